@@ -0,0 +1,115 @@
+#pragma once
+
+#include "opacity/archive/ArchiveManager.h"
+#include "opacity/core/Path.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace opacity::archive
+{
+    class ArchiveStream;
+
+    /**
+     * @brief Files inside ZIP archives, addressed as "archive.zip!inside/path"
+     *
+     * The separator is the one EntriesToFsItems puts in item paths, so an
+     * item listed from an archive can be opened as it is. An archive is
+     * mounted on first use: mapped once, with its entries indexed by name,
+     * and kept while its size and modification time stay the same.
+     * Entries are inflated on demand through ArchiveStream, with nothing
+     * written to disk.
+     *
+     * Safe to use from several threads.
+     */
+    namespace ArchiveFileSystem
+    {
+        constexpr char kSeparator = '!';
+
+        /**
+         * @brief Split a path into the archive and the entry inside it
+         * @return false when the path does not point into a ZIP archive
+         */
+        bool SplitPath(const std::string& path, std::string& archive, std::string& entry);
+
+        bool IsArchivePath(const std::string& path);
+
+        std::string JoinPath(const core::Path& archive, const std::string& entry);
+
+        /**
+         * @brief Size, time and CRC of an entry, without inflating it
+         */
+        bool Stat(const std::string& path, ArchiveEntry& entry);
+
+        /**
+         * @brief Every file entry of an archive, in archive order
+         */
+        std::vector<ArchiveEntry> ListFiles(const core::Path& archive);
+
+        /**
+         * @brief Start reading an entry
+         * @return nullptr if the archive or entry cannot be found
+         */
+        std::unique_ptr<ArchiveStream> Open(const std::string& path);
+
+        /**
+         * @brief Inflate a whole entry into memory
+         * @return false if it cannot be read or is larger than max_size
+         */
+        bool ReadEntry(const std::string& path, std::vector<char>& contents, uint64_t max_size);
+    }
+
+    /**
+     * @brief One archive entry, inflated as it is read
+     *
+     * Only what has been read so far is ever inflated. The last kWindowSize
+     * bytes are kept, so a reader that steps back a little, as image
+     * decoders do over headers, is served without starting again.
+     *
+     * While a large entry of a mapped archive is inflated, the inflater's
+     * state and dictionary are captured every few megabytes. A seek resumes
+     * from the nearest of these and inflates only the rest; otherwise it
+     * inflates and discards up to the target, or restarts the entry to go
+     * back past the window. Checkpoints are shared by every stream on the
+     * archive and saved beside the hash cache, so they outlive the process.
+     */
+    class ArchiveStream
+    {
+    public:
+        static constexpr size_t kWindowSize = 256 * 1024;
+
+        struct Impl;
+        explicit ArchiveStream(std::unique_ptr<Impl> impl);
+        ~ArchiveStream();
+
+        // Disable copy
+        ArchiveStream(const ArchiveStream&) = delete;
+        ArchiveStream& operator=(const ArchiveStream&) = delete;
+
+        uint64_t GetSize() const;
+        uint64_t Tell() const;
+
+        /**
+         * @brief Read from the current position
+         * @return Bytes read; fewer than asked only at the end or on failure
+         */
+        size_t Read(void* buffer, size_t length);
+
+        /**
+         * @brief Move to an offset within the entry
+         */
+        bool Seek(uint64_t offset);
+
+        /**
+         * @brief The entry turned out to be corrupt or could not be read
+         */
+        bool HasFailed() const;
+
+    private:
+        std::unique_ptr<Impl> impl_;
+    };
+
+} // namespace opacity::archive
@@ -1,10 +1,12 @@
 #pragma once
 
+#include "opacity/core/MemoryGovernor.h"
 #include "opacity/core/Path.h"
 #include "opacity/filesystem/FsItem.h"
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -100,6 +102,7 @@ namespace opacity::archive
         bool skip_existing = false;
         std::string password;               // For encrypted archives
         std::vector<std::string> files;     // Specific files to extract (empty = all)
+        unsigned threads = 0;               // Entries extracted at once; 0 for one per core
     };
 
     /**
@@ -114,6 +117,7 @@ namespace opacity::archive
         std::string password;               // For encryption
         std::string comment;
         std::vector<std::string> exclude_patterns;
+        unsigned threads = 0;               // Compression threads; 0 for one per core
     };
 
     /**
@@ -193,6 +197,9 @@ namespace opacity::archive
          * @param path Path to archive
          * @param password Optional password for encrypted archives
          * @return Vector of archive entries
+         *
+         * The central directory is read once and kept, as a tree, until
+         * the archive's size or modification time changes.
          */
         std::vector<ArchiveEntry> ListContents(
             const core::Path& path,
@@ -203,7 +210,10 @@ namespace opacity::archive
          * @param archive_path Path to archive
          * @param internal_path Path within the archive (empty for root)
          * @param password Optional password
-         * @return Vector of entries at the specified level
+         * @return Vector of entries at the specified level, directories
+         *         first, then by name
+         *
+         * A lookup in the cached tree; see ListContents.
          */
         std::vector<ArchiveEntry> ListDirectory(
             const core::Path& archive_path,
@@ -221,8 +231,14 @@ namespace opacity::archive
          * @brief Extract entire archive
          * @param archive_path Path to archive
          * @param options Extraction options
-         * @param progress_callback Optional progress callback
+         * @param progress_callback Optional progress callback, called one
+         *        at a time from worker threads as bytes are written
          * @return Extraction result
+         *
+         * The archive is mapped once and its entries shared out among
+         * worker threads, each inflating through its own reader, largest
+         * entries first. Every directory is created before any file is
+         * written.
          */
         ArchiveResult Extract(
             const core::Path& archive_path,
@@ -262,6 +278,11 @@ namespace opacity::archive
          * @param options Creation options
          * @param progress_callback Optional progress callback
          * @return Creation result
+         *
+         * Files are deflated in chunks on worker threads and written in
+         * order as they finish. Files that sample as already compressed
+         * are stored. The compressed form of a large file collects in a
+         * temporary file next to the archive.
          */
         ArchiveResult Create(
             const core::Path& archive_path,
@@ -319,6 +340,40 @@ namespace opacity::archive
         std::string GetLastError() const { return last_error_; }
 
     private:
+        /**
+         * @brief Central directory of one archive, parsed into a tree
+         *
+         * Node 0 is the root. Children are kept sorted by name, so a
+         * path inside the archive is found with one binary search per
+         * level.
+         */
+        struct ArchiveTree
+        {
+            struct Node
+            {
+                std::string name;
+                std::string full_path;              // Ends in '/'; empty for the root
+                size_t entry = SIZE_MAX;            // Explicit directory entry, if any
+                std::vector<size_t> directories;    // Child nodes
+                std::vector<size_t> files;          // Indices into entries
+            };
+
+            std::vector<ArchiveEntry> entries;
+            std::vector<Node> nodes;
+            int64_t modified = 0;                   // Archive's last write, when read
+            uint64_t size = 0;
+            size_t bytes = 0;                       // Estimated footprint
+        };
+
+        static constexpr size_t kMaxCachedTrees = 8;
+
+        /**
+         * @brief The archive's tree, from the cache while the file is unchanged
+         * @return nullptr if the archive cannot be read; last_error_ says why
+         */
+        std::shared_ptr<const ArchiveTree> GetTree(const core::Path& path);
+        size_t CachedBytesLocked() const;
+
         /**
          * @brief Collect files for archiving (recursive)
          */
@@ -336,6 +391,8 @@ namespace opacity::archive
         std::atomic<bool> cancel_requested_{false};
         std::string last_error_;
         mutable std::mutex mutex_;
+        std::vector<std::pair<std::string, std::shared_ptr<const ArchiveTree>>> trees_;  // Most recently used first
+        core::MemoryGovernor::Registration memory_;
     };
 
 } // namespace opacity::archive
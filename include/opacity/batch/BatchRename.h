@@ -2,12 +2,22 @@
 
 #include "opacity/core/Path.h"
 
+#include <cstdint>
 #include <functional>
 #include <memory>
+#include <optional>
 #include <regex>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
+namespace opacity::core
+{
+    class CrashRecovery;
+    struct PendingOperation;
+}
+
 namespace opacity::batch
 {
     /**
@@ -184,6 +194,11 @@ namespace opacity::batch
          */
         void AddRule(const RenameRule& rule);
 
+        /**
+         * @brief Replace a rule, as when it is edited
+         */
+        void SetRule(size_t index, const RenameRule& rule);
+
         /**
          * @brief Remove a rule by index
          */
@@ -211,6 +226,12 @@ namespace opacity::batch
 
         /**
          * @brief Generate preview of all renames
+         *
+         * Rules are compiled when they are added or edited, and files are
+         * run through them in parallel chunks. What each rule produced is
+         * kept, so after an edit only that rule and the ones after it run
+         * again; a change to the files or their order starts over.
+         *
          * @return Vector of previews for each file
          */
         std::vector<RenamePreview> GeneratePreview();
@@ -236,7 +257,16 @@ namespace opacity::batch
 
         /**
          * @brief Execute the rename operations
-         * @param progress_callback Optional progress callback
+         *
+         * Renames that take each other's names, such as a swap or a
+         * rotation, are ordered so every target is free when its turn
+         * comes, and a cycle goes through a temporary name. Each chain of
+         * dependent renames is all or nothing: if one step fails, the
+         * chain's earlier steps are renamed back. Directories are renamed
+         * in parallel. Nothing is ever overwritten.
+         *
+         * @param progress_callback Optional progress callback, called from
+         *        one thread at a time
          * @return Result of the operation
          */
         RenameResult Execute(RenameProgressCallback progress_callback = nullptr);
@@ -247,6 +277,34 @@ namespace opacity::batch
          */
         bool Undo();
 
+        /**
+         * @brief Journal each batch to recovery before renaming anything
+         *
+         * The journal holds the planned steps and is cleared once the batch
+         * is done, so it is only found after a crash mid-batch.
+         */
+        void SetJournal(core::CrashRecovery* recovery) { journal_ = recovery; }
+
+        /**
+         * @brief Journal every batch created from now on; nullptr stops it
+         *
+         * The recovery must outlive the batches, or be unset before it goes.
+         */
+        static void SetDefaultJournal(core::CrashRecovery* recovery);
+
+        /**
+         * @brief Put back the names a crashed batch had changed
+         *
+         * Goes by what is on disk, not by how far the journal got: each
+         * step is reversed, last first, where its target exists and its
+         * source does not. Clears the journal entry when recovery is given.
+         *
+         * @return false if the entry is not a rename journal or a step
+         *         could not be reversed
+         */
+        static bool RollBackJournal(const core::PendingOperation& pending,
+                                    core::CrashRecovery* recovery = nullptr);
+
         /**
          * @brief Check if undo is available
          */
@@ -316,15 +374,99 @@ namespace opacity::batch
         std::pair<std::string, std::string> SplitExtension(const std::string& filename) const;
 
         /**
-         * @brief Check if new name conflicts with existing files
+         * @brief A rule with its regex built and search text folded
+         */
+        struct CompiledRule
+        {
+            RenameRule rule;
+            std::optional<std::regex> regex;    // Empty when not a regex rule or invalid
+            std::string folded_find;            // Lowercase, for case-insensitive Replace
+        };
+
+        /**
+         * @brief Names after one rule, for every file
+         */
+        struct Stage
+        {
+            std::vector<std::string> names;
+            std::vector<std::string> errors;    // Empty where the file has none
+        };
+
+        /**
+         * @brief A file to move to a new name; file is its index in files_
          */
-        bool HasConflict(const core::Path& new_path, 
-                        const std::vector<RenamePreview>& previews,
-                        size_t current_index) const;
+        struct RenameMove
+        {
+            core::Path from;
+            core::Path to;
+            size_t file = 0;
+        };
+
+        /**
+         * @brief One rename of a plan; final steps land a file on its new name
+         */
+        struct RenameStep
+        {
+            core::Path from;
+            core::Path to;
+            size_t move = 0;            // Into the moves planned
+            bool final = true;          // false for the move to a temporary name
+        };
+
+        static constexpr size_t kPreviewChunk = 1024;
+        static constexpr unsigned kMaxPreviewThreads = 8;
+        static constexpr unsigned kMaxRenameThreads = 8;
+
+        /**
+         * @brief Order moves into sequences that never rename onto a name
+         *        still taken, grouped by directory
+         */
+        static std::vector<std::vector<std::vector<RenameStep>>> PlanMoves(const std::vector<RenameMove>& moves);
+
+        /**
+         * @brief Run planned moves; done[i] says whether moves[i] landed
+         */
+        void RunMoves(const std::vector<RenameMove>& moves,
+                      const std::string& kind,
+                      RenameResult& result,
+                      std::vector<uint8_t>& done,
+                      const RenameProgressCallback& progress_callback);
+
+        static CompiledRule CompileRule(const RenameRule& rule);
+
+        std::string ApplyCompiled(const std::string& filename,
+                                  const CompiledRule& compiled,
+                                  size_t file_index) const;
+
+        /**
+         * @brief Run the rules no stage is kept for
+         */
+        void UpdateStages();
+
+        /**
+         * @brief Whether a file not in the batch already has this name, in any case
+         */
+        bool NameExists(const std::string& directory, const std::string& name);
+
+        // Stages from this rule on are recomputed
+        void InvalidateFrom(size_t rule_index);
+
+        // The file list or its order changed
+        void InvalidateFiles();
 
         std::vector<core::Path> files_;
         std::vector<RenameRule> rules_;
+        std::vector<CompiledRule> compiled_;        // Alongside rules_
+
+        // Preview state, rebuilt as far as it has been invalidated
+        std::vector<std::string> names_;            // Filename of each file
+        std::vector<std::string> directories_;      // Parent of each file
+        std::vector<Stage> stages_;                 // Output of each rule
+        size_t valid_stages_ = 0;
+        std::unordered_map<std::string, std::unordered_set<std::string>> existing_names_;  // By directory
         
+        core::CrashRecovery* journal_ = nullptr;
+
         // Undo stack: pairs of (new_path, original_path)
         std::vector<std::vector<std::pair<core::Path, core::Path>>> undo_stack_;
         static constexpr size_t MAX_UNDO_LEVELS = 10;
@@ -1,6 +1,9 @@
 #pragma once
 
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/HashCache.h"
 #include "opacity/core/Path.h"
+#include "opacity/core/TaskScheduler.h"
 #include "opacity/filesystem/FsItem.h"
 
 #include <atomic>
@@ -20,11 +23,12 @@ namespace opacity::batch
      */
     enum class DuplicateMatchMode
     {
-        ExactHash,          // MD5/SHA hash comparison (slowest, most accurate)
+        ExactHash,          // Full content hash of every file that matched so far (exact)
         QuickHash,          // Hash of first/last blocks only (faster)
         SizeOnly,           // Same size files (fastest, least accurate)
         SizeAndName,        // Same size and filename
-        SizeAndPartialHash  // Same size + hash of first 64KB
+        SizeAndPartialHash, // Same size + first/last blocks, confirmed by a full hash (exact)
+        PerceptualImage     // Images that look alike at thumbnail size, whatever their size or format
     };
 
     /**
@@ -33,17 +37,31 @@ namespace opacity::batch
     struct DuplicateGroup
     {
         std::string hash;                           // Hash or identifier
-        uint64_t file_size = 0;                     // Size of each file
+        uint64_t file_size = 0;                     // Size of each file; of the smallest for PerceptualImage
         std::vector<core::Path> files;              // Files in this group
+        std::vector<size_t> same_file;              // Parallel to files: index of the first path to the same file on disk
+        std::vector<uint32_t> links;                // Parallel to files: names the file has on its volume, 0 if unknown
         std::chrono::system_clock::time_point oldest_modified;
         std::chrono::system_clock::time_point newest_modified;
         
         /**
-         * @brief Get total wasted space (group size * (count - 1))
+         * @brief Files on disk; hard links and other paths to one file count once
+         */
+        size_t GetDistinctFileCount() const;
+
+        /**
+         * @brief Whether the file at index is already a hard link, to
+         *        another path in the group or to one outside the search
+         */
+        bool IsLinked(size_t index) const;
+
+        /**
+         * @brief Get total wasted space (group size * (distinct files - 1))
          */
         uint64_t GetWastedSpace() const
         {
-            return files.size() > 1 ? file_size * (files.size() - 1) : 0;
+            size_t distinct = GetDistinctFileCount();
+            return distinct > 1 ? file_size * (distinct - 1) : 0;
         }
 
         /**
@@ -81,6 +99,9 @@ namespace opacity::batch
         std::vector<std::string> exclude_extensions;
         std::vector<std::string> exclude_patterns;  // Regex patterns to exclude
         bool skip_zero_size = true;                 // Skip empty files
+        bool read_placeholders = false;             // Hash online-only cloud files (downloads them)
+        int max_image_distance = 8;                 // PerceptualImage: differing bits of 64 that still match
+        core::BackgroundPolicy background;          // Priority and pacing for the file readers
     };
 
     /**
@@ -94,7 +115,7 @@ namespace opacity::batch
         uint64_t bytes_scanned = 0;
         uint64_t total_bytes = 0;
         std::string current_file;
-        std::string current_phase;      // "Scanning", "Grouping", "Hashing"
+        std::string current_phase;      // "Scanning files", "Identifying files", "Comparing first and last blocks", "Computing hashes", "Comparing images"
         double percentage = 0.0;
     };
 
@@ -109,6 +130,7 @@ namespace opacity::batch
         std::vector<DuplicateGroup> groups;
         size_t total_files_scanned = 0;
         size_t total_duplicates = 0;
+        size_t placeholders_skipped = 0;            // Online-only files left unhashed
         uint64_t total_wasted_space = 0;
         std::chrono::milliseconds duration{0};
         bool success = false;
@@ -194,6 +216,14 @@ namespace opacity::batch
          */
         DuplicateResult GetCurrentResult() const;
 
+        /**
+         * @brief Remember hashes across runs; null to hash every file
+         *
+         * A scan then reads only files changed since they were last hashed.
+         * Set while no search is running.
+         */
+        void SetHashCache(std::shared_ptr<core::HashCache> cache) { hash_cache_ = std::move(cache); }
+
         /**
          * @brief Auto-select files for deletion based on mode
          * @param groups Groups to process
@@ -231,6 +261,9 @@ namespace opacity::batch
          * @param group Duplicate group to link
          * @param keep_file The file to keep, others become links to it
          * @return true on success
+         *
+         * Paths that are already links to keep_file are left alone, so
+         * linking a group twice changes nothing.
          */
         bool CreateHardLinks(
             const DuplicateGroup& group,
@@ -262,9 +295,9 @@ namespace opacity::batch
             const std::vector<std::pair<core::Path, uint64_t>>& files);
 
         /**
-         * @brief Calculate file hash
+         * @brief Calculate the hash of a whole file
          */
-        std::string CalculateHash(const core::Path& path, DuplicateMatchMode mode);
+        std::string CalculateFullHash(const core::Path& path);
 
         /**
          * @brief Calculate partial hash (first/last blocks)
@@ -288,7 +321,8 @@ namespace opacity::batch
         std::atomic<bool> cancel_requested_{false};
         mutable std::mutex result_mutex_;
         DuplicateResult current_result_;
-        std::unique_ptr<std::thread> worker_thread_;
+        core::TaskHandle worker_task_;
+        std::shared_ptr<core::HashCache> hash_cache_;
     };
 
 } // namespace opacity::batch
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opacity::batch
+{
+    /**
+     * @brief Perceptual hashes of images, for finding resized and
+     *        re-encoded copies
+     */
+    class ImageHash
+    {
+    public:
+        /**
+         * @brief 64-bit difference hash of RGBA pixels
+         *
+         * The image is averaged down to 9x8 grey cells and each bit says
+         * whether a cell is brighter than the one to its right. Scaling,
+         * recompression and small colour shifts flip a few bits; unrelated
+         * pictures differ in about half of them.
+         */
+        static uint64_t Compute(const uint8_t* rgba, int width, int height);
+
+        /**
+         * @brief Bits that differ between two hashes
+         */
+        static int Distance(uint64_t a, uint64_t b);
+    };
+
+    /**
+     * @brief Finds every hash within a Hamming distance of a query
+     *
+     * A BK-tree: each child sits at its exact distance from its parent, so
+     * by the triangle inequality a query only descends into children whose
+     * distance is within the radius of its own distance to the parent. A
+     * small radius visits a small part of the tree however many hashes it
+     * holds. Equal hashes share a node.
+     */
+    class HammingIndex
+    {
+    public:
+        void Reserve(size_t count);
+
+        void Insert(uint64_t hash, uint32_t id);
+
+        /**
+         * @brief Append the ids of every hash at most radius bits from hash
+         */
+        void Find(uint64_t hash, int radius, std::vector<uint32_t>& ids) const;
+
+        size_t GetNodeCount() const { return nodes_.size(); }
+
+    private:
+        static constexpr uint32_t kNone = UINT32_MAX;
+
+        struct Node
+        {
+            uint64_t hash = 0;
+            uint32_t id = 0;
+            uint32_t more_ids = kNone;          // Further ids with the same hash, in extra_ids_
+            uint32_t first_child = kNone;
+            uint32_t next_sibling = kNone;
+            uint32_t distance = 0;              // From the parent
+        };
+
+        struct ExtraId
+        {
+            uint32_t id;
+            uint32_t next;
+        };
+
+        std::vector<Node> nodes_;
+        std::vector<ExtraId> extra_ids_;
+    };
+
+} // namespace opacity::batch
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "opacity/core/ShellIntegration.h"
+
+namespace opacity::cli
+{
+    /**
+     * @brief Exit codes of headless commands
+     */
+    enum ExitCode : int
+    {
+        kExitSuccess = 0,
+        kExitDifferences = 1,       // compare: the folders differ (after syncing, if asked to)
+        kExitFailure = 2            // Bad arguments, or the operation failed
+    };
+
+    /**
+     * @brief Whether the command line asks for a headless command rather
+     *        than the window
+     *
+     * search, compare, dedupe, extract, archive and copy run headless, as
+     * do help and version; anything else (no command, or open) starts the
+     * user interface.
+     */
+    bool IsHeadlessCommand(const core::CommandLineResult& args);
+
+    /**
+     * @brief Run a headless command and return its exit code
+     *
+     * Nothing of the user interface is created: no window, no Direct3D
+     * device and no ImGui context. Results are written to stdout as
+     * newline-delimited JSON, one object per line and flushed as it is
+     * written, so a script can act on the first record while the rest are
+     * still coming. Every object has a "type"; the last one written is
+     * always a "summary" or an "error". The log goes to its file only, at
+     * warnings and above unless --verbose is given.
+     */
+    int Run(const core::CommandLineResult& args);
+
+} // namespace opacity::cli
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace opacity::core
+{
+    /**
+     * @brief How a background scanner shares the machine
+     */
+    struct BackgroundPolicy
+    {
+        bool low_priority = true;                       // Background thread mode and very low I/O priority
+        bool yield_to_foreground = true;                // Pause while file operations or input are active
+        std::chrono::milliseconds input_grace{500};     // Input counts as active this long after the last event
+        std::chrono::milliseconds max_pause{5000};      // Longest single pause, so work still trickles on
+    };
+
+    /**
+     * @brief What the user is doing right now, as background work sees it
+     *
+     * The UI reports input and OperationQueue reports running jobs; both
+     * are a relaxed atomic write, cheap enough for every message.
+     */
+    class ForegroundActivity
+    {
+    public:
+        static void NoteInput();
+
+        static void BeginOperation();
+        static void EndOperation();
+
+        /**
+         * @brief Whether an operation runs, or input came within input_grace
+         */
+        static bool IsActive(std::chrono::milliseconds input_grace);
+
+        /**
+         * @brief Marks a foreground operation for its lifetime
+         */
+        class OperationScope
+        {
+        public:
+            OperationScope() { BeginOperation(); }
+            ~OperationScope() { EndOperation(); }
+
+            OperationScope(const OperationScope&) = delete;
+            OperationScope& operator=(const OperationScope&) = delete;
+        };
+
+    private:
+        static std::atomic<int> operations_;
+        static std::atomic<int64_t> last_input_;       // steady_clock ticks
+    };
+
+    /**
+     * @brief Runs the calling thread as background work while it lives
+     *
+     * With low_priority set the thread enters THREAD_MODE_BACKGROUND,
+     * which lowers its CPU, I/O and memory priority together, and files
+     * it opens through FileHasher or MappedFile are hinted very low I/O
+     * priority. The mode is left again on destruction, so a scope is safe
+     * inside a task on a shared pool thread. Scopes nest; only the
+     * outermost one changes the thread.
+     */
+    class BackgroundScope
+    {
+    public:
+        explicit BackgroundScope(const BackgroundPolicy& policy = BackgroundPolicy());
+        ~BackgroundScope();
+
+        BackgroundScope(const BackgroundScope&) = delete;
+        BackgroundScope& operator=(const BackgroundScope&) = delete;
+
+        /**
+         * @brief Pause while the foreground is active, up to max_pause
+         *
+         * Call between units of work, such as once per file.
+         */
+        void Yield(const std::atomic<bool>* cancel = nullptr) const;
+
+        /**
+         * @brief Hint very low I/O priority on a file handle, if the
+         *        calling thread is in a low-priority scope
+         * @param handle A Win32 HANDLE; ignored elsewhere
+         */
+        static void HintFileHandle(void* handle);
+
+    private:
+        BackgroundPolicy policy_;
+        bool entered_ = false;
+    };
+
+} // namespace opacity::core
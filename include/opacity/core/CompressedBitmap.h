@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opacity::core
+{
+    /**
+     * @brief Set of 32-bit ids, compressed the way Roaring bitmaps are
+     *
+     * Ids are split by their high 16 bits into containers. A container of
+     * up to kArrayLimit ids is a sorted array of the low halves; a fuller
+     * one is a 65536-bit bitset. Sparse sets stay small, dense ones cost
+     * 8 KB per 65536 ids, and set operations work container by container,
+     * a word at a time where both sides are bitsets.
+     */
+    class CompressedBitmap
+    {
+    public:
+        static constexpr size_t kArrayLimit = 4096;
+
+        /**
+         * @return false if value was already in
+         */
+        bool Add(uint32_t value);
+
+        /**
+         * @return false if value was not in
+         */
+        bool Remove(uint32_t value);
+
+        bool Contains(uint32_t value) const;
+
+        size_t Count() const;
+        bool Empty() const { return containers_.empty(); }
+        void Clear() { containers_.clear(); }
+
+        CompressedBitmap& operator&=(const CompressedBitmap& other);
+        CompressedBitmap& operator|=(const CompressedBitmap& other);
+
+        /**
+         * @brief Remove every id that other holds
+         */
+        CompressedBitmap& AndNot(const CompressedBitmap& other);
+
+        /**
+         * @brief Call fn(id) for every id in increasing order
+         */
+        template <typename Fn>
+        void ForEach(Fn&& fn) const
+        {
+            for (const auto& container : containers_)
+            {
+                uint32_t high = static_cast<uint32_t>(container.key) << 16;
+                if (container.bits.empty())
+                {
+                    for (uint16_t low : container.array)
+                        fn(high | low);
+                    continue;
+                }
+                for (size_t w = 0; w < container.bits.size(); ++w)
+                {
+                    uint64_t bits = container.bits[w];
+                    while (bits)
+                    {
+                        fn(high | static_cast<uint32_t>(w * 64 + CountTrailingZeros(bits)));
+                        bits &= bits - 1;
+                    }
+                }
+            }
+        }
+
+    private:
+        struct Container
+        {
+            uint16_t key = 0;               // High 16 bits of its ids
+            uint32_t count = 0;
+            std::vector<uint16_t> array;    // Sorted low halves, unless bits is set
+            std::vector<uint64_t> bits;     // 1024 words when a bitset
+        };
+
+        static size_t CountTrailingZeros(uint64_t bits);
+
+        Container* Find(uint16_t key);
+        const Container* Find(uint16_t key) const;
+
+        /**
+         * @brief Switch to whichever form suits the count
+         */
+        static void Normalize(Container& container);
+        static void ToBitset(Container& container);
+
+        static Container And(const Container& a, const Container& b);
+        static Container Or(const Container& a, const Container& b);
+        static Container AndNot(const Container& a, const Container& b);
+
+        std::vector<Container> containers_;     // Sorted by key; none empty
+    };
+
+} // namespace opacity::core
@@ -1,22 +1,143 @@
 #pragma once
 
+#include <atomic>
+#include <functional>
 #include <string>
 #include <memory>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
 #include <nlohmann/json.hpp>
 
 namespace opacity::core
 {
     using json = nlohmann::json;
 
+    /**
+     * @brief A configuration key resolved once, kept current by Config
+     */
+    class ConfigSlot
+    {
+    public:
+        explicit ConfigSlot(std::string key) : key_(std::move(key)) {}
+        virtual ~ConfigSlot() = default;
+
+        const std::string& Key() const { return key_; }
+
+        /**
+         * @brief Take the value now stored at the key
+         * @param value The value, or null when the key is missing
+         */
+        virtual void Publish(const json* value) = 0;
+
+    private:
+        std::string key_;
+    };
+
+    /**
+     * @brief Slot holding a converted value for lock-free reads
+     *
+     * Numbers, bools and enums are kept in an atomic. Anything else is
+     * kept as an immutable copy behind a shared pointer that Publish
+     * replaces, so a reader holding the old copy is never disturbed.
+     */
+    template<typename T>
+    class TypedConfigSlot final : public ConfigSlot
+    {
+    public:
+        TypedConfigSlot(std::string key, T default_value)
+            : ConfigSlot(std::move(key))
+            , default_value_(std::move(default_value))
+        {
+            Store(default_value_);
+        }
+
+        void Publish(const json* value) override
+        {
+            T converted = default_value_;
+            if (value)
+            {
+                try
+                {
+                    converted = value->get<T>();
+                }
+                catch (const std::exception&)
+                {
+                    // Keep the default when the stored value has the wrong type
+                }
+            }
+            Store(std::move(converted));
+        }
+
+        T Load() const
+        {
+            if constexpr (kScalar)
+                return value_.load(std::memory_order_acquire);
+            else
+                return *std::atomic_load_explicit(&value_, std::memory_order_acquire);
+        }
+
+    private:
+        static constexpr bool kScalar = std::is_arithmetic_v<T> || std::is_enum_v<T>;
+        using Storage = std::conditional_t<kScalar, std::atomic<T>, std::shared_ptr<const T>>;
+
+        void Store(T value)
+        {
+            if constexpr (kScalar)
+                value_.store(value, std::memory_order_release);
+            else
+                std::atomic_store_explicit(&value_, std::shared_ptr<const T>(std::make_shared<T>(std::move(value))),
+                                           std::memory_order_release);
+        }
+
+        T default_value_;
+        Storage value_{};
+    };
+
+    /**
+     * @brief Cheap handle to one configuration value
+     *
+     * Get reads the slot directly: no key parsing, no JSON and no lock.
+     * Handles stay valid for the life of the Config that made them.
+     */
+    template<typename T>
+    class ConfigHandle
+    {
+    public:
+        ConfigHandle() = default;
+
+        T Get() const { return slot_ ? slot_->Load() : T(); }
+
+        bool IsValid() const { return slot_ != nullptr; }
+
+    private:
+        friend class Config;
+
+        explicit ConfigHandle(const TypedConfigSlot<T>* slot) : slot_(slot) {}
+
+        const TypedConfigSlot<T>* slot_ = nullptr;
+    };
+
     /**
      * @brief Configuration management system
-     * 
+     *
      * Handles application settings stored in JSON format in %APPDATA%\Opacity.
      * Provides thread-safe access to configuration with live reload capability.
+     *
+     * Get and Set look the key up each time. Code that reads a setting
+     * often, such as every frame, should take a Handle once instead; Set
+     * and Load republish the handles they affect, and listeners hear about
+     * each change so subsystems can keep derived values of their own.
      */
     class Config
     {
     public:
+        /**
+         * @brief Called after a change; key is the one set, or empty after a reload
+         */
+        using ChangeListener = std::function<void(const std::string& key)>;
+
         /**
          * @brief Initialize configuration system
          * @param app_name Name of application subdirectory in APPDATA
@@ -58,7 +179,26 @@ namespace opacity::core
         void Set(const std::string& key, const T& value);
 
         /**
-         * @brief Get raw JSON object
+         * @brief Resolve a key once, for reading it often
+         * @param key Configuration key (dot-separated for nested values)
+         * @param default_value Read while the key is missing or of another type
+         */
+        template<typename T>
+        ConfigHandle<T> Handle(const std::string& key, const T& default_value = T());
+
+        /**
+         * @brief Register a change listener
+         * @return Id for RemoveListener
+         */
+        size_t AddListener(ChangeListener listener);
+
+        /**
+         * @brief Remove a change listener
+         */
+        void RemoveListener(size_t id);
+
+        /**
+         * @brief Get raw JSON object; not synchronized with Set
          */
         const json& GetRaw() const { return data_; }
 
@@ -70,10 +210,27 @@ namespace opacity::core
     private:
         Config();
 
+        /**
+         * @brief The value at a dotted key, or null; never inserts
+         */
+        const json* Find(const std::string& key) const;
+
+        void SetValue(const std::string& key, json value);
+        void AddSlot(std::unique_ptr<ConfigSlot> slot);
+        void Notify(const std::string& key);
+
         static std::shared_ptr<Config> instance_;
         json data_;
         std::string config_dir_;
         std::string config_file_;
+
+        // Guards data_ and slots_
+        mutable std::mutex mutex_;
+        std::vector<std::unique_ptr<ConfigSlot>> slots_;
+
+        std::mutex listeners_mutex_;
+        std::vector<std::pair<size_t, ChangeListener>> listeners_;
+        size_t next_listener_id_ = 1;
     };
 
     // Template implementations
@@ -82,20 +239,10 @@ namespace opacity::core
     {
         try
         {
-            size_t pos = 0;
-            json* current = const_cast<json*>(&data_);
-
-            while ((pos = key.find('.')) != std::string::npos)
-            {
-                std::string segment = key.substr(0, pos);
-                current = &(*current)[segment];
-                // Would need proper error handling in actual implementation
-            }
-
-            std::string last_segment = key.substr(pos);
-            if (current->contains(last_segment))
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (const json* value = Find(key))
             {
-                return current->at(last_segment).get<T>();
+                return value->get<T>();
             }
         }
         catch (const std::exception&)
@@ -111,18 +258,7 @@ namespace opacity::core
     {
         try
         {
-            size_t pos = 0;
-            json* current = &data_;
-
-            while ((pos = key.find('.')) != std::string::npos)
-            {
-                std::string segment = key.substr(0, pos);
-                (*current)[segment] = json::object();
-                current = &(*current)[segment];
-            }
-
-            std::string last_segment = key.substr(pos);
-            (*current)[last_segment] = value;
+            SetValue(key, json(value));
         }
         catch (const std::exception&)
         {
@@ -130,4 +266,13 @@ namespace opacity::core
         }
     }
 
+    template<typename T>
+    ConfigHandle<T> Config::Handle(const std::string& key, const T& default_value)
+    {
+        auto slot = std::make_unique<TypedConfigSlot<T>>(key, default_value);
+        const TypedConfigSlot<T>* typed = slot.get();
+        AddSlot(std::move(slot));
+        return ConfigHandle<T>(typed);
+    }
+
 } // namespace opacity::core
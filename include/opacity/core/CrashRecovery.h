@@ -55,7 +55,7 @@ namespace opacity::core
         std::filesystem::path destination;
         int processedCount = 0;
         int totalCount = 0;
-        std::string customData;
+        std::string customData;         // Owner's resume data, often JSON
     };
 
     /**
@@ -193,9 +193,22 @@ namespace opacity::core
 
         /**
          * @brief Set session save callback
+         *
+         * Called on the auto-save thread; used only until the first
+         * PublishSessionState.
          */
         void SetSessionSaveCallback(SessionSaveCallback callback);
 
+        /**
+         * @brief Hand over the latest state for auto-save to write
+         *
+         * Meant for the UI thread, which only moves the state in; the
+         * auto-save thread serializes it, compares it with what it last
+         * wrote and writes only if it changed. A state published twice
+         * before a save is written once.
+         */
+        void PublishSessionState(SessionState state);
+
         // ============== Settings Backup ==============
 
         /**
@@ -274,6 +287,12 @@ namespace opacity::core
          */
         void UpdateOperationProgress(const std::string& operationId, int processed);
 
+        /**
+         * @brief Update pending operation progress and its resume data
+         */
+        void UpdateOperationProgress(const std::string& operationId, int processed,
+                                     const std::string& customData);
+
         /**
          * @brief Complete pending operation
          */
@@ -0,0 +1,70 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "opacity/core/Path.h"
+
+namespace opacity::core
+{
+    class HashCache;
+
+    /**
+     * @brief One file for FileHasher::HashFiles
+     */
+    struct FileHashJob
+    {
+        Path path;
+        bool partial = false;       // First and last block only; see HashPartial
+        std::string hash;           // Set on success
+        bool success = false;
+    };
+
+    /**
+     * @brief Content hashes of files, as XXH64 hex digests
+     *
+     * Shared by folder comparison, duplicate finding and copy verification,
+     * so a hash from one is comparable with a hash from another. Whole
+     * files are read in large blocks with the next read already in flight
+     * while the last is hashed, which keeps a disk streaming at full speed
+     * on a single core.
+     */
+    class FileHasher
+    {
+    public:
+        static constexpr size_t kBlockSize = 4 * 1024 * 1024;
+        static constexpr size_t kPartialBlockSize = 64 * 1024;
+        static constexpr unsigned kMaxThreads = 8;
+
+        /**
+         * @brief Hash a whole file
+         * @param cancel Checked between blocks; a cancelled hash fails
+         * @return false when the file cannot be read
+         */
+        static bool HashFile(const Path& path, std::string& hash, const std::atomic<bool>* cancel = nullptr);
+
+        /**
+         * @brief Hash the first block and, when the file is over two blocks
+         *        long, the last; a quick filter for telling files apart
+         */
+        static bool HashPartial(const Path& path, std::string& hash, size_t block_size = kPartialBlockSize);
+
+        /**
+         * @brief Hash many files at once on a pool of worker threads
+         * @param threads 0 for one per core, up to kMaxThreads
+         * @param on_hashed Called once per job as it finishes, one call at
+         *        a time, from a worker thread
+         * @param cache Hashes kept from earlier runs, and where new ones go
+         *
+         * Jobs left when cancel is set are not started and stay unsuccessful.
+         */
+        static void HashFiles(std::vector<FileHashJob>& jobs, unsigned threads = 0,
+                              const std::atomic<bool>* cancel = nullptr,
+                              const std::function<void(const FileHashJob&)>& on_hashed = nullptr,
+                              HashCache* cache = nullptr);
+    };
+
+} // namespace opacity::core
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace opacity::core
+{
+    /**
+     * @brief Streaming XXH64
+     *
+     * Fast enough (several GB/s per core) to hash data inline while it is
+     * copied. The running state can be saved as text and restored later,
+     * so a hash can continue from where an interrupted stream stopped.
+     */
+    class Xxh64
+    {
+    public:
+        explicit Xxh64(uint64_t seed = 0);
+
+        void Update(const void* data, size_t length);
+
+        [[nodiscard]] uint64_t Digest() const;
+
+        /**
+         * @brief Digest as 16 lowercase hex digits
+         */
+        [[nodiscard]] std::string HexDigest() const;
+
+        /**
+         * @brief Running state as hex text, for LoadState
+         */
+        [[nodiscard]] std::string SaveState() const;
+
+        /**
+         * @brief Restore a state from SaveState
+         * @return false (and the state is left alone) if text is malformed
+         */
+        bool LoadState(const std::string& text);
+
+        [[nodiscard]] uint64_t Length() const { return length_; }
+
+    private:
+        uint64_t lanes_[4];
+        uint64_t seed_;
+        uint64_t length_ = 0;
+        uint8_t pending_[32];       // Bytes short of a whole 32-byte stripe
+        size_t pending_size_ = 0;
+    };
+
+} // namespace opacity::core
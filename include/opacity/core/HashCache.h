@@ -0,0 +1,147 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "opacity/core/MemoryGovernor.h"
+#include "opacity/core/Path.h"
+
+namespace opacity::core
+{
+    /**
+     * @brief Identifies one version of one file
+     *
+     * The file id survives renames and moves within a volume; the
+     * modification time and size make an edited file miss.
+     */
+    struct FileIdentity
+    {
+        uint64_t volume = 0;        // Volume serial; 0 when file_id is a hash of the path
+        uint64_t file_id = 0;
+        int64_t modified = 0;       // Last write, FILETIME ticks
+        uint64_t size = 0;
+        uint32_t links = 1;         // Hard links to the file, its own name included
+    };
+
+    /**
+     * @brief FileHasher results kept on disk between runs
+     *
+     * Full and partial hashes of a file are remembered together until the
+     * file changes, so a comparison or duplicate scan over a tree that has
+     * barely changed reads only what did. Every store appends one small
+     * record to a single file; Open() reads them back, later records
+     * replacing earlier ones, and cuts off a record torn by a crash. The
+     * file is rewritten without superseded records once they outnumber
+     * the live ones, keeping the most recently stored max_entries.
+     *
+     * Safe to use from several threads.
+     */
+    class HashCache
+    {
+    public:
+        explicit HashCache(Path file = DefaultLocation(), size_t max_entries = 4 * 1024 * 1024);
+        ~HashCache();
+
+        // Disable copy
+        HashCache(const HashCache&) = delete;
+        HashCache& operator=(const HashCache&) = delete;
+
+        /**
+         * @brief Load or create the cache file
+         * @return false if it cannot be written; the cache then stays empty
+         *         and every hash is computed
+         */
+        bool Open();
+
+        /**
+         * @brief Volume, file id, size and last write time, from one handle
+         *        open that never reads the contents
+         */
+        static bool ReadIdentity(const Path& path, FileIdentity& identity);
+
+        /**
+         * @brief Hash a whole file, or take the hash kept for this version
+         */
+        bool HashFile(const Path& path, std::string& hash, const std::atomic<bool>* cancel = nullptr);
+
+        /**
+         * @brief FileHasher::HashPartial with the default block size,
+         *        through the cache
+         */
+        bool HashPartial(const Path& path, std::string& hash);
+
+        bool FindFull(const FileIdentity& identity, std::string& hash) const;
+        bool FindPartial(const FileIdentity& identity, std::string& hash) const;
+        void StoreFull(const FileIdentity& identity, const std::string& hash);
+        void StorePartial(const FileIdentity& identity, const std::string& hash);
+
+        /**
+         * @brief Write out stores still buffered
+         */
+        void Flush();
+
+        size_t GetEntryCount() const;
+
+        /**
+         * @brief hashes.dat in the local application data folder
+         */
+        static Path DefaultLocation();
+
+    private:
+        static constexpr size_t kDigestLength = 16;
+
+        struct Slot
+        {
+            uint64_t volume;
+            uint64_t file_id;
+
+            bool operator==(const Slot& other) const
+            {
+                return volume == other.volume && file_id == other.file_id;
+            }
+        };
+
+        struct SlotHash
+        {
+            size_t operator()(const Slot& slot) const;
+        };
+
+        struct Entry
+        {
+            int64_t modified = 0;
+            uint64_t size = 0;
+            uint64_t sequence = 0;          // Order stored; compaction keeps the newest
+            uint32_t flags = 0;
+            char full[kDigestLength] = {};
+            char partial[kDigestLength] = {};
+        };
+
+        // One entry in entries_, node and bucket included
+        static constexpr size_t kEntryBytes = sizeof(Slot) + sizeof(Entry) + 4 * sizeof(void*);
+
+        bool Find(const FileIdentity& identity, uint32_t flag, std::string& hash) const;
+        void Store(const FileIdentity& identity, uint32_t flag, const std::string& hash);
+        static void WriteRecord(std::ostream& out, const Slot& slot, const Entry& entry);
+        void AppendLocked(const Slot& slot, const Entry& entry);
+        void CompactLocked();
+        void TrimLocked(size_t max_entries);
+
+        Path file_;
+        size_t max_entries_;
+
+        mutable std::mutex mutex_;
+        std::ofstream log_;
+        bool open_ = false;
+        uint64_t records_ = 0;              // In the file, superseded ones included
+        uint64_t next_sequence_ = 0;
+        std::unordered_map<Slot, Entry, SlotHash> entries_;
+
+        MemoryGovernor::Registration memory_;
+    };
+
+} // namespace opacity::core
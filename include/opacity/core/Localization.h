@@ -4,7 +4,10 @@
 #ifndef OPACITY_CORE_LOCALIZATION_H
 #define OPACITY_CORE_LOCALIZATION_H
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <type_traits>
 #include <vector>
 #include <functional>
 #include <memory>
@@ -12,6 +15,30 @@
 
 namespace opacity { namespace core {
 
+/**
+ * @brief Id of a translation key
+ */
+using StringId = uint64_t;
+
+constexpr StringId kStringIdSeed = 14695981039346656037ull;
+
+/**
+ * @brief Hash a translation key (FNV-1a); usable at compile time
+ * @param seed Id of a prefix, to extend it without building the whole key
+ */
+constexpr StringId stringId(std::string_view key, StringId seed = kStringIdSeed) {
+    StringId hash = seed;
+    for (char c : key) {
+        hash ^= static_cast<uint8_t>(c);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+// Id of a literal key, always computed by the compiler
+#define OPACITY_STRING_ID(key) \
+    (std::integral_constant<opacity::core::StringId, opacity::core::stringId(key)>::value)
+
 /**
  * @brief Language information
  */
@@ -59,6 +86,12 @@ struct FormatArg {
  * - Fallback to default language
  * - RTL language support
  * - Dynamic language switching
+ *
+ * The strings of the current language, with the fallback language under
+ * them, are compiled into one flat table the first time they are looked
+ * up after a change. Entries are found by StringId and their placeholders
+ * are split out in advance, so text() is a lookup without allocating and
+ * format() and plural() build their result in a single pass.
  */
 class Localization {
 public:
@@ -86,6 +119,12 @@ public:
     std::string get(const std::string& key) const;
     std::string get(const std::string& key, const std::string& defaultValue) const;
     
+    // Translation by id; the text stays valid until the strings change
+    const char* text(StringId id, const char* defaultValue = "") const;
+    std::string format(StringId id, const std::vector<FormatArg>& args) const;
+    std::string plural(StringId id, int count) const;
+    std::string plural(StringId id, int count, const std::vector<FormatArg>& args) const;
+    
     // Translation with context
     std::string getContext(const std::string& context, const std::string& key) const;
     
@@ -109,21 +148,21 @@ public:
     std::string formatRelativeTime(time_t timestamp) const;
     
     // Shortcuts for common UI strings
-    std::string ok() const { return get("ui.ok", "OK"); }
-    std::string cancel() const { return get("ui.cancel", "Cancel"); }
-    std::string yes() const { return get("ui.yes", "Yes"); }
-    std::string no() const { return get("ui.no", "No"); }
-    std::string apply() const { return get("ui.apply", "Apply"); }
-    std::string close() const { return get("ui.close", "Close"); }
-    std::string save() const { return get("ui.save", "Save"); }
-    std::string open() const { return get("ui.open", "Open"); }
-    std::string fileStr() const { return get("ui.file", "File"); }
-    std::string edit() const { return get("ui.edit", "Edit"); }
-    std::string view() const { return get("ui.view", "View"); }
-    std::string help() const { return get("ui.help", "Help"); }
-    std::string error() const { return get("ui.error", "Error"); }
-    std::string warning() const { return get("ui.warning", "Warning"); }
-    std::string info() const { return get("ui.info", "Information"); }
+    const char* ok() const { return text(OPACITY_STRING_ID("ui.ok"), "OK"); }
+    const char* cancel() const { return text(OPACITY_STRING_ID("ui.cancel"), "Cancel"); }
+    const char* yes() const { return text(OPACITY_STRING_ID("ui.yes"), "Yes"); }
+    const char* no() const { return text(OPACITY_STRING_ID("ui.no"), "No"); }
+    const char* apply() const { return text(OPACITY_STRING_ID("ui.apply"), "Apply"); }
+    const char* close() const { return text(OPACITY_STRING_ID("ui.close"), "Close"); }
+    const char* save() const { return text(OPACITY_STRING_ID("ui.save"), "Save"); }
+    const char* open() const { return text(OPACITY_STRING_ID("ui.open"), "Open"); }
+    const char* fileStr() const { return text(OPACITY_STRING_ID("ui.file"), "File"); }
+    const char* edit() const { return text(OPACITY_STRING_ID("ui.edit"), "Edit"); }
+    const char* view() const { return text(OPACITY_STRING_ID("ui.view"), "View"); }
+    const char* help() const { return text(OPACITY_STRING_ID("ui.help"), "Help"); }
+    const char* error() const { return text(OPACITY_STRING_ID("ui.error"), "Error"); }
+    const char* warning() const { return text(OPACITY_STRING_ID("ui.warning"), "Warning"); }
+    const char* info() const { return text(OPACITY_STRING_ID("ui.info"), "Information"); }
     
     // String table operations
     bool addString(const std::string& key, const std::string& value);
@@ -1,18 +1,56 @@
 #pragma once
 
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
 #include <string>
 #include <memory>
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/wincolor_sink.h>
 
+// Statements below this level are compiled out of the OPACITY_LOG_* macros
+#ifndef OPACITY_LOG_ACTIVE_LEVEL
+#define OPACITY_LOG_ACTIVE_LEVEL SPDLOG_LEVEL_TRACE
+#endif
+
 namespace opacity::core
 {
+    /**
+     * @brief Areas of the application whose verbosity can be set separately
+     */
+    enum class LogSubsystem : uint8_t
+    {
+        Core,
+        Filesystem,
+        Search,
+        Preview,
+        UI,
+        Count
+    };
+
+    /**
+     * @brief How the logger writes
+     */
+    struct LogOptions
+    {
+        bool async = true;                              // Format and write on a worker thread
+        size_t queue_size = 8192;                       // Messages held for the worker, at most
+        bool block_when_full = false;                   // Otherwise the oldest queued message is dropped
+        std::chrono::seconds flush_interval{1};         // Errors are flushed at once regardless
+    };
+
     /**
      * @brief Global logging system for Opacity
-     * 
+     *
      * Provides file-based logging with configurable verbosity levels.
      * Thread-safe logging across all subsystems.
+     *
+     * By default messages go through a bounded queue to one worker thread,
+     * so the thread logging never waits on the file. Each subsystem has its
+     * own level, and the OPACITY_LOG_* macros check it before formatting
+     * anything, so a disabled statement costs a single comparison.
      */
     class Logger
     {
@@ -23,6 +61,11 @@ namespace opacity::core
          */
         static void Initialize(const std::string& log_level = "info");
 
+        /**
+         * @brief Initialize the logging system with the given write mode
+         */
+        static void Initialize(const std::string& log_level, const LogOptions& options);
+
         /**
          * @brief Get the logger instance
          * @return Shared pointer to the spdlog logger
@@ -31,6 +74,8 @@ namespace opacity::core
 
         /**
          * @brief Shutdown logging system
+         *
+         * Writes out whatever is still queued before stopping the worker.
          */
         static void Shutdown();
 
@@ -40,8 +85,51 @@ namespace opacity::core
          */
         static void SetLevel(const std::string& level);
 
+        /**
+         * @brief Set one subsystem's level, overriding the global one
+         * @param level spdlog level, or empty to follow the global level again
+         */
+        static void SetSubsystemLevel(LogSubsystem subsystem, const std::string& level);
+
+        /**
+         * @brief Whether a message at level from subsystem would be written
+         */
+        static bool ShouldLog(LogSubsystem subsystem, spdlog::level::level_enum level)
+        {
+            return level >= levels_[static_cast<size_t>(subsystem)].load(std::memory_order_relaxed);
+        }
+
     private:
+        static constexpr size_t kSubsystems = static_cast<size_t>(LogSubsystem::Count);
+
+        /**
+         * @brief Recompute each subsystem's effective level
+         */
+        static void ApplyLevels();
+
         static std::shared_ptr<spdlog::logger> instance_;
+
+        // Effective level of each subsystem, read without a lock by ShouldLog
+        static std::array<std::atomic<int>, kSubsystems> levels_;
     };
 
 } // namespace opacity::core
+
+#define OPACITY_LOG(subsystem, level, ...)                                                          \
+    do                                                                                              \
+    {                                                                                               \
+        if (::opacity::core::Logger::ShouldLog(::opacity::core::LogSubsystem::subsystem, level))    \
+            ::opacity::core::Logger::Get()->log(level, __VA_ARGS__);                                \
+    } while (0)
+
+#if OPACITY_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_TRACE
+#define OPACITY_LOG_TRACE(subsystem, ...) OPACITY_LOG(subsystem, spdlog::level::trace, __VA_ARGS__)
+#else
+#define OPACITY_LOG_TRACE(subsystem, ...) (void)0
+#endif
+
+#if OPACITY_LOG_ACTIVE_LEVEL <= SPDLOG_LEVEL_DEBUG
+#define OPACITY_LOG_DEBUG(subsystem, ...) OPACITY_LOG(subsystem, spdlog::level::debug, __VA_ARGS__)
+#else
+#define OPACITY_LOG_DEBUG(subsystem, ...) (void)0
+#endif
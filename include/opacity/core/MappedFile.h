@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string_view>
+
+namespace opacity::core
+{
+    /**
+     * @brief How MappedFile::Open opens and maps a file
+     */
+    struct MappedFileOptions
+    {
+        bool share_write = false;   // Others may keep writing, as to a log being shown
+        bool map_whole = true;      // false maps nothing up front, only what Map() is asked for
+    };
+
+    /**
+     * @brief A mapped range of a file; unmapped with the last reference
+     *
+     * One mapped on its own holds its own reference to the file, so it
+     * may outlive the MappedFile it came from; one borrowed from a whole
+     * mapping may not.
+     */
+    class MappedView
+    {
+    public:
+        MappedView(void* base, size_t mapped, const uint8_t* data, size_t size, uint64_t offset);
+        ~MappedView();
+
+        // Non-copyable
+        MappedView(const MappedView&) = delete;
+        MappedView& operator=(const MappedView&) = delete;
+
+        [[nodiscard]] const uint8_t* Data() const { return data_; }
+        [[nodiscard]] size_t Size() const { return size_; }
+        [[nodiscard]] uint64_t Offset() const { return offset_; }
+
+    private:
+        void* base_;            // As mapped, rounded down to the allocation granularity
+        size_t mapped_;         // Bytes mapped from base_
+        const uint8_t* data_;
+        size_t size_;
+        uint64_t offset_;
+    };
+
+    /**
+     * @brief Read-only memory mapping of a file
+     *
+     * By default the whole file is mapped at Open() and stays valid until
+     * Close() or destruction; views returned by View() must not outlive
+     * it. Opened with map_whole off, nothing is mapped up front: Map()
+     * maps just the range asked for, so a file of many gigabytes costs
+     * address space only for what is being looked at, and an empty file
+     * opens too. Ranges may be mapped from any thread.
+     */
+    class MappedFile
+    {
+    public:
+        static constexpr size_t kWindowSize = 1024 * 1024;
+
+        MappedFile() = default;
+        ~MappedFile();
+
+        // Non-copyable, movable
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+        MappedFile(MappedFile&& other) noexcept;
+        MappedFile& operator=(MappedFile&& other) noexcept;
+
+        /**
+         * @brief Map a file for reading (closes any previous mapping)
+         */
+        bool Open(const std::filesystem::path& path, const MappedFileOptions& options = {});
+
+        /**
+         * @brief Unmap and close the file
+         */
+        void Close();
+
+        [[nodiscard]] bool IsOpen() const { return open_; }
+
+        /**
+         * @brief The whole file; null unless opened with map_whole
+         */
+        [[nodiscard]] const uint8_t* Data() const { return data_; }
+        [[nodiscard]] size_t Size() const { return static_cast<size_t>(file_size_); }
+        [[nodiscard]] uint64_t FileSize() const { return file_size_; }
+
+        /**
+         * @brief Get a bounds-checked view of part of the whole mapping
+         * @return Empty view if the range is outside the mapping
+         */
+        [[nodiscard]] std::string_view View(uint64_t offset, uint64_t length) const;
+
+        /**
+         * @brief Map [offset, offset + length), clipped to the file
+         *
+         * Borrowed from the whole mapping when there is one.
+         * @return null past the end or when mapping fails
+         */
+        [[nodiscard]] std::shared_ptr<const MappedView> Map(uint64_t offset, size_t length) const;
+
+        /**
+         * @brief A view covering [offset, offset + length), clipped to the
+         *        file; the last one is reused while it covers the range
+         *
+         * New windows span kWindowSize around the offset, so stepping
+         * through nearby rows maps once.
+         */
+        [[nodiscard]] std::shared_ptr<const MappedView> Window(uint64_t offset, size_t length) const;
+
+    private:
+        const uint8_t* data_ = nullptr;     // Whole-file view, when mapped
+        uint64_t file_size_ = 0;
+        uint32_t granularity_ = 65536;
+        bool open_ = false;
+        void* file_ = nullptr;      // HANDLE on Windows, unused elsewhere
+        void* mapping_ = nullptr;   // HANDLE on Windows; null for an empty file
+        int fd_ = -1;               // Kept for Map() outside Windows
+
+        mutable std::mutex window_mutex_;
+        mutable std::shared_ptr<const MappedView> window_;
+    };
+
+} // namespace opacity::core
@@ -0,0 +1,134 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace opacity::core
+{
+    /**
+     * @brief One registered cache, as the profiler overlay shows it
+     */
+    struct CacheUsage
+    {
+        std::string name;
+        size_t bytes = 0;               // As the cache last estimated it
+        uint64_t trims = 0;             // Times it was asked to shrink
+        size_t trimmed_bytes = 0;       // Released by those, in total
+    };
+
+    /**
+     * @brief The budget and what is charged against it
+     */
+    struct MemoryStatus
+    {
+        size_t budget_bytes = 0;
+        size_t used_bytes = 0;          // Sum over the caches
+        size_t physical_bytes = 0;      // Installed memory, 0 if unknown
+        bool low_memory = false;        // The system says memory is running low
+        uint64_t enforcements = 0;      // Passes that had to trim something
+    };
+
+    /**
+     * @brief One memory budget over every in-memory cache of the process
+     *
+     * Each cache registers a cost estimate and a trim function, and keeps
+     * the registration for as long as it lives. About once a second, and
+     * as soon as Windows signals low memory, the governor adds up the
+     * estimates. Over budget, it asks every cache to shrink by its share
+     * of the excess, so the total comes back to kTrimTarget of the budget
+     * rather than hovering at it. While memory is low it aims for half the
+     * budget or half of what is held, whichever is smaller, and keeps
+     * doing so each pass until the signal clears.
+     *
+     * Caches keep their own limits as well; the governor only ever asks
+     * for less. Estimates and trims run on the governor's thread, so both
+     * must be safe to call from any thread. Destroying a registration
+     * waits for a call into it that is under way, so never destroy one
+     * while holding a lock the callbacks take.
+     */
+    class MemoryGovernor
+    {
+    public:
+        using CostFunction = std::function<size_t()>;
+        using TrimFunction = std::function<void(size_t target_bytes)>;
+
+        static constexpr double kTrimTarget = 0.9;
+        static constexpr double kDefaultBudgetPercent = 25.0;
+
+        /**
+         * @brief Keeps a cache registered; unregisters on destruction
+         */
+        class Registration
+        {
+        public:
+            Registration() = default;
+            ~Registration();
+
+            Registration(Registration&& other) noexcept;
+            Registration& operator=(Registration&& other) noexcept;
+
+            // Disable copy
+            Registration(const Registration&) = delete;
+            Registration& operator=(const Registration&) = delete;
+
+            void Reset();
+
+        private:
+            friend class MemoryGovernor;
+            explicit Registration(uint64_t id) : id_(id) {}
+
+            uint64_t id_ = 0;
+        };
+
+        static MemoryGovernor& Get();
+
+        /**
+         * @brief Charge a cache against the budget
+         * @param cost Bytes the cache holds now, estimated cheaply
+         * @param trim Shrink to at most target_bytes, least valuable first
+         */
+        Registration Register(std::string name, CostFunction cost, TrimFunction trim);
+
+        /**
+         * @brief A fixed budget; 0 goes back to a share of installed memory
+         */
+        void SetBudget(size_t bytes);
+
+        /**
+         * @brief Budget as a percentage of installed memory
+         */
+        void SetBudgetPercent(double percent);
+
+        size_t GetBudget() const;
+
+        /**
+         * @brief Start the thread that watches the budget and the
+         *        low-memory signal
+         */
+        void Start();
+        void Stop();
+
+        /**
+         * @brief Enforce the budget now, on the calling thread
+         */
+        void Enforce();
+
+        std::vector<CacheUsage> GetUsage() const;
+        MemoryStatus GetStatus() const;
+
+    private:
+        MemoryGovernor();
+        ~MemoryGovernor();
+
+        void Unregister(uint64_t id);
+        void Run();
+
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+} // namespace opacity::core
@@ -0,0 +1,216 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace opacity::core
+{
+    /**
+     * @brief Label names and values of one series, such as {"volume", "C:\"}
+     */
+    using MetricLabels = std::vector<std::pair<std::string, std::string>>;
+
+    /**
+     * @brief A count that only goes up
+     */
+    class Counter
+    {
+    public:
+        void Add(uint64_t n = 1) { value_.fetch_add(n, std::memory_order_relaxed); }
+        uint64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<uint64_t> value_{0};
+    };
+
+    /**
+     * @brief A value that goes up and down, such as a queue length
+     */
+    class Gauge
+    {
+    public:
+        void Set(int64_t value) { value_.store(value, std::memory_order_relaxed); }
+        void Add(int64_t delta) { value_.fetch_add(delta, std::memory_order_relaxed); }
+        int64_t Get() const { return value_.load(std::memory_order_relaxed); }
+
+    private:
+        std::atomic<int64_t> value_{0};
+    };
+
+    /**
+     * @brief Count, sum, extremes and percentiles of a histogram
+     */
+    struct HistogramSummary
+    {
+        uint64_t count = 0;
+        uint64_t sum = 0;
+        uint64_t min = 0;
+        uint64_t max = 0;
+        uint64_t p50 = 0;
+        uint64_t p90 = 0;
+        uint64_t p99 = 0;
+    };
+
+    /**
+     * @brief Distribution of non-negative integers, such as microseconds
+     *
+     * HDR-style log-linear buckets: values below kSubBuckets have a bucket
+     * each, and every power of two above that is split into kSubBuckets,
+     * so any value lands in a bucket within 1/kSubBuckets of it across the
+     * whole 64-bit range. Percentiles are read back to that precision.
+     * Recording takes a few relaxed atomic operations; no lock, no
+     * allocation.
+     */
+    class Histogram
+    {
+    public:
+        static constexpr unsigned kSubBits = 4;
+        static constexpr size_t kSubBuckets = size_t{1} << kSubBits;
+        static constexpr size_t kBucketCount = (65 - kSubBits) * kSubBuckets;
+
+        void Record(uint64_t value);
+        HistogramSummary Summarize() const;
+
+        static size_t BucketOf(uint64_t value);
+        static uint64_t BucketLow(size_t bucket);
+        static uint64_t BucketHigh(size_t bucket);
+
+    private:
+        std::array<std::atomic<uint64_t>, kBucketCount> buckets_{};
+        std::atomic<uint64_t> count_{0};
+        std::atomic<uint64_t> sum_{0};
+        std::atomic<uint64_t> min_{UINT64_MAX};
+        std::atomic<uint64_t> max_{0};
+    };
+
+    /**
+     * @brief Records the microseconds between construction and destruction
+     */
+    class ScopedTimer
+    {
+    public:
+        explicit ScopedTimer(Histogram& histogram)
+            : histogram_(histogram)
+            , start_(std::chrono::steady_clock::now())
+        {
+        }
+
+        ~ScopedTimer()
+        {
+            auto elapsed = std::chrono::steady_clock::now() - start_;
+            histogram_.Record(static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count()));
+        }
+
+        // Disable copy
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& histogram_;
+        std::chrono::steady_clock::time_point start_;
+    };
+
+    enum class MetricType
+    {
+        Counter,
+        Gauge,
+        Histogram
+    };
+
+    enum class MetricsFormat
+    {
+        Ndjson,         // One object per series, appended at every export
+        Prometheus      // Text exposition format, replaced at every export
+    };
+
+    /**
+     * @brief One series as it stood when read
+     */
+    struct MetricSample
+    {
+        std::string name;
+        MetricLabels labels;
+        MetricType type = MetricType::Counter;
+        uint64_t counter = 0;
+        int64_t gauge = 0;
+        HistogramSummary histogram;
+    };
+
+    /**
+     * @brief Counters, gauges and histograms of every engine in the process
+     *
+     * A series is a name and a set of labels, registered on first use and
+     * kept for the life of the process, so the reference returned can be
+     * held: code on a hot path looks it up once (a function-local static
+     * for fixed labels) and then only touches atomics. Looking up takes a
+     * lock; updating never does.
+     *
+     * Names follow Prometheus rules (opacity_..._total for counters, the
+     * unit as a suffix). The profiler overlay shows every series; with
+     * metrics.export_path set, MainWindow also writes them out every
+     * metrics.export_interval_s seconds, so runs of different releases
+     * (the constant labels carry the release) can be compared.
+     */
+    class Metrics
+    {
+    public:
+        static constexpr std::chrono::seconds kDefaultExportInterval{60};
+
+        static Metrics& Get();
+        ~Metrics();
+
+        // Disable copy
+        Metrics(const Metrics&) = delete;
+        Metrics& operator=(const Metrics&) = delete;
+
+        Counter& GetCounter(std::string_view name, const MetricLabels& labels = {});
+        Gauge& GetGauge(std::string_view name, const MetricLabels& labels = {});
+        Histogram& GetHistogram(std::string_view name, const MetricLabels& labels = {});
+
+        /**
+         * @brief Labels added to every exported series, such as the release
+         */
+        void SetConstantLabels(MetricLabels labels);
+
+        /**
+         * @brief Every series, by name and then labels
+         */
+        std::vector<MetricSample> Snapshot() const;
+
+        std::string ToPrometheus() const;
+
+        /**
+         * @brief One line per series, each stamped with the time
+         */
+        std::string ToNdjson() const;
+
+        /**
+         * @brief Write every series to a file now: NDJSON is appended,
+         *        Prometheus text replaces the file
+         */
+        bool Export(const std::filesystem::path& file, MetricsFormat format) const;
+
+        /**
+         * @brief Export on a background thread every interval, and once more on stop
+         */
+        void StartExport(std::filesystem::path file, std::chrono::seconds interval, MetricsFormat format);
+        void StopExport();
+
+    private:
+        Metrics();
+
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+} // namespace opacity::core
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <atomic>
+#include <utility>
+
+namespace opacity::core
+{
+    /**
+     * @brief Unbounded multi-producer, single-consumer queue (Vyukov)
+     *
+     * Producers link a node with one atomic exchange and never wait on each
+     * other or on the consumer. A push still being linked is invisible to
+     * Pop() until it completes, which only delays it to the next drain.
+     */
+    template <typename T>
+    class MpscQueue
+    {
+    public:
+        MpscQueue()
+            : head_(new Node())
+            , tail_(head_.load(std::memory_order_relaxed))
+        {
+        }
+
+        ~MpscQueue()
+        {
+            T discarded;
+            while (Pop(discarded))
+            {
+            }
+            delete tail_;
+        }
+
+        MpscQueue(const MpscQueue&) = delete;
+        MpscQueue& operator=(const MpscQueue&) = delete;
+
+        void Push(T value)
+        {
+            Node* node = new Node();
+            node->value = std::move(value);
+            Node* previous = head_.exchange(node, std::memory_order_acq_rel);
+            previous->next.store(node, std::memory_order_release);
+        }
+
+        // Consumer thread only
+        bool Pop(T& value)
+        {
+            Node* next = tail_->next.load(std::memory_order_acquire);
+            if (!next)
+                return false;
+
+            value = std::move(next->value);
+            delete tail_;
+            tail_ = next;    // The popped node becomes the new stub
+            return true;
+        }
+
+    private:
+        struct Node
+        {
+            std::atomic<Node*> next{nullptr};
+            T value;
+        };
+
+        std::atomic<Node*> head_;
+        Node* tail_;
+    };
+
+} // namespace opacity::core
@@ -3,26 +3,50 @@
 #include <filesystem>
 #include <memory>
 #include <string>
+#include <string_view>
+#include <type_traits>
 
 namespace opacity::core
 {
+    class PathView;
+
     /**
      * @brief Path abstraction wrapper for Windows filesystem operations
-     * 
+     *
      * Provides unified interface for path operations, combining
      * std::filesystem::path with Win32 API where needed.
+     *
+     * The path is held in its native form, wide on Windows, which Get()
+     * and WString() return without a copy. String() converts once, the
+     * first time it is asked for, and keeps the result; the cache is
+     * filled safely when several threads read the same Path.
      */
     class Path
     {
     public:
+        using NativeString = std::filesystem::path::string_type;
+        using NativeView = std::basic_string_view<std::filesystem::path::value_type>;
+
         explicit Path(const std::filesystem::path& path = std::filesystem::path());
+        explicit Path(std::filesystem::path&& path);
         explicit Path(const std::string& path_str);
         explicit Path(const wchar_t* path_cstr);
+        explicit Path(PathView view);
+
+        Path(const Path& other);
+        Path(Path&& other) noexcept;
+        Path& operator=(const Path& other);
+        Path& operator=(Path&& other) noexcept;
 
         // Core path operations
-        [[nodiscard]] std::filesystem::path Get() const { return path_; }
-        [[nodiscard]] std::string String() const { return path_.string(); }
-        [[nodiscard]] std::wstring WString() const { return path_.wstring(); }
+        [[nodiscard]] const std::filesystem::path& Get() const { return path_; }
+        [[nodiscard]] const std::string& String() const;
+        [[nodiscard]] const std::wstring& WString() const;
+        [[nodiscard]] std::string_view StringView() const { return String(); }
+        [[nodiscard]] std::wstring_view WStringView() const { return WString(); }
+        [[nodiscard]] const NativeString& Native() const { return path_.native(); }
+        [[nodiscard]] PathView View() const;
+        [[nodiscard]] bool Empty() const { return path_.empty(); }
 
         // Path components
         [[nodiscard]] Path Parent() const;
@@ -52,7 +76,61 @@ namespace opacity::core
         [[nodiscard]] Path GetJunctionTarget() const;
 
     private:
+        // The form that is not native: narrow on Windows, wide elsewhere
+        using ConvertedString = std::conditional_t<std::is_same_v<NativeString, std::wstring>,
+                                                   std::string, std::wstring>;
+
+        const ConvertedString& Converted() const;
+
         std::filesystem::path path_;
+        mutable std::shared_ptr<const ConvertedString> converted_;
+    };
+
+    /**
+     * @brief A path that is not owned, for loops over many of them
+     *
+     * Reads the components straight out of the native text, following
+     * std::filesystem's rules for filename and extension, without
+     * building a std::filesystem::path or allocating. Only valid while
+     * the text it views is.
+     */
+    class PathView
+    {
+    public:
+        using NativeView = Path::NativeView;
+
+        PathView() = default;
+        PathView(const Path& path) : text_(path.Native()) {}
+        explicit PathView(NativeView text) : text_(text) {}
+
+        [[nodiscard]] NativeView Native() const { return text_; }
+        [[nodiscard]] bool Empty() const { return text_.empty(); }
+
+        /**
+         * @brief Everything after the last separator, or after a drive
+         */
+        [[nodiscard]] NativeView Filename() const;
+
+        /**
+         * @brief From the last dot of the filename on; empty for ".", ".."
+         *        and names whose only dot leads
+         */
+        [[nodiscard]] NativeView Extension() const;
+
+        [[nodiscard]] NativeView Stem() const;
+
+        [[nodiscard]] Path ToPath() const { return Path(*this); }
+
+        bool operator==(PathView other) const { return text_ == other.text_; }
+        bool operator!=(PathView other) const { return text_ != other.text_; }
+
+    private:
+        NativeView text_;
     };
 
+    inline PathView Path::View() const
+    {
+        return PathView(*this);
+    }
+
 } // namespace opacity::core
@@ -1,5 +1,8 @@
 #pragma once
 
+#include "opacity/core/PreviewPluginAbi.h"
+
+#include <atomic>
 #include <filesystem>
 #include <functional>
 #include <memory>
@@ -151,6 +154,9 @@ namespace opacity::core
 
     /**
      * @brief Interface for preview handler plugins
+     *
+     * Superseded by the C interface in PreviewPluginAbi.h, which writes
+     * into a host buffer and can be cancelled; still loaded as before.
      */
     class IPreviewPlugin : public virtual IPlugin
     {
@@ -178,6 +184,44 @@ namespace opacity::core
         virtual std::string GetPreviewMimeType() const = 0;
     };
 
+    /**
+     * @brief Outcome of PreviewSource::Render
+     */
+    struct PluginPreview
+    {
+        OpacityPreviewStatus status = OPACITY_PREVIEW_FAILED;
+        OpacityPreviewFormat format = OPACITY_PREVIEW_FORMAT_NONE;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t stride = 0;
+        size_t size = 0;                    // Bytes of the buffer used
+        std::string mimeType;               // What an IPreviewPlugin said it returned
+    };
+
+    /**
+     * @brief A loaded preview plugin, called the same way whichever
+     *        interface it implements
+     *
+     * Render runs on the calling thread, typically a preview worker.
+     * IPreviewPlugin implementations are called one at a time.
+     */
+    class PreviewSource
+    {
+    public:
+        virtual ~PreviewSource() = default;
+
+        virtual bool CanPreview(const std::filesystem::path& path) const = 0;
+
+        /**
+         * @brief Render into buffer, which is grown if the plugin needs more
+         * @param cancel Checked by the plugin as it runs; may be null
+         * @param progress Told how far along it is; may be empty
+         */
+        virtual PluginPreview Render(const std::filesystem::path& path, int maxWidth, int maxHeight,
+                                     std::vector<uint8_t>& buffer, const std::atomic<bool>* cancel,
+                                     const std::function<void(float)>& progress) = 0;
+    };
+
     /**
      * @brief Interface for context menu plugins
      */
@@ -257,6 +301,13 @@ namespace opacity::core
      * - Plugin discovery and enumeration
      * - Plugin settings persistence
      * - Security validation
+     *
+     * Discovery inspects the plugin DLLs on several threads and keeps what
+     * it learns in a cache beside them, so a plugin whose file has not
+     * changed is neither loaded nor signature-checked again to read its
+     * info. Plugins that only preview files are not loaded at startup;
+     * FindPreviewPlugin loads one the first time a file with one of its
+     * extensions is asked about.
      */
     class PluginManager
     {
@@ -285,6 +336,9 @@ namespace opacity::core
 
         /**
          * @brief Scan plugin directory for available plugins
+         *
+         * Unchanged DLLs are answered from the discovery cache; the rest
+         * are inspected in parallel and the cache updated.
          */
         std::vector<PluginInfo> DiscoverPlugins();
 
@@ -327,6 +381,9 @@ namespace opacity::core
 
         /**
          * @brief Load all enabled plugins
+         *
+         * Preview-only plugins that list their extensions are deferred
+         * until FindPreviewPlugin needs them.
          */
         void LoadEnabledPlugins();
 
@@ -386,9 +443,20 @@ namespace opacity::core
 
         /**
          * @brief Find preview plugin for file extension
+         *
+         * Loads a deferred plugin registered for the extension if no
+         * loaded one can preview the file.
          */
         IPreviewPlugin* FindPreviewPlugin(const std::filesystem::path& path);
 
+        /**
+         * @brief Find a preview plugin of either interface for a file
+         *
+         * Loads deferred plugins as FindPreviewPlugin does. The source
+         * must not be used after its plugin is unloaded.
+         */
+        std::shared_ptr<PreviewSource> FindPreviewSource(const std::filesystem::path& path);
+
         // ============== Settings ==============
 
         /**
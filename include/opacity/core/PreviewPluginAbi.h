@@ -0,0 +1,94 @@
+#pragma once
+
+/**
+ * @brief C interface for preview plugins, version 2
+ *
+ * Plain C so that a plugin built with any compiler or runtime can be
+ * loaded: nothing allocated on one side is freed on the other. The host
+ * owns the output buffer and reuses it between previews; a plugin that
+ * needs more room says how much and is called again with a bigger one.
+ *
+ * A plugin exports OPACITY_PREVIEW_PLUGIN_ENTRY alongside the usual
+ * OpacityPluginCreate/Destroy/GetInfo. The table it returns must stay
+ * valid until the DLL is unloaded, and can_preview and render may be
+ * called from several host worker threads at once.
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define OPACITY_PREVIEW_ABI_VERSION 2
+#define OPACITY_PREVIEW_PLUGIN_ENTRY "OpacityGetPreviewPlugin"
+
+typedef enum OpacityPreviewStatus
+{
+    OPACITY_PREVIEW_OK = 0,
+    OPACITY_PREVIEW_BUFFER_TOO_SMALL = 1,   /* output->size holds the bytes needed */
+    OPACITY_PREVIEW_CANCELLED = 2,
+    OPACITY_PREVIEW_UNSUPPORTED = 3,
+    OPACITY_PREVIEW_FAILED = 4
+} OpacityPreviewStatus;
+
+typedef enum OpacityPreviewFormat
+{
+    OPACITY_PREVIEW_FORMAT_NONE = 0,
+    OPACITY_PREVIEW_FORMAT_RGBA8 = 1,       /* width x height pixels, stride bytes per row */
+    OPACITY_PREVIEW_FORMAT_ENCODED = 2      /* An image file (PNG, JPEG, ...) for the host to decode */
+} OpacityPreviewFormat;
+
+/**
+ * @brief What the host asks for; read-only to the plugin
+ */
+typedef struct OpacityPreviewRequest
+{
+    uint32_t struct_size;                   /* sizeof(OpacityPreviewRequest), for later growth */
+    const char* path_utf8;
+    int32_t max_width;
+    int32_t max_height;
+
+    /* Poll now and then; nonzero means the preview is no longer wanted */
+    int32_t (*is_cancelled)(void* host_context);
+
+    /* Optional to call; fraction runs from 0 to 1 */
+    void (*report_progress)(void* host_context, float fraction);
+
+    void* host_context;
+} OpacityPreviewRequest;
+
+/**
+ * @brief Where the plugin writes; data and capacity come from the host
+ */
+typedef struct OpacityPreviewOutput
+{
+    uint8_t* data;
+    uint64_t capacity;
+    uint64_t size;
+    uint32_t format;                        /* OpacityPreviewFormat */
+    uint32_t width;
+    uint32_t height;
+    uint32_t stride;
+} OpacityPreviewOutput;
+
+typedef struct OpacityPreviewPluginV2
+{
+    uint32_t struct_size;                   /* sizeof(OpacityPreviewPluginV2) */
+    uint32_t abi_version;                   /* OPACITY_PREVIEW_ABI_VERSION */
+    void* instance;                         /* Passed back to every call */
+
+    int32_t (*can_preview)(void* instance, const char* path_utf8);
+    int32_t (*render)(void* instance, const OpacityPreviewRequest* request, OpacityPreviewOutput* output);
+} OpacityPreviewPluginV2;
+
+/**
+ * @brief The exported entry point
+ * @param host_abi_version OPACITY_PREVIEW_ABI_VERSION of the host
+ * @return The plugin's table, or null if it cannot serve this host
+ */
+typedef const OpacityPreviewPluginV2* (*OpacityGetPreviewPluginFunc)(uint32_t host_abi_version);
+
+#ifdef __cplusplus
+}
+#endif
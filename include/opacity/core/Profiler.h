@@ -0,0 +1,99 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "opacity/core/Path.h"
+
+namespace opacity::core
+{
+    /**
+     * @brief One timed scope on one thread
+     */
+    struct ProfileZone
+    {
+        const char* name = nullptr;     // Static string; zones keep the pointer
+        uint64_t start = 0;             // Profiler::Now() nanoseconds
+        uint64_t end = 0;
+        uint32_t depth = 0;             // Zones open around it on the same thread
+    };
+
+    struct ProfileThread
+    {
+        uint32_t id = 0;
+        std::string name;
+        std::vector<ProfileZone> zones; // Oldest first, by end time
+    };
+
+    /**
+     * @brief Scoped-zone instrumentation for finding slow frames
+     *
+     * Each thread writes the zones it closes to a ring buffer of its own,
+     * so recording takes no lock and never waits on a reader; a reader
+     * copies the rings and drops what was overwritten while it copied.
+     * Only the newest kZonesPerThread zones of each thread are kept.
+     *
+     * Off by default, when a zone costs one relaxed load. Zone names must
+     * outlive the profiler, which string literals and __func__ do.
+     */
+    class Profiler
+    {
+    public:
+        static constexpr size_t kZonesPerThread = 16 * 1024;
+
+        static void SetEnabled(bool enabled);
+        static bool IsEnabled();
+
+        /**
+         * @brief Monotonic timestamp in nanoseconds
+         */
+        static uint64_t Now();
+
+        /**
+         * @brief Name the calling thread in the overlay and in traces
+         */
+        static void SetThreadName(const std::string& name);
+
+        static void Record(const char* name, uint64_t start, uint64_t end, uint32_t depth);
+
+        /**
+         * @brief Zones of every thread that ended at or after since
+         */
+        static std::vector<ProfileThread> Collect(uint64_t since = 0);
+
+        /**
+         * @brief Write what is recorded as Chrome trace event JSON, which
+         *        chrome://tracing and Perfetto open
+         */
+        static bool ExportChromeTrace(const Path& file);
+    };
+
+    /**
+     * @brief Times the scope it lives in; use OPACITY_PROFILE_ZONE
+     */
+    class ProfileScope
+    {
+    public:
+        explicit ProfileScope(const char* name);
+        ~ProfileScope();
+
+        // Disable copy
+        ProfileScope(const ProfileScope&) = delete;
+        ProfileScope& operator=(const ProfileScope&) = delete;
+
+    private:
+        const char* name_ = nullptr;    // Null when the profiler was off at entry
+        uint64_t start_ = 0;
+        uint32_t depth_ = 0;
+    };
+
+} // namespace opacity::core
+
+#define OPACITY_PROFILE_CONCAT_INNER(a, b) a##b
+#define OPACITY_PROFILE_CONCAT(a, b) OPACITY_PROFILE_CONCAT_INNER(a, b)
+
+#define OPACITY_PROFILE_ZONE(name) \
+    ::opacity::core::ProfileScope OPACITY_PROFILE_CONCAT(profile_zone_, __LINE__)(name)
+#define OPACITY_PROFILE_FUNCTION() OPACITY_PROFILE_ZONE(__func__)
@@ -128,10 +128,15 @@ public:
     bool initialize(const std::string& configPath);
     void shutdown();
     
-    // State capture/restore callbacks
+    // State capture/restore callbacks; the collector is called on the
+    // auto-save thread, and only until the first publishState
     void setStateCollector(StateCollector collector);
     void setStateRestorer(StateRestorer restorer);
     
+    // Latest state for auto-save, handed over from the UI thread; written
+    // off it, and only if it differs from what was written last
+    void publishState(Session state);
+    
     // Current session
     std::string saveCurrentSession(const std::string& name = "", 
                                    const std::string& description = "");
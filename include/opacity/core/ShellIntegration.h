@@ -1,5 +1,8 @@
 #pragma once
 
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <filesystem>
 #include <functional>
 #include <memory>
@@ -77,6 +80,78 @@ namespace opacity::core
         static std::optional<IpcMessage> Deserialize(const std::string& data);
     };
 
+    /**
+     * @brief What a paste or drop should do with the files offered
+     */
+    enum class ShellDropEffect
+    {
+        None,
+        Copy,
+        Move,
+        Link
+    };
+
+    /**
+     * @brief A file handed to the shell by description, with no path on disk
+     */
+    struct ShellVirtualFile
+    {
+        std::wstring name;              // Relative to the drop, backslash-separated
+        uint64_t size = 0;
+        std::chrono::system_clock::time_point modified;
+        bool is_directory = false;
+    };
+
+    /**
+     * @brief Reads the contents of one virtual file as the drop target asks
+     */
+    class ShellFileReader
+    {
+    public:
+        virtual ~ShellFileReader() = default;
+
+        /**
+         * @return Bytes read; fewer than asked only at the end or on failure
+         */
+        virtual size_t Read(void* buffer, size_t length) = 0;
+        virtual bool Seek(uint64_t offset) = 0;
+    };
+
+    /**
+     * @brief Files offered on the clipboard or in a drag, resolved on demand
+     *
+     * Nothing is asked of a source until a target wants the data, which
+     * may be never; a copy or drag of any size costs only making it. A
+     * source either has paths, offered as CF_HDROP, or only virtual files
+     * (such as archive entries), offered as CFSTR_FILEDESCRIPTOR with
+     * CFSTR_FILECONTENTS streamed per file. Called on the UI thread; the
+     * readers it opens are used from whichever thread the target copies on.
+     */
+    class ShellFileSource
+    {
+    public:
+        virtual ~ShellFileSource() = default;
+
+        virtual bool HasPaths() const = 0;
+        virtual size_t Count() const = 0;
+
+        /**
+         * @brief Absolute path of a file; with HasPaths() only
+         */
+        virtual std::wstring GetPath(size_t index) const = 0;
+
+        /**
+         * @brief Description of a file; without HasPaths() only. Folders
+         *        come before what is in them.
+         */
+        virtual ShellVirtualFile Describe(size_t index) const = 0;
+
+        /**
+         * @return nullptr if the file cannot be read
+         */
+        virtual std::unique_ptr<ShellFileReader> Open(size_t index) const = 0;
+    };
+
     /**
      * @brief Shell integration configuration
      */
@@ -266,6 +341,27 @@ namespace opacity::core
          */
         static std::filesystem::path GetExecutablePath();
 
+        // ============== Clipboard and Drag-Drop ==============
+
+        /**
+         * @brief Put files on the clipboard, rendered only when pasted
+         * @param effect Copy, or Move for a cut
+         */
+        static bool SetClipboardFiles(std::shared_ptr<ShellFileSource> source, ShellDropEffect effect);
+
+        /**
+         * @brief Render what is still ours on the clipboard before exit
+         *
+         * Paths are copied out so a paste still works afterwards; virtual
+         * files cannot outlive the process and are taken off.
+         */
+        static void FlushClipboard();
+
+        /**
+         * @brief Drag files out; returns once they are dropped or the drag is cancelled
+         */
+        static ShellDropEffect DragFiles(std::shared_ptr<ShellFileSource> source);
+
         // ============== Configuration ==============
 
         /**
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string_view>
+
+namespace opacity::core
+{
+    /**
+     * @brief A file of saved state, rewritten only when the state changed
+     *
+     * Remembers a digest of the state it last wrote, so a periodic save
+     * of state that did not change costs a serialization and no disk
+     * write. Writes go to a temporary file beside it that is then renamed
+     * over it, so a crash mid-write leaves the previous version whole.
+     *
+     * Not synchronized; one thread at a time.
+     */
+    class SnapshotFile
+    {
+    public:
+        explicit SnapshotFile(std::filesystem::path path = {});
+
+        void SetPath(std::filesystem::path path);
+        const std::filesystem::path& GetPath() const { return path_; }
+
+        /**
+         * @brief Whether state is what was last written
+         */
+        [[nodiscard]] bool Unchanged(std::string_view state) const;
+
+        /**
+         * @brief Write content, made from state, and remember state
+         *
+         * state is what the digest covers: the content less anything that
+         * differs on every save, such as a timestamp. Pass the same text
+         * twice when there is nothing like that.
+         */
+        bool Write(std::string_view state, std::string_view content);
+
+        /**
+         * @brief Forget what was written, so the next write goes ahead
+         */
+        void Reset();
+
+        /**
+         * @brief Replace a file's contents through a temporary file and a rename
+         */
+        static bool WriteAtomic(const std::filesystem::path& path, std::string_view content);
+
+    private:
+        static uint64_t Digest(std::string_view state);
+
+        std::filesystem::path path_;
+        uint64_t digest_ = 0;
+        uint64_t size_ = 0;
+        bool written_ = false;
+    };
+
+} // namespace opacity::core
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "opacity/core/Profiler.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opacity::core
+{
+    /**
+     * @brief One timed step of startup
+     */
+    struct StartupPhase
+    {
+        const char* name = nullptr;     // Static string, as for profiler zones
+        uint64_t start = 0;             // Profiler::Now() nanoseconds
+        uint64_t end = 0;
+        bool critical = true;           // Before the first frame, rather than after it
+    };
+
+    /**
+     * @brief Where startup time goes, up to the first frame and after it
+     *
+     * Recorded whether or not the profiler is on, since by the time anyone
+     * opens the overlay startup is over. Phases before the window is
+     * interactive are the critical path; work deferred past the first frame
+     * is recorded too, so both can be compared with kInteractiveTarget.
+     * Thread safe; subsystems may record from their own threads.
+     */
+    class StartupProfile
+    {
+    public:
+        static constexpr uint64_t kInteractiveTarget = 200'000'000;    // Nanoseconds
+
+        /**
+         * @brief Start the clock; call first thing in main
+         */
+        static void Begin();
+
+        static void Record(const char* name, uint64_t start, uint64_t end, bool critical);
+
+        /**
+         * @brief The first frame is on screen
+         */
+        static void MarkInteractive();
+
+        /**
+         * @brief Deferred initialization is done; logs the breakdown
+         */
+        static void MarkComplete();
+
+        static uint64_t GetBegin();
+        static uint64_t GetInteractive();   // 0 until marked
+        static uint64_t GetComplete();      // 0 until marked
+        static std::vector<StartupPhase> GetPhases();
+    };
+
+    /**
+     * @brief Times a startup phase; use OPACITY_STARTUP_PHASE
+     *
+     * Also a profiler zone, for when startup is traced.
+     */
+    class StartupScope
+    {
+    public:
+        explicit StartupScope(const char* name, bool critical = true);
+        ~StartupScope();
+
+        // Disable copy
+        StartupScope(const StartupScope&) = delete;
+        StartupScope& operator=(const StartupScope&) = delete;
+
+    private:
+        ProfileScope zone_;
+        const char* name_;
+        bool critical_;
+        uint64_t start_;
+    };
+
+} // namespace opacity::core
+
+#define OPACITY_STARTUP_PHASE(...) \
+    ::opacity::core::StartupScope OPACITY_STARTUP_CONCAT(startup_phase_, __LINE__)(__VA_ARGS__)
+#define OPACITY_STARTUP_CONCAT_INNER(a, b) a##b
+#define OPACITY_STARTUP_CONCAT(a, b) OPACITY_STARTUP_CONCAT_INNER(a, b)
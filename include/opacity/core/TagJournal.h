@@ -0,0 +1,104 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2025 Opacity Project
+
+#ifndef OPACITY_CORE_TAG_JOURNAL_H
+#define OPACITY_CORE_TAG_JOURNAL_H
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace opacity { namespace core {
+
+/**
+ * @brief Write-ahead log behind the tag database
+ *
+ * Changes are appended as small checksummed records instead of the whole
+ * database being written again. A writer thread commits everything that
+ * queued up while it was busy in one write, so a burst of changes costs
+ * one flush. Once the log outgrows the snapshot, compact() starts a new
+ * generation whose snapshot is written on the writer thread; older logs
+ * are removed only once it is in place.
+ *
+ * The database is the snapshot of generation N followed by the logs of
+ * generations N, N+1, and so on. A record torn by a crash ends its log.
+ */
+class TagJournal {
+public:
+    using RecordHandler = std::function<void(uint8_t type, std::string_view payload)>;
+    using SnapshotWriter = std::function<bool(std::ostream& out, uint64_t generation)>;
+
+    TagJournal();
+    ~TagJournal();
+
+    TagJournal(const TagJournal&) = delete;
+    TagJournal& operator=(const TagJournal&) = delete;
+
+    /**
+     * @brief Replay the logs from the snapshot's generation on, then start taking appends
+     * @param snapshotBytes Size of the snapshot, which the logs are weighed against
+     */
+    bool open(const std::string& databasePath, uint64_t generation, uint64_t snapshotBytes,
+              const RecordHandler& handler);
+
+    /**
+     * @brief Write everything queued and stop the writer
+     */
+    void close();
+
+    bool isOpen() const;
+
+    void append(uint8_t type, const std::string& payload);
+
+    /**
+     * @brief Append several records so that they go out in the same write
+     */
+    void append(const std::vector<std::pair<uint8_t, std::string>>& records);
+
+    /**
+     * @brief Whether the logs since the last snapshot have outgrown it
+     */
+    bool wantsCompaction() const;
+
+    /**
+     * @brief Start a new generation, with writer producing its snapshot
+     *
+     * writer runs later on the writer thread, so anything it reads must
+     * be its own copy.
+     */
+    void compact(SnapshotWriter writer);
+
+    /**
+     * @brief Wait until everything queued so far is written
+     * @return false if a write failed since the last flush
+     */
+    bool flush();
+
+    uint64_t getGeneration() const;
+
+    /**
+     * @brief Write a snapshot beside the database and move it into place
+     */
+    static bool writeSnapshot(const std::string& databasePath, uint64_t generation,
+                              const SnapshotWriter& writer, uint64_t* bytes = nullptr);
+
+    /**
+     * @brief Delete every log of a database, for one started over
+     */
+    static void removeLogs(const std::string& databasePath);
+
+    static std::string logPath(const std::string& databasePath, uint64_t generation);
+
+private:
+    class Impl;
+    std::unique_ptr<Impl> pImpl;
+};
+
+}} // namespace opacity::core
+
+#endif // OPACITY_CORE_TAG_JOURNAL_H
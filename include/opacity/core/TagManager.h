@@ -4,8 +4,10 @@
 #ifndef OPACITY_CORE_TAG_MANAGER_H
 #define OPACITY_CORE_TAG_MANAGER_H
 
+#include "opacity/core/CompressedBitmap.h"
 #include <string>
 #include <vector>
+#include <set>
 #include <functional>
 #include <chrono>
 #include <memory>
@@ -70,6 +72,11 @@ struct TagAssignment {
     std::string filePath;
     std::chrono::system_clock::time_point assignedAt;
     std::string assignedBy;      // User or "auto"
+    
+    // Volume serial and NTFS file id when tagged, which a rename or move
+    // on the volume keeps; 0 when unknown, e.g. on network shares
+    uint64_t volumeSerial = 0;
+    uint64_t fileIndex = 0;
 };
 
 /**
@@ -111,7 +118,8 @@ enum class TagEventType {
     TagUpdated,
     TagAssigned,
     TagRemoved,
-    RuleTriggered
+    RuleTriggered,
+    FileMoved                    // filePath is the new path, details the old
 };
 
 /**
@@ -133,6 +141,9 @@ struct TagEvent {
  * - Filter files by tags
  * - Smart tagging rules for automatic categorization
  * - Persists to local database
+ *
+ * The database is a JSON snapshot plus a journal of the changes since
+ * (see TagJournal), so a change writes only itself.
  */
 class TagManager {
 public:
@@ -179,6 +190,15 @@ public:
     std::vector<std::string> getFilesMatchingFilter(const TagFilter& filter) const;
     int getFileCountForTag(const std::string& tagId) const;
     
+    // Every file ever tagged has a dense id, so per-row lookups and filters
+    // can skip hashing paths; ids hold until the index is rebuilt
+    static constexpr uint32_t kNoFile = UINT32_MAX;
+    uint32_t getFileId(const std::string& filePath) const;     // kNoFile if never tagged
+    const std::string& getFilePath(uint32_t fileId) const;
+    const std::set<std::string>& getTagIdsForFile(uint32_t fileId) const;
+    const CompressedBitmap* getFileIdsWithTag(const std::string& tagId) const;
+    CompressedBitmap getFileIdsMatchingFilter(const TagFilter& filter) const;
+    
     // Smart tagging rules
     std::string addRule(const SmartTagRule& rule);
     bool deleteRule(const std::string& ruleId);
@@ -186,6 +206,7 @@ public:
     SmartTagRule* getRule(const std::string& ruleId);
     std::vector<const SmartTagRule*> getAllRules() const;
     void applyRules(const std::string& filePath);
+    void applyRules(const std::vector<std::string>& filePaths);  // Changed files, e.g. from FileWatch; one journal write
     void applyAllRules();  // Apply to all tracked files
     
     // Suggested tags
@@ -197,12 +218,17 @@ public:
     bool exportTags(const std::string& filePath) const;
     bool importTags(const std::string& filePath, bool merge = true);
     
+    // Following files that move; paths are only a cached attribute of the
+    // file's identity, refreshed from FileWatch renames and USN changes
+    bool moveFile(const std::string& oldPath, const std::string& newPath);  // A folder takes its contents along
+    int reconcileRemoved(const std::vector<std::string>& removedPaths);     // Returns assignments dropped
+    
     // Maintenance
     bool rebuildIndex();
-    int cleanupOrphanedAssignments();  // Remove assignments for deleted files
+    int cleanupOrphanedAssignments();  // Remove assignments for deleted files; moved ones follow
     int getOrphanedCount() const;
     
-    // Persistence
+    // Persistence; save() writes a full snapshot, which changes never need
     bool save() const;
     bool load();
     
@@ -0,0 +1,241 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "opacity/core/Path.h"
+
+namespace opacity::core
+{
+    /**
+     * @brief How urgently a task should run
+     */
+    enum class TaskPriority : uint8_t
+    {
+        Interactive,    // Someone is looking at the result: previews, thumbnails in view
+        Normal,         // Asked for and watched, but long: searches, file operations
+        Background,     // Nobody waits on it: indexing, hashing, prefetching
+        Count
+    };
+
+    /**
+     * @brief Read side of a cancellation flag; cheap to copy
+     *
+     * A default-constructed token is never cancelled.
+     */
+    class CancellationToken
+    {
+    public:
+        CancellationToken() = default;
+
+        /**
+         * @brief A token reading a flag the caller owns and keeps alive
+         *        for as long as any task holding the token may run
+         */
+        static CancellationToken Watch(const std::atomic<bool>& flag);
+
+        bool IsCancelled() const { return flag_ && flag_->load(std::memory_order_relaxed); }
+
+    private:
+        friend class CancellationSource;
+
+        explicit CancellationToken(std::shared_ptr<const std::atomic<bool>> flag) : flag_(std::move(flag)) {}
+
+        std::shared_ptr<const std::atomic<bool>> flag_;
+    };
+
+    /**
+     * @brief Owns a cancellation flag and hands out tokens for it
+     */
+    class CancellationSource
+    {
+    public:
+        CancellationSource() : flag_(std::make_shared<std::atomic<bool>>(false)) {}
+
+        void Cancel() { flag_->store(true, std::memory_order_relaxed); }
+        bool IsCancelled() const { return flag_->load(std::memory_order_relaxed); }
+        CancellationToken Token() const { return CancellationToken(flag_); }
+
+    private:
+        std::shared_ptr<std::atomic<bool>> flag_;
+    };
+
+    struct TaskOptions
+    {
+        TaskPriority priority = TaskPriority::Normal;
+        CancellationToken cancel;       // A task cancelled before it starts is skipped
+        std::string io_device;          // Tasks on one device share its I/O limit; empty for none
+    };
+
+    /**
+     * @brief Waits on one submitted task
+     */
+    class TaskHandle
+    {
+    public:
+        TaskHandle() = default;
+
+        bool IsValid() const { return state_ != nullptr; }
+
+        /**
+         * @brief Whether the task has finished, or been skipped
+         */
+        bool IsDone() const;
+
+        /**
+         * @brief Whether the task was cancelled before it started
+         */
+        bool WasSkipped() const;
+
+        /**
+         * @brief Block until the task is done
+         *
+         * On a scheduler worker this runs other tasks meanwhile, so a task
+         * may wait on the ones it submitted without tying up the pool.
+         */
+        void Wait() const;
+
+    private:
+        friend class TaskScheduler;
+        struct State;
+
+        explicit TaskHandle(std::shared_ptr<State> state) : state_(std::move(state)) {}
+
+        std::shared_ptr<State> state_;
+    };
+
+    /**
+     * @brief Shared worker pool for background work
+     *
+     * Each worker has a deque per priority that it pushes to and pops
+     * from at the back; idle workers steal from the front of the others',
+     * and tasks submitted from outside the pool go to a shared queue.
+     * A worker always takes the most urgent task it can find.
+     *
+     * Tasks are not preempted, so priorities alone would let a batch of
+     * long background jobs fill every worker. Normal and Background tasks
+     * together may hold all workers but one, and Background tasks at most
+     * half of them, which leaves room for interactive work at all times.
+     *
+     * Tasks that name an I/O device run at most SetIoLimit of them on it
+     * at once; the rest wait, most urgent first, without holding a worker.
+     */
+    class TaskScheduler
+    {
+    public:
+        using Task = std::function<void(const CancellationToken& cancel)>;
+
+        // Concurrent tasks per device unless SetIoLimit says otherwise
+        static constexpr size_t kDefaultIoLimit = 2;
+
+        /**
+         * @brief The pool shared by every subsystem, started on first use
+         */
+        static TaskScheduler& Get();
+
+        /**
+         * @param workers Thread count; 0 sizes the pool from the hardware
+         */
+        explicit TaskScheduler(size_t workers = 0);
+
+        /**
+         * @brief Runs what is still queued, then stops the workers
+         */
+        ~TaskScheduler();
+
+        TaskScheduler(const TaskScheduler&) = delete;
+        TaskScheduler& operator=(const TaskScheduler&) = delete;
+
+        TaskHandle Submit(Task task, TaskOptions options = {});
+
+        /**
+         * @brief Set how many tasks may use a device at once
+         */
+        void SetIoLimit(const std::string& device, size_t concurrent);
+
+        size_t WorkerCount() const;
+
+        /**
+         * @brief The device name to throttle a path's I/O under: its drive
+         *        or share, which is the closest the pool can tell
+         */
+        static std::string IoDevice(const Path& path);
+
+    private:
+        friend class TaskHandle;
+        friend class BlockingScope;
+        friend class TaskGroup;
+
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    /**
+     * @brief Pool tasks helping with a loop the caller runs itself
+     *
+     * For fan-out inside a task: the caller works through a shared queue,
+     * and Spawn() adds tasks that join in while there is work. Close()
+     * waits only for the helpers that have started; one that starts
+     * later returns at once. Since the caller never waits on a helper
+     * that has not started, a busy pool means less help rather than a
+     * stall, and a task can fan out without needing the slots it holds.
+     */
+    class TaskGroup
+    {
+    public:
+        TaskGroup();
+
+        /**
+         * @brief Close()s the group
+         */
+        ~TaskGroup();
+
+        TaskGroup(const TaskGroup&) = delete;
+        TaskGroup& operator=(const TaskGroup&) = delete;
+
+        /**
+         * @brief Submit count helpers that each run work once
+         *
+         * work is only called before Close() returns, so it may refer to
+         * the caller's locals. options.cancel is replaced by the group's.
+         */
+        void Spawn(size_t count, std::function<void()> work, TaskOptions options = {});
+
+        /**
+         * @brief Keep helpers from starting and wait for those running
+         */
+        void Close();
+
+    private:
+        struct State;
+        std::shared_ptr<State> state_;
+    };
+
+    /**
+     * @brief While alive, the calling task waits on something outside the
+     *        pool, such as a paused operation on being resumed
+     *
+     * The task stops counting toward the limits of its priority, and the
+     * limits shrink by its worker, so other tasks of its class can run
+     * meanwhile without eating into the room kept for interactive work.
+     * Does nothing off a pool worker or in an interactive task.
+     */
+    class BlockingScope
+    {
+    public:
+        BlockingScope();
+        ~BlockingScope();
+
+        BlockingScope(const BlockingScope&) = delete;
+        BlockingScope& operator=(const BlockingScope&) = delete;
+
+    private:
+        TaskScheduler::Impl* pool_ = nullptr;
+        size_t priority_ = 0;
+    };
+
+} // namespace opacity::core
@@ -61,6 +61,14 @@ struct UpdateInfo {
     bool isCritical = false;        // Critical security update
     std::vector<std::string> changes;
     std::string minimumOSVersion;
+    
+    // Binary delta (MSDelta) from the installer of deltaBase to this one,
+    // downloaded instead of the installer when that one is kept locally
+    std::string deltaUrl;
+    std::string deltaFileName;
+    uint64_t deltaSize = 0;
+    std::string deltaSha256;
+    Version deltaBase;
 };
 
 /**
@@ -119,8 +127,13 @@ struct UpdateEvent {
  * 
  * Features:
  * - Check for updates from GitHub Releases
- * - Download updates in background
- * - Verify download integrity (SHA-256)
+ * - Download updates in background, resuming interrupted downloads with
+ *   HTTP range requests (across restarts too) and retrying dropped links
+ * - Delta updates: when a release carries a patch from the installer of
+ *   the running version, which is kept after it installs, only the patch
+ *   is downloaded and the new installer is rebuilt in a staging directory
+ * - Verify download integrity (SHA-256); a rebuilt installer must match
+ *   the release's hash or the full installer is downloaded instead
  * - Support for update channels (stable/beta/nightly)
  * - Auto-update scheduling
  * - Rollback capability
@@ -43,6 +43,15 @@ namespace opacity::diff
         std::vector<DiffLine> lines;    // Lines in this hunk
     };
 
+    /**
+     * @brief How lines are matched up
+     */
+    enum class DiffAlgorithm
+    {
+        Myers,      // Shortest edit script
+        Patience    // Anchored on lines unique to both sides; reads better on source code
+    };
+
     /**
      * @brief Options for diff computation
      */
@@ -54,6 +63,7 @@ namespace opacity::diff
         bool ignore_case = false;               // Case-insensitive comparison
         bool ignore_blank_lines = false;        // Ignore blank lines
         int context_lines = 3;                  // Lines of context around changes
+        DiffAlgorithm algorithm = DiffAlgorithm::Myers;
     };
 
     /**
@@ -80,6 +90,26 @@ namespace opacity::diff
         bool AreIdentical() const { return success && total_changes == 0; }
     };
 
+    /**
+     * @brief A run of differing bytes in a binary comparison
+     */
+    struct BinaryDiffRange
+    {
+        uint64_t offset = 0;
+        uint64_t length = 0;
+    };
+
+    /**
+     * @brief Options for binary comparison
+     */
+    struct BinaryCompareOptions
+    {
+        bool equality_only = false;     // Stop at the first difference; files of different sizes are not read
+        size_t max_ranges = 1024;       // Ranges kept; past this ranges_truncated is set
+        size_t merge_gap = 16;          // Ranges fewer than this many equal bytes apart are merged
+        unsigned threads = 0;           // Worker threads; 0 for one per hardware thread
+    };
+
     /**
      * @brief Binary comparison result
      */
@@ -91,7 +121,12 @@ namespace opacity::diff
         
         uint64_t left_size = 0;
         uint64_t right_size = 0;
-        size_t first_difference_offset = 0;
+        uint64_t first_difference_offset = 0;
+
+        // Differing ranges in offset order; bytes past the end of the shorter
+        // file count as one. Empty with equality_only.
+        std::vector<BinaryDiffRange> ranges;
+        bool ranges_truncated = false;
         
         bool success = false;
         std::string error_message;
@@ -101,7 +136,7 @@ namespace opacity::diff
      * @brief File comparison engine for Phase 2
      * 
      * Features:
-     * - Line-by-line text diff (Myers algorithm)
+     * - Line-by-line text diff (Myers O(ND) in linear space, or patience)
      * - Binary file comparison
      * - Diff options (ignore whitespace, case, etc.)
      * - Unified and side-by-side output
@@ -134,10 +169,14 @@ namespace opacity::diff
 
         /**
          * @brief Binary comparison of two files
+         *
+         * Both files are mapped and compared in 16MB blocks spread across
+         * worker threads, so large images compare at memory or disk speed.
          */
         BinaryDiffResult CompareBinaryFiles(
             const core::Path& left_path,
-            const core::Path& right_path);
+            const core::Path& right_path,
+            const BinaryCompareOptions& options = BinaryCompareOptions());
 
         /**
          * @brief Generate unified diff format output
@@ -1,7 +1,8 @@
 #pragma once
 
+#include "opacity/core/HashCache.h"
 #include "opacity/core/Path.h"
-#include "opacity/filesystem/FsItem.h"
+#include "opacity/core/TaskScheduler.h"
 
 #include <atomic>
 #include <chrono>
@@ -71,7 +72,9 @@ namespace opacity::diff
         std::chrono::system_clock::time_point right_modified;
         bool right_is_directory = false;
         std::string right_hash;
-        
+
+        bool placeholder = false;           // Online-only; compared by size and date instead of content
+
         std::string error_message;
 
         /**
@@ -95,6 +98,7 @@ namespace opacity::diff
         size_t left_only_dirs = 0;
         size_t right_only_dirs = 0;
         size_t errors = 0;
+        size_t placeholders_skipped = 0;    // Files compared by metadata to avoid a download
         
         uint64_t left_total_size = 0;
         uint64_t right_total_size = 0;
@@ -113,6 +117,7 @@ namespace opacity::diff
         bool include_hidden = false;
         bool ignore_case = true;                // Case-insensitive name matching
         bool compare_timestamps = false;        // Also check modification times
+        bool read_placeholders = false;         // Hash/Content modes read online-only files (downloads them)
         std::vector<std::string> exclude_patterns;  // Patterns to exclude
         std::vector<std::string> include_patterns;  // Patterns to include (empty = all)
         size_t max_depth = 0;                   // 0 = unlimited
@@ -164,6 +169,18 @@ namespace opacity::diff
         bool AreIdentical() const;
     };
 
+    /**
+     * @brief How a sync moves data
+     */
+    struct SyncOptions
+    {
+        // Files present on both sides are rewritten in place, block by
+        // block, where they differ instead of copied whole. A copy operation
+        // does it, run by the sync itself rather than an OperationQueue
+        bool delta = false;
+        uint64_t delta_threshold = 16ull * 1024 * 1024;    // Smaller files are always copied whole
+    };
+
     /**
      * @brief Sync operation result
      */
@@ -172,6 +189,7 @@ namespace opacity::diff
         size_t files_copied = 0;
         size_t files_deleted = 0;
         size_t files_updated = 0;
+        uint64_t bytes_unchanged = 0;   // Left as they were by delta updates
         size_t errors = 0;
         std::vector<std::string> error_messages;
         bool success = false;
@@ -242,17 +260,31 @@ namespace opacity::diff
          */
         FolderComparisonResult GetCurrentResult() const;
 
+        /**
+         * @brief Remember hashes across runs; null to hash every file
+         *
+         * Hash mode then reads only files changed since they were last hashed.
+         * Set while no comparison is running.
+         */
+        void SetHashCache(std::shared_ptr<core::HashCache> cache) { hash_cache_ = std::move(cache); }
+
         /**
          * @brief Sync folders based on comparison results
          * @param result Previous comparison result
          * @param direction Sync direction
          * @param selected_items Optional list of items to sync (nullptr = all)
+         * @param options Delta updates of large files
+         * @param progress_callback Optional progress, per item and within large files
          * @return Sync operation result
+         *
+         * Cancel() stops the sync between items or inside a delta update.
          */
         SyncResult SyncFolders(
             const FolderComparisonResult& result,
             SyncDirection direction,
-            const std::vector<size_t>* selected_items = nullptr);
+            const std::vector<size_t>* selected_items = nullptr,
+            const SyncOptions& options = SyncOptions{},
+            ComparisonProgressCallback progress_callback = nullptr);
 
         /**
          * @brief Export comparison results to various formats
@@ -263,12 +295,9 @@ namespace opacity::diff
 
     private:
         /**
-         * @brief Build file list for a folder
+         * @brief State of one Compare's walk over both trees
          */
-        std::vector<std::pair<std::string, filesystem::FsItem>> EnumerateFolder(
-            const core::Path& root,
-            const FolderComparisonOptions& options,
-            size_t current_depth = 0);
+        struct Walk;
 
         /**
          * @brief Compare two files based on mode
@@ -279,8 +308,30 @@ namespace opacity::diff
             ComparisonMode mode,
             ComparisonItem& item);
 
+        /**
+         * @brief Compare two files of the same size byte for byte
+         */
+        ComparisonStatus CompareContent(
+            const core::Path& left_path,
+            const core::Path& right_path,
+            ComparisonItem& item) const;
+
+        /**
+         * @brief Read the same-size pairs Compare deferred, many files at a
+         *        time on worker threads, and count them into the stats
+         */
+        void CompareContents(
+            FolderComparisonResult& result,
+            const std::vector<size_t>& deferred,
+            size_t processed,
+            size_t total,
+            const ComparisonProgressCallback& progress_callback);
+
+        static void CountFile(const ComparisonItem& item, ComparisonStats& stats);
+
         /**
          * @brief Calculate file hash for comparison
+         * @return Empty when the file cannot be read
          */
         std::string CalculateHash(const core::Path& path) const;
 
@@ -297,7 +348,8 @@ namespace opacity::diff
         std::atomic<bool> cancel_requested_{false};
         mutable std::mutex result_mutex_;
         FolderComparisonResult current_result_;
-        std::unique_ptr<std::thread> worker_thread_;
+        core::TaskHandle worker_task_;
+        std::shared_ptr<core::HashCache> hash_cache_;
     };
 
 } // namespace opacity::diff
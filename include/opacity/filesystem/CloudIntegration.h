@@ -1,5 +1,7 @@
 #pragma once
 
+#include "opacity/filesystem/ItemStore.h"
+
 #include <filesystem>
 #include <functional>
 #include <map>
@@ -100,9 +102,25 @@ namespace opacity::filesystem
 
         // Sync status
         CloudSyncStatus GetSyncStatus(const std::filesystem::path& path);
+
+        // Sync status from attributes already read by an enumeration; these
+        // make no file system calls, so an overlay column costs nothing extra
+        CloudSyncStatus GetSyncStatus(const FsItem& item);
+        std::vector<CloudSyncStatus> GetSyncStatuses(const ItemStore& listing);  // One per item index
         CloudFileInfo GetCloudFileInfo(const std::filesystem::path& path);
         std::vector<CloudFileInfo> GetPendingSyncs(CloudProvider provider = CloudProvider::Unknown);
 
+        // Hydration policy: opening an online-only placeholder makes the
+        // provider download it, so anything that reads file contents on its
+        // own accord (previews, content search, hashing) asks first and
+        // falls back to metadata. Explicitly requested reads go ahead.
+        static bool IsPlaceholder(uint32_t attributes);
+        static bool IsPlaceholder(const std::filesystem::path& path);   // Reads attributes only
+        static void SetHydrationAllowed(bool allowed);                    // Process-wide; off by default
+        static bool IsHydrationAllowed();
+        static bool ShouldSkipRead(uint32_t attributes, bool requested = false);
+        static bool ShouldSkipRead(const std::filesystem::path& path, bool requested = false);
+
         // OneDrive specific (Windows has deep integration)
         bool IsOneDriveInstalled();
         std::filesystem::path GetOneDriveFolder();
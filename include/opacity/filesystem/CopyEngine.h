@@ -0,0 +1,120 @@
+#pragma once
+
+#include "opacity/core/Path.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief Tuning for CopyEngine
+     */
+    struct CopyEngineConfig
+    {
+        uint64_t unbuffered_threshold = 32ull * 1024 * 1024;   // Files at least this big bypass the file cache
+        size_t buffer_size = 4 * 1024 * 1024;                  // Per buffer; two are in flight
+        size_t update_block_size = 1024 * 1024;                // Compared and rewritten as a unit by Update
+    };
+
+    /**
+     * @brief Checksumming and resuming for one copy
+     */
+    struct CopyOptions
+    {
+        bool hash = false;                          // XXH64 of the data as it streams through
+        uint64_t resume_offset = 0;                 // Dest already holds this many bytes from an earlier copy
+        std::string resume_state;                   // Hash state saved with resume_offset
+        uint64_t checkpoint_interval = 64ull * 1024 * 1024;
+
+        // Called each time dest is flushed up to offset; a later copy can
+        // resume from there. A failed copy keeps dest once this has run.
+        std::function<void(uint64_t offset, const std::string& hash_state)> checkpoint;
+    };
+
+    /**
+     * @brief Result of copying one file
+     */
+    struct CopyResult
+    {
+        bool success = false;
+        bool cancelled = false;         // The progress callback stopped the copy
+        uint64_t bytes_copied = 0;      // Includes a resumed prefix
+        uint64_t bytes_written = 0;     // Update only; the rest was already in place
+        std::string hash;               // Hex XXH64 when asked for
+        std::string error_message;
+    };
+
+    /**
+     * @brief Copies single files with byte-level progress
+     *
+     * Copies within one ReFS volume clone the source's clusters with
+     * FSCTL_DUPLICATE_EXTENTS_TO_FILE, so no data moves at all. Otherwise
+     * small files go through CopyFileEx, which keeps its own fast paths
+     * (server-side copies on shares). Large files are streamed with
+     * FILE_FLAG_NO_BUFFERING through two aligned buffers, so a read of the
+     * next chunk overlaps the write of the current one and a multi-GB copy
+     * runs at drive speed without pushing everything else out of the file
+     * cache. Every path keeps timestamps and attributes, and a failed or
+     * cancelled copy leaves no partial destination behind.
+     *
+     * When a hash is asked for, files of any size take the streamed path
+     * and are hashed between the read and the write, so the data is read
+     * once. A streamed copy can checkpoint its flushed offset and hash
+     * state, and continue from a checkpoint after a crash or a dropped
+     * share; a failed copy then keeps its partial destination.
+     */
+    class CopyEngine
+    {
+    public:
+        /**
+         * @brief Called with the bytes copied so far; return false to cancel
+         */
+        using ProgressCallback = std::function<bool(uint64_t copied, uint64_t total)>;
+
+        explicit CopyEngine(const CopyEngineConfig& config = CopyEngineConfig{});
+
+        /**
+         * @brief Copy a file, replacing dest if it exists
+         */
+        CopyResult Copy(const core::Path& source, const core::Path& dest,
+                        const ProgressCallback& progress = nullptr) const;
+
+        CopyResult Copy(const core::Path& source, const core::Path& dest, const CopyOptions& options,
+                        const ProgressCallback& progress = nullptr) const;
+
+        /**
+         * @brief Bring an existing dest up to date with source in place
+         *
+         * Both files are read side by side a block at a time, and only the
+         * blocks where dest differs are written, so a large file with a few
+         * small edits costs a read of each side and a handful of writes.
+         * Dest is then cut to the source's length and given its timestamps
+         * and attributes. A failed or cancelled update leaves dest partly
+         * updated but with its old modification time, so the next
+         * comparison still sees it as out of date.
+         */
+        CopyResult Update(const core::Path& source, const core::Path& dest,
+                          const ProgressCallback& progress = nullptr) const;
+
+        /**
+         * @brief Hash a file's contents the way Copy does
+         */
+        bool HashFile(const core::Path& path, std::string& hash) const;
+
+        const CopyEngineConfig& GetConfig() const { return config_; }
+
+    private:
+        CopyResult CopyBuffered(const core::Path& source, const core::Path& dest,
+                                const ProgressCallback& progress) const;
+        CopyResult CopyCloned(const core::Path& source, const core::Path& dest, uint64_t size,
+                              uint32_t cluster_size, const ProgressCallback& progress) const;
+        CopyResult CopyUnbuffered(const core::Path& source, const core::Path& dest, uint64_t size,
+                                  const CopyOptions& options, const ProgressCallback& progress) const;
+
+        CopyEngineConfig config_;
+    };
+
+} // namespace opacity::filesystem
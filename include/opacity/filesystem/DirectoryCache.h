@@ -0,0 +1,155 @@
+#pragma once
+
+#include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/filesystem/FileWatch.h"
+#include "opacity/filesystem/ItemStore.h"
+#include "opacity/core/MemoryGovernor.h"
+#include "opacity/core/Path.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief Limits for the directory listing cache
+     */
+    struct DirectoryCacheConfig
+    {
+        size_t max_directories = 32;        // Each cached directory holds one watch
+        size_t max_items = 500000;          // Across all cached listings
+        std::chrono::milliseconds unwatched_max_age{10000};  // When a watch could not be set up
+        std::chrono::milliseconds stale_max_age{300000};     // Unwatched listings FindStale still offers
+        size_t prefetch_limit = 8;          // Directories taken from one Prefetch call
+        size_t prefetch_threads = 2;
+    };
+
+    /**
+     * @brief Shared, size-bounded LRU cache of directory listings
+     *
+     * Listings are kept as ItemStores, keyed by directory and by the options
+     * that change which items are listed (sorting is left to the caller, so
+     * cached items are in no particular order). Each cached directory is
+     * watched; change events patch the cached items in place by re-reading
+     * just the names that changed, and an overflowed or removed directory
+     * is dropped. A directory that cannot be watched (some network shares)
+     * is only served by Find for unwatched_max_age; FindStale keeps offering
+     * it, marked stale, until stale_max_age so a slow share can show its
+     * last listing while a fresh one is read.
+     *
+     * Snapshots are immutable: a patch publishes a new one, so callers can
+     * keep reading a snapshot they already hold. Snapshots carry no error
+     * state; only successful listings are stored.
+     */
+    class DirectoryCache
+    {
+    public:
+        using Snapshot = std::shared_ptr<const ItemStore>;
+
+        DirectoryCache(FileSystemManager& fs_manager, const DirectoryCacheConfig& config = DirectoryCacheConfig{});
+        ~DirectoryCache();
+
+        // Disable copy
+        DirectoryCache(const DirectoryCache&) = delete;
+        DirectoryCache& operator=(const DirectoryCache&) = delete;
+
+        /**
+         * @brief Get a cached listing
+         * @return nullptr if the directory is not cached with these options
+         */
+        Snapshot Find(const core::Path& path, const EnumerationOptions& options);
+
+        /**
+         * @brief Get a cached listing, even one too old for Find
+         * @param stale Set when the listing is past unwatched_max_age and
+         *        should be read again
+         * @return nullptr if the directory is not cached with these options
+         */
+        Snapshot FindStale(const core::Path& path, const EnumerationOptions& options, bool& stale);
+
+        /**
+         * @brief Cache a successful listing
+         * @return The cached snapshot (or one holding listing when it is
+         *         too large to cache)
+         */
+        Snapshot Store(const core::Path& path, const EnumerationOptions& options, ItemStore listing);
+
+        /**
+         * @brief Read directories into the cache in the background
+         *
+         * Replaces whatever an earlier call left queued, so read-ahead follows
+         * the user around. Only the first prefetch_limit directories are
+         * taken, and ones already cached are skipped.
+         */
+        void Prefetch(const std::vector<core::Path>& directories, const EnumerationOptions& options);
+
+        /**
+         * @brief Drop every listing of a directory
+         */
+        void Invalidate(const core::Path& path);
+
+        /**
+         * @brief Drop everything
+         */
+        void Clear();
+
+        size_t GetDirectoryCount() const;
+        size_t GetItemCount() const;
+
+    private:
+        struct Variant
+        {
+            EnumerationOptions options;
+            std::string options_key;
+            Snapshot contents;
+            std::chrono::steady_clock::time_point stored;
+        };
+
+        struct Entry
+        {
+            core::Path path;
+            WatchHandle watch = 0;
+            std::vector<Variant> variants;
+            std::list<std::string>::iterator lru;
+        };
+
+        static std::string DirectoryKey(const core::Path& path);
+        static std::string OptionsKey(const EnumerationOptions& options);
+
+        Snapshot Lookup(const core::Path& path, const EnumerationOptions& options, bool allow_stale, bool& stale);
+        void OnChanges(const std::string& key, const std::vector<FileChangeEvent>& events);
+        void PrefetchLoop();
+        void EraseLocked(std::unordered_map<std::string, Entry>::iterator it);
+        void EvictLocked();
+        void TrimLocked(size_t target_bytes);      // For the memory governor: least recently used first
+
+        FileSystemManager& fs_manager_;
+        DirectoryCacheConfig config_;
+        FileWatch watch_;
+
+        mutable std::mutex mutex_;
+        std::unordered_map<std::string, Entry> entries_;
+        std::list<std::string> lru_;        // Most recently used first
+        size_t item_count_ = 0;
+        size_t bytes_ = 0;                  // ItemStore::MemoryUsage of every cached listing
+
+        std::mutex prefetch_mutex_;
+        std::condition_variable prefetch_wake_;
+        std::deque<core::Path> prefetch_queue_;
+        EnumerationOptions prefetch_options_;
+        std::vector<std::thread> prefetch_threads_;     // Started on the first Prefetch
+        std::atomic<bool> prefetch_stop_{false};
+
+        core::MemoryGovernor::Registration memory_;
+    };
+
+} // namespace opacity::filesystem
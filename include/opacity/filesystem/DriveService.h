@@ -0,0 +1,85 @@
+#pragma once
+
+#include "opacity/filesystem/FileSystemManager.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief The list of drives, kept current without waiting on any of them
+     *
+     * Asking a volume for its name and free space can take seconds when it
+     * is a disconnected network drive or a disk spinning up, so GetDrives()
+     * only ever returns what is cached. Each drive is queried by a task of
+     * its own, one at a time per drive, so a slow one holds up nobody else;
+     * until its first answer it is listed as not ready.
+     *
+     * Drives are listed again when the system broadcasts a volume arriving
+     * or going (WM_DEVICECHANGE, which covers mapped network drives and
+     * media inserted into a card reader), and every refresh interval, when
+     * free space is asked for again as well.
+     */
+    class DriveService
+    {
+    public:
+        using ChangeCallback = std::function<void()>;
+
+        static constexpr std::chrono::seconds kRefreshInterval{30};
+
+        DriveService();
+        ~DriveService();
+
+        // Disable copy
+        DriveService(const DriveService&) = delete;
+        DriveService& operator=(const DriveService&) = delete;
+
+        /**
+         * @brief List the drives and start watching for changes
+         */
+        void Start();
+
+        /**
+         * @brief Stop watching; queries in flight finish on their own time
+         */
+        void Stop();
+
+        /**
+         * @brief The drives as last queried, by letter; never blocks
+         */
+        std::vector<DriveInfo> GetDrives() const;
+
+        /**
+         * @brief Changes whenever the list or a drive's details do
+         */
+        uint64_t GetGeneration() const;
+
+        /**
+         * @brief Called on some other thread after every change, to wake a
+         *        UI that sleeps between inputs
+         */
+        void SetChangeCallback(ChangeCallback callback);
+
+        /**
+         * @brief List and query every drive again now (after mapping one,
+         *        say) instead of at the next interval
+         */
+        void Refresh();
+
+    private:
+        struct State;
+
+        void Run();
+
+        std::shared_ptr<State> state_;      // Shared with queries, which may outlive the service
+        std::thread thread_;
+        void* stop_event_ = nullptr;
+        void* refresh_event_ = nullptr;
+    };
+
+} // namespace opacity::filesystem
@@ -5,6 +5,7 @@
 #include <memory>
 #include <functional>
 #include <optional>
+#include <mutex>
 #include "opacity/filesystem/FsItem.h"
 #include "opacity/core/Path.h"
 
@@ -19,6 +20,7 @@ namespace opacity::filesystem
         std::vector<FsItem> items;
         std::string error_message;
         bool success = false;
+        bool cancelled = false;         // The batch callback stopped the enumeration
         size_t total_files = 0;
         size_t total_directories = 0;
         uint64_t total_size = 0;
@@ -56,12 +58,22 @@ namespace opacity::filesystem
         bool is_ready = false;
     };
 
+    class DirectoryCache;
+    class DriveService;
+    class FileWatch;
+
     /**
      * @brief Manages filesystem operations
      */
     class FileSystemManager
     {
     public:
+        /**
+         * @brief Receives enumerated items; may move them out of the batch
+         * @return false to stop enumerating
+         */
+        using ItemBatchCallback = std::function<bool(std::vector<FsItem>& batch)>;
+
         FileSystemManager();
         ~FileSystemManager();
 
@@ -72,9 +84,32 @@ namespace opacity::filesystem
         // Directory operations
         DirectoryContents EnumerateDirectory(const core::Path& path, 
                                              const EnumerationOptions& options = EnumerationOptions());
+
+        /**
+         * @brief Enumerate a directory, handing items over as they are read
+         *
+         * Batches are flushed every batch_size items, or sooner when the
+         * directory is slow to read (network shares), so a caller on another
+         * thread can show partial results. Items arrive unsorted; the
+         * returned totals and error state cover everything read, and items
+         * is left empty.
+         */
+        DirectoryContents EnumerateDirectoryBatched(const core::Path& path,
+                                                    const EnumerationOptions& options,
+                                                    const ItemBatchCallback& on_batch,
+                                                    size_t batch_size = 1024);
         
-        // Get list of available drives
+        /**
+         * @brief Query every drive now; waits on each in turn, so a UI
+         *        thread should read GetDriveService() instead
+         */
         std::vector<DriveInfo> GetDrives();
+
+        /**
+         * @brief Type, volume name and free space of one drive; may block
+         *        for as long as the drive takes to answer
+         */
+        static DriveInfo QueryDrive(char drive_letter);
         
         // Get special folder paths
         std::string GetUserHomeDirectory();
@@ -101,12 +136,48 @@ namespace opacity::filesystem
         // Normalize path (resolve . and .., convert slashes)
         core::Path NormalizePath(const core::Path& path);
 
+        /**
+         * @brief Listing cache shared by every view on this manager
+         *
+         * Created (and its change watcher started) on first use.
+         */
+        DirectoryCache& GetListingCache();
+
+        /**
+         * @brief Change watcher shared by every view on this manager
+         *
+         * Created and started on first use.
+         */
+        FileWatch& GetFileWatch();
+
+        /**
+         * @brief Cached drive list shared by every view on this manager
+         *
+         * Created and started on first use.
+         */
+        DriveService& GetDriveService();
+
+        /**
+         * @brief Whether an item would be listed under these options
+         *
+         * Applies the hidden/system/kind filters and filter pattern the
+         * way enumeration does, for items learned of some other way.
+         */
+        static bool MatchesOptions(const FsItem& item, const EnumerationOptions& options);
+
     private:
         // Convert Windows FILETIME to system_clock time_point
         std::chrono::system_clock::time_point FileTimeToTimePoint(uint64_t file_time);
         
-        // Create FsItem from WIN32_FIND_DATA
-        FsItem CreateFsItemFromFindData(const std::wstring& directory_path, void* find_data);
+        // Create FsItem from WIN32_FIND_DATA (directory_prefix is UTF-8, ending in a separator)
+        FsItem CreateFsItemFromFindData(const std::string& directory_prefix, void* find_data);
+
+        std::unique_ptr<DirectoryCache> listing_cache_;
+        std::once_flag listing_cache_once_;
+        std::unique_ptr<FileWatch> file_watch_;
+        std::once_flag file_watch_once_;
+        std::unique_ptr<DriveService> drive_service_;
+        std::once_flag drive_service_once_;
     };
 
 } // namespace opacity::filesystem
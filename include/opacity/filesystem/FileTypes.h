@@ -0,0 +1,53 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "opacity/filesystem/FsItem.h"
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief Preview handlers able to show an extension, as bits
+     */
+    enum PreviewHandlerBits : uint8_t
+    {
+        PreviewNone = 0,
+        PreviewImage = 1 << 0,
+        PreviewText = 1 << 1,
+        PreviewVideo = 1 << 2,
+        PreviewAudio = 1 << 3,
+        PreviewDocument = 1 << 4,
+        PreviewMedia = PreviewVideo | PreviewAudio
+    };
+
+    /**
+     * @brief Everything known about one extension
+     */
+    struct ExtensionInfo
+    {
+        std::string_view extension;     // Lowercase, without the dot
+        FileType type;
+        const char* mime_type;          // Null when there is nothing more specific than octet-stream
+        uint8_t preview_handlers;       // PreviewHandlerBits
+    };
+
+    /**
+     * @brief Classify an extension in one lookup
+     *
+     * The table is a perfect hash built on first use, so this folds the
+     * case into a small stack buffer, hashes once and compares one entry.
+     * Nothing is allocated.
+     *
+     * @param extension Without the dot, in any case
+     * @return The entry, or null for an extension not in the table
+     */
+    const ExtensionInfo* LookupExtension(std::string_view extension);
+
+    /**
+     * @brief Extensions that any of the given handlers can show, in table order
+     */
+    std::vector<std::string> ExtensionsFor(uint8_t preview_handlers);
+
+} // namespace opacity::filesystem
@@ -4,6 +4,7 @@
 
 #include <atomic>
 #include <chrono>
+#include <cstdint>
 #include <functional>
 #include <memory>
 #include <mutex>
@@ -33,7 +34,7 @@ namespace opacity::filesystem
     {
         FileChangeType type = FileChangeType::Unknown;
         core::Path path;
-        core::Path old_path;  // For rename events
+        core::Path old_path;  // For renames within the watch; empty when only one side is known
         std::chrono::system_clock::time_point timestamp;
         
         FileChangeEvent() = default;
@@ -64,15 +65,45 @@ namespace opacity::filesystem
         bool watch_directories = true;
         bool debounce_events = true;
         std::chrono::milliseconds debounce_delay{100};
+        std::chrono::milliseconds max_batch_delay{500};         // Deliver even while events keep arriving
+        std::chrono::milliseconds min_delivery_interval{16};    // About once per frame
+        bool coalesce_events = true;                            // Fold repeated changes to a path into one event
+        size_t storm_threshold = 2000;                          // Events/sec before a batch becomes one Unknown for the directory; 0 = never
         std::vector<std::string> include_patterns;  // Empty = include all
         std::vector<std::string> exclude_patterns;
     };
 
+    /**
+     * @brief Counters over everything a FileWatch has queued
+     */
+    struct FileWatchStats
+    {
+        uint64_t received = 0;      // Events queued for debounced delivery
+        uint64_t delivered = 0;     // Events handed to callbacks
+        uint64_t merged = 0;        // Folded into another event for the same path
+        uint64_t dropped = 0;       // Replaced by a directory summary during a storm
+        uint64_t summaries = 0;     // Unknown events sent in place of a storm
+    };
+
     /**
      * @brief File system watcher using Windows ReadDirectoryChangesW API
      * 
      * Monitors directories for file system changes and notifies callbacks
      * when files are created, modified, deleted, or renamed.
+     *
+     * Every watched directory has one overlapped ReadDirectoryChangesExW
+     * read outstanding on a shared I/O completion port, so a single thread
+     * serves any number of watches and sleeps until a read completes or a
+     * debounced batch is due. When a directory's change buffer overflows,
+     * listeners get one Unknown event for that watch's path to rescan.
+     *
+     * Debounced events are coalesced per path before delivery (a file
+     * created and deleted within a batch is never reported, a create
+     * followed by writes is one Created, chained renames become one), and
+     * batches go out at most once per min_delivery_interval. A watch that
+     * sees more than storm_threshold events a second, as during a checkout
+     * or build, stops queueing them and delivers a single Unknown event for
+     * its directory instead, the same as an overflow.
      */
     class FileWatch
     {
@@ -160,21 +191,43 @@ namespace opacity::filesystem
          */
         bool IsRunning() const;
 
+        /**
+         * @brief Get coalescing and rate-limiting counters
+         */
+        FileWatchStats GetStats() const;
+
     private:
         struct WatchEntry;
         
+        WatchHandle AddWatch(std::shared_ptr<WatchEntry> entry);
+        void RetireLocked(std::shared_ptr<WatchEntry> entry);
+        bool IssueRead(WatchEntry& entry);
         void WatcherThread();
-        void ProcessChanges(WatchEntry& entry);
+        unsigned long NextDebounceWait() const;
+        void HandleCompletion(size_t key, unsigned long error, unsigned long bytes);
+        void QueueEvent(WatchEntry& entry, const FileChangeEvent& event);
+        void ProcessChanges(WatchEntry& entry, unsigned long bytes);
         bool MatchesFilters(const std::string& filename, const WatchConfig& config) const;
         bool MatchesPattern(const std::string& filename, const std::string& pattern) const;
         void DebounceAndNotify(WatchEntry& entry);
+        std::vector<FileChangeEvent> Coalesce(const core::Path& directory, std::vector<FileChangeEvent> events);
 
-        std::vector<std::unique_ptr<WatchEntry>> watches_;
+        // Shared so the watcher thread can finish with an entry that is
+        // unwatched while it waits on it
+        std::vector<std::shared_ptr<WatchEntry>> watches_;
+        std::vector<std::shared_ptr<WatchEntry>> retiring_;    // Unwatched, read still being cancelled
         mutable std::mutex mutex_;
+        void* completion_port_ = nullptr;                       // HANDLE
         std::thread watcher_thread_;
         std::atomic<bool> running_{false};
         std::atomic<bool> paused_{false};
         WatchHandle next_handle_{1};
+
+        std::atomic<uint64_t> received_{0};
+        std::atomic<uint64_t> delivered_{0};
+        std::atomic<uint64_t> merged_{0};
+        std::atomic<uint64_t> dropped_{0};
+        std::atomic<uint64_t> summaries_{0};
     };
 
 } // namespace opacity::filesystem
@@ -50,7 +50,7 @@ namespace opacity::filesystem
         std::chrono::system_clock::time_point created;
         uint32_t attributes = 0;
         std::string extension;
-        std::string mime_type;
+        std::string mime_type;      // Optional override; enumeration leaves it empty, see GetMimeType()
         FileType type = FileType::Unknown;
 
         // Windows file attribute constants
@@ -80,6 +80,9 @@ namespace opacity::filesystem
         
         // Get file type description (e.g., "Text Document", "JPEG Image", "Folder")
         std::string GetTypeDescription() const;
+
+        // Get mime type (mime_type if set, otherwise derived from the extension)
+        std::string GetMimeType() const;
     };
 
     /**
@@ -100,6 +103,8 @@ namespace opacity::filesystem
         Descending
     };
 
+    class ItemStore;
+
     /**
      * @brief Comparator for sorting FsItems
      */
@@ -112,6 +117,9 @@ namespace opacity::filesystem
 
         bool operator()(const FsItem& a, const FsItem& b) const;
 
+        // Compare two items of an ItemStore by index
+        bool operator()(const ItemStore& store, uint32_t a, uint32_t b) const;
+
         void SetColumn(SortColumn column) { column_ = column; }
         void SetDirection(SortDirection direction) { direction_ = direction; }
         void SetFoldersFirst(bool folders_first) { folders_first_ = folders_first; }
@@ -131,11 +139,22 @@ namespace opacity::filesystem
      */
     namespace FsItemUtils
     {
-        // Sort a vector of FsItems
+        // Sort a vector of FsItems. Both sorts order exactly like the
+        // comparator but compute a key per item once and radix-sort the keys;
+        // long lists are split across threads.
         void Sort(std::vector<FsItem>& items, const FsItemComparator& comparator);
+
+        // Sort a view (indices into store)
+        void Sort(const ItemStore& store, std::vector<uint32_t>& order, const FsItemComparator& comparator);
+
+        // Keep only the indices whose names match a * and ? pattern
+        void FilterByName(const ItemStore& store, std::vector<uint32_t>& order, const std::string& pattern);
         
         // Filter items by name pattern (supports * and ? wildcards)
         std::vector<FsItem> FilterByName(const std::vector<FsItem>& items, const std::string& pattern);
+
+        // Check a name against a * and ? pattern (whole name, case-insensitive)
+        bool MatchesName(const std::string& name, const std::string& pattern);
         
         // Filter items by extension
         std::vector<FsItem> FilterByExtension(const std::vector<FsItem>& items, const std::string& extension);
@@ -148,6 +167,12 @@ namespace opacity::filesystem
         
         // Get mime type from extension
         std::string GetMimeType(const std::string& extension);
+
+        // Format a byte count (e.g., "1.5 MB", "256 B")
+        std::string FormatSize(uint64_t size);
+
+        // Format a local date (e.g., "2024-01-15 14:30")
+        std::string FormatDate(std::chrono::system_clock::time_point time);
     }
 
 } // namespace opacity::filesystem
@@ -0,0 +1,123 @@
+#pragma once
+
+#include "opacity/filesystem/FsItem.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief Column-oriented listing of one directory
+     *
+     * Names live in one arena, sizes, times and attributes in parallel
+     * arrays, and extensions (with their type descriptions) are interned
+     * once per distinct extension. Views keep a vector of indices into the
+     * store, so sorting and filtering permute 4-byte indices instead of
+     * moving FsItems. An item costs about 40 bytes plus its name, against
+     * several hundred for an FsItem with its strings and path.
+     */
+    class ItemStore
+    {
+    public:
+        using Index = uint32_t;
+
+        /**
+         * @brief Start over for a directory (UTF-8, used to build full paths)
+         */
+        void Reset(const std::string& directory);
+        void Reserve(size_t count, size_t name_bytes);
+
+        Index Add(const FsItem& item);
+
+        /**
+         * @brief Copy one item of another store without going through FsItem
+         */
+        Index AddFrom(const ItemStore& other, Index index);
+
+        size_t Count() const { return sizes_.size(); }
+        bool Empty() const { return sizes_.empty(); }
+        const std::string& GetDirectory() const { return directory_; }
+
+        // Totals over everything added
+        size_t GetFileCount() const { return file_count_; }
+        size_t GetDirectoryCount() const { return directory_count_; }
+        uint64_t GetTotalSize() const { return total_size_; }
+
+        std::string_view Name(Index index) const
+        {
+            return std::string_view(names_).substr(name_offsets_[index], name_offsets_[index + 1] - name_offsets_[index]);
+        }
+
+        uint64_t FileSize(Index index) const { return sizes_[index]; }
+        uint32_t Attributes(Index index) const { return attributes_[index]; }
+        bool IsDirectory(Index index) const { return (attributes_[index] & FsItem::ATTR_DIRECTORY) != 0; }
+        bool IsHidden(Index index) const { return (attributes_[index] & FsItem::ATTR_HIDDEN) != 0; }
+
+        std::chrono::system_clock::time_point Modified(Index index) const { return ToTimePoint(modified_[index]); }
+        std::chrono::system_clock::time_point Created(Index index) const { return ToTimePoint(created_[index]); }
+        int64_t ModifiedTicks(Index index) const { return modified_[index]; }
+        int64_t CreatedTicks(Index index) const { return created_[index]; }
+
+        /**
+         * @brief Interned extension id; 0 is "no extension"
+         */
+        uint32_t ExtensionId(Index index) const { return extension_ids_[index]; }
+        const std::string& Extension(Index index) const { return extensions_[extension_ids_[index]]; }
+
+        /**
+         * @brief Type description ("Folder", "JPEG Image", ...), shared per extension
+         */
+        const std::string& TypeDescription(Index index) const;
+
+        std::string MimeType(Index index) const { return FsItemUtils::GetMimeType(Extension(index)); }
+        std::string FullPath(Index index) const;
+
+        /**
+         * @brief Rebuild a standalone FsItem
+         */
+        FsItem Materialize(Index index) const;
+
+        /**
+         * @brief Find an item by name (case-insensitive), or Count() if absent
+         */
+        Index FindByName(std::string_view name) const;
+
+        size_t MemoryUsage() const;
+
+    private:
+        using Rep = std::chrono::system_clock::duration::rep;
+
+        static std::chrono::system_clock::time_point ToTimePoint(int64_t ticks)
+        {
+            return std::chrono::system_clock::time_point(std::chrono::system_clock::duration(static_cast<Rep>(ticks)));
+        }
+
+        uint32_t InternExtension(const std::string& extension);
+        void CountItem(bool is_directory, uint64_t size);
+
+        std::string directory_;
+
+        std::string names_;
+        std::vector<uint32_t> name_offsets_{0};     // Count() + 1 entries
+        std::vector<uint64_t> sizes_;
+        std::vector<int64_t> modified_;             // system_clock ticks
+        std::vector<int64_t> created_;
+        std::vector<uint32_t> attributes_;          // FsItem::ATTR_* (directory bit always set for folders)
+        std::vector<uint32_t> extension_ids_;
+
+        std::vector<std::string> extensions_{std::string()};
+        std::vector<std::string> type_descriptions_{std::string("File")};
+        std::unordered_map<std::string, uint32_t> extension_lookup_;
+
+        size_t file_count_ = 0;
+        size_t directory_count_ = 0;
+        uint64_t total_size_ = 0;
+    };
+
+} // namespace opacity::filesystem
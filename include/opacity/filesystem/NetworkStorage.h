@@ -66,6 +66,28 @@ namespace opacity::filesystem
         bool interactive = false;       // Allow Windows auth dialog
     };
 
+    /**
+     * @brief Last known reachability of a server
+     */
+    enum class ServerReachability
+    {
+        Unknown,        // Not probed yet
+        Reachable,
+        Unreachable
+    };
+
+    /**
+     * @brief Background reachability probing
+     */
+    struct ProbeOptions
+    {
+        int connectTimeoutMs = 750;                 // A live SMB server answers within milliseconds
+        std::chrono::seconds reachableTtl{30};
+        std::chrono::seconds unreachableTtl{5};     // Doubled for each failure in a row
+        std::chrono::seconds maxBackoff{300};
+        size_t probeThreads = 8;                    // Servers probed at once
+    };
+
     /**
      * @brief FTP/SFTP connection info
      */
@@ -111,6 +133,11 @@ namespace opacity::filesystem
      * - Network operation optimization
      * - Basic FTP/SFTP support (read-only)
      * - Connection management
+     * - Server reachability probed on background threads, all servers at
+     *   once with short connect timeouts, and cached with a TTL; servers
+     *   that stay down are retried with growing backoff. Nothing that
+     *   lists drives touches a server before it is known to answer, so a
+     *   dead SMB server never stalls the caller.
      */
     class NetworkStorage
     {
@@ -211,12 +238,15 @@ namespace opacity::filesystem
         // ============== Network Operations ==============
 
         /**
-         * @brief Check if path is on network
+         * @brief Check if path is on network (a UNC path or a mapped drive)
          */
-        bool IsNetworkPath(const std::filesystem::path& path);
+        static bool IsNetworkPath(const std::filesystem::path& path);
 
         /**
          * @brief Check network path availability
+         *
+         * The path's server is checked first: from the cache when fresh,
+         * otherwise waiting at most timeoutMs for a probe.
          */
         bool IsPathAvailable(const std::filesystem::path& path, int timeoutMs = 5000);
 
@@ -227,9 +257,34 @@ namespace opacity::filesystem
 
         /**
          * @brief Check server availability
+         *
+         * Answers from the cache when fresh, otherwise waits at most
+         * timeoutMs for a probe; a server not heard from counts as down.
          */
         bool IsServerAvailable(const std::string& serverName, int timeoutMs = 5000);
 
+        /**
+         * @brief Cached reachability of a server; never blocks
+         *
+         * Queues a background probe when the entry is missing or stale.
+         */
+        ServerReachability GetServerReachability(const std::string& serverName);
+
+        /**
+         * @brief Probe servers in the background, cached or not
+         */
+        void ProbeServersAsync(const std::vector<std::string>& serverNames);
+
+        /**
+         * @brief Probe the servers of all mapped drives in the background
+         */
+        void RefreshDrivesAsync();
+
+        /**
+         * @brief Set probe timeouts and cache lifetimes
+         */
+        void SetProbeOptions(const ProbeOptions& options);
+
         /**
          * @brief Get available space on network path
          */
@@ -239,6 +294,9 @@ namespace opacity::filesystem
 
         /**
          * @brief Discover servers on the network
+         *
+         * Returns what has turned up after at most timeoutMs; browsing
+         * carries on in the background until it finishes.
          */
         std::vector<std::string> DiscoverServers(int timeoutMs = 5000);
 
@@ -312,6 +370,9 @@ namespace opacity::filesystem
 
         /**
          * @brief Set callback for drive connection changes
+         *
+         * Also called, from a probe thread, for each mapped drive whose
+         * server is found to have come up or gone down.
          */
         void OnDriveChanged(NetworkDriveCallback callback);
 
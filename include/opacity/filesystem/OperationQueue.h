@@ -1,6 +1,9 @@
 #pragma once
 
 #include "opacity/core/Path.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/filesystem/CopyEngine.h"
+#include "opacity/filesystem/StorageTopology.h"
 #include <string>
 #include <vector>
 #include <queue>
@@ -9,7 +12,16 @@
 #include <atomic>
 #include <functional>
 #include <memory>
+#include <unordered_map>
 #include <chrono>
+#include <condition_variable>
+#include <filesystem>
+
+namespace opacity::core
+{
+    class CrashRecovery;
+    struct PendingOperation;
+}
 
 namespace opacity::filesystem
 {
@@ -37,6 +49,16 @@ namespace opacity::filesystem
         Cancelled
     };
 
+    /**
+     * @brief Scheduling class of an operation
+     */
+    enum class OperationPriority
+    {
+        Auto,           // Interactive when small, background otherwise
+        Interactive,    // Started first, may exceed a device's limit by one
+        Background
+    };
+
     /**
      * @brief Conflict resolution strategy
      */
@@ -86,8 +108,9 @@ namespace opacity::filesystem
         uint64_t completed_bytes = 0;
         std::string current_item;
         double percentage = 0.0;
-        double speed_bytes_per_sec = 0.0;
+        double speed_bytes_per_sec = 0.0;           // Smoothed over a few seconds
         std::chrono::seconds estimated_remaining{0};
+        bool sizing = false;                        // Folders still being sized; total_bytes will grow
     };
 
     /**
@@ -156,6 +179,74 @@ namespace opacity::filesystem
          */
         void SetConflictResolution(ConflictResolution resolution) { default_resolution_ = resolution; }
 
+        /**
+         * @brief Set scheduling priority (set before the operation is queued)
+         */
+        void SetPriority(OperationPriority priority) { priority_ = priority; }
+        OperationPriority GetPriority() const { return priority_; }
+
+        /**
+         * @brief Hash each copied file as it streams through (XXH64, no second read)
+         */
+        void SetChecksums(bool enabled) { checksums_ = enabled; }
+        bool GetChecksums() const { return checksums_; }
+
+        /**
+         * @brief Rewrite files that already exist at the destination and are
+         *        at least this large in place, writing only changed blocks
+         *
+         * See CopyEngine::Update. An overwrite leaves such files where they
+         * are for it, and one whose update fails before writing anything is
+         * copied whole instead. 0, the default, copies every file whole;
+         * so do checksums and the journal, which need every byte streamed.
+         */
+        void SetDeltaThreshold(uint64_t bytes) { delta_threshold_ = bytes; }
+        uint64_t GetDeltaThreshold() const { return delta_threshold_; }
+
+        /**
+         * @brief Bytes that updates in place found already there and left alone
+         */
+        uint64_t GetBytesUnchanged() const { return bytes_unchanged_; }
+
+        /**
+         * @brief Hashes of the files copied so far, by destination path
+         */
+        std::vector<std::pair<std::string, std::string>> GetFileHashes() const;
+
+        /**
+         * @brief Journal a copy to recovery so it can resume after a crash or a lost share
+         *
+         * Turns checksums on. The journal holds each finished file with its
+         * hash and the flushed offset of files in flight; it is cleared when
+         * the copy completes or is cancelled and kept when it fails. Set
+         * before the operation starts.
+         */
+        void SetJournal(core::CrashRecovery* recovery);
+        core::CrashRecovery* GetJournal() const { return journal_; }
+
+        /**
+         * @brief Rebuild a copy from its journal; nullptr if the entry is not one
+         *
+         * The rebuilt copy checks finished files against their recorded
+         * hashes, continues partial files from their last checkpoint and
+         * copies everything else as before. It keeps journaling to recovery.
+         */
+        static std::unique_ptr<BatchOperation> FromJournal(const core::PendingOperation& pending,
+                                                           core::CrashRecovery* recovery);
+
+        /**
+         * @brief Whether the scheduler treats this as user-facing work
+         *
+         * Auto counts as interactive for a handful of items under 64MB.
+         */
+        bool IsInteractive() const;
+
+        /**
+         * @brief Physical devices the operation reads or writes, one entry each;
+         *        probed on the first call, which OperationQueue::AddOperation makes
+         */
+        const std::vector<VolumeProfile>& GetDevices() const;
+
         /**
          * @brief Get current progress
          */
@@ -202,10 +293,41 @@ namespace opacity::filesystem
         std::string GetDescription() const;
 
     private:
+        struct CopyTask;
+        class CopyTaskQueue;
+
+        // What the journal knows about one destination file
+        struct JournalFile
+        {
+            uint64_t size = 0;
+            bool done = false;
+            std::string hash;           // When done
+            uint64_t offset = 0;        // Flushed so far, when not done
+            std::string hash_state;
+        };
+
         void ExecuteOperation();
-        bool CopyFileInternal(const core::Path& source, const core::Path& dest);
+        bool ExecuteItems();
+        bool ExecuteCopyPipeline();
+        void SizeItems(const std::atomic<bool>& done);
+        core::Path DestinationFor(const OperationItem& item) const;
+        bool QueueCopyItem(const OperationItem& item, size_t index, CopyTaskQueue& queue,
+                           std::atomic<size_t>* outstanding);
+        bool CopyOneFile(const CopyTask& task);
+        bool UpdatesInPlace(uint64_t size) const { return delta_threshold_ > 0 && !checksums_ && size >= delta_threshold_; }
+        bool VerifyCopied(const CopyTask& task, const JournalFile& recorded);
+        void RecordFile(const std::string& dest, const JournalFile& file);
+        void OpenJournal();
+        void SaveJournal(bool force);
+        std::string SerializeJournalLocked() const;
+        bool ResolveConflict(const core::Path& source, const core::Path& dest, std::filesystem::path& dst_path);
+        void AddCompletedBytes(uint64_t bytes);
+        void NotifyProgress();
+        void UpdateRatesLocked();
+        void WaitWhilePaused();
         bool MoveFileInternal(const core::Path& source, const core::Path& dest);
         bool DeleteFileInternal(const core::Path& path);
+        bool DeleteTree(const core::Path& path);
         ConflictResolution HandleConflict(const FileConflict& conflict);
         core::Path GenerateUniqueName(const core::Path& path);
 
@@ -217,6 +339,10 @@ namespace opacity::filesystem
         std::vector<OperationItem> items_;
         core::Path destination_;
         ConflictResolution default_resolution_ = ConflictResolution::Ask;
+        OperationPriority priority_ = OperationPriority::Auto;
+
+        mutable std::once_flag devices_once_;
+        mutable std::vector<VolumeProfile> devices_;
 
         // Progress tracking
         mutable std::mutex progress_mutex_;
@@ -224,9 +350,24 @@ namespace opacity::filesystem
         std::chrono::steady_clock::time_point start_time_;
         uint64_t last_progress_bytes_ = 0;
         std::chrono::steady_clock::time_point last_progress_time_;
+        double smoothed_rate_ = 0.0;
+        CopyEngine copy_engine_;
+        uint64_t delta_threshold_ = 0;
+        std::atomic<uint64_t> bytes_unchanged_{0};
+
+        // Checksums and the resume journal
+        bool checksums_ = false;
+        core::CrashRecovery* journal_ = nullptr;
+        std::string journal_id_;                    // Empty until first written
+        mutable std::mutex journal_mutex_;
+        std::mutex journal_write_mutex_;            // Keeps journal writes in order
+        std::unordered_map<std::string, JournalFile> journal_files_;
+        std::vector<std::string> item_targets_;     // Each item's destination once conflicts are settled
+        bool journal_dirty_ = false;
+        std::chrono::steady_clock::time_point journal_written_;
 
         // Threading
-        std::thread worker_thread_;
+        core::TaskHandle worker_task_;      // On the shared scheduler
         std::atomic<bool> pause_requested_{false};
         std::atomic<bool> cancel_requested_{false};
         std::condition_variable pause_cv_;
@@ -238,6 +379,7 @@ namespace opacity::filesystem
 
         // Callbacks
         ProgressCallback on_progress_;
+        std::mutex callback_mutex_;
         ConflictCallback on_conflict_;
         CompletionCallback on_completion_;
     };
@@ -249,7 +391,12 @@ namespace opacity::filesystem
      * - Operation queue with pause/resume
      * - Conflict resolution
      * - Progress tracking
-     * - Concurrent operation limit
+     * - Per-device admission: an operation starts only while every disk or
+     *   server it touches is below its concurrency limit (1 for spinning
+     *   disks by default), so work on an idle SSD is not held back by two
+     *   copies thrashing an HDD. Interactive operations go first and may
+     *   take one slot above a device's limit.
+     * - Overall concurrent operation limit
      */
     class OperationQueue
     {
@@ -305,6 +452,18 @@ namespace opacity::filesystem
         void SetMaxConcurrent(size_t max) { max_concurrent_ = max; }
         size_t GetMaxConcurrent() const { return max_concurrent_; }
 
+        /**
+         * @brief Set how many operations may use one device of a kind at once
+         */
+        void SetDeviceConcurrency(StorageKind kind, size_t max);
+
+        /**
+         * @brief Override the limit for one device ("PhysicalDrive1", "\\server")
+         */
+        void SetDeviceConcurrency(const std::string& device, size_t max);
+
+        size_t GetDeviceConcurrency(const VolumeProfile& device) const;
+
         /**
          * @brief Pause all operations
          */
@@ -325,6 +484,24 @@ namespace opacity::filesystem
          */
         void ClearCompleted();
 
+        /**
+         * @brief Journal every copy added from now on to recovery
+         *
+         * Copies that already have a journal keep theirs. recovery must
+         * outlive the queue.
+         */
+        void SetJournal(core::CrashRecovery* recovery) { journal_ = recovery; }
+
+        /**
+         * @brief Queue the copies SetJournal's recovery holds from an earlier session
+         *
+         * A copy whose journal cannot be read any more is cleared from
+         * recovery. Other kinds of pending operation are left to their
+         * owners. Call ProcessQueue to start them.
+         * @return How many copies were queued
+         */
+        size_t ResumeJournaled();
+
         /**
          * @brief Process the queue (start pending operations)
          */
@@ -343,8 +520,12 @@ namespace opacity::filesystem
     private:
         mutable std::mutex operations_mutex_;
         std::vector<std::unique_ptr<BatchOperation>> operations_;
-        size_t max_concurrent_ = 2;
+        size_t max_concurrent_ = 6;
+
+        std::unordered_map<StorageKind, size_t> kind_concurrency_;
+        std::unordered_map<std::string, size_t> device_concurrency_;
 
+        core::CrashRecovery* journal_ = nullptr;
         QueueChangedCallback on_queue_changed_;
     };
 
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "opacity/core/Path.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief What kind of storage a volume sits on
+     */
+    enum class StorageKind
+    {
+        Unknown,
+        SolidState,
+        Nvme,
+        Rotational,
+        Network
+    };
+
+    /**
+     * @brief How much concurrent file I/O a volume takes well
+     */
+    struct VolumeProfile
+    {
+        std::string root;                       // "C:\", "\\server\share\"
+        std::string device;                     // "PhysicalDrive0", "\\server"; volumes on one disk share it
+        StorageKind kind = StorageKind::Unknown;
+        size_t parallelism = 2;                 // Files in flight at once; 1 for spinning disks
+        bool block_clone = false;               // FSCTL_DUPLICATE_EXTENTS_TO_FILE works (ReFS)
+        uint32_t cluster_size = 0;              // 0 when unknown
+    };
+
+    namespace StorageTopology
+    {
+        /**
+         * @brief Profile of the volume holding path (which need not exist yet)
+         *
+         * Looked up once per volume: seek penalty and bus type come from the
+         * storage driver, shares count as Network. Anything that cannot be
+         * queried (USB bridges, virtual disks) is Unknown. The device is the
+         * physical disk under the volume, or the server of a share; when it
+         * cannot be found (spanned volumes, mapped drives) it is the root.
+         */
+        VolumeProfile GetVolumeProfile(const core::Path& path);
+
+        /**
+         * @brief Concurrent copies for a transfer between two volumes
+         */
+        size_t GetTransferParallelism(const VolumeProfile& source, const VolumeProfile& dest);
+
+        /**
+         * @brief Whether two profiles are the same volume, so a rename or a
+         *        clone can cross between them; roots compare without case
+         */
+        bool SameVolume(const VolumeProfile& a, const VolumeProfile& b);
+
+        const char* GetKindName(StorageKind kind);
+    }
+
+} // namespace opacity::filesystem
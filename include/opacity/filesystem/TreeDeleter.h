@@ -0,0 +1,64 @@
+#pragma once
+
+#include "opacity/core/Path.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+namespace opacity::filesystem
+{
+    /**
+     * @brief Result of deleting a tree
+     */
+    struct TreeDeleteResult
+    {
+        bool success = false;
+        bool cancelled = false;         // The progress callback stopped the delete
+        uint64_t files_deleted = 0;
+        uint64_t directories_deleted = 0;
+        uint64_t failures = 0;
+        std::string error_message;      // First failure
+    };
+
+    /**
+     * @brief Deletes directory trees with a pool of threads
+     *
+     * Each thread lists one folder, deletes its files by handle and queues
+     * its subfolders; a folder goes as soon as its last subfolder has.
+     * Deletion uses POSIX semantics where the file system has them, so a
+     * name disappears at once even while another process holds the file
+     * open and its parent can be removed straight after. Read-only files
+     * are deleted as well. Links and junctions are removed, never followed.
+     */
+    class TreeDeleter
+    {
+    public:
+        /**
+         * @brief Called now and then with the entries deleted so far;
+         *        return false to stop
+         */
+        using ProgressCallback = std::function<bool(uint64_t deleted)>;
+
+        /**
+         * @brief Called by every thread before each entry it deletes; may
+         *        block, to pause, and returns false to stop
+         */
+        using CheckpointCallback = std::function<bool()>;
+
+        explicit TreeDeleter(size_t threads = 8);
+
+        /**
+         * @brief Delete a folder and everything below it
+         * @param progress Called by one thread at a time, the others carry on
+         * @param checkpoint Called from every thread; see CheckpointCallback
+         */
+        TreeDeleteResult Delete(const core::Path& path, const ProgressCallback& progress = nullptr,
+                                const CheckpointCallback& checkpoint = nullptr) const;
+
+    private:
+        size_t threads_;
+    };
+
+} // namespace opacity::filesystem
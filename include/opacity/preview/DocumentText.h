@@ -0,0 +1,119 @@
+#pragma once
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "opacity/core/Path.h"
+
+namespace opacity::preview
+{
+    /**
+     * @brief Receives extracted text a chunk at a time
+     * @return false to stop extracting
+     *
+     * Chunks are UTF-8 and never end partway through a character.
+     */
+    using TextChunkSink = std::function<bool(std::string_view text)>;
+
+    /**
+     * @brief Reads a PDF through its cross-reference table
+     *
+     * The file is mapped, not read. Open() follows startxref back through
+     * every /Prev section, classic tables and cross-reference streams
+     * alike, so only the objects asked for are ever parsed; objects packed
+     * into object streams are found through the stream. A file whose table
+     * is damaged is indexed instead by scanning for object headers.
+     *
+     * Not thread-safe; use one reader per thread.
+     */
+    class PdfReader
+    {
+    public:
+        PdfReader();
+        ~PdfReader();
+
+        // Non-copyable
+        PdfReader(const PdfReader&) = delete;
+        PdfReader& operator=(const PdfReader&) = delete;
+
+        /**
+         * @brief Map a PDF and read its cross-reference table
+         * @return false when it is not a readable PDF; see GetErrorMessage()
+         */
+        bool Open(const core::Path& path);
+
+        void Close();
+
+        bool IsOpen() const;
+        const std::string& GetErrorMessage() const;
+
+        /**
+         * @brief Whether the document is encrypted; its strings and text
+         *        then cannot be read
+         */
+        bool IsEncrypted() const;
+
+        int GetPageCount() const;
+
+        /**
+         * @brief A document information entry such as "Title" or "Author",
+         *        as UTF-8; empty when absent
+         */
+        std::string GetInfo(const std::string& key) const;
+
+        /**
+         * @brief Stream the text shown on each page, in page order
+         * @return false when there is no text to read, such as in an
+         *         encrypted document
+         *
+         * Pages are separated by a blank line. Content streams are decoded
+         * a page at a time, so memory follows the largest page rather than
+         * the document. Text is mapped through each font's ToUnicode CMap
+         * where it has one, and read as WinAnsi otherwise.
+         */
+        bool ExtractText(const TextChunkSink& sink) const;
+
+    private:
+        class Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+    /**
+     * @brief The text of the document formats preview and search understand
+     *
+     * PDF goes through PdfReader. OOXML (docx, xlsx, pptx) and OpenDocument
+     * parts are inflated out of the zip a buffer at a time and run through
+     * a streaming XML reader that keeps only the characters of text runs,
+     * so neither a part nor its text is ever whole in memory.
+     *
+     * Safe to call from several threads at once.
+     */
+    class DocumentTextExtractor
+    {
+    public:
+        static constexpr size_t kChunkSize = 64 * 1024;
+
+        /**
+         * @param extension File extension (lowercase, no dot)
+         */
+        static bool Supports(const std::string& extension);
+
+        /**
+         * @brief Every extension Supports() accepts
+         */
+        static std::vector<std::string> GetSupportedExtensions();
+
+        /**
+         * @brief Stream a document's text to sink in chunks of about
+         *        kChunkSize
+         * @return false when the file is not a readable document of the
+         *         type its extension says
+         */
+        static bool Extract(const core::Path& path, const TextChunkSink& sink);
+    };
+
+} // namespace opacity::preview
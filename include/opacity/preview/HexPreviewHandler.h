@@ -1,10 +1,15 @@
 #pragma once
 
+#include <array>
+#include <atomic>
 #include <cstdint>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "opacity/core/MappedFile.h"
 #include "opacity/core/Path.h"
 
 namespace opacity::preview
@@ -20,7 +25,7 @@ namespace opacity::preview
     };
 
     /**
-     * @brief A single line in hex display
+     * @brief A single line in hex display, formatted as it is drawn
      */
     struct HexLine
     {
@@ -60,19 +65,155 @@ namespace opacity::preview
 
     /**
      * @brief Preview data for hex view
+     *
+     * The file is mapped, not read; rows are formatted with
+     * HexPreviewHandler::FormatRow() for just those on screen.
      */
     struct HexPreviewData
     {
-        std::vector<HexLine> lines;
+        std::shared_ptr<core::MappedFile> file;
         BinaryStats stats;
-        uint64_t startOffset = 0;
-        uint64_t endOffset = 0;
         size_t totalSize = 0;
+        uint64_t rowCount = 0;
         HexDisplayFormat format = HexDisplayFormat::Hex16;
         bool loaded = false;
         std::string errorMessage;
     };
 
+    /**
+     * @brief Shared with a running search: how far it has got, and a flag
+     *        to stop it
+     */
+    struct HexSearchProgress
+    {
+        std::atomic<uint64_t> scanned{0};
+        std::atomic<uint64_t> total{0};
+        std::atomic<bool> cancelled{false};
+    };
+
+    /**
+     * @brief A search through a mapped file on a thread of its own
+     *
+     * Poll IsRunning() and GetProgress() from the UI thread; GetResult()
+     * holds the match once it has stopped. Starting again, cancelling or
+     * destroying it stops the previous search first.
+     */
+    class HexSearch
+    {
+    public:
+        HexSearch();
+        ~HexSearch();
+
+        // Non-copyable
+        HexSearch(const HexSearch&) = delete;
+        HexSearch& operator=(const HexSearch&) = delete;
+
+        void Start(
+            std::shared_ptr<core::MappedFile> file,
+            std::vector<uint8_t> pattern,
+            bool caseSensitive = true,
+            uint64_t startOffset = 0);
+
+        void Cancel();
+
+        bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Fraction of the file searched (0.0 - 1.0)
+         */
+        float GetProgress() const;
+
+        /**
+         * @brief Offset of the match, or -1 if none (yet)
+         */
+        int64_t GetResult() const { return result_.load(std::memory_order_acquire); }
+
+    private:
+        std::thread thread_;
+        HexSearchProgress progress_;
+        std::atomic<bool> running_{false};
+        std::atomic<int64_t> result_{-1};
+    };
+
+    /**
+     * @brief Byte statistics over a whole file
+     */
+    struct HexAnalysisResult
+    {
+        std::array<uint64_t, 256> histogram = {};
+        std::vector<float> blockEntropy;   // Bits per byte (0.0 - 8.0), one per block
+        uint64_t blockSize = 0;
+        BinaryStats stats;                 // From the histogram; no magic signature
+
+        /**
+         * @brief Block entropy for a strip chart this many columns wide;
+         *        each column is the highest of its blocks, so a small
+         *        compressed or encrypted region still shows
+         */
+        std::vector<float> GetStrip(size_t columns) const;
+    };
+
+    /**
+     * @brief Histogram and per-block entropy of a whole mapped file
+     *
+     * Unlike GetBinaryStats(), which samples the start, this reads every
+     * byte: workers take chunks of blocks, map them, and count each with
+     * four interleaved tables so consecutive equal bytes do not serialise
+     * on one counter. The file is cut into at most kMaxBlocks blocks of at
+     * least kMinBlockSize bytes.
+     */
+    class HexAnalysis
+    {
+    public:
+        static constexpr size_t kMaxBlocks = 4096;
+        static constexpr uint64_t kMinBlockSize = 64 * 1024;
+
+        HexAnalysis();
+        ~HexAnalysis();
+
+        // Non-copyable
+        HexAnalysis(const HexAnalysis&) = delete;
+        HexAnalysis& operator=(const HexAnalysis&) = delete;
+
+        /**
+         * @brief Analyse a file, stopping any analysis still running
+         * @param threads Workers to use; 0 for one per core, up to 8
+         */
+        void Start(std::shared_ptr<core::MappedFile> file, unsigned threads = 0);
+
+        void Cancel();
+
+        bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Fraction of the file analysed (0.0 - 1.0)
+         */
+        float GetProgress() const;
+
+        /**
+         * @brief The finished analysis, or null while running or cancelled
+         */
+        std::shared_ptr<const HexAnalysisResult> GetResult() const;
+
+    private:
+        void WorkerLoop();
+
+        std::shared_ptr<core::MappedFile> file_;
+        std::vector<std::thread> workers_;
+        std::atomic<bool> running_{false};
+        std::atomic<bool> cancelled_{false};
+
+        uint64_t chunkBlocks_ = 1;
+        size_t chunkCount_ = 0;
+        std::atomic<size_t> nextChunk_{0};
+        std::atomic<uint64_t> analysed_{0};
+        std::atomic<unsigned> active_{0};
+
+        mutable std::mutex mutex_;
+        std::shared_ptr<HexAnalysisResult> pending_;    // Filled by the workers
+        std::shared_ptr<const HexAnalysisResult> result_;
+    };
+
     /**
      * @brief Handler for hex preview of binary files
      */
@@ -100,20 +241,25 @@ namespace opacity::preview
         bool CanHandle(const core::Path& path, const std::string& extension) const;
 
         /**
-         * @brief Load hex preview for a file
+         * @brief Open a file for hex preview; nothing past the stats sample
+         *        is read here
          * @param path Path to the file
-         * @param offset Starting offset
-         * @param maxBytes Maximum bytes to read
          * @param format Display format
          */
         HexPreviewData LoadPreview(
             const core::Path& path,
-            uint64_t offset = 0,
-            size_t maxBytes = 4096,
             HexDisplayFormat format = HexDisplayFormat::Hex16) const;
 
         /**
-         * @brief Get binary file statistics
+         * @brief Format one row of a loaded preview
+         * @param line Reused between calls, so its strings keep their storage
+         * @return false past the end or when the file cannot be mapped
+         */
+        static bool FormatRow(const HexPreviewData& preview, uint64_t row, HexLine& line);
+
+        /**
+         * @brief Get binary file statistics from a sample at the start;
+         *        see HexAnalysis for the whole file
          */
         BinaryStats GetBinaryStats(const core::Path& path, size_t sampleSize = 8192) const;
 
@@ -126,6 +272,18 @@ namespace opacity::preview
             const std::vector<uint8_t>& pattern,
             uint64_t startOffset = 0) const;
 
+        /**
+         * @brief Search a mapped file, a bounded range mapped at a time
+         * @param progress Updated as it goes, and checked for cancellation
+         * @return Offset of first match, or -1 if not found or cancelled
+         */
+        static int64_t SearchBytes(
+            const core::MappedFile& file,
+            const std::vector<uint8_t>& pattern,
+            bool caseSensitive = true,
+            uint64_t startOffset = 0,
+            HexSearchProgress* progress = nullptr);
+
         /**
          * @brief Search for string in file
          * @return Offset of first match, or -1 if not found
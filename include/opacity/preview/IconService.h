@@ -0,0 +1,160 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include "opacity/preview/TextureManager.h"
+#include "opacity/core/Path.h"
+
+namespace opacity::preview
+{
+    /**
+     * @brief Shell icon sizes, those of the system image lists
+     */
+    enum class IconSize
+    {
+        Small,          // 16 pixels at 100% scaling
+        Large,          // 32
+        ExtraLarge,     // 48
+        Jumbo           // 256
+    };
+
+    /**
+     * @brief The shell icon for a file; texture is null when there is none
+     *        to show, and is drawn once it is resident
+     */
+    struct Icon
+    {
+        TexturePtr texture;
+        int width = 0;
+        int height = 0;
+    };
+
+    /**
+     * @brief Shared with whoever draws it; the atlas cell is freed with the
+     *        last reference, so hold it until the frame has been presented
+     */
+    using IconPtr = std::shared_ptr<const Icon>;
+
+    /**
+     * @brief Shell icons for file lists, resolved off the UI thread
+     *
+     * Get() never blocks: it returns the icon in memory, or queues it and
+     * returns null so the caller draws a placeholder. As with thumbnails a
+     * request has to be renewed every frame; BeginFrame drops those nobody
+     * asked for again.
+     *
+     * Most icons depend on the type alone, so they are keyed by extension
+     * (or folder) and asked for without touching the file; a folder of ten
+     * thousand documents costs one lookup. Only .exe, .lnk and .ico files
+     * carry icons of their own; those are extracted per file, with their
+     * overlays, and come after the generic requests. A file whose own icon
+     * cannot be read without downloading it, or at all, gets its type's.
+     * Reparse points carry the link overlay.
+     *
+     * Requests run on one worker in a single-threaded COM apartment, which
+     * icon and overlay handlers expect, at background priority. Icons of
+     * the same system image list entry share one texture in the atlas.
+     */
+    class IconService
+    {
+    public:
+        IconService();
+        ~IconService();
+
+        // Disable copy
+        IconService(const IconService&) = delete;
+        IconService& operator=(const IconService&) = delete;
+
+        /**
+         * @brief Start the worker
+         */
+        void Initialize(TextureManager* textures);
+
+        /**
+         * @brief Stop the worker and drop every icon; call before the
+         *        texture manager shuts down
+         */
+        void Shutdown();
+
+        /**
+         * @brief The smallest icon size that covers this many pixels
+         */
+        static IconSize SizeFor(float pixels);
+
+        /**
+         * @brief The icon for a listed item, or null while it is resolved
+         * @param attributes As listed (FsItem::attributes); the directory
+         *        and reparse point bits choose the icon and its overlay
+         * @param modified As listed; a newer one extracts a file's own icon
+         *        again
+         */
+        IconPtr Get(const core::Path& path, uint32_t attributes, std::chrono::system_clock::time_point modified,
+                    IconSize size);
+
+        /**
+         * @brief Drop queued requests not renewed during the last frame;
+         *        call once at the start of every frame
+         */
+        void BeginFrame();
+
+        /**
+         * @brief Drop queued work and icons held in memory
+         */
+        void Clear();
+
+        /**
+         * @brief Icons asked for and not resolved yet
+         */
+        size_t GetQueuedCount() const;
+
+    private:
+        struct Job
+        {
+            std::string key;
+            core::Path path;
+            uint32_t attributes = 0;
+            IconSize size = IconSize::Small;
+            bool per_file = false;      // Extracted from the file rather than by type
+            uint64_t frame = 0;         // Last asked for in this frame
+        };
+
+        struct MemoryEntry
+        {
+            std::string key;
+            IconPtr icon;
+        };
+
+        void WorkerLoop();
+        IconPtr Resolve(const Job& job);
+        IconPtr Extract(int image, int overlay, IconSize size);
+        void StoreLocked(const std::string& key, const IconPtr& icon, bool per_file);
+
+        TextureManager* textures_ = nullptr;
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        std::list<Job> queue_;                      // Newest first
+        std::unordered_map<std::string, std::list<Job>::iterator> queued_;     // Queued, or being resolved (end()), by key
+        uint64_t frame_ = 0;
+        std::thread worker_;
+        bool stop_ = false;
+
+        // Type icons are few and kept; per-file ones are bounded, least
+        // recently drawn dropped first
+        std::unordered_map<std::string, IconPtr> type_icons_;
+        std::list<MemoryEntry> file_icons_;
+        std::unordered_map<std::string, std::list<MemoryEntry>::iterator> file_index_;
+
+        // By image list entry, overlay and size, so types sharing an icon
+        // share its texture
+        std::unordered_map<uint64_t, IconPtr> images_;
+    };
+
+} // namespace opacity::preview
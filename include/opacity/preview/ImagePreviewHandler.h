@@ -29,8 +29,10 @@ namespace opacity::preview
      */
     struct ImagePreviewData
     {
-        ImageInfo info;
-        std::vector<uint8_t> pixels;  // RGBA pixel data
+        ImageInfo info;                 // Of the file, at full size
+        int width = 0;                  // Decoded size, within max_dimension
+        int height = 0;
+        std::vector<uint8_t> pixels;  // RGBA pixel data; dropped once the texture exists
         ID3D11ShaderResourceView* texture = nullptr;  // GPU texture for ImGui rendering
         bool loaded = false;
         std::string error_message;
@@ -61,6 +63,11 @@ namespace opacity::preview
 
         /**
          * @brief Load preview data for an image file
+         *
+         * Decoding goes through WIC where it can, scaling on the way so only
+         * the target size is ever held; other formats are decoded by stb
+         * and reduced afterwards.
+         *
          * @param path Path to the file
          * @param max_dimension Maximum dimension (width or height) for thumbnail
          * @return Preview data
@@ -69,6 +76,16 @@ namespace opacity::preview
             const core::Path& path,
             int max_dimension = 512) const;
 
+        /**
+         * @brief Load preview data for an image read into memory, such as
+         *        an archive entry
+         * @param path Names the image; it is not read
+         */
+        ImagePreviewData LoadPreview(
+            const core::Path& path,
+            const std::vector<char>& contents,
+            int max_dimension = 512) const;
+
         /**
          * @brief Release resources for a preview
          */
@@ -84,11 +101,21 @@ namespace opacity::preview
          */
         ImageInfo GetImageInfo(const core::Path& path) const;
 
-    private:
-        ID3D11ShaderResourceView* CreateTexture(
+        /**
+         * @brief Upload RGBA pixels as a shader resource
+         * @return nullptr without a device or on failure
+         */
+        static ID3D11ShaderResourceView* CreateTexture(
+            ID3D11Device* device,
             const uint8_t* pixels,
             int width,
-            int height) const;
+            int height);
+
+    private:
+        ImagePreviewData LoadFrom(
+            const core::Path& path,
+            const std::vector<char>* contents,
+            int max_dimension) const;
 
         std::vector<std::string> supported_extensions_;
         ID3D11Device* device_ = nullptr;
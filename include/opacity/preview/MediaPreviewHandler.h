@@ -1,10 +1,13 @@
 #pragma once
 
+#include <atomic>
 #include <chrono>
 #include <cstdint>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <thread>
 #include <vector>
 
 #include "opacity/core/Path.h"
@@ -86,14 +89,38 @@ namespace opacity::preview
     };
 
     /**
-     * @brief Audio waveform data
+     * @brief Audio waveform as the lowest and highest sample of each bucket
+     *
+     * Buckets are bucketsPerSecond of the track each, over all channels,
+     * so a waveform is a few megabytes however long the recording.
      */
     struct AudioWaveform
     {
-        std::vector<float> samples;  // Normalized -1.0 to 1.0
+        std::vector<float> peaks;    // Min then max of each bucket, normalized -1.0 to 1.0
+        int bucketsPerSecond = 0;
         int sampleRate = 0;
         int channels = 0;
         std::chrono::milliseconds duration{0};
+
+        size_t GetBucketCount() const { return peaks.size() / 2; }
+
+        /**
+         * @brief Min and max pairs for a view this many columns wide; each
+         *        column spans its share of the buckets, so a short click
+         *        still shows
+         */
+        std::vector<float> GetStrip(size_t columns) const;
+    };
+
+    /**
+     * @brief Shared with a running waveform decode: how far it has got, and
+     *        a flag to stop it
+     */
+    struct WaveformProgress
+    {
+        std::atomic<int64_t> decodedMs{0};
+        std::atomic<int64_t> totalMs{0};
+        std::atomic<bool> cancelled{false};
     };
 
     /**
@@ -179,11 +206,44 @@ namespace opacity::preview
             int maxDimension = 160) const;
 
         /**
-         * @brief Generate audio waveform
+         * @brief Thumbnails at even intervals, decoded on the GPU
+         *
+         * The source reader decodes with DXVA on the device passed to
+         * Initialize() and scales on the GPU; each frame is copied into a
+         * texture of its own, so pixels stay empty. Only the keyframe at or
+         * before each interval is decoded, and the frames are spread over
+         * several readers at once. Without a device, or where the driver
+         * cannot decode the stream, this falls back to ExtractThumbnails().
+         */
+        std::vector<VideoThumbnail> ExtractThumbnailStrip(
+            const core::Path& path,
+            int count = 8,
+            int maxDimension = 160) const;
+
+        /**
+         * @brief Decode the first audio stream into a waveform
+         * @param bucketsPerSecond Resolution kept; GetStrip() narrows it to
+         *        the view
+         * @param progress Optional; cancelling it returns an empty waveform
+         *
+         * Decoded samples are reduced a buffer at a time and never kept.
+         * The result is stored as a peak file under the local app data
+         * folder, keyed on the path, size and modification time, so opening
+         * the same recording again reads that instead of decoding.
          */
         AudioWaveform GenerateWaveform(
             const core::Path& path,
-            int samplesPerSecond = 100) const;
+            int bucketsPerSecond = 100,
+            WaveformProgress* progress = nullptr) const;
+
+        /**
+         * @brief The stored waveform for a file, without decoding
+         * @return false when there is none for this version of the file
+         */
+        bool FindCachedWaveform(
+            const core::Path& path,
+            int bucketsPerSecond,
+            AudioWaveform& waveform) const;
 
         /**
          * @brief Release resources for a preview
@@ -220,4 +280,45 @@ namespace opacity::preview
         std::unique_ptr<Impl> impl_;
     };
 
+    /**
+     * @brief A waveform decode on a thread of its own
+     *
+     * Poll IsRunning() and GetProgress() from the UI thread, then take the
+     * waveform with TakeResult(). Starting again, cancelling or destroying
+     * it stops the previous decode first. The handler must outlive it.
+     */
+    class WaveformBuilder
+    {
+    public:
+        WaveformBuilder();
+        ~WaveformBuilder();
+
+        // Non-copyable
+        WaveformBuilder(const WaveformBuilder&) = delete;
+        WaveformBuilder& operator=(const WaveformBuilder&) = delete;
+
+        void Start(const MediaPreviewHandler& handler, const core::Path& path, int bucketsPerSecond = 100);
+
+        void Cancel();
+
+        bool IsRunning() const { return running_.load(std::memory_order_acquire); }
+
+        /**
+         * @brief Fraction of the track decoded (0.0 - 1.0)
+         */
+        float GetProgress() const;
+
+        /**
+         * @brief The finished waveform, once; empty while running
+         */
+        AudioWaveform TakeResult();
+
+    private:
+        std::thread thread_;
+        WaveformProgress progress_;
+        std::atomic<bool> running_{false};
+        std::mutex resultMutex_;
+        AudioWaveform result_;
+    };
+
 } // namespace opacity::preview
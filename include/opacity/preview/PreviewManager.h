@@ -1,15 +1,29 @@
 #pragma once
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <list>
 #include <memory>
+#include <mutex>
 #include <string>
+#include <unordered_map>
 #include <variant>
+#include <vector>
 #include "opacity/preview/TextPreviewHandler.h"
 #include "opacity/preview/ImagePreviewHandler.h"
 #include "opacity/core/Path.h"
+#include "opacity/core/MemoryGovernor.h"
 
 // Forward declare D3D11 types
 struct ID3D11Device;
 
+namespace opacity::core
+{
+    class PluginManager;
+    class PreviewSource;
+}
+
 namespace opacity::preview
 {
     /**
@@ -40,10 +54,80 @@ namespace opacity::preview
         // General info
         std::string error_message;
         bool is_loading = false;
+        bool online_only = false;   // Left unread: the file is a cloud placeholder
+    };
+
+    /**
+     * @brief A finished preview, shared between the cache and whoever shows
+     * it; the texture is released with the last reference
+     */
+    using PreviewPtr = std::shared_ptr<const PreviewData>;
+
+    /**
+     * @brief A preview being built on a PreviewManager worker
+     *
+     * Poll IsReady() from the UI thread, then Take() the result. A
+     * cancelled request never becomes ready, though its preview still goes
+     * into the cache.
+     */
+    class PreviewRequest
+    {
+    public:
+        PreviewRequest(std::string path, std::string key, bool hydrate);
+
+        // Disable copy
+        PreviewRequest(const PreviewRequest&) = delete;
+        PreviewRequest& operator=(const PreviewRequest&) = delete;
+
+        const std::string& GetPath() const { return path_; }
+        bool IsReady() const { return ready_.load(std::memory_order_acquire); }
+        bool IsCancelled() const { return cancelled_.load(std::memory_order_relaxed); }
+        void Cancel() { cancelled_.store(true, std::memory_order_relaxed); }
+
+        /**
+         * @brief How far a plugin has got, from 0 to 1; 0 for built-in handlers
+         */
+        float GetProgress() const { return progress_.load(std::memory_order_relaxed); }
+
+        /**
+         * @brief The finished preview; only valid once IsReady()
+         */
+        PreviewPtr Take() const { return result_; }
+
+    private:
+        friend class PreviewManager;
+
+        std::string path_;
+        std::string key_;                   // Cache key; empty when the file could not be stat'ed
+        bool hydrate_ = false;
+        bool prefetch_ = false;             // Nobody waits on it yet
+        std::atomic<bool> cancelled_{false};
+        std::atomic<bool> ready_{false};
+        std::atomic<float> progress_{0.0f};
+        PreviewPtr result_;                 // Written by the worker before ready_
     };
 
+    using PreviewHandle = std::shared_ptr<PreviewRequest>;
+
     /**
      * @brief Manages preview handlers and coordinates file previews
+     *
+     * RequestPreview decodes on the shared task scheduler, at interactive
+     * priority, so the UI thread never waits on stb or a slow disk; the
+     * D3D11 device is free-threaded, so textures are created there too.
+     * Each request cancels the one before it: while the selection moves
+     * only the newest preview is wanted, and a second decode lets it start
+     * even while a superseded one that cannot be interrupted runs out.
+     *
+     * Finished previews go into an LRU cache keyed by path, modification
+     * time and size, bounded by an estimate of their texture and text
+     * memory. PrefetchPreviews fills it for the items around the selection
+     * at background priority, so stepping through a folder finds the next
+     * preview already decoded.
+     *
+     * Files no built-in handler takes go to preview plugins, if a plugin
+     * manager is set. They render on the same tasks, into a buffer each
+     * scheduler thread keeps, and see the request's cancellation as they run.
      */
     class PreviewManager
     {
@@ -56,12 +140,41 @@ namespace opacity::preview
          */
         void Initialize(ID3D11Device* device);
 
+        /**
+         * @brief Offer files no built-in handler takes to preview plugins
+         * @param plugins Must outlive this manager; null to stop
+         */
+        void SetPluginManager(core::PluginManager* plugins) { plugins_ = plugins; }
+
         /**
          * @brief Load preview for a file
-         * @param path Path to the file
-         * @return Preview data
+         * @param path Path to the file, or to an entry inside a ZIP archive
+         *        ("archive.zip!inside/path")
+         * @param hydrate Read an online-only cloud file anyway, downloading it
+         * @return Preview data (only online_only set for a placeholder
+         *         left unread)
+         */
+        PreviewData LoadPreview(const core::Path& path, bool hydrate = false);
+
+        /**
+         * @brief Load a preview on a worker, cancelling any earlier request
+         *
+         * A cached preview comes back already ready, and one being
+         * prefetched is taken over rather than decoded twice.
+         */
+        PreviewHandle RequestPreview(const core::Path& path, bool hydrate = false);
+
+        /**
+         * @brief Decode previews into the cache in the background
+         *
+         * Replaces whatever an earlier call left queued; nearest first.
+         */
+        void PrefetchPreviews(const std::vector<core::Path>& paths);
+
+        /**
+         * @brief Cancel the outstanding request, if any
          */
-        PreviewData LoadPreview(const core::Path& path);
+        void CancelRequests();
 
         /**
          * @brief Release resources from a preview
@@ -73,6 +186,12 @@ namespace opacity::preview
          */
         PreviewType GetPreviewType(const core::Path& path) const;
 
+        /**
+         * @brief Bound the preview cache (bytes, estimated)
+         */
+        void SetCacheBudget(size_t bytes);
+        void ClearCache();
+
         /**
          * @brief Get reference to text handler for direct use
          */
@@ -84,9 +203,49 @@ namespace opacity::preview
         ImagePreviewHandler& GetImageHandler() { return image_handler_; }
 
     private:
+        struct CacheEntry
+        {
+            std::string key;
+            PreviewPtr preview;
+            size_t bytes = 0;
+        };
+
+        // Side of the box a plugin preview is rendered within
+        static constexpr int kPluginPreviewSize = 512;
+
+        PreviewData Load(const core::Path& path, bool hydrate, PreviewRequest* request);
+        PreviewData LoadPluginPreview(core::PreviewSource& source, const core::Path& path,
+                                      PreviewData preview, PreviewRequest* request);
+        PreviewData LoadArchivePreview(const core::Path& path, const core::Path& archive_path,
+                                       const std::string& lower_ext, bool hydrate, PreviewData preview);
+        PreviewPtr FindCachedLocked(const std::string& key);
+        void StoreCachedLocked(const std::string& key, const PreviewPtr& preview);
+        void EvictLocked(size_t limit);
+        void DropQueuedLocked(const PreviewHandle& request);
+        void ScheduleLocked();
+        void Drain(bool prefetch);
+
         TextPreviewHandler text_handler_;
         ImagePreviewHandler image_handler_;
         ID3D11Device* device_ = nullptr;
+        core::PluginManager* plugins_ = nullptr;
+
+        std::mutex mutex_;
+        std::condition_variable drained_;          // A drain returned
+        std::deque<PreviewHandle> queue_;
+        std::deque<PreviewHandle> prefetch_queue_;  // Taken only when queue_ is empty
+        std::unordered_map<std::string, std::weak_ptr<PreviewRequest>> pending_;  // Queued or decoding, by key
+        std::weak_ptr<PreviewRequest> latest_;     // The only request not yet superseded
+        size_t request_drains_ = 0;                 // Submitted to the scheduler and not returned
+        size_t prefetch_drains_ = 0;
+        bool stop_ = false;
+
+        std::list<CacheEntry> cache_;               // Most recently used first
+        std::unordered_map<std::string, std::list<CacheEntry>::iterator> cache_index_;
+        size_t cache_bytes_ = 0;
+        size_t cache_budget_ = 256 * 1024 * 1024;
+
+        core::MemoryGovernor::Registration memory_;
     };
 
 } // namespace opacity::preview
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "opacity/preview/TextDocument.h"
+
+namespace opacity::preview
+{
+    struct SyntaxLanguage;
+
+    /**
+     * @brief What a run of characters is, for colouring
+     */
+    enum class TokenKind : uint8_t
+    {
+        Plain,
+        Keyword,
+        String,
+        Comment,
+        Number,
+        Preprocessor
+    };
+
+    /**
+     * @brief A run of one kind within a line, as byte offsets into its text
+     */
+    struct TokenSpan
+    {
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        TokenKind kind = TokenKind::Plain;
+    };
+
+    /**
+     * @brief A line as displayed, and the spans that cover it
+     */
+    struct HighlightedLine
+    {
+        std::string text;
+        std::vector<TokenSpan> spans;
+    };
+
+    /**
+     * @brief Colours a TextDocument a block of lines at a time
+     *
+     * Only the lines asked for are lexed. The lexer state at the start of
+     * every kBlockLines-th line is kept, so a block far down the file is
+     * lexed from the nearest checkpoint above it, and blocks already
+     * coloured are cached. Checkpoints not made yet are caught up at most
+     * kCatchUpLines per call; until then the lines come back plain, so a
+     * jump to the end of a large file never stalls a frame.
+     *
+     * Not thread-safe; use from the UI thread.
+     */
+    class SyntaxHighlighter
+    {
+    public:
+        static constexpr size_t kBlockLines = 64;
+        static constexpr size_t kCachedBlocks = 64;
+        static constexpr size_t kCatchUpLines = 50000;
+
+        /**
+         * @param extension File extension (lowercase, no dot)
+         */
+        SyntaxHighlighter(std::shared_ptr<TextDocument> document, const std::string& extension);
+        ~SyntaxHighlighter();
+
+        // Disable copy
+        SyntaxHighlighter(const SyntaxHighlighter&) = delete;
+        SyntaxHighlighter& operator=(const SyntaxHighlighter&) = delete;
+
+        /**
+         * @brief Whether there is a lexer for this file type
+         */
+        static bool Supports(const std::string& extension);
+
+        /**
+         * @brief Counted lines with their spans; see TextDocument::GetLines
+         */
+        std::vector<HighlightedLine> GetLines(size_t first, size_t count);
+
+        /**
+         * @brief Whether the last GetLines() returned plain lines while
+         *        checkpoints are caught up
+         */
+        bool IsCatchingUp() const { return catching_up_; }
+
+    private:
+        struct CachedBlock
+        {
+            size_t block = 0;
+            std::vector<HighlightedLine> lines;
+        };
+
+        const std::vector<HighlightedLine>& GetBlock(size_t block, size_t line_count, size_t& budget);
+        void LexBlock(size_t block, uint8_t& state, std::vector<HighlightedLine>& lines) const;
+        void Lex(HighlightedLine& line, uint8_t& state) const;
+        void Reset();
+
+        std::shared_ptr<TextDocument> document_;
+        const SyntaxLanguage* language_ = nullptr;
+        uint64_t generation_ = 0;
+        bool catching_up_ = false;
+
+        std::vector<uint8_t> states_;               // Lexer state at the start of block i
+        std::list<CachedBlock> cache_;              // Most recently shown first
+        std::unordered_map<size_t, std::list<CachedBlock>::iterator> cache_index_;
+        std::vector<HighlightedLine> scratch_;      // A block not cached: the last, or not yet reachable
+    };
+
+} // namespace opacity::preview
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "opacity/core/Path.h"
+
+namespace opacity::core
+{
+    class MappedView;
+}
+
+namespace opacity::preview
+{
+    /**
+     * @brief A text file of any size, memory-mapped and read a window at a
+     *        time
+     *
+     * Open() maps the file and returns at once; a background thread then
+     * counts lines, keeping the offset of every kLineStride-th line start.
+     * Lines already counted can be read straight away: finding one costs a
+     * lookup and a scan over fewer than kLineStride lines, however far into
+     * the file it is.
+     *
+     * Refresh() picks up a file that has grown since, such as a log being
+     * written, and counts only what is new. One that has shrunk or been
+     * replaced is counted again from the start.
+     */
+    class TextDocument
+    {
+    public:
+        static constexpr size_t kLineStride = 128;
+
+        TextDocument();
+        ~TextDocument();
+
+        // Disable copy
+        TextDocument(const TextDocument&) = delete;
+        TextDocument& operator=(const TextDocument&) = delete;
+
+        /**
+         * @brief Map a file and start counting its lines
+         * @return false when it cannot be opened; see GetErrorMessage()
+         */
+        bool Open(const core::Path& path);
+
+        /**
+         * @brief Show contents already in memory, such as an archive entry
+         *
+         * The path only names the document; Refresh() never rereads it.
+         */
+        bool Open(const core::Path& path, std::vector<char> contents);
+
+        /**
+         * @brief Stop counting and unmap the file
+         */
+        void Close();
+
+        /**
+         * @brief Remap the file if its size has changed
+         * @return true when there is more to show
+         */
+        bool Refresh();
+
+        /**
+         * @brief Lines counted so far, including an unterminated last line
+         */
+        size_t GetLineCount() const;
+
+        /**
+         * @brief Whether lines are still being counted
+         */
+        bool IsIndexing() const { return indexing_.load(std::memory_order_acquire); }
+
+        uint64_t GetSize() const;
+        uint64_t GetIndexedBytes() const;
+
+        /**
+         * @brief Held in memory rather than mapped
+         */
+        bool IsBuffered() const { return buffered_; }
+
+        /**
+         * @brief Changes whenever counting starts over, so anything kept
+         *        per line is stale
+         */
+        uint64_t GetGeneration() const;
+
+        const std::string& GetErrorMessage() const { return error_message_; }
+
+        /**
+         * @brief Read counted lines for display
+         * @param first Zero-based index of the first line
+         * @param count Lines wanted; fewer come back at the end
+         * @param max_line_length Characters kept per line before "..."
+         *
+         * Trailing carriage returns are dropped and tabs widened to four
+         * spaces.
+         */
+        std::vector<std::string> GetLines(size_t first, size_t count, size_t max_line_length = 1000) const;
+
+    private:
+        // One view of the file; readers and the indexer hold it, so a
+        // remap never pulls the bytes from under them
+        struct Mapping
+        {
+            std::shared_ptr<const core::MappedView> view;
+            const char* data = nullptr;
+            uint64_t size = 0;
+            std::vector<char> contents;     // Held instead of a view when opened from memory
+        };
+
+        std::shared_ptr<const Mapping> MapFile(std::string& error) const;
+        void StartIndexing(uint64_t from);
+        void StopIndexing();
+        void IndexLoop(std::shared_ptr<const Mapping> mapping, uint64_t from);
+        void ResetIndex();
+
+        core::Path path_;
+        bool buffered_ = false;                 // Opened from memory, not mapped
+        std::string error_message_;
+
+        mutable std::mutex mutex_;
+        std::shared_ptr<const Mapping> mapping_;
+        std::vector<uint64_t> checkpoints_;     // Start of line i * kLineStride
+        uint64_t newlines_ = 0;
+        uint64_t last_line_start_ = 0;
+        uint64_t indexed_bytes_ = 0;
+        uint64_t bom_bytes_ = 0;                // A UTF-8 byte order mark, skipped
+        uint64_t generation_ = 0;
+
+        std::thread indexer_;
+        std::atomic<bool> indexing_{false};
+        std::atomic<bool> stop_{false};
+    };
+
+} // namespace opacity::preview
@@ -3,19 +3,23 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include "opacity/preview/SyntaxHighlighter.h"
+#include "opacity/preview/TextDocument.h"
 #include "opacity/core/Path.h"
 
 namespace opacity::preview
 {
     /**
      * @brief Preview data for text files
+     *
+     * The document is mapped rather than read, so any size opens at once;
+     * lines are fetched from it for whatever part is on screen.
      */
     struct TextPreviewData
     {
-        std::vector<std::string> lines;
-        size_t total_lines = 0;
+        std::shared_ptr<TextDocument> document;
+        std::shared_ptr<SyntaxHighlighter> highlighter;     // Null for plain text
         std::string encoding;  // e.g., "UTF-8", "ASCII"
-        bool truncated = false;
         std::string error_message;
     };
 
@@ -37,16 +41,18 @@ namespace opacity::preview
         bool CanHandle(const core::Path& path, const std::string& extension) const;
 
         /**
-         * @brief Load preview data for a text file
+         * @brief Open a text file for preview; its lines are counted in the
+         *        background
          * @param path Path to the file
-         * @param max_lines Maximum number of lines to load (0 = no limit)
-         * @param max_line_length Maximum characters per line before truncation
          * @return Preview data
          */
-        TextPreviewData LoadPreview(
-            const core::Path& path,
-            size_t max_lines = 500,
-            size_t max_line_length = 1000) const;
+        TextPreviewData LoadPreview(const core::Path& path) const;
+
+        /**
+         * @brief Preview contents read into memory, such as an archive entry
+         * @param path Names the file, for its language
+         */
+        TextPreviewData LoadPreview(const core::Path& path, std::vector<char> contents) const;
 
         /**
          * @brief Get the list of supported extensions
@@ -54,6 +60,9 @@ namespace opacity::preview
         std::vector<std::string> GetSupportedExtensions() const;
 
     private:
+        void Highlight(const core::Path& path, std::shared_ptr<TextDocument> document,
+                       TextPreviewData& data) const;
+
         std::vector<std::string> supported_extensions_;
     };
 
@@ -0,0 +1,204 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// Forward declare D3D11 types
+struct ID3D11Device;
+struct ID3D11DeviceContext;
+struct ID3D11Texture2D;
+struct ID3D11ShaderResourceView;
+
+namespace opacity::preview
+{
+    class TextureManager;
+
+    /**
+     * @brief Where a region sits in its texture
+     */
+    struct TextureUv
+    {
+        float u0 = 0.0f;
+        float v0 = 0.0f;
+        float u1 = 1.0f;
+        float v1 = 1.0f;
+    };
+
+    /**
+     * @brief Pixels uploaded by a TextureManager: a cell of an atlas page,
+     *        or a texture of its own when too large for one
+     *
+     * Pending until the upload has had its turn in some frame, then drawn
+     * with GetView() and GetUv(). One not drawn for a while may be evicted
+     * to keep VRAM under its cap; it never comes back, and whoever holds it
+     * uploads again.
+     */
+    class TextureRegion
+    {
+    public:
+        enum class State
+        {
+            Pending,
+            Resident,
+            Evicted
+        };
+
+        // Disable copy
+        TextureRegion(const TextureRegion&) = delete;
+        TextureRegion& operator=(const TextureRegion&) = delete;
+
+        bool IsResident() const { return state_.load(std::memory_order_acquire) == State::Resident; }
+        bool IsEvicted() const { return state_.load(std::memory_order_acquire) == State::Evicted; }
+        ID3D11ShaderResourceView* GetView() const { return view_; }
+        const TextureUv& GetUv() const { return uv_; }
+        int GetWidth() const { return width_; }
+        int GetHeight() const { return height_; }
+
+    private:
+        friend class TextureManager;
+
+        TextureRegion(std::vector<uint8_t> pixels, int width, int height, int size_class);
+
+        std::atomic<State> state_{State::Pending};
+        ID3D11ShaderResourceView* view_ = nullptr;  // The page's, or owned when standalone
+        ID3D11Texture2D* texture_ = nullptr;        // Owned when standalone
+        TextureUv uv_;
+        int width_ = 0;
+        int height_ = 0;
+        int size_class_ = 0;
+        int page_ = -1;
+        int cell_ = -1;
+        std::vector<uint8_t> pixels_;               // RGBA, until uploaded
+        uint64_t last_used_ = 0;                    // Frame it was last drawn in
+        std::list<TextureRegion*>::iterator lru_position_;
+    };
+
+    using TexturePtr = std::shared_ptr<const TextureRegion>;
+
+    /**
+     * @brief Uploads small textures into shared atlas pages
+     *
+     * Thumbnails come in a few fixed sizes, so each atlas page holds cells
+     * of one size; allocation is a free list and thousands of thumbnails
+     * share a handful of textures and views. Anything larger than the
+     * largest cell gets a texture of its own.
+     *
+     * Upload() may be called from any thread; the pixels wait until
+     * BeginFrame(), which copies at most the per-frame byte budget through
+     * a ring of staging textures, so a screenful of new thumbnails arrives
+     * over a few frames instead of stalling one. When a new page would take
+     * VRAM past the cap, the least recently drawn region of that size is
+     * evicted instead; regions drawn in the last frame are left alone.
+     *
+     * Regions must not outlive the manager.
+     */
+    class TextureManager
+    {
+    public:
+        static constexpr int kPageSize = 2048;
+        static constexpr int kStagingSize = 1024;
+
+        TextureManager();
+        ~TextureManager();
+
+        // Disable copy
+        TextureManager(const TextureManager&) = delete;
+        TextureManager& operator=(const TextureManager&) = delete;
+
+        void Initialize(ID3D11Device* device, ID3D11DeviceContext* context);
+
+        /**
+         * @brief Release every page and staging texture; regions still held
+         *        are evicted
+         */
+        void Shutdown();
+
+        /**
+         * @brief Queue RGBA pixels for upload; the region is pending until a
+         *        later BeginFrame()
+         */
+        TexturePtr Upload(std::vector<uint8_t> pixels, int width, int height);
+
+        /**
+         * @brief Mark a region as drawn this frame, so it is evicted last
+         */
+        void Touch(const TextureRegion& region);
+
+        /**
+         * @brief Run this frame's uploads; call on the UI thread before
+         *        anything is drawn
+         */
+        void BeginFrame();
+
+        /**
+         * @brief Bytes copied per frame; capped at one staging texture
+         */
+        void SetUploadBudget(size_t bytes);
+
+        /**
+         * @brief Bytes of pages and standalone textures to stay under
+         */
+        void SetVramBudget(size_t bytes);
+
+        size_t GetVramBytes() const;
+        size_t GetPendingCount() const;
+
+    private:
+        static constexpr int kCellEdges[] = {64, 128, 256};
+        static constexpr int kAtlasClasses = 3;
+        static constexpr int kStandaloneClass = kAtlasClasses;
+        static constexpr int kStagingFrames = 3;
+        static constexpr int kGutter = 1;           // Repeated edge pixels, so filtering never reads a neighbour
+
+        struct Page
+        {
+            ID3D11Texture2D* texture = nullptr;
+            ID3D11ShaderResourceView* view = nullptr;
+            int size_class = 0;
+            int columns = 0;
+            std::vector<int> free_cells;
+            int used = 0;
+        };
+
+        struct Copy
+        {
+            ID3D11Texture2D* target;
+            int x;
+            int y;
+            int source_x;
+            int source_y;
+            int width;
+            int height;
+        };
+
+        static int SizeClassFor(int width, int height);
+        bool PlaceLocked(TextureRegion& region, int& x, int& y, ID3D11Texture2D*& target);
+        bool CreatePageLocked(int size_class);
+        bool CreateStandaloneLocked(TextureRegion& region, bool with_pixels);
+        bool EvictLocked(int size_class);
+        void ReleaseEmptyPagesLocked();
+        void FreeLocked(TextureRegion& region);
+        void Release(TextureRegion* region);
+
+        ID3D11Device* device_ = nullptr;
+        ID3D11DeviceContext* context_ = nullptr;
+
+        mutable std::mutex mutex_;
+        std::deque<std::weak_ptr<const TextureRegion>> pending_;
+        std::vector<Page> pages_;                   // Released pages leave a hole, reused first
+        std::array<std::list<TextureRegion*>, kAtlasClasses + 1> lru_;     // Resident, most recently drawn first
+        std::array<ID3D11Texture2D*, kStagingFrames> staging_{};
+        uint64_t frame_ = 0;
+        size_t vram_bytes_ = 0;
+        size_t upload_budget_ = static_cast<size_t>(kStagingSize) * kStagingSize * 4;
+        size_t vram_budget_ = 256 * 1024 * 1024;
+    };
+
+} // namespace opacity::preview
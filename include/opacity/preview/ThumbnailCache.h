@@ -0,0 +1,124 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "opacity/core/Path.h"
+
+namespace opacity::preview
+{
+    /**
+     * @brief Identifies one thumbnail of one version of a file
+     *
+     * The file id survives renames and moves within a volume; the
+     * modification time and size make an edited file miss.
+     */
+    struct ThumbnailKey
+    {
+        uint64_t volume = 0;        // Volume serial; 0 when file_id is a hash of the path
+        uint64_t file_id = 0;
+        int64_t modified = 0;       // FILETIME ticks
+        uint64_t size = 0;
+        uint32_t edge = 0;          // Longest side of the thumbnail, in pixels
+    };
+
+    /**
+     * @brief Encoded thumbnails kept on disk between runs
+     *
+     * Thumbnails are appended to one packed data file, so a hit is a single
+     * read however many files a folder holds. The index of what is where is
+     * written beside it now and then and on Flush(); records appended after
+     * the index was last written are found again by reading their headers
+     * on Open(), and a torn record at the end is cut off. Replaced records
+     * stay in the file until it outgrows its budget, when it is rewritten
+     * with the most recent thumbnails only.
+     *
+     * Safe to use from several threads.
+     */
+    class ThumbnailCache
+    {
+    public:
+        explicit ThumbnailCache(core::Path directory, uint64_t max_bytes = 512ull * 1024 * 1024);
+        ~ThumbnailCache();
+
+        // Disable copy
+        ThumbnailCache(const ThumbnailCache&) = delete;
+        ThumbnailCache& operator=(const ThumbnailCache&) = delete;
+
+        /**
+         * @brief Open or create the cache files
+         * @return false if the directory cannot be written; the cache then
+         *         stays empty
+         */
+        bool Open();
+
+        /**
+         * @brief Read the thumbnail stored for key
+         * @return false on a miss, including an older version of the file
+         */
+        bool Find(const ThumbnailKey& key, std::vector<uint8_t>& encoded);
+
+        /**
+         * @brief Store an encoded thumbnail, replacing any for the same file
+         *        and edge
+         */
+        bool Store(const ThumbnailKey& key, const uint8_t* encoded, size_t length);
+
+        /**
+         * @brief Write the index so the next Open() need not scan
+         */
+        void Flush();
+
+        size_t GetEntryCount() const;
+        uint64_t GetFileBytes() const;
+
+    private:
+        struct Slot
+        {
+            uint64_t volume;
+            uint64_t file_id;
+            uint32_t edge;
+
+            bool operator==(const Slot& other) const
+            {
+                return volume == other.volume && file_id == other.file_id && edge == other.edge;
+            }
+        };
+
+        struct SlotHash
+        {
+            size_t operator()(const Slot& slot) const;
+        };
+
+        struct Entry
+        {
+            int64_t modified;
+            uint64_t size;
+            uint64_t offset;            // Of the encoded bytes, past the record header
+            uint32_t length;
+            uint32_t checksum;
+        };
+
+        void InsertLocked(const Slot& slot, const Entry& entry);
+        bool LoadIndexLocked(uint64_t& covered);
+        uint64_t ScanLocked(uint64_t from, uint64_t file_size);
+        bool OpenDataLocked();
+        void WriteIndexLocked();
+        void CompactLocked();
+
+        core::Path directory_;
+        uint64_t max_bytes_;
+
+        mutable std::mutex mutex_;
+        std::fstream data_;
+        bool open_ = false;
+        uint64_t end_ = 0;              // Where the next record goes
+        uint64_t live_bytes_ = 0;       // Records the index points at
+        size_t unindexed_ = 0;          // Stores since the index was written
+        std::unordered_map<Slot, Entry, SlotHash> entries_;
+    };
+
+} // namespace opacity::preview
@@ -0,0 +1,181 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "opacity/preview/DocumentPreviewHandler.h"
+#include "opacity/preview/ImagePreviewHandler.h"
+#include "opacity/preview/MediaPreviewHandler.h"
+#include "opacity/preview/TextureManager.h"
+#include "opacity/preview/ThumbnailCache.h"
+#include "opacity/core/Path.h"
+#include "opacity/core/MemoryGovernor.h"
+
+// Forward declare WIC types
+struct IWICImagingFactory;
+
+namespace opacity::preview
+{
+    /**
+     * @brief A thumbnail for one file; texture is null when the file has
+     *        none (unsupported, unreadable or online-only), and is drawn
+     *        once it is resident
+     */
+    struct Thumbnail
+    {
+        TexturePtr texture;
+        int width = 0;
+        int height = 0;
+    };
+
+    /**
+     * @brief Shared with whoever draws it; the atlas cell is freed with the
+     *        last reference, so hold it until the frame has been presented
+     */
+    using ThumbnailPtr = std::shared_ptr<const Thumbnail>;
+
+    /**
+     * @brief Thumbnails for the icons view
+     *
+     * Get() never blocks: it returns what is in memory, or queues the file
+     * and returns null until a later frame. Workers run in background mode,
+     * which lowers their I/O priority as well as their CPU priority, and
+     * take the request of lowest priority first, the newest among equals,
+     * so whatever is on screen now goes ahead of what is only near it.
+     * A request has to be renewed every frame; BeginFrame cancels those
+     * nobody asked for again, so cells scrolled out of view stop waiting.
+     *
+     * Each thumbnail is generated once per file version at one of a few
+     * fixed edges, then kept in a ThumbnailCache as JPEG (PNG where it has
+     * transparency); reopening a folder only reads those back. Images,
+     * videos and documents come from the matching preview handlers.
+     *
+     * Pixels go to a TextureManager; a thumbnail whose cell is evicted is
+     * dropped from memory and made again from the disk cache.
+     */
+    class ThumbnailService
+    {
+    public:
+        static constexpr int kSmallEdge = 64;
+        static constexpr int kMediumEdge = 128;
+        static constexpr int kLargeEdge = 256;
+
+        explicit ThumbnailService(core::Path cache_directory = DefaultCacheDirectory());
+        ~ThumbnailService();
+
+        // Disable copy
+        ThumbnailService(const ThumbnailService&) = delete;
+        ThumbnailService& operator=(const ThumbnailService&) = delete;
+
+        /**
+         * @brief Open the disk cache and start the workers
+         */
+        void Initialize(TextureManager* textures);
+
+        /**
+         * @brief Stop the workers and drop every thumbnail; call before the
+         *        texture manager shuts down
+         */
+        void Shutdown();
+
+        /**
+         * @brief %LOCALAPPDATA%\Opacity\Thumbnails
+         */
+        static core::Path DefaultCacheDirectory();
+
+        /**
+         * @brief The smallest edge that covers an icon of this many pixels
+         */
+        static int EdgeFor(float pixels);
+
+        /**
+         * @brief Whether any handler can make a thumbnail of this file type
+         */
+        bool CanThumbnail(const core::Path& path) const;
+
+        /**
+         * @brief The thumbnail for a file, or null while it is being made
+         * @param modified The file's modification time as listed; a newer
+         *        one makes a new thumbnail
+         * @param priority Lower is made sooner; views pass how many rows
+         *        the item is from being visible
+         */
+        ThumbnailPtr Get(const core::Path& path, std::chrono::system_clock::time_point modified, int edge,
+                         int priority = 0);
+
+        /**
+         * @brief Cancel queued requests not renewed during the last frame;
+         *        call once at the start of every frame
+         */
+        void BeginFrame();
+
+        /**
+         * @brief Bound the thumbnails held in memory (texture bytes)
+         */
+        void SetMemoryBudget(size_t bytes);
+
+        /**
+         * @brief Drop queued work and thumbnails held in memory; the disk
+         *        cache is kept
+         */
+        void Clear();
+
+        /**
+         * @brief Thumbnails asked for and not made yet
+         */
+        size_t GetQueuedCount() const;
+
+    private:
+        struct Job
+        {
+            std::string key;
+            core::Path path;
+            int edge = 0;
+            int priority = 0;
+            uint64_t frame = 0;     // Last asked for in this frame
+        };
+
+        struct MemoryEntry
+        {
+            std::string key;
+            ThumbnailPtr thumbnail;
+            size_t bytes = 0;
+        };
+
+        void WorkerLoop();
+        ThumbnailPtr Generate(IWICImagingFactory* factory, const Job& job);
+        bool Render(const Job& job, std::vector<uint8_t>& pixels, int& width, int& height) const;
+        ThumbnailPtr Upload(std::vector<uint8_t> pixels, int width, int height) const;
+        void StoreLocked(const std::string& key, const ThumbnailPtr& thumbnail);
+        void EvictLocked(size_t limit);
+
+        ImagePreviewHandler image_handler_;
+        MediaPreviewHandler media_handler_;
+        DocumentPreviewHandler document_handler_;
+        ThumbnailCache cache_;
+        std::once_flag cache_opened_;              // By the first worker to start
+        TextureManager* textures_ = nullptr;
+
+        mutable std::mutex mutex_;
+        std::condition_variable wake_;
+        std::list<Job> queue_;                      // Newest first
+        std::unordered_map<std::string, std::list<Job>::iterator> queued_;     // Queued, or being made (end()), by key
+        uint64_t frame_ = 0;
+        std::vector<std::thread> workers_;
+        bool stop_ = false;
+
+        std::list<MemoryEntry> memory_;             // Most recently drawn first
+        std::unordered_map<std::string, std::list<MemoryEntry>::iterator> memory_index_;
+        size_t memory_bytes_ = 0;
+        size_t memory_budget_ = 128 * 1024 * 1024;
+
+        core::MemoryGovernor::Registration governed_;
+    };
+
+} // namespace opacity::preview
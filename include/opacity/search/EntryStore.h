@@ -0,0 +1,220 @@
+#pragma once
+
+#include "opacity/search/SearchIndex.h"
+#include "opacity/search/TrigramIndex.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::search
+{
+    /**
+     * @brief Convert between time points and the index's microsecond timestamps
+     */
+    inline int64_t ToIndexTime(std::chrono::system_clock::time_point time)
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+    }
+
+    inline std::chrono::system_clock::time_point FromIndexTime(int64_t micros)
+    {
+        return std::chrono::system_clock::time_point(
+            std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(micros)));
+    }
+
+    /**
+     * @brief Fixed-size in-memory record for one indexed path
+     *
+     * Paths are not stored per entry: the parent directory is an id into
+     * the shared directory table and the filename lives in a string arena.
+     */
+    struct CompactEntry
+    {
+        uint32_t parentDir = 0;         // Index into the directory table
+        uint32_t nameOffset = 0;        // Filename offset in the string arena
+        uint16_t nameLength = 0;
+        uint16_t extensionId = 0;       // Interned extension
+        uint32_t contentHash = 0;
+        uint64_t size = 0;
+        int64_t modifiedTime = 0;       // Microseconds since epoch
+        int64_t indexedTime = 0;        // Microseconds since epoch
+        uint32_t flags = 0;
+
+        static constexpr uint32_t kDirectory = 1u << 0;
+        static constexpr uint32_t kRemoved = 1u << 1;
+
+        bool IsDirectory() const { return (flags & kDirectory) != 0; }
+        bool IsRemoved() const { return (flags & kRemoved) != 0; }
+    };
+
+    /**
+     * @brief Compact storage for index entries addressed by DocId
+     *
+     * Provides:
+     * - Interned parent directories and extensions
+     * - Filenames packed into a single arena
+     * - Open-addressed path lookup (4 bytes per slot)
+     * - Owned or externally mapped content per document
+     *
+     * DocIds are assigned in insertion order and stay stable until Compact().
+     * Not thread-safe; SearchIndex guards it with its entries lock.
+     */
+    class EntryStore
+    {
+    public:
+        EntryStore();
+
+        /**
+         * @brief Add an entry (the path must not already be present)
+         * @return DocId of the new record
+         */
+        DocId Insert(IndexEntry&& entry);
+
+        /**
+         * @brief Tombstone a record and drop its content
+         */
+        bool Remove(DocId doc);
+
+        /**
+         * @brief Look up a live document by path
+         */
+        std::optional<DocId> Find(const std::filesystem::path& path) const;
+
+        /**
+         * @brief All live documents anywhere below a directory
+         */
+        std::vector<DocId> FindUnder(const std::filesystem::path& dir) const;
+
+        /**
+         * @brief Sizes of a directory and of each interned directory below,
+         *        summed in one pass over the records
+         * @return The directory first; empty if it is not in the store
+         */
+        std::vector<DirectorySize> DirectorySizesUnder(const std::filesystem::path& dir) const;
+
+        /**
+         * @brief Check if a DocId refers to a live record
+         */
+        bool IsLive(DocId doc) const
+        {
+            return doc < records_.size() && !records_[doc].IsRemoved();
+        }
+
+        /**
+         * @brief Number of live records
+         */
+        size_t Size() const { return liveCount_; }
+
+        /**
+         * @brief Number of allocated DocIds, live or removed
+         */
+        size_t DocCount() const { return records_.size(); }
+
+        const CompactEntry& Record(DocId doc) const { return records_[doc]; }
+        std::string_view Filename(DocId doc) const;
+        const std::string& Extension(DocId doc) const { return extensions_[records_[doc].extensionId]; }
+        std::filesystem::path Path(DocId doc) const;
+
+        /**
+         * @brief All interned extensions, indexed by CompactEntry::extensionId
+         */
+        const std::vector<std::string>& Extensions() const { return extensions_; }
+
+        /**
+         * @brief Content of a document (owned or mapped), empty if none
+         */
+        std::string_view Content(DocId doc) const;
+
+        /**
+         * @brief Reference content that lives outside the store (e.g. a mapped file)
+         */
+        void SetMappedContent(DocId doc, std::string_view content);
+
+        /**
+         * @brief Drop references to externally mapped content
+         */
+        void ClearMappedContent() { mappedContent_.clear(); }
+
+        /**
+         * @brief Number of documents with content
+         */
+        size_t ContentCount() const { return ownedContent_.size() + mappedContent_.size(); }
+
+        /**
+         * @brief Rebuild the public IndexEntry view of a record
+         */
+        IndexEntry Materialize(DocId doc, bool withContent = true) const;
+
+        /**
+         * @brief Calls fn(DocId) for every live record in DocId order
+         */
+        template <typename Fn>
+        void ForEach(Fn&& fn) const
+        {
+            for (DocId doc = 0; doc < records_.size(); ++doc) {
+                if (!records_[doc].IsRemoved()) fn(doc);
+            }
+        }
+
+        /**
+         * @brief Drop removed records and renumber live ones densely
+         * @return Old DocId -> new DocId (kNoDoc for dropped records)
+         */
+        std::vector<DocId> Compact();
+
+        /**
+         * @brief Remove everything
+         */
+        void Clear();
+
+        /**
+         * @brief Approximate heap memory used by the store (excluding content)
+         */
+        size_t MemoryUsage() const;
+
+    private:
+        struct DirNode
+        {
+            uint32_t parent;
+            uint32_t nameOffset;
+            uint32_t nameLength;
+        };
+
+        static constexpr uint32_t kNoDir = ~uint32_t{0};
+
+        uint32_t InternDirectory(const std::filesystem::path& dir);
+        std::optional<uint32_t> FindDirectory(const std::filesystem::path& dir) const;
+        std::filesystem::path DirectoryPath(uint32_t dir) const;
+        uint16_t InternExtension(const std::string& extension);
+        uint32_t AppendName(std::string_view name);
+
+        // Path lookup table (linear probing, backward-shift deletion)
+        static uint64_t HashKey(uint32_t parent, std::string_view name);
+        uint64_t HashOf(DocId doc) const;
+        void LookupInsert(DocId doc);
+        void LookupErase(DocId doc);
+        void LookupGrow();
+
+        std::vector<CompactEntry> records_;
+        size_t liveCount_ = 0;
+
+        std::string arena_;
+        std::vector<DirNode> dirs_;
+        std::unordered_map<std::string, uint32_t> dirIds_;
+        std::vector<std::string> extensions_;
+        std::unordered_map<std::string, uint16_t> extensionIds_;
+
+        std::vector<DocId> slots_;
+        size_t slotMask_ = 0;
+
+        std::unordered_map<DocId, std::string> ownedContent_;
+        std::unordered_map<DocId, std::string_view> mappedContent_;
+    };
+
+} // namespace opacity::search
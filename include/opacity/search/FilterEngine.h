@@ -1,12 +1,202 @@
 #pragma once
 
+#include "opacity/filesystem/FsItem.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
 namespace opacity::search
 {
+    /**
+     * @brief Bitmap over item positions
+     *
+     * Reset() keeps the storage, so re-filtering the same view does not
+     * allocate.
+     */
+    class Selection
+    {
+    public:
+        void Reset(size_t size, bool value);
+
+        size_t Size() const { return size_; }
+        bool Test(size_t index) const { return (words_[index >> 6] >> (index & 63)) & 1; }
+        void Set(size_t index) { words_[index >> 6] |= uint64_t{1} << (index & 63); }
+        void Clear(size_t index) { words_[index >> 6] &= ~(uint64_t{1} << (index & 63)); }
+
+        /**
+         * @brief Number of selected items
+         */
+        size_t Count() const;
+
+        /**
+         * @brief Call fn(index) for every selected item in order
+         */
+        template <typename Fn>
+        void ForEach(Fn&& fn) const
+        {
+            for (size_t w = 0; w < words_.size(); ++w) {
+                uint64_t bits = words_[w];
+                while (bits) {
+                    fn(w * 64 + CountTrailingZeros(bits));
+                    bits &= bits - 1;
+                }
+            }
+        }
+
+        /**
+         * @brief Write the selected positions into indices (reusing its storage)
+         */
+        void ToIndices(std::vector<uint32_t>& indices) const;
+
+        std::vector<uint64_t>& Words() { return words_; }
+        const std::vector<uint64_t>& Words() const { return words_; }
+
+    private:
+        static size_t CountTrailingZeros(uint64_t bits);
+
+        std::vector<uint64_t> words_;
+        size_t size_ = 0;
+    };
+
+    /**
+     * @brief Column-oriented copy of the item fields filters test
+     *
+     * Built once per listing; compiled filters then scan tight arrays
+     * instead of chasing FsItem strings, and return selections instead of
+     * copies.
+     */
+    class ItemColumns
+    {
+    public:
+        // Tag ids for a path (e.g. from TagManager::getTagsForFile)
+        using TagLookup = std::function<std::vector<std::string>(const std::string& path)>;
+
+        void Build(const std::vector<filesystem::FsItem>& items, const TagLookup& tags = nullptr);
+
+        size_t Size() const { return sizes_.size(); }
+
+        std::string_view Name(size_t index) const
+        {
+            return std::string_view(names_).substr(nameOffsets_[index], nameOffsets_[index + 1] - nameOffsets_[index]);
+        }
+
+    private:
+        friend class FilterProgram;
+
+        std::string names_;                     // Concatenated names
+        std::vector<uint32_t> nameOffsets_;     // Size() + 1 entries
+        std::vector<uint32_t> extensionIds_;
+        std::unordered_map<std::string, uint32_t> extensionDictionary_;     // Lowercase, no dot
+        std::vector<uint64_t> sizes_;
+        std::vector<int64_t> modified_;         // Microseconds since the Unix epoch
+        std::vector<uint32_t> attributes_;
+        Selection directories_;
+        std::unordered_map<std::string, Selection> tags_;
+    };
+
+    /**
+     * @brief What to keep; every set condition must hold
+     */
+    struct FilterSpec
+    {
+        // * and ? wildcards; a pattern without them matches anywhere in the name
+        std::vector<std::string> namePatterns;
+        bool caseSensitive = false;
+        std::vector<std::string> extensions;    // Any of; with or without the dot
+        std::optional<uint64_t> minSize;
+        std::optional<uint64_t> maxSize;
+        std::optional<std::chrono::system_clock::time_point> modifiedAfter;
+        std::optional<std::chrono::system_clock::time_point> modifiedBefore;
+        uint32_t requiredAttributes = 0;        // FsItem::ATTR_* bits
+        uint32_t excludedAttributes = 0;
+        bool includeFiles = true;
+        bool includeDirectories = true;
+        std::vector<std::string> includeTags;   // Must have all
+        std::vector<std::string> excludeTags;   // Must have none
+        std::vector<std::string> anyOfTags;     // Must have at least one
+    };
+
+    /**
+     * @brief A compiled filter
+     *
+     * Conditions run cheapest first, each narrowing the selection a 64-item
+     * word at a time; name patterns only visit items that are still in.
+     */
+    class FilterProgram
+    {
+    public:
+        /**
+         * @brief True if the program keeps every item
+         */
+        bool IsEmpty() const { return ops_.empty(); }
+
+        void Evaluate(const ItemColumns& columns, Selection& selection) const;
+
+    private:
+        friend class FilterEngine;
+
+        enum class OpKind
+        {
+            Type,
+            Attributes,
+            Size,
+            Modified,
+            Extension,
+            Tags,
+            Name
+        };
+
+        struct Op
+        {
+            OpKind kind = OpKind::Type;
+            uint64_t low = 0;                   // Range bounds, masks or modes, by kind
+            uint64_t high = 0;
+            int64_t after = 0;
+            int64_t before = 0;
+            std::vector<std::string> values;    // Extensions, tags or name patterns
+        };
+
+        void Apply(const Op& op, const ItemColumns& columns, Selection& selection) const;
+
+        std::vector<Op> ops_;
+        bool caseSensitive_ = false;
+    };
+
+    /**
+     * @brief Compiles filters for file listings
+     */
     class FilterEngine
     {
     public:
-        FilterEngine() = default;
-        ~FilterEngine() = default;
+        static FilterProgram Compile(const FilterSpec& spec);
+
+        /**
+         * @brief Parse a filter expression
+         *
+         * Whitespace-separated terms, all of which must hold:
+         *   ext:cpp,h            extension is any of
+         *   size:>10M size:1K..4M  sizes with K/M/G suffixes (1024-based)
+         *   modified:>2024-01-31 modified:2024-01-01..2024-02-01  local dates
+         *   attr:r-h             attributes r h s a c e; - excludes
+         *   type:file type:dir
+         *   tag:a  tag:a|b  -tag:a   all of, any of, none of
+         *   anything else        name pattern ("quotes" keep spaces)
+         *
+         * @return std::nullopt with error set for malformed terms
+         */
+        static std::optional<FilterSpec> Parse(std::string_view expression, std::string* error = nullptr);
+
+        /**
+         * @brief Parse and compile an expression
+         */
+        static std::optional<FilterProgram> Compile(std::string_view expression, std::string* error = nullptr);
     };
 
 } // namespace opacity::search
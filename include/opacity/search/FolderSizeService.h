@@ -0,0 +1,132 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace opacity::search
+{
+    class SearchIndex;
+
+    /**
+     * @brief Recursive size of one folder
+     */
+    struct FolderSize
+    {
+        uint64_t bytes = 0;
+        uint64_t files = 0;
+        uint64_t folders = 0;           // Every folder below, at any depth
+        bool stale = false;             // Saved by an earlier session and not measured since
+    };
+
+    /**
+     * @brief One subfolder, as FolderSizeService::GetChildren lists it
+     */
+    struct FolderEntry
+    {
+        std::filesystem::path path;
+        FolderSize size;
+    };
+
+    /**
+     * @brief Recursive folder sizes for the details view
+     *
+     * Get() never blocks: it returns the cached size, or queues the folder
+     * and returns nothing until a later frame. As with thumbnails, a
+     * request has to be renewed every frame; BeginFrame drops those nobody
+     * asked for again, so folders scrolled out of view stop waiting.
+     *
+     * A folder is measured straight from the SearchIndex when one is set
+     * and holds the whole subtree, and otherwise by a parallel IndexCrawler
+     * walk at background priority. Either way every folder below is
+     * recorded as well, so opening a subfolder afterwards costs nothing.
+     *
+     * Sizes are kept current from deltas rather than by measuring again.
+     * Walked trees are watched recursively through FileWatch, and changes
+     * the index applies from the USN journal arrive through its update
+     * callback. A changed folder's own files are listed again and the
+     * difference is added to every cached folder above it; a folder that
+     * has gone takes its subtree and its total with it.
+     *
+     * Sizes are saved between sessions. What is loaded is shown at once,
+     * marked stale, and measured again when asked for.
+     */
+    class FolderSizeService
+    {
+    public:
+        explicit FolderSizeService(std::filesystem::path cacheFile = DefaultCacheFile());
+        ~FolderSizeService();
+
+        // Non-copyable
+        FolderSizeService(const FolderSizeService&) = delete;
+        FolderSizeService& operator=(const FolderSizeService&) = delete;
+
+        /**
+         * @brief Start watching; the saved sizes are read by the first
+         *        measurement, off the caller's thread
+         */
+        void Initialize();
+
+        /**
+         * @brief Stop measuring and watching, and save what is known
+         */
+        void Shutdown();
+
+        /**
+         * @brief %LOCALAPPDATA%\Opacity\FolderSizes.bin
+         */
+        static std::filesystem::path DefaultCacheFile();
+
+        /**
+         * @brief Measure from this index where it can, and follow its updates
+         */
+        void SetIndex(std::shared_ptr<SearchIndex> index);
+
+        /**
+         * @brief The size of a folder, or nothing while it is measured
+         */
+        std::optional<FolderSize> Get(const std::filesystem::path& dir);
+
+        /**
+         * @brief The subfolders of a measured folder, from the cache alone
+         *
+         * Everything below a measured folder is measured with it, so this
+         * never queues anything; drilling into a tree costs no rescans.
+         *
+         * @param ownFiles Receives the files directly in dir (folders = 0)
+         * @return false when dir is not measured yet
+         */
+        bool GetChildren(const std::filesystem::path& dir, std::vector<FolderEntry>& children,
+                         FolderSize& ownFiles) const;
+
+        /**
+         * @brief Drop queued folders not asked for during the last frame;
+         *        call once at the start of every frame
+         */
+        void BeginFrame();
+
+        /**
+         * @brief Changes whenever a cached size does, so views know to
+         *        refresh the text they made from earlier answers
+         */
+        uint64_t GetGeneration() const;
+
+        /**
+         * @brief Folders asked for and not measured yet, counting the one
+         *        being measured
+         */
+        size_t GetQueuedCount() const;
+
+        /**
+         * @brief Write the cached sizes now; unchanged sizes are not rewritten
+         */
+        bool Save();
+
+    private:
+        struct Impl;
+        std::shared_ptr<Impl> impl_;        // Shared so index callbacks can tell it is gone
+    };
+
+} // namespace opacity::search
@@ -0,0 +1,132 @@
+#pragma once
+
+#include "opacity/search/SearchIndex.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/TaskScheduler.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace opacity::search
+{
+    /**
+     * @brief Tuning for a parallel crawl
+     */
+    struct CrawlOptions
+    {
+        int crawlThreads = 4;               // Directory enumeration workers
+        int contentThreads = 2;             // Content extraction workers
+        size_t batchSize = 2048;            // Entries per batch handed to the sink
+        size_t contentQueueCapacity = 4096; // Files waiting for content extraction
+        bool followSymlinks = false;
+        core::BackgroundPolicy background;  // Priority and pacing for the crawl and content workers
+    };
+
+    /**
+     * @brief Hooks the crawler calls back into (from worker threads)
+     */
+    struct CrawlCallbacks
+    {
+        // Should this path become an index entry?
+        std::function<bool(const std::filesystem::path&)> shouldIndex;
+        // Should the crawler enumerate this directory?
+        std::function<bool(const std::filesystem::path&)> shouldDescend;
+        // Build an entry from cached directory metadata (no content)
+        std::function<IndexEntry(const std::filesystem::directory_entry&)> createEntry;
+        // Does this entry need its content read?
+        std::function<bool(const IndexEntry&)> wantsContent;
+        // Fill in entry content
+        std::function<void(IndexEntry&)> readContent;
+        // Receives finished entries in batches; may be called concurrently
+        std::function<void(std::vector<IndexEntry>&&)> sink;
+        // Periodic progress; calls are serialized
+        std::function<void(const std::filesystem::path& current, size_t processed, size_t discovered)> progress;
+    };
+
+    /**
+     * @brief Work-stealing parallel directory crawler
+     *
+     * Each crawl worker owns a deque of directories: it pushes subdirectories
+     * it discovers to the back and pops from the back (depth-first, cache
+     * friendly), while idle workers steal from the front of other deques
+     * (breadth, large subtrees). Text files are handed to a separate bounded
+     * content pool so slow reads rarely stall enumeration, and finished
+     * entries reach the sink in batches instead of one lock per file.
+     *
+     * Workers are tasks on the shared scheduler helping the calling
+     * thread, which crawls and extracts too, so a busy pool slows a crawl
+     * down rather than stalling it.
+     */
+    class IndexCrawler
+    {
+    public:
+        IndexCrawler(CrawlOptions options, CrawlCallbacks callbacks);
+        ~IndexCrawler();
+
+        // Non-copyable
+        IndexCrawler(const IndexCrawler&) = delete;
+        IndexCrawler& operator=(const IndexCrawler&) = delete;
+
+        /**
+         * @brief Crawl all roots and block until finished or cancelled
+         */
+        void Run(const std::vector<std::filesystem::path>& roots, const std::atomic<bool>& cancel);
+
+        /**
+         * @brief Index entries that were enumerated elsewhere (e.g. from the MFT)
+         *
+         * Skips directory enumeration: entries that want content go through
+         * the content pool, the rest straight to the sink.
+         */
+        void Ingest(std::vector<IndexEntry>&& entries, const std::atomic<bool>& cancel);
+
+        size_t ProcessedCount() const { return processed_; }
+        size_t DiscoveredCount() const { return discovered_; }
+
+    private:
+        struct WorkerQueue
+        {
+            std::mutex mutex;
+            std::deque<std::filesystem::path> dirs;
+        };
+
+        core::TaskOptions WorkerOptions() const;
+        void StartContentWorkers(core::TaskGroup& workers, const std::atomic<bool>& cancel);
+        void FinishContentWorkers(core::TaskGroup& workers, const std::atomic<bool>& cancel);
+        void CrawlWorker(size_t index, const std::atomic<bool>& cancel);
+        void ContentWorker(const std::atomic<bool>& cancel);
+        void ProcessDirectory(size_t index, const std::filesystem::path& dir,
+                              std::vector<IndexEntry>& batch, const std::atomic<bool>& cancel);
+        void PushDirectory(size_t index, std::filesystem::path dir);
+        bool PopDirectory(size_t index, std::filesystem::path& dir);
+        bool StealDirectory(size_t index, std::filesystem::path& dir);
+        bool PushContent(IndexEntry&& entry, std::vector<IndexEntry>& batch, const std::atomic<bool>& cancel);
+        void ExtractContent(IndexEntry&& entry, std::vector<IndexEntry>& batch);
+        void Flush(std::vector<IndexEntry>& batch);
+        void ReportProgress(const std::filesystem::path& current);
+
+        CrawlOptions options_;
+        CrawlCallbacks callbacks_;
+
+        std::vector<std::unique_ptr<WorkerQueue>> queues_;
+        std::atomic<size_t> pendingDirs_{0};
+        std::mutex idleMutex_;
+        std::condition_variable idleCv_;
+
+        std::mutex contentMutex_;
+        std::condition_variable contentNotEmpty_;
+        std::deque<IndexEntry> contentQueue_;
+        bool crawlDone_ = false;
+
+        std::atomic<size_t> processed_{0};
+        std::atomic<size_t> discovered_{0};
+        std::mutex progressMutex_;
+    };
+
+} // namespace opacity::search
@@ -0,0 +1,168 @@
+#pragma once
+
+#include "opacity/search/SearchIndex.h"
+
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace opacity::search
+{
+    /**
+     * @brief One hit from IndexClient::QuickSearch
+     *
+     * path points into the buffer shared with the host and stays valid
+     * only until the visitor returns.
+     */
+    struct HostedEntry
+    {
+        std::string_view path;          // UTF-8
+        uint64_t size = 0;
+        std::chrono::system_clock::time_point modifiedTime;
+        bool isDirectory = false;
+    };
+
+    /**
+     * @brief What the host process has indexed
+     */
+    struct HostStatus
+    {
+        uint32_t processId = 0;
+        size_t totalFiles = 0;
+        size_t totalDirectories = 0;
+        bool indexing = false;
+        std::chrono::system_clock::time_point lastUpdate;
+        std::vector<std::filesystem::path> roots;
+    };
+
+    /**
+     * @brief Serves one SearchIndex to every Opacity process of the session
+     *
+     * Clients connect to a named pipe only the current user can write to
+     * and only this machine can reach. Each connection gets a section of
+     * shared memory that the host fills with the results of every query;
+     * the pipe carries only the request and the size of the answer, and
+     * the client reads the paths in place rather than receiving copies.
+     * The section grows, under a new name, when an answer does not fit.
+     *
+     * Every connection is served on its own thread; the index is safe to
+     * query from several at once.
+     */
+    class IndexHost
+    {
+    public:
+        explicit IndexHost(std::shared_ptr<SearchIndex> index);
+        ~IndexHost();
+
+        // Non-copyable
+        IndexHost(const IndexHost&) = delete;
+        IndexHost& operator=(const IndexHost&) = delete;
+
+        /**
+         * @brief Start accepting connections
+         * @return false when another process is hosting already
+         */
+        bool Start();
+
+        /**
+         * @brief Drop every connection and stop accepting
+         */
+        void Stop();
+
+        bool IsRunning() const;
+
+        /**
+         * @brief Clients connected now
+         */
+        size_t GetClientCount() const;
+
+        /**
+         * @brief \\.\pipe\Opacity.IndexHost.<session>, one per logon session
+         */
+        static std::string PipeName();
+
+    private:
+        struct Impl;
+        std::shared_ptr<Impl> impl_;
+    };
+
+    /**
+     * @brief A connection to the IndexHost of this session
+     *
+     * Calls block on the host's answer and are meant for worker threads;
+     * one call at a time, the rest wait for it. A call that fails because
+     * the host went away leaves the client disconnected; Connect again to
+     * find a new one.
+     */
+    class IndexClient
+    {
+    public:
+        IndexClient();
+        ~IndexClient();
+
+        // Non-copyable
+        IndexClient(const IndexClient&) = delete;
+        IndexClient& operator=(const IndexClient&) = delete;
+
+        /**
+         * @brief Connect to the host, waiting up to timeout for a free pipe
+         * @return false when no host is running
+         */
+        bool Connect(std::chrono::milliseconds timeout = std::chrono::milliseconds(200));
+
+        void Disconnect();
+
+        bool IsConnected() const;
+
+        /**
+         * @brief Whether a host is running, without connecting to it
+         */
+        static bool IsHostRunning();
+
+        /**
+         * @brief Type-ahead filename search on the host's index
+         * @param scope Only hits at or below this folder; empty for all
+         * @param visit Called for every hit, best first; return false to stop
+         * @param complete Set when the hits are all there are: the host's
+         *        index is built, covers scope, and was not cut short
+         * @return false when the host could not be asked
+         */
+        bool QuickSearch(const std::string& pattern, const QuickSearchOptions& options,
+                         const std::filesystem::path& scope,
+                         const std::function<bool(const HostedEntry& entry)>& visit, bool* complete = nullptr);
+
+        /**
+         * @brief Paths of QuickSearch's hits, copied out of the shared buffer
+         */
+        std::vector<std::filesystem::path> QuickSearch(const std::string& pattern,
+                                                       const QuickSearchOptions& options,
+                                                       const std::filesystem::path& scope = {});
+
+        /**
+         * @brief SearchIndex::GetDirectorySizes, asked of the host
+         * @return Empty when the host's index cannot answer or is not there
+         */
+        std::vector<DirectorySize> GetDirectorySizes(const std::filesystem::path& dir);
+
+        /**
+         * @brief What the host has indexed, or nothing when it is not there
+         */
+        std::optional<HostStatus> GetStatus();
+
+        /**
+         * @brief Ask the host to bring its index up to date, without waiting
+         */
+        bool RequestUpdate();
+
+    private:
+        struct Impl;
+        std::unique_ptr<Impl> impl_;
+    };
+
+} // namespace opacity::search
@@ -0,0 +1,130 @@
+#pragma once
+
+#include "opacity/search/TrigramIndex.h"     // DocId
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace opacity::search
+{
+    /**
+     * @brief How a name query matches filenames
+     */
+    enum class NameMatchMode
+    {
+        Prefix,         // Name starts with the query
+        Substring,      // Name contains the query
+        Fuzzy           // Some prefix of the name is within maxDistance edits of the query
+    };
+
+    /**
+     * @brief What one name query carries over to the next keystroke
+     *
+     * When the next query extends this one, its matches are a subset of
+     * these, so only the remembered terms are re-checked.
+     */
+    struct NameQueryState
+    {
+        std::string query;                  // Case-folded
+        NameMatchMode mode = NameMatchMode::Substring;
+        int maxDistance = 0;
+        uint64_t generation = 0;            // NameIndex::Generation() the terms refer to
+        bool complete = false;              // terms holds every match
+        std::vector<std::pair<uint32_t, uint8_t>> terms;    // Term id, edit distance
+    };
+
+    /**
+     * @brief Filename dictionary for type-ahead queries
+     *
+     * Distinct case-folded names are kept sorted, each with the documents
+     * that carry it, so prefixes are a binary search and fuzzy matching
+     * walks the list as an implicit trie (shared prefixes share their
+     * Levenshtein rows, and hopeless prefixes skip their whole range).
+     * Substrings scan the packed term arena, which holds each distinct
+     * name once.
+     *
+     * Names added after the last merge sit in a small unsorted delta that
+     * is folded in once it grows; removal is a tombstone per DocId.
+     */
+    class NameIndex
+    {
+    public:
+        NameIndex() = default;
+
+        void Add(DocId doc, std::string_view name);
+        void Remove(DocId doc);
+
+        /**
+         * @brief Fold pending names into the sorted dictionary
+         */
+        void Merge();
+
+        void Clear();
+
+        /**
+         * @brief Documents matching a query, best first
+         *
+         * Results are ordered by edit distance, then name. For fuzzy
+         * queries the distance is also capped by query length (none up to 2
+         * bytes, 1 up to 5) and the first byte must match, so short input
+         * does not match everything.
+         *
+         * @param state Optional state from the previous keystroke; updated
+         */
+        std::vector<DocId> Query(std::string_view query, NameMatchMode mode, size_t maxResults,
+                                 int maxDistance = 2, NameQueryState* state = nullptr) const;
+
+        /**
+         * @brief Changes whenever term ids are reassigned
+         */
+        uint64_t Generation() const { return generation_; }
+
+        size_t TermCount() const { return termOffsets_.empty() ? 0 : termOffsets_.size() - 1; }
+        size_t PendingCount() const { return delta_.size(); }
+        size_t MemoryUsage() const;
+
+        /**
+         * @brief Smallest edit distance between query and any prefix of name
+         */
+        static int PrefixDistance(std::string_view query, std::string_view name, int limit);
+
+    private:
+        std::string_view Term(uint32_t term) const
+        {
+            return std::string_view(terms_).substr(termOffsets_[term], termOffsets_[term + 1] - termOffsets_[term]);
+        }
+
+        bool IsRemoved(DocId doc) const
+        {
+            return doc < removed_.size() && removed_[doc];
+        }
+
+        uint32_t RangeEnd(uint32_t from, std::string_view prefix) const;
+
+        // Each returns false if it stopped at termLimit
+        bool FindPrefix(std::string_view query, size_t termLimit,
+                        std::vector<std::pair<uint32_t, uint8_t>>& out) const;
+        bool FindSubstring(std::string_view query, size_t termLimit,
+                           std::vector<std::pair<uint32_t, uint8_t>>& out) const;
+        bool FindFuzzy(std::string_view query, int maxDistance, size_t termLimit,
+                       std::vector<std::pair<uint32_t, uint8_t>>& out) const;
+
+        // Sorted, distinct, case-folded names and their postings
+        std::string terms_;
+        std::vector<uint32_t> termOffsets_;     // TermCount() + 1 entries
+        std::vector<uint32_t> postingOffsets_;  // TermCount() + 1 entries
+        std::vector<DocId> postings_;
+
+        // Added since the last merge
+        std::vector<std::pair<DocId, std::string>> delta_;
+
+        std::vector<bool> removed_;
+        size_t removedCount_ = 0;
+        uint64_t generation_ = 0;
+    };
+
+} // namespace opacity::search
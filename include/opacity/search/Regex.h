@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace opacity::search
+{
+    struct RegexProgram;
+
+    /**
+     * @brief Compiled regular expression with linear-time matching
+     *
+     * Patterns compile to a Thompson NFA that is simulated breadth-first
+     * (Pike VM), so matching is O(text * pattern) for every input; there is
+     * no backtracking and no pattern can stall a search.
+     *
+     * Supported syntax: literals, ., [...] / [^...] classes with ranges,
+     * \d \w \s (and negations), \b \B, ^ $ (line anchors), groups (...) and
+     * (?:...), alternation, and the quantifiers * + ? {n} {n,} {n,m} with
+     * optional lazy ?. Backreferences and lookaround are rejected.
+     * Matching is byte-oriented; case folding covers ASCII.
+     *
+     * Copies share the compiled program and are safe to use from several
+     * threads at once.
+     */
+    class Regex
+    {
+    public:
+        using Match = std::pair<size_t, size_t>;   // Offset, length
+
+        /**
+         * @brief Compile a pattern
+         * @param error Receives a message when compilation fails
+         * @return std::nullopt for invalid or oversized patterns
+         */
+        static std::optional<Regex> Compile(std::string_view pattern, bool caseSensitive,
+                                            std::string* error = nullptr);
+
+        /**
+         * @brief Leftmost match starting at or after from (Perl-style preference)
+         */
+        std::optional<Match> Find(std::string_view text, size_t from = 0) const;
+
+        /**
+         * @brief Check if the pattern matches anywhere in text
+         */
+        bool Search(std::string_view text) const;
+
+        /**
+         * @brief All non-overlapping matches, up to limit (0 = no limit)
+         */
+        std::vector<Match> FindAll(std::string_view text, size_t limit = 0) const;
+
+        /**
+         * @brief Literals that every match must contain
+         *
+         * Usable as a prefilter (e.g. through a trigram index) before the
+         * pattern itself runs.
+         */
+        const std::vector<std::string>& RequiredLiterals() const;
+
+        /**
+         * @brief Cheap check that text contains all required literals
+         */
+        bool MayMatch(std::string_view text) const;
+
+    private:
+        explicit Regex(std::shared_ptr<const RegexProgram> program);
+
+        std::shared_ptr<const RegexProgram> program_;
+    };
+
+} // namespace opacity::search
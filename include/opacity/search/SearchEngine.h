@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 #include <atomic>
@@ -8,6 +9,8 @@
 #include <mutex>
 #include "opacity/filesystem/FsItem.h"
 #include "opacity/core/Path.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/search/Regex.h"
 
 namespace opacity::search
 {
@@ -17,10 +20,15 @@ namespace opacity::search
     struct SearchOptions
     {
         bool case_sensitive = false;
-        bool search_contents = false;     // Search file contents (slower)
+        bool use_regex = false;           // Query is a regular expression instead of a wildcard pattern
+        bool search_contents = false;     // Also match files whose contents contain the query (slower)
+        bool read_placeholders = false;   // Search inside online-only cloud files too (downloads them)
+        bool search_archives = false;     // Also match entries of ZIP archives, by name and contents
+        bool capture_context = true;      // Copy the matching line; off, LoadContext makes it when shown
         bool include_hidden = false;
         bool recursive = true;
         size_t max_results = 1000;
+        size_t worker_threads = 0;        // Directory workers (0 = one per hardware thread)
         std::vector<std::string> extensions;  // Filter by extensions (empty = all)
     };
 
@@ -32,6 +40,8 @@ namespace opacity::search
         filesystem::FsItem item;
         std::string match_context;  // For content search, shows matching line
         size_t match_line = 0;      // Line number for content matches
+        uint64_t match_offset = 0;  // Byte offset of the match in the file
+        size_t match_length = 0;    // 0 for a match by name
     };
 
     /**
@@ -46,6 +56,13 @@ namespace opacity::search
 
     /**
      * @brief Search engine for finding files by name or content
+     *
+     * Directories are work items shared by the search task and helper tasks
+     * on the shared task scheduler, so independent subtrees are enumerated
+     * in parallel. Workers publish matches to a lock-free queue that the
+     * search task drains between directories of its own, so result
+     * callbacks always run on that one thread. Every task of a search
+     * counts toward the I/O limit of the volume searched.
      */
     class SearchEngine
     {
@@ -60,7 +77,7 @@ namespace opacity::search
         /**
          * @brief Start an asynchronous search
          * @param root_path Starting directory for the search
-         * @param query Search query (supports * and ? wildcards)
+         * @param query Search query (* and ? wildcards, or a regex with use_regex)
          * @param options Search options
          * @param result_callback Called for each result found
          * @param progress_callback Called periodically with progress updates
@@ -82,6 +99,11 @@ namespace opacity::search
          */
         bool IsSearching() const;
 
+        /**
+         * @brief Online-only files the last content search left unread
+         */
+        size_t GetPlaceholdersSkipped() const { return placeholders_skipped_; }
+
         /**
          * @brief Wait for the current search to complete
          */
@@ -108,29 +130,71 @@ namespace opacity::search
             const std::string& pattern,
             bool case_sensitive = false);
 
+        /**
+         * @brief Fill match_context of a content match found without
+         *        capture_context, by reading the file again
+         * @return false if the file changed or cannot be read; the context
+         *         stays empty
+         */
+        static bool LoadContext(SearchResult& result);
+
     private:
-        void SearchThread(
-            core::Path root_path,
-            std::string query,
-            SearchOptions options,
-            SearchResultCallback result_callback,
-            SearchProgressCallback progress_callback);
+        void SearchTask(
+            const core::Path& root_path,
+            const std::string& query,
+            const SearchOptions& options,
+            const SearchResultCallback& result_callback,
+            const SearchProgressCallback& progress_callback);
 
-        void SearchDirectory(
-            const core::Path& directory,
+        struct SearchState;
+
+        void RunSearch(
+            const core::Path& root_path,
             const std::string& query,
+            const Regex* regex,
             const SearchOptions& options,
-            SearchResultCallback result_callback,
-            size_t& files_searched,
-            size_t& matches_found);
+            const SearchResultCallback& result_callback,
+            const SearchProgressCallback& progress_callback);
+
+        void SearchWorker(SearchState& state);
+
+        // Takes one directory without waiting; false when none is queued
+        bool SearchNext(SearchState& state);
+
+        void ProcessDirectory(SearchState& state, const core::Path& directory);
+
+        void SearchDirectory(SearchState& state, const core::Path& directory);
+
+        void SearchArchive(SearchState& state, const filesystem::FsItem& archive);
+
+        static bool MatchContents(
+            const filesystem::FsItem& item,
+            const std::string& query,
+            const Regex* regex,
+            const SearchOptions& options,
+            SearchResult& result);
+
+        static bool MatchText(
+            std::string_view content,
+            const std::string& query,
+            const Regex* regex,
+            const SearchOptions& options,
+            SearchResult& result);
+
+        // The line holding a match, cut around it when very long
+        static std::string_view ContextLine(std::string_view content, size_t offset, size_t length);
+
+        // Publish a match unless max_results is already reached
+        bool PublishResult(SearchState& state, SearchResult result);
 
         bool MatchesExtensionFilter(
             const std::string& extension,
             const std::vector<std::string>& extensions) const;
 
-        std::thread search_thread_;
+        core::TaskHandle search_task_;
         std::atomic<bool> cancel_requested_{false};
         std::atomic<bool> is_searching_{false};
+        std::atomic<size_t> placeholders_skipped_{0};
         mutable std::mutex mutex_;
     };
 
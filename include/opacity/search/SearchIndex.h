@@ -1,11 +1,14 @@
 #pragma once
 
+#include "opacity/search/NameIndex.h"
+
 #include <chrono>
 #include <filesystem>
 #include <functional>
 #include <memory>
 #include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 
 namespace opacity::search
@@ -29,7 +32,7 @@ namespace opacity::search
     /**
      * @brief Search result with relevance scoring
      */
-    struct SearchResult
+    struct IndexSearchResult
     {
         IndexEntry entry;
         float score = 0.0f;             // Relevance score (0-1)
@@ -59,6 +62,16 @@ namespace opacity::search
         int maxResults = 1000;
     };
 
+    /**
+     * @brief Type-ahead filename query options
+     */
+    struct QuickSearchOptions
+    {
+        NameMatchMode mode = NameMatchMode::Substring;
+        int maxDistance = 2;            // Edits allowed in Fuzzy mode (also capped by query length)
+        int maxResults = 100;
+    };
+
     /**
      * @brief Index configuration
      */
@@ -74,9 +87,16 @@ namespace opacity::search
         bool indexContent = true;                   // Index file content
         bool indexHiddenFiles = false;
         bool followSymlinks = false;
+        bool useMftEnumeration = false;             // Rebuild NTFS roots from the MFT when elevated; opt-in,
+                                                    // as it lists names under folders the user cannot open
         
-        int maxThreads = 4;                         // Indexing threads
+        int maxThreads = 4;                         // Directory crawl threads (0 = hardware concurrency)
+        int maxContentThreads = 2;                  // Content extraction threads
         int updateIntervalSeconds = 300;            // Auto-update interval (5 min)
+
+        bool backgroundPriority = true;             // Crawl at background CPU and I/O priority
+        bool yieldToForeground = true;              // Pause while file operations or input are active
+        int foregroundIdleMs = 500;                 // Input keeps the crawl paused this long
     };
 
     /**
@@ -95,6 +115,20 @@ namespace opacity::search
         std::chrono::milliseconds lastSearchDuration{0};
     };
 
+    /**
+     * @brief File sizes summed over one directory, directly and recursively
+     */
+    struct DirectorySize
+    {
+        std::filesystem::path path;
+        uint64_t directBytes = 0;       // Files immediately inside
+        uint64_t directFiles = 0;
+        uint64_t directFolders = 0;
+        uint64_t totalBytes = 0;        // Everything below, at any depth
+        uint64_t totalFiles = 0;
+        uint64_t totalFolders = 0;
+    };
+
     /**
      * @brief Index update event
      */
@@ -111,7 +145,15 @@ namespace opacity::search
      */
     using IndexProgressCallback = std::function<void(const std::string& currentPath, double progress)>;
     using IndexUpdateCallback = std::function<void(const IndexUpdateEvent& event)>;
-    using SearchResultCallback = std::function<void(const SearchResult& result)>;
+    using IndexResultCallback = std::function<void(const IndexSearchResult& result)>;
+
+    /**
+     * @brief Streams the text of a document that is not plain text (PDF,
+     *        Office) to sink; sink returns false once it has enough
+     * @return false when the file could not be read
+     */
+    using ContentExtractor = std::function<bool(const std::filesystem::path& path,
+                                                const std::function<bool(std::string_view text)>& sink)>;
 
     /**
      * @brief Search index manager
@@ -197,12 +239,15 @@ namespace opacity::search
         /**
          * @brief Search the index
          */
-        std::vector<SearchResult> Search(const SearchQuery& query);
+        std::vector<IndexSearchResult> Search(const SearchQuery& query);
 
         /**
          * @brief Search with streaming results
+         *
+         * Hits are delivered as they are found, not in rank order; some may
+         * later be outranked and missing from Search's final top results.
          */
-        void SearchAsync(const SearchQuery& query, SearchResultCallback callback);
+        void SearchAsync(const SearchQuery& query, IndexResultCallback callback);
 
         /**
          * @brief Cancel ongoing search
@@ -211,11 +256,25 @@ namespace opacity::search
 
         /**
          * @brief Quick filename search (no content)
+         *
+         * Plain text matches anywhere in the name, names starting with it
+         * first; * and ? patterns are tested against every name.
          */
         std::vector<std::filesystem::path> QuickSearch(
             const std::string& pattern,
             int maxResults = 100);
 
+        /**
+         * @brief Type-ahead filename search through the name index
+         * @param state Keep one per input box and pass it on every keystroke;
+         *              a query that extends the previous one only re-checks
+         *              the previous matches
+         */
+        std::vector<std::filesystem::path> QuickSearch(
+            const std::string& pattern,
+            const QuickSearchOptions& options,
+            NameQueryState* state = nullptr);
+
         /**
          * @brief Check if a path is in the index
          */
@@ -223,8 +282,22 @@ namespace opacity::search
 
         /**
          * @brief Get entry from index
+         * @param withContent Also copy out the indexed text, which may be large
          */
-        std::optional<IndexEntry> GetEntry(const std::filesystem::path& path) const;
+        std::optional<IndexEntry> GetEntry(const std::filesystem::path& path, bool withContent = true) const;
+
+        /**
+         * @brief Recursive sizes of a directory and every directory below it
+         *
+         * Answered only when the index holds the whole subtree: the
+         * directory lies under a root, no extensions, directories or
+         * hidden files are filtered out, and no rebuild is running.
+         * Folders with nothing indexed inside may be missing.
+         *
+         * @return The directory first, then the rest in no order; empty
+         *         when the index cannot answer
+         */
+        std::vector<DirectorySize> GetDirectorySizes(const std::filesystem::path& dir) const;
 
         // ============== Index Management ==============
 
@@ -292,6 +365,18 @@ namespace opacity::search
          */
         void SetConfig(const IndexConfig& config);
 
+        /**
+         * @brief Index the content of files with these extensions through
+         *        extractor, as preview::DocumentTextExtractor::Extract does
+         *
+         * Such files are indexed whatever their size; the text kept from
+         * each is capped at IndexConfig::maxFileSize instead. Set before
+         * indexing starts.
+         *
+         * @param extensions Lowercase, with or without the dot
+         */
+        void SetContentExtractor(std::vector<std::string> extensions, ContentExtractor extractor);
+
         /**
          * @brief Add indexing root
          */
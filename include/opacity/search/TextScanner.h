@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstddef>
+#include <string_view>
+
+namespace opacity::search
+{
+    /**
+     * @brief Vectorized literal search with optional ASCII case folding
+     *
+     * Candidate positions are found 32 (AVX2) or 16 (SSE2) bytes at a time by
+     * testing two needle bytes at once, then verified in place. Case folding
+     * happens during the comparison, so nothing is copied or allocated; bytes
+     * outside ASCII compare exactly. The instruction set is picked once at
+     * runtime, with a scalar path for other CPUs.
+     */
+    class TextScanner
+    {
+    public:
+        enum class SimdLevel
+        {
+            Scalar,
+            Sse2,
+            Avx2
+        };
+
+        /**
+         * @brief Instruction set used by this process
+         */
+        static SimdLevel ActiveLevel();
+
+        /**
+         * @brief Offset of the first occurrence of needle at or after from
+         * @return std::string_view::npos if there is none; an empty needle matches at from
+         */
+        static size_t Find(std::string_view text, std::string_view needle,
+                           bool caseSensitive, size_t from = 0);
+
+        static bool Contains(std::string_view text, std::string_view needle, bool caseSensitive)
+        {
+            return Find(text, needle, caseSensitive) != std::string_view::npos;
+        }
+
+        /**
+         * @brief Count non-overlapping occurrences, stopping at limit (0 = no limit)
+         */
+        static size_t Count(std::string_view text, std::string_view needle,
+                            bool caseSensitive, size_t limit = 0);
+
+        static bool Equals(std::string_view a, std::string_view b, bool caseSensitive);
+
+        static bool StartsWith(std::string_view text, std::string_view prefix, bool caseSensitive)
+        {
+            return text.size() >= prefix.size() && Equals(text.substr(0, prefix.size()), prefix, caseSensitive);
+        }
+
+        /**
+         * @brief Match text against a * and ? wildcard pattern
+         *
+         * The literal runs between stars are located with Find(), so long
+         * names and patterns cost a vector scan rather than a backtracking
+         * walk.
+         */
+        static bool MatchWildcard(std::string_view text, std::string_view pattern, bool caseSensitive);
+    };
+
+} // namespace opacity::search
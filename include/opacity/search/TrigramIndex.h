@@ -0,0 +1,148 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::search
+{
+    /**
+     * @brief Document identifier used by posting lists
+     */
+    using DocId = uint32_t;
+
+    /**
+     * @brief Marks a document dropped during renumbering
+     */
+    inline constexpr DocId kNoDoc = ~DocId{0};
+
+    /**
+     * @brief Inverted trigram index over arbitrary byte strings
+     *
+     * Trigrams are case-folded (ASCII) so one index serves both
+     * case-sensitive and case-insensitive queries; the candidates it
+     * returns are a superset of the real matches and must still be
+     * verified by the caller.
+     *
+     * Document ids must be added in increasing order so posting lists
+     * stay sorted without a separate sort pass. Removal is lazy: the
+     * document is tombstoned and dropped from postings on Compact().
+     *
+     * Postings can be serialized into a flat segment and later attached
+     * (typically from a memory-mapped index file) as an immutable base
+     * layer; documents added afterwards go to an in-memory delta layer.
+     */
+    class TrigramIndex
+    {
+    public:
+        TrigramIndex() = default;
+
+        /**
+         * @brief Index all trigrams of a document
+         */
+        void Add(DocId doc, std::string_view text);
+
+        /**
+         * @brief Tombstone a document (removed from postings on Compact)
+         */
+        void Remove(DocId doc);
+
+        /**
+         * @brief Get candidate documents that contain every trigram of the query
+         * @return std::nullopt if the query is too short to be filtered
+         */
+        std::optional<std::vector<DocId>> Candidates(std::string_view query) const;
+
+        /**
+         * @brief Drop tombstoned documents from the in-memory posting lists
+         */
+        void Compact();
+
+        /**
+         * @brief Serialize all postings into a flat segment
+         * @param remap Old DocId -> new DocId; kNoDoc (or out of range) drops the document.
+         *              The mapping must be monotonic so lists stay sorted.
+         */
+        void Serialize(const std::vector<DocId>& remap, std::string& out) const;
+
+        /**
+         * @brief Use a serialized segment as the immutable base layer
+         *
+         * The segment memory is not copied and must stay valid until Clear()
+         * or destruction. Replaces any previous content.
+         */
+        bool AttachSegment(std::string_view segment);
+
+        /**
+         * @brief Check if a base segment is attached
+         */
+        bool HasSegment() const { return slots_ != nullptr; }
+
+        /**
+         * @brief Remove everything
+         */
+        void Clear();
+
+        /**
+         * @brief Number of distinct trigrams
+         */
+        size_t TrigramCount() const { return postings_.size(); }
+
+        /**
+         * @brief Approximate memory used by the posting lists
+         */
+        size_t MemoryUsage() const;
+
+        /**
+         * @brief Extract the sorted, unique, case-folded trigrams of a string
+         */
+        static std::vector<uint32_t> ExtractTrigrams(std::string_view text);
+
+        /**
+         * @brief Intersect two sorted docid lists
+         */
+        static std::vector<DocId> Intersect(const std::vector<DocId>& a, const std::vector<DocId>& b);
+
+        /**
+         * @brief Union two sorted docid lists
+         */
+        static std::vector<DocId> Union(const std::vector<DocId>& a, const std::vector<DocId>& b);
+
+    private:
+        struct SegmentHeader
+        {
+            char magic[4];
+            uint32_t trigramCount;
+        };
+
+        struct SegmentSlot
+        {
+            uint32_t trigram;
+            uint32_t count;
+            uint64_t offset;        // Index into the segment's DocId array
+        };
+
+        bool IsRemoved(DocId doc) const
+        {
+            return doc < removed_.size() && removed_[doc];
+        }
+
+        const SegmentSlot* FindSlot(uint32_t trigram) const;
+        std::vector<DocId> Postings(uint32_t trigram) const;
+
+        // Base layer (attached segment)
+        const SegmentSlot* slots_ = nullptr;
+        const DocId* segmentDocs_ = nullptr;
+        uint32_t slotCount_ = 0;
+
+        // Delta layer
+        std::unordered_map<uint32_t, std::vector<DocId>> postings_;
+        std::vector<bool> removed_;
+        size_t removedCount_ = 0;
+    };
+
+} // namespace opacity::search
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace opacity::search
+{
+    /**
+     * @brief Position in a volume's USN change journal
+     */
+    struct UsnCursor
+    {
+        std::string volume;             // Volume root, e.g. "C:\"
+        uint64_t journalId = 0;         // Changes when the journal is recreated
+        int64_t nextUsn = 0;            // First record not yet applied
+    };
+
+    /**
+     * @brief A single coalesced change read from the journal
+     */
+    struct UsnChange
+    {
+        enum class Kind { Added, Modified, Removed };
+        Kind kind = Kind::Modified;
+        std::filesystem::path path;
+        bool isDirectory = false;
+    };
+
+    /**
+     * @brief Reader for the NTFS USN change journal
+     *
+     * Lets SearchIndex apply only the files that changed since the last
+     * update instead of rescanning whole roots. Callers fall back to a
+     * rescan whenever a method reports failure (non-NTFS or network volume,
+     * missing rights, journal recreated or records already truncated).
+     */
+    class UsnJournal
+    {
+    public:
+        /**
+         * @brief Get the volume root that contains a path
+         */
+        static std::optional<std::string> VolumeOf(const std::filesystem::path& path);
+
+        /**
+         * @brief Check if a root lives on a local NTFS volume with a journal
+         */
+        static bool IsSupported(const std::filesystem::path& root);
+
+        /**
+         * @brief Get a cursor positioned at the end of the volume's journal
+         */
+        static std::optional<UsnCursor> QueryCursor(const std::string& volume);
+
+        /**
+         * @brief Read all changes after the cursor and advance it
+         * @return std::nullopt if the journal can no longer be replayed from the cursor
+         */
+        static std::optional<std::vector<UsnChange>> ReadChanges(UsnCursor& cursor);
+    };
+
+} // namespace opacity::search
@@ -1,6 +1,10 @@
 #pragma once
 
+#include "opacity/ui/FuzzyMatcher.h"
+
+#include <atomic>
 #include <chrono>
+#include <deque>
 #include <functional>
 #include <memory>
 #include <optional>
@@ -36,6 +40,45 @@ namespace opacity::ui
         std::vector<size_t> matched_indices;// Character indices that matched
     };
 
+    /**
+     * @brief A source of palette results besides the registered commands
+     *
+     * Inline providers hand over everything they have when the palette
+     * opens, and it is matched along with the commands. Async providers
+     * are asked per query on a thread of their own and emit results as
+     * they find them; the palette lists those after the inline matches.
+     */
+    class PaletteProvider
+    {
+    public:
+        enum class Tier
+        {
+            Inline,     // Cheap to list; matched on the UI thread
+            Async       // Searched per query off the UI thread
+        };
+
+        using Emit = std::function<void(std::vector<PaletteCommand>)>;
+
+        virtual ~PaletteProvider() = default;
+
+        virtual Tier GetTier() const = 0;
+
+        /**
+         * @brief Append every item, for an inline provider
+         */
+        virtual void Collect(std::vector<PaletteCommand>& items) { (void)items; }
+
+        /**
+         * @brief Search for query, for an async provider; runs on its own thread
+         * @param emit May be called any number of times with what was found so far
+         */
+        virtual void Query(const std::string& query, size_t max_results,
+                           const std::atomic<bool>& cancel, const Emit& emit)
+        {
+            (void)query; (void)max_results; (void)cancel; (void)emit;
+        }
+    };
+
     /**
      * @brief History entry for recent commands
      */
@@ -55,6 +98,16 @@ namespace opacity::ui
      * - Recent commands history
      * - Category filtering
      * - Custom command registration
+     *
+     * Commands are indexed for matching once, when the palette next
+     * searches after a change. Typing on narrows the previous matches
+     * instead of scanning everything again, and only the shown results
+     * are sorted. With many candidates the matching runs on a background
+     * thread, and the results shown stay up until it finishes.
+     *
+     * Providers add sessions, bookmarks, files and so on. Inline results
+     * show as soon as the query changes; async ones are appended below
+     * them as they arrive, so nothing already listed moves.
      */
     class CommandPalette
     {
@@ -77,6 +130,11 @@ namespace opacity::ui
          */
         void RegisterCommands(const std::vector<PaletteCommand>& commands);
 
+        /**
+         * @brief Add a source of results; inline ones are collected each time the palette opens
+         */
+        void AddProvider(std::shared_ptr<PaletteProvider> provider);
+
         /**
          * @brief Unregister a command by ID
          */
@@ -238,11 +296,36 @@ namespace opacity::ui
         void SetBoostRecent(bool boost) { boost_recent_ = boost; }
 
     private:
+        struct MatchJob;
+        struct StreamJob;
+
+        static constexpr size_t kMaxResults = 20;
+        static constexpr size_t kMaxStreamed = 20;         // Async provider results, on top of kMaxResults
+        static constexpr size_t kAsyncCandidates = 20000;  // Matched off the UI thread from this many
+
+        /**
+         * @brief Index the commands for matching, if they changed
+         */
+        void EnsureIndex() const;
+        std::vector<uint32_t> EligibleEntries() const;
+        std::unordered_map<uint32_t, int> HistoryBoosts() const;
+        std::vector<PaletteMatch> ToMatches(const std::string& lower_query,
+                                            const std::vector<FuzzyMatcher::Hit>& hits, size_t count) const;
+        void ApplyHits(const std::string& lower_query, std::vector<FuzzyMatcher::Hit>& hits);
+        void PollMatch();
+        void CancelMatch();
+        void ResetMatching();
+
+        void CollectProvided();
+        void StartStream();
+        void PollStream();
+        void CancelStream();
+
         /**
-         * @brief Calculate fuzzy match score
+         * @brief Rebuild the shown results from the inline and streamed ones
+         * @param keep_selection Keep the selected item selected where it moved to
          */
-        int CalculateFuzzyScore(const std::string& text, const std::string& query,
-                                std::vector<size_t>& matched_indices) const;
+        void ComposeResults(bool keep_selection);
 
         /**
          * @brief Add command to history
@@ -256,6 +339,27 @@ namespace opacity::ui
 
         // Commands
         std::unordered_map<std::string, PaletteCommand> commands_;
+
+        // Providers, and the items the inline ones gave when last shown
+        std::vector<std::shared_ptr<PaletteProvider>> providers_;
+        std::vector<PaletteCommand> provided_;
+
+        // Matching index, rebuilt after commands change; entries_ holds the
+        // command or provided item of each matcher entry
+        mutable std::shared_ptr<const FuzzyMatcher> matcher_;
+        mutable std::vector<const PaletteCommand*> entries_;
+        mutable std::unordered_map<std::string, uint32_t> entry_of_;
+        mutable bool index_dirty_ = true;
+
+        // Every entry matching narrowed_query_, the last query matched in
+        // full; a query extending it starts from these
+        std::string narrowed_query_;
+        std::vector<uint32_t> narrowed_hits_;
+        std::shared_ptr<MatchJob> match_job_;
+
+        // What async providers found for the current query, in arrival order
+        std::deque<PaletteCommand> streamed_;
+        std::shared_ptr<StreamJob> stream_job_;
         
         // History
         std::vector<PaletteHistoryEntry> history_;
@@ -264,7 +368,8 @@ namespace opacity::ui
         // UI State
         bool visible_ = false;
         std::string current_query_;
-        std::vector<PaletteMatch> current_results_;
+        std::vector<PaletteMatch> inline_results_;      // Commands and inline items, ranked
+        std::vector<PaletteMatch> current_results_;     // Those, then the streamed ones
         int selected_index_ = 0;
         std::string category_filter_;
         char input_buffer_[256] = {};
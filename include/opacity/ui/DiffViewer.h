@@ -4,6 +4,8 @@
 #include <imgui.h>
 #include <string>
 #include <functional>
+#include <unordered_map>
+#include <vector>
 
 namespace opacity::ui
 {
@@ -128,6 +130,36 @@ namespace opacity::ui
         bool ExportToFile(const std::string& path, bool as_html = false) const;
 
     private:
+        /**
+         * @brief One rendered row; lines point into result_.hunks
+         *
+         * Side by side, a change block's removals and additions are paired
+         * up so each row shows a left line against a right line.
+         */
+        struct DiffRow
+        {
+            const diff::DiffLine* left = nullptr;   // Left line, or the row's line in one-column views
+            const diff::DiffLine* right = nullptr;  // Right line; inline, the added half of a modified line
+            size_t hunk = 0;
+            bool is_header = false;                 // Hunk header (unified view)
+        };
+
+        /**
+         * @brief Byte range of each side that differs from the other
+         */
+        struct IntraLineSpan
+        {
+            size_t left_begin = 0;
+            size_t left_end = 0;
+            size_t right_begin = 0;
+            size_t right_end = 0;
+        };
+
+        void BuildRows();
+        const IntraLineSpan& GetIntraLineSpan(size_t row);
+        void RenderLineText(const std::string& text, const ImVec4& color, size_t highlight_begin, size_t highlight_end);
+        void ScrollToPendingHunk(float line_height);
+
         void RenderToolbar();
         void RenderSideBySideView();
         void RenderUnifiedView();
@@ -157,6 +189,17 @@ namespace opacity::ui
 
         // UI state
         bool show_options_popup_ = false;
+
+        // Rows for the current mode, rebuilt when the diff or mode changes;
+        // only the visible ones are submitted each frame
+        std::vector<DiffRow> rows_;
+        std::vector<size_t> hunk_rows_;         // First row of each hunk
+        DiffViewMode rows_mode_ = DiffViewMode::SideBySide;
+        bool rows_dirty_ = true;
+        bool scroll_to_hunk_ = false;
+
+        // Computed as modified rows first come into view
+        std::unordered_map<size_t, IntraLineSpan> intra_line_cache_;
     };
 
 } // namespace opacity::ui
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/search/FolderSizeService.h"
+
+#include <imgui.h>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief Treemap of where the space under a folder goes
+     *
+     * Sizes come from the FolderSizeService, so once a drive has been
+     * measured, opening the view or drilling into any folder below needs no
+     * rescans. The squarified layout runs on a scheduler task a level at a
+     * time, publishing after each one, so the largest blocks show at once
+     * and detail fills in; only tiles large enough to see are subdivided.
+     * A folder's own files share one tile. Tiles are drawn in one batch of
+     * draw list primitives, labels only where they fit.
+     *
+     * Click a folder to drill into it; right-click or Up goes back out, and
+     * a double-click opens the folder in the file list.
+     */
+    class DiskUsageView
+    {
+    public:
+        using NavigationCallback = std::function<void(const std::string& path)>;
+
+        explicit DiskUsageView(std::shared_ptr<search::FolderSizeService> folder_sizes);
+        ~DiskUsageView();
+
+        DiskUsageView(const DiskUsageView&) = delete;
+        DiskUsageView& operator=(const DiskUsageView&) = delete;
+
+        /**
+         * @brief Open the view on a folder, measuring it if need be
+         */
+        void Show(const std::string& path);
+        void Hide();
+        bool IsVisible() const { return visible_; }
+
+        /**
+         * @brief Called with a folder to open in the file list (double-click)
+         */
+        void SetNavigationCallback(NavigationCallback callback) { on_navigate_ = std::move(callback); }
+
+        void Render();
+
+        /**
+         * @brief A layout is still being made or not shown yet, so the
+         *        caller should keep drawing frames
+         */
+        bool IsBusy() const;
+
+    private:
+        struct Tile
+        {
+            float x0, y0, x1, y1;
+            uint64_t bytes;
+            uint16_t depth;             // 0 for the children of the root
+            uint16_t branch;            // Which child of the root it lies in, for its colour
+            int32_t folder;             // Index into folders, -1 for a folder's own files
+        };
+
+        struct Layout
+        {
+            std::vector<Tile> tiles;                        // Parents before children
+            std::vector<std::filesystem::path> folders;
+            std::vector<std::string> names;                 // Per folder, for labels
+        };
+
+        struct LayoutJob;
+
+        void DrillTo(std::filesystem::path path);
+        void DrillOut();
+        void StartLayout(float width, float height);
+        void PollLayout();
+        void RenderTiles(const ImVec2& origin);
+        const Tile* FolderAt(const ImVec2& point) const;
+        static void RunLayout(LayoutJob& job, const core::CancellationToken& cancel);
+
+        std::shared_ptr<search::FolderSizeService> folder_sizes_;
+        NavigationCallback on_navigate_;
+        bool visible_ = false;
+
+        std::filesystem::path root_;
+        std::vector<std::filesystem::path> history_;    // Folders drilled in from, for Up
+
+        // Latest layout received, and what it was made for
+        Layout layout_;
+        float layout_width_ = 0.0f;
+        float layout_height_ = 0.0f;
+        uint64_t layout_generation_ = 0;
+        std::chrono::steady_clock::time_point layout_started_;
+
+        std::shared_ptr<LayoutJob> job_;
+        uint32_t job_version_ = 0;          // Of the job's layout last copied
+        core::CancellationSource job_cancel_;
+    };
+
+} // namespace opacity::ui
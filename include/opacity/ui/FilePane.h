@@ -1,8 +1,17 @@
 #pragma once
 
 #include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/filesystem/FileWatch.h"
 #include "opacity/filesystem/FsItem.h"
+#include "opacity/filesystem/ItemStore.h"
+#include "opacity/preview/IconService.h"
+#include "opacity/preview/ThumbnailService.h"
+#include "opacity/search/FolderSizeService.h"
+#include "opacity/ui/SelectionSet.h"
 #include "opacity/core/Path.h"
+#include "opacity/core/TaskScheduler.h"
+#include <imgui.h>
+#include <cstdint>
 #include <memory>
 #include <string>
 #include <vector>
@@ -20,12 +29,17 @@ namespace opacity::ui
      * - View mode settings
      * 
      * Multiple FilePanes can be displayed side-by-side or in tabs.
+     *
+     * The current directory is watched; changes are applied to the sorted
+     * listing as individual inserts, removals and moves rather than by
+     * reading the directory again.
      */
     class FilePane
     {
     public:
         using NavigationCallback = std::function<void(const std::string& path)>;
-        using SelectionCallback = std::function<void(const std::vector<filesystem::FsItem>& items)>;
+        using SelectionCallback = std::function<void(const SelectionView& selection)>;
+        using RedrawCallback = std::function<void()>;
 
         /**
          * @brief Unique identifier for this pane
@@ -83,16 +97,73 @@ namespace opacity::ui
          */
         void Refresh();
 
+        /**
+         * @brief Check if a directory listing is still being read
+         *
+         * Listings load on a background thread; until they finish, the pane
+         * holds the items read so far, in the order they were read.
+         */
+        bool IsLoading() const { return load_job_ != nullptr; }
+
+        /**
+         * @brief Stop reading the current listing, keeping what was read
+         */
+        void CancelLoad();
+
+        /**
+         * @brief Release the listing of a pane nobody is looking at
+         *
+         * The path, history, settings, scroll position and the names of the
+         * selected and focused items are kept; the listing, its display text
+         * and the directory watch are dropped. The next Render or Wake reads
+         * the directory again, normally from the listing cache, and puts the
+         * selection and scroll position back. A pane still loading is left
+         * as it is.
+         */
+        void Hibernate();
+        void Wake();
+        bool IsHibernating() const { return hibernating_; }
+
+        /**
+         * @brief Open at a saved location without reading it
+         *
+         * For session restore: the pane starts out hibernated at path, with
+         * the given selection, focus and scroll position (negative for
+         * none) to put back, so nothing is read until it is first drawn or
+         * woken.
+         */
+        void RestoreAt(const std::string& path, std::vector<std::string> selected_names,
+                       std::string focused_name, float scroll_y);
+
+        /**
+         * @brief Bytes held by the listing and its display text
+         */
+        size_t GetMemoryUsage() const;
+
         // Selection
         void SelectAll();
         void SelectNone();
         void InvertSelection();
         void SetSelection(size_t index, bool selected);
         void ToggleSelection(size_t index);
+
+        /**
+         * @brief Select exactly the positions from first to last, in either order
+         */
+        void SelectRange(size_t first, size_t last);
         bool IsSelected(size_t index) const;
         size_t GetSelectionCount() const;
+        SelectionView GetSelection() const { return SelectionView(selection_, store_, order_); }
         std::vector<filesystem::FsItem> GetSelectedItems() const;
 
+        /**
+         * @brief Put the selection on the clipboard for the shell, or
+         *        drag it out; paths are only built when a target asks
+         * @param cut Mark the files to be moved when pasted
+         */
+        bool CopySelectionToClipboard(bool cut = false) const;
+        void DragSelection();
+
         /**
          * @brief Set the focused item index (for keyboard navigation)
          */
@@ -120,8 +191,30 @@ namespace opacity::ui
         void SetIconSize(int size) { icon_size_ = size; }
         int GetIconSize() const { return icon_size_; }
 
+        /**
+         * @brief Draw thumbnails in the icons view; null shows plain icons
+         */
+        void SetThumbnailService(std::shared_ptr<preview::ThumbnailService> thumbnails) { thumbnails_ = std::move(thumbnails); }
+
+        /**
+         * @brief Show recursive folder sizes in the details view, filled in
+         *        as they are measured; null leaves folders blank
+         */
+        void SetFolderSizeService(std::shared_ptr<search::FolderSizeService> folder_sizes) { folder_sizes_ = std::move(folder_sizes); }
+
+        /**
+         * @brief Draw shell icons beside names and in place of missing
+         *        thumbnails; null marks folders with text
+         */
+        void SetIconService(std::shared_ptr<preview::IconService> icons);
+
         // Content Access
-        const std::vector<filesystem::FsItem>& GetItems() const { return items_; }
+        // Positions (as used by selection and focus) index GetOrder(), which
+        // holds indices into GetItemStore()
+        const filesystem::ItemStore& GetItemStore() const { return store_; }
+        const std::vector<filesystem::ItemStore::Index>& GetOrder() const { return order_; }
+        size_t GetItemCount() const { return order_.size(); }
+        filesystem::FsItem GetItem(size_t index) const { return store_.Materialize(order_[index]); }
         size_t GetFileCount() const { return file_count_; }
         size_t GetDirectoryCount() const { return directory_count_; }
         uint64_t GetTotalSize() const { return total_size_; }
@@ -132,6 +225,12 @@ namespace opacity::ui
         void SetNavigationCallback(NavigationCallback callback) { on_navigate_ = std::move(callback); }
         void SetSelectionCallback(SelectionCallback callback) { on_selection_change_ = std::move(callback); }
 
+        /**
+         * @brief Called from worker threads when the pane has something new
+         *        to draw: a batch of the listing, its end, or watched changes
+         */
+        void SetRedrawCallback(RedrawCallback callback) { on_redraw_ = std::move(callback); }
+
         /**
          * @brief Render the pane contents using ImGui
          * @param width Available width
@@ -146,10 +245,41 @@ namespace opacity::ui
         void HandleKeyboardInput();
 
     private:
+        struct LoadJob;
+        struct PendingChange;
+        struct WatchQueue;
+
         void LoadDirectory(const std::string& path);
+        void PollLoad();
+        void FinishLoad(LoadJob& job);
+        void WaitForLoads();
+        void StartWatching(const filesystem::EnumerationOptions& options);
+        void StopWatching();
+        void PollChanges();
+        void ApplyChanges(std::vector<PendingChange>& changes);
+        void CompactStore();
+        int PositionOf(filesystem::ItemStore::Index index) const;
+        void RestoreSelection(const std::vector<std::string>& selected_names, const std::string& focused_name);
+        std::vector<bool> SelectedRows() const;
+        void NotifySelectionChanged();
         void SortItems();
         void RenderDetailsView();
         void RenderIconsView();
+        void RestoreScroll();
+
+        struct DisplayText
+        {
+            static constexpr uint32_t kNone = UINT32_MAX;
+            uint32_t label = kNone;     // Offsets into display_arena_
+            uint32_t size = kNone;
+            uint32_t modified = kNone;
+            bool size_stale = false;    // Folder size from an earlier session; still asked for
+        };
+        const DisplayText& GetDisplayText(filesystem::ItemStore::Index index);
+        const char* DisplayString(uint32_t offset) const { return display_arena_.data() + offset; }
+        const char* FolderSizeText(filesystem::ItemStore::Index index);
+        void DrawIcon(filesystem::ItemStore::Index index, const ImVec2& min, float edge, preview::IconSize size);
+        void ClearDisplayText();
         void HandleItemActivation(size_t index);
 
         static uint32_t next_id_;
@@ -162,15 +292,42 @@ namespace opacity::ui
         std::vector<std::string> history_;
         size_t history_index_ = 0;
 
-        // Content
-        std::vector<filesystem::FsItem> items_;
-        std::vector<bool> selection_;
+        // Content; the store is never reordered and order_ is the sorted
+        // view. selection_ holds view positions, so a shift-click is one
+        // range; whatever reorders the view carries it over by store index
+        filesystem::ItemStore store_;
+        std::vector<filesystem::ItemStore::Index> order_;
+        SelectionSet selection_;
         int focused_index_ = -1;
         size_t file_count_ = 0;
         size_t directory_count_ = 0;
         uint64_t total_size_ = 0;
         std::string last_error_;
 
+        // Details view text, made the first time a row is drawn and kept
+        // until the store is replaced, so drawing a row allocates nothing;
+        // NUL-terminated strings, indexed by store index
+        std::string display_arena_;
+        std::vector<DisplayText> display_text_;
+
+        // Background listing being read; shared with its scheduler task.
+        // Reads the pane moved on from are cancelled, and waited for only
+        // when the pane is destroyed
+        std::shared_ptr<LoadJob> load_job_;
+        core::TaskHandle load_task_;
+        std::vector<core::TaskHandle> abandoned_loads_;
+
+        // Changes to the current directory, filled on the watcher thread
+        std::shared_ptr<WatchQueue> watch_queue_;
+        filesystem::WatchHandle watch_handle_ = 0;
+
+        // Hibernation keeps only what it takes to put the view back
+        bool hibernating_ = false;
+        std::vector<std::string> restore_selection_;
+        std::string restore_focus_;
+        float scroll_y_ = 0.0f;             // Of the view, as last drawn
+        float restore_scroll_ = -1.0f;      // Applied once the listing is back
+
         // Settings
         filesystem::SortColumn sort_column_ = filesystem::SortColumn::Name;
         filesystem::SortDirection sort_direction_ = filesystem::SortDirection::Ascending;
@@ -179,12 +336,25 @@ namespace opacity::ui
         ViewMode view_mode_ = ViewMode::Details;
         int icon_size_ = 1; // 0=small, 1=medium, 2=large
 
+        // Thumbnails drawn last frame, held until its draw list is rendered
+        std::shared_ptr<preview::ThumbnailService> thumbnails_;
+        std::vector<preview::ThumbnailPtr> drawn_thumbnails_;
+
+        // Icons drawn last frame, held the same way
+        std::shared_ptr<preview::IconService> icons_;
+        std::vector<preview::IconPtr> drawn_icons_;
+
+        // Folder sizes; text made from them is dropped when they change
+        std::shared_ptr<search::FolderSizeService> folder_sizes_;
+        uint64_t folder_size_generation_ = 0;
+
         // Custom title (if empty, uses directory name)
         std::string custom_title_;
 
         // Callbacks
         NavigationCallback on_navigate_;
         SelectionCallback on_selection_change_;
+        RedrawCallback on_redraw_;
     };
 
 } // namespace opacity::ui
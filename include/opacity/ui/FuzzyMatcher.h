@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief Fuzzy matching over many candidates, prepared once
+     *
+     * Each entry keeps its label, description and keywords lowercased,
+     * with a 64-bit mask of the characters in each; a field whose mask
+     * lacks one of the query's characters is passed over unread. Anything
+     * that matches a query also matches every prefix of it, so a query
+     * that extends the last one only needs the entries that matched that.
+     *
+     * Read-only once built, so one matcher can be shared by searches on
+     * other threads.
+     */
+    class FuzzyMatcher
+    {
+    public:
+        struct Hit
+        {
+            uint32_t entry = 0;
+            int score = 0;
+        };
+
+        /**
+         * @brief Add an entry
+         * @param bonus Added to the score whenever the entry matches
+         * @return Its index, counting from 0 in the order added
+         */
+        uint32_t Add(std::string_view label, std::string_view description,
+                     const std::vector<std::string>& keywords, int bonus);
+
+        size_t Size() const { return entries_.size(); }
+
+        static std::string Lower(std::string_view text);
+        static uint64_t CharMask(std::string_view lower);
+
+        /**
+         * @brief Score of one entry against a lowercased query; 0 if it does not match
+         * @param matched Label positions that matched, when the label did
+         */
+        int Score(uint32_t entry, std::string_view query, uint64_t query_mask,
+                  std::vector<size_t>* matched = nullptr) const;
+
+        /**
+         * @brief Append every candidate that matches, in candidate order
+         * @return false if cancelled part way
+         */
+        bool Filter(std::string_view query, const std::vector<uint32_t>& candidates,
+                    std::vector<Hit>& hits, const std::atomic<bool>* cancel = nullptr) const;
+
+        /**
+         * @brief Move the best count hits to the front, best first; the rest
+         *        follow in no particular order. Ties go to the earlier entry.
+         */
+        static void SelectTop(std::vector<Hit>& hits, size_t count);
+
+    private:
+        struct Entry
+        {
+            std::string label;
+            std::string description;
+            std::string keywords;           // Joined by '\n', which no query holds
+            uint64_t label_mask = 0;
+            uint64_t description_mask = 0;
+            uint64_t keyword_mask = 0;
+            int bonus = 0;
+        };
+
+        static int SubsequenceScore(std::string_view text, std::string_view query, std::vector<size_t>* matched);
+
+        std::vector<Entry> entries_;
+    };
+
+} // namespace opacity::ui
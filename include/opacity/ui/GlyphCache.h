@@ -0,0 +1,107 @@
+#pragma once
+
+#include "opacity/core/MappedFile.h"
+#include "opacity/core/MemoryGovernor.h"
+
+#include <imgui.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief Font atlas that grows to the characters actually shown
+     *
+     * Baking the CJK ranges up front takes seconds and tens of MB of
+     * texture, so only Latin-1 is baked at startup. Text passed to Note()
+     * that holds anything else queues those characters, and Update()
+     * rebuilds the atlas with every character seen so far, at most once per
+     * kRebuildInterval. The fallback fonts are merged in for characters the
+     * main font lacks; one none of them has is not asked for again. Font
+     * files are mapped once and every rebuild reads them in place.
+     *
+     * The atlas is charged to the memory governor. Asked to shrink, the
+     * next Update() forgets the characters seen longest ago and rebuilds;
+     * those still on screen are noted again as they are drawn.
+     *
+     * UI thread only, like ImGui itself, but for the governor's calls.
+     */
+    class GlyphCache
+    {
+    public:
+        static constexpr std::chrono::milliseconds kRebuildInterval{100};
+
+        GlyphCache();
+
+        // Disable copy
+        GlyphCache(const GlyphCache&) = delete;
+        GlyphCache& operator=(const GlyphCache&) = delete;
+
+        /**
+         * @brief Fonts to build from; files that do not exist are skipped
+         * @param primary Main font; ImGui's default when empty or missing
+         * @param fallbacks Merged in, in order, for what primary lacks
+         */
+        void SetFonts(const std::string& primary, const std::vector<std::string>& fallbacks, float size);
+
+        /**
+         * @brief Queue the characters of UTF-8 text that are not in the atlas yet
+         */
+        void Note(std::string_view utf8);
+        void NoteCodepoint(uint32_t codepoint);
+
+        /**
+         * @brief Whether the next Update() has something to build
+         */
+        bool IsPending() const { return fonts_dirty_ || built_count_ < codepoints_.size(); }
+
+        /**
+         * @brief Rebuild the atlas if characters or fonts are waiting; call between frames
+         * @return true if rebuilt, so the font texture must be uploaded again
+         */
+        bool Update(ImFontAtlas& atlas);
+
+        size_t GetGlyphCount() const { return codepoints_.size(); }
+
+    private:
+        bool Known(uint32_t codepoint) const
+        {
+            size_t word = codepoint >> 6;
+            return word < known_.size() && ((known_[word] >> (codepoint & 63)) & 1);
+        }
+
+        void Shrink(size_t target_bytes);
+
+        // Mapped on first use; null when the file cannot be read
+        const core::MappedFile* FontFile(const std::string& path);
+        void AddFont(ImFontAtlas& atlas, const core::MappedFile& file, ImFontConfig& config);
+
+        std::string primary_;
+        std::vector<std::string> fallbacks_;
+        std::unordered_map<std::string, core::MappedFile> font_files_;  // By path; closed if unreadable
+        float size_ = 14.0f;
+        bool fonts_dirty_ = true;
+
+        std::vector<uint64_t> known_;               // Bit per codepoint baked or queued
+        std::vector<uint32_t> codepoints_;          // Beyond the base ranges, in the order seen
+        size_t built_count_ = 0;                    // Leading codepoints_ in the atlas
+        std::vector<ImWchar> ranges_;               // The atlas reads these while it builds
+        std::chrono::steady_clock::time_point last_build_;
+
+        std::atomic<size_t> atlas_bytes_{0};        // Pixels of the last build
+        std::atomic<size_t> shrink_to_{SIZE_MAX};   // Set by the governor, applied by Update()
+        core::MemoryGovernor::Registration memory_;
+    };
+
+    /**
+     * @brief The glyph cache of the ImGui context, which the backend builds from
+     */
+    GlyphCache& GetGlyphCache();
+
+} // namespace opacity::ui
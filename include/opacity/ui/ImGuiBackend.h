@@ -5,6 +5,7 @@
 #include <Windows.h>
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <chrono>
 #include <string>
 
 namespace opacity::ui
@@ -14,6 +15,13 @@ namespace opacity::ui
      * 
      * Manages the DirectX 11 device, swap chain, and ImGui context.
      * Provides the rendering foundation for the application.
+     *
+     * Frames are drawn only when something can have changed. After input
+     * a few frames settle ImGui's state; after that ProcessMessages sleeps
+     * until the next message, a Wake() from another thread, or the time a
+     * caller asked to be drawn again with RequestFrame(). The swap chain
+     * uses the flip model with a frame latency of one where Windows offers
+     * it, so an active frame starts as soon as the last one is shown.
      */
     class ImGuiBackend
     {
@@ -51,11 +59,25 @@ namespace opacity::ui
         void EndFrame();
 
         /**
-         * @brief Process Win32 messages
+         * @brief Process Win32 messages, waiting for one while no frame is due
          * @return true if application should continue, false if quit requested
          */
         bool ProcessMessages();
 
+        /**
+         * @brief Ask for another frame
+         * @param within Longest wait before it; zero for the next refresh
+         *
+         * Lasts for the frame being built; call it every frame while an
+         * animation or background work shown on screen goes on.
+         */
+        void RequestFrame(std::chrono::milliseconds within = std::chrono::milliseconds(0));
+
+        /**
+         * @brief Draw a frame soon; safe to call from any thread
+         */
+        void Wake();
+
         /**
          * @brief Check if window is still valid
          */
@@ -77,12 +99,18 @@ namespace opacity::ui
          */
         ID3D11Device* GetDevice() const { return device_.Get(); }
 
+        /**
+         * @brief Get the immediate context for texture uploads
+         */
+        ID3D11DeviceContext* GetDeviceContext() const { return device_context_.Get(); }
+
     private:
         bool CreateDeviceD3D();
         void CleanupDeviceD3D();
         void CreateRenderTarget();
         void CleanupRenderTarget();
         void HandleResize(int width, int height);
+        bool PumpMessages();
 
         static LRESULT WINAPI WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM lParam);
 
@@ -93,11 +121,20 @@ namespace opacity::ui
         int height_ = 720;
         bool running_ = false;
 
+        // Frame scheduling
+        static constexpr int kFramesAfterInput = 3;                // ImGui settles hover and focus over a few frames
+        static constexpr DWORD kTextInputInterval = 500;            // Caret blink while a text field is active
+        HANDLE wake_event_ = nullptr;
+        int frames_due_ = 1;
+        DWORD wait_timeout_ = INFINITE;
+
         // DirectX 11
         Microsoft::WRL::ComPtr<ID3D11Device> device_;
         Microsoft::WRL::ComPtr<ID3D11DeviceContext> device_context_;
         Microsoft::WRL::ComPtr<IDXGISwapChain> swap_chain_;
         Microsoft::WRL::ComPtr<ID3D11RenderTargetView> main_render_target_view_;
+        HANDLE frame_latency_waitable_ = nullptr;
+        UINT swap_chain_flags_ = 0;
 
         // Clear color (dark theme)
         float clear_color_[4] = { 0.1f, 0.1f, 0.1f, 1.0f };
@@ -5,6 +5,12 @@
 #include <array>
 #include <functional>
 
+namespace opacity::core
+{
+    struct Session;
+    struct SessionState;
+}
+
 namespace opacity::ui
 {
     /**
@@ -48,7 +54,15 @@ namespace opacity::ui
             Full            // Sync both navigation and selection
         };
 
-        LayoutManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager);
+        /**
+         * @param thumbnails Handed to every pane for its icons view; may be null
+         * @param folder_sizes Handed to every pane for its Size column; may be null
+         * @param icons Handed to every pane for the icons of its rows; may be null
+         */
+        LayoutManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager,
+                      std::shared_ptr<preview::ThumbnailService> thumbnails = nullptr,
+                      std::shared_ptr<search::FolderSizeService> folder_sizes = nullptr,
+                      std::shared_ptr<preview::IconService> icons = nullptr);
         ~LayoutManager();
 
         // Prevent copying
@@ -60,6 +74,22 @@ namespace opacity::ui
          */
         void Initialize(const std::string& initial_path = "");
 
+        /**
+         * @brief Open a saved session's panes and tabs without reading them
+         *
+         * Every tab is restored hibernated, so startup costs the same for
+         * forty tabs as for four. The active tab of each pane reads its
+         * directory when first drawn; the listing cache reads the others
+         * ahead in the background, those next to the active tabs first,
+         * and the rest when activated.
+         */
+        void RestoreSession(const core::Session& session);
+
+        /**
+         * @brief The same, from the state crash recovery saved
+         */
+        void RestoreSession(const core::SessionState& state);
+
         /**
          * @brief Set the layout type
          */
@@ -156,6 +186,11 @@ namespace opacity::ui
          */
         void SetFocusChangedCallback(FocusChangedCallback callback) { on_focus_changed_ = std::move(callback); }
 
+        /**
+         * @brief Called from worker threads when a pane has something new to draw
+         */
+        void SetRedrawCallback(FilePane::RedrawCallback callback);
+
         // Layout presets
         void LoadLayoutPreset(const std::string& name);
         void SaveLayoutPreset(const std::string& name);
@@ -172,8 +207,13 @@ namespace opacity::ui
         void RenderPaneWithBorder(size_t pane_index, float x, float y, float width, float height);
         void HandlePaneSynchronization(size_t source_pane);
         void EnsurePanesExist(size_t count);
+        std::unique_ptr<TabManager> CreateTabManager() const;
+        void RestorePanes(const std::vector<std::vector<TabStub>>& panes, const std::vector<size_t>& active);
 
         std::shared_ptr<filesystem::FileSystemManager> fs_manager_;
+        std::shared_ptr<preview::ThumbnailService> thumbnails_;
+        std::shared_ptr<search::FolderSizeService> folder_sizes_;
+        std::shared_ptr<preview::IconService> icons_;
         std::array<std::unique_ptr<TabManager>, MAX_PANES> panes_;
         
         LayoutType layout_ = LayoutType::Single;
@@ -185,6 +225,7 @@ namespace opacity::ui
         SyncMode sync_mode_ = SyncMode::None;
         
         FocusChangedCallback on_focus_changed_;
+        FilePane::RedrawCallback on_redraw_;
 
         // Splitter drag state
         bool dragging_h_split_ = false;
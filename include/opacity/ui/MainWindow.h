@@ -6,12 +6,25 @@
 #include "opacity/ui/Theme.h"
 #include "opacity/ui/AdvancedSearchDialog.h"
 #include "opacity/ui/DiffViewer.h"
+#include "opacity/ui/ProfilerOverlay.h"
+#include "opacity/ui/DiskUsageView.h"
+#include "opacity/ui/SearchResultsModel.h"
 #include "opacity/filesystem/FileSystemManager.h"
 #include "opacity/filesystem/FsItem.h"
 #include "opacity/filesystem/OperationQueue.h"
 #include "opacity/filesystem/FileWatch.h"
 #include "opacity/preview/PreviewManager.h"
+#include "opacity/preview/TextureManager.h"
+#include "opacity/preview/ThumbnailService.h"
+#include "opacity/preview/IconService.h"
 #include "opacity/search/SearchEngine.h"
+#include "opacity/search/FilterEngine.h"
+#include "opacity/search/FolderSizeService.h"
+#include "opacity/search/IndexHost.h"
+#include "opacity/core/CrashRecovery.h"
+#include "opacity/core/SessionManager.h"
+#include "opacity/core/TaskScheduler.h"
+#include <atomic>
 #include <memory>
 #include <string>
 #include <vector>
@@ -62,6 +75,7 @@ namespace opacity::ui
         void RenderToolbar();
         void RenderAddressBar();
         void RenderFilePanel();
+        bool DrawItemIcon(const filesystem::FsItem& item, const ImVec2& min, float edge, preview::IconSize size);
         void RenderStatusBar();
         void RenderPreviewPanel();
         void RenderDrivesPanel();
@@ -78,10 +92,23 @@ namespace opacity::ui
 
         // Navigation
         void NavigateTo(const std::string& path);
+
+        // Open a saved session's tabs, and list its active one here
+        bool RestoreSession(const core::Session& session);
+        void RestoreSession(const core::SessionState& state);
+        void ShowRestoredPane();
+
+        // Hand where the window is to auto-save and crash recovery
+        void PublishSession();
         void NavigateUp();
         void NavigateBack();
         void NavigateForward();
-        void RefreshCurrentDirectory();
+        // use_cache takes a listing the cache holds, for navigation; changes
+        // made from here read the disk again
+        void RefreshCurrentDirectory(bool use_cache = false);
+        filesystem::EnumerationOptions ListingOptions() const;
+        float IconSizePixels() const;
+        void UpdateFilter();
 
         // File operations
         void OpenSelectedItems();
@@ -105,11 +132,19 @@ namespace opacity::ui
 
         // Search
         void StartSearch();
+        void StartWalkSearch(const std::string& query, const std::string& directory);
         void CancelSearch();
+        bool IsSearching() const;
         void OnSearchResult(const search::SearchResult& result);
+        void SearchResidentIndex(const std::string& query);
+        void PollResidentSearch();
+
+        // Startup
+        void RunDeferredInit(bool all);
 
         // Preview
-        void UpdatePreview();
+        void UpdatePreview(bool hydrate = false);
+        void PollPreview();
         void ReleaseCurrentPreview();
 
         // Backend
@@ -120,16 +155,49 @@ namespace opacity::ui
 
         // Preview manager
         std::unique_ptr<preview::PreviewManager> preview_manager_;
-        preview::PreviewData current_preview_;
+        preview::PreviewPtr current_preview_;
+        preview::PreviewHandle preview_request_;    // In flight for preview_file_path_
         std::string preview_file_path_;
+        bool text_follow_tail_ = false;             // Keep a growing text file scrolled to its end
+        int text_goto_line_ = 1;
+        double text_refresh_time_ = 0.0;
+
+        // Icon view thumbnails; those drawn last frame are held until its
+        // draw list has been rendered. Their atlas pages outlive them
+        std::unique_ptr<preview::TextureManager> texture_manager_;
+        std::shared_ptr<preview::ThumbnailService> thumbnail_service_;
+        std::vector<preview::ThumbnailPtr> drawn_thumbnails_;
+
+        // Shell icons for the file list and the panes, held the same way
+        std::shared_ptr<preview::IconService> icon_service_;
+        std::vector<preview::IconPtr> drawn_icons_;
+
+        // Recursive sizes for the panes' Size column
+        std::shared_ptr<search::FolderSizeService> folder_size_service_;
+        uint64_t folder_size_generation_ = 0;
 
         // Search engine
         std::unique_ptr<search::SearchEngine> search_engine_;
-        std::vector<search::SearchResult> search_results_;
-        std::mutex search_results_mutex_;
-        size_t search_files_count_ = 0;
+        SearchResultsModel search_results_;
+        std::atomic<size_t> search_files_count_{0};
+        bool search_contents_ = false;
         bool show_search_results_ = false;
 
+        // The index the resident tray process serves, when one runs. Every
+        // call blocks on the pipe, so it is asked on a scheduler task; an
+        // answer the host does not mark complete falls back to the walk
+        struct ResidentSearch
+        {
+            std::string query;
+            std::string directory;
+            core::CancellationSource cancel;
+            core::TaskHandle task;
+            std::vector<search::SearchResult> results;  // Written by the task, read once it is done
+            bool complete = false;
+        };
+        std::shared_ptr<search::IndexClient> index_client_;
+        std::shared_ptr<ResidentSearch> resident_search_;
+
         // Current state
         std::string current_path_;
         std::vector<std::string> path_history_;
@@ -161,16 +229,41 @@ namespace opacity::ui
         char search_buffer_[256] = "";
         bool search_active_ = false;
 
+        // Local filter over current_items_, re-evaluated only when the text
+        // or the listing changes
+        search::ItemColumns filter_columns_;
+        search::FilterProgram filter_program_;
+        search::Selection filter_selection_;
+        std::string filter_text_;
+        bool filter_columns_dirty_ = true;
+
         // Phase 2 components
         std::unique_ptr<LayoutManager> layout_manager_;
         std::unique_ptr<KeybindManager> keybind_manager_;
         std::unique_ptr<Theme> current_theme_;
         std::unique_ptr<AdvancedSearchDialog> advanced_search_dialog_;
         std::unique_ptr<DiffViewer> diff_viewer_;
+        std::unique_ptr<ProfilerOverlay> profiler_overlay_;
+        std::unique_ptr<DiskUsageView> disk_usage_view_;
+        std::unique_ptr<core::CrashRecovery> crash_recovery_;     // Outlives the copies journaling to it
+        std::unique_ptr<core::SessionManager> session_manager_;
+        bool sessions_loaded_ = false;
         std::unique_ptr<filesystem::OperationQueue> operation_queue_;
         std::unique_ptr<filesystem::FileWatch> file_watch_;
         filesystem::WatchHandle current_watch_handle_ = 0;
 
+        // Startup work left until the first frame is on screen, one step a frame
+        struct DeferredInit
+        {
+            const char* name;
+            std::function<void()> run;
+        };
+        std::vector<DeferredInit> deferred_init_;
+        size_t deferred_next_ = 0;
+        bool interactive_ = false;
+        bool keybinds_loaded_ = false;
+        bool navigation_loaded_ = false;
+
         // Phase 2 UI state
         bool show_layout_selector_ = false;
         bool show_keybind_editor_ = false;
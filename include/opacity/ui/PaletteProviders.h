@@ -0,0 +1,95 @@
+#pragma once
+
+#include "opacity/ui/CommandPalette.h"
+
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <string>
+
+namespace opacity::core
+{
+    class SessionManager;
+    class BookmarkManager;
+    class TagManager;
+}
+
+namespace opacity::search
+{
+    class SearchIndex;
+}
+
+namespace opacity::ui
+{
+    /**
+     * @brief Recent sessions; choosing one calls open with its ID
+     */
+    class SessionPaletteProvider : public PaletteProvider
+    {
+    public:
+        SessionPaletteProvider(const core::SessionManager& sessions,
+                               std::function<void(const std::string&)> open);
+
+        Tier GetTier() const override { return Tier::Inline; }
+        void Collect(std::vector<PaletteCommand>& items) override;
+
+    private:
+        const core::SessionManager& sessions_;
+        std::function<void(const std::string&)> open_;
+    };
+
+    /**
+     * @brief Bookmarks; choosing one calls open with its path
+     */
+    class BookmarkPaletteProvider : public PaletteProvider
+    {
+    public:
+        BookmarkPaletteProvider(const core::BookmarkManager& bookmarks,
+                                std::function<void(const std::string&)> open);
+
+        Tier GetTier() const override { return Tier::Inline; }
+        void Collect(std::vector<PaletteCommand>& items) override;
+
+    private:
+        const core::BookmarkManager& bookmarks_;
+        std::function<void(const std::string&)> open_;
+    };
+
+    /**
+     * @brief Tags; choosing one calls show with its ID, to list what carries it
+     */
+    class TagPaletteProvider : public PaletteProvider
+    {
+    public:
+        TagPaletteProvider(const core::TagManager& tags,
+                           std::function<void(const std::string&)> show);
+
+        Tier GetTier() const override { return Tier::Inline; }
+        void Collect(std::vector<PaletteCommand>& items) override;
+
+    private:
+        const core::TagManager& tags_;
+        std::function<void(const std::string&)> show_;
+    };
+
+    /**
+     * @brief Indexed files by name; choosing one calls open with its path
+     *
+     * Searched per query off the UI thread, which the index allows.
+     */
+    class FilePaletteProvider : public PaletteProvider
+    {
+    public:
+        FilePaletteProvider(std::shared_ptr<search::SearchIndex> index,
+                            std::function<void(const std::filesystem::path&)> open);
+
+        Tier GetTier() const override { return Tier::Async; }
+        void Query(const std::string& query, size_t max_results,
+                   const std::atomic<bool>& cancel, const Emit& emit) override;
+
+    private:
+        std::shared_ptr<search::SearchIndex> index_;
+        std::function<void(const std::filesystem::path&)> open_;
+    };
+
+} // namespace opacity::ui
@@ -0,0 +1,182 @@
+#pragma once
+
+#include "opacity/core/Path.h"
+#include "opacity/core/SnapshotFile.h"
+#include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/preview/ThumbnailService.h"
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::core
+{
+    class BookmarkManager;
+    class SessionManager;
+}
+
+namespace opacity::ui
+{
+    /**
+     * @brief How often warmed directories were actually visited
+     */
+    struct PrefetchStats
+    {
+        uint64_t predicted = 0;             // Directories guessed
+        uint64_t used = 0;                  // Guesses the next navigation went to
+        uint64_t network_predicted = 0;     // The same, for network paths only
+        uint64_t network_used = 0;
+        uint64_t network_skipped = 0;       // Network guesses not read ahead
+        uint64_t thumbnails = 0;            // Thumbnails made ahead
+    };
+
+    /**
+     * @brief Reads ahead the directories the user is likely to open next
+     *
+     * Every navigation, from the main list or any pane, is recorded: each
+     * directory keeps a frecency score (visits decaying with a half-life of
+     * kHalfLife) and counts of where the user went from it next, a
+     * first-order Markov model. Bookmarks, quick-access entries and the
+     * tabs of recent sessions seed the scores.
+     *
+     * After a navigation, the first idle frame ranks the likely next
+     * directories, mostly by the transitions out of the current one and
+     * partly by frecency, and hands the best kTargets to the listing
+     * cache's background readers. Later idle frames ask for thumbnails
+     * of their first files at a priority below anything on screen; input
+     * stops the renewals, so queued thumbnails are dropped at once.
+     *
+     * A guess counts as used if the next navigation goes there. Network
+     * paths are only read ahead while at least kMinNetworkUseRate of
+     * those guesses are used, after a trial of kNetworkTrial, since a
+     * wrong guess there costs the share's bandwidth. Guesses are still
+     * counted while the gate is shut, so it opens again once they improve.
+     *
+     * UI thread only. The model is saved to navigation.dat next to the
+     * hash cache.
+     */
+    class PrefetchEngine
+    {
+    public:
+        static constexpr size_t kTargets = 4;
+        static constexpr size_t kThumbnailsPerTarget = 24;
+        static constexpr int kThumbnailPriority = 1000;         // Below every visible row
+        static constexpr size_t kMaxPaths = 2000;
+        static constexpr size_t kMaxSuccessors = 16;
+        static constexpr std::chrono::hours kHalfLife{24 * 7};
+        static constexpr double kMinNetworkUseRate = 0.25;
+        static constexpr uint64_t kNetworkTrial = 20;
+        static constexpr std::chrono::seconds kWarmTime{30};    // Read-ahead for one directory stops after this
+
+        PrefetchEngine() = default;
+
+        // Disable copy
+        PrefetchEngine(const PrefetchEngine&) = delete;
+        PrefetchEngine& operator=(const PrefetchEngine&) = delete;
+
+        /**
+         * @brief What to warm; nothing is read ahead until attached
+         */
+        void Attach(filesystem::FileSystemManager* fs_manager, std::shared_ptr<preview::ThumbnailService> thumbnails);
+        void Detach();
+
+        bool Load(const core::Path& file = DefaultLocation());
+        bool Save();
+
+        /**
+         * @brief navigation.dat next to the hash cache
+         */
+        static core::Path DefaultLocation();
+
+        /**
+         * @brief Count a directory as visited weight times, without a transition
+         */
+        void Seed(const std::string& path, double weight);
+        void Seed(const core::BookmarkManager& bookmarks);
+        void Seed(const core::SessionManager& sessions);
+
+        /**
+         * @brief A navigation from one directory to another; from may be
+         *        empty for the first
+         */
+        void RecordNavigation(const std::string& from, const std::string& to);
+
+        /**
+         * @brief The directories most likely to be opened after from, best first
+         */
+        std::vector<std::string> Predict(const std::string& from, size_t count) const;
+
+        /**
+         * @brief Read ahead for the current directory; call on frames with
+         *        nothing else to do
+         * @param options Listing options the views read with
+         * @param thumbnail_edge Edge of the thumbnails views show, or 0 for none
+         */
+        void OnIdle(const filesystem::EnumerationOptions& options, int thumbnail_edge);
+
+        /**
+         * @brief Whether OnIdle has anything left to do; the caller keeps
+         *        frames coming while it does
+         */
+        bool HasWork() const;
+
+        const PrefetchStats& GetStats() const { return stats_; }
+
+    private:
+        struct Successor
+        {
+            std::string key;
+            double count = 0.0;
+        };
+
+        struct Node
+        {
+            std::string path;                   // As first navigated to
+            double score = 0.0;                 // Frecency at last_visit
+            int64_t last_visit = 0;             // Seconds since the epoch
+            std::vector<Successor> next;        // Most frequent first
+        };
+
+        struct Warm
+        {
+            core::Path path;
+            std::chrono::system_clock::time_point modified;
+        };
+
+        static std::string Key(const std::string& path);
+        static int64_t Now();
+        double Frecency(const Node& node, int64_t now) const;
+        Node& Visit(const std::string& path, double weight, int64_t now);
+        void Prune();
+        bool NetworkAllowed() const;
+        void Start(const filesystem::EnumerationOptions& options);
+        void CollectThumbnails();
+        void RenewThumbnails(int edge);
+        std::string Serialize() const;
+
+        std::unordered_map<std::string, Node> nodes_;
+        core::SnapshotFile file_;
+
+        filesystem::FileSystemManager* fs_manager_ = nullptr;
+        std::shared_ptr<preview::ThumbnailService> thumbnails_;
+
+        std::string current_;                   // Key of the last directory navigated to
+        std::string prefetched_for_;            // Key the read-ahead below was made for
+        std::vector<std::pair<std::string, bool>> outstanding_;    // Keys guessed, and whether on the network
+        std::vector<core::Path> unlisted_;      // Read ahead; files not collected yet
+        std::vector<Warm> warm_;                // Thumbnails still to make
+        filesystem::EnumerationOptions options_;
+        std::chrono::steady_clock::time_point deadline_;
+        PrefetchStats stats_;
+    };
+
+    /**
+     * @brief The read-ahead of this process, shared by every view
+     */
+    PrefetchEngine& GetPrefetchEngine();
+
+} // namespace opacity::ui
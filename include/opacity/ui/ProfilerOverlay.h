@@ -0,0 +1,63 @@
+#pragma once
+
+#include "opacity/core/Profiler.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief Frame times and a per-thread timeline of profiler zones
+     *
+     * The profiler records only while the overlay is open. A frame is the
+     * "Frame" zone MainWindow opens around each frame; selecting one shows
+     * every zone of every thread that overlapped it, and which zones took
+     * the most time in it. Pausing keeps the capture still for reading.
+     * The startup breakdown is shown too, recorded whether or not the
+     * overlay was open then, as are the memory budget and every series
+     * in core::Metrics.
+     */
+    class ProfilerOverlay
+    {
+    public:
+        static constexpr const char* kFrameZone = "Frame";
+
+        ProfilerOverlay() = default;
+        ~ProfilerOverlay();
+
+        void Show();
+        void Hide();
+        bool IsVisible() const { return visible_; }
+
+        void Render();
+
+    private:
+        static constexpr uint64_t kHistory = 4'000'000'000ull;     // Nanoseconds of zones captured
+        static constexpr size_t kMaxFrames = 240;
+
+        void Capture();
+        void RenderFrameGraph();
+        void RenderTimeline(const core::ProfileZone& frame);
+        void RenderHotZones(const core::ProfileZone& frame);
+        void RenderStartup();
+        void RenderMemory();
+        void RenderPrefetch();
+        void RenderMetrics();
+
+        bool visible_ = false;
+        bool paused_ = false;
+        std::vector<core::ProfileThread> threads_;
+        std::vector<core::ProfileZone> frames_;     // Oldest first
+        int selected_frame_ = -1;                   // -1 follows the newest
+
+        char metrics_filter_[64] = {};
+        std::unordered_map<std::string, uint64_t> counter_previous_;   // By series, at the last rate sample
+        std::unordered_map<std::string, double> counter_rates_;        // Per second
+        std::chrono::steady_clock::time_point rates_sampled_;
+    };
+
+} // namespace opacity::ui
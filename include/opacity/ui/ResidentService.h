@@ -0,0 +1,66 @@
+#pragma once
+
+#include "opacity/search/SearchIndex.h"
+#include "opacity/ui/SystemTray.h"
+
+#include <memory>
+
+namespace opacity::ui
+{
+    /**
+     * @brief The resident process behind the tray icon: `opacity resident`
+     *
+     * Owns the one SearchIndex of the session, loads it once, keeps it up
+     * to date and serves it to every window through SystemTray::HostIndex,
+     * so a window opened later finds the index warm instead of loading its
+     * own, and there is one crawler however many windows are open. The
+     * thumbnail, hash and folder-size caches are files every process
+     * already shares.
+     *
+     * It outlives its windows and runs until Exit is chosen from the tray
+     * menu or the session ends. Show Opacity starts a new window.
+     */
+    class ResidentService
+    {
+    public:
+        ResidentService();
+        ~ResidentService();
+
+        // Non-copyable
+        ResidentService(const ResidentService&) = delete;
+        ResidentService& operator=(const ResidentService&) = delete;
+
+        /**
+         * @brief Load and serve the index, and run the tray until exit
+         * @return Process exit code; 0 as well when another process is
+         *         resident already
+         */
+        int Run();
+
+        /**
+         * @brief Whether windows should start the service: the
+         *        resident.enabled setting
+         */
+        static bool IsEnabled();
+
+        /**
+         * @brief Start `opacity resident` in the background unless a
+         *        resident process is running already
+         */
+        static bool Launch();
+
+        /**
+         * @brief What the resident index covers: the resident.roots
+         *        setting, or the user's home folder
+         */
+        static search::IndexConfig DefaultIndexConfig();
+
+    private:
+        void UpdateTooltip();
+        static void OpenWindow();
+
+        std::shared_ptr<search::SearchIndex> index_;
+        SystemTray tray_;
+    };
+
+} // namespace opacity::ui
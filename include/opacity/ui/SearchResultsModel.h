@@ -0,0 +1,160 @@
+#pragma once
+
+#include "opacity/core/MpscQueue.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/filesystem/FsItem.h"
+#include "opacity/search/SearchEngine.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief Results of one search, as the results window lists them
+     *
+     * The search thread pushes results onto a lock-free queue and never
+     * waits for the UI; the UI thread drains it once a frame, at most
+     * kMaxDrainPerFrame at a time, so a flood of hits is spread over a few
+     * frames rather than stalling one. Results are kept in arrival order
+     * and never move; the view is an index over them.
+     *
+     * Sorting is stable and incremental: a drained batch is sorted on its
+     * own and merged into the sorted order, so results that compare equal
+     * stay in arrival order and a new batch costs one merge, not a re-sort.
+     * Grouped by directory, each parent directory becomes a collapsible
+     * row with its results under it, in the same order.
+     *
+     * Content matches may arrive without their matching line
+     * (SearchOptions::capture_context off); Context() has it read on a
+     * scheduler task the first time a row is drawn, a few files at a time,
+     * and the row shows it from a later frame.
+     *
+     * Push() is safe from any thread; everything else is UI thread only.
+     */
+    class SearchResultsModel
+    {
+    public:
+        static constexpr size_t kMaxDrainPerFrame = 50000;
+        static constexpr size_t kMaxContextLoads = 8;
+
+        /**
+         * @brief One line of the view: a result, or a directory heading
+         */
+        struct Row
+        {
+            uint32_t index = 0;             // Into the results, or the groups
+            bool group = false;
+        };
+
+        ~SearchResultsModel();
+
+        /**
+         * @brief Forget every result, and whatever is still queued, for a new search
+         */
+        void Reset();
+
+        /**
+         * @brief Queue a result; any thread
+         */
+        void Push(search::SearchResult result);
+
+        /**
+         * @brief Take queued results into the view
+         * @return true if the rows changed
+         */
+        bool Drain();
+
+        /**
+         * @brief Replace the results outright, already complete
+         */
+        void Assign(std::vector<search::SearchResult> results);
+
+        /**
+         * @brief Order by a column; std::nullopt keeps arrival order
+         */
+        void SetSort(std::optional<filesystem::SortColumn> column, filesystem::SortDirection direction);
+        std::optional<filesystem::SortColumn> GetSortColumn() const { return sort_column_; }
+        filesystem::SortDirection GetSortDirection() const { return sort_direction_; }
+
+        void SetGrouped(bool grouped);
+        bool IsGrouped() const { return grouped_; }
+
+        /**
+         * @brief Expand or collapse a directory heading
+         */
+        void ToggleGroup(uint32_t group);
+
+        size_t GetResultCount() const { return results_.size(); }
+        size_t GetPendingCount() const { return pushed_.load(std::memory_order_relaxed) - drained_; }
+        size_t GetRowCount() const { return grouped_ ? rows_.size() : order_.size(); }
+        Row GetRow(size_t row) const { return grouped_ ? rows_[row] : Row{order_[row], false}; }
+
+        const search::SearchResult& GetResult(uint32_t index) const { return results_[index]; }
+        const std::string& GetGroupDirectory(uint32_t group) const { return groups_[group].directory; }
+        size_t GetGroupSize(uint32_t group) const { return groups_[group].size; }
+        bool IsGroupExpanded(uint32_t group) const { return groups_[group].expanded; }
+
+        /**
+         * @brief The matching line of a content match, read on first use
+         * @return Empty for a match by name, when the file changed, or
+         *         while the line is still being read
+         */
+        const std::string& Context(uint32_t index);
+
+        /**
+         * @brief Matching lines being read; the view has more to show when each is done
+         */
+        size_t GetContextLoadCount() const { return context_loads_; }
+
+    private:
+        struct Group
+        {
+            std::string directory;
+            size_t size = 0;                // Results in it
+            bool expanded = true;
+        };
+
+        struct LoadedContext
+        {
+            uint32_t index = 0;
+            std::string context;
+        };
+
+        void Append(search::SearchResult result);
+        void TakeLoadedContexts();
+        void SortBatch(size_t first);
+        void BuildRows();
+
+        core::MpscQueue<search::SearchResult> pending_;
+        std::atomic<size_t> pushed_{0};
+        size_t drained_ = 0;                        // Of pushed_, taken or dropped
+
+        std::deque<search::SearchResult> results_;  // Arrival order; never moves
+        std::vector<uint32_t> group_of_;            // Per result
+        std::vector<bool> context_read_;            // Per result: Context() has tried
+
+        // Lines read by tasks; a new queue and token for every search, so
+        // a late answer lands in the old one and is dropped with it
+        std::shared_ptr<core::MpscQueue<LoadedContext>> loaded_ =
+            std::make_shared<core::MpscQueue<LoadedContext>>();
+        core::CancellationSource context_cancel_;
+        size_t context_loads_ = 0;                  // Submitted, not yet taken
+        std::vector<uint32_t> order_;               // Results in view order
+        std::vector<Group> groups_;
+        std::unordered_map<std::string, uint32_t> group_index_;
+        std::vector<Row> rows_;                     // Grouped only; otherwise order_ is the view
+
+        std::optional<filesystem::SortColumn> sort_column_;
+        filesystem::SortDirection sort_direction_ = filesystem::SortDirection::Ascending;
+        bool grouped_ = false;
+    };
+
+} // namespace opacity::ui
@@ -0,0 +1,189 @@
+#pragma once
+
+#include "opacity/filesystem/FsItem.h"
+#include "opacity/filesystem/ItemStore.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief Selected positions of a listing, as ranges plus single toggles
+     *
+     * Selections are mostly runs: everything, a shift-click range, or a
+     * few ranges with items ctrl-clicked in and out of them. Runs are kept
+     * as an interval list and single toggles as a bitset over it, so a
+     * position is selected when it is in a range or toggled, but not both.
+     * An inverted flag flips the whole set, which makes select-all and
+     * invert O(1) however long the listing is; the count is kept as it
+     * changes rather than counted.
+     */
+    class SelectionSet
+    {
+    public:
+        /**
+         * @brief Number of positions the set covers; none selected after
+         */
+        void Reset(size_t size);
+
+        /**
+         * @brief Grow or shrink the tail; positions added are not selected
+         */
+        void Resize(size_t size);
+
+        /**
+         * @brief Rebuild from selected(position), in runs
+         */
+        template <typename Predicate>
+        void Assign(size_t size, Predicate&& selected)
+        {
+            Reset(size);
+            for (size_t position = 0; position < size;)
+            {
+                if (!selected(position))
+                {
+                    ++position;
+                    continue;
+                }
+                size_t begin = position;
+                while (position < size && selected(position))
+                    ++position;
+                ranges_.push_back({begin, position});
+                raw_count_ += position - begin;
+            }
+        }
+
+        size_t Size() const { return size_; }
+        size_t Count() const { return inverted_ ? size_ - raw_count_ : raw_count_; }
+        bool IsEmpty() const { return Count() == 0; }
+
+        bool Contains(size_t position) const { return position < size_ && (InRanges(position) != Toggled(position)) != inverted_; }
+
+        void Set(size_t position, bool selected);
+        void Toggle(size_t position);
+
+        /**
+         * @brief Select or deselect [begin, end)
+         */
+        void SetRange(size_t begin, size_t end, bool selected);
+
+        void SelectAll();
+        void Clear();
+        void Invert() { inverted_ = !inverted_; }
+
+        /**
+         * @brief Call fn(position) for every selected position in order
+         */
+        template <typename Fn>
+        void ForEach(Fn&& fn) const
+        {
+            // Between and inside ranges a position is selected when its
+            // toggle differs from the run it is in
+            size_t position = 0;
+            for (const auto& range : ranges_)
+            {
+                VisitRun(position, range.begin, inverted_, fn);
+                VisitRun(range.begin, range.end, !inverted_, fn);
+                position = range.end;
+            }
+            VisitRun(position, size_, inverted_, fn);
+        }
+
+    private:
+        struct Range
+        {
+            size_t begin;
+            size_t end;
+        };
+
+        static size_t CountTrailingZeros(uint64_t bits);
+
+        bool InRanges(size_t position) const;
+        bool Toggled(size_t position) const
+        {
+            size_t word = position >> 6;
+            return word < words_.size() && ((words_[word] >> (position & 63)) & 1);
+        }
+
+        size_t CountRaw(size_t begin, size_t end) const;
+        size_t CountToggled(size_t begin, size_t end) const;
+        void ClearToggles(size_t begin, size_t end);
+        void AddRange(size_t begin, size_t end);
+        void RemoveRange(size_t begin, size_t end);
+
+        template <typename Fn>
+        void VisitRun(size_t begin, size_t end, bool selected, Fn& fn) const
+        {
+            for (size_t position = begin; position < end;)
+            {
+                // Without toggles past the bitset, an unselected run is done
+                size_t word = position >> 6;
+                if (!selected && word >= words_.size())
+                    return;
+
+                uint64_t bits = word < words_.size() ? words_[word] : 0;
+                if (selected)
+                    bits = ~bits;
+                bits &= ~uint64_t{0} << (position & 63);
+                size_t word_end = (word + 1) << 6;
+                if (end < word_end)
+                    bits &= (uint64_t{1} << (end & 63)) - 1;
+
+                while (bits)
+                {
+                    fn((word << 6) + CountTrailingZeros(bits));
+                    bits &= bits - 1;
+                }
+                position = word_end;
+            }
+        }
+
+        size_t size_ = 0;
+        bool inverted_ = false;
+        size_t raw_count_ = 0;          // Positions in a range or toggled, before inverting
+        std::vector<Range> ranges_;     // Sorted, disjoint and not touching
+        std::vector<uint64_t> words_;   // Toggles; only as long as the last one needs
+    };
+
+    /**
+     * @brief A pane's selection as its callback sees it
+     *
+     * Borrows the pane's state rather than copying items, so it is only
+     * valid during the callback; positions index the view order.
+     */
+    class SelectionView
+    {
+    public:
+        SelectionView(const SelectionSet& selection, const filesystem::ItemStore& store,
+                      const std::vector<filesystem::ItemStore::Index>& order)
+            : selection_(selection), store_(store), order_(order) {}
+
+        size_t Count() const { return selection_.Count(); }
+        bool IsEmpty() const { return selection_.IsEmpty(); }
+        bool Contains(size_t position) const { return selection_.Contains(position); }
+
+        const filesystem::ItemStore& GetItemStore() const { return store_; }
+
+        /**
+         * @brief Call fn(position, store index) for every selected item in view order
+         */
+        template <typename Fn>
+        void ForEach(Fn&& fn) const
+        {
+            selection_.ForEach([&](size_t position) { fn(position, order_[position]); });
+        }
+
+        /**
+         * @brief Copy the selected items out, for callers that keep them
+         */
+        std::vector<filesystem::FsItem> Materialize() const;
+
+    private:
+        const SelectionSet& selection_;
+        const filesystem::ItemStore& store_;
+        const std::vector<filesystem::ItemStore::Index>& order_;
+    };
+
+} // namespace opacity::ui
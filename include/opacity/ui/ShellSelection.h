@@ -0,0 +1,62 @@
+#pragma once
+
+#include "opacity/core/ShellIntegration.h"
+#include "opacity/filesystem/ItemStore.h"
+#include "opacity/ui/SelectionSet.h"
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace opacity::ui
+{
+    /**
+     * @brief A pane's selection handed to the shell as it stood when copied
+     *
+     * Keeps the listing, the selection ranges and the view order as they
+     * were: copying a selection of any size is a few block copies, with
+     * nothing built per item. The first request from a target lists the
+     * selected items once, in view order, and builds each path only as
+     * it is asked for.
+     *
+     * Items inside a ZIP archive have no path the shell can open, so they
+     * go out as virtual files: selected folders are expanded from the
+     * archive's index, and each file is inflated straight into the
+     * target's stream, never to a temporary copy. Cloud placeholders keep
+     * their paths; nothing is downloaded until the target reads them.
+     */
+    class SelectionFileSource : public core::ShellFileSource
+    {
+    public:
+        SelectionFileSource(filesystem::ItemStore store, SelectionSet selection,
+                            std::vector<filesystem::ItemStore::Index> order);
+
+        bool HasPaths() const override;
+        size_t Count() const override;
+        std::wstring GetPath(size_t index) const override;
+        core::ShellVirtualFile Describe(size_t index) const override;
+        std::unique_ptr<core::ShellFileReader> Open(size_t index) const override;
+
+    private:
+        struct ArchiveFile
+        {
+            std::string path;                   // archive.zip!entry, as ArchiveFileSystem opens it
+            core::ShellVirtualFile file;
+        };
+
+        void Resolve() const;
+        void ResolveArchive() const;
+
+        filesystem::ItemStore store_;
+        SelectionSet selection_;
+        std::vector<filesystem::ItemStore::Index> order_;
+        bool archive_ = false;
+
+        mutable std::once_flag resolved_;
+        mutable std::vector<filesystem::ItemStore::Index> items_;  // Selected, in view order
+        mutable std::vector<ArchiveFile> archive_files_;            // Folders before their contents
+    };
+
+} // namespace opacity::ui
@@ -7,6 +7,11 @@
 #include <string>
 #include <vector>
 
+namespace opacity::search
+{
+    class SearchIndex;
+}
+
 namespace opacity::ui
 {
     /**
@@ -300,6 +305,41 @@ namespace opacity::ui
          */
         void OnNotificationClick(TrayNotificationCallback callback);
 
+        /**
+         * @brief Set what Show Opacity and clicks on the icon do, in place
+         *        of restoring the window the tray was given
+         */
+        void OnShowRequested(std::function<void()> callback);
+
+        // ============== Resident Index ==============
+
+        /**
+         * @brief Serve this index to every Opacity window of the session
+         *        for as long as the tray icon lives
+         *
+         * Windows reach it through search::IndexClient; see
+         * search::IndexHost. Stopped by Shutdown.
+         *
+         * @return false when another process hosts an index already
+         */
+        bool HostIndex(std::shared_ptr<search::SearchIndex> index);
+
+        /**
+         * @brief Stop serving the index; connected windows fall back to
+         *        their own searches
+         */
+        void StopHostingIndex();
+
+        /**
+         * @brief Whether this tray serves an index
+         */
+        bool IsHostingIndex() const;
+
+        /**
+         * @brief Windows connected to the hosted index
+         */
+        size_t GetIndexClientCount() const;
+
         // ============== Configuration ==============
 
         /**
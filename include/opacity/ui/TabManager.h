@@ -1,6 +1,7 @@
 #pragma once
 
 #include "opacity/ui/FilePane.h"
+#include <chrono>
 #include <memory>
 #include <vector>
 #include <string>
@@ -18,6 +19,7 @@ namespace opacity::ui
         bool is_pinned = false;
         bool is_modified = false;  // For future: track unsaved changes
         std::string color;         // Optional tab color (hex string)
+        std::chrono::steady_clock::time_point last_viewed = std::chrono::steady_clock::now();
         
         Tab() = default;
         Tab(std::unique_ptr<FilePane> p) : pane(std::move(p)) {}
@@ -27,6 +29,20 @@ namespace opacity::ui
         Tab& operator=(Tab&&) = default;
     };
 
+    /**
+     * @brief A saved tab, restored without reading its directory
+     */
+    struct TabStub
+    {
+        std::string path;
+        std::string title;                          // Empty for the directory name
+        std::vector<std::string> selected_names;
+        std::string focused_name;
+        float scroll_y = -1.0f;                     // Negative for the top
+        bool is_pinned = false;
+        std::string color;
+    };
+
     /**
      * @brief Manages a collection of tabs, each containing a FilePane
      * 
@@ -35,6 +51,7 @@ namespace opacity::ui
      * - Tab pinning and custom colors
      * - Recently closed tab history for restoration
      * - Tab group management
+     * - Hibernation of tabs left in the background
      */
     class TabManager
     {
@@ -42,7 +59,15 @@ namespace opacity::ui
         using TabId = FilePane::PaneId;
         using TabChangedCallback = std::function<void(TabId active_tab)>;
 
-        TabManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager);
+        /**
+         * @param thumbnails Handed to every pane for its icons view; may be null
+         * @param folder_sizes Handed to every pane for its Size column; may be null
+         * @param icons Handed to every pane for the icons of its rows; may be null
+         */
+        TabManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager,
+                   std::shared_ptr<preview::ThumbnailService> thumbnails = nullptr,
+                   std::shared_ptr<search::FolderSizeService> folder_sizes = nullptr,
+                   std::shared_ptr<preview::IconService> icons = nullptr);
         ~TabManager();
 
         // Prevent copying
@@ -57,6 +82,15 @@ namespace opacity::ui
          */
         TabId CreateTab(const std::string& path = "", bool make_active = true);
 
+        /**
+         * @brief Replace every tab with saved ones, none of them read yet
+         *
+         * Each tab is a hibernated pane; the active one reads its directory
+         * when first drawn, the others when activated or woken. An empty
+         * list leaves one new tab at the home directory.
+         */
+        void RestoreTabs(const std::vector<TabStub>& tabs, size_t active_index);
+
         /**
          * @brief Close a tab
          * @param id Tab to close
@@ -114,6 +148,7 @@ namespace opacity::ui
         // Active tab management
         void SetActiveTab(TabId id);
         TabId GetActiveTabId() const;
+        size_t GetActiveTabIndex() const { return active_tab_index_; }
         FilePane* GetActivePane();
         const FilePane* GetActivePane() const;
 
@@ -138,6 +173,19 @@ namespace opacity::ui
          */
         void Render(float width, float height);
 
+        /**
+         * @brief When background tabs release their listings
+         * @param idle_after Hibernate a tab not shown for this long; zero never does
+         * @param memory_budget Bytes the listings of awake tabs may hold before
+         *        the longest unseen are hibernated early; zero for no limit
+         */
+        void SetHibernation(std::chrono::seconds idle_after, size_t memory_budget);
+
+        /**
+         * @brief Handed to every pane, now and later; see FilePane::SetRedrawCallback
+         */
+        void SetRedrawCallback(FilePane::RedrawCallback callback);
+
         /**
          * @brief Set callback for when active tab changes
          */
@@ -159,12 +207,17 @@ namespace opacity::ui
         void SwitchToTab(int index);
 
     private:
+        std::unique_ptr<FilePane> CreatePane() const;
         void RenderTabBar();
         void RenderTabContextMenu(size_t tab_index);
         size_t FindTabIndex(TabId id) const;
         void EnsureActiveTabValid();
+        void UpdateHibernation();
 
         std::shared_ptr<filesystem::FileSystemManager> fs_manager_;
+        std::shared_ptr<preview::ThumbnailService> thumbnails_;
+        std::shared_ptr<search::FolderSizeService> folder_sizes_;
+        std::shared_ptr<preview::IconService> icons_;
         std::vector<Tab> tabs_;
         size_t active_tab_index_ = 0;
 
@@ -179,6 +232,16 @@ namespace opacity::ui
         static constexpr size_t MAX_CLOSED_TABS = 10;
 
         TabChangedCallback on_tab_changed_;
+        FilePane::RedrawCallback on_redraw_;
+
+        // Background tabs drop their listings after a while, or sooner when
+        // awake ones hold more than the budget
+        static constexpr std::chrono::seconds kDefaultHibernateAfter{600};
+        static constexpr size_t kDefaultMemoryBudget = 256 * 1024 * 1024;
+        static constexpr std::chrono::seconds kHibernationCheckInterval{1};
+        std::chrono::seconds hibernate_after_ = kDefaultHibernateAfter;
+        size_t memory_budget_ = kDefaultMemoryBudget;
+        std::chrono::steady_clock::time_point next_hibernation_check_;
     };
 
 } // namespace opacity::ui
@@ -47,6 +47,13 @@ namespace opacity::ui
         unsigned int image;
         unsigned int document;
         unsigned int code;
+
+        // Syntax colors for text previews
+        unsigned int syntax_keyword;
+        unsigned int syntax_string;
+        unsigned int syntax_comment;
+        unsigned int syntax_number;
+        unsigned int syntax_preprocessor;
     };
 
     /**
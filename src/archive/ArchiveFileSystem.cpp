@@ -0,0 +1,721 @@
+#include "opacity/archive/ArchiveFileSystem.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/HashCache.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/MappedFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <type_traits>
+#include <unordered_map>
+
+// miniz for ZIP support
+#include "miniz.h"
+#include "miniz_zip.h"
+
+namespace opacity::archive
+{
+    namespace
+    {
+        constexpr size_t kMaxMounts = 4;
+        constexpr size_t kMaxIdleReaders = 4;
+        constexpr size_t kSkipBlockSize = 64 * 1024;
+
+        // Inflate checkpoints: never closer than kMinCheckpointInterval, and
+        // at most kMaxCheckpoints per entry (each holds a 32KB dictionary)
+        constexpr uint64_t kMinCheckpointInterval = 4 * 1024 * 1024;
+        constexpr uint64_t kMaxCheckpoints = 64;
+
+        constexpr uint32_t kIndexMagic = 0x58444941;    // "AIDX"
+        constexpr uint32_t kRecordMagic = 0x50434941;   // "AICP"
+        constexpr uint32_t kIndexVersion = 1;
+
+        /**
+         * @brief Everything needed to resume inflating an entry part way
+         *
+         * The iterator state of a mapped archive holds no pointers of its
+         * own besides its buffers, so the inflator, the window it writes
+         * into and the offsets around them are the whole of it.
+         */
+        struct Checkpoint
+        {
+            uint64_t output = 0;            // Bytes inflated before this point
+            uint64_t read_buf_ofs = 0;
+            uint64_t read_buf_avail = 0;
+            uint64_t comp_remaining = 0;
+            uint64_t cur_file_ofs = 0;
+            uint64_t out_blk_remain = 0;
+            int32_t status = 0;
+            uint32_t crc = 0;               // Of the bytes inflated so far
+            tinfl_decompressor inflator;
+            mz_uint8 dictionary[TINFL_LZ_DICT_SIZE];
+        };
+
+        static_assert(std::is_trivially_copyable_v<Checkpoint>, "checkpoints are written as they are");
+
+        struct IndexHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+            uint32_t checkpoint_size;       // Differs if miniz's inflator changes
+            uint32_t reserved;
+            int64_t modified;
+            uint64_t size;
+        };
+
+        struct IndexRecord
+        {
+            uint32_t magic;
+            uint32_t checksum;              // Of the file index and the checkpoint
+            uint32_t file;                  // Index within the archive
+            uint32_t reserved;
+        };
+
+        uint32_t Checksum(uint32_t file, const Checkpoint& checkpoint)
+        {
+            core::Xxh64 hash;
+            hash.Update(&file, sizeof(file));
+            hash.Update(&checkpoint, sizeof(Checkpoint));
+            return static_cast<uint32_t>(hash.Digest());
+        }
+
+        // Next to the hash cache, one file per archive named by its path
+        std::filesystem::path IndexLocation(const std::string& archive)
+        {
+            core::Xxh64 hash;
+            hash.Update(archive.data(), archive.size());
+            return core::HashCache::DefaultLocation().Get().parent_path() / "archives" / (hash.HexDigest() + ".idx");
+        }
+
+        uint64_t CheckpointInterval(uint64_t size)
+        {
+            return std::max(kMinCheckpointInterval, size / kMaxCheckpoints);
+        }
+
+        /**
+         * @brief One archive, mapped and indexed, shared by its open streams
+         *
+         * A miniz reader is not safe to share, so each stream borrows one of
+         * its own; readers are kept for the next stream rather than parsing
+         * the central directory again.
+         */
+        struct Mount
+        {
+            std::string path;
+            int64_t modified = 0;
+            uint64_t size = 0;
+            core::MappedFile mapping;
+            std::vector<ArchiveEntry> files;
+            std::vector<mz_uint> indices;                       // Of each file within the archive
+            std::unordered_map<std::string, size_t> by_name;    // Into files
+
+            std::mutex readers_mutex;
+            std::vector<mz_zip_archive*> idle_readers;
+
+            // Shared by every stream on the archive, by archive index, in order of output
+            std::mutex checkpoints_mutex;
+            std::unordered_map<mz_uint, std::vector<std::shared_ptr<const Checkpoint>>> checkpoints;
+            bool checkpoints_saved = true;
+
+            ~Mount()
+            {
+                for (auto* reader : idle_readers)
+                {
+                    mz_zip_reader_end(reader);
+                    delete reader;
+                }
+            }
+
+            mz_zip_archive* AcquireReader()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(readers_mutex);
+                    if (!idle_readers.empty())
+                    {
+                        auto* reader = idle_readers.back();
+                        idle_readers.pop_back();
+                        return reader;
+                    }
+                }
+
+                // Without a mapping (an empty file, or no address space for it) each reader opens the file
+                auto* reader = new mz_zip_archive{};
+                bool opened = mapping.IsOpen()
+                    ? mz_zip_reader_init_mem(reader, mapping.Data(), mapping.Size(), MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)
+                    : mz_zip_reader_init_file(reader, path.c_str(), MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY);
+                if (!opened)
+                {
+                    delete reader;
+                    return nullptr;
+                }
+                return reader;
+            }
+
+            void ReleaseReader(mz_zip_archive* reader)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(readers_mutex);
+                    if (idle_readers.size() < kMaxIdleReaders)
+                    {
+                        idle_readers.push_back(reader);
+                        return;
+                    }
+                }
+                mz_zip_reader_end(reader);
+                delete reader;
+            }
+
+            // The last checkpoint at or before offset
+            std::shared_ptr<const Checkpoint> FindCheckpoint(mz_uint index, uint64_t offset)
+            {
+                std::lock_guard<std::mutex> lock(checkpoints_mutex);
+                auto it = checkpoints.find(index);
+                if (it == checkpoints.end())
+                    return nullptr;
+
+                const auto& list = it->second;
+                auto after = std::upper_bound(list.begin(), list.end(), offset,
+                    [](uint64_t value, const auto& checkpoint) { return value < checkpoint->output; });
+                return after == list.begin() ? nullptr : *std::prev(after);
+            }
+
+            // Kept unless one already lies within an interval of it
+            void AddCheckpoint(mz_uint index, uint64_t interval, std::shared_ptr<const Checkpoint> checkpoint)
+            {
+                std::lock_guard<std::mutex> lock(checkpoints_mutex);
+                auto& list = checkpoints[index];
+                auto at = std::lower_bound(list.begin(), list.end(), checkpoint->output,
+                    [](const auto& existing, uint64_t value) { return existing->output < value; });
+                if (at != list.end() && (*at)->output - checkpoint->output < interval)
+                    return;
+                if (at != list.begin() && checkpoint->output - (*std::prev(at))->output < interval)
+                    return;
+
+                list.insert(at, std::move(checkpoint));
+                checkpoints_saved = false;
+            }
+
+            void LoadCheckpoints()
+            {
+                std::ifstream in(IndexLocation(path), std::ios::binary);
+                IndexHeader header{};
+                if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+                    header.magic != kIndexMagic || header.version != kIndexVersion ||
+                    header.checkpoint_size != sizeof(Checkpoint) ||
+                    header.modified != modified || header.size != size)
+                {
+                    return;
+                }
+
+                std::unordered_map<mz_uint, size_t> positions;
+                for (size_t i = 0; i < indices.size(); ++i)
+                    positions.emplace(indices[i], i);
+
+                std::lock_guard<std::mutex> lock(checkpoints_mutex);
+                IndexRecord record{};
+                while (in.read(reinterpret_cast<char*>(&record), sizeof(record)))
+                {
+                    auto checkpoint = std::make_shared<Checkpoint>();
+                    if (!in.read(reinterpret_cast<char*>(checkpoint.get()), sizeof(Checkpoint)) ||
+                        record.magic != kRecordMagic || record.checksum != Checksum(record.file, *checkpoint))
+                    {
+                        break;
+                    }
+
+                    // Never resume past the end of an entry
+                    auto found = positions.find(record.file);
+                    if (found == positions.end() || checkpoint->output >= files[found->second].uncompressed_size)
+                        continue;
+                    checkpoints[record.file].push_back(std::move(checkpoint));
+                }
+                for (auto& [file, list] : checkpoints)
+                {
+                    std::sort(list.begin(), list.end(),
+                        [](const auto& a, const auto& b) { return a->output < b->output; });
+                }
+            }
+
+            void SaveCheckpoints()
+            {
+                std::lock_guard<std::mutex> lock(checkpoints_mutex);
+                if (checkpoints_saved)
+                    return;
+                checkpoints_saved = true;
+
+                std::error_code error;
+                auto location = IndexLocation(path);
+                std::filesystem::create_directories(location.parent_path(), error);
+
+                // Written aside and renamed, so a reader never sees half a file
+                auto temp_location = location;
+                temp_location += ".tmp";
+                {
+                    std::ofstream out(temp_location, std::ios::binary | std::ios::trunc);
+                    IndexHeader header{kIndexMagic, kIndexVersion, static_cast<uint32_t>(sizeof(Checkpoint)), 0, modified, size};
+                    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                    for (const auto& [file, list] : checkpoints)
+                    {
+                        for (const auto& checkpoint : list)
+                        {
+                            IndexRecord record{kRecordMagic, Checksum(file, *checkpoint), file, 0};
+                            out.write(reinterpret_cast<const char*>(&record), sizeof(record));
+                            out.write(reinterpret_cast<const char*>(checkpoint.get()), sizeof(Checkpoint));
+                        }
+                    }
+                    if (!out)
+                    {
+                        SPDLOG_WARN("Failed to write archive index: {}", location.string());
+                        return;
+                    }
+                }
+                std::filesystem::rename(temp_location, location, error);
+            }
+        };
+
+        std::mutex mounts_mutex;
+        std::vector<std::shared_ptr<Mount>> mounts;     // Most recently used first
+
+        // Entry names are matched with forward slashes and no leading one
+        std::string NormalizeName(std::string name)
+        {
+            std::replace(name.begin(), name.end(), '\\', '/');
+            size_t start = name.find_first_not_of('/');
+            return start == std::string::npos ? std::string() : name.substr(start);
+        }
+
+        std::shared_ptr<Mount> GetMount(const std::string& path)
+        {
+            core::Path archive_path(path);
+            std::error_code error;
+            int64_t modified = std::filesystem::last_write_time(archive_path.Get(), error).time_since_epoch().count();
+            uint64_t size = error ? 0 : std::filesystem::file_size(archive_path.Get(), error);
+            if (error)
+                return nullptr;
+
+            {
+                std::lock_guard<std::mutex> lock(mounts_mutex);
+                for (auto it = mounts.begin(); it != mounts.end(); ++it)
+                {
+                    if ((*it)->path != path)
+                        continue;
+
+                    // Streams still open on a replaced archive keep the old mount alive
+                    if ((*it)->modified == modified && (*it)->size == size)
+                    {
+                        std::rotate(mounts.begin(), it, std::next(it));
+                        return mounts.front();
+                    }
+                    mounts.erase(it);
+                    break;
+                }
+            }
+
+            auto mount = std::make_shared<Mount>();
+            mount->path = path;
+            mount->modified = modified;
+            mount->size = size;
+            mount->mapping.Open(archive_path.Get());
+
+            mz_zip_archive* reader = mount->AcquireReader();
+            if (!reader)
+            {
+                SPDLOG_WARN("Failed to mount archive: {}", path);
+                return nullptr;
+            }
+
+            mz_uint num_files = mz_zip_reader_get_num_files(reader);
+            mount->files.reserve(num_files);
+            mount->indices.reserve(num_files);
+            for (mz_uint i = 0; i < num_files; ++i)
+            {
+                mz_zip_archive_file_stat stat;
+                if (!mz_zip_reader_file_stat(reader, i, &stat) || stat.m_is_directory)
+                    continue;
+
+                ArchiveEntry entry;
+                entry.name = stat.m_filename;
+                entry.full_path = stat.m_filename;
+                entry.compressed_size = stat.m_comp_size;
+                entry.uncompressed_size = stat.m_uncomp_size;
+                entry.is_encrypted = stat.m_is_encrypted;
+                entry.crc32 = stat.m_crc32;
+                if (entry.uncompressed_size > 0)
+                {
+                    entry.compression_ratio = 1.0 -
+                        (static_cast<double>(entry.compressed_size) / entry.uncompressed_size);
+                }
+                std::time_t time = stat.m_time;
+                entry.modified_time = std::chrono::system_clock::from_time_t(time);
+
+                // The first of two entries with one name wins, as with mz_zip_reader_locate_file
+                mount->by_name.emplace(NormalizeName(entry.name), mount->files.size());
+                mount->files.push_back(std::move(entry));
+                mount->indices.push_back(i);
+            }
+            mount->ReleaseReader(reader);
+            mount->LoadCheckpoints();
+
+            std::lock_guard<std::mutex> lock(mounts_mutex);
+            mounts.insert(mounts.begin(), mount);
+            if (mounts.size() > kMaxMounts)
+                mounts.pop_back();
+            return mount;
+        }
+
+        // Mount and position in files, for "archive!entry"
+        bool Resolve(const std::string& path, std::shared_ptr<Mount>& mount, size_t& file)
+        {
+            std::string archive;
+            std::string entry;
+            if (!ArchiveFileSystem::SplitPath(path, archive, entry))
+                return false;
+
+            mount = GetMount(archive);
+            if (!mount)
+                return false;
+
+            auto it = mount->by_name.find(entry);
+            if (it == mount->by_name.end())
+                return false;
+            file = it->second;
+            return true;
+        }
+    }
+
+    struct ArchiveStream::Impl
+    {
+        std::shared_ptr<Mount> mount;
+        mz_zip_archive* reader = nullptr;
+        mz_uint index = 0;
+        uint64_t size = 0;
+
+        mz_zip_reader_extract_iter_state* iterator = nullptr;
+        uint64_t produced = 0;          // Bytes inflated so far
+        uint64_t position = 0;
+        std::vector<char> window;       // The last bytes inflated, by position modulo its size
+        uint64_t buffered = 0;          // Of those, how many the window holds
+        bool failed = false;
+
+        uint64_t checkpoint_interval = 0;
+        uint64_t next_checkpoint = 0;   // Output offset at which to take one; 0 when none are taken
+
+        ~Impl()
+        {
+            if (iterator)
+                mz_zip_reader_extract_iter_free(iterator);
+            if (reader)
+                mount->ReleaseReader(reader);
+            if (mount)
+                mount->SaveCheckpoints();
+        }
+
+        bool Restart()
+        {
+            if (iterator)
+                mz_zip_reader_extract_iter_free(iterator);
+            produced = 0;
+            buffered = 0;
+            iterator = size > 0 ? mz_zip_reader_extract_iter_new(reader, index, 0) : nullptr;
+            failed = size > 0 && !iterator;
+
+            // Only an inflater reading straight from the mapping can be captured
+            bool capture = iterator && iterator->pWrite_buf && mount->mapping.IsOpen() &&
+                           size > checkpoint_interval;
+            next_checkpoint = capture ? checkpoint_interval : 0;
+            return !failed;
+        }
+
+        uint64_t WindowStart() const
+        {
+            return produced - buffered;
+        }
+
+        void TakeCheckpoint()
+        {
+            auto checkpoint = std::make_shared<Checkpoint>();
+            checkpoint->output = iterator->out_buf_ofs;
+            checkpoint->read_buf_ofs = iterator->read_buf_ofs;
+            checkpoint->read_buf_avail = iterator->read_buf_avail;
+            checkpoint->comp_remaining = iterator->comp_remaining;
+            checkpoint->cur_file_ofs = iterator->cur_file_ofs;
+            checkpoint->out_blk_remain = iterator->out_blk_remain;
+            checkpoint->status = iterator->status;
+            checkpoint->crc = iterator->file_crc32;
+            checkpoint->inflator = iterator->inflator;
+            std::memcpy(checkpoint->dictionary, iterator->pWrite_buf, TINFL_LZ_DICT_SIZE);
+            mount->AddCheckpoint(index, checkpoint_interval, std::move(checkpoint));
+        }
+
+        // Resume inflating where a checkpoint was taken
+        bool Resume(const Checkpoint& checkpoint)
+        {
+            if (!iterator && !Restart())
+                return false;
+            if (!iterator || !iterator->pWrite_buf)
+                return false;
+
+            // A checkpoint read back from disk must still fit the entry
+            if (checkpoint.read_buf_ofs + checkpoint.read_buf_avail > iterator->file_stat.m_comp_size ||
+                checkpoint.out_blk_remain > TINFL_LZ_DICT_SIZE || checkpoint.output >= size)
+            {
+                return false;
+            }
+
+            iterator->read_buf_ofs = checkpoint.read_buf_ofs;
+            iterator->read_buf_avail = checkpoint.read_buf_avail;
+            iterator->comp_remaining = checkpoint.comp_remaining;
+            iterator->cur_file_ofs = checkpoint.cur_file_ofs;
+            iterator->out_buf_ofs = checkpoint.output;
+            iterator->out_blk_remain = static_cast<size_t>(checkpoint.out_blk_remain);
+            iterator->status = checkpoint.status;
+            iterator->file_crc32 = checkpoint.crc;
+            iterator->inflator = checkpoint.inflator;
+            std::memcpy(iterator->pWrite_buf, checkpoint.dictionary, TINFL_LZ_DICT_SIZE);
+
+            produced = checkpoint.output;
+            buffered = 0;
+            next_checkpoint = next_checkpoint ? produced + checkpoint_interval : 0;
+            return true;
+        }
+
+        void Remember(const char* data, size_t length)
+        {
+            const size_t capacity = window.size();
+            uint64_t at = produced;
+            buffered = std::min<uint64_t>(capacity, buffered + length);
+            if (length > capacity)
+            {
+                data += length - capacity;
+                at += length - capacity;
+                length = capacity;
+            }
+            while (length > 0)
+            {
+                size_t slot = static_cast<size_t>(at % capacity);
+                size_t chunk = std::min(length, capacity - slot);
+                std::memcpy(window.data() + slot, data, chunk);
+                data += chunk;
+                at += chunk;
+                length -= chunk;
+            }
+        }
+
+        size_t Recall(char* buffer, size_t length)
+        {
+            const size_t capacity = window.size();
+            length = static_cast<size_t>(std::min<uint64_t>(length, produced - position));
+            size_t done = 0;
+            while (done < length)
+            {
+                size_t slot = static_cast<size_t>((position + done) % capacity);
+                size_t chunk = std::min(length - done, capacity - slot);
+                std::memcpy(buffer + done, window.data() + slot, chunk);
+                done += chunk;
+            }
+            return done;
+        }
+
+        // Continue inflating at produced, which must be the position
+        size_t Inflate(char* buffer, size_t length)
+        {
+            if (!iterator || failed)
+                return 0;
+
+            size_t read = mz_zip_reader_extract_iter_read(iterator, buffer, length);
+            Remember(buffer, read);
+            produced += read;
+
+            if (next_checkpoint && produced >= next_checkpoint && produced < size)
+            {
+                TakeCheckpoint();
+                next_checkpoint = produced + checkpoint_interval;
+            }
+
+            // The CRC is only checked once the whole entry has come out
+            if (produced >= size || read == 0)
+            {
+                failed = !mz_zip_reader_extract_iter_free(iterator) || produced != size;
+                iterator = nullptr;
+                if (failed)
+                    SPDLOG_WARN("Corrupt entry {} in archive: {}", index, mount->path);
+            }
+            return read;
+        }
+    };
+
+    ArchiveStream::ArchiveStream(std::unique_ptr<Impl> impl)
+        : impl_(std::move(impl))
+    {
+    }
+
+    ArchiveStream::~ArchiveStream() = default;
+
+    uint64_t ArchiveStream::GetSize() const
+    {
+        return impl_->size;
+    }
+
+    uint64_t ArchiveStream::Tell() const
+    {
+        return impl_->position;
+    }
+
+    bool ArchiveStream::HasFailed() const
+    {
+        return impl_->failed;
+    }
+
+    size_t ArchiveStream::Read(void* buffer, size_t length)
+    {
+        Impl& impl = *impl_;
+        char* out = static_cast<char*>(buffer);
+        length = static_cast<size_t>(std::min<uint64_t>(length, impl.size - impl.position));
+
+        size_t done = 0;
+        if (impl.position < impl.produced)
+        {
+            done = impl.Recall(out, length);
+            impl.position += done;
+        }
+        while (done < length && !impl.failed)
+        {
+            size_t read = impl.Inflate(out + done, length - done);
+            if (read == 0)
+                break;
+            done += read;
+            impl.position += read;
+        }
+        return done;
+    }
+
+    bool ArchiveStream::Seek(uint64_t offset)
+    {
+        Impl& impl = *impl_;
+        if (offset > impl.size || impl.failed)
+            return false;
+
+        if (offset >= impl.WindowStart() && offset <= impl.produced)
+        {
+            impl.position = offset;
+            return true;
+        }
+
+        // Resume from the nearest checkpoint when it saves inflating
+        // anything, or else start over when the offset is behind
+        auto checkpoint = impl.mount->FindCheckpoint(impl.index, offset);
+        bool resumed = checkpoint && (offset < impl.produced || checkpoint->output > impl.produced) &&
+                       impl.Resume(*checkpoint);
+        if (!resumed && offset < impl.produced && !impl.Restart())
+        {
+            return false;
+        }
+
+        if (offset <= impl.produced)
+        {
+            impl.position = offset;
+            return true;
+        }
+
+        // Inflate up to the offset; what is skipped still passes through the window
+        impl.position = impl.produced;
+        std::vector<char> skip(static_cast<size_t>(std::min<uint64_t>(kSkipBlockSize, offset - impl.produced)));
+        while (impl.produced < offset)
+        {
+            size_t want = static_cast<size_t>(std::min<uint64_t>(skip.size(), offset - impl.produced));
+            size_t read = impl.Inflate(skip.data(), want);
+            impl.position = impl.produced;
+            if (read == 0)
+                return false;
+        }
+        return true;
+    }
+
+    namespace ArchiveFileSystem
+    {
+        bool SplitPath(const std::string& path, std::string& archive, std::string& entry)
+        {
+            for (size_t at = path.find(kSeparator); at != std::string::npos; at = path.find(kSeparator, at + 1))
+            {
+                if (ArchiveManager::GetFormat(core::Path(path.substr(0, at))) != ArchiveFormat::Zip)
+                    continue;
+
+                entry = NormalizeName(path.substr(at + 1));
+                if (entry.empty())
+                    return false;
+                archive = path.substr(0, at);
+                return true;
+            }
+            return false;
+        }
+
+        bool IsArchivePath(const std::string& path)
+        {
+            std::string archive;
+            std::string entry;
+            return SplitPath(path, archive, entry);
+        }
+
+        std::string JoinPath(const core::Path& archive, const std::string& entry)
+        {
+            return archive.String() + kSeparator + entry;
+        }
+
+        bool Stat(const std::string& path, ArchiveEntry& entry)
+        {
+            std::shared_ptr<Mount> mount;
+            size_t file = 0;
+            if (!Resolve(path, mount, file))
+                return false;
+            entry = mount->files[file];
+            return true;
+        }
+
+        std::vector<ArchiveEntry> ListFiles(const core::Path& archive)
+        {
+            auto mount = GetMount(archive.String());
+            return mount ? mount->files : std::vector<ArchiveEntry>{};
+        }
+
+        std::unique_ptr<ArchiveStream> Open(const std::string& path)
+        {
+            auto impl = std::make_unique<ArchiveStream::Impl>();
+            size_t file = 0;
+            if (!Resolve(path, impl->mount, file))
+                return nullptr;
+
+            const ArchiveEntry& entry = impl->mount->files[file];
+            if (entry.is_encrypted)
+                return nullptr;
+
+            impl->index = impl->mount->indices[file];
+            impl->size = entry.uncompressed_size;
+            impl->checkpoint_interval = CheckpointInterval(impl->size);
+            impl->window.resize(static_cast<size_t>(std::max<uint64_t>(1, std::min<uint64_t>(ArchiveStream::kWindowSize, impl->size))));
+
+            impl->reader = impl->mount->AcquireReader();
+            if (!impl->reader || !impl->Restart())
+                return nullptr;
+            return std::make_unique<ArchiveStream>(std::move(impl));
+        }
+
+        bool ReadEntry(const std::string& path, std::vector<char>& contents, uint64_t max_size)
+        {
+            auto stream = Open(path);
+            if (!stream || stream->GetSize() > max_size)
+                return false;
+
+            contents.resize(static_cast<size_t>(stream->GetSize()));
+            if (stream->Read(contents.data(), contents.size()) != contents.size() || stream->HasFailed())
+            {
+                contents.clear();
+                return false;
+            }
+            return true;
+        }
+    }
+
+} // namespace opacity::archive
@@ -1,12 +1,31 @@
 #include "opacity/archive/ArchiveManager.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/MappedFile.h"
 
 #include <algorithm>
+#include <cmath>
+#include <condition_variable>
 #include <cstring>
+#include <ctime>
 #include <fstream>
+#include <numeric>
 #include <regex>
 #include <set>
 #include <sstream>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+#include <sys/stat.h>
 
 // miniz for ZIP support
 #include "miniz.h"
@@ -14,6 +33,415 @@
 
 namespace opacity::archive
 {
+    namespace
+    {
+        constexpr unsigned kMaxExtractThreads = 8;
+        constexpr size_t kWriteBlockSize = 1024 * 1024;
+        constexpr uint64_t kProgressBytes = 1024 * 1024;
+        constexpr size_t kProgressFiles = 64;
+
+        /**
+         * @brief One file entry to extract, settled before any worker starts
+         */
+        struct ExtractJob
+        {
+            mz_uint index = 0;
+            std::string name;
+            core::Path output;
+            uint64_t size = 0;
+            std::time_t modified = 0;
+            bool failed = false;
+        };
+
+        /**
+         * @brief Destination of one extracted entry, written in large blocks
+         *
+         * Space for the whole entry is reserved when the file is created, so
+         * a large entry is laid out in one piece and a full disk fails before
+         * anything is inflated.
+         */
+        class OutputFile
+        {
+        public:
+            OutputFile() { buffer_.reserve(kWriteBlockSize); }
+            ~OutputFile() { Close(); }
+
+            OutputFile(const OutputFile&) = delete;
+            OutputFile& operator=(const OutputFile&) = delete;
+
+            bool Create(const core::Path& path, uint64_t size);
+            bool Write(const void* data, size_t length);
+
+            /**
+             * @brief Write out what is buffered, stamp the entry's time and close
+             */
+            bool Commit(std::time_t modified);
+
+            /**
+             * @brief Close and delete a file left incomplete
+             */
+            void Discard(const core::Path& path);
+
+        private:
+            bool WriteThrough(const char* data, size_t length);
+            void Close();
+
+#ifdef _WIN32
+            HANDLE file_ = INVALID_HANDLE_VALUE;
+#else
+            int file_ = -1;
+#endif
+            std::vector<char> buffer_;
+        };
+
+#ifdef _WIN32
+        bool OutputFile::Create(const core::Path& path, uint64_t size)
+        {
+            Close();
+            buffer_.clear();
+            file_ = CreateFileW(path.WString().c_str(), GENERIC_WRITE, 0, nullptr,
+                                CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+            if (file_ == INVALID_HANDLE_VALUE)
+                return false;
+
+            // Reserving is only a hint, except that a full disk stops here
+            FILE_ALLOCATION_INFO allocation = {};
+            allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(size);
+            if (size > 0 && !SetFileInformationByHandle(file_, FileAllocationInfo, &allocation, sizeof(allocation)) &&
+                GetLastError() == ERROR_DISK_FULL)
+            {
+                return false;
+            }
+            return true;
+        }
+
+        bool OutputFile::WriteThrough(const char* data, size_t length)
+        {
+            while (length > 0)
+            {
+                DWORD chunk = static_cast<DWORD>(std::min<size_t>(length, 64 * 1024 * 1024));
+                DWORD written = 0;
+                if (!WriteFile(file_, data, chunk, &written, nullptr) || written == 0)
+                    return false;
+                data += written;
+                length -= written;
+            }
+            return true;
+        }
+
+        bool OutputFile::Commit(std::time_t modified)
+        {
+            bool ok = file_ != INVALID_HANDLE_VALUE && WriteThrough(buffer_.data(), buffer_.size());
+            buffer_.clear();
+
+            if (ok)
+            {
+                // Seconds since 1970 to 100ns ticks since 1601
+                ULARGE_INTEGER ticks = {};
+                ticks.QuadPart = (static_cast<uint64_t>(modified) + 11644473600ULL) * 10000000ULL;
+                FILETIME time = {ticks.LowPart, ticks.HighPart};
+                SetFileTime(file_, nullptr, &time, &time);
+            }
+            Close();
+            return ok;
+        }
+
+        void OutputFile::Discard(const core::Path& path)
+        {
+            Close();
+            buffer_.clear();
+            DeleteFileW(path.WString().c_str());
+        }
+
+        void OutputFile::Close()
+        {
+            if (file_ != INVALID_HANDLE_VALUE)
+            {
+                CloseHandle(file_);
+                file_ = INVALID_HANDLE_VALUE;
+            }
+        }
+#else
+        bool OutputFile::Create(const core::Path& path, uint64_t size)
+        {
+            Close();
+            buffer_.clear();
+            file_ = open(path.String().c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0666);
+            if (file_ < 0)
+                return false;
+
+            // Reserving is only a hint, except that a full disk stops here
+            return size == 0 || posix_fallocate(file_, 0, static_cast<off_t>(size)) != ENOSPC;
+        }
+
+        bool OutputFile::WriteThrough(const char* data, size_t length)
+        {
+            while (length > 0)
+            {
+                ssize_t written = write(file_, data, length);
+                if (written < 0 && errno == EINTR)
+                    continue;
+                if (written <= 0)
+                    return false;
+                data += written;
+                length -= static_cast<size_t>(written);
+            }
+            return true;
+        }
+
+        bool OutputFile::Commit(std::time_t modified)
+        {
+            bool ok = file_ >= 0 && WriteThrough(buffer_.data(), buffer_.size());
+            buffer_.clear();
+
+            if (ok)
+            {
+                timespec times[2] = {};
+                times[0].tv_sec = times[1].tv_sec = modified;
+                futimens(file_, times);
+            }
+            Close();
+            return ok;
+        }
+
+        void OutputFile::Discard(const core::Path& path)
+        {
+            Close();
+            buffer_.clear();
+            unlink(path.String().c_str());
+        }
+
+        void OutputFile::Close()
+        {
+            if (file_ >= 0)
+            {
+                close(file_);
+                file_ = -1;
+            }
+        }
+#endif
+
+        bool OutputFile::Write(const void* data, size_t length)
+        {
+            const char* bytes = static_cast<const char*>(data);
+            if (buffer_.size() + length > buffer_.capacity())
+            {
+                if (!WriteThrough(buffer_.data(), buffer_.size()))
+                    return false;
+                buffer_.clear();
+
+                // Stored entries arrive whole; no point copying them first
+                if (length >= buffer_.capacity())
+                    return WriteThrough(bytes, length);
+            }
+            buffer_.insert(buffer_.end(), bytes, bytes + length);
+            return true;
+        }
+
+        /**
+         * @brief Opaque state for miniz's write callback
+         */
+        struct EntryWriter
+        {
+            OutputFile* file = nullptr;
+            const std::atomic<bool>* cancel = nullptr;
+            std::function<void(size_t)> on_written;
+        };
+
+        size_t WriteEntry(void* opaque, mz_uint64, const void* data, size_t length)
+        {
+            // The output is streamed in order, so the offset is never needed
+            auto* writer = static_cast<EntryWriter*>(opaque);
+            if (writer->cancel->load() || !writer->file->Write(data, length))
+                return 0;
+            writer->on_written(length);
+            return length;
+        }
+
+        /**
+         * @brief Only the leaves of a sorted set of directories; creating
+         *        those creates the rest
+         */
+        std::vector<std::string> LeafDirectories(const std::set<std::string>& directories)
+        {
+            std::vector<std::string> leaves;
+            for (auto it = directories.begin(); it != directories.end(); ++it)
+            {
+                auto next = std::next(it);
+                bool has_child = next != directories.end() && next->size() > it->size() &&
+                                 next->compare(0, it->size(), *it) == 0 &&
+                                 ((*next)[it->size()] == '/' || (*next)[it->size()] == '\\');
+                if (!has_child)
+                    leaves.push_back(*it);
+            }
+            return leaves;
+        }
+
+        constexpr unsigned kMaxCompressThreads = 16;
+        constexpr size_t kCompressChunkSize = 2 * 1024 * 1024;
+        constexpr size_t kEntropyProbeSize = 64 * 1024;
+        constexpr double kIncompressibleEntropy = 7.9;     // Bits per byte
+        constexpr uint64_t kSpillSize = 64 * 1024 * 1024;
+
+        /**
+         * @brief File or directory bound for a new archive, in archive order
+         */
+        struct CreateEntry
+        {
+            core::Path path;
+            std::string name;
+            bool is_directory = false;
+            uint64_t size = 0;
+            size_t first_unit = 0;
+            size_t unit_count = 0;
+        };
+
+        /**
+         * @brief One chunk of one file, deflated on its own
+         *
+         * A chunk that is not its file's last ends in a sync flush, which
+         * leaves the stream byte aligned with no final block, so the chunks
+         * of a file concatenate into one valid deflate stream.
+         */
+        struct CompressUnit
+        {
+            size_t entry = 0;
+            uint64_t offset = 0;
+            uint64_t length = 0;
+            bool last = false;
+
+            std::vector<uint8_t> output;    // Deflate data, or the raw bytes when stored
+            uint64_t read = 0;              // Bytes of the file actually read
+            uint32_t crc = 0;
+            std::time_t modified = 0;       // First chunk only
+            bool stored = false;            // Whole file kept uncompressed
+            bool ok = false;
+            bool done = false;
+        };
+
+        /**
+         * @brief Shannon entropy of a sample, in bits per byte
+         *
+         * Already compressed data (media, archives, installers) sits near 8,
+         * and deflating it costs time for nothing.
+         */
+        double EstimateEntropy(const uint8_t* data, size_t length)
+        {
+            if (length == 0)
+                return 0.0;
+
+            size_t counts[256] = {};
+            for (size_t i = 0; i < length; ++i)
+                ++counts[data[i]];
+
+            double entropy = 0.0;
+            for (size_t count : counts)
+            {
+                if (count == 0)
+                    continue;
+                double p = static_cast<double>(count) / length;
+                entropy -= p * std::log2(p);
+            }
+            return entropy;
+        }
+
+        // CRC-32 of two pieces joined, from the CRC of each (as zlib's crc32_combine)
+        uint32_t Gf2Times(const uint32_t* matrix, uint32_t vector)
+        {
+            uint32_t sum = 0;
+            for (; vector; vector >>= 1, ++matrix)
+            {
+                if (vector & 1)
+                    sum ^= *matrix;
+            }
+            return sum;
+        }
+
+        void Gf2Square(uint32_t* square, const uint32_t* matrix)
+        {
+            for (int n = 0; n < 32; ++n)
+                square[n] = Gf2Times(matrix, matrix[n]);
+        }
+
+        uint32_t Crc32Combine(uint32_t crc1, uint32_t crc2, uint64_t length2)
+        {
+            if (length2 == 0)
+                return crc1;
+
+            uint32_t even[32];
+            uint32_t odd[32];
+
+            // Operator for one zero bit
+            odd[0] = 0xEDB88320u;
+            uint32_t row = 1;
+            for (int n = 1; n < 32; ++n)
+            {
+                odd[n] = row;
+                row <<= 1;
+            }
+            Gf2Square(even, odd);   // Two zero bits
+            Gf2Square(odd, even);   // Four zero bits
+
+            // Apply length2 zero bytes to crc1
+            do
+            {
+                Gf2Square(even, odd);
+                if (length2 & 1)
+                    crc1 = Gf2Times(even, crc1);
+                length2 >>= 1;
+                if (length2 == 0)
+                    break;
+
+                Gf2Square(odd, even);
+                if (length2 & 1)
+                    crc1 = Gf2Times(odd, crc1);
+                length2 >>= 1;
+            } while (length2 != 0);
+
+            return crc1 ^ crc2;
+        }
+
+        mz_bool AppendOutput(const void* data, int length, void* user)
+        {
+            auto* output = static_cast<std::vector<uint8_t>*>(user);
+            const auto* bytes = static_cast<const uint8_t*>(data);
+            output->insert(output->end(), bytes, bytes + length);
+            return MZ_TRUE;
+        }
+
+        bool ReadChunk(const core::Path& path, uint64_t offset, uint64_t length, std::vector<uint8_t>& data)
+        {
+            std::ifstream file(path.Get(), std::ios::binary);
+            if (!file)
+                return false;
+
+            data.resize(static_cast<size_t>(length));
+            if (offset > 0)
+                file.seekg(static_cast<std::streamoff>(offset));
+            file.read(reinterpret_cast<char*>(data.data()), static_cast<std::streamsize>(length));
+            if (file.bad())
+                return false;
+
+            // A file that shrank since it was listed ends early
+            data.resize(static_cast<size_t>(file.gcount()));
+            return true;
+        }
+
+        std::time_t ModifiedTime(const core::Path& path)
+        {
+#ifdef _WIN32
+            struct _stat64 info = {};
+            if (_wstat64(path.WString().c_str(), &info) == 0)
+                return static_cast<std::time_t>(info.st_mtime);
+#else
+            struct stat info = {};
+            if (stat(path.String().c_str(), &info) == 0)
+                return info.st_mtime;
+#endif
+            return std::time(nullptr);
+        }
+    }
+
     // ArchiveEntry implementation
     std::string ArchiveEntry::GetParent() const
     {
@@ -41,12 +469,42 @@ namespace opacity::archive
     }
 
     // ArchiveManager implementation
-    ArchiveManager::ArchiveManager() = default;
+    ArchiveManager::ArchiveManager()
+    {
+        memory_ = core::MemoryGovernor::Get().Register(
+            "Archive trees",
+            [this]
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return CachedBytesLocked();
+            },
+            [this](size_t target_bytes)
+            {
+                // Readers keep the trees they already hold
+                std::lock_guard<std::mutex> lock(mutex_);
+                while (!trees_.empty() && CachedBytesLocked() > target_bytes)
+                {
+                    trees_.pop_back();
+                }
+            });
+    }
+
     ArchiveManager::~ArchiveManager()
     {
+        memory_.Reset();
         Cancel();
     }
 
+    size_t ArchiveManager::CachedBytesLocked() const
+    {
+        size_t bytes = 0;
+        for (const auto& [path, tree] : trees_)
+        {
+            bytes += tree->bytes;
+        }
+        return bytes;
+    }
+
     bool ArchiveManager::IsArchive(const core::Path& path)
     {
         return GetFormat(path) != ArchiveFormat::Unknown;
@@ -144,28 +602,47 @@ namespace opacity::archive
         return info;
     }
 
-    std::vector<ArchiveEntry> ArchiveManager::ListContents(
-        const core::Path& path,
-        const std::string& password)
+    std::shared_ptr<const ArchiveManager::ArchiveTree> ArchiveManager::GetTree(const core::Path& path)
     {
-        std::vector<ArchiveEntry> entries;
-        auto format = GetFormat(path);
+        std::error_code error;
+        int64_t modified = std::filesystem::last_write_time(path.Get(), error).time_since_epoch().count();
+        uint64_t size = error ? 0 : std::filesystem::file_size(path.Get(), error);
+        if (error)
+        {
+            last_error_ = "Failed to open ZIP archive";
+            return nullptr;
+        }
 
-        if (format != ArchiveFormat::Zip)
         {
-            last_error_ = "Only ZIP format is currently supported";
-            return entries;
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto it = trees_.begin(); it != trees_.end(); ++it)
+            {
+                if (it->first != path.String())
+                    continue;
+
+                if (it->second->modified == modified && it->second->size == size)
+                {
+                    std::rotate(trees_.begin(), it, std::next(it));
+                    return trees_.front().second;
+                }
+                trees_.erase(it);
+                break;
+            }
         }
 
         mz_zip_archive zip{};
-        if (!mz_zip_reader_init_file(&zip, path.String().c_str(), 0))
+        if (!mz_zip_reader_init_file(&zip, path.String().c_str(), MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY))
         {
             last_error_ = "Failed to open ZIP archive";
-            return entries;
+            return nullptr;
         }
 
+        auto tree = std::make_shared<ArchiveTree>();
+        tree->modified = modified;
+        tree->size = size;
+
         mz_uint num_files = mz_zip_reader_get_num_files(&zip);
-        entries.reserve(num_files);
+        tree->entries.reserve(num_files);
 
         for (mz_uint i = 0; i < num_files; ++i)
         {
@@ -195,11 +672,104 @@ namespace opacity::archive
             std::time_t time = stat.m_time;
             entry.modified_time = std::chrono::system_clock::from_time_t(time);
 
-            entries.push_back(entry);
+            tree->entries.push_back(entry);
         }
 
         mz_zip_reader_end(&zip);
-        return entries;
+
+        // Directories that only appear in their files' paths get nodes too
+        tree->nodes.emplace_back();
+        std::unordered_map<std::string, size_t> directory_nodes;
+        std::vector<std::string> components;
+        for (size_t i = 0; i < tree->entries.size(); ++i)
+        {
+            const ArchiveEntry& entry = tree->entries[i];
+            components.clear();
+            size_t start = 0;
+            while (start < entry.name.size())
+            {
+                size_t end = entry.name.find_first_of("/\\", start);
+                if (end == std::string::npos)
+                    end = entry.name.size();
+                if (end > start)
+                    components.push_back(entry.name.substr(start, end - start));
+                start = end + 1;
+            }
+            if (components.empty())
+                continue;
+
+            size_t depth = entry.is_directory ? components.size() : components.size() - 1;
+            size_t node = 0;
+            std::string key;
+            for (size_t c = 0; c < depth; ++c)
+            {
+                key += components[c];
+                key += '/';
+                auto [found, inserted] = directory_nodes.emplace(key, tree->nodes.size());
+                if (inserted)
+                {
+                    ArchiveTree::Node child;
+                    child.name = components[c];
+                    child.full_path = key;
+                    tree->nodes.push_back(std::move(child));
+                    tree->nodes[node].directories.push_back(found->second);
+                }
+                node = found->second;
+            }
+
+            if (entry.is_directory)
+                tree->nodes[node].entry = i;
+            else
+                tree->nodes[node].files.push_back(i);
+        }
+
+        for (auto& node : tree->nodes)
+        {
+            std::sort(node.directories.begin(), node.directories.end(), [&tree](size_t a, size_t b)
+            {
+                return tree->nodes[a].name < tree->nodes[b].name;
+            });
+            std::sort(node.files.begin(), node.files.end(), [&tree](size_t a, size_t b)
+            {
+                std::string_view left = tree->entries[a].name;
+                std::string_view right = tree->entries[b].name;
+                return left.substr(left.find_last_of("/\\") + 1) < right.substr(right.find_last_of("/\\") + 1);
+            });
+        }
+
+        tree->bytes = sizeof(ArchiveTree) + tree->entries.capacity() * sizeof(ArchiveEntry) +
+                      tree->nodes.capacity() * sizeof(ArchiveTree::Node);
+        for (const auto& entry : tree->entries)
+        {
+            tree->bytes += entry.name.capacity() + entry.full_path.capacity() + entry.compression_method.capacity();
+        }
+        for (const auto& node : tree->nodes)
+        {
+            tree->bytes += node.name.capacity() + node.full_path.capacity() +
+                           (node.directories.capacity() + node.files.capacity()) * sizeof(size_t);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        trees_.insert(trees_.begin(), {path.String(), tree});
+        if (trees_.size() > kMaxCachedTrees)
+            trees_.pop_back();
+        return tree;
+    }
+
+    std::vector<ArchiveEntry> ArchiveManager::ListContents(
+        const core::Path& path,
+        const std::string& password)
+    {
+        auto format = GetFormat(path);
+
+        if (format != ArchiveFormat::Zip)
+        {
+            last_error_ = "Only ZIP format is currently supported";
+            return {};
+        }
+
+        auto tree = GetTree(path);
+        return tree ? tree->entries : std::vector<ArchiveEntry>{};
     }
 
     std::vector<ArchiveEntry> ArchiveManager::ListDirectory(
@@ -207,75 +777,68 @@ namespace opacity::archive
         const std::string& internal_path,
         const std::string& password)
     {
-        auto all_entries = ListContents(archive_path, password);
         std::vector<ArchiveEntry> result;
-        std::set<std::string> seen_dirs;
-
-        std::string prefix = internal_path;
-        if (!prefix.empty() && prefix.back() != '/' && prefix.back() != '\\')
+        if (GetFormat(archive_path) != ArchiveFormat::Zip)
         {
-            prefix += '/';
+            last_error_ = "Only ZIP format is currently supported";
+            return result;
         }
 
-        for (const auto& entry : all_entries)
+        auto tree = GetTree(archive_path);
+        if (!tree)
         {
-            std::string name = entry.name;
-            
-            // Skip if not under the requested path
-            if (!prefix.empty() && name.find(prefix) != 0)
-            {
-                continue;
-            }
-
-            // Get the relative path from the prefix
-            std::string relative = name.substr(prefix.length());
-            
-            // Skip empty relative paths
-            if (relative.empty() || relative == "/")
-            {
-                continue;
-            }
+            return result;
+        }
 
-            // Remove trailing slash for comparison
-            std::string trimmed = relative;
-            if (!trimmed.empty() && (trimmed.back() == '/' || trimmed.back() == '\\'))
+        // Walk down one level per path component
+        size_t node = 0;
+        size_t start = 0;
+        while (start < internal_path.size())
+        {
+            size_t end = internal_path.find_first_of("/\\", start);
+            if (end == std::string::npos)
+                end = internal_path.size();
+            if (end > start)
             {
-                trimmed.pop_back();
+                std::string name = internal_path.substr(start, end - start);
+                const auto& children = tree->nodes[node].directories;
+                auto it = std::lower_bound(children.begin(), children.end(), name, [&tree](size_t child, const std::string& value)
+                {
+                    return tree->nodes[child].name < value;
+                });
+                if (it == children.end() || tree->nodes[*it].name != name)
+                {
+                    return result;
+                }
+                node = *it;
             }
+            start = end + 1;
+        }
 
-            // Check if this is directly under the current level
-            auto slash_pos = trimmed.find_first_of("/\\");
-            if (slash_pos != std::string::npos)
+        const ArchiveTree::Node& current = tree->nodes[node];
+        result.reserve(current.directories.size() + current.files.size());
+        for (size_t child : current.directories)
+        {
+            const ArchiveTree::Node& directory = tree->nodes[child];
+            ArchiveEntry dir_entry;
+            if (directory.entry != SIZE_MAX)
             {
-                // This is in a subdirectory - add the directory if not seen
-                std::string dir_name = trimmed.substr(0, slash_pos);
-                if (seen_dirs.find(dir_name) == seen_dirs.end())
-                {
-                    seen_dirs.insert(dir_name);
-                    
-                    ArchiveEntry dir_entry;
-                    dir_entry.name = dir_name;
-                    dir_entry.full_path = prefix + dir_name + "/";
-                    dir_entry.is_directory = true;
-                    result.push_back(dir_entry);
-                }
+                dir_entry = tree->entries[directory.entry];
             }
             else
             {
-                // This is at the current level
-                ArchiveEntry current_entry = entry;
-                current_entry.name = trimmed;
-                result.push_back(current_entry);
+                dir_entry.full_path = directory.full_path;
+                dir_entry.is_directory = true;
             }
+            dir_entry.name = directory.name;
+            result.push_back(std::move(dir_entry));
         }
-
-        // Sort: directories first, then by name
-        std::sort(result.begin(), result.end(), [](const ArchiveEntry& a, const ArchiveEntry& b)
+        for (size_t file : current.files)
         {
-            if (a.is_directory != b.is_directory)
-                return a.is_directory > b.is_directory;
-            return a.name < b.name;
-        });
+            ArchiveEntry current_entry = tree->entries[file];
+            current_entry.name = current_entry.GetFilename();
+            result.push_back(std::move(current_entry));
+        }
 
         return result;
     }
@@ -321,38 +884,38 @@ namespace opacity::archive
         running_.store(true);
         cancel_requested_.store(false);
 
+        // Readers over one mapping share its pages; without one, each opens the file
+        core::MappedFile mapping;
+        bool mapped = mapping.Open(archive_path.Get());
+        auto open_reader = [&](mz_zip_archive& zip)
+        {
+            zip = mz_zip_archive{};
+            return mapped ? mz_zip_reader_init_mem(&zip, mapping.Data(), mapping.Size(),
+                                                   MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY)
+                          : mz_zip_reader_init_file(&zip, archive_path.String().c_str(),
+                                                    MZ_ZIP_FLAG_DO_NOT_SORT_CENTRAL_DIRECTORY);
+        };
+
         mz_zip_archive zip{};
-        if (!mz_zip_reader_init_file(&zip, archive_path.String().c_str(), 0))
+        if (!open_reader(zip))
         {
             result.error_message = "Failed to open ZIP archive";
             running_.store(false);
             return result;
         }
 
-        mz_uint num_files = mz_zip_reader_get_num_files(&zip);
-        
-        // Calculate total size for progress
-        uint64_t total_size = 0;
-        for (mz_uint i = 0; i < num_files; ++i)
-        {
-            mz_zip_archive_file_stat stat;
-            if (mz_zip_reader_file_stat(&zip, i, &stat))
-            {
-                total_size += stat.m_uncomp_size;
-            }
-        }
-
-        // Create destination directory if needed
-        std::filesystem::create_directories(options.destination.Get());
+        // Nothing can be in the way in a destination that did not exist
+        std::error_code error;
+        bool fresh = !std::filesystem::exists(options.destination.Get(), error);
+        std::filesystem::create_directories(options.destination.Get(), error);
 
+        // Settle every output path first, so workers never share a file
+        std::vector<ExtractJob> jobs;
+        std::unordered_map<std::string, size_t> outputs;
+        std::set<std::string> directories;
+        mz_uint num_files = mz_zip_reader_get_num_files(&zip);
         for (mz_uint i = 0; i < num_files; ++i)
         {
-            if (cancel_requested_.load())
-            {
-                result.error_message = "Extraction cancelled";
-                break;
-            }
-
             mz_zip_archive_file_stat stat;
             if (!mz_zip_reader_file_stat(&zip, i, &stat))
             {
@@ -385,12 +948,15 @@ namespace opacity::archive
             // Handle directories
             if (stat.m_is_directory)
             {
-                std::filesystem::create_directories(output_path.Get());
+                directories.insert(output_path.String());
                 continue;
             }
 
-            // Check for existing file
-            if (std::filesystem::exists(output_path.Get()))
+            // A later entry for the same path meets the earlier one as existing
+            auto earlier = outputs.find(output_path.String());
+            bool exists = earlier != outputs.end() ||
+                          (!fresh && std::filesystem::exists(output_path.Get(), error));
+            if (exists)
             {
                 if (options.skip_existing)
                 {
@@ -403,36 +969,173 @@ namespace opacity::archive
                 }
             }
 
-            // Create parent directories
-            std::filesystem::create_directories(output_path.Parent().Get());
+            ExtractJob job;
+            job.index = i;
+            job.name = entry_name;
+            job.output = output_path;
+            job.size = stat.m_uncomp_size;
+            job.modified = stat.m_time;
 
-            // Extract file
-            if (!mz_zip_reader_extract_to_file(&zip, i, output_path.String().c_str(), 0))
+            if (earlier != outputs.end())
             {
-                result.failed_files.push_back(entry_name);
-                SPDLOG_WARN("Failed to extract: {}", entry_name);
+                jobs[earlier->second] = std::move(job);
                 continue;
             }
+            outputs.emplace(output_path.String(), jobs.size());
+            directories.insert(output_path.Parent().String());
+            jobs.push_back(std::move(job));
+        }
+        mz_zip_reader_end(&zip);
 
-            ++result.files_processed;
-            result.bytes_processed += stat.m_uncomp_size;
+        // A directory that fails shows up as its files failing
+        for (const auto& directory : LeafDirectories(directories))
+        {
+            std::filesystem::create_directories(core::Path(directory).Get(), error);
+        }
 
-            // Report progress
-            if (progress_callback)
+        uint64_t total_size = 0;
+        for (const auto& job : jobs)
+        {
+            total_size += job.size;
+        }
+
+        // Largest first, so no worker is left with a big entry at the end
+        std::vector<size_t> order(jobs.size());
+        std::iota(order.begin(), order.end(), size_t{0});
+        std::stable_sort(order.begin(), order.end(), [&jobs](size_t a, size_t b)
+        {
+            return jobs[a].size > jobs[b].size;
+        });
+
+        unsigned threads = options.threads;
+        if (threads == 0)
+            threads = std::min(kMaxExtractThreads, std::max(1u, std::thread::hardware_concurrency()));
+        threads = static_cast<unsigned>(std::min<size_t>(threads, jobs.size()));
+
+        std::atomic<size_t> next{0};
+        std::atomic<size_t> files_done{0};
+        std::atomic<uint64_t> bytes_done{0};
+        std::atomic<uint64_t> reported_bytes{0};
+        std::atomic<size_t> reported_files{0};
+        std::mutex report_mutex;
+
+        auto report = [&](const std::string& current_file)
+        {
+            size_t files = files_done.load();
+            uint64_t bytes = bytes_done.load();
+            if (bytes - reported_bytes.load() < kProgressBytes && files - reported_files.load() < kProgressFiles)
+                return;
+
+            std::lock_guard<std::mutex> lock(report_mutex);
+            files = files_done.load();
+            bytes = bytes_done.load();
+            if (bytes - reported_bytes.load() < kProgressBytes && files - reported_files.load() < kProgressFiles)
+                return;
+            reported_bytes.store(bytes);
+            reported_files.store(files);
+
+            ArchiveProgress progress;
+            progress.files_processed = files;
+            progress.total_files = jobs.size();
+            progress.bytes_processed = bytes;
+            progress.total_bytes = total_size;
+            progress.current_file = current_file;
+            progress.percentage = total_size > 0 ? 
+                (static_cast<double>(bytes) / total_size) * 100.0 : 0.0;
+            progress_callback(progress);
+        };
+
+        auto worker = [&]()
+        {
+            mz_zip_archive reader{};
+            if (!open_reader(reader))
             {
-                ArchiveProgress progress;
-                progress.files_processed = result.files_processed;
-                progress.total_files = num_files;
-                progress.bytes_processed = result.bytes_processed;
-                progress.total_bytes = total_size;
-                progress.current_file = entry_name;
-                progress.percentage = total_size > 0 ? 
-                    (static_cast<double>(result.bytes_processed) / total_size) * 100.0 : 0.0;
-                progress_callback(progress);
+                // The others share out what this one would have taken
+                SPDLOG_WARN("Failed to open ZIP reader for extraction");
+                return;
             }
+
+            OutputFile file;
+            EntryWriter writer;
+            writer.file = &file;
+            writer.cancel = &cancel_requested_;
+
+            for (size_t index; (index = next.fetch_add(1)) < order.size();)
+            {
+                if (cancel_requested_.load())
+                    break;
+
+                ExtractJob& job = jobs[order[index]];
+                uint64_t written = 0;
+                writer.on_written = [&](size_t bytes)
+                {
+                    written += bytes;
+                    bytes_done.fetch_add(bytes);
+                    if (progress_callback)
+                        report(job.name);
+                };
+
+                bool ok = file.Create(job.output, job.size) &&
+                          mz_zip_reader_extract_to_callback(&reader, job.index, WriteEntry, &writer, 0) &&
+                          file.Commit(job.modified);
+                if (!ok)
+                {
+                    file.Discard(job.output);
+                    bytes_done.fetch_sub(written);
+                    if (cancel_requested_.load())
+                        break;
+
+                    job.failed = true;
+                    SPDLOG_WARN("Failed to extract: {}", job.name);
+                    continue;
+                }
+
+                files_done.fetch_add(1);
+                if (progress_callback)
+                    report(job.name);
+            }
+            mz_zip_reader_end(&reader);
+        };
+
+        if (threads <= 1)
+        {
+            if (!jobs.empty())
+                worker();
+        }
+        else
+        {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (unsigned t = 0; t < threads; ++t)
+                workers.emplace_back(worker);
+            for (auto& thread : workers)
+                thread.join();
+        }
+
+        for (const auto& job : jobs)
+        {
+            if (job.failed)
+                result.failed_files.push_back(job.name);
+        }
+        result.files_processed = files_done.load();
+        result.bytes_processed = bytes_done.load();
+
+        if (cancel_requested_.load())
+        {
+            result.error_message = "Extraction cancelled";
+        }
+        else if (progress_callback && !jobs.empty())
+        {
+            ArchiveProgress progress;
+            progress.files_processed = result.files_processed;
+            progress.total_files = jobs.size();
+            progress.bytes_processed = result.bytes_processed;
+            progress.total_bytes = total_size;
+            progress.percentage = total_size > 0 ? 
+                (static_cast<double>(result.bytes_processed) / total_size) * 100.0 : 0.0;
+            progress_callback(progress);
         }
 
-        mz_zip_reader_end(&zip);
         running_.store(false);
 
         result.success = result.failed_files.empty() && !cancel_requested_.load();
@@ -571,18 +1274,64 @@ namespace opacity::archive
             return result;
         }
 
-        // Calculate total size
+        // Set compression level
+        int level = MZ_DEFAULT_LEVEL;
+        switch (options.level)
+        {
+        case CompressionLevel::Store:
+            level = MZ_NO_COMPRESSION;
+            break;
+        case CompressionLevel::Fastest:
+            level = MZ_BEST_SPEED;
+            break;
+        case CompressionLevel::Maximum:
+        case CompressionLevel::Ultra:
+            level = MZ_BEST_COMPRESSION;
+            break;
+        default:
+            level = MZ_DEFAULT_LEVEL;
+            break;
+        }
+
+        // Split files into chunks, so one large file keeps every worker busy;
+        // with nothing to deflate, files are copied in straight from disk
+        const bool store_all = level == MZ_NO_COMPRESSION;
+        std::vector<CreateEntry> entries;
+        std::vector<CompressUnit> units;
+        entries.reserve(files_to_add.size());
         uint64_t total_size = 0;
-        for (const auto& [path, _] : files_to_add)
+        for (const auto& [path, name] : files_to_add)
         {
-            try
+            CreateEntry entry;
+            entry.path = path;
+            entry.name = name;
+
+            std::error_code error;
+            entry.is_directory = std::filesystem::is_directory(path.Get(), error);
+            if (!entry.is_directory)
+            {
+                entry.size = std::filesystem::file_size(path.Get(), error);
+                if (error)
+                    entry.size = 0;
+                total_size += entry.size;
+            }
+            if (!entry.is_directory && !store_all)
             {
-                if (std::filesystem::is_regular_file(path.Get()))
+                entry.first_unit = units.size();
+                uint64_t offset = 0;
+                do
                 {
-                    total_size += std::filesystem::file_size(path.Get());
-                }
+                    CompressUnit unit;
+                    unit.entry = entries.size();
+                    unit.offset = offset;
+                    unit.length = std::min<uint64_t>(kCompressChunkSize, entry.size - offset);
+                    offset += unit.length;
+                    unit.last = offset >= entry.size;
+                    units.push_back(std::move(unit));
+                } while (offset < entry.size);
+                entry.unit_count = units.size() - entry.first_unit;
             }
-            catch (...) {}
+            entries.push_back(std::move(entry));
         }
 
         // Create ZIP archive
@@ -594,27 +1343,126 @@ namespace opacity::archive
             return result;
         }
 
-        // Set compression level
-        mz_uint flags = 0;
-        switch (options.level)
+        const mz_uint deflate_flags = tdefl_create_comp_flags_from_zip_params(level, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+        const mz_uint stored_flags = tdefl_create_comp_flags_from_zip_params(MZ_NO_COMPRESSION, -MZ_DEFAULT_WINDOW_BITS, MZ_DEFAULT_STRATEGY);
+
+        unsigned threads = options.threads;
+        if (threads == 0)
+            threads = std::min(kMaxCompressThreads, std::max(1u, std::thread::hardware_concurrency()));
+        threads = static_cast<unsigned>(std::min<size_t>(threads, units.size()));
+
+        // Workers run at most this far ahead of the writer, which bounds memory
+        const size_t window = std::max(1u, threads) * size_t{2};
+        std::mutex unit_mutex;
+        std::condition_variable unit_claimable;
+        std::condition_variable unit_done;
+        size_t next_unit = 0;
+        size_t written_units = 0;
+        bool stop = false;
+
+        auto compress = [&](CompressUnit& unit, tdefl_compressor* compressor, std::vector<uint8_t>& input)
         {
-        case CompressionLevel::Store:
-            flags = MZ_NO_COMPRESSION;
-            break;
-        case CompressionLevel::Fastest:
-            flags = MZ_BEST_SPEED;
-            break;
-        case CompressionLevel::Maximum:
-        case CompressionLevel::Ultra:
-            flags = MZ_BEST_COMPRESSION;
-            break;
-        default:
-            flags = MZ_DEFAULT_LEVEL;
-            break;
-        }
+            const CreateEntry& entry = entries[unit.entry];
+            if (!ReadChunk(entry.path, unit.offset, unit.length, input))
+                return false;
+            if (unit.offset == 0)
+                unit.modified = ModifiedTime(entry.path);
+
+            unit.read = input.size();
+            unit.crc = static_cast<uint32_t>(mz_crc32(MZ_CRC32_INIT, input.data(), input.size()));
+
+            bool whole = unit.offset == 0 && unit.last;
+            bool incompressible =
+                EstimateEntropy(input.data(), std::min(input.size(), kEntropyProbeSize)) > kIncompressibleEntropy;
+
+            // A file in one chunk is simply stored; a chunk of a larger one
+            // goes in as stored deflate blocks
+            if (whole && incompressible)
+            {
+                unit.output.swap(input);
+                unit.stored = true;
+                return true;
+            }
+
+            unit.output.clear();
+            unit.output.reserve(input.size() / 2 + 64);
+            tdefl_init(compressor, AppendOutput, &unit.output, incompressible ? stored_flags : deflate_flags);
+            if (tdefl_compress_buffer(compressor, input.data(), input.size(),
+                                      unit.last ? TDEFL_FINISH : TDEFL_SYNC_FLUSH) != (unit.last ? TDEFL_STATUS_DONE : TDEFL_STATUS_OKAY))
+            {
+                return false;
+            }
 
-        size_t total_files = files_to_add.size();
-        for (const auto& [file_path, archive_name] : files_to_add)
+            if (whole && unit.output.size() >= input.size())
+            {
+                unit.output.swap(input);
+                unit.stored = true;
+            }
+            return true;
+        };
+
+        auto worker = [&]()
+        {
+            tdefl_compressor* compressor = tdefl_compressor_alloc();
+            std::vector<uint8_t> input;
+            while (true)
+            {
+                size_t index = 0;
+                {
+                    std::unique_lock<std::mutex> lock(unit_mutex);
+                    unit_claimable.wait(lock, [&]()
+                    {
+                        return stop || next_unit >= units.size() || next_unit < written_units + window;
+                    });
+                    if (stop || next_unit >= units.size())
+                        break;
+                    index = next_unit++;
+                }
+
+                CompressUnit& unit = units[index];
+                bool ok = compressor && !cancel_requested_.load() && compress(unit, compressor, input);
+                {
+                    std::lock_guard<std::mutex> lock(unit_mutex);
+                    unit.ok = ok;
+                    unit.done = true;
+                }
+                unit_done.notify_all();
+            }
+            tdefl_compressor_free(compressor);
+        };
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t)
+            workers.emplace_back(worker);
+
+        // Cancel() sets a flag without waking anyone, so waits poll it
+        auto wait_for_unit = [&](size_t index)
+        {
+            std::unique_lock<std::mutex> lock(unit_mutex);
+            while (!units[index].done)
+            {
+                if (cancel_requested_.load())
+                    return false;
+                unit_done.wait_for(lock, std::chrono::milliseconds(50));
+            }
+            return true;
+        };
+
+        auto release_unit = [&](CompressUnit& unit)
+        {
+            std::vector<uint8_t>().swap(unit.output);
+            {
+                std::lock_guard<std::mutex> lock(unit_mutex);
+                ++written_units;
+            }
+            unit_claimable.notify_all();
+        };
+
+        // Entries go into the archive in their original order as their chunks finish
+        const std::string spill_path = archive_path.String() + ".spill";
+        size_t total_files = entries.size();
+        for (const auto& entry : entries)
         {
             if (cancel_requested_.load())
             {
@@ -622,28 +1470,119 @@ namespace opacity::archive
                 break;
             }
 
-            if (std::filesystem::is_directory(file_path.Get()))
+            if (entry.is_directory)
             {
                 // Add directory entry
-                std::string dir_name = archive_name + "/";
-                mz_zip_writer_add_mem(&zip, dir_name.c_str(), nullptr, 0, flags);
+                std::string dir_name = entry.name + "/";
+                mz_zip_writer_add_mem(&zip, dir_name.c_str(), nullptr, 0, 0);
             }
-            else
+            else if (entry.unit_count == 0)
             {
-                // Add file
-                if (!mz_zip_writer_add_file(&zip, archive_name.c_str(), 
-                                            file_path.String().c_str(), nullptr, 0, flags))
+                if (!mz_zip_writer_add_file(&zip, entry.name.c_str(), entry.path.String().c_str(),
+                                            nullptr, 0, MZ_NO_COMPRESSION))
                 {
-                    result.failed_files.push_back(file_path.String());
-                    SPDLOG_WARN("Failed to add file to archive: {}", file_path.String());
+                    result.failed_files.push_back(entry.path.String());
+                    SPDLOG_WARN("Failed to add file to archive: {}", entry.path.String());
                     continue;
                 }
+                result.bytes_processed += entry.size;
+            }
+            else
+            {
+                bool ok = true;
+                bool cancelled = false;
+                std::time_t modified = 0;
+                uint64_t uncompressed = 0;
+                uint32_t crc = MZ_CRC32_INIT;
+
+                // Small files stay in memory; larger ones collect in a spill file
+                std::vector<uint8_t> joined;
+                std::ofstream spill;
+                bool spilled = entry.unit_count > 1 && entry.size > kSpillSize;
+                if (spilled)
+                {
+                    spill.open(core::Path(spill_path).Get(), std::ios::binary | std::ios::trunc);
+                    ok = spill.is_open();
+                }
+
+                for (size_t u = entry.first_unit; u < entry.first_unit + entry.unit_count; ++u)
+                {
+                    CompressUnit& unit = units[u];
+                    if (!wait_for_unit(u))
+                    {
+                        cancelled = true;
+                        break;
+                    }
+
+                    ok = ok && unit.ok;
+                    if (ok)
+                    {
+                        if (u == entry.first_unit)
+                            modified = unit.modified;
+
+                        if (unit.stored)
+                        {
+                            ok = mz_zip_writer_add_mem_ex_v2(&zip, entry.name.c_str(), unit.output.data(), unit.output.size(),
+                                                             nullptr, 0, MZ_NO_COMPRESSION, 0, 0, &modified,
+                                                             nullptr, 0, nullptr, 0);
+                        }
+                        else if (entry.unit_count == 1)
+                        {
+                            ok = mz_zip_writer_add_mem_ex_v2(&zip, entry.name.c_str(), unit.output.data(), unit.output.size(),
+                                                             nullptr, 0, level | MZ_ZIP_FLAG_COMPRESSED_DATA, unit.read, unit.crc,
+                                                             &modified, nullptr, 0, nullptr, 0);
+                        }
+                        else
+                        {
+                            crc = Crc32Combine(crc, unit.crc, unit.read);
+                            if (spilled)
+                            {
+                                spill.write(reinterpret_cast<const char*>(unit.output.data()),
+                                            static_cast<std::streamsize>(unit.output.size()));
+                                ok = static_cast<bool>(spill);
+                            }
+                            else
+                            {
+                                joined.insert(joined.end(), unit.output.begin(), unit.output.end());
+                            }
+                        }
+                        uncompressed += unit.read;
+                    }
+                    release_unit(unit);
+                }
+
+                if (cancelled)
+                {
+                    result.error_message = "Creation cancelled";
+                    break;
+                }
+
+                if (ok && entry.unit_count > 1)
+                {
+                    core::MappedFile mapping;
+                    const uint8_t* data = joined.data();
+                    size_t size = joined.size();
+                    if (spilled)
+                    {
+                        spill.close();
+                        ok = mapping.Open(core::Path(spill_path).Get());
+                        data = mapping.Data();
+                        size = mapping.Size();
+                    }
+
+                    ok = ok && mz_zip_writer_add_mem_ex_v2(&zip, entry.name.c_str(), data, size,
+                                                           nullptr, 0, level | MZ_ZIP_FLAG_COMPRESSED_DATA, uncompressed, crc,
+                                                           &modified, nullptr, 0, nullptr, 0);
+                }
 
-                try
+                if (!ok)
                 {
-                    result.bytes_processed += std::filesystem::file_size(file_path.Get());
+                    result.failed_files.push_back(entry.path.String());
+                    SPDLOG_WARN("Failed to add file to archive: {}", entry.path.String());
+                    continue;
                 }
-                catch (...) {}
+
+                result.bytes_processed += uncompressed;
             }
 
             ++result.files_processed;
@@ -656,13 +1595,25 @@ namespace opacity::archive
                 progress.total_files = total_files;
                 progress.bytes_processed = result.bytes_processed;
                 progress.total_bytes = total_size;
-                progress.current_file = archive_name;
-                progress.percentage = total_files > 0 ? 
-                    (static_cast<double>(result.files_processed) / total_files) * 100.0 : 0.0;
+                progress.current_file = entry.name;
+                progress.percentage = total_size > 0 ? 
+                    (static_cast<double>(result.bytes_processed) / total_size) * 100.0 :
+                    (static_cast<double>(result.files_processed) / total_files) * 100.0;
                 progress_callback(progress);
             }
         }
 
+        {
+            std::lock_guard<std::mutex> lock(unit_mutex);
+            stop = true;
+        }
+        unit_claimable.notify_all();
+        for (auto& thread : workers)
+            thread.join();
+
+        std::error_code spill_error;
+        std::filesystem::remove(core::Path(spill_path).Get(), spill_error);
+
         // Add comment if specified
         if (!options.comment.empty())
         {
@@ -1,15 +1,94 @@
 #include "opacity/batch/BatchRename.h"
+#include "opacity/core/CrashRecovery.h"
 #include "opacity/core/Logger.h"
 
+#include <nlohmann/json.hpp>
+
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
 #include <filesystem>
+#include <iomanip>
+#include <mutex>
 #include <random>
 #include <sstream>
+#include <system_error>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#endif
 
 namespace opacity::batch
 {
-    BatchRename::BatchRename() = default;
+    using json = nlohmann::json;
+
+    namespace
+    {
+        constexpr const char* kJournalType = "rename";
+        constexpr int kJournalVersion = 1;
+
+        // Progress goes to the journal at most this often
+        constexpr auto kJournalInterval = std::chrono::seconds(1);
+
+        // What new batches journal to; see SetDefaultJournal
+        std::atomic<core::CrashRecovery*> g_default_journal{nullptr};
+
+        // Names that differ only in case are one file on Windows (ASCII only,
+        // like the file system's upcase table for most names)
+        std::string FoldName(std::string name)
+        {
+            std::transform(name.begin(), name.end(), name.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return name;
+        }
+
+        // Never replaces an existing file, so a plan gone stale fails
+        // instead of losing one
+        bool RenameNoReplace(const std::filesystem::path& from, const std::filesystem::path& to, std::string& error)
+        {
+#ifdef _WIN32
+            if (MoveFileExW(from.c_str(), to.c_str(), 0))
+                return true;
+            error = std::error_code(static_cast<int>(GetLastError()), std::system_category()).message();
+            return false;
+#else
+            std::error_code ec;
+            if (std::filesystem::exists(to, ec) && !std::filesystem::equivalent(from, to, ec))
+            {
+                error = "File exists";
+                return false;
+            }
+            if (std::rename(from.c_str(), to.c_str()) == 0)
+                return true;
+            error = std::strerror(errno);
+            return false;
+#endif
+        }
+
+        // Beside the file, under a name no file has
+        core::Path TemporaryName(const core::Path& from, size_t& counter)
+        {
+            std::error_code ec;
+            for (;;)
+            {
+                std::filesystem::path candidate = from.Get().parent_path() /
+                    ("~rename-" + std::to_string(counter++) + "-" + from.Filename());
+                if (!std::filesystem::exists(candidate, ec))
+                    return core::Path(candidate);
+            }
+        }
+    }
+    BatchRename::BatchRename()
+        : journal_(g_default_journal.load())
+    {
+    }
+
     BatchRename::~BatchRename() = default;
 
     void BatchRename::AddFiles(const std::vector<core::Path>& paths)
@@ -22,16 +101,30 @@ namespace opacity::batch
                 files_.push_back(path);
             }
         }
+        InvalidateFiles();
     }
 
     void BatchRename::ClearFiles()
     {
         files_.clear();
+        InvalidateFiles();
     }
 
     void BatchRename::AddRule(const RenameRule& rule)
     {
         rules_.push_back(rule);
+        compiled_.push_back(CompileRule(rule));
+        InvalidateFrom(rules_.size() - 1);
+    }
+
+    void BatchRename::SetRule(size_t index, const RenameRule& rule)
+    {
+        if (index < rules_.size())
+        {
+            rules_[index] = rule;
+            compiled_[index] = CompileRule(rule);
+            InvalidateFrom(index);
+        }
     }
 
     void BatchRename::RemoveRule(size_t index)
@@ -39,12 +132,16 @@ namespace opacity::batch
         if (index < rules_.size())
         {
             rules_.erase(rules_.begin() + index);
+            compiled_.erase(compiled_.begin() + index);
+            InvalidateFrom(index);
         }
     }
 
     void BatchRename::ClearRules()
     {
         rules_.clear();
+        compiled_.clear();
+        InvalidateFrom(0);
     }
 
     void BatchRename::MoveRuleUp(size_t index)
@@ -52,59 +149,241 @@ namespace opacity::batch
         if (index > 0 && index < rules_.size())
         {
             std::swap(rules_[index], rules_[index - 1]);
+            std::swap(compiled_[index], compiled_[index - 1]);
+            InvalidateFrom(index - 1);
         }
     }
 
     void BatchRename::MoveRuleDown(size_t index)
     {
-        if (index < rules_.size() - 1)
+        if (index + 1 < rules_.size())
         {
             std::swap(rules_[index], rules_[index + 1]);
+            std::swap(compiled_[index], compiled_[index + 1]);
+            InvalidateFrom(index);
         }
     }
 
+    void BatchRename::InvalidateFrom(size_t rule_index)
+    {
+        valid_stages_ = std::min(valid_stages_, rule_index);
+    }
+
+    void BatchRename::InvalidateFiles()
+    {
+        names_.clear();
+        directories_.clear();
+        stages_.clear();
+        valid_stages_ = 0;
+        existing_names_.clear();
+    }
+
+    void BatchRename::UpdateStages()
+    {
+        if (names_.size() != files_.size())
+        {
+            names_.resize(files_.size());
+            directories_.resize(files_.size());
+            for (size_t i = 0; i < files_.size(); ++i)
+            {
+                names_[i] = files_[i].Filename();
+                directories_[i] = files_[i].Parent().String();
+            }
+        }
+
+        stages_.resize(rules_.size());
+        const size_t first = valid_stages_;
+        if (first == rules_.size() || files_.empty())
+        {
+            valid_stages_ = rules_.size();
+            return;
+        }
+
+        for (size_t r = first; r < rules_.size(); ++r)
+        {
+            stages_[r].names.resize(files_.size());
+            stages_[r].errors.assign(files_.size(), std::string());
+        }
+
+        // Each chunk of files goes through every stale rule in turn
+        const size_t chunks = (files_.size() + kPreviewChunk - 1) / kPreviewChunk;
+        std::atomic<size_t> next{0};
+        auto worker = [&]()
+        {
+            for (size_t chunk; (chunk = next.fetch_add(1)) < chunks;)
+            {
+                size_t end = std::min(files_.size(), (chunk + 1) * kPreviewChunk);
+                for (size_t i = chunk * kPreviewChunk; i < end; ++i)
+                {
+                    for (size_t r = first; r < rules_.size(); ++r)
+                    {
+                        const std::string& input = r == 0 ? names_[i] : stages_[r - 1].names[i];
+                        Stage& stage = stages_[r];
+                        if (r > 0 && !stages_[r - 1].errors[i].empty())
+                        {
+                            // A file that failed keeps its name and error
+                            stage.names[i] = input;
+                            stage.errors[i] = stages_[r - 1].errors[i];
+                            continue;
+                        }
+
+                        try
+                        {
+                            stage.names[i] = ApplyCompiled(input, compiled_[r], i);
+                        }
+                        catch (const std::exception& e)
+                        {
+                            stage.names[i] = names_[i];
+                            stage.errors[i] = e.what();
+                        }
+                    }
+                }
+            }
+        };
+
+        unsigned threads = std::min(kMaxPreviewThreads, std::max(1u, std::thread::hardware_concurrency()));
+        threads = static_cast<unsigned>(std::min<size_t>(threads, chunks));
+        if (threads <= 1)
+        {
+            worker();
+        }
+        else
+        {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (unsigned t = 0; t < threads; ++t)
+                workers.emplace_back(worker);
+            for (auto& thread : workers)
+                thread.join();
+        }
+
+        valid_stages_ = rules_.size();
+    }
+
+    bool BatchRename::NameExists(const std::string& directory, const std::string& name)
+    {
+        // One listing per directory instead of a lookup per file
+        auto it = existing_names_.find(directory);
+        if (it == existing_names_.end())
+        {
+            std::unordered_set<std::string> names;
+            std::error_code ec;
+            for (std::filesystem::directory_iterator entry(directory, ec), end; !ec && entry != end; entry.increment(ec))
+            {
+                names.insert(FoldName(entry->path().filename().string()));
+            }
+            it = existing_names_.emplace(directory, std::move(names)).first;
+        }
+        return it->second.count(FoldName(name)) > 0;
+    }
+
     std::vector<RenamePreview> BatchRename::GeneratePreview()
     {
-        std::vector<RenamePreview> previews;
-        previews.reserve(files_.size());
+        UpdateStages();
 
+        std::vector<RenamePreview> previews(files_.size());
         for (size_t i = 0; i < files_.size(); ++i)
         {
-            RenamePreview preview;
+            RenamePreview& preview = previews[i];
             preview.original_path = files_[i];
-            preview.original_name = files_[i].Filename();
+            preview.original_name = names_[i];
 
-            try
+            if (rules_.empty())
             {
-                preview.new_name = ApplyAllRules(preview.original_name, i);
-                preview.will_change = (preview.original_name != preview.new_name);
+                preview.new_name = names_[i];
             }
-            catch (const std::exception& e)
+            else if (!stages_.back().errors[i].empty())
             {
                 preview.has_error = true;
-                preview.error_message = e.what();
+                preview.error_message = stages_.back().errors[i];
                 preview.new_name = preview.original_name;
             }
+            else
+            {
+                preview.new_name = stages_.back().names[i];
+                preview.will_change = (preview.original_name != preview.new_name);
+            }
+        }
 
-            previews.push_back(preview);
+        // Two files bound for one name in one directory both conflict,
+        // whatever the case of each
+        std::unordered_map<std::string, size_t> targets;
+        targets.reserve(previews.size());
+        std::vector<std::string> keys(previews.size());
+        for (size_t i = 0; i < previews.size(); ++i)
+        {
+            keys[i] = FoldName(directories_[i] + '/' + previews[i].new_name);
+            ++targets[keys[i]];
         }
 
-        // Check for conflicts
+        // A file of the batch that moves away frees its name, which is how
+        // swaps work; one that turns out unable to move keeps it, so look
+        // again until nothing changes
+        std::unordered_set<std::string> leaving;
         for (size_t i = 0; i < previews.size(); ++i)
         {
-            if (previews[i].has_error) continue;
+            if (previews[i].will_change && !previews[i].has_error)
+                leaving.insert(FoldName(directories_[i] + '/' + names_[i]));
+        }
 
-            core::Path new_path(files_[i].Parent().String() + "/" + previews[i].new_name);
-            previews[i].has_conflict = HasConflict(new_path, previews, i);
+        for (bool changed = true; changed;)
+        {
+            changed = false;
+            for (size_t i = 0; i < previews.size(); ++i)
+            {
+                if (previews[i].has_error) continue;
+
+                // A name that does not change can only be taken by another file in the batch
+                previews[i].has_conflict = targets[keys[i]] > 1 ||
+                    (previews[i].will_change && NameExists(directories_[i], previews[i].new_name) &&
+                     leaving.count(keys[i]) == 0);
+                if (previews[i].has_conflict && leaving.erase(FoldName(directories_[i] + '/' + names_[i])) > 0)
+                    changed = true;
+            }
         }
 
         return previews;
     }
 
+    BatchRename::CompiledRule BatchRename::CompileRule(const RenameRule& rule)
+    {
+        CompiledRule compiled;
+        compiled.rule = rule;
+
+        bool is_regex = rule.operation == RenameOperation::RegexReplace ||
+                        (rule.operation == RenameOperation::Replace && rule.use_regex);
+        if (is_regex)
+        {
+            try
+            {
+                compiled.regex.emplace(rule.find_text,
+                    rule.case_sensitive ? std::regex::ECMAScript :
+                                          std::regex::ECMAScript | std::regex::icase);
+            }
+            catch (const std::regex_error& e)
+            {
+                // Left without a regex, the rule changes nothing
+                SPDLOG_WARN("Regex error: {}", e.what());
+            }
+        }
+
+        compiled.folded_find = rule.find_text;
+        std::transform(compiled.folded_find.begin(), compiled.folded_find.end(), compiled.folded_find.begin(), ::tolower);
+        return compiled;
+    }
+
     std::string BatchRename::ApplyRule(const std::string& filename, 
                                         const RenameRule& rule, 
                                         size_t file_index)
     {
+        return ApplyCompiled(filename, CompileRule(rule), file_index);
+    }
+
+    std::string BatchRename::ApplyCompiled(const std::string& filename,
+                                           const CompiledRule& compiled,
+                                           size_t file_index) const
+    {
+        const RenameRule& rule = compiled.rule;
         auto [name, ext] = SplitExtension(filename);
         std::string result_name = name;
         std::string result_ext = ext;
@@ -115,31 +394,30 @@ namespace opacity::batch
             {
                 if (rule.use_regex)
                 {
-                    try
+                    if (compiled.regex)
                     {
-                        std::regex rx(rule.find_text, 
-                            rule.case_sensitive ? std::regex::ECMAScript : 
-                                                  std::regex::ECMAScript | std::regex::icase);
-                        result_name = std::regex_replace(result_name, rx, rule.replace_text);
-                        if (rule.apply_to_extension)
+                        try
                         {
-                            result_ext = std::regex_replace(result_ext, rx, rule.replace_text);
+                            result_name = std::regex_replace(result_name, *compiled.regex, rule.replace_text);
+                            if (rule.apply_to_extension)
+                            {
+                                result_ext = std::regex_replace(result_ext, *compiled.regex, rule.replace_text);
+                            }
+                        }
+                        catch (const std::regex_error& e)
+                        {
+                            SPDLOG_WARN("Regex error: {}", e.what());
                         }
-                    }
-                    catch (const std::regex_error& e)
-                    {
-                        SPDLOG_WARN("Regex error: {}", e.what());
                     }
                 }
-                else
+                else if (!rule.find_text.empty())
                 {
                     // Simple find and replace
-                    std::string search = rule.find_text;
+                    const std::string& search = rule.case_sensitive ? rule.find_text : compiled.folded_find;
                     std::string target = result_name;
                     
                     if (!rule.case_sensitive)
                     {
-                        std::transform(search.begin(), search.end(), search.begin(), ::tolower);
                         std::transform(target.begin(), target.end(), target.begin(), ::tolower);
                     }
 
@@ -160,16 +438,16 @@ namespace opacity::batch
 
         case RenameOperation::RegexReplace:
             {
-                try
-                {
-                    std::regex rx(rule.find_text,
-                        rule.case_sensitive ? std::regex::ECMAScript :
-                                              std::regex::ECMAScript | std::regex::icase);
-                    result_name = std::regex_replace(result_name, rx, rule.replace_text);
-                }
-                catch (const std::regex_error& e)
+                if (compiled.regex)
                 {
-                    SPDLOG_WARN("Regex error: {}", e.what());
+                    try
+                    {
+                        result_name = std::regex_replace(result_name, *compiled.regex, rule.replace_text);
+                    }
+                    catch (const std::regex_error& e)
+                    {
+                        SPDLOG_WARN("Regex error: {}", e.what());
+                    }
                 }
             }
             break;
@@ -301,9 +579,9 @@ namespace opacity::batch
     std::string BatchRename::ApplyAllRules(const std::string& filename, size_t file_index)
     {
         std::string result = filename;
-        for (const auto& rule : rules_)
+        for (const auto& compiled : compiled_)
         {
-            result = ApplyRule(result, rule, file_index);
+            result = ApplyCompiled(result, compiled, file_index);
         }
         return result;
     }
@@ -314,23 +592,12 @@ namespace opacity::batch
         result.total_files = files_.size();
 
         auto previews = GeneratePreview();
-        std::vector<std::pair<core::Path, core::Path>> undo_entries;
+        std::vector<RenameMove> moves;
 
         for (size_t i = 0; i < files_.size(); ++i)
         {
             const auto& preview = previews[i];
 
-            if (progress_callback)
-            {
-                RenameProgress progress;
-                progress.files_processed = i;
-                progress.total_files = files_.size();
-                progress.current_file = preview.original_name;
-                progress.percentage = files_.size() > 0 ? 
-                    (static_cast<double>(i) / files_.size()) * 100.0 : 0.0;
-                progress_callback(progress);
-            }
-
             if (preview.has_error)
             {
                 ++result.error_count;
@@ -351,24 +618,28 @@ namespace opacity::batch
                 continue;
             }
 
-            core::Path new_path(files_[i].Parent().String() + "/" + preview.new_name);
+            moves.push_back({files_[i], core::Path(directories_[i] + "/" + preview.new_name), i});
+        }
 
-            try
-            {
-                std::filesystem::rename(files_[i].Get(), new_path.Get());
-                undo_entries.push_back({new_path, files_[i]});
-                ++result.renamed_count;
-                
-                // Update the file list
-                files_[i] = new_path;
-            }
-            catch (const std::exception& e)
-            {
-                ++result.error_count;
-                result.errors.push_back(preview.original_name + ": " + e.what());
-            }
+        std::vector<uint8_t> done;
+        RunMoves(moves, "rename", result, done, progress_callback);
+
+        std::vector<std::pair<core::Path, core::Path>> undo_entries;
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            if (!done[m])
+                continue;
+
+            undo_entries.push_back({moves[m].to, moves[m].from});
+            ++result.renamed_count;
+
+            // Update the file list
+            files_[moves[m].file] = moves[m].to;
         }
 
+        // Renamed files start the next preview over
+        InvalidateFiles();
+
         // Save undo information
         if (!undo_entries.empty())
         {
@@ -390,32 +661,335 @@ namespace opacity::batch
             return false;
         }
 
-        auto& last_operation = undo_stack_.back();
-        bool all_success = true;
+        // Files no longer in the list are still renamed back
+        std::unordered_map<std::string, size_t> positions;
+        for (size_t i = 0; i < files_.size(); ++i)
+        {
+            positions.emplace(files_[i].String(), i);
+        }
 
-        for (const auto& [new_path, original_path] : last_operation)
+        std::vector<RenameMove> moves;
+        for (const auto& [new_path, original_path] : undo_stack_.back())
         {
-            try
+            auto it = positions.find(new_path.String());
+            moves.push_back({new_path, original_path, it != positions.end() ? it->second : SIZE_MAX});
+        }
+
+        RenameResult result;
+        std::vector<uint8_t> done;
+        RunMoves(moves, "undo rename", result, done, nullptr);
+
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            if (done[m] && moves[m].file != SIZE_MAX)
+            {
+                files_[moves[m].file] = moves[m].to;
+            }
+        }
+        for (const auto& error : result.errors)
+        {
+            SPDLOG_ERROR("Failed to undo rename: {}", error);
+        }
+
+        undo_stack_.pop_back();
+        InvalidateFiles();
+        return result.error_count == 0;
+    }
+
+    void BatchRename::SetDefaultJournal(core::CrashRecovery* recovery)
+    {
+        g_default_journal = recovery;
+    }
+
+    std::vector<std::vector<std::vector<BatchRename::RenameStep>>> BatchRename::PlanMoves(
+        const std::vector<RenameMove>& moves)
+    {
+        constexpr size_t kNone = SIZE_MAX;
+
+        // Each name is the target of one move at most, so the moves form
+        // separate chains and cycles. Names are matched in any case, as the
+        // preview checked them; a move that only changes case finds itself
+        // and waits on nothing
+        std::unordered_map<std::string, size_t> by_source;
+        by_source.reserve(moves.size());
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            by_source.emplace(FoldName(moves[m].from.String()), m);
+        }
+
+        std::vector<size_t> next(moves.size(), kNone);      // The move that must go first, out of the way
+        std::vector<bool> has_previous(moves.size(), false);
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            auto it = by_source.find(FoldName(moves[m].to.String()));
+            if (it != by_source.end() && it->second != m)
+            {
+                next[m] = it->second;
+                has_previous[it->second] = true;
+            }
+        }
+
+        std::vector<std::vector<std::vector<RenameStep>>> plan;
+        std::unordered_map<std::string, size_t> directories;
+        auto add = [&](size_t first, std::vector<RenameStep> sequence)
+        {
+            auto [it, added] = directories.emplace(moves[first].from.Parent().String(), plan.size());
+            if (added)
+                plan.emplace_back();
+            plan[it->second].push_back(std::move(sequence));
+        };
+
+        // A chain runs from its far end, each move freeing the name the one before needs
+        std::vector<bool> planned(moves.size(), false);
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            if (has_previous[m])
+                continue;
+
+            std::vector<RenameStep> sequence;
+            for (size_t n = m; n != kNone; n = next[n])
             {
-                std::filesystem::rename(new_path.Get(), original_path.Get());
-                
-                // Update file list
-                auto it = std::find_if(files_.begin(), files_.end(),
-                    [&new_path](const core::Path& p) { return p.String() == new_path.String(); });
-                if (it != files_.end())
+                planned[n] = true;
+                sequence.push_back({moves[n].from, moves[n].to, n, true});
+            }
+            std::reverse(sequence.begin(), sequence.end());
+            add(m, std::move(sequence));
+        }
+
+        // What is left are cycles: the first file steps aside to a temporary
+        // name, the rest follow from the far end, and it takes its new name last
+        size_t counter = 0;
+        for (size_t m = 0; m < moves.size(); ++m)
+        {
+            if (planned[m])
+                continue;
+
+            std::vector<size_t> cycle;
+            for (size_t n = m; n != kNone && !planned[n]; n = next[n])
+            {
+                planned[n] = true;
+                cycle.push_back(n);
+            }
+
+            core::Path temporary = TemporaryName(moves[m].from, counter);
+            std::vector<RenameStep> sequence;
+            sequence.push_back({moves[m].from, temporary, m, false});
+            for (size_t k = cycle.size(); k-- > 1;)
+            {
+                size_t n = cycle[k];
+                sequence.push_back({moves[n].from, moves[n].to, n, true});
+            }
+            sequence.push_back({temporary, moves[m].to, m, true});
+            add(m, std::move(sequence));
+        }
+
+        return plan;
+    }
+
+    void BatchRename::RunMoves(const std::vector<RenameMove>& moves,
+                               const std::string& kind,
+                               RenameResult& result,
+                               std::vector<uint8_t>& done,
+                               const RenameProgressCallback& progress_callback)
+    {
+        done.assign(moves.size(), 0);
+        if (moves.empty())
+            return;
+
+        auto plan = PlanMoves(moves);
+
+        // The whole plan is on disk before the first rename
+        std::string journal_id;
+        if (journal_)
+        {
+            json sequences = json::array();
+            for (const auto& directory : plan)
+            {
+                for (const auto& sequence : directory)
                 {
-                    *it = original_path;
+                    json steps = json::array();
+                    for (const auto& step : sequence)
+                    {
+                        steps.push_back({{"from", step.from.String()}, {"to", step.to.String()}});
+                    }
+                    sequences.push_back(std::move(steps));
                 }
             }
-            catch (const std::exception& e)
+
+            auto now = std::chrono::system_clock::now();
+            core::PendingOperation pending;
+            pending.id = "rename-" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+                now.time_since_epoch()).count());
+            pending.type = kJournalType;
+            pending.startTime = now;
+            pending.totalCount = static_cast<int>(moves.size());
+            pending.customData = json{{"version", kJournalVersion}, {"kind", kind}, {"sequences", std::move(sequences)}}.dump();
+            journal_->RecordPendingOperation(pending);
+            journal_id = pending.id;
+        }
+
+        std::mutex report_mutex;
+        size_t processed = 0;
+        bool rollback_failed = false;
+        auto journal_written = std::chrono::steady_clock::now();
+
+        auto report = [&](const RenameMove& move, const std::string* error)
+        {
+            std::lock_guard<std::mutex> lock(report_mutex);
+            ++processed;
+            if (error)
+            {
+                ++result.error_count;
+                result.errors.push_back(move.from.Filename() + ": " + *error);
+            }
+
+            if (progress_callback)
             {
-                SPDLOG_ERROR("Failed to undo rename: {}", e.what());
-                all_success = false;
+                RenameProgress progress;
+                progress.files_processed = processed;
+                progress.total_files = moves.size();
+                progress.current_file = move.from.Filename();
+                progress.percentage = (static_cast<double>(processed) / moves.size()) * 100.0;
+                progress_callback(progress);
             }
+
+            auto now = std::chrono::steady_clock::now();
+            if (journal_ && now - journal_written >= kJournalInterval)
+            {
+                journal_->UpdateOperationProgress(journal_id, static_cast<int>(processed));
+                journal_written = now;
+            }
+        };
+
+        // One directory at a time per worker; sequences never share a name
+        std::atomic<size_t> next{0};
+        auto worker = [&]()
+        {
+            for (size_t index; (index = next.fetch_add(1)) < plan.size();)
+            {
+                for (const auto& sequence : plan[index])
+                {
+                    std::string error;
+                    size_t failed = sequence.size();
+                    for (size_t k = 0; k < sequence.size(); ++k)
+                    {
+                        if (!RenameNoReplace(sequence[k].from.Get(), sequence[k].to.Get(), error))
+                        {
+                            failed = k;
+                            break;
+                        }
+                    }
+
+                    if (failed == sequence.size())
+                    {
+                        for (const auto& step : sequence)
+                        {
+                            if (step.final)
+                            {
+                                done[step.move] = 1;
+                                report(moves[step.move], nullptr);
+                            }
+                        }
+                        continue;
+                    }
+
+                    // All or nothing: put back what this sequence had renamed
+                    for (size_t k = failed; k-- > 0;)
+                    {
+                        std::string undo_error;
+                        if (!RenameNoReplace(sequence[k].to.Get(), sequence[k].from.Get(), undo_error))
+                        {
+                            SPDLOG_ERROR("Failed to roll back {} -> {}: {}", sequence[k].to.String(),
+                                         sequence[k].from.String(), undo_error);
+                            std::lock_guard<std::mutex> lock(report_mutex);
+                            rollback_failed = true;
+                        }
+                    }
+
+                    const auto& failed_step = sequence[failed];
+                    for (const auto& step : sequence)
+                    {
+                        if (!step.final)
+                            continue;
+                        std::string message = step.move == failed_step.move ? error : "Rolled back with " + moves[failed_step.move].from.Filename();
+                        report(moves[step.move], &message);
+                    }
+                }
+            }
+        };
+
+        unsigned threads = std::min(kMaxRenameThreads, std::max(1u, std::thread::hardware_concurrency()));
+        threads = static_cast<unsigned>(std::min<size_t>(threads, plan.size()));
+        if (threads <= 1)
+        {
+            worker();
+        }
+        else
+        {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (unsigned t = 0; t < threads; ++t)
+                workers.emplace_back(worker);
+            for (auto& thread : workers)
+                thread.join();
         }
 
-        undo_stack_.pop_back();
-        return all_success;
+        // Kept when something could not be put back, so it can be tried again
+        if (journal_)
+        {
+            if (rollback_failed)
+                journal_->UpdateOperationProgress(journal_id, static_cast<int>(processed));
+            else
+                journal_->CompleteOperation(journal_id);
+        }
+        SPDLOG_INFO("Batch {}: {} of {} files in {} directories", kind, processed - result.error_count,
+                    moves.size(), plan.size());
+    }
+
+    bool BatchRename::RollBackJournal(const core::PendingOperation& pending, core::CrashRecovery* recovery)
+    {
+        if (pending.type != kJournalType)
+            return false;
+
+        bool success = true;
+        try
+        {
+            json j = json::parse(pending.customData);
+            if (j.value("version", 0) != kJournalVersion)
+                return false;
+
+            std::error_code ec;
+            for (const auto& steps : j.at("sequences"))
+            {
+                for (size_t k = steps.size(); k-- > 0;)
+                {
+                    std::filesystem::path from = core::Path(steps[k].at("from").get<std::string>()).Get();
+                    std::filesystem::path to = core::Path(steps[k].at("to").get<std::string>()).Get();
+                    if (!std::filesystem::exists(to, ec) || std::filesystem::exists(from, ec))
+                        continue;
+
+                    std::string error;
+                    if (!RenameNoReplace(to, from, error))
+                    {
+                        SPDLOG_WARN("Cannot roll back {} -> {}: {}", to.string(), from.string(), error);
+                        success = false;
+                    }
+                }
+            }
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_WARN("Cannot roll back operation {}: {}", pending.id, e.what());
+            return false;
+        }
+
+        if (success)
+        {
+            SPDLOG_INFO("Rolled back rename batch {}", pending.id);
+            if (recovery)
+                recovery->CompleteOperation(pending.id);
+        }
+        return success;
     }
 
     void BatchRename::SortByName(bool ascending)
@@ -425,6 +999,7 @@ namespace opacity::batch
             {
                 return ascending ? a.Filename() < b.Filename() : a.Filename() > b.Filename();
             });
+        InvalidateFiles();
     }
 
     void BatchRename::SortByDate(bool ascending)
@@ -436,6 +1011,7 @@ namespace opacity::batch
                 auto time_b = std::filesystem::last_write_time(b.Get());
                 return ascending ? time_a < time_b : time_a > time_b;
             });
+        InvalidateFiles();
     }
 
     void BatchRename::SortBySize(bool ascending)
@@ -447,6 +1023,7 @@ namespace opacity::batch
                 auto size_b = std::filesystem::file_size(b.Get());
                 return ascending ? size_a < size_b : size_a > size_b;
             });
+        InvalidateFiles();
     }
 
     void BatchRename::Randomize()
@@ -454,11 +1031,13 @@ namespace opacity::batch
         std::random_device rd;
         std::mt19937 g(rd());
         std::shuffle(files_.begin(), files_.end(), g);
+        InvalidateFiles();
     }
 
     void BatchRename::Reverse()
     {
         std::reverse(files_.begin(), files_.end());
+        InvalidateFiles();
     }
 
     RenameRule BatchRename::CreateReplaceRule(const std::string& find,
@@ -733,34 +1312,4 @@ namespace opacity::batch
         return {filename.substr(0, pos), filename.substr(pos + 1)};
     }
 
-    bool BatchRename::HasConflict(const core::Path& new_path,
-                                   const std::vector<RenamePreview>& previews,
-                                   size_t current_index) const
-    {
-        // Check if file already exists (and it's not the same file)
-        if (std::filesystem::exists(new_path.Get()))
-        {
-            if (new_path.String() != files_[current_index].String())
-            {
-                return true;
-            }
-        }
-
-        // Check if any other file in the batch will have the same name
-        std::string new_name = new_path.Filename();
-        for (size_t i = 0; i < previews.size(); ++i)
-        {
-            if (i != current_index && previews[i].new_name == new_name)
-            {
-                // Check if they're in the same directory
-                if (files_[i].Parent().String() == files_[current_index].Parent().String())
-                {
-                    return true;
-                }
-            }
-        }
-
-        return false;
-    }
-
 } // namespace opacity::batch
@@ -1,9 +1,19 @@
 #include "opacity/batch/DuplicateFinder.h"
+#include "opacity/batch/ImageSimilarity.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/FileHasher.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/filesystem/CloudIntegration.h"
+#include "opacity/filesystem/StorageTopology.h"
+#include "opacity/preview/ImagePreviewHandler.h"
 
 #include <algorithm>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <fstream>
+#include <numeric>
 #include <iomanip>
 #include <regex>
 #include <sstream>
@@ -16,6 +26,294 @@
 
 namespace opacity::batch
 {
+    namespace
+    {
+        // Longest side of the decode an image hash is taken from
+        constexpr int kImageHashEdge = 64;
+
+        // A file still in the running for a duplicate group
+        struct Candidate
+        {
+            core::Path path;
+            uint64_t size = 0;
+            size_t device = 0;          // Index into the per-device reader limits
+            std::string name;           // Lowercased, for SizeAndName
+            std::string hash;           // Hex, from the last stage that read the file
+            uint64_t digest = 0;        // The same hash, for grouping
+            bool hashed = false;
+            core::FileIdentity identity;
+            bool identified = false;
+            const Candidate* same_as = nullptr;     // Another path to this file on disk, read in its place
+        };
+
+        using CandidateGroups = std::vector<std::vector<Candidate*>>;
+
+        // Every path in the groups, or only one per file on disk
+        std::vector<Candidate*> Members(const CandidateGroups& groups, bool distinct = false)
+        {
+            std::vector<Candidate*> members;
+            for (const auto& group : groups)
+            {
+                for (auto* candidate : group)
+                {
+                    if (!distinct || !candidate->same_as)
+                        members.push_back(candidate);
+                }
+            }
+            return members;
+        }
+
+        // Break each group into runs that compare equal; files the last
+        // stage could not read and runs holding one file on disk drop out.
+        // Other paths to a file sort with it, as they share its hash.
+        template <typename Less>
+        void Split(CandidateGroups& groups, bool hashed_only, Less less)
+        {
+            CandidateGroups split;
+            for (auto& group : groups)
+            {
+                for (auto* candidate : group)
+                {
+                    if (candidate->same_as)
+                    {
+                        candidate->hash = candidate->same_as->hash;
+                        candidate->digest = candidate->same_as->digest;
+                        candidate->hashed = candidate->same_as->hashed;
+                    }
+                }
+
+                if (hashed_only)
+                {
+                    group.erase(std::remove_if(group.begin(), group.end(),
+                        [](const Candidate* candidate) { return !candidate->hashed; }), group.end());
+                }
+
+                std::stable_sort(group.begin(), group.end(),
+                    [&less](const Candidate* a, const Candidate* b) { return less(*a, *b); });
+
+                for (size_t begin = 0, end = 0; begin < group.size(); begin = end)
+                {
+                    size_t files = 0;
+                    for (end = begin; end < group.size() && !less(*group[begin], *group[end]); ++end)
+                    {
+                        if (!group[end]->same_as)
+                            ++files;
+                    }
+                    if (files > 1)
+                        split.emplace_back(group.begin() + begin, group.begin() + end);
+                }
+            }
+            groups.swap(split);
+        }
+
+        bool SameFile(const core::FileIdentity& a, const core::FileIdentity& b)
+        {
+            // Without a volume the id is only a hash of the path
+            return a.volume != 0 && a.volume == b.volume && a.file_id == b.file_id;
+        }
+
+        // Hard links and paths through junctions to one file on disk are
+        // pointed at the first of them, which alone is read from now on
+        void CollapseSameFiles(CandidateGroups& groups)
+        {
+            auto by_id = [](const Candidate* a, const Candidate* b)
+            {
+                if (a->identity.volume != b->identity.volume)
+                    return a->identity.volume < b->identity.volume;
+                return a->identity.file_id < b->identity.file_id;
+            };
+
+            for (auto& group : groups)
+            {
+                std::vector<Candidate*> identified;
+                for (auto* candidate : group)
+                {
+                    if (candidate->identified)
+                        identified.push_back(candidate);
+                }
+                std::stable_sort(identified.begin(), identified.end(), by_id);
+
+                for (size_t i = 1; i < identified.size(); ++i)
+                {
+                    const Candidate* previous = identified[i - 1];
+                    if (SameFile(previous->identity, identified[i]->identity))
+                        identified[i]->same_as = previous->same_as ? previous->same_as : previous;
+                }
+            }
+        }
+
+        // Images whose hashes are within max_distance of each other, or
+        // linked through others that are, end up in one group
+        void ClusterSimilar(CandidateGroups& groups, int max_distance)
+        {
+            std::vector<Candidate*> images;
+            for (auto* candidate : Members(groups))
+            {
+                if (candidate->hashed && !candidate->same_as)
+                    images.push_back(candidate);
+            }
+
+            HammingIndex index;
+            index.Reserve(images.size());
+            for (size_t i = 0; i < images.size(); ++i)
+            {
+                index.Insert(images[i]->digest, static_cast<uint32_t>(i));
+            }
+
+            std::vector<uint32_t> parent(images.size());
+            std::iota(parent.begin(), parent.end(), 0u);
+            auto root = [&parent](uint32_t i)
+            {
+                while (parent[i] != i)
+                {
+                    parent[i] = parent[parent[i]];
+                    i = parent[i];
+                }
+                return i;
+            };
+
+            std::vector<uint32_t> near;
+            for (size_t i = 0; i < images.size(); ++i)
+            {
+                near.clear();
+                index.Find(images[i]->digest, max_distance, near);
+                for (uint32_t j : near)
+                {
+                    uint32_t a = root(static_cast<uint32_t>(i));
+                    uint32_t b = root(j);
+                    if (a != b)
+                        parent[std::max(a, b)] = std::min(a, b);
+                }
+            }
+
+            std::unordered_map<const Candidate*, size_t> cluster_of;
+            std::unordered_map<uint32_t, size_t> clusters;
+            CandidateGroups clustered;
+            for (size_t i = 0; i < images.size(); ++i)
+            {
+                auto [it, added] = clusters.emplace(root(static_cast<uint32_t>(i)), clustered.size());
+                if (added)
+                    clustered.emplace_back();
+                clustered[it->second].push_back(images[i]);
+                cluster_of[images[i]] = it->second;
+            }
+
+            // Other paths to an image go with it
+            for (auto* candidate : Members(groups))
+            {
+                auto it = candidate->same_as ? cluster_of.find(candidate->same_as) : cluster_of.end();
+                if (it != cluster_of.end())
+                    clustered[it->second].push_back(candidate);
+            }
+
+            groups.swap(clustered);
+            Split(groups, false, [](const Candidate&, const Candidate&) { return false; });
+        }
+
+        void SetHash(Candidate& candidate, std::string hash, const std::atomic<bool>& cancel)
+        {
+            // Unreadable files would otherwise all share the empty hash
+            candidate.hash = std::move(hash);
+            candidate.hashed = !candidate.hash.empty();
+            if (candidate.hashed)
+                candidate.digest = std::strtoull(candidate.hash.c_str(), nullptr, 16);
+            else if (!cancel.load())
+                SPDLOG_WARN("Failed to hash {}", candidate.path.String());
+        }
+
+        // Each device gets as many readers as it serves well at once, so a
+        // spinning disk is read one file at a time while an SSD or another
+        // disk in the same search is read alongside it
+        void ReadCandidates(const std::vector<Candidate*>& pending, const std::vector<size_t>& device_limits,
+                            const core::BackgroundPolicy& background, const std::atomic<bool>& cancel,
+                            const std::function<void(Candidate&)>& read,
+                            const std::function<void(const Candidate&)>& on_read)
+        {
+            std::vector<std::vector<Candidate*>> queues(device_limits.size());
+            for (auto* candidate : pending)
+            {
+                queues[candidate->device].push_back(candidate);
+            }
+
+            std::vector<std::atomic<size_t>> next(queues.size());
+            std::vector<std::atomic<size_t>> readers(queues.size());
+            std::mutex report_mutex;
+            std::mutex slot_mutex;
+            std::condition_variable slot_freed;
+            auto worker = [&](size_t device)
+            {
+                // Pool tasks and the caller both read; neither goes over the limit
+                if (readers[device].fetch_add(1) >= device_limits[device])
+                {
+                    readers[device]--;
+                    return;
+                }
+
+                {
+                    core::BackgroundScope scope(background);
+                    auto& queue = queues[device];
+                    for (size_t index; (index = next[device].fetch_add(1)) < queue.size();)
+                    {
+                        scope.Yield(&cancel);
+                        if (cancel.load())
+                            break;
+
+                        Candidate& candidate = *queue[index];
+                        try
+                        {
+                            read(candidate);
+                        }
+                        catch (const std::exception& e)
+                        {
+                            SPDLOG_WARN("Failed to read {}: {}", candidate.path.String(), e.what());
+                        }
+
+                        std::lock_guard<std::mutex> lock(report_mutex);
+                        on_read(candidate);
+                    }
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(slot_mutex);
+                    readers[device]--;
+                }
+                slot_freed.notify_all();
+            };
+
+            core::TaskOptions options;
+            if (background.low_priority)
+                options.priority = core::TaskPriority::Background;
+            core::TaskGroup helpers;
+            for (size_t device = 0; device < queues.size(); ++device)
+            {
+                size_t count = std::min<size_t>({device_limits[device], queues[device].size(),
+                                                 core::FileHasher::kMaxThreads});
+                helpers.Spawn(count, [&worker, device] { worker(device); }, options);
+            }
+
+            // Read alongside the helpers wherever a device has a free reader,
+            // so a busy pool slows the search down rather than stalling it
+            for (;;)
+            {
+                bool remaining = false;
+                for (size_t device = 0; device < queues.size() && !cancel.load(); ++device)
+                {
+                    if (next[device].load() < queues[device].size())
+                    {
+                        remaining = true;
+                        worker(device);
+                    }
+                }
+                if (!remaining || cancel.load())
+                    break;
+
+                std::unique_lock<std::mutex> lock(slot_mutex);
+                slot_freed.wait_for(lock, std::chrono::milliseconds(10));
+            }
+            helpers.Close();
+        }
+    }
+
     // DuplicateGroup implementation
     core::Path DuplicateGroup::GetOldestFile() const
     {
@@ -89,6 +387,26 @@ namespace opacity::batch
         return longest;
     }
 
+    size_t DuplicateGroup::GetDistinctFileCount() const
+    {
+        if (same_file.size() != files.size()) return files.size();
+
+        size_t distinct = 0;
+        for (size_t i = 0; i < same_file.size(); ++i)
+        {
+            if (same_file[i] == i) ++distinct;
+        }
+        return distinct;
+    }
+
+    bool DuplicateGroup::IsLinked(size_t index) const
+    {
+        if (index < links.size() && links[index] > 1) return true;
+        if (same_file.size() != files.size() || index >= same_file.size()) return false;
+
+        return std::count(same_file.begin(), same_file.end(), same_file[index]) > 1;
+    }
+
     // DuplicateResult implementation
     std::vector<const DuplicateGroup*> DuplicateResult::GetByWastedSpace() const
     {
@@ -130,10 +448,7 @@ namespace opacity::batch
     DuplicateFinder::~DuplicateFinder()
     {
         Cancel();
-        if (worker_thread_ && worker_thread_->joinable())
-        {
-            worker_thread_->join();
-        }
+        worker_task_.Wait();
     }
 
     DuplicateResult DuplicateFinder::FindDuplicates(
@@ -169,8 +484,12 @@ namespace opacity::batch
 
         SPDLOG_INFO("Found {} files to check", files.size());
 
+        // Resized and re-encoded copies differ in size, so images are not
+        // grouped by it
+        bool perceptual = options.mode == DuplicateMatchMode::PerceptualImage;
+
         // Phase 2: Group by size
-        if (progress_callback)
+        if (progress_callback && !perceptual)
         {
             DuplicateProgress progress;
             progress.current_phase = "Grouping by size";
@@ -178,7 +497,9 @@ namespace opacity::batch
             progress_callback(progress);
         }
 
-        auto size_groups = GroupBySize(files);
+        std::unordered_map<uint64_t, std::vector<core::Path>> size_groups;
+        if (!perceptual)
+            size_groups = GroupBySize(files);
 
         // Remove groups with only one file (no duplicates possible)
         for (auto it = size_groups.begin(); it != size_groups.end();)
@@ -195,103 +516,222 @@ namespace opacity::batch
 
         SPDLOG_INFO("{} size groups with potential duplicates", size_groups.size());
 
-        // Phase 3: Hash files within same-size groups
-        size_t processed = 0;
-        size_t total_to_hash = 0;
+        // Phase 3: Narrow the size groups down, cheapest test first. Every
+        // stage splits the groups it is given and drops whatever is left
+        // on its own, so each read only happens for files still in doubt.
+        std::vector<Candidate> candidates;
+        std::vector<size_t> device_limits;
+        std::unordered_map<std::string, size_t> device_indices;
+        bool needs_hash = options.mode != DuplicateMatchMode::SizeOnly &&
+                          options.mode != DuplicateMatchMode::SizeAndName;
+
+        // Candidates are pointed at from here on, so their storage is
+        // reserved once up front
+        size_t candidate_count = perceptual ? files.size() : 0;
         for (const auto& [size, group_files] : size_groups)
         {
-            total_to_hash += group_files.size();
+            candidate_count += group_files.size();
         }
+        candidates.reserve(candidate_count);
 
-        std::unordered_map<std::string, DuplicateGroup> hash_groups;
+        auto add_candidate = [&](const core::Path& file_path, uint64_t size, std::vector<Candidate*>& group)
+        {
+            // Hashing an online-only file would download it; a size
+            // match alone does not make it a duplicate
+            if (needs_hash && filesystem::CloudIntegration::ShouldSkipRead(file_path.Get(), options.read_placeholders))
+            {
+                ++result.placeholders_skipped;
+                return;
+            }
 
-        for (const auto& [size, group_files] : size_groups)
+            Candidate& candidate = candidates.emplace_back();
+            candidate.path = file_path;
+            candidate.size = size;
+
+            filesystem::VolumeProfile volume = filesystem::StorageTopology::GetVolumeProfile(file_path);
+            auto [it, added] = device_indices.emplace(volume.device, device_limits.size());
+            if (added)
+                device_limits.push_back(std::max<size_t>(1, volume.parallelism));
+            candidate.device = it->second;
+            group.push_back(&candidate);
+        };
+
+        std::vector<std::vector<Candidate*>> groups;
+        preview::ImagePreviewHandler images;
+        if (perceptual)
         {
-            if (cancel_requested_.load()) break;
+            std::vector<Candidate*> group;
+            for (const auto& [file_path, size] : files)
+            {
+                std::string ext = file_path.Extension();
+                if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
+                if (images.CanHandle(file_path, ext))
+                    add_candidate(file_path, size, group);
+            }
+            if (group.size() > 1)
+                groups.push_back(std::move(group));
+        }
 
+        for (const auto& [size, group_files] : size_groups)
+        {
+            std::vector<Candidate*> group;
             for (const auto& file_path : group_files)
             {
-                if (cancel_requested_.load()) break;
+                add_candidate(file_path, size, group);
+            }
+            if (group.size() > 1)
+                groups.push_back(std::move(group));
+        }
 
-                std::string hash;
-                try
-                {
-                    hash = CalculateHash(file_path, options.mode);
-                }
-                catch (const std::exception& e)
+        if (options.mode == DuplicateMatchMode::SizeAndName)
+        {
+            for (auto* candidate : Members(groups))
+            {
+                std::string name = candidate->path.Filename();
+                std::transform(name.begin(), name.end(), name.begin(), ::tolower);
+                candidate->name = std::move(name);
+            }
+            Split(groups, false, [](const Candidate& a, const Candidate& b) { return a.name < b.name; });
+        }
+
+        auto run_stage = [&](const std::vector<Candidate*>& pending, const std::string& phase,
+                             const std::function<void(Candidate&)>& read)
+        {
+            size_t processed = 0;
+            ReadCandidates(pending, device_limits, options.background, cancel_requested_, read, [&](const Candidate& candidate)
+            {
+                ++processed;
+                if (progress_callback)
                 {
-                    SPDLOG_WARN("Failed to hash {}: {}", file_path.String(), e.what());
-                    ++processed;
-                    continue;
+                    DuplicateProgress progress;
+                    progress.files_scanned = processed;
+                    progress.total_files = pending.size();
+                    progress.current_file = candidate.path.Filename();
+                    progress.current_phase = phase;
+                    progress.percentage = (static_cast<double>(processed) / pending.size()) * 100.0;
+                    progress_callback(progress);
                 }
+            });
+        };
 
-                std::string key = std::to_string(size) + "_" + hash;
-                
-                if (hash_groups.find(key) == hash_groups.end())
+        // Paths to one file on disk would otherwise be read once each and
+        // then reported as copies of each other. Reading an identity opens
+        // the file for its attributes only, which never recalls a placeholder.
+        run_stage(Members(groups), "Identifying files", [](Candidate& candidate)
+        {
+            candidate.identified = core::HashCache::ReadIdentity(candidate.path, candidate.identity);
+        });
+        CollapseSameFiles(groups);
+        Split(groups, false, [](const Candidate&, const Candidate&) { return false; });
+
+        auto by_digest = [](const Candidate& a, const Candidate& b) { return a.digest < b.digest; };
+        if (perceptual && !cancel_requested_.load())
+        {
+            // A small scaled decode is all the hash looks at; WIC scales
+            // JPEGs while decoding, so a large photo is never held whole
+            run_stage(Members(groups, true), "Comparing images", [&images](Candidate& candidate)
+            {
+                preview::ImagePreviewData image = images.LoadPreview(candidate.path, kImageHashEdge);
+                candidate.hashed = image.width > 0 && image.height > 0 && !image.pixels.empty();
+                if (!candidate.hashed)
                 {
-                    DuplicateGroup group;
-                    group.hash = hash;
-                    group.file_size = size;
-                    hash_groups[key] = group;
+                    SPDLOG_WARN("Failed to decode {}: {}", candidate.path.String(), image.error_message);
+                    return;
                 }
 
-                hash_groups[key].files.push_back(file_path);
-                ++processed;
+                char hex[17];
+                candidate.digest = ImageHash::Compute(image.pixels.data(), image.width, image.height);
+                std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(candidate.digest));
+                candidate.hash = hex;
+            });
+            ClusterSimilar(groups, options.max_image_distance);
+        }
+        else if (needs_hash && !cancel_requested_.load())
+        {
+            // First and last blocks tell most same-size files apart
+            run_stage(Members(groups, true), "Comparing first and last blocks", [this](Candidate& candidate)
+            {
+                SetHash(candidate, CalculatePartialHash(candidate.path), cancel_requested_);
+            });
+            Split(groups, true, by_digest);
 
-                if (progress_callback)
+            // Whatever still matches is read in full, except files no longer
+            // than a block, which the first stage already hashed whole
+            if (options.mode != DuplicateMatchMode::QuickHash && !cancel_requested_.load())
+            {
+                std::vector<Candidate*> pending;
+                for (auto* candidate : Members(groups, true))
                 {
-                    DuplicateProgress progress;
-                    progress.files_scanned = processed;
-                    progress.total_files = total_to_hash;
-                    progress.current_file = file_path.Filename();
-                    progress.current_phase = "Computing hashes";
-                    progress.percentage = total_to_hash > 0 ?
-                        (static_cast<double>(processed) / total_to_hash) * 100.0 : 0.0;
-                    progress_callback(progress);
+                    if (candidate->size > core::FileHasher::kPartialBlockSize)
+                    {
+                        candidate->hashed = false;
+                        pending.push_back(candidate);
+                    }
                 }
+                run_stage(pending, "Computing hashes", [this](Candidate& candidate)
+                {
+                    SetHash(candidate, CalculateFullHash(candidate.path), cancel_requested_);
+                });
+                Split(groups, true, by_digest);
             }
         }
 
         // Phase 4: Build result
-        for (auto& [key, group] : hash_groups)
+        for (const auto& members : groups)
         {
-            if (group.files.size() > 1)
+            DuplicateGroup group;
+            group.hash = members.front()->hash;
+            group.file_size = members.front()->size;
+
+            std::unordered_map<const Candidate*, size_t> first_path;
+            for (const auto* candidate : members)
             {
-                // Calculate timestamps
-                for (const auto& file_path : group.files)
+                const Candidate* file = candidate->same_as ? candidate->same_as : candidate;
+                group.same_file.push_back(first_path.emplace(file, group.files.size()).first->second);
+                group.links.push_back(candidate->identified ? candidate->identity.links : 0);
+                group.files.push_back(candidate->path);
+                group.file_size = std::min(group.file_size, candidate->size);
+
+                try
                 {
-                    try
+                    auto ftime = std::filesystem::last_write_time(candidate->path.Get());
+                    auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                        ftime - std::filesystem::file_time_type::clock::now() + 
+                        std::chrono::system_clock::now());
+                    
+                    if (group.oldest_modified == std::chrono::system_clock::time_point{} ||
+                        sctp < group.oldest_modified)
                     {
-                        auto ftime = std::filesystem::last_write_time(file_path.Get());
-                        auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                            ftime - std::filesystem::file_time_type::clock::now() + 
-                            std::chrono::system_clock::now());
-                        
-                        if (group.oldest_modified == std::chrono::system_clock::time_point{} ||
-                            sctp < group.oldest_modified)
-                        {
-                            group.oldest_modified = sctp;
-                        }
-                        if (sctp > group.newest_modified)
-                        {
-                            group.newest_modified = sctp;
-                        }
+                        group.oldest_modified = sctp;
+                    }
+                    if (sctp > group.newest_modified)
+                    {
+                        group.newest_modified = sctp;
                     }
-                    catch (...) {}
                 }
-
-                result.groups.push_back(std::move(group));
-                result.total_duplicates += group.files.size() - 1;
-                result.total_wasted_space += group.GetWastedSpace();
+                catch (...) {}
             }
+
+            result.total_duplicates += group.GetDistinctFileCount() - 1;
+            result.total_wasted_space += group.GetWastedSpace();
+            result.groups.push_back(std::move(group));
         }
 
         auto end_time = std::chrono::steady_clock::now();
         result.duration = std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time);
         result.success = !cancel_requested_.load();
 
+        if (hash_cache_)
+        {
+            hash_cache_->Flush();
+        }
+
         SPDLOG_INFO("Duplicate search complete: {} groups, {} duplicates, {} bytes wasted",
             result.groups.size(), result.total_duplicates, result.total_wasted_space);
+        if (result.placeholders_skipped > 0)
+        {
+            SPDLOG_INFO("Skipped {} online-only files", result.placeholders_skipped);
+        }
 
         running_.store(false);
 
@@ -316,13 +756,12 @@ namespace opacity::batch
             return;
         }
 
-        if (worker_thread_ && worker_thread_->joinable())
-        {
-            worker_thread_->join();
-        }
+        worker_task_.Wait();
 
-        worker_thread_ = std::make_unique<std::thread>([this, paths, options,
-                                                         progress_callback, complete_callback]()
+        core::TaskOptions task_options;
+        task_options.priority = core::TaskPriority::Background;
+        worker_task_ = core::TaskScheduler::Get().Submit([this, paths, options,
+                                                          progress_callback, complete_callback](const core::CancellationToken&)
         {
             auto result = FindDuplicates(paths, options, progress_callback);
             
@@ -330,7 +769,7 @@ namespace opacity::batch
             {
                 complete_callback(result.success, result.error_message);
             }
-        });
+        }, std::move(task_options));
     }
 
     void DuplicateFinder::Cancel()
@@ -380,7 +819,7 @@ namespace opacity::batch
                         break;
                     }
                 }
-                if (keep.String().empty())
+                if (keep.Empty())
                 {
                     keep = group.files[0];
                 }
@@ -394,7 +833,7 @@ namespace opacity::batch
                         break;
                     }
                 }
-                if (keep.String().empty())
+                if (keep.Empty())
                 {
                     keep = group.files[0];
                 }
@@ -492,24 +931,40 @@ namespace opacity::batch
         const core::Path& keep_file)
     {
 #ifdef _WIN32
+        core::FileIdentity kept;
+        if (!core::HashCache::ReadIdentity(keep_file, kept))
+        {
+            SPDLOG_ERROR("Failed to create hard link: cannot open {}", keep_file.String());
+            return false;
+        }
+
         for (const auto& file : group.files)
         {
             if (file.String() == keep_file.String()) continue;
 
+            // Linked by an earlier run, or the same file all along
+            core::FileIdentity identity;
+            if (core::HashCache::ReadIdentity(file, identity) && SameFile(identity, kept)) continue;
+
             try
             {
-                // Delete the duplicate
-                std::filesystem::remove(file.Get());
+                // The link takes a temporary name first, so the duplicate is
+                // only replaced once its replacement exists
+                std::wstring link_path = file.WString();
+                std::wstring temporary_path = link_path + L".opacity-link";
+                std::wstring target_path = keep_file.WString();
                 
-                // Create hard link
-                std::wstring link_path(file.String().begin(), file.String().end());
-                std::wstring target_path(keep_file.String().begin(), keep_file.String().end());
-                
-                if (!CreateHardLinkW(link_path.c_str(), target_path.c_str(), nullptr))
+                if (!CreateHardLinkW(temporary_path.c_str(), target_path.c_str(), nullptr))
                 {
                     SPDLOG_ERROR("Failed to create hard link: {}", GetLastError());
                     return false;
                 }
+                if (!MoveFileExW(temporary_path.c_str(), link_path.c_str(), MOVEFILE_REPLACE_EXISTING))
+                {
+                    SPDLOG_ERROR("Failed to create hard link: {}", GetLastError());
+                    DeleteFileW(temporary_path.c_str());
+                    return false;
+                }
             }
             catch (const std::exception& e)
             {
@@ -720,84 +1175,24 @@ body { font-family: Arial, sans-serif; margin: 20px; }
         return groups;
     }
 
-    std::string DuplicateFinder::CalculateHash(const core::Path& path, DuplicateMatchMode mode)
+    std::string DuplicateFinder::CalculateFullHash(const core::Path& path)
     {
-        switch (mode)
-        {
-        case DuplicateMatchMode::SizeOnly:
-        case DuplicateMatchMode::SizeAndName:
-            return ""; // No hash needed
-
-        case DuplicateMatchMode::QuickHash:
-        case DuplicateMatchMode::SizeAndPartialHash:
-            return CalculatePartialHash(path);
-
-        case DuplicateMatchMode::ExactHash:
-            {
-                // Full file hash using FNV-1a
-                std::ifstream file(path.String(), std::ios::binary);
-                if (!file) return "";
-
-                uint64_t hash = 14695981039346656037ULL;
-                constexpr uint64_t prime = 1099511628211ULL;
-
-                char buffer[8192];
-                while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
-                {
-                    for (std::streamsize i = 0; i < file.gcount(); ++i)
-                    {
-                        hash ^= static_cast<uint8_t>(buffer[i]);
-                        hash *= prime;
-                    }
-                }
-
-                std::ostringstream ss;
-                ss << std::hex << std::setfill('0') << std::setw(16) << hash;
-                return ss.str();
-            }
-        }
-
-        return "";
+        std::string hash;
+        if (hash_cache_)
+            hash_cache_->HashFile(path, hash, &cancel_requested_);
+        else
+            core::FileHasher::HashFile(path, hash, &cancel_requested_);
+        return hash;
     }
 
     std::string DuplicateFinder::CalculatePartialHash(const core::Path& path)
     {
-        constexpr size_t BLOCK_SIZE = 64 * 1024; // 64KB
-
-        std::ifstream file(path.String(), std::ios::binary | std::ios::ate);
-        if (!file) return "";
-
-        auto file_size = file.tellg();
-        file.seekg(0);
-
-        uint64_t hash = 14695981039346656037ULL;
-        constexpr uint64_t prime = 1099511628211ULL;
-
-        char buffer[BLOCK_SIZE];
-
-        // Hash first block
-        file.read(buffer, BLOCK_SIZE);
-        for (std::streamsize i = 0; i < file.gcount(); ++i)
-        {
-            hash ^= static_cast<uint8_t>(buffer[i]);
-            hash *= prime;
-        }
-
-        // Hash last block if file is large enough
-        if (file_size > static_cast<std::streamoff>(BLOCK_SIZE * 2))
-        {
-            file.seekg(-static_cast<std::streamoff>(BLOCK_SIZE), std::ios::end);
-            file.read(buffer, BLOCK_SIZE);
-            for (std::streamsize i = 0; i < file.gcount(); ++i)
-            {
-                hash ^= static_cast<uint8_t>(buffer[i]);
-                hash *= prime;
-            }
-        }
-
-        std::ostringstream ss;
-        ss << std::hex << std::setfill('0') << std::setw(16) << hash;
-        return ss.str();
+        std::string hash;
+        if (hash_cache_)
+            hash_cache_->HashPartial(path, hash);
+        else
+            core::FileHasher::HashPartial(path, hash);
+        return hash;
     }
 
     bool DuplicateFinder::MatchesExtension(const std::string& ext,
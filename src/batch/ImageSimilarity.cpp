@@ -0,0 +1,132 @@
+#include "opacity/batch/ImageSimilarity.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cstdlib>
+
+namespace opacity::batch
+{
+    uint64_t ImageHash::Compute(const uint8_t* rgba, int width, int height)
+    {
+        constexpr int kColumns = 9;
+        constexpr int kRows = 8;
+
+        if (!rgba || width <= 0 || height <= 0)
+            return 0;
+
+        // Each cell averages its share of the image; a picture smaller than
+        // the grid repeats pixels instead
+        uint32_t cells[kRows][kColumns] = {};
+        for (int row = 0; row < kRows; ++row)
+        {
+            int y0 = row * height / kRows;
+            int y1 = std::max(y0 + 1, (row + 1) * height / kRows);
+            for (int column = 0; column < kColumns; ++column)
+            {
+                int x0 = column * width / kColumns;
+                int x1 = std::max(x0 + 1, (column + 1) * width / kColumns);
+
+                uint64_t sum = 0;
+                for (int y = y0; y < y1; ++y)
+                {
+                    const uint8_t* pixel = rgba + (static_cast<size_t>(y) * width + x0) * 4;
+                    for (int x = x0; x < x1; ++x, pixel += 4)
+                    {
+                        sum += pixel[0] * 299u + pixel[1] * 587u + pixel[2] * 114u;
+                    }
+                }
+                cells[row][column] = static_cast<uint32_t>(sum / (static_cast<uint64_t>(y1 - y0) * (x1 - x0)));
+            }
+        }
+
+        uint64_t hash = 0;
+        for (int row = 0; row < kRows; ++row)
+        {
+            for (int column = 0; column + 1 < kColumns; ++column)
+            {
+                hash = (hash << 1) | (cells[row][column] > cells[row][column + 1] ? 1u : 0u);
+            }
+        }
+        return hash;
+    }
+
+    int ImageHash::Distance(uint64_t a, uint64_t b)
+    {
+        return static_cast<int>(std::bitset<64>(a ^ b).count());
+    }
+
+    void HammingIndex::Reserve(size_t count)
+    {
+        nodes_.reserve(count);
+    }
+
+    void HammingIndex::Insert(uint64_t hash, uint32_t id)
+    {
+        if (nodes_.empty())
+        {
+            nodes_.emplace_back().hash = hash;
+            nodes_.back().id = id;
+            return;
+        }
+
+        uint32_t current = 0;
+        while (true)
+        {
+            auto distance = static_cast<uint32_t>(ImageHash::Distance(hash, nodes_[current].hash));
+            if (distance == 0)
+            {
+                extra_ids_.push_back({id, nodes_[current].more_ids});
+                nodes_[current].more_ids = static_cast<uint32_t>(extra_ids_.size() - 1);
+                return;
+            }
+
+            uint32_t child = nodes_[current].first_child;
+            while (child != kNone && nodes_[child].distance != distance)
+            {
+                child = nodes_[child].next_sibling;
+            }
+            if (child == kNone)
+            {
+                Node node;
+                node.hash = hash;
+                node.id = id;
+                node.distance = distance;
+                node.next_sibling = nodes_[current].first_child;
+                nodes_.push_back(node);
+                nodes_[current].first_child = static_cast<uint32_t>(nodes_.size() - 1);
+                return;
+            }
+            current = child;
+        }
+    }
+
+    void HammingIndex::Find(uint64_t hash, int radius, std::vector<uint32_t>& ids) const
+    {
+        if (nodes_.empty())
+            return;
+
+        std::vector<uint32_t> pending{0};
+        while (!pending.empty())
+        {
+            const Node& node = nodes_[pending.back()];
+            pending.pop_back();
+
+            int distance = ImageHash::Distance(hash, node.hash);
+            if (distance <= radius)
+            {
+                ids.push_back(node.id);
+                for (uint32_t extra = node.more_ids; extra != kNone; extra = extra_ids_[extra].next)
+                {
+                    ids.push_back(extra_ids_[extra].id);
+                }
+            }
+
+            for (uint32_t child = node.first_child; child != kNone; child = nodes_[child].next_sibling)
+            {
+                if (std::abs(static_cast<int>(nodes_[child].distance) - distance) <= radius)
+                    pending.push_back(child);
+            }
+        }
+    }
+
+} // namespace opacity::batch
@@ -0,0 +1,761 @@
+#include "opacity/cli/CommandLine.h"
+#include "opacity/archive/ArchiveManager.h"
+#include "opacity/batch/DuplicateFinder.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/HashCache.h"
+#include "opacity/core/Logger.h"
+#include "opacity/diff/FolderComparison.h"
+#include "opacity/filesystem/OperationQueue.h"
+#include "opacity/preview/DocumentText.h"
+#include "opacity/search/SearchIndex.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <sstream>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#endif
+
+namespace opacity::cli
+{
+    namespace
+    {
+        using json = nlohmann::json;
+        namespace fs = std::filesystem;
+
+        constexpr char kVersion[] = OPACITY_VERSION;
+
+        // Progress records are for a person watching; one every so often
+        constexpr auto kProgressInterval = std::chrono::milliseconds(250);
+
+        constexpr char kUsage[] =
+            "Usage: opacity <command> [paths...] [--option=value] [--flag]\n"
+            "\n"
+            "Commands (output is one JSON object per line on stdout):\n"
+            "  search <roots...> --query=TEXT     Query the index of the roots, updating it first\n"
+            "         [--content] [--regex] [--case] [--word] [--ext=a,b] [--max=N]\n"
+            "         [--index=DIR] [--no-update]\n"
+            "  compare <left> <right>             List what differs between two folders\n"
+            "         [--mode=name|size|date|hash|content] [--all] [--timestamps]\n"
+            "         [--sync=left-to-right|right-to-left|both|mirror] [--delta]\n"
+            "  dedupe <folders...>                Find duplicate files\n"
+            "         [--mode=partial|exact|quick|size|name|image] [--min-size=N] [--max-size=N]\n"
+            "         [--ext=a,b]\n"
+            "  extract <archive> --to=DIR         Extract an archive\n"
+            "         [--overwrite] [--skip-existing] [--password=P]\n"
+            "  archive <archive> <sources...>     Create an archive\n"
+            "         [--format=zip|7z|tar|tgz|tbz2] [--level=0-9] [--password=P]\n"
+            "  copy <sources...> --to=DIR         Copy files and folders\n"
+            "         [--conflict=skip|overwrite|older|rename] [--verify]\n"
+            "  help, version\n"
+            "  resident                           Keep one index warm in the tray for every window\n"
+            "\n"
+            "Common flags: --progress (progress records), --hidden (include hidden files),\n"
+            "--exclude=a,b (name patterns), --no-cache (do not use the hash cache), --verbose.\n"
+            "Exit code 0 on success, 1 when compare finds differences, 2 on failure.\n";
+
+        /**
+         * @brief Newline-delimited JSON on stdout, safe to call from any thread
+         */
+        class Output
+        {
+        public:
+            explicit Output(bool progress)
+                : progress_(progress)
+            {
+#ifdef _WIN32
+                // Lines end in \n alone, whatever reads them
+                _setmode(_fileno(stdout), _O_BINARY);
+#endif
+            }
+
+            void Write(const json& record)
+            {
+                // Names that are not valid UTF-8 still come out, with
+                // replacement characters, rather than failing the run
+                std::string line = record.dump(-1, ' ', false, json::error_handler_t::replace);
+                line += '\n';
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                std::fwrite(line.data(), 1, line.size(), stdout);
+                std::fflush(stdout);
+            }
+
+            void Progress(json record)
+            {
+                if (!progress_)
+                    return;
+
+                auto now = std::chrono::steady_clock::now();
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    if (now - last_progress_ < kProgressInterval)
+                        return;
+                    last_progress_ = now;
+                }
+                record["type"] = "progress";
+                Write(record);
+            }
+
+            int Error(const std::string& message, int code = kExitFailure)
+            {
+                Write({{"type", "error"}, {"message", message}});
+                return code;
+            }
+
+        private:
+            bool progress_;
+            std::mutex mutex_;
+            std::chrono::steady_clock::time_point last_progress_;
+        };
+
+        std::string Timestamp(std::chrono::system_clock::time_point time)
+        {
+            std::time_t t = std::chrono::system_clock::to_time_t(time);
+            std::tm tm = {};
+#ifdef _WIN32
+            gmtime_s(&tm, &t);
+#else
+            gmtime_r(&t, &tm);
+#endif
+            char buffer[32];
+            std::strftime(buffer, sizeof(buffer), "%Y-%m-%dT%H:%M:%SZ", &tm);
+            return buffer;
+        }
+
+        std::string Option(const core::CommandLineResult& args, const std::string& key,
+                           const std::string& fallback = std::string())
+        {
+            return args.GetOption(key).value_or(fallback);
+        }
+
+        std::vector<std::string> ListOption(const core::CommandLineResult& args, const std::string& key)
+        {
+            std::vector<std::string> values;
+            std::istringstream in(Option(args, key));
+            std::string value;
+            while (std::getline(in, value, ','))
+            {
+                if (!value.empty())
+                    values.push_back(value);
+            }
+            return values;
+        }
+
+        // A byte count, with an optional K, M or G (binary) suffix
+        std::optional<uint64_t> SizeOption(const core::CommandLineResult& args, const std::string& key)
+        {
+            auto text = args.GetOption(key);
+            if (!text || text->empty())
+                return std::nullopt;
+
+            size_t end = 0;
+            uint64_t value = 0;
+            try
+            {
+                value = std::stoull(*text, &end);
+            }
+            catch (const std::exception&)
+            {
+                return std::nullopt;
+            }
+
+            if (end < text->size())
+            {
+                switch (std::toupper(static_cast<unsigned char>((*text)[end])))
+                {
+                case 'K': value <<= 10; break;
+                case 'M': value <<= 20; break;
+                case 'G': value <<= 30; break;
+                default: return std::nullopt;
+                }
+            }
+            return value;
+        }
+
+        template <typename T>
+        std::optional<T> EnumOption(const core::CommandLineResult& args, const std::string& key,
+                                    const std::map<std::string, T>& names, T fallback)
+        {
+            auto text = args.GetOption(key);
+            if (!text)
+                return fallback;
+            auto it = names.find(*text);
+            if (it == names.end())
+                return std::nullopt;
+            return it->second;
+        }
+
+        int64_t Milliseconds(std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration_cast<std::chrono::milliseconds>(
+                std::chrono::steady_clock::now() - start).count();
+        }
+
+        // Shared with the user interface, so a nightly run reads only what
+        // changed since the last one, and the window finds its hashes too
+        std::shared_ptr<core::HashCache> OpenHashCache(const core::CommandLineResult& args)
+        {
+            if (args.HasFlag("no-cache"))
+                return nullptr;
+
+            auto cache = std::make_shared<core::HashCache>();
+            cache->Open();
+            return cache;
+        }
+
+        // One index per set of roots, next to the hash cache
+        fs::path DefaultIndexPath(std::vector<fs::path> roots)
+        {
+            std::sort(roots.begin(), roots.end());
+            core::Xxh64 hash;
+            for (const auto& root : roots)
+            {
+                std::string text = root.lexically_normal().u8string();
+                hash.Update(text.data(), text.size() + 1);
+            }
+            return core::HashCache::DefaultLocation().Get().parent_path() / "indexes" / hash.HexDigest();
+        }
+
+        int RunSearch(const core::CommandLineResult& args, Output& out)
+        {
+            auto text = args.GetOption("query");
+            if (!text || text->empty())
+                return out.Error("search needs --query=TEXT");
+            if (args.paths.empty())
+                return out.Error("search needs at least one root folder");
+
+            auto start = std::chrono::steady_clock::now();
+
+            search::IndexConfig config;
+            config.roots = args.paths;
+            config.indexPath = args.GetOption("index") ? fs::path(fs::u8path(*args.GetOption("index")))
+                                                       : DefaultIndexPath(args.paths);
+            config.indexContent = args.HasFlag("content");
+            config.indexHiddenFiles = args.HasFlag("hidden");
+            config.excludedDirs = ListOption(args, "exclude");
+            config.maxThreads = 0;
+            // Nobody is at this console for the crawl to make way for
+            config.backgroundPriority = false;
+            config.yieldToForeground = false;
+
+            search::SearchIndex index;
+            index.SetContentExtractor(preview::DocumentTextExtractor::GetSupportedExtensions(),
+                [](const fs::path& path, const std::function<bool(std::string_view)>& sink) {
+                    return preview::DocumentTextExtractor::Extract(core::Path(path), sink);
+                });
+            if (!index.Initialize(config))
+                return out.Error("Cannot open the index at " + config.indexPath.u8string());
+
+            bool loaded = index.LoadIndex();
+            if (!args.HasFlag("no-update") || !loaded)
+            {
+                bool updated = index.UpdateIndex([&out](const std::string& path, double progress) {
+                    out.Progress({{"command", "search"}, {"phase", "indexing"}, {"current", path},
+                                  {"percentage", progress * 100.0}});
+                });
+                if (!updated)
+                {
+                    index.Shutdown();
+                    return out.Error("Indexing failed");
+                }
+            }
+
+            search::SearchQuery query;
+            query.text = *text;
+            query.caseSensitive = args.HasFlag("case");
+            query.wholeWord = args.HasFlag("word");
+            query.useRegex = args.HasFlag("regex");
+            query.searchContent = args.HasFlag("content");
+            query.extensions = ListOption(args, "ext");
+            if (auto max = SizeOption(args, "max"))
+                query.maxResults = static_cast<int>(std::min<uint64_t>(*max, INT32_MAX));
+
+            auto results = index.Search(query);
+            for (const auto& result : results)
+            {
+                json record = {
+                    {"type", "match"},
+                    {"path", result.entry.path.u8string()},
+                    {"directory", result.entry.isDirectory},
+                    {"size", result.entry.size},
+                    {"modified", Timestamp(result.entry.modifiedTime)},
+                    {"score", result.score}
+                };
+                if (!result.matchContext.empty())
+                    record["context"] = result.matchContext;
+                out.Write(record);
+            }
+
+            auto stats = index.GetStatistics();
+            index.Shutdown();
+
+            out.Write({
+                {"type", "summary"},
+                {"command", "search"},
+                {"matches", results.size()},
+                {"indexed_files", stats.totalFiles},
+                {"indexed_directories", stats.totalDirectories},
+                {"index", config.indexPath.u8string()},
+                {"duration_ms", Milliseconds(start)}
+            });
+            return kExitSuccess;
+        }
+
+        const char* StatusName(diff::ComparisonStatus status)
+        {
+            switch (status)
+            {
+            case diff::ComparisonStatus::Identical: return "identical";
+            case diff::ComparisonStatus::LeftOnly: return "left_only";
+            case diff::ComparisonStatus::RightOnly: return "right_only";
+            case diff::ComparisonStatus::Different: return "different";
+            case diff::ComparisonStatus::Error: return "error";
+            }
+            return "unknown";
+        }
+
+        json Side(bool exists, bool directory, uint64_t size, std::chrono::system_clock::time_point modified,
+                  const std::string& hash)
+        {
+            if (!exists)
+                return nullptr;
+
+            json side = {{"directory", directory}, {"size", size}, {"modified", Timestamp(modified)}};
+            if (!hash.empty())
+                side["hash"] = hash;
+            return side;
+        }
+
+        int RunCompare(const core::CommandLineResult& args, Output& out)
+        {
+            if (args.paths.size() != 2)
+                return out.Error("compare needs a left and a right folder");
+
+            auto mode = EnumOption<diff::ComparisonMode>(args, "mode", {
+                {"name", diff::ComparisonMode::Name},
+                {"size", diff::ComparisonMode::Size},
+                {"date", diff::ComparisonMode::Date},
+                {"hash", diff::ComparisonMode::Hash},
+                {"content", diff::ComparisonMode::Content}
+            }, diff::ComparisonMode::Size);
+            if (!mode)
+                return out.Error("Unknown --mode; use name, size, date, hash or content");
+
+            std::optional<diff::SyncDirection> direction;
+            if (args.GetOption("sync"))
+            {
+                direction = EnumOption<diff::SyncDirection>(args, "sync", {
+                    {"left-to-right", diff::SyncDirection::LeftToRight},
+                    {"right-to-left", diff::SyncDirection::RightToLeft},
+                    {"both", diff::SyncDirection::Bidirectional},
+                    {"mirror", diff::SyncDirection::Mirror}
+                }, diff::SyncDirection::LeftToRight);
+                if (!direction)
+                    return out.Error("Unknown --sync; use left-to-right, right-to-left, both or mirror");
+            }
+
+            auto start = std::chrono::steady_clock::now();
+
+            diff::FolderComparisonOptions options;
+            options.mode = *mode;
+            options.include_hidden = args.HasFlag("hidden");
+            options.compare_timestamps = args.HasFlag("timestamps");
+            options.exclude_patterns = ListOption(args, "exclude");
+
+            diff::FolderComparison comparison;
+            comparison.SetHashCache(OpenHashCache(args));
+
+            auto result = comparison.Compare(core::Path(args.paths[0]), core::Path(args.paths[1]), options,
+                [&out](const diff::ComparisonProgress& progress) {
+                    out.Progress({{"command", "compare"}, {"phase", "comparing"}, {"current", progress.current_file},
+                                  {"done", progress.files_processed}, {"total", progress.total_files},
+                                  {"percentage", progress.percentage}});
+                });
+            if (!result.success)
+                return out.Error(result.error_message.empty() ? "Comparison failed" : result.error_message);
+
+            bool all = args.HasFlag("all");
+            for (const auto& item : result.items)
+            {
+                if (item.status == diff::ComparisonStatus::Identical && !all)
+                    continue;
+
+                json record = {
+                    {"type", "item"},
+                    {"path", item.relative_path},
+                    {"status", StatusName(item.status)},
+                    {"left", Side(item.left_exists, item.left_is_directory, item.left_size, item.left_modified,
+                                  item.left_hash)},
+                    {"right", Side(item.right_exists, item.right_is_directory, item.right_size, item.right_modified,
+                                   item.right_hash)}
+                };
+                if (item.placeholder)
+                    record["placeholder"] = true;
+                if (!item.error_message.empty())
+                    record["error"] = item.error_message;
+                out.Write(record);
+            }
+
+            const auto& stats = result.stats;
+            json summary = {
+                {"type", "summary"},
+                {"command", "compare"},
+                {"identical", result.AreIdentical()},
+                {"items", stats.total_items},
+                {"identical_files", stats.identical_files},
+                {"different_files", stats.different_files},
+                {"left_only_files", stats.left_only_files},
+                {"right_only_files", stats.right_only_files},
+                {"left_only_dirs", stats.left_only_dirs},
+                {"right_only_dirs", stats.right_only_dirs},
+                {"errors", stats.errors},
+                {"placeholders_skipped", stats.placeholders_skipped},
+                {"different_bytes", stats.different_size}
+            };
+
+            int code = result.AreIdentical() ? kExitSuccess : kExitDifferences;
+            if (direction && !result.AreIdentical())
+            {
+                diff::SyncOptions sync_options;
+                sync_options.delta = args.HasFlag("delta");
+                auto sync = comparison.SyncFolders(result, *direction, nullptr, sync_options,
+                    [&out](const diff::ComparisonProgress& progress) {
+                        out.Progress({{"command", "compare"}, {"phase", "syncing"}, {"current", progress.current_file},
+                                      {"done", progress.files_processed}, {"total", progress.total_files},
+                                      {"percentage", progress.percentage}});
+                    });
+
+                for (const auto& message : sync.error_messages)
+                {
+                    out.Write({{"type", "failed"}, {"error", message}});
+                }
+                summary["sync"] = {
+                    {"copied", sync.files_copied},
+                    {"updated", sync.files_updated},
+                    {"deleted", sync.files_deleted},
+                    {"bytes_unchanged", sync.bytes_unchanged},
+                    {"errors", sync.errors}
+                };
+                code = sync.success && sync.errors == 0 ? kExitSuccess : kExitFailure;
+            }
+
+            summary["duration_ms"] = Milliseconds(start);
+            out.Write(summary);
+            return code;
+        }
+
+        int RunDedupe(const core::CommandLineResult& args, Output& out)
+        {
+            if (args.paths.empty())
+                return out.Error("dedupe needs at least one folder");
+
+            auto mode = EnumOption<batch::DuplicateMatchMode>(args, "mode", {
+                {"partial", batch::DuplicateMatchMode::SizeAndPartialHash},
+                {"exact", batch::DuplicateMatchMode::ExactHash},
+                {"quick", batch::DuplicateMatchMode::QuickHash},
+                {"size", batch::DuplicateMatchMode::SizeOnly},
+                {"name", batch::DuplicateMatchMode::SizeAndName},
+                {"image", batch::DuplicateMatchMode::PerceptualImage}
+            }, batch::DuplicateMatchMode::SizeAndPartialHash);
+            if (!mode)
+                return out.Error("Unknown --mode; use partial, exact, quick, size, name or image");
+
+            batch::DuplicateSearchOptions options;
+            options.mode = *mode;
+            options.include_hidden = args.HasFlag("hidden");
+            options.min_size = SizeOption(args, "min-size").value_or(0);
+            options.max_size = SizeOption(args, "max-size").value_or(0);
+            options.include_extensions = ListOption(args, "ext");
+            options.exclude_patterns = ListOption(args, "exclude");
+
+            std::vector<core::Path> roots;
+            for (const auto& path : args.paths)
+            {
+                roots.emplace_back(path);
+            }
+
+            batch::DuplicateFinder finder;
+            finder.SetHashCache(OpenHashCache(args));
+            auto result = finder.FindDuplicates(roots, options, [&out](const batch::DuplicateProgress& progress) {
+                out.Progress({{"command", "dedupe"}, {"phase", progress.current_phase},
+                              {"current", progress.current_file}, {"done", progress.files_scanned},
+                              {"total", progress.total_files}, {"percentage", progress.percentage}});
+            });
+            if (!result.success)
+                return out.Error(result.error_message.empty() ? "Duplicate search failed" : result.error_message);
+
+            for (const auto* group : result.GetByWastedSpace())
+            {
+                json files = json::array();
+                for (size_t i = 0; i < group->files.size(); ++i)
+                {
+                    files.push_back({{"path", group->files[i].String()}, {"linked", group->IsLinked(i)}});
+                }
+                out.Write({
+                    {"type", "group"},
+                    {"hash", group->hash},
+                    {"size", group->file_size},
+                    {"wasted", group->GetWastedSpace()},
+                    {"files", std::move(files)}
+                });
+            }
+
+            out.Write({
+                {"type", "summary"},
+                {"command", "dedupe"},
+                {"groups", result.groups.size()},
+                {"duplicates", result.total_duplicates},
+                {"wasted_bytes", result.total_wasted_space},
+                {"files_scanned", result.total_files_scanned},
+                {"placeholders_skipped", result.placeholders_skipped},
+                {"duration_ms", result.duration.count()}
+            });
+            return kExitSuccess;
+        }
+
+        void WriteArchiveProgress(Output& out, const char* command, const archive::ArchiveProgress& progress)
+        {
+            out.Progress({{"command", command}, {"current", progress.current_file},
+                          {"done", progress.files_processed}, {"total", progress.total_files},
+                          {"bytes", progress.bytes_processed}, {"percentage", progress.percentage}});
+        }
+
+        int FinishArchive(Output& out, const char* command, const archive::ArchiveResult& result,
+                          std::chrono::steady_clock::time_point start)
+        {
+            for (const auto& file : result.failed_files)
+            {
+                out.Write({{"type", "failed"}, {"path", file}});
+            }
+            if (!result.success)
+                return out.Error(result.error_message.empty() ? std::string(command) + " failed" : result.error_message);
+
+            out.Write({
+                {"type", "summary"},
+                {"command", command},
+                {"files", result.files_processed},
+                {"bytes", result.bytes_processed},
+                {"failed", result.failed_files.size()},
+                {"duration_ms", Milliseconds(start)}
+            });
+            return result.failed_files.empty() ? kExitSuccess : kExitFailure;
+        }
+
+        int RunExtract(const core::CommandLineResult& args, Output& out)
+        {
+            auto to = args.GetOption("to");
+            if (args.paths.size() != 1 || !to)
+                return out.Error("extract needs one archive and --to=DIR");
+
+            auto start = std::chrono::steady_clock::now();
+
+            archive::ExtractOptions options;
+            options.destination = core::Path(fs::absolute(fs::u8path(*to)));
+            options.overwrite_existing = args.HasFlag("overwrite");
+            options.skip_existing = args.HasFlag("skip-existing");
+            options.password = Option(args, "password");
+
+            archive::ArchiveManager archives;
+            auto result = archives.Extract(core::Path(args.paths[0]), options, [&out](const archive::ArchiveProgress& progress) {
+                WriteArchiveProgress(out, "extract", progress);
+            });
+            return FinishArchive(out, "extract", result, start);
+        }
+
+        int RunArchive(const core::CommandLineResult& args, Output& out)
+        {
+            if (args.paths.size() < 2)
+                return out.Error("archive needs the archive to write and at least one source");
+
+            core::Path target(args.paths[0]);
+            archive::ArchiveFormat detected = archive::ArchiveManager::GetFormat(target);
+            auto format = EnumOption<archive::ArchiveFormat>(args, "format", {
+                {"zip", archive::ArchiveFormat::Zip},
+                {"7z", archive::ArchiveFormat::SevenZip},
+                {"tar", archive::ArchiveFormat::Tar},
+                {"tgz", archive::ArchiveFormat::TarGz},
+                {"tbz2", archive::ArchiveFormat::TarBz2}
+            }, detected == archive::ArchiveFormat::Unknown ? archive::ArchiveFormat::Zip : detected);
+            if (!format)
+                return out.Error("Unknown --format; use zip, 7z, tar, tgz or tbz2");
+
+            auto start = std::chrono::steady_clock::now();
+
+            archive::CreateOptions options;
+            options.format = *format;
+            if (auto level = SizeOption(args, "level"))
+                options.level = static_cast<archive::CompressionLevel>(std::min<uint64_t>(*level, 9));
+            options.include_root_folder = true;
+            options.password = Option(args, "password");
+            options.exclude_patterns = ListOption(args, "exclude");
+
+            std::vector<core::Path> sources;
+            for (size_t i = 1; i < args.paths.size(); ++i)
+            {
+                sources.emplace_back(args.paths[i]);
+            }
+
+            archive::ArchiveManager archives;
+            auto result = archives.Create(target, sources, options, [&out](const archive::ArchiveProgress& progress) {
+                WriteArchiveProgress(out, "archive", progress);
+            });
+            return FinishArchive(out, "archive", result, start);
+        }
+
+        int RunCopy(const core::CommandLineResult& args, Output& out)
+        {
+            auto to = args.GetOption("to");
+            if (args.paths.empty() || !to)
+                return out.Error("copy needs at least one source and --to=DIR");
+
+            // Nobody is there to ask, so conflicts are skipped unless told otherwise
+            auto resolution = EnumOption<filesystem::ConflictResolution>(args, "conflict", {
+                {"skip", filesystem::ConflictResolution::Skip},
+                {"overwrite", filesystem::ConflictResolution::Overwrite},
+                {"older", filesystem::ConflictResolution::OverwriteOlder},
+                {"rename", filesystem::ConflictResolution::Rename}
+            }, filesystem::ConflictResolution::Skip);
+            if (!resolution)
+                return out.Error("Unknown --conflict; use skip, overwrite, older or rename");
+
+            auto start = std::chrono::steady_clock::now();
+
+            auto operation = std::make_unique<filesystem::BatchOperation>(filesystem::OperationType::Copy);
+            operation->SetDestination(core::Path(fs::absolute(fs::u8path(*to))));
+            operation->SetConflictResolution(*resolution);
+            operation->SetChecksums(args.HasFlag("verify"));
+
+            for (const auto& source : args.paths)
+            {
+                std::error_code ec;
+                filesystem::OperationItem item;
+                item.source = core::Path(source);
+                item.is_directory = fs::is_directory(source, ec);
+                if (!item.is_directory)
+                {
+                    item.size = fs::file_size(source, ec);
+                    if (ec)
+                        return out.Error("Cannot read " + source.u8string() + ": " + ec.message());
+                }
+                operation->AddItem(item);
+            }
+
+            std::mutex completion_mutex;
+            bool succeeded = false;
+            std::string error;
+            operation->SetProgressCallback([&out](const filesystem::OperationProgress& progress) {
+                out.Progress({{"command", "copy"}, {"current", progress.current_item},
+                              {"done", progress.completed_items}, {"total", progress.total_items},
+                              {"bytes", progress.completed_bytes}, {"total_bytes", progress.total_bytes},
+                              {"bytes_per_second", progress.speed_bytes_per_sec},
+                              {"percentage", progress.percentage}});
+            });
+            operation->SetCompletionCallback([&](bool success, const std::string& message) {
+                std::lock_guard<std::mutex> lock(completion_mutex);
+                succeeded = success;
+                error = message;
+            });
+
+            // Through the queue, so the copy is scheduled by the same
+            // per-device limits as in the window
+            filesystem::OperationQueue queue;
+            filesystem::BatchOperation* copy = operation.get();
+            queue.AddOperation(std::move(operation));
+            queue.ProcessQueue();
+            copy->WaitForCompletion();
+
+            for (const auto& [path, message] : copy->GetFailedItems())
+            {
+                out.Write({{"type", "failed"}, {"path", path}, {"error", message}});
+            }
+            if (copy->GetChecksums())
+            {
+                for (const auto& [path, hash] : copy->GetFileHashes())
+                {
+                    out.Write({{"type", "file"}, {"path", path}, {"hash", hash}});
+                }
+            }
+
+            std::lock_guard<std::mutex> lock(completion_mutex);
+            if (!succeeded)
+                return out.Error(error.empty() ? "Copy failed" : error);
+
+            auto progress = copy->GetProgress();
+            out.Write({
+                {"type", "summary"},
+                {"command", "copy"},
+                {"items", progress.completed_items},
+                {"bytes", progress.completed_bytes},
+                {"failed", copy->GetFailedItems().size()},
+                {"duration_ms", Milliseconds(start)}
+            });
+            return kExitSuccess;
+        }
+
+        using CommandHandler = int (*)(const core::CommandLineResult&, Output&);
+
+        const std::map<std::string, CommandHandler>& Handlers()
+        {
+            static const std::map<std::string, CommandHandler> handlers = {
+                {"search", RunSearch},
+                {"compare", RunCompare},
+                {"dedupe", RunDedupe},
+                {"extract", RunExtract},
+                {"archive", RunArchive},
+                {"copy", RunCopy}
+            };
+            return handlers;
+        }
+    }
+
+    bool IsHeadlessCommand(const core::CommandLineResult& args)
+    {
+        return args.command == "help" || args.command == "version" || Handlers().count(args.command) > 0;
+    }
+
+    int Run(const core::CommandLineResult& args)
+    {
+        if (args.command == "help" || args.HasFlag("help"))
+        {
+            std::fputs(kUsage, stdout);
+            return kExitSuccess;
+        }
+
+        Output out(args.HasFlag("progress"));
+        if (args.command == "version")
+        {
+            out.Write({{"type", "version"}, {"version", kVersion}});
+            return kExitSuccess;
+        }
+
+        core::Logger::Initialize(args.HasFlag("verbose") ? "info" : "warn");
+
+        int code = kExitFailure;
+        try
+        {
+            code = Handlers().at(args.command)(args, out);
+        }
+        catch (const std::exception& ex)
+        {
+            SPDLOG_ERROR("{} failed: {}", args.command, ex.what());
+            code = out.Error(ex.what());
+        }
+
+        core::Logger::Shutdown();
+        return code;
+    }
+
+} // namespace opacity::cli
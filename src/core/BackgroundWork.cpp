@@ -0,0 +1,116 @@
+#include "opacity/core/BackgroundWork.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#endif
+
+namespace opacity::core
+{
+    namespace
+    {
+        // Slept at a time while paused, so a cancel is seen promptly
+        constexpr std::chrono::milliseconds kYieldSlice{50};
+
+        thread_local int background_depth = 0;     // Low-priority scopes open on this thread
+
+        int64_t Ticks()
+        {
+            return std::chrono::steady_clock::now().time_since_epoch().count();
+        }
+    }
+
+    std::atomic<int> ForegroundActivity::operations_{0};
+    std::atomic<int64_t> ForegroundActivity::last_input_{0};
+
+    void ForegroundActivity::NoteInput()
+    {
+        last_input_.store(Ticks(), std::memory_order_relaxed);
+    }
+
+    void ForegroundActivity::BeginOperation()
+    {
+        operations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void ForegroundActivity::EndOperation()
+    {
+        operations_.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    bool ForegroundActivity::IsActive(std::chrono::milliseconds input_grace)
+    {
+        if (operations_.load(std::memory_order_relaxed) > 0)
+            return true;
+
+        int64_t last = last_input_.load(std::memory_order_relaxed);
+        if (last == 0)
+            return false;
+        auto since = std::chrono::steady_clock::duration(Ticks() - last);
+        return since < input_grace;
+    }
+
+    BackgroundScope::BackgroundScope(const BackgroundPolicy& policy)
+        : policy_(policy)
+    {
+        if (!policy_.low_priority)
+            return;
+
+        entered_ = true;
+        if (background_depth++ == 0)
+        {
+#ifdef _WIN32
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN);
+#endif
+        }
+    }
+
+    BackgroundScope::~BackgroundScope()
+    {
+        if (!entered_)
+            return;
+
+        if (--background_depth == 0)
+        {
+#ifdef _WIN32
+            SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_END);
+#endif
+        }
+    }
+
+    void BackgroundScope::Yield(const std::atomic<bool>* cancel) const
+    {
+        if (!policy_.yield_to_foreground)
+            return;
+
+        auto deadline = std::chrono::steady_clock::now() + policy_.max_pause;
+        while (ForegroundActivity::IsActive(policy_.input_grace))
+        {
+            if ((cancel && cancel->load(std::memory_order_relaxed)) ||
+                std::chrono::steady_clock::now() >= deadline)
+            {
+                return;
+            }
+            std::this_thread::sleep_for(kYieldSlice);
+        }
+    }
+
+    void BackgroundScope::HintFileHandle(void* handle)
+    {
+        if (background_depth == 0)
+            return;
+
+#ifdef _WIN32
+        // The thread's mode covers reads it issues; the hint stays with
+        // the handle, for the paging reads behind a mapped view too
+        FILE_IO_PRIORITY_HINT_INFO hint = {};
+        hint.PriorityHint = IoPriorityHintVeryLow;
+        SetFileInformationByHandle(static_cast<HANDLE>(handle), FileIoPriorityHintInfo, &hint, sizeof(hint));
+#else
+        (void)handle;
+#endif
+    }
+
+} // namespace opacity::core
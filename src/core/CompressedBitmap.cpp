@@ -0,0 +1,359 @@
+#include "opacity/core/CompressedBitmap.h"
+
+#include <algorithm>
+#include <iterator>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace opacity::core
+{
+    namespace
+    {
+        constexpr size_t kBitsetWords = 65536 / 64;
+
+        inline size_t PopCount(uint64_t bits)
+        {
+#ifdef _MSC_VER
+            return static_cast<size_t>(__popcnt64(bits));
+#else
+            return static_cast<size_t>(__builtin_popcountll(bits));
+#endif
+        }
+
+        inline bool TestBit(const std::vector<uint64_t>& bits, uint16_t low)
+        {
+            return (bits[low >> 6] >> (low & 63)) & 1;
+        }
+    }
+
+    size_t CompressedBitmap::CountTrailingZeros(uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return static_cast<size_t>(index);
+#else
+        return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+    }
+
+    CompressedBitmap::Container* CompressedBitmap::Find(uint16_t key)
+    {
+        auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+            [](const Container& container, uint16_t value) { return container.key < value; });
+        return it != containers_.end() && it->key == key ? &*it : nullptr;
+    }
+
+    const CompressedBitmap::Container* CompressedBitmap::Find(uint16_t key) const
+    {
+        return const_cast<CompressedBitmap*>(this)->Find(key);
+    }
+
+    bool CompressedBitmap::Add(uint32_t value)
+    {
+        auto key = static_cast<uint16_t>(value >> 16);
+        auto low = static_cast<uint16_t>(value);
+
+        auto it = std::lower_bound(containers_.begin(), containers_.end(), key,
+            [](const Container& container, uint16_t k) { return container.key < k; });
+        if (it == containers_.end() || it->key != key)
+        {
+            Container container;
+            container.key = key;
+            container.count = 1;
+            container.array.push_back(low);
+            containers_.insert(it, std::move(container));
+            return true;
+        }
+
+        Container& container = *it;
+        if (!container.bits.empty())
+        {
+            uint64_t mask = uint64_t{1} << (low & 63);
+            uint64_t& word = container.bits[low >> 6];
+            if (word & mask)
+                return false;
+            word |= mask;
+        }
+        else
+        {
+            auto pos = std::lower_bound(container.array.begin(), container.array.end(), low);
+            if (pos != container.array.end() && *pos == low)
+                return false;
+            container.array.insert(pos, low);
+        }
+        ++container.count;
+        Normalize(container);
+        return true;
+    }
+
+    bool CompressedBitmap::Remove(uint32_t value)
+    {
+        auto key = static_cast<uint16_t>(value >> 16);
+        auto low = static_cast<uint16_t>(value);
+        Container* container = Find(key);
+        if (!container)
+            return false;
+
+        if (!container->bits.empty())
+        {
+            uint64_t mask = uint64_t{1} << (low & 63);
+            uint64_t& word = container->bits[low >> 6];
+            if (!(word & mask))
+                return false;
+            word &= ~mask;
+        }
+        else
+        {
+            auto pos = std::lower_bound(container->array.begin(), container->array.end(), low);
+            if (pos == container->array.end() || *pos != low)
+                return false;
+            container->array.erase(pos);
+        }
+
+        if (--container->count == 0)
+            containers_.erase(containers_.begin() + (container - containers_.data()));
+        else
+            Normalize(*container);
+        return true;
+    }
+
+    bool CompressedBitmap::Contains(uint32_t value) const
+    {
+        const Container* container = Find(static_cast<uint16_t>(value >> 16));
+        if (!container)
+            return false;
+
+        auto low = static_cast<uint16_t>(value);
+        if (!container->bits.empty())
+            return TestBit(container->bits, low);
+        return std::binary_search(container->array.begin(), container->array.end(), low);
+    }
+
+    size_t CompressedBitmap::Count() const
+    {
+        size_t count = 0;
+        for (const auto& container : containers_)
+            count += container.count;
+        return count;
+    }
+
+    void CompressedBitmap::ToBitset(Container& container)
+    {
+        if (!container.bits.empty())
+            return;
+        container.bits.assign(kBitsetWords, 0);
+        for (uint16_t low : container.array)
+            container.bits[low >> 6] |= uint64_t{1} << (low & 63);
+        container.array.clear();
+        container.array.shrink_to_fit();
+    }
+
+    void CompressedBitmap::Normalize(Container& container)
+    {
+        // A bitset only drops back to an array well below the limit, so a
+        // count around it does not flip the form on every change
+        if (container.bits.empty())
+        {
+            if (container.array.size() > kArrayLimit)
+                ToBitset(container);
+            return;
+        }
+        if (container.count > kArrayLimit / 2)
+            return;
+
+        std::vector<uint16_t> array;
+        array.reserve(container.count);
+        for (size_t w = 0; w < kBitsetWords; ++w)
+        {
+            uint64_t bits = container.bits[w];
+            while (bits)
+            {
+                array.push_back(static_cast<uint16_t>(w * 64 + CountTrailingZeros(bits)));
+                bits &= bits - 1;
+            }
+        }
+        container.array = std::move(array);
+        container.bits.clear();
+        container.bits.shrink_to_fit();
+    }
+
+    CompressedBitmap::Container CompressedBitmap::And(const Container& a, const Container& b)
+    {
+        Container result;
+        result.key = a.key;
+        if (!a.bits.empty() && !b.bits.empty())
+        {
+            result.bits.resize(kBitsetWords);
+            for (size_t w = 0; w < kBitsetWords; ++w)
+            {
+                result.bits[w] = a.bits[w] & b.bits[w];
+                result.count += static_cast<uint32_t>(PopCount(result.bits[w]));
+            }
+        }
+        else if (a.bits.empty() && b.bits.empty())
+        {
+            std::set_intersection(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                  std::back_inserter(result.array));
+            result.count = static_cast<uint32_t>(result.array.size());
+        }
+        else
+        {
+            const Container& array = a.bits.empty() ? a : b;
+            const Container& bitset = a.bits.empty() ? b : a;
+            for (uint16_t low : array.array)
+            {
+                if (TestBit(bitset.bits, low))
+                    result.array.push_back(low);
+            }
+            result.count = static_cast<uint32_t>(result.array.size());
+        }
+        if (result.count > 0)
+            Normalize(result);
+        return result;
+    }
+
+    CompressedBitmap::Container CompressedBitmap::Or(const Container& a, const Container& b)
+    {
+        Container result;
+        result.key = a.key;
+        if (a.bits.empty() && b.bits.empty() && a.count + b.count <= kArrayLimit)
+        {
+            std::set_union(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                           std::back_inserter(result.array));
+            result.count = static_cast<uint32_t>(result.array.size());
+            return result;
+        }
+
+        result.array = a.array;
+        result.bits = a.bits;
+        ToBitset(result);
+        if (!b.bits.empty())
+        {
+            for (size_t w = 0; w < kBitsetWords; ++w)
+                result.bits[w] |= b.bits[w];
+        }
+        else
+        {
+            for (uint16_t low : b.array)
+                result.bits[low >> 6] |= uint64_t{1} << (low & 63);
+        }
+        for (uint64_t word : result.bits)
+            result.count += static_cast<uint32_t>(PopCount(word));
+        Normalize(result);
+        return result;
+    }
+
+    CompressedBitmap::Container CompressedBitmap::AndNot(const Container& a, const Container& b)
+    {
+        Container result;
+        result.key = a.key;
+        if (a.bits.empty())
+        {
+            if (b.bits.empty())
+            {
+                std::set_difference(a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                    std::back_inserter(result.array));
+            }
+            else
+            {
+                for (uint16_t low : a.array)
+                {
+                    if (!TestBit(b.bits, low))
+                        result.array.push_back(low);
+                }
+            }
+            result.count = static_cast<uint32_t>(result.array.size());
+            return result;
+        }
+
+        result.bits = a.bits;
+        if (!b.bits.empty())
+        {
+            for (size_t w = 0; w < kBitsetWords; ++w)
+                result.bits[w] &= ~b.bits[w];
+        }
+        else
+        {
+            for (uint16_t low : b.array)
+                result.bits[low >> 6] &= ~(uint64_t{1} << (low & 63));
+        }
+        for (uint64_t word : result.bits)
+            result.count += static_cast<uint32_t>(PopCount(word));
+        if (result.count > 0)
+            Normalize(result);
+        return result;
+    }
+
+    CompressedBitmap& CompressedBitmap::operator&=(const CompressedBitmap& other)
+    {
+        std::vector<Container> result;
+        auto a = containers_.begin();
+        auto b = other.containers_.begin();
+        while (a != containers_.end() && b != other.containers_.end())
+        {
+            if (a->key < b->key)
+                ++a;
+            else if (b->key < a->key)
+                ++b;
+            else
+            {
+                Container both = And(*a, *b);
+                if (both.count > 0)
+                    result.push_back(std::move(both));
+                ++a;
+                ++b;
+            }
+        }
+        containers_ = std::move(result);
+        return *this;
+    }
+
+    CompressedBitmap& CompressedBitmap::operator|=(const CompressedBitmap& other)
+    {
+        std::vector<Container> result;
+        result.reserve(containers_.size() + other.containers_.size());
+        auto a = containers_.begin();
+        auto b = other.containers_.begin();
+        while (a != containers_.end() || b != other.containers_.end())
+        {
+            if (b == other.containers_.end() || (a != containers_.end() && a->key < b->key))
+                result.push_back(std::move(*a++));
+            else if (a == containers_.end() || b->key < a->key)
+                result.push_back(*b++);
+            else
+            {
+                result.push_back(Or(*a, *b));
+                ++a;
+                ++b;
+            }
+        }
+        containers_ = std::move(result);
+        return *this;
+    }
+
+    CompressedBitmap& CompressedBitmap::AndNot(const CompressedBitmap& other)
+    {
+        std::vector<Container> result;
+        result.reserve(containers_.size());
+        auto b = other.containers_.begin();
+        for (auto& container : containers_)
+        {
+            while (b != other.containers_.end() && b->key < container.key)
+                ++b;
+            if (b == other.containers_.end() || b->key != container.key)
+            {
+                result.push_back(std::move(container));
+                continue;
+            }
+            Container rest = AndNot(container, *b);
+            if (rest.count > 0)
+                result.push_back(std::move(rest));
+        }
+        containers_ = std::move(result);
+        return *this;
+    }
+
+} // namespace opacity::core
@@ -2,10 +2,25 @@
 #include "opacity/core/Logger.h"
 #include <windows.h>
 #include <shlobj.h>
+#include <algorithm>
+#include <filesystem>
 #include <fstream>
 
 namespace opacity::core
 {
+    namespace
+    {
+        // Whether one key is the other or lies under it, so a change to
+        // one is a change to the other
+        bool Overlaps(const std::string& a, const std::string& b)
+        {
+            const std::string& shorter = a.size() < b.size() ? a : b;
+            const std::string& longer = a.size() < b.size() ? b : a;
+            return longer.compare(0, shorter.size(), shorter) == 0 &&
+                   (longer.size() == shorter.size() || longer[shorter.size()] == '.');
+        }
+    }
+
     std::shared_ptr<Config> Config::instance_ = nullptr;
 
     Config::Config()
@@ -46,33 +61,46 @@ namespace opacity::core
 
     void Config::Load()
     {
+        json loaded = json::object();
         try
         {
             if (std::filesystem::exists(config_file_))
             {
                 std::ifstream config_stream(config_file_);
-                config_stream >> data_;
+                config_stream >> loaded;
                 SPDLOG_INFO("Configuration loaded from: {}", config_file_);
             }
             else
             {
                 SPDLOG_INFO("No existing configuration file, using defaults");
-                data_ = json::object();
             }
         }
         catch (const std::exception& ex)
         {
             SPDLOG_ERROR("Failed to load configuration: {}", ex.what());
-            data_ = json::object();
+            loaded = json::object();
         }
+
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            data_ = std::move(loaded);
+            for (const auto& slot : slots_)
+                slot->Publish(Find(slot->Key()));
+        }
+        Notify(std::string());
     }
 
     void Config::Save()
     {
         try
         {
+            std::string text;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                text = data_.dump(2);
+            }
             std::ofstream config_stream(config_file_);
-            config_stream << data_.dump(2);
+            config_stream << text;
             SPDLOG_INFO("Configuration saved to: {}", config_file_);
         }
         catch (const std::exception& ex)
@@ -81,4 +109,90 @@ namespace opacity::core
         }
     }
 
+    const json* Config::Find(const std::string& key) const
+    {
+        const json* current = &data_;
+        size_t begin = 0;
+        while (true)
+        {
+            size_t end = key.find('.', begin);
+            if (!current->is_object())
+                return nullptr;
+
+            auto it = current->find(key.substr(begin, end == std::string::npos ? std::string::npos : end - begin));
+            if (it == current->end())
+                return nullptr;
+            current = &*it;
+
+            if (end == std::string::npos)
+                return current;
+            begin = end + 1;
+        }
+    }
+
+    void Config::SetValue(const std::string& key, json value)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+
+            // Intermediate objects are created as needed; siblings are kept
+            json* current = &data_;
+            size_t begin = 0;
+            size_t end;
+            while ((end = key.find('.', begin)) != std::string::npos)
+            {
+                if (!current->is_object())
+                    *current = json::object();
+                current = &(*current)[key.substr(begin, end - begin)];
+                begin = end + 1;
+            }
+            if (!current->is_object())
+                *current = json::object();
+            (*current)[key.substr(begin)] = std::move(value);
+
+            for (const auto& slot : slots_)
+            {
+                if (Overlaps(slot->Key(), key))
+                    slot->Publish(Find(slot->Key()));
+            }
+        }
+        Notify(key);
+    }
+
+    void Config::AddSlot(std::unique_ptr<ConfigSlot> slot)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot->Publish(Find(slot->Key()));
+        slots_.push_back(std::move(slot));
+    }
+
+    size_t Config::AddListener(ChangeListener listener)
+    {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        size_t id = next_listener_id_++;
+        listeners_.emplace_back(id, std::move(listener));
+        return id;
+    }
+
+    void Config::RemoveListener(size_t id)
+    {
+        std::lock_guard<std::mutex> lock(listeners_mutex_);
+        listeners_.erase(std::remove_if(listeners_.begin(), listeners_.end(),
+            [id](const auto& entry) { return entry.first == id; }), listeners_.end());
+    }
+
+    void Config::Notify(const std::string& key)
+    {
+        // Called without the lock, so a listener may read or set the config
+        std::vector<ChangeListener> listeners;
+        {
+            std::lock_guard<std::mutex> lock(listeners_mutex_);
+            listeners.reserve(listeners_.size());
+            for (const auto& entry : listeners_)
+                listeners.push_back(entry.second);
+        }
+        for (const auto& listener : listeners)
+            listener(key);
+    }
+
 } // namespace opacity::core
@@ -1,8 +1,10 @@
 #include "opacity/core/CrashRecovery.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/SnapshotFile.h"
 
 #include <atomic>
 #include <chrono>
+#include <condition_variable>
 #include <fstream>
 #include <iomanip>
 #include <mutex>
@@ -66,9 +68,20 @@ namespace opacity::core
         std::thread autoSaveThread_;
         std::atomic<bool> autoSaveRunning_{false};
         std::atomic<bool> initialized_{false};
+        std::mutex wakeMutex_;
+        std::condition_variable wake_;
         
         mutable std::mutex mutex_;
 
+        // Latest state from PublishSessionState, until auto-save takes it
+        std::mutex publishMutex_;
+        std::shared_ptr<const SessionState> published_;
+        bool everPublished_ = false;
+
+        // Guards the session state file
+        std::mutex stateMutex_;
+        SnapshotFile stateFile_;
+
 #ifdef _WIN32
         static LONG WINAPI UnhandledExceptionHandler(EXCEPTION_POINTERS* exceptionInfo);
         static CrashRecovery::Impl* instance_;
@@ -77,30 +90,48 @@ namespace opacity::core
         void AutoSaveLoop()
         {
             while (autoSaveRunning_) {
-                std::this_thread::sleep_for(
-                    std::chrono::seconds(config_.autoSaveIntervalSeconds));
-                
-                if (autoSaveRunning_ && saveCallback_) {
-                    try {
-                        SessionState state = saveCallback_();
-                        state.sessionId = sessionId_;
-                        state.timestamp = std::chrono::system_clock::now();
-                        SaveState(state);
-                    }
-                    catch (const std::exception& e) {
-                        Logger::Get()->error("CrashRecovery: Auto-save failed: {}", e.what());
-                    }
+                {
+                    std::unique_lock<std::mutex> lock(wakeMutex_);
+                    wake_.wait_for(lock, std::chrono::seconds(config_.autoSaveIntervalSeconds),
+                                   [this] { return !autoSaveRunning_; });
+                }
+                if (!autoSaveRunning_) break;
+
+                try {
+                    SaveLatest();
+                }
+                catch (const std::exception& e) {
+                    Logger::Get()->error("CrashRecovery: Auto-save failed: {}", e.what());
                 }
             }
         }
 
+        // Writes the published state, or asks the callback if nothing ever was
+        void SaveLatest()
+        {
+            std::shared_ptr<const SessionState> published;
+            bool everPublished;
+            {
+                std::lock_guard<std::mutex> lock(publishMutex_);
+                published = std::move(published_);
+                published_.reset();
+                everPublished = everPublished_;
+            }
+
+            if (published) {
+                SaveState(*published);
+            }
+            else if (!everPublished && saveCallback_) {
+                SaveState(saveCallback_());
+            }
+        }
+
+        // Skips the write when nothing but the time has changed since the last one
         void SaveState(const SessionState& state)
         {
             try {
                 json j;
-                j["sessionId"] = state.sessionId;
-                j["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
-                    state.timestamp.time_since_epoch()).count();
+                j["sessionId"] = sessionId_;
                 
                 j["window"]["x"] = state.windowX;
                 j["window"]["y"] = state.windowY;
@@ -132,14 +163,23 @@ namespace opacity::core
                     j["custom"] = json::parse(state.customJson);
                 }
 
-                auto statePath = config_.recoveryPath / "session_state.json";
-                std::ofstream file(statePath);
-                file << j.dump(2);
+                std::lock_guard<std::mutex> lock(stateMutex_);
+                stateFile_.SetPath(config_.recoveryPath / "session_state.json");
+                std::string body = j.dump();
+                if (stateFile_.Unchanged(body)) {
+                    return;
+                }
+
+                j["timestamp"] = std::chrono::duration_cast<std::chrono::milliseconds>(
+                    std::chrono::system_clock::now().time_since_epoch()).count();
+                if (!stateFile_.Write(body, j.dump())) {
+                    return;
+                }
 
                 // Also save lock file to indicate active session
                 auto lockPath = config_.recoveryPath / "session.lock";
-                std::ofstream lock(lockPath);
-                lock << sessionId_;
+                std::ofstream lockFile(lockPath);
+                lockFile << sessionId_;
             }
             catch (const std::exception& e) {
                 Logger::Get()->error("CrashRecovery: Failed to save state: {}", e.what());
@@ -207,11 +247,10 @@ namespace opacity::core
             return state;
         }
 
+        // Caller holds mutex_
         void SaveOperations()
         {
             try {
-                std::lock_guard<std::mutex> lock(mutex_);
-                
                 json j = json::array();
                 for (const auto& op : pendingOperations_) {
                     json opJson;
@@ -233,9 +272,19 @@ namespace opacity::core
                     j.push_back(opJson);
                 }
 
+                // Written aside and renamed over, so a crash mid-write
+                // leaves the previous journal instead of a truncated one
                 auto opsPath = config_.recoveryPath / "pending_operations.json";
-                std::ofstream file(opsPath);
-                file << j.dump(2);
+                auto tempPath = config_.recoveryPath / "pending_operations.json.tmp";
+                {
+                    std::ofstream file(tempPath, std::ios::trunc);
+                    file << j.dump(2);
+                    if (!file) {
+                        Logger::Get()->error("CrashRecovery: Failed to write {}", tempPath.string());
+                        return;
+                    }
+                }
+                std::filesystem::rename(tempPath, opsPath);
             }
             catch (const std::exception& e) {
                 Logger::Get()->error("CrashRecovery: Failed to save operations: {}", e.what());
@@ -379,6 +428,12 @@ namespace opacity::core
         auto lockPath = config.recoveryPath / "session.lock";
         impl_->previousCrash_ = std::filesystem::exists(lockPath, ec);
 
+        // Operations left unfinished stay on record until resumed or cleared
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            impl_->pendingOperations_ = impl_->LoadOperations();
+        }
+
         impl_->initialized_ = true;
         Logger::Get()->info("CrashRecovery: Initialized, previous crash: {}", 
             impl_->previousCrash_);
@@ -420,9 +475,15 @@ namespace opacity::core
         auto lockPath = impl_->config_.recoveryPath / "session.lock";
         std::filesystem::remove(lockPath, ec);
 
-        // Clear pending operations
-        auto opsPath = impl_->config_.recoveryPath / "pending_operations.json";
-        std::filesystem::remove(opsPath, ec);
+        // Clear pending operations, unless some were left unfinished (a
+        // copy that lost its share can still be resumed next session)
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            if (impl_->pendingOperations_.empty()) {
+                auto opsPath = impl_->config_.recoveryPath / "pending_operations.json";
+                std::filesystem::remove(opsPath, ec);
+            }
+        }
 
         Logger::Get()->info("CrashRecovery: Ended session: {}", impl_->sessionId_);
         impl_->sessionId_.clear();
@@ -435,10 +496,7 @@ namespace opacity::core
 
     bool CrashRecovery::SaveSessionState(const SessionState& state)
     {
-        SessionState stateWithId = state;
-        stateWithId.sessionId = impl_->sessionId_;
-        stateWithId.timestamp = std::chrono::system_clock::now();
-        impl_->SaveState(stateWithId);
+        impl_->SaveState(state);
         return true;
     }
 
@@ -480,7 +538,11 @@ namespace opacity::core
 
     void CrashRecovery::StopAutoSave()
     {
-        impl_->autoSaveRunning_ = false;
+        {
+            std::lock_guard<std::mutex> lock(impl_->wakeMutex_);
+            impl_->autoSaveRunning_ = false;
+        }
+        impl_->wake_.notify_all();
         
         if (impl_->autoSaveThread_.joinable()) {
             impl_->autoSaveThread_.join();
@@ -496,11 +558,8 @@ namespace opacity::core
 
     void CrashRecovery::SaveNow()
     {
-        if (!impl_->saveCallback_) return;
-        
         try {
-            SessionState state = impl_->saveCallback_();
-            SaveSessionState(state);
+            impl_->SaveLatest();
         }
         catch (const std::exception& e) {
             Logger::Get()->error("CrashRecovery: Manual save failed: {}", e.what());
@@ -512,6 +571,14 @@ namespace opacity::core
         impl_->saveCallback_ = callback;
     }
 
+    void CrashRecovery::PublishSessionState(SessionState state)
+    {
+        auto published = std::make_shared<const SessionState>(std::move(state));
+        std::lock_guard<std::mutex> lock(impl_->publishMutex_);
+        impl_->published_ = std::move(published);
+        impl_->everPublished_ = true;
+    }
+
     bool CrashRecovery::BackupSettings(const std::filesystem::path& settingsPath)
     {
         try {
@@ -778,6 +845,21 @@ namespace opacity::core
         impl_->SaveOperations();
     }
 
+    void CrashRecovery::UpdateOperationProgress(const std::string& operationId, int processed,
+                                                const std::string& customData)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+
+        for (auto& op : impl_->pendingOperations_) {
+            if (op.id == operationId) {
+                op.processedCount = processed;
+                op.customData = customData;
+                break;
+            }
+        }
+        impl_->SaveOperations();
+    }
+
     void CrashRecovery::CompleteOperation(const std::string& operationId)
     {
         ClearPendingOperation(operationId);
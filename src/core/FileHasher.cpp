@@ -0,0 +1,318 @@
+#include "opacity/core/FileHasher.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/HashCache.h"
+
+#include <algorithm>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace opacity::core
+{
+    namespace
+    {
+#ifdef _WIN32
+        HANDLE OpenForRead(const Path& path, DWORD flags)
+        {
+            // Shared for writing and deleting, so hashing never gets in anyone's way
+            HANDLE file = CreateFileW(path.WString().c_str(), GENERIC_READ,
+                                      FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                      OPEN_EXISTING, flags, nullptr);
+            if (file != INVALID_HANDLE_VALUE)
+                BackgroundScope::HintFileHandle(file);
+            return file;
+        }
+
+        bool ReadAt(HANDLE file, uint64_t offset, char* buffer, size_t length, size_t& read)
+        {
+            // A synchronous handle still takes its position from the OVERLAPPED
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = static_cast<DWORD>(offset);
+            overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+            DWORD bytes = 0;
+            if (!ReadFile(file, buffer, static_cast<DWORD>(length), &bytes, &overlapped) &&
+                GetLastError() != ERROR_HANDLE_EOF)
+            {
+                return false;
+            }
+            read = bytes;
+            return true;
+        }
+#else
+        bool ReadAt(int file, uint64_t offset, char* buffer, size_t length, size_t& read)
+        {
+            read = 0;
+            while (read < length)
+            {
+                ssize_t bytes = pread(file, buffer + read, length - read, static_cast<off_t>(offset + read));
+                if (bytes < 0)
+                    return false;
+                if (bytes == 0)
+                    break;
+                read += static_cast<size_t>(bytes);
+            }
+            return true;
+        }
+#endif
+    }
+
+#ifdef _WIN32
+    bool FileHasher::HashFile(const Path& path, std::string& hash, const std::atomic<bool>* cancel)
+    {
+        HANDLE file = OpenForRead(path, FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        // Two reads: one is hashed while the other fills
+        struct Read
+        {
+            OVERLAPPED overlapped = {};
+            std::vector<char> buffer;
+            bool pending = false;
+        };
+        Read reads[2];
+
+        bool ok = true;
+        for (auto& read : reads)
+        {
+            read.buffer.resize(kBlockSize);
+            read.overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            ok = ok && read.overlapped.hEvent != nullptr;
+        }
+
+        auto issue = [file](Read& read, uint64_t offset)
+        {
+            read.overlapped.Offset = static_cast<DWORD>(offset);
+            read.overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+            if (ReadFile(file, read.buffer.data(), static_cast<DWORD>(read.buffer.size()), nullptr, &read.overlapped) ||
+                GetLastError() == ERROR_IO_PENDING)
+            {
+                read.pending = true;
+                return true;
+            }
+
+            // Left not pending, which finishes as an empty read
+            return GetLastError() == ERROR_HANDLE_EOF;
+        };
+
+        auto finish = [file](Read& read, DWORD& bytes)
+        {
+            bytes = 0;
+            if (!read.pending)
+                return true;
+
+            read.pending = false;
+            return GetOverlappedResult(file, &read.overlapped, &bytes, TRUE) || GetLastError() == ERROR_HANDLE_EOF;
+        };
+
+        Xxh64 hasher;
+        uint64_t offset = 0;
+        int current = 0;
+        ok = ok && issue(reads[0], 0);
+        while (ok)
+        {
+            DWORD bytes = 0;
+            if (!finish(reads[current], bytes))
+            {
+                ok = false;
+                break;
+            }
+            if (bytes == 0)
+                break;
+
+            if (cancel && cancel->load())
+            {
+                ok = false;
+                break;
+            }
+
+            offset += bytes;
+            if (!issue(reads[current ^ 1], offset))
+            {
+                ok = false;
+                break;
+            }
+            hasher.Update(reads[current].buffer.data(), bytes);
+            current ^= 1;
+        }
+
+        // Nothing may still be reading into a buffer when it is freed
+        for (auto& read : reads)
+        {
+            if (read.pending)
+            {
+                DWORD ignored = 0;
+                CancelIoEx(file, &read.overlapped);
+                GetOverlappedResult(file, &read.overlapped, &ignored, TRUE);
+            }
+            if (read.overlapped.hEvent)
+                CloseHandle(read.overlapped.hEvent);
+        }
+        CloseHandle(file);
+
+        if (ok)
+            hash = hasher.HexDigest();
+        return ok;
+    }
+
+    bool FileHasher::HashPartial(const Path& path, std::string& hash, size_t block_size)
+    {
+        HANDLE file = OpenForRead(path, FILE_ATTRIBUTE_NORMAL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER size = {};
+        bool ok = GetFileSizeEx(file, &size) != 0;
+
+        std::vector<char> buffer(block_size);
+        Xxh64 hasher;
+        size_t read = 0;
+        ok = ok && ReadAt(file, 0, buffer.data(), buffer.size(), read);
+        if (ok)
+            hasher.Update(buffer.data(), read);
+
+        uint64_t file_size = static_cast<uint64_t>(size.QuadPart);
+        if (ok && file_size > 2 * static_cast<uint64_t>(block_size))
+        {
+            ok = ReadAt(file, file_size - block_size, buffer.data(), buffer.size(), read);
+            if (ok)
+                hasher.Update(buffer.data(), read);
+        }
+        CloseHandle(file);
+
+        if (ok)
+            hash = hasher.HexDigest();
+        return ok;
+    }
+#else
+    bool FileHasher::HashFile(const Path& path, std::string& hash, const std::atomic<bool>* cancel)
+    {
+        int file = open(path.String().c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        // The kernel reads ahead while each block is hashed
+        posix_fadvise(file, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+        std::vector<char> buffer(kBlockSize);
+        Xxh64 hasher;
+        uint64_t offset = 0;
+        bool ok = true;
+        while (true)
+        {
+            size_t read = 0;
+            if (!ReadAt(file, offset, buffer.data(), buffer.size(), read) || (cancel && cancel->load()))
+            {
+                ok = false;
+                break;
+            }
+            if (read == 0)
+                break;
+
+            hasher.Update(buffer.data(), read);
+            offset += read;
+        }
+        close(file);
+
+        if (ok)
+            hash = hasher.HexDigest();
+        return ok;
+    }
+
+    bool FileHasher::HashPartial(const Path& path, std::string& hash, size_t block_size)
+    {
+        int file = open(path.String().c_str(), O_RDONLY);
+        if (file < 0)
+            return false;
+
+        struct stat info = {};
+        bool ok = fstat(file, &info) == 0;
+
+        std::vector<char> buffer(block_size);
+        Xxh64 hasher;
+        size_t read = 0;
+        ok = ok && ReadAt(file, 0, buffer.data(), buffer.size(), read);
+        if (ok)
+            hasher.Update(buffer.data(), read);
+
+        uint64_t file_size = static_cast<uint64_t>(info.st_size);
+        if (ok && file_size > 2 * static_cast<uint64_t>(block_size))
+        {
+            ok = ReadAt(file, file_size - block_size, buffer.data(), buffer.size(), read);
+            if (ok)
+                hasher.Update(buffer.data(), read);
+        }
+        close(file);
+
+        if (ok)
+            hash = hasher.HexDigest();
+        return ok;
+    }
+#endif
+
+    void FileHasher::HashFiles(std::vector<FileHashJob>& jobs, unsigned threads,
+                               const std::atomic<bool>* cancel,
+                               const std::function<void(const FileHashJob&)>& on_hashed,
+                               HashCache* cache)
+    {
+        if (jobs.empty())
+            return;
+
+        if (threads == 0)
+            threads = std::min(kMaxThreads, std::max(1u, std::thread::hardware_concurrency()));
+        threads = static_cast<unsigned>(std::min<size_t>(threads, jobs.size()));
+
+        std::atomic<size_t> next{0};
+        std::mutex report_mutex;
+        auto worker = [&]()
+        {
+            for (size_t index; (index = next.fetch_add(1)) < jobs.size();)
+            {
+                if (cancel && cancel->load())
+                    return;
+
+                FileHashJob& job = jobs[index];
+                if (cache)
+                {
+                    job.success = job.partial ? cache->HashPartial(job.path, job.hash)
+                                              : cache->HashFile(job.path, job.hash, cancel);
+                }
+                else
+                {
+                    job.success = job.partial ? HashPartial(job.path, job.hash) : HashFile(job.path, job.hash, cancel);
+                }
+
+                if (on_hashed)
+                {
+                    std::lock_guard<std::mutex> lock(report_mutex);
+                    on_hashed(job);
+                }
+            }
+        };
+
+        if (threads <= 1)
+        {
+            worker();
+            return;
+        }
+
+        std::vector<std::thread> workers;
+        workers.reserve(threads);
+        for (unsigned t = 0; t < threads; ++t)
+            workers.emplace_back(worker);
+        for (auto& thread : workers)
+            thread.join();
+    }
+
+} // namespace opacity::core
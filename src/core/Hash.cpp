@@ -0,0 +1,249 @@
+#include "opacity/core/Hash.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace opacity::core
+{
+    namespace
+    {
+        constexpr uint64_t kPrime1 = 0x9E3779B185EBCA87ULL;
+        constexpr uint64_t kPrime2 = 0xC2B2AE3D27D4EB4FULL;
+        constexpr uint64_t kPrime3 = 0x165667B19E3779F9ULL;
+        constexpr uint64_t kPrime4 = 0x85EBCA77C2B2AE63ULL;
+        constexpr uint64_t kPrime5 = 0x27D4EB2F165667C5ULL;
+
+        uint64_t Rotl(uint64_t value, int bits)
+        {
+            return (value << bits) | (value >> (64 - bits));
+        }
+
+        // Little-endian reads; memcpy keeps unaligned input legal
+        uint64_t Read64(const uint8_t* p)
+        {
+            uint64_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint32_t Read32(const uint8_t* p)
+        {
+            uint32_t value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+
+        uint64_t Round(uint64_t lane, uint64_t input)
+        {
+            lane += input * kPrime2;
+            lane = Rotl(lane, 31);
+            return lane * kPrime1;
+        }
+
+        uint64_t MergeRound(uint64_t hash, uint64_t lane)
+        {
+            hash ^= Round(0, lane);
+            return hash * kPrime1 + kPrime4;
+        }
+
+        void ConsumeStripe(uint64_t* lanes, const uint8_t* p)
+        {
+            lanes[0] = Round(lanes[0], Read64(p));
+            lanes[1] = Round(lanes[1], Read64(p + 8));
+            lanes[2] = Round(lanes[2], Read64(p + 16));
+            lanes[3] = Round(lanes[3], Read64(p + 24));
+        }
+
+        void AppendHex(std::string& text, const uint8_t* data, size_t length)
+        {
+            static const char* digits = "0123456789abcdef";
+            for (size_t i = 0; i < length; ++i)
+            {
+                text += digits[data[i] >> 4];
+                text += digits[data[i] & 0x0F];
+            }
+        }
+
+        void AppendHex64(std::string& text, uint64_t value)
+        {
+            uint8_t bytes[8];
+            for (int i = 0; i < 8; ++i)
+            {
+                bytes[i] = static_cast<uint8_t>(value >> (56 - 8 * i));
+            }
+            AppendHex(text, bytes, sizeof(bytes));
+        }
+
+        int HexValue(char c)
+        {
+            if (c >= '0' && c <= '9')
+                return c - '0';
+            if (c >= 'a' && c <= 'f')
+                return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F')
+                return c - 'A' + 10;
+            return -1;
+        }
+
+        bool ParseHex(const char* text, uint8_t* out, size_t length)
+        {
+            for (size_t i = 0; i < length; ++i)
+            {
+                int high = HexValue(text[2 * i]);
+                int low = HexValue(text[2 * i + 1]);
+                if (high < 0 || low < 0)
+                    return false;
+                out[i] = static_cast<uint8_t>((high << 4) | low);
+            }
+            return true;
+        }
+
+        bool ParseHex64(const char* text, uint64_t& value)
+        {
+            uint8_t bytes[8];
+            if (!ParseHex(text, bytes, sizeof(bytes)))
+                return false;
+
+            value = 0;
+            for (uint8_t byte : bytes)
+            {
+                value = (value << 8) | byte;
+            }
+            return true;
+        }
+    }
+
+    Xxh64::Xxh64(uint64_t seed)
+        : seed_(seed)
+    {
+        lanes_[0] = seed + kPrime1 + kPrime2;
+        lanes_[1] = seed + kPrime2;
+        lanes_[2] = seed;
+        lanes_[3] = seed - kPrime1;
+    }
+
+    void Xxh64::Update(const void* data, size_t length)
+    {
+        auto p = static_cast<const uint8_t*>(data);
+        length_ += length;
+
+        if (pending_size_ > 0)
+        {
+            size_t take = std::min(length, sizeof(pending_) - pending_size_);
+            std::memcpy(pending_ + pending_size_, p, take);
+            pending_size_ += take;
+            p += take;
+            length -= take;
+
+            if (pending_size_ < sizeof(pending_))
+                return;
+
+            ConsumeStripe(lanes_, pending_);
+            pending_size_ = 0;
+        }
+
+        while (length >= 32)
+        {
+            ConsumeStripe(lanes_, p);
+            p += 32;
+            length -= 32;
+        }
+
+        std::memcpy(pending_, p, length);
+        pending_size_ = length;
+    }
+
+    uint64_t Xxh64::Digest() const
+    {
+        uint64_t hash;
+        if (length_ >= 32)
+        {
+            hash = Rotl(lanes_[0], 1) + Rotl(lanes_[1], 7) + Rotl(lanes_[2], 12) + Rotl(lanes_[3], 18);
+            for (uint64_t lane : lanes_)
+            {
+                hash = MergeRound(hash, lane);
+            }
+        }
+        else
+        {
+            hash = seed_ + kPrime5;
+        }
+
+        hash += length_;
+
+        const uint8_t* p = pending_;
+        const uint8_t* end = pending_ + pending_size_;
+        for (; p + 8 <= end; p += 8)
+        {
+            hash ^= Round(0, Read64(p));
+            hash = Rotl(hash, 27) * kPrime1 + kPrime4;
+        }
+        if (p + 4 <= end)
+        {
+            hash ^= static_cast<uint64_t>(Read32(p)) * kPrime1;
+            hash = Rotl(hash, 23) * kPrime2 + kPrime3;
+            p += 4;
+        }
+        for (; p < end; ++p)
+        {
+            hash ^= *p * kPrime5;
+            hash = Rotl(hash, 11) * kPrime1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= kPrime2;
+        hash ^= hash >> 29;
+        hash *= kPrime3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    std::string Xxh64::HexDigest() const
+    {
+        std::string text;
+        AppendHex64(text, Digest());
+        return text;
+    }
+
+    std::string Xxh64::SaveState() const
+    {
+        // lanes, seed, length, then the pending bytes
+        std::string text;
+        text.reserve(6 * 16 + 2 * pending_size_);
+        for (uint64_t lane : lanes_)
+        {
+            AppendHex64(text, lane);
+        }
+        AppendHex64(text, seed_);
+        AppendHex64(text, length_);
+        AppendHex(text, pending_, pending_size_);
+        return text;
+    }
+
+    bool Xxh64::LoadState(const std::string& text)
+    {
+        constexpr size_t kFixed = 6 * 16;
+        if (text.size() < kFixed || text.size() % 2 != 0 || text.size() > kFixed + 2 * sizeof(pending_))
+            return false;
+
+        uint64_t values[6];
+        for (int i = 0; i < 6; ++i)
+        {
+            if (!ParseHex64(text.data() + 16 * i, values[i]))
+                return false;
+        }
+
+        uint8_t pending[sizeof(pending_)];
+        size_t pending_size = (text.size() - kFixed) / 2;
+        if (!ParseHex(text.data() + kFixed, pending, pending_size) || values[5] % 32 != pending_size % 32)
+            return false;
+
+        std::memcpy(lanes_, values, sizeof(lanes_));
+        seed_ = values[4];
+        length_ = values[5];
+        std::memcpy(pending_, pending, pending_size);
+        pending_size_ = pending_size;
+        return true;
+    }
+
+} // namespace opacity::core
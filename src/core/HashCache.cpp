@@ -0,0 +1,475 @@
+#include "opacity/core/HashCache.h"
+#include "opacity/core/FileHasher.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <functional>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <ShlObj.h>
+#else
+#include <cstdlib>
+#include <sys/stat.h>
+#endif
+
+namespace opacity::core
+{
+    namespace
+    {
+        constexpr uint32_t kFileMagic = 0x48435048;     // "HPCH"
+        constexpr uint32_t kRecordMagic = 0x52434848;   // "HHCR"
+        constexpr uint32_t kVersion = 1;
+
+        constexpr uint32_t kHasFull = 1;
+        constexpr uint32_t kHasPartial = 2;
+
+        // Superseded records tolerated before the file is rewritten
+        constexpr uint64_t kCompactSlack = 4096;
+
+        struct FileHeader
+        {
+            uint32_t magic;
+            uint32_t version;
+        };
+
+        struct Record
+        {
+            uint32_t magic;
+            uint32_t checksum;      // Of everything after it
+            uint64_t volume;
+            uint64_t file_id;
+            int64_t modified;
+            uint64_t size;
+            uint32_t flags;
+            uint32_t reserved;
+            char full[16];
+            char partial[16];
+        };
+
+        static_assert(sizeof(Record) == 80, "record is written as is");
+
+        uint32_t Checksum(const Record& record)
+        {
+            const auto* bytes = reinterpret_cast<const uint8_t*>(&record);
+            Xxh64 hash;
+            hash.Update(bytes + 8, sizeof(Record) - 8);
+            return static_cast<uint32_t>(hash.Digest());
+        }
+
+        template <typename T>
+        bool ReadRaw(std::istream& stream, T& value)
+        {
+            return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+        }
+
+        template <typename T>
+        void WriteRaw(std::ostream& stream, const T& value)
+        {
+            stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+        }
+
+        bool SameVersion(const FileIdentity& a, const FileIdentity& b)
+        {
+            return a.volume == b.volume && a.file_id == b.file_id && a.modified == b.modified && a.size == b.size;
+        }
+    }
+
+    size_t HashCache::SlotHash::operator()(const Slot& slot) const
+    {
+        size_t hash = std::hash<uint64_t>{}(slot.file_id);
+        return hash ^ (std::hash<uint64_t>{}(slot.volume) + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2));
+    }
+
+    HashCache::HashCache(Path file, size_t max_entries)
+        : file_(std::move(file))
+        , max_entries_(max_entries)
+    {
+        memory_ = MemoryGovernor::Get().Register(
+            "File hashes",
+            [this]
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return entries_.size() * kEntryBytes;
+            },
+            [this](size_t target_bytes)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                TrimLocked(target_bytes / kEntryBytes);
+            });
+    }
+
+    HashCache::~HashCache()
+    {
+        memory_.Reset();
+        Flush();
+    }
+
+    bool HashCache::Open()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (open_)
+            return true;
+
+        std::error_code ec;
+        std::filesystem::create_directories(file_.Parent().Get(), ec);
+
+        uint64_t file_size = std::filesystem::file_size(file_.Get(), ec);
+        if (ec)
+            file_size = 0;
+
+        std::ifstream in(file_.Get(), std::ios::binary);
+        FileHeader header{};
+        uint64_t end = 0;
+        if (file_size >= sizeof(FileHeader) && ReadRaw(in, header) &&
+            header.magic == kFileMagic && header.version == kVersion)
+        {
+            end = sizeof(FileHeader);
+            Record record{};
+            while (end + sizeof(Record) <= file_size && ReadRaw(in, record) &&
+                   record.magic == kRecordMagic && record.checksum == Checksum(record))
+            {
+                Entry entry;
+                entry.modified = record.modified;
+                entry.size = record.size;
+                entry.sequence = next_sequence_++;
+                entry.flags = record.flags;
+                std::memcpy(entry.full, record.full, kDigestLength);
+                std::memcpy(entry.partial, record.partial, kDigestLength);
+                entries_[Slot{record.volume, record.file_id}] = entry;
+
+                ++records_;
+                end += sizeof(Record);
+            }
+        }
+        in.close();
+
+        if (end == 0)
+        {
+            // New or unreadable: start over
+            std::ofstream out(file_.Get(), std::ios::binary | std::ios::trunc);
+            WriteRaw(out, FileHeader{kFileMagic, kVersion});
+            if (!out)
+            {
+                SPDLOG_WARN("Hash cache unavailable: cannot write {}", file_.String());
+                return false;
+            }
+            end = sizeof(FileHeader);
+        }
+        else if (end < file_size)
+        {
+            // A record torn by a crash; the next one goes in its place
+            std::filesystem::resize_file(file_.Get(), end, ec);
+            if (ec)
+                return false;
+        }
+
+        log_.open(file_.Get(), std::ios::binary | std::ios::app);
+        if (!log_.is_open())
+        {
+            SPDLOG_WARN("Hash cache unavailable: cannot open {}", file_.String());
+            return false;
+        }
+        open_ = true;
+
+        if (records_ > 2 * entries_.size() + kCompactSlack || entries_.size() > max_entries_)
+            CompactLocked();
+
+        SPDLOG_DEBUG("Hash cache opened: {} files", entries_.size());
+        return true;
+    }
+
+    bool HashCache::ReadIdentity(const Path& path, FileIdentity& identity)
+    {
+#ifdef _WIN32
+        // Opening for attributes only never recalls a cloud placeholder
+        HANDLE handle = CreateFileW(path.WString().c_str(), FILE_READ_ATTRIBUTES,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                    OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+
+        BY_HANDLE_FILE_INFORMATION info;
+        BOOL ok = GetFileInformationByHandle(handle, &info);
+        CloseHandle(handle);
+        if (!ok)
+            return false;
+
+        identity.volume = info.dwVolumeSerialNumber;
+        identity.file_id = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        identity.modified = static_cast<int64_t>((static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                                                 info.ftLastWriteTime.dwLowDateTime);
+        identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        identity.links = info.nNumberOfLinks;
+#else
+        struct stat info = {};
+        if (stat(path.String().c_str(), &info) != 0)
+            return false;
+
+        // 100ns ticks since 1601, as on Windows
+        identity.volume = static_cast<uint64_t>(info.st_dev);
+        identity.file_id = static_cast<uint64_t>(info.st_ino);
+        identity.modified = (static_cast<int64_t>(info.st_mtim.tv_sec) + 11644473600LL) * 10000000LL +
+                            info.st_mtim.tv_nsec / 100;
+        identity.size = static_cast<uint64_t>(info.st_size);
+        identity.links = static_cast<uint32_t>(info.st_nlink);
+#endif
+
+        if (identity.file_id == 0)
+        {
+            // Some network file systems report no ids; the path will do
+            std::wstring text = path.WString();
+            Xxh64 hash;
+            hash.Update(text.data(), text.size() * sizeof(wchar_t));
+            identity.volume = 0;
+            identity.file_id = hash.Digest();
+        }
+        return true;
+    }
+
+    bool HashCache::HashFile(const Path& path, std::string& hash, const std::atomic<bool>* cancel)
+    {
+        FileIdentity identity;
+        bool known = ReadIdentity(path, identity);
+        if (known && FindFull(identity, hash))
+            return true;
+
+        if (!FileHasher::HashFile(path, hash, cancel))
+            return false;
+
+        // A file written to while it was read is not worth remembering
+        FileIdentity after;
+        if (known && ReadIdentity(path, after) && SameVersion(identity, after))
+            StoreFull(identity, hash);
+        return true;
+    }
+
+    bool HashCache::HashPartial(const Path& path, std::string& hash)
+    {
+        FileIdentity identity;
+        bool known = ReadIdentity(path, identity);
+        if (known && FindPartial(identity, hash))
+            return true;
+
+        if (!FileHasher::HashPartial(path, hash))
+            return false;
+
+        FileIdentity after;
+        if (known && ReadIdentity(path, after) && SameVersion(identity, after))
+            StorePartial(identity, hash);
+        return true;
+    }
+
+    bool HashCache::FindFull(const FileIdentity& identity, std::string& hash) const
+    {
+        return Find(identity, kHasFull, hash);
+    }
+
+    bool HashCache::FindPartial(const FileIdentity& identity, std::string& hash) const
+    {
+        return Find(identity, kHasPartial, hash);
+    }
+
+    void HashCache::StoreFull(const FileIdentity& identity, const std::string& hash)
+    {
+        Store(identity, kHasFull, hash);
+    }
+
+    void HashCache::StorePartial(const FileIdentity& identity, const std::string& hash)
+    {
+        Store(identity, kHasPartial, hash);
+    }
+
+    void HashCache::Flush()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (open_)
+            log_.flush();
+    }
+
+    size_t HashCache::GetEntryCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    Path HashCache::DefaultLocation()
+    {
+        std::filesystem::path base;
+#ifdef _WIN32
+        wchar_t local_appdata[MAX_PATH];
+        if (SUCCEEDED(SHGetFolderPathW(nullptr, CSIDL_LOCAL_APPDATA, nullptr, 0, local_appdata)))
+            base = std::filesystem::path(local_appdata) / "Opacity";
+#else
+        if (const char* cache = std::getenv("XDG_CACHE_HOME"))
+            base = std::filesystem::path(cache) / "opacity";
+        else if (const char* home = std::getenv("HOME"))
+            base = std::filesystem::path(home) / ".cache" / "opacity";
+#endif
+        if (base.empty())
+        {
+            std::error_code ec;
+            base = std::filesystem::temp_directory_path(ec) / "Opacity";
+        }
+        return Path(base / "hashes.dat");
+    }
+
+    bool HashCache::Find(const FileIdentity& identity, uint32_t flag, std::string& hash) const
+    {
+        static auto& hits = Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                      {{"cache", "hash"}, {"result", "hit"}});
+        static auto& misses = Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                        {{"cache", "hash"}, {"result", "miss"}});
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(Slot{identity.volume, identity.file_id});
+        if (it == entries_.end() || !(it->second.flags & flag) ||
+            it->second.modified != identity.modified || it->second.size != identity.size)
+        {
+            misses.Add();
+            return false;
+        }
+
+        hits.Add();
+
+        const char* digest = flag == kHasFull ? it->second.full : it->second.partial;
+        hash.assign(digest, kDigestLength);
+        return true;
+    }
+
+    void HashCache::Store(const FileIdentity& identity, uint32_t flag, const std::string& hash)
+    {
+        if (hash.size() != kDigestLength)
+            return;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!open_)
+            return;
+
+        Slot slot{identity.volume, identity.file_id};
+        Entry& entry = entries_[slot];
+        if (entry.modified != identity.modified || entry.size != identity.size)
+        {
+            // A new version: what was kept for the old one no longer holds
+            entry = Entry{};
+            entry.modified = identity.modified;
+            entry.size = identity.size;
+        }
+        entry.sequence = next_sequence_++;
+        entry.flags |= flag;
+        std::memcpy(flag == kHasFull ? entry.full : entry.partial, hash.data(), kDigestLength);
+
+        AppendLocked(slot, entry);
+
+        if (records_ > 2 * entries_.size() + kCompactSlack || entries_.size() > max_entries_ + kCompactSlack)
+            CompactLocked();
+    }
+
+    void HashCache::WriteRecord(std::ostream& out, const Slot& slot, const Entry& entry)
+    {
+        Record record{};
+        record.magic = kRecordMagic;
+        record.volume = slot.volume;
+        record.file_id = slot.file_id;
+        record.modified = entry.modified;
+        record.size = entry.size;
+        record.flags = entry.flags;
+        std::memcpy(record.full, entry.full, kDigestLength);
+        std::memcpy(record.partial, entry.partial, kDigestLength);
+        record.checksum = Checksum(record);
+        WriteRaw(out, record);
+    }
+
+    void HashCache::AppendLocked(const Slot& slot, const Entry& entry)
+    {
+        WriteRecord(log_, slot, entry);
+        if (!log_)
+        {
+            log_.clear();
+            return;
+        }
+        ++records_;
+    }
+
+    void HashCache::TrimLocked(size_t max_entries)
+    {
+        if (entries_.size() <= max_entries)
+            return;
+
+        // Forget the oldest; they are hashed again when next asked for,
+        // and the next compaction leaves them out of the file as well
+        std::vector<uint64_t> sequences;
+        sequences.reserve(entries_.size());
+        for (const auto& [slot, entry] : entries_)
+        {
+            sequences.push_back(entry.sequence);
+        }
+        auto cutoff = sequences.begin() + (sequences.size() - max_entries);
+        std::nth_element(sequences.begin(), cutoff, sequences.end());
+        uint64_t oldest_kept = cutoff == sequences.end() ? UINT64_MAX : *cutoff;
+
+        for (auto it = entries_.begin(); it != entries_.end();)
+        {
+            if (it->second.sequence < oldest_kept)
+                it = entries_.erase(it);
+            else
+                ++it;
+        }
+    }
+
+    void HashCache::CompactLocked()
+    {
+        // The most recently stored are kept when there are too many
+        std::vector<std::pair<Slot, Entry>> keep(entries_.begin(), entries_.end());
+        std::sort(keep.begin(), keep.end(), [](const auto& a, const auto& b)
+        {
+            return a.second.sequence > b.second.sequence;
+        });
+        if (keep.size() > max_entries_)
+            keep.resize(max_entries_);
+        std::reverse(keep.begin(), keep.end());     // Back to oldest first
+
+        auto temp_path = file_.Get();
+        temp_path += ".tmp";
+        {
+            std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+            WriteRaw(out, FileHeader{kFileMagic, kVersion});
+            for (const auto& [slot, entry] : keep)
+            {
+                WriteRecord(out, slot, entry);
+            }
+            if (!out)
+            {
+                std::error_code ec;
+                std::filesystem::remove(temp_path, ec);
+                return;
+            }
+        }
+
+        log_.close();
+        std::error_code ec;
+        std::filesystem::rename(temp_path, file_.Get(), ec);
+        if (ec)
+        {
+            std::filesystem::remove(temp_path, ec);
+        }
+        else
+        {
+            SPDLOG_INFO("Hash cache compacted from {} to {} records", records_, keep.size());
+            entries_.clear();
+            entries_.insert(keep.begin(), keep.end());
+            records_ = keep.size();
+        }
+
+        log_.open(file_.Get(), std::ios::binary | std::ios::app);
+        open_ = log_.is_open();
+    }
+
+} // namespace opacity::core
@@ -30,6 +30,22 @@ FormatArg::FormatArg(const std::string& n, double v) : name(n) {
 
 class Localization::Impl {
 public:
+    // Part of a compiled string: literal text, or the name of a placeholder
+    struct Segment {
+        uint32_t offset;
+        uint32_t length;
+        bool placeholder;
+    };
+    
+    struct Entry {
+        StringId id;
+        std::string key;
+        std::string text;
+        std::vector<Segment> segments;
+        mutable bool used = false;
+    };
+    
+
     std::string localesDir;
     std::string currentLanguage = "en";
     std::string fallbackLanguage = "en";
@@ -42,6 +58,153 @@ public:
     mutable std::set<std::string> usedKeys;
     bool initialized = false;
     
+    // Current language over the fallback, found through an open-addressed
+    // table of entry index + 1 (0 is empty); rebuilt when marked dirty
+    mutable std::vector<Entry> catalog;
+    mutable std::vector<uint32_t> table;
+    mutable bool catalogDirty = true;
+    
+    static std::vector<Segment> parseSegments(const std::string& text) {
+        std::vector<Segment> segments;
+        size_t literal = 0;
+        size_t pos = 0;
+        while ((pos = text.find('{', pos)) != std::string::npos) {
+            size_t close = text.find_first_of("{}", pos + 1);
+            if (close == std::string::npos || text[close] != '}' || close == pos + 1) {
+                ++pos;
+                continue;
+            }
+            if (pos > literal) {
+                segments.push_back({static_cast<uint32_t>(literal), static_cast<uint32_t>(pos - literal), false});
+            }
+            segments.push_back({static_cast<uint32_t>(pos + 1), static_cast<uint32_t>(close - pos - 1), true});
+            literal = pos = close + 1;
+        }
+        if (literal < text.size()) {
+            segments.push_back({static_cast<uint32_t>(literal), static_cast<uint32_t>(text.size() - literal), false});
+        }
+        return segments;
+    }
+    
+    static std::string render(const std::string& text, const std::vector<Segment>& segments,
+                              const std::vector<FormatArg>& args) {
+        size_t size = text.size();
+        for (const auto& arg : args) {
+            size += arg.value.size();
+        }
+        
+        std::string result;
+        result.reserve(size);
+        for (const auto& segment : segments) {
+            std::string_view part(text.data() + segment.offset, segment.length);
+            if (!segment.placeholder) {
+                result.append(part);
+                continue;
+            }
+            
+            auto arg = std::find_if(args.begin(), args.end(),
+                [part](const FormatArg& a) { return a.name == part; });
+            if (arg != args.end()) {
+                result += arg->value;
+            } else {
+                // Unknown placeholders are left as written
+                result += '{';
+                result.append(part);
+                result += '}';
+            }
+        }
+        return result;
+    }
+    
+    void compileCatalog() const {
+        for (const auto& entry : catalog) {
+            if (entry.used) {
+                usedKeys.insert(entry.key);
+            }
+        }
+        catalog.clear();
+        
+        std::unordered_map<std::string, const std::string*> merged;
+        for (const auto& code : {fallbackLanguage, currentLanguage}) {
+            auto langIt = strings.find(code);
+            if (langIt == strings.end()) {
+                continue;
+            }
+            for (const auto& [key, value] : langIt->second) {
+                merged[key] = &value;
+            }
+        }
+        
+        catalog.reserve(merged.size());
+        for (const auto& [key, value] : merged) {
+            Entry entry;
+            entry.id = stringId(key);
+            entry.key = key;
+            entry.text = *value;
+            entry.segments = parseSegments(entry.text);
+            entry.used = usedKeys.count(key) > 0;
+            catalog.push_back(std::move(entry));
+        }
+        
+        size_t capacity = 16;
+        while (capacity < catalog.size() * 2) {
+            capacity *= 2;
+        }
+        table.assign(capacity, 0);
+        size_t mask = capacity - 1;
+        for (size_t i = 0; i < catalog.size(); ++i) {
+            size_t slot = static_cast<size_t>(catalog[i].id) & mask;
+            bool duplicate = false;
+            while (table[slot] != 0) {
+                if (catalog[table[slot] - 1].id == catalog[i].id) {
+                    spdlog::warn("Localization: keys '{}' and '{}' share an id, keeping the first",
+                                 catalog[table[slot] - 1].key, catalog[i].key);
+                    duplicate = true;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+            if (!duplicate) {
+                table[slot] = static_cast<uint32_t>(i + 1);
+            }
+        }
+        catalogDirty = false;
+    }
+    
+    const Entry* findEntry(StringId id) const {
+        if (catalogDirty) {
+            compileCatalog();
+        }
+        size_t mask = table.size() - 1;
+        for (size_t slot = static_cast<size_t>(id) & mask; table[slot] != 0; slot = (slot + 1) & mask) {
+            const Entry& entry = catalog[table[slot] - 1];
+            if (entry.id == id) {
+                entry.used = true;
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+    
+    const Entry* findEntry(const std::string& key) const {
+        const Entry* entry = findEntry(stringId(key));
+        return entry && entry->key == key ? entry : nullptr;
+    }
+    
+    // The entry for count: its plural form, then the other form, then the key itself
+    const Entry* findPlural(StringId id, int count) const {
+        PluralRule rule = getPluralRule(currentLanguage, count);
+        if (const Entry* entry = findEntry(stringId(getPluralSuffix(rule), id))) {
+            return entry;
+        }
+        if (rule != PluralRule::Other) {
+            if (const Entry* entry = findEntry(stringId(getPluralSuffix(PluralRule::Other), id))) {
+                return entry;
+            }
+        }
+        return findEntry(id);
+    }
+    
     bool loadLanguage(const std::string& code) {
         std::string filePath = localesDir + "/" + code + ".json";
         if (!fs::exists(filePath)) {
@@ -61,6 +224,7 @@ public:
             flattenJson(j, "", langStrings);
             
             strings[code] = std::move(langStrings);
+            catalogDirty = true;
             spdlog::info("Localization: loaded {} strings for '{}'", 
                         strings[code].size(), code);
             return true;
@@ -168,26 +332,12 @@ public:
     }
     
     std::string getString(const std::string& key, const std::string& defaultValue = "") const {
-        usedKeys.insert(key);
-        
-        // Try current language
-        auto langIt = strings.find(currentLanguage);
-        if (langIt != strings.end()) {
-            auto strIt = langIt->second.find(key);
-            if (strIt != langIt->second.end()) {
-                return strIt->second;
-            }
+        if (const Entry* entry = findEntry(key)) {
+            return entry->text;
         }
         
-        // Try fallback language
-        if (currentLanguage != fallbackLanguage) {
-            langIt = strings.find(fallbackLanguage);
-            if (langIt != strings.end()) {
-                auto strIt = langIt->second.find(key);
-                if (strIt != langIt->second.end()) {
-                    return strIt->second;
-                }
-            }
+        if (usedKeys.find(key) == usedKeys.end()) {
+            usedKeys.insert(key);
         }
         
         // Return default or key
@@ -201,18 +351,7 @@ public:
     
     std::string formatString(const std::string& text, 
                             const std::vector<FormatArg>& args) const {
-        std::string result = text;
-        
-        for (const auto& arg : args) {
-            std::string placeholder = "{" + arg.name + "}";
-            size_t pos = 0;
-            while ((pos = result.find(placeholder, pos)) != std::string::npos) {
-                result.replace(pos, placeholder.length(), arg.value);
-                pos += arg.value.length();
-            }
-        }
-        
-        return result;
+        return render(text, parseSegments(text), args);
     }
     
     PluralRule getPluralRule(const std::string& lang, int n) const {
@@ -248,17 +387,16 @@ public:
         return PluralRule::Other;
     }
     
-    std::string getPluralKey(const std::string& baseKey, PluralRule rule) const {
-        static std::unordered_map<PluralRule, std::string> suffixes = {
-            {PluralRule::Zero, "_zero"},
-            {PluralRule::One, "_one"},
-            {PluralRule::Two, "_two"},
-            {PluralRule::Few, "_few"},
-            {PluralRule::Many, "_many"},
-            {PluralRule::Other, "_other"}
-        };
-        
-        return baseKey + suffixes[rule];
+    static std::string_view getPluralSuffix(PluralRule rule) {
+        switch (rule) {
+            case PluralRule::Zero: return "_zero";
+            case PluralRule::One: return "_one";
+            case PluralRule::Two: return "_two";
+            case PluralRule::Few: return "_few";
+            case PluralRule::Many: return "_many";
+            case PluralRule::Other: break;
+        }
+        return "_other";
     }
 };
 
@@ -372,6 +510,7 @@ bool Localization::setLanguage(const std::string& languageCode) {
     }
     
     pImpl->currentLanguage = languageCode;
+    pImpl->catalogDirty = true;
     
     // Notify listeners
     for (const auto& callback : pImpl->callbacks) {
@@ -449,8 +588,10 @@ std::string Localization::getContext(const std::string& context, const std::stri
 
 std::string Localization::format(const std::string& key, 
                                  const std::vector<FormatArg>& args) const {
-    std::string text = get(key);
-    return pImpl->formatString(text, args);
+    if (const auto* entry = pImpl->findEntry(key)) {
+        return Impl::render(entry->text, entry->segments, args);
+    }
+    return pImpl->formatString(get(key), args);
 }
 
 std::string Localization::format(const std::string& key,
@@ -464,22 +605,32 @@ std::string Localization::plural(const std::string& key, int count) const {
 
 std::string Localization::plural(const std::string& key, int count,
                                  const std::vector<FormatArg>& args) const {
-    PluralRule rule = pImpl->getPluralRule(pImpl->currentLanguage, count);
-    std::string pluralKey = pImpl->getPluralKey(key, rule);
-    
-    // Try specific plural form
-    std::string text = pImpl->getString(pluralKey, "");
-    if (text.empty() || text == pluralKey) {
-        // Try _other form
-        pluralKey = pImpl->getPluralKey(key, PluralRule::Other);
-        text = pImpl->getString(pluralKey, "");
-        if (text.empty() || text == pluralKey) {
-            // Fall back to base key
-            text = get(key);
-        }
+    const auto* entry = pImpl->findPlural(stringId(key), count);
+    if (entry && entry->key.compare(0, key.size(), key) == 0) {
+        return Impl::render(entry->text, entry->segments, args);
     }
     
-    return pImpl->formatString(text, args);
+    // Fall back to base key
+    return pImpl->formatString(get(key), args);
+}
+
+const char* Localization::text(StringId id, const char* defaultValue) const {
+    const auto* entry = pImpl->findEntry(id);
+    return entry ? entry->text.c_str() : defaultValue;
+}
+
+std::string Localization::format(StringId id, const std::vector<FormatArg>& args) const {
+    const auto* entry = pImpl->findEntry(id);
+    return entry ? Impl::render(entry->text, entry->segments, args) : std::string();
+}
+
+std::string Localization::plural(StringId id, int count) const {
+    return plural(id, count, {FormatArg("count", count)});
+}
+
+std::string Localization::plural(StringId id, int count, const std::vector<FormatArg>& args) const {
+    const auto* entry = pImpl->findPlural(id, count);
+    return entry ? Impl::render(entry->text, entry->segments, args) : std::string();
 }
 
 std::string Localization::formatNumber(double number, int decimals) const {
@@ -598,6 +749,7 @@ std::string Localization::formatRelativeTime(time_t timestamp) const {
 
 bool Localization::addString(const std::string& key, const std::string& value) {
     pImpl->strings[pImpl->currentLanguage][key] = value;
+    pImpl->catalogDirty = true;
     return true;
 }
 
@@ -703,6 +855,7 @@ bool Localization::importStrings(const std::string& filePath) {
         for (const auto& [key, value] : strings) {
             pImpl->strings[pImpl->currentLanguage][key] = value;
         }
+        pImpl->catalogDirty = true;
         
         return true;
     } catch (...) {
@@ -715,7 +868,13 @@ void Localization::setShowMissingKeys(bool show) {
 }
 
 std::vector<std::string> Localization::getUsedKeys() const {
-    return std::vector<std::string>(pImpl->usedKeys.begin(), pImpl->usedKeys.end());
+    std::set<std::string> keys = pImpl->usedKeys;
+    for (const auto& entry : pImpl->catalog) {
+        if (entry.used) {
+            keys.insert(entry.key);
+        }
+    }
+    return std::vector<std::string>(keys.begin(), keys.end());
 }
 
 }} // namespace opacity::core
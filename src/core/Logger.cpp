@@ -1,32 +1,72 @@
 #include "opacity/core/Logger.h"
 
+#include <spdlog/async.h>
+
+#include <algorithm>
+#include <mutex>
+#include <optional>
+
 namespace opacity::core
 {
+    namespace
+    {
+        std::mutex levels_mutex;
+        spdlog::level::level_enum global_level = spdlog::level::info;
+        std::array<std::optional<spdlog::level::level_enum>, static_cast<size_t>(LogSubsystem::Count)> overrides;
+    }
+
     std::shared_ptr<spdlog::logger> Logger::instance_ = nullptr;
+    std::array<std::atomic<int>, Logger::kSubsystems> Logger::levels_{};
 
     void Logger::Initialize(const std::string& log_level)
     {
+        Initialize(log_level, LogOptions{});
+    }
+
+    void Logger::Initialize(const std::string& log_level, const LogOptions& options)
+    {
+        {
+            std::lock_guard<std::mutex> lock(levels_mutex);
+            global_level = spdlog::level::from_str(log_level);
+        }
+
         try
         {
-            auto max_size = 1024 * 1024 * 10; // 10 MB
-            auto max_files = 3;
             auto sink = std::make_shared<spdlog::sinks::basic_file_sink_mt>(
                 "opacity.log", false);
 
-            auto logger = std::make_shared<spdlog::logger>("opacity", sink);
-            logger->set_level(spdlog::level::from_str(log_level));
+            std::shared_ptr<spdlog::logger> logger;
+            if (options.async)
+            {
+                // One worker keeps the file in order; the queue is fixed,
+                // so a burst costs memory up front rather than growing
+                spdlog::init_thread_pool(std::max<size_t>(options.queue_size, 1), 1);
+                logger = std::make_shared<spdlog::async_logger>(
+                    "opacity", sink, spdlog::thread_pool(),
+                    options.block_when_full ? spdlog::async_overflow_policy::block
+                                            : spdlog::async_overflow_policy::overrun_oldest);
+            }
+            else
+            {
+                logger = std::make_shared<spdlog::logger>("opacity", sink);
+            }
             logger->flush_on(spdlog::level::err);
 
+            spdlog::drop("opacity");
             spdlog::set_default_logger(logger);
+            if (options.async && options.flush_interval.count() > 0)
+                spdlog::flush_every(options.flush_interval);
             instance_ = logger;
+            ApplyLevels();
 
-            SPDLOG_INFO("Logger initialized");
+            SPDLOG_INFO("Logger initialized ({})", options.async ? "async" : "sync");
         }
         catch (const spdlog::spdlog_ex& ex)
         {
             // Fallback to console logging
             auto console_sink = std::make_shared<spdlog::sinks::wincolor_stdout_sink_mt>();
             instance_ = std::make_shared<spdlog::logger>("opacity", console_sink);
+            ApplyLevels();
             SPDLOG_ERROR("Failed to initialize file logger: {}", ex.what());
         }
     }
@@ -45,18 +85,57 @@ namespace opacity::core
         if (instance_)
         {
             instance_->flush();
-            spdlog::drop("opacity");
             instance_ = nullptr;
+
+            // Stops the flusher, then drains the queue and joins the worker
+            spdlog::shutdown();
         }
     }
 
     void Logger::SetLevel(const std::string& level)
     {
+        {
+            std::lock_guard<std::mutex> lock(levels_mutex);
+            global_level = spdlog::level::from_str(level);
+        }
         if (instance_)
         {
-            instance_->set_level(spdlog::level::from_str(level));
+            ApplyLevels();
             SPDLOG_INFO("Log level changed to: {}", level);
         }
     }
 
+    void Logger::SetSubsystemLevel(LogSubsystem subsystem, const std::string& level)
+    {
+        if (subsystem >= LogSubsystem::Count)
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(levels_mutex);
+            auto& entry = overrides[static_cast<size_t>(subsystem)];
+            if (level.empty())
+                entry.reset();
+            else
+                entry = spdlog::level::from_str(level);
+        }
+        ApplyLevels();
+    }
+
+    void Logger::ApplyLevels()
+    {
+        std::lock_guard<std::mutex> lock(levels_mutex);
+
+        // The logger passes whatever the most verbose subsystem wants; the
+        // macros have already filtered by subsystem before it sees anything
+        auto lowest = global_level;
+        for (size_t i = 0; i < kSubsystems; ++i)
+        {
+            auto level = overrides[i].value_or(global_level);
+            levels_[i].store(static_cast<int>(level), std::memory_order_relaxed);
+            lowest = std::min(lowest, level);
+        }
+        if (instance_)
+            instance_->set_level(lowest);
+    }
+
 } // namespace opacity::core
@@ -0,0 +1,235 @@
+#include "opacity/core/MappedFile.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/Logger.h"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace opacity::core
+{
+    MappedView::MappedView(void* base, size_t mapped, const uint8_t* data, size_t size, uint64_t offset)
+        : base_(base)
+        , mapped_(mapped)
+        , data_(data)
+        , size_(size)
+        , offset_(offset)
+    {
+    }
+
+    MappedView::~MappedView()
+    {
+        if (!base_) {
+            return;
+        }
+#ifdef _WIN32
+        UnmapViewOfFile(base_);
+#else
+        ::munmap(base_, mapped_);
+#endif
+    }
+
+    MappedFile::~MappedFile()
+    {
+        Close();
+    }
+
+    MappedFile::MappedFile(MappedFile&& other) noexcept
+    {
+        *this = std::move(other);
+    }
+
+    MappedFile& MappedFile::operator=(MappedFile&& other) noexcept
+    {
+        if (this != &other) {
+            Close();
+            data_ = std::exchange(other.data_, nullptr);
+            file_size_ = std::exchange(other.file_size_, 0);
+            granularity_ = other.granularity_;
+            open_ = std::exchange(other.open_, false);
+            file_ = std::exchange(other.file_, nullptr);
+            mapping_ = std::exchange(other.mapping_, nullptr);
+            fd_ = std::exchange(other.fd_, -1);
+
+            std::scoped_lock lock(window_mutex_, other.window_mutex_);
+            window_ = std::move(other.window_);
+        }
+        return *this;
+    }
+
+    bool MappedFile::Open(const std::filesystem::path& path, const MappedFileOptions& options)
+    {
+        Close();
+
+#ifdef _WIN32
+        DWORD share = FILE_SHARE_READ | FILE_SHARE_DELETE | (options.share_write ? FILE_SHARE_WRITE : 0);
+        HANDLE file = CreateFileW(path.wstring().c_str(), GENERIC_READ, share, nullptr, OPEN_EXISTING,
+            FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+        if (file == INVALID_HANDLE_VALUE) {
+            return false;
+        }
+        BackgroundScope::HintFileHandle(file);
+
+        LARGE_INTEGER fileSize;
+        if (!GetFileSizeEx(file, &fileSize) || (options.map_whole && fileSize.QuadPart == 0)) {
+            CloseHandle(file);
+            return false;
+        }
+
+        // An empty file cannot be mapped, and has nothing to read anyway
+        HANDLE mapping = nullptr;
+        if (fileSize.QuadPart > 0) {
+            mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+            if (!mapping) {
+                Logger::Get()->warn("MappedFile: failed to map {}: {}", path.string(), GetLastError());
+                CloseHandle(file);
+                return false;
+            }
+        }
+
+        if (options.map_whole) {
+            void* view = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            if (!view) {
+                CloseHandle(mapping);
+                CloseHandle(file);
+                return false;
+            }
+            data_ = static_cast<const uint8_t*>(view);
+            file_ = file;
+        } else {
+            // The section keeps the file open
+            CloseHandle(file);
+        }
+
+        SYSTEM_INFO info = {};
+        GetSystemInfo(&info);
+        granularity_ = info.dwAllocationGranularity;
+        mapping_ = mapping;
+        file_size_ = static_cast<uint64_t>(fileSize.QuadPart);
+        open_ = true;
+        return true;
+#else
+        (void)options.share_write;
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st {};
+        if (::fstat(fd, &st) != 0 || (options.map_whole && st.st_size == 0)) {
+            ::close(fd);
+            return false;
+        }
+
+        if (options.map_whole) {
+            void* view = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            ::close(fd);
+            if (view == MAP_FAILED) {
+                return false;
+            }
+            data_ = static_cast<const uint8_t*>(view);
+        } else {
+            fd_ = fd;
+        }
+
+        granularity_ = static_cast<uint32_t>(::sysconf(_SC_PAGESIZE));
+        file_size_ = static_cast<uint64_t>(st.st_size);
+        open_ = true;
+        return true;
+#endif
+    }
+
+    void MappedFile::Close()
+    {
+        {
+            std::lock_guard<std::mutex> lock(window_mutex_);
+            window_.reset();
+        }
+#ifdef _WIN32
+        if (data_) UnmapViewOfFile(data_);
+        if (mapping_) CloseHandle(mapping_);
+        if (file_) CloseHandle(file_);
+#else
+        if (data_) ::munmap(const_cast<uint8_t*>(data_), static_cast<size_t>(file_size_));
+        if (fd_ >= 0) ::close(fd_);
+#endif
+        data_ = nullptr;
+        file_size_ = 0;
+        open_ = false;
+        file_ = nullptr;
+        mapping_ = nullptr;
+        fd_ = -1;
+    }
+
+    std::string_view MappedFile::View(uint64_t offset, uint64_t length) const
+    {
+        if (!data_ || offset > file_size_ || length > file_size_ - offset) {
+            return {};
+        }
+        return std::string_view(reinterpret_cast<const char*>(data_ + offset),
+            static_cast<size_t>(length));
+    }
+
+    std::shared_ptr<const MappedView> MappedFile::Map(uint64_t offset, size_t length) const
+    {
+        if (!open_ || offset >= file_size_ || length == 0) {
+            return nullptr;
+        }
+        length = static_cast<size_t>(std::min<uint64_t>(length, file_size_ - offset));
+
+        // A whole mapping already covers it; the view just borrows it
+        if (data_) {
+            return std::make_shared<MappedView>(nullptr, 0, data_ + offset, length, offset);
+        }
+
+        // Views start on the allocation granularity
+        uint64_t base = offset - offset % granularity_;
+        size_t delta = static_cast<size_t>(offset - base);
+#ifdef _WIN32
+        void* mapped = MapViewOfFile(mapping_, FILE_MAP_READ, static_cast<DWORD>(base >> 32),
+            static_cast<DWORD>(base & 0xFFFFFFFF), delta + length);
+        if (!mapped) {
+            Logger::Get()->warn("MappedFile: failed to map {} bytes at {}: {}", length, offset, GetLastError());
+            return nullptr;
+        }
+#else
+        void* mapped = ::mmap(nullptr, delta + length, PROT_READ, MAP_PRIVATE, fd_, static_cast<off_t>(base));
+        if (mapped == MAP_FAILED) {
+            Logger::Get()->warn("MappedFile: failed to map {} bytes at {}", length, offset);
+            return nullptr;
+        }
+#endif
+        return std::make_shared<MappedView>(mapped, delta + length,
+            static_cast<const uint8_t*>(mapped) + delta, length, offset);
+    }
+
+    std::shared_ptr<const MappedView> MappedFile::Window(uint64_t offset, size_t length) const
+    {
+        if (offset >= file_size_) {
+            return nullptr;
+        }
+        uint64_t end = std::min<uint64_t>(offset + length, file_size_);
+
+        std::lock_guard<std::mutex> lock(window_mutex_);
+        if (window_ && offset >= window_->Offset() && end <= window_->Offset() + window_->Size()) {
+            return window_;
+        }
+
+        // Centred on the offset, so scrolling either way stays inside it
+        uint64_t start = offset > kWindowSize / 2 ? offset - kWindowSize / 2 : 0;
+        size_t span = static_cast<size_t>(std::max<uint64_t>(kWindowSize, end - start));
+        window_ = Map(start, span);
+        return window_;
+    }
+
+} // namespace opacity::core
@@ -0,0 +1,382 @@
+#include "opacity/core/MemoryGovernor.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace opacity::core
+{
+    namespace
+    {
+        constexpr auto kInterval = std::chrono::milliseconds(1000);
+
+        size_t PhysicalMemory()
+        {
+#ifdef _WIN32
+            MEMORYSTATUSEX status = {};
+            status.dwLength = sizeof(status);
+            if (GlobalMemoryStatusEx(&status))
+                return static_cast<size_t>(status.ullTotalPhys);
+            return 0;
+#else
+            long pages = sysconf(_SC_PHYS_PAGES);
+            long page_size = sysconf(_SC_PAGE_SIZE);
+            return pages > 0 && page_size > 0 ? static_cast<size_t>(pages) * static_cast<size_t>(page_size) : 0;
+#endif
+        }
+
+        double Megabytes(size_t bytes)
+        {
+            return bytes / (1024.0 * 1024.0);
+        }
+    }
+
+    struct MemoryGovernor::Impl
+    {
+        struct Entry
+        {
+            uint64_t id = 0;
+            std::string name;
+            CostFunction cost;
+            TrimFunction trim;
+            size_t bytes = 0;
+            uint64_t trims = 0;
+            size_t trimmed_bytes = 0;
+        };
+
+        // Held while calling into a cache, so unregistering waits for the
+        // call to return; recursive for a trim that drops a registration
+        std::recursive_mutex call_mutex;
+
+        mutable std::mutex mutex;
+        std::vector<Entry> entries;
+        uint64_t next_id = 1;
+        size_t fixed_budget = 0;
+        double budget_percent = kDefaultBudgetPercent;
+        size_t physical = PhysicalMemory();
+        bool low_memory = false;
+        uint64_t enforcements = 0;
+
+        std::thread thread;
+        std::mutex stop_mutex;
+        std::condition_variable stop_wake;
+        bool stop = false;
+#ifdef _WIN32
+        HANDLE stop_event = nullptr;
+        HANDLE low_memory_event = nullptr;
+#endif
+
+        // Called with mutex held
+        size_t BudgetLocked() const
+        {
+            if (fixed_budget > 0)
+                return fixed_budget;
+            return static_cast<size_t>(physical * (budget_percent / 100.0));
+        }
+
+        bool Registered(uint64_t id)
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            return std::any_of(entries.begin(), entries.end(), [id](const Entry& entry) { return entry.id == id; });
+        }
+
+        bool IsLowMemory() const
+        {
+#ifdef _WIN32
+            BOOL low = FALSE;
+            return low_memory_event && QueryMemoryResourceNotification(low_memory_event, &low) && low;
+#else
+            return false;
+#endif
+        }
+    };
+
+    // ============== Registration ==============
+
+    MemoryGovernor::Registration::~Registration()
+    {
+        Reset();
+    }
+
+    MemoryGovernor::Registration::Registration(Registration&& other) noexcept
+        : id_(other.id_)
+    {
+        other.id_ = 0;
+    }
+
+    MemoryGovernor::Registration& MemoryGovernor::Registration::operator=(Registration&& other) noexcept
+    {
+        if (this != &other)
+        {
+            Reset();
+            id_ = other.id_;
+            other.id_ = 0;
+        }
+        return *this;
+    }
+
+    void MemoryGovernor::Registration::Reset()
+    {
+        if (id_)
+        {
+            MemoryGovernor::Get().Unregister(id_);
+            id_ = 0;
+        }
+    }
+
+    // ============== MemoryGovernor ==============
+
+    MemoryGovernor& MemoryGovernor::Get()
+    {
+        static MemoryGovernor governor;
+        return governor;
+    }
+
+    MemoryGovernor::MemoryGovernor()
+        : impl_(std::make_unique<Impl>())
+    {
+    }
+
+    MemoryGovernor::~MemoryGovernor()
+    {
+        Stop();
+    }
+
+    MemoryGovernor::Registration MemoryGovernor::Register(std::string name, CostFunction cost, TrimFunction trim)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        Impl::Entry entry;
+        entry.id = impl_->next_id++;
+        entry.name = std::move(name);
+        entry.cost = std::move(cost);
+        entry.trim = std::move(trim);
+        impl_->entries.push_back(std::move(entry));
+        return Registration(impl_->entries.back().id);
+    }
+
+    void MemoryGovernor::Unregister(uint64_t id)
+    {
+        std::lock_guard<std::recursive_mutex> calls(impl_->call_mutex);
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        auto& entries = impl_->entries;
+        entries.erase(std::remove_if(entries.begin(), entries.end(),
+                                     [id](const Impl::Entry& entry) { return entry.id == id; }),
+                      entries.end());
+    }
+
+    void MemoryGovernor::SetBudget(size_t bytes)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->fixed_budget = bytes;
+    }
+
+    void MemoryGovernor::SetBudgetPercent(double percent)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->fixed_budget = 0;
+        impl_->budget_percent = std::clamp(percent, 1.0, 90.0);
+    }
+
+    size_t MemoryGovernor::GetBudget() const
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        return impl_->BudgetLocked();
+    }
+
+    void MemoryGovernor::Start()
+    {
+        if (impl_->thread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(impl_->stop_mutex);
+            impl_->stop = false;
+        }
+#ifdef _WIN32
+        impl_->stop_event = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        impl_->low_memory_event = CreateMemoryResourceNotification(LowMemoryResourceNotification);
+        if (!impl_->low_memory_event)
+            Logger::Get()->warn("MemoryGovernor: no low-memory notification ({}); enforcing the budget only",
+                                GetLastError());
+#endif
+        impl_->thread = std::thread(&MemoryGovernor::Run, this);
+        Logger::Get()->info("MemoryGovernor: budget {:.0f} MB", Megabytes(GetBudget()));
+    }
+
+    void MemoryGovernor::Stop()
+    {
+        if (!impl_->thread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(impl_->stop_mutex);
+            impl_->stop = true;
+        }
+        impl_->stop_wake.notify_all();
+#ifdef _WIN32
+        SetEvent(impl_->stop_event);
+#endif
+        impl_->thread.join();
+
+#ifdef _WIN32
+        CloseHandle(impl_->stop_event);
+        impl_->stop_event = nullptr;
+        if (impl_->low_memory_event)
+            CloseHandle(impl_->low_memory_event);
+        impl_->low_memory_event = nullptr;
+#endif
+    }
+
+    void MemoryGovernor::Run()
+    {
+        Profiler::SetThreadName("Memory governor");
+#ifdef _WIN32
+        HANDLE events[] = {impl_->stop_event, impl_->low_memory_event};
+        DWORD count = impl_->low_memory_event ? 2 : 1;
+        DWORD interval = static_cast<DWORD>(kInterval.count());
+        while (true)
+        {
+            DWORD result = WaitForMultipleObjects(count, events, FALSE, interval);
+            if (result == WAIT_OBJECT_0)
+                break;
+
+            Enforce();
+
+            // The signal stays set while memory is low; wait out a pass
+            // before looking at it again rather than trimming in a loop
+            if (result == WAIT_OBJECT_0 + 1 && WaitForSingleObject(impl_->stop_event, interval) == WAIT_OBJECT_0)
+                break;
+        }
+#else
+        std::unique_lock<std::mutex> lock(impl_->stop_mutex);
+        while (!impl_->stop_wake.wait_for(lock, kInterval, [this] { return impl_->stop; }))
+        {
+            lock.unlock();
+            Enforce();
+            lock.lock();
+        }
+#endif
+    }
+
+    void MemoryGovernor::Enforce()
+    {
+        OPACITY_PROFILE_ZONE("MemoryGovernor::Enforce");
+        std::lock_guard<std::recursive_mutex> calls(impl_->call_mutex);
+
+        struct Measured
+        {
+            uint64_t id;
+            CostFunction cost;
+            TrimFunction trim;
+            size_t bytes = 0;
+            size_t released = 0;
+            bool trimmed = false;
+        };
+
+        std::vector<Measured> caches;
+        size_t budget = 0;
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex);
+            budget = impl_->BudgetLocked();
+            caches.reserve(impl_->entries.size());
+            for (const auto& entry : impl_->entries)
+            {
+                caches.push_back({entry.id, entry.cost, entry.trim});
+            }
+        }
+
+        size_t total = 0;
+        for (auto& cache : caches)
+        {
+            cache.bytes = cache.cost ? cache.cost() : 0;
+            total += cache.bytes;
+        }
+
+        bool low = impl_->IsLowMemory();
+        size_t limit = low ? std::min(budget, total) / 2 : budget;
+        bool over = budget > 0 && total > limit;
+        if (over)
+        {
+            size_t target = low ? limit : static_cast<size_t>(limit * kTrimTarget);
+            size_t excess = total - target;
+            Logger::Get()->info("MemoryGovernor: {:.0f} MB held against {:.0f} MB{}; trimming {:.0f} MB",
+                                Megabytes(total), Megabytes(limit), low ? " (memory is low)" : "",
+                                Megabytes(excess));
+
+            for (auto& cache : caches)
+            {
+                if (cache.bytes == 0 || !cache.trim || !impl_->Registered(cache.id))
+                    continue;
+
+                // Each gives up its share of the excess, so no one cache
+                // is emptied for the others
+                size_t cut = static_cast<size_t>(static_cast<double>(excess) * cache.bytes / total);
+                cache.trim(cut < cache.bytes ? cache.bytes - cut : 0);
+
+                size_t after = cache.cost ? cache.cost() : 0;
+                cache.released = after < cache.bytes ? cache.bytes - after : 0;
+                cache.bytes = after;
+                cache.trimmed = true;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->low_memory = low;
+        if (over)
+            ++impl_->enforcements;
+        for (auto& entry : impl_->entries)
+        {
+            auto it = std::find_if(caches.begin(), caches.end(),
+                                   [&entry](const Measured& cache) { return cache.id == entry.id; });
+            if (it == caches.end())
+                continue;
+
+            entry.bytes = it->bytes;
+            if (it->trimmed)
+            {
+                ++entry.trims;
+                entry.trimmed_bytes += it->released;
+            }
+        }
+    }
+
+    std::vector<CacheUsage> MemoryGovernor::GetUsage() const
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        std::vector<CacheUsage> usage;
+        usage.reserve(impl_->entries.size());
+        for (const auto& entry : impl_->entries)
+        {
+            usage.push_back({entry.name, entry.bytes, entry.trims, entry.trimmed_bytes});
+        }
+        return usage;
+    }
+
+    MemoryStatus MemoryGovernor::GetStatus() const
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        MemoryStatus status;
+        status.budget_bytes = impl_->BudgetLocked();
+        status.physical_bytes = impl_->physical;
+        status.low_memory = impl_->low_memory;
+        status.enforcements = impl_->enforcements;
+        for (const auto& entry : impl_->entries)
+        {
+            status.used_bytes += entry.bytes;
+        }
+        return status;
+    }
+
+} // namespace opacity::core
@@ -0,0 +1,478 @@
+#include "opacity/core/Metrics.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/SnapshotFile.h"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <thread>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace opacity::core
+{
+    namespace
+    {
+        inline unsigned HighestBit(uint64_t value)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanReverse64(&index, value);
+            return static_cast<unsigned>(index);
+#else
+            return 63u - static_cast<unsigned>(__builtin_clzll(value));
+#endif
+        }
+
+        const char* TypeName(MetricType type)
+        {
+            switch (type)
+            {
+            case MetricType::Counter: return "counter";
+            case MetricType::Gauge: return "gauge";
+            case MetricType::Histogram: return "histogram";
+            }
+            return "untyped";
+        }
+
+        // Escapes for a Prometheus label value or a JSON string; both use
+        // backslash escapes for quotes, backslashes and newlines
+        void AppendEscaped(std::string& out, std::string_view text, bool json)
+        {
+            for (char c : text)
+            {
+                switch (c)
+                {
+                case '"': out += "\\\""; break;
+                case '\\': out += "\\\\"; break;
+                case '\n': out += "\\n"; break;
+                default:
+                    if (json && static_cast<unsigned char>(c) < 0x20)
+                    {
+                        char escape[8];
+                        std::snprintf(escape, sizeof(escape), "\\u%04x", static_cast<unsigned>(c));
+                        out += escape;
+                    }
+                    else
+                    {
+                        out += c;
+                    }
+                    break;
+                }
+            }
+        }
+
+        // {a="1",b="2"}, with extra as one more label; empty for no labels
+        std::string PrometheusLabels(const MetricLabels& labels, std::string_view extra = {})
+        {
+            if (labels.empty() && extra.empty())
+                return {};
+
+            std::string out = "{";
+            for (const auto& [name, value] : labels)
+            {
+                if (out.size() > 1)
+                    out += ',';
+                out += name;
+                out += "=\"";
+                AppendEscaped(out, value, false);
+                out += '"';
+            }
+            if (!extra.empty())
+            {
+                if (out.size() > 1)
+                    out += ',';
+                out += extra;
+            }
+            out += '}';
+            return out;
+        }
+    }
+
+    // ============== Histogram ==============
+
+    size_t Histogram::BucketOf(uint64_t value)
+    {
+        if (value < kSubBuckets)
+            return static_cast<size_t>(value);
+
+        // The leading bit and the kSubBits after it pick the bucket
+        unsigned shift = HighestBit(value) - kSubBits;
+        size_t sub = static_cast<size_t>(value >> shift) - kSubBuckets;
+        return kSubBuckets + shift * kSubBuckets + sub;
+    }
+
+    uint64_t Histogram::BucketLow(size_t bucket)
+    {
+        if (bucket < kSubBuckets)
+            return bucket;
+
+        size_t shift = (bucket - kSubBuckets) / kSubBuckets;
+        size_t sub = (bucket - kSubBuckets) % kSubBuckets;
+        return static_cast<uint64_t>(kSubBuckets + sub) << shift;
+    }
+
+    uint64_t Histogram::BucketHigh(size_t bucket)
+    {
+        if (bucket < kSubBuckets)
+            return bucket;
+
+        size_t shift = (bucket - kSubBuckets) / kSubBuckets;
+        return BucketLow(bucket) + ((uint64_t{1} << shift) - 1);
+    }
+
+    void Histogram::Record(uint64_t value)
+    {
+        buckets_[BucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(value, std::memory_order_relaxed);
+
+        uint64_t seen = min_.load(std::memory_order_relaxed);
+        while (value < seen && !min_.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+        {
+        }
+        seen = max_.load(std::memory_order_relaxed);
+        while (value > seen && !max_.compare_exchange_weak(seen, value, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    HistogramSummary Histogram::Summarize() const
+    {
+        // Read while others record, so the bucket total is what the
+        // percentiles are taken over, not count_
+        std::array<uint64_t, kBucketCount> counts;
+        uint64_t total = 0;
+        for (size_t i = 0; i < kBucketCount; ++i)
+        {
+            counts[i] = buckets_[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+
+        HistogramSummary summary;
+        summary.count = count_.load(std::memory_order_relaxed);
+        summary.sum = sum_.load(std::memory_order_relaxed);
+        if (total == 0)
+            return summary;
+
+        summary.min = min_.load(std::memory_order_relaxed);
+        summary.max = max_.load(std::memory_order_relaxed);
+
+        // The highest value of the bucket holding each rank, within the
+        // extremes actually seen
+        auto percentile = [&](double fraction)
+        {
+            uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(fraction * static_cast<double>(total) + 0.5));
+            uint64_t seen = 0;
+            for (size_t i = 0; i < kBucketCount; ++i)
+            {
+                seen += counts[i];
+                if (seen >= rank)
+                    return std::clamp(BucketHigh(i), summary.min, summary.max);
+            }
+            return summary.max;
+        };
+        summary.p50 = percentile(0.50);
+        summary.p90 = percentile(0.90);
+        summary.p99 = percentile(0.99);
+        return summary;
+    }
+
+    // ============== Metrics ==============
+
+    struct Metrics::Impl
+    {
+        struct Series
+        {
+            std::string name;
+            MetricLabels labels;
+            MetricType type = MetricType::Counter;
+            std::unique_ptr<Counter> counter;
+            std::unique_ptr<Gauge> gauge;
+            std::unique_ptr<Histogram> histogram;
+        };
+
+        mutable std::mutex mutex;
+        std::map<std::string, Series> series;     // By name and then labels, as exported
+        MetricLabels constant_labels;
+
+        // Handed out when a name is asked for as a second type, so the
+        // caller still has something to update
+        Counter stray_counter;
+        Gauge stray_gauge;
+        Histogram stray_histogram;
+
+        std::thread thread;
+        std::mutex stop_mutex;
+        std::condition_variable stop_wake;
+        bool stop = false;
+
+        Series* Find(std::string_view name, const MetricLabels& labels, MetricType type)
+        {
+            // The space sorts below any name character, so the series of
+            // one name stay together ahead of longer names
+            std::string key(name);
+            key += ' ';
+            key += PrometheusLabels(labels);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            auto [it, added] = series.try_emplace(std::move(key));
+            Series& found = it->second;
+            if (added)
+            {
+                found.name = std::string(name);
+                found.labels = labels;
+                found.type = type;
+                switch (type)
+                {
+                case MetricType::Counter: found.counter = std::make_unique<Counter>(); break;
+                case MetricType::Gauge: found.gauge = std::make_unique<Gauge>(); break;
+                case MetricType::Histogram: found.histogram = std::make_unique<Histogram>(); break;
+                }
+            }
+            else if (found.type != type)
+            {
+                Logger::Get()->error("Metrics: {} is a {}, not a {}", it->first, TypeName(found.type),
+                                     TypeName(type));
+                return nullptr;
+            }
+            return &found;
+        }
+    };
+
+    Metrics& Metrics::Get()
+    {
+        static Metrics metrics;
+        return metrics;
+    }
+
+    Metrics::Metrics()
+        : impl_(std::make_unique<Impl>())
+    {
+    }
+
+    Metrics::~Metrics()
+    {
+        StopExport();
+    }
+
+    Counter& Metrics::GetCounter(std::string_view name, const MetricLabels& labels)
+    {
+        auto* series = impl_->Find(name, labels, MetricType::Counter);
+        return series ? *series->counter : impl_->stray_counter;
+    }
+
+    Gauge& Metrics::GetGauge(std::string_view name, const MetricLabels& labels)
+    {
+        auto* series = impl_->Find(name, labels, MetricType::Gauge);
+        return series ? *series->gauge : impl_->stray_gauge;
+    }
+
+    Histogram& Metrics::GetHistogram(std::string_view name, const MetricLabels& labels)
+    {
+        auto* series = impl_->Find(name, labels, MetricType::Histogram);
+        return series ? *series->histogram : impl_->stray_histogram;
+    }
+
+    void Metrics::SetConstantLabels(MetricLabels labels)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        impl_->constant_labels = std::move(labels);
+    }
+
+    std::vector<MetricSample> Metrics::Snapshot() const
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex);
+        std::vector<MetricSample> samples;
+        samples.reserve(impl_->series.size());
+        for (const auto& [key, series] : impl_->series)
+        {
+            MetricSample sample;
+            sample.name = series.name;
+            sample.labels = series.labels;
+            sample.type = series.type;
+            if (series.counter)
+                sample.counter = series.counter->Get();
+            if (series.gauge)
+                sample.gauge = series.gauge->Get();
+            if (series.histogram)
+                sample.histogram = series.histogram->Summarize();
+            samples.push_back(std::move(sample));
+        }
+        return samples;
+    }
+
+    std::string Metrics::ToPrometheus() const
+    {
+        MetricLabels constant;
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex);
+            constant = impl_->constant_labels;
+        }
+
+        // Histograms go out as summaries; the buckets are far too many
+        // for the text format
+        std::string out;
+        std::string last_name;
+        for (auto& sample : Snapshot())
+        {
+            MetricLabels labels = constant;
+            labels.insert(labels.end(), sample.labels.begin(), sample.labels.end());
+
+            if (sample.name != last_name)
+            {
+                out += "# TYPE " + sample.name + ' ' +
+                       (sample.type == MetricType::Histogram ? "summary" : TypeName(sample.type)) + '\n';
+                last_name = sample.name;
+            }
+
+            switch (sample.type)
+            {
+            case MetricType::Counter:
+                out += sample.name + PrometheusLabels(labels) + ' ' + std::to_string(sample.counter) + '\n';
+                break;
+            case MetricType::Gauge:
+                out += sample.name + PrometheusLabels(labels) + ' ' + std::to_string(sample.gauge) + '\n';
+                break;
+            case MetricType::Histogram:
+            {
+                const HistogramSummary& h = sample.histogram;
+                const std::pair<const char*, uint64_t> quantiles[] = {
+                    {"quantile=\"0.5\"", h.p50}, {"quantile=\"0.9\"", h.p90},
+                    {"quantile=\"0.99\"", h.p99}, {"quantile=\"1\"", h.max}};
+                for (const auto& [quantile, value] : quantiles)
+                    out += sample.name + PrometheusLabels(labels, quantile) + ' ' + std::to_string(value) + '\n';
+                out += sample.name + "_sum" + PrometheusLabels(labels) + ' ' + std::to_string(h.sum) + '\n';
+                out += sample.name + "_count" + PrometheusLabels(labels) + ' ' + std::to_string(h.count) + '\n';
+                break;
+            }
+            }
+        }
+        return out;
+    }
+
+    std::string Metrics::ToNdjson() const
+    {
+        MetricLabels constant;
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex);
+            constant = impl_->constant_labels;
+        }
+
+        auto now = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
+        std::string stamp = std::to_string(now);
+
+        std::string out;
+        for (auto& sample : Snapshot())
+        {
+            out += "{\"timestamp_ms\":" + stamp + ",\"name\":\"";
+            AppendEscaped(out, sample.name, true);
+            out += "\",\"type\":\"";
+            out += TypeName(sample.type);
+            out += "\",\"labels\":{";
+
+            bool first = true;
+            auto add_labels = [&](const MetricLabels& labels)
+            {
+                for (const auto& [name, value] : labels)
+                {
+                    if (!first)
+                        out += ',';
+                    first = false;
+                    out += '"';
+                    AppendEscaped(out, name, true);
+                    out += "\":\"";
+                    AppendEscaped(out, value, true);
+                    out += '"';
+                }
+            };
+            add_labels(constant);
+            add_labels(sample.labels);
+            out += '}';
+
+            switch (sample.type)
+            {
+            case MetricType::Counter:
+                out += ",\"value\":" + std::to_string(sample.counter);
+                break;
+            case MetricType::Gauge:
+                out += ",\"value\":" + std::to_string(sample.gauge);
+                break;
+            case MetricType::Histogram:
+            {
+                const HistogramSummary& h = sample.histogram;
+                out += ",\"count\":" + std::to_string(h.count) + ",\"sum\":" + std::to_string(h.sum) +
+                       ",\"min\":" + std::to_string(h.min) + ",\"max\":" + std::to_string(h.max) +
+                       ",\"p50\":" + std::to_string(h.p50) + ",\"p90\":" + std::to_string(h.p90) +
+                       ",\"p99\":" + std::to_string(h.p99);
+                break;
+            }
+            }
+            out += "}\n";
+        }
+        return out;
+    }
+
+    bool Metrics::Export(const std::filesystem::path& file, MetricsFormat format) const
+    {
+        OPACITY_PROFILE_ZONE("Metrics::Export");
+        if (format == MetricsFormat::Prometheus)
+            return SnapshotFile::WriteAtomic(file, ToPrometheus());
+
+        std::error_code ec;
+        std::filesystem::create_directories(file.parent_path(), ec);
+        std::ofstream out(file, std::ios::binary | std::ios::app);
+        out << ToNdjson();
+        return static_cast<bool>(out);
+    }
+
+    void Metrics::StartExport(std::filesystem::path file, std::chrono::seconds interval, MetricsFormat format)
+    {
+        StopExport();
+        if (file.empty())
+            return;
+        if (interval.count() <= 0)
+            interval = kDefaultExportInterval;
+
+        {
+            std::lock_guard<std::mutex> lock(impl_->stop_mutex);
+            impl_->stop = false;
+        }
+        impl_->thread = std::thread([this, file = std::move(file), interval, format]()
+        {
+            Profiler::SetThreadName("Metrics export");
+            std::unique_lock<std::mutex> lock(impl_->stop_mutex);
+            bool stopping = false;
+            while (!stopping)
+            {
+                stopping = impl_->stop_wake.wait_for(lock, interval, [this] { return impl_->stop; });
+                lock.unlock();
+                if (!Export(file, format))
+                    Logger::Get()->warn("Metrics: failed to export to {}", file.u8string());
+                lock.lock();
+            }
+        });
+        Logger::Get()->info("Metrics: exporting every {} s", interval.count());
+    }
+
+    void Metrics::StopExport()
+    {
+        if (!impl_->thread.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lock(impl_->stop_mutex);
+            impl_->stop = true;
+        }
+        impl_->stop_wake.notify_all();
+        impl_->thread.join();
+    }
+
+} // namespace opacity::core
@@ -1,12 +1,31 @@
 #include "opacity/core/Path.h"
 
+#include <atomic>
+
 namespace opacity::core
 {
+    namespace
+    {
+        bool IsSeparator(std::filesystem::path::value_type c)
+        {
+#ifdef _WIN32
+            return c == L'\\' || c == L'/';
+#else
+            return c == '/';
+#endif
+        }
+    }
+
     Path::Path(const std::filesystem::path& path)
         : path_(path)
     {
     }
 
+    Path::Path(std::filesystem::path&& path)
+        : path_(std::move(path))
+    {
+    }
+
     Path::Path(const std::string& path_str)
         : path_(path_str)
     {
@@ -17,6 +36,81 @@ namespace opacity::core
     {
     }
 
+    Path::Path(PathView view)
+        : path_(NativeString(view.Native()))
+    {
+    }
+
+    // The cache is shared rather than copied; another thread may be
+    // filling the source's at the same time
+    Path::Path(const Path& other)
+        : path_(other.path_)
+        , converted_(std::atomic_load_explicit(&other.converted_, std::memory_order_acquire))
+    {
+    }
+
+    Path::Path(Path&& other) noexcept
+        : path_(std::move(other.path_))
+        , converted_(std::move(other.converted_))
+    {
+    }
+
+    Path& Path::operator=(const Path& other)
+    {
+        if (this != &other)
+        {
+            path_ = other.path_;
+            converted_ = std::atomic_load_explicit(&other.converted_, std::memory_order_acquire);
+        }
+        return *this;
+    }
+
+    Path& Path::operator=(Path&& other) noexcept
+    {
+        path_ = std::move(other.path_);
+        converted_ = std::move(other.converted_);
+        return *this;
+    }
+
+    const Path::ConvertedString& Path::Converted() const
+    {
+        auto cached = std::atomic_load_explicit(&converted_, std::memory_order_acquire);
+        if (!cached)
+        {
+#ifdef _WIN32
+            std::shared_ptr<const ConvertedString> fresh = std::make_shared<const ConvertedString>(path_.string());
+#else
+            std::shared_ptr<const ConvertedString> fresh = std::make_shared<const ConvertedString>(path_.wstring());
+#endif
+            // Whichever thread gets there first, both made the same string
+            if (std::atomic_compare_exchange_strong(&converted_, &cached, fresh))
+                cached = std::move(fresh);
+        }
+        return *cached;
+    }
+
+#ifdef _WIN32
+    const std::string& Path::String() const
+    {
+        return Converted();
+    }
+
+    const std::wstring& Path::WString() const
+    {
+        return path_.native();
+    }
+#else
+    const std::string& Path::String() const
+    {
+        return path_.native();
+    }
+
+    const std::wstring& Path::WString() const
+    {
+        return Converted();
+    }
+#endif
+
     Path Path::Parent() const
     {
         return Path(path_.parent_path());
@@ -89,8 +183,8 @@ namespace opacity::core
 
     bool Path::IsNetworkPath() const
     {
-        std::string path_str = path_.string();
-        return path_str.length() >= 2 && path_str[0] == '\\' && path_str[1] == '\\';
+        const auto& native = path_.native();
+        return native.length() >= 2 && native[0] == '\\' && native[1] == '\\';
     }
 
     bool Path::IsJunction() const
@@ -105,4 +199,35 @@ namespace opacity::core
         return Path();
     }
 
+    PathView::NativeView PathView::Filename() const
+    {
+        size_t begin = text_.size();
+        while (begin > 0 && !IsSeparator(text_[begin - 1]))
+            --begin;
+#ifdef _WIN32
+        // "C:name" is relative to the drive's current directory
+        if (begin == 0 && text_.size() >= 2 && text_[1] == L':')
+            begin = 2;
+#endif
+        return text_.substr(begin);
+    }
+
+    PathView::NativeView PathView::Extension() const
+    {
+        NativeView name = Filename();
+        if (name.size() <= 2 && name.find_first_not_of('.') == NativeView::npos)
+            return NativeView();
+
+        size_t dot = name.rfind('.');
+        if (dot == NativeView::npos || dot == 0)
+            return NativeView();
+        return name.substr(dot);
+    }
+
+    PathView::NativeView PathView::Stem() const
+    {
+        NativeView name = Filename();
+        return name.substr(0, name.size() - Extension().size());
+    }
+
 } // namespace opacity::core
@@ -1,9 +1,15 @@
 #include "opacity/core/PluginManager.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/FileHasher.h"
+#include "opacity/core/HashCache.h"
+#include "opacity/core/SnapshotFile.h"
 
 #include <algorithm>
+#include <atomic>
+#include <cctype>
 #include <fstream>
 #include <mutex>
+#include <thread>
 #include <nlohmann/json.hpp>
 
 #ifdef _WIN32
@@ -37,9 +43,217 @@ namespace opacity::core
         IPlugin* instance = nullptr;
         CreatePluginFunc createFunc = nullptr;
         DestroyPluginFunc destroyFunc = nullptr;
+        const OpacityPreviewPluginV2* previewAbi = nullptr;
+        std::shared_ptr<PreviewSource> previewSource;
         PluginInfo info;
     };
 
+    /**
+     * @brief A plugin exporting the C preview interface
+     */
+    class AbiPreviewSource final : public PreviewSource
+    {
+    public:
+        explicit AbiPreviewSource(const OpacityPreviewPluginV2* table) : table_(table) {}
+
+        bool CanPreview(const std::filesystem::path& path) const override
+        {
+            return !table_->can_preview || table_->can_preview(table_->instance, path.u8string().c_str()) != 0;
+        }
+
+        PluginPreview Render(const std::filesystem::path& path, int maxWidth, int maxHeight,
+                             std::vector<uint8_t>& buffer, const std::atomic<bool>* cancel,
+                             const std::function<void(float)>& progress) override
+        {
+            HostContext context{cancel, &progress};
+            std::string utf8Path = path.u8string();
+
+            OpacityPreviewRequest request = {};
+            request.struct_size = sizeof(request);
+            request.path_utf8 = utf8Path.c_str();
+            request.max_width = maxWidth;
+            request.max_height = maxHeight;
+            request.is_cancelled = &IsCancelled;
+            request.report_progress = &ReportProgress;
+            request.host_context = &context;
+
+            PluginPreview result;
+            for (int attempt = 0; attempt < 2; ++attempt) {
+                OpacityPreviewOutput output = {};
+                output.data = buffer.data();
+                output.capacity = buffer.size();
+
+                result.status = static_cast<OpacityPreviewStatus>(table_->render(table_->instance, &request, &output));
+                if (result.status == OPACITY_PREVIEW_BUFFER_TOO_SMALL && attempt == 0 &&
+                    output.size > buffer.size() && output.size <= kMaxPreviewBytes) {
+                    buffer.resize(static_cast<size_t>(output.size));
+                    continue;
+                }
+
+                if (result.status == OPACITY_PREVIEW_OK) {
+                    result.format = static_cast<OpacityPreviewFormat>(output.format);
+                    result.width = output.width;
+                    result.height = output.height;
+                    result.stride = output.stride;
+                    result.size = static_cast<size_t>(std::min<uint64_t>(output.size, buffer.size()));
+                }
+                break;
+            }
+            return result;
+        }
+
+    private:
+        // A plugin asking for more than this has gone wrong
+        static constexpr uint64_t kMaxPreviewBytes = 512ull * 1024 * 1024;
+
+        struct HostContext
+        {
+            const std::atomic<bool>* cancel;
+            const std::function<void(float)>* progress;
+        };
+
+        static int32_t IsCancelled(void* context)
+        {
+            auto* host = static_cast<HostContext*>(context);
+            return host->cancel && host->cancel->load(std::memory_order_relaxed) ? 1 : 0;
+        }
+
+        static void ReportProgress(void* context, float fraction)
+        {
+            auto* host = static_cast<HostContext*>(context);
+            if (*host->progress) {
+                (*host->progress)(std::clamp(fraction, 0.0f, 1.0f));
+            }
+        }
+
+        const OpacityPreviewPluginV2* table_;
+    };
+
+    /**
+     * @brief An IPreviewPlugin, whose result is copied into the host buffer
+     */
+    class LegacyPreviewSource final : public PreviewSource
+    {
+    public:
+        explicit LegacyPreviewSource(IPreviewPlugin* plugin) : plugin_(plugin) {}
+
+        bool CanPreview(const std::filesystem::path& path) const override
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return plugin_->CanPreview(path);
+        }
+
+        PluginPreview Render(const std::filesystem::path& path, int maxWidth, int maxHeight,
+                             std::vector<uint8_t>& buffer, const std::atomic<bool>* cancel,
+                             const std::function<void(float)>& progress) override
+        {
+            PluginPreview result;
+            if (cancel && cancel->load(std::memory_order_relaxed)) {
+                result.status = OPACITY_PREVIEW_CANCELLED;
+                return result;
+            }
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            std::vector<uint8_t> bytes = plugin_->GetPreview(path, maxWidth, maxHeight);
+            if (bytes.empty()) {
+                return result;
+            }
+
+            if (buffer.size() < bytes.size()) {
+                buffer.resize(bytes.size());
+            }
+            std::copy(bytes.begin(), bytes.end(), buffer.begin());
+
+            result.status = OPACITY_PREVIEW_OK;
+            result.size = bytes.size();
+            result.mimeType = plugin_->GetPreviewMimeType();
+            if (result.mimeType.compare(0, 6, "image/") == 0) {
+                result.format = OPACITY_PREVIEW_FORMAT_ENCODED;
+            }
+            if (progress) {
+                progress(1.0f);
+            }
+            return result;
+        }
+
+    private:
+        // Written before plugins ran off the UI thread
+        mutable std::mutex mutex_;
+        IPreviewPlugin* plugin_;
+    };
+
+    /**
+     * @brief What discovery learned about one DLL, kept between runs
+     */
+    struct DiscoveryRecord
+    {
+        FileIdentity identity;
+        std::string hash;
+        bool signatureChecked = false;
+        bool signatureValid = false;
+        bool inspected = false;     // Loaded once to read its info
+        bool valid = false;         // Had the exports and gave its info
+        PluginInfo info;
+    };
+
+    namespace
+    {
+        constexpr const char* kDiscoveryCacheName = "plugin-cache.json";
+        constexpr int kDiscoveryCacheVersion = 1;
+        constexpr unsigned kMaxDiscoveryThreads = 8;
+
+        bool SameVersion(const FileIdentity& a, const FileIdentity& b)
+        {
+            return a.volume == b.volume && a.file_id == b.file_id &&
+                   a.modified == b.modified && a.size == b.size;
+        }
+
+        // Lowercase, with the leading dot, however the plugin wrote it
+        std::string ExtensionKey(std::string extension)
+        {
+            if (!extension.empty() && extension[0] != '.') {
+                extension.insert(extension.begin(), '.');
+            }
+            std::transform(extension.begin(), extension.end(), extension.begin(),
+                [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return extension;
+        }
+
+        json InfoToJson(const PluginInfo& info)
+        {
+            return {
+                {"id", info.id},
+                {"name", info.name},
+                {"description", info.description},
+                {"author", info.author},
+                {"version", info.version},
+                {"website", info.website},
+                {"apiVersionMajor", info.apiVersionMajor},
+                {"apiVersionMinor", info.apiVersionMinor},
+                {"capabilities", static_cast<uint32_t>(info.capabilities)},
+                {"supportedExtensions", info.supportedExtensions},
+                {"dependencies", info.dependencies}
+            };
+        }
+
+        PluginInfo InfoFromJson(const json& j)
+        {
+            PluginInfo info;
+            info.id = j.value("id", "");
+            info.name = j.value("name", "");
+            info.description = j.value("description", "");
+            info.author = j.value("author", "");
+            info.version = j.value("version", "");
+            info.website = j.value("website", "");
+            info.apiVersionMajor = j.value("apiVersionMajor", 0);
+            info.apiVersionMinor = j.value("apiVersionMinor", 0);
+            info.capabilities = static_cast<PluginCapability>(j.value("capabilities", 0u));
+            info.supportedExtensions = j.value("supportedExtensions", std::vector<std::string>());
+            info.dependencies = j.value("dependencies", std::vector<std::string>());
+            return info;
+        }
+    }
+
     // ============== PluginManager::Impl ==============
 
     class PluginManager::Impl
@@ -58,9 +272,191 @@ namespace opacity::core
         
         std::vector<std::string> trustedPublishers_;
         bool requireSignedPlugins_ = false;
+
+        // Enabled preview plugins not loaded yet, by the extensions they list
+        std::unordered_map<std::string, std::vector<std::string>> deferredPreviews_;
         
         mutable std::mutex mutex_;
 
+        // Discovery cache by DLL file name; guarded apart from mutex_ so
+        // a signature check can consult it while a plugin is loading
+        std::unordered_map<std::string, DiscoveryRecord> discoveryCache_;
+        bool discoveryCacheLoaded_ = false;
+        std::mutex cacheMutex_;
+
+        // Take the deferred plugins for path's extension, and drop them
+        // from the other extensions they were deferred for
+        std::vector<std::string> TakeDeferredPreviews(const std::filesystem::path& path)
+        {
+            std::vector<std::string> pending;
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = deferredPreviews_.find(ExtensionKey(path.extension().string()));
+            if (it == deferredPreviews_.end()) {
+                return pending;
+            }
+            pending = std::move(it->second);
+            deferredPreviews_.erase(it);
+
+            for (auto other = deferredPreviews_.begin(); other != deferredPreviews_.end();) {
+                auto& ids = other->second;
+                ids.erase(std::remove_if(ids.begin(), ids.end(), [&](const std::string& id) {
+                    return std::find(pending.begin(), pending.end(), id) != pending.end();
+                }), ids.end());
+                other = ids.empty() ? deferredPreviews_.erase(other) : std::next(other);
+            }
+            return pending;
+        }
+
+        std::filesystem::path DiscoveryCachePath() const
+        {
+            return pluginDirectory_ / kDiscoveryCacheName;
+        }
+
+        void LoadDiscoveryCache()
+        {
+            discoveryCache_.clear();
+            discoveryCacheLoaded_ = true;
+
+            std::error_code ec;
+            auto path = DiscoveryCachePath();
+            if (!std::filesystem::exists(path, ec)) {
+                return;
+            }
+
+            try {
+                std::ifstream file(path);
+                json j = json::parse(file);
+                if (j.value("version", 0) != kDiscoveryCacheVersion) {
+                    return;
+                }
+
+                for (const auto& [name, entry] : j["plugins"].items()) {
+                    DiscoveryRecord record;
+                    record.identity.volume = entry.value("volume", uint64_t{0});
+                    record.identity.file_id = entry.value("fileId", uint64_t{0});
+                    record.identity.modified = entry.value("modified", int64_t{0});
+                    record.identity.size = entry.value("size", uint64_t{0});
+                    record.hash = entry.value("hash", "");
+                    record.signatureChecked = entry.value("signatureChecked", false);
+                    record.signatureValid = entry.value("signatureValid", false);
+                    record.inspected = entry.value("inspected", false);
+                    record.valid = entry.value("valid", false);
+                    if (entry.contains("info")) {
+                        record.info = InfoFromJson(entry["info"]);
+                    }
+                    discoveryCache_[name] = std::move(record);
+                }
+            }
+            catch (const std::exception& e) {
+                Logger::Get()->warn("PluginManager: Ignoring discovery cache: {}", e.what());
+                discoveryCache_.clear();
+            }
+        }
+
+        void SaveDiscoveryCache()
+        {
+            json plugins = json::object();
+            for (const auto& [name, record] : discoveryCache_) {
+                json entry = {
+                    {"volume", record.identity.volume},
+                    {"fileId", record.identity.file_id},
+                    {"modified", record.identity.modified},
+                    {"size", record.identity.size},
+                    {"hash", record.hash},
+                    {"signatureChecked", record.signatureChecked},
+                    {"signatureValid", record.signatureValid},
+                    {"inspected", record.inspected},
+                    {"valid", record.valid}
+                };
+                if (record.valid) {
+                    entry["info"] = InfoToJson(record.info);
+                }
+                plugins[name] = std::move(entry);
+            }
+
+            json j = {{"version", kDiscoveryCacheVersion}, {"plugins", std::move(plugins)}};
+            if (!SnapshotFile::WriteAtomic(DiscoveryCachePath(), j.dump())) {
+                Logger::Get()->warn("PluginManager: Failed to write discovery cache");
+            }
+        }
+
+        /**
+         * @brief Learn what a DLL is, from cached as far as it still holds
+         * @return false if the file cannot be read
+         */
+        bool Inspect(const std::filesystem::path& path, const DiscoveryRecord* cached,
+                     bool requireSigned, DiscoveryRecord& record, bool& changed)
+        {
+            if (!HashCache::ReadIdentity(Path(path), record.identity)) {
+                return false;
+            }
+
+            changed = true;
+            if (cached && SameVersion(cached->identity, record.identity)) {
+                record = *cached;
+                changed = false;
+            }
+            else if (FileHasher::HashFile(Path(path), record.hash) && cached && cached->hash == record.hash) {
+                // Copied or touched, but the same bytes
+                FileIdentity identity = record.identity;
+                record = *cached;
+                record.identity = identity;
+            }
+
+            if (requireSigned && !record.signatureChecked) {
+                record.signatureValid = CheckSignature(path);
+                record.signatureChecked = true;
+                changed = true;
+            }
+
+            // Never run an unsigned DLL's code when signatures are required
+            if (!record.inspected && (!requireSigned || record.signatureValid)) {
+                LoadedPlugin tempPlugin;
+#ifdef _WIN32
+                record.valid = LoadPluginDll(path, tempPlugin);
+                if (record.valid) {
+                    record.info = tempPlugin.info;
+                    UnloadPluginDll(tempPlugin);
+                }
+#endif
+                record.inspected = true;
+                changed = true;
+            }
+            return true;
+        }
+
+        bool CheckSignature(const std::filesystem::path& dllPath)
+        {
+#ifdef _WIN32
+            std::wstring widePath = dllPath.wstring();
+
+            WINTRUST_FILE_INFO fileInfo = {};
+            fileInfo.cbStruct = sizeof(fileInfo);
+            fileInfo.pcwszFilePath = widePath.c_str();
+
+            GUID policyGuid = WINTRUST_ACTION_GENERIC_VERIFY_V2;
+
+            WINTRUST_DATA trustData = {};
+            trustData.cbStruct = sizeof(trustData);
+            trustData.dwUIChoice = WTD_UI_NONE;
+            trustData.fdwRevocationChecks = WTD_REVOKE_NONE;
+            trustData.dwUnionChoice = WTD_CHOICE_FILE;
+            trustData.pFile = &fileInfo;
+            trustData.dwStateAction = WTD_STATEACTION_VERIFY;
+
+            LONG result = WinVerifyTrust(nullptr, &policyGuid, &trustData);
+
+            // Cleanup
+            trustData.dwStateAction = WTD_STATEACTION_CLOSE;
+            WinVerifyTrust(nullptr, &policyGuid, &trustData);
+
+            return result == ERROR_SUCCESS;
+#else
+            (void)dllPath;
+            return true;  // No signature verification on non-Windows
+#endif
+        }
+
         void NotifyPluginLoaded(const PluginInfo& info)
         {
             for (auto& callback : loadedCallbacks_) {
@@ -108,6 +504,18 @@ namespace opacity::core
                 return false;
             }
 
+            // The C preview interface is optional, and only taken if it
+            // answers for this host's version
+            auto getPreviewFunc = reinterpret_cast<OpacityGetPreviewPluginFunc>(
+                GetProcAddress(plugin.module, OPACITY_PREVIEW_PLUGIN_ENTRY));
+            if (getPreviewFunc) {
+                const OpacityPreviewPluginV2* table = getPreviewFunc(OPACITY_PREVIEW_ABI_VERSION);
+                if (table && table->struct_size >= sizeof(OpacityPreviewPluginV2) &&
+                    table->abi_version == OPACITY_PREVIEW_ABI_VERSION && table->render) {
+                    plugin.previewAbi = table;
+                }
+            }
+
             // Get plugin info
             plugin.info = getInfoFunc();
             plugin.info.dllPath = dllPath;
@@ -118,6 +526,8 @@ namespace opacity::core
 
         void UnloadPluginDll(LoadedPlugin& plugin)
         {
+            plugin.previewSource.reset();
+            plugin.previewAbi = nullptr;
             if (plugin.instance) {
                 plugin.instance->Shutdown();
                 if (plugin.destroyFunc) {
@@ -175,38 +585,108 @@ namespace opacity::core
         UnloadAllPlugins();
         impl_->discoveredPlugins_.clear();
         impl_->pluginSettings_.clear();
+        impl_->deferredPreviews_.clear();
     }
 
     std::vector<PluginInfo> PluginManager::DiscoverPlugins()
     {
-        std::lock_guard<std::mutex> lock(impl_->mutex_);
-        
-        impl_->discoveredPlugins_.clear();
         std::vector<PluginInfo> result;
+        std::vector<std::filesystem::path> paths;
+        bool requireSigned;
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            requireSigned = impl_->requireSignedPlugins_;
 
-        std::error_code ec;
-        if (!std::filesystem::exists(impl_->pluginDirectory_, ec)) {
-            return result;
+            std::error_code ec;
+            if (!std::filesystem::exists(impl_->pluginDirectory_, ec)) {
+                impl_->discoveredPlugins_.clear();
+                return result;
+            }
+
+            for (const auto& entry : std::filesystem::directory_iterator(impl_->pluginDirectory_, ec)) {
+                if (!entry.is_regular_file()) continue;
+                
+                const auto& path = entry.path();
+                if (path.extension() != ".dll" && path.extension() != ".so") continue;
+                paths.push_back(path);
+            }
         }
 
-        for (const auto& entry : std::filesystem::directory_iterator(impl_->pluginDirectory_, ec)) {
-            if (!entry.is_regular_file()) continue;
-            
-            const auto& path = entry.path();
-            if (path.extension() != ".dll" && path.extension() != ".so") continue;
+        std::vector<std::optional<DiscoveryRecord>> cached(paths.size());
+        {
+            std::lock_guard<std::mutex> lock(impl_->cacheMutex_);
+            if (!impl_->discoveryCacheLoaded_) {
+                impl_->LoadDiscoveryCache();
+            }
+            for (size_t i = 0; i < paths.size(); ++i) {
+                auto it = impl_->discoveryCache_.find(paths[i].filename().string());
+                if (it != impl_->discoveryCache_.end()) {
+                    cached[i] = it->second;
+                }
+            }
+        }
 
-            // Try to load and get info without fully initializing
-            LoadedPlugin tempPlugin;
-#ifdef _WIN32
-            if (impl_->LoadPluginDll(path, tempPlugin)) {
-                PluginInfo info = tempPlugin.info;
-                impl_->discoveredPlugins_[info.id] = info;
-                result.push_back(info);
-                
-                // Unload - we just wanted the info
-                impl_->UnloadPluginDll(tempPlugin);
+        // Each DLL is inspected on its own, against its own copy of the cache
+        std::vector<DiscoveryRecord> records(paths.size());
+        std::vector<char> readable(paths.size(), 0);
+        std::atomic<bool> changed{false};
+        std::atomic<size_t> next{0};
+        auto worker = [&]() {
+            for (size_t index; (index = next.fetch_add(1)) < paths.size();) {
+                bool recordChanged = false;
+                const auto& entry = cached[index];
+                readable[index] = impl_->Inspect(paths[index], entry ? &*entry : nullptr, requireSigned,
+                                                 records[index], recordChanged);
+                if (recordChanged) {
+                    changed = true;
+                }
             }
-#endif
+        };
+
+        unsigned threads = std::min(kMaxDiscoveryThreads, std::max(1u, std::thread::hardware_concurrency()));
+        threads = static_cast<unsigned>(std::min<size_t>(threads, paths.size()));
+        if (threads <= 1) {
+            worker();
+        }
+        else {
+            std::vector<std::thread> workers;
+            workers.reserve(threads);
+            for (unsigned t = 0; t < threads; ++t) {
+                workers.emplace_back(worker);
+            }
+            for (auto& thread : workers) {
+                thread.join();
+            }
+        }
+
+        {
+            // Only DLLs still present are kept
+            std::lock_guard<std::mutex> lock(impl_->cacheMutex_);
+            std::unordered_map<std::string, DiscoveryRecord> cache;
+            for (size_t i = 0; i < paths.size(); ++i) {
+                if (readable[i]) {
+                    cache[paths[i].filename().string()] = records[i];
+                }
+            }
+            if (changed || cache.size() != impl_->discoveryCache_.size()) {
+                impl_->discoveryCache_ = std::move(cache);
+                impl_->SaveDiscoveryCache();
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        impl_->discoveredPlugins_.clear();
+        for (size_t i = 0; i < paths.size(); ++i) {
+            const DiscoveryRecord& record = records[i];
+            if (!readable[i] || !record.valid || (requireSigned && !record.signatureValid)) continue;
+
+            PluginInfo info = record.info;
+            info.dllPath = paths[i];
+            auto loadedIt = impl_->loadedPlugins_.find(info.id);
+            info.state = loadedIt != impl_->loadedPlugins_.end() ? loadedIt->second.info.state
+                                                                 : PluginState::Unloaded;
+            impl_->discoveredPlugins_[info.id] = info;
+            result.push_back(info);
         }
 
         Logger::Get()->info("PluginManager: Discovered {} plugins", result.size());
@@ -334,6 +814,13 @@ namespace opacity::core
 
         plugin.info.state = PluginState::Active;
 
+        if (plugin.previewAbi) {
+            plugin.previewSource = std::make_shared<AbiPreviewSource>(plugin.previewAbi);
+        }
+        else if (auto* previewPlugin = dynamic_cast<IPreviewPlugin*>(plugin.instance)) {
+            plugin.previewSource = std::make_shared<LegacyPreviewSource>(previewPlugin);
+        }
+
         // Store loaded plugin
         impl_->loadedPlugins_[plugin.info.id] = std::move(plugin);
         impl_->discoveredPlugins_[plugin.info.id] = impl_->loadedPlugins_[plugin.info.id].info;
@@ -378,6 +865,11 @@ namespace opacity::core
     void PluginManager::LoadEnabledPlugins()
     {
         auto plugins = GetAllPlugins();
+        size_t deferred = 0;
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            impl_->deferredPreviews_.clear();
+        }
         
         for (const auto& plugin : plugins) {
             auto settingsIt = impl_->pluginSettings_.find(plugin.id);
@@ -387,9 +879,26 @@ namespace opacity::core
                 enabled = settingsIt->second.enabled;
             }
             
-            if (enabled) {
-                LoadPlugin(plugin.id);
+            if (!enabled) {
+                continue;
             }
+
+            // A plugin that only previews is wanted once one of its files is
+            if (plugin.capabilities == PluginCapability::PreviewHandler &&
+                !plugin.supportedExtensions.empty() && !IsPluginLoaded(plugin.id)) {
+                std::lock_guard<std::mutex> lock(impl_->mutex_);
+                for (const auto& extension : plugin.supportedExtensions) {
+                    impl_->deferredPreviews_[ExtensionKey(extension)].push_back(plugin.id);
+                }
+                ++deferred;
+                continue;
+            }
+
+            LoadPlugin(plugin.id);
+        }
+
+        if (deferred > 0) {
+            Logger::Get()->info("PluginManager: Deferred {} preview plugins until needed", deferred);
         }
     }
 
@@ -539,7 +1048,55 @@ namespace opacity::core
                 return plugin;
             }
         }
-        return nullptr;
+
+        // Load the deferred plugins for this extension, once each
+        std::vector<std::string> pending = impl_->TakeDeferredPreviews(path);
+
+        IPreviewPlugin* found = nullptr;
+        for (const auto& id : pending) {
+            if (!LoadPlugin(id).success) {
+                continue;
+            }
+            auto* plugin = dynamic_cast<IPreviewPlugin*>(GetPlugin(id));
+            if (!found && plugin && plugin->CanPreview(path)) {
+                found = plugin;
+            }
+        }
+        return found;
+    }
+
+    std::shared_ptr<PreviewSource> PluginManager::FindPreviewSource(const std::filesystem::path& path)
+    {
+        auto find = [&]() -> std::shared_ptr<PreviewSource> {
+            std::vector<std::shared_ptr<PreviewSource>> sources;
+            {
+                std::lock_guard<std::mutex> lock(impl_->mutex_);
+                for (auto& [id, plugin] : impl_->loadedPlugins_) {
+                    if (plugin.previewSource) {
+                        sources.push_back(plugin.previewSource);
+                    }
+                }
+            }
+            for (auto& source : sources) {
+                if (source->CanPreview(path)) {
+                    return source;
+                }
+            }
+            return nullptr;
+        };
+
+        if (auto source = find()) {
+            return source;
+        }
+
+        std::vector<std::string> pending = impl_->TakeDeferredPreviews(path);
+        if (pending.empty()) {
+            return nullptr;
+        }
+        for (const auto& id : pending) {
+            LoadPlugin(id);
+        }
+        return find();
     }
 
     PluginSettings PluginManager::GetPluginSettings(const std::string& pluginId) const
@@ -632,31 +1189,19 @@ namespace opacity::core
 
     bool PluginManager::ValidatePluginSignature(const std::filesystem::path& dllPath)
     {
-#ifdef _WIN32
-        WINTRUST_FILE_INFO fileInfo = {};
-        fileInfo.cbStruct = sizeof(fileInfo);
-        fileInfo.pcwszFilePath = dllPath.wstring().c_str();
-
-        GUID policyGuid = WINTRUST_ACTION_GENERIC_VERIFY_V2;
-
-        WINTRUST_DATA trustData = {};
-        trustData.cbStruct = sizeof(trustData);
-        trustData.dwUIChoice = WTD_UI_NONE;
-        trustData.fdwRevocationChecks = WTD_REVOKE_NONE;
-        trustData.dwUnionChoice = WTD_CHOICE_FILE;
-        trustData.pFile = &fileInfo;
-        trustData.dwStateAction = WTD_STATEACTION_VERIFY;
-
-        LONG result = WinVerifyTrust(nullptr, &policyGuid, &trustData);
-
-        // Cleanup
-        trustData.dwStateAction = WTD_STATEACTION_CLOSE;
-        WinVerifyTrust(nullptr, &policyGuid, &trustData);
+        // The discovery cache answers for a DLL checked in this version
+        FileIdentity identity;
+        bool known = HashCache::ReadIdentity(Path(dllPath), identity);
+        if (known) {
+            std::lock_guard<std::mutex> lock(impl_->cacheMutex_);
+            auto it = impl_->discoveryCache_.find(dllPath.filename().string());
+            if (it != impl_->discoveryCache_.end() && it->second.signatureChecked &&
+                SameVersion(it->second.identity, identity)) {
+                return it->second.signatureValid;
+            }
+        }
 
-        return result == ERROR_SUCCESS;
-#else
-        return true;  // No signature verification on non-Windows
-#endif
+        return impl_->CheckSignature(dllPath);
     }
 
     void PluginManager::SetRequireSignedPlugins(bool require)
@@ -0,0 +1,250 @@
+#include "opacity/core/Profiler.h"
+#include "opacity/core/Logger.h"
+
+#include <nlohmann/json.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+
+namespace opacity::core
+{
+    using json = nlohmann::json;
+
+    namespace
+    {
+        // Written by the owning thread only; atomic so a reader copying
+        // the ring while it wraps sees whole values
+        struct Slot
+        {
+            std::atomic<const char*> name{nullptr};
+            std::atomic<uint64_t> start{0};
+            std::atomic<uint64_t> end{0};
+            std::atomic<uint32_t> depth{0};
+        };
+
+        struct ThreadBuffer
+        {
+            uint32_t id = 0;
+            std::string name;                               // Guarded by g_registry_mutex
+            bool retired = false;                           // Its thread has exited; guarded too
+            std::unique_ptr<Slot[]> slots{new Slot[Profiler::kZonesPerThread]};
+            std::atomic<uint64_t> head{0};                  // Zones ever written
+            std::atomic<uint64_t> base{0};                  // Zones before this are a former thread's
+        };
+
+        std::atomic<bool> g_enabled{false};
+
+        // Threads come and go with every search and operation, so the
+        // buffer of one that exited goes to the next thread that records;
+        // until then its zones still show
+        std::mutex g_registry_mutex;
+        std::vector<std::shared_ptr<ThreadBuffer>> g_buffers;
+        uint32_t g_next_id = 1;
+
+        struct LocalThread
+        {
+            std::shared_ptr<ThreadBuffer> buffer;
+            std::string name;
+
+            ~LocalThread()
+            {
+                if (buffer)
+                {
+                    std::lock_guard<std::mutex> lock(g_registry_mutex);
+                    buffer->retired = true;
+                }
+            }
+        };
+
+        thread_local LocalThread t_thread;
+        thread_local uint32_t t_depth = 0;
+
+        ThreadBuffer& LocalBuffer()
+        {
+            if (!t_thread.buffer)
+            {
+                std::lock_guard<std::mutex> lock(g_registry_mutex);
+                auto it = std::find_if(g_buffers.begin(), g_buffers.end(),
+                    [](const std::shared_ptr<ThreadBuffer>& buffer) { return buffer->retired; });
+                if (it != g_buffers.end())
+                {
+                    t_thread.buffer = *it;
+                    t_thread.buffer->retired = false;
+                    t_thread.buffer->base.store(t_thread.buffer->head.load(std::memory_order_relaxed),
+                                                std::memory_order_relaxed);
+                }
+                else
+                {
+                    t_thread.buffer = std::make_shared<ThreadBuffer>();
+                    g_buffers.push_back(t_thread.buffer);
+                }
+
+                ThreadBuffer& buffer = *t_thread.buffer;
+                buffer.id = g_next_id++;
+                buffer.name = !t_thread.name.empty() ? t_thread.name : "Thread " + std::to_string(buffer.id);
+            }
+            return *t_thread.buffer;
+        }
+    }
+
+    void Profiler::SetEnabled(bool enabled)
+    {
+        g_enabled.store(enabled, std::memory_order_relaxed);
+    }
+
+    bool Profiler::IsEnabled()
+    {
+        return g_enabled.load(std::memory_order_relaxed);
+    }
+
+    uint64_t Profiler::Now()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    void Profiler::SetThreadName(const std::string& name)
+    {
+        // The buffer waits for the first zone; naming a thread costs nothing
+        t_thread.name = name;
+        if (t_thread.buffer)
+        {
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            t_thread.buffer->name = name;
+        }
+    }
+
+    void Profiler::Record(const char* name, uint64_t start, uint64_t end, uint32_t depth)
+    {
+        ThreadBuffer& buffer = LocalBuffer();
+        uint64_t index = buffer.head.load(std::memory_order_relaxed);
+
+        // Pairs with the fence in Collect: a reader that sees any of these
+        // stores also sees the head that was current before them
+        std::atomic_thread_fence(std::memory_order_release);
+
+        Slot& slot = buffer.slots[index % kZonesPerThread];
+        slot.name.store(name, std::memory_order_relaxed);
+        slot.start.store(start, std::memory_order_relaxed);
+        slot.end.store(end, std::memory_order_relaxed);
+        slot.depth.store(depth, std::memory_order_relaxed);
+        buffer.head.store(index + 1, std::memory_order_release);
+    }
+
+    std::vector<ProfileThread> Profiler::Collect(uint64_t since)
+    {
+        // Bases are read with the names, under the lock that guards
+        // handing a buffer to a new thread
+        std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+        std::vector<uint64_t> bases;
+        std::vector<ProfileThread> threads;
+        {
+            std::lock_guard<std::mutex> lock(g_registry_mutex);
+            buffers = g_buffers;
+            for (const auto& buffer : buffers)
+            {
+                ProfileThread thread;
+                thread.id = buffer->id;
+                thread.name = buffer->name;
+                threads.push_back(std::move(thread));
+                bases.push_back(buffer->base.load(std::memory_order_relaxed));
+            }
+        }
+
+        for (size_t t = 0; t < buffers.size(); ++t)
+        {
+            const ThreadBuffer& buffer = *buffers[t];
+            uint64_t head = buffer.head.load(std::memory_order_acquire);
+            uint64_t first = std::max(head > kZonesPerThread ? head - kZonesPerThread : 0, bases[t]);
+
+            std::vector<ProfileZone> zones;
+            zones.reserve(static_cast<size_t>(head - first));
+            for (uint64_t index = first; index < head; ++index)
+            {
+                const Slot& slot = buffer.slots[index % kZonesPerThread];
+                ProfileZone zone;
+                zone.name = slot.name.load(std::memory_order_relaxed);
+                zone.start = slot.start.load(std::memory_order_relaxed);
+                zone.end = slot.end.load(std::memory_order_relaxed);
+                zone.depth = slot.depth.load(std::memory_order_relaxed);
+                zones.push_back(zone);
+            }
+
+            // The owner kept writing while we copied; a slot it may have
+            // reached again by now does not hold the zone we meant to read
+            std::atomic_thread_fence(std::memory_order_acquire);
+            uint64_t now = buffer.head.load(std::memory_order_relaxed);
+            size_t skip = now >= first + kZonesPerThread
+                              ? static_cast<size_t>(std::min<uint64_t>(now - kZonesPerThread + 1 - first, zones.size()))
+                              : 0;
+
+            auto& kept = threads[t].zones;
+            for (size_t z = skip; z < zones.size(); ++z)
+            {
+                if (zones[z].name && zones[z].end >= since)
+                    kept.push_back(zones[z]);
+            }
+        }
+
+        return threads;
+    }
+
+    bool Profiler::ExportChromeTrace(const Path& file)
+    {
+        auto threads = Collect();
+
+        uint64_t base = UINT64_MAX;
+        for (const auto& thread : threads)
+        {
+            for (const auto& zone : thread.zones)
+                base = std::min(base, zone.start);
+        }
+
+        json events = json::array();
+        for (const auto& thread : threads)
+        {
+            events.push_back({{"name", "thread_name"}, {"ph", "M"}, {"pid", 1}, {"tid", thread.id},
+                              {"args", {{"name", thread.name}}}});
+            for (const auto& zone : thread.zones)
+            {
+                events.push_back({{"name", zone.name}, {"ph", "X"}, {"pid", 1}, {"tid", thread.id},
+                                  {"ts", static_cast<double>(zone.start - base) / 1000.0},
+                                  {"dur", static_cast<double>(zone.end - zone.start) / 1000.0}});
+            }
+        }
+
+        std::ofstream out(file.Get(), std::ios::binary | std::ios::trunc);
+        if (!out)
+        {
+            SPDLOG_ERROR("Failed to write trace: {}", file.String());
+            return false;
+        }
+        out << json{{"traceEvents", std::move(events)}, {"displayTimeUnit", "ns"}}.dump();
+        SPDLOG_INFO("Wrote profiler trace: {}", file.String());
+        return out.good();
+    }
+
+    ProfileScope::ProfileScope(const char* name)
+    {
+        if (!Profiler::IsEnabled())
+            return;
+
+        name_ = name;
+        depth_ = t_depth++;
+        start_ = Profiler::Now();
+    }
+
+    ProfileScope::~ProfileScope()
+    {
+        if (!name_)
+            return;
+
+        --t_depth;
+        Profiler::Record(name_, start_, Profiler::Now(), depth_);
+    }
+
+} // namespace opacity::core
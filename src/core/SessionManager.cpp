@@ -2,6 +2,7 @@
 // Copyright (c) 2025 Opacity Project
 
 #include "opacity/core/SessionManager.h"
+#include "opacity/core/SnapshotFile.h"
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
 #include <fstream>
@@ -13,6 +14,7 @@
 #include <thread>
 #include <atomic>
 #include <mutex>
+#include <condition_variable>
 
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
@@ -217,8 +219,19 @@ public:
     std::atomic<int> autoSaveInterval{300}; // 5 minutes
     std::atomic<bool> stopAutoSave{false};
     std::thread autoSaveThread;
+    std::mutex wakeMutex;
+    std::condition_variable wake;
     std::mutex saveMutex;
     
+    // Both files are rewritten only when what they hold changed
+    SnapshotFile configFile;
+    SnapshotFile autoSaveFile;
+    
+    // Latest state from publishState, until auto-save takes it
+    std::mutex publishMutex;
+    std::unique_ptr<Session> published;
+    bool everPublished = false;
+    
     bool initialized = false;
     
     void rebuildIndex() {
@@ -252,18 +265,15 @@ public:
             j["defaultSessionId"] = defaultSessionId;
             j["startupBehavior"] = startupBehavior;
             
-            fs::path dir = fs::path(configPath).parent_path();
-            if (!fs::exists(dir)) {
-                fs::create_directories(dir);
+            configFile.SetPath(configPath);
+            std::string content = j.dump();
+            if (configFile.Unchanged(content)) {
+                return true;
             }
-            
-            std::ofstream file(configPath);
-            if (!file) {
-                spdlog::error("SessionManager: failed to open {} for writing", configPath);
+            if (!configFile.Write(content, content)) {
+                spdlog::error("SessionManager: failed to write {}", configPath);
                 return false;
             }
-            
-            file << j.dump(2);
             spdlog::debug("SessionManager: saved {} sessions to {}", sessions.size(), configPath);
             return true;
         } catch (const std::exception& e) {
@@ -320,32 +330,72 @@ public:
     
     void autoSaveLoop() {
         while (!stopAutoSave) {
-            std::this_thread::sleep_for(std::chrono::seconds(autoSaveInterval.load()));
+            {
+                std::unique_lock<std::mutex> lock(wakeMutex);
+                wake.wait_for(lock, std::chrono::seconds(autoSaveInterval.load()),
+                              [this] { return stopAutoSave.load(); });
+            }
             if (stopAutoSave) break;
             
-            if (autoSaveEnabled && stateCollector) {
+            if (autoSaveEnabled) {
                 try {
-                    Session current = stateCollector();
-                    current.id = "autosave";
-                    current.name = "Auto-saved Session";
-                    current.isAutoSave = true;
-                    current.modifiedAt = std::chrono::system_clock::now();
-                    
-                    // Save to autosave file
-                    json j = current;
-                    std::string autoSavePath = sessionsDir + "/autosave.json";
-                    std::ofstream file(autoSavePath);
-                    if (file) {
-                        file << j.dump(2);
-                        spdlog::debug("SessionManager: auto-saved session");
-                        notifyEvent(SessionEventType::AutoSaved, "autosave");
-                    }
+                    saveLatest();
                 } catch (const std::exception& e) {
                     spdlog::warn("SessionManager: auto-save failed: {}", e.what());
                 }
             }
         }
     }
+    
+    void stopAutoSaveThread() {
+        {
+            std::lock_guard<std::mutex> lock(wakeMutex);
+            stopAutoSave = true;
+        }
+        wake.notify_all();
+        if (autoSaveThread.joinable()) {
+            autoSaveThread.join();
+        }
+    }
+    
+    // The published state, or the collector's if nothing ever was published
+    void saveLatest() {
+        std::unique_ptr<Session> state;
+        bool usedPublish;
+        {
+            std::lock_guard<std::mutex> lock(publishMutex);
+            state = std::move(published);
+            usedPublish = everPublished;
+        }
+        if (state) {
+            writeAutoSave(*state);
+        } else if (!usedPublish && stateCollector) {
+            writeAutoSave(stateCollector());
+        }
+    }
+    
+    void writeAutoSave(Session current) {
+        current.id = "autosave";
+        current.name = "Auto-saved Session";
+        current.isAutoSave = true;
+        
+        // Compared without the time, which differs on every save
+        json j = current;
+        j.erase("modifiedAt");
+        std::string body = j.dump();
+        
+        std::lock_guard<std::mutex> lock(saveMutex);
+        autoSaveFile.SetPath(fs::path(sessionsDir) / "autosave.json");
+        if (autoSaveFile.Unchanged(body)) {
+            return;
+        }
+        
+        current.modifiedAt = std::chrono::system_clock::now();
+        if (autoSaveFile.Write(body, json(current).dump())) {
+            spdlog::debug("SessionManager: auto-saved session");
+            notifyEvent(SessionEventType::AutoSaved, "autosave");
+        }
+    }
 };
 
 SessionManager::SessionManager() : pImpl(std::make_unique<Impl>()) {}
@@ -380,10 +430,7 @@ bool SessionManager::initialize(const std::string& configPath) {
 void SessionManager::shutdown() {
     if (pImpl->initialized) {
         // Stop auto-save thread
-        pImpl->stopAutoSave = true;
-        if (pImpl->autoSaveThread.joinable()) {
-            pImpl->autoSaveThread.join();
-        }
+        pImpl->stopAutoSaveThread();
         
         save();
         pImpl->initialized = false;
@@ -398,6 +445,13 @@ void SessionManager::setStateRestorer(StateRestorer restorer) {
     pImpl->stateRestorer = std::move(restorer);
 }
 
+void SessionManager::publishState(Session state) {
+    auto published = std::make_unique<Session>(std::move(state));
+    std::lock_guard<std::mutex> lock(pImpl->publishMutex);
+    pImpl->published = std::move(published);
+    pImpl->everPublished = true;
+}
+
 std::string SessionManager::saveCurrentSession(const std::string& name, const std::string& description) {
     if (!pImpl->stateCollector) {
         spdlog::error("SessionManager: no state collector set");
@@ -850,10 +904,7 @@ void SessionManager::enableAutoSave(bool enabled) {
         pImpl->autoSaveThread = std::thread(&Impl::autoSaveLoop, pImpl.get());
     } else if (!enabled && wasEnabled) {
         // Stop auto-save thread
-        pImpl->stopAutoSave = true;
-        if (pImpl->autoSaveThread.joinable()) {
-            pImpl->autoSaveThread.join();
-        }
+        pImpl->stopAutoSaveThread();
     }
 }
 
@@ -862,24 +913,10 @@ bool SessionManager::isAutoSaveEnabled() const {
 }
 
 void SessionManager::triggerAutoSave() {
-    if (pImpl->stateCollector) {
-        try {
-            Session current = pImpl->stateCollector();
-            current.id = "autosave";
-            current.name = "Auto-saved Session";
-            current.isAutoSave = true;
-            current.modifiedAt = std::chrono::system_clock::now();
-            
-            json j = current;
-            std::string autoSavePath = pImpl->sessionsDir + "/autosave.json";
-            std::ofstream file(autoSavePath);
-            if (file) {
-                file << j.dump(2);
-                pImpl->notifyEvent(SessionEventType::AutoSaved, "autosave");
-            }
-        } catch (...) {
-            spdlog::warn("SessionManager: manual auto-save failed");
-        }
+    try {
+        pImpl->saveLatest();
+    } catch (...) {
+        spdlog::warn("SessionManager: manual auto-save failed");
     }
 }
 
@@ -915,6 +952,8 @@ void SessionManager::clearAutoSave() {
     if (fs::exists(autoSavePath)) {
         fs::remove(autoSavePath);
     }
+    std::lock_guard<std::mutex> lock(pImpl->saveMutex);
+    pImpl->autoSaveFile.Reset();
 }
 
 void SessionManager::setStartupBehavior(const std::string& behavior) {
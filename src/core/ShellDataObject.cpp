@@ -0,0 +1,685 @@
+#include "opacity/core/ShellIntegration.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <mutex>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <ole2.h>
+#include <shlobj.h>
+#pragma comment(lib, "ole32.lib")
+#pragma comment(lib, "shell32.lib")
+#endif
+
+namespace opacity::core
+{
+#ifdef _WIN32
+    namespace
+    {
+        // OLE for the clipboard and drag-drop, once per thread that uses them
+        struct OleSession
+        {
+            HRESULT result = OleInitialize(nullptr);
+            ~OleSession()
+            {
+                if (SUCCEEDED(result))
+                    OleUninitialize();
+            }
+        };
+
+        bool EnsureOle()
+        {
+            thread_local OleSession session;
+            if (FAILED(session.result))
+            {
+                SPDLOG_WARN("OLE is not available on this thread ({:#x})", static_cast<uint32_t>(session.result));
+                return false;
+            }
+            return true;
+        }
+
+        DWORD ToDropEffect(ShellDropEffect effect)
+        {
+            switch (effect)
+            {
+            case ShellDropEffect::Copy: return DROPEFFECT_COPY;
+            case ShellDropEffect::Move: return DROPEFFECT_MOVE;
+            case ShellDropEffect::Link: return DROPEFFECT_LINK;
+            default: return DROPEFFECT_NONE;
+            }
+        }
+
+        ShellDropEffect FromDropEffect(DWORD effect)
+        {
+            if (effect & DROPEFFECT_MOVE)
+                return ShellDropEffect::Move;
+            if (effect & DROPEFFECT_COPY)
+                return ShellDropEffect::Copy;
+            if (effect & DROPEFFECT_LINK)
+                return ShellDropEffect::Link;
+            return ShellDropEffect::None;
+        }
+
+        FILETIME ToFileTime(std::chrono::system_clock::time_point time)
+        {
+            // 100ns intervals since 1601, the FILETIME epoch
+            constexpr int64_t kEpochOffset = 116444736000000000LL;
+            using Ticks = std::chrono::duration<int64_t, std::ratio<1, 10'000'000>>;
+            auto ticks = std::chrono::duration_cast<Ticks>(time.time_since_epoch()).count() + kEpochOffset;
+
+            FILETIME result;
+            result.dwLowDateTime = static_cast<DWORD>(ticks);
+            result.dwHighDateTime = static_cast<DWORD>(static_cast<uint64_t>(ticks) >> 32);
+            return result;
+        }
+
+        HGLOBAL AllocCopy(const void* data, size_t size)
+        {
+            HGLOBAL global = GlobalAlloc(GMEM_MOVEABLE, size);
+            if (!global)
+                return nullptr;
+            if (void* target = GlobalLock(global))
+            {
+                std::memcpy(target, data, size);
+                GlobalUnlock(global);
+                return global;
+            }
+            GlobalFree(global);
+            return nullptr;
+        }
+
+        bool ReadDword(const STGMEDIUM& medium, DWORD& value)
+        {
+            if (medium.tymed != TYMED_HGLOBAL || GlobalSize(medium.hGlobal) < sizeof(DWORD))
+                return false;
+            auto* data = static_cast<const DWORD*>(GlobalLock(medium.hGlobal));
+            if (!data)
+                return false;
+            value = *data;
+            GlobalUnlock(medium.hGlobal);
+            return true;
+        }
+
+        /**
+         * Contents of one virtual file. Agile through the free-threaded
+         * marshaler, so the target's copy thread reads it directly rather
+         * than through calls queued to the UI thread.
+         */
+        class FileStream : public IStream
+        {
+        public:
+            FileStream(std::unique_ptr<ShellFileReader> reader, uint64_t size, std::wstring name)
+                : reader_(std::move(reader))
+                , size_(size)
+                , name_(std::move(name))
+            {
+                CoCreateFreeThreadedMarshaler(static_cast<IStream*>(this), &marshaler_);
+            }
+
+            ~FileStream()
+            {
+                if (marshaler_)
+                    marshaler_->Release();
+            }
+
+            // IUnknown
+            IFACEMETHODIMP QueryInterface(REFIID riid, void** object) override
+            {
+                if (!object)
+                    return E_POINTER;
+                if (riid == IID_IUnknown || riid == IID_IStream || riid == IID_ISequentialStream)
+                {
+                    *object = static_cast<IStream*>(this);
+                    AddRef();
+                    return S_OK;
+                }
+                if (riid == IID_IMarshal && marshaler_)
+                    return marshaler_->QueryInterface(riid, object);
+                *object = nullptr;
+                return E_NOINTERFACE;
+            }
+
+            IFACEMETHODIMP_(ULONG) AddRef() override { return ++refs_; }
+
+            IFACEMETHODIMP_(ULONG) Release() override
+            {
+                ULONG refs = --refs_;
+                if (refs == 0)
+                    delete this;
+                return refs;
+            }
+
+            // ISequentialStream
+            IFACEMETHODIMP Read(void* buffer, ULONG length, ULONG* read) override
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                size_t done = reader_->Read(buffer, length);
+                position_ += done;
+                if (read)
+                    *read = static_cast<ULONG>(done);
+                return done == length ? S_OK : S_FALSE;
+            }
+
+            IFACEMETHODIMP Write(const void*, ULONG, ULONG*) override { return STG_E_ACCESSDENIED; }
+
+            // IStream
+            IFACEMETHODIMP Seek(LARGE_INTEGER move, DWORD origin, ULARGE_INTEGER* new_position) override
+            {
+                if (origin > STREAM_SEEK_END)
+                    return STG_E_INVALIDFUNCTION;
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                int64_t base = origin == STREAM_SEEK_SET ? 0
+                             : origin == STREAM_SEEK_CUR ? static_cast<int64_t>(position_)
+                             : static_cast<int64_t>(size_);
+                int64_t target = base + move.QuadPart;
+                if (target < 0)
+                    return STG_E_INVALIDPOINTER;
+
+                if (static_cast<uint64_t>(target) != position_)
+                {
+                    if (!reader_->Seek(static_cast<uint64_t>(target)))
+                        return STG_E_SEEKERROR;
+                    position_ = static_cast<uint64_t>(target);
+                }
+                if (new_position)
+                    new_position->QuadPart = position_;
+                return S_OK;
+            }
+
+            IFACEMETHODIMP SetSize(ULARGE_INTEGER) override { return STG_E_ACCESSDENIED; }
+
+            IFACEMETHODIMP CopyTo(IStream* target, ULARGE_INTEGER length, ULARGE_INTEGER* read,
+                                  ULARGE_INTEGER* written) override
+            {
+                constexpr ULONG kChunk = 256 * 1024;
+                std::vector<char> buffer(kChunk);
+                uint64_t total_read = 0;
+                uint64_t total_written = 0;
+                HRESULT hr = S_OK;
+                while (total_read < length.QuadPart)
+                {
+                    ULONG want = static_cast<ULONG>(std::min<uint64_t>(kChunk, length.QuadPart - total_read));
+                    ULONG got = 0;
+                    Read(buffer.data(), want, &got);
+                    if (got == 0)
+                        break;
+                    total_read += got;
+
+                    ULONG put = 0;
+                    hr = target->Write(buffer.data(), got, &put);
+                    total_written += put;
+                    if (FAILED(hr))
+                        break;
+                }
+                if (read)
+                    read->QuadPart = total_read;
+                if (written)
+                    written->QuadPart = total_written;
+                return FAILED(hr) ? hr : S_OK;
+            }
+
+            IFACEMETHODIMP Commit(DWORD) override { return S_OK; }
+            IFACEMETHODIMP Revert() override { return E_NOTIMPL; }
+            IFACEMETHODIMP LockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return STG_E_INVALIDFUNCTION; }
+            IFACEMETHODIMP UnlockRegion(ULARGE_INTEGER, ULARGE_INTEGER, DWORD) override { return STG_E_INVALIDFUNCTION; }
+            IFACEMETHODIMP Clone(IStream**) override { return E_NOTIMPL; }
+
+            IFACEMETHODIMP Stat(STATSTG* stat, DWORD flags) override
+            {
+                if (!stat)
+                    return STG_E_INVALIDPOINTER;
+                *stat = {};
+                stat->type = STGTY_STREAM;
+                stat->cbSize.QuadPart = size_;
+                stat->grfMode = STGM_READ;
+                if (!(flags & STATFLAG_NONAME))
+                {
+                    size_t bytes = (name_.size() + 1) * sizeof(wchar_t);
+                    stat->pwcsName = static_cast<LPOLESTR>(CoTaskMemAlloc(bytes));
+                    if (!stat->pwcsName)
+                        return STG_E_INSUFFICIENTMEMORY;
+                    std::memcpy(stat->pwcsName, name_.c_str(), bytes);
+                }
+                return S_OK;
+            }
+
+        private:
+            std::atomic<ULONG> refs_{1};
+            IUnknown* marshaler_ = nullptr;
+            std::mutex mutex_;                  // Reads and seeks come from whichever thread the target uses
+            std::unique_ptr<ShellFileReader> reader_;
+            uint64_t size_ = 0;
+            uint64_t position_ = 0;
+            std::wstring name_;
+        };
+
+        /**
+         * The files of a ShellFileSource as the shell sees them. Formats
+         * are rendered when asked for, once each for CF_HDROP and the file
+         * descriptors, which targets ask for repeatedly while the pointer
+         * is over them.
+         */
+        class FileDataObject : public IDataObject
+        {
+        public:
+            FileDataObject(std::shared_ptr<ShellFileSource> source, DWORD preferred_effect)
+                : source_(std::move(source))
+                , preferred_effect_(preferred_effect)
+            {
+            }
+
+            bool HasPaths() const { return source_->HasPaths(); }
+
+            // IUnknown
+            IFACEMETHODIMP QueryInterface(REFIID riid, void** object) override
+            {
+                if (!object)
+                    return E_POINTER;
+                if (riid == IID_IUnknown || riid == IID_IDataObject)
+                {
+                    *object = static_cast<IDataObject*>(this);
+                    AddRef();
+                    return S_OK;
+                }
+                *object = nullptr;
+                return E_NOINTERFACE;
+            }
+
+            IFACEMETHODIMP_(ULONG) AddRef() override { return ++refs_; }
+
+            IFACEMETHODIMP_(ULONG) Release() override
+            {
+                ULONG refs = --refs_;
+                if (refs == 0)
+                    delete this;
+                return refs;
+            }
+
+            // IDataObject
+            IFACEMETHODIMP GetData(FORMATETC* format, STGMEDIUM* medium) override
+            {
+                if (!format || !medium)
+                    return E_INVALIDARG;
+                *medium = {};
+
+                HRESULT supported = QueryGetData(format);
+                if (FAILED(supported))
+                    return supported;
+
+                if (format->cfFormat == kFileContents)
+                {
+                    // lindex counts the descriptors, which leave out some files
+                    const Descriptors& descriptors = GetDescriptors();
+                    if (format->lindex < 0 || static_cast<size_t>(format->lindex) >= descriptors.sources.size())
+                        return DV_E_LINDEX;
+
+                    size_t index = descriptors.sources[static_cast<size_t>(format->lindex)];
+                    ShellVirtualFile file = source_->Describe(index);
+                    auto reader = file.is_directory ? nullptr : source_->Open(index);
+                    if (!reader)
+                        return E_FAIL;
+
+                    size_t slash = file.name.find_last_of(L'\\');
+                    medium->tymed = TYMED_ISTREAM;
+                    medium->pstm = new FileStream(std::move(reader), file.size,
+                                                  slash == std::wstring::npos ? file.name : file.name.substr(slash + 1));
+                    return S_OK;
+                }
+
+                HGLOBAL global = nullptr;
+                if (format->cfFormat == CF_HDROP)
+                {
+                    const std::wstring& paths = DropFiles();
+                    DROPFILES header = {};
+                    header.pFiles = sizeof(DROPFILES);
+                    header.fWide = TRUE;
+
+                    size_t bytes = sizeof(DROPFILES) + paths.size() * sizeof(wchar_t);
+                    global = GlobalAlloc(GMEM_MOVEABLE, bytes);
+                    if (auto* target = global ? static_cast<char*>(GlobalLock(global)) : nullptr)
+                    {
+                        std::memcpy(target, &header, sizeof(header));
+                        std::memcpy(target + sizeof(header), paths.data(), paths.size() * sizeof(wchar_t));
+                        GlobalUnlock(global);
+                    }
+                    else if (global)
+                    {
+                        GlobalFree(global);
+                        global = nullptr;
+                    }
+                }
+                else if (format->cfFormat == kFileDescriptor)
+                {
+                    global = FileDescriptors();
+                }
+                else if (format->cfFormat == kPreferredEffect)
+                {
+                    global = AllocCopy(&preferred_effect_, sizeof(preferred_effect_));
+                }
+
+                if (!global)
+                    return E_OUTOFMEMORY;
+                medium->tymed = TYMED_HGLOBAL;
+                medium->hGlobal = global;
+                return S_OK;
+            }
+
+            IFACEMETHODIMP GetDataHere(FORMATETC*, STGMEDIUM*) override { return E_NOTIMPL; }
+
+            IFACEMETHODIMP QueryGetData(FORMATETC* format) override
+            {
+                if (!format)
+                    return E_INVALIDARG;
+                if (format->dwAspect != DVASPECT_CONTENT)
+                    return DV_E_DVASPECT;
+
+                for (const FORMATETC& offered : Formats())
+                {
+                    if (offered.cfFormat != format->cfFormat)
+                        continue;
+                    if (!(offered.tymed & format->tymed))
+                        return DV_E_TYMED;
+                    if (offered.cfFormat != kFileContents && format->lindex != -1)
+                        return DV_E_LINDEX;
+                    return S_OK;
+                }
+                return DV_E_FORMATETC;
+            }
+
+            IFACEMETHODIMP GetCanonicalFormatEtc(FORMATETC*, FORMATETC* out) override
+            {
+                if (out)
+                    out->ptd = nullptr;
+                return E_NOTIMPL;
+            }
+
+            IFACEMETHODIMP SetData(FORMATETC* format, STGMEDIUM* medium, BOOL release) override
+            {
+                // A target reports how a paste or optimized move went; the
+                // files it moved are seen by the file watch
+                if (!format || !medium ||
+                    (format->cfFormat != kPerformedEffect && format->cfFormat != kPasteSucceeded))
+                {
+                    return E_NOTIMPL;
+                }
+
+                DWORD value = DROPEFFECT_NONE;
+                if (ReadDword(*medium, value))
+                    SPDLOG_DEBUG("Shell target reported drop effect {}", value);
+                if (release)
+                    ReleaseStgMedium(medium);
+                return S_OK;
+            }
+
+            IFACEMETHODIMP EnumFormatEtc(DWORD direction, IEnumFORMATETC** enumerator) override
+            {
+                if (direction != DATADIR_GET)
+                    return E_NOTIMPL;
+                auto formats = Formats();
+                return SHCreateStdEnumFmtEtc(static_cast<UINT>(formats.size()), formats.data(), enumerator);
+            }
+
+            IFACEMETHODIMP DAdvise(FORMATETC*, DWORD, IAdviseSink*, DWORD*) override { return OLE_E_ADVISENOTSUPPORTED; }
+            IFACEMETHODIMP DUnadvise(DWORD) override { return OLE_E_ADVISENOTSUPPORTED; }
+            IFACEMETHODIMP EnumDAdvise(IEnumSTATDATA**) override { return OLE_E_ADVISENOTSUPPORTED; }
+
+        private:
+            static inline const CLIPFORMAT kPreferredEffect =
+                static_cast<CLIPFORMAT>(RegisterClipboardFormatW(CFSTR_PREFERREDDROPEFFECT));
+            static inline const CLIPFORMAT kPerformedEffect =
+                static_cast<CLIPFORMAT>(RegisterClipboardFormatW(CFSTR_PERFORMEDDROPEFFECT));
+            static inline const CLIPFORMAT kPasteSucceeded =
+                static_cast<CLIPFORMAT>(RegisterClipboardFormatW(CFSTR_PASTESUCCEEDED));
+            static inline const CLIPFORMAT kFileDescriptor =
+                static_cast<CLIPFORMAT>(RegisterClipboardFormatW(CFSTR_FILEDESCRIPTORW));
+            static inline const CLIPFORMAT kFileContents =
+                static_cast<CLIPFORMAT>(RegisterClipboardFormatW(CFSTR_FILECONTENTS));
+
+            std::vector<FORMATETC> Formats() const
+            {
+                std::vector<FORMATETC> formats;
+                if (source_->HasPaths())
+                {
+                    formats.push_back({CF_HDROP, nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL});
+                }
+                else
+                {
+                    formats.push_back({kFileDescriptor, nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL});
+                    formats.push_back({kFileContents, nullptr, DVASPECT_CONTENT, -1, TYMED_ISTREAM});
+                }
+                formats.push_back({kPreferredEffect, nullptr, DVASPECT_CONTENT, -1, TYMED_HGLOBAL});
+                return formats;
+            }
+
+            // Every path, each ending in a null, and one more null after them
+            const std::wstring& DropFiles()
+            {
+                std::call_once(drop_files_once_, [this]()
+                {
+                    OPACITY_PROFILE_ZONE("ShellDataObject::DropFiles");
+                    size_t count = source_->Count();
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        drop_files_ += source_->GetPath(i);
+                        drop_files_ += L'\0';
+                    }
+                    drop_files_ += L'\0';
+                    drop_files_.shrink_to_fit();
+                    SPDLOG_DEBUG("Rendered {} paths for the shell", count);
+                });
+                return drop_files_;
+            }
+
+            // One descriptor per file whose name fits, and the file each is for
+            struct Descriptors
+            {
+                std::vector<FILEDESCRIPTORW> items;
+                std::vector<size_t> sources;
+            };
+
+            const Descriptors& GetDescriptors()
+            {
+                std::call_once(descriptors_once_, [this]()
+                {
+                    OPACITY_PROFILE_ZONE("ShellDataObject::FileDescriptors");
+                    size_t count = source_->Count();
+                    descriptors_.items.reserve(count);
+                    descriptors_.sources.reserve(count);
+
+                    // cFileName holds MAX_PATH characters with the terminator,
+                    // and that covers the path below the drop folder too. A
+                    // cut-off name would land as a different file, so longer
+                    // ones are left out of the drag with a warning; everything
+                    // below a folder left out goes too
+                    size_t skipped = 0;
+                    for (size_t i = 0; i < count; ++i)
+                    {
+                        ShellVirtualFile file = source_->Describe(i);
+                        if (file.name.size() >= MAX_PATH)
+                        {
+                            ++skipped;
+                            continue;
+                        }
+
+                        FILEDESCRIPTORW descriptor = {};
+                        descriptor.dwFlags = FD_ATTRIBUTES | FD_WRITESTIME | FD_PROGRESSUI | FD_UNICODE;
+                        descriptor.dwFileAttributes = file.is_directory ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+                        descriptor.ftLastWriteTime = ToFileTime(file.modified);
+                        if (!file.is_directory)
+                        {
+                            descriptor.dwFlags |= FD_FILESIZE;
+                            descriptor.nFileSizeLow = static_cast<DWORD>(file.size);
+                            descriptor.nFileSizeHigh = static_cast<DWORD>(file.size >> 32);
+                        }
+                        std::copy(file.name.begin(), file.name.end(), descriptor.cFileName);
+                        descriptors_.items.push_back(descriptor);
+                        descriptors_.sources.push_back(i);
+                    }
+                    if (skipped > 0)
+                        SPDLOG_WARN("Left {} of {} files out of the drag; their names are too long", skipped, count);
+                });
+                return descriptors_;
+            }
+
+            HGLOBAL FileDescriptors()
+            {
+                const Descriptors& descriptors = GetDescriptors();
+                size_t count = descriptors.items.size();
+                size_t bytes = offsetof(FILEGROUPDESCRIPTORW, fgd) + std::max<size_t>(count, 1) * sizeof(FILEDESCRIPTORW);
+                HGLOBAL global = GlobalAlloc(GMEM_MOVEABLE | GMEM_ZEROINIT, bytes);
+                auto* group = global ? static_cast<FILEGROUPDESCRIPTORW*>(GlobalLock(global)) : nullptr;
+                if (!group)
+                {
+                    if (global)
+                        GlobalFree(global);
+                    return nullptr;
+                }
+
+                group->cItems = static_cast<UINT>(count);
+                if (count > 0)
+                    std::memcpy(group->fgd, descriptors.items.data(), count * sizeof(FILEDESCRIPTORW));
+                GlobalUnlock(global);
+                return global;
+            }
+
+            std::atomic<ULONG> refs_{1};
+            std::shared_ptr<ShellFileSource> source_;
+            DWORD preferred_effect_;
+            std::once_flag drop_files_once_;
+            std::wstring drop_files_;
+            std::once_flag descriptors_once_;
+            Descriptors descriptors_;
+        };
+
+        class DropSource : public IDropSource
+        {
+        public:
+            IFACEMETHODIMP QueryInterface(REFIID riid, void** object) override
+            {
+                if (!object)
+                    return E_POINTER;
+                if (riid == IID_IUnknown || riid == IID_IDropSource)
+                {
+                    *object = static_cast<IDropSource*>(this);
+                    AddRef();
+                    return S_OK;
+                }
+                *object = nullptr;
+                return E_NOINTERFACE;
+            }
+
+            IFACEMETHODIMP_(ULONG) AddRef() override { return ++refs_; }
+
+            IFACEMETHODIMP_(ULONG) Release() override
+            {
+                ULONG refs = --refs_;
+                if (refs == 0)
+                    delete this;
+                return refs;
+            }
+
+            IFACEMETHODIMP QueryContinueDrag(BOOL escape, DWORD keys) override
+            {
+                if (escape)
+                    return DRAGDROP_S_CANCEL;
+                if (!(keys & (MK_LBUTTON | MK_RBUTTON)))
+                    return DRAGDROP_S_DROP;
+                return S_OK;
+            }
+
+            IFACEMETHODIMP GiveFeedback(DWORD) override { return DRAGDROP_S_USEDEFAULTCURSORS; }
+
+        private:
+            std::atomic<ULONG> refs_{1};
+        };
+
+        // Ours while on the clipboard, so exit can render it; UI thread only
+        FileDataObject* g_clipboard = nullptr;
+
+        void ReleaseClipboardObject()
+        {
+            if (g_clipboard)
+            {
+                g_clipboard->Release();
+                g_clipboard = nullptr;
+            }
+        }
+    }
+
+    bool ShellIntegration::SetClipboardFiles(std::shared_ptr<ShellFileSource> source, ShellDropEffect effect)
+    {
+        if (!source || !EnsureOle())
+            return false;
+
+        auto* data = new FileDataObject(std::move(source), ToDropEffect(effect));
+        HRESULT hr = OleSetClipboard(data);
+        if (FAILED(hr))
+        {
+            SPDLOG_WARN("Could not set the clipboard ({:#x})", static_cast<uint32_t>(hr));
+            data->Release();
+            return false;
+        }
+
+        ReleaseClipboardObject();
+        g_clipboard = data;
+        return true;
+    }
+
+    void ShellIntegration::FlushClipboard()
+    {
+        if (!g_clipboard)
+            return;
+
+        if (OleIsCurrentClipboard(g_clipboard) == S_OK)
+        {
+            if (g_clipboard->HasPaths())
+                OleFlushClipboard();
+            else
+                OleSetClipboard(nullptr);
+        }
+        ReleaseClipboardObject();
+    }
+
+    ShellDropEffect ShellIntegration::DragFiles(std::shared_ptr<ShellFileSource> source)
+    {
+        if (!source || !EnsureOle())
+            return ShellDropEffect::None;
+
+        // Virtual files can only be copied out
+        DWORD allowed = source->HasPaths() ? DROPEFFECT_COPY | DROPEFFECT_MOVE | DROPEFFECT_LINK : DROPEFFECT_COPY;
+        auto* data = new FileDataObject(std::move(source), DROPEFFECT_NONE);
+        auto* drop_source = new DropSource();
+
+        DWORD effect = DROPEFFECT_NONE;
+        HRESULT hr = DoDragDrop(data, drop_source, allowed, &effect);
+        drop_source->Release();
+        data->Release();
+
+        return hr == DRAGDROP_S_DROP ? FromDropEffect(effect) : ShellDropEffect::None;
+    }
+#else
+    bool ShellIntegration::SetClipboardFiles(std::shared_ptr<ShellFileSource>, ShellDropEffect)
+    {
+        return false;
+    }
+
+    void ShellIntegration::FlushClipboard()
+    {
+    }
+
+    ShellDropEffect ShellIntegration::DragFiles(std::shared_ptr<ShellFileSource>)
+    {
+        return ShellDropEffect::None;
+    }
+#endif
+
+} // namespace opacity::core
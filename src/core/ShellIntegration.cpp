@@ -563,8 +563,9 @@ namespace opacity::core
             // Check if it's a command
             else if (result.command.empty() && 
                      (arg == "open" || arg == "search" || arg == "compare" || 
-                      arg == "help" || arg == "version" || arg == "register" ||
-                      arg == "unregister"))
+                      arg == "dedupe" || arg == "extract" || arg == "archive" ||
+                      arg == "copy" || arg == "help" || arg == "version" ||
+                      arg == "resident" || arg == "register" || arg == "unregister"))
             {
                 result.command = arg;
             }
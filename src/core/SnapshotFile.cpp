@@ -0,0 +1,79 @@
+#include "opacity/core/SnapshotFile.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/Logger.h"
+
+#include <fstream>
+#include <system_error>
+
+namespace opacity::core
+{
+    SnapshotFile::SnapshotFile(std::filesystem::path path)
+        : path_(std::move(path))
+    {
+    }
+
+    void SnapshotFile::SetPath(std::filesystem::path path)
+    {
+        if (path != path_) {
+            path_ = std::move(path);
+            Reset();
+        }
+    }
+
+    uint64_t SnapshotFile::Digest(std::string_view state)
+    {
+        Xxh64 hash;
+        hash.Update(state.data(), state.size());
+        return hash.Digest();
+    }
+
+    bool SnapshotFile::Unchanged(std::string_view state) const
+    {
+        return written_ && size_ == state.size() && digest_ == Digest(state);
+    }
+
+    bool SnapshotFile::Write(std::string_view state, std::string_view content)
+    {
+        if (!WriteAtomic(path_, content)) {
+            return false;
+        }
+        digest_ = Digest(state);
+        size_ = state.size();
+        written_ = true;
+        return true;
+    }
+
+    void SnapshotFile::Reset()
+    {
+        written_ = false;
+    }
+
+    bool SnapshotFile::WriteAtomic(const std::filesystem::path& path, std::string_view content)
+    {
+        std::error_code ec;
+        if (path.has_parent_path()) {
+            std::filesystem::create_directories(path.parent_path(), ec);
+        }
+
+        auto tempPath = path;
+        tempPath += ".tmp";
+        {
+            std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+            file.write(content.data(), static_cast<std::streamsize>(content.size()));
+            file.flush();
+            if (!file) {
+                Logger::Get()->error("SnapshotFile: Failed to write {}", tempPath.string());
+                return false;
+            }
+        }
+
+        std::filesystem::rename(tempPath, path, ec);
+        if (ec) {
+            Logger::Get()->error("SnapshotFile: Failed to replace {}: {}", path.string(), ec.message());
+            std::filesystem::remove(tempPath, ec);
+            return false;
+        }
+        return true;
+    }
+
+} // namespace opacity::core
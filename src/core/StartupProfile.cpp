@@ -0,0 +1,117 @@
+#include "opacity/core/StartupProfile.h"
+#include "opacity/core/Logger.h"
+
+#include <mutex>
+
+namespace opacity::core
+{
+    namespace
+    {
+        std::mutex g_mutex;
+        uint64_t g_begin = 0;
+        uint64_t g_interactive = 0;
+        uint64_t g_complete = 0;
+        std::vector<StartupPhase> g_phases;
+
+        double Milliseconds(uint64_t nanoseconds)
+        {
+            return static_cast<double>(nanoseconds) / 1'000'000.0;
+        }
+    }
+
+    void StartupProfile::Begin()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_begin == 0)
+            g_begin = Profiler::Now();
+    }
+
+    void StartupProfile::Record(const char* name, uint64_t start, uint64_t end, bool critical)
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        if (g_begin == 0)
+            g_begin = start;
+        g_phases.push_back(StartupPhase{name, start, end, critical});
+    }
+
+    void StartupProfile::MarkInteractive()
+    {
+        uint64_t begin;
+        uint64_t now = Profiler::Now();
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            if (g_interactive != 0)
+                return;
+            g_interactive = now;
+            begin = g_begin;
+        }
+
+        uint64_t elapsed = now - begin;
+        if (elapsed > kInteractiveTarget)
+            SPDLOG_WARN("Interactive after {:.1f} ms, over the {:.0f} ms target",
+                        Milliseconds(elapsed), Milliseconds(kInteractiveTarget));
+        else
+            SPDLOG_INFO("Interactive after {:.1f} ms", Milliseconds(elapsed));
+    }
+
+    void StartupProfile::MarkComplete()
+    {
+        std::vector<StartupPhase> phases;
+        uint64_t begin;
+        uint64_t interactive;
+        uint64_t now = Profiler::Now();
+        {
+            std::lock_guard<std::mutex> lock(g_mutex);
+            if (g_complete != 0)
+                return;
+            g_complete = now;
+            phases = g_phases;
+            begin = g_begin;
+            interactive = g_interactive;
+        }
+
+        SPDLOG_INFO("Startup complete after {:.1f} ms (interactive after {:.1f} ms):",
+                    Milliseconds(now - begin), Milliseconds(interactive ? interactive - begin : 0));
+        for (const auto& phase : phases)
+        {
+            SPDLOG_INFO("  {:<24} {:>8.1f} ms at {:>8.1f} ms{}", phase.name,
+                        Milliseconds(phase.end - phase.start), Milliseconds(phase.start - begin),
+                        phase.critical ? "" : " (deferred)");
+        }
+    }
+
+    uint64_t StartupProfile::GetBegin()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_begin;
+    }
+
+    uint64_t StartupProfile::GetInteractive()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_interactive;
+    }
+
+    uint64_t StartupProfile::GetComplete()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_complete;
+    }
+
+    std::vector<StartupPhase> StartupProfile::GetPhases()
+    {
+        std::lock_guard<std::mutex> lock(g_mutex);
+        return g_phases;
+    }
+
+    StartupScope::StartupScope(const char* name, bool critical)
+        : zone_(name), name_(name), critical_(critical), start_(Profiler::Now())
+    {
+    }
+
+    StartupScope::~StartupScope()
+    {
+        StartupProfile::Record(name_, start_, Profiler::Now(), critical_);
+    }
+
+} // namespace opacity::core
@@ -0,0 +1,424 @@
+// SPDX-License-Identifier: MIT
+// Copyright (c) 2025 Opacity Project
+
+#include "opacity/core/TagJournal.h"
+#include "opacity/core/Hash.h"
+#include <spdlog/spdlog.h>
+#include <algorithm>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+namespace fs = std::filesystem;
+
+namespace opacity { namespace core {
+
+namespace {
+
+constexpr uint32_t kLogMagic = 0x4C4A5447;      // "GTJL"
+constexpr uint32_t kRecordMagic = 0x524A5447;   // "GTJR"
+constexpr uint32_t kVersion = 1;
+
+// Logs smaller than this are never worth a snapshot
+constexpr uint64_t kMinCompactBytes = 4 * 1024 * 1024;
+
+struct LogHeader {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t generation;
+};
+
+struct RecordHeader {
+    uint32_t magic;
+    uint32_t length;        // Of the payload that follows
+    uint32_t checksum;      // Of type and payload
+    uint8_t type;
+    uint8_t reserved[3];
+};
+
+static_assert(sizeof(LogHeader) == 16, "header is written as is");
+static_assert(sizeof(RecordHeader) == 16, "record header is written as is");
+
+uint32_t Checksum(uint8_t type, std::string_view payload) {
+    Xxh64 hash;
+    hash.Update(&type, 1);
+    hash.Update(payload.data(), payload.size());
+    return static_cast<uint32_t>(hash.Digest());
+}
+
+template <typename T>
+void WriteRaw(std::ostream& stream, const T& value) {
+    stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+} // namespace
+
+class TagJournal::Impl {
+public:
+    struct Task {
+        uint64_t generation = 0;
+        std::string records;
+        SnapshotWriter snapshot;    // Set for a compaction, which has no records
+    };
+
+    std::string databasePath;
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::deque<Task> tasks;
+    bool busy = false;
+    bool stop = false;
+    bool failed = false;
+    uint64_t generation = 0;
+    uint64_t logBytes = 0;          // Appended since the last snapshot began
+    uint64_t snapshotBytes = 0;
+
+    // Writer thread only, once it runs
+    std::ofstream log;
+    uint64_t logGeneration = UINT64_MAX;
+
+    std::thread writer;
+
+    bool openLog(uint64_t gen) {
+        if (log.is_open() && logGeneration == gen) {
+            return true;
+        }
+        log.close();
+        logGeneration = UINT64_MAX;
+
+        std::string path = logPath(databasePath, gen);
+        std::error_code ec;
+        uint64_t size = fs::file_size(path, ec);
+        if (ec || size < sizeof(LogHeader)) {
+            std::ofstream out(path, std::ios::binary | std::ios::trunc);
+            WriteRaw(out, LogHeader{kLogMagic, kVersion, gen});
+            if (!out) {
+                spdlog::error("TagJournal: cannot write {}", path);
+                return false;
+            }
+        }
+
+        log.open(path, std::ios::binary | std::ios::app);
+        if (!log.is_open()) {
+            spdlog::error("TagJournal: cannot open {}", path);
+            return false;
+        }
+        logGeneration = gen;
+        return true;
+    }
+
+    // Replays one log; returns the bytes of it that hold whole records
+    uint64_t replay(uint64_t gen, const RecordHandler& handler) {
+        std::string path = logPath(databasePath, gen);
+        std::string data;
+        {
+            std::ifstream in(path, std::ios::binary);
+            std::error_code ec;
+            uint64_t size = fs::file_size(path, ec);
+            if (!in || ec) {
+                return 0;
+            }
+            data.resize(static_cast<size_t>(size));
+            in.read(data.data(), static_cast<std::streamsize>(data.size()));
+            data.resize(static_cast<size_t>(in.gcount()));
+        }
+
+        LogHeader header{};
+        if (data.size() < sizeof(LogHeader)) {
+            return 0;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        if (header.magic != kLogMagic || header.version != kVersion || header.generation != gen) {
+            spdlog::warn("TagJournal: ignoring unreadable log {}", path);
+            return 0;
+        }
+
+        size_t end = sizeof(LogHeader);
+        size_t records = 0;
+        while (data.size() - end >= sizeof(RecordHeader)) {
+            RecordHeader record{};
+            std::memcpy(&record, data.data() + end, sizeof(record));
+            size_t payloadAt = end + sizeof(RecordHeader);
+            if (record.magic != kRecordMagic || record.length > data.size() - payloadAt) {
+                break;
+            }
+            std::string_view payload(data.data() + payloadAt, record.length);
+            if (record.checksum != Checksum(record.type, payload)) {
+                break;
+            }
+            handler(record.type, payload);
+            end = payloadAt + record.length;
+            ++records;
+        }
+
+        if (end < data.size()) {
+            spdlog::warn("TagJournal: dropping {} torn bytes from {}", data.size() - end, path);
+        }
+        spdlog::debug("TagJournal: replayed {} records from {}", records, path);
+        return end;
+    }
+
+    void writerLoop() {
+        std::unique_lock<std::mutex> lock(mutex);
+        for (;;) {
+            wake.wait(lock, [this] { return stop || !tasks.empty(); });
+            if (tasks.empty()) {
+                break;
+            }
+
+            Task task = std::move(tasks.front());
+            tasks.pop_front();
+            busy = true;
+            lock.unlock();
+
+            bool ok;
+            uint64_t bytes = 0;
+            try {
+                ok = task.snapshot ? compactTo(task.generation, task.snapshot, bytes)
+                                   : writeRecords(task.generation, task.records);
+            } catch (const std::exception& e) {
+                spdlog::error("TagJournal: write failed: {}", e.what());
+                ok = false;
+            }
+
+            lock.lock();
+            busy = false;
+            if (!ok) {
+                failed = true;
+            }
+            if (task.snapshot && ok) {
+                snapshotBytes = bytes;
+            }
+            idle.notify_all();
+        }
+    }
+
+    bool writeRecords(uint64_t gen, const std::string& records) {
+        if (!openLog(gen)) {
+            return false;
+        }
+        log.write(records.data(), static_cast<std::streamsize>(records.size()));
+        log.flush();
+        return static_cast<bool>(log);
+    }
+
+    bool compactTo(uint64_t gen, const SnapshotWriter& snapshot, uint64_t& bytes) {
+        if (!writeSnapshot(databasePath, gen, snapshot, &bytes)) {
+            return false;
+        }
+
+        // The snapshot covers every older log now; the open one included,
+        // which Windows will not delete while it is open
+        log.close();
+        logGeneration = UINT64_MAX;
+        std::error_code ec;
+        for (uint64_t old = gen; old-- > 0;) {
+            std::string path = logPath(databasePath, old);
+            if (!fs::remove(path, ec)) {
+                break;
+            }
+        }
+        spdlog::debug("TagJournal: compacted to generation {} ({} bytes)", gen, bytes);
+        return true;
+    }
+};
+
+TagJournal::TagJournal() : pImpl(std::make_unique<Impl>()) {}
+
+TagJournal::~TagJournal() {
+    close();
+}
+
+bool TagJournal::open(const std::string& databasePath, uint64_t generation, uint64_t snapshotBytes,
+                      const RecordHandler& handler) {
+    close();
+
+    pImpl->databasePath = databasePath;
+    pImpl->snapshotBytes = snapshotBytes;
+    pImpl->logBytes = 0;
+    pImpl->failed = false;
+    pImpl->stop = false;
+
+    // Each compaction that never wrote its snapshot left one more log
+    uint64_t gen = generation;
+    uint64_t good = pImpl->replay(gen, handler);
+    pImpl->logBytes += good;
+    while (fs::exists(logPath(databasePath, gen + 1))) {
+        std::error_code ec;
+        if (good < fs::file_size(logPath(databasePath, gen), ec) && !ec) {
+            fs::resize_file(logPath(databasePath, gen), good, ec);
+        }
+        ++gen;
+        good = pImpl->replay(gen, handler);
+        pImpl->logBytes += good;
+    }
+
+    // The next record goes where a torn one was
+    std::error_code ec;
+    std::string newest = logPath(databasePath, gen);
+    uint64_t size = fs::file_size(newest, ec);
+    if (!ec && good < size) {
+        fs::resize_file(newest, good, ec);
+        if (ec) {
+            spdlog::error("TagJournal: cannot truncate {}: {}", newest, ec.message());
+            return false;
+        }
+    }
+
+    pImpl->generation = gen;
+    if (!pImpl->openLog(gen)) {
+        return false;
+    }
+
+    pImpl->writer = std::thread([impl = pImpl.get()] { impl->writerLoop(); });
+    spdlog::debug("TagJournal: opened generation {}", gen);
+    return true;
+}
+
+void TagJournal::close() {
+    if (!pImpl->writer.joinable()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        pImpl->stop = true;
+    }
+    pImpl->wake.notify_all();
+    pImpl->writer.join();
+    pImpl->log.close();
+    pImpl->logGeneration = UINT64_MAX;
+}
+
+bool TagJournal::isOpen() const {
+    return pImpl->writer.joinable();
+}
+
+void TagJournal::append(uint8_t type, const std::string& payload) {
+    append({{type, payload}});
+}
+
+void TagJournal::append(const std::vector<std::pair<uint8_t, std::string>>& records) {
+    if (records.empty()) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+
+        // Whatever queues up while the writer is busy goes in its next write
+        auto& tasks = pImpl->tasks;
+        if (tasks.empty() || tasks.back().snapshot) {
+            Impl::Task task;
+            task.generation = pImpl->generation;
+            tasks.push_back(std::move(task));
+        }
+        std::string& out = tasks.back().records;
+        for (const auto& [type, payload] : records) {
+            RecordHeader header{};
+            header.magic = kRecordMagic;
+            header.length = static_cast<uint32_t>(payload.size());
+            header.checksum = Checksum(type, payload);
+            header.type = type;
+            out.append(reinterpret_cast<const char*>(&header), sizeof(header));
+            out += payload;
+            pImpl->logBytes += sizeof(header) + payload.size();
+        }
+    }
+    pImpl->wake.notify_one();
+}
+
+bool TagJournal::wantsCompaction() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return pImpl->logBytes > std::max(kMinCompactBytes, pImpl->snapshotBytes);
+}
+
+void TagJournal::compact(SnapshotWriter writer) {
+    {
+        std::lock_guard<std::mutex> lock(pImpl->mutex);
+        Impl::Task task;
+        task.generation = ++pImpl->generation;
+        task.snapshot = std::move(writer);
+        pImpl->tasks.push_back(std::move(task));
+        pImpl->logBytes = 0;
+    }
+    pImpl->wake.notify_one();
+}
+
+bool TagJournal::flush() {
+    std::unique_lock<std::mutex> lock(pImpl->mutex);
+    if (!pImpl->writer.joinable()) {
+        return !pImpl->failed;
+    }
+    pImpl->idle.wait(lock, [this] { return pImpl->tasks.empty() && !pImpl->busy; });
+    bool ok = !pImpl->failed;
+    pImpl->failed = false;
+    return ok;
+}
+
+uint64_t TagJournal::getGeneration() const {
+    std::lock_guard<std::mutex> lock(pImpl->mutex);
+    return pImpl->generation;
+}
+
+bool TagJournal::writeSnapshot(const std::string& databasePath, uint64_t generation,
+                               const SnapshotWriter& writer, uint64_t* bytes) {
+    fs::path dir = fs::path(databasePath).parent_path();
+    std::error_code ec;
+    if (!dir.empty()) {
+        fs::create_directories(dir, ec);
+    }
+
+    std::string temp = databasePath + ".tmp";
+    {
+        std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            spdlog::error("TagJournal: failed to open {} for writing", temp);
+            return false;
+        }
+        if (!writer(out, generation)) {
+            return false;
+        }
+        out.flush();
+        if (!out) {
+            spdlog::error("TagJournal: failed to write {}", temp);
+            return false;
+        }
+        if (bytes) {
+            *bytes = static_cast<uint64_t>(out.tellp());
+        }
+    }
+
+    // Readers see the old snapshot or the new one, never half of either
+    fs::rename(temp, databasePath, ec);
+    if (ec) {
+        spdlog::error("TagJournal: failed to replace {}: {}", databasePath, ec.message());
+        fs::remove(temp, ec);
+        return false;
+    }
+    return true;
+}
+
+void TagJournal::removeLogs(const std::string& databasePath) {
+    fs::path path(databasePath);
+    std::string prefix = path.filename().string() + ".";
+    std::error_code ec;
+    fs::directory_iterator it(path.parent_path().empty() ? fs::path(".") : path.parent_path(), ec);
+    for (; !ec && it != fs::directory_iterator(); it.increment(ec)) {
+        std::string name = it->path().filename().string();
+        if (name.size() > prefix.size() + 4 && name.compare(0, prefix.size(), prefix) == 0 &&
+            name.compare(name.size() - 4, 4, ".wal") == 0) {
+            std::error_code removeEc;
+            fs::remove(it->path(), removeEc);
+        }
+    }
+}
+
+std::string TagJournal::logPath(const std::string& databasePath, uint64_t generation) {
+    return databasePath + "." + std::to_string(generation) + ".wal";
+}
+
+}} // namespace opacity::core
@@ -2,8 +2,11 @@
 // Copyright (c) 2025 Opacity Project
 
 #include "opacity/core/TagManager.h"
+#include "opacity/core/TagJournal.h"
+#include "opacity/core/HashCache.h"
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
+#include <cstring>
 #include <fstream>
 #include <algorithm>
 #include <random>
@@ -132,6 +135,10 @@ void to_json(json& j, const TagAssignment& a) {
         {"assignedAt", TimePointToString(a.assignedAt)},
         {"assignedBy", a.assignedBy}
     };
+    if (a.fileIndex != 0) {
+        j["volumeSerial"] = a.volumeSerial;
+        j["fileIndex"] = a.fileIndex;
+    }
 }
 
 void from_json(const json& j, TagAssignment& a) {
@@ -139,6 +146,77 @@ void from_json(const json& j, TagAssignment& a) {
     j.at("filePath").get_to(a.filePath);
     if (j.contains("assignedAt")) a.assignedAt = StringToTimePoint(j.at("assignedAt").get<std::string>());
     if (j.contains("assignedBy")) j.at("assignedBy").get_to(a.assignedBy);
+    if (j.contains("volumeSerial")) j.at("volumeSerial").get_to(a.volumeSerial);
+    if (j.contains("fileIndex")) j.at("fileIndex").get_to(a.fileIndex);
+}
+
+// Volume serial and file id of a path; false when it has none to go by
+static bool ReadFileIdentity(const std::string& path, uint64_t& volumeSerial, uint64_t& fileIndex) {
+    FileIdentity identity;
+    if (!HashCache::ReadIdentity(Path(path), identity) || identity.volume == 0) {
+        return false;
+    }
+    volumeSerial = identity.volume;
+    fileIndex = identity.file_id;
+    return true;
+}
+
+// Where a file that was at oldPath went, found by its id on the same
+// volume without searching; empty if it is gone or cannot be told
+static std::string LocateFile(const std::string& oldPath, uint64_t volumeSerial, uint64_t fileIndex) {
+    if (fileIndex == 0) {
+        return "";
+    }
+    
+    std::wstring wide = Path(oldPath).WString();
+    wchar_t root[MAX_PATH];
+    if (!GetVolumePathNameW(wide.c_str(), root, MAX_PATH)) {
+        return "";
+    }
+    
+    const DWORD share = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
+    HANDLE volume = CreateFileW(root, 0, share, nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+    if (volume == INVALID_HANDLE_VALUE) {
+        return "";
+    }
+    
+    FILE_ID_DESCRIPTOR descriptor = {};
+    descriptor.dwSize = sizeof(descriptor);
+    descriptor.Type = FileIdType;
+    descriptor.FileId.QuadPart = static_cast<LONGLONG>(fileIndex);
+    HANDLE file = OpenFileById(volume, &descriptor, FILE_READ_ATTRIBUTES, share, nullptr, FILE_FLAG_BACKUP_SEMANTICS);
+    CloseHandle(volume);
+    if (file == INVALID_HANDLE_VALUE) {
+        return "";
+    }
+    
+    // File ids are only unique within a volume
+    std::wstring found;
+    BY_HANDLE_FILE_INFORMATION info;
+    if (GetFileInformationByHandle(file, &info) && info.dwVolumeSerialNumber == volumeSerial) {
+        std::vector<wchar_t> buffer(32768);
+        DWORD length = GetFinalPathNameByHandleW(file, buffer.data(), static_cast<DWORD>(buffer.size()),
+                                                 FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+        if (length > 0 && length < buffer.size()) {
+            found.assign(buffer.data(), length);
+        }
+    }
+    CloseHandle(file);
+    
+    if (found.compare(0, 8, L"\\\\?\\UNC\\") == 0) {
+        found = L"\\\\" + found.substr(8);
+    } else if (found.compare(0, 4, L"\\\\?\\") == 0) {
+        found = found.substr(4);
+    }
+    return found.empty() ? "" : Path(std::filesystem::path(found)).String();
+}
+
+// Whether path is base or lies under it
+static bool IsSameOrUnder(const std::string& path, const std::string& base) {
+    if (path.compare(0, base.size(), base) != 0) {
+        return false;
+    }
+    return path.size() == base.size() || path[base.size()] == '\\' || path[base.size()] == '/';
 }
 
 void to_json(json& j, const SmartTagRule& r) {
@@ -169,6 +247,67 @@ void from_json(const json& j, SmartTagRule& r) {
     if (j.contains("description")) j.at("description").get_to(r.description);
 }
 
+// Journal records; tags and rules go as JSON, being few and rarely changed
+enum RecordType : uint8_t {
+    TagPut = 1,
+    TagDelete = 2,
+    Assign = 3,
+    Unassign = 4,
+    RulePut = 5,
+    RuleDelete = 6,
+    Move = 7
+};
+
+static void PutString(std::string& out, const std::string& value) {
+    uint32_t length = static_cast<uint32_t>(value.size());
+    out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+    out += value;
+}
+
+static void PutInt64(std::string& out, int64_t value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+static bool GetString(std::string_view& in, std::string& value) {
+    uint32_t length;
+    if (in.size() < sizeof(length)) return false;
+    std::memcpy(&length, in.data(), sizeof(length));
+    in.remove_prefix(sizeof(length));
+    if (in.size() < length) return false;
+    value.assign(in.data(), length);
+    in.remove_prefix(length);
+    return true;
+}
+
+static bool GetInt64(std::string_view& in, int64_t& value) {
+    if (in.size() < sizeof(value)) return false;
+    std::memcpy(&value, in.data(), sizeof(value));
+    in.remove_prefix(sizeof(value));
+    return true;
+}
+
+static std::string AssignmentKey(const std::string& tagId, const std::string& filePath) {
+    return tagId + '\n' + filePath;
+}
+
+// What a snapshot holds, copied so it can be written on the journal's thread
+struct TagSnapshot {
+    std::vector<Tag> tags;
+    std::vector<TagAssignment> assignments;
+    std::vector<SmartTagRule> rules;
+};
+
+static bool WriteSnapshot(std::ostream& out, uint64_t generation, const TagSnapshot& data) {
+    json j;
+    j["version"] = 1;
+    j["generation"] = generation;
+    j["tags"] = data.tags;
+    j["assignments"] = data.assignments;
+    j["rules"] = data.rules;
+    out << j.dump(2);
+    return static_cast<bool>(out);
+}
+
 class TagManager::Impl {
 public:
     std::string databasePath;
@@ -178,35 +317,97 @@ public:
     
     std::unordered_map<std::string, size_t> tagIndex;       // id -> index
     std::unordered_map<std::string, std::string> nameIndex; // name -> id
-    std::unordered_map<std::string, std::set<std::string>> fileToTags;  // path -> tag ids
-    std::unordered_map<std::string, std::set<std::string>> tagToFiles;  // tag id -> paths
+    std::unordered_map<std::string, uint32_t> fileIds;                  // path -> file id
+    std::vector<std::string> filePaths;                                 // file id -> path
+    std::vector<std::set<std::string>> fileTags;                        // file id -> tag ids
+    std::unordered_map<std::string, CompressedBitmap> tagFiles;         // tag id -> file ids
+    std::unordered_map<std::string, size_t> assignmentIndex;            // tag id '\n' path -> index
+    
+    TagJournal journal;
+    
+    // Records held back while a batch runs, so it goes out as one write
+    int batchDepth = 0;
+    std::vector<std::pair<uint8_t, std::string>> batched;
+    bool batchNeedsSave = false;
+    
+    // Rules compiled for matching; rebuilt after any rule changes
+    struct CompiledRule {
+        size_t rule = 0;                        // Index into rules
+        std::unique_ptr<std::regex> pathRegex;  // Null when there is no pattern
+        bool needsSize = false;
+    };
+    std::vector<CompiledRule> compiledRules;
+    std::unordered_map<std::string, std::vector<size_t>> rulesByExtension;  // Lowercase, no dot
+    std::vector<size_t> rulesForAnyExtension;
+    bool rulesDirty = true;
     
     std::vector<EventCallback> callbacks;
     bool initialized = false;
     
     void rebuildIndex() {
+        rulesDirty = true;
         tagIndex.clear();
         nameIndex.clear();
-        fileToTags.clear();
-        tagToFiles.clear();
+        fileIds.clear();
+        filePaths.clear();
+        fileTags.clear();
+        tagFiles.clear();
+        assignmentIndex.clear();
         
         for (size_t i = 0; i < tags.size(); ++i) {
             tagIndex[tags[i].id] = i;
             nameIndex[tags[i].name] = tags[i].id;
         }
         
-        for (const auto& a : assignments) {
-            fileToTags[a.filePath].insert(a.tagId);
-            tagToFiles[a.tagId].insert(a.filePath);
+        for (size_t i = 0; i < assignments.size(); ++i) {
+            const auto& a = assignments[i];
+            indexAssignment(a.tagId, a.filePath);
+            assignmentIndex[AssignmentKey(a.tagId, a.filePath)] = i;
         }
         
         // Update usage counts
         for (auto& tag : tags) {
-            auto it = tagToFiles.find(tag.id);
-            tag.usageCount = it != tagToFiles.end() ? static_cast<int>(it->second.size()) : 0;
+            auto it = tagFiles.find(tag.id);
+            tag.usageCount = it != tagFiles.end() ? static_cast<int>(it->second.Count()) : 0;
         }
     }
     
+    uint32_t fileIdOf(const std::string& filePath) const {
+        auto it = fileIds.find(filePath);
+        return it != fileIds.end() ? it->second : kNoFile;
+    }
+    
+    void indexAssignment(const std::string& tagId, const std::string& filePath) {
+        auto [it, inserted] = fileIds.emplace(filePath, static_cast<uint32_t>(filePaths.size()));
+        if (inserted) {
+            filePaths.push_back(filePath);
+            fileTags.emplace_back();
+        }
+        fileTags[it->second].insert(tagId);
+        tagFiles[tagId].Add(it->second);
+    }
+    
+    // The file keeps its id, so ids never move while the index stands
+    void unindexAssignment(const std::string& tagId, const std::string& filePath) {
+        uint32_t fileId = fileIdOf(filePath);
+        if (fileId == kNoFile) {
+            return;
+        }
+        fileTags[fileId].erase(tagId);
+        auto it = tagFiles.find(tagId);
+        if (it != tagFiles.end()) {
+            it->second.Remove(fileId);
+        }
+    }
+    
+    std::vector<std::string> pathsOf(const CompressedBitmap& files) const {
+        std::vector<std::string> result;
+        result.reserve(files.Count());
+        files.ForEach([&](uint32_t fileId) { result.push_back(filePaths[fileId]); });
+        std::sort(result.begin(), result.end());
+        return result;
+    }
+    
     void notifyEvent(TagEventType type, const std::string& tagId, 
                     const std::string& filePath = "", const std::string& details = "") {
         TagEvent event{type, tagId, filePath, details};
@@ -219,26 +420,297 @@ public:
         }
     }
     
-    bool saveToFile() {
-        try {
-            json j;
-            j["version"] = 1;
-            j["tags"] = tags;
-            j["assignments"] = assignments;
-            j["rules"] = rules;
+    // Assignments are unordered, so one is removed by moving the last into its place
+    bool addAssignment(const TagAssignment& a) {
+        auto [it, inserted] = assignmentIndex.emplace(AssignmentKey(a.tagId, a.filePath), assignments.size());
+        if (inserted) {
+            assignments.push_back(a);
+        }
+        return inserted;
+    }
+    
+    bool eraseAssignment(const std::string& tagId, const std::string& filePath) {
+        auto it = assignmentIndex.find(AssignmentKey(tagId, filePath));
+        if (it == assignmentIndex.end()) {
+            return false;
+        }
+        size_t index = it->second;
+        assignmentIndex.erase(it);
+        if (index + 1 != assignments.size()) {
+            assignments[index] = std::move(assignments.back());
+            assignmentIndex[AssignmentKey(assignments[index].tagId, assignments[index].filePath)] = index;
+        }
+        assignments.pop_back();
+        return true;
+    }
+    
+    TagSnapshot copySnapshot() const {
+        return TagSnapshot{tags, assignments, rules};
+    }
+    
+    // Without a journal every change writes the whole database, as a fallback
+    void record(uint8_t type, const std::string& payload) {
+        if (journal.isOpen()) {
+            if (batchDepth > 0) {
+                batched.emplace_back(type, payload);
+                return;
+            }
+            journal.append(type, payload);
+            maybeCompact();
+        } else if (initialized) {
+            if (batchDepth > 0) {
+                batchNeedsSave = true;
+                return;
+            }
+            saveToFile();
+        }
+    }
+    
+    void beginBatch() {
+        ++batchDepth;
+    }
+    
+    void endBatch() {
+        if (--batchDepth > 0) {
+            return;
+        }
+        if (!batched.empty()) {
+            journal.append(batched);
+            batched.clear();
+            maybeCompact();
+        }
+        if (batchNeedsSave) {
+            batchNeedsSave = false;
+            saveToFile();
+        }
+    }
+    
+    // Holds records back until it ends, so a batch of changes costs one write
+    class Batch {
+    public:
+        explicit Batch(Impl& impl) : impl_(impl) { impl_.beginBatch(); }
+        ~Batch() { impl_.endBatch(); }
+        
+        Batch(const Batch&) = delete;
+        Batch& operator=(const Batch&) = delete;
+        
+    private:
+        Impl& impl_;
+    };
+    
+    void recordTag(const Tag& t) {
+        record(TagPut, json(t).dump());
+    }
+    
+    void recordRule(const SmartTagRule& r) {
+        record(RulePut, json(r).dump());
+    }
+    
+    void recordAssign(const TagAssignment& a) {
+        std::string payload;
+        PutString(payload, a.tagId);
+        PutString(payload, a.filePath);
+        PutInt64(payload, std::chrono::duration_cast<std::chrono::microseconds>(
+            a.assignedAt.time_since_epoch()).count());
+        PutString(payload, a.assignedBy);
+        PutInt64(payload, static_cast<int64_t>(a.volumeSerial));
+        PutInt64(payload, static_cast<int64_t>(a.fileIndex));
+        record(Assign, payload);
+    }
+    
+    void recordUnassign(const std::string& tagId, const std::string& filePath) {
+        std::string payload;
+        PutString(payload, tagId);
+        PutString(payload, filePath);
+        record(Unassign, payload);
+    }
+    
+    void maybeCompact() {
+        if (journal.wantsCompaction()) {
+            auto data = std::make_shared<TagSnapshot>(copySnapshot());
+            journal.compact([data](std::ostream& out, uint64_t generation) {
+                return WriteSnapshot(out, generation, *data);
+            });
+        }
+    }
+    
+    // Re-keys every assignment at or under oldPath; returns how many moved
+    size_t movePath(const std::string& oldPath, const std::string& newPath, bool log) {
+        std::vector<TagAssignment> moving;
+        for (const auto& a : assignments) {
+            if (IsSameOrUnder(a.filePath, oldPath)) {
+                moving.push_back(a);
+            }
+        }
+        
+        for (auto& a : moving) {
+            eraseAssignment(a.tagId, a.filePath);
+            unindexAssignment(a.tagId, a.filePath);
+            a.filePath = newPath + a.filePath.substr(oldPath.size());
+            if (addAssignment(a)) {
+                indexAssignment(a.tagId, a.filePath);
+            }
+        }
+        
+        if (!moving.empty()) {
+            for (auto& tag : tags) {
+                auto it = tagFiles.find(tag.id);
+                tag.usageCount = it != tagFiles.end() ? static_cast<int>(it->second.Count()) : 0;
+            }
+            if (log) {
+                std::string payload;
+                PutString(payload, oldPath);
+                PutString(payload, newPath);
+                record(Move, payload);
+            }
+        }
+        return moving.size();
+    }
+    
+    // Tracked paths that no longer exist follow their file id if it moved
+    // on the volume and lose their tags otherwise; returns tags dropped
+    int resolveMissing(const std::vector<std::string>& paths) {
+        int dropped = 0;
+        for (const auto& path : paths) {
+            uint32_t fileId = fileIdOf(path);
+            if (fileId == kNoFile || fileTags[fileId].empty() || fs::exists(path)) {
+                continue;
+            }
             
-            fs::path dir = fs::path(databasePath).parent_path();
-            if (!fs::exists(dir)) {
-                fs::create_directories(dir);
+            uint64_t volumeSerial = 0, fileIndex = 0;
+            for (const auto& tagId : fileTags[fileId]) {
+                auto it = assignmentIndex.find(AssignmentKey(tagId, path));
+                if (it != assignmentIndex.end() && assignments[it->second].fileIndex != 0) {
+                    volumeSerial = assignments[it->second].volumeSerial;
+                    fileIndex = assignments[it->second].fileIndex;
+                    break;
+                }
             }
             
-            std::ofstream file(databasePath);
-            if (!file) {
-                spdlog::error("TagManager: failed to open {} for writing", databasePath);
-                return false;
+            std::string found = LocateFile(path, volumeSerial, fileIndex);
+            if (!found.empty() && found != path) {
+                movePath(path, found, true);
+                notifyEvent(TagEventType::FileMoved, "", found, path);
+                continue;
             }
             
-            file << j.dump(2);
+            std::set<std::string> orphaned = fileTags[fileId];
+            for (const auto& tagId : orphaned) {
+                eraseAssignment(tagId, path);
+                unindexAssignment(tagId, path);
+                recordUnassign(tagId, path);
+                ++dropped;
+            }
+        }
+        if (dropped > 0) {
+            rebuildIndex();
+        }
+        return dropped;
+    }
+    
+    void applyRecord(uint8_t type, std::string_view payload) {
+        try {
+            switch (type) {
+            case TagPut: {
+                Tag t = json::parse(payload).get<Tag>();
+                auto it = tagIndex.find(t.id);
+                if (it != tagIndex.end()) {
+                    tags[it->second] = t;
+                } else {
+                    tagIndex[t.id] = tags.size();
+                    tags.push_back(t);
+                }
+                break;
+            }
+            case TagDelete: {
+                std::string tagId(payload);
+                assignments.erase(
+                    std::remove_if(assignments.begin(), assignments.end(),
+                        [&](const TagAssignment& a) { return a.tagId == tagId; }),
+                    assignments.end());
+                tags.erase(
+                    std::remove_if(tags.begin(), tags.end(),
+                        [&](const Tag& t) { return t.id == tagId; }),
+                    tags.end());
+                rebuildIndex();
+                break;
+            }
+            case Assign: {
+                TagAssignment a;
+                int64_t assignedAt = 0;
+                if (GetString(payload, a.tagId) && GetString(payload, a.filePath) &&
+                    GetInt64(payload, assignedAt) && GetString(payload, a.assignedBy)) {
+                    a.assignedAt = std::chrono::system_clock::time_point(
+                        std::chrono::duration_cast<std::chrono::system_clock::duration>(
+                            std::chrono::microseconds(assignedAt)));
+                    int64_t volumeSerial = 0, fileIndex = 0;
+                    if (GetInt64(payload, volumeSerial) && GetInt64(payload, fileIndex)) {
+                        a.volumeSerial = static_cast<uint64_t>(volumeSerial);
+                        a.fileIndex = static_cast<uint64_t>(fileIndex);
+                    }
+                    addAssignment(a);
+                }
+                break;
+            }
+            case Unassign: {
+                std::string tagId, filePath;
+                if (GetString(payload, tagId) && GetString(payload, filePath)) {
+                    eraseAssignment(tagId, filePath);
+                }
+                break;
+            }
+            case Move: {
+                std::string oldPath, newPath;
+                if (GetString(payload, oldPath) && GetString(payload, newPath)) {
+                    movePath(oldPath, newPath, false);
+                }
+                break;
+            }
+            case RulePut: {
+                SmartTagRule r = json::parse(payload).get<SmartTagRule>();
+                auto it = std::find_if(rules.begin(), rules.end(),
+                    [&](const SmartTagRule& existing) { return existing.id == r.id; });
+                if (it != rules.end()) {
+                    *it = r;
+                } else {
+                    rules.push_back(r);
+                }
+                break;
+            }
+            case RuleDelete: {
+                std::string ruleId(payload);
+                rules.erase(
+                    std::remove_if(rules.begin(), rules.end(),
+                        [&](const SmartTagRule& r) { return r.id == ruleId; }),
+                    rules.end());
+                break;
+            }
+            default:
+                spdlog::warn("TagManager: skipping journal record of unknown type {}", type);
+                break;
+            }
+        } catch (const std::exception& e) {
+            spdlog::warn("TagManager: skipping bad journal record: {}", e.what());
+        }
+    }
+    
+    bool saveToFile() {
+        try {
+            TagSnapshot data = copySnapshot();
+            auto writer = [&data](std::ostream& out, uint64_t generation) {
+                return WriteSnapshot(out, generation, data);
+            };
+            if (journal.isOpen()) {
+                // A snapshot of its own generation, so no log repeats what it holds
+                journal.compact(writer);
+                if (!journal.flush()) {
+                    return false;
+                }
+            } else if (TagJournal::writeSnapshot(databasePath, 0, writer)) {
+                TagJournal::removeLogs(databasePath);
+            } else {
+                return false;
+            }
             spdlog::debug("TagManager: saved {} tags, {} assignments", 
                          tags.size(), assignments.size());
             return true;
@@ -249,10 +721,15 @@ public:
     }
     
     bool loadFromFile() {
+        journal.close();
+        tags.clear();
+        assignments.clear();
+        rules.clear();
+        
         try {
             if (!fs::exists(databasePath)) {
                 spdlog::info("TagManager: no existing database");
-                createDefaultTags();
+                startFresh();
                 return true;
             }
             
@@ -263,7 +740,9 @@ public:
             }
             
             json j = json::parse(file);
+            file.close();
             
+            uint64_t generation = j.value("generation", uint64_t{0});
             if (j.contains("tags")) {
                 tags = j["tags"].get<std::vector<Tag>>();
             }
@@ -273,10 +752,19 @@ public:
             if (j.contains("rules")) {
                 rules = j["rules"].get<std::vector<SmartTagRule>>();
             }
+            rebuildIndex();
             
+            // Then whatever changed since the snapshot was written
+            size_t snapshotAssignments = assignments.size();
+            if (!journal.open(databasePath, generation, fs::file_size(databasePath),
+                    [this](uint8_t type, std::string_view payload) { applyRecord(type, payload); })) {
+                spdlog::warn("TagManager: journal unavailable, saving in full");
+            }
             rebuildIndex();
-            spdlog::info("TagManager: loaded {} tags, {} assignments", 
-                        tags.size(), assignments.size());
+            
+            spdlog::info("TagManager: loaded {} tags, {} assignments ({} from journal)", 
+                        tags.size(), assignments.size(),
+                        static_cast<int64_t>(assignments.size()) - static_cast<int64_t>(snapshotAssignments));
             return true;
         } catch (const std::exception& e) {
             spdlog::error("TagManager: load failed: {}", e.what());
@@ -284,6 +772,26 @@ public:
         }
     }
     
+    // Defaults, written as generation 0 with any stale logs gone
+    void startFresh() {
+        journal.close();
+        tags.clear();
+        assignments.clear();
+        rules.clear();
+        createDefaultTags();
+        
+        TagJournal::removeLogs(databasePath);
+        TagSnapshot data = copySnapshot();
+        uint64_t bytes = 0;
+        bool written = TagJournal::writeSnapshot(databasePath, 0,
+            [&data](std::ostream& out, uint64_t generation) {
+                return WriteSnapshot(out, generation, data);
+            }, &bytes);
+        if (!written || !journal.open(databasePath, 0, bytes, [](uint8_t, std::string_view) {})) {
+            spdlog::warn("TagManager: journal unavailable, saving in full");
+        }
+    }
+    
     void createDefaultTags() {
         // Create some default tags
         auto addTag = [this](const std::string& name, const TagColor& color, bool isSystem = true) {
@@ -305,52 +813,115 @@ public:
         rebuildIndex();
     }
     
-    bool matchesRule(const SmartTagRule& rule, const std::string& filePath) {
-        if (!rule.enabled) return false;
+    static std::string lowerAscii(std::string text) {
+        for (auto& c : text) {
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        }
+        return text;
+    }
+    
+    // Rules are indexed by the extensions they accept, so a file is only
+    // tried against those rules and the ones that take any extension
+    void compileRules() {
+        if (!rulesDirty) {
+            return;
+        }
+        rulesDirty = false;
+        compiledRules.clear();
+        rulesByExtension.clear();
+        rulesForAnyExtension.clear();
         
-        try {
-            // Check path pattern
+        for (size_t i = 0; i < rules.size(); ++i) {
+            const SmartTagRule& rule = rules[i];
+            if (!rule.enabled) continue;
+            
+            CompiledRule compiled;
+            compiled.rule = i;
+            compiled.needsSize = rule.minSize >= 0 || rule.maxSize >= 0;
             if (!rule.pathPattern.empty()) {
-                std::regex pathRegex(rule.pathPattern, std::regex::icase);
-                if (!std::regex_search(filePath, pathRegex)) {
-                    return false;
+                try {
+                    compiled.pathRegex = std::make_unique<std::regex>(
+                        rule.pathPattern, std::regex::icase | std::regex::optimize);
+                } catch (const std::regex_error& e) {
+                    spdlog::warn("TagManager: rule '{}' has a bad path pattern: {}", rule.name, e.what());
+                    continue;
                 }
             }
             
-            // Check extension filter
-            if (!rule.extensionFilter.empty()) {
-                std::string ext = fs::path(filePath).extension().string();
-                if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
-                
-                std::istringstream iss(rule.extensionFilter);
-                std::string token;
-                bool found = false;
-                while (std::getline(iss, token, ',')) {
-                    // Trim whitespace
-                    token.erase(0, token.find_first_not_of(" \t"));
-                    token.erase(token.find_last_not_of(" \t") + 1);
-                    if (token[0] == '.') token = token.substr(1);
-                    
-                    if (_stricmp(ext.c_str(), token.c_str()) == 0) {
-                        found = true;
-                        break;
-                    }
-                }
-                if (!found) return false;
-            }
+            size_t index = compiledRules.size();
+            compiledRules.push_back(std::move(compiled));
             
-            // Check file size
-            if (fs::exists(filePath) && fs::is_regular_file(filePath)) {
-                auto size = static_cast<int64_t>(fs::file_size(filePath));
-                if (rule.minSize >= 0 && size < rule.minSize) return false;
-                if (rule.maxSize >= 0 && size > rule.maxSize) return false;
+            std::vector<std::string> extensions;
+            std::istringstream iss(rule.extensionFilter);
+            std::string token;
+            while (std::getline(iss, token, ',')) {
+                // Trim whitespace
+                token.erase(0, token.find_first_not_of(" \t"));
+                token.erase(token.find_last_not_of(" \t") + 1);
+                if (!token.empty() && token[0] == '.') token = token.substr(1);
+                if (!token.empty()) extensions.push_back(lowerAscii(token));
             }
             
-            return true;
-        } catch (...) {
-            return false;
+            if (extensions.empty()) {
+                rulesForAnyExtension.push_back(index);
+            } else {
+                for (const auto& ext : extensions) {
+                    auto& bucket = rulesByExtension[ext];
+                    if (bucket.empty() || bucket.back() != index) bucket.push_back(index);
+                }
+            }
+        }
+    }
+    
+    // Appends the rules filePath matches whose tag it does not have yet;
+    // the file is stat'ed at most once, and only if a rule needs its size
+    void matchRules(const std::string& filePath, std::vector<size_t>& matched) {
+        compileRules();
+        if (compiledRules.empty()) return;
+        
+        std::string ext = fs::path(filePath).extension().string();
+        if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
+        ext = lowerAscii(ext);
+        
+        uint32_t fileId = fileIdOf(filePath);
+        const std::set<std::string>* has = fileId != kNoFile ? &fileTags[fileId] : nullptr;
+        
+        bool sizeKnown = false;
+        int64_t size = -1;          // -1 when not a regular file, which size limits pass
+        
+        auto tryRule = [&](size_t index) {
+            const CompiledRule& compiled = compiledRules[index];
+            const SmartTagRule& rule = rules[compiled.rule];
+            if (has && has->count(rule.tagId)) return;
+            if (compiled.pathRegex && !std::regex_search(filePath, *compiled.pathRegex)) return;
+            if (compiled.needsSize) {
+                if (!sizeKnown) {
+                    sizeKnown = true;
+                    std::error_code ec;
+                    if (fs::is_regular_file(filePath, ec)) {
+                        auto bytes = fs::file_size(filePath, ec);
+                        if (!ec) size = static_cast<int64_t>(bytes);
+                    }
+                }
+                if (size >= 0) {
+                    if (rule.minSize >= 0 && size < rule.minSize) return;
+                    if (rule.maxSize >= 0 && size > rule.maxSize) return;
+                }
+            }
+            matched.push_back(compiled.rule);
+        };
+        
+        auto bucket = rulesByExtension.find(ext);
+        if (bucket != rulesByExtension.end()) {
+            for (size_t index : bucket->second) tryRule(index);
         }
+        for (size_t index : rulesForAnyExtension) tryRule(index);
+        
+        // Keep the order rules were added in
+        std::sort(matched.begin(), matched.end());
     }
+    
+    bool assign(const std::string& filePath, const std::string& tagId, const char* assignedBy);
 };
 
 TagManager::TagManager() : pImpl(std::make_unique<Impl>()) {}
@@ -368,7 +939,7 @@ bool TagManager::initialize(const std::string& databasePath) {
     pImpl->databasePath = databasePath;
     if (!pImpl->loadFromFile()) {
         spdlog::warn("TagManager: failed to load, starting fresh");
-        pImpl->createDefaultTags();
+        pImpl->startFresh();
     }
     
     pImpl->initialized = true;
@@ -378,7 +949,12 @@ bool TagManager::initialize(const std::string& databasePath) {
 
 void TagManager::shutdown() {
     if (pImpl->initialized) {
-        save();
+        // Everything is in the journal already; it only has to finish writing
+        if (pImpl->journal.isOpen()) {
+            pImpl->journal.close();
+        } else {
+            save();
+        }
         pImpl->initialized = false;
     }
 }
@@ -401,8 +977,8 @@ std::string TagManager::createTag(const std::string& name, const TagColor& color
     pImpl->tagIndex[t.id] = pImpl->tags.size() - 1;
     pImpl->nameIndex[t.name] = t.id;
     
+    pImpl->recordTag(t);
     pImpl->notifyEvent(TagEventType::TagCreated, t.id);
-    save();
     
     spdlog::info("TagManager: created tag '{}'", name);
     return t.id;
@@ -432,8 +1008,8 @@ bool TagManager::deleteTag(const std::string& tagId) {
     pImpl->tags.erase(pImpl->tags.begin() + it->second);
     pImpl->rebuildIndex();
     
+    pImpl->record(TagDelete, tagId);
     pImpl->notifyEvent(TagEventType::TagDeleted, tagId, "", name);
-    save();
     
     spdlog::info("TagManager: deleted tag '{}'", name);
     return true;
@@ -455,8 +1031,8 @@ bool TagManager::updateTag(const std::string& tagId, const Tag& updated) {
         pImpl->nameIndex[updated.name] = tagId;
     }
     
+    pImpl->recordTag(pImpl->tags[it->second]);
     pImpl->notifyEvent(TagEventType::TagUpdated, tagId);
-    save();
     
     return true;
 }
@@ -531,14 +1107,15 @@ std::vector<const Tag*> TagManager::searchTags(const std::string& query) const {
     return result;
 }
 
-bool TagManager::assignTag(const std::string& filePath, const std::string& tagId) {
-    if (!getTag(tagId)) {
+bool TagManager::Impl::assign(const std::string& filePath, const std::string& tagId, const char* assignedBy) {
+    auto tagIt = tagIndex.find(tagId);
+    if (tagIt == tagIndex.end()) {
         spdlog::warn("TagManager: unknown tag {}", tagId);
         return false;
     }
     
     // Check if already assigned
-    if (hasTag(filePath, tagId)) {
+    if (assignmentIndex.count(AssignmentKey(tagId, filePath))) {
         return true;
     }
     
@@ -546,47 +1123,41 @@ bool TagManager::assignTag(const std::string& filePath, const std::string& tagId
     a.tagId = tagId;
     a.filePath = filePath;
     a.assignedAt = std::chrono::system_clock::now();
-    a.assignedBy = "user";
+    a.assignedBy = assignedBy;
+    ReadFileIdentity(filePath, a.volumeSerial, a.fileIndex);
     
-    pImpl->assignments.push_back(a);
-    pImpl->fileToTags[filePath].insert(tagId);
-    pImpl->tagToFiles[tagId].insert(filePath);
+    addAssignment(a);
+    indexAssignment(tagId, filePath);
     
     // Update usage count
-    auto* tag = getTag(tagId);
-    if (tag) {
-        tag->usageCount = static_cast<int>(pImpl->tagToFiles[tagId].size());
-    }
+    tags[tagIt->second].usageCount = static_cast<int>(tagFiles[tagId].Count());
     
-    pImpl->notifyEvent(TagEventType::TagAssigned, tagId, filePath);
-    save();
+    recordAssign(a);
+    notifyEvent(TagEventType::TagAssigned, tagId, filePath);
     
     return true;
 }
 
+bool TagManager::assignTag(const std::string& filePath, const std::string& tagId) {
+    return pImpl->assign(filePath, tagId, "user");
+}
+
 bool TagManager::removeTag(const std::string& filePath, const std::string& tagId) {
     if (!hasTag(filePath, tagId)) {
         return false;
     }
     
-    pImpl->assignments.erase(
-        std::remove_if(pImpl->assignments.begin(), pImpl->assignments.end(),
-            [&](const TagAssignment& a) { 
-                return a.filePath == filePath && a.tagId == tagId; 
-            }),
-        pImpl->assignments.end());
-    
-    pImpl->fileToTags[filePath].erase(tagId);
-    pImpl->tagToFiles[tagId].erase(filePath);
+    pImpl->eraseAssignment(tagId, filePath);
+    pImpl->unindexAssignment(tagId, filePath);
     
     // Update usage count
     auto* tag = getTag(tagId);
     if (tag) {
-        tag->usageCount = static_cast<int>(pImpl->tagToFiles[tagId].size());
+        tag->usageCount = static_cast<int>(pImpl->tagFiles[tagId].Count());
     }
     
+    pImpl->recordUnassign(tagId, filePath);
     pImpl->notifyEvent(TagEventType::TagRemoved, tagId, filePath);
-    save();
     
     return true;
 }
@@ -600,6 +1171,8 @@ bool TagManager::toggleTag(const std::string& filePath, const std::string& tagId
 }
 
 bool TagManager::setTags(const std::string& filePath, const std::vector<std::string>& tagIds) {
+    Impl::Batch batch(*pImpl);
+    
     // Remove all existing tags
     clearTags(filePath);
     
@@ -612,12 +1185,13 @@ bool TagManager::setTags(const std::string& filePath, const std::vector<std::str
 }
 
 bool TagManager::clearTags(const std::string& filePath) {
-    auto it = pImpl->fileToTags.find(filePath);
-    if (it == pImpl->fileToTags.end() || it->second.empty()) {
+    uint32_t fileId = pImpl->fileIdOf(filePath);
+    if (fileId == kNoFile || pImpl->fileTags[fileId].empty()) {
         return true;
     }
     
-    std::set<std::string> tagsToRemove = it->second;
+    Impl::Batch batch(*pImpl);
+    std::set<std::string> tagsToRemove = pImpl->fileTags[fileId];
     for (const auto& tagId : tagsToRemove) {
         removeTag(filePath, tagId);
     }
@@ -626,14 +1200,12 @@ bool TagManager::clearTags(const std::string& filePath) {
 }
 
 bool TagManager::hasTag(const std::string& filePath, const std::string& tagId) const {
-    auto it = pImpl->fileToTags.find(filePath);
-    if (it == pImpl->fileToTags.end()) {
-        return false;
-    }
-    return it->second.count(tagId) > 0;
+    uint32_t fileId = pImpl->fileIdOf(filePath);
+    return fileId != kNoFile && pImpl->fileTags[fileId].count(tagId) > 0;
 }
 
 bool TagManager::assignTagToMany(const std::vector<std::string>& filePaths, const std::string& tagId) {
+    Impl::Batch batch(*pImpl);
     for (const auto& path : filePaths) {
         assignTag(path, tagId);
     }
@@ -641,6 +1213,7 @@ bool TagManager::assignTagToMany(const std::vector<std::string>& filePaths, cons
 }
 
 bool TagManager::removeTagFromMany(const std::vector<std::string>& filePaths, const std::string& tagId) {
+    Impl::Batch batch(*pImpl);
     for (const auto& path : filePaths) {
         removeTag(path, tagId);
     }
@@ -653,12 +1226,8 @@ bool TagManager::copyTags(const std::string& sourcePath, const std::string& dest
 }
 
 std::vector<std::string> TagManager::getTagsForFile(const std::string& filePath) const {
-    std::vector<std::string> result;
-    auto it = pImpl->fileToTags.find(filePath);
-    if (it != pImpl->fileToTags.end()) {
-        result.assign(it->second.begin(), it->second.end());
-    }
-    return result;
+    const auto& tags = getTagIdsForFile(pImpl->fileIdOf(filePath));
+    return std::vector<std::string>(tags.begin(), tags.end());
 }
 
 std::vector<Tag> TagManager::getTagObjectsForFile(const std::string& filePath) const {
@@ -674,69 +1243,83 @@ std::vector<Tag> TagManager::getTagObjectsForFile(const std::string& filePath) c
 }
 
 std::vector<std::string> TagManager::getFilesWithTag(const std::string& tagId) const {
-    std::vector<std::string> result;
-    auto it = pImpl->tagToFiles.find(tagId);
-    if (it != pImpl->tagToFiles.end()) {
-        result.assign(it->second.begin(), it->second.end());
-    }
-    return result;
+    const CompressedBitmap* files = getFileIdsWithTag(tagId);
+    return files ? pImpl->pathsOf(*files) : std::vector<std::string>();
 }
 
 std::vector<std::string> TagManager::getFilesMatchingFilter(const TagFilter& filter) const {
-    std::set<std::string> result;
-    bool first = true;
+    return pImpl->pathsOf(getFileIdsMatchingFilter(filter));
+}
+
+CompressedBitmap TagManager::getFileIdsMatchingFilter(const TagFilter& filter) const {
+    // Nothing to include from means nothing matches, whatever is excluded
+    if (filter.includeTags.empty() && filter.anyOfTags.empty()) {
+        return CompressedBitmap();
+    }
     
-    // Must have ALL includeTags
-    for (const auto& tagId : filter.includeTags) {
-        auto files = getFilesWithTag(tagId);
-        std::set<std::string> fileSet(files.begin(), files.end());
-        
+    CompressedBitmap result;
+    bool first = true;
+    auto narrow = [&](const CompressedBitmap& files) {
         if (first) {
-            result = fileSet;
+            result = files;
             first = false;
         } else {
-            std::set<std::string> intersection;
-            std::set_intersection(result.begin(), result.end(),
-                                 fileSet.begin(), fileSet.end(),
-                                 std::inserter(intersection, intersection.begin()));
-            result = intersection;
+            result &= files;
         }
+    };
+    
+    // Must have ALL includeTags
+    for (const auto& tagId : filter.includeTags) {
+        const CompressedBitmap* files = getFileIdsWithTag(tagId);
+        if (!files) {
+            return CompressedBitmap();
+        }
+        narrow(*files);
     }
     
     // Must have ANY of anyOfTags
     if (!filter.anyOfTags.empty()) {
-        std::set<std::string> anyMatch;
+        CompressedBitmap anyMatch;
         for (const auto& tagId : filter.anyOfTags) {
-            auto files = getFilesWithTag(tagId);
-            anyMatch.insert(files.begin(), files.end());
-        }
-        
-        if (first) {
-            result = anyMatch;
-            first = false;
-        } else {
-            std::set<std::string> intersection;
-            std::set_intersection(result.begin(), result.end(),
-                                 anyMatch.begin(), anyMatch.end(),
-                                 std::inserter(intersection, intersection.begin()));
-            result = intersection;
+            if (const CompressedBitmap* files = getFileIdsWithTag(tagId)) {
+                anyMatch |= *files;
+            }
         }
+        narrow(anyMatch);
     }
     
     // Must NOT have excludeTags
     for (const auto& tagId : filter.excludeTags) {
-        auto files = getFilesWithTag(tagId);
-        for (const auto& f : files) {
-            result.erase(f);
+        if (const CompressedBitmap* files = getFileIdsWithTag(tagId)) {
+            result.AndNot(*files);
         }
     }
     
-    return std::vector<std::string>(result.begin(), result.end());
+    return result;
+}
+
+uint32_t TagManager::getFileId(const std::string& filePath) const {
+    return pImpl->fileIdOf(filePath);
+}
+
+const std::string& TagManager::getFilePath(uint32_t fileId) const {
+    static const std::string empty;
+    return fileId < pImpl->filePaths.size() ? pImpl->filePaths[fileId] : empty;
+}
+
+const std::set<std::string>& TagManager::getTagIdsForFile(uint32_t fileId) const {
+    static const std::set<std::string> empty;
+    return fileId < pImpl->fileTags.size() ? pImpl->fileTags[fileId] : empty;
+}
+
+const CompressedBitmap* TagManager::getFileIdsWithTag(const std::string& tagId) const {
+    auto it = pImpl->tagFiles.find(tagId);
+    return it != pImpl->tagFiles.end() && !it->second.Empty() ? &it->second : nullptr;
 }
 
 int TagManager::getFileCountForTag(const std::string& tagId) const {
-    auto it = pImpl->tagToFiles.find(tagId);
-    return it != pImpl->tagToFiles.end() ? static_cast<int>(it->second.size()) : 0;
+    const CompressedBitmap* files = getFileIdsWithTag(tagId);
+    return files ? static_cast<int>(files->Count()) : 0;
 }
 
 std::string TagManager::addRule(const SmartTagRule& rule) {
@@ -746,7 +1329,8 @@ std::string TagManager::addRule(const SmartTagRule& rule) {
     }
     
     pImpl->rules.push_back(r);
-    save();
+    pImpl->rulesDirty = true;
+    pImpl->recordRule(r);
     
     return r.id;
 }
@@ -757,7 +1341,8 @@ bool TagManager::deleteRule(const std::string& ruleId) {
     
     if (it != pImpl->rules.end()) {
         pImpl->rules.erase(it);
-        save();
+        pImpl->rulesDirty = true;
+        pImpl->record(RuleDelete, ruleId);
         return true;
     }
     
@@ -769,7 +1354,8 @@ bool TagManager::updateRule(const std::string& ruleId, const SmartTagRule& updat
         if (r.id == ruleId) {
             r = updated;
             r.id = ruleId;
-            save();
+            pImpl->rulesDirty = true;
+            pImpl->recordRule(r);
             return true;
         }
     }
@@ -777,6 +1363,8 @@ bool TagManager::updateRule(const std::string& ruleId, const SmartTagRule& updat
 }
 
 SmartTagRule* TagManager::getRule(const std::string& ruleId) {
+    // The caller may change it in place
+    pImpl->rulesDirty = true;
     for (auto& r : pImpl->rules) {
         if (r.id == ruleId) {
             return &r;
@@ -794,24 +1382,35 @@ std::vector<const SmartTagRule*> TagManager::getAllRules() const {
 }
 
 void TagManager::applyRules(const std::string& filePath) {
-    for (const auto& rule : pImpl->rules) {
-        if (pImpl->matchesRule(rule, filePath)) {
-            assignTag(filePath, rule.tagId);
-            pImpl->notifyEvent(TagEventType::RuleTriggered, rule.tagId, filePath, rule.name);
+    applyRules(std::vector<std::string>{filePath});
+}
+
+void TagManager::applyRules(const std::vector<std::string>& filePaths) {
+    Impl::Batch batch(*pImpl);
+    std::vector<size_t> matched;
+    for (const auto& path : filePaths) {
+        matched.clear();
+        pImpl->matchRules(path, matched);
+        for (size_t index : matched) {
+            // Copied, as a callback may change the rules
+            SmartTagRule rule = pImpl->rules[index];
+            if (pImpl->assign(path, rule.tagId, "auto")) {
+                pImpl->notifyEvent(TagEventType::RuleTriggered, rule.tagId, path, rule.name);
+            }
         }
     }
 }
 
 void TagManager::applyAllRules() {
     // Apply rules to all files that have at least one tag
-    std::set<std::string> allFiles;
-    for (const auto& [path, tags] : pImpl->fileToTags) {
-        allFiles.insert(path);
+    std::vector<std::string> allFiles;
+    for (uint32_t fileId = 0; fileId < pImpl->fileTags.size(); ++fileId) {
+        if (!pImpl->fileTags[fileId].empty()) {
+            allFiles.push_back(pImpl->filePaths[fileId]);
+        }
     }
     
-    for (const auto& path : allFiles) {
-        applyRules(path);
-    }
+    applyRules(allFiles);
 }
 
 std::vector<const Tag*> TagManager::suggestTags(const std::string& filePath) const {
@@ -931,25 +1530,40 @@ bool TagManager::rebuildIndex() {
     return true;
 }
 
+bool TagManager::moveFile(const std::string& oldPath, const std::string& newPath) {
+    if (oldPath == newPath || pImpl->movePath(oldPath, newPath, true) == 0) {
+        return false;
+    }
+    pImpl->notifyEvent(TagEventType::FileMoved, "", newPath, oldPath);
+    return true;
+}
+
+int TagManager::reconcileRemoved(const std::vector<std::string>& removedPaths) {
+    // Only what was removed, and what was under a removed folder, is checked
+    std::vector<std::string> candidates;
+    for (uint32_t fileId = 0; fileId < pImpl->filePaths.size(); ++fileId) {
+        if (pImpl->fileTags[fileId].empty()) {
+            continue;
+        }
+        const std::string& path = pImpl->filePaths[fileId];
+        for (const auto& removed : removedPaths) {
+            if (IsSameOrUnder(path, removed)) {
+                candidates.push_back(path);
+                break;
+            }
+        }
+    }
+    return pImpl->resolveMissing(candidates);
+}
+
 int TagManager::cleanupOrphanedAssignments() {
-    int count = 0;
-    pImpl->assignments.erase(
-        std::remove_if(pImpl->assignments.begin(), pImpl->assignments.end(),
-            [&count](const TagAssignment& a) {
-                if (!fs::exists(a.filePath)) {
-                    count++;
-                    return true;
-                }
-                return false;
-            }),
-        pImpl->assignments.end());
-    
-    if (count > 0) {
-        pImpl->rebuildIndex();
-        save();
+    std::vector<std::string> tracked;
+    for (uint32_t fileId = 0; fileId < pImpl->filePaths.size(); ++fileId) {
+        if (!pImpl->fileTags[fileId].empty()) {
+            tracked.push_back(pImpl->filePaths[fileId]);
+        }
     }
-    
-    return count;
+    return pImpl->resolveMissing(tracked);
 }
 
 int TagManager::getOrphanedCount() const {
@@ -0,0 +1,613 @@
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::core
+{
+    namespace
+    {
+        constexpr size_t kPriorities = static_cast<size_t>(TaskPriority::Count);
+        constexpr size_t kInteractive = static_cast<size_t>(TaskPriority::Interactive);
+        constexpr size_t kBackground = static_cast<size_t>(TaskPriority::Background);
+
+        // Long jobs hold a worker each, so even a small machine gets a few
+        constexpr size_t kMinWorkers = 4;
+        constexpr size_t kMaxWorkers = 32;
+
+        enum TaskStatus : int
+        {
+            kPending,
+            kRunning,
+            kDone,
+            kSkipped
+        };
+
+        // Take one of limit slots, unless all are taken
+        bool Acquire(std::atomic<size_t>& count, size_t limit)
+        {
+            size_t current = count.load(std::memory_order_relaxed);
+            while (current < limit)
+            {
+                if (count.compare_exchange_weak(current, current + 1, std::memory_order_acq_rel))
+                    return true;
+            }
+            return false;
+        }
+    }
+
+    CancellationToken CancellationToken::Watch(const std::atomic<bool>& flag)
+    {
+        // Aliasing, not owning: the caller keeps the flag alive
+        return CancellationToken(std::shared_ptr<const std::atomic<bool>>(std::shared_ptr<void>(), &flag));
+    }
+
+    struct TaskScheduler::Impl
+    {
+        struct Item
+        {
+            Task task;
+            TaskOptions options;
+            std::shared_ptr<TaskHandle::State> state;
+        };
+        using ItemPtr = std::unique_ptr<Item>;
+
+        struct Queues
+        {
+            std::mutex mutex;
+            std::array<std::deque<ItemPtr>, kPriorities> tasks;
+        };
+
+        struct Device
+        {
+            size_t limit = kDefaultIoLimit;
+            size_t running = 0;
+            std::array<std::deque<ItemPtr>, kPriorities> waiting;  // Off the queues until a slot frees
+        };
+
+        explicit Impl(size_t workers);
+
+        void Enqueue(ItemPtr item);
+        bool Reserve(size_t priority);
+        void Release(size_t priority);
+        ItemPtr Take(size_t worker, size_t priority);
+        bool RunOne(size_t worker, bool helping);
+        void Run(ItemPtr item, size_t priority, bool limited);
+        void Finish(Item& item, TaskStatus status);
+        void WorkerLoop(size_t worker);
+
+        static thread_local Impl* current;
+        static thread_local size_t current_worker;
+        static thread_local size_t current_priority;    // Of the task this worker runs
+        static thread_local bool current_limited;       // That task holds a slot of its class
+
+        std::vector<std::unique_ptr<Queues>> local;     // One per worker
+        Queues shared;                                  // Submitted from outside the pool
+        std::atomic<size_t> queued{0};                  // In local or shared
+        std::atomic<size_t> unfinished{0};              // Submitted and not done, waiting on a device too
+
+        size_t normal_limit = 1;                        // Normal and Background running together
+        size_t background_limit = 1;
+        std::atomic<size_t> normal_running{0};
+        std::atomic<size_t> background_running{0};
+        std::atomic<size_t> blocked{0};                 // Workers inside a BlockingScope
+
+        std::mutex devices_mutex;
+        std::unordered_map<std::string, Device> devices;
+
+        std::mutex wake_mutex;
+        std::condition_variable wake;
+        uint64_t signal = 0;                            // Bumped whenever there may be new work
+        bool stop = false;
+
+        std::vector<std::thread> threads;
+    };
+
+    struct TaskHandle::State
+    {
+        std::atomic<int> status{kPending};
+        std::mutex mutex;
+        std::condition_variable done;
+        TaskScheduler::Impl* owner = nullptr;
+    };
+
+    thread_local TaskScheduler::Impl* TaskScheduler::Impl::current = nullptr;
+    thread_local size_t TaskScheduler::Impl::current_worker = 0;
+    thread_local size_t TaskScheduler::Impl::current_priority = kInteractive;
+    thread_local bool TaskScheduler::Impl::current_limited = false;
+
+    TaskScheduler::Impl::Impl(size_t workers)
+    {
+        if (workers == 0)
+        {
+            size_t hardware = std::thread::hardware_concurrency();
+            workers = std::clamp(hardware, kMinWorkers, kMaxWorkers);
+        }
+
+        normal_limit = std::max<size_t>(1, workers - 1);
+        background_limit = std::max<size_t>(1, workers / 2);
+
+        for (size_t i = 0; i < workers; ++i)
+            local.push_back(std::make_unique<Queues>());
+        for (size_t i = 0; i < workers; ++i)
+            threads.emplace_back(&Impl::WorkerLoop, this, i);
+    }
+
+    void TaskScheduler::Impl::Enqueue(ItemPtr item)
+    {
+        size_t priority = static_cast<size_t>(item->options.priority);
+
+        // A worker keeps what it submits; the others steal it when idle
+        Queues& queues = current == this ? *local[current_worker] : shared;
+        {
+            std::lock_guard<std::mutex> lock(queues.mutex);
+            queues.tasks[priority].push_back(std::move(item));
+        }
+        queued.fetch_add(1, std::memory_order_release);
+
+        {
+            std::lock_guard<std::mutex> lock(wake_mutex);
+            ++signal;
+        }
+        wake.notify_one();
+    }
+
+    bool TaskScheduler::Impl::Reserve(size_t priority)
+    {
+        if (priority == kInteractive)
+            return true;
+
+        // A blocked worker is out of the count and out of the limits, so
+        // what is left for interactive work stays the same
+        size_t out = blocked.load(std::memory_order_acquire);
+        size_t normal = normal_limit > out ? normal_limit - out : 1;
+        size_t background = std::max<size_t>(1, std::min(background_limit, normal));
+        if (priority == kBackground && !Acquire(background_running, background))
+            return false;
+        if (!Acquire(normal_running, normal))
+        {
+            if (priority == kBackground)
+                background_running.fetch_sub(1, std::memory_order_acq_rel);
+            return false;
+        }
+        return true;
+    }
+
+    void TaskScheduler::Impl::Release(size_t priority)
+    {
+        if (priority == kInteractive)
+            return;
+        normal_running.fetch_sub(1, std::memory_order_acq_rel);
+        if (priority == kBackground)
+            background_running.fetch_sub(1, std::memory_order_acq_rel);
+    }
+
+    TaskScheduler::Impl::ItemPtr TaskScheduler::Impl::Take(size_t worker, size_t priority)
+    {
+        auto pop = [priority](Queues& queues, bool back) -> ItemPtr
+        {
+            std::lock_guard<std::mutex> lock(queues.mutex);
+            auto& tasks = queues.tasks[priority];
+            if (tasks.empty())
+                return nullptr;
+            ItemPtr item;
+            if (back)
+            {
+                item = std::move(tasks.back());
+                tasks.pop_back();
+            }
+            else
+            {
+                item = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            return item;
+        };
+
+        // Own work newest first, while its data is still in cache; the
+        // shared queue and other workers' oldest first
+        if (auto item = pop(*local[worker], true))
+            return item;
+        if (auto item = pop(shared, false))
+            return item;
+        for (size_t i = 1; i < local.size(); ++i)
+        {
+            if (auto item = pop(*local[(worker + i) % local.size()], false))
+                return item;
+        }
+        return nullptr;
+    }
+
+    bool TaskScheduler::Impl::RunOne(size_t worker, bool helping)
+    {
+        if (queued.load(std::memory_order_acquire) == 0)
+            return false;
+
+        for (size_t priority = 0; priority < kPriorities; ++priority)
+        {
+            // A worker waiting on a task ignores the limits, or a task
+            // waiting on a child of its own class could wait forever
+            bool limited = !helping && priority != kInteractive;
+            if (limited && !Reserve(priority))
+                continue;
+
+            ItemPtr item = Take(worker, priority);
+            if (!item)
+            {
+                if (limited)
+                    Release(priority);
+                continue;
+            }
+
+            queued.fetch_sub(1, std::memory_order_acq_rel);
+            Run(std::move(item), priority, limited);
+            return true;
+        }
+        return false;
+    }
+
+    void TaskScheduler::Impl::Run(ItemPtr item, size_t priority, bool limited)
+    {
+        if (item->options.cancel.IsCancelled())
+        {
+            if (limited)
+                Release(priority);
+            Finish(*item, kSkipped);
+            return;
+        }
+
+        const std::string device_name = item->options.io_device;
+        if (!device_name.empty())
+        {
+            std::lock_guard<std::mutex> lock(devices_mutex);
+            Device& device = devices[device_name];
+            if (device.running >= device.limit)
+            {
+                if (limited)
+                    Release(priority);
+                device.waiting[priority].push_back(std::move(item));
+                return;
+            }
+            ++device.running;
+        }
+
+        item->state->status.store(kRunning, std::memory_order_relaxed);
+        size_t outer_priority = current_priority;
+        bool outer_limited = current_limited;
+        current_priority = priority;
+        current_limited = limited;
+        try
+        {
+            item->task(item->options.cancel);
+        }
+        catch (const std::exception& ex)
+        {
+            Logger::Get()->error("Background task failed: {}", ex.what());
+        }
+        catch (...)
+        {
+            Logger::Get()->error("Background task failed");
+        }
+        current_priority = outer_priority;
+        current_limited = outer_limited;
+
+        if (limited)
+            Release(priority);
+
+        if (!device_name.empty())
+        {
+            // Waiting tasks cancelled meanwhile are finished here: nothing
+            // else would take them off the device
+            ItemPtr next;
+            std::vector<ItemPtr> skipped;
+            {
+                std::lock_guard<std::mutex> lock(devices_mutex);
+                Device& device = devices[device_name];
+                --device.running;
+                for (auto& waiting : device.waiting)
+                {
+                    while (!next && !waiting.empty())
+                    {
+                        ItemPtr candidate = std::move(waiting.front());
+                        waiting.pop_front();
+                        if (candidate->options.cancel.IsCancelled())
+                            skipped.push_back(std::move(candidate));
+                        else
+                            next = std::move(candidate);
+                    }
+                    if (next)
+                        break;
+                }
+            }
+            for (auto& item_skipped : skipped)
+                Finish(*item_skipped, kSkipped);
+            if (next)
+                Enqueue(std::move(next));
+        }
+
+        Finish(*item, kDone);
+    }
+
+    void TaskScheduler::Impl::Finish(Item& item, TaskStatus status)
+    {
+        // Captures go before waiters wake, since they may own what was captured
+        item.task = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(item.state->mutex);
+            item.state->status.store(status, std::memory_order_release);
+        }
+        item.state->done.notify_all();
+
+        if (unfinished.fetch_sub(1, std::memory_order_acq_rel) == 1)
+        {
+            // Only stopping workers wait for this
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                ++signal;
+            }
+            wake.notify_all();
+        }
+    }
+
+    void TaskScheduler::Impl::WorkerLoop(size_t worker)
+    {
+        current = this;
+        current_worker = worker;
+        Profiler::SetThreadName("Task " + std::to_string(worker));
+
+        while (true)
+        {
+            uint64_t seen;
+            {
+                std::lock_guard<std::mutex> lock(wake_mutex);
+                seen = signal;
+            }
+
+            if (RunOne(worker, false))
+                continue;
+
+            // Work held back by a limit is picked up by the worker whose
+            // task frees the slot, so an idle worker can sleep
+            std::unique_lock<std::mutex> lock(wake_mutex);
+            auto finished = [this] { return stop && unfinished.load(std::memory_order_acquire) == 0; };
+            if (finished())
+                return;
+            wake.wait(lock, [&] { return signal != seen || finished(); });
+        }
+    }
+
+    // ========================================================================
+    // TaskHandle
+    // ========================================================================
+
+    bool TaskHandle::IsDone() const
+    {
+        return !state_ || state_->status.load(std::memory_order_acquire) >= kDone;
+    }
+
+    bool TaskHandle::WasSkipped() const
+    {
+        return state_ && state_->status.load(std::memory_order_acquire) == kSkipped;
+    }
+
+    void TaskHandle::Wait() const
+    {
+        if (!state_)
+            return;
+
+        TaskScheduler::Impl* pool = TaskScheduler::Impl::current;
+        if (pool && pool == state_->owner)
+        {
+            while (!IsDone())
+            {
+                if (!pool->RunOne(TaskScheduler::Impl::current_worker, true))
+                {
+                    std::unique_lock<std::mutex> lock(state_->mutex);
+                    state_->done.wait_for(lock, std::chrono::milliseconds(1), [this] { return IsDone(); });
+                }
+            }
+            return;
+        }
+
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->done.wait(lock, [this] { return IsDone(); });
+    }
+
+    // ========================================================================
+    // TaskGroup
+    // ========================================================================
+
+    struct TaskGroup::State
+    {
+        std::mutex mutex;
+        std::condition_variable idle;
+        size_t running = 0;
+        bool closed = false;
+        CancellationSource cancel;
+    };
+
+    TaskGroup::TaskGroup()
+        : state_(std::make_shared<State>())
+    {
+    }
+
+    TaskGroup::~TaskGroup()
+    {
+        Close();
+    }
+
+    void TaskGroup::Spawn(size_t count, std::function<void()> work, TaskOptions options)
+    {
+        if (count == 0)
+            return;
+
+        options.cancel = state_->cancel.Token();
+        auto shared_work = std::make_shared<std::function<void()>>(std::move(work));
+        for (size_t i = 0; i < count; ++i)
+        {
+            TaskScheduler::Get().Submit([state = state_, shared_work](const CancellationToken&)
+            {
+                {
+                    std::lock_guard<std::mutex> lock(state->mutex);
+                    if (state->closed)
+                        return;
+                    ++state->running;
+                }
+
+                // Counted out even when the work throws, or Close() would wait forever
+                struct Leave
+                {
+                    State& state;
+                    ~Leave()
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(state.mutex);
+                            --state.running;
+                        }
+                        state.idle.notify_all();
+                    }
+                } leave{*state};
+                (*shared_work)();
+            }, options);
+        }
+    }
+
+    void TaskGroup::Close()
+    {
+        state_->cancel.Cancel();
+        std::unique_lock<std::mutex> lock(state_->mutex);
+        state_->closed = true;
+        state_->idle.wait(lock, [this] { return state_->running == 0; });
+    }
+
+    // ========================================================================
+    // BlockingScope
+    // ========================================================================
+
+    BlockingScope::BlockingScope()
+    {
+        TaskScheduler::Impl* pool = TaskScheduler::Impl::current;
+        if (!pool || !TaskScheduler::Impl::current_limited)
+            return;
+
+        pool_ = pool;
+        priority_ = TaskScheduler::Impl::current_priority;
+        pool->Release(priority_);
+        pool->blocked.fetch_add(1, std::memory_order_acq_rel);
+
+        // The slot given back may let a waiting task go
+        {
+            std::lock_guard<std::mutex> lock(pool->wake_mutex);
+            ++pool->signal;
+        }
+        pool->wake.notify_one();
+    }
+
+    BlockingScope::~BlockingScope()
+    {
+        if (!pool_)
+            return;
+
+        // Taken back whatever the limits say; they hold again once
+        // the tasks that ran meanwhile finish
+        TaskScheduler::Impl* pool = pool_;
+        pool->blocked.fetch_sub(1, std::memory_order_acq_rel);
+        pool->normal_running.fetch_add(1, std::memory_order_acq_rel);
+        if (priority_ == kBackground)
+            pool->background_running.fetch_add(1, std::memory_order_acq_rel);
+    }
+
+    // ========================================================================
+    // TaskScheduler
+    // ========================================================================
+
+    TaskScheduler& TaskScheduler::Get()
+    {
+        static TaskScheduler instance;
+        return instance;
+    }
+
+    TaskScheduler::TaskScheduler(size_t workers)
+        : impl_(std::make_unique<Impl>(workers))
+    {
+        Logger::Get()->debug("TaskScheduler started with {} workers", impl_->threads.size());
+    }
+
+    TaskScheduler::~TaskScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(impl_->wake_mutex);
+            impl_->stop = true;
+            ++impl_->signal;
+        }
+        impl_->wake.notify_all();
+        for (auto& thread : impl_->threads)
+            thread.join();
+    }
+
+    TaskHandle TaskScheduler::Submit(Task task, TaskOptions options)
+    {
+        auto state = std::make_shared<TaskHandle::State>();
+        state->owner = impl_.get();
+
+        auto item = std::make_unique<Impl::Item>();
+        item->task = std::move(task);
+        item->options = std::move(options);
+        item->state = state;
+
+        impl_->unfinished.fetch_add(1, std::memory_order_acq_rel);
+        impl_->Enqueue(std::move(item));
+        return TaskHandle(std::move(state));
+    }
+
+    void TaskScheduler::SetIoLimit(const std::string& device, size_t concurrent)
+    {
+        std::vector<Impl::ItemPtr> released;
+        {
+            std::lock_guard<std::mutex> lock(impl_->devices_mutex);
+            Impl::Device& entry = impl_->devices[device];
+            entry.limit = std::max<size_t>(1, concurrent);
+
+            // A raised limit lets waiting tasks go now
+            size_t free = entry.limit > entry.running ? entry.limit - entry.running : 0;
+            for (auto& waiting : entry.waiting)
+            {
+                while (free > 0 && !waiting.empty())
+                {
+                    released.push_back(std::move(waiting.front()));
+                    waiting.pop_front();
+                    --free;
+                }
+            }
+        }
+        for (auto& item : released)
+            impl_->Enqueue(std::move(item));
+    }
+
+    size_t TaskScheduler::WorkerCount() const
+    {
+        return impl_->threads.size();
+    }
+
+    std::string TaskScheduler::IoDevice(const Path& path)
+    {
+        std::string device = Path(path.Get().root_name()).String();
+        for (char& c : device)
+        {
+            if (c >= 'A' && c <= 'Z')
+                c = static_cast<char>(c - 'A' + 'a');
+        }
+        return device;
+    }
+
+} // namespace opacity::core
@@ -2,17 +2,23 @@
 // Copyright (c) 2025 Opacity Project
 
 #include "opacity/core/UpdateManager.h"
+#include "opacity/core/TaskScheduler.h"
 #include <spdlog/spdlog.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <filesystem>
-#include <thread>
 #include <atomic>
 #include <mutex>
 #include <regex>
 #include <set>
+#include <thread>
+#include <vector>
 
 #define WIN32_LEAN_AND_MEAN
 #define NOMINMAX
@@ -21,10 +27,12 @@
 #include <wincrypt.h>
 #include <ShlObj.h>
 #include <shellapi.h>
+#include <msdelta.h>
 
 #pragma comment(lib, "wininet.lib")
 #pragma comment(lib, "crypt32.lib")
 #pragma comment(lib, "shell32.lib")
+#pragma comment(lib, "msdelta.lib")
 
 namespace fs = std::filesystem;
 using json = nlohmann::json;
@@ -113,6 +121,45 @@ static std::chrono::system_clock::time_point StringToTimePoint(const std::string
     return std::chrono::system_clock::from_time_t(std::mktime(&tm));
 }
 
+// Connection attempts per download; each one resumes where the last stopped
+static constexpr int kMaxDownloadAttempts = 6;
+static constexpr DWORD kReceiveTimeoutMs = 30000;
+
+static std::string ToLower(std::string text) {
+    std::transform(text.begin(), text.end(), text.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    return text;
+}
+
+// GitHub publishes an asset's hash as "sha256:<hex>"
+static std::string AssetSha256(const json& asset) {
+    std::string digest = asset.value("digest", "");
+    const std::string prefix = "sha256:";
+    if (digest.compare(0, prefix.size(), prefix) == 0) {
+        return ToLower(digest.substr(prefix.size()));
+    }
+    return "";
+}
+
+static std::string ReadTextFile(const fs::path& path) {
+    std::ifstream file(path, std::ios::binary);
+    std::ostringstream oss;
+    oss << file.rdbuf();
+    return oss.str();
+}
+
+class InternetHandle {
+public:
+    explicit InternetHandle(HINTERNET handle) : handle_(handle) {}
+    ~InternetHandle() { if (handle_) InternetCloseHandle(handle_); }
+    InternetHandle(const InternetHandle&) = delete;
+    InternetHandle& operator=(const InternetHandle&) = delete;
+    operator HINTERNET() const { return handle_; }
+    explicit operator bool() const { return handle_ != nullptr; }
+private:
+    HINTERNET handle_;
+};
+
 class UpdateManager::Impl {
 public:
     Version currentVersion;
@@ -127,6 +174,13 @@ public:
     std::string downloadPath;
     std::string lastError;
     
+    // Downloads, and installers kept as the base of the next delta
+    std::string updatesDir;
+    std::string installedPackage;           // Installer of the running version
+    std::string installedPackageVersion;
+    std::string pendingPackage;             // Installer launched; kept once its version runs
+    std::string pendingPackageVersion;
+    
     // Settings
     bool autoCheck = true;
     int autoCheckIntervalHours = 24;
@@ -140,7 +194,8 @@ public:
     std::atomic<bool> downloading{false};
     std::atomic<bool> cancelRequested{false};
     DownloadProgress downloadProgress;
-    std::thread downloadThread;
+    TaskHandle downloadTask;
+    TaskHandle checkTask;
     std::mutex downloadMutex;
     
     std::vector<EventCallback> callbacks;
@@ -204,49 +259,129 @@ public:
         return true;
     }
     
-    bool downloadFile(const std::string& url, const std::string& destPath) {
-        HINTERNET hInternet = InternetOpenA("Opacity/1.0", 
-                                           INTERNET_OPEN_TYPE_PRECONFIG, 
-                                           nullptr, nullptr, 0);
-        if (!hInternet) {
-            return false;
+    enum class Transfer {
+        Complete,
+        Interrupted,    // Worth another attempt, from where it stopped
+        Failed          // The server refused it; another attempt would too
+    };
+    
+    // One request for what the partial file still lacks. The validator
+    // (the ETag, or Last-Modified) recorded with it goes in If-Range, so a
+    // release replaced since sends the whole new file instead of the rest
+    // of the old one.
+    Transfer transfer(const std::string& url, const fs::path& part, const fs::path& validatorPath,
+                      std::chrono::steady_clock::time_point startTime, uint64_t& sessionBytes) {
+        std::error_code ec;
+        uint64_t have = fs::exists(part, ec) ? fs::file_size(part, ec) : 0;
+        if (ec) {
+            have = 0;
         }
+        std::string validator = ReadTextFile(validatorPath);
         
-        HINTERNET hConnect = InternetOpenUrlA(hInternet, url.c_str(), 
-                                             nullptr, 0, 
-                                             INTERNET_FLAG_RELOAD | INTERNET_FLAG_SECURE,
-                                             0);
-        if (!hConnect) {
-            InternetCloseHandle(hInternet);
-            return false;
+        std::string headers;
+        if (have > 0 && !validator.empty()) {
+            headers = "Range: bytes=" + std::to_string(have) + "-\r\nIf-Range: " + validator + "\r\n";
+        } else {
+            have = 0;   // Nothing says the bytes on disk belong to this file
+        }
+        
+        InternetHandle internet(InternetOpenA("Opacity/1.0", INTERNET_OPEN_TYPE_PRECONFIG, nullptr, nullptr, 0));
+        if (!internet) {
+            lastError = "Failed to initialize WinINet";
+            return Transfer::Interrupted;
         }
+        DWORD timeout = kReceiveTimeoutMs;
+        InternetSetOptionA(internet, INTERNET_OPTION_RECEIVE_TIMEOUT, &timeout, sizeof(timeout));
         
-        // Get content length
-        DWORD contentLength = 0;
-        DWORD bufSize = sizeof(contentLength);
-        HttpQueryInfoA(hConnect, HTTP_QUERY_CONTENT_LENGTH | HTTP_QUERY_FLAG_NUMBER,
-                      &contentLength, &bufSize, nullptr);
+        InternetHandle request(InternetOpenUrlA(internet, url.c_str(),
+                                                headers.empty() ? nullptr : headers.c_str(),
+                                                headers.empty() ? 0 : static_cast<DWORD>(-1),
+                                                INTERNET_FLAG_RELOAD | INTERNET_FLAG_SECURE |
+                                                INTERNET_FLAG_NO_CACHE_WRITE,
+                                                0));
+        if (!request) {
+            lastError = "Failed to connect to URL";
+            return Transfer::Interrupted;
+        }
         
-        downloadProgress.totalBytes = contentLength;
-        downloadProgress.bytesDownloaded = 0;
+        DWORD status = 0;
+        DWORD size = sizeof(status);
+        HttpQueryInfoA(request, HTTP_QUERY_STATUS_CODE | HTTP_QUERY_FLAG_NUMBER, &status, &size, nullptr);
+        if (status == 416) {
+            // The range starts at or past the end: stale, start over
+            fs::remove(part, ec);
+            fs::remove(validatorPath, ec);
+            return Transfer::Interrupted;
+        }
+        if (status != 200 && status != 206) {
+            lastError = "Server returned HTTP " + std::to_string(status);
+            return status >= 500 ? Transfer::Interrupted : Transfer::Failed;
+        }
+        bool resumed = status == 206;
+        if (!resumed) {
+            have = 0;
+        }
         
-        std::ofstream file(destPath, std::ios::binary);
-        if (!file) {
-            InternetCloseHandle(hConnect);
-            InternetCloseHandle(hInternet);
-            return false;
+        char lengthText[32] = {};
+        DWORD lengthSize = sizeof(lengthText);
+        uint64_t contentLength = 0;
+        if (HttpQueryInfoA(request, HTTP_QUERY_CONTENT_LENGTH, lengthText, &lengthSize, nullptr)) {
+            contentLength = std::strtoull(lengthText, nullptr, 10);
         }
         
-        char buffer[8192];
-        DWORD bytesRead;
-        auto startTime = std::chrono::steady_clock::now();
+        // Weak ETags may not be used for ranges
+        char text[256] = {};
+        DWORD textSize = sizeof(text) - 1;
+        std::string newValidator;
+        if (HttpQueryInfoA(request, HTTP_QUERY_ETAG, text, &textSize, nullptr) &&
+            std::strncmp(text, "W/", 2) != 0) {
+            newValidator.assign(text, textSize);
+        } else {
+            textSize = sizeof(text) - 1;
+            if (HttpQueryInfoA(request, HTTP_QUERY_LAST_MODIFIED, text, &textSize, nullptr)) {
+                newValidator.assign(text, textSize);
+            }
+        }
+        if (!resumed) {
+            if (newValidator.empty()) {
+                fs::remove(validatorPath, ec);
+            } else {
+                std::ofstream(validatorPath, std::ios::binary | std::ios::trunc) << newValidator;
+            }
+        }
+        
+        downloadProgress.totalBytes = contentLength > 0 ? have + contentLength : 0;
+        downloadProgress.bytesDownloaded = have;
+        
+        std::ofstream file(part, std::ios::binary | (resumed ? std::ios::app : std::ios::trunc));
+        if (!file) {
+            lastError = "Cannot write " + part.u8string();
+            return Transfer::Failed;
+        }
+        if (resumed) {
+            spdlog::info("UpdateManager: resuming download at {} bytes", have);
+        }
         
+        std::vector<char> buffer(64 * 1024);
+        uint64_t received = 0;
+        bool readFailed = false;
         while (!cancelRequested) {
-            if (!InternetReadFile(hConnect, buffer, sizeof(buffer), &bytesRead) || bytesRead == 0) {
+            DWORD bytesRead = 0;
+            if (!InternetReadFile(request, buffer.data(), static_cast<DWORD>(buffer.size()), &bytesRead)) {
+                readFailed = true;
+                break;
+            }
+            if (bytesRead == 0) {
                 break;
             }
             
-            file.write(buffer, bytesRead);
+            file.write(buffer.data(), bytesRead);
+            if (!file) {
+                lastError = "Cannot write " + part.u8string();
+                return Transfer::Failed;
+            }
+            received += bytesRead;
+            sessionBytes += bytesRead;
             downloadProgress.bytesDownloaded += bytesRead;
             
             // Calculate progress
@@ -255,12 +390,11 @@ public:
                     100.0 * downloadProgress.bytesDownloaded / downloadProgress.totalBytes;
             }
             
-            // Calculate speed
+            // Speed counts what this session fetched, not what was resumed
             auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(
                 std::chrono::steady_clock::now() - startTime).count();
             if (elapsed > 0) {
-                downloadProgress.speedBytesPerSecond = 
-                    static_cast<double>(downloadProgress.bytesDownloaded) / elapsed;
+                downloadProgress.speedBytesPerSecond = static_cast<double>(sessionBytes) / elapsed;
                 
                 if (downloadProgress.speedBytesPerSecond > 0 && downloadProgress.totalBytes > 0) {
                     uint64_t remaining = downloadProgress.totalBytes - downloadProgress.bytesDownloaded;
@@ -272,18 +406,171 @@ public:
             notifyProgress();
         }
         
-        file.close();
-        InternetCloseHandle(hConnect);
-        InternetCloseHandle(hInternet);
+        if (cancelRequested || readFailed || (contentLength > 0 && received < contentLength)) {
+            lastError = "Connection lost during download";
+            return Transfer::Interrupted;
+        }
+        return Transfer::Complete;
+    }
+    
+    // Waits out a backoff; false if cancelled meanwhile
+    bool waitBeforeRetry(int attempt) {
+        auto until = std::chrono::steady_clock::now() + std::chrono::seconds(2 << std::min(attempt, 5));
+        while (std::chrono::steady_clock::now() < until) {
+            if (cancelRequested) {
+                return false;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        }
+        return !cancelRequested;
+    }
+    
+    /**
+     * Fetch url into destPath, which only appears once complete and, when
+     * expectedSha256 is given, verified. Bytes already fetched are kept in
+     * destPath + ".part" across failures, cancellation and restarts.
+     */
+    bool downloadFile(const std::string& url, const std::string& destPath, const std::string& expectedSha256) {
+        fs::path dest = fs::u8path(destPath);
+        fs::path part = dest;
+        part += ".part";
+        fs::path validator = dest;
+        validator += ".validator";
         
-        if (cancelRequested) {
-            fs::remove(destPath);
+        auto startTime = std::chrono::steady_clock::now();
+        uint64_t sessionBytes = 0;
+        Transfer result = Transfer::Interrupted;
+        for (int attempt = 0; attempt < kMaxDownloadAttempts; ++attempt) {
+            if (attempt > 0) {
+                spdlog::warn("UpdateManager: {}; retrying ({} of {})", lastError, attempt + 1,
+                             kMaxDownloadAttempts);
+                if (!waitBeforeRetry(attempt)) {
+                    break;
+                }
+            }
+            result = transfer(url, part, validator, startTime, sessionBytes);
+            if (result != Transfer::Interrupted || cancelRequested) {
+                break;
+            }
+        }
+        if (result != Transfer::Complete || cancelRequested) {
             return false;
         }
         
+        std::error_code ec;
+        if (!expectedSha256.empty()) {
+            downloadProgress.status = "Verifying";
+            notifyProgress();
+            if (computeSHA256(part.u8string()) != ToLower(expectedSha256)) {
+                // Nothing of it can be trusted; the next attempt starts clean
+                fs::remove(part, ec);
+                fs::remove(validator, ec);
+                lastError = "Downloaded file failed hash verification";
+                return false;
+            }
+        }
+        
+        fs::remove(dest, ec);
+        fs::rename(part, dest, ec);
+        if (ec) {
+            lastError = "Cannot move download into place: " + ec.message();
+            return false;
+        }
+        fs::remove(validator, ec);
         return true;
     }
     
+    bool isDownloaded(const std::string& path, const std::string& expectedSha256) {
+        std::error_code ec;
+        if (path.empty() || !fs::exists(fs::u8path(path), ec)) {
+            return false;
+        }
+        return expectedSha256.empty() || computeSHA256(path) == ToLower(expectedSha256);
+    }
+    
+    bool canPatch(const UpdateInfo& update) const {
+        std::error_code ec;
+        return !update.deltaUrl.empty() && !update.sha256Hash.empty() &&
+               !installedPackage.empty() && installedPackageVersion == update.deltaBase.toString() &&
+               fs::exists(fs::u8path(installedPackage), ec);
+    }
+    
+    // Download the delta and rebuild the installer from the kept one in a
+    // staging directory; targetPath only appears if the result verifies
+    bool downloadAndApplyDelta(const UpdateInfo& update, const std::string& targetPath) {
+        fs::path dir = fs::u8path(updatesDir);
+        fs::path delta = dir / fs::u8path(update.deltaFileName);
+        downloadProgress.status = "Downloading patch";
+        if (!downloadFile(update.deltaUrl, delta.u8string(), update.deltaSha256)) {
+            return false;
+        }
+        
+        downloadProgress.status = "Applying patch";
+        notifyProgress();
+        
+        std::error_code ec;
+        fs::path staging = dir / "staging";
+        fs::create_directories(staging, ec);
+        fs::path staged = staging / fs::u8path(targetPath).filename();
+        fs::remove(staged, ec);
+        
+        bool applied = ApplyDeltaW(DELTA_FLAG_NONE, fs::u8path(installedPackage).wstring().c_str(),
+                                   delta.wstring().c_str(), staged.wstring().c_str()) != FALSE;
+        DWORD error = applied ? 0 : GetLastError();
+        fs::remove(delta, ec);
+        if (!applied) {
+            lastError = "Failed to apply update patch (error " + std::to_string(error) + ")";
+            return false;
+        }
+        
+        if (computeSHA256(staged.u8string()) != ToLower(update.sha256Hash)) {
+            fs::remove(staged, ec);
+            lastError = "Patched installer failed hash verification";
+            return false;
+        }
+        
+        fs::path target = fs::u8path(targetPath);
+        fs::remove(target, ec);
+        fs::rename(staged, target, ec);
+        if (ec) {
+            lastError = "Cannot move patched installer into place: " + ec.message();
+            return false;
+        }
+        
+        spdlog::info("UpdateManager: rebuilt {} from {} with a {} byte patch", update.fileName,
+                     update.deltaBase.toString(), update.deltaSize);
+        return true;
+    }
+    
+    // Once the version an installer was launched for is the one running,
+    // that installer becomes the base for the next delta
+    void adoptInstalledPackage() {
+        if (pendingPackage.empty() || pendingPackageVersion != currentVersion.toString()) {
+            return;
+        }
+        
+        std::error_code ec;
+        fs::path pending = fs::u8path(pendingPackage);
+        fs::path baseDir = fs::u8path(updatesDir) / "installed";
+        fs::path base = baseDir / pending.filename();
+        if (fs::exists(pending, ec) && base != pending) {
+            fs::create_directories(baseDir, ec);
+            if (!installedPackage.empty() && fs::u8path(installedPackage) != base) {
+                fs::remove(fs::u8path(installedPackage), ec);
+            }
+            fs::remove(base, ec);
+            fs::rename(pending, base, ec);
+            if (!ec) {
+                installedPackage = base.u8string();
+                installedPackageVersion = pendingPackageVersion;
+                spdlog::info("UpdateManager: keeping {} for delta updates", installedPackage);
+            }
+        }
+        pendingPackage.clear();
+        pendingPackageVersion.clear();
+        saveToFile();
+    }
+    
     std::string computeSHA256(const std::string& filePath) {
         HCRYPTPROV hProv = 0;
         HCRYPTHASH hHash = 0;
@@ -298,7 +585,7 @@ public:
             return "";
         }
         
-        std::ifstream file(filePath, std::ios::binary);
+        std::ifstream file(fs::u8path(filePath), std::ios::binary);
         if (!file) {
             CryptDestroyHash(hHash);
             CryptReleaseContext(hProv, 0);
@@ -343,6 +630,10 @@ public:
                                                             skippedVersions.end());
             j["installScheduled"] = installScheduled;
             j["downloadPath"] = downloadPath;
+            j["installedPackage"] = installedPackage;
+            j["installedPackageVersion"] = installedPackageVersion;
+            j["pendingPackage"] = pendingPackage;
+            j["pendingPackageVersion"] = pendingPackageVersion;
             
             fs::path dir = fs::path(configPath).parent_path();
             if (!fs::exists(dir)) {
@@ -388,6 +679,10 @@ public:
             }
             if (j.contains("installScheduled")) installScheduled = j["installScheduled"];
             if (j.contains("downloadPath")) downloadPath = j["downloadPath"];
+            installedPackage = j.value("installedPackage", "");
+            installedPackageVersion = j.value("installedPackageVersion", "");
+            pendingPackage = j.value("pendingPackage", "");
+            pendingPackageVersion = j.value("pendingPackageVersion", "");
             
             return true;
         } catch (...) {
@@ -426,6 +721,8 @@ bool UpdateManager::initialize(const Version& currentVersion, const std::string&
     }
     
     pImpl->loadFromFile();
+    pImpl->updatesDir = (fs::u8path(pImpl->configPath).parent_path() / "updates").u8string();
+    pImpl->adoptInstalledPackage();
     
     pImpl->initialized = true;
     spdlog::info("UpdateManager: initialized, current version {}", currentVersion.toString());
@@ -435,9 +732,8 @@ bool UpdateManager::initialize(const Version& currentVersion, const std::string&
 void UpdateManager::shutdown() {
     if (pImpl->initialized) {
         pImpl->cancelRequested = true;
-        if (pImpl->downloadThread.joinable()) {
-            pImpl->downloadThread.join();
-        }
+        pImpl->downloadTask.Wait();
+        pImpl->checkTask.Wait();
         saveSettings();
         pImpl->initialized = false;
     }
@@ -486,6 +782,7 @@ bool UpdateManager::checkForUpdates() {
             }
             
             // Found a newer version
+            pImpl->availableUpdate = UpdateInfo();
             pImpl->availableUpdate.version = releaseVersion;
             pImpl->availableUpdate.releaseNotes = release.value("body", "");
             pImpl->availableUpdate.isPrerelease = isPrerelease;
@@ -498,17 +795,44 @@ bool UpdateManager::checkForUpdates() {
             
             // Find download asset
             if (release.contains("assets")) {
+                UpdateInfo& update = pImpl->availableUpdate;
                 for (const auto& asset : release["assets"]) {
                     std::string name = asset.value("name", "");
                     // Look for Windows installer
-                    if (name.find(".exe") != std::string::npos || 
-                        name.find(".msi") != std::string::npos) {
-                        pImpl->availableUpdate.downloadUrl = 
-                            asset.value("browser_download_url", "");
-                        pImpl->availableUpdate.fileName = name;
-                        pImpl->availableUpdate.fileSize = asset.value("size", 0);
+                    if (name.size() > 4 &&
+                        (name.compare(name.size() - 4, 4, ".exe") == 0 ||
+                         name.compare(name.size() - 4, 4, ".msi") == 0)) {
+                        update.downloadUrl = asset.value("browser_download_url", "");
+                        update.fileName = name;
+                        update.fileSize = asset.value("size", uint64_t{0});
+                        update.sha256Hash = AssetSha256(asset);
+                        break;
+                    }
+                }
+                
+                // "<installer>.sha256" when the release has no digests, and
+                // "<installer>.from-<version>.delta" from the running version
+                std::string deltaName = update.fileName + ".from-" +
+                                        pImpl->currentVersion.toString() + ".delta";
+                for (const auto& asset : release["assets"]) {
+                    if (update.fileName.empty()) {
                         break;
                     }
+                    std::string name = asset.value("name", "");
+                    if (name == update.fileName + ".sha256" && update.sha256Hash.empty()) {
+                        std::string text;
+                        if (pImpl->httpGet(asset.value("browser_download_url", ""), text)) {
+                            std::istringstream iss(text);
+                            iss >> update.sha256Hash;
+                            update.sha256Hash = ToLower(update.sha256Hash);
+                        }
+                    } else if (name == deltaName) {
+                        update.deltaUrl = asset.value("browser_download_url", "");
+                        update.deltaFileName = name;
+                        update.deltaSize = asset.value("size", uint64_t{0});
+                        update.deltaSha256 = AssetSha256(asset);
+                        update.deltaBase = pImpl->currentVersion;
+                    }
                 }
             }
             
@@ -542,9 +866,11 @@ bool UpdateManager::checkForUpdates() {
 }
 
 bool UpdateManager::checkForUpdatesAsync() {
-    std::thread([this]() {
+    TaskOptions options;
+    options.priority = TaskPriority::Background;
+    pImpl->checkTask = TaskScheduler::Get().Submit([this](const CancellationToken&) {
         checkForUpdates();
-    }).detach();
+    }, std::move(options));
     return true;
 }
 
@@ -573,29 +899,36 @@ bool UpdateManager::downloadUpdate() {
     pImpl->state = UpdateState::Downloading;
     pImpl->downloading = true;
     pImpl->cancelRequested = false;
+    pImpl->lastError.clear();
+    pImpl->downloadProgress = DownloadProgress();
     pImpl->notifyEvent(UpdateEventType::DownloadStarted);
     
-    // Create download directory
-    wchar_t tempPath[MAX_PATH];
-    GetTempPathW(MAX_PATH, tempPath);
+    // Kept beside the settings rather than in temp, so a partial download
+    // survives cleanup and reboots and is resumed
+    const UpdateInfo& update = pImpl->availableUpdate;
+    std::error_code ec;
+    fs::path dir = fs::u8path(pImpl->updatesDir);
+    fs::create_directories(dir, ec);
+    pImpl->downloadPath = (dir / fs::u8path("Opacity_Update_" + update.version.toString() + "_" +
+                                            update.fileName)).u8string();
     
-    int len = WideCharToMultiByte(CP_UTF8, 0, tempPath, -1, nullptr, 0, nullptr, nullptr);
-    std::string tempDir;
-    if (len > 0) {
-        tempDir.resize(len - 1);
-        WideCharToMultiByte(CP_UTF8, 0, tempPath, -1, &tempDir[0], len, nullptr, nullptr);
+    bool success = pImpl->isDownloaded(pImpl->downloadPath, update.sha256Hash);
+    if (!success && pImpl->canPatch(update)) {
+        success = pImpl->downloadAndApplyDelta(update, pImpl->downloadPath);
+        if (!success && !pImpl->cancelRequested) {
+            spdlog::warn("UpdateManager: delta update failed ({}); downloading the full installer",
+                         pImpl->lastError);
+        }
+    }
+    if (!success && !pImpl->cancelRequested) {
+        pImpl->downloadProgress.status = "Downloading";
+        success = pImpl->downloadFile(update.downloadUrl, pImpl->downloadPath, update.sha256Hash);
     }
-    
-    pImpl->downloadPath = tempDir + "Opacity_Update_" + 
-                         pImpl->availableUpdate.version.toString() + "_" +
-                         pImpl->availableUpdate.fileName;
-    
-    bool success = pImpl->downloadFile(pImpl->availableUpdate.downloadUrl, 
-                                       pImpl->downloadPath);
     
     pImpl->downloading = false;
     
     if (success) {
+        pImpl->downloadProgress.status = "Downloaded";
         pImpl->state = UpdateState::Downloaded;
         pImpl->notifyEvent(UpdateEventType::DownloadCompleted);
         pImpl->saveToFile();
@@ -603,7 +936,11 @@ bool UpdateManager::downloadUpdate() {
         return true;
     } else {
         pImpl->state = UpdateState::Failed;
-        pImpl->lastError = "Download failed or cancelled";
+        if (pImpl->cancelRequested) {
+            pImpl->lastError = "Download cancelled; it resumes from where it stopped";
+        } else if (pImpl->lastError.empty()) {
+            pImpl->lastError = "Download failed";
+        }
         pImpl->notifyEvent(UpdateEventType::Error, pImpl->lastError);
         return false;
     }
@@ -614,13 +951,13 @@ bool UpdateManager::downloadUpdateAsync() {
         return false;
     }
     
-    if (pImpl->downloadThread.joinable()) {
-        pImpl->downloadThread.join();
-    }
+    pImpl->downloadTask.Wait();
     
-    pImpl->downloadThread = std::thread([this]() {
+    TaskOptions options;
+    options.priority = TaskPriority::Background;
+    pImpl->downloadTask = TaskScheduler::Get().Submit([this](const CancellationToken&) {
         downloadUpdate();
-    });
+    }, std::move(options));
     
     return true;
 }
@@ -647,7 +984,7 @@ std::string UpdateManager::getDownloadedFilePath() const {
 }
 
 bool UpdateManager::installUpdate() {
-    if (pImpl->downloadPath.empty() || !fs::exists(pImpl->downloadPath)) {
+    if (pImpl->downloadPath.empty() || !fs::exists(fs::u8path(pImpl->downloadPath))) {
         pImpl->lastError = "No downloaded update found";
         return false;
     }
@@ -665,6 +1002,10 @@ bool UpdateManager::installUpdate() {
     sei.nShow = SW_SHOWNORMAL;
     
     if (ShellExecuteExA(&sei)) {
+        // Becomes the base for the next delta once this version runs
+        pImpl->pendingPackage = pImpl->downloadPath;
+        pImpl->pendingPackageVersion = pImpl->availableUpdate.version.toString();
+        pImpl->saveToFile();
         pImpl->notifyEvent(UpdateEventType::InstallCompleted);
         spdlog::info("UpdateManager: installer launched");
         return true;
@@ -686,7 +1027,7 @@ bool UpdateManager::installUpdateAndRestart() {
 }
 
 bool UpdateManager::scheduleInstallOnExit() {
-    if (pImpl->downloadPath.empty() || !fs::exists(pImpl->downloadPath)) {
+    if (pImpl->downloadPath.empty() || !fs::exists(fs::u8path(pImpl->downloadPath))) {
         return false;
     }
     
@@ -700,7 +1041,7 @@ bool UpdateManager::isInstallScheduled() const {
 }
 
 bool UpdateManager::verifyDownload() const {
-    if (pImpl->downloadPath.empty() || !fs::exists(pImpl->downloadPath)) {
+    if (pImpl->downloadPath.empty() || !fs::exists(fs::u8path(pImpl->downloadPath))) {
         return false;
     }
     
@@ -710,7 +1051,7 @@ bool UpdateManager::verifyDownload() const {
     }
     
     std::string computedHash = pImpl->computeSHA256(pImpl->downloadPath);
-    return computedHash == pImpl->availableUpdate.sha256Hash;
+    return computedHash == ToLower(pImpl->availableUpdate.sha256Hash);
 }
 
 void UpdateManager::setAutoCheck(bool enabled) {
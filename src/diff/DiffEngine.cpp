@@ -1,14 +1,506 @@
 #include "opacity/diff/DiffEngine.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/MappedFile.h"
 
 #include <fstream>
 #include <sstream>
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string_view>
+#include <thread>
 #include <unordered_map>
 
+#if defined(_M_X64) || defined(__x86_64__)
+#define OPACITY_DIFF_SSE 1
+#include <emmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
 namespace opacity::diff
 {
+    namespace
+    {
+        // Below this many edits per split a shortest script is always found
+        constexpr ptrdiff_t kMinEditCostLimit = 256;
+
+        // Binary comparison work unit; large enough that claiming one is
+        // free, small enough to spread a file over every thread
+        constexpr uint64_t kCompareBlockSize = 16 * 1024 * 1024;
+
+#ifdef OPACITY_DIFF_SSE
+        inline unsigned LowestBit(uint32_t mask)
+        {
+#ifdef _MSC_VER
+            unsigned long index = 0;
+            _BitScanForward(&index, mask);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(mask));
+#endif
+        }
+
+        // Bit i set where a[i] == b[i], for 16 bytes
+        inline uint32_t EqualMask(const uint8_t* a, const uint8_t* b)
+        {
+            __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a));
+            __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b));
+            return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)));
+        }
+#endif
+
+        /**
+         * @brief Offset of the first byte that differs, or length
+         */
+        uint64_t FirstDifference(const uint8_t* a, const uint8_t* b, uint64_t length)
+        {
+            uint64_t i = 0;
+#ifdef OPACITY_DIFF_SSE
+            // 64 bytes per test while everything matches, the common case
+            for (; i + 64 <= length; i += 64)
+            {
+                __m128i equal = _mm_and_si128(
+                    _mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i))),
+                        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 16)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 16)))),
+                    _mm_and_si128(
+                        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 32)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 32))),
+                        _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i + 48)),
+                                       _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i + 48)))));
+                if (_mm_movemask_epi8(equal) != 0xFFFF)
+                    break;
+            }
+            for (; i + 16 <= length; i += 16)
+            {
+                uint32_t mask = EqualMask(a + i, b + i);
+                if (mask != 0xFFFF)
+                    return i + LowestBit(~mask & 0xFFFF);
+            }
+#endif
+            for (; i < length; ++i)
+            {
+                if (a[i] != b[i])
+                    return i;
+            }
+            return length;
+        }
+
+        /**
+         * @brief Offset of the first byte that matches, or length
+         */
+        uint64_t FirstEqual(const uint8_t* a, const uint8_t* b, uint64_t length)
+        {
+            uint64_t i = 0;
+#ifdef OPACITY_DIFF_SSE
+            for (; i + 16 <= length; i += 16)
+            {
+                uint32_t mask = EqualMask(a + i, b + i);
+                if (mask != 0)
+                    return i + LowestBit(mask);
+            }
+#endif
+            for (; i < length; ++i)
+            {
+                if (a[i] == b[i])
+                    return i;
+            }
+            return length;
+        }
+
+        struct BlockDifferences
+        {
+            std::vector<BinaryDiffRange> ranges;
+            bool truncated = false;     // Stopped at the range limit
+        };
+
+        /**
+         * @brief Differing ranges of [begin, end), merged across gaps of
+         *        fewer than merge_gap equal bytes
+         */
+        void ScanBlock(const uint8_t* a, const uint8_t* b, uint64_t begin, uint64_t end,
+            const BinaryCompareOptions& options, BlockDifferences& out)
+        {
+            uint64_t pos = begin;
+            while (pos < end)
+            {
+                pos += FirstDifference(a + pos, b + pos, end - pos);
+                if (pos >= end)
+                    break;
+                uint64_t run_end = pos + FirstEqual(a + pos, b + pos, end - pos);
+
+                auto& ranges = out.ranges;
+                if (!ranges.empty() && pos - (ranges.back().offset + ranges.back().length) < options.merge_gap)
+                {
+                    ranges.back().length = run_end - ranges.back().offset;
+                }
+                else if (ranges.size() < options.max_ranges)
+                {
+                    ranges.push_back({pos, run_end - pos});
+                }
+                else
+                {
+                    out.truncated = true;
+                    return;
+                }
+                pos = run_end;
+            }
+        }
+
+        // Append a range in offset order, merging it into the last one when
+        // close enough; false once the limit is reached
+        bool AppendRange(std::vector<BinaryDiffRange>& ranges, const BinaryDiffRange& range,
+            const BinaryCompareOptions& options)
+        {
+            if (!ranges.empty())
+            {
+                auto& last = ranges.back();
+                uint64_t last_end = last.offset + last.length;
+                if (range.offset - last_end < options.merge_gap)
+                {
+                    last.length = std::max(last_end, range.offset + range.length) - last.offset;
+                    return true;
+                }
+            }
+            if (ranges.size() >= options.max_ranges)
+                return false;
+            ranges.push_back(range);
+            return true;
+        }
+
+        /**
+         * @brief Marks the lines of two sequences that are not part of a
+         *        common subsequence
+         *
+         * Myers uses the O(ND) algorithm with the linear-space middle snake:
+         * a range is split where the forward and backward searches meet and
+         * both halves are compared in turn, so memory stays O(N + M) however
+         * far apart the sequences are. Past a cost limit that grows with the
+         * square root of the input, the split is taken wherever the forward
+         * search got furthest instead, trading minimality for time on
+         * unrelated inputs.
+         *
+         * Patience anchors each range on the lines that occur exactly once
+         * on both sides, in their longest common order, and handles ranges
+         * without any such line with Myers.
+         */
+        template <typename T>
+        class SequenceMatcher
+        {
+        public:
+            SequenceMatcher(const std::vector<T>& left, const std::vector<T>& right)
+                : left_(left)
+                , right_(right)
+                , left_changed_(left.size(), false)
+                , right_changed_(right.size(), false)
+            {
+                auto root = static_cast<ptrdiff_t>(std::sqrt(static_cast<double>(left.size() + right.size())));
+                cost_limit_ = std::max(kMinEditCostLimit, root);
+            }
+
+            void CompareMyers()
+            {
+                RunMyers({0, left_.size(), 0, right_.size()});
+            }
+
+            void ComparePatience()
+            {
+                RunPatience({0, left_.size(), 0, right_.size()});
+            }
+
+            const std::vector<bool>& LeftChanged() const { return left_changed_; }
+            const std::vector<bool>& RightChanged() const { return right_changed_; }
+
+        private:
+            struct Range
+            {
+                size_t left_begin;
+                size_t left_end;
+                size_t right_begin;
+                size_t right_end;
+            };
+
+            void MarkChanged(const Range& range)
+            {
+                std::fill(left_changed_.begin() + range.left_begin, left_changed_.begin() + range.left_end, true);
+                std::fill(right_changed_.begin() + range.right_begin, right_changed_.begin() + range.right_end, true);
+            }
+
+            // Narrow a range past its common prefix and suffix; false when
+            // one side is used up and the rest has been marked
+            bool Trim(Range& range)
+            {
+                while (range.left_begin < range.left_end && range.right_begin < range.right_end &&
+                       left_[range.left_begin] == right_[range.right_begin])
+                {
+                    ++range.left_begin;
+                    ++range.right_begin;
+                }
+                while (range.left_begin < range.left_end && range.right_begin < range.right_end &&
+                       left_[range.left_end - 1] == right_[range.right_end - 1])
+                {
+                    --range.left_end;
+                    --range.right_end;
+                }
+
+                if (range.left_begin == range.left_end || range.right_begin == range.right_end)
+                {
+                    MarkChanged(range);
+                    return false;
+                }
+                return true;
+            }
+
+            void RunMyers(const Range& whole)
+            {
+                // An explicit stack; splits of unrelated inputs can go deep
+                std::vector<Range> pending{whole};
+                while (!pending.empty())
+                {
+                    Range range = pending.back();
+                    pending.pop_back();
+                    if (!Trim(range))
+                        continue;
+
+                    size_t split_left = 0;
+                    size_t split_right = 0;
+                    if (!Bisect(range, split_left, split_right))
+                    {
+                        MarkChanged(range);
+                        continue;
+                    }
+                    pending.push_back({split_left, range.left_end, split_right, range.right_end});
+                    pending.push_back({range.left_begin, split_left, range.right_begin, split_right});
+                }
+            }
+
+            /**
+             * @brief Find where a shortest path crosses the middle diagonal
+             * @return false when the range has no common line to split on
+             */
+            bool Bisect(const Range& range, size_t& split_left, size_t& split_right)
+            {
+                const T* a = left_.data() + range.left_begin;
+                const T* b = right_.data() + range.right_begin;
+                const auto n = static_cast<ptrdiff_t>(range.left_end - range.left_begin);
+                const auto m = static_cast<ptrdiff_t>(range.right_end - range.right_begin);
+
+                const ptrdiff_t max_d = (n + m + 1) / 2;
+                const ptrdiff_t offset = max_d;
+                const ptrdiff_t length = 2 * max_d + 2;
+                forward_.assign(static_cast<size_t>(length), -1);
+                backward_.assign(static_cast<size_t>(length), -1);
+                forward_[offset + 1] = 0;
+                backward_[offset + 1] = 0;
+
+                const ptrdiff_t delta = n - m;
+                const bool odd = (delta & 1) != 0;
+                ptrdiff_t k1_start = 0, k1_end = 0, k2_start = 0, k2_end = 0;
+                ptrdiff_t best_x = 0, best_y = 0;
+
+                auto split = [&](ptrdiff_t x, ptrdiff_t y)
+                {
+                    // A split that leaves the whole range on one side would never end
+                    if ((x == 0 && y == 0) || (x == n && y == m))
+                        return false;
+                    split_left = range.left_begin + static_cast<size_t>(x);
+                    split_right = range.right_begin + static_cast<size_t>(y);
+                    return true;
+                };
+
+                const ptrdiff_t limit = std::min(max_d, cost_limit_);
+                for (ptrdiff_t d = 0; d < limit; ++d)
+                {
+                    // Forward: furthest reaching path on each diagonal k
+                    for (ptrdiff_t k1 = -d + k1_start; k1 <= d - k1_end; k1 += 2)
+                    {
+                        ptrdiff_t k1_offset = offset + k1;
+                        ptrdiff_t x1 = (k1 == -d || (k1 != d && forward_[k1_offset - 1] < forward_[k1_offset + 1]))
+                            ? forward_[k1_offset + 1]
+                            : forward_[k1_offset - 1] + 1;
+                        ptrdiff_t y1 = x1 - k1;
+                        while (x1 < n && y1 < m && a[x1] == b[y1])
+                        {
+                            ++x1;
+                            ++y1;
+                        }
+                        forward_[k1_offset] = x1;
+
+                        if (x1 > n)
+                            k1_end += 2;
+                        else if (y1 > m)
+                            k1_start += 2;
+                        else
+                        {
+                            if (x1 + y1 > best_x + best_y)
+                            {
+                                best_x = x1;
+                                best_y = y1;
+                            }
+                            if (odd)
+                            {
+                                ptrdiff_t k2_offset = offset + delta - k1;
+                                if (k2_offset >= 0 && k2_offset < length && backward_[k2_offset] != -1 &&
+                                    x1 >= n - backward_[k2_offset])
+                                {
+                                    return split(x1, y1);
+                                }
+                            }
+                        }
+                    }
+
+                    // Backward, from the end of both sequences
+                    for (ptrdiff_t k2 = -d + k2_start; k2 <= d - k2_end; k2 += 2)
+                    {
+                        ptrdiff_t k2_offset = offset + k2;
+                        ptrdiff_t x2 = (k2 == -d || (k2 != d && backward_[k2_offset - 1] < backward_[k2_offset + 1]))
+                            ? backward_[k2_offset + 1]
+                            : backward_[k2_offset - 1] + 1;
+                        ptrdiff_t y2 = x2 - k2;
+                        while (x2 < n && y2 < m && a[n - x2 - 1] == b[m - y2 - 1])
+                        {
+                            ++x2;
+                            ++y2;
+                        }
+                        backward_[k2_offset] = x2;
+
+                        if (x2 > n)
+                            k2_end += 2;
+                        else if (y2 > m)
+                            k2_start += 2;
+                        else if (!odd)
+                        {
+                            ptrdiff_t k1_offset = offset + delta - k2;
+                            if (k1_offset >= 0 && k1_offset < length && forward_[k1_offset] != -1)
+                            {
+                                ptrdiff_t x1 = forward_[k1_offset];
+                                ptrdiff_t y1 = offset + x1 - k1_offset;
+                                if (x1 >= n - x2)
+                                {
+                                    return split(x1, y1);
+                                }
+                            }
+                        }
+                    }
+                }
+
+                // Too costly to finish: settle for how far the forward search got
+                return limit < max_d && split(best_x, best_y);
+            }
+
+            void RunPatience(const Range& whole)
+            {
+                std::vector<Range> pending{whole};
+                while (!pending.empty())
+                {
+                    Range range = pending.back();
+                    pending.pop_back();
+                    if (!Trim(range))
+                        continue;
+
+                    auto anchors = UniqueAnchors(range);
+                    if (anchors.empty())
+                    {
+                        RunMyers(range);
+                        continue;
+                    }
+
+                    // The gaps between anchors, which match each other
+                    size_t left_begin = range.left_begin;
+                    size_t right_begin = range.right_begin;
+                    for (const auto& [left_index, right_index] : anchors)
+                    {
+                        pending.push_back({left_begin, left_index, right_begin, right_index});
+                        left_begin = left_index + 1;
+                        right_begin = right_index + 1;
+                    }
+                    pending.push_back({left_begin, range.left_end, right_begin, range.right_end});
+                }
+            }
+
+            /**
+             * @brief Lines found exactly once on each side of the range, in
+             *        the longest run that keeps the same order on both
+             */
+            std::vector<std::pair<size_t, size_t>> UniqueAnchors(const Range& range) const
+            {
+                struct Occurrence
+                {
+                    size_t left_count = 0;
+                    size_t right_count = 0;
+                    size_t right_index = 0;
+                };
+                struct Hash
+                {
+                    size_t operator()(const T* value) const { return std::hash<T>{}(*value); }
+                };
+                struct Equal
+                {
+                    bool operator()(const T* a, const T* b) const { return *a == *b; }
+                };
+
+                std::unordered_map<const T*, Occurrence, Hash, Equal> occurrences;
+                occurrences.reserve(range.left_end - range.left_begin);
+                for (size_t i = range.left_begin; i < range.left_end; ++i)
+                    ++occurrences[&left_[i]].left_count;
+                for (size_t j = range.right_begin; j < range.right_end; ++j)
+                {
+                    auto it = occurrences.find(&right_[j]);
+                    if (it != occurrences.end())
+                    {
+                        ++it->second.right_count;
+                        it->second.right_index = j;
+                    }
+                }
+
+                std::vector<std::pair<size_t, size_t>> matches;
+                for (size_t i = range.left_begin; i < range.left_end; ++i)
+                {
+                    const auto& occurrence = occurrences[&left_[i]];
+                    if (occurrence.left_count == 1 && occurrence.right_count == 1)
+                        matches.emplace_back(i, occurrence.right_index);
+                }
+
+                // Longest increasing run of right indices, by patience sorting
+                std::vector<size_t> tails;
+                std::vector<size_t> previous(matches.size(), SIZE_MAX);
+                for (size_t index = 0; index < matches.size(); ++index)
+                {
+                    auto pile = std::lower_bound(tails.begin(), tails.end(), matches[index].second,
+                        [&matches](size_t tail, size_t right) { return matches[tail].second < right; });
+                    if (pile != tails.begin())
+                        previous[index] = *(pile - 1);
+                    if (pile == tails.end())
+                        tails.push_back(index);
+                    else
+                        *pile = index;
+                }
+
+                std::vector<std::pair<size_t, size_t>> anchors;
+                for (size_t index = tails.empty() ? SIZE_MAX : tails.back(); index != SIZE_MAX; index = previous[index])
+                    anchors.push_back(matches[index]);
+                std::reverse(anchors.begin(), anchors.end());
+                return anchors;
+            }
+
+            const std::vector<T>& left_;
+            const std::vector<T>& right_;
+            std::vector<bool> left_changed_;
+            std::vector<bool> right_changed_;
+            std::vector<ptrdiff_t> forward_;
+            std::vector<ptrdiff_t> backward_;
+            ptrdiff_t cost_limit_ = kMinEditCostLimit;
+        };
+    }
+
     DiffEngine::DiffEngine() = default;
     DiffEngine::~DiffEngine() = default;
 
@@ -93,75 +585,146 @@ namespace opacity::diff
 
     BinaryDiffResult DiffEngine::CompareBinaryFiles(
         const core::Path& left_path,
-        const core::Path& right_path)
+        const core::Path& right_path,
+        const BinaryCompareOptions& options)
     {
         BinaryDiffResult result;
         result.left_file = left_path.String();
         result.right_file = right_path.String();
 
-        std::ifstream left_stream(left_path.String(), std::ios::binary | std::ios::ate);
-        std::ifstream right_stream(right_path.String(), std::ios::binary | std::ios::ate);
-
-        if (!left_stream)
+        std::error_code ec;
+        result.left_size = std::filesystem::file_size(left_path.Get(), ec);
+        if (ec)
         {
             result.error_message = "Failed to open left file: " + left_path.String();
             return result;
         }
-
-        if (!right_stream)
+        result.right_size = std::filesystem::file_size(right_path.Get(), ec);
+        if (ec)
         {
             result.error_message = "Failed to open right file: " + right_path.String();
             return result;
         }
 
-        result.left_size = static_cast<uint64_t>(left_stream.tellg());
-        result.right_size = static_cast<uint64_t>(right_stream.tellg());
+        // Sizes alone settle equality
+        if (options.equality_only && result.left_size != result.right_size)
+        {
+            result.success = true;
+            return result;
+        }
 
-        left_stream.seekg(0);
-        right_stream.seekg(0);
+        // Empty files cannot be mapped, and have nothing to compare
+        core::MappedFile left_map, right_map;
+        if (result.left_size > 0 && !left_map.Open(left_path.Get()))
+        {
+            result.error_message = "Failed to open left file: " + left_path.String();
+            return result;
+        }
+        if (result.right_size > 0 && !right_map.Open(right_path.Get()))
+        {
+            result.error_message = "Failed to open right file: " + right_path.String();
+            return result;
+        }
+        result.left_size = left_map.Size();
+        result.right_size = right_map.Size();
+
+        const uint8_t* left_data = left_map.Data();
+        const uint8_t* right_data = right_map.Data();
+        const uint64_t common = std::min(result.left_size, result.right_size);
+        const size_t block_count = static_cast<size_t>((common + kCompareBlockSize - 1) / kCompareBlockSize);
 
-        // Compare byte by byte
-        const size_t buffer_size = 65536;
-        std::vector<char> left_buffer(buffer_size);
-        std::vector<char> right_buffer(buffer_size);
-        
-        size_t offset = 0;
-        bool found_difference = false;
+        // Blocks are claimed in order, so once a difference is found every
+        // earlier block has already been claimed and will still finish
+        std::vector<BlockDifferences> blocks(block_count);
+        std::atomic<size_t> next_block{0};
+        std::atomic<bool> found{false};
 
-        while (left_stream && right_stream)
+        auto worker = [&]()
         {
-            left_stream.read(left_buffer.data(), buffer_size);
-            right_stream.read(right_buffer.data(), buffer_size);
+            for (size_t index; (index = next_block.fetch_add(1)) < block_count;)
+            {
+                if (options.equality_only && found.load(std::memory_order_relaxed))
+                    return;
 
-            auto left_read = left_stream.gcount();
-            auto right_read = right_stream.gcount();
+                uint64_t begin = index * kCompareBlockSize;
+                uint64_t end = std::min(begin + kCompareBlockSize, common);
+                if (options.equality_only)
+                {
+                    uint64_t offset = FirstDifference(left_data + begin, right_data + begin, end - begin);
+                    if (offset < end - begin)
+                    {
+                        blocks[index].ranges.push_back({begin + offset, 1});
+                        found.store(true, std::memory_order_relaxed);
+                    }
+                }
+                else
+                {
+                    ScanBlock(left_data, right_data, begin, end, options, blocks[index]);
+                }
+            }
+        };
 
-            auto compare_size = std::min(left_read, right_read);
+        unsigned thread_count = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+        thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, block_count));
+        if (thread_count <= 1)
+        {
+            worker();
+        }
+        else
+        {
+            std::vector<std::thread> threads;
+            threads.reserve(thread_count);
+            for (unsigned t = 0; t < thread_count; ++t)
+                threads.emplace_back(worker);
+            for (auto& thread : threads)
+                thread.join();
+        }
 
-            for (std::streamsize i = 0; i < compare_size; ++i)
+        if (options.equality_only)
+        {
+            for (const auto& block : blocks)
             {
-                if (left_buffer[i] != right_buffer[i])
+                if (!block.ranges.empty())
                 {
-                    result.first_difference_offset = offset + static_cast<size_t>(i);
-                    found_difference = true;
-                    break;
+                    result.first_difference_offset = block.ranges.front().offset;
+                    result.success = true;
+                    return result;
                 }
             }
+            result.are_identical = true;
+            result.success = true;
+            return result;
+        }
 
-            if (found_difference)
-                break;
-
-            if (left_read != right_read)
+        // Stitch the blocks together; a range can run across a boundary
+        bool complete = true;
+        for (const auto& block : blocks)
+        {
+            for (const auto& range : block.ranges)
             {
-                result.first_difference_offset = offset + static_cast<size_t>(std::min(left_read, right_read));
-                found_difference = true;
+                if (!AppendRange(result.ranges, range, options))
+                {
+                    complete = false;
+                    break;
+                }
+            }
+            if (!complete || block.truncated)
+            {
+                complete = false;
                 break;
             }
+        }
 
-            offset += static_cast<size_t>(compare_size);
+        if (complete && result.left_size != result.right_size)
+        {
+            uint64_t longer = std::max(result.left_size, result.right_size);
+            complete = AppendRange(result.ranges, {common, longer - common}, options);
         }
+        result.ranges_truncated = !complete;
 
-        result.are_identical = !found_difference && (result.left_size == result.right_size);
+        result.are_identical = result.ranges.empty() && result.left_size == result.right_size;
+        if (!result.ranges.empty())
+            result.first_difference_offset = result.ranges.front().offset;
         result.success = true;
 
         return result;
@@ -386,73 +949,131 @@ body { font-family: monospace; }
     {
         std::vector<DiffLine> result;
 
-        // Simple LCS-based diff algorithm
-        // In production, use Myers algorithm for better performance
-
         size_t left_size = left_lines.size();
         size_t right_size = right_lines.size();
 
-        // Create normalized versions for comparison
-        std::vector<std::string> left_norm, right_norm;
-        for (const auto& line : left_lines)
-            left_norm.push_back(NormalizeLine(line, options));
-        for (const auto& line : right_lines)
-            right_norm.push_back(NormalizeLine(line, options));
+        // Normalize each line once and intern it: lines that compare equal
+        // share an id on both sides, and matching runs on the ids
+        const bool normalizes = options.ignore_case || options.ignore_whitespace ||
+            options.ignore_leading_whitespace || options.ignore_trailing_whitespace;
 
-        // Build LCS table
-        std::vector<std::vector<size_t>> lcs(left_size + 1, std::vector<size_t>(right_size + 1, 0));
+        std::unordered_map<std::string_view, uint32_t> ids;
+        ids.reserve(left_size + right_size);
+        std::deque<std::string> normalized;     // Keys of normalized lines; a deque never moves them
+        std::vector<uint8_t> sides;             // Per id: 1 if seen on the left, 2 on the right
 
-        for (size_t i = 1; i <= left_size; ++i)
+        auto intern = [&](const std::string& line, uint8_t side)
         {
-            for (size_t j = 1; j <= right_size; ++j)
+            std::string folded;
+            std::string_view key = line;
+            if (normalizes)
             {
-                if (left_norm[i - 1] == right_norm[j - 1])
-                    lcs[i][j] = lcs[i - 1][j - 1] + 1;
-                else
-                    lcs[i][j] = std::max(lcs[i - 1][j], lcs[i][j - 1]);
+                folded = NormalizeLine(line, options);
+                key = folded;
+            }
+
+            auto it = ids.find(key);
+            if (it == ids.end())
+            {
+                if (normalizes)
+                {
+                    normalized.push_back(std::move(folded));
+                    key = normalized.back();
+                }
+                it = ids.emplace(key, static_cast<uint32_t>(sides.size())).first;
+                sides.push_back(0);
+            }
+            sides[it->second] |= side;
+            return it->second;
+        };
+
+        std::vector<uint32_t> left_ids, right_ids;
+        left_ids.reserve(left_size);
+        right_ids.reserve(right_size);
+        for (const auto& line : left_lines)
+            left_ids.push_back(intern(line, 1));
+        for (const auto& line : right_lines)
+            right_ids.push_back(intern(line, 2));
+
+        // A line found on one side only can never match, so it is marked
+        // changed here and the matcher only sees lines both sides share.
+        // That is not the same alignment as matching every line: among
+        // equally long matches another may be picked, and the Myers cost
+        // limit falls elsewhere, so with repeated lines a hunk can start or
+        // end on a different copy than before
+        std::vector<bool> left_changed(left_size, true);
+        std::vector<bool> right_changed(right_size, true);
+        std::vector<uint32_t> left_shared, right_shared;
+        std::vector<size_t> left_index, right_index;
+        for (size_t i = 0; i < left_size; ++i)
+        {
+            if (sides[left_ids[i]] == 3)
+            {
+                left_shared.push_back(left_ids[i]);
+                left_index.push_back(i);
+            }
+        }
+        for (size_t j = 0; j < right_size; ++j)
+        {
+            if (sides[right_ids[j]] == 3)
+            {
+                right_shared.push_back(right_ids[j]);
+                right_index.push_back(j);
             }
         }
 
-        // Backtrack to find differences
+        SequenceMatcher<uint32_t> matcher(left_shared, right_shared);
+        if (options.algorithm == DiffAlgorithm::Patience)
+            matcher.ComparePatience();
+        else
+            matcher.CompareMyers();
+
+        for (size_t i = 0; i < left_shared.size(); ++i)
+            left_changed[left_index[i]] = matcher.LeftChanged()[i];
+        for (size_t j = 0; j < right_shared.size(); ++j)
+            right_changed[right_index[j]] = matcher.RightChanged()[j];
+
+        // Walk both sides; unmarked lines pair up in order, and each change
+        // block lists its removals before its additions
         std::vector<DiffLine> temp_result;
-        size_t i = left_size;
-        size_t j = right_size;
+        temp_result.reserve(std::max(left_size, right_size));
+        size_t i = 0;
+        size_t j = 0;
 
-        while (i > 0 || j > 0)
+        while (i < left_size || j < right_size)
         {
             DiffLine line;
+            bool left_remaining = i < left_size;
+            bool right_remaining = j < right_size;
 
-            if (i > 0 && j > 0 && left_norm[i - 1] == right_norm[j - 1])
+            if (left_remaining && (left_changed[i] || !right_remaining))
             {
-                line.type = DiffType::Equal;
-                line.left_text = left_lines[i - 1];
-                line.right_text = right_lines[j - 1];
-                line.left_line_number = i;
-                line.right_line_number = j;
-                --i;
-                --j;
+                line.type = DiffType::Removed;
+                line.left_text = left_lines[i];
+                line.left_line_number = i + 1;
+                ++i;
             }
-            else if (j > 0 && (i == 0 || lcs[i][j - 1] >= lcs[i - 1][j]))
+            else if (right_remaining && (right_changed[j] || !left_remaining))
             {
                 line.type = DiffType::Added;
-                line.right_text = right_lines[j - 1];
-                line.right_line_number = j;
-                --j;
+                line.right_text = right_lines[j];
+                line.right_line_number = j + 1;
+                ++j;
             }
-            else if (i > 0)
+            else
             {
-                line.type = DiffType::Removed;
-                line.left_text = left_lines[i - 1];
-                line.left_line_number = i;
-                --i;
+                line.type = DiffType::Equal;
+                line.left_text = left_lines[i];
+                line.right_text = right_lines[j];
+                line.left_line_number = i + 1;
+                line.right_line_number = j + 1;
+                ++i;
+                ++j;
             }
 
-            temp_result.push_back(line);
+            temp_result.push_back(std::move(line));
         }
 
-        // Reverse to get correct order
-        std::reverse(temp_result.begin(), temp_result.end());
-
         // Filter blank lines if requested
         if (options.ignore_blank_lines)
         {
@@ -461,7 +1082,11 @@ body { font-family: monospace; }
                 bool left_blank = line.left_text.find_first_not_of(" \t\r\n") == std::string::npos;
                 bool right_blank = line.right_text.find_first_not_of(" \t\r\n") == std::string::npos;
 
-                if (line.type == DiffType::Equal || (!left_blank && !right_blank))
+                // Only the side a change is on says whether it is blank
+                bool blank = (line.type == DiffType::Removed && left_blank) ||
+                    (line.type == DiffType::Added && right_blank) ||
+                    (line.type == DiffType::Modified && left_blank && right_blank);
+                if (!blank)
                 {
                     result.push_back(line);
                 }
@@ -1,17 +1,19 @@
 #include "opacity/diff/FolderComparison.h"
+#include "opacity/core/FileHasher.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/diff/DiffEngine.h"
 #include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/filesystem/CloudIntegration.h"
+#include "opacity/filesystem/OperationQueue.h"
 
 #include <algorithm>
-#include <fstream>
+#include <condition_variable>
+#include <future>
 #include <iomanip>
 #include <regex>
-#include <set>
 #include <sstream>
 
-// For hashing
-#include <array>
-
 namespace opacity::diff
 {
     // ComparisonItem implementation
@@ -54,16 +56,464 @@ namespace opacity::diff
                stats.left_only_dirs == 0 && stats.right_only_dirs == 0;
     }
 
+    namespace
+    {
+        struct ListedEntry
+        {
+            std::string name;
+            std::string key;                // Name as matched against the other side
+            bool is_directory = false;
+            uint64_t size = 0;
+            std::chrono::system_clock::time_point modified;
+        };
+
+        // One directory's entries, by key
+        using DirectoryListing = std::vector<ListedEntry>;
+
+        // Part of the progress bar the walk fills; reading contents takes the rest
+        double WalkShare(const FolderComparisonOptions& options)
+        {
+            bool reads_content = options.mode == ComparisonMode::Hash || options.mode == ComparisonMode::Content;
+            return reads_content ? 20.0 : 100.0;
+        }
+
+        /**
+         * Lists directories on a few pool tasks, newest request first: the
+         * walk asks for a directory's subdirectories in reverse and then
+         * consumes them depth first, so the newest request is the one it
+         * needs next and listings run just ahead of the walk instead of
+         * across the tree. A listing no helper has taken yet is made by the
+         * walk itself, so it never waits on a task that has not started.
+         */
+        class ListingPool
+        {
+        public:
+            explicit ListingPool(unsigned threads) : threads_(threads) {}
+
+            ~ListingPool()
+            {
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    stopping_ = true;
+                }
+                helpers_.Close();
+            }
+
+            std::future<DirectoryListing> Submit(std::function<DirectoryListing()> work)
+            {
+                std::packaged_task<DirectoryListing()> task(std::move(work));
+                auto future = task.get_future();
+                bool spawn = false;
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    tasks_.push_back(std::move(task));
+                    spawn = helpers_running_ < threads_;
+                    if (spawn)
+                        ++helpers_running_;
+                }
+                // Helpers leave once the queue is empty, so none idles on a pool slot
+                if (spawn)
+                    helpers_.Spawn(1, [this]() { Run(); });
+                return future;
+            }
+
+            DirectoryListing Get(std::future<DirectoryListing>& future)
+            {
+                // Run queued listings until this one is ready or taken by a helper
+                while (future.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+                {
+                    std::packaged_task<DirectoryListing()> task;
+                    if (!Pop(task))
+                        break;
+                    task();
+                }
+                return future.get();
+            }
+
+        private:
+            bool Pop(std::packaged_task<DirectoryListing()>& task)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (stopping_ || tasks_.empty())
+                    return false;
+                task = std::move(tasks_.back());
+                tasks_.pop_back();
+                return true;
+            }
+
+            void Run()
+            {
+                for (;;)
+                {
+                    std::packaged_task<DirectoryListing()> task;
+                    {
+                        std::lock_guard<std::mutex> lock(mutex_);
+                        if (stopping_ || tasks_.empty())
+                        {
+                            --helpers_running_;
+                            return;
+                        }
+                        task = std::move(tasks_.back());
+                        tasks_.pop_back();
+                    }
+                    task();
+                }
+            }
+
+            std::mutex mutex_;
+            std::vector<std::packaged_task<DirectoryListing()>> tasks_;
+            unsigned threads_;
+            unsigned helpers_running_ = 0;      // Spawned and not yet left, started or not
+            bool stopping_ = false;
+            core::TaskGroup helpers_;
+        };
+    }
+
+    struct FolderComparison::Walk
+    {
+        Walk(FolderComparison& owner, FolderComparisonResult& result, const ComparisonProgressCallback& progress_callback)
+            : owner(owner)
+            , result(result)
+            , options(result.options)
+            , progress_callback(progress_callback)
+            , listers(std::clamp(std::thread::hardware_concurrency(), 2u, 8u))
+        {
+        }
+
+        std::future<DirectoryListing> List(const std::filesystem::path& directory);
+
+        /**
+         * Compare one directory's entries, then each subdirectory in turn;
+         * left or right is null when the directory is on one side only.
+         * Each side keeps its own path, which may differ in case.
+         */
+        void CompareDirectory(const std::string& relative,
+                              const std::filesystem::path& left_directory, const DirectoryListing* left,
+                              const std::filesystem::path& right_directory, const DirectoryListing* right,
+                              size_t depth);
+
+        void CompareEntry(const std::string& relative, const core::Path& left_full, const ListedEntry* left,
+                          const core::Path& right_full, const ListedEntry* right);
+        void ReportProgress(const std::string& current_file);
+        void Publish();
+
+        FolderComparison& owner;
+        FolderComparisonResult& result;
+        const FolderComparisonOptions& options;
+        const ComparisonProgressCallback& progress_callback;
+        ListingPool listers;
+
+        std::vector<size_t> deferred;       // Items whose contents are compared after the walk
+        size_t processed = 0;
+        size_t published = 0;               // Items already copied to current_result_
+
+        // The walk's progress is how much of the top level it has finished
+        size_t top_level_total = 0;
+        size_t top_level_done = 0;
+        bool top_level_listed = false;
+    };
+
+    std::future<DirectoryListing> FolderComparison::Walk::List(const std::filesystem::path& directory)
+    {
+        return listers.Submit([this, directory]()
+        {
+            DirectoryListing listing;
+            if (owner.cancel_requested_.load())
+                return listing;
+
+            try
+            {
+                for (const auto& entry : std::filesystem::directory_iterator(directory))
+                {
+                    if (owner.cancel_requested_.load()) break;
+
+                    ListedEntry listed;
+                    listed.name = entry.path().filename().string();
+
+                    // Skip hidden files if not included
+                    if (!options.include_hidden && listed.name.front() == '.')
+                    {
+                        continue;
+                    }
+
+                    // Check include/exclude patterns
+                    if (!owner.MatchesPatterns(listed.name, options.include_patterns, options.exclude_patterns))
+                    {
+                        continue;
+                    }
+
+                    std::error_code ec;
+                    listed.is_directory = entry.is_directory(ec);
+                    if (!listed.is_directory)
+                    {
+                        listed.size = entry.file_size(ec);
+                        if (ec) listed.size = 0;
+                    }
+
+                    try
+                    {
+                        auto ftime = entry.last_write_time();
+                        listed.modified = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                            ftime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
+                    }
+                    catch (...) {}
+
+                    listed.key = listed.name;
+                    if (options.ignore_case)
+                    {
+                        std::transform(listed.key.begin(), listed.key.end(), listed.key.begin(), ::tolower);
+                    }
+                    listing.push_back(std::move(listed));
+                }
+            }
+            catch (const std::exception& e)
+            {
+                SPDLOG_WARN("Error enumerating folder {}: {}", directory.string(), e.what());
+            }
+
+            // Names differing only in case are one entry when case is ignored
+            std::sort(listing.begin(), listing.end(), [](const ListedEntry& a, const ListedEntry& b)
+            {
+                return a.key < b.key;
+            });
+            listing.erase(std::unique(listing.begin(), listing.end(), [](const ListedEntry& a, const ListedEntry& b)
+            {
+                return a.key == b.key;
+            }), listing.end());
+            return listing;
+        });
+    }
+
+    void FolderComparison::Walk::CompareDirectory(const std::string& relative,
+                                                  const std::filesystem::path& left_directory, const DirectoryListing* left,
+                                                  const std::filesystem::path& right_directory, const DirectoryListing* right,
+                                                  size_t depth)
+    {
+        static const DirectoryListing kEmpty;
+        const DirectoryListing& left_entries = left ? *left : kEmpty;
+        const DirectoryListing& right_entries = right ? *right : kEmpty;
+
+        struct Subdirectory
+        {
+            std::string relative;
+            std::filesystem::path left_path;
+            std::filesystem::path right_path;
+            bool left = false;
+            bool right = false;
+            std::future<DirectoryListing> left_listing;
+            std::future<DirectoryListing> right_listing;
+        };
+        std::vector<Subdirectory> subdirectories;
+        bool descend = options.recursive && (options.max_depth == 0 || depth + 1 < options.max_depth);
+
+        size_t i = 0;
+        size_t j = 0;
+        while (i < left_entries.size() || j < right_entries.size())
+        {
+            if (owner.cancel_requested_.load())
+                return;
+
+            const ListedEntry* l = nullptr;
+            const ListedEntry* r = nullptr;
+            if (j == right_entries.size() || (i < left_entries.size() && left_entries[i].key < right_entries[j].key))
+                l = &left_entries[i++];
+            else if (i == left_entries.size() || right_entries[j].key < left_entries[i].key)
+                r = &right_entries[j++];
+            else
+            {
+                l = &left_entries[i++];
+                r = &right_entries[j++];
+            }
+
+            // Named as on the left where it exists, so syncing keeps its case
+            const std::string& name = l ? l->name : r->name;
+            std::string child = relative.empty() ? name : relative + "/" + name;
+            std::filesystem::path left_path = l ? left_directory / l->name : std::filesystem::path();
+            std::filesystem::path right_path = r ? right_directory / r->name : std::filesystem::path();
+            CompareEntry(child, core::Path(left_path), l, core::Path(right_path), r);
+
+            bool left_is_directory = l && l->is_directory;
+            bool right_is_directory = r && r->is_directory;
+            if (descend && (left_is_directory || right_is_directory))
+            {
+                Subdirectory subdirectory;
+                subdirectory.relative = std::move(child);
+                subdirectory.left_path = std::move(left_path);
+                subdirectory.right_path = std::move(right_path);
+                subdirectory.left = left_is_directory;
+                subdirectory.right = right_is_directory;
+                subdirectories.push_back(std::move(subdirectory));
+            }
+            else if (depth == 0)
+            {
+                ++top_level_done;
+            }
+
+            if (depth == 0)
+                ++top_level_total;
+        }
+        if (depth == 0)
+            top_level_listed = true;
+        Publish();
+
+        for (auto it = subdirectories.rbegin(); it != subdirectories.rend(); ++it)
+        {
+            if (it->left)
+                it->left_listing = List(it->left_path);
+            if (it->right)
+                it->right_listing = List(it->right_path);
+        }
+
+        for (auto& subdirectory : subdirectories)
+        {
+            if (owner.cancel_requested_.load())
+                return;
+
+            // A directory on one side only walks alone, so all it holds is listed
+            DirectoryListing left_listing;
+            DirectoryListing right_listing;
+            if (subdirectory.left)
+                left_listing = listers.Get(subdirectory.left_listing);
+            if (subdirectory.right)
+                right_listing = listers.Get(subdirectory.right_listing);
+
+            CompareDirectory(subdirectory.relative,
+                             subdirectory.left_path, subdirectory.left ? &left_listing : nullptr,
+                             subdirectory.right_path, subdirectory.right ? &right_listing : nullptr,
+                             depth + 1);
+
+            if (depth == 0)
+            {
+                ++top_level_done;
+                ReportProgress(subdirectory.relative);
+            }
+        }
+    }
+
+    void FolderComparison::Walk::CompareEntry(const std::string& relative, const core::Path& left_full, const ListedEntry* left,
+                                              const core::Path& right_full, const ListedEntry* right)
+    {
+        ComparisonItem item;
+        item.relative_path = relative;
+
+        if (left)
+        {
+            item.left_exists = true;
+            item.left_size = left->size;
+            item.left_modified = left->modified;
+            item.left_is_directory = left->is_directory;
+        }
+
+        if (right)
+        {
+            item.right_exists = true;
+            item.right_size = right->size;
+            item.right_modified = right->modified;
+            item.right_is_directory = right->is_directory;
+        }
+
+        // Determine status
+        if (item.left_exists && item.right_exists)
+        {
+            if (item.left_is_directory && item.right_is_directory)
+            {
+                item.status = ComparisonStatus::Identical;
+                ++result.stats.identical_dirs;
+            }
+            else if (item.left_is_directory != item.right_is_directory)
+            {
+                item.status = ComparisonStatus::Different;
+                ++result.stats.different_files;
+            }
+            else
+            {
+                // Both are files - compare based on mode
+                ComparisonMode mode = options.mode;
+                if ((mode == ComparisonMode::Hash || mode == ComparisonMode::Content) &&
+                    (filesystem::CloudIntegration::ShouldSkipRead(left_full.Get(), options.read_placeholders) ||
+                     filesystem::CloudIntegration::ShouldSkipRead(right_full.Get(), options.read_placeholders)))
+                {
+                    // Reading either side would download it
+                    mode = ComparisonMode::Date;
+                    item.placeholder = true;
+                    ++result.stats.placeholders_skipped;
+                }
+
+                // Files of different sizes differ without being read
+                bool reads_content = mode == ComparisonMode::Hash || mode == ComparisonMode::Content;
+                if (reads_content && item.left_size == item.right_size)
+                {
+                    deferred.push_back(result.items.size());
+                    result.stats.left_total_size += item.left_size;
+                    result.stats.right_total_size += item.right_size;
+                    result.items.push_back(std::move(item));
+                    return;
+                }
+
+                item.status = owner.CompareFiles(left_full, right_full, mode, item);
+                CountFile(item, result.stats);
+            }
+        }
+        else if (item.left_exists)
+        {
+            item.status = ComparisonStatus::LeftOnly;
+            if (item.left_is_directory)
+                ++result.stats.left_only_dirs;
+            else
+                ++result.stats.left_only_files;
+        }
+        else
+        {
+            item.status = ComparisonStatus::RightOnly;
+            if (item.right_is_directory)
+                ++result.stats.right_only_dirs;
+            else
+                ++result.stats.right_only_files;
+        }
+
+        result.stats.left_total_size += item.left_size;
+        result.stats.right_total_size += item.right_size;
+        result.items.push_back(std::move(item));
+        ++processed;
+
+        ReportProgress(relative);
+    }
+
+    void FolderComparison::Walk::ReportProgress(const std::string& current_file)
+    {
+        if (!progress_callback)
+            return;
+
+        // Nothing is known of the rest of the tree until the top level has
+        // been listed, so until then the walk stays at zero
+        double walked = top_level_listed && top_level_total > 0
+            ? static_cast<double>(top_level_done) / top_level_total : 0.0;
+
+        ComparisonProgress progress;
+        progress.files_processed = processed;
+        progress.total_files = result.items.size();
+        progress.current_file = current_file;
+        progress.percentage = walked * WalkShare(options);
+        progress_callback(progress);
+    }
+
+    void FolderComparison::Walk::Publish()
+    {
+        std::lock_guard<std::mutex> lock(owner.result_mutex_);
+        owner.current_result_.items.insert(owner.current_result_.items.end(),
+                                           result.items.begin() + static_cast<std::ptrdiff_t>(published),
+                                           result.items.end());
+        owner.current_result_.stats = result.stats;
+        published = result.items.size();
+    }
+
     // FolderComparison implementation
     FolderComparison::FolderComparison() = default;
 
     FolderComparison::~FolderComparison()
     {
         Cancel();
-        if (worker_thread_ && worker_thread_->joinable())
-        {
-            worker_thread_->join();
-        }
+        worker_task_.Wait();
     }
 
     FolderComparisonResult FolderComparison::Compare(
@@ -101,141 +551,38 @@ namespace opacity::diff
             return result;
         }
 
-        // Enumerate both folders
-        auto left_items = EnumerateFolder(left_path, options);
-        auto right_items = EnumerateFolder(right_path, options);
-
-        if (cancel_requested_.load())
+        // Walk both trees together; each directory's two listings are
+        // merge-joined as soon as they arrive, and results stream out
+        // into the current result as each directory is done
         {
-            result.error_message = "Comparison cancelled";
-            running_.store(false);
-            return result;
+            std::lock_guard<std::mutex> lock(result_mutex_);
+            current_result_ = FolderComparisonResult();
+            current_result_.left_root = left_path;
+            current_result_.right_root = right_path;
+            current_result_.options = options;
         }
 
-        // Build lookup maps
-        std::unordered_map<std::string, filesystem::FsItem> left_map;
-        std::unordered_map<std::string, filesystem::FsItem> right_map;
-
-        for (const auto& [rel_path, item] : left_items)
+        Walk walk(*this, result, progress_callback);
         {
-            std::string key = options.ignore_case ? 
-                [](std::string s) { std::transform(s.begin(), s.end(), s.begin(), ::tolower); return s; }(rel_path) : rel_path;
-            left_map[key] = item;
+            auto left_root = walk.List(left_path.Get());
+            auto right_root = walk.List(right_path.Get());
+            DirectoryListing left_listing = walk.listers.Get(left_root);
+            DirectoryListing right_listing = walk.listers.Get(right_root);
+            walk.CompareDirectory(std::string(), left_path.Get(), &left_listing, right_path.Get(), &right_listing, 0);
         }
 
-        for (const auto& [rel_path, item] : right_items)
+        if (cancel_requested_.load())
         {
-            std::string key = options.ignore_case ? 
-                [](std::string s) { std::transform(s.begin(), s.end(), s.begin(), ::tolower); return s; }(rel_path) : rel_path;
-            right_map[key] = item;
+            result.error_message = "Comparison cancelled";
         }
 
-        // Collect all unique paths
-        std::set<std::string> all_paths;
-        for (const auto& [path, _] : left_map) all_paths.insert(path);
-        for (const auto& [path, _] : right_map) all_paths.insert(path);
-
-        size_t total = all_paths.size();
-        size_t processed = 0;
+        std::vector<size_t> deferred = std::move(walk.deferred);
+        size_t processed = walk.processed;
+        size_t total = result.items.size();
 
-        // Compare items
-        for (const auto& rel_path : all_paths)
+        if (!deferred.empty())
         {
-            if (cancel_requested_.load())
-            {
-                result.error_message = "Comparison cancelled";
-                break;
-            }
-
-            ComparisonItem item;
-            item.relative_path = rel_path;
-
-            auto left_it = left_map.find(rel_path);
-            auto right_it = right_map.find(rel_path);
-
-            if (left_it != left_map.end())
-            {
-                item.left_exists = true;
-                item.left_size = left_it->second.size;
-                item.left_modified = left_it->second.modified_time;
-                item.left_is_directory = left_it->second.is_directory;
-            }
-
-            if (right_it != right_map.end())
-            {
-                item.right_exists = true;
-                item.right_size = right_it->second.size;
-                item.right_modified = right_it->second.modified_time;
-                item.right_is_directory = right_it->second.is_directory;
-            }
-
-            // Determine status
-            if (item.left_exists && item.right_exists)
-            {
-                if (item.left_is_directory && item.right_is_directory)
-                {
-                    item.status = ComparisonStatus::Identical;
-                    ++result.stats.identical_dirs;
-                }
-                else if (item.left_is_directory != item.right_is_directory)
-                {
-                    item.status = ComparisonStatus::Different;
-                    ++result.stats.different_files;
-                }
-                else
-                {
-                    // Both are files - compare based on mode
-                    core::Path left_full(left_path.String() + "/" + rel_path);
-                    core::Path right_full(right_path.String() + "/" + rel_path);
-                    item.status = CompareFiles(left_full, right_full, options.mode, item);
-                    
-                    if (item.status == ComparisonStatus::Identical)
-                    {
-                        ++result.stats.identical_files;
-                    }
-                    else if (item.status == ComparisonStatus::Different)
-                    {
-                        ++result.stats.different_files;
-                        result.stats.different_size += std::max(item.left_size, item.right_size);
-                    }
-                    else if (item.status == ComparisonStatus::Error)
-                    {
-                        ++result.stats.errors;
-                    }
-                }
-            }
-            else if (item.left_exists)
-            {
-                item.status = ComparisonStatus::LeftOnly;
-                if (item.left_is_directory)
-                    ++result.stats.left_only_dirs;
-                else
-                    ++result.stats.left_only_files;
-            }
-            else
-            {
-                item.status = ComparisonStatus::RightOnly;
-                if (item.right_is_directory)
-                    ++result.stats.right_only_dirs;
-                else
-                    ++result.stats.right_only_files;
-            }
-
-            result.stats.left_total_size += item.left_size;
-            result.stats.right_total_size += item.right_size;
-            result.items.push_back(item);
-            ++processed;
-
-            // Report progress
-            if (progress_callback)
-            {
-                ComparisonProgress progress;
-                progress.files_processed = processed;
-                progress.total_files = total;
-                progress.current_file = rel_path;
-                progress.percentage = total > 0 ? (static_cast<double>(processed) / total) * 100.0 : 0.0;
-                progress_callback(progress);
-            }
+            CompareContents(result, deferred, processed, total, progress_callback);
         }
 
         result.stats.total_items = result.items.size();
@@ -273,14 +620,13 @@ namespace opacity::diff
             return;
         }
 
-        // Join any previous thread
-        if (worker_thread_ && worker_thread_->joinable())
-        {
-            worker_thread_->join();
-        }
+        // Wait out any previous comparison
+        worker_task_.Wait();
 
-        worker_thread_ = std::make_unique<std::thread>([this, left_path, right_path, options, 
-                                                         progress_callback, complete_callback]()
+        core::TaskOptions task_options;
+        task_options.priority = core::TaskPriority::Background;
+        worker_task_ = core::TaskScheduler::Get().Submit([this, left_path, right_path, options,
+                                                          progress_callback, complete_callback](const core::CancellationToken&)
         {
             auto result = Compare(left_path, right_path, options, progress_callback);
             
@@ -288,7 +634,7 @@ namespace opacity::diff
             {
                 complete_callback(result.success, result.error_message);
             }
-        });
+        }, std::move(task_options));
     }
 
     void FolderComparison::Cancel()
@@ -305,10 +651,13 @@ namespace opacity::diff
     SyncResult FolderComparison::SyncFolders(
         const FolderComparisonResult& result,
         SyncDirection direction,
-        const std::vector<size_t>* selected_items)
+        const std::vector<size_t>* selected_items,
+        const SyncOptions& options,
+        ComparisonProgressCallback progress_callback)
     {
         SyncResult sync_result;
         filesystem::FileSystemManager fs_manager;
+        cancel_requested_.store(false);
 
         std::vector<size_t> items_to_sync;
         if (selected_items)
@@ -326,13 +675,49 @@ namespace opacity::diff
             }
         }
 
+        size_t position = 0;
+        std::string current_file;
+        auto report = [&](double fraction)
+        {
+            if (progress_callback)
+            {
+                ComparisonProgress progress;
+                progress.files_processed = position;
+                progress.total_files = items_to_sync.size();
+                progress.current_file = current_file;
+                progress.percentage = (position + fraction) / items_to_sync.size() * 100.0;
+                progress_callback(progress);
+            }
+        };
+
+        // Replaces a file that exists on both sides; a large one is left
+        // for the delta copy below when asked for
+        std::vector<filesystem::OperationItem> deltas;
+        std::vector<std::string> delta_names;
+        bool deferred = false;
+        auto update = [&](const core::Path& from, const core::Path& to, uint64_t size)
+        {
+            if (options.delta && size >= options.delta_threshold)
+            {
+                deltas.push_back({from, to, size, false});
+                delta_names.push_back(current_file);
+                deferred = true;
+                return false;
+            }
+            return fs_manager.Copy(from, to, true);
+        };
+
         for (size_t idx : items_to_sync)
         {
+            if (cancel_requested_.load()) break;
             if (idx >= result.items.size()) continue;
             
             const auto& item = result.items[idx];
             core::Path left_path(result.left_root.String() + "/" + item.relative_path);
             core::Path right_path(result.right_root.String() + "/" + item.relative_path);
+            current_file = item.relative_path;
+            deferred = false;
+            report(0.0);
 
             try
             {
@@ -343,7 +728,7 @@ namespace opacity::diff
                     {
                         if (item.right_exists)
                         {
-                            if (fs_manager.Copy(left_path, right_path, true))
+                            if (update(left_path, right_path, item.left_size))
                                 ++sync_result.files_updated;
                         }
                         else
@@ -365,7 +750,7 @@ namespace opacity::diff
                     {
                         if (item.left_exists)
                         {
-                            if (fs_manager.Copy(right_path, left_path, true))
+                            if (update(right_path, left_path, item.right_size))
                                 ++sync_result.files_updated;
                         }
                         else
@@ -407,12 +792,12 @@ namespace opacity::diff
                         // Copy newer to older
                         if (item.IsLeftNewer())
                         {
-                            if (fs_manager.Copy(left_path, right_path, true))
+                            if (update(left_path, right_path, item.left_size))
                                 ++sync_result.files_updated;
                         }
                         else
                         {
-                            if (fs_manager.Copy(right_path, left_path, true))
+                            if (update(right_path, left_path, item.right_size))
                                 ++sync_result.files_updated;
                         }
                     }
@@ -421,17 +806,25 @@ namespace opacity::diff
                 case SyncDirection::Mirror:
                     if (item.left_exists && !item.left_is_directory)
                     {
-                        auto parent = right_path.Parent();
-                        if (!std::filesystem::exists(parent.Get()))
+                        if (item.right_exists && !item.right_is_directory)
                         {
-                            std::filesystem::create_directories(parent.Get());
+                            if (update(left_path, right_path, item.left_size))
+                                ++sync_result.files_updated;
                         }
-                        if (fs_manager.Copy(left_path, right_path, true))
+                        else
                         {
-                            if (item.right_exists)
-                                ++sync_result.files_updated;
-                            else
-                                ++sync_result.files_copied;
+                            auto parent = right_path.Parent();
+                            if (!std::filesystem::exists(parent.Get()))
+                            {
+                                std::filesystem::create_directories(parent.Get());
+                            }
+                            if (fs_manager.Copy(left_path, right_path, true))
+                            {
+                                if (item.right_exists)
+                                    ++sync_result.files_updated;
+                                else
+                                    ++sync_result.files_copied;
+                            }
                         }
                     }
                     else if (!item.left_exists && item.right_exists)
@@ -447,8 +840,64 @@ namespace opacity::diff
                 ++sync_result.errors;
                 sync_result.error_messages.push_back(item.relative_path + ": " + e.what());
             }
+            if (!deferred)
+                ++position;
         }
 
+        // Large files go through a copy operation, as the operation queue
+        // runs them: only changed blocks are written, the workers suit the
+        // disks, progress moves inside each file and Cancel() stops it
+        // mid-file. It runs here and not in a queue because SyncFolders
+        // returns once the sync is done, and a queue starts work only when
+        // its owner processes it. Like every copy it has no undo, and a
+        // cancelled one does not count what it had updated.
+        if (!deltas.empty() && !cancel_requested_.load())
+        {
+            filesystem::BatchOperation operation(filesystem::OperationType::Copy);
+            operation.AddItems(deltas);
+            operation.SetConflictResolution(filesystem::ConflictResolution::Overwrite);
+            operation.SetDeltaThreshold(options.delta_threshold);
+            operation.SetPriority(filesystem::OperationPriority::Background);
+
+            size_t first = position;
+            operation.SetProgressCallback([&](const filesystem::OperationProgress& progress)
+            {
+                if (cancel_requested_.load())
+                    operation.Cancel();
+
+                // The batch's share of the total, by bytes
+                double share = deltas.size() * progress.percentage / 100.0;
+                position = first + std::min(progress.completed_items, deltas.size());
+                current_file = progress.current_item;
+                report(std::max(0.0, share - static_cast<double>(position - first)));
+            });
+            operation.Start();
+            operation.WaitForCompletion();
+
+            std::unordered_map<std::string, std::string> names;
+            for (size_t i = 0; i < deltas.size(); ++i)
+            {
+                names.emplace(deltas[i].source.String(), delta_names[i]);
+            }
+
+            auto failed = operation.GetFailedItems();
+            for (const auto& [source, error] : failed)
+            {
+                auto name = names.find(source);
+                ++sync_result.errors;
+                sync_result.error_messages.push_back(
+                    (name != names.end() ? name->second : core::Path(source).Filename()) + ": " + error);
+            }
+            if (operation.GetStatus() != filesystem::OperationStatus::Cancelled)
+            {
+                sync_result.files_updated += deltas.size() - std::min(failed.size(), deltas.size());
+            }
+            sync_result.bytes_unchanged += operation.GetBytesUnchanged();
+            position = first + deltas.size();
+        }
+        if (!items_to_sync.empty())
+            report(0.0);
+
         sync_result.success = sync_result.errors == 0;
         return sync_result;
     }
@@ -591,83 +1040,6 @@ tr:nth-child(even) { background-color: #f2f2f2; }
         return ss.str();
     }
 
-    std::vector<std::pair<std::string, filesystem::FsItem>> FolderComparison::EnumerateFolder(
-        const core::Path& root,
-        const FolderComparisonOptions& options,
-        size_t current_depth)
-    {
-        std::vector<std::pair<std::string, filesystem::FsItem>> results;
-
-        if (options.max_depth > 0 && current_depth >= options.max_depth)
-        {
-            return results;
-        }
-
-        try
-        {
-            for (const auto& entry : std::filesystem::directory_iterator(root.Get()))
-            {
-                if (cancel_requested_.load()) break;
-
-                std::string name = entry.path().filename().string();
-                std::string relative = entry.path().lexically_relative(root.Get()).string();
-
-                // Skip hidden files if not included
-                if (!options.include_hidden && name.front() == '.')
-                {
-                    continue;
-                }
-
-                // Check include/exclude patterns
-                if (!MatchesPatterns(relative, options.include_patterns, options.exclude_patterns))
-                {
-                    continue;
-                }
-
-                filesystem::FsItem item;
-                item.name = name;
-                item.path = entry.path().string();
-                item.is_directory = entry.is_directory();
-
-                if (!item.is_directory)
-                {
-                    try
-                    {
-                        item.size = entry.file_size();
-                    }
-                    catch (...) { item.size = 0; }
-                }
-
-                try
-                {
-                    auto ftime = std::filesystem::last_write_time(entry.path());
-                    auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                        ftime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now());
-                    item.modified_time = sctp;
-                }
-                catch (...) {}
-
-                results.push_back({relative, item});
-
-                // Recurse into directories
-                if (item.is_directory && options.recursive)
-                {
-                    auto sub_items = EnumerateFolder(core::Path(entry.path().string()), options, current_depth + 1);
-                    for (auto& [sub_rel, sub_item] : sub_items)
-                    {
-                        results.push_back({relative + "/" + sub_rel, sub_item});
-                    }
-                }
-            }
-        }
-        catch (const std::exception& e)
-        {
-            SPDLOG_WARN("Error enumerating folder {}: {}", root.String(), e.what());
-        }
-
-        return results;
-    }
-
     ComparisonStatus FolderComparison::CompareFiles(
         const core::Path& left_path,
         const core::Path& right_path,
@@ -697,8 +1069,16 @@ tr:nth-child(even) { background-color: #f2f2f2; }
 
             case ComparisonMode::Hash:
                 {
+                    if (item.left_size != item.right_size)
+                        return ComparisonStatus::Different;
+
                     item.left_hash = CalculateHash(left_path);
                     item.right_hash = CalculateHash(right_path);
+                    if (item.left_hash.empty() || item.right_hash.empty())
+                    {
+                        item.error_message = "Failed to read files for hashing";
+                        return ComparisonStatus::Error;
+                    }
                     return (item.left_hash == item.right_hash) ? 
                         ComparisonStatus::Identical : ComparisonStatus::Different;
                 }
@@ -709,38 +1089,7 @@ tr:nth-child(even) { background-color: #f2f2f2; }
                     if (item.left_size != item.right_size)
                         return ComparisonStatus::Different;
 
-                    // Byte-by-byte comparison
-                    std::ifstream left_stream(left_path.String(), std::ios::binary);
-                    std::ifstream right_stream(right_path.String(), std::ios::binary);
-
-                    if (!left_stream || !right_stream)
-                    {
-                        item.error_message = "Failed to open files for comparison";
-                        return ComparisonStatus::Error;
-                    }
-
-                    constexpr size_t BUFFER_SIZE = 64 * 1024;
-                    std::vector<char> left_buffer(BUFFER_SIZE);
-                    std::vector<char> right_buffer(BUFFER_SIZE);
-
-                    while (left_stream && right_stream)
-                    {
-                        left_stream.read(left_buffer.data(), BUFFER_SIZE);
-                        right_stream.read(right_buffer.data(), BUFFER_SIZE);
-
-                        auto left_read = left_stream.gcount();
-                        auto right_read = right_stream.gcount();
-
-                        if (left_read != right_read)
-                            return ComparisonStatus::Different;
-
-                        if (left_read == 0) break;
-
-                        if (std::memcmp(left_buffer.data(), right_buffer.data(), left_read) != 0)
-                            return ComparisonStatus::Different;
-                    }
-
-                    return ComparisonStatus::Identical;
+                    return CompareContent(left_path, right_path, item);
                 }
             }
         }
@@ -753,30 +1102,168 @@ tr:nth-child(even) { background-color: #f2f2f2; }
         return ComparisonStatus::Error;
     }
 
-    std::string FolderComparison::CalculateHash(const core::Path& path) const
+    ComparisonStatus FolderComparison::CompareContent(
+        const core::Path& left_path,
+        const core::Path& right_path,
+        ComparisonItem& item) const
     {
-        // Simple hash implementation - in production, use a proper crypto library
-        std::ifstream file(path.String(), std::ios::binary);
-        if (!file)
-            return "";
+        // Mapped and compared a vector at a time; the pool supplies the parallelism
+        DiffEngine engine;
+        BinaryCompareOptions options;
+        options.equality_only = true;
+        options.threads = 1;
+
+        BinaryDiffResult compared = engine.CompareBinaryFiles(left_path, right_path, options);
+        if (!compared.success)
+        {
+            item.error_message = compared.error_message;
+            return ComparisonStatus::Error;
+        }
+        return compared.are_identical ? ComparisonStatus::Identical : ComparisonStatus::Different;
+    }
 
-        // Simple FNV-1a hash for demonstration
-        uint64_t hash = 14695981039346656037ULL;
-        constexpr uint64_t prime = 1099511628211ULL;
+    void FolderComparison::CompareContents(
+        FolderComparisonResult& result,
+        const std::vector<size_t>& deferred,
+        size_t processed,
+        size_t total,
+        const ComparisonProgressCallback& progress_callback)
+    {
+        auto full_path = [](const core::Path& root, const ComparisonItem& item)
+        {
+            return core::Path(root.String() + "/" + item.relative_path);
+        };
 
-        char buffer[8192];
-        while (file.read(buffer, sizeof(buffer)) || file.gcount() > 0)
+        // Carries on from where the walk left the progress bar
+        double walk_share = WalkShare(result.options);
+        size_t compared = 0;
+        auto report = [&](const std::string& current_file)
         {
-            for (std::streamsize i = 0; i < file.gcount(); ++i)
+            ++processed;
+            ++compared;
+            if (progress_callback)
             {
-                hash ^= static_cast<uint8_t>(buffer[i]);
-                hash *= prime;
+                ComparisonProgress progress;
+                progress.files_processed = processed;
+                progress.total_files = total;
+                progress.current_file = current_file;
+                progress.percentage = walk_share +
+                    (100.0 - walk_share) * static_cast<double>(compared) / deferred.size();
+                progress_callback(progress);
+            }
+        };
+
+        if (result.options.mode == ComparisonMode::Hash)
+        {
+            // Each side is its own job, so a pair's two files hash at once
+            std::vector<core::FileHashJob> jobs;
+            jobs.reserve(2 * deferred.size());
+            for (size_t index : deferred)
+            {
+                const ComparisonItem& item = result.items[index];
+                jobs.emplace_back().path = full_path(result.left_root, item);
+                jobs.emplace_back().path = full_path(result.right_root, item);
             }
+
+            std::vector<bool> halves(deferred.size(), false);
+            core::FileHasher::HashFiles(jobs, 0, &cancel_requested_, [&](const core::FileHashJob& job)
+            {
+                // A pair counts as processed once both of its files are
+                size_t pair = static_cast<size_t>(&job - jobs.data()) / 2;
+                if (halves[pair])
+                    report(result.items[deferred[pair]].relative_path);
+                halves[pair] = true;
+            }, hash_cache_.get());
+
+            if (hash_cache_)
+                hash_cache_->Flush();
+
+            for (size_t i = 0; i < deferred.size(); ++i)
+            {
+                ComparisonItem& item = result.items[deferred[i]];
+                const core::FileHashJob& left = jobs[2 * i];
+                const core::FileHashJob& right = jobs[2 * i + 1];
+                if (left.success && right.success)
+                {
+                    item.left_hash = left.hash;
+                    item.right_hash = right.hash;
+                    item.status = left.hash == right.hash ? ComparisonStatus::Identical : ComparisonStatus::Different;
+                }
+                else
+                {
+                    item.status = ComparisonStatus::Error;
+                    item.error_message = cancel_requested_.load()
+                        ? "Comparison cancelled" : "Failed to read files for hashing";
+                }
+                CountFile(item, result.stats);
+            }
+            return;
         }
 
-        std::ostringstream ss;
-        ss << std::hex << std::setfill('0') << std::setw(16) << hash;
-        return ss.str();
+        for (size_t index : deferred)
+        {
+            ComparisonItem& item = result.items[index];
+            item.status = ComparisonStatus::Error;
+            item.error_message = "Comparison cancelled";
+        }
+
+        unsigned thread_count = std::min(core::FileHasher::kMaxThreads, std::max(1u, std::thread::hardware_concurrency()));
+        thread_count = static_cast<unsigned>(std::min<size_t>(thread_count, deferred.size()));
+
+        std::atomic<size_t> next{0};
+        std::mutex report_mutex;
+        auto worker = [&]()
+        {
+            for (size_t index; (index = next.fetch_add(1)) < deferred.size();)
+            {
+                if (cancel_requested_.load())
+                    return;
+
+                ComparisonItem& item = result.items[deferred[index]];
+                item.error_message.clear();
+                item.status = CompareContent(full_path(result.left_root, item), full_path(result.right_root, item), item);
+
+                std::lock_guard<std::mutex> lock(report_mutex);
+                report(item.relative_path);
+            }
+        };
+
+        // This thread compares too, with pool tasks helping while they can
+        core::TaskGroup helpers;
+        if (thread_count > 1)
+            helpers.Spawn(thread_count - 1, worker);
+        worker();
+        helpers.Close();
+
+        for (size_t index : deferred)
+        {
+            CountFile(result.items[index], result.stats);
+        }
+    }
+
+    void FolderComparison::CountFile(const ComparisonItem& item, ComparisonStats& stats)
+    {
+        if (item.status == ComparisonStatus::Identical)
+        {
+            ++stats.identical_files;
+        }
+        else if (item.status == ComparisonStatus::Different)
+        {
+            ++stats.different_files;
+            stats.different_size += std::max(item.left_size, item.right_size);
+        }
+        else if (item.status == ComparisonStatus::Error)
+        {
+            ++stats.errors;
+        }
+    }
+
+    std::string FolderComparison::CalculateHash(const core::Path& path) const
+    {
+        std::string hash;
+        bool hashed = hash_cache_ ? hash_cache_->HashFile(path, hash, &cancel_requested_)
+                                  : core::FileHasher::HashFile(path, hash, &cancel_requested_);
+        return hashed ? hash : "";
     }
 
     bool FolderComparison::MatchesPatterns(
@@ -2,6 +2,7 @@
 #include "opacity/core/Logger.h"
 
 #include <algorithm>
+#include <atomic>
 #include <map>
 #include <mutex>
 #include <fstream>
@@ -18,6 +19,63 @@ namespace opacity::filesystem
 {
     using namespace opacity::core;
 
+    namespace
+    {
+        // Cloud files API attributes (may not be defined in older SDKs)
+        constexpr uint32_t ATTR_REPARSE_POINT = 0x00000400;
+        constexpr uint32_t ATTR_OFFLINE = 0x00001000;
+        constexpr uint32_t ATTR_RECALL_ON_OPEN = 0x00040000;
+        constexpr uint32_t ATTR_PINNED = 0x00080000;
+        constexpr uint32_t ATTR_UNPINNED = 0x00100000;
+        constexpr uint32_t ATTR_RECALL_ON_DATA_ACCESS = 0x00400000;
+
+        std::atomic<bool> hydrationAllowed{false};
+
+        bool IsOneDrive(CloudProvider provider)
+        {
+            return provider == CloudProvider::OneDrive || provider == CloudProvider::OneDriveBusiness;
+        }
+
+        // Placeholder state as the cloud files API exposes it in the
+        // attributes; the same bits come back from FindFirstFile
+        CloudSyncStatus PlaceholderStatus(uint32_t attributes)
+        {
+            // Check if it's a placeholder (online-only)
+            if (attributes & ATTR_RECALL_ON_OPEN ||
+                attributes & ATTR_RECALL_ON_DATA_ACCESS) {
+                return CloudSyncStatus::OnlineOnly;
+            }
+
+            // Check pinned status
+            if (attributes & ATTR_PINNED) {
+                return CloudSyncStatus::AlwaysAvailable;
+            }
+
+            if (attributes & ATTR_UNPINNED) {
+                return CloudSyncStatus::OnlineOnly;
+            }
+
+            // Check offline attribute
+            if (attributes & ATTR_OFFLINE) {
+                return CloudSyncStatus::OnlineOnly;
+            }
+
+            // If reparse point but not offline, it might be syncing
+            if (attributes & ATTR_REPARSE_POINT) {
+                return CloudSyncStatus::Syncing;
+            }
+
+            return CloudSyncStatus::Synced;
+        }
+
+        // Status of an item known to exist, from its attributes
+        CloudSyncStatus StatusFromAttributes(CloudProvider provider, uint32_t attributes)
+        {
+            // Other providers only tell us the file is there locally
+            return IsOneDrive(provider) ? PlaceholderStatus(attributes) : CloudSyncStatus::Synced;
+        }
+    }
+
     class CloudIntegration::Impl
     {
     public:
@@ -205,38 +263,7 @@ namespace opacity::filesystem
                 return CloudSyncStatus::Unknown;
             }
 
-            // Cloud files API attributes (may not be defined in older SDKs)
-            constexpr DWORD ATTR_RECALL_ON_OPEN = 0x00040000;
-            constexpr DWORD ATTR_RECALL_ON_DATA_ACCESS = 0x00400000;
-            constexpr DWORD ATTR_PINNED = 0x00080000;
-            constexpr DWORD ATTR_UNPINNED = 0x00100000;
-
-            // Check if it's a placeholder (online-only)
-            if (attributes & ATTR_RECALL_ON_OPEN ||
-                attributes & ATTR_RECALL_ON_DATA_ACCESS) {
-                return CloudSyncStatus::OnlineOnly;
-            }
-
-            // Check pinned status
-            if (attributes & ATTR_PINNED) {
-                return CloudSyncStatus::AlwaysAvailable;
-            }
-
-            if (attributes & ATTR_UNPINNED) {
-                return CloudSyncStatus::OnlineOnly;
-            }
-
-            // Check offline attribute
-            if (attributes & FILE_ATTRIBUTE_OFFLINE) {
-                return CloudSyncStatus::OnlineOnly;
-            }
-
-            // If reparse point but not offline, it might be syncing
-            if (attributes & FILE_ATTRIBUTE_REPARSE_POINT) {
-                return CloudSyncStatus::Syncing;
-            }
-
-            return CloudSyncStatus::Synced;
+            return PlaceholderStatus(attributes);
         }
 #endif
     };
@@ -426,8 +453,7 @@ namespace opacity::filesystem
         }
 
 #ifdef _WIN32
-        if (*provider == CloudProvider::OneDrive || 
-            *provider == CloudProvider::OneDriveBusiness) {
+        if (IsOneDrive(*provider)) {
             return impl_->GetOneDriveFileStatus(path);
         }
 #endif
@@ -441,6 +467,31 @@ namespace opacity::filesystem
         return CloudSyncStatus::Unknown;
     }
 
+    CloudSyncStatus CloudIntegration::GetSyncStatus(const FsItem& item)
+    {
+        auto provider = GetCloudProvider(item.full_path.Get());
+        if (!provider) {
+            return CloudSyncStatus::Unknown;
+        }
+        return StatusFromAttributes(*provider, item.attributes);
+    }
+
+    std::vector<CloudSyncStatus> CloudIntegration::GetSyncStatuses(const ItemStore& listing)
+    {
+        std::vector<CloudSyncStatus> statuses(listing.Count(), CloudSyncStatus::Unknown);
+
+        // Everything in a listing shares its directory's provider
+        auto provider = GetCloudProvider(listing.GetDirectory());
+        if (!provider) {
+            return statuses;
+        }
+
+        for (ItemStore::Index i = 0; i < listing.Count(); ++i) {
+            statuses[i] = StatusFromAttributes(*provider, listing.Attributes(i));
+        }
+        return statuses;
+    }
+
     CloudFileInfo CloudIntegration::GetCloudFileInfo(const std::filesystem::path& path)
     {
         CloudFileInfo info;
@@ -476,6 +527,47 @@ namespace opacity::filesystem
         return {};
     }
 
+    // ============== Hydration Policy ==============
+
+    bool CloudIntegration::IsPlaceholder(uint32_t attributes)
+    {
+        // Pinned or unpinned alone says nothing about whether the data is
+        // local; only these make a read go to the provider
+        return (attributes & (ATTR_RECALL_ON_OPEN | ATTR_RECALL_ON_DATA_ACCESS | ATTR_OFFLINE)) != 0;
+    }
+
+    bool CloudIntegration::IsPlaceholder(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        DWORD attributes = GetFileAttributesW(path.wstring().c_str());
+        return attributes != INVALID_FILE_ATTRIBUTES && IsPlaceholder(static_cast<uint32_t>(attributes));
+#else
+        (void)path;
+        return false;
+#endif
+    }
+
+    void CloudIntegration::SetHydrationAllowed(bool allowed)
+    {
+        hydrationAllowed.store(allowed, std::memory_order_relaxed);
+    }
+
+    bool CloudIntegration::IsHydrationAllowed()
+    {
+        return hydrationAllowed.load(std::memory_order_relaxed);
+    }
+
+    bool CloudIntegration::ShouldSkipRead(uint32_t attributes, bool requested)
+    {
+        return !requested && !IsHydrationAllowed() && IsPlaceholder(attributes);
+    }
+
+    bool CloudIntegration::ShouldSkipRead(const std::filesystem::path& path, bool requested)
+    {
+        // Check the policy first so an allowed read costs no syscall
+        return !requested && !IsHydrationAllowed() && IsPlaceholder(path);
+    }
+
     // ============== OneDrive Specific ==============
 
     bool CloudIntegration::IsOneDriveInstalled()
@@ -0,0 +1,782 @@
+#include "opacity/filesystem/CopyEngine.h"
+#include "opacity/filesystem/StorageTopology.h"
+#include "opacity/core/FileHasher.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <winioctl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace opacity::filesystem
+{
+    namespace
+    {
+        // Unbuffered transfers must be sector-aligned in offset, length and
+        // memory; 4KB covers current disks, and VirtualAlloc hands out pages
+        constexpr uint64_t kSectorAlignment = 4096;
+
+        // CopyFileEx handles these itself (EFS keys, sparse ranges,
+        // compression state); a raw stream copy would lose them
+        constexpr DWORD kBufferedOnlyAttributes = FILE_ATTRIBUTE_ENCRYPTED |
+                                                  FILE_ATTRIBUTE_SPARSE_FILE |
+                                                  FILE_ATTRIBUTE_COMPRESSED;
+
+        // Cloned per FSCTL_DUPLICATE_EXTENTS_TO_FILE call; well under the
+        // 4GB limit and a multiple of every cluster size
+        constexpr uint64_t kCloneChunk = 1ull << 30;
+
+        // Smaller files are dominated by opening and closing, not transfer
+        constexpr uint64_t kMinThroughputSample = 1024 * 1024;
+
+        // The series one device's copies are counted in
+        struct DeviceSeries
+        {
+            core::Counter* ok = nullptr;
+            core::Counter* cancelled = nullptr;
+            core::Counter* failed = nullptr;
+            core::Counter* bytes = nullptr;
+            core::Histogram* throughput = nullptr;
+        };
+
+        // Series outlive the registry's lookups, so each copying thread
+        // finds a device's once rather than for every file
+        const DeviceSeries& SeriesFor(const std::string& device)
+        {
+            thread_local std::unordered_map<std::string, DeviceSeries> cache;
+            auto it = cache.find(device);
+            if (it != cache.end())
+                return it->second;
+
+            auto& metrics = core::Metrics::Get();
+            DeviceSeries series;
+            series.ok = &metrics.GetCounter("opacity_copy_files_total", {{"device", device}, {"result", "ok"}});
+            series.cancelled = &metrics.GetCounter("opacity_copy_files_total", {{"device", device}, {"result", "cancelled"}});
+            series.failed = &metrics.GetCounter("opacity_copy_files_total", {{"device", device}, {"result", "failed"}});
+            series.bytes = &metrics.GetCounter("opacity_copy_bytes_total", {{"device", device}});
+            series.throughput = &metrics.GetHistogram("opacity_copy_throughput_kibps", {{"device", device}});
+            return cache.emplace(device, series).first->second;
+        }
+
+        uint64_t AlignUp(uint64_t value, uint64_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+
+        std::string ErrorText(const std::string& what, DWORD error)
+        {
+            std::string message = what;
+
+            char* buffer = nullptr;
+            FormatMessageA(
+                FORMAT_MESSAGE_ALLOCATE_BUFFER | FORMAT_MESSAGE_FROM_SYSTEM | FORMAT_MESSAGE_IGNORE_INSERTS,
+                nullptr, error, 0, reinterpret_cast<LPSTR>(&buffer), 0, nullptr);
+
+            if (buffer)
+            {
+                std::string text = buffer;
+                LocalFree(buffer);
+                while (!text.empty() && (text.back() == '\r' || text.back() == '\n' || text.back() == ' '))
+                {
+                    text.pop_back();
+                }
+                message += ": " + text;
+            }
+            else
+            {
+                message += " (error " + std::to_string(error) + ")";
+            }
+            return message;
+        }
+
+        struct FileHandle
+        {
+            HANDLE handle = INVALID_HANDLE_VALUE;
+
+            ~FileHandle() { Close(); }
+
+            bool Valid() const { return handle != INVALID_HANDLE_VALUE; }
+
+            void Close()
+            {
+                if (Valid())
+                {
+                    CloseHandle(handle);
+                    handle = INVALID_HANDLE_VALUE;
+                }
+            }
+        };
+
+        // One half of the double buffer: aligned memory plus the overlapped
+        // read or write that currently owns it
+        struct TransferBuffer
+        {
+            void* data = nullptr;
+            OVERLAPPED overlapped{};
+            HANDLE file = INVALID_HANDLE_VALUE;
+            bool pending = false;
+
+            explicit TransferBuffer(size_t size)
+                : data(VirtualAlloc(nullptr, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE))
+            {
+                overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+            }
+
+            ~TransferBuffer()
+            {
+                Cancel();
+                if (data)
+                {
+                    VirtualFree(data, 0, MEM_RELEASE);
+                }
+                if (overlapped.hEvent)
+                {
+                    CloseHandle(overlapped.hEvent);
+                }
+            }
+
+            TransferBuffer(const TransferBuffer&) = delete;
+            TransferBuffer& operator=(const TransferBuffer&) = delete;
+
+            bool Valid() const { return data != nullptr && overlapped.hEvent != nullptr; }
+
+            bool Start(bool write, HANDLE target, uint64_t offset, DWORD length)
+            {
+                overlapped.Offset = static_cast<DWORD>(offset);
+                overlapped.OffsetHigh = static_cast<DWORD>(offset >> 32);
+
+                BOOL ok = write ? WriteFile(target, data, length, nullptr, &overlapped)
+                                : ReadFile(target, data, length, nullptr, &overlapped);
+                if (!ok && GetLastError() != ERROR_IO_PENDING)
+                {
+                    return false;
+                }
+
+                file = target;
+                pending = true;
+                return true;
+            }
+
+            // Wait for the pending operation; GetLastError() has the reason on failure
+            bool Finish(DWORD& bytes)
+            {
+                pending = false;
+                bytes = 0;
+                return GetOverlappedResult(file, &overlapped, &bytes, TRUE) != FALSE;
+            }
+
+            void Cancel()
+            {
+                if (pending)
+                {
+                    DWORD bytes = 0;
+                    CancelIoEx(file, &overlapped);
+                    GetOverlappedResult(file, &overlapped, &bytes, TRUE);
+                    pending = false;
+                }
+            }
+        };
+
+        struct ProgressContext
+        {
+            const CopyEngine::ProgressCallback* progress = nullptr;
+            uint64_t copied = 0;
+        };
+
+        DWORD CALLBACK CopyProgressRoutine(LARGE_INTEGER total_size, LARGE_INTEGER transferred,
+                                           LARGE_INTEGER, LARGE_INTEGER, DWORD, DWORD,
+                                           HANDLE, HANDLE, LPVOID data)
+        {
+            auto* context = static_cast<ProgressContext*>(data);
+            context->copied = static_cast<uint64_t>(transferred.QuadPart);
+
+            if (*context->progress &&
+                !(*context->progress)(context->copied, static_cast<uint64_t>(total_size.QuadPart)))
+            {
+                return PROGRESS_CANCEL;
+            }
+            return PROGRESS_CONTINUE;
+        }
+    }
+
+    CopyEngine::CopyEngine(const CopyEngineConfig& config)
+        : config_(config)
+    {
+    }
+
+    CopyResult CopyEngine::Copy(const core::Path& source, const core::Path& dest,
+                                const ProgressCallback& progress) const
+    {
+        return Copy(source, dest, CopyOptions{}, progress);
+    }
+
+    CopyResult CopyEngine::Copy(const core::Path& source, const core::Path& dest, const CopyOptions& options,
+                                const ProgressCallback& progress) const
+    {
+        auto started = std::chrono::steady_clock::now();
+
+        // Counted by the device written to, which is what limits a copy
+        auto done = [&](CopyResult result)
+        {
+            const DeviceSeries& series = SeriesFor(StorageTopology::GetVolumeProfile(dest).device);
+            (result.success ? series.ok : result.cancelled ? series.cancelled : series.failed)->Add();
+
+            uint64_t bytes = result.bytes_copied - std::min(result.bytes_copied, options.resume_offset);
+            series.bytes->Add(bytes);
+
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - started;
+            if (result.success && bytes >= kMinThroughputSample && elapsed.count() > 0.0)
+            {
+                series.throughput->Record(static_cast<uint64_t>(static_cast<double>(bytes) / 1024.0 / elapsed.count()));
+            }
+            return result;
+        };
+
+        WIN32_FILE_ATTRIBUTE_DATA data;
+        if (!GetFileAttributesExW(source.WString().c_str(), GetFileExInfoStandard, &data))
+        {
+            CopyResult result;
+            result.error_message = ErrorText("Cannot read " + source.String(), GetLastError());
+            return done(result);
+        }
+
+        uint64_t size = (static_cast<uint64_t>(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+
+        // Hashing needs the data to pass through this process, and only
+        // the streamed path can checkpoint or resume
+        bool streamed = options.hash || options.resume_offset > 0 || options.checkpoint;
+
+        // Fills in the hash for the paths that never see the data
+        auto finish = [&](CopyResult result, const core::Path& hashed)
+        {
+            if (result.success && options.hash && !HashFile(hashed, result.hash))
+            {
+                result.success = false;
+                result.error_message = ErrorText("Failed to read " + hashed.String(), GetLastError());
+            }
+            return result;
+        };
+
+        // On ReFS a copy within the volume only needs new references to
+        // the same clusters, whatever the file's size
+        VolumeProfile source_volume = StorageTopology::GetVolumeProfile(source);
+        if (size > 0 && options.resume_offset == 0 && source_volume.block_clone && source_volume.cluster_size != 0 &&
+            (data.dwFileAttributes & FILE_ATTRIBUTE_ENCRYPTED) == 0 &&
+            StorageTopology::SameVolume(source_volume, StorageTopology::GetVolumeProfile(dest)))
+        {
+            CopyResult result = CopyCloned(source, dest, size, source_volume.cluster_size, progress);
+            if (result.success || result.cancelled || result.bytes_copied > 0)
+                return done(finish(result, source));
+
+            // Mismatched integrity streams and the like; copy the data instead
+            SPDLOG_DEBUG("Block clone of {} failed ({}), copying", source.String(), result.error_message);
+        }
+
+        if ((size >= config_.unbuffered_threshold || (streamed && size > 0)) &&
+            (data.dwFileAttributes & kBufferedOnlyAttributes) == 0)
+        {
+            CopyResult result = CopyUnbuffered(source, dest, size, options, progress);
+
+            // Some redirectors and filters refuse unbuffered handles; nothing
+            // was written yet, so the regular path can still do the copy
+            if (result.success || result.cancelled || result.bytes_copied > 0)
+                return done(result);
+
+            SPDLOG_DEBUG("Unbuffered copy of {} failed ({}), retrying buffered", source.String(), result.error_message);
+        }
+
+        // Encrypted, sparse and compressed files are hashed from the copy
+        return done(finish(CopyBuffered(source, dest, progress), dest));
+    }
+
+    CopyResult CopyEngine::Update(const core::Path& source, const core::Path& dest,
+                                  const ProgressCallback& progress) const
+    {
+        CopyResult result;
+
+        std::wstring source_name = source.WString();
+        std::wstring dest_name = dest.WString();
+
+        FileHandle input;
+        FileHandle output;
+
+        input.handle = CreateFileW(source_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                   FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (!input.Valid())
+        {
+            result.error_message = ErrorText("Cannot open " + source.String(), GetLastError());
+            return result;
+        }
+
+        BY_HANDLE_FILE_INFORMATION info;
+        if (!GetFileInformationByHandle(input.handle, &info))
+        {
+            result.error_message = ErrorText("Cannot read " + source.String(), GetLastError());
+            return result;
+        }
+        uint64_t size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+
+        output.handle = CreateFileW(dest_name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (!output.Valid())
+        {
+            result.error_message = ErrorText("Cannot open " + dest.String(), GetLastError());
+            return result;
+        }
+
+        LARGE_INTEGER existing_size{};
+        FILETIME dest_created, dest_accessed, dest_modified;
+        if (!GetFileSizeEx(output.handle, &existing_size) ||
+            !GetFileTime(output.handle, &dest_created, &dest_accessed, &dest_modified))
+        {
+            result.error_message = ErrorText("Cannot read " + dest.String(), GetLastError());
+            return result;
+        }
+        auto dest_size = static_cast<uint64_t>(existing_size.QuadPart);
+
+        // Each side reads into its own pair of buffers; a block that differs
+        // is written from the source buffer it was read into
+        auto block = static_cast<DWORD>(std::max<size_t>(config_.update_block_size, 64 * 1024));
+        block = static_cast<DWORD>(std::min<uint64_t>(block, std::max<uint64_t>(size, 1)));
+        TransferBuffer sources[2] = {TransferBuffer(block), TransferBuffer(block)};
+        TransferBuffer dests[2] = {TransferBuffer(block), TransferBuffer(block)};
+
+        // Writes so far must not make dest look newer than it is
+        auto abandon = [&]()
+        {
+            for (auto& buffer : sources)
+                buffer.Cancel();
+            for (auto& buffer : dests)
+                buffer.Cancel();
+            SetFileTime(output.handle, nullptr, nullptr, &dest_modified);
+            output.Close();
+        };
+
+        auto fail = [&](const std::string& what)
+        {
+            result.error_message = ErrorText(what, GetLastError());
+            abandon();
+            return result;
+        };
+
+        if (!sources[0].Valid() || !sources[1].Valid() || !dests[0].Valid() || !dests[1].Valid())
+            return fail("Cannot allocate copy buffers");
+
+        auto start_reads = [&](int pair, uint64_t offset)
+        {
+            auto length = static_cast<DWORD>(std::min<uint64_t>(block, size - offset));
+            if (!sources[pair].Start(false, input.handle, offset, length))
+                return false;
+
+            // Past the end of dest there is nothing to compare against
+            if (offset >= dest_size)
+                return true;
+            auto existing = static_cast<DWORD>(std::min<uint64_t>(length, dest_size - offset));
+            return dests[pair].Start(false, output.handle, offset, existing);
+        };
+
+        uint64_t offset = 0;
+        int current = 0;
+        if (size > 0 && !start_reads(current, offset))
+            return fail("Failed to read " + source.String());
+
+        while (offset < size)
+        {
+            TransferBuffer& source_buffer = sources[current];
+            TransferBuffer& dest_buffer = dests[current];
+            TransferBuffer& other = sources[current ^ 1];
+
+            DWORD read = 0;
+            if (!source_buffer.Finish(read) && GetLastError() != ERROR_HANDLE_EOF)
+                return fail("Failed to read " + source.String());
+
+            DWORD existing = 0;
+            if (dest_buffer.pending && !dest_buffer.Finish(existing) && GetLastError() != ERROR_HANDLE_EOF)
+                return fail("Failed to read " + dest.String());
+
+            // The last block's write came from the buffer about to be read into
+            DWORD written = 0;
+            if (other.pending && !other.Finish(written))
+                return fail("Failed to write " + dest.String());
+
+            // A short read is the end of the file, even if it shrank meanwhile
+            uint64_t expected = std::min<uint64_t>(block, size - offset);
+            bool more = read == expected && offset + read < size;
+            if (more && !start_reads(current ^ 1, offset + read))
+                return fail("Failed to read " + source.String());
+
+            if (read == 0)
+                break;
+
+            if (existing != read || std::memcmp(source_buffer.data, dest_buffer.data, read) != 0)
+            {
+                if (!source_buffer.Start(true, output.handle, offset, read))
+                    return fail("Failed to write " + dest.String());
+                result.bytes_written += read;
+            }
+
+            offset += read;
+            result.bytes_copied = offset;
+            if (progress && !progress(result.bytes_copied, size))
+            {
+                result.cancelled = true;
+                abandon();
+                return result;
+            }
+
+            if (!more)
+                break;
+            current ^= 1;
+        }
+
+        for (auto& buffer : sources)
+        {
+            DWORD written = 0;
+            if (buffer.pending && !buffer.Finish(written))
+                return fail("Failed to write " + dest.String());
+        }
+
+        if (offset != dest_size)
+        {
+            FILE_END_OF_FILE_INFO end_of_file{};
+            end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(offset);
+            if (!SetFileInformationByHandle(output.handle, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)))
+                return fail("Failed to finish " + dest.String());
+        }
+
+        SetFileTime(output.handle, &info.ftCreationTime, &info.ftLastAccessTime, &info.ftLastWriteTime);
+        output.Close();
+        SetFileAttributesW(dest_name.c_str(), info.dwFileAttributes);
+
+        result.success = true;
+        return result;
+    }
+
+    bool CopyEngine::HashFile(const core::Path& path, std::string& hash) const
+    {
+        return core::FileHasher::HashFile(path, hash);
+    }
+
+    CopyResult CopyEngine::CopyBuffered(const core::Path& source, const core::Path& dest,
+                                        const ProgressCallback& progress) const
+    {
+        CopyResult result;
+
+        ProgressContext context;
+        context.progress = &progress;
+
+        // CopyFileEx removes the destination itself when cancelled or failed
+        if (CopyFileExW(source.WString().c_str(), dest.WString().c_str(),
+                        CopyProgressRoutine, &context, nullptr, 0))
+        {
+            result.success = true;
+            result.bytes_copied = context.copied;
+            return result;
+        }
+
+        DWORD error = GetLastError();
+        result.bytes_copied = context.copied;
+        if (error == ERROR_REQUEST_ABORTED)
+        {
+            result.cancelled = true;
+        }
+        else
+        {
+            result.error_message = ErrorText("Failed to copy " + source.String(), error);
+        }
+        return result;
+    }
+
+    CopyResult CopyEngine::CopyCloned(const core::Path& source, const core::Path& dest, uint64_t size,
+                                      uint32_t cluster_size, const ProgressCallback& progress) const
+    {
+        CopyResult result;
+
+        std::wstring source_name = source.WString();
+        std::wstring dest_name = dest.WString();
+
+        FileHandle input;
+        FileHandle output;
+
+        input.handle = CreateFileW(source_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, 0, nullptr);
+        if (!input.Valid())
+        {
+            result.error_message = ErrorText("Cannot open " + source.String(), GetLastError());
+            return result;
+        }
+
+        BY_HANDLE_FILE_INFORMATION info;
+        if (!GetFileInformationByHandle(input.handle, &info))
+        {
+            result.error_message = ErrorText("Cannot read " + source.String(), GetLastError());
+            return result;
+        }
+
+        output.handle = CreateFileW(dest_name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (!output.Valid())
+        {
+            result.error_message = ErrorText("Cannot create " + dest.String(), GetLastError());
+            return result;
+        }
+
+        auto fail = [&](const std::string& what)
+        {
+            result.error_message = ErrorText(what, GetLastError());
+            output.Close();
+            DeleteFileW(dest_name.c_str());
+            return result;
+        };
+
+        // The target must match the source's sparseness and already be long
+        // enough to hold the cloned range
+        DWORD returned = 0;
+        if ((info.dwFileAttributes & FILE_ATTRIBUTE_SPARSE_FILE) &&
+            !DeviceIoControl(output.handle, FSCTL_SET_SPARSE, nullptr, 0, nullptr, 0, &returned, nullptr))
+            return fail("Failed to prepare " + dest.String());
+
+        FILE_END_OF_FILE_INFO end_of_file{};
+        end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(size);
+        if (!SetFileInformationByHandle(output.handle, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)))
+            return fail("Failed to prepare " + dest.String());
+
+        // Ranges are whole clusters; the last one may run past the end of file
+        uint64_t cloned_size = AlignUp(size, cluster_size);
+        for (uint64_t offset = 0; offset < cloned_size; offset += kCloneChunk)
+        {
+            DUPLICATE_EXTENTS_DATA extents{};
+            extents.FileHandle = input.handle;
+            extents.SourceFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            extents.TargetFileOffset.QuadPart = static_cast<LONGLONG>(offset);
+            extents.ByteCount.QuadPart = static_cast<LONGLONG>(std::min(kCloneChunk, cloned_size - offset));
+
+            if (!DeviceIoControl(output.handle, FSCTL_DUPLICATE_EXTENTS_TO_FILE, &extents, sizeof(extents),
+                                 nullptr, 0, &returned, nullptr))
+                return fail("Failed to clone " + source.String());
+
+            result.bytes_copied = std::min(size, offset + kCloneChunk);
+            if (progress && !progress(result.bytes_copied, size))
+            {
+                result.cancelled = true;
+                output.Close();
+                DeleteFileW(dest_name.c_str());
+                return result;
+            }
+        }
+
+        SetFileTime(output.handle, &info.ftCreationTime, &info.ftLastAccessTime, &info.ftLastWriteTime);
+        output.Close();
+        SetFileAttributesW(dest_name.c_str(), info.dwFileAttributes);
+
+        result.success = true;
+        return result;
+    }
+
+    CopyResult CopyEngine::CopyUnbuffered(const core::Path& source, const core::Path& dest, uint64_t size,
+                                          const CopyOptions& options, const ProgressCallback& progress) const
+    {
+        CopyResult result;
+
+        std::wstring source_name = source.WString();
+        std::wstring dest_name = dest.WString();
+        DWORD attributes = GetFileAttributesW(source_name.c_str());
+
+        // Handles are declared before the buffers so pending I/O is always
+        // cancelled before the handles it runs on are closed
+        FileHandle input;
+        FileHandle output;
+
+        input.handle = CreateFileW(source_name.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                   FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED | FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+        if (!input.Valid())
+        {
+            result.error_message = ErrorText("Cannot open " + source.String(), GetLastError());
+            return result;
+        }
+
+        // A checkpoint is only trusted if it is sector-aligned, inside the
+        // source, matches its hash state and dest really holds that much
+        core::Xxh64 hasher;
+        uint64_t start = options.resume_offset;
+        if (start > 0 && (start >= size || start % kSectorAlignment != 0 ||
+                          (options.hash && (!hasher.LoadState(options.resume_state) || hasher.Length() != start))))
+        {
+            SPDLOG_DEBUG("Checkpoint for {} at {} no longer fits, copying from the start", dest.String(), start);
+            start = 0;
+            hasher = core::Xxh64();
+        }
+
+        DWORD write_flags = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_NO_BUFFERING | FILE_FLAG_OVERLAPPED;
+        if (start > 0)
+        {
+            output.handle = CreateFileW(dest_name.c_str(), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, write_flags, nullptr);
+
+            LARGE_INTEGER existing{};
+            if (!output.Valid() || !GetFileSizeEx(output.handle, &existing) ||
+                static_cast<uint64_t>(existing.QuadPart) < start)
+            {
+                SPDLOG_DEBUG("{} is shorter than its checkpoint, copying from the start", dest.String());
+                output.Close();
+                start = 0;
+                hasher = core::Xxh64();
+            }
+        }
+        if (!output.Valid())
+        {
+            output.handle = CreateFileW(dest_name.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, write_flags, nullptr);
+        }
+        if (!output.Valid())
+        {
+            result.error_message = ErrorText("Cannot create " + dest.String(), GetLastError());
+            return result;
+        }
+
+        // Reserve the clusters up front so the file is laid out in one piece
+        FILE_ALLOCATION_INFO allocation{};
+        allocation.AllocationSize.QuadPart = static_cast<LONGLONG>(AlignUp(size, kSectorAlignment));
+        SetFileInformationByHandle(output.handle, FileAllocationInfo, &allocation, sizeof(allocation));
+
+        // Small files streamed for their hash get buffers to match
+        auto chunk = static_cast<DWORD>(AlignUp(std::max<uint64_t>(config_.buffer_size, kSectorAlignment), kSectorAlignment));
+        chunk = static_cast<DWORD>(std::min<uint64_t>(chunk, AlignUp(size - start, kSectorAlignment)));
+        TransferBuffer buffers[2] = {TransferBuffer(chunk), TransferBuffer(chunk)};
+
+        uint64_t durable = start;       // Everything before this is flushed and was checkpointed
+
+        auto discard = [&]()
+        {
+            buffers[0].Cancel();
+            buffers[1].Cancel();
+            output.Close();
+            DeleteFileW(dest_name.c_str());
+        };
+
+        auto fail = [&](const std::string& what)
+        {
+            result.error_message = ErrorText(what, GetLastError());
+            if (options.checkpoint && durable > 0)
+            {
+                // The caller recorded a checkpoint and can pick up from it
+                buffers[0].Cancel();
+                buffers[1].Cancel();
+                output.Close();
+            }
+            else
+            {
+                discard();
+            }
+            return result;
+        };
+
+        if (!buffers[0].Valid() || !buffers[1].Valid())
+            return fail("Cannot allocate copy buffers");
+
+        // Reads fill one buffer while the other is being written out
+        uint64_t offset = start;
+        result.bytes_copied = start;
+        int current = 0;
+        if (!buffers[current].Start(false, input.handle, offset, chunk))
+            return fail("Failed to read " + source.String());
+
+        while (true)
+        {
+            TransferBuffer& buffer = buffers[current];
+            TransferBuffer& other = buffers[current ^ 1];
+
+            DWORD read = 0;
+            if (!buffer.Finish(read) && GetLastError() != ERROR_HANDLE_EOF)
+                return fail("Failed to read " + source.String());
+
+            DWORD written = 0;
+            if (other.pending && !other.Finish(written))
+                return fail("Failed to write " + dest.String());
+
+            // Everything before offset is written and hashed here
+            if (options.checkpoint && offset - durable >= options.checkpoint_interval)
+            {
+                if (!FlushFileBuffers(output.handle))
+                    return fail("Failed to write " + dest.String());
+                durable = offset;
+                options.checkpoint(durable, options.hash ? hasher.SaveState() : std::string());
+            }
+
+            // A short read is the end of the file, even if it shrank meanwhile
+            bool more = read == chunk && offset + chunk < size;
+            if (more && !other.Start(false, input.handle, offset + chunk, chunk))
+                return fail("Failed to read " + source.String());
+
+            if (read > 0)
+            {
+                // Hashed while the other buffer's read is in flight
+                if (options.hash)
+                {
+                    hasher.Update(buffer.data, read);
+                }
+
+                // The tail goes out padded to a whole sector; the end of file
+                // is trimmed back once everything is written
+                auto length = static_cast<DWORD>(AlignUp(read, kSectorAlignment));
+                if (length > read)
+                {
+                    std::memset(static_cast<char*>(buffer.data) + read, 0, length - read);
+                }
+
+                if (!buffer.Start(true, output.handle, offset, length))
+                    return fail("Failed to write " + dest.String());
+
+                result.bytes_copied += read;
+                if (progress && !progress(result.bytes_copied, size))
+                {
+                    result.cancelled = true;
+                    discard();
+                    return result;
+                }
+            }
+
+            if (!more)
+            {
+                if (buffer.pending && !buffer.Finish(written))
+                    return fail("Failed to write " + dest.String());
+                break;
+            }
+
+            offset += chunk;
+            current ^= 1;
+        }
+
+        FILE_END_OF_FILE_INFO end_of_file{};
+        end_of_file.EndOfFile.QuadPart = static_cast<LONGLONG>(result.bytes_copied);
+        if (!SetFileInformationByHandle(output.handle, FileEndOfFileInfo, &end_of_file, sizeof(end_of_file)))
+            return fail("Failed to finish " + dest.String());
+
+        FILETIME created, accessed, modified;
+        if (GetFileTime(input.handle, &created, &accessed, &modified))
+        {
+            SetFileTime(output.handle, &created, &accessed, &modified);
+        }
+
+        output.Close();
+        if (attributes != INVALID_FILE_ATTRIBUTES)
+        {
+            SetFileAttributesW(dest_name.c_str(), attributes);
+        }
+
+        if (options.hash)
+        {
+            result.hash = hasher.HexDigest();
+        }
+        result.success = true;
+        return result;
+    }
+
+} // namespace opacity::filesystem
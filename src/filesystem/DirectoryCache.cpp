@@ -0,0 +1,473 @@
+#include "opacity/filesystem/DirectoryCache.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
+
+#include <algorithm>
+#include <cctype>
+#include <optional>
+#include <string_view>
+#include <unordered_set>
+
+namespace opacity::filesystem
+{
+    namespace
+    {
+        std::string FoldName(std::string_view name)
+        {
+            std::string folded(name);
+            for (char& c : folded)
+            {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return folded;
+        }
+
+        // Only views asking for a listing count; read-ahead probes do not
+        DirectoryCache::Snapshot CountLookup(DirectoryCache::Snapshot snapshot)
+        {
+            static auto& hits = core::Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                                {{"cache", "listing"}, {"result", "hit"}});
+            static auto& misses = core::Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                                  {{"cache", "listing"}, {"result", "miss"}});
+            (snapshot ? hits : misses).Add();
+            return snapshot;
+        }
+    }
+
+    DirectoryCache::DirectoryCache(FileSystemManager& fs_manager, const DirectoryCacheConfig& config)
+        : fs_manager_(fs_manager)
+        , config_(config)
+    {
+        watch_.Start();
+
+        memory_ = core::MemoryGovernor::Get().Register(
+            "Directory listings",
+            [this]
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                return bytes_;
+            },
+            [this](size_t target_bytes)
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                TrimLocked(target_bytes);
+            });
+    }
+
+    DirectoryCache::~DirectoryCache()
+    {
+        memory_.Reset();
+
+        // A read-ahead in flight gives up at its next batch
+        {
+            std::lock_guard<std::mutex> lock(prefetch_mutex_);
+            prefetch_stop_ = true;
+            prefetch_queue_.clear();
+        }
+        prefetch_wake_.notify_all();
+        for (auto& thread : prefetch_threads_)
+        {
+            thread.join();
+        }
+
+        // Change callbacks reach into this object; stop them before members go
+        watch_.Stop();
+        watch_.UnwatchAll();
+    }
+
+    DirectoryCache::Snapshot DirectoryCache::Find(const core::Path& path, const EnumerationOptions& options)
+    {
+        bool stale = false;
+        return CountLookup(Lookup(path, options, false, stale));
+    }
+
+    DirectoryCache::Snapshot DirectoryCache::FindStale(const core::Path& path, const EnumerationOptions& options,
+                                                       bool& stale)
+    {
+        stale = false;
+        return CountLookup(Lookup(path, options, true, stale));
+    }
+
+    DirectoryCache::Snapshot DirectoryCache::Lookup(const core::Path& path, const EnumerationOptions& options,
+                                                    bool allow_stale, bool& stale)
+    {
+        std::string key = DirectoryKey(path);
+        std::string options_key = OptionsKey(options);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+            return nullptr;
+
+        Entry& entry = it->second;
+        for (auto variant = entry.variants.begin(); variant != entry.variants.end(); ++variant)
+        {
+            if (variant->options_key != options_key)
+                continue;
+
+            if (entry.watch == 0)
+            {
+                auto age = std::chrono::steady_clock::now() - variant->stored;
+                if (age > config_.stale_max_age)
+                {
+                    item_count_ -= variant->contents->Count();
+                    bytes_ -= variant->contents->MemoryUsage();
+                    entry.variants.erase(variant);
+                    if (entry.variants.empty())
+                        EraseLocked(it);
+                    return nullptr;
+                }
+                if (age > config_.unwatched_max_age)
+                {
+                    if (!allow_stale)
+                        return nullptr;
+                    stale = true;
+                }
+            }
+
+            lru_.splice(lru_.begin(), lru_, entry.lru);
+            return variant->contents;
+        }
+        return nullptr;
+    }
+
+    DirectoryCache::Snapshot DirectoryCache::Store(const core::Path& path, const EnumerationOptions& options,
+                                                   ItemStore listing)
+    {
+        auto snapshot = std::make_shared<const ItemStore>(std::move(listing));
+        if (snapshot->Count() > config_.max_items)
+            return snapshot;
+
+        std::string key = DirectoryKey(path);
+        std::string options_key = OptionsKey(options);
+
+        bool cached = false;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            cached = entries_.count(key) != 0;
+        }
+
+        // Opening the watch can be slow on a share, so it happens unlocked
+        WatchHandle watch = 0;
+        if (!cached)
+        {
+            WatchConfig watch_config;
+            watch_config.recursive = false;
+            watch = watch_.WatchBatch(path,
+                [this, key](const std::vector<FileChangeEvent>& events) { OnChanges(key, events); },
+                watch_config);
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+        {
+            lru_.push_front(key);
+            Entry entry;
+            entry.path = path;
+            entry.watch = watch;
+            entry.lru = lru_.begin();
+            it = entries_.emplace(key, std::move(entry)).first;
+        }
+        else
+        {
+            // Another thread cached this directory meanwhile
+            if (watch != 0)
+                watch_.Unwatch(watch);
+            lru_.splice(lru_.begin(), lru_, it->second.lru);
+        }
+
+        Entry& entry = it->second;
+        auto variant = std::find_if(entry.variants.begin(), entry.variants.end(),
+            [&options_key](const Variant& v) { return v.options_key == options_key; });
+        auto now = std::chrono::steady_clock::now();
+        if (variant == entry.variants.end())
+        {
+            entry.variants.push_back({options, options_key, snapshot, now});
+        }
+        else
+        {
+            item_count_ -= variant->contents->Count();
+            bytes_ -= variant->contents->MemoryUsage();
+            variant->contents = snapshot;
+            variant->stored = now;
+        }
+        item_count_ += snapshot->Count();
+        bytes_ += snapshot->MemoryUsage();
+
+        EvictLocked();
+        return snapshot;
+    }
+
+    void DirectoryCache::Prefetch(const std::vector<core::Path>& directories, const EnumerationOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(prefetch_mutex_);
+        if (prefetch_stop_)
+            return;
+
+        prefetch_queue_.clear();
+        prefetch_options_ = options;
+        for (const auto& directory : directories)
+        {
+            if (prefetch_queue_.size() >= config_.prefetch_limit)
+                break;
+            prefetch_queue_.push_back(directory);
+        }
+
+        if (prefetch_threads_.empty() && !prefetch_queue_.empty())
+        {
+            for (size_t i = 0; i < std::max<size_t>(config_.prefetch_threads, 1); ++i)
+            {
+                prefetch_threads_.emplace_back([this] { PrefetchLoop(); });
+            }
+        }
+        prefetch_wake_.notify_all();
+    }
+
+    void DirectoryCache::Invalidate(const core::Path& path)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        auto it = entries_.find(DirectoryKey(path));
+        if (it != entries_.end())
+        {
+            EraseLocked(it);
+        }
+    }
+
+    void DirectoryCache::Clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        while (!entries_.empty())
+        {
+            EraseLocked(entries_.begin());
+        }
+    }
+
+    size_t DirectoryCache::GetDirectoryCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return entries_.size();
+    }
+
+    size_t DirectoryCache::GetItemCount() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return item_count_;
+    }
+
+    std::string DirectoryCache::DirectoryKey(const core::Path& path)
+    {
+        std::string key = FoldName(path.String());
+        std::replace(key.begin(), key.end(), '/', '\\');
+
+        // "C:\dir\" and "C:\dir" are the same directory; "C:\" keeps its separator
+        while (key.size() > 3 && key.back() == '\\')
+        {
+            key.pop_back();
+        }
+        return key;
+    }
+
+    std::string DirectoryCache::OptionsKey(const EnumerationOptions& options)
+    {
+        std::string key;
+        key += options.include_hidden ? 'h' : '-';
+        key += options.include_system ? 's' : '-';
+        key += options.include_files ? 'f' : '-';
+        key += options.include_directories ? 'd' : '-';
+        key += options.follow_symlinks ? 'l' : '-';
+        key += options.filter_pattern;
+        return key;
+    }
+
+    void DirectoryCache::OnChanges(const std::string& key, const std::vector<FileChangeEvent>& events)
+    {
+        core::Path directory;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it == entries_.end())
+                return;
+            directory = it->second.path;
+        }
+
+        // Collect the names that changed; anything about the directory itself
+        // (removal, lost events) means the listing can no longer be trusted
+        std::unordered_set<std::string> changed;
+        std::vector<core::Path> changed_paths;
+        for (const auto& event : events)
+        {
+            if (event.type == FileChangeType::Unknown || DirectoryKey(event.path) == key)
+            {
+                SPDLOG_DEBUG("Directory cache dropping {}", directory.String());
+                Invalidate(directory);
+                return;
+            }
+            for (const core::Path* path : {&event.path, &event.old_path})
+            {
+                if (path->Empty() || DirectoryKey(path->Parent()) != key)
+                    continue;
+                if (changed.insert(FoldName(path->Filename())).second)
+                    changed_paths.push_back(*path);
+            }
+        }
+
+        if (changed.empty())
+            return;
+
+        // Re-read each changed name; a missing one was deleted or renamed away
+        std::vector<FsItem> current;
+        for (const auto& changed_path : changed_paths)
+        {
+            if (auto info = fs_manager_.GetFileInfo(changed_path))
+            {
+                current.push_back(std::move(*info));
+            }
+        }
+
+        std::vector<Variant> variants;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = entries_.find(key);
+            if (it == entries_.end())
+                return;
+            variants = it->second.variants;
+        }
+
+        // Build the patched snapshots unlocked; listings can be large
+        std::vector<Snapshot> patched;
+        patched.reserve(variants.size());
+        for (const auto& variant : variants)
+        {
+            const ItemStore& old_listing = *variant.contents;
+            auto listing = std::make_shared<ItemStore>();
+            listing->Reset(old_listing.GetDirectory());
+            listing->Reserve(old_listing.Count() + current.size(), 0);
+
+            for (ItemStore::Index i = 0; i < old_listing.Count(); ++i)
+            {
+                if (!changed.count(FoldName(old_listing.Name(i))))
+                    listing->AddFrom(old_listing, i);
+            }
+
+            for (const auto& item : current)
+            {
+                if (FileSystemManager::MatchesOptions(item, variant.options))
+                    listing->Add(item);
+            }
+            patched.push_back(std::move(listing));
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = entries_.find(key);
+        if (it == entries_.end())
+            return;
+
+        // Only replace snapshots nobody stored over in the meantime
+        for (size_t i = 0; i < variants.size(); ++i)
+        {
+            for (auto& variant : it->second.variants)
+            {
+                if (variant.contents == variants[i].contents)
+                {
+                    item_count_ = item_count_ - variant.contents->Count() + patched[i]->Count();
+                    bytes_ = bytes_ - variant.contents->MemoryUsage() + patched[i]->MemoryUsage();
+                    variant.contents = patched[i];
+                }
+            }
+        }
+
+        EvictLocked();
+    }
+
+    void DirectoryCache::PrefetchLoop()
+    {
+        while (true)
+        {
+            core::Path directory;
+            EnumerationOptions options;
+            {
+                std::unique_lock<std::mutex> lock(prefetch_mutex_);
+                prefetch_wake_.wait(lock, [this] { return !prefetch_queue_.empty() || prefetch_stop_; });
+                if (prefetch_stop_)
+                    return;
+
+                directory = std::move(prefetch_queue_.front());
+                prefetch_queue_.pop_front();
+                options = prefetch_options_;
+            }
+
+            bool stale = false;
+            if (Lookup(directory, options, true, stale) && !stale)
+                continue;
+
+            ItemStore listing;
+            listing.Reset(directory.String());
+            DirectoryContents summary = fs_manager_.EnumerateDirectoryBatched(directory, options,
+                [this, &listing](std::vector<FsItem>& batch)
+                {
+                    if (prefetch_stop_)
+                        return false;
+                    for (const auto& item : batch)
+                    {
+                        listing.Add(item);
+                    }
+                    return true;
+                });
+
+            if (summary.success)
+                Store(directory, options, std::move(listing));
+            else
+                SPDLOG_DEBUG("Directory cache could not prefetch {}: {}", directory.String(), summary.error_message);
+        }
+    }
+
+    void DirectoryCache::EraseLocked(std::unordered_map<std::string, Entry>::iterator it)
+    {
+        Entry& entry = it->second;
+        if (entry.watch != 0)
+        {
+            watch_.Unwatch(entry.watch);
+        }
+        for (const auto& variant : entry.variants)
+        {
+            item_count_ -= variant.contents->Count();
+            bytes_ -= variant.contents->MemoryUsage();
+        }
+        lru_.erase(entry.lru);
+        entries_.erase(it);
+    }
+
+    void DirectoryCache::EvictLocked()
+    {
+        while (!lru_.empty() && (entries_.size() > config_.max_directories || item_count_ > config_.max_items))
+        {
+            auto it = entries_.find(lru_.back());
+            if (it == entries_.end())
+            {
+                lru_.pop_back();
+                continue;
+            }
+            EraseLocked(it);
+        }
+    }
+
+    void DirectoryCache::TrimLocked(size_t target_bytes)
+    {
+        while (!lru_.empty() && bytes_ > target_bytes)
+        {
+            auto it = entries_.find(lru_.back());
+            if (it == entries_.end())
+            {
+                lru_.pop_back();
+                continue;
+            }
+            EraseLocked(it);
+        }
+    }
+
+} // namespace opacity::filesystem
@@ -0,0 +1,290 @@
+#include "opacity/filesystem/DriveService.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/TaskScheduler.h"
+
+#define NOMINMAX
+#include <Windows.h>
+#include <Dbt.h>
+
+#include <map>
+#include <mutex>
+
+namespace opacity::filesystem
+{
+    namespace
+    {
+        constexpr wchar_t kWindowClass[] = L"OpacityDriveService";
+
+        bool SameDrive(const DriveInfo& a, const DriveInfo& b)
+        {
+            return a.volume_name == b.volume_name && a.file_system == b.file_system &&
+                   a.total_bytes == b.total_bytes && a.free_bytes == b.free_bytes &&
+                   a.available_bytes == b.available_bytes && a.is_removable == b.is_removable &&
+                   a.is_network == b.is_network && a.is_ready == b.is_ready;
+        }
+    }
+
+    struct DriveService::State
+    {
+        struct Drive
+        {
+            DriveInfo info;
+            bool querying = false;      // A query task is queued or running
+            bool again = false;         // Asked for while one was, so run another after it
+        };
+
+        mutable std::mutex mutex;
+        std::map<char, Drive> drives;
+        uint64_t generation = 0;
+        ChangeCallback on_change;
+
+        // After a change, outside the lock
+        void Changed()
+        {
+            ChangeCallback callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                ++generation;
+                callback = on_change;
+            }
+            if (callback)
+                callback();
+        }
+
+        // Called with mutex held
+        void QueryLocked(const std::shared_ptr<State>& self, char letter, Drive& drive)
+        {
+            if (drive.querying)
+            {
+                drive.again = true;
+                return;
+            }
+            drive.querying = true;
+
+            core::TaskOptions options;
+            options.priority = core::TaskPriority::Background;
+            options.io_device = core::TaskScheduler::IoDevice(core::Path(std::string(1, letter) + ":\\"));
+            core::TaskScheduler::Get().Submit([self, letter](const core::CancellationToken&) {
+                self->RunQuery(self, letter);
+            }, std::move(options));
+        }
+
+        void RunQuery(const std::shared_ptr<State>& self, char letter)
+        {
+            OPACITY_PROFILE_ZONE("DriveService::Query");
+            DriveInfo info = FileSystemManager::QueryDrive(letter);
+
+            bool changed = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto it = drives.find(letter);
+                if (it == drives.end())
+                    return;         // Removed while it was asked
+
+                Drive& drive = it->second;
+                drive.querying = false;
+                if (!SameDrive(drive.info, info))
+                {
+                    drive.info = std::move(info);
+                    changed = true;
+                }
+                if (drive.again)
+                {
+                    drive.again = false;
+                    QueryLocked(self, letter, drive);
+                }
+            }
+            if (changed)
+                Changed();
+        }
+
+        // Letters that came and went; every listed drive is queried again
+        // when refresh is set, new ones always
+        void Enumerate(const std::shared_ptr<State>& self, bool refresh)
+        {
+            DWORD mask = GetLogicalDrives();
+            bool changed = false;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto it = drives.begin(); it != drives.end();)
+                {
+                    if (mask & (1u << (it->first - 'A')))
+                    {
+                        ++it;
+                    }
+                    else
+                    {
+                        it = drives.erase(it);
+                        changed = true;
+                    }
+                }
+
+                for (char letter = 'A'; letter <= 'Z'; ++letter)
+                {
+                    if (!(mask & (1u << (letter - 'A'))))
+                        continue;
+
+                    auto [it, added] = drives.try_emplace(letter);
+                    if (added)
+                    {
+                        it->second.info.drive_letter = std::string(1, letter) + ":";
+                        changed = true;
+                    }
+                    if (added || refresh)
+                        QueryLocked(self, letter, it->second);
+                }
+            }
+            if (changed)
+                Changed();
+        }
+    };
+
+    DriveService::DriveService()
+        : state_(std::make_shared<State>())
+    {
+    }
+
+    DriveService::~DriveService()
+    {
+        Stop();
+    }
+
+    void DriveService::Start()
+    {
+        if (thread_.joinable())
+            return;
+
+        stop_event_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        refresh_event_ = CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
+        // Letters are known at once; what they hold comes from the queries
+        state_->Enumerate(state_, true);
+        thread_ = std::thread(&DriveService::Run, this);
+    }
+
+    void DriveService::Stop()
+    {
+        if (thread_.joinable())
+        {
+            SetEvent(static_cast<HANDLE>(stop_event_));
+            thread_.join();
+        }
+        if (stop_event_)
+        {
+            CloseHandle(static_cast<HANDLE>(stop_event_));
+            stop_event_ = nullptr;
+        }
+        if (refresh_event_)
+        {
+            CloseHandle(static_cast<HANDLE>(refresh_event_));
+            refresh_event_ = nullptr;
+        }
+
+        // Queries still running are not waited on, and tell nobody
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->on_change = nullptr;
+    }
+
+    std::vector<DriveInfo> DriveService::GetDrives() const
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        std::vector<DriveInfo> drives;
+        drives.reserve(state_->drives.size());
+        for (const auto& [letter, drive] : state_->drives)
+        {
+            drives.push_back(drive.info);
+        }
+        return drives;
+    }
+
+    uint64_t DriveService::GetGeneration() const
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        return state_->generation;
+    }
+
+    void DriveService::SetChangeCallback(ChangeCallback callback)
+    {
+        std::lock_guard<std::mutex> lock(state_->mutex);
+        state_->on_change = std::move(callback);
+    }
+
+    void DriveService::Refresh()
+    {
+        if (refresh_event_)
+            SetEvent(static_cast<HANDLE>(refresh_event_));
+    }
+
+    void DriveService::Run()
+    {
+        core::Profiler::SetThreadName("Drives");
+
+        // Volume arrival and removal are broadcast to top-level windows
+        // only, so this one is never shown rather than message-only
+        HINSTANCE instance = GetModuleHandleW(nullptr);
+        WNDCLASSEXW window_class = {};
+        window_class.cbSize = sizeof(window_class);
+        window_class.lpszClassName = kWindowClass;
+        window_class.hInstance = instance;
+        window_class.lpfnWndProc = [](HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) -> LRESULT
+        {
+            if (msg == WM_DEVICECHANGE && (wparam == DBT_DEVICEARRIVAL || wparam == DBT_DEVICEREMOVECOMPLETE))
+            {
+                auto* header = reinterpret_cast<DEV_BROADCAST_HDR*>(lparam);
+                if (header && header->dbch_devicetype == DBT_DEVTYP_VOLUME)
+                {
+                    auto* service = reinterpret_cast<DriveService*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+                    if (service)
+                        service->state_->Enumerate(service->state_, true);
+                }
+                return TRUE;
+            }
+            return DefWindowProcW(hwnd, msg, wparam, lparam);
+        };
+        RegisterClassExW(&window_class);
+
+        HWND window = CreateWindowExW(0, kWindowClass, L"", WS_OVERLAPPED, 0, 0, 0, 0,
+                                      nullptr, nullptr, instance, nullptr);
+        if (window)
+        {
+            SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+        }
+        else
+        {
+            core::Logger::Get()->warn("DriveService: no window for device notifications; drives refresh on a timer only");
+        }
+
+        HANDLE events[] = {static_cast<HANDLE>(stop_event_), static_cast<HANDLE>(refresh_event_)};
+        auto next_refresh = std::chrono::steady_clock::now() + kRefreshInterval;
+        while (true)
+        {
+            auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(
+                next_refresh - std::chrono::steady_clock::now());
+            DWORD timeout = wait.count() > 0 ? static_cast<DWORD>(wait.count()) : 0;
+            DWORD result = MsgWaitForMultipleObjects(2, events, FALSE, timeout, QS_ALLINPUT);
+            if (result == WAIT_OBJECT_0)
+                break;
+
+            if (result == WAIT_OBJECT_0 + 2)
+            {
+                MSG msg;
+                while (PeekMessageW(&msg, nullptr, 0, 0, PM_REMOVE))
+                {
+                    DispatchMessageW(&msg);
+                }
+            }
+
+            if (result == WAIT_OBJECT_0 + 1 || std::chrono::steady_clock::now() >= next_refresh)
+            {
+                state_->Enumerate(state_, true);
+                next_refresh = std::chrono::steady_clock::now() + kRefreshInterval;
+            }
+        }
+
+        if (window)
+            DestroyWindow(window);
+        UnregisterClassW(kWindowClass, instance);
+    }
+
+} // namespace opacity::filesystem
@@ -1,5 +1,10 @@
 #include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/filesystem/DirectoryCache.h"
+#include "opacity/filesystem/DriveService.h"
+#include "opacity/filesystem/FileWatch.h"
+#include "opacity/filesystem/StorageTopology.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
 
 #define NOMINMAX
 #include <Windows.h>
@@ -8,7 +13,9 @@
 #include <shellapi.h>
 
 #include <algorithm>
+#include <chrono>
 #include <codecvt>
+#include <iterator>
 #include <locale>
 
 #pragma comment(lib, "Shlwapi.lib")
@@ -39,6 +46,17 @@ namespace
         return result;
     }
 
+    // Convert a NUL-terminated wide name (at most MAX_PATH) in one call
+    void AppendWideName(const wchar_t* name, std::string& out)
+    {
+        char buffer[MAX_PATH * 3 + 1];
+        int length = WideCharToMultiByte(CP_UTF8, 0, name, -1, buffer, sizeof(buffer), nullptr, nullptr);
+        if (length > 1)
+        {
+            out.append(buffer, static_cast<size_t>(length - 1));
+        }
+    }
+
     // Get shell folder path
     std::string GetKnownFolderPath(const KNOWNFOLDERID& folder_id)
     {
@@ -61,15 +79,107 @@ FileSystemManager::FileSystemManager()
 
 FileSystemManager::~FileSystemManager()
 {
+    listing_cache_.reset();
+    drive_service_.reset();
+    if (file_watch_)
+    {
+        file_watch_->Stop();
+    }
     core::Logger::Get()->debug("FileSystemManager destroyed");
 }
 
+DirectoryCache& FileSystemManager::GetListingCache()
+{
+    std::call_once(listing_cache_once_, [this]()
+    {
+        listing_cache_ = std::make_unique<DirectoryCache>(*this);
+    });
+    return *listing_cache_;
+}
+
+DriveService& FileSystemManager::GetDriveService()
+{
+    std::call_once(drive_service_once_, [this]()
+    {
+        drive_service_ = std::make_unique<DriveService>();
+        drive_service_->Start();
+    });
+    return *drive_service_;
+}
+
+FileWatch& FileSystemManager::GetFileWatch()
+{
+    std::call_once(file_watch_once_, [this]()
+    {
+        file_watch_ = std::make_unique<FileWatch>();
+        file_watch_->Start();
+    });
+    return *file_watch_;
+}
+
+bool FileSystemManager::MatchesOptions(const FsItem& item, const EnumerationOptions& options)
+{
+    if (!options.include_hidden && item.IsHidden())
+        return false;
+    if (!options.include_system && item.IsSystem())
+        return false;
+    if (!options.include_directories && item.is_directory)
+        return false;
+    if (!options.include_files && !item.is_directory)
+        return false;
+    if (!options.filter_pattern.empty() && !FsItemUtils::MatchesName(item.name, options.filter_pattern))
+        return false;
+    return true;
+}
+
 DirectoryContents FileSystemManager::EnumerateDirectory(const core::Path& path, 
                                                          const EnumerationOptions& options)
 {
+    std::vector<FsItem> items;
+    DirectoryContents result = EnumerateDirectoryBatched(path, options,
+        [&items](std::vector<FsItem>& batch)
+        {
+            if (items.empty())
+            {
+                items = std::move(batch);
+            }
+            else
+            {
+                items.insert(items.end(), std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+            }
+            return true;
+        });
+
+    if (!result.success)
+    {
+        return result;
+    }
+
+    // Sort results
+    FsItemComparator comparator(options.sort_column, options.sort_direction, options.folders_first);
+    FsItemUtils::Sort(items, comparator);
+
+    result.items = std::move(items);
+    OPACITY_LOG_DEBUG(Filesystem, "Enumerated {} items in {}", result.items.size(), path.String());
+    
+    return result;
+}
+
+DirectoryContents FileSystemManager::EnumerateDirectoryBatched(const core::Path& path,
+                                                                const EnumerationOptions& options,
+                                                                const ItemBatchCallback& on_batch,
+                                                                size_t batch_size)
+{
+    // A slow share should still show something every few frames
+    constexpr auto kFlushInterval = std::chrono::milliseconds(50);
+
     DirectoryContents result;
     result.success = false;
 
+    auto& metrics = core::Metrics::Get();
+    core::MetricLabels volume = {{"volume", StorageTopology::GetVolumeProfile(path).root}};
+    auto started = std::chrono::steady_clock::now();
+
     std::wstring wide_path = Utf8ToWide(path.String());
     
     // Ensure path ends with backslash for search
@@ -80,8 +190,11 @@ DirectoryContents FileSystemManager::EnumerateDirectory(const core::Path& path,
     
     std::wstring search_path = wide_path + L"*";
 
+    // Basic info skips the 8.3 short names, and large fetch asks for bigger
+    // directory buffers per round trip
     WIN32_FIND_DATAW find_data;
-    HANDLE find_handle = FindFirstFileW(search_path.c_str(), &find_data);
+    HANDLE find_handle = FindFirstFileExW(search_path.c_str(), FindExInfoBasic, &find_data,
+                                          FindExSearchNameMatch, nullptr, FIND_FIRST_EX_LARGE_FETCH);
     
     if (find_handle == INVALID_HANDLE_VALUE)
     {
@@ -102,9 +215,27 @@ DirectoryContents FileSystemManager::EnumerateDirectory(const core::Path& path,
             break;
         }
         core::Logger::Get()->warn("Directory enumeration failed: {}", result.error_message);
+        metrics.GetCounter("opacity_enumeration_errors_total", volume).Add();
         return result;
     }
 
+    // Names are joined onto the UTF-8 directory instead of converting the
+    // full wide path per item
+    std::string directory_prefix = WideToUtf8(wide_path);
+    const bool filter_names = !options.filter_pattern.empty() && options.filter_pattern != "*";
+
+    std::vector<FsItem> batch;
+    batch.reserve(batch_size);
+    auto last_flush = std::chrono::steady_clock::now();
+
+    auto flush = [&]()
+    {
+        last_flush = std::chrono::steady_clock::now();
+        bool keep_going = on_batch(batch);
+        batch.clear();
+        return keep_going;
+    };
+
     do
     {
         // Skip . and ..
@@ -127,17 +258,13 @@ DirectoryContents FileSystemManager::EnumerateDirectory(const core::Path& path,
         if (!options.include_files && !is_directory)
             continue;
 
-        FsItem item = CreateFsItemFromFindData(wide_path, &find_data);
+        FsItem item = CreateFsItemFromFindData(directory_prefix, &find_data);
         
         // Apply name filter pattern
-        if (!options.filter_pattern.empty())
-        {
-            auto filtered = FsItemUtils::FilterByName({item}, options.filter_pattern);
-            if (filtered.empty())
-                continue;
-        }
+        if (filter_names && !FsItemUtils::MatchesName(item.name, options.filter_pattern))
+            continue;
 
-        result.items.push_back(std::move(item));
+        batch.push_back(std::move(item));
 
         if (is_directory)
         {
@@ -149,17 +276,29 @@ DirectoryContents FileSystemManager::EnumerateDirectory(const core::Path& path,
             result.total_size += (static_cast<uint64_t>(find_data.nFileSizeHigh) << 32) | find_data.nFileSizeLow;
         }
 
+        if (batch.size() >= batch_size || std::chrono::steady_clock::now() - last_flush >= kFlushInterval)
+        {
+            if (!flush())
+            {
+                result.cancelled = true;
+                break;
+            }
+        }
+
     } while (FindNextFileW(find_handle, &find_data));
 
     FindClose(find_handle);
 
-    // Sort results
-    FsItemComparator comparator(options.sort_column, options.sort_direction, options.folders_first);
-    FsItemUtils::Sort(result.items, comparator);
+    if (!result.cancelled && !batch.empty() && !flush())
+    {
+        result.cancelled = true;
+    }
 
-    result.success = true;
-    core::Logger::Get()->debug("Enumerated {} items in {}", result.items.size(), path.String());
-    
+    result.success = !result.cancelled;
+
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+    metrics.GetHistogram("opacity_enumeration_duration_us", volume).Record(static_cast<uint64_t>(elapsed.count()));
+    metrics.GetCounter("opacity_enumeration_items_total", volume).Add(result.total_files + result.total_directories);
     return result;
 }
 
@@ -179,45 +318,7 @@ std::vector<DriveInfo> FileSystemManager::GetDrives()
     {
         if (drive_mask & 1)
         {
-            DriveInfo info;
-            info.drive_letter = std::string(1, drive_letter) + ":";
-            
-            std::string root_path = info.drive_letter + "\\";
-            std::wstring wide_root = Utf8ToWide(root_path);
-            
-            UINT drive_type = GetDriveTypeW(wide_root.c_str());
-            info.is_removable = (drive_type == DRIVE_REMOVABLE);
-            info.is_network = (drive_type == DRIVE_REMOTE);
-            
-            // Check if drive is ready
-            ULARGE_INTEGER free_bytes, total_bytes, available_bytes;
-            if (GetDiskFreeSpaceExW(wide_root.c_str(), &available_bytes, &total_bytes, &free_bytes))
-            {
-                info.is_ready = true;
-                info.total_bytes = total_bytes.QuadPart;
-                info.free_bytes = free_bytes.QuadPart;
-                info.available_bytes = available_bytes.QuadPart;
-            }
-            else
-            {
-                info.is_ready = false;
-            }
-
-            // Get volume information
-            if (info.is_ready)
-            {
-                wchar_t volume_name[MAX_PATH + 1] = {0};
-                wchar_t file_system[MAX_PATH + 1] = {0};
-                
-                if (GetVolumeInformationW(wide_root.c_str(), volume_name, MAX_PATH,
-                                          nullptr, nullptr, nullptr, file_system, MAX_PATH))
-                {
-                    info.volume_name = WideToUtf8(volume_name);
-                    info.file_system = WideToUtf8(file_system);
-                }
-            }
-
-            drives.push_back(info);
+            drives.push_back(QueryDrive(drive_letter));
         }
         
         drive_mask >>= 1;
@@ -227,6 +328,49 @@ std::vector<DriveInfo> FileSystemManager::GetDrives()
     return drives;
 }
 
+DriveInfo FileSystemManager::QueryDrive(char drive_letter)
+{
+    DriveInfo info;
+    info.drive_letter = std::string(1, drive_letter) + ":";
+    
+    std::string root_path = info.drive_letter + "\\";
+    std::wstring wide_root = Utf8ToWide(root_path);
+    
+    UINT drive_type = GetDriveTypeW(wide_root.c_str());
+    info.is_removable = (drive_type == DRIVE_REMOVABLE);
+    info.is_network = (drive_type == DRIVE_REMOTE);
+    
+    // Check if drive is ready
+    ULARGE_INTEGER free_bytes, total_bytes, available_bytes;
+    if (GetDiskFreeSpaceExW(wide_root.c_str(), &available_bytes, &total_bytes, &free_bytes))
+    {
+        info.is_ready = true;
+        info.total_bytes = total_bytes.QuadPart;
+        info.free_bytes = free_bytes.QuadPart;
+        info.available_bytes = available_bytes.QuadPart;
+    }
+    else
+    {
+        info.is_ready = false;
+    }
+
+    // Get volume information
+    if (info.is_ready)
+    {
+        wchar_t volume_name[MAX_PATH + 1] = {0};
+        wchar_t file_system[MAX_PATH + 1] = {0};
+        
+        if (GetVolumeInformationW(wide_root.c_str(), volume_name, MAX_PATH,
+                                  nullptr, nullptr, nullptr, file_system, MAX_PATH))
+        {
+            info.volume_name = WideToUtf8(volume_name);
+            info.file_system = WideToUtf8(file_system);
+        }
+    }
+
+    return info;
+}
+
 std::string FileSystemManager::GetUserHomeDirectory()
 {
     return GetKnownFolderPath(FOLDERID_Profile);
@@ -256,7 +400,7 @@ bool FileSystemManager::MakeDirectory(const core::Path& path)
     
     if (result == ERROR_SUCCESS || result == ERROR_ALREADY_EXISTS)
     {
-        core::Logger::Get()->debug("Created directory: {}", path.String());
+        OPACITY_LOG_DEBUG(Filesystem, "Created directory: {}", path.String());
         return true;
     }
     
@@ -293,7 +437,7 @@ bool FileSystemManager::Delete(const core::Path& path, bool recursive)
             int result = SHFileOperationW(&file_op);
             if (result == 0 && !file_op.fAnyOperationsAborted)
             {
-                core::Logger::Get()->debug("Deleted directory recursively: {}", path.String());
+                OPACITY_LOG_DEBUG(Filesystem, "Deleted directory recursively: {}", path.String());
                 return true;
             }
             return false;
@@ -302,7 +446,7 @@ bool FileSystemManager::Delete(const core::Path& path, bool recursive)
         {
             if (RemoveDirectoryW(wide_path.c_str()))
             {
-                core::Logger::Get()->debug("Deleted empty directory: {}", path.String());
+                OPACITY_LOG_DEBUG(Filesystem, "Deleted empty directory: {}", path.String());
                 return true;
             }
             return false;
@@ -312,7 +456,7 @@ bool FileSystemManager::Delete(const core::Path& path, bool recursive)
     {
         if (DeleteFileW(wide_path.c_str()))
         {
-            core::Logger::Get()->debug("Deleted file: {}", path.String());
+            OPACITY_LOG_DEBUG(Filesystem, "Deleted file: {}", path.String());
             return true;
         }
         return false;
@@ -326,7 +470,7 @@ bool FileSystemManager::Rename(const core::Path& old_path, const core::Path& new
     
     if (MoveFileW(wide_old.c_str(), wide_new.c_str()))
     {
-        core::Logger::Get()->debug("Renamed {} to {}", old_path.String(), new_path.String());
+        OPACITY_LOG_DEBUG(Filesystem, "Renamed {} to {}", old_path.String(), new_path.String());
         return true;
     }
     
@@ -386,7 +530,7 @@ bool FileSystemManager::Move(const core::Path& source, const core::Path& dest, b
     
     if (MoveFileExW(wide_source.c_str(), wide_dest.c_str(), flags))
     {
-        core::Logger::Get()->debug("Moved {} to {}", source.String(), dest.String());
+        OPACITY_LOG_DEBUG(Filesystem, "Moved {} to {}", source.String(), dest.String());
         return true;
     }
     
@@ -413,7 +557,7 @@ std::optional<FsItem> FileSystemManager::GetFileInfo(const core::Path& path)
         dir_path = dir_path.substr(0, last_sep + 1);
     }
     
-    FsItem item = CreateFsItemFromFindData(dir_path, &find_data);
+    FsItem item = CreateFsItemFromFindData(WideToUtf8(dir_path), &find_data);
     FindClose(find_handle);
     
     return item;
@@ -507,13 +651,13 @@ std::chrono::system_clock::time_point FileSystemManager::FileTimeToTimePoint(uin
     return std::chrono::system_clock::time_point(duration);
 }
 
-FsItem FileSystemManager::CreateFsItemFromFindData(const std::wstring& directory_path, void* find_data_ptr)
+FsItem FileSystemManager::CreateFsItemFromFindData(const std::string& directory_prefix, void* find_data_ptr)
 {
     WIN32_FIND_DATAW* find_data = static_cast<WIN32_FIND_DATAW*>(find_data_ptr);
     
     FsItem item;
-    item.name = WideToUtf8(find_data->cFileName);
-    item.full_path = core::Path(WideToUtf8(directory_path + find_data->cFileName));
+    AppendWideName(find_data->cFileName, item.name);
+    item.full_path = core::Path(directory_prefix + item.name);
     item.is_directory = (find_data->dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
     item.is_symlink = (find_data->dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
     item.size = (static_cast<uint64_t>(find_data->nFileSizeHigh) << 32) | find_data->nFileSizeLow;
@@ -528,11 +672,11 @@ FsItem FileSystemManager::CreateFsItemFromFindData(const std::wstring& directory
     item.modified = FileTimeToTimePoint(modified_ft);
     item.created = FileTimeToTimePoint(created_ft);
     
-    // Extract extension
+    // Extract extension; mime type and type description are derived from it
+    // on demand
     if (!item.is_directory)
     {
         item.extension = FsItemUtils::GetExtension(item.name);
-        item.mime_type = FsItemUtils::GetMimeType(item.extension);
     }
     
     return item;
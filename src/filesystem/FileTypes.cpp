@@ -0,0 +1,408 @@
+#include "opacity/filesystem/FileTypes.h"
+
+#include <array>
+#include <cassert>
+#include <cstddef>
+
+namespace opacity::filesystem
+{
+
+namespace
+{
+    // FileType and mime type follow what DetermineFileType and GetMimeType
+    // answered before they shared this table; most of the extensions only
+    // a preview handler knows stay Unknown, as they always were.
+    constexpr ExtensionInfo kExtensions[] = {
+        // Images
+        {"jpg", FileType::Image, "image/jpeg", PreviewImage},
+        {"jpeg", FileType::Image, "image/jpeg", PreviewImage},
+        {"png", FileType::Image, "image/png", PreviewImage},
+        {"gif", FileType::Image, "image/gif", PreviewImage},
+        {"bmp", FileType::Image, "image/bmp", PreviewImage},
+        {"ico", FileType::Image, "image/x-icon", PreviewNone},
+        {"tiff", FileType::Image, nullptr, PreviewNone},
+        {"tif", FileType::Image, nullptr, PreviewNone},
+        {"webp", FileType::Image, "image/webp", PreviewNone},
+        {"svg", FileType::Image, "image/svg+xml", PreviewText},
+        {"psd", FileType::Image, nullptr, PreviewImage},
+        {"raw", FileType::Image, nullptr, PreviewNone},
+        {"heic", FileType::Image, nullptr, PreviewNone},
+        {"heif", FileType::Image, nullptr, PreviewNone},
+
+        // Audio
+        {"mp3", FileType::Audio, "audio/mpeg", PreviewAudio},
+        {"wav", FileType::Audio, "audio/wav", PreviewAudio},
+        {"flac", FileType::Audio, "audio/flac", PreviewAudio},
+        {"aac", FileType::Audio, nullptr, PreviewAudio},
+        {"ogg", FileType::Audio, "audio/ogg", PreviewAudio},
+        {"wma", FileType::Audio, nullptr, PreviewAudio},
+        {"m4a", FileType::Audio, nullptr, PreviewAudio},
+        {"opus", FileType::Audio, nullptr, PreviewAudio},
+
+        // Video
+        {"mp4", FileType::Video, "video/mp4", PreviewVideo},
+        {"avi", FileType::Video, "video/x-msvideo", PreviewVideo},
+        {"mkv", FileType::Video, "video/x-matroska", PreviewVideo},
+        {"mov", FileType::Video, "video/quicktime", PreviewVideo},
+        {"wmv", FileType::Video, nullptr, PreviewVideo},
+        {"flv", FileType::Video, nullptr, PreviewVideo},
+        {"webm", FileType::Video, "video/webm", PreviewVideo},
+        {"m4v", FileType::Video, nullptr, PreviewVideo},
+        {"mpeg", FileType::Video, nullptr, PreviewVideo},
+        {"mpg", FileType::Video, nullptr, PreviewVideo},
+
+        // Archives
+        {"zip", FileType::Archive, "application/zip", PreviewNone},
+        {"rar", FileType::Archive, "application/vnd.rar", PreviewNone},
+        {"7z", FileType::Archive, "application/x-7z-compressed", PreviewNone},
+        {"tar", FileType::Archive, "application/x-tar", PreviewNone},
+        {"gz", FileType::Archive, "application/gzip", PreviewNone},
+        {"bz2", FileType::Archive, nullptr, PreviewNone},
+        {"xz", FileType::Archive, nullptr, PreviewNone},
+        {"cab", FileType::Archive, nullptr, PreviewNone},
+        {"iso", FileType::Archive, nullptr, PreviewNone},
+
+        // Documents
+        {"pdf", FileType::Document, "application/pdf", PreviewDocument},
+        {"doc", FileType::Document, "application/msword", PreviewDocument},
+        {"docx", FileType::Document, "application/vnd.openxmlformats-officedocument.wordprocessingml.document", PreviewDocument},
+        {"xls", FileType::Document, "application/vnd.ms-excel", PreviewDocument},
+        {"xlsx", FileType::Document, "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet", PreviewDocument},
+        {"ppt", FileType::Document, nullptr, PreviewDocument},
+        {"pptx", FileType::Document, nullptr, PreviewDocument},
+        {"odt", FileType::Document, nullptr, PreviewDocument},
+        {"ods", FileType::Document, nullptr, PreviewDocument},
+        {"odp", FileType::Document, nullptr, PreviewDocument},
+        {"rtf", FileType::Document, nullptr, PreviewText | PreviewDocument},
+
+        // Code
+        {"cpp", FileType::Code, "text/x-c++src", PreviewText},
+        {"c", FileType::Code, "text/x-csrc", PreviewText},
+        {"h", FileType::Code, "text/x-chdr", PreviewText},
+        {"hpp", FileType::Code, "text/x-c++hdr", PreviewText},
+        {"cs", FileType::Code, "text/x-csharp", PreviewText},
+        {"java", FileType::Code, "text/x-java-source", PreviewText},
+        {"py", FileType::Code, "text/x-python", PreviewText},
+        {"js", FileType::Code, "text/javascript", PreviewText},
+        {"ts", FileType::Code, "text/typescript", PreviewText | PreviewVideo},
+        {"html", FileType::Code, "text/html", PreviewText},
+        {"css", FileType::Code, "text/css", PreviewText},
+        {"php", FileType::Code, nullptr, PreviewText},
+        {"rb", FileType::Code, nullptr, PreviewText},
+        {"go", FileType::Code, "text/x-go", PreviewText},
+        {"rs", FileType::Code, "text/x-rust", PreviewText},
+        {"swift", FileType::Code, nullptr, PreviewText},
+        {"kt", FileType::Code, nullptr, PreviewText},
+        {"scala", FileType::Code, nullptr, PreviewText},
+        {"lua", FileType::Code, nullptr, PreviewText},
+        {"sh", FileType::Code, nullptr, PreviewText},
+        {"bash", FileType::Code, nullptr, PreviewText},
+        {"ps1", FileType::Code, nullptr, PreviewText},
+
+        // Text
+        {"txt", FileType::Text, "text/plain", PreviewText},
+        {"md", FileType::Text, "text/markdown", PreviewText},
+        {"log", FileType::Text, nullptr, PreviewText},
+        {"cfg", FileType::Text, nullptr, PreviewText},
+        {"ini", FileType::Text, nullptr, PreviewText},
+        {"json", FileType::Text, "application/json", PreviewText},
+        {"xml", FileType::Text, "application/xml", PreviewText},
+        {"yaml", FileType::Text, nullptr, PreviewText},
+        {"yml", FileType::Text, nullptr, PreviewText},
+        {"csv", FileType::Text, "text/csv", PreviewText},
+
+        // Executables
+        {"exe", FileType::Executable, "application/vnd.microsoft.portable-executable", PreviewNone},
+        {"dll", FileType::Executable, "application/vnd.microsoft.portable-executable", PreviewNone},
+        {"sys", FileType::Executable, nullptr, PreviewNone},
+        {"msi", FileType::Executable, "application/x-msi", PreviewNone},
+        {"bat", FileType::Executable, nullptr, PreviewText},
+        {"cmd", FileType::Executable, nullptr, PreviewText},
+        {"com", FileType::Executable, nullptr, PreviewNone},
+
+        // Other images the image handler decodes
+        {"tga", FileType::Unknown, nullptr, PreviewImage},
+        {"hdr", FileType::Unknown, nullptr, PreviewImage},
+        {"pic", FileType::Unknown, nullptr, PreviewImage},
+        {"pnm", FileType::Unknown, nullptr, PreviewImage},
+
+        // Other text the text handler shows
+        {"htm", FileType::Unknown, "text/html", PreviewText},
+        {"text", FileType::Unknown, nullptr, PreviewText},
+        {"markdown", FileType::Unknown, nullptr, PreviewText},
+        {"rst", FileType::Unknown, nullptr, PreviewText},
+        {"cc", FileType::Unknown, nullptr, PreviewText},
+        {"cxx", FileType::Unknown, nullptr, PreviewText},
+        {"hxx", FileType::Unknown, nullptr, PreviewText},
+        {"inl", FileType::Unknown, nullptr, PreviewText},
+        {"groovy", FileType::Unknown, nullptr, PreviewText},
+        {"pyw", FileType::Unknown, nullptr, PreviewText},
+        {"pyx", FileType::Unknown, nullptr, PreviewText},
+        {"pxd", FileType::Unknown, nullptr, PreviewText},
+        {"jsx", FileType::Unknown, nullptr, PreviewText},
+        {"tsx", FileType::Unknown, nullptr, PreviewText},
+        {"mjs", FileType::Unknown, nullptr, PreviewText},
+        {"cjs", FileType::Unknown, nullptr, PreviewText},
+        {"rake", FileType::Unknown, nullptr, PreviewText},
+        {"gemspec", FileType::Unknown, nullptr, PreviewText},
+        {"phtml", FileType::Unknown, nullptr, PreviewText},
+        {"m", FileType::Unknown, nullptr, PreviewText},
+        {"mm", FileType::Unknown, nullptr, PreviewText},
+        {"pl", FileType::Unknown, nullptr, PreviewText},
+        {"pm", FileType::Unknown, nullptr, PreviewText},
+        {"tcl", FileType::Unknown, nullptr, PreviewText},
+        {"r", FileType::Unknown, nullptr, PreviewText},
+        {"zsh", FileType::Unknown, nullptr, PreviewText},
+        {"fish", FileType::Unknown, nullptr, PreviewText},
+        {"psm1", FileType::Unknown, nullptr, PreviewText},
+        {"asm", FileType::Unknown, nullptr, PreviewText},
+        {"s", FileType::Unknown, nullptr, PreviewText},
+        {"xhtml", FileType::Unknown, nullptr, PreviewText},
+        {"scss", FileType::Unknown, nullptr, PreviewText},
+        {"sass", FileType::Unknown, nullptr, PreviewText},
+        {"less", FileType::Unknown, nullptr, PreviewText},
+        {"xsl", FileType::Unknown, nullptr, PreviewText},
+        {"xslt", FileType::Unknown, nullptr, PreviewText},
+        {"vue", FileType::Unknown, nullptr, PreviewText},
+        {"svelte", FileType::Unknown, nullptr, PreviewText},
+        {"jsonc", FileType::Unknown, nullptr, PreviewText},
+        {"json5", FileType::Unknown, nullptr, PreviewText},
+        {"toml", FileType::Unknown, nullptr, PreviewText},
+        {"conf", FileType::Unknown, nullptr, PreviewText},
+        {"config", FileType::Unknown, nullptr, PreviewText},
+        {"tsv", FileType::Unknown, nullptr, PreviewText},
+        {"sql", FileType::Unknown, nullptr, PreviewText},
+        {"sqlite", FileType::Unknown, nullptr, PreviewText},
+        {"cmake", FileType::Unknown, nullptr, PreviewText},
+        {"make", FileType::Unknown, nullptr, PreviewText},
+        {"makefile", FileType::Unknown, nullptr, PreviewText},
+        {"dockerfile", FileType::Unknown, nullptr, PreviewText},
+        {"gradle", FileType::Unknown, nullptr, PreviewText},
+        {"maven", FileType::Unknown, nullptr, PreviewText},
+        {"pom", FileType::Unknown, nullptr, PreviewText},
+        {"gitignore", FileType::Unknown, nullptr, PreviewText},
+        {"gitattributes", FileType::Unknown, nullptr, PreviewText},
+        {"gitmodules", FileType::Unknown, nullptr, PreviewText},
+        {"editorconfig", FileType::Unknown, nullptr, PreviewText},
+        {"eslintrc", FileType::Unknown, nullptr, PreviewText},
+        {"prettierrc", FileType::Unknown, nullptr, PreviewText},
+        {"readme", FileType::Unknown, nullptr, PreviewText},
+        {"license", FileType::Unknown, nullptr, PreviewText},
+        {"changelog", FileType::Unknown, nullptr, PreviewText},
+        {"contributing", FileType::Unknown, nullptr, PreviewText},
+        {"authors", FileType::Unknown, nullptr, PreviewText},
+        {"todo", FileType::Unknown, nullptr, PreviewText},
+        {"note", FileType::Unknown, nullptr, PreviewText},
+        {"notes", FileType::Unknown, nullptr, PreviewText},
+
+        // Other video
+        {"3gp", FileType::Unknown, nullptr, PreviewVideo},
+        {"3g2", FileType::Unknown, nullptr, PreviewVideo},
+        {"mts", FileType::Unknown, nullptr, PreviewVideo},
+        {"m2ts", FileType::Unknown, nullptr, PreviewVideo},
+        {"vob", FileType::Unknown, nullptr, PreviewVideo},
+        {"ogv", FileType::Unknown, nullptr, PreviewVideo},
+        {"divx", FileType::Unknown, nullptr, PreviewVideo},
+        {"xvid", FileType::Unknown, nullptr, PreviewVideo},
+        {"asf", FileType::Unknown, nullptr, PreviewVideo},
+
+        // Other audio
+        {"aiff", FileType::Unknown, nullptr, PreviewAudio},
+        {"ape", FileType::Unknown, nullptr, PreviewAudio},
+        {"alac", FileType::Unknown, nullptr, PreviewAudio},
+        {"mid", FileType::Unknown, nullptr, PreviewAudio},
+        {"midi", FileType::Unknown, nullptr, PreviewAudio},
+        {"ac3", FileType::Unknown, nullptr, PreviewAudio},
+        {"dts", FileType::Unknown, nullptr, PreviewAudio},
+        {"mka", FileType::Unknown, nullptr, PreviewAudio},
+        {"ra", FileType::Unknown, nullptr, PreviewAudio},
+        {"ram", FileType::Unknown, nullptr, PreviewAudio},
+
+        // Other documents
+        {"docm", FileType::Unknown, nullptr, PreviewDocument},
+        {"xlsm", FileType::Unknown, nullptr, PreviewDocument},
+        {"pptm", FileType::Unknown, nullptr, PreviewDocument},
+    };
+
+    constexpr size_t kCount = std::size(kExtensions);
+    constexpr size_t kBuckets = 128;
+    constexpr size_t kSlots = 512;      // Kept sparse so every bucket finds a seed in a few tries
+    constexpr uint16_t kEmpty = 0xFFFF;
+
+    static_assert((kSlots & (kSlots - 1)) == 0 && kCount < kSlots && kSlots <= kEmpty);
+
+    constexpr size_t LongestExtension()
+    {
+        size_t longest = 0;
+        for (const auto& entry : kExtensions)
+            longest = entry.extension.size() > longest ? entry.extension.size() : longest;
+        return longest;
+    }
+
+    constexpr size_t kMaxLength = LongestExtension();
+
+    constexpr bool AllLowercase()
+    {
+        for (const auto& entry : kExtensions)
+        {
+            for (char c : entry.extension)
+            {
+                if (c >= 'A' && c <= 'Z')
+                    return false;
+            }
+        }
+        return true;
+    }
+
+    static_assert(AllLowercase(), "extension table entries must be lowercase");
+
+    // FNV-1a with a final mix, since the table uses the low bits
+    constexpr uint32_t Hash(std::string_view text)
+    {
+        uint32_t hash = 2166136261u;
+        for (char c : text)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 16777619u;
+        }
+        hash ^= hash >> 16;
+        hash *= 0x85EBCA6Bu;
+        hash ^= hash >> 13;
+        return hash;
+    }
+
+    /**
+     * @brief Hash and displace. A key's hash picks its bucket and, with
+     *        that bucket's seed, its slot; each bucket was given the first
+     *        seed that sends all of its keys to free slots
+     *
+     * Built once, on first lookup: the seed search takes far more steps
+     * than compilers allow a constant expression by default, and it runs
+     * in microseconds.
+     */
+    struct PerfectHash
+    {
+        std::array<uint16_t, kBuckets> seeds{};
+        std::array<uint16_t, kSlots> slots{};
+
+        static constexpr size_t Bucket(uint32_t hash) { return hash % kBuckets; }
+
+        static constexpr size_t Slot(uint32_t hash, uint32_t seed)
+        {
+            uint32_t step = ((hash * 0xC2B2AE35u) ^ (hash >> 15)) | 1u;
+            return ((hash >> 7) + seed * step) % kSlots;
+        }
+
+        constexpr size_t Find(uint32_t hash) const { return Slot(hash, seeds[Bucket(hash)]); }
+    };
+
+    PerfectHash BuildPerfectHash()
+    {
+        PerfectHash table;
+        for (auto& slot : table.slots)
+            slot = kEmpty;
+
+        // Each key is hashed once; trying a seed is then just arithmetic
+        std::array<uint32_t, kCount> hashes{};
+        std::array<uint16_t, kBuckets + 1> start{};
+        size_t largest = 0;
+        for (size_t i = 0; i < kCount; ++i)
+        {
+            hashes[i] = Hash(kExtensions[i].extension);
+            ++start[PerfectHash::Bucket(hashes[i]) + 1];
+        }
+        for (size_t b = 0; b < kBuckets; ++b)
+        {
+            largest = start[b + 1] > largest ? start[b + 1] : largest;
+            start[b + 1] = static_cast<uint16_t>(start[b + 1] + start[b]);
+        }
+
+        // Keys grouped by bucket
+        std::array<uint16_t, kCount> keys{};
+        std::array<uint16_t, kBuckets> filled{};
+        for (size_t i = 0; i < kCount; ++i)
+        {
+            size_t b = PerfectHash::Bucket(hashes[i]);
+            keys[start[b] + filled[b]++] = static_cast<uint16_t>(i);
+        }
+
+        // Biggest buckets first, while the table is emptiest
+        for (size_t size = largest; size > 0; --size)
+        {
+            for (size_t b = 0; b < kBuckets; ++b)
+            {
+                if (static_cast<size_t>(start[b + 1] - start[b]) != size)
+                    continue;
+
+                for (uint32_t seed = 0;; ++seed)
+                {
+                    if (seed == kEmpty)
+                    {
+                        // Only a duplicate entry gets here; its bucket is left unplaced
+                        assert(!"no seed places this bucket; duplicate extension?");
+                        break;
+                    }
+
+                    size_t placed = 0;
+                    for (; placed < size; ++placed)
+                    {
+                        uint16_t key = keys[start[b] + placed];
+                        size_t slot = PerfectHash::Slot(hashes[key], seed);
+                        if (table.slots[slot] != kEmpty)
+                            break;
+                        table.slots[slot] = key;
+                    }
+                    if (placed == size)
+                    {
+                        table.seeds[b] = static_cast<uint16_t>(seed);
+                        break;
+                    }
+
+                    // Take back this attempt's keys and try the next seed
+                    for (size_t undo = 0; undo < placed; ++undo)
+                        table.slots[PerfectHash::Slot(hashes[keys[start[b] + undo]], seed)] = kEmpty;
+                }
+            }
+        }
+        return table;
+    }
+
+    const PerfectHash& Table()
+    {
+        static const PerfectHash table = BuildPerfectHash();
+        return table;
+    }
+}
+
+const ExtensionInfo* LookupExtension(std::string_view extension)
+{
+    if (extension.empty() || extension.size() > kMaxLength)
+        return nullptr;
+
+    char lower[kMaxLength];
+    for (size_t i = 0; i < extension.size(); ++i)
+    {
+        char c = extension[i];
+        lower[i] = (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+    std::string_view key(lower, extension.size());
+
+    const PerfectHash& table = Table();
+    uint16_t index = table.slots[table.Find(Hash(key))];
+    if (index == kEmpty || kExtensions[index].extension != key)
+        return nullptr;
+    return &kExtensions[index];
+}
+
+std::vector<std::string> ExtensionsFor(uint8_t preview_handlers)
+{
+    std::vector<std::string> result;
+    for (const auto& entry : kExtensions)
+    {
+        if (entry.preview_handlers & preview_handlers)
+            result.emplace_back(entry.extension);
+    }
+    return result;
+}
+
+} // namespace opacity::filesystem
@@ -1,14 +1,73 @@
 #include "opacity/filesystem/FileWatch.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
 
 #define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
 #include <windows.h>
 
 #include <algorithm>
 #include <regex>
+#include <unordered_map>
 
 namespace opacity::filesystem
 {
+    namespace
+    {
+        constexpr DWORD kNotifyFilter = FILE_NOTIFY_CHANGE_FILE_NAME |
+                                        FILE_NOTIFY_CHANGE_DIR_NAME |
+                                        FILE_NOTIFY_CHANGE_ATTRIBUTES |
+                                        FILE_NOTIFY_CHANGE_SIZE |
+                                        FILE_NOTIFY_CHANGE_LAST_WRITE |
+                                        FILE_NOTIFY_CHANGE_CREATION;
+
+        // Completion key of the packets Stop() and Watch() post to the port
+        constexpr ULONG_PTR kWakeKey = 0;
+
+        // The stats of every watch in the process together, by stage
+        core::Counter& EventCounter(const char* stage)
+        {
+            return core::Metrics::Get().GetCounter("opacity_filewatch_events_total", {{"stage", stage}});
+        }
+
+        FileChangeType ToChangeType(DWORD action)
+        {
+            switch (action)
+            {
+            case FILE_ACTION_ADDED:
+                return FileChangeType::Created;
+            case FILE_ACTION_REMOVED:
+                return FileChangeType::Deleted;
+            case FILE_ACTION_MODIFIED:
+                return FileChangeType::Modified;
+            case FILE_ACTION_RENAMED_OLD_NAME:
+            case FILE_ACTION_RENAMED_NEW_NAME:
+                return FileChangeType::Renamed;
+            default:
+                return FileChangeType::Unknown;
+            }
+        }
+
+        // Paths compare case-insensitively, as the file system does
+        std::string PathKey(const core::Path& path)
+        {
+            std::string key = path.String();
+            for (char& c : key)
+            {
+                if (c >= 'A' && c <= 'Z')
+                    c = static_cast<char>(c - 'A' + 'a');
+            }
+            return key;
+        }
+
+        // Deleted, or renamed away with no new name in the watch
+        bool IsGone(const FileChangeEvent& event)
+        {
+            return event.type == FileChangeType::Deleted ||
+                   (event.type == FileChangeType::Renamed && event.old_path.Empty());
+        }
+    }
+
     struct FileWatch::WatchEntry
     {
         WatchHandle handle = 0;
@@ -20,96 +79,126 @@ namespace opacity::filesystem
         
         HANDLE dir_handle = INVALID_HANDLE_VALUE;
         OVERLAPPED overlapped{};
-        std::vector<BYTE> buffer;
+        std::vector<DWORD> buffer;          // DWORD-aligned, as the notify records require
+        bool extended = true;               // ReadDirectoryChangesExW; cleared where unsupported (some shares)
+        bool read_pending = false;          // Only touched by whoever issues or completes the read
         
         std::vector<FileChangeEvent> pending_events;
+        std::chrono::steady_clock::time_point first_event_time;
         std::chrono::steady_clock::time_point last_event_time;
+        std::chrono::steady_clock::time_point last_delivery_time;
         std::mutex event_mutex;
+
+        // Storm detection over one-second windows
+        std::chrono::steady_clock::time_point window_start;
+        size_t window_events = 0;
+        bool storm = false;
+        bool summary_pending = false;       // pending_events holds only the directory summary
         
         WatchEntry()
         {
-            buffer.resize(64 * 1024);  // 64KB buffer
-            overlapped.hEvent = CreateEvent(nullptr, TRUE, FALSE, nullptr);
+            buffer.resize(64 * 1024 / sizeof(DWORD));  // 64KB buffer
         }
         
         ~WatchEntry()
         {
             if (dir_handle != INVALID_HANDLE_VALUE)
             {
-                CancelIo(dir_handle);
                 CloseHandle(dir_handle);
             }
-            if (overlapped.hEvent != nullptr)
-            {
-                CloseHandle(overlapped.hEvent);
-            }
         }
     };
 
-    FileWatch::FileWatch() = default;
+    FileWatch::FileWatch()
+    {
+        completion_port_ = CreateIoCompletionPort(INVALID_HANDLE_VALUE, nullptr, 0, 1);
+        if (completion_port_ == nullptr)
+        {
+            SPDLOG_ERROR("Failed to create FileWatch completion port: {}", GetLastError());
+        }
+    }
 
     FileWatch::~FileWatch()
     {
         Stop();
         UnwatchAll();
+
+        // Cancelled reads still own their buffers until the port reports
+        // them; collect those completions before anything is freed
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (completion_port_ != nullptr)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (retiring_.empty())
+                    break;
+            }
+            if (std::chrono::steady_clock::now() > deadline)
+            {
+                SPDLOG_WARN("FileWatch gave up waiting on cancelled reads");
+                break;
+            }
+
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+            BOOL ok = GetQueuedCompletionStatus(completion_port_, &bytes, &key, &overlapped, 100);
+            if (overlapped != nullptr)
+            {
+                HandleCompletion(key, ok ? 0 : GetLastError(), bytes);
+            }
+        }
+
+        if (completion_port_ != nullptr)
+        {
+            CloseHandle(completion_port_);
+        }
     }
 
     WatchHandle FileWatch::Watch(const core::Path& path, FileChangeCallback callback,
                                   const WatchConfig& config)
     {
-        auto entry = std::make_unique<WatchEntry>();
-        entry->handle = next_handle_++;
+        auto entry = std::make_shared<WatchEntry>();
         entry->path = path;
         entry->config = config;
         entry->callback = std::move(callback);
         entry->is_batch = false;
 
-        // Open directory handle
-        DWORD share_mode = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
-        DWORD flags = FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED;
-        
-        entry->dir_handle = CreateFileW(
-            path.WString().c_str(),
-            FILE_LIST_DIRECTORY,
-            share_mode,
-            nullptr,
-            OPEN_EXISTING,
-            flags,
-            nullptr
-        );
-
-        if (entry->dir_handle == INVALID_HANDLE_VALUE)
-        {
-            SPDLOG_ERROR("Failed to open directory for watching: {}", path.String());
-            return 0;
-        }
-
-        WatchHandle handle = entry->handle;
-        
+        WatchHandle handle = AddWatch(std::move(entry));
+        if (handle != 0)
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            watches_.push_back(std::move(entry));
+            SPDLOG_DEBUG("Started watching: {}", path.String());
         }
-
-        SPDLOG_INFO("Started watching: {}", path.String());
         return handle;
     }
 
     WatchHandle FileWatch::WatchBatch(const core::Path& path, BatchChangeCallback callback,
                                        const WatchConfig& config)
     {
-        auto entry = std::make_unique<WatchEntry>();
-        entry->handle = next_handle_++;
+        auto entry = std::make_shared<WatchEntry>();
         entry->path = path;
         entry->config = config;
         entry->batch_callback = std::move(callback);
         entry->is_batch = true;
 
+        WatchHandle handle = AddWatch(std::move(entry));
+        if (handle != 0)
+        {
+            SPDLOG_DEBUG("Started batch watching: {}", path.String());
+        }
+        return handle;
+    }
+
+    WatchHandle FileWatch::AddWatch(std::shared_ptr<WatchEntry> entry)
+    {
+        if (completion_port_ == nullptr)
+            return 0;
+
         DWORD share_mode = FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE;
         DWORD flags = FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED;
         
         entry->dir_handle = CreateFileW(
-            path.WString().c_str(),
+            entry->path.WString().c_str(),
             FILE_LIST_DIRECTORY,
             share_mode,
             nullptr,
@@ -120,18 +209,28 @@ namespace opacity::filesystem
 
         if (entry->dir_handle == INVALID_HANDLE_VALUE)
         {
-            SPDLOG_ERROR("Failed to open directory for watching: {}", path.String());
+            SPDLOG_ERROR("Failed to open directory for watching: {}", entry->path.String());
             return 0;
         }
 
-        WatchHandle handle = entry->handle;
-        
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        // Completions carry the watch handle, so the thread can tell a live
+        // watch from one that was unwatched while its read was in flight
+        entry->handle = next_handle_++;
+        if (CreateIoCompletionPort(entry->dir_handle, completion_port_, static_cast<ULONG_PTR>(entry->handle), 0) == nullptr)
         {
-            std::lock_guard<std::mutex> lock(mutex_);
-            watches_.push_back(std::move(entry));
+            SPDLOG_ERROR("Failed to attach watch to completion port: {}", entry->path.String());
+            return 0;
         }
 
-        SPDLOG_INFO("Started batch watching: {}", path.String());
+        if (!IssueRead(*entry))
+        {
+            return 0;
+        }
+
+        WatchHandle handle = entry->handle;
+        watches_.push_back(std::move(entry));
         return handle;
     }
 
@@ -144,7 +243,8 @@ namespace opacity::filesystem
         
         if (it != watches_.end())
         {
-            SPDLOG_INFO("Stopped watching: {}", (*it)->path.String());
+            SPDLOG_DEBUG("Stopped watching: {}", (*it)->path.String());
+            RetireLocked(std::move(*it));
             watches_.erase(it);
         }
     }
@@ -152,10 +252,25 @@ namespace opacity::filesystem
     void FileWatch::UnwatchAll()
     {
         std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& entry : watches_)
+        {
+            RetireLocked(std::move(entry));
+        }
         watches_.clear();
         SPDLOG_INFO("Stopped all watches");
     }
 
+    void FileWatch::RetireLocked(std::shared_ptr<WatchEntry> entry)
+    {
+        // The kernel writes into the entry until the read completes, so it
+        // is kept until the cancellation comes back through the port
+        if (entry->read_pending)
+        {
+            CancelIoEx(entry->dir_handle, &entry->overlapped);
+            retiring_.push_back(std::move(entry));
+        }
+    }
+
     bool FileWatch::IsWatching(const core::Path& path) const
     {
         std::lock_guard<std::mutex> lock(mutex_);
@@ -187,7 +302,7 @@ namespace opacity::filesystem
 
     void FileWatch::Start()
     {
-        if (running_)
+        if (running_ || completion_port_ == nullptr)
             return;
 
         running_ = true;
@@ -202,17 +317,8 @@ namespace opacity::filesystem
 
         running_ = false;
         
-        // Signal all overlapped events to wake up the thread
-        {
-            std::lock_guard<std::mutex> lock(mutex_);
-            for (auto& entry : watches_)
-            {
-                if (entry->overlapped.hEvent)
-                {
-                    SetEvent(entry->overlapped.hEvent);
-                }
-            }
-        }
+        // Wake the thread out of its wait on the port
+        PostQueuedCompletionStatus(completion_port_, 0, kWakeKey, nullptr);
 
         if (watcher_thread_.joinable())
         {
@@ -227,168 +333,302 @@ namespace opacity::filesystem
         return running_;
     }
 
-    void FileWatch::WatcherThread()
+    FileWatchStats FileWatch::GetStats() const
     {
-        while (running_)
+        FileWatchStats stats;
+        stats.received = received_;
+        stats.delivered = delivered_;
+        stats.merged = merged_;
+        stats.dropped = dropped_;
+        stats.summaries = summaries_;
+        return stats;
+    }
+
+    bool FileWatch::IssueRead(WatchEntry& entry)
+    {
+        entry.overlapped = OVERLAPPED{};
+
+        BOOL success = FALSE;
+        if (entry.extended)
         {
-            if (paused_)
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                continue;
-            }
+            success = ReadDirectoryChangesExW(
+                entry.dir_handle,
+                entry.buffer.data(),
+                static_cast<DWORD>(entry.buffer.size() * sizeof(DWORD)),
+                entry.config.recursive ? TRUE : FALSE,
+                kNotifyFilter,
+                nullptr,
+                &entry.overlapped,
+                nullptr,
+                ReadDirectoryNotifyExtendedInformation
+            );
 
-            std::vector<WatchEntry*> entries;
+            // Redirected drives may not know the extended class
+            if (!success)
             {
-                std::lock_guard<std::mutex> lock(mutex_);
-                for (auto& entry : watches_)
+                DWORD error = GetLastError();
+                if (error == ERROR_INVALID_PARAMETER || error == ERROR_INVALID_FUNCTION || error == ERROR_NOT_SUPPORTED)
                 {
-                    entries.push_back(entry.get());
+                    entry.extended = false;
                 }
             }
+        }
 
-            if (entries.empty())
+        if (!entry.extended)
+        {
+            success = ReadDirectoryChangesW(
+                entry.dir_handle,
+                entry.buffer.data(),
+                static_cast<DWORD>(entry.buffer.size() * sizeof(DWORD)),
+                entry.config.recursive ? TRUE : FALSE,
+                kNotifyFilter,
+                nullptr,
+                &entry.overlapped,
+                nullptr
+            );
+        }
+
+        entry.read_pending = success != FALSE;
+        if (!success)
+        {
+            SPDLOG_ERROR("ReadDirectoryChangesW failed for: {}", entry.path.String());
+        }
+        return entry.read_pending;
+    }
+
+    void FileWatch::WatcherThread()
+    {
+        while (running_)
+        {
+            DWORD bytes = 0;
+            ULONG_PTR key = 0;
+            OVERLAPPED* overlapped = nullptr;
+
+            // Sleep until a read completes or a debounced batch falls due;
+            // nothing is polled
+            BOOL ok = GetQueuedCompletionStatus(completion_port_, &bytes, &key, &overlapped, NextDebounceWait());
+            DWORD error = ok ? 0 : GetLastError();
+
+            if (!running_)
+                break;
+
+            if (overlapped != nullptr)
             {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
-                continue;
+                HandleCompletion(key, error, bytes);
             }
 
-            // Issue read requests for each watch
-            for (auto* entry : entries)
+            std::vector<std::shared_ptr<WatchEntry>> entries;
             {
-                DWORD filter = FILE_NOTIFY_CHANGE_FILE_NAME |
-                               FILE_NOTIFY_CHANGE_DIR_NAME |
-                               FILE_NOTIFY_CHANGE_ATTRIBUTES |
-                               FILE_NOTIFY_CHANGE_SIZE |
-                               FILE_NOTIFY_CHANGE_LAST_WRITE |
-                               FILE_NOTIFY_CHANGE_CREATION;
-
-                BOOL success = ReadDirectoryChangesW(
-                    entry->dir_handle,
-                    entry->buffer.data(),
-                    static_cast<DWORD>(entry->buffer.size()),
-                    entry->config.recursive ? TRUE : FALSE,
-                    filter,
-                    nullptr,
-                    &entry->overlapped,
-                    nullptr
-                );
-
-                if (!success)
-                {
-                    SPDLOG_ERROR("ReadDirectoryChangesW failed for: {}", entry->path.String());
-                }
+                std::lock_guard<std::mutex> lock(mutex_);
+                entries = watches_;
             }
-
-            // Wait for any changes
-            std::vector<HANDLE> events;
-            for (auto* entry : entries)
+            for (const auto& entry : entries)
             {
-                if (entry->overlapped.hEvent)
-                {
-                    events.push_back(entry->overlapped.hEvent);
-                }
+                DebounceAndNotify(*entry);
             }
+        }
+    }
 
-            if (events.empty())
-            {
-                std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    unsigned long FileWatch::NextDebounceWait() const
+    {
+        std::vector<std::shared_ptr<WatchEntry>> entries;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            entries = watches_;
+        }
+
+        auto now = std::chrono::steady_clock::now();
+        DWORD wait = INFINITE;
+        for (const auto& entry : entries)
+        {
+            std::lock_guard<std::mutex> lock(entry->event_mutex);
+            if (entry->pending_events.empty())
                 continue;
-            }
 
-            DWORD wait_result = WaitForMultipleObjects(
-                static_cast<DWORD>(events.size()),
-                events.data(),
-                FALSE,
-                100  // 100ms timeout for responsive shutdown
-            );
+            auto due = std::min(entry->last_event_time + entry->config.debounce_delay,
+                                entry->first_event_time + entry->config.max_batch_delay);
+            due = std::max(due, entry->last_delivery_time + entry->config.min_delivery_interval);
+            auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(due - now).count();
+            wait = std::min<DWORD>(wait, remaining > 0 ? static_cast<DWORD>(remaining) : 0);
+        }
+        return wait;
+    }
 
-            if (!running_)
-                break;
+    void FileWatch::HandleCompletion(size_t key, unsigned long error, unsigned long bytes)
+    {
+        std::shared_ptr<WatchEntry> entry;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
 
-            if (wait_result == WAIT_TIMEOUT)
+            auto retired = std::find_if(retiring_.begin(), retiring_.end(),
+                [key](const auto& candidate) { return candidate->handle == key; });
+            if (retired != retiring_.end())
             {
-                // Check for debounced events
-                for (auto* entry : entries)
-                {
-                    DebounceAndNotify(*entry);
-                }
-                continue;
+                // The cancelled read is done with the buffer; let it go
+                retiring_.erase(retired);
+                return;
             }
 
-            if (wait_result >= WAIT_OBJECT_0 && 
-                wait_result < WAIT_OBJECT_0 + events.size())
-            {
-                size_t index = wait_result - WAIT_OBJECT_0;
-                if (index < entries.size())
-                {
-                    ProcessChanges(*entries[index]);
-                    ResetEvent(entries[index]->overlapped.hEvent);
-                }
-            }
+            auto it = std::find_if(watches_.begin(), watches_.end(),
+                [key](const auto& candidate) { return candidate->handle == key; });
+            if (it == watches_.end())
+                return;
+            entry = *it;
+            entry->read_pending = false;
         }
-    }
 
-    void FileWatch::ProcessChanges(WatchEntry& entry)
-    {
-        DWORD bytes_returned = 0;
-        if (!GetOverlappedResult(entry.dir_handle, &entry.overlapped, &bytes_returned, FALSE))
+        if (error == ERROR_OPERATION_ABORTED)
+            return;
+
+        if (error != 0 && error != ERROR_NOTIFY_ENUM_DIR)
         {
+            // The directory went away or became unreadable; tell listeners
+            // and stop reading it
+            SPDLOG_WARN("Watch on {} failed ({}), stopping", entry->path.String(), error);
+            QueueEvent(*entry, FileChangeEvent(FileChangeType::Unknown, entry->path));
             return;
         }
 
-        if (bytes_returned == 0)
-            return;
+        if (error == ERROR_NOTIFY_ENUM_DIR || bytes == 0)
+        {
+            // The buffer overflowed and the individual changes are lost;
+            // report the watched directory itself so listeners rescan just it
+            static auto& overflows = core::Metrics::Get().GetCounter("opacity_filewatch_overflows_total");
+            overflows.Add();
+            QueueEvent(*entry, FileChangeEvent(FileChangeType::Unknown, entry->path));
+        }
+        else if (!paused_)
+        {
+            ProcessChanges(*entry, bytes);
+        }
 
-        FILE_NOTIFY_INFORMATION* info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(entry.buffer.data());
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (std::find(watches_.begin(), watches_.end(), entry) != watches_.end())
+        {
+            IssueRead(*entry);
+        }
+    }
+
+    void FileWatch::QueueEvent(WatchEntry& entry, const FileChangeEvent& event)
+    {
+        static auto& received = EventCounter("received");
+        static auto& dropped = EventCounter("dropped");
 
-        while (true)
+        if (entry.is_batch || entry.config.debounce_events)
         {
-            // Get the filename
-            std::wstring filename(info->FileName, info->FileNameLength / sizeof(wchar_t));
-            core::Path full_path = entry.path / core::Path(filename);
+            std::lock_guard<std::mutex> lock(entry.event_mutex);
+            auto now = std::chrono::steady_clock::now();
+            size_t threshold = entry.config.storm_threshold;
+            received_++;
+            received.Add();
+
+            // A storm lasts until a full window stays under the threshold
+            if (now - entry.window_start >= std::chrono::seconds(1))
+            {
+                entry.storm = threshold != 0 && entry.window_events > threshold &&
+                              now - entry.window_start < std::chrono::seconds(2);
+                entry.window_start = now;
+                entry.window_events = 0;
+            }
+            if (threshold != 0 && ++entry.window_events > threshold)
+            {
+                entry.storm = true;
+            }
 
-            // Determine change type
-            FileChangeType change_type = FileChangeType::Unknown;
-            switch (info->Action)
+            if (entry.pending_events.empty())
             {
-            case FILE_ACTION_ADDED:
-                change_type = FileChangeType::Created;
-                break;
-            case FILE_ACTION_REMOVED:
-                change_type = FileChangeType::Deleted;
-                break;
-            case FILE_ACTION_MODIFIED:
-                change_type = FileChangeType::Modified;
-                break;
-            case FILE_ACTION_RENAMED_OLD_NAME:
-            case FILE_ACTION_RENAMED_NEW_NAME:
-                change_type = FileChangeType::Renamed;
-                break;
+                entry.first_event_time = now;
             }
+            entry.last_event_time = now;
 
-            // Check if this file matches our filters
-            if (MatchesFilters(full_path.Filename(), entry.config))
+            if (!entry.storm)
             {
-                FileChangeEvent event(change_type, full_path);
+                entry.pending_events.push_back(event);
+                return;
+            }
 
-                if (entry.is_batch || entry.config.debounce_events)
-                {
-                    std::lock_guard<std::mutex> lock(entry.event_mutex);
-                    entry.pending_events.push_back(event);
-                    entry.last_event_time = std::chrono::steady_clock::now();
-                }
-                else if (entry.callback)
+            // Listeners rescan on an Unknown for the directory, which covers
+            // everything queued so far and everything until delivery
+            if (!entry.summary_pending)
+            {
+                dropped_ += entry.pending_events.size();
+                dropped.Add(entry.pending_events.size());
+                entry.pending_events.clear();
+                entry.pending_events.push_back(FileChangeEvent(FileChangeType::Unknown, entry.path));
+                entry.summary_pending = true;
+                summaries_++;
+            }
+            dropped_++;
+            dropped.Add();
+        }
+        else if (entry.callback)
+        {
+            entry.callback(event);
+        }
+    }
+
+    void FileWatch::ProcessChanges(WatchEntry& entry, unsigned long bytes)
+    {
+        // A rename arrives as an old-name record followed by a new-name
+        // record; they are reported as one event carrying both paths
+        core::Path renamed_from;
+
+        auto handle_record = [&](DWORD action, const wchar_t* name, DWORD name_bytes)
+        {
+            std::wstring filename(name, name_bytes / sizeof(wchar_t));
+            core::Path full_path = entry.path / core::Path(filename);
+
+            if (action == FILE_ACTION_RENAMED_OLD_NAME)
+            {
+                if (!renamed_from.Empty() && MatchesFilters(renamed_from.Filename(), entry.config))
+                    QueueEvent(entry, FileChangeEvent(FileChangeType::Renamed, renamed_from));
+                renamed_from = full_path;
+            }
+            else if (action == FILE_ACTION_RENAMED_NEW_NAME && !renamed_from.Empty())
+            {
+                if (MatchesFilters(full_path.Filename(), entry.config) ||
+                    MatchesFilters(renamed_from.Filename(), entry.config))
                 {
-                    entry.callback(event);
+                    QueueEvent(entry, FileChangeEvent(FileChangeType::Renamed, renamed_from, full_path));
                 }
+                renamed_from = core::Path();
+            }
+            else if (MatchesFilters(full_path.Filename(), entry.config))
+            {
+                // Check if this file matches our filters
+                QueueEvent(entry, FileChangeEvent(ToChangeType(action), full_path));
+            }
+        };
+
+        const BYTE* base = reinterpret_cast<const BYTE*>(entry.buffer.data());
+        const BYTE* end = base + std::min<size_t>(bytes, entry.buffer.size() * sizeof(DWORD));
+        const BYTE* record = base;
+        while (record < end)
+        {
+            DWORD next = 0;
+            if (entry.extended)
+            {
+                auto info = reinterpret_cast<const FILE_NOTIFY_EXTENDED_INFORMATION*>(record);
+                handle_record(info->Action, info->FileName, info->FileNameLength);
+                next = info->NextEntryOffset;
+            }
+            else
+            {
+                auto info = reinterpret_cast<const FILE_NOTIFY_INFORMATION*>(record);
+                handle_record(info->Action, info->FileName, info->FileNameLength);
+                next = info->NextEntryOffset;
             }
 
             // Move to next notification
-            if (info->NextEntryOffset == 0)
+            if (next == 0)
                 break;
+            record += next;
+        }
 
-            info = reinterpret_cast<FILE_NOTIFY_INFORMATION*>(
-                reinterpret_cast<BYTE*>(info) + info->NextEntryOffset);
+        // Renamed away without a new name here (moved out of the directory)
+        if (!renamed_from.Empty() && MatchesFilters(renamed_from.Filename(), entry.config))
+        {
+            QueueEvent(entry, FileChangeEvent(FileChangeType::Renamed, renamed_from));
         }
     }
 
@@ -468,15 +708,29 @@ namespace opacity::filesystem
             return;
 
         auto now = std::chrono::steady_clock::now();
-        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
-            now - entry.last_event_time);
 
-        if (elapsed < entry.config.debounce_delay)
+        // Wait for the burst to settle, but not forever while it keeps going
+        bool settled = now - entry.last_event_time >= entry.config.debounce_delay;
+        bool overdue = now - entry.first_event_time >= entry.config.max_batch_delay;
+        if (!settled && !overdue)
+            return;
+
+        if (now - entry.last_delivery_time < entry.config.min_delivery_interval)
             return;
 
         // Time to notify
         std::vector<FileChangeEvent> events = std::move(entry.pending_events);
         entry.pending_events.clear();
+        entry.summary_pending = false;
+        entry.last_delivery_time = now;
+
+        if (entry.config.coalesce_events)
+        {
+            events = Coalesce(entry.path, std::move(events));
+        }
+        delivered_ += events.size();
+        static auto& delivered = EventCounter("delivered");
+        delivered.Add(events.size());
 
         if (entry.is_batch && entry.batch_callback)
         {
@@ -491,4 +745,123 @@ namespace opacity::filesystem
         }
     }
 
+    std::vector<FileChangeEvent> FileWatch::Coalesce(const core::Path& directory, std::vector<FileChangeEvent> events)
+    {
+        // Listeners rescan the whole directory for this, so nothing else matters
+        for (const auto& event : events)
+        {
+            if (event.type == FileChangeType::Unknown && PathKey(event.path) == PathKey(directory))
+            {
+                merged_ += events.size() - 1;
+                return {event};
+            }
+        }
+
+        // Each path maps to the one event describing what happened to it so
+        // far; later events fold into that one where the net effect allows
+        std::vector<bool> live(events.size(), true);
+        std::unordered_map<std::string, size_t> latest;
+
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            FileChangeEvent& event = events[i];
+
+            if (event.type == FileChangeType::Renamed && !event.old_path.Empty())
+            {
+                auto prior = latest.find(PathKey(event.old_path));
+                if (prior != latest.end())
+                {
+                    size_t index = prior->second;
+                    FileChangeEvent& earlier = events[index];
+                    bool moved_here = earlier.type == FileChangeType::Renamed && !earlier.old_path.Empty();
+
+                    if (earlier.type == FileChangeType::Created || moved_here)
+                    {
+                        // Created then renamed is a create of the new name;
+                        // a -> b -> c is a -> c
+                        earlier.path = event.path;
+                        if (moved_here && PathKey(earlier.old_path) == PathKey(earlier.path))
+                        {
+                            earlier.type = FileChangeType::Modified;
+                            earlier.old_path = core::Path();
+                        }
+                        live[i] = false;
+                        latest.erase(prior);
+                        latest[PathKey(earlier.path)] = index;
+                        merged_++;
+                        continue;
+                    }
+                    if (earlier.type == FileChangeType::Modified)
+                    {
+                        // The rename makes listeners re-read the item anyway
+                        live[index] = false;
+                        latest.erase(prior);
+                        merged_++;
+                    }
+                }
+                latest[PathKey(event.path)] = i;
+                continue;
+            }
+
+            std::string key = PathKey(event.path);
+            auto prior = latest.find(key);
+            if (prior == latest.end())
+            {
+                latest[key] = i;
+                continue;
+            }
+
+            size_t index = prior->second;
+            FileChangeEvent& earlier = events[index];
+            bool gone = IsGone(event);
+            live[i] = false;
+            merged_++;
+
+            if (IsGone(earlier))
+            {
+                // Removed and back again: the item was replaced
+                if (!gone)
+                    earlier.type = FileChangeType::Modified;
+            }
+            else if (earlier.type == FileChangeType::Created)
+            {
+                // Came and went within the batch; nobody needs to hear of it
+                if (gone)
+                {
+                    live[index] = false;
+                    latest.erase(prior);
+                    merged_++;
+                }
+            }
+            else if (earlier.type == FileChangeType::Modified)
+            {
+                if (gone)
+                    earlier.type = event.type;
+            }
+            else if (earlier.type == FileChangeType::Renamed && gone)
+            {
+                // Moved here and then removed: only the old name's loss is visible
+                earlier = FileChangeEvent(event.type, earlier.old_path);
+                latest.erase(prior);
+                latest[PathKey(earlier.path)] = index;
+            }
+            else if (earlier.type != FileChangeType::Renamed)
+            {
+                // Nothing to fold into (an Unknown for a child)
+                live[i] = true;
+                merged_--;
+                latest[key] = i;
+            }
+        }
+
+        std::vector<FileChangeEvent> coalesced;
+        coalesced.reserve(events.size());
+        for (size_t i = 0; i < events.size(); ++i)
+        {
+            if (live[i])
+                coalesced.push_back(std::move(events[i]));
+        }
+        return coalesced;
+    }
+
 } // namespace opacity::filesystem
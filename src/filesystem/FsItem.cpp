@@ -1,12 +1,14 @@
 #include "opacity/filesystem/FsItem.h"
+#include "opacity/filesystem/FileTypes.h"
+#include "opacity/filesystem/ItemStore.h"
 #include <sstream>
 #include <iomanip>
 #include <ctime>
 #include <cctype>
 #include <unordered_map>
-#include <unordered_set>
-#include <regex>
 #include <algorithm>
+#include <string_view>
+#include <thread>
 
 namespace opacity::filesystem
 {
@@ -17,68 +19,14 @@ namespace opacity::filesystem
 
 FileType DetermineFileType(const std::string& filename)
 {
-    // Get extension
     auto pos = filename.rfind('.');
     if (pos == std::string::npos || pos == 0)
     {
         return FileType::Unknown;
     }
 
-    std::string ext = filename.substr(pos + 1);
-    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-
-    // Image formats
-    static const std::unordered_set<std::string> image_exts = {
-        "jpg", "jpeg", "png", "gif", "bmp", "ico", "tiff", "tif", 
-        "webp", "svg", "psd", "raw", "heic", "heif"
-    };
-
-    // Audio formats
-    static const std::unordered_set<std::string> audio_exts = {
-        "mp3", "wav", "flac", "aac", "ogg", "wma", "m4a", "opus"
-    };
-
-    // Video formats
-    static const std::unordered_set<std::string> video_exts = {
-        "mp4", "avi", "mkv", "mov", "wmv", "flv", "webm", "m4v", "mpeg", "mpg"
-    };
-
-    // Archive formats
-    static const std::unordered_set<std::string> archive_exts = {
-        "zip", "rar", "7z", "tar", "gz", "bz2", "xz", "cab", "iso"
-    };
-
-    // Document formats
-    static const std::unordered_set<std::string> document_exts = {
-        "pdf", "doc", "docx", "xls", "xlsx", "ppt", "pptx", "odt", "ods", "odp", "rtf"
-    };
-
-    // Code formats
-    static const std::unordered_set<std::string> code_exts = {
-        "cpp", "c", "h", "hpp", "cs", "java", "py", "js", "ts", "html", "css",
-        "php", "rb", "go", "rs", "swift", "kt", "scala", "lua", "sh", "bash", "ps1"
-    };
-
-    // Text formats
-    static const std::unordered_set<std::string> text_exts = {
-        "txt", "md", "log", "cfg", "ini", "json", "xml", "yaml", "yml", "csv"
-    };
-
-    // Executable formats
-    static const std::unordered_set<std::string> exe_exts = {
-        "exe", "dll", "sys", "msi", "bat", "cmd", "com"
-    };
-
-    if (image_exts.count(ext)) return FileType::Image;
-    if (audio_exts.count(ext)) return FileType::Audio;
-    if (video_exts.count(ext)) return FileType::Video;
-    if (archive_exts.count(ext)) return FileType::Archive;
-    if (document_exts.count(ext)) return FileType::Document;
-    if (code_exts.count(ext)) return FileType::Code;
-    if (text_exts.count(ext)) return FileType::Text;
-    if (exe_exts.count(ext)) return FileType::Executable;
-
-    return FileType::Unknown;
+    const ExtensionInfo* info = LookupExtension(std::string_view(filename).substr(pos + 1));
+    return info ? info->type : FileType::Unknown;
 }
 
 // ============================================================================
@@ -91,49 +39,128 @@ std::string FsItem::GetFormattedSize() const
     {
         return "";  // Don't show size for directories
     }
-
-    const char* units[] = {"B", "KB", "MB", "GB", "TB", "PB"};
-    double display_size = static_cast<double>(size);
-    int unit_index = 0;
-
-    while (display_size >= 1024.0 && unit_index < 5)
-    {
-        display_size /= 1024.0;
-        unit_index++;
-    }
-
-    std::ostringstream oss;
-    if (unit_index == 0)
-    {
-        oss << size << " " << units[unit_index];
-    }
-    else
-    {
-        oss << std::fixed << std::setprecision(1) << display_size << " " << units[unit_index];
-    }
-    return oss.str();
+    return FsItemUtils::FormatSize(size);
 }
 
 std::string FsItem::GetFormattedModifiedDate() const
 {
-    auto time_t_val = std::chrono::system_clock::to_time_t(modified);
-    std::tm tm_val;
-    localtime_s(&tm_val, &time_t_val);
-    
-    std::ostringstream oss;
-    oss << std::put_time(&tm_val, "%Y-%m-%d %H:%M");
-    return oss.str();
+    return FsItemUtils::FormatDate(modified);
 }
 
 std::string FsItem::GetFormattedCreatedDate() const
 {
-    auto time_t_val = std::chrono::system_clock::to_time_t(created);
-    std::tm tm_val;
-    localtime_s(&tm_val, &time_t_val);
-    
-    std::ostringstream oss;
-    oss << std::put_time(&tm_val, "%Y-%m-%d %H:%M");
-    return oss.str();
+    return FsItemUtils::FormatDate(created);
+}
+
+namespace
+{
+    // Known description for an extension, or nullptr
+    const std::string* FindTypeDescription(const std::string& extension)
+    {
+        // Common file type descriptions
+        static const std::unordered_map<std::string, std::string> type_descriptions = {
+            // Text files
+            {"txt", "Text Document"},
+            {"md", "Markdown Document"},
+            {"log", "Log File"},
+            {"csv", "CSV File"},
+            {"json", "JSON File"},
+            {"xml", "XML File"},
+            {"yaml", "YAML File"},
+            {"yml", "YAML File"},
+            
+            // Code files
+            {"cpp", "C++ Source File"},
+            {"c", "C Source File"},
+            {"h", "C/C++ Header"},
+            {"hpp", "C++ Header"},
+            {"cs", "C# Source File"},
+            {"py", "Python Script"},
+            {"js", "JavaScript File"},
+            {"ts", "TypeScript File"},
+            {"java", "Java Source File"},
+            {"rs", "Rust Source File"},
+            {"go", "Go Source File"},
+            {"rb", "Ruby Script"},
+            {"php", "PHP File"},
+            {"html", "HTML Document"},
+            {"htm", "HTML Document"},
+            {"css", "CSS Stylesheet"},
+            {"sql", "SQL Script"},
+            
+            // Image files
+            {"jpg", "JPEG Image"},
+            {"jpeg", "JPEG Image"},
+            {"png", "PNG Image"},
+            {"gif", "GIF Image"},
+            {"bmp", "Bitmap Image"},
+            {"ico", "Icon File"},
+            {"svg", "SVG Image"},
+            {"webp", "WebP Image"},
+            {"tiff", "TIFF Image"},
+            {"tif", "TIFF Image"},
+            {"psd", "Photoshop Document"},
+            
+            // Audio files
+            {"mp3", "MP3 Audio"},
+            {"wav", "WAV Audio"},
+            {"flac", "FLAC Audio"},
+            {"ogg", "OGG Audio"},
+            {"m4a", "M4A Audio"},
+            {"wma", "WMA Audio"},
+            
+            // Video files
+            {"mp4", "MP4 Video"},
+            {"mkv", "MKV Video"},
+            {"avi", "AVI Video"},
+            {"mov", "QuickTime Video"},
+            {"wmv", "WMV Video"},
+            {"webm", "WebM Video"},
+            
+            // Document files
+            {"pdf", "PDF Document"},
+            {"doc", "Word Document"},
+            {"docx", "Word Document"},
+            {"xls", "Excel Spreadsheet"},
+            {"xlsx", "Excel Spreadsheet"},
+            {"ppt", "PowerPoint Presentation"},
+            {"pptx", "PowerPoint Presentation"},
+            {"odt", "OpenDocument Text"},
+            {"ods", "OpenDocument Spreadsheet"},
+            
+            // Archive files
+            {"zip", "ZIP Archive"},
+            {"rar", "RAR Archive"},
+            {"7z", "7-Zip Archive"},
+            {"tar", "TAR Archive"},
+            {"gz", "GZip Archive"},
+            {"bz2", "BZip2 Archive"},
+            
+            // Executable files
+            {"exe", "Application"},
+            {"dll", "Dynamic Link Library"},
+            {"msi", "Windows Installer"},
+            {"bat", "Batch File"},
+            {"cmd", "Command Script"},
+            {"ps1", "PowerShell Script"},
+            {"sh", "Shell Script"},
+            
+            // Config files
+            {"ini", "Configuration File"},
+            {"cfg", "Configuration File"},
+            {"conf", "Configuration File"},
+            {"reg", "Registry File"},
+            
+            // Other
+            {"iso", "Disc Image"},
+            {"img", "Disk Image"},
+            {"vhd", "Virtual Hard Disk"},
+            {"vmdk", "VMware Disk"},
+        };
+
+        auto it = type_descriptions.find(extension);
+        return it != type_descriptions.end() ? &it->second : nullptr;
+    }
 }
 
 std::string FsItem::GetTypeDescription() const
@@ -148,111 +175,9 @@ std::string FsItem::GetTypeDescription() const
         return "File";
     }
 
-    // Common file type descriptions
-    static const std::unordered_map<std::string, std::string> type_descriptions = {
-        // Text files
-        {"txt", "Text Document"},
-        {"md", "Markdown Document"},
-        {"log", "Log File"},
-        {"csv", "CSV File"},
-        {"json", "JSON File"},
-        {"xml", "XML File"},
-        {"yaml", "YAML File"},
-        {"yml", "YAML File"},
-        
-        // Code files
-        {"cpp", "C++ Source File"},
-        {"c", "C Source File"},
-        {"h", "C/C++ Header"},
-        {"hpp", "C++ Header"},
-        {"cs", "C# Source File"},
-        {"py", "Python Script"},
-        {"js", "JavaScript File"},
-        {"ts", "TypeScript File"},
-        {"java", "Java Source File"},
-        {"rs", "Rust Source File"},
-        {"go", "Go Source File"},
-        {"rb", "Ruby Script"},
-        {"php", "PHP File"},
-        {"html", "HTML Document"},
-        {"htm", "HTML Document"},
-        {"css", "CSS Stylesheet"},
-        {"sql", "SQL Script"},
-        
-        // Image files
-        {"jpg", "JPEG Image"},
-        {"jpeg", "JPEG Image"},
-        {"png", "PNG Image"},
-        {"gif", "GIF Image"},
-        {"bmp", "Bitmap Image"},
-        {"ico", "Icon File"},
-        {"svg", "SVG Image"},
-        {"webp", "WebP Image"},
-        {"tiff", "TIFF Image"},
-        {"tif", "TIFF Image"},
-        {"psd", "Photoshop Document"},
-        
-        // Audio files
-        {"mp3", "MP3 Audio"},
-        {"wav", "WAV Audio"},
-        {"flac", "FLAC Audio"},
-        {"ogg", "OGG Audio"},
-        {"m4a", "M4A Audio"},
-        {"wma", "WMA Audio"},
-        
-        // Video files
-        {"mp4", "MP4 Video"},
-        {"mkv", "MKV Video"},
-        {"avi", "AVI Video"},
-        {"mov", "QuickTime Video"},
-        {"wmv", "WMV Video"},
-        {"webm", "WebM Video"},
-        
-        // Document files
-        {"pdf", "PDF Document"},
-        {"doc", "Word Document"},
-        {"docx", "Word Document"},
-        {"xls", "Excel Spreadsheet"},
-        {"xlsx", "Excel Spreadsheet"},
-        {"ppt", "PowerPoint Presentation"},
-        {"pptx", "PowerPoint Presentation"},
-        {"odt", "OpenDocument Text"},
-        {"ods", "OpenDocument Spreadsheet"},
-        
-        // Archive files
-        {"zip", "ZIP Archive"},
-        {"rar", "RAR Archive"},
-        {"7z", "7-Zip Archive"},
-        {"tar", "TAR Archive"},
-        {"gz", "GZip Archive"},
-        {"bz2", "BZip2 Archive"},
-        
-        // Executable files
-        {"exe", "Application"},
-        {"dll", "Dynamic Link Library"},
-        {"msi", "Windows Installer"},
-        {"bat", "Batch File"},
-        {"cmd", "Command Script"},
-        {"ps1", "PowerShell Script"},
-        {"sh", "Shell Script"},
-        
-        // Config files
-        {"ini", "Configuration File"},
-        {"cfg", "Configuration File"},
-        {"conf", "Configuration File"},
-        {"reg", "Registry File"},
-        
-        // Other
-        {"iso", "Disc Image"},
-        {"img", "Disk Image"},
-        {"vhd", "Virtual Hard Disk"},
-        {"vmdk", "VMware Disk"},
-    };
-
-    auto it = type_descriptions.find(extension);
-    if (it != type_descriptions.end())
+    if (const std::string* description = FindTypeDescription(extension))
     {
-        return it->second;
+        return *description;
     }
 
     // Default: uppercase extension + "File"
@@ -264,10 +189,51 @@ std::string FsItem::GetTypeDescription() const
     return upper_ext + " File";
 }
 
+std::string FsItem::GetMimeType() const
+{
+    if (!mime_type.empty())
+    {
+        return mime_type;
+    }
+    return FsItemUtils::GetMimeType(extension);
+}
+
 // ============================================================================
 // FsItemComparator Implementation
 // ============================================================================
 
+namespace
+{
+    // std::tolower in the "C" locale the app runs in, without the call
+    unsigned char FoldAscii(char c)
+    {
+        auto byte = static_cast<unsigned char>(c);
+        return (byte >= 'A' && byte <= 'Z') ? static_cast<unsigned char>(byte + ('a' - 'A')) : byte;
+    }
+
+    // Case-insensitive (ASCII) order without lowercased copies
+    int CompareFolded(std::string_view a, std::string_view b)
+    {
+        size_t length = std::min(a.size(), b.size());
+        for (size_t i = 0; i < length; ++i)
+        {
+            int ca = FoldAscii(a[i]);
+            int cb = FoldAscii(b[i]);
+            if (ca != cb)
+            {
+                return ca < cb ? -1 : 1;
+            }
+        }
+        return a.size() == b.size() ? 0 : (a.size() < b.size() ? -1 : 1);
+    }
+
+    template <typename T>
+    int CompareValues(const T& a, const T& b)
+    {
+        return a < b ? -1 : (b < a ? 1 : 0);
+    }
+}
+
 FsItemComparator::FsItemComparator(SortColumn column, SortDirection direction, bool folders_first)
     : column_(column)
     , direction_(direction)
@@ -289,13 +255,7 @@ bool FsItemComparator::operator()(const FsItem& a, const FsItem& b) const
     {
     case SortColumn::Name:
         // Case-insensitive comparison
-        {
-            std::string a_lower = a.name;
-            std::string b_lower = b.name;
-            for (char& c : a_lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
-            for (char& c : b_lower) c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
-            cmp = a_lower.compare(b_lower);
-        }
+        cmp = CompareFolded(a.name, b.name);
         break;
         
     case SortColumn::Size:
@@ -306,9 +266,18 @@ bool FsItemComparator::operator()(const FsItem& a, const FsItem& b) const
         
     case SortColumn::Type:
         {
-            std::string a_type = a.GetTypeDescription();
-            std::string b_type = b.GetTypeDescription();
-            cmp = a_type.compare(b_type);
+            // Known types compare their table entries directly; only folders,
+            // extensionless and unknown types build the description
+            const std::string* a_known = a.is_directory || a.extension.empty() ? nullptr : FindTypeDescription(a.extension);
+            const std::string* b_known = b.is_directory || b.extension.empty() ? nullptr : FindTypeDescription(b.extension);
+            if (a_known && b_known)
+            {
+                cmp = a_known->compare(*b_known);
+            }
+            else
+            {
+                cmp = (a_known ? *a_known : a.GetTypeDescription()).compare(b_known ? *b_known : b.GetTypeDescription());
+            }
         }
         break;
         
@@ -334,79 +303,609 @@ bool FsItemComparator::operator()(const FsItem& a, const FsItem& b) const
     return cmp < 0;
 }
 
+bool FsItemComparator::operator()(const ItemStore& store, uint32_t a, uint32_t b) const
+{
+    bool a_directory = store.IsDirectory(a);
+    bool b_directory = store.IsDirectory(b);
+    if (folders_first_ && a_directory != b_directory)
+    {
+        return a_directory;
+    }
+
+    int cmp = 0;
+
+    switch (column_)
+    {
+    case SortColumn::Name:
+        cmp = CompareFolded(store.Name(a), store.Name(b));
+        break;
+
+    case SortColumn::Size:
+        cmp = CompareValues(store.FileSize(a), store.FileSize(b));
+        break;
+
+    case SortColumn::Type:
+        // Descriptions are interned, so equal extensions skip the compare
+        if (a_directory != b_directory || store.ExtensionId(a) != store.ExtensionId(b))
+        {
+            cmp = store.TypeDescription(a).compare(store.TypeDescription(b));
+        }
+        break;
+
+    case SortColumn::DateModified:
+        cmp = CompareValues(store.ModifiedTicks(a), store.ModifiedTicks(b));
+        break;
+
+    case SortColumn::DateCreated:
+        cmp = CompareValues(store.CreatedTicks(a), store.CreatedTicks(b));
+        break;
+    }
+
+    if (direction_ == SortDirection::Descending)
+    {
+        cmp = -cmp;
+    }
+
+    return cmp < 0;
+}
+
 // ============================================================================
 // FsItemUtils Implementation
 // ============================================================================
 
-namespace FsItemUtils
+namespace
 {
+    // Below this many items a plain comparison sort beats the radix passes
+    constexpr size_t kRadixMinimum = 512;
 
-void Sort(std::vector<FsItem>& items, const FsItemComparator& comparator)
-{
-    std::sort(items.begin(), items.end(), comparator);
-}
+    // Lists this long are sorted in chunks on several threads and merged
+    constexpr size_t kParallelMinimum = 1 << 17;
+    constexpr unsigned kMaxSortThreads = 8;
 
-std::vector<FsItem> FilterByName(const std::vector<FsItem>& items, const std::string& pattern)
-{
-    if (pattern.empty() || pattern == "*")
+    struct SortRecord
     {
-        return items;
+        uint64_t key;           // Orders the records; complemented for descending
+        uint32_t position;      // Index into the list being sorted
+    };
+
+    // Case-folded copies of the names, built once per Name sort and only
+    // read when two records share a key
+    class FoldedNames
+    {
+    public:
+        void Reserve(size_t count)
+        {
+            arena_.reserve(count * 16);
+            offsets_.reserve(count + 1);
+        }
+
+        void Add(std::string_view name)
+        {
+            size_t start = arena_.size();
+            arena_.append(name);
+            for (size_t i = start; i < arena_.size(); ++i)
+            {
+                arena_[i] = static_cast<char>(FoldAscii(arena_[i]));
+            }
+            offsets_.push_back(static_cast<uint32_t>(arena_.size()));
+        }
+
+        std::string_view Get(uint32_t position) const
+        {
+            return std::string_view(arena_).substr(offsets_[position], offsets_[position + 1] - offsets_[position]);
+        }
+
+        // Folded bytes [8 * depth, 8 * depth + 8), big-endian and zero
+        // padded, so keys order like the names they were cut from
+        uint64_t ChunkKey(uint32_t position, size_t depth) const
+        {
+            std::string_view name = Get(position);
+            uint64_t key = 0;
+            for (size_t i = depth * 8; i < depth * 8 + 8; ++i)
+            {
+                key = (key << 8) | (i < name.size() ? static_cast<unsigned char>(name[i]) : 0u);
+            }
+            return key;
+        }
+
+    private:
+        std::string arena_;
+        std::vector<uint32_t> offsets_{0};
+    };
+
+    uint64_t SignedKey(int64_t value)
+    {
+        return static_cast<uint64_t>(value) ^ (uint64_t{1} << 63);
+    }
+
+    // Rank of each value among the distinct values, in string order. Lists
+    // hold few distinct types, so only those get sorted.
+    std::vector<uint32_t> RankStrings(const std::vector<std::string_view>& values)
+    {
+        std::unordered_map<std::string_view, uint32_t> ids;
+        std::vector<std::string_view> distinct;
+        std::vector<uint32_t> ranks;
+        ranks.reserve(values.size());
+        for (std::string_view value : values)
+        {
+            auto inserted = ids.emplace(value, static_cast<uint32_t>(distinct.size()));
+            if (inserted.second)
+            {
+                distinct.push_back(value);
+            }
+            ranks.push_back(inserted.first->second);
+        }
+
+        std::vector<uint32_t> by_value(distinct.size());
+        for (uint32_t id = 0; id < by_value.size(); ++id)
+        {
+            by_value[id] = id;
+        }
+        std::sort(by_value.begin(), by_value.end(),
+            [&distinct](uint32_t a, uint32_t b) { return distinct[a] < distinct[b]; });
+
+        std::vector<uint32_t> rank_of_id(distinct.size());
+        for (uint32_t rank = 0; rank < by_value.size(); ++rank)
+        {
+            rank_of_id[by_value[rank]] = rank;
+        }
+        for (uint32_t& rank : ranks)
+        {
+            rank = rank_of_id[rank];
+        }
+        return ranks;
     }
 
-    // Convert wildcard pattern to regex
-    std::string regex_pattern;
-    for (char c : pattern)
+    /**
+     * Sorts records by key with an LSD radix sort, then settles runs of
+     * equal keys by full folded name when sorting by name. Each record's key
+     * is computed once up front, so no comparison re-derives anything.
+     */
+    class KeyedSort
     {
-        switch (c)
+    public:
+        KeyedSort(const FoldedNames* names, bool descending)
+            : names_(names)
+            , descending_(descending)
+        {
+        }
+
+        void Run(SortRecord* first, SortRecord* last) const
         {
-        case '*':
-            regex_pattern += ".*";
+            size_t count = static_cast<size_t>(last - first);
+            std::vector<SortRecord> scratch(count);
+
+            unsigned threads = 1;
+            if (count >= kParallelMinimum)
+            {
+                threads = std::min(kMaxSortThreads, std::max(1u, std::thread::hardware_concurrency()));
+            }
+            if (threads <= 1)
+            {
+                SortRange(first, last, scratch.data());
+                return;
+            }
+
+            std::vector<SortRecord*> bounds;
+            for (unsigned t = 0; t <= threads; ++t)
+            {
+                bounds.push_back(first + count * t / threads);
+            }
+
+            std::vector<std::thread> workers;
+            for (unsigned t = 0; t < threads; ++t)
+            {
+                workers.emplace_back([this, &bounds, &scratch, first, t]()
+                {
+                    SortRange(bounds[t], bounds[t + 1], scratch.data() + (bounds[t] - first));
+                });
+            }
+            for (auto& worker : workers)
+            {
+                worker.join();
+            }
+
+            // Merge neighbouring chunks pairwise until one run is left
+            for (unsigned width = 1; width < threads; width *= 2)
+            {
+                workers.clear();
+                for (unsigned t = 0; t + width < threads; t += 2 * width)
+                {
+                    SortRecord* low = bounds[t];
+                    SortRecord* middle = bounds[t + width];
+                    SortRecord* high = bounds[std::min(t + 2 * width, threads)];
+                    SortRecord* out = scratch.data() + (low - first);
+                    workers.emplace_back([this, low, middle, high, out]()
+                    {
+                        std::merge(low, middle, middle, high, out,
+                            [this](const SortRecord& a, const SortRecord& b) { return Less(a, b); });
+                        std::copy(out, out + (high - low), low);
+                    });
+                }
+                for (auto& worker : workers)
+                {
+                    worker.join();
+                }
+            }
+        }
+
+    private:
+        bool Less(const SortRecord& a, const SortRecord& b) const
+        {
+            if (a.key != b.key)
+            {
+                return a.key < b.key;
+            }
+            if (!names_)
+            {
+                return false;
+            }
+            return descending_ ? names_->Get(b.position) < names_->Get(a.position)
+                               : names_->Get(a.position) < names_->Get(b.position);
+        }
+
+        void SortRange(SortRecord* first, SortRecord* last, SortRecord* scratch) const
+        {
+            if (static_cast<size_t>(last - first) < kRadixMinimum)
+            {
+                std::sort(first, last, [this](const SortRecord& a, const SortRecord& b) { return Less(a, b); });
+                return;
+            }
+
+            RadixSort(first, last, scratch);
+            if (names_)
+            {
+                ResolveTies(first, last, scratch, 0);
+            }
+        }
+
+        static void RadixSort(SortRecord* first, SortRecord* last, SortRecord* scratch)
+        {
+            size_t count = static_cast<size_t>(last - first);
+
+            // Bytes every key shares (the high bytes of sizes and dates,
+            // mostly) need no pass
+            uint64_t any_set = 0;
+            uint64_t all_set = ~uint64_t{0};
+            for (const SortRecord* record = first; record != last; ++record)
+            {
+                any_set |= record->key;
+                all_set &= record->key;
+            }
+            uint64_t varying = any_set ^ all_set;
+
+            SortRecord* from = first;
+            SortRecord* to = scratch;
+            for (unsigned shift = 0; shift < 64; shift += 8)
+            {
+                if (((varying >> shift) & 0xFF) == 0)
+                {
+                    continue;
+                }
+
+                size_t offsets[256] = {};
+                for (size_t i = 0; i < count; ++i)
+                {
+                    offsets[(from[i].key >> shift) & 0xFF]++;
+                }
+                size_t total = 0;
+                for (size_t& offset : offsets)
+                {
+                    size_t bucket = offset;
+                    offset = total;
+                    total += bucket;
+                }
+                for (size_t i = 0; i < count; ++i)
+                {
+                    to[offsets[(from[i].key >> shift) & 0xFF]++] = from[i];
+                }
+                std::swap(from, to);
+            }
+
+            if (from != first)
+            {
+                std::copy(from, from + count, first);
+            }
+        }
+
+        // Records here are sorted by name chunk `depth`; order each run that
+        // shares it. Long runs (common prefixes such as "IMG_2024") radix on
+        // the next chunk instead of falling back to full string compares.
+        void ResolveTies(SortRecord* first, SortRecord* last, SortRecord* scratch, size_t depth) const
+        {
+            while (first != last)
+            {
+                SortRecord* run_end = first + 1;
+                while (run_end != last && run_end->key == first->key)
+                {
+                    ++run_end;
+                }
+
+                size_t run_length = static_cast<size_t>(run_end - first);
+                if (run_length >= kRadixMinimum && HasChunk(first, run_end, depth + 1))
+                {
+                    uint64_t run_key = first->key;
+                    for (SortRecord* record = first; record != run_end; ++record)
+                    {
+                        record->key = ChunkKey(record->position, depth + 1);
+                    }
+                    RadixSort(first, run_end, scratch);
+                    ResolveTies(first, run_end, scratch, depth + 1);
+
+                    // Merging chunks compares the first-level keys
+                    for (SortRecord* record = first; record != run_end; ++record)
+                    {
+                        record->key = run_key;
+                    }
+                }
+                else if (run_length > 1)
+                {
+                    std::sort(first, run_end, [this](const SortRecord& a, const SortRecord& b) { return Less(a, b); });
+                }
+                first = run_end;
+            }
+        }
+
+        // Whether any name in the run is longer than `depth` chunks; if none
+        // is, the run holds equal names
+        bool HasChunk(const SortRecord* first, const SortRecord* last, size_t depth) const
+        {
+            for (const SortRecord* record = first; record != last; ++record)
+            {
+                if (names_->Get(record->position).size() > depth * 8)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        uint64_t ChunkKey(uint32_t position, size_t depth) const
+        {
+            uint64_t key = names_->ChunkKey(position, depth);
+            return descending_ ? ~key : key;
+        }
+
+        const FoldedNames* names_;
+        bool descending_;
+    };
+
+    /**
+     * Builds a key per item and sorts; returns positions in sorted order.
+     * Source adapts FsItems or an ItemStore view to the same accessors.
+     */
+    template <typename Source>
+    std::vector<SortRecord> SortByKeys(const Source& source, size_t count, const FsItemComparator& comparator)
+    {
+        std::vector<SortRecord> records(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            records[i].position = static_cast<uint32_t>(i);
+        }
+
+        FoldedNames names;
+        bool by_name = comparator.GetColumn() == SortColumn::Name;
+
+        switch (comparator.GetColumn())
+        {
+        case SortColumn::Name:
+            names.Reserve(count);
+            for (size_t i = 0; i < count; ++i)
+            {
+                names.Add(source.Name(i));
+                records[i].key = names.ChunkKey(static_cast<uint32_t>(i), 0);
+            }
             break;
-        case '?':
-            regex_pattern += ".";
+
+        case SortColumn::Size:
+            for (size_t i = 0; i < count; ++i)
+            {
+                records[i].key = source.Size(i);
+            }
             break;
-        case '.':
-        case '+':
-        case '^':
-        case '$':
-        case '(':
-        case ')':
-        case '[':
-        case ']':
-        case '{':
-        case '}':
-        case '|':
-        case '\\':
-            regex_pattern += '\\';
-            regex_pattern += c;
+
+        case SortColumn::Type:
+            {
+                std::vector<std::string_view> descriptions;
+                descriptions.reserve(count);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    descriptions.push_back(source.TypeDescription(i));
+                }
+                std::vector<uint32_t> ranks = RankStrings(descriptions);
+                for (size_t i = 0; i < count; ++i)
+                {
+                    records[i].key = ranks[i];
+                }
+            }
             break;
-        default:
-            regex_pattern += c;
+
+        case SortColumn::DateModified:
+            for (size_t i = 0; i < count; ++i)
+            {
+                records[i].key = SignedKey(source.ModifiedTicks(i));
+            }
             break;
+
+        case SortColumn::DateCreated:
+            for (size_t i = 0; i < count; ++i)
+            {
+                records[i].key = SignedKey(source.CreatedTicks(i));
+            }
+            break;
+        }
+
+        bool descending = comparator.GetDirection() == SortDirection::Descending;
+        if (descending)
+        {
+            for (auto& record : records)
+            {
+                record.key = ~record.key;
+            }
+        }
+
+        // Folders and files sort as two separate lists
+        SortRecord* split = records.data();
+        if (comparator.GetFoldersFirst())
+        {
+            split = std::partition(records.data(), records.data() + count,
+                [&source](const SortRecord& record) { return source.IsDirectory(record.position); });
         }
+
+        KeyedSort sorter(by_name ? &names : nullptr, descending);
+        sorter.Run(records.data(), split);
+        sorter.Run(split, records.data() + count);
+        return records;
     }
 
-    std::vector<FsItem> result;
-    try
+    int64_t TimeTicks(std::chrono::system_clock::time_point time)
+    {
+        return static_cast<int64_t>(time.time_since_epoch().count());
+    }
+
+    struct ItemListSource
+    {
+        const std::vector<FsItem>& items;
+        std::vector<std::string> descriptions;
+
+        std::string_view Name(size_t i) const { return items[i].name; }
+        uint64_t Size(size_t i) const { return items[i].size; }
+        std::string_view TypeDescription(size_t i) const { return descriptions[i]; }
+        int64_t ModifiedTicks(size_t i) const { return TimeTicks(items[i].modified); }
+        int64_t CreatedTicks(size_t i) const { return TimeTicks(items[i].created); }
+        bool IsDirectory(size_t i) const { return items[i].is_directory; }
+    };
+
+    struct StoreViewSource
+    {
+        const ItemStore& store;
+        const std::vector<uint32_t>& order;
+
+        std::string_view Name(size_t i) const { return store.Name(order[i]); }
+        uint64_t Size(size_t i) const { return store.FileSize(order[i]); }
+        std::string_view TypeDescription(size_t i) const { return store.TypeDescription(order[i]); }
+        int64_t ModifiedTicks(size_t i) const { return store.ModifiedTicks(order[i]); }
+        int64_t CreatedTicks(size_t i) const { return store.CreatedTicks(order[i]); }
+        bool IsDirectory(size_t i) const { return store.IsDirectory(order[i]); }
+    };
+}
+
+namespace FsItemUtils
+{
+
+void Sort(std::vector<FsItem>& items, const FsItemComparator& comparator)
+{
+    ItemListSource source{items, {}};
+    if (comparator.GetColumn() == SortColumn::Type)
     {
-        std::regex re(regex_pattern, std::regex::icase);
+        // Worked out once per item rather than once per comparison
+        source.descriptions.reserve(items.size());
         for (const auto& item : items)
         {
-            if (std::regex_match(item.name, re))
-            {
-                result.push_back(item);
-            }
+            source.descriptions.push_back(item.GetTypeDescription());
         }
     }
-    catch (const std::regex_error&)
+
+    std::vector<SortRecord> records = SortByKeys(source, items.size(), comparator);
+
+    std::vector<FsItem> sorted;
+    sorted.reserve(items.size());
+    for (const auto& record : records)
+    {
+        sorted.push_back(std::move(items[record.position]));
+    }
+    items.swap(sorted);
+}
+
+void Sort(const ItemStore& store, std::vector<uint32_t>& order, const FsItemComparator& comparator)
+{
+    std::vector<SortRecord> records = SortByKeys(StoreViewSource{store, order}, order.size(), comparator);
+
+    std::vector<uint32_t> sorted;
+    sorted.reserve(order.size());
+    for (const auto& record : records)
+    {
+        sorted.push_back(order[record.position]);
+    }
+    order.swap(sorted);
+}
+
+void FilterByName(const ItemStore& store, std::vector<uint32_t>& order, const std::string& pattern)
+{
+    if (pattern.empty() || pattern == "*")
+    {
+        return;
+    }
+
+    std::string name;
+    auto removed = std::remove_if(order.begin(), order.end(), [&](uint32_t index)
+    {
+        name.assign(store.Name(index));
+        return !MatchesName(name, pattern);
+    });
+    order.erase(removed, order.end());
+}
+
+std::vector<FsItem> FilterByName(const std::vector<FsItem>& items, const std::string& pattern)
+{
+    if (pattern.empty() || pattern == "*")
     {
-        // Invalid pattern, return all items
         return items;
     }
 
+    std::vector<FsItem> result;
+    for (const auto& item : items)
+    {
+        if (MatchesName(item.name, pattern))
+        {
+            result.push_back(item);
+        }
+    }
     return result;
 }
 
+bool MatchesName(const std::string& name, const std::string& pattern)
+{
+    auto fold = [](char c)
+    {
+        return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    };
+
+    // Greedy match that backtracks only to the last '*'
+    size_t n = 0;
+    size_t p = 0;
+    size_t star = std::string::npos;
+    size_t resume = 0;
+    while (n < name.size())
+    {
+        if (p < pattern.size() && (pattern[p] == '?' || (pattern[p] != '*' && fold(pattern[p]) == fold(name[n]))))
+        {
+            ++n;
+            ++p;
+        }
+        else if (p < pattern.size() && pattern[p] == '*')
+        {
+            star = p++;
+            resume = n;
+        }
+        else if (star != std::string::npos)
+        {
+            p = star + 1;
+            n = ++resume;
+        }
+        else
+        {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*')
+    {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
 std::vector<FsItem> FilterByExtension(const std::vector<FsItem>& items, const std::string& extension)
 {
     if (extension.empty())
@@ -473,81 +972,50 @@ std::string GetExtension(const std::string& filename)
 
 std::string GetMimeType(const std::string& extension)
 {
-    static const std::unordered_map<std::string, std::string> mime_types = {
-        // Text
-        {"txt", "text/plain"},
-        {"html", "text/html"},
-        {"htm", "text/html"},
-        {"css", "text/css"},
-        {"js", "text/javascript"},
-        {"json", "application/json"},
-        {"xml", "application/xml"},
-        {"csv", "text/csv"},
-        {"md", "text/markdown"},
-        
-        // Code
-        {"cpp", "text/x-c++src"},
-        {"c", "text/x-csrc"},
-        {"h", "text/x-chdr"},
-        {"hpp", "text/x-c++hdr"},
-        {"py", "text/x-python"},
-        {"java", "text/x-java-source"},
-        {"cs", "text/x-csharp"},
-        {"ts", "text/typescript"},
-        {"rs", "text/x-rust"},
-        {"go", "text/x-go"},
-        
-        // Images
-        {"jpg", "image/jpeg"},
-        {"jpeg", "image/jpeg"},
-        {"png", "image/png"},
-        {"gif", "image/gif"},
-        {"bmp", "image/bmp"},
-        {"svg", "image/svg+xml"},
-        {"ico", "image/x-icon"},
-        {"webp", "image/webp"},
-        
-        // Audio
-        {"mp3", "audio/mpeg"},
-        {"wav", "audio/wav"},
-        {"ogg", "audio/ogg"},
-        {"flac", "audio/flac"},
-        
-        // Video
-        {"mp4", "video/mp4"},
-        {"webm", "video/webm"},
-        {"mkv", "video/x-matroska"},
-        {"avi", "video/x-msvideo"},
-        {"mov", "video/quicktime"},
-        
-        // Documents
-        {"pdf", "application/pdf"},
-        {"doc", "application/msword"},
-        {"docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document"},
-        {"xls", "application/vnd.ms-excel"},
-        {"xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet"},
-        
-        // Archives
-        {"zip", "application/zip"},
-        {"rar", "application/vnd.rar"},
-        {"7z", "application/x-7z-compressed"},
-        {"tar", "application/x-tar"},
-        {"gz", "application/gzip"},
-        
-        // Executables
-        {"exe", "application/vnd.microsoft.portable-executable"},
-        {"dll", "application/vnd.microsoft.portable-executable"},
-        {"msi", "application/x-msi"},
-    };
-
-    auto it = mime_types.find(extension);
-    if (it != mime_types.end())
+    // Lookups fold case; mime types never did
+    const ExtensionInfo* info = LookupExtension(extension);
+    if (info && info->mime_type && info->extension == extension)
     {
-        return it->second;
+        return info->mime_type;
     }
     return "application/octet-stream";
 }
 
+std::string FormatSize(uint64_t size)
+{
+    const char* units[] = {"B", "KB", "MB", "GB", "TB", "PB"};
+    double display_size = static_cast<double>(size);
+    int unit_index = 0;
+
+    while (display_size >= 1024.0 && unit_index < 5)
+    {
+        display_size /= 1024.0;
+        unit_index++;
+    }
+
+    std::ostringstream oss;
+    if (unit_index == 0)
+    {
+        oss << size << " " << units[unit_index];
+    }
+    else
+    {
+        oss << std::fixed << std::setprecision(1) << display_size << " " << units[unit_index];
+    }
+    return oss.str();
+}
+
+std::string FormatDate(std::chrono::system_clock::time_point time)
+{
+    auto time_t_val = std::chrono::system_clock::to_time_t(time);
+    std::tm tm_val;
+    localtime_s(&tm_val, &time_t_val);
+    
+    std::ostringstream oss;
+    oss << std::put_time(&tm_val, "%Y-%m-%d %H:%M");
+    return oss.str();
+}
+
 } // namespace FsItemUtils
 
 } // namespace opacity::filesystem
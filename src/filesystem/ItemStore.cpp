@@ -0,0 +1,214 @@
+#include "opacity/filesystem/ItemStore.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace opacity::filesystem
+{
+
+namespace
+{
+    // FILE_ATTRIBUTE_REPARSE_POINT; FsItem derives is_symlink from it
+    constexpr uint32_t kAttrReparsePoint = 0x400;
+
+    bool EqualsFolded(std::string_view a, std::string_view b)
+    {
+        if (a.size() != b.size())
+        {
+            return false;
+        }
+        for (size_t i = 0; i < a.size(); ++i)
+        {
+            if (std::tolower(static_cast<unsigned char>(a[i])) != std::tolower(static_cast<unsigned char>(b[i])))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    int64_t ToTicks(std::chrono::system_clock::time_point time)
+    {
+        return static_cast<int64_t>(time.time_since_epoch().count());
+    }
+}
+
+void ItemStore::Reset(const std::string& directory)
+{
+    directory_ = directory;
+    if (!directory_.empty() && directory_.back() != '\\' && directory_.back() != '/')
+    {
+        directory_ += '\\';
+    }
+
+    names_.clear();
+    name_offsets_.assign(1, 0);
+    sizes_.clear();
+    modified_.clear();
+    created_.clear();
+    attributes_.clear();
+    extension_ids_.clear();
+
+    extensions_.assign(1, std::string());
+    type_descriptions_.assign(1, std::string("File"));
+    extension_lookup_.clear();
+
+    file_count_ = 0;
+    directory_count_ = 0;
+    total_size_ = 0;
+}
+
+void ItemStore::Reserve(size_t count, size_t name_bytes)
+{
+    names_.reserve(name_bytes);
+    name_offsets_.reserve(count + 1);
+    sizes_.reserve(count);
+    modified_.reserve(count);
+    created_.reserve(count);
+    attributes_.reserve(count);
+    extension_ids_.reserve(count);
+}
+
+ItemStore::Index ItemStore::Add(const FsItem& item)
+{
+    auto index = static_cast<Index>(Count());
+
+    names_.append(item.name);
+    name_offsets_.push_back(static_cast<uint32_t>(names_.size()));
+    sizes_.push_back(item.size);
+    modified_.push_back(ToTicks(item.modified));
+    created_.push_back(ToTicks(item.created));
+
+    uint32_t attributes = item.attributes;
+    if (item.is_directory)
+    {
+        attributes |= FsItem::ATTR_DIRECTORY;
+    }
+    if (item.is_symlink)
+    {
+        attributes |= kAttrReparsePoint;
+    }
+    attributes_.push_back(attributes);
+
+    extension_ids_.push_back(item.is_directory ? 0 : InternExtension(item.extension));
+    CountItem(item.is_directory, item.size);
+    return index;
+}
+
+ItemStore::Index ItemStore::AddFrom(const ItemStore& other, Index index)
+{
+    auto added = static_cast<Index>(Count());
+
+    names_.append(other.Name(index));
+    name_offsets_.push_back(static_cast<uint32_t>(names_.size()));
+    sizes_.push_back(other.sizes_[index]);
+    modified_.push_back(other.modified_[index]);
+    created_.push_back(other.created_[index]);
+    attributes_.push_back(other.attributes_[index]);
+    extension_ids_.push_back(other.IsDirectory(index) ? 0 : InternExtension(other.Extension(index)));
+    CountItem(other.IsDirectory(index), other.sizes_[index]);
+    return added;
+}
+
+const std::string& ItemStore::TypeDescription(Index index) const
+{
+    static const std::string folder = "Folder";
+    if (IsDirectory(index))
+    {
+        return folder;
+    }
+    return type_descriptions_[extension_ids_[index]];
+}
+
+std::string ItemStore::FullPath(Index index) const
+{
+    std::string path;
+    std::string_view name = Name(index);
+    path.reserve(directory_.size() + name.size());
+    path.append(directory_);
+    path.append(name);
+    return path;
+}
+
+FsItem ItemStore::Materialize(Index index) const
+{
+    FsItem item;
+    item.name = std::string(Name(index));
+    item.full_path = core::Path(FullPath(index));
+    item.is_directory = IsDirectory(index);
+    item.is_symlink = (attributes_[index] & kAttrReparsePoint) != 0;
+    item.size = sizes_[index];
+    item.modified = Modified(index);
+    item.created = Created(index);
+    item.attributes = attributes_[index];
+    item.extension = Extension(index);
+    return item;
+}
+
+ItemStore::Index ItemStore::FindByName(std::string_view name) const
+{
+    for (Index index = 0; index < Count(); ++index)
+    {
+        if (EqualsFolded(Name(index), name))
+        {
+            return index;
+        }
+    }
+    return static_cast<Index>(Count());
+}
+
+size_t ItemStore::MemoryUsage() const
+{
+    size_t bytes = directory_.capacity() +
+                   names_.capacity() +
+                   name_offsets_.capacity() * sizeof(uint32_t) +
+                   sizes_.capacity() * sizeof(uint64_t) +
+                   modified_.capacity() * sizeof(int64_t) +
+                   created_.capacity() * sizeof(int64_t) +
+                   attributes_.capacity() * sizeof(uint32_t) +
+                   extension_ids_.capacity() * sizeof(uint32_t);
+    for (size_t i = 0; i < extensions_.size(); ++i)
+    {
+        bytes += extensions_[i].capacity() + type_descriptions_[i].capacity() + 2 * sizeof(std::string);
+    }
+    return bytes;
+}
+
+void ItemStore::CountItem(bool is_directory, uint64_t size)
+{
+    if (is_directory)
+    {
+        directory_count_++;
+    }
+    else
+    {
+        file_count_++;
+        total_size_ += size;
+    }
+}
+
+uint32_t ItemStore::InternExtension(const std::string& extension)
+{
+    if (extension.empty())
+    {
+        return 0;
+    }
+
+    auto it = extension_lookup_.find(extension);
+    if (it != extension_lookup_.end())
+    {
+        return it->second;
+    }
+
+    // Descriptions are worked out once per distinct extension
+    FsItem probe;
+    probe.extension = extension;
+
+    auto id = static_cast<uint32_t>(extensions_.size());
+    extensions_.push_back(extension);
+    type_descriptions_.push_back(probe.GetTypeDescription());
+    extension_lookup_.emplace(extension, id);
+    return id;
+}
+
+} // namespace opacity::filesystem
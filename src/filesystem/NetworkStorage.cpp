@@ -3,10 +3,13 @@
 
 #include <algorithm>
 #include <codecvt>
+#include <condition_variable>
+#include <deque>
 #include <locale>
 #include <mutex>
 #include <regex>
 #include <thread>
+#include <unordered_map>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -36,6 +39,98 @@ namespace opacity::filesystem
                                &result[0], size, nullptr, nullptr);
             return result;
         }
+
+        // "\\Server" and "server" share one cache entry
+        std::string ServerKey(const std::string& serverName)
+        {
+            std::string key = serverName.substr(std::min(serverName.find_first_not_of('\\'), serverName.size()));
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            return key;
+        }
+
+        // TCP connect to the SMB port on every address the name resolves
+        // to at once, bounded by timeoutMs however the server fails
+        // (refused, no route, SYNs dropped by a firewall)
+        bool ProbeSmbPort(const std::string& server, int timeoutMs)
+        {
+#ifdef _WIN32
+            struct addrinfo hints = {};
+            hints.ai_family = AF_UNSPEC;
+            hints.ai_socktype = SOCK_STREAM;
+            hints.ai_protocol = IPPROTO_TCP;
+
+            struct addrinfo* result = nullptr;
+            if (getaddrinfo(server.c_str(), "445", &hints, &result) != 0) {
+                return false;
+            }
+
+            std::vector<SOCKET> pending;
+            bool connected = false;
+            for (auto* ai = result; ai && !connected && pending.size() < FD_SETSIZE; ai = ai->ai_next) {
+                SOCKET sock = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+                if (sock == INVALID_SOCKET) {
+                    continue;
+                }
+
+                u_long nonBlocking = 1;
+                ioctlsocket(sock, FIONBIO, &nonBlocking);
+                if (connect(sock, ai->ai_addr, static_cast<int>(ai->ai_addrlen)) == 0) {
+                    connected = true;
+                } else if (WSAGetLastError() != WSAEWOULDBLOCK) {
+                    closesocket(sock);
+                    continue;
+                }
+                pending.push_back(sock);
+            }
+            freeaddrinfo(result);
+
+            auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(timeoutMs);
+            while (!connected && !pending.empty()) {
+                auto remaining = std::chrono::duration_cast<std::chrono::microseconds>(
+                    deadline - std::chrono::steady_clock::now()).count();
+                if (remaining <= 0) {
+                    break;
+                }
+
+                fd_set writable, failed;
+                FD_ZERO(&writable);
+                FD_ZERO(&failed);
+                for (SOCKET sock : pending) {
+                    FD_SET(sock, &writable);
+                    FD_SET(sock, &failed);
+                }
+
+                timeval timeout;
+                timeout.tv_sec = static_cast<long>(remaining / 1000000);
+                timeout.tv_usec = static_cast<long>(remaining % 1000000);
+                if (select(0, nullptr, &writable, &failed, &timeout) <= 0) {
+                    break;
+                }
+
+                // Windows reports a refused connect in the except set
+                for (auto it = pending.begin(); it != pending.end();) {
+                    if (FD_ISSET(*it, &writable)) {
+                        connected = true;
+                        ++it;
+                    } else if (FD_ISSET(*it, &failed)) {
+                        closesocket(*it);
+                        it = pending.erase(it);
+                    } else {
+                        ++it;
+                    }
+                }
+            }
+
+            for (SOCKET sock : pending) {
+                closesocket(sock);
+            }
+            return connected;
+#else
+            (void)server;
+            (void)timeoutMs;
+            return false;
+#endif
+        }
     }
 
     class NetworkStorage::Impl
@@ -53,6 +148,174 @@ namespace opacity::filesystem
         
         std::mutex mutex_;
 
+        // Reachability cache, filled by a pool of probe threads
+        struct Reachability
+        {
+            ServerReachability state = ServerReachability::Unknown;
+            std::chrono::steady_clock::time_point expires;
+            int failures = 0;           // In a row, for the backoff
+            bool queued = false;        // Waiting for or being probed
+        };
+
+        ProbeOptions probeOptions_;
+        std::mutex probeMutex_;
+        std::condition_variable probeWake_;
+        std::condition_variable probeDone_;
+        std::deque<std::string> probeQueue_;
+        std::unordered_map<std::string, Reachability> reachability_;
+        std::vector<std::thread> probeThreads_;
+        bool probeStop_ = false;
+
+        // Caller holds probeMutex_
+        bool IsStaleLocked(const Reachability& entry) const
+        {
+            return !cachingEnabled_ || entry.state == ServerReachability::Unknown ||
+                   std::chrono::steady_clock::now() >= entry.expires;
+        }
+
+        // Caller holds probeMutex_
+        void QueueProbeLocked(const std::string& key)
+        {
+            auto& entry = reachability_[key];
+            if (entry.queued || probeStop_) {
+                return;
+            }
+
+            entry.queued = true;
+            probeQueue_.push_back(key);
+
+            // Started on first use, so a session without shares has no threads
+            if (probeThreads_.empty()) {
+                size_t count = std::max<size_t>(probeOptions_.probeThreads, 1);
+                for (size_t i = 0; i < count; ++i) {
+                    probeThreads_.emplace_back(&Impl::ProbeLoop, this);
+                }
+            }
+            probeWake_.notify_one();
+        }
+
+        ServerReachability Lookup(const std::string& key)
+        {
+            std::lock_guard<std::mutex> lock(probeMutex_);
+            auto& entry = reachability_[key];
+            if (IsStaleLocked(entry)) {
+                QueueProbeLocked(key);
+            }
+            return entry.state;
+        }
+
+        // The last known state if no probe finishes in time
+        ServerReachability WaitForProbe(const std::string& key, int timeoutMs)
+        {
+            std::unique_lock<std::mutex> lock(probeMutex_);
+            auto& entry = reachability_[key];
+            if (!IsStaleLocked(entry)) {
+                return entry.state;
+            }
+
+            QueueProbeLocked(key);
+            probeDone_.wait_for(lock, std::chrono::milliseconds(std::max(timeoutMs, 0)),
+                [&] { return !entry.queued || probeStop_; });
+            return entry.state;
+        }
+
+        void ProbeLoop()
+        {
+            while (true) {
+                std::string key;
+                int timeoutMs = 0;
+                {
+                    std::unique_lock<std::mutex> lock(probeMutex_);
+                    probeWake_.wait(lock, [this] { return probeStop_ || !probeQueue_.empty(); });
+                    if (probeStop_) {
+                        return;
+                    }
+                    key = std::move(probeQueue_.front());
+                    probeQueue_.pop_front();
+                    timeoutMs = probeOptions_.connectTimeoutMs;
+                }
+
+                bool reachable = ProbeSmbPort(key, timeoutMs);
+                auto state = reachable ? ServerReachability::Reachable : ServerReachability::Unreachable;
+
+                ServerReachability previous;
+                {
+                    std::lock_guard<std::mutex> lock(probeMutex_);
+                    auto& entry = reachability_[key];
+                    previous = entry.state;
+                    entry.state = state;
+                    entry.queued = false;
+
+                    auto now = std::chrono::steady_clock::now();
+                    if (reachable) {
+                        entry.failures = 0;
+                        entry.expires = now + probeOptions_.reachableTtl;
+                    } else {
+                        // 5s, 10s, 20s, ... up to the cap
+                        auto wait = probeOptions_.unreachableTtl * (int64_t{1} << std::min(entry.failures, 16));
+                        entry.expires = now + std::min<std::chrono::seconds>(wait, probeOptions_.maxBackoff);
+                        entry.failures++;
+                    }
+                }
+                probeDone_.notify_all();
+
+                if (state != previous) {
+                    Logger::Get()->info("NetworkStorage: {} is {}", key, reachable ? "reachable" : "unreachable");
+                    PublishServer(key, reachable);
+                }
+            }
+        }
+
+        void StopProbes()
+        {
+            {
+                std::lock_guard<std::mutex> lock(probeMutex_);
+                probeStop_ = true;
+                probeQueue_.clear();
+            }
+            probeWake_.notify_all();
+            probeDone_.notify_all();
+
+            for (auto& thread : probeThreads_) {
+                thread.join();
+            }
+            probeThreads_.clear();
+
+            std::lock_guard<std::mutex> lock(probeMutex_);
+            for (auto& [key, entry] : reachability_) {
+                entry.queued = false;
+            }
+            probeStop_ = false;
+        }
+
+        void PublishServer(const std::string& key, bool reachable)
+        {
+#ifdef _WIN32
+            NetworkDriveCallback callback;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                callback = driveCallback_;
+            }
+            if (!callback) {
+                return;
+            }
+
+            for (const auto& [letter, remoteName] : EnumerateMappedDrives()) {
+                std::string server, share, relative;
+                if (!ParseUNCPath(remoteName, server, share, relative) || ServerKey(server) != key) {
+                    continue;
+                }
+
+                NetworkDrive drive = CreateDriveInfo(letter, remoteName, reachable);
+                drive.isConnected = reachable;
+                callback(drive, reachable);
+            }
+#else
+            (void)key;
+            (void)reachable;
+#endif
+        }
+
 #ifdef _WIN32
         NetworkDriveType DetectDriveType(const std::string& uncPath)
         {
@@ -69,7 +332,44 @@ namespace opacity::filesystem
             return NetworkDriveType::SMB;
         }
 
-        NetworkDrive CreateDriveInfo(char letter, const std::string& remoteName)
+        std::vector<std::pair<char, std::string>> EnumerateMappedDrives()
+        {
+            std::vector<std::pair<char, std::string>> mapped;
+            DWORD drivesMask = GetLogicalDrives();
+            
+            for (char letter = 'A'; letter <= 'Z'; ++letter) {
+                if (drivesMask & (1 << (letter - 'A'))) {
+                    std::string drivePath = std::string(1, letter) + ":";
+                    
+                    if (GetDriveTypeA(drivePath.c_str()) == DRIVE_REMOTE) {
+                        char remoteName[MAX_PATH] = {};
+                        DWORD remoteNameLen = MAX_PATH;
+                        
+                        if (WNetGetConnectionA(drivePath.c_str(), remoteName, &remoteNameLen) == NO_ERROR) {
+                            mapped.emplace_back(letter, remoteName);
+                        }
+                    }
+                }
+            }
+            return mapped;
+        }
+
+        // Only asks the server for space once it is known to answer; the
+        // state of an unprobed server is filled in by a later callback
+        NetworkDrive DescribeDrive(char letter, const std::string& remoteName)
+        {
+            auto state = ServerReachability::Unknown;
+            std::string server, share, relative;
+            if (ParseUNCPath(remoteName, server, share, relative)) {
+                state = Lookup(ServerKey(server));
+            }
+
+            NetworkDrive drive = CreateDriveInfo(letter, remoteName, state == ServerReachability::Reachable);
+            drive.isConnected = state != ServerReachability::Unreachable;
+            return drive;
+        }
+
+        NetworkDrive CreateDriveInfo(char letter, const std::string& remoteName, bool querySpace)
         {
             NetworkDrive drive;
             drive.driveLetter = letter;
@@ -91,7 +391,7 @@ namespace opacity::filesystem
             // Get space info
             std::string drivePath = std::string(1, letter) + ":\\";
             ULARGE_INTEGER freeBytesAvailable, totalBytes, freeBytes;
-            if (GetDiskFreeSpaceExA(drivePath.c_str(), &freeBytesAvailable, 
+            if (querySpace && GetDiskFreeSpaceExA(drivePath.c_str(), &freeBytesAvailable, 
                                     &totalBytes, &freeBytes)) {
                 drive.totalSpace = totalBytes.QuadPart;
                 drive.freeSpace = freeBytes.QuadPart;
@@ -149,6 +449,7 @@ namespace opacity::filesystem
 
     void NetworkStorage::Shutdown()
     {
+        impl_->StopProbes();
         DisconnectFtp();
 #ifdef _WIN32
         WSACleanup();
@@ -161,21 +462,8 @@ namespace opacity::filesystem
         std::vector<NetworkDrive> drives;
 
 #ifdef _WIN32
-        DWORD drivesMask = GetLogicalDrives();
-        
-        for (char letter = 'A'; letter <= 'Z'; ++letter) {
-            if (drivesMask & (1 << (letter - 'A'))) {
-                std::string drivePath = std::string(1, letter) + ":";
-                
-                if (GetDriveTypeA(drivePath.c_str()) == DRIVE_REMOTE) {
-                    char remoteName[MAX_PATH] = {};
-                    DWORD remoteNameLen = MAX_PATH;
-                    
-                    if (WNetGetConnectionA(drivePath.c_str(), remoteName, &remoteNameLen) == NO_ERROR) {
-                        drives.push_back(impl_->CreateDriveInfo(letter, remoteName));
-                    }
-                }
-            }
+        for (const auto& [letter, remoteName] : impl_->EnumerateMappedDrives()) {
+            drives.push_back(impl_->DescribeDrive(letter, remoteName));
         }
 #endif
 
@@ -195,7 +483,7 @@ namespace opacity::filesystem
         DWORD remoteNameLen = MAX_PATH;
         
         if (WNetGetConnectionA(drivePath.c_str(), remoteName, &remoteNameLen) == NO_ERROR) {
-            return impl_->CreateDriveInfo(driveLetter, remoteName);
+            return impl_->DescribeDrive(driveLetter, remoteName);
         }
 #endif
         return std::nullopt;
@@ -466,7 +754,14 @@ namespace opacity::filesystem
 
     bool NetworkStorage::IsPathAvailable(const std::filesystem::path& path, int timeoutMs)
     {
-        // Simple check - try to access the path
+        // On a dead server exists() would block for the SMB timeout, so
+        // the server has to answer a probe first
+        std::string server, share, relative;
+        if (ParseUNCPath(DriveToUNC(path), server, share, relative) &&
+            impl_->WaitForProbe(ServerKey(server), timeoutMs) != ServerReachability::Reachable) {
+            return false;
+        }
+
         std::error_code ec;
         return std::filesystem::exists(path, ec);
     }
@@ -484,39 +779,40 @@ namespace opacity::filesystem
 
     bool NetworkStorage::IsServerAvailable(const std::string& serverName, int timeoutMs)
     {
-#ifdef _WIN32
-        // Use socket connect to check server availability
-        SOCKET sock = socket(AF_INET, SOCK_STREAM, IPPROTO_TCP);
-        if (sock == INVALID_SOCKET) {
-            return false;
-        }
-
-        // Set timeout
-        DWORD timeout = timeoutMs;
-        setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, reinterpret_cast<char*>(&timeout), sizeof(timeout));
-        setsockopt(sock, SOL_SOCKET, SO_SNDTIMEO, reinterpret_cast<char*>(&timeout), sizeof(timeout));
+        return impl_->WaitForProbe(ServerKey(serverName), timeoutMs) == ServerReachability::Reachable;
+    }
 
-        // Resolve hostname
-        struct addrinfo hints = {};
-        hints.ai_family = AF_INET;
-        hints.ai_socktype = SOCK_STREAM;
+    ServerReachability NetworkStorage::GetServerReachability(const std::string& serverName)
+    {
+        return impl_->Lookup(ServerKey(serverName));
+    }
 
-        struct addrinfo* result = nullptr;
-        if (getaddrinfo(serverName.c_str(), "445", &hints, &result) != 0) {  // SMB port
-            closesocket(sock);
-            return false;
+    void NetworkStorage::ProbeServersAsync(const std::vector<std::string>& serverNames)
+    {
+        std::lock_guard<std::mutex> lock(impl_->probeMutex_);
+        for (const auto& serverName : serverNames) {
+            impl_->QueueProbeLocked(ServerKey(serverName));
         }
+    }
 
-        // Try to connect
-        bool available = (connect(sock, result->ai_addr, static_cast<int>(result->ai_addrlen)) == 0);
-
-        freeaddrinfo(result);
-        closesocket(sock);
-
-        return available;
-#else
-        return false;
+    void NetworkStorage::RefreshDrivesAsync()
+    {
+        std::vector<std::string> servers;
+#ifdef _WIN32
+        for (const auto& [letter, remoteName] : impl_->EnumerateMappedDrives()) {
+            std::string server, share, relative;
+            if (ParseUNCPath(remoteName, server, share, relative)) {
+                servers.push_back(server);
+            }
+        }
 #endif
+        ProbeServersAsync(servers);
+    }
+
+    void NetworkStorage::SetProbeOptions(const ProbeOptions& options)
+    {
+        std::lock_guard<std::mutex> lock(impl_->probeMutex_);
+        impl_->probeOptions_ = options;
     }
 
     std::pair<uint64_t, uint64_t> NetworkStorage::GetSpaceInfo(const std::filesystem::path& path)
@@ -537,39 +833,55 @@ namespace opacity::filesystem
         std::vector<std::string> servers;
 
 #ifdef _WIN32
-        LPNETRESOURCEW lpnrLocal = nullptr;
-        HANDLE hEnum;
-        
-        DWORD dwResult = WNetOpenEnumW(RESOURCE_GLOBALNET, RESOURCETYPE_DISK,
-                                        0, lpnrLocal, &hEnum);
-        
-        if (dwResult != NO_ERROR) {
-            return servers;
-        }
-
-        DWORD cbBuffer = 16384;
-        auto lpnrBuffer = std::make_unique<BYTE[]>(cbBuffer);
-        
-        DWORD cEntries = static_cast<DWORD>(-1);
-        
-        while (true) {
-            dwResult = WNetEnumResourceW(hEnum, &cEntries, lpnrBuffer.get(), &cbBuffer);
+        // Browsing can hang on an unresponsive master browser, so it runs
+        // on a thread of its own that owns its results and outlives the
+        // call if it has to
+        struct Discovery
+        {
+            std::mutex mutex;
+            std::condition_variable finished;
+            std::vector<std::string> servers;
+            bool done = false;
+        };
+        auto discovery = std::make_shared<Discovery>();
+
+        std::thread([discovery]() {
+            HANDLE hEnum;
+            DWORD dwResult = WNetOpenEnumW(RESOURCE_GLOBALNET, RESOURCETYPE_DISK,
+                                            0, nullptr, &hEnum);
             
             if (dwResult == NO_ERROR) {
-                auto* lpnr = reinterpret_cast<LPNETRESOURCEW>(lpnrBuffer.get());
-                for (DWORD i = 0; i < cEntries; i++) {
-                    if (lpnr[i].lpRemoteName) {
-                        servers.push_back(WideToNarrow(lpnr[i].lpRemoteName));
+                DWORD cbBuffer = 16384;
+                auto lpnrBuffer = std::make_unique<BYTE[]>(cbBuffer);
+                
+                while (true) {
+                    DWORD cEntries = static_cast<DWORD>(-1);
+                    dwResult = WNetEnumResourceW(hEnum, &cEntries, lpnrBuffer.get(), &cbBuffer);
+                    if (dwResult != NO_ERROR) {
+                        break;
+                    }
+
+                    auto* lpnr = reinterpret_cast<LPNETRESOURCEW>(lpnrBuffer.get());
+                    std::lock_guard<std::mutex> lock(discovery->mutex);
+                    for (DWORD i = 0; i < cEntries; i++) {
+                        if (lpnr[i].lpRemoteName) {
+                            discovery->servers.push_back(WideToNarrow(lpnr[i].lpRemoteName));
+                        }
                     }
                 }
-            } else if (dwResult == ERROR_NO_MORE_ITEMS) {
-                break;
-            } else {
-                break;
+
+                WNetCloseEnum(hEnum);
             }
-        }
 
-        WNetCloseEnum(hEnum);
+            std::lock_guard<std::mutex> lock(discovery->mutex);
+            discovery->done = true;
+            discovery->finished.notify_all();
+        }).detach();
+
+        std::unique_lock<std::mutex> lock(discovery->mutex);
+        discovery->finished.wait_for(lock, std::chrono::milliseconds(std::max(timeoutMs, 0)),
+            [&] { return discovery->done; });
+        servers = discovery->servers;
 #endif
 
         return servers;
@@ -674,7 +986,15 @@ namespace opacity::filesystem
 
     void NetworkStorage::ClearCache()
     {
-        // No caching implemented yet
+        // Entries with a probe in flight stay so the result has a home
+        std::lock_guard<std::mutex> lock(impl_->probeMutex_);
+        for (auto it = impl_->reachability_.begin(); it != impl_->reachability_.end();) {
+            if (it->second.queued) {
+                ++it;
+            } else {
+                it = impl_->reachability_.erase(it);
+            }
+        }
     }
 
     void NetworkStorage::SetRetryCount(int count)
@@ -684,6 +1004,7 @@ namespace opacity::filesystem
 
     void NetworkStorage::OnDriveChanged(NetworkDriveCallback callback)
     {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
         impl_->driveCallback_ = callback;
     }
 
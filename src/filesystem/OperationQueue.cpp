@@ -1,17 +1,112 @@
 #include "opacity/filesystem/OperationQueue.h"
+#include "opacity/filesystem/StorageTopology.h"
+#include "opacity/filesystem/TreeDeleter.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/CrashRecovery.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+
+#include <nlohmann/json.hpp>
 
 #include <imgui.h>
 #include "opacity/ui/ImGuiScoped.h"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
 #include <fstream>
 #include <filesystem>
+#include <deque>
+#include <stdexcept>
 
 namespace fs = std::filesystem;
 
 namespace opacity::filesystem
 {
+    using json = nlohmann::json;
+
+    namespace
+    {
+        constexpr double kRateSampleSeconds = 0.25;
+        constexpr double kRateTimeConstantSeconds = 3.0;
+
+        // Each journal write rewrites the recovery file, so finished files
+        // and checkpoints in between go out together
+        constexpr auto kJournalInterval = std::chrono::seconds(1);
+        constexpr int kJournalVersion = 1;
+    }
+
     uint64_t BatchOperation::next_id_ = 1;
 
+    struct BatchOperation::CopyTask
+    {
+        fs::path source;
+        fs::path dest;
+        uint64_t size = 0;
+        size_t item = 0;        // Index into items_
+    };
+
+    // Bounded hand-off from the walking thread to the copy workers, so a
+    // huge tree is never enumerated far ahead of the copies
+    class BatchOperation::CopyTaskQueue
+    {
+    public:
+        CopyTaskQueue(size_t capacity, std::function<void(const CopyTask&)> copy)
+            : capacity_(capacity), copy_(std::move(copy)) {}
+
+        // When the queue is full the caller copies the file itself, so the
+        // walk never waits on workers that may not have started
+        void Push(CopyTask task)
+        {
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (tasks_.size() < capacity_)
+                {
+                    tasks_.push_back(std::move(task));
+                    not_empty_.notify_one();
+                    return;
+                }
+            }
+            copy_(task);
+        }
+
+        // Copy queued files until the queue is closed and empty
+        void Work()
+        {
+            CopyTask task;
+            while (Pop(task))
+            {
+                copy_(task);
+            }
+        }
+
+        void Close()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            not_empty_.notify_all();
+        }
+
+    private:
+        bool Pop(CopyTask& task)
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            not_empty_.wait(lock, [this] { return !tasks_.empty() || closed_; });
+            if (tasks_.empty())
+                return false;
+
+            task = std::move(tasks_.front());
+            tasks_.pop_front();
+            return true;
+        }
+
+        std::mutex mutex_;
+        std::condition_variable not_empty_;
+        std::deque<CopyTask> tasks_;
+        size_t capacity_;
+        std::function<void(const CopyTask&)> copy_;
+        bool closed_ = false;
+    };
+
     BatchOperation::BatchOperation(OperationType type)
         : id_{next_id_++}
         , type_(type)
@@ -22,8 +117,7 @@ namespace opacity::filesystem
     BatchOperation::~BatchOperation()
     {
         Cancel();
-        if (worker_thread_.joinable())
-            worker_thread_.join();
+        worker_task_.Wait();
     }
 
     void BatchOperation::AddItem(const OperationItem& item)
@@ -39,6 +133,80 @@ namespace opacity::filesystem
             AddItem(item);
     }
 
+    void BatchOperation::SetJournal(core::CrashRecovery* recovery)
+    {
+        journal_ = recovery;
+        if (journal_)
+            checksums_ = true;
+    }
+
+    std::vector<std::pair<std::string, std::string>> BatchOperation::GetFileHashes() const
+    {
+        std::vector<std::pair<std::string, std::string>> hashes;
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex_);
+            for (const auto& [dest, file] : journal_files_)
+            {
+                if (file.done && !file.hash.empty())
+                    hashes.emplace_back(dest, file.hash);
+            }
+        }
+        std::sort(hashes.begin(), hashes.end());
+        return hashes;
+    }
+
+    std::unique_ptr<BatchOperation> BatchOperation::FromJournal(const core::PendingOperation& pending,
+                                                                core::CrashRecovery* recovery)
+    {
+        if (pending.type != "copy")
+            return nullptr;
+
+        try
+        {
+            json j = json::parse(pending.customData);
+            if (j.value("version", 0) != kJournalVersion)
+                return nullptr;
+
+            auto operation = std::make_unique<BatchOperation>(OperationType::Copy);
+            operation->SetDestination(core::Path(j.value("destination", std::string())));
+            operation->checksums_ = j.value("checksums", true);
+
+            for (const auto& entry : j.at("items"))
+            {
+                OperationItem item;
+                item.source = core::Path(entry.at("source").get<std::string>());
+                item.destination = core::Path(entry.value("destination", std::string()));
+                item.size = entry.value("size", uint64_t{0});
+                item.is_directory = entry.value("directory", false);
+                operation->AddItem(item);
+                operation->item_targets_.push_back(entry.value("target", std::string()));
+            }
+
+            for (const auto& [dest, entry] : j.at("files").items())
+            {
+                JournalFile file;
+                file.size = entry.value("size", uint64_t{0});
+                file.done = entry.value("done", false);
+                file.hash = entry.value("hash", std::string());
+                file.offset = entry.value("offset", uint64_t{0});
+                file.hash_state = entry.value("state", std::string());
+                operation->journal_files_[dest] = std::move(file);
+            }
+
+            operation->journal_ = recovery;
+            operation->journal_id_ = pending.id;
+
+            SPDLOG_INFO("Resuming copy {} with {} items, {} files on record", pending.id,
+                        operation->items_.size(), operation->journal_files_.size());
+            return operation;
+        }
+        catch (const std::exception& e)
+        {
+            SPDLOG_WARN("Cannot resume operation {}: {}", pending.id, e.what());
+            return nullptr;
+        }
+    }
+
     OperationProgress BatchOperation::GetProgress() const
     {
         std::lock_guard<std::mutex> lock(progress_mutex_);
@@ -54,7 +222,10 @@ namespace opacity::filesystem
         start_time_ = std::chrono::steady_clock::now();
         last_progress_time_ = start_time_;
 
-        worker_thread_ = std::thread(&BatchOperation::ExecuteOperation, this);
+        // Copies pace themselves per device through StorageTopology, so
+        // the task names none
+        worker_task_ = core::TaskScheduler::Get().Submit(
+            [this](const core::CancellationToken&) { ExecuteOperation(); });
     }
 
     void BatchOperation::Pause()
@@ -87,68 +258,77 @@ namespace opacity::filesystem
 
     void BatchOperation::WaitForCompletion()
     {
-        if (worker_thread_.joinable())
-            worker_thread_.join();
+        worker_task_.Wait();
     }
 
     void BatchOperation::ExecuteOperation()
     {
+        OPACITY_PROFILE_ZONE("BatchOperation::ExecuteOperation");
+        // Indexing and scans pace themselves while this runs
+        core::ForegroundActivity::OperationScope foreground;
         SPDLOG_INFO("Starting batch operation {} with {} items", id_.id, items_.size());
 
-        bool success = true;
         std::string error_message;
 
+        // Copies run many files at once; everything else goes item by item
+        bool success = (type_ == OperationType::Copy) ? ExecuteCopyPipeline() : ExecuteItems();
+
+        if (cancel_requested_)
+        {
+            status_ = OperationStatus::Cancelled;
+            SPDLOG_INFO("Batch operation {} cancelled", id_.id);
+        }
+        else if (!success)
+        {
+            status_ = OperationStatus::Failed;
+            error_message = "Some items failed to process";
+            SPDLOG_WARN("Batch operation {} completed with errors", id_.id);
+        }
+        else
+        {
+            status_ = OperationStatus::Completed;
+            SPDLOG_INFO("Batch operation {} completed successfully", id_.id);
+        }
+
+        if (on_completion_)
+            on_completion_(success, error_message);
+    }
+
+    core::Path BatchOperation::DestinationFor(const OperationItem& item) const
+    {
+        if (!destination_.Empty())
+        {
+            return core::Path(destination_.String() + "\\" + item.source.Filename());
+        }
+        return item.destination;
+    }
+
+    bool BatchOperation::ExecuteItems()
+    {
+        bool success = true;
+
         for (size_t i = 0; i < items_.size() && !cancel_requested_; ++i)
         {
-            // Handle pause
-            if (pause_requested_)
-            {
-                std::unique_lock<std::mutex> lock(pause_mutex_);
-                pause_cv_.wait(lock, [this] { return !pause_requested_ || cancel_requested_; });
-            }
+            WaitWhilePaused();
 
             if (cancel_requested_)
                 break;
 
             const auto& item = items_[i];
+            uint64_t item_start_bytes = 0;
             
             {
                 std::lock_guard<std::mutex> lock(progress_mutex_);
                 progress_.current_item = item.source.String();
+                item_start_bytes = progress_.completed_bytes;
             }
 
             bool item_success = false;
 
             switch (type_)
             {
-            case OperationType::Copy:
-                {
-                    core::Path dest = destination_;
-                    if (!destination_.String().empty())
-                    {
-                        dest = core::Path(destination_.String() + "\\" + item.source.Filename());
-                    }
-                    else
-                    {
-                        dest = item.destination;
-                    }
-                    item_success = CopyFileInternal(item.source, dest);
-                }
-                break;
-
             case OperationType::Move:
-                {
-                    core::Path dest = destination_;
-                    if (!destination_.String().empty())
-                    {
-                        dest = core::Path(destination_.String() + "\\" + item.source.Filename());
-                    }
-                    else
-                    {
-                        dest = item.destination;
-                    }
-                    item_success = MoveFileInternal(item.source, dest);
-                }
+                item_success = MoveFileInternal(item.source, DestinationFor(item));
                 break;
 
             case OperationType::Delete:
@@ -158,6 +338,9 @@ namespace opacity::filesystem
             case OperationType::Rename:
                 item_success = MoveFileInternal(item.source, item.destination);
                 break;
+
+            case OperationType::Copy:
+                break;      // ExecuteCopyPipeline
             }
 
             if (!item_success)
@@ -169,116 +352,594 @@ namespace opacity::filesystem
             {
                 std::lock_guard<std::mutex> lock(progress_mutex_);
                 progress_.completed_items = i + 1;
-                progress_.completed_bytes += item.size;
-                progress_.percentage = (progress_.total_bytes > 0) 
-                    ? (100.0 * progress_.completed_bytes / progress_.total_bytes) 
-                    : (100.0 * progress_.completed_items / progress_.total_items);
-
-                // Calculate speed
-                auto now = std::chrono::steady_clock::now();
-                auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - last_progress_time_);
-                if (elapsed.count() > 100)
-                {
-                    uint64_t bytes_diff = progress_.completed_bytes - last_progress_bytes_;
-                    progress_.speed_bytes_per_sec = (bytes_diff * 1000.0) / elapsed.count();
-                    last_progress_bytes_ = progress_.completed_bytes;
-                    last_progress_time_ = now;
-
-                    // Estimate remaining time
-                    if (progress_.speed_bytes_per_sec > 0)
-                    {
-                        uint64_t remaining_bytes = progress_.total_bytes - progress_.completed_bytes;
-                        auto remaining_sec = static_cast<int64_t>(remaining_bytes / progress_.speed_bytes_per_sec);
-                        progress_.estimated_remaining = std::chrono::seconds(remaining_sec);
-                    }
-                }
+                progress_.completed_bytes = item_start_bytes + item.size;
+                UpdateRatesLocked();
             }
 
-            if (on_progress_)
-                on_progress_(GetProgress());
+            NotifyProgress();
         }
 
-        if (cancel_requested_)
+        return success;
+    }
+
+    bool BatchOperation::ExecuteCopyPipeline()
+    {
+        // This thread walks the items, resolves conflicts and creates
+        // folders, feeding files to workers that copy them concurrently.
+        // The pool is sized for the slowest volume involved, so a spinning
+        // disk on either end gets one file at a time.
+        size_t workers = 0;
+        VolumeProfile dest_volume = StorageTopology::GetVolumeProfile(
+            destination_.Empty() && !items_.empty() ? items_.front().destination : destination_);
+        std::string last_source_root;
+        for (const auto& item : items_)
         {
-            status_ = OperationStatus::Cancelled;
-            SPDLOG_INFO("Batch operation {} cancelled", id_.id);
+            VolumeProfile source_volume = StorageTopology::GetVolumeProfile(item.source);
+            if (source_volume.root == last_source_root)
+                continue;
+            last_source_root = source_volume.root;
+
+            size_t parallelism = StorageTopology::GetTransferParallelism(source_volume, dest_volume);
+            workers = (workers == 0) ? parallelism : std::min(workers, parallelism);
         }
-        else if (!success)
+        workers = std::max<size_t>(workers, 1);
+        SPDLOG_DEBUG("Batch operation {} copying with {} workers", id_.id, workers);
+
+        OpenJournal();
+
+        std::atomic<bool> success{true};
+
+        // One count per queued file plus one held while the item is walked;
+        // the last one out marks the item complete
+        std::unique_ptr<std::atomic<size_t>[]> outstanding(new std::atomic<size_t>[items_.size()]());
+        auto release = [&](size_t item)
         {
-            status_ = OperationStatus::Failed;
-            error_message = "Some items failed to process";
-            SPDLOG_WARN("Batch operation {} completed with errors", id_.id);
+            if (outstanding[item].fetch_sub(1) == 1)
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex_);
+                progress_.completed_items++;
+                UpdateRatesLocked();
+            }
+        };
+
+        CopyTaskQueue queue(workers * 64, [&](const CopyTask& task)
+        {
+            WaitWhilePaused();
+            if (!cancel_requested_ && !CopyOneFile(task))
+            {
+                success = false;
+            }
+            release(task.item);
+        });
+
+        // The walk below only runs as far ahead as the queue allows, so
+        // folders are sized separately and the totals stream in while the
+        // first files are already copying
+        std::atomic<bool> sizing_done{false};
+        core::TaskOptions sizer_options;
+        sizer_options.priority = core::TaskPriority::Background;
+        core::TaskGroup sizer;
+        sizer.Spawn(1, [&] { SizeItems(sizing_done); }, std::move(sizer_options));
+
+        // The workers are pool tasks helping this one, which copies files
+        // itself whenever the queue is full and whatever is left after the walk
+        core::TaskGroup pool;
+        pool.Spawn(workers, [&queue] { queue.Work(); });
+
+        for (size_t i = 0; i < items_.size() && !cancel_requested_; ++i)
+        {
+            WaitWhilePaused();
+
+            if (cancel_requested_)
+                break;
+
+            const auto& item = items_[i];
+            {
+                std::lock_guard<std::mutex> lock(progress_mutex_);
+                progress_.current_item = item.source.String();
+            }
+
+            outstanding[i] = 1;
+            if (!QueueCopyItem(item, i, queue, outstanding.get()))
+            {
+                success = false;
+            }
+            release(i);
+            NotifyProgress();
         }
-        else
+
+        queue.Close();
+        queue.Work();
+        pool.Close();
+
+        sizing_done = true;
+        sizer.Close();
+
+        if (journal_)
         {
-            status_ = OperationStatus::Completed;
-            SPDLOG_INFO("Batch operation {} completed successfully", id_.id);
+            // A failed copy keeps its journal for a later resume
+            if (success || cancel_requested_)
+                journal_->CompleteOperation(journal_id_);
+            else
+                SaveJournal(true);
         }
 
-        if (on_completion_)
-            on_completion_(success, error_message);
+        NotifyProgress();
+        return success;
     }
 
-    bool BatchOperation::CopyFileInternal(const core::Path& source, const core::Path& dest)
+    void BatchOperation::SizeItems(const std::atomic<bool>& done)
     {
-        try
+        bool has_folders = false;
+        std::error_code ec;
+        for (const auto& item : items_)
         {
-            fs::path src_path(source.String());
-            fs::path dst_path(dest.String());
+            has_folders = has_folders || fs::is_directory(fs::path(item.source.String()), ec);
+        }
+        if (!has_folders)
+            return;
 
-            // Check for conflict
-            if (fs::exists(dst_path))
+        {
+            std::lock_guard<std::mutex> lock(progress_mutex_);
+            progress_.sizing = true;
+        }
+
+        for (const auto& item : items_)
+        {
+            fs::path src_path(item.source.String());
+            if (done || cancel_requested_ || !fs::is_directory(src_path, ec))
+                continue;
+
+            // The item's own size is replaced by what the walk finds; the
+            // total is published in steps to keep the lock quiet
+            uint64_t discovered = 0;
+            uint64_t accounted = item.size;
+            size_t since_publish = 0;
+
+            auto publish = [&]()
             {
-                FileConflict conflict;
-                conflict.source_path = source;
-                conflict.destination_path = dest;
-                conflict.is_directory = fs::is_directory(dst_path);
+                std::lock_guard<std::mutex> lock(progress_mutex_);
+                progress_.total_bytes = progress_.total_bytes + discovered - accounted;
+                accounted = discovered;
+                since_publish = 0;
+            };
+
+            fs::recursive_directory_iterator it(src_path, fs::directory_options::skip_permission_denied, ec);
+            for (fs::recursive_directory_iterator end; !ec && it != end; it.increment(ec))
+            {
+                if (done || cancel_requested_)
+                    break;
 
-                if (!conflict.is_directory)
+                if (it->is_regular_file(ec))
                 {
-                    conflict.source_size = fs::file_size(src_path);
-                    conflict.dest_size = fs::file_size(dst_path);
+                    discovered += it->file_size(ec);
                 }
+                if (++since_publish >= 256 && discovered > accounted)
+                {
+                    publish();
+                }
+            }
 
-                ConflictResolution resolution = HandleConflict(conflict);
+            // A partial walk only ever raises the total
+            if (discovered > accounted || (!done && !cancel_requested_))
+            {
+                publish();
+            }
+        }
 
-                switch (resolution)
-                {
-                case ConflictResolution::Skip:
+        std::lock_guard<std::mutex> lock(progress_mutex_);
+        progress_.sizing = false;
+        UpdateRatesLocked();
+    }
+
+    bool BatchOperation::QueueCopyItem(const OperationItem& item, size_t index, CopyTaskQueue& queue,
+                                       std::atomic<size_t>* outstanding)
+    {
+        core::Path dest = DestinationFor(item);
+
+        try
+        {
+            fs::path src_path(item.source.String());
+            fs::path dst_path(dest.String());
+
+            // A resumed copy settled this item's conflicts already, and
+            // what is there now is its own work
+            std::string target;
+            {
+                std::lock_guard<std::mutex> lock(journal_mutex_);
+                target = item_targets_[index];
+            }
+
+            if (!target.empty())
+            {
+                dst_path = fs::path(target);
+            }
+            else
+            {
+                if (!ResolveConflict(item.source, dest, dst_path))
                     return true;
-                case ConflictResolution::Overwrite:
-                    fs::remove_all(dst_path);
-                    break;
-                case ConflictResolution::Rename:
-                    dst_path = fs::path(GenerateUniqueName(dest).String());
-                    break;
-                default:
-                    break;
-                }
+
+                std::lock_guard<std::mutex> lock(journal_mutex_);
+                item_targets_[index] = core::Path(dst_path).String();
+                journal_dirty_ = true;
             }
 
             // Create parent directories
             fs::create_directories(dst_path.parent_path());
 
-            // Copy
-            if (fs::is_directory(src_path))
+            if (!fs::is_directory(src_path))
             {
-                fs::copy(src_path, dst_path, fs::copy_options::recursive | fs::copy_options::overwrite_existing);
+                outstanding[index]++;
+                queue.Push(CopyTask{src_path, dst_path, item.size, index});
+                return true;
             }
-            else
+
+            // Totals come from SizeItems, which runs ahead of this walk
+            fs::create_directories(dst_path);
+
+            for (const auto& entry : fs::recursive_directory_iterator(src_path))
             {
-                fs::copy_file(src_path, dst_path, fs::copy_options::overwrite_existing);
-            }
+                if (cancel_requested_)
+                    break;
 
+                fs::path target = dst_path / fs::relative(entry.path(), src_path);
+                if (entry.is_directory())
+                {
+                    fs::create_directories(target);
+                    continue;
+                }
+
+                outstanding[index]++;
+                queue.Push(CopyTask{entry.path(), target, entry.file_size(), index});
+            }
             return true;
         }
         catch (const std::exception& e)
         {
             std::lock_guard<std::mutex> lock(failed_mutex_);
-            failed_items_.emplace_back(source.String(), e.what());
-            SPDLOG_ERROR("Failed to copy {}: {}", source.String(), e.what());
+            failed_items_.emplace_back(item.source.String(), e.what());
+            SPDLOG_ERROR("Failed to copy {}: {}", item.source.String(), e.what());
+            return false;
+        }
+    }
+
+    bool BatchOperation::CopyOneFile(const CopyTask& task)
+    {
+        OPACITY_PROFILE_ZONE("BatchOperation::CopyOneFile");
+        core::Path source(task.source);
+        core::Path dest(task.dest);
+        std::string key = dest.String();
+
+        JournalFile recorded;
+        bool known = false;
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex_);
+            auto it = journal_files_.find(key);
+            if (it != journal_files_.end())
+            {
+                recorded = it->second;
+                known = true;
+            }
+        }
+
+        // Finished before the copy was interrupted, and still intact
+        if (known && recorded.done && VerifyCopied(task, recorded))
+        {
+            AddCompletedBytes(task.size);
+            return true;
+        }
+
+        CopyOptions options;
+        options.hash = checksums_;
+        if (known && !recorded.done && recorded.size == task.size)
+        {
+            options.resume_offset = recorded.offset;
+            options.resume_state = recorded.hash_state;
+        }
+        if (journal_)
+        {
+            options.checkpoint = [this, &key, &task](uint64_t offset, const std::string& hash_state)
+            {
+                JournalFile file;
+                file.size = task.size;
+                file.offset = offset;
+                file.hash_state = hash_state;
+                RecordFile(key, file);
+            };
+        }
+
+        uint64_t reported = 0;
+        auto report = [this, &task, &reported](uint64_t copied, uint64_t)
+        {
+            // Pausing and cancelling take effect inside a large file, not after it
+            WaitWhilePaused();
+            if (cancel_requested_)
+                return false;
+
+            copied = std::min(copied, task.size);
+            if (copied > reported)
+            {
+                AddCompletedBytes(copied - reported);
+                reported = copied;
+            }
+            return true;
+        };
+
+        // A large file already there only has its changed blocks written;
+        // one left untouched by a failed update can still be copied whole
+        CopyResult result;
+        std::error_code ec;
+        bool in_place = !known && UpdatesInPlace(task.size) && fs::is_regular_file(task.dest, ec);
+        if (in_place)
+        {
+            result = copy_engine_.Update(source, dest, report);
+            if (result.success)
+            {
+                bytes_unchanged_ += result.bytes_copied - result.bytes_written;
+            }
+            else if (!result.cancelled && result.bytes_written == 0)
+            {
+                SPDLOG_DEBUG("Update of {} in place failed ({}), copying", dest.String(), result.error_message);
+                in_place = false;
+            }
+        }
+        if (!in_place)
+        {
+            result = copy_engine_.Copy(source, dest, options, report);
+        }
+
+        // Whatever happened, the file's share of the total is settled now
+        if (task.size > reported)
+        {
+            AddCompletedBytes(task.size - reported);
+        }
+
+        if (result.success && checksums_)
+        {
+            JournalFile file;
+            file.size = task.size;
+            file.done = true;
+            file.hash = result.hash;
+            RecordFile(key, file);
+        }
+
+        if (result.success || result.cancelled)
+            return true;
+
+        std::lock_guard<std::mutex> lock(failed_mutex_);
+        failed_items_.emplace_back(source.String(), result.error_message);
+        SPDLOG_ERROR("Failed to copy {}: {}", source.String(), result.error_message);
+        return false;
+    }
+
+    bool BatchOperation::VerifyCopied(const CopyTask& task, const JournalFile& recorded)
+    {
+        std::error_code ec;
+        if (recorded.size != task.size || fs::file_size(task.dest, ec) != recorded.size || ec)
+            return false;
+        if (recorded.hash.empty())
+            return true;
+
+        std::string hash;
+        if (copy_engine_.HashFile(core::Path(task.dest), hash) && hash == recorded.hash)
+            return true;
+
+        SPDLOG_WARN("{} does not match its recorded hash, copying it again", core::Path(task.dest).String());
+        return false;
+    }
+
+    void BatchOperation::RecordFile(const std::string& dest, const JournalFile& file)
+    {
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex_);
+            journal_files_[dest] = file;
+            journal_dirty_ = true;
+        }
+        SaveJournal(false);
+    }
+
+    void BatchOperation::OpenJournal()
+    {
+        item_targets_.resize(items_.size());
+        if (!journal_ || !journal_id_.empty())
+            return;
+
+        auto now = std::chrono::system_clock::now();
+        journal_id_ = "copy-" + std::to_string(std::chrono::duration_cast<std::chrono::milliseconds>(
+            now.time_since_epoch()).count()) + "-" + std::to_string(id_.id);
+
+        core::PendingOperation pending;
+        pending.id = journal_id_;
+        pending.type = "copy";
+        pending.startTime = now;
+        for (const auto& item : items_)
+        {
+            pending.sourcePaths.emplace_back(item.source.WString());
+        }
+        pending.destination = fs::path(destination_.WString());
+        pending.totalCount = static_cast<int>(items_.size());
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex_);
+            pending.customData = SerializeJournalLocked();
+            journal_written_ = std::chrono::steady_clock::now();
+        }
+        journal_->RecordPendingOperation(pending);
+    }
+
+    void BatchOperation::SaveJournal(bool force)
+    {
+        if (!journal_)
+            return;
+
+        // A write already under way will be followed by the next one
+        std::unique_lock<std::mutex> writer(journal_write_mutex_, std::defer_lock);
+        if (force)
+            writer.lock();
+        else if (!writer.try_lock())
+            return;
+
+        std::string data;
+        int finished = 0;
+        {
+            std::lock_guard<std::mutex> lock(journal_mutex_);
+            auto now = std::chrono::steady_clock::now();
+            if (!journal_dirty_ || (!force && now - journal_written_ < kJournalInterval))
+                return;
+
+            data = SerializeJournalLocked();
+            for (const auto& entry : journal_files_)
+            {
+                finished += entry.second.done ? 1 : 0;
+            }
+            journal_dirty_ = false;
+            journal_written_ = now;
+        }
+        journal_->UpdateOperationProgress(journal_id_, finished, data);
+    }
+
+    std::string BatchOperation::SerializeJournalLocked() const
+    {
+        json j;
+        j["version"] = kJournalVersion;
+        j["checksums"] = checksums_;
+        j["destination"] = destination_.String();
+
+        json items = json::array();
+        for (size_t i = 0; i < items_.size(); ++i)
+        {
+            const auto& item = items_[i];
+            json entry;
+            entry["source"] = item.source.String();
+            entry["destination"] = item.destination.String();
+            entry["size"] = item.size;
+            entry["directory"] = item.is_directory;
+            entry["target"] = (i < item_targets_.size()) ? item_targets_[i] : std::string();
+            items.push_back(std::move(entry));
+        }
+        j["items"] = std::move(items);
+
+        json files = json::object();
+        for (const auto& [dest, file] : journal_files_)
+        {
+            json entry;
+            entry["size"] = file.size;
+            entry["done"] = file.done;
+            if (file.done)
+            {
+                entry["hash"] = file.hash;
+            }
+            else
+            {
+                entry["offset"] = file.offset;
+                entry["state"] = file.hash_state;
+            }
+            files[dest] = std::move(entry);
+        }
+        j["files"] = std::move(files);
+
+        return j.dump();
+    }
+
+    void BatchOperation::AddCompletedBytes(uint64_t bytes)
+    {
+        {
+            std::lock_guard<std::mutex> lock(progress_mutex_);
+            progress_.completed_bytes += bytes;
+            UpdateRatesLocked();
+        }
+        NotifyProgress();
+    }
+
+    void BatchOperation::NotifyProgress()
+    {
+        if (!on_progress_)
+            return;
+
+        // Workers report concurrently; the callback sees one call at a time
+        std::lock_guard<std::mutex> lock(callback_mutex_);
+        on_progress_(GetProgress());
+    }
+
+    void BatchOperation::UpdateRatesLocked()
+    {
+        // Totals can trail the transfer while folders are still being sized
+        progress_.percentage = (progress_.total_bytes > 0) 
+            ? (100.0 * progress_.completed_bytes / progress_.total_bytes) 
+            : (100.0 * progress_.completed_items / progress_.total_items);
+        progress_.percentage = std::min(progress_.percentage, 100.0);
+
+        // Calculate speed
+        auto now = std::chrono::steady_clock::now();
+        double elapsed = std::chrono::duration<double>(now - last_progress_time_).count();
+        if (elapsed >= kRateSampleSeconds)
+        {
+            // Exponentially weighted over a few seconds: bursts of tiny
+            // files and write-cache flushes even out, real changes in speed
+            // still show within a few samples
+            double instant = (progress_.completed_bytes - last_progress_bytes_) / elapsed;
+            double weight = 1.0 - std::exp(-elapsed / kRateTimeConstantSeconds);
+            smoothed_rate_ = (last_progress_bytes_ == 0) ? instant : smoothed_rate_ + weight * (instant - smoothed_rate_);
+
+            progress_.speed_bytes_per_sec = smoothed_rate_;
+            last_progress_bytes_ = progress_.completed_bytes;
+            last_progress_time_ = now;
+
+            // Estimate remaining time
+            if (progress_.speed_bytes_per_sec > 0)
+            {
+                uint64_t remaining_bytes = (progress_.total_bytes > progress_.completed_bytes)
+                    ? progress_.total_bytes - progress_.completed_bytes : 0;
+                auto remaining_sec = static_cast<int64_t>(remaining_bytes / progress_.speed_bytes_per_sec);
+                progress_.estimated_remaining = std::chrono::seconds(remaining_sec);
+            }
+        }
+    }
+
+    void BatchOperation::WaitWhilePaused()
+    {
+        if (pause_requested_)
+        {
+            std::unique_lock<std::mutex> lock(pause_mutex_);
+            core::BlockingScope blocking;   // Other work takes the slot until resumed
+            pause_cv_.wait(lock, [this] { return !pause_requested_ || cancel_requested_; });
+        }
+    }
+
+    bool BatchOperation::ResolveConflict(const core::Path& source, const core::Path& dest, fs::path& dst_path)
+    {
+        if (!fs::exists(dst_path))
+            return true;
+
+        FileConflict conflict;
+        conflict.source_path = source;
+        conflict.destination_path = dest;
+        conflict.is_directory = fs::is_directory(dst_path);
+
+        fs::path src_path(source.String());
+        if (!conflict.is_directory && !fs::is_directory(src_path))
+        {
+            conflict.source_size = fs::file_size(src_path);
+            conflict.dest_size = fs::file_size(dst_path);
+        }
+
+        ConflictResolution resolution = HandleConflict(conflict);
+
+        switch (resolution)
+        {
+        case ConflictResolution::Skip:
             return false;
+        case ConflictResolution::Overwrite:
+            // Kept for CopyOneFile to update in place
+            if (conflict.is_directory || fs::is_directory(src_path) || !UpdatesInPlace(conflict.source_size))
+                fs::remove_all(dst_path);
+            break;
+        case ConflictResolution::Rename:
+            dst_path = fs::path(GenerateUniqueName(dest).String());
+            break;
+        default:
+            break;
         }
+        return true;
     }
 
     bool BatchOperation::MoveFileInternal(const core::Path& source, const core::Path& dest)
@@ -315,13 +976,56 @@ namespace opacity::filesystem
             // Create parent directories
             fs::create_directories(dst_path.parent_path());
 
-            // Move
-            fs::rename(src_path, dst_path);
+            // Within a volume the whole tree moves with one rename
+            if (StorageTopology::SameVolume(StorageTopology::GetVolumeProfile(source), StorageTopology::GetVolumeProfile(core::Path(dst_path))))
+            {
+                fs::rename(src_path, dst_path);
+                return true;
+            }
 
-            return true;
+            // Across volumes: copy everything, then remove the source
+            auto keep_going = [this](uint64_t, uint64_t)
+            {
+                WaitWhilePaused();
+                return !cancel_requested_.load();
+            };
+            auto copy = [&](const fs::path& from, const fs::path& to)
+            {
+                CopyResult result = copy_engine_.Copy(core::Path(from), core::Path(to), keep_going);
+                if (!result.success && !result.cancelled)
+                    throw std::runtime_error(result.error_message);
+                return result.success;
+            };
+
+            if (!fs::is_directory(src_path))
+            {
+                if (!copy(src_path, dst_path))
+                    return false;
+                fs::remove(src_path);
+                return true;
+            }
+
+            fs::create_directories(dst_path);
+            for (const auto& entry : fs::recursive_directory_iterator(src_path))
+            {
+                fs::path target = dst_path / fs::relative(entry.path(), src_path);
+                if (entry.is_directory())
+                {
+                    fs::create_directories(target);
+                }
+                else if (!copy(entry.path(), target))
+                {
+                    return false;
+                }
+            }
+
+            return DeleteTree(source);
         }
         catch (const std::exception& e)
         {
+            if (cancel_requested_)
+                return false;
+
             std::lock_guard<std::mutex> lock(failed_mutex_);
             failed_items_.emplace_back(source.String(), e.what());
             SPDLOG_ERROR("Failed to move {}: {}", source.String(), e.what());
@@ -337,7 +1041,7 @@ namespace opacity::filesystem
             
             if (fs::is_directory(fspath))
             {
-                fs::remove_all(fspath);
+                return DeleteTree(path);
             }
             else
             {
@@ -355,6 +1059,27 @@ namespace opacity::filesystem
         }
     }
 
+    bool BatchOperation::DeleteTree(const core::Path& path)
+    {
+        // Deletes are metadata updates, which even a spinning disk takes a
+        // couple of at once
+        VolumeProfile volume = StorageTopology::GetVolumeProfile(path);
+        TreeDeleter deleter(std::max<size_t>(volume.parallelism, 2));
+
+        // Every deleting thread waits out a pause, not only the one reporting
+        TreeDeleteResult result = deleter.Delete(path, nullptr, [this]()
+        {
+            WaitWhilePaused();
+            return !cancel_requested_.load();
+        });
+
+        if (result.cancelled)
+            return false;
+        if (!result.success)
+            throw std::runtime_error(result.error_message);
+        return true;
+    }
+
     ConflictResolution BatchOperation::HandleConflict(const FileConflict& conflict)
     {
         if (on_conflict_)
@@ -382,6 +1107,43 @@ namespace opacity::filesystem
         return core::Path(new_path.string());
     }
 
+    bool BatchOperation::IsInteractive() const
+    {
+        if (priority_ != OperationPriority::Auto)
+            return priority_ == OperationPriority::Interactive;
+
+        // What the user just dragged or pasted and is waiting to see land
+        std::lock_guard<std::mutex> lock(progress_mutex_);
+        return progress_.total_items <= 32 && progress_.total_bytes < 64ull * 1024 * 1024;
+    }
+
+    const std::vector<VolumeProfile>& BatchOperation::GetDevices() const
+    {
+        std::call_once(devices_once_, [this]()
+        {
+            auto add = [this](const core::Path& path)
+            {
+                VolumeProfile volume = StorageTopology::GetVolumeProfile(path);
+                bool known = std::any_of(devices_.begin(), devices_.end(),
+                    [&volume](const VolumeProfile& device) { return device.device == volume.device; });
+                if (!known)
+                    devices_.push_back(volume);
+            };
+
+            // Top-level items nearly always share a volume, so the probe
+            // cache keeps this cheap even for large selections
+            for (const auto& item : items_)
+            {
+                add(item.source);
+                if (type_ == OperationType::Copy || type_ == OperationType::Move)
+                {
+                    add(DestinationFor(item));
+                }
+            }
+        });
+        return devices_;
+    }
+
     std::vector<std::pair<std::string, std::string>> BatchOperation::GetFailedItems() const
     {
         std::lock_guard<std::mutex> lock(failed_mutex_);
@@ -403,7 +1165,16 @@ namespace opacity::filesystem
     }
 
     // OperationQueue implementation
-    OperationQueue::OperationQueue() = default;
+    OperationQueue::OperationQueue()
+    {
+        // A disk that seeks is fastest with one stream; flash and servers
+        // keep up with a few operations, each already running files in parallel
+        kind_concurrency_[StorageKind::Rotational] = 1;
+        kind_concurrency_[StorageKind::Unknown] = 1;
+        kind_concurrency_[StorageKind::SolidState] = 2;
+        kind_concurrency_[StorageKind::Network] = 2;
+        kind_concurrency_[StorageKind::Nvme] = 3;
+    }
 
     OperationQueue::~OperationQueue()
     {
@@ -412,6 +1183,16 @@ namespace opacity::filesystem
 
     BatchOperation::OperationId OperationQueue::AddOperation(std::unique_ptr<BatchOperation> operation)
     {
+        if (journal_ && operation->GetType() == OperationType::Copy && !operation->GetJournal() &&
+            operation->GetStatus() == OperationStatus::Pending)
+        {
+            operation->SetJournal(journal_);
+        }
+
+        // Probed here, once and outside the lock; ProcessQueue and the
+        // progress window then read the cached list
+        operation->GetDevices();
+
         std::lock_guard<std::mutex> lock(operations_mutex_);
         auto id = operation->GetId();
         operations_.push_back(std::move(operation));
@@ -552,33 +1333,106 @@ namespace opacity::filesystem
             on_queue_changed_();
     }
 
+    void OperationQueue::SetDeviceConcurrency(StorageKind kind, size_t max)
+    {
+        std::lock_guard<std::mutex> lock(operations_mutex_);
+        kind_concurrency_[kind] = std::max<size_t>(max, 1);
+    }
+
+    void OperationQueue::SetDeviceConcurrency(const std::string& device, size_t max)
+    {
+        std::lock_guard<std::mutex> lock(operations_mutex_);
+        device_concurrency_[device] = std::max<size_t>(max, 1);
+    }
+
+    size_t OperationQueue::GetDeviceConcurrency(const VolumeProfile& device) const
+    {
+        auto it = device_concurrency_.find(device.device);
+        if (it != device_concurrency_.end())
+            return it->second;
+
+        auto kind = kind_concurrency_.find(device.kind);
+        return (kind != kind_concurrency_.end()) ? kind->second : 1;
+    }
+
+    size_t OperationQueue::ResumeJournaled()
+    {
+        if (!journal_)
+            return 0;
+
+        size_t resumed = 0;
+        for (const auto& pending : journal_->GetPendingOperations())
+        {
+            if (pending.type != "copy")
+                continue;
+
+            if (auto operation = BatchOperation::FromJournal(pending, journal_))
+            {
+                AddOperation(std::move(operation));
+                ++resumed;
+            }
+            else
+            {
+                journal_->ClearPendingOperation(pending.id);
+            }
+        }
+        if (resumed > 0)
+            SPDLOG_INFO("Resuming {} interrupted copies", resumed);
+        return resumed;
+    }
+
     void OperationQueue::ProcessQueue()
     {
+        OPACITY_PROFILE_ZONE("OperationQueue::ProcessQueue");
         std::lock_guard<std::mutex> lock(operations_mutex_);
         
+        // Running operations per device; paused ones do no I/O
         size_t active = 0;
+        std::unordered_map<std::string, size_t> busy;
         for (const auto& op : operations_)
         {
             if (op->GetStatus() == OperationStatus::InProgress)
+            {
                 ++active;
+                for (const auto& device : op->GetDevices())
+                    busy[device.device]++;
+            }
         }
 
-        // Start pending operations if we have capacity
+        // Interactive work first, each class in the order it was queued
+        std::vector<std::pair<BatchOperation*, bool>> pending;
         for (auto& op : operations_)
+        {
+            if (op->GetStatus() == OperationStatus::Pending)
+                pending.emplace_back(op.get(), op->IsInteractive());
+        }
+        std::stable_partition(pending.begin(), pending.end(),
+            [](const auto& entry) { return entry.second; });
+
+        // Start what fits; a pending operation on a busy disk does not hold
+        // back one behind it on an idle disk
+        for (auto [op, interactive] : pending)
         {
             if (active >= max_concurrent_)
                 break;
-            
-            if (op->GetStatus() == OperationStatus::Pending)
-            {
-                op->Start();
-                ++active;
-            }
+
+            size_t extra = interactive ? 1 : 0;
+            const auto& devices = op->GetDevices();
+            bool fits = std::all_of(devices.begin(), devices.end(),
+                [&](const VolumeProfile& device) { return busy[device.device] < GetDeviceConcurrency(device) + extra; });
+            if (!fits)
+                continue;
+
+            op->Start();
+            ++active;
+            for (const auto& device : devices)
+                busy[device.device]++;
         }
     }
 
     void OperationQueue::RenderUI()
     {
+        OPACITY_PROFILE_ZONE("OperationQueue::RenderUI");
         std::lock_guard<std::mutex> lock(operations_mutex_);
         
         if (operations_.empty())
@@ -643,8 +1497,11 @@ namespace opacity::filesystem
                 {
                     double speed_mb = progress.speed_bytes_per_sec / (1024.0 * 1024.0);
                     auto eta = progress.estimated_remaining.count();
-                    ImGui::Text("%.1f MB/s - %lld:%02lld remaining", 
-                        speed_mb, eta / 60, eta % 60);
+                    if (progress.sizing)
+                        ImGui::Text("%.1f MB/s - sizing...", speed_mb);
+                    else
+                        ImGui::Text("%.1f MB/s - %lld:%02lld remaining", 
+                            speed_mb, eta / 60, eta % 60);
                 }
 
                 // Control buttons
@@ -667,6 +1524,34 @@ namespace opacity::filesystem
             // RAII will pop ID
         }
 
+        // Throughput per device; an operation's speed counts on every
+        // device it reads or writes
+        std::vector<std::pair<VolumeProfile, double>> device_speeds;
+        for (const auto& op : operations_)
+        {
+            if (op->GetStatus() != OperationStatus::InProgress)
+                continue;
+
+            double speed = op->GetProgress().speed_bytes_per_sec;
+            for (const auto& device : op->GetDevices())
+            {
+                auto it = std::find_if(device_speeds.begin(), device_speeds.end(),
+                    [&device](const auto& entry) { return entry.first.device == device.device; });
+                if (it == device_speeds.end())
+                    device_speeds.emplace_back(device, speed);
+                else
+                    it->second += speed;
+            }
+        }
+
+        for (const auto& [device, speed] : device_speeds)
+        {
+            ImGui::TextDisabled("%s (%s): %.1f MB/s", device.device.c_str(),
+                StorageTopology::GetKindName(device.kind), speed / (1024.0 * 1024.0));
+        }
+        if (!device_speeds.empty())
+            ImGui::Separator();
+
         // Queue controls
         if (ImGui::Button("Pause All"))
             PauseAll();
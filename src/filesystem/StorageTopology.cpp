@@ -0,0 +1,213 @@
+#include "opacity/filesystem/StorageTopology.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/TaskScheduler.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <winioctl.h>
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <unordered_map>
+
+namespace opacity::filesystem
+{
+    namespace
+    {
+        std::mutex profiles_mutex;
+        std::unordered_map<std::string, VolumeProfile> profiles;
+
+        size_t DefaultParallelism(StorageKind kind)
+        {
+            switch (kind)
+            {
+            case StorageKind::Nvme:
+                return 16;
+            case StorageKind::SolidState:
+                return 8;
+            case StorageKind::Network:
+                return 8;       // Hides the round trips of each open and close
+            case StorageKind::Rotational:
+                return 1;
+            default:
+                return 2;
+            }
+        }
+
+        std::string VolumeRoot(const core::Path& path)
+        {
+            wchar_t volume[MAX_PATH] = {};
+            if (!GetVolumePathNameW(path.WString().c_str(), volume, MAX_PATH))
+            {
+                return std::string();
+            }
+            return core::Path(std::wstring(volume)).String();
+        }
+
+        bool QueryProperty(HANDLE device, STORAGE_PROPERTY_ID id, void* output, DWORD size)
+        {
+            STORAGE_PROPERTY_QUERY query{};
+            query.PropertyId = id;
+            query.QueryType = PropertyStandardQuery;
+
+            DWORD returned = 0;
+            return DeviceIoControl(device, IOCTL_STORAGE_QUERY_PROPERTY, &query, sizeof(query),
+                                   output, size, &returned, nullptr) && returned >= sizeof(DWORD) * 2;
+        }
+
+        void Probe(VolumeProfile& profile)
+        {
+            const std::string& root = profile.root;
+            profile.device = root;
+
+            std::wstring wide_root = core::Path(root).WString();
+            if (root.size() > 1 && root[0] == '\\' && root[1] == '\\')
+            {
+                // "\\server\share\" -> "\\server"
+                profile.kind = StorageKind::Network;
+                profile.device = root.substr(0, root.find('\\', 2));
+                return;
+            }
+            if (GetDriveTypeW(wide_root.c_str()) == DRIVE_REMOTE)
+            {
+                profile.kind = StorageKind::Network;
+                return;
+            }
+
+            DWORD fs_flags = 0;
+            if (GetVolumeInformationW(wide_root.c_str(), nullptr, 0, nullptr, nullptr, &fs_flags, nullptr, 0))
+            {
+                profile.block_clone = (fs_flags & FILE_SUPPORTS_BLOCK_REFCOUNTING) != 0;
+            }
+
+            DWORD sectors_per_cluster = 0;
+            DWORD bytes_per_sector = 0;
+            DWORD free_clusters = 0;
+            DWORD total_clusters = 0;
+            if (GetDiskFreeSpaceW(wide_root.c_str(), &sectors_per_cluster, &bytes_per_sector, &free_clusters, &total_clusters))
+            {
+                profile.cluster_size = sectors_per_cluster * bytes_per_sector;
+            }
+
+            // "C:\" -> "\\.\C:"; no access rights are needed for the queries
+            if (root.size() < 2 || root[1] != ':')
+            {
+                return;
+            }
+            std::wstring device_name = L"\\\\.\\" + wide_root.substr(0, 2);
+            HANDLE device = CreateFileW(device_name.c_str(), 0, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                                        nullptr, OPEN_EXISTING, 0, nullptr);
+            if (device == INVALID_HANDLE_VALUE)
+            {
+                return;
+            }
+
+            // A volume spanning several disks reports ERROR_MORE_DATA and
+            // keeps its root as the device
+            VOLUME_DISK_EXTENTS extents{};
+            DWORD returned = 0;
+            if (DeviceIoControl(device, IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS, nullptr, 0,
+                                &extents, sizeof(extents), &returned, nullptr) &&
+                extents.NumberOfDiskExtents == 1)
+            {
+                profile.device = "PhysicalDrive" + std::to_string(extents.Extents[0].DiskNumber);
+            }
+
+            StorageKind kind = StorageKind::Unknown;
+
+            DEVICE_SEEK_PENALTY_DESCRIPTOR seek_penalty{};
+            if (QueryProperty(device, StorageDeviceSeekPenaltyProperty, &seek_penalty, sizeof(seek_penalty)))
+            {
+                kind = seek_penalty.IncursSeekPenalty ? StorageKind::Rotational : StorageKind::SolidState;
+            }
+
+            if (kind == StorageKind::SolidState)
+            {
+                STORAGE_DEVICE_DESCRIPTOR descriptor{};
+                if (QueryProperty(device, StorageDeviceProperty, &descriptor, sizeof(descriptor)) &&
+                    descriptor.BusType == BusTypeNvme)
+                {
+                    kind = StorageKind::Nvme;
+                }
+            }
+
+            CloseHandle(device);
+            profile.kind = kind;
+        }
+    }
+
+    namespace StorageTopology
+    {
+        VolumeProfile GetVolumeProfile(const core::Path& path)
+        {
+            std::string root = VolumeRoot(path);
+            std::string key = root;
+            std::transform(key.begin(), key.end(), key.begin(),
+                [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+            {
+                std::lock_guard<std::mutex> lock(profiles_mutex);
+                auto it = profiles.find(key);
+                if (it != profiles.end())
+                    return it->second;
+            }
+
+            // Probing can block on a sleeping disk or a slow share, so it
+            // runs unlocked; a racing probe just stores the same answer
+            VolumeProfile profile;
+            profile.root = root;
+            if (!root.empty())
+            {
+                Probe(profile);
+            }
+            profile.parallelism = DefaultParallelism(profile.kind);
+
+            SPDLOG_DEBUG("Volume {} is {} on {}, {} concurrent transfers", root, GetKindName(profile.kind),
+                         profile.device, profile.parallelism);
+
+            // Pool tasks that name this volume as their device take the same
+            if (!root.empty())
+            {
+                core::TaskScheduler::Get().SetIoLimit(core::TaskScheduler::IoDevice(core::Path(root)),
+                                                      profile.parallelism);
+            }
+
+            std::lock_guard<std::mutex> lock(profiles_mutex);
+            profiles[key] = profile;
+            return profile;
+        }
+
+        size_t GetTransferParallelism(const VolumeProfile& source, const VolumeProfile& dest)
+        {
+            return std::max<size_t>(1, std::min(source.parallelism, dest.parallelism));
+        }
+
+        bool SameVolume(const VolumeProfile& a, const VolumeProfile& b)
+        {
+            return !a.root.empty() && a.root.size() == b.root.size() &&
+                   std::equal(a.root.begin(), a.root.end(), b.root.begin(),
+                       [](char x, char y) { return std::tolower(static_cast<unsigned char>(x)) ==
+                                                   std::tolower(static_cast<unsigned char>(y)); });
+        }
+
+        const char* GetKindName(StorageKind kind)
+        {
+            switch (kind)
+            {
+            case StorageKind::SolidState:
+                return "SSD";
+            case StorageKind::Nvme:
+                return "NVMe";
+            case StorageKind::Rotational:
+                return "HDD";
+            case StorageKind::Network:
+                return "Network";
+            default:
+                return "Unknown";
+            }
+        }
+    }
+
+} // namespace opacity::filesystem
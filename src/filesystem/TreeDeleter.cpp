@@ -0,0 +1,315 @@
+#include "opacity/filesystem/TreeDeleter.h"
+#include "opacity/core/Logger.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace opacity::filesystem
+{
+    namespace
+    {
+        struct Folder
+        {
+            std::wstring path;
+            Folder* parent = nullptr;
+            std::atomic<size_t> pending{1};     // Its own listing plus each subfolder still there
+        };
+
+        // Deep build trees outgrow MAX_PATH; the \\?\ form has no limit but
+        // wants an absolute path with backslashes
+        std::wstring LongPath(std::wstring path)
+        {
+            std::replace(path.begin(), path.end(), L'/', L'\\');
+            while (path.size() > 3 && path.back() == L'\\')
+            {
+                path.pop_back();
+            }
+
+            if (path.rfind(L"\\\\?\\", 0) == 0)
+                return path;
+            if (path.rfind(L"\\\\", 0) == 0)
+                return L"\\\\?\\UNC\\" + path.substr(2);
+            return L"\\\\?\\" + path;
+        }
+
+        std::string DisplayPath(const std::wstring& path)
+        {
+            std::wstring display = path;
+            if (display.rfind(L"\\\\?\\UNC\\", 0) == 0)
+                display = L"\\\\" + display.substr(8);
+            else if (display.rfind(L"\\\\?\\", 0) == 0)
+                display = display.substr(4);
+            return core::Path(display).String();
+        }
+
+        // Returns 0 or the Win32 error
+        DWORD DeleteEntry(const std::wstring& path)
+        {
+            HANDLE handle = CreateFileW(path.c_str(), DELETE, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                                        nullptr, OPEN_EXISTING, FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS,
+                                        nullptr);
+            if (handle == INVALID_HANDLE_VALUE)
+            {
+                return GetLastError();
+            }
+
+            FILE_DISPOSITION_INFO_EX info{};
+            info.Flags = FILE_DISPOSITION_FLAG_DELETE | FILE_DISPOSITION_FLAG_POSIX_SEMANTICS |
+                         FILE_DISPOSITION_FLAG_IGNORE_READONLY_ATTRIBUTE;
+
+            DWORD error = 0;
+            if (!SetFileInformationByHandle(handle, FileDispositionInfoEx, &info, sizeof(info)))
+            {
+                error = GetLastError();
+                if (error == ERROR_INVALID_PARAMETER || error == ERROR_NOT_SUPPORTED || error == ERROR_INVALID_FUNCTION)
+                {
+                    // FAT and older NTFS: classic delete-on-close, which
+                    // refuses read-only files
+                    DWORD attributes = GetFileAttributesW(path.c_str());
+                    if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_READONLY))
+                    {
+                        SetFileAttributesW(path.c_str(), attributes & ~FILE_ATTRIBUTE_READONLY);
+                    }
+
+                    FILE_DISPOSITION_INFO basic{};
+                    basic.DeleteFile = TRUE;
+                    error = SetFileInformationByHandle(handle, FileDispositionInfo, &basic, sizeof(basic)) ? 0 : GetLastError();
+                }
+            }
+
+            CloseHandle(handle);
+            return error;
+        }
+    }
+
+    TreeDeleter::TreeDeleter(size_t threads)
+        : threads_(std::max<size_t>(threads, 1))
+    {
+    }
+
+    TreeDeleteResult TreeDeleter::Delete(const core::Path& path, const ProgressCallback& progress,
+                                         const CheckpointCallback& checkpoint) const
+    {
+        TreeDeleteResult result;
+
+        std::mutex mutex;
+        std::condition_variable wake;
+        std::deque<std::unique_ptr<Folder>> folders;    // Owns every folder seen; addresses stay put
+        std::vector<Folder*> work;
+        bool finished = false;
+        std::atomic<bool> stop{false};
+        std::atomic<uint64_t> files{0};
+        std::atomic<uint64_t> directories{0};
+        std::atomic<uint64_t> failures{0};
+        std::mutex progress_mutex;
+
+        auto halt = [&]()
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stop = true;
+            wake.notify_all();
+        };
+
+        // Each thread on its own, so a pause holds all of them
+        auto proceed = [&]()
+        {
+            if (stop)
+                return false;
+            if (checkpoint && !checkpoint())
+            {
+                halt();
+                return false;
+            }
+            return true;
+        };
+
+        auto fail = [&](const std::wstring& name, DWORD error)
+        {
+            failures++;
+            std::lock_guard<std::mutex> lock(mutex);
+            if (result.error_message.empty())
+            {
+                result.error_message = "Cannot delete " + DisplayPath(name) + " (error " + std::to_string(error) + ")";
+            }
+        };
+
+        std::wstring root_path = LongPath(path.WString());
+        DWORD root_attributes = GetFileAttributesW(root_path.c_str());
+        if (root_attributes == INVALID_FILE_ATTRIBUTES)
+        {
+            result.error_message = "Cannot delete " + path.String() + " (error " + std::to_string(GetLastError()) + ")";
+            return result;
+        }
+
+        // A file, link or junction goes by itself
+        if (!(root_attributes & FILE_ATTRIBUTE_DIRECTORY) || (root_attributes & FILE_ATTRIBUTE_REPARSE_POINT))
+        {
+            DWORD error = DeleteEntry(root_path);
+            if (error != 0)
+            {
+                result.error_message = "Cannot delete " + path.String() + " (error " + std::to_string(error) + ")";
+                return result;
+            }
+            result.success = true;
+            result.files_deleted = 1;
+            return result;
+        }
+
+        // Remove folders whose contents are gone, walking up while each
+        // removal empties the parent too
+        auto release = [&](Folder* folder)
+        {
+            while (folder != nullptr && folder->pending.fetch_sub(1) == 1)
+            {
+                DWORD error = DeleteEntry(folder->path);
+                if (error != 0)
+                    fail(folder->path, error);
+                else
+                    directories++;
+
+                if (folder->parent == nullptr)
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    finished = true;
+                    wake.notify_all();
+                }
+                folder = folder->parent;
+            }
+        };
+
+        auto process = [&](Folder* folder)
+        {
+            WIN32_FIND_DATAW data;
+            std::wstring pattern = folder->path + L"\\*";
+            HANDLE find = FindFirstFileExW(pattern.c_str(), FindExInfoBasic, &data, FindExSearchNameMatch,
+                                           nullptr, FIND_FIRST_EX_LARGE_FETCH);
+            if (find == INVALID_HANDLE_VALUE)
+            {
+                DWORD error = GetLastError();
+                if (error != ERROR_FILE_NOT_FOUND)
+                    fail(folder->path, error);
+                return;
+            }
+
+            // The listing is finished before anything in it is deleted
+            std::vector<std::wstring> entries;
+            std::vector<std::wstring> subfolders;
+            do
+            {
+                const wchar_t* name = data.cFileName;
+                if (name[0] == L'.' && (name[1] == 0 || (name[1] == L'.' && name[2] == 0)))
+                    continue;
+
+                std::wstring child = folder->path + L"\\" + name;
+                bool descend = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) &&
+                               !(data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT);
+                (descend ? subfolders : entries).push_back(std::move(child));
+            } while (FindNextFileW(find, &data));
+            FindClose(find);
+
+            // Hand out the subfolders first so idle threads start on them
+            // while this one deletes files
+            if (!subfolders.empty())
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                for (auto& subfolder_path : subfolders)
+                {
+                    auto subfolder = std::make_unique<Folder>();
+                    subfolder->path = std::move(subfolder_path);
+                    subfolder->parent = folder;
+                    folder->pending++;
+                    work.push_back(subfolder.get());
+                    folders.push_back(std::move(subfolder));
+                }
+                wake.notify_all();
+            }
+
+            for (const auto& entry : entries)
+            {
+                if (!proceed())
+                    break;
+
+                DWORD error = DeleteEntry(entry);
+                if (error != 0)
+                    fail(entry, error);
+                else
+                    files++;
+            }
+        };
+
+        auto worker = [&]()
+        {
+            while (true)
+            {
+                Folder* folder = nullptr;
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    wake.wait(lock, [&] { return !work.empty() || finished || stop; });
+                    if (finished || stop)
+                        return;
+
+                    // Depth first keeps the set of half-done folders small
+                    folder = work.back();
+                    work.pop_back();
+                }
+
+                // A stopped delete leaves its folders behind, so this one
+                // need not be released
+                if (!proceed())
+                    return;
+
+                process(folder);
+                release(folder);
+
+                if (progress && progress_mutex.try_lock())
+                {
+                    bool keep_going = progress(files + directories);
+                    progress_mutex.unlock();
+                    if (!keep_going)
+                        halt();
+                }
+            }
+        };
+
+        {
+            auto root = std::make_unique<Folder>();
+            root->path = root_path;
+            work.push_back(root.get());
+            folders.push_back(std::move(root));
+        }
+
+        std::vector<std::thread> pool;
+        for (size_t i = 1; i < threads_; ++i)
+        {
+            pool.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : pool)
+        {
+            thread.join();
+        }
+
+        result.files_deleted = files;
+        result.directories_deleted = directories;
+        result.failures = failures;
+        result.cancelled = stop;
+        result.success = !result.cancelled && result.failures == 0;
+
+        if (result.failures > 0)
+        {
+            SPDLOG_WARN("Tree delete of {} left {} entries: {}", path.String(), result.failures, result.error_message);
+        }
+        return result;
+    }
+
+} // namespace opacity::filesystem
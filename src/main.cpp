@@ -2,31 +2,65 @@
 #include <filesystem>
 #include "opacity/core/Logger.h"
 #include "opacity/core/Config.h"
+#include "opacity/core/ShellIntegration.h"
+#include "opacity/core/StartupProfile.h"
+#include "opacity/cli/CommandLine.h"
 #include "opacity/ui/MainWindow.h"
+#include "opacity/ui/ResidentService.h"
 
 /**
  * @brief Main entry point for Opacity application
  * 
- * Initializes all subsystems and runs the main application loop.
+ * Initializes all subsystems and runs the main application loop, or runs
+ * a headless command (opacity help lists them) without any of the UI, or
+ * the resident index behind the tray icon (opacity resident).
  */
 int main()
 {
+    bool resident = false;
+    {
+        opacity::core::ShellIntegration shell;
+        auto args = shell.ParseWindowsCommandLine();
+        if (opacity::cli::IsHeadlessCommand(args))
+            return opacity::cli::Run(args);
+        resident = args.command == "resident";
+    }
+
+    opacity::core::StartupProfile::Begin();
+
     try
     {
         // Initialize logging first
-        opacity::core::Logger::Initialize("debug");
+        {
+            OPACITY_STARTUP_PHASE("Logger");
+            opacity::core::Logger::Initialize("debug");
+        }
         
         SPDLOG_INFO("========================================");
         SPDLOG_INFO("Opacity - Windows File Manager");
-        SPDLOG_INFO("Version: 1.0.0");
+        SPDLOG_INFO("Version: {}", OPACITY_VERSION);
         SPDLOG_INFO("========================================");
 
         // Initialize configuration system
-        opacity::core::Config::Initialize("Opacity");
+        {
+            OPACITY_STARTUP_PHASE("Config");
+            opacity::core::Config::Initialize("Opacity");
+        }
         SPDLOG_INFO("Configuration system initialized");
 
+        if (resident)
+        {
+            opacity::ui::ResidentService service;
+            int exit_code = service.Run();
+            opacity::core::Logger::Shutdown();
+            return exit_code;
+        }
+
         // Initialize and run UI
+        uint64_t construct_start = opacity::core::Profiler::Now();
         opacity::ui::MainWindow window;
+        opacity::core::StartupProfile::Record("Construct window", construct_start,
+                                              opacity::core::Profiler::Now(), true);
         if (window.Initialize())
         {
             SPDLOG_INFO("Main window initialized");
@@ -1,12 +1,10 @@
 #include "opacity/preview/DocumentPreviewHandler.h"
+#include "opacity/preview/DocumentText.h"
 #include "opacity/core/Logger.h"
+#include "opacity/filesystem/FileTypes.h"
 
 #include <algorithm>
-#include <fstream>
-#include <sstream>
-#include <unordered_set>
 #include <unordered_map>
-#include <regex>
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -28,7 +26,6 @@ namespace opacity::preview
         ID3D11Device* device_ = nullptr;
 
         std::unordered_map<std::string, DocumentType> extensionMap_;
-        std::unordered_set<std::string> supportedExtensions_;
 
         Impl()
         {
@@ -49,10 +46,6 @@ namespace opacity::preview
                 {"ods", DocumentType::OpenDocument},
                 {"odp", DocumentType::OpenDocument}
             };
-
-            for (const auto& [ext, type] : extensionMap_) {
-                supportedExtensions_.insert(ext);
-            }
         }
 
         ~Impl() = default;
@@ -62,103 +55,36 @@ namespace opacity::preview
             DocumentInfo info;
             info.type = DocumentType::PDF;
 
-            std::ifstream file(path, std::ios::binary);
-            if (!file.is_open()) {
+            std::error_code ec;
+            info.fileSize = std::filesystem::file_size(path, ec);
+
+            PdfReader reader;
+            if (!reader.Open(core::Path(path))) {
+                OPACITY_LOG_DEBUG(Preview, "DocumentPreviewHandler: {}: {}", path.string(), reader.GetErrorMessage());
                 return info;
             }
 
-            // Read PDF header and basic info
-            std::string content(8192, '\0');
-            file.read(&content[0], content.size());
-            file.seekg(0, std::ios::end);
-            info.fileSize = static_cast<size_t>(file.tellg());
-
-            // Check for encryption
-            if (content.find("/Encrypt") != std::string::npos) {
-                info.isEncrypted = true;
-                info.hasPassword = true;
+            info.pageCount = reader.GetPageCount();
+            info.isEncrypted = reader.IsEncrypted();
+            info.hasPassword = info.isEncrypted;
+
+            // Empty for encrypted documents, whose strings cannot be read
+            info.title = reader.GetInfo("Title");
+            info.author = reader.GetInfo("Author");
+            info.subject = reader.GetInfo("Subject");
+            info.creator = reader.GetInfo("Creator");
+            std::string created = reader.GetInfo("CreationDate");
+            if (!created.empty()) {
+                info.creationDate = ParsePdfDate(created);
             }
-
-            // Try to find page count
-            std::regex pageCountRegex("/Count\\s+(\\d+)");
-            std::smatch match;
-            if (std::regex_search(content, match, pageCountRegex)) {
-                try {
-                    info.pageCount = std::stoi(match[1].str());
-                } catch (...) {}
+            std::string modified = reader.GetInfo("ModDate");
+            if (!modified.empty()) {
+                info.modificationDate = ParsePdfDate(modified);
             }
 
-            // Extract metadata from Info dictionary
-            ExtractPdfMetadata(content, info);
-
             return info;
         }
 
-        void ExtractPdfMetadata(const std::string& content, DocumentInfo& info) const
-        {
-            // Title
-            std::regex titleRegex("/Title\\s*\\(([^)]+)\\)");
-            std::smatch match;
-            if (std::regex_search(content, match, titleRegex)) {
-                info.title = DecodePdfString(match[1].str());
-            }
-
-            // Author
-            std::regex authorRegex("/Author\\s*\\(([^)]+)\\)");
-            if (std::regex_search(content, match, authorRegex)) {
-                info.author = DecodePdfString(match[1].str());
-            }
-
-            // Subject
-            std::regex subjectRegex("/Subject\\s*\\(([^)]+)\\)");
-            if (std::regex_search(content, match, subjectRegex)) {
-                info.subject = DecodePdfString(match[1].str());
-            }
-
-            // Creator
-            std::regex creatorRegex("/Creator\\s*\\(([^)]+)\\)");
-            if (std::regex_search(content, match, creatorRegex)) {
-                info.creator = DecodePdfString(match[1].str());
-            }
-
-            // Creation date
-            std::regex creationDateRegex("/CreationDate\\s*\\(([^)]+)\\)");
-            if (std::regex_search(content, match, creationDateRegex)) {
-                info.creationDate = ParsePdfDate(match[1].str());
-            }
-
-            // Modification date
-            std::regex modDateRegex("/ModDate\\s*\\(([^)]+)\\)");
-            if (std::regex_search(content, match, modDateRegex)) {
-                info.modificationDate = ParsePdfDate(match[1].str());
-            }
-        }
-
-        std::string DecodePdfString(const std::string& str) const
-        {
-            // Basic PDF string decoding (handles common escape sequences)
-            std::string result;
-            result.reserve(str.size());
-
-            for (size_t i = 0; i < str.size(); i++) {
-                if (str[i] == '\\' && i + 1 < str.size()) {
-                    switch (str[i + 1]) {
-                        case 'n': result += '\n'; i++; break;
-                        case 'r': result += '\r'; i++; break;
-                        case 't': result += '\t'; i++; break;
-                        case '\\': result += '\\'; i++; break;
-                        case '(': result += '('; i++; break;
-                        case ')': result += ')'; i++; break;
-                        default: result += str[i]; break;
-                    }
-                } else {
-                    result += str[i];
-                }
-            }
-
-            return result;
-        }
-
         std::string ParsePdfDate(const std::string& dateStr) const
         {
             // PDF date format: D:YYYYMMDDHHmmSS+HH'mm'
@@ -219,37 +145,33 @@ namespace opacity::preview
             }
         }
 
-        std::string ExtractPdfText(const std::filesystem::path& path, int maxChars) const
+        /**
+         * @brief Up to maxChars bytes of a document's text, cut on a
+         *        character boundary
+         */
+        std::string ExtractDocumentText(const std::filesystem::path& path, size_t maxChars, bool* truncated) const
         {
-            // Basic PDF text extraction - finds text between parentheses
-            // Real PDF text extraction requires a proper library
-            std::ifstream file(path, std::ios::binary);
-            if (!file.is_open()) {
-                return "";
-            }
-
-            std::stringstream buffer;
-            buffer << file.rdbuf();
-            std::string content = buffer.str();
-
-            std::string extractedText;
-            extractedText.reserve(maxChars);
-
-            // Find text in Tj and TJ operators
-            std::regex textRegex("\\(([^)]+)\\)\\s*Tj");
-            auto begin = std::sregex_iterator(content.begin(), content.end(), textRegex);
-            auto end = std::sregex_iterator();
-
-            for (auto it = begin; it != end && static_cast<int>(extractedText.size()) < maxChars; ++it) {
-                extractedText += DecodePdfString((*it)[1].str());
-                extractedText += " ";
-            }
+            std::string text;
+            bool full = false;
+            DocumentTextExtractor::Extract(core::Path(path), [&](std::string_view chunk) {
+                size_t room = maxChars - text.size();
+                if (chunk.size() <= room) {
+                    text.append(chunk);
+                    return text.size() < maxChars;
+                }
+                // Back up to the start of the character the limit falls in
+                while (room > 0 && (static_cast<uint8_t>(chunk[room]) & 0xC0) == 0x80) {
+                    room--;
+                }
+                text.append(chunk.substr(0, room));
+                full = true;
+                return false;
+            });
 
-            if (static_cast<int>(extractedText.size()) > maxChars) {
-                extractedText.resize(maxChars);
+            if (truncated) {
+                *truncated = full || text.size() >= maxChars;
             }
-
-            return extractedText;
+            return text;
         }
 
 #ifdef _WIN32
@@ -392,9 +314,8 @@ namespace opacity::preview
 
     bool DocumentPreviewHandler::CanHandle(const core::Path& path, const std::string& extension) const
     {
-        std::string ext = extension;
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        return impl_->supportedExtensions_.count(ext) > 0;
+        const filesystem::ExtensionInfo* info = filesystem::LookupExtension(extension);
+        return info && (info->preview_handlers & filesystem::PreviewDocument);
     }
 
     DocumentType DocumentPreviewHandler::GetDocumentType(const std::string& extension) const
@@ -432,12 +353,11 @@ namespace opacity::preview
         }
 #endif
 
-        // Extract text preview for PDFs
-        if (ext == "pdf") {
+        // Extract a text preview from the formats that have readable text
+        if (DocumentTextExtractor::Supports(ext) && !preview.info.isEncrypted) {
             DocumentTextContent textContent;
             textContent.pageNumber = 1;
-            textContent.text = impl_->ExtractPdfText(fsPath, 2000);
-            textContent.truncated = textContent.text.size() >= 2000;
+            textContent.text = impl_->ExtractDocumentText(fsPath, 2000, &textContent.truncated);
             if (!textContent.text.empty()) {
                 preview.textContent.push_back(std::move(textContent));
             }
@@ -479,12 +399,10 @@ namespace opacity::preview
         if (!ext.empty() && ext[0] == '.') ext = ext.substr(1);
         std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
 
-        if (ext == "pdf") {
-            return impl_->ExtractPdfText(fsPath, maxCharacters);
+        if (!DocumentTextExtractor::Supports(ext) || maxCharacters <= 0) {
+            return "";
         }
-
-        // For Office documents, we'd need to extract from OOXML
-        return "";
+        return impl_->ExtractDocumentText(fsPath, static_cast<size_t>(maxCharacters), nullptr);
     }
 
     void DocumentPreviewHandler::ReleasePreview(DocumentPreviewData& preview) const
@@ -504,8 +422,7 @@ namespace opacity::preview
 
     std::vector<std::string> DocumentPreviewHandler::GetSupportedExtensions() const
     {
-        return std::vector<std::string>(impl_->supportedExtensions_.begin(),
-                                        impl_->supportedExtensions_.end());
+        return filesystem::ExtensionsFor(filesystem::PreviewDocument);
     }
 
     std::string DocumentPreviewHandler::GetTypeName(DocumentType type)
@@ -0,0 +1,2041 @@
+#include "opacity/preview/DocumentText.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstdint>
+#include <cstring>
+#include <unordered_map>
+#include <unordered_set>
+
+// miniz for OOXML and OpenDocument parts, and for FlateDecode streams
+#include "miniz.h"
+#include "miniz_zip.h"
+
+namespace opacity::preview
+{
+    using namespace opacity::core;
+
+    namespace
+    {
+        constexpr int kMaxNesting = 64;                         // Arrays, dictionaries and reference chains
+        constexpr size_t kMaxStreamBytes = 64 * 1024 * 1024;    // Decoded, per stream
+        constexpr uint32_t kMaxObjects = 8 * 1024 * 1024;
+        constexpr size_t kMaxPages = 1024 * 1024;
+        constexpr size_t kMaxCMapEntries = 1024 * 1024;
+        constexpr size_t kMaxCachedFonts = 1024;
+        constexpr size_t kReadBuffer = 64 * 1024;
+        constexpr uint32_t kAnyObject = UINT32_MAX;
+
+        enum class DocumentFamily
+        {
+            None,
+            Pdf,
+            Word,
+            Sheet,
+            Slides,
+            OpenDocument
+        };
+
+        DocumentFamily FamilyOf(const std::string& extension)
+        {
+            if (extension == "pdf") return DocumentFamily::Pdf;
+            if (extension == "docx" || extension == "docm") return DocumentFamily::Word;
+            if (extension == "xlsx" || extension == "xlsm") return DocumentFamily::Sheet;
+            if (extension == "pptx" || extension == "pptm") return DocumentFamily::Slides;
+            if (extension == "odt" || extension == "ods" || extension == "odp") return DocumentFamily::OpenDocument;
+            return DocumentFamily::None;
+        }
+
+        size_t EncodeUtf8(uint32_t cp, char* out)
+        {
+            if (cp >= 0xD800 && cp < 0xE000) cp = 0xFFFD;
+            if (cp < 0x80) {
+                out[0] = static_cast<char>(cp);
+                return 1;
+            }
+            if (cp < 0x800) {
+                out[0] = static_cast<char>(0xC0 | (cp >> 6));
+                out[1] = static_cast<char>(0x80 | (cp & 0x3F));
+                return 2;
+            }
+            if (cp < 0x10000) {
+                out[0] = static_cast<char>(0xE0 | (cp >> 12));
+                out[1] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out[2] = static_cast<char>(0x80 | (cp & 0x3F));
+                return 3;
+            }
+            if (cp < 0x110000) {
+                out[0] = static_cast<char>(0xF0 | (cp >> 18));
+                out[1] = static_cast<char>(0x80 | ((cp >> 12) & 0x3F));
+                out[2] = static_cast<char>(0x80 | ((cp >> 6) & 0x3F));
+                out[3] = static_cast<char>(0x80 | (cp & 0x3F));
+                return 4;
+            }
+            return EncodeUtf8(0xFFFD, out);
+        }
+
+        void AppendUtf8(std::string& out, uint32_t cp)
+        {
+            char bytes[4];
+            out.append(bytes, EncodeUtf8(cp, bytes));
+        }
+
+        // WinAnsiEncoding differs from Latin-1 only in 0x80 - 0x9F
+        constexpr uint16_t kWinAnsiHigh[32] = {
+            0x20AC, 0xFFFD, 0x201A, 0x0192, 0x201E, 0x2026, 0x2020, 0x2021,
+            0x02C6, 0x2030, 0x0160, 0x2039, 0x0152, 0xFFFD, 0x017D, 0xFFFD,
+            0xFFFD, 0x2018, 0x2019, 0x201C, 0x201D, 0x2022, 0x2013, 0x2014,
+            0x02DC, 0x2122, 0x0161, 0x203A, 0x0153, 0xFFFD, 0x017E, 0x0178
+        };
+
+        uint32_t WinAnsi(uint8_t byte)
+        {
+            return byte >= 0x80 && byte < 0xA0 ? kWinAnsiHigh[byte - 0x80] : byte;
+        }
+
+        void AppendUtf16Be(std::string& out, std::string_view bytes)
+        {
+            for (size_t i = 0; i + 1 < bytes.size(); i += 2) {
+                uint32_t unit = (static_cast<uint8_t>(bytes[i]) << 8) | static_cast<uint8_t>(bytes[i + 1]);
+                if (unit >= 0xD800 && unit < 0xDC00 && i + 3 < bytes.size()) {
+                    uint32_t low = (static_cast<uint8_t>(bytes[i + 2]) << 8) | static_cast<uint8_t>(bytes[i + 3]);
+                    if (low >= 0xDC00 && low < 0xE000) {
+                        AppendUtf8(out, 0x10000 + ((unit - 0xD800) << 10) + (low - 0xDC00));
+                        i += 2;
+                        continue;
+                    }
+                }
+                AppendUtf8(out, unit);
+            }
+        }
+
+        /**
+         * @brief A PDF text string as UTF-8: UTF-16BE or UTF-8 behind a byte
+         *        order mark, PDFDocEncoding (read as WinAnsi) otherwise
+         */
+        std::string DecodeTextString(std::string_view bytes)
+        {
+            std::string text;
+            if (bytes.size() >= 2 && static_cast<uint8_t>(bytes[0]) == 0xFE && static_cast<uint8_t>(bytes[1]) == 0xFF) {
+                AppendUtf16Be(text, bytes.substr(2));
+            } else if (bytes.size() >= 3 && static_cast<uint8_t>(bytes[0]) == 0xEF &&
+                       static_cast<uint8_t>(bytes[1]) == 0xBB && static_cast<uint8_t>(bytes[2]) == 0xBF) {
+                text.assign(bytes.substr(3));
+            } else {
+                for (char c : bytes) {
+                    AppendUtf8(text, WinAnsi(static_cast<uint8_t>(c)));
+                }
+            }
+            return text;
+        }
+
+        /**
+         * @brief Length of the longest prefix that ends on a whole UTF-8
+         *        character
+         */
+        size_t CompleteLength(const std::string& text)
+        {
+            size_t end = text.size();
+            size_t continuation = 0;
+            while (continuation < end && continuation < 3 &&
+                   (static_cast<uint8_t>(text[end - 1 - continuation]) & 0xC0) == 0x80) {
+                continuation++;
+            }
+            if (continuation == end) return end;
+
+            uint8_t lead = static_cast<uint8_t>(text[end - 1 - continuation]);
+            size_t needed = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1;
+            return continuation + 1 >= needed ? end : end - 1 - continuation;
+        }
+
+        /**
+         * @brief Collects text and hands it to the sink a chunk at a time,
+         *        keeping line and word breaks from doubling up
+         */
+        class ChunkWriter
+        {
+        public:
+            explicit ChunkWriter(const TextChunkSink& sink)
+                : sink_(sink)
+            {}
+
+            bool IsStopped() const { return stopped_; }
+            bool EndsInSpace() const { return !written_ || endsInSpace_ || pendingSpace_; }
+
+            void Append(std::string_view text)
+            {
+                if (stopped_ || text.empty()) return;
+                if (pendingSpace_) {
+                    pendingSpace_ = false;
+                    if (text[0] != ' ' && text[0] != '\t' && text[0] != '\n') buffer_ += ' ';
+                }
+                buffer_.append(text);
+
+                size_t newlines = 0;
+                while (newlines < text.size() && text[text.size() - 1 - newlines] == '\n') {
+                    newlines++;
+                }
+                trailingNewlines_ = newlines == text.size() ? trailingNewlines_ + newlines : newlines;
+                char last = text.back();
+                endsInSpace_ = last == ' ' || last == '\t' || last == '\n';
+                written_ = true;
+
+                if (buffer_.size() >= DocumentTextExtractor::kChunkSize) {
+                    Flush(false);
+                }
+            }
+
+            void AppendCodepoint(uint32_t cp)
+            {
+                char bytes[4];
+                Append(std::string_view(bytes, EncodeUtf8(cp, bytes)));
+            }
+
+            /**
+             * @brief Make sure the text ends in at least this many newlines
+             */
+            void EndLine(size_t lines = 1)
+            {
+                pendingSpace_ = false;
+                while (written_ && !stopped_ && trailingNewlines_ < lines) {
+                    Append("\n");
+                }
+            }
+
+            /**
+             * @brief A space between words, unless there is already one;
+             *        dropped if a line break comes first
+             */
+            void Space()
+            {
+                if (written_ && !endsInSpace_) {
+                    pendingSpace_ = true;
+                }
+            }
+
+            /**
+             * @brief Hand over what is left
+             * @return false if the sink asked to stop
+             */
+            bool Finish()
+            {
+                Flush(true);
+                return !stopped_;
+            }
+
+        private:
+            void Flush(bool all)
+            {
+                size_t length = all ? buffer_.size() : CompleteLength(buffer_);
+                if (length == 0 || stopped_) return;
+                if (!sink_(std::string_view(buffer_.data(), length))) {
+                    stopped_ = true;
+                }
+                buffer_.erase(0, length);
+            }
+
+            const TextChunkSink& sink_;
+            std::string buffer_;
+            size_t trailingNewlines_ = 0;
+            bool endsInSpace_ = false;
+            bool pendingSpace_ = false;
+            bool written_ = false;
+            bool stopped_ = false;
+        };
+
+        // ============== XML text ==============
+
+        /**
+         * @brief Which elements of a document part hold its text, by local
+         *        name (the namespace prefix is ignored)
+         */
+        struct XmlTextRules
+        {
+            std::vector<std::string_view> text;         // Character data is kept only inside these; empty keeps all
+            std::vector<std::string_view> paragraphs;   // Each ends a line
+            std::vector<std::string_view> tabs;
+            std::vector<std::string_view> lineBreaks;
+            std::vector<std::string_view> spaces;
+        };
+
+        const XmlTextRules& RulesFor(DocumentFamily family)
+        {
+            static const XmlTextRules word = {{"t"}, {"p"}, {"tab"}, {"br", "cr"}, {}};
+            static const XmlTextRules sheet = {{"t"}, {"si"}, {}, {}, {}};
+            static const XmlTextRules slides = {{"t"}, {"p"}, {}, {"br"}, {}};
+            static const XmlTextRules openDocument = {{}, {"p", "h"}, {"tab"}, {"line-break"}, {"s"}};
+
+            switch (family) {
+                case DocumentFamily::Sheet: return sheet;
+                case DocumentFamily::Slides: return slides;
+                case DocumentFamily::OpenDocument: return openDocument;
+                default: return word;
+            }
+        }
+
+        bool Contains(const std::vector<std::string_view>& names, std::string_view name)
+        {
+            return std::find(names.begin(), names.end(), name) != names.end();
+        }
+
+        /**
+         * @brief Pulls the text out of XML fed to it in pieces of any size
+         *
+         * Only as much as is needed to tell what an element is gets kept
+         * between pieces: a tag's name, an unfinished entity, or how far
+         * into a closing "-->" or "]]>" it is.
+         */
+        class XmlTextReader
+        {
+        public:
+            XmlTextReader(const XmlTextRules& rules, ChunkWriter& out)
+                : rules_(rules)
+                , out_(out)
+            {}
+
+            void Feed(const char* data, size_t size)
+            {
+                for (size_t i = 0; i < size; i++) {
+                    char c = data[i];
+                    switch (state_) {
+                        case State::Text:
+                            if (c == '<') {
+                                FlushRun();
+                                state_ = State::Tag;
+                                tag_.clear();
+                                quote_ = 0;
+                                lastSignificant_ = 0;
+                            } else if (c == '&') {
+                                state_ = State::Entity;
+                                entity_.clear();
+                            } else if (Keeping()) {
+                                AppendCharacter(c);
+                            }
+                            break;
+
+                        case State::Entity:
+                            if (c == ';') {
+                                DecodeEntity();
+                                state_ = State::Text;
+                            } else if (entity_.size() < 10) {
+                                entity_ += c;
+                            } else {
+                                state_ = State::Text;
+                            }
+                            break;
+
+                        case State::Tag:
+                            if (tag_.empty() && c == '!') {
+                                tag_ = "!";
+                                state_ = State::Markup;
+                            } else if (tag_.empty() && c == '?') {
+                                state_ = State::Instruction;
+                                tail_ = 0;
+                            } else if (quote_) {
+                                if (c == quote_) quote_ = 0;
+                            } else if (c == '"' || c == '\'') {
+                                quote_ = c;
+                            } else if (c == '>') {
+                                EndTag();
+                                state_ = State::Text;
+                            } else {
+                                if (c != ' ' && c != '\t' && c != '\r' && c != '\n') lastSignificant_ = c;
+                                if (tag_.size() < 256) tag_ += c;
+                            }
+                            break;
+
+                        case State::Markup:
+                            tag_ += c;
+                            if (tag_ == "!--") {
+                                state_ = State::Comment;
+                                tail_ = 0;
+                            } else if (tag_ == "![CDATA[") {
+                                state_ = State::CData;
+                                tail_ = 0;
+                            } else if (std::string_view("!--").compare(0, tag_.size(), tag_) != 0 &&
+                                       std::string_view("![CDATA[").compare(0, tag_.size(), tag_) != 0) {
+                                // A declaration; nothing in it is text
+                                state_ = c == '>' ? State::Text : State::Declaration;
+                            }
+                            break;
+
+                        case State::Comment:
+                            if (c == '>' && tail_ >= 2) {
+                                state_ = State::Text;
+                            } else {
+                                tail_ = c == '-' ? tail_ + 1 : 0;
+                            }
+                            break;
+
+                        case State::CData:
+                            if (c == ']') {
+                                tail_++;
+                            } else if (c == '>' && tail_ >= 2) {
+                                if (Keeping()) run_.append(tail_ - 2, ']');
+                                state_ = State::Text;
+                            } else {
+                                if (Keeping()) {
+                                    run_.append(tail_, ']');
+                                    AppendCharacter(c);
+                                }
+                                tail_ = 0;
+                            }
+                            break;
+
+                        case State::Instruction:
+                            if (c == '>' && tail_ == 1) {
+                                state_ = State::Text;
+                            } else {
+                                tail_ = c == '?' ? 1 : 0;
+                            }
+                            break;
+
+                        case State::Declaration:
+                            if (c == '>') state_ = State::Text;
+                            break;
+                    }
+                }
+
+                if (run_.size() >= kReadBuffer) {
+                    FlushRun();
+                }
+            }
+
+            void Finish()
+            {
+                FlushRun();
+            }
+
+        private:
+            enum class State : uint8_t
+            {
+                Text,
+                Entity,
+                Tag,
+                Markup,
+                Comment,
+                CData,
+                Instruction,
+                Declaration
+            };
+
+            bool Keeping() const { return rules_.text.empty() || textDepth_ > 0; }
+
+            /**
+             * @brief Character data, with runs of whitespace (layout, in XML)
+             *        collapsed to one space
+             */
+            void AppendCharacter(char c)
+            {
+                if (c != ' ' && c != '\t' && c != '\r' && c != '\n') {
+                    run_ += c;
+                } else if (run_.empty() ? !out_.EndsInSpace() : run_.back() != ' ') {
+                    run_ += ' ';
+                }
+            }
+
+            void FlushRun()
+            {
+                if (!run_.empty()) {
+                    out_.Append(run_);
+                    run_.clear();
+                }
+            }
+
+            void EndTag()
+            {
+                if (tag_.empty()) return;
+
+                bool closing = tag_[0] == '/';
+                size_t start = closing ? 1 : 0;
+                size_t end = tag_.find_first_of(" \t\r\n/", start);
+                std::string_view name(tag_.data() + start, (end == std::string::npos ? tag_.size() : end) - start);
+                size_t colon = name.rfind(':');
+                if (colon != std::string_view::npos) name.remove_prefix(colon + 1);
+
+                if (closing) {
+                    if (textDepth_ > 0 && Contains(rules_.text, name)) textDepth_--;
+                    if (Contains(rules_.paragraphs, name)) out_.EndLine();
+                    return;
+                }
+
+                bool selfClosing = lastSignificant_ == '/';
+                if (Contains(rules_.tabs, name)) {
+                    out_.Append("\t");
+                } else if (Contains(rules_.lineBreaks, name)) {
+                    out_.EndLine();
+                } else if (Contains(rules_.spaces, name)) {
+                    out_.Append(" ");
+                } else if (!selfClosing && Contains(rules_.text, name)) {
+                    textDepth_++;
+                } else if (selfClosing && Contains(rules_.paragraphs, name)) {
+                    out_.EndLine();
+                }
+            }
+
+            void DecodeEntity()
+            {
+                if (!Keeping() || entity_.empty()) return;
+
+                if (entity_ == "amp") run_ += '&';
+                else if (entity_ == "lt") run_ += '<';
+                else if (entity_ == "gt") run_ += '>';
+                else if (entity_ == "quot") run_ += '"';
+                else if (entity_ == "apos") run_ += '\'';
+                else if (entity_[0] == '#') {
+                    bool hex = entity_.size() > 1 && (entity_[1] == 'x' || entity_[1] == 'X');
+                    uint32_t cp = 0;
+                    for (size_t i = hex ? 2 : 1; i < entity_.size(); i++) {
+                        char c = entity_[i];
+                        int digit = -1;
+                        if (c >= '0' && c <= '9') digit = c - '0';
+                        else if (hex && c >= 'a' && c <= 'f') digit = c - 'a' + 10;
+                        else if (hex && c >= 'A' && c <= 'F') digit = c - 'A' + 10;
+                        if (digit < 0) return;
+                        cp = cp * (hex ? 16 : 10) + static_cast<uint32_t>(digit);
+                        if (cp > 0x10FFFF) return;
+                    }
+                    if (cp < 0x20) cp = ' ';
+                    AppendUtf8(run_, cp);
+                }
+            }
+
+            const XmlTextRules& rules_;
+            ChunkWriter& out_;
+            State state_ = State::Text;
+            std::string tag_;           // Between < and >, capped; enough for the name
+            std::string run_;           // Character data not yet appended
+            std::string entity_;
+            char quote_ = 0;
+            char lastSignificant_ = 0;  // Last character of the tag outside quotes, for "/>"
+            int textDepth_ = 0;
+            size_t tail_ = 0;           // How much of a closing "-->", "]]>" or "?>" has been seen
+        };
+
+        /**
+         * @brief The parts of a zipped document that hold its text, in
+         *        reading order
+         */
+        std::vector<mz_uint> FindTextParts(mz_zip_archive& zip, DocumentFamily family)
+        {
+            std::vector<mz_uint> parts;
+            std::vector<std::pair<int, mz_uint>> slides;
+            int wordRank[3] = {-1, -1, -1};
+
+            mz_uint count = mz_zip_reader_get_num_files(&zip);
+            char name[512];
+            for (mz_uint i = 0; i < count; i++) {
+                if (mz_zip_reader_get_filename(&zip, i, name, sizeof(name)) == 0) continue;
+                std::string_view part(name);
+
+                switch (family) {
+                    case DocumentFamily::Word:
+                        if (part == "word/document.xml") wordRank[0] = static_cast<int>(i);
+                        else if (part == "word/footnotes.xml") wordRank[1] = static_cast<int>(i);
+                        else if (part == "word/endnotes.xml") wordRank[2] = static_cast<int>(i);
+                        break;
+                    case DocumentFamily::Sheet:
+                        if (part == "xl/sharedStrings.xml") parts.push_back(i);
+                        break;
+                    case DocumentFamily::Slides: {
+                        // ppt/slides/slide12.xml comes after slide2.xml
+                        constexpr std::string_view prefix = "ppt/slides/slide";
+                        constexpr std::string_view suffix = ".xml";
+                        if (part.size() > prefix.size() + suffix.size() &&
+                            part.compare(0, prefix.size(), prefix) == 0 &&
+                            part.compare(part.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                            std::string_view digits = part.substr(prefix.size(), part.size() - prefix.size() - suffix.size());
+                            if (!digits.empty() && digits.size() < 8 &&
+                                std::all_of(digits.begin(), digits.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+                                slides.emplace_back(std::stoi(std::string(digits)), i);
+                            }
+                        }
+                        break;
+                    }
+                    case DocumentFamily::OpenDocument:
+                        if (part == "content.xml") parts.push_back(i);
+                        break;
+                    default:
+                        break;
+                }
+            }
+
+            for (int index : wordRank) {
+                if (index >= 0) parts.push_back(static_cast<mz_uint>(index));
+            }
+            std::sort(slides.begin(), slides.end());
+            for (const auto& slide : slides) {
+                parts.push_back(slide.second);
+            }
+            return parts;
+        }
+
+        /**
+         * @brief Inflate one zip entry straight out of the mapping, handing
+         *        it to feed a buffer at a time until feed returns false
+         *
+         * Done here rather than with mz_zip_reader_extract_iter_read, which
+         * can spin forever on a truncated entry of an archive in memory.
+         */
+        template <typename Feed>
+        bool StreamEntry(mz_zip_archive& zip, const core::MappedFile& file, mz_uint index, Feed&& feed)
+        {
+            mz_zip_archive_file_stat stat;
+            if (!mz_zip_reader_file_stat(&zip, index, &stat)) return false;
+
+            // The local header repeats the name, with an extra field of its own
+            uint64_t header = stat.m_local_header_ofs;
+            if (header + 30 > file.Size()) return false;
+            const uint8_t* local = file.Data() + header;
+            if (local[0] != 'P' || local[1] != 'K' || local[2] != 3 || local[3] != 4) return false;
+            uint64_t start = header + 30 + (local[26] | (local[27] << 8)) + (local[28] | (local[29] << 8));
+            if (start > file.Size() || stat.m_comp_size > file.Size() - start) return false;
+
+            const char* data = reinterpret_cast<const char*>(file.Data() + start);
+            size_t size = static_cast<size_t>(stat.m_comp_size);
+            if (stat.m_method == 0) {
+                for (size_t pos = 0; pos < size; pos += kReadBuffer) {
+                    if (!feed(data + pos, std::min(kReadBuffer, size - pos))) break;
+                }
+                return true;
+            }
+            if (stat.m_method != MZ_DEFLATED) return false;
+
+            mz_stream stream{};
+            if (mz_inflateInit2(&stream, -MZ_DEFAULT_WINDOW_BITS) != MZ_OK) return false;
+            stream.next_in = reinterpret_cast<const unsigned char*>(data);
+            stream.avail_in = static_cast<mz_uint32>(std::min<size_t>(size, UINT32_MAX));
+
+            std::vector<char> buffer(kReadBuffer);
+            int status = MZ_OK;
+            while (status == MZ_OK) {
+                stream.next_out = reinterpret_cast<unsigned char*>(buffer.data());
+                stream.avail_out = static_cast<mz_uint32>(buffer.size());
+                status = mz_inflate(&stream, MZ_NO_FLUSH);
+                size_t produced = buffer.size() - stream.avail_out;
+                if (produced == 0 || !feed(buffer.data(), produced)) break;
+            }
+            mz_inflateEnd(&stream);
+            return true;
+        }
+
+        bool ExtractZipText(const core::MappedFile& file, DocumentFamily family, ChunkWriter& out)
+        {
+            mz_zip_archive zip{};
+            if (!mz_zip_reader_init_mem(&zip, file.Data(), file.Size(), 0)) {
+                return false;
+            }
+
+            std::vector<mz_uint> parts = FindTextParts(zip, family);
+            const XmlTextRules& rules = RulesFor(family);
+            bool found = false;
+
+            for (mz_uint index : parts) {
+                // A buffer at a time; a part is never whole in memory
+                XmlTextReader reader(rules, out);
+                bool read = StreamEntry(zip, file, index, [&](const char* data, size_t size) {
+                    reader.Feed(data, size);
+                    return !out.IsStopped();
+                });
+                reader.Finish();
+                if (!read) continue;
+
+                out.EndLine(2);
+                found = true;
+                if (out.IsStopped()) break;
+            }
+
+            mz_zip_reader_end(&zip);
+            return found;
+        }
+
+        // ============== PDF objects ==============
+
+        struct PdfObject
+        {
+            enum class Kind : uint8_t
+            {
+                Null,
+                Boolean,
+                Number,
+                Name,
+                String,
+                Array,
+                Dictionary,
+                Reference,
+                Keyword
+            };
+
+            Kind kind = Kind::Null;
+            bool boolean = false;
+            double number = 0.0;
+            uint32_t reference = 0;             // Object number of a Reference
+            std::string text;                   // Name without the slash, string bytes, or keyword
+            std::vector<PdfObject> items;       // Array elements, or dictionary values
+            std::vector<std::string> keys;      // Dictionary keys, parallel to items
+
+            bool IsName(std::string_view name) const { return kind == Kind::Name && text == name; }
+
+            const PdfObject* Get(std::string_view key) const
+            {
+                if (kind != Kind::Dictionary) return nullptr;
+                for (size_t i = 0; i < keys.size(); i++) {
+                    if (keys[i] == key) return &items[i];
+                }
+                return nullptr;
+            }
+        };
+
+        bool IsWhitespace(char c)
+        {
+            return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\f' || c == '\0';
+        }
+
+        bool IsDelimiter(char c)
+        {
+            return c == '(' || c == ')' || c == '<' || c == '>' || c == '[' || c == ']' ||
+                   c == '{' || c == '}' || c == '/' || c == '%';
+        }
+
+        bool IsRegular(char c)
+        {
+            return !IsWhitespace(c) && !IsDelimiter(c);
+        }
+
+        int HexValue(char c)
+        {
+            if (c >= '0' && c <= '9') return c - '0';
+            if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+            if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+            return -1;
+        }
+
+        /**
+         * @brief Reads PDF objects and content stream tokens from a range
+         *        of bytes
+         */
+        class PdfLexer
+        {
+        public:
+            PdfLexer(const char* begin, const char* end)
+                : pos_(begin)
+                , end_(end)
+            {}
+
+            const char* Position() const { return pos_; }
+            const char* End() const { return end_; }
+            void Seek(const char* pos) { pos_ = std::min(pos, end_); }
+
+            void SkipWhitespace()
+            {
+                while (pos_ < end_) {
+                    if (IsWhitespace(*pos_)) {
+                        pos_++;
+                    } else if (*pos_ == '%') {
+                        while (pos_ < end_ && *pos_ != '\r' && *pos_ != '\n') pos_++;
+                    } else {
+                        break;
+                    }
+                }
+            }
+
+            bool ReadInteger(int64_t& value)
+            {
+                SkipWhitespace();
+                const char* start = pos_;
+                bool negative = false;
+                if (pos_ < end_ && (*pos_ == '-' || *pos_ == '+')) {
+                    negative = *pos_ == '-';
+                    pos_++;
+                }
+                int64_t result = 0;
+                const char* digits = pos_;
+                while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9' && pos_ - digits < 18) {
+                    result = result * 10 + (*pos_ - '0');
+                    pos_++;
+                }
+                if (pos_ == digits || (pos_ < end_ && IsRegular(*pos_))) {
+                    pos_ = start;
+                    return false;
+                }
+                value = negative ? -result : result;
+                return true;
+            }
+
+            /**
+             * @brief Consume the next token if it is this keyword
+             */
+            bool ReadKeyword(std::string_view keyword)
+            {
+                SkipWhitespace();
+                size_t length = keyword.size();
+                if (static_cast<size_t>(end_ - pos_) < length || std::string_view(pos_, length) != keyword) {
+                    return false;
+                }
+                if (pos_ + length < end_ && IsRegular(pos_[length])) {
+                    return false;
+                }
+                pos_ += length;
+                return true;
+            }
+
+            /**
+             * @param references Whether "n g R" is read as a reference;
+             *        content streams have none
+             */
+            bool ReadObject(PdfObject& object, bool references = true, int depth = 0)
+            {
+                object = PdfObject{};
+                SkipWhitespace();
+                if (pos_ >= end_ || depth > kMaxNesting) return false;
+
+                char c = *pos_;
+                if (c == '/') {
+                    ReadName(object);
+                } else if (c == '(') {
+                    ReadLiteral(object);
+                } else if (c == '<' && pos_ + 1 < end_ && pos_[1] == '<') {
+                    ReadDictionary(object, references, depth);
+                } else if (c == '<') {
+                    ReadHex(object);
+                } else if (c == '[') {
+                    ReadArray(object, references, depth);
+                } else if ((c >= '0' && c <= '9') || c == '-' || c == '+' || c == '.') {
+                    ReadNumber(object, references);
+                } else if (IsDelimiter(c)) {
+                    // Stray ) > ] { }; step over it
+                    object.kind = PdfObject::Kind::Keyword;
+                    object.text.assign(1, c);
+                    pos_++;
+                } else {
+                    const char* start = pos_;
+                    while (pos_ < end_ && IsRegular(*pos_)) pos_++;
+                    std::string_view word(start, static_cast<size_t>(pos_ - start));
+                    if (word == "true" || word == "false") {
+                        object.kind = PdfObject::Kind::Boolean;
+                        object.boolean = word == "true";
+                    } else if (word == "null") {
+                        object.kind = PdfObject::Kind::Null;
+                    } else {
+                        object.kind = PdfObject::Kind::Keyword;
+                        object.text.assign(word);
+                    }
+                }
+                return true;
+            }
+
+            /**
+             * @brief Step over an inline image's data, after its ID keyword
+             */
+            void SkipInlineImage()
+            {
+                // One whitespace byte, then binary data up to a standalone EI
+                if (pos_ < end_) pos_++;
+                while (pos_ + 1 < end_) {
+                    if (pos_[0] == 'E' && pos_[1] == 'I' && IsWhitespace(pos_[-1]) &&
+                        (pos_ + 2 == end_ || !IsRegular(pos_[2]))) {
+                        pos_ += 2;
+                        return;
+                    }
+                    pos_++;
+                }
+                pos_ = end_;
+            }
+
+        private:
+            void ReadName(PdfObject& object)
+            {
+                object.kind = PdfObject::Kind::Name;
+                pos_++;
+                while (pos_ < end_ && IsRegular(*pos_)) {
+                    if (*pos_ == '#' && pos_ + 2 < end_ && HexValue(pos_[1]) >= 0 && HexValue(pos_[2]) >= 0) {
+                        object.text += static_cast<char>(HexValue(pos_[1]) * 16 + HexValue(pos_[2]));
+                        pos_ += 3;
+                    } else {
+                        object.text += *pos_++;
+                    }
+                }
+            }
+
+            void ReadLiteral(PdfObject& object)
+            {
+                object.kind = PdfObject::Kind::String;
+                pos_++;
+                int depth = 1;
+                while (pos_ < end_) {
+                    char c = *pos_++;
+                    if (c == '\\') {
+                        if (pos_ >= end_) break;
+                        char e = *pos_++;
+                        switch (e) {
+                            case 'n': object.text += '\n'; break;
+                            case 'r': object.text += '\r'; break;
+                            case 't': object.text += '\t'; break;
+                            case 'b': object.text += '\b'; break;
+                            case 'f': object.text += '\f'; break;
+                            case '\r':
+                                if (pos_ < end_ && *pos_ == '\n') pos_++;
+                                break;
+                            case '\n':
+                                break;
+                            default:
+                                if (e >= '0' && e <= '7') {
+                                    int value = e - '0';
+                                    for (int i = 0; i < 2 && pos_ < end_ && *pos_ >= '0' && *pos_ <= '7'; i++) {
+                                        value = value * 8 + (*pos_++ - '0');
+                                    }
+                                    object.text += static_cast<char>(value & 0xFF);
+                                } else {
+                                    object.text += e;
+                                }
+                                break;
+                        }
+                    } else if (c == '(') {
+                        depth++;
+                        object.text += c;
+                    } else if (c == ')') {
+                        if (--depth == 0) break;
+                        object.text += c;
+                    } else if (c == '\r') {
+                        object.text += '\n';
+                        if (pos_ < end_ && *pos_ == '\n') pos_++;
+                    } else {
+                        object.text += c;
+                    }
+                }
+            }
+
+            void ReadHex(PdfObject& object)
+            {
+                object.kind = PdfObject::Kind::String;
+                pos_++;
+                int high = -1;
+                while (pos_ < end_ && *pos_ != '>') {
+                    int value = HexValue(*pos_++);
+                    if (value < 0) continue;
+                    if (high < 0) {
+                        high = value;
+                    } else {
+                        object.text += static_cast<char>(high * 16 + value);
+                        high = -1;
+                    }
+                }
+                if (high >= 0) object.text += static_cast<char>(high * 16);
+                if (pos_ < end_) pos_++;
+            }
+
+            void ReadArray(PdfObject& object, bool references, int depth)
+            {
+                object.kind = PdfObject::Kind::Array;
+                pos_++;
+                while (true) {
+                    SkipWhitespace();
+                    if (pos_ >= end_) return;
+                    if (*pos_ == ']') {
+                        pos_++;
+                        return;
+                    }
+                    PdfObject item;
+                    if (!ReadObject(item, references, depth + 1)) return;
+                    object.items.push_back(std::move(item));
+                }
+            }
+
+            void ReadDictionary(PdfObject& object, bool references, int depth)
+            {
+                object.kind = PdfObject::Kind::Dictionary;
+                pos_ += 2;
+                while (true) {
+                    SkipWhitespace();
+                    if (pos_ >= end_) return;
+                    if (*pos_ == '>') {
+                        pos_ += (pos_ + 1 < end_ && pos_[1] == '>') ? 2 : 1;
+                        return;
+                    }
+                    PdfObject key;
+                    if (!ReadObject(key, references, depth + 1)) return;
+                    if (key.kind != PdfObject::Kind::Name) continue;
+
+                    PdfObject value;
+                    if (!ReadObject(value, references, depth + 1)) return;
+                    object.keys.push_back(std::move(key.text));
+                    object.items.push_back(std::move(value));
+                }
+            }
+
+            void ReadNumber(PdfObject& object, bool references)
+            {
+                object.kind = PdfObject::Kind::Number;
+                bool negative = false;
+                if (*pos_ == '-' || *pos_ == '+') {
+                    negative = *pos_ == '-';
+                    pos_++;
+                }
+                double value = 0.0;
+                bool integer = true;
+                bool digits = false;
+                while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9') {
+                    value = value * 10.0 + (*pos_++ - '0');
+                    digits = true;
+                }
+                if (pos_ < end_ && *pos_ == '.') {
+                    integer = false;
+                    pos_++;
+                    double scale = 0.1;
+                    while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9') {
+                        value += (*pos_++ - '0') * scale;
+                        scale *= 0.1;
+                        digits = true;
+                    }
+                }
+                // Tolerate junk such as "--5" or "1.2.3" the way readers do
+                while (pos_ < end_ && IsRegular(*pos_)) pos_++;
+                object.number = negative ? -value : value;
+
+                if (!references || !integer || negative || !digits || value >= kMaxObjects) return;
+
+                // "n g R" is a reference; anything else leaves n a number
+                const char* save = pos_;
+                SkipWhitespace();
+                const char* generation = pos_;
+                while (pos_ < end_ && *pos_ >= '0' && *pos_ <= '9') pos_++;
+                if (pos_ > generation && pos_ < end_ && IsWhitespace(*pos_)) {
+                    SkipWhitespace();
+                    if (pos_ < end_ && *pos_ == 'R' && (pos_ + 1 == end_ || !IsRegular(pos_[1]))) {
+                        pos_++;
+                        object.kind = PdfObject::Kind::Reference;
+                        object.reference = static_cast<uint32_t>(value);
+                        return;
+                    }
+                }
+                pos_ = save;
+            }
+
+            const char* pos_;
+            const char* end_;
+        };
+
+        double NumberOr(const PdfObject* object, double fallback)
+        {
+            return object && object->kind == PdfObject::Kind::Number ? object->number : fallback;
+        }
+
+        // ============== PDF stream filters ==============
+
+        /**
+         * @brief FlateDecode, keeping what came out of a truncated stream
+         */
+        bool Inflate(std::string_view input, std::string& out, size_t limit)
+        {
+            mz_stream stream{};
+            if (mz_inflateInit(&stream) != MZ_OK) return false;
+
+            stream.next_in = reinterpret_cast<const unsigned char*>(input.data());
+            stream.avail_in = static_cast<mz_uint32>(std::min<size_t>(input.size(), UINT32_MAX));
+
+            size_t chunk = 64 * 1024;
+            int status = MZ_OK;
+            while (out.size() < limit) {
+                size_t used = out.size();
+                out.resize(used + chunk);
+                stream.next_out = reinterpret_cast<unsigned char*>(&out[used]);
+                stream.avail_out = static_cast<mz_uint32>(chunk);
+                status = mz_inflate(&stream, MZ_NO_FLUSH);
+                out.resize(used + chunk - stream.avail_out);
+                if (status != MZ_OK) break;
+                chunk = std::min<size_t>(chunk * 2, 4 * 1024 * 1024);
+            }
+            mz_inflateEnd(&stream);
+
+            if (out.size() > limit) out.resize(limit);
+            return status == MZ_STREAM_END || !out.empty();
+        }
+
+        bool DecodeAsciiHex(std::string_view input, std::string& out)
+        {
+            int high = -1;
+            for (char c : input) {
+                if (c == '>') break;
+                int value = HexValue(c);
+                if (value < 0) continue;
+                if (high < 0) {
+                    high = value;
+                } else {
+                    out += static_cast<char>(high * 16 + value);
+                    high = -1;
+                }
+            }
+            if (high >= 0) out += static_cast<char>(high * 16);
+            return true;
+        }
+
+        bool DecodeAscii85(std::string_view input, std::string& out)
+        {
+            uint32_t group = 0;
+            int count = 0;
+            for (size_t i = 0; i < input.size(); i++) {
+                char c = input[i];
+                if (c == '~') break;
+                if (IsWhitespace(c)) continue;
+                if (c == 'z' && count == 0) {
+                    out.append(4, '\0');
+                    continue;
+                }
+                if (c < '!' || c > 'u') return !out.empty();
+                group = group * 85 + static_cast<uint32_t>(c - '!');
+                if (++count == 5) {
+                    for (int shift = 24; shift >= 0; shift -= 8) out += static_cast<char>((group >> shift) & 0xFF);
+                    group = 0;
+                    count = 0;
+                }
+            }
+            if (count > 1) {
+                for (int pad = count; pad < 5; pad++) group = group * 85 + 84;
+                for (int b = 0; b < count - 1; b++) out += static_cast<char>((group >> (24 - 8 * b)) & 0xFF);
+            }
+            return true;
+        }
+
+        /**
+         * @brief Undo a PNG predictor, as cross-reference and object
+         *        streams use
+         */
+        void ApplyPredictor(const PdfObject* params, std::string& data)
+        {
+            if (!params || NumberOr(params->Get("Predictor"), 1) < 10) return;
+
+            int colors = std::max(1, static_cast<int>(NumberOr(params->Get("Colors"), 1)));
+            int bits = std::max(1, static_cast<int>(NumberOr(params->Get("BitsPerComponent"), 8)));
+            int columns = std::max(1, static_cast<int>(NumberOr(params->Get("Columns"), 1)));
+            size_t bpp = std::max(1, colors * bits / 8);
+            size_t rowBytes = (static_cast<size_t>(columns) * colors * bits + 7) / 8;
+
+            std::string out;
+            out.reserve(data.size());
+            std::vector<uint8_t> previous(rowBytes, 0);
+            std::vector<uint8_t> row(rowBytes);
+            for (size_t pos = 0; pos + 1 + rowBytes <= data.size(); pos += rowBytes + 1) {
+                uint8_t filter = static_cast<uint8_t>(data[pos]);
+                const uint8_t* source = reinterpret_cast<const uint8_t*>(data.data() + pos + 1);
+                for (size_t i = 0; i < rowBytes; i++) {
+                    int left = i >= bpp ? row[i - bpp] : 0;
+                    int up = previous[i];
+                    int upLeft = i >= bpp ? previous[i - bpp] : 0;
+                    int value = source[i];
+                    switch (filter) {
+                        case 1: value += left; break;
+                        case 2: value += up; break;
+                        case 3: value += (left + up) / 2; break;
+                        case 4: {
+                            int p = left + up - upLeft;
+                            int pa = std::abs(p - left), pb = std::abs(p - up), pc = std::abs(p - upLeft);
+                            value += (pa <= pb && pa <= pc) ? left : (pb <= pc ? up : upLeft);
+                            break;
+                        }
+                        default: break;
+                    }
+                    row[i] = static_cast<uint8_t>(value);
+                }
+                out.append(reinterpret_cast<const char*>(row.data()), rowBytes);
+                previous.swap(row);
+            }
+            data = std::move(out);
+        }
+
+        // ============== PDF text ==============
+
+        /**
+         * @brief How one font's character codes become text
+         */
+        struct FontMap
+        {
+            size_t codeBytes = 1;                           // 2 for composite fonts, or as the CMap says
+            bool mapped = false;                            // Has a ToUnicode CMap
+            std::unordered_map<uint32_t, std::string> unicode;
+        };
+
+        uint32_t CodeOf(std::string_view bytes)
+        {
+            uint32_t code = 0;
+            for (size_t i = 0; i < bytes.size() && i < 4; i++) {
+                code = (code << 8) | static_cast<uint8_t>(bytes[i]);
+            }
+            return code;
+        }
+
+        std::string UnicodeOf(std::string_view utf16)
+        {
+            std::string text;
+            AppendUtf16Be(text, utf16);
+            // Control characters are layout, and would break lines mid-word
+            text.erase(std::remove_if(text.begin(), text.end(),
+                                      [](char c) { return static_cast<uint8_t>(c) < 0x20; }), text.end());
+            return text;
+        }
+
+        /**
+         * @brief Read the bfchar and bfrange mappings of a ToUnicode CMap
+         */
+        void ParseCMap(std::string_view cmap, FontMap& font)
+        {
+            PdfLexer lexer(cmap.data(), cmap.data() + cmap.size());
+            PdfObject token;
+            bool sizedCodes = false;
+
+            auto insert = [&font](uint32_t code, std::string text) {
+                if (font.unicode.size() < kMaxCMapEntries) font.unicode[code] = std::move(text);
+            };
+
+            while (lexer.ReadObject(token, false)) {
+                if (token.kind != PdfObject::Kind::Keyword) continue;
+
+                if (token.text == "begincodespacerange") {
+                    PdfObject low, high;
+                    while (lexer.ReadObject(low, false) && low.kind == PdfObject::Kind::String &&
+                           lexer.ReadObject(high, false)) {
+                        if (!sizedCodes && !low.text.empty() && low.text.size() <= 4) {
+                            font.codeBytes = low.text.size();
+                            sizedCodes = true;
+                        }
+                    }
+                } else if (token.text == "beginbfchar") {
+                    PdfObject source, target;
+                    while (lexer.ReadObject(source, false) && source.kind == PdfObject::Kind::String &&
+                           lexer.ReadObject(target, false)) {
+                        if (target.kind == PdfObject::Kind::String) {
+                            insert(CodeOf(source.text), UnicodeOf(target.text));
+                        }
+                    }
+                } else if (token.text == "beginbfrange") {
+                    PdfObject low, high, target;
+                    while (lexer.ReadObject(low, false) && low.kind == PdfObject::Kind::String &&
+                           lexer.ReadObject(high, false) && lexer.ReadObject(target, false)) {
+                        uint32_t first = CodeOf(low.text);
+                        uint32_t last = CodeOf(high.text);
+                        if (last < first || last - first > 0xFFFF) continue;
+
+                        if (target.kind == PdfObject::Kind::String && target.text.size() >= 2) {
+                            // Consecutive codes map to consecutive last code units
+                            std::string utf16 = target.text;
+                            size_t tail = utf16.size() - 2;
+                            uint32_t unit = (static_cast<uint8_t>(utf16[tail]) << 8) | static_cast<uint8_t>(utf16[tail + 1]);
+                            for (uint32_t code = first; code <= last; code++) {
+                                uint32_t value = unit + (code - first);
+                                utf16[tail] = static_cast<char>((value >> 8) & 0xFF);
+                                utf16[tail + 1] = static_cast<char>(value & 0xFF);
+                                insert(code, UnicodeOf(utf16));
+                            }
+                        } else if (target.kind == PdfObject::Kind::Array) {
+                            for (size_t i = 0; i < target.items.size() && first + i <= last; i++) {
+                                if (target.items[i].kind == PdfObject::Kind::String) {
+                                    insert(first + static_cast<uint32_t>(i), UnicodeOf(target.items[i].text));
+                                }
+                            }
+                        }
+                    }
+                }
+            }
+
+            font.mapped = !font.unicode.empty();
+        }
+
+        void ShowText(const std::string& bytes, const FontMap* font, ChunkWriter& out)
+        {
+            if (font && font->mapped) {
+                size_t width = std::max<size_t>(1, font->codeBytes);
+                for (size_t i = 0; i + width <= bytes.size(); i += width) {
+                    uint32_t code = CodeOf(std::string_view(bytes.data() + i, width));
+                    auto it = font->unicode.find(code);
+                    if (it != font->unicode.end()) {
+                        out.Append(it->second);
+                    } else if (width == 1 && code >= 0x20) {
+                        out.AppendCodepoint(WinAnsi(static_cast<uint8_t>(code)));
+                    }
+                }
+                return;
+            }
+
+            // Glyph ids of a composite font say nothing without a CMap
+            if (font && font->codeBytes > 1) return;
+
+            for (char c : bytes) {
+                uint8_t byte = static_cast<uint8_t>(c);
+                if (byte >= 0x20) {
+                    out.AppendCodepoint(WinAnsi(byte));
+                } else if (byte == '\t' || byte == '\n' || byte == '\r') {
+                    out.Space();
+                }
+            }
+        }
+    }
+
+    // ============== PdfReader ==============
+
+    class PdfReader::Impl
+    {
+    public:
+        struct XrefEntry
+        {
+            uint8_t type = 0;           // 0 unknown or free, 1 at offset, 2 inside an object stream
+            uint64_t offset = 0;        // Byte offset, or the containing object stream's number
+            uint32_t index = 0;         // Position within the object stream
+        };
+
+        using FontCache = std::unordered_map<uint32_t, std::shared_ptr<const FontMap>>;
+
+        core::MappedFile file_;
+        const char* data_ = nullptr;    // From the %PDF header; offsets count from here
+        size_t size_ = 0;
+        std::string errorMessage_;
+        std::vector<XrefEntry> xref_;
+        PdfObject trailer_;
+        bool encrypted_ = false;
+
+        // The last object stream unpacked; neighbouring objects tend to
+        // share one
+        uint32_t objectStream_ = 0;
+        std::string objectStreamData_;
+        std::vector<std::pair<uint32_t, size_t>> objectStreamEntries_;     // Number, offset past /First
+
+        bool Open(const core::Path& path)
+        {
+            Close();
+            if (!file_.Open(path.Get())) {
+                errorMessage_ = "Failed to open file";
+                return false;
+            }
+
+            // Anything before the header is junk that offsets do not count
+            std::string_view head(reinterpret_cast<const char*>(file_.Data()), std::min<size_t>(file_.Size(), 1024));
+            size_t header = head.find("%PDF-");
+            if (header == std::string_view::npos) {
+                Close();
+                errorMessage_ = "Not a PDF file";
+                return false;
+            }
+            data_ = reinterpret_cast<const char*>(file_.Data()) + header;
+            size_ = file_.Size() - header;
+
+            if (!LoadXref() || !Resolve(trailer_.Get("Root")).Get("Pages")) {
+                OPACITY_LOG_DEBUG(Preview, "PdfReader: cross-reference table of {} is damaged, scanning", path.String());
+                Repair();
+            }
+            if (!Resolve(trailer_.Get("Root")).Get("Pages")) {
+                Close();
+                errorMessage_ = "Damaged PDF file";
+                return false;
+            }
+
+            encrypted_ = trailer_.Get("Encrypt") != nullptr;
+            return true;
+        }
+
+        void Close()
+        {
+            file_.Close();
+            data_ = nullptr;
+            size_ = 0;
+            xref_.clear();
+            trailer_ = PdfObject{};
+            encrypted_ = false;
+            objectStream_ = 0;
+            objectStreamData_.clear();
+            objectStreamEntries_.clear();
+            errorMessage_.clear();
+        }
+
+        // ---- Cross-reference table ----
+
+        void SetEntry(uint64_t number, const XrefEntry& entry, bool replace)
+        {
+            if (number == 0 || number >= kMaxObjects) return;
+            if (number >= xref_.size()) xref_.resize(number + 1);
+            // Newer sections are read first, so an entry already set wins
+            if (replace || xref_[number].type == 0) xref_[number] = entry;
+        }
+
+        bool LoadXref()
+        {
+            size_t tail = std::min<size_t>(size_, 4096);
+            std::string_view end(data_ + size_ - tail, tail);
+            size_t keyword = end.rfind("startxref");
+            if (keyword == std::string_view::npos) return false;
+
+            PdfLexer lexer(end.data() + keyword + 9, data_ + size_);
+            int64_t offset = 0;
+            if (!lexer.ReadInteger(offset)) return false;
+
+            std::unordered_set<int64_t> seen;
+            while (offset > 0 && static_cast<uint64_t>(offset) < size_ && seen.insert(offset).second && seen.size() < 1024) {
+                PdfObject trailer;
+                if (!ReadXrefSection(static_cast<size_t>(offset), trailer)) break;
+                if (trailer_.kind == PdfObject::Kind::Null) trailer_ = trailer;
+
+                // Hybrid files keep their compressed objects in a stream
+                // alongside the table
+                double stream = NumberOr(trailer.Get("XRefStm"), 0);
+                if (stream > 0 && stream < size_ && seen.insert(static_cast<int64_t>(stream)).second) {
+                    PdfObject ignored;
+                    ReadXrefSection(static_cast<size_t>(stream), ignored);
+                }
+                offset = static_cast<int64_t>(NumberOr(trailer.Get("Prev"), 0));
+            }
+            return trailer_.Get("Root") != nullptr;
+        }
+
+        bool ReadXrefSection(size_t offset, PdfObject& trailer)
+        {
+            PdfLexer lexer(data_ + offset, data_ + size_);
+            if (lexer.ReadKeyword("xref")) {
+                while (true) {
+                    const char* save = lexer.Position();
+                    int64_t start = 0, count = 0;
+                    if (!lexer.ReadInteger(start) || !lexer.ReadInteger(count)) {
+                        lexer.Seek(save);
+                        break;
+                    }
+                    if (start < 0 || count < 0 || start + count > kMaxObjects) return false;
+                    for (int64_t i = 0; i < count; i++) {
+                        int64_t entryOffset = 0, generation = 0;
+                        if (!lexer.ReadInteger(entryOffset) || !lexer.ReadInteger(generation)) return false;
+                        lexer.SkipWhitespace();
+                        const char* type = lexer.Position();
+                        if (type >= lexer.End()) return false;
+                        lexer.Seek(type + 1);
+                        if (*type == 'n' && entryOffset > 0) {
+                            SetEntry(static_cast<uint64_t>(start + i), {1, static_cast<uint64_t>(entryOffset), 0}, false);
+                        }
+                    }
+                }
+                return lexer.ReadKeyword("trailer") && lexer.ReadObject(trailer) &&
+                       trailer.kind == PdfObject::Kind::Dictionary;
+            }
+
+            // Otherwise a cross-reference stream, whose dictionary is the trailer
+            std::string_view raw;
+            if (!ReadIndirect(offset, kAnyObject, trailer, &raw, 0)) return false;
+            const PdfObject* type = trailer.Get("Type");
+            if (!type || !type->IsName("XRef")) return false;
+
+            std::string rows;
+            if (!DecodeStream(trailer, raw, rows, kMaxStreamBytes, 0)) return false;
+
+            const PdfObject* widths = trailer.Get("W");
+            if (!widths || widths->kind != PdfObject::Kind::Array || widths->items.size() < 3) return false;
+            size_t w[3];
+            for (int i = 0; i < 3; i++) {
+                w[i] = static_cast<size_t>(std::clamp(NumberOr(&widths->items[i], 0), 0.0, 8.0));
+            }
+            size_t rowBytes = w[0] + w[1] + w[2];
+            if (rowBytes == 0) return false;
+
+            std::vector<int64_t> ranges;
+            const PdfObject* index = trailer.Get("Index");
+            if (index && index->kind == PdfObject::Kind::Array) {
+                for (const auto& item : index->items) ranges.push_back(static_cast<int64_t>(NumberOr(&item, 0)));
+            } else {
+                ranges = {0, static_cast<int64_t>(NumberOr(trailer.Get("Size"), 0))};
+            }
+
+            auto field = [&rows](size_t pos, size_t width) {
+                uint64_t value = 0;
+                for (size_t i = 0; i < width; i++) value = (value << 8) | static_cast<uint8_t>(rows[pos + i]);
+                return value;
+            };
+
+            size_t pos = 0;
+            for (size_t r = 0; r + 1 < ranges.size(); r += 2) {
+                int64_t start = ranges[r];
+                int64_t count = ranges[r + 1];
+                if (start < 0 || count < 0 || start + count > kMaxObjects) return false;
+                for (int64_t i = 0; i < count && pos + rowBytes <= rows.size(); i++, pos += rowBytes) {
+                    uint64_t kind = w[0] ? field(pos, w[0]) : 1;
+                    uint64_t second = field(pos + w[0], w[1]);
+                    uint64_t third = field(pos + w[0] + w[1], w[2]);
+                    if (kind == 1 && second > 0) {
+                        SetEntry(static_cast<uint64_t>(start + i), {1, second, 0}, false);
+                    } else if (kind == 2) {
+                        SetEntry(static_cast<uint64_t>(start + i), {2, second, static_cast<uint32_t>(third)}, false);
+                    }
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Rebuild the table by finding every "n g obj" in the file
+         */
+        void Repair()
+        {
+            xref_.clear();
+            objectStream_ = 0;
+            objectStreamData_.clear();
+            objectStreamEntries_.clear();
+
+            std::string_view all(data_, size_);
+            std::vector<uint32_t> objectStreams;
+            std::vector<uint32_t> catalogs;
+
+            for (size_t pos = all.find("obj"); pos != std::string_view::npos; pos = all.find("obj", pos + 3)) {
+                if (pos == 0 || !IsWhitespace(all[pos - 1]) || (pos + 3 < size_ && IsRegular(all[pos + 3]))) continue;
+
+                // Back over the generation and the object number
+                size_t cursor = pos;
+                auto skipBack = [&all, &cursor](bool digits) {
+                    size_t start = cursor;
+                    while (cursor > 0 && (digits ? (all[cursor - 1] >= '0' && all[cursor - 1] <= '9')
+                                                 : IsWhitespace(all[cursor - 1]))) {
+                        cursor--;
+                    }
+                    return start - cursor;
+                };
+                skipBack(false);
+                if (skipBack(true) == 0) continue;
+                if (skipBack(false) == 0) continue;
+                size_t numberEnd = cursor;
+                if (skipBack(true) == 0 || numberEnd - cursor > 9) continue;
+                if (cursor > 0 && IsRegular(all[cursor - 1])) continue;
+
+                uint64_t number = std::stoull(std::string(all.substr(cursor, numberEnd - cursor)));
+                if (number == 0 || number >= kMaxObjects) continue;
+                SetEntry(number, {1, cursor, 0}, true);
+
+                std::string_view head = all.substr(pos, 512);
+                if (head.find("/ObjStm") != std::string_view::npos) objectStreams.push_back(static_cast<uint32_t>(number));
+                if (head.find("/Catalog") != std::string_view::npos) catalogs.push_back(static_cast<uint32_t>(number));
+            }
+
+            // Objects packed in object streams, unless also written out directly
+            for (uint32_t stream : objectStreams) {
+                if (!LoadObjectStream(stream, 0)) continue;
+                for (size_t i = 0; i < objectStreamEntries_.size(); i++) {
+                    SetEntry(objectStreamEntries_[i].first, {2, stream, static_cast<uint32_t>(i)}, false);
+                }
+            }
+
+            // The last trailer naming a catalog, else the last catalog object
+            PdfObject trailer;
+            for (size_t pos = all.find("trailer"); pos != std::string_view::npos; pos = all.find("trailer", pos + 7)) {
+                PdfLexer lexer(data_ + pos + 7, data_ + size_);
+                PdfObject candidate;
+                if (lexer.ReadObject(candidate) && candidate.Get("Root")) trailer = std::move(candidate);
+            }
+            if (!trailer.Get("Root")) {
+                for (auto it = catalogs.rbegin(); it != catalogs.rend(); ++it) {
+                    PdfObject catalog = Load(*it, 0);
+                    const PdfObject* type = catalog.Get("Type");
+                    if (type && type->IsName("Catalog")) {
+                        PdfObject root;
+                        root.kind = PdfObject::Kind::Reference;
+                        root.reference = *it;
+                        trailer = PdfObject{};
+                        trailer.kind = PdfObject::Kind::Dictionary;
+                        trailer.keys.push_back("Root");
+                        trailer.items.push_back(std::move(root));
+                        break;
+                    }
+                }
+            }
+            trailer_ = std::move(trailer);
+        }
+
+        // ---- Objects ----
+
+        /**
+         * @brief Parse "n g obj" at offset and the object after it, and
+         *        locate its stream data if it has one
+         */
+        bool ReadIndirect(size_t offset, uint32_t number, PdfObject& object, std::string_view* stream, int depth)
+        {
+            if (offset >= size_) return false;
+            PdfLexer lexer(data_ + offset, data_ + size_);
+            int64_t found = 0, generation = 0;
+            if (!lexer.ReadInteger(found) || !lexer.ReadInteger(generation) || !lexer.ReadKeyword("obj")) return false;
+            if (number != kAnyObject && found != number) return false;
+            if (!lexer.ReadObject(object)) return false;
+
+            if (!stream) return true;
+            *stream = {};
+            if (object.kind != PdfObject::Kind::Dictionary || !lexer.ReadKeyword("stream")) return true;
+
+            const char* begin = lexer.Position();
+            const char* end = data_ + size_;
+            if (begin < end && *begin == '\r') begin++;
+            if (begin < end && *begin == '\n') begin++;
+            size_t available = static_cast<size_t>(end - begin);
+
+            // Trust /Length only when endstream is where it says
+            PdfObject declared = Resolve(object.Get("Length"), depth + 1);
+            double length = NumberOr(&declared, -1);
+            if (length >= 0 && length <= static_cast<double>(available)) {
+                PdfLexer after(begin + static_cast<size_t>(length), end);
+                if (after.ReadKeyword("endstream")) {
+                    *stream = std::string_view(begin, static_cast<size_t>(length));
+                    return true;
+                }
+            }
+
+            std::string_view rest(begin, available);
+            size_t close = rest.find("endstream");
+            if (close == std::string_view::npos) close = available;
+            if (close > 0 && rest[close - 1] == '\n') close--;
+            if (close > 0 && rest[close - 1] == '\r') close--;
+            *stream = rest.substr(0, close);
+            return true;
+        }
+
+        bool LoadObjectStream(uint32_t number, int depth)
+        {
+            if (objectStream_ == number && !objectStreamEntries_.empty()) return true;
+
+            objectStream_ = 0;
+            objectStreamData_.clear();
+            objectStreamEntries_.clear();
+            if (number >= xref_.size() || xref_[number].type != 1) return false;
+
+            PdfObject dictionary;
+            std::string_view raw;
+            if (!ReadIndirect(static_cast<size_t>(xref_[number].offset), number, dictionary, &raw, depth + 1)) return false;
+
+            std::string data;
+            if (!DecodeStream(dictionary, raw, data, kMaxStreamBytes, depth + 1)) return false;
+
+            size_t count = static_cast<size_t>(std::max(0.0, NumberOr(dictionary.Get("N"), 0)));
+            size_t first = static_cast<size_t>(std::max(0.0, NumberOr(dictionary.Get("First"), 0)));
+            if (first > data.size()) return false;
+
+            PdfLexer lexer(data.data(), data.data() + first);
+            std::vector<std::pair<uint32_t, size_t>> entries;
+            for (size_t i = 0; i < count; i++) {
+                int64_t member = 0, offset = 0;
+                if (!lexer.ReadInteger(member) || !lexer.ReadInteger(offset) || member < 0 || offset < 0) break;
+                entries.emplace_back(static_cast<uint32_t>(member), first + static_cast<size_t>(offset));
+            }
+
+            objectStream_ = number;
+            objectStreamData_ = std::move(data);
+            objectStreamEntries_ = std::move(entries);
+            return true;
+        }
+
+        /**
+         * @brief An object by number, with its stream data when it has one
+         *        (valid while the file is open)
+         */
+        bool LoadObject(uint32_t number, PdfObject& object, std::string_view* stream, int depth)
+        {
+            object = PdfObject{};
+            if (stream) *stream = {};
+            if (depth > kMaxNesting || number >= xref_.size()) return false;
+
+            const XrefEntry entry = xref_[number];
+            if (entry.type == 1) {
+                return ReadIndirect(static_cast<size_t>(entry.offset), number, object, stream, depth);
+            }
+            if (entry.type != 2 || entry.offset >= kMaxObjects) return false;
+
+            uint32_t container = static_cast<uint32_t>(entry.offset);
+            if (!LoadObjectStream(container, depth)) return false;
+
+            // The index usually says where it is; the number says for sure
+            size_t offset = std::string::npos;
+            if (entry.index < objectStreamEntries_.size() && objectStreamEntries_[entry.index].first == number) {
+                offset = objectStreamEntries_[entry.index].second;
+            } else {
+                for (const auto& member : objectStreamEntries_) {
+                    if (member.first == number) {
+                        offset = member.second;
+                        break;
+                    }
+                }
+            }
+            if (offset >= objectStreamData_.size()) return false;
+
+            PdfLexer lexer(objectStreamData_.data() + offset, objectStreamData_.data() + objectStreamData_.size());
+            return lexer.ReadObject(object);
+        }
+
+        PdfObject Load(uint32_t number, int depth)
+        {
+            PdfObject object;
+            LoadObject(number, object, nullptr, depth);
+            return object;
+        }
+
+        /**
+         * @brief The object itself, following references
+         */
+        PdfObject Resolve(const PdfObject* object, int depth = 0)
+        {
+            if (!object) return PdfObject{};
+            PdfObject resolved = *object;
+            while (resolved.kind == PdfObject::Kind::Reference && depth++ < kMaxNesting) {
+                resolved = Load(resolved.reference, depth);
+            }
+            return resolved.kind == PdfObject::Kind::Reference ? PdfObject{} : resolved;
+        }
+
+        /**
+         * @brief Run a stream's filters, stopping at limit bytes
+         * @return false for filters that carry no text (images) or cannot
+         *         be undone here
+         */
+        bool DecodeStream(const PdfObject& dictionary, std::string_view raw, std::string& out, size_t limit, int depth)
+        {
+            out.clear();
+            PdfObject filter = Resolve(dictionary.Get("Filter"), depth);
+            PdfObject params = Resolve(dictionary.Get("DecodeParms"), depth);
+
+            std::vector<std::string> filters;
+            std::vector<const PdfObject*> filterParams;
+            if (filter.kind == PdfObject::Kind::Name) {
+                filters.push_back(filter.text);
+                filterParams.push_back(params.kind == PdfObject::Kind::Dictionary ? &params : nullptr);
+            } else if (filter.kind == PdfObject::Kind::Array) {
+                for (size_t i = 0; i < filter.items.size(); i++) {
+                    if (filter.items[i].kind != PdfObject::Kind::Name) return false;
+                    filters.push_back(filter.items[i].text);
+                    const PdfObject* param = nullptr;
+                    if (params.kind == PdfObject::Kind::Array && i < params.items.size() &&
+                        params.items[i].kind == PdfObject::Kind::Dictionary) {
+                        param = &params.items[i];
+                    }
+                    filterParams.push_back(param);
+                }
+            }
+
+            std::string buffer;
+            std::string_view input = raw;
+            for (size_t i = 0; i < filters.size(); i++) {
+                std::string next;
+                const std::string& name = filters[i];
+                if (name == "FlateDecode" || name == "Fl") {
+                    if (!Inflate(input, next, limit)) return false;
+                    ApplyPredictor(filterParams[i], next);
+                } else if (name == "ASCIIHexDecode" || name == "AHx") {
+                    DecodeAsciiHex(input, next);
+                } else if (name == "ASCII85Decode" || name == "A85") {
+                    DecodeAscii85(input, next);
+                } else {
+                    return false;
+                }
+                buffer = std::move(next);
+                input = buffer;
+            }
+
+            if (filters.empty()) {
+                out.assign(raw.substr(0, limit));
+            } else {
+                out = std::move(buffer);
+                if (out.size() > limit) out.resize(limit);
+            }
+            return true;
+        }
+
+        // ---- Pages ----
+
+        /**
+         * @brief Call visit(page, resources) for each page in order, with
+         *        the resources it inherits; stops when visit returns false
+         */
+        template <typename Visit>
+        size_t ForEachPage(Visit&& visit)
+        {
+            PdfObject root = Resolve(trailer_.Get("Root"));
+            const PdfObject* pages = root.Get("Pages");
+            if (!pages) return 0;
+
+            struct Node
+            {
+                PdfObject object;
+                PdfObject resources;
+            };
+
+            std::vector<Node> stack;
+            stack.push_back({*pages, PdfObject{}});
+            std::unordered_set<uint32_t> visited;
+            size_t count = 0;
+            size_t steps = 0;
+
+            while (!stack.empty() && steps++ < kMaxPages * 2) {
+                Node node = std::move(stack.back());
+                stack.pop_back();
+                if (node.object.kind == PdfObject::Kind::Reference && !visited.insert(node.object.reference).second) {
+                    continue;
+                }
+                PdfObject object = Resolve(&node.object);
+                if (object.kind != PdfObject::Kind::Dictionary) continue;
+
+                PdfObject resources = object.Get("Resources") ? *object.Get("Resources") : node.resources;
+                PdfObject kids = Resolve(object.Get("Kids"));
+                if (kids.kind == PdfObject::Kind::Array) {
+                    for (auto it = kids.items.rbegin(); it != kids.items.rend(); ++it) {
+                        stack.push_back({*it, resources});
+                    }
+                    continue;
+                }
+
+                count++;
+                if (!visit(object, resources)) break;
+            }
+            return count;
+        }
+
+        int GetPageCount()
+        {
+            PdfObject root = Resolve(trailer_.Get("Root"));
+            PdfObject pages = Resolve(root.Get("Pages"));
+            double count = NumberOr(pages.Get("Count"), 0);
+            if (count > 0 && count < kMaxPages) return static_cast<int>(count);
+            return static_cast<int>(ForEachPage([](const PdfObject&, const PdfObject&) { return true; }));
+        }
+
+        /**
+         * @brief A page's content streams, decoded and joined
+         */
+        void ReadPageContent(const PdfObject& page, std::string& content)
+        {
+            content.clear();
+            const PdfObject* contents = page.Get("Contents");
+            if (!contents) return;
+
+            std::vector<uint32_t> streams;
+            if (contents->kind == PdfObject::Kind::Reference) {
+                // Either a stream, or a reference to an array of them
+                PdfObject object;
+                std::string_view raw;
+                if (!LoadObject(contents->reference, object, &raw, 0)) return;
+                if (object.kind == PdfObject::Kind::Array) {
+                    for (const auto& item : object.items) {
+                        if (item.kind == PdfObject::Kind::Reference) streams.push_back(item.reference);
+                    }
+                } else {
+                    streams.push_back(contents->reference);
+                }
+            } else if (contents->kind == PdfObject::Kind::Array) {
+                for (const auto& item : contents->items) {
+                    if (item.kind == PdfObject::Kind::Reference) streams.push_back(item.reference);
+                }
+            }
+
+            std::string decoded;
+            for (uint32_t number : streams) {
+                PdfObject dictionary;
+                std::string_view raw;
+                if (content.size() >= kMaxStreamBytes || !LoadObject(number, dictionary, &raw, 0)) continue;
+                if (DecodeStream(dictionary, raw, decoded, kMaxStreamBytes - content.size(), 0)) {
+                    // Streams split anywhere, even mid-token, but not mid-byte
+                    content += decoded;
+                    content += '\n';
+                }
+            }
+        }
+
+        std::shared_ptr<const FontMap> LoadFont(const PdfObject& fonts, const std::string& name, FontCache& cache)
+        {
+            const PdfObject* entry = fonts.Get(name);
+            if (!entry) return nullptr;
+
+            uint32_t key = entry->kind == PdfObject::Kind::Reference ? entry->reference : 0;
+            if (key) {
+                auto it = cache.find(key);
+                if (it != cache.end()) return it->second;
+            }
+
+            PdfObject font = Resolve(entry);
+            auto map = std::make_shared<FontMap>();
+            const PdfObject* subtype = font.Get("Subtype");
+            if (subtype && subtype->IsName("Type0")) map->codeBytes = 2;
+
+            const PdfObject* toUnicode = font.Get("ToUnicode");
+            if (toUnicode && toUnicode->kind == PdfObject::Kind::Reference) {
+                PdfObject dictionary;
+                std::string_view raw;
+                std::string cmap;
+                if (LoadObject(toUnicode->reference, dictionary, &raw, 0) &&
+                    DecodeStream(dictionary, raw, cmap, kMaxStreamBytes, 0)) {
+                    ParseCMap(cmap, *map);
+                }
+            }
+
+            if (key) {
+                if (cache.size() >= kMaxCachedFonts) cache.clear();
+                cache[key] = map;
+            }
+            return map;
+        }
+
+        /**
+         * @brief Show the text operators of one page's content
+         */
+        void ExtractContent(std::string_view content, const PdfObject& resources, FontCache& cache, ChunkWriter& out)
+        {
+            PdfObject resolvedResources = Resolve(&resources);
+            PdfObject fonts = Resolve(resolvedResources.Get("Font"));
+            std::shared_ptr<const FontMap> font;
+            double lineY = 0.0;
+
+            PdfLexer lexer(content.data(), content.data() + content.size());
+            std::vector<PdfObject> operands;
+            PdfObject token;
+            while (!out.IsStopped() && lexer.ReadObject(token, false)) {
+                if (token.kind != PdfObject::Kind::Keyword) {
+                    if (operands.size() < 64) operands.push_back(std::move(token));
+                    continue;
+                }
+
+                const std::string& op = token.text;
+                size_t count = operands.size();
+                if (op == "Tj" || op == "'" || op == "\"") {
+                    if (op != "Tj") out.EndLine();
+                    if (count > 0 && operands.back().kind == PdfObject::Kind::String) {
+                        ShowText(operands.back().text, font.get(), out);
+                    }
+                } else if (op == "TJ") {
+                    if (count > 0 && operands.back().kind == PdfObject::Kind::Array) {
+                        for (const auto& item : operands.back().items) {
+                            if (item.kind == PdfObject::Kind::String) {
+                                ShowText(item.text, font.get(), out);
+                            } else if (item.kind == PdfObject::Kind::Number && item.number < -200) {
+                                // A gap this wide (in thousandths of an em) is a word space
+                                out.Space();
+                            }
+                        }
+                    }
+                } else if (op == "Td" || op == "TD") {
+                    if (count >= 2 && operands[count - 1].number != 0) {
+                        out.EndLine();
+                    } else {
+                        out.Space();
+                    }
+                } else if (op == "T*") {
+                    out.EndLine();
+                } else if (op == "Tm") {
+                    if (count >= 6) {
+                        double y = operands[count - 1].number;
+                        if (y != lineY) {
+                            out.EndLine();
+                            lineY = y;
+                        } else {
+                            out.Space();
+                        }
+                    }
+                } else if (op == "Tf") {
+                    if (count >= 2 && operands[count - 2].kind == PdfObject::Kind::Name) {
+                        font = LoadFont(fonts, operands[count - 2].text, cache);
+                    }
+                } else if (op == "ET") {
+                    out.Space();
+                } else if (op == "ID") {
+                    lexer.SkipInlineImage();
+                }
+                operands.clear();
+            }
+        }
+
+        bool ExtractText(const TextChunkSink& sink)
+        {
+            if (!data_ || encrypted_) return false;
+
+            ChunkWriter out(sink);
+            FontCache fonts;
+            std::string content;
+            size_t pages = ForEachPage([&](const PdfObject& page, const PdfObject& resources) {
+                ReadPageContent(page, content);
+                ExtractContent(content, resources, fonts, out);
+                out.EndLine(2);
+                return !out.IsStopped();
+            });
+            out.Finish();
+            return pages > 0;
+        }
+    };
+
+    PdfReader::PdfReader()
+        : impl_(std::make_unique<Impl>())
+    {}
+
+    PdfReader::~PdfReader() = default;
+
+    bool PdfReader::Open(const core::Path& path)
+    {
+        return impl_->Open(path);
+    }
+
+    void PdfReader::Close()
+    {
+        impl_->Close();
+    }
+
+    bool PdfReader::IsOpen() const
+    {
+        return impl_->data_ != nullptr;
+    }
+
+    const std::string& PdfReader::GetErrorMessage() const
+    {
+        return impl_->errorMessage_;
+    }
+
+    bool PdfReader::IsEncrypted() const
+    {
+        return impl_->encrypted_;
+    }
+
+    int PdfReader::GetPageCount() const
+    {
+        return impl_->data_ ? impl_->GetPageCount() : 0;
+    }
+
+    std::string PdfReader::GetInfo(const std::string& key) const
+    {
+        if (!impl_->data_ || impl_->encrypted_) return {};
+        PdfObject info = impl_->Resolve(impl_->trailer_.Get("Info"));
+        PdfObject value = impl_->Resolve(info.Get(key));
+        return value.kind == PdfObject::Kind::String ? DecodeTextString(value.text) : std::string();
+    }
+
+    bool PdfReader::ExtractText(const TextChunkSink& sink) const
+    {
+        return impl_->ExtractText(sink);
+    }
+
+    // ============== DocumentTextExtractor ==============
+
+    bool DocumentTextExtractor::Supports(const std::string& extension)
+    {
+        return FamilyOf(extension) != DocumentFamily::None;
+    }
+
+    std::vector<std::string> DocumentTextExtractor::GetSupportedExtensions()
+    {
+        return {"pdf", "docx", "docm", "xlsx", "xlsm", "pptx", "pptm", "odt", "ods", "odp"};
+    }
+
+    bool DocumentTextExtractor::Extract(const core::Path& path, const TextChunkSink& sink)
+    {
+        std::string extension = path.Extension();
+        if (!extension.empty() && extension[0] == '.') extension.erase(0, 1);
+        std::transform(extension.begin(), extension.end(), extension.begin(),
+                       [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+        DocumentFamily family = FamilyOf(extension);
+        if (family == DocumentFamily::None) return false;
+
+        if (family == DocumentFamily::Pdf) {
+            PdfReader reader;
+            return reader.Open(path) && reader.ExtractText(sink);
+        }
+
+        core::MappedFile file;
+        if (!file.Open(path.Get())) return false;
+
+        ChunkWriter out(sink);
+        bool found = ExtractZipText(file, family, out);
+        out.Finish();
+        return found;
+    }
+
+} // namespace opacity::preview
@@ -3,7 +3,9 @@
 
 #include <algorithm>
 #include <array>
+#include <cctype>
 #include <cmath>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
 #include <sstream>
@@ -13,6 +15,145 @@ namespace opacity::preview
 {
     using namespace opacity::core;
 
+    namespace
+    {
+        // Mapped at a time while searching; bounds address space, not speed
+        constexpr size_t kSearchChunk = 64 * 1024 * 1024;
+
+        // Mapped at a time by each analysis worker
+        constexpr uint64_t kAnalysisChunk = 16 * 1024 * 1024;
+
+        constexpr unsigned kMaxAnalysisThreads = 8;
+
+        // Shared for writing and deleting, so the file stays usable by
+        // others; mapped a range at a time, however large it is
+        constexpr MappedFileOptions kMapOptions{true, false};
+
+        constexpr char kHexDigits[] = "0123456789ABCDEF";
+
+        // How often a byte turns up in typical binaries; the rarest byte
+        // of a pattern is the one scanned for
+        int Commonness(uint8_t b, bool foldCase)
+        {
+            if (b == 0x00) return 4;
+            if (b == 0xFF) return 3;
+            if (b == ' ') return 2;
+            if (foldCase && std::isalpha(b)) return 2;  // Two scans, one per case
+            if (std::isalnum(b)) return 1;
+            return 0;
+        }
+
+        bool Matches(const uint8_t* data, const std::vector<uint8_t>& pattern, bool foldCase)
+        {
+            if (!foldCase) {
+                return std::memcmp(data, pattern.data(), pattern.size()) == 0;
+            }
+            for (size_t i = 0; i < pattern.size(); i++) {
+                if (std::tolower(data[i]) != pattern[i]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        double EntropyOf(const uint64_t* counts, uint64_t total)
+        {
+            if (total == 0) return 0.0;
+
+            double entropy = 0.0;
+            double size = static_cast<double>(total);
+            for (size_t i = 0; i < 256; i++) {
+                if (counts[i] > 0) {
+                    double p = counts[i] / size;
+                    entropy -= p * std::log2(p);
+                }
+            }
+            return entropy;
+        }
+
+        // Counts, entropy and the text/binary guess, from a histogram
+        void ClassifyBytes(const std::array<uint64_t, 256>& histogram, uint64_t total, BinaryStats& stats)
+        {
+            stats.nullBytes = static_cast<size_t>(histogram[0]);
+            stats.printableBytes = 0;
+            stats.controlBytes = 0;
+            stats.highBytes = 0;
+            for (size_t b = 1; b < 256; b++) {
+                if (b >= 32 && b < 127) {
+                    stats.printableBytes += static_cast<size_t>(histogram[b]);
+                } else if (b < 32) {
+                    stats.controlBytes += static_cast<size_t>(histogram[b]);
+                } else {
+                    stats.highBytes += static_cast<size_t>(histogram[b]);
+                }
+            }
+
+            // Calculate entropy
+            stats.entropy = EntropyOf(histogram.data(), total);
+
+            // Determine if text or binary
+            double printableRatio = total ? static_cast<double>(stats.printableBytes) / total : 0.0;
+            double nullRatio = total ? static_cast<double>(stats.nullBytes) / total : 0.0;
+
+            stats.isProbablyText = printableRatio > 0.85 && nullRatio < 0.01;
+            stats.isProbablyBinary = !stats.isProbablyText;
+        }
+
+        // Four tables, one per byte lane: a run of one value bumps four
+        // counters in turn instead of waiting on one
+        void CountBytes(const uint8_t* data, size_t size, uint64_t* counts)
+        {
+            uint32_t tables[4][256] = {};
+            size_t i = 0;
+            for (; i + 4 <= size; i += 4) {
+                tables[0][data[i]]++;
+                tables[1][data[i + 1]]++;
+                tables[2][data[i + 2]]++;
+                tables[3][data[i + 3]]++;
+            }
+            for (; i < size; i++) {
+                tables[0][data[i]]++;
+            }
+            for (size_t b = 0; b < 256; b++) {
+                counts[b] = static_cast<uint64_t>(tables[0][b]) + tables[1][b] + tables[2][b] + tables[3][b];
+            }
+        }
+
+        // memchr is vectorised by the CRT, so candidates are found a
+        // register at a time and only those are compared
+        int64_t FindIn(const uint8_t* data, size_t size, const std::vector<uint8_t>& pattern,
+                       size_t anchor, bool foldCase)
+        {
+            size_t length = pattern.size();
+            if (size < length) return -1;
+
+            const uint8_t* p = data + anchor;
+            const uint8_t* last = data + (size - length) + anchor + 1;
+            uint8_t lower = pattern[anchor];
+            uint8_t upper = foldCase ? static_cast<uint8_t>(std::toupper(lower)) : lower;
+
+            auto scan = [&](uint8_t b, const uint8_t* from) {
+                return static_cast<const uint8_t*>(std::memchr(from, b, static_cast<size_t>(last - from)));
+            };
+            const uint8_t* nextLower = scan(lower, p);
+            const uint8_t* nextUpper = upper != lower ? scan(upper, p) : nullptr;
+
+            while (nextLower || nextUpper) {
+                const uint8_t* hit = !nextUpper ? nextLower
+                                   : !nextLower ? nextUpper
+                                   : std::min(nextLower, nextUpper);
+                if (Matches(hit - anchor, pattern, foldCase)) {
+                    return static_cast<int64_t>(hit - anchor - data);
+                }
+
+                p = hit + 1;
+                if (nextLower == hit) nextLower = p < last ? scan(lower, p) : nullptr;
+                if (nextUpper == hit) nextUpper = p < last ? scan(upper, p) : nullptr;
+            }
+            return -1;
+        }
+    }
+
     class HexPreviewHandler::Impl
     {
     public:
@@ -98,6 +239,200 @@ namespace opacity::preview
         }
     };
 
+    // ============== HexSearch ==============
+
+    HexSearch::HexSearch() = default;
+
+    HexSearch::~HexSearch()
+    {
+        Cancel();
+    }
+
+    void HexSearch::Start(
+        std::shared_ptr<MappedFile> file,
+        std::vector<uint8_t> pattern,
+        bool caseSensitive,
+        uint64_t startOffset)
+    {
+        Cancel();
+        progress_.cancelled.store(false, std::memory_order_relaxed);
+        progress_.scanned.store(0, std::memory_order_relaxed);
+        progress_.total.store(0, std::memory_order_relaxed);
+        result_.store(-1, std::memory_order_release);
+        if (!file) return;
+
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread([this, file = std::move(file), pattern = std::move(pattern), caseSensitive, startOffset]() {
+            int64_t result = HexPreviewHandler::SearchBytes(*file, pattern, caseSensitive, startOffset, &progress_);
+            result_.store(result, std::memory_order_release);
+            running_.store(false, std::memory_order_release);
+        });
+    }
+
+    void HexSearch::Cancel()
+    {
+        progress_.cancelled.store(true, std::memory_order_relaxed);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        running_.store(false, std::memory_order_release);
+    }
+
+    float HexSearch::GetProgress() const
+    {
+        uint64_t total = progress_.total.load(std::memory_order_relaxed);
+        if (total == 0) return IsRunning() ? 0.0f : 1.0f;
+        return static_cast<float>(static_cast<double>(progress_.scanned.load(std::memory_order_relaxed)) / total);
+    }
+
+    // ============== HexAnalysis ==============
+
+    std::vector<float> HexAnalysisResult::GetStrip(size_t columns) const
+    {
+        std::vector<float> strip;
+        if (columns == 0 || blockEntropy.empty()) return strip;
+
+        size_t blocks = blockEntropy.size();
+        strip.resize(columns);
+        for (size_t c = 0; c < columns; c++) {
+            size_t begin = std::min(c * blocks / columns, blocks - 1);
+            size_t end = std::max(begin + 1, (c + 1) * blocks / columns);
+            strip[c] = *std::max_element(blockEntropy.begin() + begin, blockEntropy.begin() + end);
+        }
+        return strip;
+    }
+
+    HexAnalysis::HexAnalysis() = default;
+
+    HexAnalysis::~HexAnalysis()
+    {
+        Cancel();
+    }
+
+    void HexAnalysis::Start(std::shared_ptr<MappedFile> file, unsigned threads)
+    {
+        Cancel();
+        cancelled_.store(false, std::memory_order_relaxed);
+        analysed_.store(0, std::memory_order_relaxed);
+        nextChunk_.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            result_.reset();
+        }
+        if (!file || !file->IsOpen()) return;
+
+        uint64_t size = file->FileSize();
+        auto pending = std::make_shared<HexAnalysisResult>();
+        pending->stats.fileSize = static_cast<size_t>(size);
+
+        // Whole multiples of the minimum keep every chunk on the mapping
+        // granularity
+        uint64_t blockSize = std::max<uint64_t>(kMinBlockSize, (size + kMaxBlocks - 1) / kMaxBlocks);
+        blockSize = (blockSize + kMinBlockSize - 1) / kMinBlockSize * kMinBlockSize;
+        uint64_t blocks = (size + blockSize - 1) / blockSize;
+        pending->blockSize = blockSize;
+        pending->blockEntropy.assign(static_cast<size_t>(blocks), 0.0f);
+
+        if (blocks == 0) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ClassifyBytes(pending->histogram, 0, pending->stats);
+            result_ = std::move(pending);
+            return;
+        }
+
+        chunkBlocks_ = std::max<uint64_t>(1, kAnalysisChunk / blockSize);
+        chunkCount_ = static_cast<size_t>((blocks + chunkBlocks_ - 1) / chunkBlocks_);
+
+        if (threads == 0) {
+            threads = std::min(kMaxAnalysisThreads, std::max(1u, std::thread::hardware_concurrency()));
+        }
+        threads = static_cast<unsigned>(std::min<size_t>(threads, chunkCount_));
+
+        file_ = std::move(file);
+        pending_ = std::move(pending);
+        running_.store(true, std::memory_order_release);
+        active_.store(threads, std::memory_order_relaxed);
+        for (unsigned i = 0; i < threads; i++) {
+            workers_.emplace_back(&HexAnalysis::WorkerLoop, this);
+        }
+    }
+
+    void HexAnalysis::Cancel()
+    {
+        cancelled_.store(true, std::memory_order_relaxed);
+        for (auto& worker : workers_) {
+            worker.join();
+        }
+        workers_.clear();
+        running_.store(false, std::memory_order_release);
+        pending_.reset();
+        file_.reset();
+    }
+
+    float HexAnalysis::GetProgress() const
+    {
+        uint64_t size = file_ ? file_->FileSize() : 0;
+        if (size == 0) return IsRunning() ? 0.0f : 1.0f;
+        return static_cast<float>(static_cast<double>(analysed_.load(std::memory_order_relaxed)) / size);
+    }
+
+    std::shared_ptr<const HexAnalysisResult> HexAnalysis::GetResult() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return result_;
+    }
+
+    void HexAnalysis::WorkerLoop()
+    {
+        HexAnalysisResult& pending = *pending_;
+        uint64_t size = file_->FileSize();
+        uint64_t blockSize = pending.blockSize;
+        std::array<uint64_t, 256> histogram = {};
+        uint64_t counts[256];
+
+        while (!cancelled_.load(std::memory_order_relaxed)) {
+            size_t chunk = nextChunk_.fetch_add(1, std::memory_order_relaxed);
+            if (chunk >= chunkCount_) break;
+
+            uint64_t firstBlock = chunk * chunkBlocks_;
+            uint64_t offset = firstBlock * blockSize;
+            size_t length = static_cast<size_t>(std::min(chunkBlocks_ * blockSize, size - offset));
+            auto view = file_->Map(offset, length);
+            if (!view) {
+                // Unreadable: no result rather than a wrong one
+                cancelled_.store(true, std::memory_order_relaxed);
+                break;
+            }
+
+            // Each block's entropy slot is written by this worker alone
+            for (uint64_t at = 0; at < length; at += blockSize) {
+                size_t bytes = static_cast<size_t>(std::min<uint64_t>(blockSize, length - at));
+                CountBytes(view->Data() + at, bytes, counts);
+                for (size_t b = 0; b < 256; b++) {
+                    histogram[b] += counts[b];
+                }
+                pending.blockEntropy[static_cast<size_t>(firstBlock + at / blockSize)] =
+                    static_cast<float>(EntropyOf(counts, bytes));
+                analysed_.fetch_add(bytes, std::memory_order_relaxed);
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t b = 0; b < 256; b++) {
+            pending.histogram[b] += histogram[b];
+        }
+
+        // The last worker out publishes, unless the analysis was stopped
+        if (active_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            if (!cancelled_.load(std::memory_order_relaxed)) {
+                ClassifyBytes(pending.histogram, size, pending.stats);
+                result_ = pending_;
+                OPACITY_LOG_DEBUG(Preview, "HexAnalysis: {} bytes, entropy {:.3f}", size, pending.stats.entropy);
+            }
+            running_.store(false, std::memory_order_release);
+        }
+    }
+
     // ============== HexPreviewHandler ==============
 
     HexPreviewHandler::HexPreviewHandler()
@@ -122,69 +457,21 @@ namespace opacity::preview
 
     HexPreviewData HexPreviewHandler::LoadPreview(
         const core::Path& path,
-        uint64_t offset,
-        size_t maxBytes,
         HexDisplayFormat format) const
     {
         HexPreviewData preview;
         preview.format = format;
-        preview.startOffset = offset;
 
-        std::filesystem::path fsPath = path.Get();
-        
-        std::ifstream file(fsPath, std::ios::binary);
-        if (!file.is_open()) {
+        auto file = std::make_shared<MappedFile>();
+        if (!file->Open(path.Get(), kMapOptions)) {
             preview.errorMessage = "Failed to open file";
             return preview;
         }
 
-        // Get file size
-        file.seekg(0, std::ios::end);
-        preview.totalSize = static_cast<size_t>(file.tellg());
-        
-        if (offset >= preview.totalSize) {
-            preview.errorMessage = "Offset beyond file size";
-            return preview;
-        }
-
-        file.seekg(offset);
-
-        // Read bytes
-        size_t bytesToRead = std::min(maxBytes, preview.totalSize - static_cast<size_t>(offset));
-        std::vector<uint8_t> buffer(bytesToRead);
-        file.read(reinterpret_cast<char*>(buffer.data()), bytesToRead);
-        size_t bytesRead = static_cast<size_t>(file.gcount());
-
-        if (bytesRead == 0) {
-            preview.errorMessage = "No bytes read";
-            return preview;
-        }
-
-        preview.endOffset = offset + bytesRead;
-
-        // Build hex lines
         int bytesPerRow = GetBytesPerRow(format);
-        uint64_t currentOffset = offset;
-
-        for (size_t i = 0; i < bytesRead; i += bytesPerRow) {
-            HexLine line;
-            line.offset = currentOffset;
-
-            size_t lineBytes = std::min(static_cast<size_t>(bytesPerRow), bytesRead - i);
-            line.bytes.assign(buffer.begin() + i, buffer.begin() + i + lineBytes);
-            line.hexString = BytesToHex(line.bytes);
-            line.asciiString = BytesToAscii(line.bytes);
-
-            // Pad if not full row
-            if (lineBytes < static_cast<size_t>(bytesPerRow)) {
-                size_t padding = bytesPerRow - lineBytes;
-                line.hexString += std::string(padding * 3, ' ');
-                line.asciiString += std::string(padding, ' ');
-            }
-
-            preview.lines.push_back(std::move(line));
-            currentOffset += bytesPerRow;
-        }
+        preview.totalSize = static_cast<size_t>(file->FileSize());
+        preview.rowCount = (file->FileSize() + bytesPerRow - 1) / bytesPerRow;
+        preview.file = std::move(file);
 
         // Get stats from first portion of file
         preview.stats = GetBinaryStats(path, 8192);
@@ -193,6 +480,39 @@ namespace opacity::preview
         return preview;
     }
 
+    bool HexPreviewHandler::FormatRow(const HexPreviewData& preview, uint64_t row, HexLine& line)
+    {
+        if (!preview.file) return false;
+
+        size_t bytesPerRow = static_cast<size_t>(GetBytesPerRow(preview.format));
+        uint64_t offset = row * bytesPerRow;
+        if (offset >= preview.file->FileSize()) return false;
+
+        size_t count = static_cast<size_t>(std::min<uint64_t>(bytesPerRow, preview.file->FileSize() - offset));
+        auto view = preview.file->Window(offset, count);
+        if (!view) return false;
+        const uint8_t* bytes = view->Data() + (offset - view->Offset());
+
+        line.offset = offset;
+        line.bytes.assign(bytes, bytes + count);
+        line.hexString.clear();
+        line.asciiString.clear();
+
+        // Padded to a full row, so columns line up on the last one
+        for (size_t i = 0; i < bytesPerRow; i++) {
+            if (i > 0) line.hexString += ' ';
+            if (i < count) {
+                line.hexString += kHexDigits[bytes[i] >> 4];
+                line.hexString += kHexDigits[bytes[i] & 0x0F];
+                line.asciiString += (bytes[i] >= 32 && bytes[i] < 127) ? static_cast<char>(bytes[i]) : '.';
+            } else {
+                line.hexString += "  ";
+                line.asciiString += ' ';
+            }
+        }
+        return true;
+    }
+
     BinaryStats HexPreviewHandler::GetBinaryStats(const core::Path& path, size_t sampleSize) const
     {
         BinaryStats stats;
@@ -218,28 +538,11 @@ namespace opacity::preview
         if (bytesRead == 0) return stats;
 
         // Analyze bytes
+        std::array<uint64_t, 256> histogram = {};
         for (size_t i = 0; i < bytesRead; i++) {
-            uint8_t b = buffer[i];
-            if (b == 0) {
-                stats.nullBytes++;
-            } else if (b >= 32 && b < 127) {
-                stats.printableBytes++;
-            } else if (b < 32) {
-                stats.controlBytes++;
-            } else {
-                stats.highBytes++;
-            }
+            histogram[buffer[i]]++;
         }
-
-        // Calculate entropy
-        stats.entropy = CalculateEntropy(buffer);
-
-        // Determine if text or binary
-        double printableRatio = static_cast<double>(stats.printableBytes) / bytesRead;
-        double nullRatio = static_cast<double>(stats.nullBytes) / bytesRead;
-
-        stats.isProbablyText = printableRatio > 0.85 && nullRatio < 0.01;
-        stats.isProbablyBinary = !stats.isProbablyText;
+        ClassifyBytes(histogram, bytesRead, stats);
 
         // Detect magic signature
         stats.detectedType = impl_->DetectMagic(buffer);
@@ -256,47 +559,66 @@ namespace opacity::preview
         const core::Path& path,
         const std::vector<uint8_t>& pattern,
         uint64_t startOffset) const
+    {
+        MappedFile file;
+        if (!file.Open(path.Get(), kMapOptions)) return -1;
+        return SearchBytes(file, pattern, true, startOffset);
+    }
+
+    int64_t HexPreviewHandler::SearchBytes(
+        const MappedFile& file,
+        const std::vector<uint8_t>& pattern,
+        bool caseSensitive,
+        uint64_t startOffset,
+        HexSearchProgress* progress)
     {
         if (pattern.empty()) return -1;
 
-        std::filesystem::path fsPath = path.Get();
-        std::ifstream file(fsPath, std::ios::binary);
-        if (!file.is_open()) return -1;
-
-        file.seekg(startOffset);
-
-        const size_t bufferSize = 65536;
-        std::vector<uint8_t> buffer(bufferSize + pattern.size() - 1);
-        uint64_t currentOffset = startOffset;
-
-        while (file) {
-            file.read(reinterpret_cast<char*>(buffer.data()), bufferSize);
-            size_t bytesRead = static_cast<size_t>(file.gcount());
-            if (bytesRead == 0) break;
-
-            // Search in buffer
-            for (size_t i = 0; i <= bytesRead - pattern.size(); i++) {
-                bool match = true;
-                for (size_t j = 0; j < pattern.size(); j++) {
-                    if (buffer[i + j] != pattern[j]) {
-                        match = false;
-                        break;
-                    }
-                }
-                if (match) {
-                    return currentOffset + i;
-                }
+        uint64_t size = file.FileSize();
+        if (progress) {
+            progress->total.store(size > startOffset ? size - startOffset : 0, std::memory_order_relaxed);
+            progress->scanned.store(0, std::memory_order_relaxed);
+        }
+
+        bool foldCase = !caseSensitive;
+        std::vector<uint8_t> needle = pattern;
+        if (foldCase) {
+            std::transform(needle.begin(), needle.end(), needle.begin(),
+                [](uint8_t b) { return static_cast<uint8_t>(std::tolower(b)); });
+        }
+
+        size_t anchor = 0;
+        for (size_t i = 1; i < needle.size(); i++) {
+            if (Commonness(needle[i], foldCase) < Commonness(needle[anchor], foldCase)) {
+                anchor = i;
             }
+        }
 
-            // Overlap for patterns spanning buffers
-            if (bytesRead == bufferSize) {
-                file.seekg(-static_cast<std::streamoff>(pattern.size() - 1), std::ios::cur);
-                currentOffset += bufferSize - (pattern.size() - 1);
-            } else {
-                break;
+        // Chunks overlap by one byte less than the pattern, so a match
+        // across a boundary is found in the later one
+        uint64_t offset = startOffset;
+        while (offset + needle.size() <= size) {
+            if (progress && progress->cancelled.load(std::memory_order_relaxed)) return -1;
+
+            size_t length = static_cast<size_t>(std::min<uint64_t>(kSearchChunk + needle.size() - 1, size - offset));
+            auto view = file.Map(offset, length);
+            if (!view) return -1;
+
+            int64_t found = FindIn(view->Data(), view->Size(), needle, anchor, foldCase);
+            if (found >= 0) {
+                return static_cast<int64_t>(offset) + found;
+            }
+
+            if (offset + length >= size) break;
+            offset += length - (needle.size() - 1);
+            if (progress) {
+                progress->scanned.store(offset - startOffset, std::memory_order_relaxed);
             }
         }
 
+        if (progress) {
+            progress->scanned.store(progress->total.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
         return -1;
     }
 
@@ -306,15 +628,11 @@ namespace opacity::preview
         bool caseSensitive,
         uint64_t startOffset) const
     {
-        std::vector<uint8_t> bytes(pattern.begin(), pattern.end());
-        
-        if (!caseSensitive) {
-            // For case-insensitive, we'd need a more complex algorithm
-            // For now, just search for lowercase version
-            std::transform(bytes.begin(), bytes.end(), bytes.begin(), ::tolower);
-        }
+        MappedFile file;
+        if (!file.Open(path.Get(), kMapOptions)) return -1;
 
-        return SearchBytes(path, bytes, startOffset);
+        std::vector<uint8_t> bytes(pattern.begin(), pattern.end());
+        return SearchBytes(file, bytes, caseSensitive, startOffset);
     }
 
     std::string HexPreviewHandler::DetectFileType(const core::Path& path) const
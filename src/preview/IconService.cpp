@@ -0,0 +1,430 @@
+#include "opacity/preview/IconService.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/filesystem/CloudIntegration.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <ShlObj.h>
+#include <shellapi.h>
+#include <CommCtrl.h>
+#include <commoncontrols.h>
+
+#include <algorithm>
+#include <cctype>
+#include <vector>
+
+namespace opacity::preview
+{
+
+namespace
+{
+    // Enough for every file icon of a few large folders
+    constexpr size_t kMaxFileIcons = 4096;
+
+    // Requests past this many are the oldest
+    constexpr size_t kMaxQueued = 1024;
+
+    // Only extractions wait on the user, and not for long; type icons are
+    // quick and every row is waiting on them
+    constexpr std::chrono::milliseconds kInputGrace{150};
+    constexpr std::chrono::milliseconds kMaxPause{500};
+
+    constexpr uint32_t kDirectoryAttribute = FILE_ATTRIBUTE_DIRECTORY;
+    constexpr uint32_t kReparseAttribute = FILE_ATTRIBUTE_REPARSE_POINT;
+
+    std::string LowerExtension(const core::Path& path)
+    {
+        std::string ext = path.Extension();
+        if (!ext.empty() && ext[0] == '.')
+        {
+            ext = ext.substr(1);
+        }
+        std::transform(ext.begin(), ext.end(), ext.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext;
+    }
+
+    // Types whose files each carry an icon of their own
+    bool HasOwnIcon(const std::string& ext)
+    {
+        return ext == "exe" || ext == "lnk" || ext == "ico";
+    }
+
+    int ImageListFor(IconSize size)
+    {
+        switch (size)
+        {
+        case IconSize::Small: return SHIL_SMALL;
+        case IconSize::Large: return SHIL_LARGE;
+        case IconSize::ExtraLarge: return SHIL_EXTRALARGE;
+        case IconSize::Jumbo: return SHIL_JUMBO;
+        }
+        return SHIL_SMALL;
+    }
+
+    // RGBA from an icon's colour bitmap; icons drawn before alpha channels
+    // take their transparency from the mask
+    bool IconPixels(HICON icon, std::vector<uint8_t>& pixels, int& width, int& height)
+    {
+        ICONINFO info = {};
+        if (!GetIconInfo(icon, &info))
+            return false;
+
+        BITMAP bitmap = {};
+        bool ok = info.hbmColor && GetObjectW(info.hbmColor, sizeof(bitmap), &bitmap) != 0 &&
+                  bitmap.bmWidth > 0 && bitmap.bmHeight > 0;
+        if (ok)
+        {
+            width = bitmap.bmWidth;
+            height = bitmap.bmHeight;
+
+            BITMAPINFO format = {};
+            format.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+            format.bmiHeader.biWidth = width;
+            format.bmiHeader.biHeight = -height;        // Top-down
+            format.bmiHeader.biPlanes = 1;
+            format.bmiHeader.biBitCount = 32;
+            format.bmiHeader.biCompression = BI_RGB;
+
+            size_t count = static_cast<size_t>(width) * height;
+            pixels.resize(count * 4);
+            HDC dc = GetDC(nullptr);
+            ok = GetDIBits(dc, info.hbmColor, 0, static_cast<UINT>(height), pixels.data(), &format,
+                           DIB_RGB_COLORS) == height;
+
+            bool has_alpha = false;
+            for (size_t i = 0; ok && i < count && !has_alpha; ++i)
+            {
+                has_alpha = pixels[i * 4 + 3] != 0;
+            }
+            if (ok && !has_alpha && info.hbmMask)
+            {
+                std::vector<uint8_t> mask(pixels.size());
+                ok = GetDIBits(dc, info.hbmMask, 0, static_cast<UINT>(height), mask.data(), &format,
+                               DIB_RGB_COLORS) == height;
+                for (size_t i = 0; ok && i < count; ++i)
+                {
+                    pixels[i * 4 + 3] = mask[i * 4] ? 0 : 255;
+                }
+            }
+            ReleaseDC(nullptr, dc);
+
+            // BGRA to RGBA
+            for (size_t i = 0; ok && i < count; ++i)
+            {
+                std::swap(pixels[i * 4], pixels[i * 4 + 2]);
+            }
+        }
+
+        if (info.hbmColor)
+            DeleteObject(info.hbmColor);
+        if (info.hbmMask)
+            DeleteObject(info.hbmMask);
+        return ok;
+    }
+}
+
+IconService::IconService() = default;
+
+IconService::~IconService()
+{
+    Shutdown();
+}
+
+void IconService::Initialize(TextureManager* textures)
+{
+    if (worker_.joinable() || stop_)
+        return;
+
+    textures_ = textures;
+    worker_ = std::thread(&IconService::WorkerLoop, this);
+    core::Logger::Get()->debug("IconService initialized");
+}
+
+void IconService::Shutdown()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    if (worker_.joinable())
+        worker_.join();
+
+    Clear();
+    queued_.clear();
+}
+
+IconSize IconService::SizeFor(float pixels)
+{
+    if (pixels <= 16.0f)
+        return IconSize::Small;
+    if (pixels <= 32.0f)
+        return IconSize::Large;
+    if (pixels <= 48.0f)
+        return IconSize::ExtraLarge;
+    return IconSize::Jumbo;
+}
+
+IconPtr IconService::Get(const core::Path& path, uint32_t attributes, std::chrono::system_clock::time_point modified,
+                         IconSize size)
+{
+    bool directory = (attributes & kDirectoryAttribute) != 0;
+    std::string ext = directory ? std::string() : LowerExtension(path);
+    bool per_file = !directory && HasOwnIcon(ext);
+
+    // A type icon depends on nothing else; a file's own on which file and
+    // which version
+    std::string key;
+    if (per_file)
+        key = path.String() + '|' + std::to_string(modified.time_since_epoch().count());
+    else
+        key = directory ? std::string("<folder>") : '.' + ext;
+    key += '|';
+    key += static_cast<char>('0' + static_cast<int>(size));
+    if (attributes & kReparseAttribute)
+        key += 'l';
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (per_file)
+    {
+        auto it = file_index_.find(key);
+        if (it != file_index_.end())
+        {
+            const TexturePtr& texture = it->second->icon->texture;
+            if (!texture || !texture->IsEvicted())
+            {
+                if (texture && textures_)
+                    textures_->Touch(*texture);
+                file_icons_.splice(file_icons_.begin(), file_icons_, it->second);
+                return it->second->icon;
+            }
+
+            // Lost its atlas cell; extracted again in a frame or two
+            file_icons_.erase(it->second);
+            file_index_.erase(it);
+        }
+    }
+    else
+    {
+        auto it = type_icons_.find(key);
+        if (it != type_icons_.end())
+        {
+            const TexturePtr& texture = it->second->texture;
+            if (!texture || !texture->IsEvicted())
+            {
+                if (texture && textures_)
+                    textures_->Touch(*texture);
+                return it->second;
+            }
+            type_icons_.erase(it);
+        }
+    }
+
+    auto queued = queued_.find(key);
+    if (queued != queued_.end())
+    {
+        if (queued->second != queue_.end())
+            queued->second->frame = frame_;
+        return nullptr;
+    }
+    if (!worker_.joinable() || stop_)
+        return nullptr;
+
+    queue_.push_front(Job{key, path, attributes, size, per_file, frame_});
+    queued_.emplace(std::move(key), queue_.begin());
+    if (queue_.size() > kMaxQueued)
+    {
+        queued_.erase(queue_.back().key);
+        queue_.pop_back();
+    }
+    wake_.notify_one();
+    return nullptr;
+}
+
+void IconService::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = queue_.begin(); it != queue_.end();)
+    {
+        if (it->frame < frame_)
+        {
+            queued_.erase(it->key);
+            it = queue_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    ++frame_;
+}
+
+void IconService::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& job : queue_)
+    {
+        queued_.erase(job.key);
+    }
+    queue_.clear();
+    type_icons_.clear();
+    file_icons_.clear();
+    file_index_.clear();
+    images_.clear();
+}
+
+size_t IconService::GetQueuedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_.size();
+}
+
+void IconService::WorkerLoop()
+{
+    core::Profiler::SetThreadName("Icons");
+    core::BackgroundPolicy policy;
+    policy.input_grace = kInputGrace;
+    policy.max_pause = kMaxPause;
+    core::BackgroundScope background(policy);
+
+    // Icon and overlay handlers are apartment-threaded shell extensions
+    HRESULT co = CoInitializeEx(nullptr, COINIT_APARTMENTTHREADED | COINIT_DISABLE_OLE1DDE);
+
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_)
+                break;
+
+            // Type icons first, as each covers many rows; the newest first
+            // otherwise
+            auto next = std::find_if(queue_.begin(), queue_.end(), [](const Job& queued) { return !queued.per_file; });
+            if (next == queue_.end())
+                next = queue_.begin();
+            job = std::move(*next);
+            queue_.erase(next);
+            queued_[job.key] = queue_.end();
+        }
+
+        if (job.per_file)
+            background.Yield();
+        IconPtr icon = Resolve(job);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queued_.erase(job.key) > 0)
+        {
+            StoreLocked(job.key, icon, job.per_file);
+        }
+    }
+
+    if (SUCCEEDED(co))
+        CoUninitialize();
+}
+
+IconPtr IconService::Resolve(const Job& job)
+{
+    OPACITY_PROFILE_ZONE("IconService::Resolve");
+    SHFILEINFOW info = {};
+    int overlay = 0;
+    bool found = false;
+
+    // A file's own icon means reading it, so not from a placeholder
+    if (job.per_file && !filesystem::CloudIntegration::ShouldSkipRead(job.attributes))
+    {
+        // The overlay index comes only with an icon handle, unused here
+        UINT flags = SHGFI_SYSICONINDEX | SHGFI_ICON | SHGFI_OVERLAYINDEX;
+        if (SHGetFileInfoW(job.path.WString().c_str(), 0, &info, sizeof(info), flags) != 0)
+        {
+            found = true;
+            overlay = (info.iIcon >> 24) & 0xFF;
+            if (info.hIcon)
+                DestroyIcon(info.hIcon);
+        }
+    }
+
+    if (!found)
+    {
+        // By type alone: a made-up name, with nothing read from disk
+        bool directory = (job.attributes & kDirectoryAttribute) != 0;
+        std::wstring name = directory ? L"folder" : L"file" + job.path.Get().extension().wstring();
+        DWORD attributes = directory ? FILE_ATTRIBUTE_DIRECTORY : FILE_ATTRIBUTE_NORMAL;
+        UINT flags = SHGFI_SYSICONINDEX | SHGFI_USEFILEATTRIBUTES;
+        if (SHGetFileInfoW(name.c_str(), attributes, &info, sizeof(info), flags) == 0)
+            return std::make_shared<const Icon>();
+    }
+
+    if (overlay == 0 && (job.attributes & kReparseAttribute))
+    {
+        int link = SHGetIconOverlayIndexW(nullptr, IDO_SHGIOI_LINK);
+        if (link > 0)
+            overlay = link;
+    }
+    return Extract(info.iIcon & 0x00FFFFFF, overlay, job.size);
+}
+
+IconPtr IconService::Extract(int image, int overlay, IconSize size)
+{
+    uint64_t key = (static_cast<uint64_t>(image) << 16) | (static_cast<uint64_t>(overlay) << 8) |
+                   static_cast<uint64_t>(size);
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        auto it = images_.find(key);
+        if (it != images_.end() && (!it->second->texture || !it->second->texture->IsEvicted()))
+            return it->second;
+    }
+
+    IImageList* list = nullptr;
+    HICON handle = nullptr;
+    HRESULT hr = SHGetImageList(ImageListFor(size), IID_PPV_ARGS(&list));
+    if (SUCCEEDED(hr))
+        hr = list->GetIcon(image, ILD_TRANSPARENT | INDEXTOOVERLAYMASK(overlay), &handle);
+    if (list)
+        list->Release();
+
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    bool ok = SUCCEEDED(hr) && handle && IconPixels(handle, pixels, width, height);
+    if (handle)
+        DestroyIcon(handle);
+
+    // Copied into an atlas page on the UI thread, a few per frame
+    auto icon = std::make_shared<Icon>();
+    if (ok && textures_)
+        icon->texture = textures_->Upload(std::move(pixels), width, height);
+    if (icon->texture)
+    {
+        icon->width = width;
+        icon->height = height;
+    }
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    images_[key] = icon;
+    return icon;
+}
+
+void IconService::StoreLocked(const std::string& key, const IconPtr& icon, bool per_file)
+{
+    if (!per_file)
+    {
+        type_icons_[key] = icon;
+        return;
+    }
+
+    file_icons_.push_front(MemoryEntry{key, icon});
+    file_index_[key] = file_icons_.begin();
+    while (file_icons_.size() > kMaxFileIcons)
+    {
+        file_index_.erase(file_icons_.back().key);
+        file_icons_.pop_back();
+    }
+}
+
+} // namespace opacity::preview
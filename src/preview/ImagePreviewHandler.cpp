@@ -1,8 +1,10 @@
 #include "opacity/preview/ImagePreviewHandler.h"
 #include "opacity/core/Logger.h"
+#include "opacity/filesystem/FileTypes.h"
 
 #define NOMINMAX
 #include <d3d11.h>
+#include <wincodec.h>
 
 // stb_image for image loading
 #define STB_IMAGE_IMPLEMENTATION
@@ -10,17 +12,158 @@
 #include <stb_image.h>
 
 #include <algorithm>
+#include <cstring>
 #include <fstream>
 
 namespace opacity::preview
 {
 
+namespace
+{
+    // Fit within max_dimension, keeping the aspect ratio; never enlarges
+    void FitWithin(int width, int height, int max_dimension, int& fit_width, int& fit_height)
+    {
+        fit_width = width;
+        fit_height = height;
+        if (max_dimension > 0 && (width > max_dimension || height > max_dimension))
+        {
+            float scale = static_cast<float>(max_dimension) / static_cast<float>(std::max(width, height));
+            fit_width = std::max(1, static_cast<int>(width * scale));
+            fit_height = std::max(1, static_cast<int>(height * scale));
+        }
+    }
+
+    // Box filter: each target pixel averages the source pixels it covers
+    void Downsample(const uint8_t* source, int width, int height,
+                    int target_width, int target_height, std::vector<uint8_t>& target)
+    {
+        target.resize(static_cast<size_t>(target_width) * target_height * 4);
+        for (int y = 0; y < target_height; ++y)
+        {
+            int y0 = static_cast<int>(static_cast<int64_t>(y) * height / target_height);
+            int y1 = std::max(y0 + 1, static_cast<int>(static_cast<int64_t>(y + 1) * height / target_height));
+            for (int x = 0; x < target_width; ++x)
+            {
+                int x0 = static_cast<int>(static_cast<int64_t>(x) * width / target_width);
+                int x1 = std::max(x0 + 1, static_cast<int>(static_cast<int64_t>(x + 1) * width / target_width));
+
+                uint32_t sum[4] = {0, 0, 0, 0};
+                for (int sy = y0; sy < y1; ++sy)
+                {
+                    const uint8_t* row = source + (static_cast<size_t>(sy) * width + x0) * 4;
+                    for (int sx = x0; sx < x1; ++sx, row += 4)
+                    {
+                        sum[0] += row[0];
+                        sum[1] += row[1];
+                        sum[2] += row[2];
+                        sum[3] += row[3];
+                    }
+                }
+
+                uint32_t count = static_cast<uint32_t>((y1 - y0) * (x1 - x0));
+                uint8_t* out = target.data() + (static_cast<size_t>(y) * target_width + x) * 4;
+                for (int c = 0; c < 4; ++c)
+                {
+                    out[c] = static_cast<uint8_t>(sum[c] / count);
+                }
+            }
+        }
+    }
+
+    // WIC decoders feed the scaler row by row, so memory stays at the
+    // target size however large the file is. With contents, those are
+    // decoded instead of the file.
+    bool DecodeScaled(const core::Path& path, const std::vector<char>* contents, int max_dimension,
+                      ImagePreviewData& data)
+    {
+        HRESULT co = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+        bool uninitialize = SUCCEEDED(co);
+
+        IWICImagingFactory* factory = nullptr;
+        IWICStream* stream = nullptr;
+        IWICBitmapDecoder* decoder = nullptr;
+        IWICBitmapFrameDecode* frame = nullptr;
+        IWICBitmapScaler* scaler = nullptr;
+        IWICFormatConverter* converter = nullptr;
+
+        UINT width = 0;
+        UINT height = 0;
+        int target_width = 0;
+        int target_height = 0;
+
+        HRESULT hr = CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER,
+                                      IID_PPV_ARGS(&factory));
+        if (SUCCEEDED(hr) && contents)
+        {
+            hr = factory->CreateStream(&stream);
+            if (SUCCEEDED(hr))
+                hr = stream->InitializeFromMemory(
+                    reinterpret_cast<BYTE*>(const_cast<char*>(contents->data())), static_cast<DWORD>(contents->size()));
+            if (SUCCEEDED(hr))
+                hr = factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder);
+        }
+        else if (SUCCEEDED(hr))
+        {
+            hr = factory->CreateDecoderFromFilename(path.WString().c_str(), nullptr, GENERIC_READ,
+                                                    WICDecodeMetadataCacheOnDemand, &decoder);
+        }
+        if (SUCCEEDED(hr))
+            hr = decoder->GetFrame(0, &frame);
+        if (SUCCEEDED(hr))
+            hr = frame->GetSize(&width, &height);
+
+        IWICBitmapSource* source = frame;
+        if (SUCCEEDED(hr))
+        {
+            FitWithin(static_cast<int>(width), static_cast<int>(height), max_dimension, target_width, target_height);
+            if (target_width != static_cast<int>(width) || target_height != static_cast<int>(height))
+            {
+                hr = factory->CreateBitmapScaler(&scaler);
+                if (SUCCEEDED(hr))
+                    hr = scaler->Initialize(frame, target_width, target_height, WICBitmapInterpolationModeFant);
+                source = scaler;
+            }
+        }
+
+        if (SUCCEEDED(hr))
+            hr = factory->CreateFormatConverter(&converter);
+        if (SUCCEEDED(hr))
+            hr = converter->Initialize(source, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone,
+                                       nullptr, 0.0, WICBitmapPaletteTypeCustom);
+        if (SUCCEEDED(hr))
+        {
+            UINT stride = static_cast<UINT>(target_width) * 4;
+            data.pixels.resize(static_cast<size_t>(stride) * target_height);
+            hr = converter->CopyPixels(nullptr, stride, static_cast<UINT>(data.pixels.size()), data.pixels.data());
+        }
+
+        if (converter) converter->Release();
+        if (scaler) scaler->Release();
+        if (frame) frame->Release();
+        if (decoder) decoder->Release();
+        if (stream) stream->Release();
+        if (factory) factory->Release();
+        if (uninitialize)
+            CoUninitialize();
+
+        if (FAILED(hr))
+        {
+            data.pixels.clear();
+            return false;
+        }
+
+        data.info.width = static_cast<int>(width);
+        data.info.height = static_cast<int>(height);
+        data.width = target_width;
+        data.height = target_height;
+        return true;
+    }
+}
+
 ImagePreviewHandler::ImagePreviewHandler()
 {
-    // Initialize list of supported image extensions
-    supported_extensions_ = {
-        "png", "jpg", "jpeg", "bmp", "gif", "tga", "psd", "hdr", "pic", "pnm"
-    };
+    // The shared extension table says which formats the decoder takes
+    supported_extensions_ = filesystem::ExtensionsFor(filesystem::PreviewImage);
     
     core::Logger::Get()->debug("ImagePreviewHandler initialized with {} supported extensions", 
                                supported_extensions_.size());
@@ -38,15 +181,8 @@ void ImagePreviewHandler::Initialize(ID3D11Device* device)
 
 bool ImagePreviewHandler::CanHandle(const core::Path& path, const std::string& extension) const
 {
-    if (extension.empty())
-        return false;
-
-    std::string lower_ext = extension;
-    std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(),
-        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-
-    return std::find(supported_extensions_.begin(), supported_extensions_.end(), lower_ext) 
-           != supported_extensions_.end();
+    const filesystem::ExtensionInfo* info = filesystem::LookupExtension(extension);
+    return info && (info->preview_handlers & filesystem::PreviewImage);
 }
 
 ImageInfo ImagePreviewHandler::GetImageInfo(const core::Path& path) const
@@ -96,52 +232,90 @@ ImageInfo ImagePreviewHandler::GetImageInfo(const core::Path& path) const
 ImagePreviewData ImagePreviewHandler::LoadPreview(
     const core::Path& path,
     int max_dimension) const
+{
+    return LoadFrom(path, nullptr, max_dimension);
+}
+
+ImagePreviewData ImagePreviewHandler::LoadPreview(
+    const core::Path& path,
+    const std::vector<char>& contents,
+    int max_dimension) const
+{
+    return LoadFrom(path, &contents, max_dimension);
+}
+
+ImagePreviewData ImagePreviewHandler::LoadFrom(
+    const core::Path& path,
+    const std::vector<char>* contents,
+    int max_dimension) const
 {
     ImagePreviewData data;
 
-    // Load image using stb_image
-    int width, height, channels;
-    unsigned char* pixels = stbi_load(path.String().c_str(), &width, &height, &channels, 4);  // Force RGBA
-    
-    if (!pixels)
+    const auto* bytes = contents ? reinterpret_cast<const stbi_uc*>(contents->data()) : nullptr;
+    int length = contents ? static_cast<int>(contents->size()) : 0;
+
+    if (!DecodeScaled(path, contents, max_dimension, data))
     {
-        data.error_message = std::string("Failed to load image: ") + stbi_failure_reason();
-        return data;
+        // Formats WIC has no codec for (TGA, PSD, HDR, ...)
+        int width, height, channels;
+        unsigned char* pixels = contents
+            ? stbi_load_from_memory(bytes, length, &width, &height, &channels, 4)
+            : stbi_load(path.String().c_str(), &width, &height, &channels, 4);  // Force RGBA
+
+        if (!pixels)
+        {
+            data.error_message = std::string("Failed to load image: ") + stbi_failure_reason();
+            return data;
+        }
+
+        data.info.width = width;
+        data.info.height = height;
+        data.info.channels = channels;
+
+        FitWithin(width, height, max_dimension, data.width, data.height);
+        if (data.width != width || data.height != height)
+        {
+            Downsample(pixels, width, height, data.width, data.height, data.pixels);
+        }
+        else
+        {
+            data.pixels.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+        }
+        stbi_image_free(pixels);
     }
-
-    data.info.width = width;
-    data.info.height = height;
-    data.info.channels = channels;
-
-    // Resize if needed
-    int display_width = width;
-    int display_height = height;
-    
-    if (max_dimension > 0 && (width > max_dimension || height > max_dimension))
+    else
     {
-        float scale = static_cast<float>(max_dimension) / static_cast<float>(std::max(width, height));
-        display_width = static_cast<int>(width * scale);
-        display_height = static_cast<int>(height * scale);
+        // WIC converted to RGBA; the header still says what the file holds
+        int width, height, channels;
+        bool known = contents ? stbi_info_from_memory(bytes, length, &width, &height, &channels)
+                              : stbi_info(path.String().c_str(), &width, &height, &channels);
+        data.info.channels = known ? channels : 4;
     }
 
-    // Store pixel data
-    size_t data_size = static_cast<size_t>(width) * height * 4;
-    data.pixels.resize(data_size);
-    std::memcpy(data.pixels.data(), pixels, data_size);
-
-    // Create D3D11 texture if device is available
+    // Create D3D11 texture if device is available; the pixels are then
+    // only needed by whoever has no device
     if (device_)
     {
-        data.texture = CreateTexture(pixels, width, height);
+        data.texture = CreateTexture(device_, data.pixels.data(), data.width, data.height);
+        if (data.texture)
+        {
+            data.pixels.clear();
+            data.pixels.shrink_to_fit();
+        }
     }
 
-    stbi_image_free(pixels);
-
     // Get additional info
-    std::ifstream file(path.String(), std::ios::binary | std::ios::ate);
-    if (file.is_open())
+    if (contents)
+    {
+        data.info.file_size = contents->size();
+    }
+    else
     {
-        data.info.file_size = static_cast<size_t>(file.tellg());
+        std::ifstream file(path.String(), std::ios::binary | std::ios::ate);
+        if (file.is_open())
+        {
+            data.info.file_size = static_cast<size_t>(file.tellg());
+        }
     }
 
     data.loaded = true;
@@ -165,11 +339,12 @@ std::vector<std::string> ImagePreviewHandler::GetSupportedExtensions() const
 }
 
 ID3D11ShaderResourceView* ImagePreviewHandler::CreateTexture(
+    ID3D11Device* device,
     const uint8_t* pixels,
     int width,
-    int height) const
+    int height)
 {
-    if (!device_ || !pixels)
+    if (!device || !pixels)
         return nullptr;
 
     // Create texture
@@ -188,7 +363,7 @@ ID3D11ShaderResourceView* ImagePreviewHandler::CreateTexture(
     init_data.SysMemPitch = width * 4;
 
     ID3D11Texture2D* texture = nullptr;
-    HRESULT hr = device_->CreateTexture2D(&desc, &init_data, &texture);
+    HRESULT hr = device->CreateTexture2D(&desc, &init_data, &texture);
     if (FAILED(hr))
     {
         core::Logger::Get()->warn("Failed to create texture2D: {}", hr);
@@ -202,7 +377,7 @@ ID3D11ShaderResourceView* ImagePreviewHandler::CreateTexture(
     srv_desc.Texture2D.MipLevels = 1;
 
     ID3D11ShaderResourceView* srv = nullptr;
-    hr = device_->CreateShaderResourceView(texture, &srv_desc, &srv);
+    hr = device->CreateShaderResourceView(texture, &srv_desc, &srv);
     texture->Release();
 
     if (FAILED(hr))
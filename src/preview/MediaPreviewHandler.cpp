@@ -1,10 +1,20 @@
 #include "opacity/preview/MediaPreviewHandler.h"
+#include "opacity/core/Hash.h"
 #include "opacity/core/Logger.h"
+#include "opacity/filesystem/FileTypes.h"
 
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <limits>
 #include <sstream>
 #include <iomanip>
-#include <unordered_set>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define OPACITY_WAVEFORM_SSE 1
+#include <emmintrin.h>
+#endif
 
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
@@ -14,6 +24,7 @@
 #include <mfidl.h>
 #include <mfreadwrite.h>
 #include <propvarutil.h>
+#include <shlobj.h>
 #include <d3d11.h>
 #pragma comment(lib, "mfplat.lib")
 #pragma comment(lib, "mfreadwrite.lib")
@@ -25,30 +36,178 @@ namespace opacity::preview
 {
     using namespace opacity::core;
 
+    namespace
+    {
+        constexpr char kPeakMagic[4] = {'O', 'P', 'K', 'S'};
+        constexpr uint32_t kPeakVersion = 1;
+
+        // Written as is; the cache is per machine
+        struct PeakFileHeader
+        {
+            char magic[4];
+            uint32_t version;
+            uint32_t bucketsPerSecond;
+            uint32_t sampleRate;
+            uint32_t channels;
+            uint32_t reserved;
+            int64_t durationMs;
+            uint64_t buckets;
+        };
+
+        /**
+         * @brief Widen lo and hi to cover count samples
+         *
+         * Decoded float audio is reduced here a buffer at a time, so this is
+         * the whole cost of a waveform besides the decoder itself.
+         */
+        void MinMax(const float* samples, size_t count, float& lo, float& hi)
+        {
+            size_t i = 0;
+#ifdef OPACITY_WAVEFORM_SSE
+            if (count >= 16) {
+                // Two accumulators each, so the loads are not waiting on one chain
+                __m128 lo0 = _mm_set1_ps(lo), lo1 = lo0;
+                __m128 hi0 = _mm_set1_ps(hi), hi1 = hi0;
+                for (; i + 8 <= count; i += 8) {
+                    __m128 a = _mm_loadu_ps(samples + i);
+                    __m128 b = _mm_loadu_ps(samples + i + 4);
+                    lo0 = _mm_min_ps(lo0, a);
+                    hi0 = _mm_max_ps(hi0, a);
+                    lo1 = _mm_min_ps(lo1, b);
+                    hi1 = _mm_max_ps(hi1, b);
+                }
+                lo0 = _mm_min_ps(lo0, lo1);
+                hi0 = _mm_max_ps(hi0, hi1);
+                lo0 = _mm_min_ps(lo0, _mm_shuffle_ps(lo0, lo0, _MM_SHUFFLE(1, 0, 3, 2)));
+                hi0 = _mm_max_ps(hi0, _mm_shuffle_ps(hi0, hi0, _MM_SHUFFLE(1, 0, 3, 2)));
+                lo0 = _mm_min_ss(lo0, _mm_shuffle_ps(lo0, lo0, _MM_SHUFFLE(2, 3, 0, 1)));
+                hi0 = _mm_max_ss(hi0, _mm_shuffle_ps(hi0, hi0, _MM_SHUFFLE(2, 3, 0, 1)));
+                lo = _mm_cvtss_f32(lo0);
+                hi = _mm_cvtss_f32(hi0);
+            }
+#endif
+            for (; i < count; i++) {
+                lo = std::min(lo, samples[i]);
+                hi = std::max(hi, samples[i]);
+            }
+        }
+
+        /**
+         * @brief Folds interleaved samples into min/max pairs per bucket as
+         *        they are decoded
+         *
+         * Bucket b covers frames [b * rate / buckets, (b + 1) * rate / buckets),
+         * so buckets stay aligned to the track however the decoder splits it.
+         */
+        class PeakReducer
+        {
+        public:
+            PeakReducer(int sampleRate, int channels, int bucketsPerSecond, std::vector<float>& peaks)
+                : sampleRate_(static_cast<uint64_t>(sampleRate))
+                , channels_(static_cast<size_t>(channels))
+                , bucketsPerSecond_(static_cast<uint64_t>(std::min(bucketsPerSecond, sampleRate)))
+                , peaks_(peaks)
+            {
+                bucketEnd_ = BucketEnd(0);
+            }
+
+            void Add(const float* samples, size_t frames)
+            {
+                while (frames > 0) {
+                    size_t take = static_cast<size_t>(std::min<uint64_t>(frames, bucketEnd_ - frame_));
+                    MinMax(samples, take * channels_, lo_, hi_);
+                    samples += take * channels_;
+                    frames -= take;
+                    frame_ += take;
+                    if (frame_ == bucketEnd_) {
+                        Close();
+                    }
+                }
+            }
+
+            void Finish()
+            {
+                if (lo_ <= hi_) {
+                    Close();
+                }
+            }
+
+        private:
+            uint64_t BucketEnd(uint64_t bucket) const
+            {
+                return (bucket + 1) * sampleRate_ / bucketsPerSecond_;
+            }
+
+            void Close()
+            {
+                peaks_.push_back(std::clamp(lo_, -1.0f, 1.0f));
+                peaks_.push_back(std::clamp(hi_, -1.0f, 1.0f));
+                lo_ = std::numeric_limits<float>::infinity();
+                hi_ = -std::numeric_limits<float>::infinity();
+                bucketEnd_ = BucketEnd(++bucket_);
+            }
+
+            uint64_t sampleRate_;
+            size_t channels_;
+            uint64_t bucketsPerSecond_;
+            std::vector<float>& peaks_;
+            uint64_t frame_ = 0;
+            uint64_t bucket_ = 0;
+            uint64_t bucketEnd_ = 0;
+            float lo_ = std::numeric_limits<float>::infinity();
+            float hi_ = -std::numeric_limits<float>::infinity();
+        };
+    }
+
+    // ============== AudioWaveform ==============
+
+    std::vector<float> AudioWaveform::GetStrip(size_t columns) const
+    {
+        std::vector<float> strip;
+        size_t buckets = GetBucketCount();
+        if (columns == 0 || buckets == 0) return strip;
+
+        strip.resize(columns * 2);
+        for (size_t column = 0; column < columns; column++) {
+            size_t begin = column * buckets / columns;
+            size_t end = std::max((column + 1) * buckets / columns, begin + 1);
+            float lo = peaks[begin * 2];
+            float hi = peaks[begin * 2 + 1];
+            for (size_t bucket = begin + 1; bucket < end && bucket < buckets; bucket++) {
+                lo = std::min(lo, peaks[bucket * 2]);
+                hi = std::max(hi, peaks[bucket * 2 + 1]);
+            }
+            strip[column * 2] = lo;
+            strip[column * 2 + 1] = hi;
+        }
+        return strip;
+    }
+
     class MediaPreviewHandler::Impl
     {
     public:
         ID3D11Device* device_ = nullptr;
         bool mfInitialized_ = false;
-
-        std::unordered_set<std::string> videoExtensions_;
-        std::unordered_set<std::string> audioExtensions_;
+        std::filesystem::path peakDirectory_;
+#ifdef _WIN32
+        IMFDXGIDeviceManager* deviceManager_ = nullptr;     // Shares device_ with hardware decoders
+#endif
 
         Impl()
         {
-            // Supported video extensions
-            videoExtensions_ = {
-                "mp4", "mkv", "avi", "mov", "wmv", "flv", "webm",
-                "m4v", "mpeg", "mpg", "3gp", "3g2", "ts", "mts",
-                "m2ts", "vob", "ogv", "divx", "xvid", "asf"
-            };
-
-            // Supported audio extensions
-            audioExtensions_ = {
-                "mp3", "wav", "flac", "aac", "ogg", "wma", "m4a",
-                "opus", "aiff", "ape", "alac", "mid", "midi", "ac3",
-                "dts", "mka", "ra", "ram"
-            };
+            std::filesystem::path base;
+#ifdef _WIN32
+            PWSTR localAppData = nullptr;
+            if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &localAppData)) && localAppData) {
+                base = localAppData;
+            }
+            CoTaskMemFree(localAppData);
+#endif
+            if (base.empty()) {
+                std::error_code ec;
+                base = std::filesystem::temp_directory_path(ec);
+            }
+            peakDirectory_ = base / "Opacity" / "Peaks";
         }
 
         ~Impl()
@@ -69,6 +228,19 @@ namespace opacity::preview
                     return false;
                 }
             }
+
+            if (device_ && !deviceManager_) {
+                UINT resetToken = 0;
+                IMFDXGIDeviceManager* manager = nullptr;
+                if (SUCCEEDED(MFCreateDXGIDeviceManager(&resetToken, &manager))) {
+                    if (SUCCEEDED(manager->ResetDevice(device_, resetToken))) {
+                        deviceManager_ = manager;
+                    } else {
+                        Logger::Get()->warn("MediaPreviewHandler: Device cannot decode video; thumbnails use software");
+                        manager->Release();
+                    }
+                }
+            }
 #endif
             return true;
         }
@@ -76,6 +248,10 @@ namespace opacity::preview
         void Shutdown()
         {
 #ifdef _WIN32
+            if (deviceManager_) {
+                deviceManager_->Release();
+                deviceManager_ = nullptr;
+            }
             if (mfInitialized_) {
                 MFShutdown();
                 mfInitialized_ = false;
@@ -83,7 +259,225 @@ namespace opacity::preview
 #endif
         }
 
+        /**
+         * @brief Peak file for this version of the file at this resolution;
+         *        empty if the file cannot be read
+         *
+         * An edited file hashes to a new name, so a stale peak file is
+         * never read, only left behind.
+         */
+        std::filesystem::path PeakFilePath(const std::filesystem::path& path, int bucketsPerSecond) const
+        {
+            std::error_code ec;
+            uint64_t size = std::filesystem::file_size(path, ec);
+            if (ec) return {};
+            auto modified = std::filesystem::last_write_time(path, ec);
+            if (ec) return {};
+
+            std::string name = path.u8string();
+            int64_t ticks = modified.time_since_epoch().count();
+            uint32_t rate = static_cast<uint32_t>(bucketsPerSecond);
+
+            Xxh64 hash;
+            hash.Update(name.data(), name.size());
+            hash.Update(&size, sizeof(size));
+            hash.Update(&ticks, sizeof(ticks));
+            hash.Update(&rate, sizeof(rate));
+            return peakDirectory_ / (hash.HexDigest() + ".peaks");
+        }
+
+        bool ReadPeaks(const std::filesystem::path& file, AudioWaveform& waveform) const
+        {
+            std::ifstream in(file, std::ios::binary);
+            if (!in) return false;
+
+            PeakFileHeader header = {};
+            if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+                std::memcmp(header.magic, kPeakMagic, sizeof(kPeakMagic)) != 0 ||
+                header.version != kPeakVersion || header.bucketsPerSecond == 0) {
+                return false;
+            }
+
+            // A torn write would have been renamed into place only whole,
+            // but guard the length before trusting it
+            std::error_code ec;
+            uint64_t fileSize = std::filesystem::file_size(file, ec);
+            if (ec || header.buckets > (fileSize - sizeof(header)) / (2 * sizeof(float))) {
+                return false;
+            }
+
+            std::vector<float> peaks(static_cast<size_t>(header.buckets) * 2);
+            if (!in.read(reinterpret_cast<char*>(peaks.data()), peaks.size() * sizeof(float))) {
+                return false;
+            }
+
+            waveform.peaks = std::move(peaks);
+            waveform.bucketsPerSecond = static_cast<int>(header.bucketsPerSecond);
+            waveform.sampleRate = static_cast<int>(header.sampleRate);
+            waveform.channels = static_cast<int>(header.channels);
+            waveform.duration = std::chrono::milliseconds(header.durationMs);
+            return true;
+        }
+
+        void WritePeaks(const std::filesystem::path& file, const AudioWaveform& waveform) const
+        {
+            std::error_code ec;
+            std::filesystem::create_directories(file.parent_path(), ec);
+
+            // Written beside it and renamed into place, so a reader never
+            // sees half a file
+            std::filesystem::path temp = file;
+            temp += ".tmp";
+            {
+                std::ofstream out(temp, std::ios::binary | std::ios::trunc);
+                if (!out) {
+                    Logger::Get()->warn("MediaPreviewHandler: Cannot write peak file {}", temp.string());
+                    return;
+                }
+
+                PeakFileHeader header = {};
+                std::memcpy(header.magic, kPeakMagic, sizeof(kPeakMagic));
+                header.version = kPeakVersion;
+                header.bucketsPerSecond = static_cast<uint32_t>(waveform.bucketsPerSecond);
+                header.sampleRate = static_cast<uint32_t>(waveform.sampleRate);
+                header.channels = static_cast<uint32_t>(waveform.channels);
+                header.durationMs = waveform.duration.count();
+                header.buckets = waveform.GetBucketCount();
+                out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+                out.write(reinterpret_cast<const char*>(waveform.peaks.data()), waveform.peaks.size() * sizeof(float));
+                if (!out) {
+                    out.close();
+                    std::filesystem::remove(temp, ec);
+                    return;
+                }
+            }
+
+            std::filesystem::rename(temp, file, ec);
+            if (ec) {
+                Logger::Get()->warn("MediaPreviewHandler: Cannot replace peak file {}: {}", file.string(), ec.message());
+                std::filesystem::remove(temp, ec);
+            }
+        }
+
 #ifdef _WIN32
+        /**
+         * @brief Decode the first audio stream as float samples, reducing
+         *        each buffer into buckets as it arrives
+         */
+        bool DecodeWaveform(const std::filesystem::path& path, int bucketsPerSecond,
+                            WaveformProgress* progress, AudioWaveform& waveform) const
+        {
+            if (!mfInitialized_) return false;
+
+            IMFSourceReader* pReader = nullptr;
+            HRESULT hr = MFCreateSourceReaderFromURL(path.wstring().c_str(), nullptr, &pReader);
+            if (FAILED(hr) || !pReader) {
+                return false;
+            }
+
+            // Only audio; a video's frames would otherwise be decoded too
+            pReader->SetStreamSelection(MF_SOURCE_READER_ALL_STREAMS, FALSE);
+            pReader->SetStreamSelection(MF_SOURCE_READER_FIRST_AUDIO_STREAM, TRUE);
+
+            IMFMediaType* pMediaType = nullptr;
+            hr = MFCreateMediaType(&pMediaType);
+            if (SUCCEEDED(hr)) {
+                pMediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Audio);
+                pMediaType->SetGUID(MF_MT_SUBTYPE, MFAudioFormat_Float);
+                hr = pReader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_AUDIO_STREAM, nullptr, pMediaType);
+                pMediaType->Release();
+            }
+
+            UINT32 channels = 0, sampleRate = 0;
+            IMFMediaType* pCurrentType = nullptr;
+            if (SUCCEEDED(hr)) {
+                hr = pReader->GetCurrentMediaType(MF_SOURCE_READER_FIRST_AUDIO_STREAM, &pCurrentType);
+            }
+            if (SUCCEEDED(hr)) {
+                pCurrentType->GetUINT32(MF_MT_AUDIO_NUM_CHANNELS, &channels);
+                pCurrentType->GetUINT32(MF_MT_AUDIO_SAMPLES_PER_SECOND, &sampleRate);
+                pCurrentType->Release();
+            }
+            if (FAILED(hr) || channels == 0 || sampleRate == 0) {
+                pReader->Release();
+                return false;
+            }
+
+            PROPVARIANT var;
+            PropVariantInit(&var);
+            int64_t duration100ns = 0;
+            if (SUCCEEDED(pReader->GetPresentationAttribute(MF_SOURCE_READER_MEDIASOURCE, MF_PD_DURATION, &var))) {
+                PropVariantToInt64(var, &duration100ns);
+            }
+            PropVariantClear(&var);
+
+            if (progress) {
+                progress->totalMs.store(duration100ns / 10000, std::memory_order_relaxed);
+            }
+
+            waveform.bucketsPerSecond = std::min(bucketsPerSecond, static_cast<int>(sampleRate));
+            waveform.sampleRate = static_cast<int>(sampleRate);
+            waveform.channels = static_cast<int>(channels);
+            waveform.peaks.clear();
+            if (duration100ns > 0) {
+                waveform.peaks.reserve(static_cast<size_t>(duration100ns / 10000000 + 1) * waveform.bucketsPerSecond * 2);
+            }
+
+            PeakReducer reducer(waveform.sampleRate, waveform.channels, waveform.bucketsPerSecond, waveform.peaks);
+            uint64_t frames = 0;
+            bool complete = false;
+
+            while (!(progress && progress->cancelled.load(std::memory_order_relaxed))) {
+                DWORD streamIndex = 0, flags = 0;
+                LONGLONG timestamp = 0;
+                IMFSample* pSample = nullptr;
+                hr = pReader->ReadSample(MF_SOURCE_READER_FIRST_AUDIO_STREAM, 0,
+                                         &streamIndex, &flags, &timestamp, &pSample);
+                if (FAILED(hr)) break;
+                if (flags & MF_SOURCE_READERF_ENDOFSTREAM) {
+                    if (pSample) pSample->Release();
+                    complete = true;
+                    break;
+                }
+                if (!pSample) continue;
+
+                IMFMediaBuffer* pBuffer = nullptr;
+                if (SUCCEEDED(pSample->ConvertToContiguousBuffer(&pBuffer)) && pBuffer) {
+                    BYTE* pData = nullptr;
+                    DWORD maxLength = 0, currentLength = 0;
+                    if (SUCCEEDED(pBuffer->Lock(&pData, &maxLength, &currentLength))) {
+                        size_t count = currentLength / (sizeof(float) * channels);
+                        reducer.Add(reinterpret_cast<const float*>(pData), count);
+                        frames += count;
+                        pBuffer->Unlock();
+                    }
+                    pBuffer->Release();
+                }
+                pSample->Release();
+
+                if (progress) {
+                    progress->decodedMs.store(timestamp / 10000, std::memory_order_relaxed);
+                }
+            }
+
+            pReader->Release();
+            if (!complete) {
+                if (FAILED(hr)) {
+                    Logger::Get()->warn("MediaPreviewHandler: Audio decode failed for {}: {:#x}",
+                                        path.string(), static_cast<uint32_t>(hr));
+                }
+                return false;
+            }
+
+            reducer.Finish();
+            waveform.duration = std::chrono::milliseconds(
+                duration100ns > 0 ? duration100ns / 10000 : static_cast<int64_t>(frames * 1000 / sampleRate));
+            if (progress) {
+                progress->decodedMs.store(waveform.duration.count(), std::memory_order_relaxed);
+            }
+            return true;
+        }
+
         MediaInfo ExtractMediaInfo(const std::filesystem::path& path) const
         {
             MediaInfo info;
@@ -363,6 +757,162 @@ namespace opacity::preview
             return thumb;
         }
 
+        /**
+         * @brief Decode the keyframe at or before every stride-th timestamp
+         *        from first, on one hardware reader
+         *
+         * The video processor converts and scales on the GPU, so only the
+         * small frame is copied, texture to texture.
+         */
+        void ExtractStripFrames(const std::filesystem::path& path,
+                                const std::vector<std::chrono::milliseconds>& timestamps,
+                                size_t first, size_t stride, int maxDimension,
+                                std::vector<VideoThumbnail>& frames) const
+        {
+            IMFAttributes* pAttributes = nullptr;
+            if (FAILED(MFCreateAttributes(&pAttributes, 3))) return;
+            pAttributes->SetUnknown(MF_SOURCE_READER_D3D_MANAGER, deviceManager_);
+            pAttributes->SetUINT32(MF_READWRITE_ENABLE_HARDWARE_TRANSFORMS, TRUE);
+            pAttributes->SetUINT32(MF_SOURCE_READER_ENABLE_ADVANCED_VIDEO_PROCESSING, TRUE);
+
+            IMFSourceReader* pReader = nullptr;
+            HRESULT hr = MFCreateSourceReaderFromURL(path.wstring().c_str(), pAttributes, &pReader);
+            pAttributes->Release();
+            if (FAILED(hr) || !pReader) {
+                return;
+            }
+
+            pReader->SetStreamSelection(MF_SOURCE_READER_ALL_STREAMS, FALSE);
+            pReader->SetStreamSelection(MF_SOURCE_READER_FIRST_VIDEO_STREAM, TRUE);
+
+            UINT32 width = 0, height = 0;
+            IMFMediaType* pNativeType = nullptr;
+            if (SUCCEEDED(pReader->GetNativeMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0, &pNativeType))) {
+                MFGetAttributeSize(pNativeType, MF_MT_FRAME_SIZE, &width, &height);
+                pNativeType->Release();
+            }
+            if (width == 0 || height == 0) {
+                pReader->Release();
+                return;
+            }
+
+            UINT32 scaledWidth = width;
+            UINT32 scaledHeight = height;
+            if (static_cast<int>(std::max(width, height)) > maxDimension) {
+                float scale = static_cast<float>(maxDimension) / std::max(width, height);
+                scaledWidth = std::max(1u, static_cast<UINT32>(width * scale));
+                scaledHeight = std::max(1u, static_cast<UINT32>(height * scale));
+            }
+
+            // Converted from the decoder's NV12/P010 and scaled by the video processor
+            IMFMediaType* pMediaType = nullptr;
+            hr = MFCreateMediaType(&pMediaType);
+            if (SUCCEEDED(hr)) {
+                pMediaType->SetGUID(MF_MT_MAJOR_TYPE, MFMediaType_Video);
+                pMediaType->SetGUID(MF_MT_SUBTYPE, MFVideoFormat_ARGB32);
+                pMediaType->SetUINT32(MF_MT_INTERLACE_MODE, MFVideoInterlace_Progressive);
+                MFSetAttributeSize(pMediaType, MF_MT_FRAME_SIZE, scaledWidth, scaledHeight);
+                hr = pReader->SetCurrentMediaType(MF_SOURCE_READER_FIRST_VIDEO_STREAM, nullptr, pMediaType);
+                pMediaType->Release();
+            }
+            if (FAILED(hr)) {
+                pReader->Release();
+                return;
+            }
+
+            ID3D11DeviceContext* pContext = nullptr;
+            device_->GetImmediateContext(&pContext);
+
+            for (size_t i = first; i < timestamps.size(); i += stride) {
+                PROPVARIANT var;
+                PropVariantInit(&var);
+                var.vt = VT_I8;
+                var.hVal.QuadPart = timestamps[i].count() * 10000;  // Convert to 100ns units
+                hr = pReader->SetCurrentPosition(GUID_NULL, var);
+                PropVariantClear(&var);
+                if (FAILED(hr)) break;
+
+                // A seek lands on the keyframe at or before the position; that
+                // first frame is the thumbnail, with nothing decoded past it
+                DWORD streamIndex = 0, flags = 0;
+                LONGLONG frameTimestamp = 0;
+                IMFSample* pSample = nullptr;
+                hr = pReader->ReadSample(MF_SOURCE_READER_FIRST_VIDEO_STREAM, 0,
+                                         &streamIndex, &flags, &frameTimestamp, &pSample);
+                if (FAILED(hr) || (flags & MF_SOURCE_READERF_ENDOFSTREAM)) {
+                    if (pSample) pSample->Release();
+                    break;
+                }
+                if (!pSample) continue;
+
+                IMFMediaBuffer* pBuffer = nullptr;
+                IMFDXGIBuffer* pDxgiBuffer = nullptr;
+                ID3D11Texture2D* pFrame = nullptr;
+                UINT subresource = 0;
+                if (SUCCEEDED(pSample->GetBufferByIndex(0, &pBuffer)) &&
+                    SUCCEEDED(pBuffer->QueryInterface(IID_PPV_ARGS(&pDxgiBuffer))) &&
+                    SUCCEEDED(pDxgiBuffer->GetResource(IID_PPV_ARGS(&pFrame))) &&
+                    SUCCEEDED(pDxgiBuffer->GetSubresourceIndex(&subresource))) {
+                    VideoThumbnail& thumb = frames[i];
+                    thumb.timestamp = std::chrono::milliseconds(frameTimestamp / 10000);
+                    thumb.texture = CopyFrame(pContext, pFrame, subresource, scaledWidth, scaledHeight);
+                    if (thumb.texture) {
+                        thumb.width = static_cast<int>(scaledWidth);
+                        thumb.height = static_cast<int>(scaledHeight);
+                    }
+                }
+                if (pFrame) pFrame->Release();
+                if (pDxgiBuffer) pDxgiBuffer->Release();
+                if (pBuffer) pBuffer->Release();
+                pSample->Release();
+            }
+
+            if (pContext) pContext->Release();
+            pReader->Release();
+        }
+
+        /**
+         * @brief Copy one decoded frame out of the decoder's texture pool
+         *        into a texture of its own
+         */
+        ID3D11ShaderResourceView* CopyFrame(ID3D11DeviceContext* context, ID3D11Texture2D* source,
+                                            UINT subresource, UINT width, UINT height) const
+        {
+            if (!context || !source) return nullptr;
+
+            D3D11_TEXTURE2D_DESC sourceDesc = {};
+            source->GetDesc(&sourceDesc);
+
+            D3D11_TEXTURE2D_DESC desc = {};
+            desc.Width = std::min(width, sourceDesc.Width);
+            desc.Height = std::min(height, sourceDesc.Height);
+            desc.MipLevels = 1;
+            desc.ArraySize = 1;
+            desc.Format = sourceDesc.Format;
+            desc.SampleDesc.Count = 1;
+            desc.Usage = D3D11_USAGE_DEFAULT;
+            desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+            ID3D11Texture2D* pTexture = nullptr;
+            HRESULT hr = device_->CreateTexture2D(&desc, nullptr, &pTexture);
+            if (FAILED(hr)) return nullptr;
+
+            // Pool textures may be padded past the frame
+            D3D11_BOX box = {0, 0, 0, desc.Width, desc.Height, 1};
+            context->CopySubresourceRegion(pTexture, 0, 0, 0, 0, source, subresource, &box);
+
+            D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Format = desc.Format;
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MipLevels = 1;
+
+            ID3D11ShaderResourceView* pSRV = nullptr;
+            hr = device_->CreateShaderResourceView(pTexture, &srvDesc, &pSRV);
+            pTexture->Release();
+
+            return SUCCEEDED(hr) ? pSRV : nullptr;
+        }
+
         ID3D11ShaderResourceView* CreateTexture(const uint8_t* pixels, int width, int height) const
         {
             if (!device_ || !pixels || width <= 0 || height <= 0) return nullptr;
@@ -424,19 +974,16 @@ namespace opacity::preview
 
     bool MediaPreviewHandler::CanHandle(const core::Path& path, const std::string& extension) const
     {
-        std::string ext = extension;
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        return impl_->videoExtensions_.count(ext) > 0 || 
-               impl_->audioExtensions_.count(ext) > 0;
+        const filesystem::ExtensionInfo* info = filesystem::LookupExtension(extension);
+        return info && (info->preview_handlers & filesystem::PreviewMedia);
     }
 
     MediaType MediaPreviewHandler::GetMediaType(const std::string& extension) const
     {
-        std::string ext = extension;
-        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-        
-        if (impl_->videoExtensions_.count(ext) > 0) return MediaType::Video;
-        if (impl_->audioExtensions_.count(ext) > 0) return MediaType::Audio;
+        const filesystem::ExtensionInfo* info = filesystem::LookupExtension(extension);
+        if (!info) return MediaType::Unknown;
+        if (info->preview_handlers & filesystem::PreviewVideo) return MediaType::Video;
+        if (info->preview_handlers & filesystem::PreviewAudio) return MediaType::Audio;
         return MediaType::Unknown;
     }
 
@@ -450,7 +997,12 @@ namespace opacity::preview
         preview.info = impl_->ExtractMediaInfo(fsPath);
         
         if (preview.info.type == MediaType::Video && maxThumbnails > 0) {
-            preview.thumbnails = ExtractThumbnails(path, maxThumbnails);
+            preview.thumbnails = ExtractThumbnailStrip(path, maxThumbnails);
+        }
+
+        // Only a stored waveform; decoding one is left to a WaveformBuilder
+        if (preview.info.type == MediaType::Audio) {
+            FindCachedWaveform(path, 100, preview.waveform);
         }
         
         preview.loaded = true;
@@ -510,19 +1062,100 @@ namespace opacity::preview
         return thumbnails;
     }
 
+    std::vector<VideoThumbnail> MediaPreviewHandler::ExtractThumbnailStrip(
+        const core::Path& path,
+        int count,
+        int maxDimension) const
+    {
+        std::vector<VideoThumbnail> thumbnails;
+
+#ifdef _WIN32
+        if (!impl_->deviceManager_ || count <= 0) {
+            return ExtractThumbnails(path, count, maxDimension);
+        }
+
+        auto info = GetMediaInfo(path);
+        if (info.type != MediaType::Video || info.duration.count() <= 0) {
+            return thumbnails;
+        }
+
+        int64_t interval = info.duration.count() / (count + 1);
+        std::vector<std::chrono::milliseconds> timestamps;
+        for (int i = 1; i <= count; i++) {
+            timestamps.push_back(std::chrono::milliseconds(interval * i));
+        }
+
+        // One reader per worker, each taking every workers-th frame; the
+        // decoder engine is shared, so a few readers saturate it
+        size_t workers = std::min<size_t>(
+            timestamps.size(), std::clamp(std::thread::hardware_concurrency() / 2, 1u, 4u));
+        std::vector<VideoThumbnail> frames(timestamps.size());
+        std::vector<std::thread> threads;
+        std::filesystem::path fsPath = path.Get();
+        for (size_t worker = 0; worker < workers; worker++) {
+            threads.emplace_back([this, &fsPath, &timestamps, &frames, worker, workers, maxDimension]() {
+                HRESULT co = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+                impl_->ExtractStripFrames(fsPath, timestamps, worker, workers, maxDimension, frames);
+                if (SUCCEEDED(co)) CoUninitialize();
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        // Intervals shorter than the keyframe spacing land on the same frame
+        for (auto& frame : frames) {
+            if (!frame.texture) continue;
+            if (!thumbnails.empty() && thumbnails.back().timestamp == frame.timestamp) {
+                frame.texture->Release();
+                continue;
+            }
+            thumbnails.push_back(std::move(frame));
+        }
+
+        if (thumbnails.empty()) {
+            OPACITY_LOG_DEBUG(Preview, "MediaPreviewHandler: No hardware frames for {}, using software", path.String());
+            return ExtractThumbnails(path, count, maxDimension);
+        }
+#endif
+
+        return thumbnails;
+    }
+
     AudioWaveform MediaPreviewHandler::GenerateWaveform(
         const core::Path& path,
-        int samplesPerSecond) const
+        int bucketsPerSecond,
+        WaveformProgress* progress) const
     {
         AudioWaveform waveform;
-        
-        // Full waveform generation would require reading audio samples
-        // This is a placeholder that would need FFmpeg or similar
-        Logger::Get()->warn("MediaPreviewHandler: Waveform generation not implemented");
-        
+        if (bucketsPerSecond <= 0) return waveform;
+
+        std::filesystem::path peakFile = impl_->PeakFilePath(path.Get(), bucketsPerSecond);
+        if (!peakFile.empty() && impl_->ReadPeaks(peakFile, waveform)) {
+            return waveform;
+        }
+
+#ifdef _WIN32
+        if (!impl_->DecodeWaveform(path.Get(), bucketsPerSecond, progress, waveform)) {
+            return AudioWaveform{};
+        }
+        if (!peakFile.empty()) {
+            impl_->WritePeaks(peakFile, waveform);
+        }
+#endif
+
         return waveform;
     }
 
+    bool MediaPreviewHandler::FindCachedWaveform(
+        const core::Path& path,
+        int bucketsPerSecond,
+        AudioWaveform& waveform) const
+    {
+        std::filesystem::path peakFile = impl_->PeakFilePath(path.Get(), bucketsPerSecond);
+        return !peakFile.empty() && impl_->ReadPeaks(peakFile, waveform);
+    }
+
     void MediaPreviewHandler::ReleasePreview(MediaPreviewData& preview) const
     {
 #ifdef _WIN32
@@ -534,20 +1167,79 @@ namespace opacity::preview
         }
 #endif
         preview.thumbnails.clear();
-        preview.waveform.samples.clear();
+        preview.waveform.peaks.clear();
         preview.loaded = false;
     }
 
+    // ============== WaveformBuilder ==============
+
+    WaveformBuilder::WaveformBuilder() = default;
+
+    WaveformBuilder::~WaveformBuilder()
+    {
+        Cancel();
+    }
+
+    void WaveformBuilder::Start(const MediaPreviewHandler& handler, const core::Path& path, int bucketsPerSecond)
+    {
+        Cancel();
+        progress_.cancelled.store(false, std::memory_order_relaxed);
+        progress_.decodedMs.store(0, std::memory_order_relaxed);
+        progress_.totalMs.store(0, std::memory_order_relaxed);
+        {
+            std::lock_guard<std::mutex> lock(resultMutex_);
+            result_ = AudioWaveform{};
+        }
+
+        running_.store(true, std::memory_order_release);
+        thread_ = std::thread([this, &handler, path, bucketsPerSecond]() {
+#ifdef _WIN32
+            HRESULT co = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+#endif
+            AudioWaveform waveform = handler.GenerateWaveform(path, bucketsPerSecond, &progress_);
+            {
+                std::lock_guard<std::mutex> lock(resultMutex_);
+                result_ = std::move(waveform);
+            }
+#ifdef _WIN32
+            if (SUCCEEDED(co)) CoUninitialize();
+#endif
+            running_.store(false, std::memory_order_release);
+        });
+    }
+
+    void WaveformBuilder::Cancel()
+    {
+        progress_.cancelled.store(true, std::memory_order_relaxed);
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        running_.store(false, std::memory_order_release);
+    }
+
+    float WaveformBuilder::GetProgress() const
+    {
+        int64_t total = progress_.totalMs.load(std::memory_order_relaxed);
+        if (total <= 0) return IsRunning() ? 0.0f : 1.0f;
+        float decoded = static_cast<float>(progress_.decodedMs.load(std::memory_order_relaxed));
+        return std::min(decoded / static_cast<float>(total), 1.0f);
+    }
+
+    AudioWaveform WaveformBuilder::TakeResult()
+    {
+        if (IsRunning()) return AudioWaveform{};
+        std::lock_guard<std::mutex> lock(resultMutex_);
+        return std::move(result_);
+    }
+
     std::vector<std::string> MediaPreviewHandler::GetSupportedVideoExtensions() const
     {
-        return std::vector<std::string>(impl_->videoExtensions_.begin(), 
-                                        impl_->videoExtensions_.end());
+        return filesystem::ExtensionsFor(filesystem::PreviewVideo);
     }
 
     std::vector<std::string> MediaPreviewHandler::GetSupportedAudioExtensions() const
     {
-        return std::vector<std::string>(impl_->audioExtensions_.begin(), 
-                                        impl_->audioExtensions_.end());
+        return filesystem::ExtensionsFor(filesystem::PreviewAudio);
     }
 
     std::vector<std::string> MediaPreviewHandler::GetSupportedExtensions() const
@@ -1,18 +1,141 @@
 #include "opacity/preview/PreviewManager.h"
+#include "opacity/archive/ArchiveFileSystem.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
+#include "opacity/core/PluginManager.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/filesystem/CloudIntegration.h"
+
+#define NOMINMAX
+#include <d3d11.h>
 
 #include <algorithm>
+#include <cstring>
+#include <filesystem>
 
 namespace opacity::preview
 {
 
+namespace
+{
+    // Decodes for requests at once; prefetching runs one at a time
+    constexpr size_t kPreviewWorkers = 2;
+
+    // Archive entries are inflated into memory to be shown
+    constexpr uint64_t kMaxArchiveImageBytes = 64 * 1024 * 1024;
+    constexpr uint64_t kMaxArchiveTextBytes = 32 * 1024 * 1024;
+
+    // Microseconds each handler takes to decode one preview
+    core::Histogram& DecodeTime(const char* handler)
+    {
+        return core::Metrics::Get().GetHistogram("opacity_preview_decode_us", {{"handler", handler}});
+    }
+
+    // Path, modification time and size: an edited file gets a new key
+    std::string CacheKey(const core::Path& path)
+    {
+        // An archive entry goes by its CRC and size instead
+        archive::ArchiveEntry archive_entry;
+        if (archive::ArchiveFileSystem::Stat(path.String(), archive_entry))
+            return path.String() + '|' + std::to_string(archive_entry.crc32) + '|' + std::to_string(archive_entry.uncompressed_size);
+
+        std::error_code ec;
+        std::filesystem::directory_entry entry(path.Get(), ec);
+        if (ec)
+            return {};
+        auto size = entry.file_size(ec);
+        if (ec)
+            return {};
+        auto modified = entry.last_write_time(ec);
+        if (ec)
+            return {};
+        return path.String() + '|' + std::to_string(modified.time_since_epoch().count()) + '|' + std::to_string(size);
+    }
+
+    size_t EstimateBytes(const PreviewData& preview)
+    {
+        size_t bytes = sizeof(PreviewData) + preview.file_path.size();
+
+        const auto& image = preview.image_preview;
+        if (image.texture)
+        {
+            bytes += static_cast<size_t>(image.width) * image.height * 4;     // RGBA
+        }
+        bytes += image.pixels.size();
+
+        // Text is mapped, not held; only the document itself counts,
+        // unless it came out of an archive
+        if (preview.text_preview.document)
+        {
+            bytes += sizeof(TextDocument);
+            if (preview.text_preview.document->IsBuffered())
+            {
+                bytes += static_cast<size_t>(preview.text_preview.document->GetSize());
+            }
+        }
+        return bytes;
+    }
+
+    PreviewPtr Share(PreviewData preview)
+    {
+        return PreviewPtr(new PreviewData(std::move(preview)), [](const PreviewData* data)
+        {
+            if (data->image_preview.texture)
+            {
+                data->image_preview.texture->Release();
+            }
+            delete data;
+        });
+    }
+}
+
+PreviewRequest::PreviewRequest(std::string path, std::string key, bool hydrate)
+    : path_(std::move(path))
+    , key_(std::move(key))
+    , hydrate_(hydrate)
+{
+}
+
 PreviewManager::PreviewManager()
 {
+    memory_ = core::MemoryGovernor::Get().Register(
+        "Previews",
+        [this]
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return cache_bytes_;
+        },
+        [this](size_t target_bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            EvictLocked(target_bytes);
+        });
     core::Logger::Get()->debug("PreviewManager initialized");
 }
 
 PreviewManager::~PreviewManager()
 {
+    memory_.Reset();
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    stop_ = true;
+    for (auto* queue : {&queue_, &prefetch_queue_})
+    {
+        for (auto& request : *queue)
+        {
+            request->Cancel();
+        }
+        queue->clear();
+    }
+    pending_.clear();
+    if (auto latest = latest_.lock())
+    {
+        latest->Cancel();
+    }
+
+    // Drains still queued on the scheduler see stop_ and return at once
+    drained_.wait(lock, [this] { return request_drains_ == 0 && prefetch_drains_ == 0; });
 }
 
 void PreviewManager::Initialize(ID3D11Device* device)
@@ -22,8 +145,14 @@ void PreviewManager::Initialize(ID3D11Device* device)
     core::Logger::Get()->debug("PreviewManager D3D11 device initialized");
 }
 
-PreviewData PreviewManager::LoadPreview(const core::Path& path)
+PreviewData PreviewManager::LoadPreview(const core::Path& path, bool hydrate)
+{
+    return Load(path, hydrate, nullptr);
+}
+
+PreviewData PreviewManager::Load(const core::Path& path, bool hydrate, PreviewRequest* request)
 {
+    OPACITY_PROFILE_ZONE("PreviewManager::LoadPreview");
     PreviewData preview;
     preview.file_path = path.String();
     preview.file_name = path.Filename();
@@ -39,9 +168,26 @@ PreviewData PreviewManager::LoadPreview(const core::Path& path)
     std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(),
         [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
 
+    std::string archive_path;
+    std::string entry_name;
+    if (archive::ArchiveFileSystem::SplitPath(preview.file_path, archive_path, entry_name))
+    {
+        return LoadArchivePreview(path, core::Path(archive_path), lower_ext, hydrate, std::move(preview));
+    }
+
+    // Following the selection through a synced folder must not download it
+    if (filesystem::CloudIntegration::ShouldSkipRead(path.Get(), hydrate))
+    {
+        preview.type = GetPreviewType(path);
+        preview.online_only = true;
+        return preview;
+    }
+
     // Check which handler can handle this file
     if (image_handler_.CanHandle(path, lower_ext))
     {
+        static auto& decode_time = DecodeTime("image");
+        core::ScopedTimer timer(decode_time);
         preview.type = PreviewType::Image;
         preview.is_loading = true;
         preview.image_preview = image_handler_.LoadPreview(path);
@@ -54,6 +200,8 @@ PreviewData PreviewManager::LoadPreview(const core::Path& path)
     }
     else if (text_handler_.CanHandle(path, lower_ext))
     {
+        static auto& decode_time = DecodeTime("text");
+        core::ScopedTimer timer(decode_time);
         preview.type = PreviewType::Text;
         preview.is_loading = true;
         preview.text_preview = text_handler_.LoadPreview(path);
@@ -64,22 +212,422 @@ PreviewData PreviewManager::LoadPreview(const core::Path& path)
             preview.error_message = preview.text_preview.error_message;
         }
     }
+    else if (auto source = plugins_ ? plugins_->FindPreviewSource(path.Get()) : nullptr)
+    {
+        static auto& decode_time = DecodeTime("plugin");
+        core::ScopedTimer timer(decode_time);
+        preview = LoadPluginPreview(*source, path, std::move(preview), request);
+    }
+    else
+    {
+        preview.type = PreviewType::Unsupported;
+        preview.error_message = "No preview available for this file type";
+    }
+
+    return preview;
+}
+
+PreviewData PreviewManager::LoadPluginPreview(core::PreviewSource& source, const core::Path& path,
+                                              PreviewData preview, PreviewRequest* request)
+{
+    OPACITY_PROFILE_ZONE("PreviewManager::LoadPluginPreview");
+
+    // Kept by each worker, so most plugins write into memory already there
+    thread_local std::vector<uint8_t> buffer;
+    size_t wanted = static_cast<size_t>(kPluginPreviewSize) * kPluginPreviewSize * 4;
+    if (buffer.size() < wanted)
+        buffer.resize(wanted);
+
+    std::function<void(float)> progress;
+    if (request)
+        progress = [request](float fraction) { request->progress_.store(fraction, std::memory_order_relaxed); };
+
+    core::PluginPreview result = source.Render(path.Get(), kPluginPreviewSize, kPluginPreviewSize, buffer,
+                                               request ? &request->cancelled_ : nullptr, progress);
+    preview.type = PreviewType::Image;
+    if (result.status != OPACITY_PREVIEW_OK)
+    {
+        preview.error_message = result.status == OPACITY_PREVIEW_CANCELLED ? "Preview cancelled"
+                                                                           : "The plugin could not preview this file";
+        return preview;
+    }
+
+    ImagePreviewData& image = preview.image_preview;
+    if (result.format == OPACITY_PREVIEW_FORMAT_ENCODED)
+    {
+        std::vector<char> contents(buffer.begin(), buffer.begin() + result.size);
+        image = image_handler_.LoadPreview(path, contents);
+    }
+    else if (result.format == OPACITY_PREVIEW_FORMAT_RGBA8 && result.width > 0 && result.height > 0)
+    {
+        size_t row = static_cast<size_t>(result.width) * 4;
+        size_t stride = result.stride ? result.stride : row;
+        if (stride < row || result.size < stride * (result.height - 1) + row)
+        {
+            preview.error_message = "The plugin returned a malformed preview";
+            return preview;
+        }
+
+        // Rows are packed in place for the texture
+        if (stride != row)
+        {
+            for (size_t y = 1; y < result.height; ++y)
+                std::memmove(buffer.data() + y * row, buffer.data() + y * stride, row);
+        }
+
+        image.width = static_cast<int>(result.width);
+        image.height = static_cast<int>(result.height);
+        image.info.width = image.width;
+        image.info.height = image.height;
+        image.info.channels = 4;
+        image.info.format = "Plugin";
+        if (device_)
+            image.texture = ImagePreviewHandler::CreateTexture(device_, buffer.data(), image.width, image.height);
+        if (!image.texture)
+            image.pixels.assign(buffer.begin(), buffer.begin() + row * result.height);
+        image.loaded = true;
+    }
     else
     {
         preview.type = PreviewType::Unsupported;
         preview.error_message = "No preview available for this file type";
+        return preview;
+    }
+
+    if (!image.loaded)
+        preview.error_message = image.error_message;
+    return preview;
+}
+
+PreviewData PreviewManager::LoadArchivePreview(const core::Path& path, const core::Path& archive_path,
+                                               const std::string& lower_ext, bool hydrate, PreviewData preview)
+{
+    preview.type = GetPreviewType(path);
+    if (filesystem::CloudIntegration::ShouldSkipRead(archive_path.Get(), hydrate))
+    {
+        preview.online_only = true;
+        return preview;
+    }
+
+    bool image = image_handler_.CanHandle(path, lower_ext);
+    if (!image && !text_handler_.CanHandle(path, lower_ext))
+    {
+        preview.type = PreviewType::Unsupported;
+        preview.error_message = "No preview available for this file type";
+        return preview;
+    }
+
+    // Inflated into memory; nothing is extracted to disk
+    std::vector<char> contents;
+    if (!archive::ArchiveFileSystem::ReadEntry(path.String(), contents,
+                                               image ? kMaxArchiveImageBytes : kMaxArchiveTextBytes))
+    {
+        preview.error_message = "Archive entry cannot be read or is too large to preview";
+        return preview;
     }
 
+    if (image)
+    {
+        static auto& decode_time = DecodeTime("image");
+        core::ScopedTimer timer(decode_time);
+        preview.type = PreviewType::Image;
+        preview.image_preview = image_handler_.LoadPreview(path, contents);
+        if (!preview.image_preview.loaded)
+        {
+            preview.error_message = preview.image_preview.error_message;
+        }
+    }
+    else
+    {
+        static auto& decode_time = DecodeTime("text");
+        core::ScopedTimer timer(decode_time);
+        preview.type = PreviewType::Text;
+        preview.text_preview = text_handler_.LoadPreview(path, std::move(contents));
+    }
     return preview;
 }
 
+PreviewHandle PreviewManager::RequestPreview(const core::Path& path, bool hydrate)
+{
+    std::string key = CacheKey(path);
+    PreviewHandle request;
+    bool queue = false;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+
+        if (!key.empty())
+        {
+            static auto& hits = core::Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                                {{"cache", "preview"}, {"result", "hit"}});
+            static auto& misses = core::Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                                  {{"cache", "preview"}, {"result", "miss"}});
+            auto cached = FindCachedLocked(key);
+            (cached ? hits : misses).Add();
+            if (cached)
+            {
+                request = std::make_shared<PreviewRequest>(path.String(), key, hydrate);
+                request->result_ = std::move(cached);
+                request->ready_.store(true, std::memory_order_release);
+            }
+            else
+            {
+                // Already queued or decoding, perhaps for a selection that
+                // moved on and came back: take it over
+                auto it = pending_.find(key);
+                auto existing = it != pending_.end() ? it->second.lock() : nullptr;
+                if (existing && (existing->hydrate_ || !hydrate))
+                {
+                    existing->cancelled_.store(false, std::memory_order_relaxed);
+                    if (existing->prefetch_)
+                    {
+                        existing->prefetch_ = false;
+                        auto queued = std::find(prefetch_queue_.begin(), prefetch_queue_.end(), existing);
+                        if (queued != prefetch_queue_.end())
+                        {
+                            prefetch_queue_.erase(queued);
+                            queue_.push_front(existing);
+                        }
+                    }
+                    request = std::move(existing);
+                }
+            }
+        }
+
+        if (!request)
+        {
+            request = std::make_shared<PreviewRequest>(path.String(), key, hydrate);
+            queue = true;
+        }
+
+        auto previous = latest_.lock();
+        if (previous && previous != request)
+        {
+            previous->Cancel();
+        }
+
+        // Superseded requests still queued would only be skipped later
+        for (auto it = queue_.begin(); it != queue_.end();)
+        {
+            if ((*it)->IsCancelled())
+            {
+                DropQueuedLocked(*it);
+                it = queue_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+
+        if (queue)
+        {
+            queue_.push_back(request);
+            if (!key.empty())
+                pending_[key] = request;
+        }
+        latest_ = request;
+
+        // Also for a prefetch just moved into queue_
+        ScheduleLocked();
+    }
+    return request;
+}
+
+void PreviewManager::PrefetchPreviews(const std::vector<core::Path>& paths)
+{
+    // Stat outside the lock; the workers may be waiting on it
+    std::vector<std::pair<core::Path, std::string>> candidates;
+    for (const auto& path : paths)
+    {
+        if (GetPreviewType(path) == PreviewType::Unsupported)
+            continue;
+        std::string key = CacheKey(path);
+        if (!key.empty())
+            candidates.emplace_back(path, std::move(key));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (auto& request : prefetch_queue_)
+        {
+            DropQueuedLocked(request);
+        }
+        prefetch_queue_.clear();
+
+        for (auto& [path, key] : candidates)
+        {
+            if (FindCachedLocked(key) || pending_.count(key))
+                continue;
+
+            auto request = std::make_shared<PreviewRequest>(path.String(), key, false);
+            request->prefetch_ = true;
+            prefetch_queue_.push_back(request);
+            pending_[key] = request;
+        }
+        ScheduleLocked();
+    }
+}
+
+void PreviewManager::CancelRequests()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (auto latest = latest_.lock())
+    {
+        latest->Cancel();
+    }
+    for (auto& request : queue_)
+    {
+        DropQueuedLocked(request);
+    }
+    queue_.clear();
+}
+
+void PreviewManager::SetCacheBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_budget_ = bytes;
+    EvictLocked(cache_budget_);
+}
+
+void PreviewManager::ClearCache()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    cache_.clear();
+    cache_index_.clear();
+    cache_bytes_ = 0;
+}
+
+PreviewPtr PreviewManager::FindCachedLocked(const std::string& key)
+{
+    auto it = cache_index_.find(key);
+    if (it == cache_index_.end())
+        return nullptr;
+
+    cache_.splice(cache_.begin(), cache_, it->second);
+    return it->second->preview;
+}
+
+void PreviewManager::StoreCachedLocked(const std::string& key, const PreviewPtr& preview)
+{
+    size_t bytes = EstimateBytes(*preview);
+    if (bytes > cache_budget_)
+        return;
+
+    auto it = cache_index_.find(key);
+    if (it != cache_index_.end())
+    {
+        cache_bytes_ -= it->second->bytes;
+        cache_.erase(it->second);
+    }
+
+    cache_.push_front({key, preview, bytes});
+    cache_index_[key] = cache_.begin();
+    cache_bytes_ += bytes;
+    EvictLocked(cache_budget_);
+}
+
+void PreviewManager::EvictLocked(size_t limit)
+{
+    // Evicting only drops the cache's reference; a preview on screen stays
+    while (cache_bytes_ > limit && !cache_.empty())
+    {
+        cache_bytes_ -= cache_.back().bytes;
+        cache_index_.erase(cache_.back().key);
+        cache_.pop_back();
+    }
+}
+
+void PreviewManager::DropQueuedLocked(const PreviewHandle& request)
+{
+    request->Cancel();
+    auto it = pending_.find(request->key_);
+    if (it != pending_.end() && it->second.lock() == request)
+    {
+        pending_.erase(it);
+    }
+}
+
+void PreviewManager::ScheduleLocked()
+{
+    if (stop_)
+        return;
+
+    // Each drain takes requests until its queue is empty. Two let a new
+    // request start while a superseded decode that cannot be interrupted
+    // runs out
+    while (request_drains_ < std::min(kPreviewWorkers, queue_.size()))
+    {
+        ++request_drains_;
+        core::TaskOptions options;
+        options.priority = core::TaskPriority::Interactive;
+        core::TaskScheduler::Get().Submit([this](const core::CancellationToken&) { Drain(false); }, options);
+    }
+
+    if (prefetch_drains_ == 0 && !prefetch_queue_.empty())
+    {
+        ++prefetch_drains_;
+        core::TaskOptions options;
+        options.priority = core::TaskPriority::Background;
+        core::TaskScheduler::Get().Submit([this](const core::CancellationToken&) { Drain(true); }, options);
+    }
+}
+
+void PreviewManager::Drain(bool prefetch)
+{
+    while (true)
+    {
+        PreviewHandle request;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto& queue = prefetch ? prefetch_queue_ : queue_;
+            if (stop_ || queue.empty())
+            {
+                --(prefetch ? prefetch_drains_ : request_drains_);
+                drained_.notify_all();
+                return;
+            }
+
+            request = std::move(queue.front());
+            queue.pop_front();
+
+            if (request->IsCancelled())
+            {
+                DropQueuedLocked(request);
+                continue;
+            }
+        }
+
+        PreviewPtr preview = Share(Load(core::Path(request->GetPath()), request->hydrate_, request.get()));
+
+        // Under the lock so a request taken over meanwhile cannot miss ready_
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!request->key_.empty())
+        {
+            // Placeholders and failures are tried again next time
+            if (!preview->online_only && preview->error_message.empty())
+                StoreCachedLocked(request->key_, preview);
+
+            auto it = pending_.find(request->key_);
+            if (it != pending_.end() && it->second.lock() == request)
+                pending_.erase(it);
+        }
+
+        if (!request->IsCancelled())
+        {
+            request->result_ = std::move(preview);
+            request->ready_.store(true, std::memory_order_release);
+        }
+    }
+}
+
 void PreviewManager::ReleasePreview(PreviewData& preview)
 {
     if (preview.type == PreviewType::Image)
     {
         image_handler_.ReleasePreview(preview.image_preview);
     }
-    preview.text_preview.lines.clear();
+    preview.text_preview.highlighter.reset();
+    preview.text_preview.document.reset();
     preview.type = PreviewType::None;
 }
 
@@ -0,0 +1,566 @@
+#include "opacity/preview/SyntaxHighlighter.h"
+
+#include <algorithm>
+#include <cctype>
+#include <string_view>
+#include <unordered_set>
+
+namespace opacity::preview
+{
+
+/**
+ * @brief How one family of file types is lexed
+ */
+struct SyntaxLanguage
+{
+    std::vector<std::string_view> extensions;
+    std::vector<std::string_view> line_comments;
+    std::string_view block_open;
+    std::string_view block_close;
+    std::string_view quotes;                // Strings that end with the line
+    bool template_strings = false;          // `...` may span lines
+    bool triple_quotes = false;             // """...""" and '''...''' may span lines
+    bool preprocessor = false;              // # first on a line
+    bool markup = false;                    // Tag names after < and </
+    bool ignore_case = false;
+    std::unordered_set<std::string_view> keywords;
+};
+
+namespace
+{
+    // Lexer state carried from one line to the next
+    enum : uint8_t
+    {
+        kNormal = 0,
+        kBlockComment,
+        kTripleDouble,
+        kTripleSingle,
+        kTemplate
+    };
+
+    const std::vector<SyntaxLanguage>& Languages()
+    {
+        static const std::vector<SyntaxLanguage> languages = [] {
+            std::vector<SyntaxLanguage> list;
+
+            SyntaxLanguage cpp;
+            cpp.extensions = {"c", "cpp", "cc", "cxx", "h", "hpp", "hxx", "inl", "m", "mm"};
+            cpp.line_comments = {"//"};
+            cpp.block_open = "/*";
+            cpp.block_close = "*/";
+            cpp.quotes = "\"'";
+            cpp.preprocessor = true;
+            cpp.keywords = {
+                "alignas", "alignof", "auto", "bool", "break", "case", "catch", "char", "class", "const",
+                "constexpr", "consteval", "const_cast", "continue", "decltype", "default", "delete", "do",
+                "double", "dynamic_cast", "else", "enum", "explicit", "export", "extern", "false", "final",
+                "float", "for", "friend", "goto", "if", "inline", "int", "long", "mutable", "namespace",
+                "new", "noexcept", "nullptr", "operator", "override", "private", "protected", "public",
+                "register", "reinterpret_cast", "return", "short", "signed", "sizeof", "static",
+                "static_assert", "static_cast", "struct", "switch", "template", "this", "thread_local",
+                "throw", "true", "try", "typedef", "typeid", "typename", "union", "unsigned", "using",
+                "virtual", "void", "volatile", "wchar_t", "while", "NULL"};
+            list.push_back(std::move(cpp));
+
+            SyntaxLanguage managed;
+            managed.extensions = {"cs", "java", "kt", "scala", "groovy", "swift", "php"};
+            managed.line_comments = {"//"};
+            managed.block_open = "/*";
+            managed.block_close = "*/";
+            managed.quotes = "\"'";
+            managed.keywords = {
+                "abstract", "as", "async", "await", "base", "bool", "boolean", "break", "byte", "case",
+                "catch", "char", "class", "const", "continue", "def", "default", "do", "double", "else",
+                "enum", "extends", "extension", "false", "final", "finally", "float", "for", "foreach",
+                "fun", "func", "function", "get", "guard", "if", "implements", "import", "in", "int",
+                "interface", "internal", "is", "let", "long", "namespace", "new", "null", "object",
+                "override", "package", "private", "protected", "protocol", "public", "readonly", "return",
+                "sealed", "self", "set", "short", "static", "string", "struct", "super", "switch", "this",
+                "throw", "throws", "trait", "true", "try", "typeof", "val", "var", "virtual", "void",
+                "when", "where", "while", "yield"};
+            list.push_back(std::move(managed));
+
+            SyntaxLanguage go;
+            go.extensions = {"go"};
+            go.line_comments = {"//"};
+            go.block_open = "/*";
+            go.block_close = "*/";
+            go.quotes = "\"'";
+            go.template_strings = true;     // Raw strings
+            go.keywords = {
+                "break", "case", "chan", "const", "continue", "default", "defer", "else", "fallthrough",
+                "false", "for", "func", "go", "goto", "if", "import", "interface", "iota", "map", "nil",
+                "package", "range", "return", "select", "struct", "switch", "true", "type", "var"};
+            list.push_back(std::move(go));
+
+            SyntaxLanguage rust;
+            rust.extensions = {"rs"};
+            rust.line_comments = {"//"};
+            rust.block_open = "/*";
+            rust.block_close = "*/";
+            rust.quotes = "\"";             // ' is also a lifetime
+            rust.keywords = {
+                "as", "async", "await", "break", "const", "continue", "crate", "dyn", "else", "enum",
+                "extern", "false", "fn", "for", "if", "impl", "in", "let", "loop", "match", "mod", "move",
+                "mut", "pub", "ref", "return", "self", "Self", "static", "struct", "super", "trait",
+                "true", "type", "unsafe", "use", "where", "while"};
+            list.push_back(std::move(rust));
+
+            SyntaxLanguage script;
+            script.extensions = {"js", "jsx", "ts", "tsx", "mjs", "cjs", "vue", "svelte"};
+            script.line_comments = {"//"};
+            script.block_open = "/*";
+            script.block_close = "*/";
+            script.quotes = "\"'";
+            script.template_strings = true;
+            script.keywords = {
+                "abstract", "as", "async", "await", "break", "case", "catch", "class", "const",
+                "continue", "debugger", "declare", "default", "delete", "do", "else", "enum", "export",
+                "extends", "false", "finally", "for", "from", "function", "get", "if", "implements",
+                "import", "in", "instanceof", "interface", "let", "new", "null", "of", "private",
+                "protected", "public", "readonly", "return", "set", "static", "super", "switch", "this",
+                "throw", "true", "try", "type", "typeof", "undefined", "var", "void", "while", "yield"};
+            list.push_back(std::move(script));
+
+            SyntaxLanguage python;
+            python.extensions = {"py", "pyw", "pyx", "pxd"};
+            python.line_comments = {"#"};
+            python.quotes = "\"'";
+            python.triple_quotes = true;
+            python.keywords = {
+                "False", "None", "True", "and", "as", "assert", "async", "await", "break", "class",
+                "continue", "def", "del", "elif", "else", "except", "finally", "for", "from", "global",
+                "if", "import", "in", "is", "lambda", "nonlocal", "not", "or", "pass", "raise", "return",
+                "self", "try", "while", "with", "yield"};
+            list.push_back(std::move(python));
+
+            SyntaxLanguage shell;
+            shell.extensions = {"sh", "bash", "zsh", "fish", "ps1", "psm1", "rb", "rake", "gemspec", "pl",
+                                "pm", "tcl", "r", "cmake", "make", "makefile", "dockerfile"};
+            shell.line_comments = {"#"};
+            shell.quotes = "\"'";
+            shell.keywords = {
+                "begin", "break", "case", "continue", "def", "do", "done", "elif", "else", "elsif", "end",
+                "esac", "eval", "exit", "export", "fi", "for", "foreach", "function", "if", "in", "let",
+                "local", "module", "my", "next", "our", "param", "require", "return", "sub", "then",
+                "unless", "until", "use", "while", "yield"};
+            list.push_back(std::move(shell));
+
+            SyntaxLanguage lua;
+            lua.extensions = {"lua"};
+            lua.line_comments = {"--"};
+            lua.block_open = "--[[";
+            lua.block_close = "]]";
+            lua.quotes = "\"'";
+            lua.keywords = {
+                "and", "break", "do", "else", "elseif", "end", "false", "for", "function", "goto", "if",
+                "in", "local", "nil", "not", "or", "repeat", "return", "then", "true", "until", "while"};
+            list.push_back(std::move(lua));
+
+            SyntaxLanguage sql;
+            sql.extensions = {"sql"};
+            sql.line_comments = {"--"};
+            sql.block_open = "/*";
+            sql.block_close = "*/";
+            sql.quotes = "'\"";
+            sql.ignore_case = true;
+            sql.keywords = {
+                "add", "all", "alter", "and", "as", "asc", "begin", "between", "by", "case", "commit",
+                "create", "delete", "desc", "distinct", "drop", "else", "end", "exists", "from", "group",
+                "having", "in", "index", "inner", "insert", "into", "is", "join", "key", "left", "like",
+                "limit", "not", "null", "on", "or", "order", "outer", "primary", "references", "right",
+                "select", "set", "table", "then", "union", "update", "values", "view", "when", "where"};
+            list.push_back(std::move(sql));
+
+            SyntaxLanguage css;
+            css.extensions = {"css", "scss", "sass", "less"};
+            css.line_comments = {"//"};
+            css.block_open = "/*";
+            css.block_close = "*/";
+            css.quotes = "\"'";
+            css.keywords = {"important", "@import", "@media", "@mixin", "@include", "@extend"};
+            list.push_back(std::move(css));
+
+            SyntaxLanguage json;
+            json.extensions = {"json", "jsonc", "json5"};
+            json.line_comments = {"//"};
+            json.block_open = "/*";
+            json.block_close = "*/";
+            json.quotes = "\"";
+            json.keywords = {"true", "false", "null"};
+            list.push_back(std::move(json));
+
+            SyntaxLanguage markup;
+            markup.extensions = {"html", "htm", "xhtml", "xml", "xsl", "xslt", "svg"};
+            markup.block_open = "<!--";
+            markup.block_close = "-->";
+            markup.quotes = "\"";
+            markup.markup = true;
+            list.push_back(std::move(markup));
+
+            SyntaxLanguage config;
+            config.extensions = {"yaml", "yml", "toml", "ini", "cfg", "conf", "config", "gitignore",
+                                 "gitattributes", "gitmodules", "editorconfig"};
+            config.line_comments = {"#", ";"};
+            config.quotes = "\"";
+            config.keywords = {"true", "false", "yes", "no", "on", "off", "null"};
+            list.push_back(std::move(config));
+
+            return list;
+        }();
+        return languages;
+    }
+
+    const SyntaxLanguage* FindLanguage(const std::string& extension)
+    {
+        for (const auto& language : Languages())
+        {
+            if (std::find(language.extensions.begin(), language.extensions.end(), extension) !=
+                language.extensions.end())
+                return &language;
+        }
+        return nullptr;
+    }
+
+    bool StartsWith(const std::string& text, size_t pos, std::string_view prefix)
+    {
+        return !prefix.empty() && text.compare(pos, prefix.size(), prefix) == 0;
+    }
+
+    bool IsIdentifierStart(char c)
+    {
+        return std::isalpha(static_cast<unsigned char>(c)) || c == '_' || c == '$' || c == '@';
+    }
+
+    bool IsIdentifier(char c)
+    {
+        return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+    }
+
+    void Push(std::vector<TokenSpan>& spans, size_t begin, size_t end, TokenKind kind)
+    {
+        if (end <= begin)
+            return;
+        if (!spans.empty() && spans.back().kind == kind && spans.back().end == begin)
+        {
+            spans.back().end = static_cast<uint32_t>(end);
+            return;
+        }
+        spans.push_back(TokenSpan{static_cast<uint32_t>(begin), static_cast<uint32_t>(end), kind});
+    }
+
+    // Past the closing quote, or npos when the line ends first
+    size_t SkipQuoted(const std::string& text, size_t pos, char quote)
+    {
+        while (pos < text.size())
+        {
+            if (text[pos] == '\\')
+            {
+                pos += 2;
+                continue;
+            }
+            if (text[pos] == quote)
+                return pos + 1;
+            ++pos;
+        }
+        return std::string::npos;
+    }
+}
+
+SyntaxHighlighter::SyntaxHighlighter(std::shared_ptr<TextDocument> document, const std::string& extension)
+    : document_(std::move(document))
+    , language_(FindLanguage(extension))
+{
+    Reset();
+}
+
+SyntaxHighlighter::~SyntaxHighlighter()
+{
+}
+
+bool SyntaxHighlighter::Supports(const std::string& extension)
+{
+    return FindLanguage(extension) != nullptr;
+}
+
+std::vector<HighlightedLine> SyntaxHighlighter::GetLines(size_t first, size_t count)
+{
+    std::vector<HighlightedLine> lines;
+    catching_up_ = false;
+    if (!document_)
+        return lines;
+
+    // The file was replaced or started over: nothing kept still applies
+    uint64_t generation = document_->GetGeneration();
+    if (generation != generation_)
+    {
+        Reset();
+        generation_ = generation;
+    }
+
+    size_t line_count = document_->GetLineCount();
+    if (first >= line_count || count == 0)
+        return lines;
+    count = std::min(count, line_count - first);
+
+    size_t budget = kCatchUpLines;
+    size_t last = first + count - 1;
+    lines.reserve(count);
+    for (size_t block = first / kBlockLines; block <= last / kBlockLines; ++block)
+    {
+        const auto& block_lines = GetBlock(block, line_count, budget);
+        size_t block_first = block * kBlockLines;
+        size_t from = std::max(first, block_first) - block_first;
+        size_t to = std::min(last + 1, block_first + block_lines.size()) - block_first;
+        for (size_t i = from; i < to; ++i)
+        {
+            lines.push_back(block_lines[i]);
+        }
+    }
+    return lines;
+}
+
+const std::vector<HighlightedLine>& SyntaxHighlighter::GetBlock(size_t block, size_t line_count, size_t& budget)
+{
+    auto it = cache_index_.find(block);
+    if (it != cache_index_.end())
+    {
+        cache_.splice(cache_.begin(), cache_, it->second);
+        return it->second->lines;
+    }
+
+    // Lex forward from the last checkpoint, keeping only the states
+    while (states_.size() <= block && budget > 0)
+    {
+        uint8_t state = states_.back();
+        LexBlock(states_.size() - 1, state, scratch_);
+        states_.push_back(state);
+        budget -= std::min(budget, kBlockLines);
+    }
+
+    if (states_.size() <= block)
+    {
+        catching_up_ = true;
+        scratch_.clear();
+        for (auto& text : document_->GetLines(block * kBlockLines, kBlockLines))
+        {
+            HighlightedLine line;
+            line.text = std::move(text);
+            Push(line.spans, 0, line.text.size(), TokenKind::Plain);
+            scratch_.push_back(std::move(line));
+        }
+        return scratch_;
+    }
+
+    uint8_t state = states_[block];
+    std::vector<HighlightedLine> lines;
+    LexBlock(block, state, lines);
+
+    // The last block may still grow; it is lexed again until it is complete
+    bool complete = (block + 1) * kBlockLines < line_count;
+    if (!complete)
+    {
+        scratch_ = std::move(lines);
+        return scratch_;
+    }
+
+    if (states_.size() == block + 1)
+    {
+        states_.push_back(state);
+    }
+    cache_.push_front(CachedBlock{block, std::move(lines)});
+    cache_index_[block] = cache_.begin();
+    if (cache_.size() > kCachedBlocks)
+    {
+        cache_index_.erase(cache_.back().block);
+        cache_.pop_back();
+    }
+    return cache_.front().lines;
+}
+
+void SyntaxHighlighter::LexBlock(size_t block, uint8_t& state, std::vector<HighlightedLine>& lines) const
+{
+    lines.clear();
+    for (auto& text : document_->GetLines(block * kBlockLines, kBlockLines))
+    {
+        HighlightedLine line;
+        line.text = std::move(text);
+        Lex(line, state);
+        lines.push_back(std::move(line));
+    }
+}
+
+void SyntaxHighlighter::Lex(HighlightedLine& line, uint8_t& state) const
+{
+    const std::string& text = line.text;
+    auto& spans = line.spans;
+    size_t size = text.size();
+    size_t pos = 0;
+
+    if (!language_)
+    {
+        Push(spans, 0, size, TokenKind::Plain);
+        return;
+    }
+    const SyntaxLanguage& language = *language_;
+
+    // Finish whatever the previous line left open
+    if (state != kNormal)
+    {
+        size_t end = std::string::npos;
+        TokenKind kind = TokenKind::String;
+        if (state == kBlockComment)
+        {
+            kind = TokenKind::Comment;
+            end = text.find(language.block_close);
+            if (end != std::string::npos)
+                end += language.block_close.size();
+        }
+        else if (state == kTemplate)
+        {
+            end = SkipQuoted(text, 0, '`');
+        }
+        else
+        {
+            end = text.find(state == kTripleDouble ? "\"\"\"" : "'''");
+            if (end != std::string::npos)
+                end += 3;
+        }
+
+        if (end == std::string::npos)
+        {
+            Push(spans, 0, size, kind);
+            return;
+        }
+        Push(spans, 0, end, kind);
+        pos = end;
+        state = kNormal;
+    }
+
+    size_t first_visible = text.find_first_not_of(" \t");
+    while (pos < size)
+    {
+        char c = text[pos];
+
+        if (language.preprocessor && c == '#' && pos == first_visible)
+        {
+            Push(spans, pos, size, TokenKind::Preprocessor);
+            return;
+        }
+
+        if (StartsWith(text, pos, language.block_open))
+        {
+            size_t end = text.find(language.block_close, pos + language.block_open.size());
+            if (end == std::string::npos)
+            {
+                Push(spans, pos, size, TokenKind::Comment);
+                state = kBlockComment;
+                return;
+            }
+            end += language.block_close.size();
+            Push(spans, pos, end, TokenKind::Comment);
+            pos = end;
+            continue;
+        }
+
+        bool comment = std::any_of(language.line_comments.begin(), language.line_comments.end(),
+            [&](std::string_view prefix) { return StartsWith(text, pos, prefix); });
+        if (comment)
+        {
+            Push(spans, pos, size, TokenKind::Comment);
+            return;
+        }
+
+        if (language.triple_quotes && (StartsWith(text, pos, "\"\"\"") || StartsWith(text, pos, "'''")))
+        {
+            size_t end = text.find(text.substr(pos, 3), pos + 3);
+            if (end == std::string::npos)
+            {
+                Push(spans, pos, size, TokenKind::String);
+                state = c == '"' ? kTripleDouble : kTripleSingle;
+                return;
+            }
+            Push(spans, pos, end + 3, TokenKind::String);
+            pos = end + 3;
+            continue;
+        }
+
+        if (language.template_strings && c == '`')
+        {
+            size_t end = SkipQuoted(text, pos + 1, '`');
+            if (end == std::string::npos)
+            {
+                Push(spans, pos, size, TokenKind::String);
+                state = kTemplate;
+                return;
+            }
+            Push(spans, pos, end, TokenKind::String);
+            pos = end;
+            continue;
+        }
+
+        if (language.quotes.find(c) != std::string_view::npos)
+        {
+            size_t end = std::min(SkipQuoted(text, pos + 1, c), size);
+            Push(spans, pos, end, TokenKind::String);
+            pos = end;
+            continue;
+        }
+
+        bool digit = std::isdigit(static_cast<unsigned char>(c)) ||
+                     (c == '.' && pos + 1 < size && std::isdigit(static_cast<unsigned char>(text[pos + 1])));
+        if (digit && (pos == 0 || !IsIdentifier(text[pos - 1])))
+        {
+            size_t end = pos + 1;
+            while (end < size && (IsIdentifier(text[end]) || text[end] == '.'))
+            {
+                ++end;
+            }
+            Push(spans, pos, end, TokenKind::Number);
+            pos = end;
+            continue;
+        }
+
+        if (IsIdentifierStart(c))
+        {
+            size_t end = pos + 1;
+            while (end < size && (IsIdentifier(text[end]) || (language.markup && (text[end] == '-' || text[end] == ':'))))
+            {
+                ++end;
+            }
+
+            bool keyword = false;
+            if (language.markup)
+            {
+                keyword = (pos >= 1 && text[pos - 1] == '<') ||
+                          (pos >= 2 && text[pos - 1] == '/' && text[pos - 2] == '<');
+            }
+            else if (!language.keywords.empty())
+            {
+                std::string word = text.substr(pos, end - pos);
+                if (language.ignore_case)
+                {
+                    std::transform(word.begin(), word.end(), word.begin(),
+                        [](unsigned char ch) { return static_cast<char>(std::tolower(ch)); });
+                }
+                keyword = language.keywords.count(word) > 0;
+            }
+            Push(spans, pos, end, keyword ? TokenKind::Keyword : TokenKind::Plain);
+            pos = end;
+            continue;
+        }
+
+        Push(spans, pos, pos + 1, TokenKind::Plain);
+        ++pos;
+    }
+}
+
+void SyntaxHighlighter::Reset()
+{
+    states_.assign(1, kNormal);
+    cache_.clear();
+    cache_index_.clear();
+    scratch_.clear();
+}
+
+} // namespace opacity::preview
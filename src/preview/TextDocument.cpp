@@ -0,0 +1,356 @@
+#include "opacity/preview/TextDocument.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/MappedFile.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace opacity::preview
+{
+
+namespace
+{
+    // Bytes counted between publishing progress to readers
+    constexpr uint64_t kIndexChunk = 4 * 1024 * 1024;
+
+    // Bytes compared to tell a file that grew from one that was replaced
+    constexpr uint64_t kIdentityBytes = 4096;
+
+    bool HasBom(const char* data, uint64_t size)
+    {
+        return size >= 3 &&
+               static_cast<unsigned char>(data[0]) == 0xEF &&
+               static_cast<unsigned char>(data[1]) == 0xBB &&
+               static_cast<unsigned char>(data[2]) == 0xBF;
+    }
+
+    std::string FormatLine(const char* begin, const char* end, size_t max_line_length)
+    {
+        // Remove trailing carriage return (Windows line endings)
+        if (end > begin && end[-1] == '\r')
+        {
+            --end;
+        }
+
+        bool cut = max_line_length > 0 && static_cast<size_t>(end - begin) > max_line_length;
+        if (cut)
+        {
+            end = begin + max_line_length;
+        }
+
+        // Replace tabs with spaces for display
+        std::string line;
+        line.reserve(static_cast<size_t>(end - begin) + (cut ? 3 : 0));
+        for (const char* c = begin; c < end; ++c)
+        {
+            if (*c == '\t')
+            {
+                line += "    ";  // 4 spaces per tab
+            }
+            else
+            {
+                line += *c;
+            }
+        }
+        if (cut)
+        {
+            line += "...";
+        }
+        return line;
+    }
+}
+
+TextDocument::TextDocument()
+{
+}
+
+TextDocument::~TextDocument()
+{
+    Close();
+}
+
+bool TextDocument::Open(const core::Path& path)
+{
+    Close();
+    path_ = path;
+
+    auto mapping = MapFile(error_message_);
+    if (!mapping)
+        return false;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mapping_ = mapping;
+        ResetIndex();
+    }
+    StartIndexing(bom_bytes_);
+    return true;
+}
+
+bool TextDocument::Open(const core::Path& path, std::vector<char> contents)
+{
+    Close();
+    path_ = path;
+    buffered_ = true;
+
+    auto mapping = std::make_shared<Mapping>();
+    mapping->contents = std::move(contents);
+    mapping->data = mapping->contents.data();
+    mapping->size = mapping->contents.size();
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mapping_ = mapping;
+        ResetIndex();
+    }
+    StartIndexing(bom_bytes_);
+    return true;
+}
+
+void TextDocument::Close()
+{
+    StopIndexing();
+    buffered_ = false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    mapping_.reset();
+    ResetIndex();
+}
+
+bool TextDocument::Refresh()
+{
+    if (buffered_)
+        return false;
+
+    WIN32_FILE_ATTRIBUTE_DATA attributes = {};
+    if (!GetFileAttributesExW(path_.WString().c_str(), GetFileExInfoStandard, &attributes))
+        return false;
+    uint64_t size = (static_cast<uint64_t>(attributes.nFileSizeHigh) << 32) | attributes.nFileSizeLow;
+
+    std::shared_ptr<const Mapping> previous;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        previous = mapping_;
+    }
+    if (previous && previous->size == size)
+        return false;
+
+    std::string error;
+    auto mapping = MapFile(error);
+    if (!mapping)
+        return false;
+
+    // Appended to when the old bytes are still there; anything else was
+    // truncated or replaced, and is counted again
+    bool appended = previous && mapping->size > previous->size;
+    if (appended && previous->size > 0)
+    {
+        uint64_t compare = std::min(previous->size, kIdentityBytes);
+        appended = std::memcmp(previous->data, mapping->data, static_cast<size_t>(compare)) == 0;
+    }
+
+    StopIndexing();
+    uint64_t from = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mapping_ = mapping;
+        if (!appended)
+        {
+            ResetIndex();
+        }
+        from = appended ? indexed_bytes_ : bom_bytes_;
+    }
+    StartIndexing(from);
+    return true;
+}
+
+size_t TextDocument::GetLineCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return static_cast<size_t>(newlines_ + (indexed_bytes_ > last_line_start_ ? 1 : 0));
+}
+
+uint64_t TextDocument::GetSize() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return mapping_ ? mapping_->size : 0;
+}
+
+uint64_t TextDocument::GetIndexedBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return indexed_bytes_;
+}
+
+uint64_t TextDocument::GetGeneration() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return generation_;
+}
+
+std::vector<std::string> TextDocument::GetLines(size_t first, size_t count, size_t max_line_length) const
+{
+    std::vector<std::string> lines;
+
+    std::shared_ptr<const Mapping> mapping;
+    uint64_t line_count = 0;
+    uint64_t start = 0;
+    uint64_t end = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        line_count = newlines_ + (indexed_bytes_ > last_line_start_ ? 1 : 0);
+        if (!mapping_ || first >= line_count || count == 0)
+            return lines;
+        mapping = mapping_;
+        start = checkpoints_[first / kLineStride];
+        end = indexed_bytes_;
+    }
+
+    const char* data = mapping->data;
+    const char* pos = data + start;
+    const char* limit = data + end;
+
+    // At most kLineStride - 1 lines between the checkpoint and the first
+    for (size_t skip = first % kLineStride; skip > 0 && pos < limit; --skip)
+    {
+        const void* newline = std::memchr(pos, '\n', static_cast<size_t>(limit - pos));
+        pos = newline ? static_cast<const char*>(newline) + 1 : limit;
+    }
+
+    count = static_cast<size_t>(std::min<uint64_t>(count, line_count - first));
+    lines.reserve(count);
+    while (lines.size() < count)
+    {
+        const void* newline = std::memchr(pos, '\n', static_cast<size_t>(limit - pos));
+        const char* line_end = newline ? static_cast<const char*>(newline) : limit;
+        lines.push_back(FormatLine(pos, line_end, max_line_length));
+        if (!newline)
+            break;
+        pos = line_end + 1;
+    }
+    return lines;
+}
+
+std::shared_ptr<const TextDocument::Mapping> TextDocument::MapFile(std::string& error) const
+{
+    // Shared for writing and deleting, so a log can be written to, rotated
+    // or removed while it is shown
+    core::MappedFileOptions options;
+    options.share_write = true;
+    options.map_whole = false;
+
+    core::MappedFile file;
+    if (!file.Open(path_.Get(), options))
+    {
+        error = "Failed to open file";
+        return nullptr;
+    }
+
+    // An empty file maps to nothing, and has nothing to show anyway. The
+    // view keeps the file open once it is closed here
+    auto mapping = std::make_shared<Mapping>();
+    mapping->size = file.FileSize();
+    if (mapping->size > 0)
+    {
+        mapping->view = file.Map(0, static_cast<size_t>(mapping->size));
+        if (!mapping->view)
+        {
+            error = "Error reading file";
+            return nullptr;
+        }
+        mapping->data = reinterpret_cast<const char*>(mapping->view->Data());
+    }
+    return mapping;
+}
+
+void TextDocument::StartIndexing(uint64_t from)
+{
+    std::shared_ptr<const Mapping> mapping;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        mapping = mapping_;
+    }
+    if (!mapping || from >= mapping->size)
+        return;
+
+    indexing_.store(true, std::memory_order_release);
+    indexer_ = std::thread(&TextDocument::IndexLoop, this, std::move(mapping), from);
+}
+
+void TextDocument::StopIndexing()
+{
+    stop_.store(true, std::memory_order_relaxed);
+    if (indexer_.joinable())
+    {
+        indexer_.join();
+    }
+    stop_.store(false, std::memory_order_relaxed);
+    indexing_.store(false, std::memory_order_release);
+}
+
+void TextDocument::IndexLoop(std::shared_ptr<const Mapping> mapping, uint64_t from)
+{
+    uint64_t newlines = 0;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        newlines = newlines_;
+    }
+
+    std::vector<uint64_t> checkpoints;
+    uint64_t last_line_start = 0;
+    uint64_t pos = from;
+    while (pos < mapping->size && !stop_.load(std::memory_order_relaxed))
+    {
+        uint64_t chunk_end = std::min(pos + kIndexChunk, mapping->size);
+        const char* chunk = mapping->data;
+        bool found = false;
+
+        while (pos < chunk_end)
+        {
+            const void* newline = std::memchr(chunk + pos, '\n', static_cast<size_t>(chunk_end - pos));
+            if (!newline)
+                break;
+            pos = static_cast<uint64_t>(static_cast<const char*>(newline) - chunk) + 1;
+            ++newlines;
+            last_line_start = pos;
+            found = true;
+            if (newlines % kLineStride == 0)
+            {
+                checkpoints.push_back(pos);
+            }
+        }
+        pos = chunk_end;
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        checkpoints_.insert(checkpoints_.end(), checkpoints.begin(), checkpoints.end());
+        newlines_ = newlines;
+        if (found)
+        {
+            last_line_start_ = last_line_start;
+        }
+        indexed_bytes_ = chunk_end;
+        checkpoints.clear();
+    }
+
+    if (pos >= mapping->size)
+    {
+        OPACITY_LOG_DEBUG(Preview, "TextDocument: {} lines in {}", newlines, path_.String());
+    }
+    indexing_.store(false, std::memory_order_release);
+}
+
+void TextDocument::ResetIndex()
+{
+    bom_bytes_ = mapping_ && HasBom(mapping_->data, mapping_->size) ? 3 : 0;
+    checkpoints_.assign(1, bom_bytes_);
+    newlines_ = 0;
+    last_line_start_ = bom_bytes_;
+    indexed_bytes_ = bom_bytes_;
+    ++generation_;
+}
+
+} // namespace opacity::preview
@@ -1,54 +1,18 @@
 #include "opacity/preview/TextPreviewHandler.h"
 #include "opacity/core/Logger.h"
+#include "opacity/filesystem/FileTypes.h"
 
-#include <fstream>
 #include <algorithm>
+#include <cctype>
 
 namespace opacity::preview
 {
 
 TextPreviewHandler::TextPreviewHandler()
 {
-    // Initialize list of supported text file extensions
-    supported_extensions_ = {
-        // Plain text
-        "txt", "text", "log", "md", "markdown", "rst", "rtf",
-        
-        // Code files
-        "c", "cpp", "cc", "cxx", "h", "hpp", "hxx", "inl",
-        "cs", "java", "kt", "scala", "groovy",
-        "py", "pyw", "pyx", "pxd",
-        "js", "jsx", "ts", "tsx", "mjs", "cjs",
-        "rb", "rake", "gemspec",
-        "php", "phtml",
-        "go", "rs", "swift", "m", "mm",
-        "lua", "pl", "pm", "tcl", "r", "R",
-        "sh", "bash", "zsh", "fish", "ps1", "psm1", "bat", "cmd",
-        "asm", "s", "S",
-        
-        // Web files
-        "html", "htm", "xhtml", "css", "scss", "sass", "less",
-        "xml", "xsl", "xslt", "svg",
-        "vue", "svelte",
-        
-        // Data files
-        "json", "jsonc", "json5",
-        "yaml", "yml",
-        "toml", "ini", "cfg", "conf", "config",
-        "csv", "tsv",
-        "sql", "sqlite",
-        
-        // Build/config files
-        "cmake", "make", "makefile", "dockerfile",
-        "gradle", "maven", "pom",
-        "gitignore", "gitattributes", "gitmodules",
-        "editorconfig", "eslintrc", "prettierrc",
-        
-        // Documentation
-        "readme", "license", "changelog", "contributing", "authors",
-        "todo", "note", "notes"
-    };
-    
+    // The shared extension table lists what the text view can show
+    supported_extensions_ = filesystem::ExtensionsFor(filesystem::PreviewText);
+
     core::Logger::Get()->debug("TextPreviewHandler initialized with {} supported extensions", 
                                supported_extensions_.size());
 }
@@ -82,77 +46,58 @@ bool TextPreviewHandler::CanHandle(const core::Path& path, const std::string& ex
         return false;
     }
 
-    std::string lower_ext = extension;
-    std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(),
-        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-
-    return std::find(supported_extensions_.begin(), supported_extensions_.end(), lower_ext) 
-           != supported_extensions_.end();
+    const filesystem::ExtensionInfo* info = filesystem::LookupExtension(extension);
+    return info && (info->preview_handlers & filesystem::PreviewText);
 }
 
-TextPreviewData TextPreviewHandler::LoadPreview(
-    const core::Path& path,
-    size_t max_lines,
-    size_t max_line_length) const
+TextPreviewData TextPreviewHandler::LoadPreview(const core::Path& path) const
 {
     TextPreviewData data;
     data.encoding = "UTF-8";  // Assume UTF-8 for now
 
-    std::ifstream file(path.String(), std::ios::binary);
-    if (!file.is_open())
+    auto document = std::make_shared<TextDocument>();
+    if (!document->Open(path))
     {
-        data.error_message = "Failed to open file";
+        data.error_message = document->GetErrorMessage();
         return data;
     }
 
-    // Read file content
-    std::string line;
-    while (std::getline(file, line))
-    {
-        ++data.total_lines;
-
-        if (max_lines > 0 && data.lines.size() >= max_lines)
-        {
-            data.truncated = true;
-            continue;  // Continue counting total lines
-        }
-
-        // Remove trailing carriage return (Windows line endings)
-        if (!line.empty() && line.back() == '\r')
-        {
-            line.pop_back();
-        }
+    Highlight(path, document, data);
+    return data;
+}
 
-        // Truncate long lines
-        if (max_line_length > 0 && line.length() > max_line_length)
-        {
-            line = line.substr(0, max_line_length) + "...";
-        }
+TextPreviewData TextPreviewHandler::LoadPreview(const core::Path& path, std::vector<char> contents) const
+{
+    TextPreviewData data;
+    data.encoding = "UTF-8";  // Assume UTF-8 for now
 
-        // Replace tabs with spaces for display
-        std::string processed_line;
-        processed_line.reserve(line.size());
-        for (char c : line)
-        {
-            if (c == '\t')
-            {
-                processed_line += "    ";  // 4 spaces per tab
-            }
-            else
-            {
-                processed_line += c;
-            }
-        }
+    auto document = std::make_shared<TextDocument>();
+    document->Open(path, std::move(contents));
+    Highlight(path, document, data);
+    return data;
+}
 
-        data.lines.push_back(std::move(processed_line));
+void TextPreviewHandler::Highlight(const core::Path& path, std::shared_ptr<TextDocument> document,
+                                   TextPreviewData& data) const
+{
+    // Extensionless files such as makefiles go by name
+    std::string language = path.Extension();
+    if (!language.empty() && language[0] == '.')
+    {
+        language = language.substr(1);
     }
-
-    if (file.bad())
+    if (language.empty())
     {
-        data.error_message = "Error reading file";
+        language = path.Filename();
+    }
+    std::transform(language.begin(), language.end(), language.begin(),
+        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+    if (SyntaxHighlighter::Supports(language))
+    {
+        data.highlighter = std::make_shared<SyntaxHighlighter>(document, language);
     }
 
-    return data;
+    data.document = std::move(document);
 }
 
 std::vector<std::string> TextPreviewHandler::GetSupportedExtensions() const
@@ -0,0 +1,538 @@
+#include "opacity/preview/TextureManager.h"
+#include "opacity/core/Logger.h"
+
+#define NOMINMAX
+#include <d3d11.h>
+
+#include <algorithm>
+#include <cstring>
+
+namespace opacity::preview
+{
+
+namespace
+{
+    constexpr size_t kBytesPerPixel = 4;    // RGBA
+
+    // The image plus its gutter, edge pixels repeated outwards
+    void WritePadded(uint8_t* target, size_t pitch, const std::vector<uint8_t>& pixels,
+                     int width, int height, int gutter)
+    {
+        size_t row_bytes = static_cast<size_t>(width) * kBytesPerPixel;
+        for (int y = -gutter; y < height + gutter; ++y)
+        {
+            int source_y = std::clamp(y, 0, height - 1);
+            const uint8_t* in = pixels.data() + static_cast<size_t>(source_y) * row_bytes;
+            uint8_t* out = target + static_cast<size_t>(y + gutter) * pitch;
+
+            for (int x = 0; x < gutter; ++x)
+            {
+                std::memcpy(out + x * kBytesPerPixel, in, kBytesPerPixel);
+                std::memcpy(out + (gutter + width + x) * kBytesPerPixel, in + row_bytes - kBytesPerPixel, kBytesPerPixel);
+            }
+            std::memcpy(out + gutter * kBytesPerPixel, in, row_bytes);
+        }
+    }
+
+    bool CreateView(ID3D11Device* device, ID3D11Texture2D* texture, ID3D11ShaderResourceView** view)
+    {
+        D3D11_SHADER_RESOURCE_VIEW_DESC desc = {};
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+        desc.Texture2D.MipLevels = 1;
+        return SUCCEEDED(device->CreateShaderResourceView(texture, &desc, view));
+    }
+}
+
+TextureRegion::TextureRegion(std::vector<uint8_t> pixels, int width, int height, int size_class)
+    : width_(width)
+    , height_(height)
+    , size_class_(size_class)
+    , pixels_(std::move(pixels))
+{
+}
+
+TextureManager::TextureManager()
+{
+}
+
+TextureManager::~TextureManager()
+{
+    Shutdown();
+}
+
+void TextureManager::Initialize(ID3D11Device* device, ID3D11DeviceContext* context)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    device_ = device;
+    context_ = context;
+    if (!device_)
+        return;
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = kStagingSize;
+    desc.Height = kStagingSize;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_STAGING;
+    desc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+    for (auto& staging : staging_)
+    {
+        HRESULT hr = device_->CreateTexture2D(&desc, nullptr, &staging);
+        if (FAILED(hr))
+        {
+            core::Logger::Get()->warn("TextureManager: failed to create staging texture: {}", hr);
+            staging = nullptr;
+        }
+    }
+    core::Logger::Get()->debug("TextureManager initialized");
+}
+
+void TextureManager::Shutdown()
+{
+    std::vector<TexturePtr> waiting;    // Released after the lock; a last reference comes back here
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    for (auto& list : lru_)
+    {
+        while (!list.empty())
+        {
+            TextureRegion* region = list.front();
+            FreeLocked(*region);
+            region->state_.store(TextureRegion::State::Evicted, std::memory_order_release);
+        }
+    }
+
+    for (auto& weak : pending_)
+    {
+        if (auto pointer = weak.lock())
+        {
+            auto& region = const_cast<TextureRegion&>(*pointer);
+            region.pixels_.clear();
+            region.state_.store(TextureRegion::State::Evicted, std::memory_order_release);
+            waiting.push_back(std::move(pointer));
+        }
+    }
+    pending_.clear();
+
+    for (auto& page : pages_)
+    {
+        if (page.view) page.view->Release();
+        if (page.texture) page.texture->Release();
+    }
+    pages_.clear();
+
+    for (auto& staging : staging_)
+    {
+        if (staging)
+        {
+            staging->Release();
+            staging = nullptr;
+        }
+    }
+
+    vram_bytes_ = 0;
+    device_ = nullptr;
+    context_ = nullptr;
+}
+
+TexturePtr TextureManager::Upload(std::vector<uint8_t> pixels, int width, int height)
+{
+    if (width <= 0 || height <= 0 || pixels.size() != static_cast<size_t>(width) * height * kBytesPerPixel)
+        return nullptr;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!device_)
+            return nullptr;
+    }
+
+    auto* region = new TextureRegion(std::move(pixels), width, height, SizeClassFor(width, height));
+    TexturePtr pointer(region, [this](const TextureRegion* released)
+    {
+        Release(const_cast<TextureRegion*>(released));
+    });
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_.push_back(pointer);
+    return pointer;
+}
+
+void TextureManager::Touch(const TextureRegion& region)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!region.IsResident())
+        return;
+
+    auto& touched = const_cast<TextureRegion&>(region);
+    touched.last_used_ = frame_;
+    auto& list = lru_[touched.size_class_];
+    list.splice(list.begin(), list, touched.lru_position_);
+}
+
+void TextureManager::BeginFrame()
+{
+    std::vector<TexturePtr> held;       // Released after the lock; a last reference comes back here
+    std::vector<TextureRegion*> uploaded;
+    std::unique_lock<std::mutex> lock(mutex_);
+    ++frame_;
+    if (!context_ || pending_.empty())
+        return;
+
+    ID3D11Texture2D* staging = staging_[frame_ % kStagingFrames];
+    D3D11_MAPPED_SUBRESOURCE mapped = {};
+    if (!staging || FAILED(context_->Map(staging, 0, D3D11_MAP_WRITE, 0, &mapped)))
+        return;
+
+    // Shelves: left to right, then a new row under the tallest so far
+    std::vector<Copy> copies;
+    size_t bytes = 0;
+    int shelf_x = 0;
+    int shelf_y = 0;
+    int shelf_height = 0;
+
+    while (!pending_.empty())
+    {
+        TexturePtr pointer = pending_.front().lock();
+        if (!pointer)
+        {
+            pending_.pop_front();
+            continue;
+        }
+        auto& region = const_cast<TextureRegion&>(*pointer);
+        held.push_back(std::move(pointer));
+
+        int padded_width = region.width_ + 2 * kGutter;
+        int padded_height = region.height_ + 2 * kGutter;
+        size_t padded_bytes = static_cast<size_t>(padded_width) * padded_height * kBytesPerPixel;
+        if (!copies.empty() && bytes + padded_bytes > upload_budget_)
+            break;
+
+        if (padded_width > kStagingSize || padded_height > kStagingSize)
+        {
+            // Too large to stage: created with its pixels, as this frame's
+            // only upload
+            if (!copies.empty())
+                break;
+            if (!CreateStandaloneLocked(region, true))
+                break;
+            region.pixels_ = std::vector<uint8_t>();
+            uploaded.push_back(&region);
+            pending_.pop_front();
+            break;
+        }
+
+        if (shelf_x + padded_width > kStagingSize)
+        {
+            shelf_x = 0;
+            shelf_y += shelf_height;
+            shelf_height = 0;
+        }
+        if (shelf_y + padded_height > kStagingSize)
+            break;
+
+        // Nothing can be placed while VRAM is full of regions still on
+        // screen; it waits for some to go
+        int x = 0;
+        int y = 0;
+        ID3D11Texture2D* target = nullptr;
+        if (!PlaceLocked(region, x, y, target))
+            break;
+
+        auto* origin = static_cast<uint8_t*>(mapped.pData) + static_cast<size_t>(shelf_y) * mapped.RowPitch +
+                       static_cast<size_t>(shelf_x) * kBytesPerPixel;
+        WritePadded(origin, mapped.RowPitch, region.pixels_, region.width_, region.height_, kGutter);
+
+        if (region.size_class_ == kStandaloneClass)
+            copies.push_back(Copy{target, 0, 0, shelf_x + kGutter, shelf_y + kGutter, region.width_, region.height_});
+        else
+            copies.push_back(Copy{target, x, y, shelf_x, shelf_y, padded_width, padded_height});
+
+        region.pixels_ = std::vector<uint8_t>();
+        uploaded.push_back(&region);
+        pending_.pop_front();
+
+        shelf_x += padded_width;
+        shelf_height = std::max(shelf_height, padded_height);
+        bytes += padded_bytes;
+    }
+
+    context_->Unmap(staging, 0);
+    for (const auto& copy : copies)
+    {
+        D3D11_BOX box = {};
+        box.left = static_cast<UINT>(copy.source_x);
+        box.top = static_cast<UINT>(copy.source_y);
+        box.front = 0;
+        box.right = static_cast<UINT>(copy.source_x + copy.width);
+        box.bottom = static_cast<UINT>(copy.source_y + copy.height);
+        box.back = 1;
+        context_->CopySubresourceRegion(copy.target, 0, copy.x, copy.y, 0, staging, 0, &box);
+    }
+
+    for (TextureRegion* region : uploaded)
+    {
+        region->state_.store(TextureRegion::State::Resident, std::memory_order_release);
+    }
+    lock.unlock();
+}
+
+void TextureManager::SetUploadBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    upload_budget_ = std::min(bytes, static_cast<size_t>(kStagingSize) * kStagingSize * kBytesPerPixel);
+}
+
+void TextureManager::SetVramBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    vram_budget_ = bytes;
+    ReleaseEmptyPagesLocked();
+}
+
+size_t TextureManager::GetVramBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return vram_bytes_;
+}
+
+size_t TextureManager::GetPendingCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return pending_.size();
+}
+
+int TextureManager::SizeClassFor(int width, int height)
+{
+    int edge = std::max(width, height);
+    for (int size_class = 0; size_class < kAtlasClasses; ++size_class)
+    {
+        if (edge <= kCellEdges[size_class])
+            return size_class;
+    }
+    return kStandaloneClass;
+}
+
+bool TextureManager::PlaceLocked(TextureRegion& region, int& x, int& y, ID3D11Texture2D*& target)
+{
+    if (region.size_class_ == kStandaloneClass)
+    {
+        if (!CreateStandaloneLocked(region, false))
+            return false;
+        x = 0;
+        y = 0;
+        target = region.texture_;
+        return true;
+    }
+
+    int size_class = region.size_class_;
+    auto find_page = [&]() -> int
+    {
+        for (size_t i = 0; i < pages_.size(); ++i)
+        {
+            if (pages_[i].texture && pages_[i].size_class == size_class && !pages_[i].free_cells.empty())
+                return static_cast<int>(i);
+        }
+        return -1;
+    };
+
+    int page_index = find_page();
+    if (page_index < 0)
+    {
+        if (!CreatePageLocked(size_class) && !EvictLocked(size_class))
+            return false;
+        page_index = find_page();
+        if (page_index < 0)
+            return false;
+    }
+
+    Page& page = pages_[page_index];
+    int cell = page.free_cells.back();
+    page.free_cells.pop_back();
+    page.used++;
+
+    int cell_size = kCellEdges[size_class] + 2 * kGutter;
+    x = (cell % page.columns) * cell_size;
+    y = (cell / page.columns) * cell_size;
+    target = page.texture;
+
+    float scale = 1.0f / static_cast<float>(kPageSize);
+    region.page_ = page_index;
+    region.cell_ = cell;
+    region.view_ = page.view;
+    region.uv_.u0 = (x + kGutter) * scale;
+    region.uv_.v0 = (y + kGutter) * scale;
+    region.uv_.u1 = (x + kGutter + region.width_) * scale;
+    region.uv_.v1 = (y + kGutter + region.height_) * scale;
+
+    region.last_used_ = frame_;
+    auto& list = lru_[size_class];
+    list.push_front(&region);
+    region.lru_position_ = list.begin();
+    return true;
+}
+
+bool TextureManager::CreatePageLocked(int size_class)
+{
+    size_t bytes = static_cast<size_t>(kPageSize) * kPageSize * kBytesPerPixel;
+    if (vram_bytes_ + bytes > vram_budget_)
+    {
+        ReleaseEmptyPagesLocked();
+        if (vram_bytes_ + bytes > vram_budget_)
+            return false;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = kPageSize;
+    desc.Height = kPageSize;
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    Page page;
+    HRESULT hr = device_->CreateTexture2D(&desc, nullptr, &page.texture);
+    if (FAILED(hr) || !CreateView(device_, page.texture, &page.view))
+    {
+        core::Logger::Get()->warn("TextureManager: failed to create atlas page: {}", hr);
+        if (page.texture) page.texture->Release();
+        return false;
+    }
+
+    page.size_class = size_class;
+    page.columns = kPageSize / (kCellEdges[size_class] + 2 * kGutter);
+    int cells = page.columns * page.columns;
+    page.free_cells.reserve(cells);
+    for (int cell = cells - 1; cell >= 0; --cell)
+    {
+        page.free_cells.push_back(cell);    // Filled from the top left
+    }
+
+    auto hole = std::find_if(pages_.begin(), pages_.end(), [](const Page& p) { return p.texture == nullptr; });
+    if (hole != pages_.end())
+        *hole = std::move(page);
+    else
+        pages_.push_back(std::move(page));
+
+    vram_bytes_ += bytes;
+    OPACITY_LOG_DEBUG(Preview, "TextureManager: atlas page for {}px cells, {} bytes of VRAM in use",
+                               kCellEdges[size_class], vram_bytes_);
+    return true;
+}
+
+bool TextureManager::CreateStandaloneLocked(TextureRegion& region, bool with_pixels)
+{
+    size_t bytes = static_cast<size_t>(region.width_) * region.height_ * kBytesPerPixel;
+    while (vram_bytes_ + bytes > vram_budget_)
+    {
+        if (EvictLocked(kStandaloneClass))
+            continue;
+        ReleaseEmptyPagesLocked();
+        if (vram_bytes_ + bytes > vram_budget_)
+            return false;
+    }
+
+    D3D11_TEXTURE2D_DESC desc = {};
+    desc.Width = static_cast<UINT>(region.width_);
+    desc.Height = static_cast<UINT>(region.height_);
+    desc.MipLevels = 1;
+    desc.ArraySize = 1;
+    desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+    desc.SampleDesc.Count = 1;
+    desc.Usage = D3D11_USAGE_DEFAULT;
+    desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+    D3D11_SUBRESOURCE_DATA init_data = {};
+    init_data.pSysMem = region.pixels_.data();
+    init_data.SysMemPitch = static_cast<UINT>(region.width_ * kBytesPerPixel);
+
+    HRESULT hr = device_->CreateTexture2D(&desc, with_pixels ? &init_data : nullptr, &region.texture_);
+    if (FAILED(hr) || !CreateView(device_, region.texture_, &region.view_))
+    {
+        core::Logger::Get()->warn("TextureManager: failed to create texture: {}", hr);
+        if (region.texture_) region.texture_->Release();
+        region.texture_ = nullptr;
+        region.view_ = nullptr;
+        return false;
+    }
+
+    region.uv_ = TextureUv{};
+    region.last_used_ = frame_;
+    auto& list = lru_[kStandaloneClass];
+    list.push_front(&region);
+    region.lru_position_ = list.begin();
+    vram_bytes_ += bytes;
+    return true;
+}
+
+bool TextureManager::EvictLocked(int size_class)
+{
+    auto& list = lru_[size_class];
+    if (list.empty())
+        return false;
+
+    // Drawn this frame or the last: its pixels may still be on screen
+    TextureRegion* oldest = list.back();
+    if (oldest->last_used_ + 1 >= frame_)
+        return false;
+
+    FreeLocked(*oldest);
+    oldest->state_.store(TextureRegion::State::Evicted, std::memory_order_release);
+    return true;
+}
+
+void TextureManager::ReleaseEmptyPagesLocked()
+{
+    for (auto& page : pages_)
+    {
+        if (page.texture && page.used == 0)
+        {
+            page.view->Release();
+            page.texture->Release();
+            page = Page{};
+            vram_bytes_ -= static_cast<size_t>(kPageSize) * kPageSize * kBytesPerPixel;
+        }
+    }
+}
+
+void TextureManager::FreeLocked(TextureRegion& region)
+{
+    bool placed = region.page_ >= 0 || region.texture_ != nullptr;
+    if (!placed)
+        return;
+
+    lru_[region.size_class_].erase(region.lru_position_);
+
+    if (region.page_ >= 0)
+    {
+        Page& page = pages_[region.page_];
+        page.free_cells.push_back(region.cell_);
+        page.used--;
+        region.page_ = -1;
+        region.cell_ = -1;
+    }
+    else
+    {
+        region.view_->Release();
+        region.texture_->Release();
+        region.texture_ = nullptr;
+        vram_bytes_ -= static_cast<size_t>(region.width_) * region.height_ * kBytesPerPixel;
+    }
+    region.view_ = nullptr;
+}
+
+void TextureManager::Release(TextureRegion* region)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        FreeLocked(*region);
+    }
+    delete region;
+}
+
+} // namespace opacity::preview
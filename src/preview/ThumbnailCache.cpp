@@ -0,0 +1,420 @@
+#include "opacity/preview/ThumbnailCache.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/Logger.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <functional>
+#include <utility>
+
+namespace opacity::preview
+{
+
+namespace
+{
+    constexpr uint32_t kDataMagic = 0x48545043;     // "CPTH"
+    constexpr uint32_t kIndexMagic = 0x58495443;    // "CTIX"
+    constexpr uint32_t kRecordMagic = 0x43455254;   // "TREC"
+    constexpr uint32_t kVersion = 1;
+
+    // Stores between index writes; anything newer is found by scanning
+    constexpr size_t kIndexInterval = 256;
+
+    struct FileHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+    };
+
+    struct RecordHeader
+    {
+        uint32_t magic;
+        uint32_t length;
+        uint32_t edge;
+        uint32_t checksum;
+        uint64_t volume;
+        uint64_t file_id;
+        int64_t modified;
+        uint64_t size;
+    };
+
+    struct IndexHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t covered;       // Length of the data file when written
+        uint64_t count;
+    };
+
+    struct IndexRecord
+    {
+        uint64_t volume;
+        uint64_t file_id;
+        int64_t modified;
+        uint64_t size;
+        uint64_t offset;
+        uint32_t length;
+        uint32_t edge;
+        uint32_t checksum;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(RecordHeader) == 48, "record header is written as is");
+    static_assert(sizeof(IndexRecord) == 56, "index record is written as is");
+
+    uint32_t Checksum(const uint8_t* data, size_t length)
+    {
+        core::Xxh64 hash;
+        hash.Update(data, length);
+        return static_cast<uint32_t>(hash.Digest());
+    }
+
+    template <typename T>
+    bool ReadRaw(std::istream& stream, T& value)
+    {
+        return static_cast<bool>(stream.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    template <typename T>
+    void WriteRaw(std::ostream& stream, const T& value)
+    {
+        stream.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+}
+
+size_t ThumbnailCache::SlotHash::operator()(const Slot& slot) const
+{
+    size_t hash = std::hash<uint64_t>{}(slot.file_id);
+    hash ^= std::hash<uint64_t>{}(slot.volume) + 0x9E3779B97F4A7C15ULL + (hash << 6) + (hash >> 2);
+    return hash ^ slot.edge;
+}
+
+ThumbnailCache::ThumbnailCache(core::Path directory, uint64_t max_bytes)
+    : directory_(std::move(directory))
+    , max_bytes_(max_bytes)
+{
+}
+
+ThumbnailCache::~ThumbnailCache()
+{
+    Flush();
+}
+
+bool ThumbnailCache::Open()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_)
+        return true;
+
+    std::error_code ec;
+    std::filesystem::create_directories(directory_.Get(), ec);
+
+    auto data_path = (directory_ / "thumbnails.dat").Get();
+    uint64_t file_size = std::filesystem::file_size(data_path, ec);
+    if (ec)
+        file_size = 0;
+
+    FileHeader header{};
+    if (file_size >= sizeof(FileHeader))
+    {
+        std::ifstream file(data_path, std::ios::binary);
+        if (!ReadRaw(file, header))
+            header = {};
+    }
+
+    uint64_t end = sizeof(FileHeader);
+    if (header.magic == kDataMagic && header.version == kVersion)
+    {
+        uint64_t covered = sizeof(FileHeader);
+        if (!LoadIndexLocked(covered) || covered > file_size)
+        {
+            entries_.clear();
+            live_bytes_ = 0;
+            covered = sizeof(FileHeader);
+        }
+
+        end = ScanLocked(covered, file_size);
+        if (end < file_size)
+        {
+            // A record torn by a crash; the next one goes in its place
+            std::filesystem::resize_file(data_path, end, ec);
+            if (ec)
+                return false;
+        }
+    }
+    else
+    {
+        // New or unreadable: start over, and forget an index of the old file
+        std::filesystem::remove((directory_ / "thumbnails.idx").Get(), ec);
+        std::ofstream file(data_path, std::ios::binary | std::ios::trunc);
+        WriteRaw(file, FileHeader{kDataMagic, kVersion});
+        if (!file)
+        {
+            core::Logger::Get()->warn("Thumbnail cache unavailable: cannot write {}", directory_.String());
+            return false;
+        }
+    }
+
+    end_ = end;
+    if (!OpenDataLocked())
+        return false;
+    open_ = true;
+
+    if (end_ > max_bytes_ || end_ - sizeof(FileHeader) - live_bytes_ > end_ / 2)
+        CompactLocked();
+
+    core::Logger::Get()->debug("Thumbnail cache opened: {} thumbnails, {} bytes", entries_.size(), end_);
+    return true;
+}
+
+bool ThumbnailCache::Find(const ThumbnailKey& key, std::vector<uint8_t>& encoded)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_)
+        return false;
+
+    auto it = entries_.find(Slot{key.volume, key.file_id, key.edge});
+    if (it == entries_.end() || it->second.modified != key.modified || it->second.size != key.size)
+        return false;
+
+    const Entry& entry = it->second;
+    encoded.resize(entry.length);
+    data_.seekg(static_cast<std::streamoff>(entry.offset));
+    if (!data_.read(reinterpret_cast<char*>(encoded.data()), entry.length) ||
+        Checksum(encoded.data(), encoded.size()) != entry.checksum)
+    {
+        data_.clear();
+        live_bytes_ -= sizeof(RecordHeader) + entry.length;
+        entries_.erase(it);
+        encoded.clear();
+        return false;
+    }
+    return true;
+}
+
+bool ThumbnailCache::Store(const ThumbnailKey& key, const uint8_t* encoded, size_t length)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!open_ || length == 0 || length > UINT32_MAX)
+        return false;
+
+    RecordHeader header{};
+    header.magic = kRecordMagic;
+    header.length = static_cast<uint32_t>(length);
+    header.edge = key.edge;
+    header.checksum = Checksum(encoded, length);
+    header.volume = key.volume;
+    header.file_id = key.file_id;
+    header.modified = key.modified;
+    header.size = key.size;
+
+    data_.seekp(static_cast<std::streamoff>(end_));
+    WriteRaw(data_, header);
+    data_.write(reinterpret_cast<const char*>(encoded), static_cast<std::streamsize>(length));
+    if (!data_)
+    {
+        data_.clear();
+        return false;
+    }
+
+    InsertLocked(Slot{key.volume, key.file_id, key.edge},
+                 Entry{key.modified, key.size, end_ + sizeof(RecordHeader), header.length, header.checksum});
+    end_ += sizeof(RecordHeader) + length;
+
+    if (end_ > max_bytes_)
+        CompactLocked();
+    else if (++unindexed_ >= kIndexInterval)
+        WriteIndexLocked();
+    return true;
+}
+
+void ThumbnailCache::Flush()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (open_ && unindexed_ > 0)
+        WriteIndexLocked();
+}
+
+size_t ThumbnailCache::GetEntryCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return entries_.size();
+}
+
+uint64_t ThumbnailCache::GetFileBytes() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return end_;
+}
+
+void ThumbnailCache::InsertLocked(const Slot& slot, const Entry& entry)
+{
+    auto [it, inserted] = entries_.try_emplace(slot, entry);
+    if (!inserted)
+    {
+        live_bytes_ -= sizeof(RecordHeader) + it->second.length;
+        it->second = entry;
+    }
+    live_bytes_ += sizeof(RecordHeader) + entry.length;
+}
+
+bool ThumbnailCache::LoadIndexLocked(uint64_t& covered)
+{
+    std::ifstream file((directory_ / "thumbnails.idx").Get(), std::ios::binary);
+    IndexHeader header{};
+    if (!ReadRaw(file, header) || header.magic != kIndexMagic || header.version != kVersion)
+        return false;
+
+    for (uint64_t i = 0; i < header.count; ++i)
+    {
+        IndexRecord record{};
+        if (!ReadRaw(file, record) || record.offset + record.length > header.covered)
+            return false;
+        InsertLocked(Slot{record.volume, record.file_id, record.edge},
+                     Entry{record.modified, record.size, record.offset, record.length, record.checksum});
+    }
+
+    covered = header.covered;
+    return true;
+}
+
+uint64_t ThumbnailCache::ScanLocked(uint64_t from, uint64_t file_size)
+{
+    std::ifstream file((directory_ / "thumbnails.dat").Get(), std::ios::binary);
+    file.seekg(static_cast<std::streamoff>(from));
+
+    std::vector<uint8_t> payload;
+    uint64_t position = from;
+    while (position + sizeof(RecordHeader) <= file_size)
+    {
+        RecordHeader header{};
+        if (!ReadRaw(file, header) || header.magic != kRecordMagic ||
+            position + sizeof(RecordHeader) + header.length > file_size)
+            break;
+
+        payload.resize(header.length);
+        if (!file.read(reinterpret_cast<char*>(payload.data()), header.length) ||
+            Checksum(payload.data(), payload.size()) != header.checksum)
+            break;
+
+        InsertLocked(Slot{header.volume, header.file_id, header.edge},
+                     Entry{header.modified, header.size, position + sizeof(RecordHeader), header.length, header.checksum});
+        position += sizeof(RecordHeader) + header.length;
+        ++unindexed_;
+    }
+    return position;
+}
+
+bool ThumbnailCache::OpenDataLocked()
+{
+    data_.open((directory_ / "thumbnails.dat").Get(), std::ios::in | std::ios::out | std::ios::binary);
+    if (!data_.is_open())
+    {
+        core::Logger::Get()->warn("Thumbnail cache unavailable: cannot open {}", directory_.String());
+        return false;
+    }
+    return true;
+}
+
+void ThumbnailCache::WriteIndexLocked()
+{
+    data_.flush();
+
+    auto index_path = (directory_ / "thumbnails.idx").Get();
+    auto temp_path = (directory_ / "thumbnails.idx.tmp").Get();
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        WriteRaw(file, IndexHeader{kIndexMagic, kVersion, end_, entries_.size()});
+        for (const auto& [slot, entry] : entries_)
+        {
+            WriteRaw(file, IndexRecord{slot.volume, slot.file_id, entry.modified, entry.size,
+                                       entry.offset, entry.length, slot.edge, entry.checksum, 0});
+        }
+        if (!file)
+            return;
+    }
+
+    std::error_code ec;
+    std::filesystem::rename(temp_path, index_path, ec);
+    if (!ec)
+        unindexed_ = 0;
+}
+
+void ThumbnailCache::CompactLocked()
+{
+    // Newest records are kept first, down to three quarters of the budget
+    // so the next compaction is a while off
+    std::vector<std::pair<Slot, Entry>> keep(entries_.begin(), entries_.end());
+    std::sort(keep.begin(), keep.end(), [](const auto& a, const auto& b)
+    {
+        return a.second.offset > b.second.offset;
+    });
+
+    uint64_t target = max_bytes_ / 4 * 3;
+    uint64_t kept_bytes = sizeof(FileHeader);
+    size_t count = 0;
+    while (count < keep.size() && kept_bytes + sizeof(RecordHeader) + keep[count].second.length <= target)
+    {
+        kept_bytes += sizeof(RecordHeader) + keep[count].second.length;
+        ++count;
+    }
+    keep.resize(count);
+    std::reverse(keep.begin(), keep.end());     // Back to oldest first
+
+    auto data_path = (directory_ / "thumbnails.dat").Get();
+    auto temp_path = (directory_ / "thumbnails.dat.tmp").Get();
+    std::unordered_map<Slot, Entry, SlotHash> compacted;
+    uint64_t position = sizeof(FileHeader);
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        WriteRaw(file, FileHeader{kDataMagic, kVersion});
+
+        std::vector<uint8_t> payload;
+        for (auto& [slot, entry] : keep)
+        {
+            payload.resize(entry.length);
+            data_.seekg(static_cast<std::streamoff>(entry.offset));
+            if (!data_.read(reinterpret_cast<char*>(payload.data()), entry.length))
+            {
+                data_.clear();
+                continue;
+            }
+
+            WriteRaw(file, RecordHeader{kRecordMagic, entry.length, slot.edge, entry.checksum,
+                                        slot.volume, slot.file_id, entry.modified, entry.size});
+            file.write(reinterpret_cast<const char*>(payload.data()), entry.length);
+
+            entry.offset = position + sizeof(RecordHeader);
+            compacted.emplace(slot, entry);
+            position += sizeof(RecordHeader) + entry.length;
+        }
+        if (!file)
+        {
+            std::error_code ec;
+            std::filesystem::remove(temp_path, ec);
+            return;
+        }
+    }
+
+    core::Logger::Get()->info("Thumbnail cache compacted from {} to {} bytes ({} of {} thumbnails kept)",
+                              end_, position, compacted.size(), entries_.size());
+
+    data_.close();
+    std::error_code ec;
+    std::filesystem::rename(temp_path, data_path, ec);
+    if (ec)
+    {
+        std::filesystem::remove(temp_path, ec);
+        open_ = OpenDataLocked();
+        return;
+    }
+
+    entries_ = std::move(compacted);
+    end_ = position;
+    live_bytes_ = position - sizeof(FileHeader);
+    open_ = OpenDataLocked();
+    if (open_)
+        WriteIndexLocked();
+}
+
+} // namespace opacity::preview
@@ -0,0 +1,599 @@
+#include "opacity/preview/ThumbnailService.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/Hash.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/StartupProfile.h"
+#include "opacity/filesystem/CloudIntegration.h"
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <ShlObj.h>
+#include <wincodec.h>
+
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+
+namespace opacity::preview
+{
+
+namespace
+{
+    constexpr size_t kThumbnailWorkers = 2;
+
+    // While the user scrolls or a copy runs, wait this long after input
+    // before decoding, but never longer than kMaxPause per thumbnail
+    constexpr std::chrono::milliseconds kInputGrace{150};
+    constexpr std::chrono::milliseconds kMaxPause{1000};
+
+    // Requests past this many are the ones furthest from view
+    constexpr size_t kMaxQueued = 512;
+
+    constexpr float kJpegQuality = 0.85f;
+
+    // File id, modification time and size from one handle open; opening
+    // for attributes only never recalls a cloud placeholder
+    bool ReadKey(const core::Path& path, ThumbnailKey& key, DWORD& attributes)
+    {
+        HANDLE handle = CreateFileW(path.WString().c_str(), FILE_READ_ATTRIBUTES,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr,
+                                    OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if (handle == INVALID_HANDLE_VALUE)
+            return false;
+
+        BY_HANDLE_FILE_INFORMATION info;
+        BOOL ok = GetFileInformationByHandle(handle, &info);
+        CloseHandle(handle);
+        if (!ok)
+            return false;
+
+        key.volume = info.dwVolumeSerialNumber;
+        key.file_id = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+        if (key.file_id == 0)
+        {
+            // Some network file systems report no ids; the path will do
+            std::wstring text = path.WString();
+            core::Xxh64 hash;
+            hash.Update(text.data(), text.size() * sizeof(wchar_t));
+            key.volume = 0;
+            key.file_id = hash.Digest();
+        }
+        key.modified = static_cast<int64_t>((static_cast<uint64_t>(info.ftLastWriteTime.dwHighDateTime) << 32) |
+                                            info.ftLastWriteTime.dwLowDateTime);
+        key.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+        attributes = info.dwFileAttributes;
+        return true;
+    }
+
+    bool IsOpaque(const std::vector<uint8_t>& pixels)
+    {
+        for (size_t i = 3; i < pixels.size(); i += 4)
+        {
+            if (pixels[i] != 255)
+                return false;
+        }
+        return true;
+    }
+
+    // JPEG keeps photos small; PNG keeps the transparency of icons
+    bool Encode(IWICImagingFactory* factory, const std::vector<uint8_t>& pixels, int width, int height,
+                std::vector<uint8_t>& encoded)
+    {
+        bool opaque = IsOpaque(pixels);
+
+        IWICStream* stream = nullptr;
+        IWICBitmapEncoder* encoder = nullptr;
+        IWICBitmapFrameEncode* frame = nullptr;
+        IPropertyBag2* options = nullptr;
+        IWICBitmap* bitmap = nullptr;
+        IWICFormatConverter* converter = nullptr;
+
+        // Room for an incompressible PNG; trimmed to what was written
+        encoded.resize(pixels.size() + pixels.size() / 8 + 4096);
+
+        HRESULT hr = factory->CreateStream(&stream);
+        if (SUCCEEDED(hr))
+            hr = stream->InitializeFromMemory(encoded.data(), static_cast<DWORD>(encoded.size()));
+        if (SUCCEEDED(hr))
+            hr = factory->CreateEncoder(opaque ? GUID_ContainerFormatJpeg : GUID_ContainerFormatPng, nullptr, &encoder);
+        if (SUCCEEDED(hr))
+            hr = encoder->Initialize(stream, WICBitmapEncoderNoCache);
+        if (SUCCEEDED(hr))
+            hr = encoder->CreateNewFrame(&frame, &options);
+        if (SUCCEEDED(hr) && opaque)
+        {
+            PROPBAG2 option = {};
+            option.pstrName = const_cast<LPOLESTR>(L"ImageQuality");
+            VARIANT value;
+            VariantInit(&value);
+            value.vt = VT_R4;
+            value.fltVal = kJpegQuality;
+            hr = options->Write(1, &option, &value);
+        }
+        if (SUCCEEDED(hr))
+            hr = frame->Initialize(options);
+        if (SUCCEEDED(hr))
+            hr = frame->SetSize(static_cast<UINT>(width), static_cast<UINT>(height));
+
+        // The encoder answers with the nearest format it takes (24bpp BGR
+        // for JPEG); convert to exactly that
+        WICPixelFormatGUID format = GUID_WICPixelFormat32bppRGBA;
+        if (SUCCEEDED(hr))
+            hr = frame->SetPixelFormat(&format);
+        if (SUCCEEDED(hr))
+            hr = factory->CreateBitmapFromMemory(static_cast<UINT>(width), static_cast<UINT>(height),
+                                                 GUID_WICPixelFormat32bppRGBA, static_cast<UINT>(width) * 4,
+                                                 static_cast<UINT>(pixels.size()), const_cast<BYTE*>(pixels.data()),
+                                                 &bitmap);
+        if (SUCCEEDED(hr))
+            hr = factory->CreateFormatConverter(&converter);
+        if (SUCCEEDED(hr))
+            hr = converter->Initialize(bitmap, format, WICBitmapDitherTypeNone, nullptr, 0.0, WICBitmapPaletteTypeCustom);
+        if (SUCCEEDED(hr))
+            hr = frame->WriteSource(converter, nullptr);
+        if (SUCCEEDED(hr))
+            hr = frame->Commit();
+        if (SUCCEEDED(hr))
+            hr = encoder->Commit();
+
+        ULARGE_INTEGER written = {};
+        if (SUCCEEDED(hr))
+        {
+            LARGE_INTEGER zero = {};
+            hr = stream->Seek(zero, STREAM_SEEK_CUR, &written);
+        }
+
+        if (converter) converter->Release();
+        if (bitmap) bitmap->Release();
+        if (options) options->Release();
+        if (frame) frame->Release();
+        if (encoder) encoder->Release();
+        if (stream) stream->Release();
+
+        if (FAILED(hr))
+        {
+            encoded.clear();
+            return false;
+        }
+        encoded.resize(static_cast<size_t>(written.QuadPart));
+        return true;
+    }
+
+    bool Decode(IWICImagingFactory* factory, std::vector<uint8_t>& encoded,
+                std::vector<uint8_t>& pixels, int& width, int& height)
+    {
+        IWICStream* stream = nullptr;
+        IWICBitmapDecoder* decoder = nullptr;
+        IWICBitmapFrameDecode* frame = nullptr;
+        IWICFormatConverter* converter = nullptr;
+
+        UINT frame_width = 0;
+        UINT frame_height = 0;
+
+        HRESULT hr = factory->CreateStream(&stream);
+        if (SUCCEEDED(hr))
+            hr = stream->InitializeFromMemory(encoded.data(), static_cast<DWORD>(encoded.size()));
+        if (SUCCEEDED(hr))
+            hr = factory->CreateDecoderFromStream(stream, nullptr, WICDecodeMetadataCacheOnDemand, &decoder);
+        if (SUCCEEDED(hr))
+            hr = decoder->GetFrame(0, &frame);
+        if (SUCCEEDED(hr))
+            hr = frame->GetSize(&frame_width, &frame_height);
+        if (SUCCEEDED(hr))
+            hr = factory->CreateFormatConverter(&converter);
+        if (SUCCEEDED(hr))
+            hr = converter->Initialize(frame, GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeNone,
+                                       nullptr, 0.0, WICBitmapPaletteTypeCustom);
+        if (SUCCEEDED(hr))
+        {
+            UINT stride = frame_width * 4;
+            pixels.resize(static_cast<size_t>(stride) * frame_height);
+            hr = converter->CopyPixels(nullptr, stride, static_cast<UINT>(pixels.size()), pixels.data());
+        }
+
+        if (converter) converter->Release();
+        if (frame) frame->Release();
+        if (decoder) decoder->Release();
+        if (stream) stream->Release();
+
+        if (FAILED(hr))
+        {
+            pixels.clear();
+            return false;
+        }
+        width = static_cast<int>(frame_width);
+        height = static_cast<int>(frame_height);
+        return true;
+    }
+
+    std::string LowerExtension(const core::Path& path)
+    {
+        std::string ext = path.Extension();
+        if (!ext.empty() && ext[0] == '.')
+        {
+            ext = ext.substr(1);
+        }
+        std::transform(ext.begin(), ext.end(), ext.begin(),
+            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        return ext;
+    }
+}
+
+ThumbnailService::ThumbnailService(core::Path cache_directory)
+    : cache_(std::move(cache_directory))
+{
+    governed_ = core::MemoryGovernor::Get().Register(
+        "Thumbnails",
+        [this]
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            return memory_bytes_;
+        },
+        [this](size_t target_bytes)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            EvictLocked(target_bytes);
+        });
+}
+
+ThumbnailService::~ThumbnailService()
+{
+    Shutdown();
+}
+
+void ThumbnailService::Initialize(TextureManager* textures)
+{
+    if (!workers_.empty() || stop_)
+        return;
+
+    textures_ = textures;
+    media_handler_.Initialize(nullptr);     // Pixels only; textures are made here
+
+    for (size_t i = 0; i < kThumbnailWorkers; ++i)
+    {
+        workers_.emplace_back(&ThumbnailService::WorkerLoop, this);
+    }
+    core::Logger::Get()->debug("ThumbnailService initialized");
+}
+
+void ThumbnailService::Shutdown()
+{
+    governed_.Reset();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stop_ = true;
+    }
+    wake_.notify_all();
+    for (auto& worker : workers_)
+    {
+        worker.join();
+    }
+    workers_.clear();
+
+    Clear();
+    queued_.clear();
+    cache_.Flush();
+}
+
+core::Path ThumbnailService::DefaultCacheDirectory()
+{
+    std::filesystem::path base;
+    PWSTR path = nullptr;
+    if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &path)) && path)
+    {
+        base = path;
+    }
+    else
+    {
+        std::error_code ec;
+        base = std::filesystem::temp_directory_path(ec);
+    }
+    CoTaskMemFree(path);
+    return core::Path(base / "Opacity" / "Thumbnails");
+}
+
+int ThumbnailService::EdgeFor(float pixels)
+{
+    if (pixels <= kSmallEdge)
+        return kSmallEdge;
+    if (pixels <= kMediumEdge)
+        return kMediumEdge;
+    return kLargeEdge;
+}
+
+bool ThumbnailService::CanThumbnail(const core::Path& path) const
+{
+    std::string ext = LowerExtension(path);
+    return image_handler_.CanHandle(path, ext) ||
+           media_handler_.GetMediaType(ext) == MediaType::Video ||
+           document_handler_.CanHandle(path, ext);
+}
+
+ThumbnailPtr ThumbnailService::Get(const core::Path& path, std::chrono::system_clock::time_point modified, int edge,
+                                   int priority)
+{
+    std::string key = path.String() + '|' + std::to_string(modified.time_since_epoch().count()) + '|' +
+                      std::to_string(edge);
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = memory_index_.find(key);
+    if (it != memory_index_.end())
+    {
+        const TexturePtr& texture = it->second->thumbnail->texture;
+        if (!texture || !texture->IsEvicted())
+        {
+            if (texture && textures_)
+            {
+                textures_->Touch(*texture);
+            }
+            memory_.splice(memory_.begin(), memory_, it->second);
+            return it->second->thumbnail;
+        }
+
+        // Its atlas cell went to something drawn more recently; the disk
+        // cache has it, so it comes back in a frame or two
+        memory_bytes_ -= it->second->bytes;
+        memory_.erase(it->second);
+        memory_index_.erase(it);
+    }
+
+    auto queued = queued_.find(key);
+    if (queued != queued_.end())
+    {
+        // Still wanted, and as near as it is now
+        if (queued->second != queue_.end())
+        {
+            queued->second->priority = priority;
+            queued->second->frame = frame_;
+        }
+        return nullptr;
+    }
+    if (workers_.empty())
+        return nullptr;
+
+    queue_.push_front(Job{key, path, edge, priority, frame_});
+    queued_.emplace(std::move(key), queue_.begin());
+    if (queue_.size() > kMaxQueued)
+    {
+        // The oldest of those furthest away
+        auto furthest = std::prev(queue_.end());
+        for (auto it = queue_.rbegin(); it != queue_.rend(); ++it)
+        {
+            if (it->priority > furthest->priority)
+                furthest = std::prev(it.base());
+        }
+        queued_.erase(furthest->key);
+        queue_.erase(furthest);
+    }
+    wake_.notify_one();
+    return nullptr;
+}
+
+void ThumbnailService::BeginFrame()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (auto it = queue_.begin(); it != queue_.end();)
+    {
+        if (it->frame < frame_)
+        {
+            queued_.erase(it->key);
+            it = queue_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+    ++frame_;
+}
+
+void ThumbnailService::SetMemoryBudget(size_t bytes)
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    memory_budget_ = bytes;
+    EvictLocked(memory_budget_);
+}
+
+void ThumbnailService::Clear()
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    for (const auto& job : queue_)
+    {
+        queued_.erase(job.key);
+    }
+    queue_.clear();
+    memory_.clear();
+    memory_index_.clear();
+    memory_bytes_ = 0;
+}
+
+size_t ThumbnailService::GetQueuedCount() const
+{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return queued_.size();
+}
+
+void ThumbnailService::WorkerLoop()
+{
+    core::Profiler::SetThreadName("Thumbnails");
+    // Background mode lowers I/O and memory priority along with CPU
+    // priority, so thumbnails never hold up listings or copies. Pauses
+    // are kept short: the user is usually waiting on these
+    core::BackgroundPolicy policy;
+    policy.input_grace = kInputGrace;
+    policy.max_pause = kMaxPause;
+    core::BackgroundScope background(policy);
+
+    HRESULT co = CoInitializeEx(nullptr, COINIT_MULTITHREADED);
+    IWICImagingFactory* factory = nullptr;
+    if (FAILED(CoCreateInstance(CLSID_WICImagingFactory, nullptr, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(&factory))))
+    {
+        core::Logger::Get()->warn("ThumbnailService: WIC unavailable, thumbnails will not be cached");
+        factory = nullptr;
+    }
+
+    // Reading the cache index is left to the workers, off the startup path;
+    // the first to get here opens it and the rest wait for that
+    std::call_once(cache_opened_, [this]()
+    {
+        OPACITY_STARTUP_PHASE("Thumbnail cache", false);
+        cache_.Open();
+    });
+
+    while (true)
+    {
+        Job job;
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            wake_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+            if (stop_)
+                break;
+
+            // Nearest to view first, the newest among equals
+            auto next = queue_.begin();
+            for (auto it = std::next(next); it != queue_.end(); ++it)
+            {
+                if (it->priority < next->priority)
+                    next = it;
+            }
+            job = std::move(*next);
+            queue_.erase(next);
+            queued_[job.key] = queue_.end();
+        }
+
+        background.Yield();
+        ThumbnailPtr thumbnail = Generate(factory, job);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (queued_.erase(job.key) > 0)
+        {
+            StoreLocked(job.key, thumbnail);
+        }
+    }
+
+    if (factory)
+        factory->Release();
+    if (SUCCEEDED(co))
+        CoUninitialize();
+}
+
+ThumbnailPtr ThumbnailService::Generate(IWICImagingFactory* factory, const Job& job)
+{
+    OPACITY_PROFILE_ZONE("ThumbnailService::Generate");
+    ThumbnailKey key;
+    DWORD attributes = 0;
+    if (!ReadKey(job.path, key, attributes))
+        return std::make_shared<const Thumbnail>();
+    key.edge = static_cast<uint32_t>(job.edge);
+
+    std::vector<uint8_t> encoded;
+    std::vector<uint8_t> pixels;
+    int width = 0;
+    int height = 0;
+    static auto& disk_hits = core::Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                             {{"cache", "thumbnail_disk"}, {"result", "hit"}});
+    static auto& disk_misses = core::Metrics::Get().GetCounter("opacity_cache_lookups_total",
+                                                               {{"cache", "thumbnail_disk"}, {"result", "miss"}});
+    if (factory && cache_.Find(key, encoded) && Decode(factory, encoded, pixels, width, height))
+    {
+        disk_hits.Add();
+        return Upload(std::move(pixels), width, height);
+    }
+    disk_misses.Add();
+
+    // A thumbnail made before the file went online-only is still shown
+    // above; making one now would download it
+    if (filesystem::CloudIntegration::ShouldSkipRead(attributes))
+        return std::make_shared<const Thumbnail>();
+
+    if (!Render(job, pixels, width, height))
+        return std::make_shared<const Thumbnail>();
+
+    if (factory && Encode(factory, pixels, width, height, encoded))
+    {
+        cache_.Store(key, encoded.data(), encoded.size());
+    }
+    return Upload(std::move(pixels), width, height);
+}
+
+bool ThumbnailService::Render(const Job& job, std::vector<uint8_t>& pixels, int& width, int& height) const
+{
+    std::string ext = LowerExtension(job.path);
+
+    if (image_handler_.CanHandle(job.path, ext))
+    {
+        ImagePreviewData data = image_handler_.LoadPreview(job.path, job.edge);
+        if (!data.loaded || data.pixels.empty())
+            return false;
+        pixels = std::move(data.pixels);
+        width = data.width;
+        height = data.height;
+        return true;
+    }
+
+    if (media_handler_.GetMediaType(ext) == MediaType::Video)
+    {
+        auto frames = media_handler_.ExtractThumbnails(job.path, 1, job.edge);
+        if (frames.empty() || frames[0].pixels.empty())
+            return false;
+        pixels = std::move(frames[0].pixels);
+        width = frames[0].width;
+        height = frames[0].height;
+        return true;
+    }
+
+    if (document_handler_.CanHandle(job.path, ext))
+    {
+        DocumentThumbnail page = document_handler_.ExtractPageThumbnail(job.path, 1, job.edge);
+        if (page.pixels.empty())
+            return false;
+        pixels = std::move(page.pixels);
+        width = page.width;
+        height = page.height;
+        return true;
+    }
+
+    return false;
+}
+
+ThumbnailPtr ThumbnailService::Upload(std::vector<uint8_t> pixels, int width, int height) const
+{
+    // Copied into an atlas page on the UI thread, a few per frame
+    auto thumbnail = std::make_shared<Thumbnail>();
+    if (textures_)
+    {
+        thumbnail->texture = textures_->Upload(std::move(pixels), width, height);
+    }
+    if (thumbnail->texture)
+    {
+        thumbnail->width = width;
+        thumbnail->height = height;
+    }
+    return thumbnail;
+}
+
+void ThumbnailService::StoreLocked(const std::string& key, const ThumbnailPtr& thumbnail)
+{
+    size_t bytes = sizeof(Thumbnail) + key.size() +
+                   static_cast<size_t>(thumbnail->width) * thumbnail->height * 4;     // RGBA
+    memory_.push_front(MemoryEntry{key, thumbnail, bytes});
+    memory_index_[key] = memory_.begin();
+    memory_bytes_ += bytes;
+    EvictLocked(memory_budget_);
+}
+
+void ThumbnailService::EvictLocked(size_t limit)
+{
+    while (memory_bytes_ > limit && !memory_.empty())
+    {
+        const MemoryEntry& oldest = memory_.back();
+        memory_bytes_ -= oldest.bytes;
+        memory_index_.erase(oldest.key);
+        memory_.pop_back();
+    }
+}
+
+} // namespace opacity::preview
@@ -0,0 +1,462 @@
+#include "opacity/search/EntryStore.h"
+
+#include <algorithm>
+
+namespace opacity::search
+{
+    static constexpr size_t kInitialSlots = 1024;
+
+    EntryStore::EntryStore()
+    {
+        Clear();
+    }
+
+    // ============== Interning ==============
+
+    uint32_t EntryStore::AppendName(std::string_view name)
+    {
+        // Offsets are 32-bit; the arena is rebuilt on Compact() well before
+        // it could approach 4GB of filenames.
+        auto offset = static_cast<uint32_t>(arena_.size());
+        arena_.append(name.data(), name.size());
+        return offset;
+    }
+
+    uint32_t EntryStore::InternDirectory(const std::filesystem::path& dir)
+    {
+        std::string key = dir.string();
+        auto it = dirIds_.find(key);
+        if (it != dirIds_.end()) {
+            return it->second;
+        }
+
+        DirNode node{};
+        std::filesystem::path parent = dir.parent_path();
+        std::string name;
+        if (parent.empty() || parent == dir) {
+            // Root (or relative leaf) keeps its full spelling
+            node.parent = kNoDir;
+            name = key;
+        } else {
+            node.parent = InternDirectory(parent);
+            name = dir.filename().string();
+        }
+        node.nameOffset = AppendName(name);
+        node.nameLength = static_cast<uint32_t>(name.size());
+
+        auto id = static_cast<uint32_t>(dirs_.size());
+        dirs_.push_back(node);
+        dirIds_.emplace(std::move(key), id);
+        return id;
+    }
+
+    std::optional<uint32_t> EntryStore::FindDirectory(const std::filesystem::path& dir) const
+    {
+        auto it = dirIds_.find(dir.string());
+        if (it == dirIds_.end()) {
+            return std::nullopt;
+        }
+        return it->second;
+    }
+
+    std::filesystem::path EntryStore::DirectoryPath(uint32_t dir) const
+    {
+        std::vector<uint32_t> chain;
+        for (uint32_t id = dir; id != kNoDir; id = dirs_[id].parent) {
+            chain.push_back(id);
+        }
+
+        std::filesystem::path result;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it) {
+            const DirNode& node = dirs_[*it];
+            std::string_view name(arena_.data() + node.nameOffset, node.nameLength);
+            if (result.empty()) {
+                result = std::filesystem::path(std::string(name));
+            } else {
+                result /= std::string(name);
+            }
+        }
+        return result;
+    }
+
+    uint16_t EntryStore::InternExtension(const std::string& extension)
+    {
+        auto it = extensionIds_.find(extension);
+        if (it != extensionIds_.end()) {
+            return it->second;
+        }
+
+        // Pathological trees with >64K distinct extensions share the empty slot
+        if (extensions_.size() > 0xFFFF) {
+            return 0;
+        }
+
+        auto id = static_cast<uint16_t>(extensions_.size());
+        extensions_.push_back(extension);
+        extensionIds_.emplace(extension, id);
+        return id;
+    }
+
+    // ============== Path lookup ==============
+
+    uint64_t EntryStore::HashKey(uint32_t parent, std::string_view name)
+    {
+        // FNV-1a over the parent id and filename bytes
+        uint64_t hash = 14695981039346656037ull;
+        for (int i = 0; i < 4; ++i) {
+            hash = (hash ^ ((parent >> (i * 8)) & 0xFF)) * 1099511628211ull;
+        }
+        for (char c : name) {
+            hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+        }
+        return hash;
+    }
+
+    uint64_t EntryStore::HashOf(DocId doc) const
+    {
+        return HashKey(records_[doc].parentDir, Filename(doc));
+    }
+
+    void EntryStore::LookupInsert(DocId doc)
+    {
+        if ((liveCount_ + 1) * 10 > slots_.size() * 7) {
+            LookupGrow();
+        }
+
+        size_t i = HashOf(doc) & slotMask_;
+        while (slots_[i] != kNoDoc) {
+            i = (i + 1) & slotMask_;
+        }
+        slots_[i] = doc;
+    }
+
+    void EntryStore::LookupErase(DocId doc)
+    {
+        size_t i = HashOf(doc) & slotMask_;
+        while (slots_[i] != doc) {
+            if (slots_[i] == kNoDoc) return;
+            i = (i + 1) & slotMask_;
+        }
+
+        // Shift later members of the probe run back so lookups never stop early
+        slots_[i] = kNoDoc;
+        size_t j = i;
+        for (;;) {
+            j = (j + 1) & slotMask_;
+            if (slots_[j] == kNoDoc) break;
+
+            size_t home = HashOf(slots_[j]) & slotMask_;
+            bool movable = (i <= j) ? (home <= i || home > j) : (home <= i && home > j);
+            if (movable) {
+                slots_[i] = slots_[j];
+                slots_[j] = kNoDoc;
+                i = j;
+            }
+        }
+    }
+
+    void EntryStore::LookupGrow()
+    {
+        std::vector<DocId> old = std::move(slots_);
+        slots_.assign(std::max(kInitialSlots, old.size() * 2), kNoDoc);
+        slotMask_ = slots_.size() - 1;
+
+        for (DocId doc : old) {
+            if (doc == kNoDoc) continue;
+            size_t i = HashOf(doc) & slotMask_;
+            while (slots_[i] != kNoDoc) {
+                i = (i + 1) & slotMask_;
+            }
+            slots_[i] = doc;
+        }
+    }
+
+    std::optional<DocId> EntryStore::Find(const std::filesystem::path& path) const
+    {
+        auto dir = FindDirectory(path.parent_path());
+        if (!dir) {
+            return std::nullopt;
+        }
+
+        std::string name = path.filename().string();
+        size_t i = HashKey(*dir, name) & slotMask_;
+        while (slots_[i] != kNoDoc) {
+            DocId doc = slots_[i];
+            if (records_[doc].parentDir == *dir && Filename(doc) == name) {
+                return doc;
+            }
+            i = (i + 1) & slotMask_;
+        }
+        return std::nullopt;
+    }
+
+    std::vector<DocId> EntryStore::FindUnder(const std::filesystem::path& dir) const
+    {
+        std::vector<DocId> docs;
+        auto top = FindDirectory(dir);
+        if (!top) {
+            return docs;
+        }
+
+        // Parents are always interned before their children, so one forward
+        // pass marks every directory in the subtree
+        std::vector<bool> below(dirs_.size(), false);
+        below[*top] = true;
+        for (size_t id = *top + 1; id < dirs_.size(); ++id) {
+            uint32_t parent = dirs_[id].parent;
+            if (parent != kNoDir && below[parent]) {
+                below[id] = true;
+            }
+        }
+
+        ForEach([&](DocId doc) {
+            if (below[records_[doc].parentDir]) docs.push_back(doc);
+        });
+        return docs;
+    }
+
+    std::vector<DirectorySize> EntryStore::DirectorySizesUnder(const std::filesystem::path& dir) const
+    {
+        std::vector<DirectorySize> sizes;
+        auto top = FindDirectory(dir);
+        if (!top) {
+            return sizes;
+        }
+
+        // Slot per directory id, kNoDir outside the subtree
+        std::vector<uint32_t> slot(dirs_.size(), kNoDir);
+        std::vector<uint32_t> ids;
+        slot[*top] = 0;
+        ids.push_back(*top);
+        for (size_t id = *top + 1; id < dirs_.size(); ++id) {
+            uint32_t parent = dirs_[id].parent;
+            if (parent != kNoDir && slot[parent] != kNoDir) {
+                slot[id] = static_cast<uint32_t>(ids.size());
+                ids.push_back(static_cast<uint32_t>(id));
+            }
+        }
+
+        sizes.resize(ids.size());
+        ForEach([&](DocId doc) {
+            const CompactEntry& record = records_[doc];
+            uint32_t at = slot[record.parentDir];
+            if (at == kNoDir) return;
+            if (record.IsDirectory()) {
+                sizes[at].directFolders++;
+            } else {
+                sizes[at].directBytes += record.size;
+                sizes[at].directFiles++;
+            }
+        });
+
+        for (auto& size : sizes) {
+            size.totalBytes = size.directBytes;
+            size.totalFiles = size.directFiles;
+            size.totalFolders = size.directFolders;
+        }
+
+        // Children come after their parents, so walking back folds each
+        // finished subtree into its parent exactly once
+        for (size_t i = ids.size(); i-- > 1;) {
+            DirectorySize& child = sizes[i];
+            DirectorySize& parent = sizes[slot[dirs_[ids[i]].parent]];
+            parent.totalBytes += child.totalBytes;
+            parent.totalFiles += child.totalFiles;
+            parent.totalFolders += child.totalFolders;
+        }
+
+        for (size_t i = 0; i < ids.size(); ++i) {
+            sizes[i].path = DirectoryPath(ids[i]);
+        }
+        return sizes;
+    }
+
+    // ============== Records ==============
+
+    DocId EntryStore::Insert(IndexEntry&& entry)
+    {
+        CompactEntry record;
+        record.parentDir = InternDirectory(entry.path.parent_path());
+        std::string name = entry.path.filename().string();
+        record.nameOffset = AppendName(name);
+        record.nameLength = static_cast<uint16_t>(std::min<size_t>(name.size(), 0xFFFF));
+        record.extensionId = InternExtension(entry.extension);
+        record.contentHash = entry.contentHash;
+        record.size = entry.size;
+        record.modifiedTime = ToIndexTime(entry.modifiedTime);
+        record.indexedTime = ToIndexTime(entry.indexedTime);
+        record.flags = entry.isDirectory ? CompactEntry::kDirectory : 0;
+
+        auto doc = static_cast<DocId>(records_.size());
+        records_.push_back(record);
+        LookupInsert(doc);
+        liveCount_++;
+
+        if (!entry.content.empty()) {
+            ownedContent_.emplace(doc, std::move(entry.content));
+        }
+        return doc;
+    }
+
+    bool EntryStore::Remove(DocId doc)
+    {
+        if (!IsLive(doc)) {
+            return false;
+        }
+
+        LookupErase(doc);
+        records_[doc].flags |= CompactEntry::kRemoved;
+        liveCount_--;
+        ownedContent_.erase(doc);
+        mappedContent_.erase(doc);
+        return true;
+    }
+
+    std::string_view EntryStore::Filename(DocId doc) const
+    {
+        const CompactEntry& record = records_[doc];
+        return std::string_view(arena_.data() + record.nameOffset, record.nameLength);
+    }
+
+    std::filesystem::path EntryStore::Path(DocId doc) const
+    {
+        return DirectoryPath(records_[doc].parentDir) / std::string(Filename(doc));
+    }
+
+    std::string_view EntryStore::Content(DocId doc) const
+    {
+        auto owned = ownedContent_.find(doc);
+        if (owned != ownedContent_.end()) {
+            return owned->second;
+        }
+        auto mapped = mappedContent_.find(doc);
+        return mapped != mappedContent_.end() ? mapped->second : std::string_view{};
+    }
+
+    void EntryStore::SetMappedContent(DocId doc, std::string_view content)
+    {
+        if (!IsLive(doc) || content.empty()) {
+            return;
+        }
+        ownedContent_.erase(doc);
+        mappedContent_[doc] = content;
+    }
+
+    IndexEntry EntryStore::Materialize(DocId doc, bool withContent) const
+    {
+        const CompactEntry& record = records_[doc];
+
+        IndexEntry entry;
+        entry.path = Path(doc);
+        entry.filename = std::string(Filename(doc));
+        entry.extension = extensions_[record.extensionId];
+        entry.size = record.size;
+        entry.modifiedTime = FromIndexTime(record.modifiedTime);
+        entry.indexedTime = FromIndexTime(record.indexedTime);
+        entry.contentHash = record.contentHash;
+        entry.isDirectory = record.IsDirectory();
+        if (withContent) {
+            entry.content = std::string(Content(doc));
+        }
+        return entry;
+    }
+
+    std::vector<DocId> EntryStore::Compact()
+    {
+        std::vector<DocId> remap(records_.size(), kNoDoc);
+
+        // Rebuild the arena with directory names first, then live filenames
+        std::string arena;
+        arena.reserve(arena_.size());
+        for (DirNode& node : dirs_) {
+            auto offset = static_cast<uint32_t>(arena.size());
+            arena.append(arena_, node.nameOffset, node.nameLength);
+            node.nameOffset = offset;
+        }
+
+        std::vector<CompactEntry> records;
+        records.reserve(liveCount_);
+        for (DocId doc = 0; doc < records_.size(); ++doc) {
+            CompactEntry record = records_[doc];
+            if (record.IsRemoved()) continue;
+
+            auto offset = static_cast<uint32_t>(arena.size());
+            arena.append(arena_, record.nameOffset, record.nameLength);
+            record.nameOffset = offset;
+
+            remap[doc] = static_cast<DocId>(records.size());
+            records.push_back(record);
+        }
+
+        std::unordered_map<DocId, std::string> ownedContent;
+        ownedContent.reserve(ownedContent_.size());
+        for (auto& [doc, content] : ownedContent_) {
+            ownedContent.emplace(remap[doc], std::move(content));
+        }
+
+        std::unordered_map<DocId, std::string_view> mappedContent;
+        mappedContent.reserve(mappedContent_.size());
+        for (const auto& [doc, content] : mappedContent_) {
+            mappedContent.emplace(remap[doc], content);
+        }
+
+        arena_ = std::move(arena);
+        arena_.shrink_to_fit();
+        records_ = std::move(records);
+        ownedContent_ = std::move(ownedContent);
+        mappedContent_ = std::move(mappedContent);
+
+        size_t slotCount = kInitialSlots;
+        while (records_.size() * 10 > slotCount * 7) {
+            slotCount *= 2;
+        }
+        slots_.assign(slotCount, kNoDoc);
+        slotMask_ = slotCount - 1;
+        for (DocId doc = 0; doc < records_.size(); ++doc) {
+            size_t i = HashOf(doc) & slotMask_;
+            while (slots_[i] != kNoDoc) {
+                i = (i + 1) & slotMask_;
+            }
+            slots_[i] = doc;
+        }
+
+        return remap;
+    }
+
+    void EntryStore::Clear()
+    {
+        records_.clear();
+        liveCount_ = 0;
+        arena_.clear();
+        dirs_.clear();
+        dirIds_.clear();
+        ownedContent_.clear();
+        mappedContent_.clear();
+
+        // Extension id 0 is always the empty extension
+        extensions_.assign(1, std::string());
+        extensionIds_.clear();
+        extensionIds_.emplace(std::string(), 0);
+
+        slots_.assign(kInitialSlots, kNoDoc);
+        slotMask_ = slots_.size() - 1;
+    }
+
+    size_t EntryStore::MemoryUsage() const
+    {
+        size_t bytes = records_.capacity() * sizeof(CompactEntry)
+            + arena_.capacity()
+            + dirs_.capacity() * sizeof(DirNode)
+            + slots_.capacity() * sizeof(DocId);
+
+        for (const auto& [key, id] : dirIds_) {
+            bytes += key.capacity() + sizeof(id) + 2 * sizeof(void*);
+        }
+        for (const auto& ext : extensions_) {
+            bytes += 2 * (ext.capacity() + sizeof(ext));
+        }
+        bytes += (ownedContent_.size() + mappedContent_.size()) * (sizeof(DocId) + 4 * sizeof(void*));
+        return bytes;
+    }
+
+} // namespace opacity::search
@@ -1 +1,696 @@
 #include "opacity/search/FilterEngine.h"
+#include "opacity/search/TextScanner.h"
+
+#include <algorithm>
+#include <cctype>
+#include <ctime>
+#include <limits>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace opacity::search
+{
+    namespace
+    {
+        constexpr int64_t kMicrosPerDay = 24LL * 60 * 60 * 1000 * 1000;
+
+        std::string ToLower(std::string_view text)
+        {
+            std::string result(text);
+            std::transform(result.begin(), result.end(), result.begin(),
+                [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+            return result;
+        }
+
+        std::string NormalizeExtension(std::string_view extension)
+        {
+            if (!extension.empty() && extension.front() == '.') {
+                extension.remove_prefix(1);
+            }
+            return ToLower(extension);
+        }
+
+        inline size_t TrailingZeros(uint64_t bits)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward64(&index, bits);
+            return static_cast<size_t>(index);
+#else
+            return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+        }
+
+        int64_t ToMicros(std::chrono::system_clock::time_point time)
+        {
+            return std::chrono::duration_cast<std::chrono::microseconds>(time.time_since_epoch()).count();
+        }
+
+        /**
+         * @brief AND a per-item test into the selection, one word at a time
+         *
+         * The inner loop has no branches, so compilers vectorize it for the
+         * column types used here.
+         */
+        template <typename Test>
+        void NarrowWords(Selection& selection, Test&& test)
+        {
+            auto& words = selection.Words();
+            const size_t size = selection.Size();
+            for (size_t w = 0; w < words.size(); ++w) {
+                if (words[w] == 0) continue;
+
+                const size_t base = w * 64;
+                const size_t count = std::min<size_t>(64, size - base);
+                uint64_t keep = 0;
+                for (size_t j = 0; j < count; ++j) {
+                    keep |= static_cast<uint64_t>(test(base + j)) << j;
+                }
+                words[w] &= keep;
+            }
+        }
+
+        bool HasWildcards(std::string_view pattern)
+        {
+            return pattern.find_first_of("*?") != std::string_view::npos;
+        }
+
+        // ============== Expression parsing ==============
+
+        std::vector<std::string> Tokenize(std::string_view expression)
+        {
+            std::vector<std::string> tokens;
+            std::string current;
+            bool quoted = false;
+            bool any = false;
+
+            for (char c : expression) {
+                if (c == '"') {
+                    quoted = !quoted;
+                    any = true;
+                } else if (!quoted && std::isspace(static_cast<unsigned char>(c))) {
+                    if (any) tokens.push_back(std::move(current));
+                    current.clear();
+                    any = false;
+                } else {
+                    current += c;
+                    any = true;
+                }
+            }
+            if (any) tokens.push_back(std::move(current));
+            return tokens;
+        }
+
+        std::vector<std::string> SplitList(std::string_view text, char separator)
+        {
+            std::vector<std::string> parts;
+            size_t start = 0;
+            while (start <= text.size()) {
+                size_t end = text.find(separator, start);
+                if (end == std::string_view::npos) end = text.size();
+                if (end > start) parts.emplace_back(text.substr(start, end - start));
+                start = end + 1;
+            }
+            return parts;
+        }
+
+        std::optional<uint64_t> ParseSize(std::string_view text)
+        {
+            if (text.empty()) return std::nullopt;
+
+            size_t i = 0;
+            double value = 0.0;
+            bool digits = false;
+            while (i < text.size() && std::isdigit(static_cast<unsigned char>(text[i]))) {
+                value = value * 10.0 + (text[i] - '0');
+                digits = true;
+                ++i;
+            }
+            if (i < text.size() && text[i] == '.') {
+                double scale = 0.1;
+                for (++i; i < text.size() && std::isdigit(static_cast<unsigned char>(text[i])); ++i) {
+                    value += (text[i] - '0') * scale;
+                    scale /= 10.0;
+                    digits = true;
+                }
+            }
+            if (!digits) return std::nullopt;
+
+            std::string unit = ToLower(text.substr(i));
+            double multiplier = 1.0;
+            if (unit.empty() || unit == "b") {
+                multiplier = 1.0;
+            } else if (unit == "k" || unit == "kb") {
+                multiplier = 1024.0;
+            } else if (unit == "m" || unit == "mb") {
+                multiplier = 1024.0 * 1024.0;
+            } else if (unit == "g" || unit == "gb") {
+                multiplier = 1024.0 * 1024.0 * 1024.0;
+            } else if (unit == "t" || unit == "tb") {
+                multiplier = 1024.0 * 1024.0 * 1024.0 * 1024.0;
+            } else {
+                return std::nullopt;
+            }
+
+            double bytes = value * multiplier;
+            if (bytes >= 18446744073709551615.0) return std::nullopt;
+            return static_cast<uint64_t>(bytes);
+        }
+
+        // Start of a local calendar day, as microseconds since the epoch
+        std::optional<int64_t> ParseDate(std::string_view text)
+        {
+            int year = 0, month = 0, day = 0;
+            if (text.size() != 10 || text[4] != '-' || text[7] != '-') return std::nullopt;
+            for (size_t i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+                if (!std::isdigit(static_cast<unsigned char>(text[i]))) return std::nullopt;
+            }
+            year = std::stoi(std::string(text.substr(0, 4)));
+            month = std::stoi(std::string(text.substr(5, 2)));
+            day = std::stoi(std::string(text.substr(8, 2)));
+            if (month < 1 || month > 12 || day < 1 || day > 31) return std::nullopt;
+
+            std::tm tm{};
+            tm.tm_year = year - 1900;
+            tm.tm_mon = month - 1;
+            tm.tm_mday = day;
+            tm.tm_isdst = -1;
+            std::time_t time = std::mktime(&tm);
+            if (time == static_cast<std::time_t>(-1)) return std::nullopt;
+            return static_cast<int64_t>(time) * 1000 * 1000;
+        }
+
+        std::chrono::system_clock::time_point FromMicros(int64_t micros)
+        {
+            return std::chrono::system_clock::time_point(
+                std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::microseconds(micros)));
+        }
+
+        /**
+         * @brief Split "<=value", ">value", "a..b" or "value" into bounds
+         */
+        struct RangeTerm
+        {
+            std::string op;     // "", "<", "<=", ">", ">=", "=", ".."
+            std::string low;
+            std::string high;
+        };
+
+        RangeTerm SplitRange(std::string_view text)
+        {
+            RangeTerm term;
+            size_t dots = text.find("..");
+            if (dots != std::string_view::npos) {
+                term.op = "..";
+                term.low = std::string(text.substr(0, dots));
+                term.high = std::string(text.substr(dots + 2));
+                return term;
+            }
+            for (const char* op : {">=", "<=", ">", "<", "="}) {
+                std::string_view prefix(op);
+                if (text.substr(0, prefix.size()) == prefix) {
+                    term.op = op;
+                    term.low = std::string(text.substr(prefix.size()));
+                    return term;
+                }
+            }
+            term.low = std::string(text);
+            return term;
+        }
+
+        bool ParseSizeTerm(std::string_view value, FilterSpec& spec)
+        {
+            RangeTerm term = SplitRange(value);
+            auto low = ParseSize(term.low);
+            if (!low) return false;
+
+            if (term.op == "..") {
+                auto high = ParseSize(term.high);
+                if (!high || *high < *low) return false;
+                spec.minSize = low;
+                spec.maxSize = high;
+            } else if (term.op == ">") {
+                if (*low == std::numeric_limits<uint64_t>::max()) return false;
+                spec.minSize = *low + 1;
+            } else if (term.op == ">=") {
+                spec.minSize = low;
+            } else if (term.op == "<") {
+                if (*low == 0) return false;
+                spec.maxSize = *low - 1;
+            } else if (term.op == "<=") {
+                spec.maxSize = low;
+            } else {
+                spec.minSize = low;
+                spec.maxSize = low;
+            }
+            return true;
+        }
+
+        bool ParseDateTerm(std::string_view value, FilterSpec& spec)
+        {
+            RangeTerm term = SplitRange(value);
+            auto low = ParseDate(term.low);
+            if (!low) return false;
+
+            // A day covers [start, start + 1 day)
+            const int64_t endOfLow = *low + kMicrosPerDay - 1;
+            if (term.op == "..") {
+                auto high = ParseDate(term.high);
+                if (!high || *high < *low) return false;
+                spec.modifiedAfter = FromMicros(*low);
+                spec.modifiedBefore = FromMicros(*high + kMicrosPerDay - 1);
+            } else if (term.op == ">") {
+                spec.modifiedAfter = FromMicros(endOfLow + 1);
+            } else if (term.op == ">=") {
+                spec.modifiedAfter = FromMicros(*low);
+            } else if (term.op == "<") {
+                spec.modifiedBefore = FromMicros(*low - 1);
+            } else if (term.op == "<=") {
+                spec.modifiedBefore = FromMicros(endOfLow);
+            } else {
+                spec.modifiedAfter = FromMicros(*low);
+                spec.modifiedBefore = FromMicros(endOfLow);
+            }
+            return true;
+        }
+
+        bool ParseAttributeTerm(std::string_view value, FilterSpec& spec)
+        {
+            using filesystem::FsItem;
+
+            bool exclude = false;
+            for (char c : value) {
+                uint32_t bit = 0;
+                switch (std::tolower(static_cast<unsigned char>(c))) {
+                case '+': exclude = false; continue;
+                case '-': exclude = true; continue;
+                case 'r': bit = FsItem::ATTR_READONLY; break;
+                case 'h': bit = FsItem::ATTR_HIDDEN; break;
+                case 's': bit = FsItem::ATTR_SYSTEM; break;
+                case 'a': bit = FsItem::ATTR_ARCHIVE; break;
+                case 'c': bit = FsItem::ATTR_COMPRESSED; break;
+                case 'e': bit = FsItem::ATTR_ENCRYPTED; break;
+                default: return false;
+                }
+                (exclude ? spec.excludedAttributes : spec.requiredAttributes) |= bit;
+            }
+            return spec.requiredAttributes != 0 || spec.excludedAttributes != 0;
+        }
+    }
+
+    // ============== Selection ==============
+
+    void Selection::Reset(size_t size, bool value)
+    {
+        size_ = size;
+        words_.assign((size + 63) / 64, value ? ~uint64_t{0} : 0);
+        if (value && (size & 63) != 0) {
+            words_.back() = (uint64_t{1} << (size & 63)) - 1;
+        }
+    }
+
+    size_t Selection::Count() const
+    {
+        size_t count = 0;
+        for (uint64_t word : words_) {
+#ifdef _MSC_VER
+            count += static_cast<size_t>(__popcnt64(word));
+#else
+            count += static_cast<size_t>(__builtin_popcountll(word));
+#endif
+        }
+        return count;
+    }
+
+    size_t Selection::CountTrailingZeros(uint64_t bits)
+    {
+        return TrailingZeros(bits);
+    }
+
+    void Selection::ToIndices(std::vector<uint32_t>& indices) const
+    {
+        indices.clear();
+        ForEach([&indices](size_t index) { indices.push_back(static_cast<uint32_t>(index)); });
+    }
+
+    // ============== ItemColumns ==============
+
+    void ItemColumns::Build(const std::vector<filesystem::FsItem>& items, const TagLookup& tags)
+    {
+        const size_t count = items.size();
+
+        names_.clear();
+        nameOffsets_.clear();
+        extensionIds_.clear();
+        extensionDictionary_.clear();
+        sizes_.clear();
+        modified_.clear();
+        attributes_.clear();
+        tags_.clear();
+
+        size_t nameBytes = 0;
+        for (const auto& item : items) {
+            nameBytes += item.name.size();
+        }
+        names_.reserve(nameBytes);
+        nameOffsets_.reserve(count + 1);
+        extensionIds_.reserve(count);
+        sizes_.reserve(count);
+        modified_.reserve(count);
+        attributes_.reserve(count);
+        directories_.Reset(count, false);
+
+        nameOffsets_.push_back(0);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& item = items[i];
+
+            names_ += item.name;
+            nameOffsets_.push_back(static_cast<uint32_t>(names_.size()));
+
+            std::string extension = NormalizeExtension(item.extension);
+            auto ext = extensionDictionary_.emplace(std::move(extension),
+                                                    static_cast<uint32_t>(extensionDictionary_.size()));
+            extensionIds_.push_back(ext.first->second);
+
+            sizes_.push_back(item.size);
+
+            // Listings fill `modified`; older code paths only set modified_time
+            auto modified = item.modified != std::chrono::system_clock::time_point{} ? item.modified
+                                                                                     : item.modified_time;
+            modified_.push_back(ToMicros(modified));
+
+            uint32_t attributes = item.attributes;
+            if (item.is_directory) {
+                attributes |= filesystem::FsItem::ATTR_DIRECTORY;
+                directories_.Set(i);
+            }
+            attributes_.push_back(attributes);
+
+            if (tags) {
+                for (const auto& tag : tags(item.full_path.String())) {
+                    auto [it, inserted] = tags_.try_emplace(tag);
+                    if (inserted) {
+                        it->second.Reset(count, false);
+                    }
+                    it->second.Set(i);
+                }
+            }
+        }
+    }
+
+    // ============== FilterProgram ==============
+
+    void FilterProgram::Evaluate(const ItemColumns& columns, Selection& selection) const
+    {
+        selection.Reset(columns.Size(), true);
+        for (const auto& op : ops_) {
+            Apply(op, columns, selection);
+        }
+    }
+
+    void FilterProgram::Apply(const Op& op, const ItemColumns& columns, Selection& selection) const
+    {
+        auto& words = selection.Words();
+
+        switch (op.kind) {
+        case OpKind::Type: {
+            // low: 1 = directories only, 2 = files only, 0 = nothing
+            const auto& directories = columns.directories_.Words();
+            for (size_t w = 0; w < words.size(); ++w) {
+                if (op.low == 1) {
+                    words[w] &= directories[w];
+                } else if (op.low == 2) {
+                    words[w] &= ~directories[w];
+                } else {
+                    words[w] = 0;
+                }
+            }
+            break;
+        }
+
+        case OpKind::Attributes: {
+            const uint32_t* attributes = columns.attributes_.data();
+            const uint32_t required = static_cast<uint32_t>(op.low);
+            const uint32_t excluded = static_cast<uint32_t>(op.high);
+            NarrowWords(selection, [=](size_t i) {
+                return ((attributes[i] & required) == required) & ((attributes[i] & excluded) == 0);
+            });
+            break;
+        }
+
+        case OpKind::Size: {
+            const uint64_t* sizes = columns.sizes_.data();
+            const uint64_t low = op.low;
+            const uint64_t high = op.high;
+            NarrowWords(selection, [=](size_t i) {
+                return (sizes[i] >= low) & (sizes[i] <= high);
+            });
+            break;
+        }
+
+        case OpKind::Modified: {
+            const int64_t* modified = columns.modified_.data();
+            const int64_t after = op.after;
+            const int64_t before = op.before;
+            NarrowWords(selection, [=](size_t i) {
+                return (modified[i] >= after) & (modified[i] <= before);
+            });
+            break;
+        }
+
+        case OpKind::Extension: {
+            // Resolve the set against this listing's dictionary once
+            std::vector<uint8_t> wanted(columns.extensionDictionary_.size(), 0);
+            for (const auto& extension : op.values) {
+                auto it = columns.extensionDictionary_.find(extension);
+                if (it != columns.extensionDictionary_.end()) {
+                    wanted[it->second] = 1;
+                }
+            }
+            const uint32_t* ids = columns.extensionIds_.data();
+            const uint8_t* table = wanted.data();
+            NarrowWords(selection, [=](size_t i) { return table[ids[i]] != 0; });
+            break;
+        }
+
+        case OpKind::Tags: {
+            // low: 0 = all of, 1 = none of, 2 = any of
+            if (op.low == 2) {
+                std::vector<uint64_t> any(words.size(), 0);
+                for (const auto& tag : op.values) {
+                    auto it = columns.tags_.find(tag);
+                    if (it == columns.tags_.end()) continue;
+                    const auto& tagged = it->second.Words();
+                    for (size_t w = 0; w < words.size(); ++w) {
+                        any[w] |= tagged[w];
+                    }
+                }
+                for (size_t w = 0; w < words.size(); ++w) {
+                    words[w] &= any[w];
+                }
+                break;
+            }
+
+            for (const auto& tag : op.values) {
+                auto it = columns.tags_.find(tag);
+                if (it == columns.tags_.end()) {
+                    if (op.low == 0) {
+                        std::fill(words.begin(), words.end(), 0);
+                    }
+                    continue;
+                }
+                const auto& tagged = it->second.Words();
+                for (size_t w = 0; w < words.size(); ++w) {
+                    words[w] &= (op.low == 0) ? tagged[w] : ~tagged[w];
+                }
+            }
+            break;
+        }
+
+        case OpKind::Name: {
+            // Strings are the expensive part: only test items still selected
+            const bool caseSensitive = caseSensitive_;
+            for (size_t w = 0; w < words.size(); ++w) {
+                uint64_t bits = words[w];
+                while (bits) {
+                    size_t bit = TrailingZeros(bits);
+                    std::string_view name = columns.Name(w * 64 + bit);
+                    for (const auto& pattern : op.values) {
+                        bool matches = HasWildcards(pattern)
+                            ? TextScanner::MatchWildcard(name, pattern, caseSensitive)
+                            : TextScanner::Contains(name, pattern, caseSensitive);
+                        if (!matches) {
+                            words[w] &= ~(uint64_t{1} << bit);
+                            break;
+                        }
+                    }
+                    bits &= bits - 1;
+                }
+            }
+            break;
+        }
+        }
+    }
+
+    // ============== FilterEngine ==============
+
+    FilterProgram FilterEngine::Compile(const FilterSpec& spec)
+    {
+        using Op = FilterProgram::Op;
+        using OpKind = FilterProgram::OpKind;
+
+        auto makeOp = [](OpKind kind) {
+            Op op;
+            op.kind = kind;
+            return op;
+        };
+
+        FilterProgram program;
+        program.caseSensitive_ = spec.caseSensitive;
+
+        // Cheapest first: whole-word bitmaps, numeric columns, then strings
+        if (!spec.includeFiles || !spec.includeDirectories) {
+            Op op = makeOp(OpKind::Type);
+            op.low = spec.includeDirectories ? 1 : (spec.includeFiles ? 2 : 0);
+            program.ops_.push_back(std::move(op));
+        }
+
+        if (spec.requiredAttributes != 0 || spec.excludedAttributes != 0) {
+            Op op = makeOp(OpKind::Attributes);
+            op.low = spec.requiredAttributes;
+            op.high = spec.excludedAttributes;
+            program.ops_.push_back(std::move(op));
+        }
+
+        if (spec.minSize || spec.maxSize) {
+            Op op = makeOp(OpKind::Size);
+            op.low = spec.minSize.value_or(0);
+            op.high = spec.maxSize.value_or(std::numeric_limits<uint64_t>::max());
+            program.ops_.push_back(std::move(op));
+        }
+
+        if (spec.modifiedAfter || spec.modifiedBefore) {
+            Op op = makeOp(OpKind::Modified);
+            op.after = spec.modifiedAfter ? ToMicros(*spec.modifiedAfter) : std::numeric_limits<int64_t>::min();
+            op.before = spec.modifiedBefore ? ToMicros(*spec.modifiedBefore) : std::numeric_limits<int64_t>::max();
+            program.ops_.push_back(std::move(op));
+        }
+
+        if (!spec.extensions.empty()) {
+            Op op = makeOp(OpKind::Extension);
+            for (const auto& extension : spec.extensions) {
+                op.values.push_back(NormalizeExtension(extension));
+            }
+            program.ops_.push_back(std::move(op));
+        }
+
+        auto addTags = [&program, &makeOp](const std::vector<std::string>& tags, uint64_t mode) {
+            if (tags.empty()) return;
+            Op op = makeOp(OpKind::Tags);
+            op.low = mode;
+            op.values = tags;
+            program.ops_.push_back(std::move(op));
+        };
+        addTags(spec.includeTags, 0);
+        addTags(spec.excludeTags, 1);
+        addTags(spec.anyOfTags, 2);
+
+        std::vector<std::string> patterns;
+        for (const auto& pattern : spec.namePatterns) {
+            // "*" and "" keep everything
+            if (pattern.empty() || pattern.find_first_not_of('*') == std::string::npos) continue;
+            patterns.push_back(pattern);
+        }
+        if (!patterns.empty()) {
+            Op op = makeOp(OpKind::Name);
+            op.values = std::move(patterns);
+            program.ops_.push_back(std::move(op));
+        }
+
+        return program;
+    }
+
+    std::optional<FilterSpec> FilterEngine::Parse(std::string_view expression, std::string* error)
+    {
+        FilterSpec spec;
+
+        auto fail = [error](const std::string& term) -> std::optional<FilterSpec> {
+            if (error) *error = "Invalid filter term '" + term + "'";
+            return std::nullopt;
+        };
+
+        for (const auto& token : Tokenize(expression)) {
+            bool negated = !token.empty() && token[0] == '-';
+            std::string_view term = token;
+            if (negated) term.remove_prefix(1);
+
+            size_t colon = term.find(':');
+            std::string key = colon == std::string_view::npos ? std::string()
+                                                              : ToLower(term.substr(0, colon));
+            std::string_view value = colon == std::string_view::npos ? std::string_view()
+                                                                     : term.substr(colon + 1);
+
+            if (key == "tag") {
+                auto tags = SplitList(value, '|');
+                if (tags.empty()) return fail(token);
+                if (negated) {
+                    spec.excludeTags.insert(spec.excludeTags.end(), tags.begin(), tags.end());
+                } else if (tags.size() > 1) {
+                    spec.anyOfTags.insert(spec.anyOfTags.end(), tags.begin(), tags.end());
+                } else {
+                    spec.includeTags.push_back(tags.front());
+                }
+                continue;
+            }
+
+            // Only tags can be negated; anything else is a name like "-old"
+            if (!negated) {
+                if (key == "ext") {
+                    auto extensions = SplitList(value, ',');
+                    if (extensions.empty()) return fail(token);
+                    spec.extensions.insert(spec.extensions.end(), extensions.begin(), extensions.end());
+                    continue;
+                }
+                if (key == "size") {
+                    if (!ParseSizeTerm(value, spec)) return fail(token);
+                    continue;
+                }
+                if (key == "modified") {
+                    if (!ParseDateTerm(value, spec)) return fail(token);
+                    continue;
+                }
+                if (key == "attr") {
+                    if (!ParseAttributeTerm(value, spec)) return fail(token);
+                    continue;
+                }
+                if (key == "type") {
+                    std::string type = ToLower(value);
+                    if (type == "file") {
+                        spec.includeDirectories = false;
+                    } else if (type == "dir" || type == "folder") {
+                        spec.includeFiles = false;
+                    } else {
+                        return fail(token);
+                    }
+                    continue;
+                }
+            }
+
+            spec.namePatterns.push_back(token);
+        }
+
+        return spec;
+    }
+
+    std::optional<FilterProgram> FilterEngine::Compile(std::string_view expression, std::string* error)
+    {
+        auto spec = Parse(expression, error);
+        if (!spec) {
+            return std::nullopt;
+        }
+        return Compile(*spec);
+    }
+
+} // namespace opacity::search
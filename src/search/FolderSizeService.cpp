@@ -0,0 +1,723 @@
+#include "opacity/search/FolderSizeService.h"
+#include "opacity/search/IndexCrawler.h"
+#include "opacity/search/SearchIndex.h"
+#include "opacity/filesystem/FileWatch.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/SnapshotFile.h"
+#include "opacity/core/TaskScheduler.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <ShlObj.h>
+#endif
+
+namespace opacity::search
+{
+    using namespace opacity::core;
+
+    namespace
+    {
+        constexpr char kCacheMagic[4] = {'O', 'F', 'S', 'Z'};
+        constexpr uint32_t kCacheVersion = 1;
+
+        // Directory enumeration workers per walk
+        constexpr int kWalkThreads = 4;
+
+        // Saved at most this often while measuring; always on shutdown
+        constexpr std::chrono::minutes kSaveInterval{5};
+
+        // Sorts below every character a name can hold, so a folder's
+        // subtree is the key range right after it, before any sibling
+        constexpr char kSeparator = '\x01';
+
+        // Lowercase, with kSeparator between components
+        std::string FolderKey(const std::filesystem::path& dir)
+        {
+            std::string key = dir.lexically_normal().generic_u8string();
+            while (key.size() > 1 && key.back() == '/' && key[key.size() - 2] != ':') {
+                key.pop_back();
+            }
+            for (char& c : key) {
+                c = c == '/' ? kSeparator : static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return key;
+        }
+
+        std::string SubtreePrefix(const std::string& key)
+        {
+            return key.back() == kSeparator ? key : key + kSeparator;
+        }
+
+        // Signed change to a folder's totals
+        struct SizeDelta
+        {
+            int64_t bytes = 0;
+            int64_t files = 0;
+            int64_t folders = 0;
+
+            bool IsZero() const { return bytes == 0 && files == 0 && folders == 0; }
+        };
+
+        template <typename T>
+        void WriteValue(std::string& out, T value)
+        {
+            out.append(reinterpret_cast<const char*>(&value), sizeof(value));
+        }
+
+        template <typename T>
+        bool ReadValue(const std::string& in, size_t& pos, T& value)
+        {
+            if (in.size() - pos < sizeof(value)) return false;
+            std::memcpy(&value, in.data() + pos, sizeof(value));
+            pos += sizeof(value);
+            return true;
+        }
+    }
+
+    struct FolderSizeService::Impl
+    {
+        struct Node
+        {
+            std::filesystem::path path;
+            uint64_t directBytes = 0;
+            uint64_t directFiles = 0;
+            uint64_t directFolders = 0;
+            FolderSize total;
+        };
+
+        struct Job
+        {
+            std::filesystem::path path;
+            std::string key;
+        };
+
+        struct DirtyPath
+        {
+            std::filesystem::path path;
+            bool tree = false;          // Measure the whole subtree again
+        };
+
+        explicit Impl(std::filesystem::path cacheFile) : snapshot_(std::move(cacheFile)) {}
+
+        // Every folder below a cached folder is cached too, so walking up
+        // from a change can stop at the first folder that is not
+        std::map<std::string, Node> nodes_;
+        std::vector<Job> jobs_;
+        std::unordered_map<std::string, uint64_t> queued_;     // Key -> frame last asked for
+        std::unordered_map<std::string, DirtyPath> dirty_;
+        uint64_t frame_ = 0;
+        std::atomic<uint64_t> generation_{0};
+        mutable std::mutex mutex_;
+
+        // One drain at a time; only it touches watches_
+        TaskHandle drain_;
+        bool draining_ = false;
+        bool measuring_ = false;        // A queued folder is being measured now
+        bool stop_ = false;
+        std::atomic<bool> cancel_{false};
+
+        std::shared_ptr<SearchIndex> index_;
+        filesystem::FileWatch watch_;
+        std::map<std::string, filesystem::WatchHandle> watches_;
+
+        // Loading and saving; each may be asked for from outside the drain
+        std::mutex fileMutex_;
+        SnapshotFile snapshot_;
+        bool loaded_ = false;
+        std::atomic<std::chrono::steady_clock::time_point> lastSave_{std::chrono::steady_clock::now()};
+
+        // ---- Requests (callers hold mutex_) ----
+
+        void ScheduleLocked()
+        {
+            if (draining_ || stop_) return;
+            draining_ = true;
+
+            TaskOptions options;
+            options.priority = TaskPriority::Normal;
+            drain_ = TaskScheduler::Get().Submit([this](const CancellationToken&) { Drain(); },
+                                                 std::move(options));
+        }
+
+        void MarkDirty(const std::filesystem::path& path, bool tree)
+        {
+            if (path.empty()) return;
+            std::lock_guard<std::mutex> lock(mutex_);
+            DirtyPath& dirty = dirty_[FolderKey(path)];
+            dirty.path = path;
+            dirty.tree = dirty.tree || tree;
+            ScheduleLocked();
+        }
+
+        void OnWatchBatch(const std::vector<filesystem::FileChangeEvent>& events)
+        {
+            for (const auto& event : events) {
+                MarkDirty(event.path.Get(), event.type == filesystem::FileChangeType::Unknown);
+                if (!event.old_path.Empty()) {
+                    MarkDirty(event.old_path.Get(), false);
+                }
+            }
+        }
+
+        // ---- Cached tree (callers hold mutex_) ----
+
+        SizeDelta EraseSubtreeLocked(const std::string& key)
+        {
+            SizeDelta removed;
+            auto top = nodes_.find(key);
+            if (top == nodes_.end()) return removed;
+
+            removed.bytes = -static_cast<int64_t>(top->second.total.bytes);
+            removed.files = -static_cast<int64_t>(top->second.total.files);
+            removed.folders = -static_cast<int64_t>(top->second.total.folders);
+            nodes_.erase(top);
+
+            std::string prefix = SubtreePrefix(key);
+            for (auto it = nodes_.lower_bound(prefix);
+                 it != nodes_.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+                it = nodes_.erase(it);
+            }
+            return removed;
+        }
+
+        static void Apply(FolderSize& size, const SizeDelta& delta)
+        {
+            size.bytes = static_cast<uint64_t>(static_cast<int64_t>(size.bytes) + delta.bytes);
+            size.files = static_cast<uint64_t>(static_cast<int64_t>(size.files) + delta.files);
+            size.folders = static_cast<uint64_t>(static_cast<int64_t>(size.folders) + delta.folders);
+        }
+
+        void AddToAncestorsLocked(const std::filesystem::path& dir, const SizeDelta& delta)
+        {
+            if (delta.IsZero()) return;
+            for (std::filesystem::path at = dir.parent_path(); !at.empty(); at = at.parent_path()) {
+                auto it = nodes_.find(FolderKey(at));
+                if (it == nodes_.end()) break;
+                Apply(it->second.total, delta);
+                if (at == at.parent_path()) break;
+            }
+        }
+
+        // Put a freshly measured subtree in place of the cached one
+        void ReplaceLocked(const std::filesystem::path& dir, std::vector<DirectorySize>& sizes)
+        {
+            std::string key = FolderKey(dir);
+            SizeDelta delta = EraseSubtreeLocked(key);
+            for (auto& size : sizes) {
+                std::string nodeKey = FolderKey(size.path);
+                Node& node = nodes_[nodeKey];
+                node.path = std::move(size.path);
+                node.directBytes = size.directBytes;
+                node.directFiles = size.directFiles;
+                node.directFolders = size.directFolders;
+                node.total = FolderSize{size.totalBytes, size.totalFiles, size.totalFolders, false};
+            }
+
+            const FolderSize& total = nodes_[key].total;
+            delta.bytes += static_cast<int64_t>(total.bytes);
+            delta.files += static_cast<int64_t>(total.files);
+            delta.folders += static_cast<int64_t>(total.folders);
+            AddToAncestorsLocked(dir, delta);
+            generation_++;
+        }
+
+        // ---- Measuring (drain only) ----
+
+        std::vector<DirectorySize> Walk(const std::filesystem::path& dir)
+        {
+            OPACITY_PROFILE_ZONE("FolderSizeService::Walk");
+            std::map<std::string, DirectorySize> found;
+            std::mutex foundMutex;
+            found[FolderKey(dir)].path = dir;
+
+            CrawlOptions options;
+            options.crawlThreads = kWalkThreads;
+            options.contentThreads = 0;
+            // Someone is waiting on these; pause only briefly for input
+            options.background.input_grace = std::chrono::milliseconds(150);
+            options.background.max_pause = std::chrono::milliseconds(1000);
+
+            CrawlCallbacks callbacks;
+            callbacks.createEntry = [](const std::filesystem::directory_entry& item) {
+                IndexEntry entry;
+                entry.path = item.path();
+                std::error_code ec;
+                entry.isDirectory = item.is_directory(ec);
+                if (!entry.isDirectory) {
+                    uint64_t size = item.file_size(ec);
+                    entry.size = ec ? 0 : size;
+                }
+                return entry;
+            };
+            callbacks.sink = [&](std::vector<IndexEntry>&& entries) {
+                std::lock_guard<std::mutex> lock(foundMutex);
+                for (auto& entry : entries) {
+                    DirectorySize& parent = found[FolderKey(entry.path.parent_path())];
+                    if (entry.isDirectory) {
+                        parent.directFolders++;
+                        DirectorySize& self = found[FolderKey(entry.path)];
+                        self.path = std::move(entry.path);
+                    } else {
+                        parent.directBytes += entry.size;
+                        parent.directFiles++;
+                    }
+                }
+            };
+
+            IndexCrawler crawler(options, std::move(callbacks));
+            crawler.Run({dir}, cancel_);
+
+            for (auto& [key, size] : found) {
+                size.totalBytes = size.directBytes;
+                size.totalFiles = size.directFiles;
+                size.totalFolders = size.directFolders;
+            }
+
+            // A subtree sorts right after its folder, so walking the keys
+            // backwards finishes every folder before its parent
+            std::string rootKey = FolderKey(dir);
+            for (auto it = found.rbegin(); it != found.rend(); ++it) {
+                if (it->first == rootKey) continue;
+                auto parent = found.find(FolderKey(it->second.path.parent_path()));
+                if (parent == found.end()) continue;
+                parent->second.totalBytes += it->second.totalBytes;
+                parent->second.totalFiles += it->second.totalFiles;
+                parent->second.totalFolders += it->second.totalFolders;
+            }
+
+            std::vector<DirectorySize> sizes;
+            sizes.reserve(found.size());
+            sizes.push_back(std::move(found[rootKey]));
+            found.erase(rootKey);
+            for (auto& [key, size] : found) {
+                if (!size.path.empty()) sizes.push_back(std::move(size));
+            }
+            return sizes;
+        }
+
+        void Measure(const std::filesystem::path& dir)
+        {
+            std::error_code ec;
+            if (!std::filesystem::is_directory(dir, ec)) return;
+
+            std::vector<DirectorySize> sizes;
+            if (index_) {
+                sizes = index_->GetDirectorySizes(dir);
+            }
+            bool fromIndex = !sizes.empty();
+            if (!fromIndex) {
+                sizes = Walk(dir);
+            }
+            if (cancel_) return;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                ReplaceLocked(dir, sizes);
+            }
+
+            // The index follows the journal for its own trees
+            if (!fromIndex) {
+                WatchTree(dir);
+            }
+        }
+
+        // List a cached folder's own files again and pass the change up
+        void RescanDirect(const std::filesystem::path& dir)
+        {
+            std::string key = FolderKey(dir);
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                if (nodes_.find(key) == nodes_.end()) return;
+            }
+
+            uint64_t bytes = 0, files = 0, folders = 0;
+            std::error_code ec;
+            for (const auto& item : std::filesystem::directory_iterator(
+                     dir, std::filesystem::directory_options::skip_permission_denied, ec)) {
+                std::error_code statEc;
+                if (item.is_directory(statEc)) {
+                    folders++;
+                } else {
+                    uint64_t size = item.file_size(statEc);
+                    bytes += statEc ? 0 : size;
+                    files++;
+                }
+            }
+            if (ec) return;
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = nodes_.find(key);
+            if (it == nodes_.end()) return;
+
+            Node& node = it->second;
+            SizeDelta delta;
+            delta.bytes = static_cast<int64_t>(bytes) - static_cast<int64_t>(node.directBytes);
+            delta.files = static_cast<int64_t>(files) - static_cast<int64_t>(node.directFiles);
+            delta.folders = static_cast<int64_t>(folders) - static_cast<int64_t>(node.directFolders);
+            if (delta.IsZero()) return;
+
+            node.directBytes = bytes;
+            node.directFiles = files;
+            node.directFolders = folders;
+            Apply(node.total, delta);
+            AddToAncestorsLocked(dir, delta);
+            generation_++;
+        }
+
+        void ApplyDirty(std::unordered_map<std::string, DirtyPath> dirty)
+        {
+            std::map<std::string, std::filesystem::path> rescan;
+            std::vector<std::filesystem::path> measure;
+
+            for (auto& [key, change] : dirty) {
+                std::error_code ec;
+                bool isDir = std::filesystem::is_directory(change.path, ec);
+                std::filesystem::path parent = change.path.parent_path();
+
+                {
+                    std::lock_guard<std::mutex> lock(mutex_);
+                    bool cached = nodes_.find(key) != nodes_.end();
+                    bool parentCached = nodes_.find(FolderKey(parent)) != nodes_.end();
+
+                    if (cached && !isDir) {
+                        // Gone, or replaced by a file
+                        AddToAncestorsLocked(change.path, EraseSubtreeLocked(key));
+                        generation_++;
+                    } else if (isDir && (change.tree || (!cached && parentCached))) {
+                        measure.push_back(change.path);
+                    } else if (cached) {
+                        rescan.emplace(key, change.path);
+                    }
+                    if (parentCached) {
+                        rescan.emplace(FolderKey(parent), parent);
+                    }
+                }
+            }
+
+            for (const auto& dir : measure) {
+                if (cancel_) return;
+                Measure(dir);
+            }
+            for (const auto& [key, dir] : rescan) {
+                if (cancel_) return;
+                RescanDirect(dir);
+            }
+        }
+
+        void WatchTree(const std::filesystem::path& dir)
+        {
+            std::string key = FolderKey(dir);
+            for (std::filesystem::path at = dir; !at.empty(); at = at.parent_path()) {
+                if (watches_.count(FolderKey(at)) > 0) return;    // Already covered
+                if (at == at.parent_path()) break;
+            }
+
+            // This watch covers any made for folders below
+            std::string prefix = SubtreePrefix(key);
+            for (auto it = watches_.lower_bound(prefix);
+                 it != watches_.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+                watch_.Unwatch(it->second);
+                it = watches_.erase(it);
+            }
+
+            filesystem::WatchConfig config;
+            config.recursive = true;
+            filesystem::WatchHandle handle = watch_.WatchBatch(
+                Path(dir),
+                [this](const std::vector<filesystem::FileChangeEvent>& events) { OnWatchBatch(events); },
+                config);
+            if (handle != 0) {
+                watches_[key] = handle;
+            }
+        }
+
+        void Drain()
+        {
+            EnsureLoaded();
+
+            std::unique_lock<std::mutex> lock(mutex_);
+            while (!stop_) {
+                if (!dirty_.empty()) {
+                    auto dirty = std::move(dirty_);
+                    dirty_.clear();
+                    lock.unlock();
+                    ApplyDirty(std::move(dirty));
+                    lock.lock();
+                    continue;
+                }
+                if (jobs_.empty()) break;
+
+                Job job = std::move(jobs_.front());
+                jobs_.erase(jobs_.begin());
+                queued_.erase(job.key);
+
+                // A folder above it may have been measured meanwhile
+                auto it = nodes_.find(job.key);
+                if (it != nodes_.end() && !it->second.total.stale) continue;
+
+                measuring_ = true;
+                lock.unlock();
+                Measure(job.path);
+                lock.lock();
+                measuring_ = false;
+            }
+            draining_ = false;
+            lock.unlock();
+
+            if (std::chrono::steady_clock::now() - lastSave_.load() >= kSaveInterval) {
+                Save();
+            }
+        }
+
+        // ---- Persistence ----
+
+        void EnsureLoaded()
+        {
+            std::lock_guard<std::mutex> fileLock(fileMutex_);
+            if (loaded_) return;
+            loaded_ = true;
+
+            std::ifstream file(snapshot_.GetPath(), std::ios::binary);
+            if (!file) return;
+            std::string data((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+            size_t pos = sizeof(kCacheMagic);
+            uint32_t version = 0;
+            uint64_t count = 0;
+            if (data.size() < sizeof(kCacheMagic) || std::memcmp(data.data(), kCacheMagic, sizeof(kCacheMagic)) != 0 ||
+                !ReadValue(data, pos, version) || version != kCacheVersion || !ReadValue(data, pos, count)) {
+                Logger::Get()->warn("FolderSizeService: Ignoring unreadable cache {}", snapshot_.GetPath().string());
+                return;
+            }
+
+            std::map<std::string, Node> loaded;
+            for (uint64_t i = 0; i < count; ++i) {
+                uint32_t length = 0;
+                Node node;
+                if (!ReadValue(data, pos, length) || data.size() - pos < length) break;
+                node.path = std::filesystem::u8path(data.substr(pos, length));
+                pos += length;
+                if (!ReadValue(data, pos, node.directBytes) || !ReadValue(data, pos, node.directFiles) ||
+                    !ReadValue(data, pos, node.directFolders) || !ReadValue(data, pos, node.total.bytes) ||
+                    !ReadValue(data, pos, node.total.files) || !ReadValue(data, pos, node.total.folders)) {
+                    break;
+                }
+                node.total.stale = true;
+                std::string key = FolderKey(node.path);
+                loaded.emplace(std::move(key), std::move(node));
+            }
+
+            // What is on disk now needs no writing until something changes
+            std::string state = Serialize(loaded);
+            snapshot_.Write(state, state);
+
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto& [key, node] : loaded) {
+                nodes_.emplace(key, std::move(node));
+            }
+            generation_++;
+            Logger::Get()->info("FolderSizeService: Loaded {} folder sizes", loaded.size());
+        }
+
+        static std::string Serialize(const std::map<std::string, Node>& nodes)
+        {
+            std::string out(kCacheMagic, sizeof(kCacheMagic));
+            WriteValue(out, kCacheVersion);
+            WriteValue(out, static_cast<uint64_t>(nodes.size()));
+            for (const auto& [key, node] : nodes) {
+                std::string path = node.path.u8string();
+                WriteValue(out, static_cast<uint32_t>(path.size()));
+                out.append(path);
+                WriteValue(out, node.directBytes);
+                WriteValue(out, node.directFiles);
+                WriteValue(out, node.directFolders);
+                WriteValue(out, node.total.bytes);
+                WriteValue(out, node.total.files);
+                WriteValue(out, node.total.folders);
+            }
+            return out;
+        }
+
+        bool Save()
+        {
+            OPACITY_PROFILE_ZONE("FolderSizeService::Save");
+            std::lock_guard<std::mutex> fileLock(fileMutex_);
+            if (!loaded_) return false;     // Would overwrite what was never read
+
+            std::string state;
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                state = Serialize(nodes_);
+            }
+            lastSave_ = std::chrono::steady_clock::now();
+            if (snapshot_.Unchanged(state)) return true;
+
+            std::error_code ec;
+            std::filesystem::create_directories(snapshot_.GetPath().parent_path(), ec);
+            return snapshot_.Write(state, state);
+        }
+    };
+
+    FolderSizeService::FolderSizeService(std::filesystem::path cacheFile)
+        : impl_(std::make_shared<Impl>(std::move(cacheFile)))
+    {
+    }
+
+    FolderSizeService::~FolderSizeService()
+    {
+        Shutdown();
+    }
+
+    void FolderSizeService::Initialize()
+    {
+        impl_->watch_.Start();
+    }
+
+    void FolderSizeService::Shutdown()
+    {
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            if (impl_->stop_) return;
+            impl_->stop_ = true;
+            impl_->jobs_.clear();
+            impl_->queued_.clear();
+        }
+        impl_->cancel_ = true;
+        impl_->drain_.Wait();
+
+        impl_->watch_.UnwatchAll();
+        impl_->watch_.Stop();
+        impl_->watches_.clear();
+        impl_->Save();
+    }
+
+    std::filesystem::path FolderSizeService::DefaultCacheFile()
+    {
+        std::filesystem::path base;
+#ifdef _WIN32
+        PWSTR path = nullptr;
+        if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_LocalAppData, 0, nullptr, &path)) && path) {
+            base = path;
+        }
+        CoTaskMemFree(path);
+#endif
+        if (base.empty()) {
+            std::error_code ec;
+            base = std::filesystem::temp_directory_path(ec);
+        }
+        return base / "Opacity" / "FolderSizes.bin";
+    }
+
+    void FolderSizeService::SetIndex(std::shared_ptr<SearchIndex> index)
+    {
+        if (index) {
+            // The index cannot drop a callback, so it holds only a weak reference
+            std::weak_ptr<Impl> weak = impl_;
+            index->OnIndexUpdate([weak](const IndexUpdateEvent& event) {
+                if (event.path.empty()) return;
+                if (event.type != IndexUpdateEvent::Type::Added &&
+                    event.type != IndexUpdateEvent::Type::Modified &&
+                    event.type != IndexUpdateEvent::Type::Removed) {
+                    return;
+                }
+                if (auto impl = weak.lock()) {
+                    impl->MarkDirty(event.path, false);
+                }
+            });
+        }
+
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        impl_->index_ = std::move(index);
+    }
+
+    std::optional<FolderSize> FolderSizeService::Get(const std::filesystem::path& dir)
+    {
+        if (dir.empty()) return std::nullopt;
+
+        std::string key = FolderKey(dir);
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        if (impl_->stop_) return std::nullopt;
+
+        std::optional<FolderSize> result;
+        auto it = impl_->nodes_.find(key);
+        if (it != impl_->nodes_.end()) {
+            result = it->second.total;
+            if (!result->stale) return result;
+        }
+
+        auto [queued, added] = impl_->queued_.try_emplace(key, impl_->frame_);
+        queued->second = impl_->frame_;
+        if (added) {
+            impl_->jobs_.push_back({dir, std::move(key)});
+            impl_->ScheduleLocked();
+        }
+        return result;
+    }
+
+    bool FolderSizeService::GetChildren(const std::filesystem::path& dir, std::vector<FolderEntry>& children,
+                                        FolderSize& ownFiles) const
+    {
+        children.clear();
+        std::string key = FolderKey(dir);
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+
+        const auto& nodes = impl_->nodes_;
+        auto self = nodes.find(key);
+        if (self == nodes.end()) return false;
+        ownFiles = FolderSize{self->second.directBytes, self->second.directFiles, 0, self->second.total.stale};
+
+        // Take each child and jump past its subtree, which ends where
+        // keys continue with anything above the separator
+        std::string prefix = SubtreePrefix(key);
+        for (auto it = nodes.lower_bound(prefix);
+             it != nodes.end() && it->first.compare(0, prefix.size(), prefix) == 0;) {
+            children.push_back({it->second.path, it->second.total});
+            it = nodes.lower_bound(it->first + static_cast<char>(kSeparator + 1));
+        }
+        return true;
+    }
+
+    void FolderSizeService::BeginFrame()
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        auto& jobs = impl_->jobs_;
+        auto& queued = impl_->queued_;
+        uint64_t frame = impl_->frame_;
+        jobs.erase(std::remove_if(jobs.begin(), jobs.end(), [&](const Impl::Job& job) {
+            auto it = queued.find(job.key);
+            if (it != queued.end() && it->second == frame) return false;
+            queued.erase(job.key);
+            return true;
+        }), jobs.end());
+        impl_->frame_++;
+    }
+
+    uint64_t FolderSizeService::GetGeneration() const
+    {
+        return impl_->generation_.load();
+    }
+
+    size_t FolderSizeService::GetQueuedCount() const
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        return impl_->jobs_.size() + (impl_->measuring_ ? 1 : 0);
+    }
+
+    bool FolderSizeService::Save()
+    {
+        return impl_->Save();
+    }
+
+} // namespace opacity::search
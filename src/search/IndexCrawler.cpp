@@ -0,0 +1,323 @@
+#include "opacity/search/IndexCrawler.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace opacity::search
+{
+    // Report progress roughly every this many processed entries
+    static constexpr size_t kProgressInterval = 256;
+
+    IndexCrawler::IndexCrawler(CrawlOptions options, CrawlCallbacks callbacks)
+        : options_(options)
+        , callbacks_(std::move(callbacks))
+    {
+        options_.crawlThreads = std::max(1, options_.crawlThreads);
+        options_.contentThreads = std::max(1, options_.contentThreads);
+        options_.batchSize = std::max<size_t>(1, options_.batchSize);
+        options_.contentQueueCapacity = std::max<size_t>(1, options_.contentQueueCapacity);
+
+        for (int i = 0; i < options_.crawlThreads; ++i) {
+            queues_.push_back(std::make_unique<WorkerQueue>());
+        }
+    }
+
+    IndexCrawler::~IndexCrawler() = default;
+
+    void IndexCrawler::Run(const std::vector<std::filesystem::path>& roots, const std::atomic<bool>& cancel)
+    {
+        crawlDone_ = false;
+        processed_ = 0;
+        discovered_ = 0;
+
+        // Seed roots round-robin so every worker starts with local work
+        size_t next = 0;
+        for (const auto& root : roots) {
+            std::error_code ec;
+            if (!std::filesystem::is_directory(root, ec)) continue;
+            PushDirectory(next++ % queues_.size(), root);
+        }
+
+        core::TaskGroup contentWorkers;
+        StartContentWorkers(contentWorkers, cancel);
+
+        // This thread crawls the first queue; helpers that start take the
+        // others, and it steals whatever the rest of them leave seeded
+        core::TaskGroup crawlWorkers;
+        std::atomic<size_t> nextQueue{1};
+        crawlWorkers.Spawn(queues_.size() - 1, [this, &nextQueue, &cancel] {
+            CrawlWorker(nextQueue++, cancel);
+        }, WorkerOptions());
+        CrawlWorker(0, cancel);
+        crawlWorkers.Close();
+
+        FinishContentWorkers(contentWorkers, cancel);
+
+        // Drop anything left behind by a cancelled crawl
+        for (auto& queue : queues_) {
+            queue->dirs.clear();
+        }
+        pendingDirs_ = 0;
+    }
+
+    void IndexCrawler::Ingest(std::vector<IndexEntry>&& entries, const std::atomic<bool>& cancel)
+    {
+        crawlDone_ = false;
+        processed_ = 0;
+        discovered_ = entries.size();
+
+        core::TaskGroup contentWorkers;
+        StartContentWorkers(contentWorkers, cancel);
+
+        std::vector<IndexEntry> batch;
+        batch.reserve(options_.batchSize);
+        for (auto& entry : entries) {
+            if (cancel) break;
+
+            if (callbacks_.wantsContent && callbacks_.wantsContent(entry)) {
+                if (!PushContent(std::move(entry), batch, cancel)) break;
+                continue;
+            }
+
+            std::filesystem::path current = entry.path;
+            batch.push_back(std::move(entry));
+            if (batch.size() >= options_.batchSize) {
+                Flush(batch);
+            }
+            processed_++;
+            ReportProgress(current);
+        }
+        Flush(batch);
+        entries.clear();
+
+        FinishContentWorkers(contentWorkers, cancel);
+    }
+
+    core::TaskOptions IndexCrawler::WorkerOptions() const
+    {
+        core::TaskOptions options;
+        if (options_.background.low_priority) {
+            options.priority = core::TaskPriority::Background;
+        }
+        return options;
+    }
+
+    void IndexCrawler::StartContentWorkers(core::TaskGroup& workers, const std::atomic<bool>& cancel)
+    {
+        workers.Spawn(options_.contentThreads, [this, &cancel] { ContentWorker(cancel); }, WorkerOptions());
+    }
+
+    void IndexCrawler::FinishContentWorkers(core::TaskGroup& workers, const std::atomic<bool>& cancel)
+    {
+        {
+            std::lock_guard<std::mutex> lock(contentMutex_);
+            crawlDone_ = true;
+        }
+        contentNotEmpty_.notify_all();
+
+        // Extract whatever the helpers have not got to, then wait for them
+        ContentWorker(cancel);
+        workers.Close();
+        contentQueue_.clear();
+    }
+
+    void IndexCrawler::CrawlWorker(size_t index, const std::atomic<bool>& cancel)
+    {
+        core::BackgroundScope background(options_.background);
+        std::vector<IndexEntry> batch;
+        batch.reserve(options_.batchSize);
+
+        while (!cancel) {
+            std::filesystem::path dir;
+            if (PopDirectory(index, dir) || StealDirectory(index, dir)) {
+                background.Yield(&cancel);
+                ProcessDirectory(index, dir, batch, cancel);
+                if (--pendingDirs_ == 0) {
+                    idleCv_.notify_all();
+                }
+                continue;
+            }
+
+            if (pendingDirs_ == 0) {
+                break;
+            }
+
+            // Others are still enumerating and may publish work soon
+            std::unique_lock<std::mutex> lock(idleMutex_);
+            idleCv_.wait_for(lock, std::chrono::milliseconds(2));
+        }
+
+        Flush(batch);
+    }
+
+    void IndexCrawler::ContentWorker(const std::atomic<bool>& cancel)
+    {
+        core::BackgroundScope background(options_.background);
+        std::vector<IndexEntry> batch;
+        batch.reserve(options_.batchSize);
+
+        for (;;) {
+            IndexEntry entry;
+            {
+                std::unique_lock<std::mutex> lock(contentMutex_);
+                contentNotEmpty_.wait(lock, [this, &cancel] {
+                    return !contentQueue_.empty() || crawlDone_ || cancel;
+                });
+                if (cancel || contentQueue_.empty()) {
+                    break;
+                }
+                entry = std::move(contentQueue_.front());
+                contentQueue_.pop_front();
+            }
+
+            background.Yield(&cancel);
+            ExtractContent(std::move(entry), batch);
+        }
+
+        Flush(batch);
+    }
+
+    void IndexCrawler::ProcessDirectory(size_t index, const std::filesystem::path& dir,
+                                        std::vector<IndexEntry>& batch, const std::atomic<bool>& cancel)
+    {
+        std::error_code ec;
+        std::filesystem::directory_iterator it(dir,
+            std::filesystem::directory_options::skip_permission_denied, ec);
+        if (ec) {
+            return;
+        }
+
+        for (const auto& item : it) {
+            if (cancel) return;
+
+            const auto& path = item.path();
+            discovered_++;
+
+            std::error_code statEc;
+            bool isDir = item.is_directory(statEc);
+            bool isLink = item.is_symlink(statEc);
+            if (isDir && (!isLink || options_.followSymlinks) &&
+                (!callbacks_.shouldDescend || callbacks_.shouldDescend(path)))
+            {
+                PushDirectory(index, path);
+            }
+
+            if (callbacks_.shouldIndex && !callbacks_.shouldIndex(path)) {
+                processed_++;
+                continue;
+            }
+
+            try {
+                IndexEntry entry = callbacks_.createEntry(item);
+                if (callbacks_.wantsContent && callbacks_.wantsContent(entry)) {
+                    if (!PushContent(std::move(entry), batch, cancel)) return;
+                    continue;
+                }
+                batch.push_back(std::move(entry));
+                if (batch.size() >= options_.batchSize) {
+                    Flush(batch);
+                }
+            }
+            catch (...) {
+                // Skip problematic files
+            }
+
+            processed_++;
+            ReportProgress(path);
+        }
+    }
+
+    void IndexCrawler::PushDirectory(size_t index, std::filesystem::path dir)
+    {
+        pendingDirs_++;
+        {
+            std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+            queues_[index]->dirs.push_back(std::move(dir));
+        }
+        idleCv_.notify_one();
+    }
+
+    bool IndexCrawler::PopDirectory(size_t index, std::filesystem::path& dir)
+    {
+        auto& queue = *queues_[index];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.dirs.empty()) {
+            return false;
+        }
+        dir = std::move(queue.dirs.back());
+        queue.dirs.pop_back();
+        return true;
+    }
+
+    bool IndexCrawler::StealDirectory(size_t index, std::filesystem::path& dir)
+    {
+        for (size_t offset = 1; offset < queues_.size(); ++offset) {
+            auto& victim = *queues_[(index + offset) % queues_.size()];
+            std::lock_guard<std::mutex> lock(victim.mutex);
+            if (!victim.dirs.empty()) {
+                // Oldest entries are closest to the root and carry the most work
+                dir = std::move(victim.dirs.front());
+                victim.dirs.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool IndexCrawler::PushContent(IndexEntry&& entry, std::vector<IndexEntry>& batch,
+                                   const std::atomic<bool>& cancel)
+    {
+        if (cancel) return false;
+
+        {
+            std::lock_guard<std::mutex> lock(contentMutex_);
+            if (contentQueue_.size() < options_.contentQueueCapacity) {
+                contentQueue_.push_back(std::move(entry));
+                contentNotEmpty_.notify_one();
+                return true;
+            }
+        }
+
+        // Back-pressure: while extraction is behind, enumeration does it
+        // too, rather than wait on helpers that may not have started
+        ExtractContent(std::move(entry), batch);
+        return true;
+    }
+
+    void IndexCrawler::ExtractContent(IndexEntry&& entry, std::vector<IndexEntry>& batch)
+    {
+        if (callbacks_.readContent) {
+            callbacks_.readContent(entry);
+        }
+        std::filesystem::path current = entry.path;
+        batch.push_back(std::move(entry));
+        if (batch.size() >= options_.batchSize) {
+            Flush(batch);
+        }
+
+        processed_++;
+        ReportProgress(current);
+    }
+
+    void IndexCrawler::Flush(std::vector<IndexEntry>& batch)
+    {
+        if (batch.empty()) {
+            return;
+        }
+        if (callbacks_.sink) {
+            callbacks_.sink(std::move(batch));
+        }
+        batch.clear();
+        batch.reserve(options_.batchSize);
+    }
+
+    void IndexCrawler::ReportProgress(const std::filesystem::path& current)
+    {
+        if (!callbacks_.progress || processed_ % kProgressInterval != 0) {
+            return;
+        }
+        std::lock_guard<std::mutex> lock(progressMutex_);
+        callbacks_.progress(current, processed_, discovered_);
+    }
+
+} // namespace opacity::search
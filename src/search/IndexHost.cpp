@@ -0,0 +1,867 @@
+#include "opacity/search/IndexHost.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/TaskScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cctype>
+#include <cstring>
+#include <list>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#endif
+
+namespace opacity::search
+{
+    using namespace opacity::core;
+
+    namespace
+    {
+        constexpr uint32_t kMagic = 0x4849504F;         // "OPIH"
+        constexpr uint16_t kProtocolVersion = 2;
+
+        enum class Op : uint16_t
+        {
+            Hello = 1,
+            QuickSearch = 2,
+            DirectorySizes = 3,
+            Status = 4,
+            Update = 5
+        };
+
+        enum class Status : uint16_t
+        {
+            Ok = 0,
+            BadRequest = 1,
+            TooLarge = 2,
+            Unavailable = 3
+        };
+
+        // Every request is one pipe message: this, then text and scope
+        struct RequestHeader
+        {
+            uint32_t magic = kMagic;
+            uint16_t version = kProtocolVersion;
+            uint16_t op = 0;
+            int32_t mode = 0;
+            int32_t maxDistance = 0;
+            int32_t maxResults = 0;
+            uint32_t textBytes = 0;
+            uint32_t scopeBytes = 0;
+        };
+
+        // Every reply is one pipe message holding only this; what it
+        // answers is in the connection's section
+        struct ReplyHeader
+        {
+            uint32_t magic = kMagic;
+            uint16_t op = 0;
+            uint16_t status = 0;
+            uint32_t processId = 0;
+            uint32_t connectionId = 0;
+            uint32_t sectionGeneration = 0;     // Reopen the section when this changes
+            uint32_t count = 0;                 // Records in the answer
+            uint32_t flags = 0;                 // kReply* bits
+            uint32_t reserved = 0;
+            uint64_t sectionBytes = 0;
+            uint64_t bytes = 0;                 // Length of the answer, from the section's start
+        };
+
+        // A search answer holds every hit there is, up to the count asked
+        // for: the index is not still being built, covers the scope, and
+        // did not stop at kScopedCandidates before the scope was filled
+        constexpr uint32_t kReplyComplete = 1;
+
+        constexpr uint64_t kInitialSection = 1ull << 20;
+        constexpr uint64_t kMaxSection = 256ull << 20;
+        constexpr size_t kMaxRequest = 64 * 1024;
+
+        // With a scope the index is asked for this many and those outside
+        // are dropped, since it cannot filter by folder itself
+        constexpr int kScopedCandidates = 20000;
+
+        // Records in the section are 8-byte aligned; fixed fields first,
+        // then the UTF-8 path
+        struct EntryRecord
+        {
+            uint64_t size;
+            int64_t modifiedTicks;              // system_clock::duration since the epoch
+            uint32_t pathBytes;
+            uint32_t isDirectory;
+        };
+
+        struct SizeRecord
+        {
+            uint64_t directBytes;
+            uint64_t directFiles;
+            uint64_t directFolders;
+            uint64_t totalBytes;
+            uint64_t totalFiles;
+            uint64_t totalFolders;
+            uint32_t pathBytes;
+            uint32_t reserved;
+        };
+
+        struct StatusRecord
+        {
+            uint64_t totalFiles;
+            uint64_t totalDirectories;
+            int64_t lastUpdateTicks;
+            uint32_t processId;
+            uint32_t indexing;
+            uint32_t rootCount;
+            uint32_t reserved;
+        };
+
+        void Align(std::string& out)
+        {
+            out.resize((out.size() + 7) & ~size_t{7}, '\0');
+        }
+
+        template <typename T>
+        void Append(std::string& out, const T& record, const std::string& text)
+        {
+            out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+            out += text;
+            Align(out);
+        }
+
+        template <typename T>
+        bool Read(const char* base, uint64_t bytes, uint64_t& pos, T& record, std::string_view& text,
+                  uint32_t T::*textBytes)
+        {
+            if (pos + sizeof(T) > bytes) return false;
+            std::memcpy(&record, base + pos, sizeof(T));
+            pos += sizeof(T);
+            uint32_t length = record.*textBytes;
+            if (pos + length > bytes) return false;
+            text = std::string_view(base + pos, length);
+            pos = (pos + length + 7) & ~uint64_t{7};
+            return true;
+        }
+
+        std::string FoldedKey(const std::filesystem::path& path)
+        {
+            std::string key = path.lexically_normal().generic_u8string();
+            while (key.size() > 1 && key.back() == '/' && key[key.size() - 2] != ':') {
+                key.pop_back();
+            }
+            for (char& c : key) {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+            return key;
+        }
+
+        // Case-insensitive, whole components only
+        bool IsUnder(const std::string& pathKey, const std::string& scopeKey)
+        {
+            if (pathKey.size() < scopeKey.size() || pathKey.compare(0, scopeKey.size(), scopeKey) != 0) {
+                return false;
+            }
+            return pathKey.size() == scopeKey.size() || scopeKey.back() == '/' || pathKey[scopeKey.size()] == '/';
+        }
+
+#ifdef _WIN32
+        std::wstring Widen(const std::string& text)
+        {
+            if (text.empty()) return {};
+            int length = MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), nullptr, 0);
+            std::wstring wide(static_cast<size_t>(length), L'\0');
+            MultiByteToWideChar(CP_UTF8, 0, text.data(), static_cast<int>(text.size()), wide.data(), length);
+            return wide;
+        }
+
+        std::wstring SectionName(uint32_t processId, uint32_t connectionId, uint32_t generation)
+        {
+            return L"Local\\Opacity.IndexHost." + std::to_wstring(processId) + L"." +
+                   std::to_wstring(connectionId) + L"." + std::to_wstring(generation);
+        }
+
+        // Waits for overlapped I/O on handle, or for stop; false on either
+        // failure or stop, with the I/O cancelled. more is set when a read
+        // got only the start of a message
+        bool Finish(HANDLE handle, OVERLAPPED& overlapped, BOOL started, HANDLE stop, DWORD& bytes,
+                    bool* more = nullptr)
+        {
+            if (more) *more = false;
+            if (!started) {
+                DWORD error = GetLastError();
+                if (error == ERROR_PIPE_CONNECTED) return true;
+                if (error == ERROR_IO_PENDING) {
+                    HANDLE events[] = {overlapped.hEvent, stop};
+                    if (WaitForMultipleObjects(2, events, FALSE, INFINITE) != WAIT_OBJECT_0) {
+                        CancelIoEx(handle, &overlapped);
+                        GetOverlappedResult(handle, &overlapped, &bytes, TRUE);
+                        return false;
+                    }
+                } else if (error != ERROR_MORE_DATA) {
+                    return false;
+                }
+            }
+            if (GetOverlappedResult(handle, &overlapped, &bytes, FALSE)) return true;
+            if (GetLastError() != ERROR_MORE_DATA || !more) return false;
+            *more = true;
+            return true;
+        }
+#endif
+    }
+
+    std::string IndexHost::PipeName()
+    {
+        std::string name = "\\\\.\\pipe\\Opacity.IndexHost";
+#ifdef _WIN32
+        DWORD session = 0;
+        if (ProcessIdToSessionId(GetCurrentProcessId(), &session)) {
+            name += "." + std::to_string(session);
+        }
+#endif
+        return name;
+    }
+
+    // ============== IndexHost ==============
+
+    struct IndexHost::Impl
+    {
+#ifdef _WIN32
+        struct Connection
+        {
+            uint32_t id = 0;
+            HANDLE pipe = INVALID_HANDLE_VALUE;
+            HANDLE section = nullptr;
+            char* view = nullptr;
+            uint64_t sectionBytes = 0;
+            uint32_t generation = 0;
+            std::thread thread;
+            std::atomic<bool> done{false};
+
+            ~Connection()
+            {
+                if (view) UnmapViewOfFile(view);
+                if (section) CloseHandle(section);
+                if (pipe != INVALID_HANDLE_VALUE) CloseHandle(pipe);
+            }
+
+            // A bigger section under the next generation's name; the
+            // client opens it on seeing the generation change
+            bool Reserve(uint64_t bytes)
+            {
+                if (view && bytes <= sectionBytes) return true;
+
+                uint64_t size = std::max(sectionBytes, kInitialSection);
+                while (size < bytes) size *= 2;
+                if (size > kMaxSection) return false;
+
+                std::wstring name = SectionName(GetCurrentProcessId(), id, generation + 1);
+                HANDLE next = CreateFileMappingW(INVALID_HANDLE_VALUE, nullptr, PAGE_READWRITE,
+                                                 static_cast<DWORD>(size >> 32), static_cast<DWORD>(size),
+                                                 name.c_str());
+                if (!next) return false;
+                auto* nextView = static_cast<char*>(MapViewOfFile(next, FILE_MAP_WRITE, 0, 0, 0));
+                if (!nextView) {
+                    CloseHandle(next);
+                    return false;
+                }
+
+                // A client still reading the old view keeps it alive
+                if (view) UnmapViewOfFile(view);
+                if (section) CloseHandle(section);
+                section = next;
+                view = nextView;
+                sectionBytes = size;
+                ++generation;
+                return true;
+            }
+        };
+
+        HANDLE stop_ = nullptr;
+        std::thread acceptThread_;
+        std::list<std::unique_ptr<Connection>> connections_;
+#endif
+        explicit Impl(std::shared_ptr<SearchIndex> index) : index_(std::move(index)) {}
+
+        std::shared_ptr<SearchIndex> index_;
+        std::string pipeName_ = IndexHost::PipeName();
+        std::atomic<bool> running_{false};
+        std::atomic<size_t> clients_{0};
+        uint32_t nextConnection_ = 1;
+        mutable std::mutex mutex_;
+
+        // ---- Answers, as they go into the section ----
+
+        Status AnswerQuickSearch(const RequestHeader& request, const std::string& text, const std::string& scope,
+                                 std::string& out, uint32_t& count, uint32_t& flags)
+        {
+            OPACITY_PROFILE_ZONE("IndexHost::QuickSearch");
+            if (request.maxResults <= 0) return Status::Ok;
+
+            QuickSearchOptions options;
+            options.mode = static_cast<NameMatchMode>(request.mode);
+            options.maxDistance = request.maxDistance;
+            options.maxResults = scope.empty() ? request.maxResults
+                                               : std::max(request.maxResults, kScopedCandidates);
+
+            std::string scopeKey = scope.empty() ? std::string() : FoldedKey(std::filesystem::u8path(scope));
+            bool covered = scopeKey.empty();
+            for (const auto& root : index_->GetIndexedRoots()) {
+                covered = covered || IsUnder(scopeKey, FoldedKey(root));
+            }
+
+            auto candidates = index_->QuickSearch(text, options);
+            for (const auto& path : candidates) {
+                if (!scopeKey.empty() && !IsUnder(FoldedKey(path), scopeKey)) continue;
+
+                EntryRecord record{};
+                std::string utf8 = path.u8string();
+                record.pathBytes = static_cast<uint32_t>(utf8.size());
+                if (auto entry = index_->GetEntry(path, false)) {
+                    record.size = entry->size;
+                    record.modifiedTicks = entry->modifiedTime.time_since_epoch().count();
+                    record.isDirectory = entry->isDirectory ? 1 : 0;
+                }
+                Append(out, record, utf8);
+                if (static_cast<int>(++count) >= request.maxResults) break;
+            }
+
+            bool truncated = !scopeKey.empty() && static_cast<int>(count) < request.maxResults &&
+                             static_cast<int>(candidates.size()) >= options.maxResults;
+            if (covered && !truncated && !index_->IsIndexing()) flags |= kReplyComplete;
+            return Status::Ok;
+        }
+
+        Status AnswerDirectorySizes(const std::string& text, std::string& out, uint32_t& count)
+        {
+            for (const auto& size : index_->GetDirectorySizes(std::filesystem::u8path(text))) {
+                SizeRecord record{};
+                std::string utf8 = size.path.u8string();
+                record.directBytes = size.directBytes;
+                record.directFiles = size.directFiles;
+                record.directFolders = size.directFolders;
+                record.totalBytes = size.totalBytes;
+                record.totalFiles = size.totalFiles;
+                record.totalFolders = size.totalFolders;
+                record.pathBytes = static_cast<uint32_t>(utf8.size());
+                Append(out, record, utf8);
+                ++count;
+            }
+            return Status::Ok;
+        }
+
+        Status AnswerStatus(std::string& out, uint32_t& count)
+        {
+            IndexStats stats = index_->GetStatistics();
+            auto roots = index_->GetIndexedRoots();
+
+            StatusRecord record{};
+            record.totalFiles = stats.totalFiles;
+            record.totalDirectories = stats.totalDirectories;
+            record.lastUpdateTicks = stats.lastUpdate.time_since_epoch().count();
+#ifdef _WIN32
+            record.processId = GetCurrentProcessId();
+#endif
+            record.indexing = index_->IsIndexing() ? 1 : 0;
+            record.rootCount = static_cast<uint32_t>(roots.size());
+            out.append(reinterpret_cast<const char*>(&record), sizeof(record));
+            for (const auto& root : roots) {
+                std::string utf8 = root.u8string();
+                uint32_t length = static_cast<uint32_t>(utf8.size());
+                out.append(reinterpret_cast<const char*>(&length), sizeof(length));
+                out += utf8;
+            }
+            count = 1;
+            return Status::Ok;
+        }
+
+        Status AnswerUpdate()
+        {
+            if (index_->IsIndexing()) return Status::Ok;
+
+            // Not waited on; the index runs one update at a time
+            std::weak_ptr<SearchIndex> weak = index_;
+            core::TaskOptions options;
+            options.priority = core::TaskPriority::Background;
+            core::TaskScheduler::Get().Submit([weak](const core::CancellationToken&) {
+                if (auto index = weak.lock()) {
+                    index->UpdateIndex();
+                }
+            }, std::move(options));
+            return Status::Ok;
+        }
+
+#ifdef _WIN32
+        HANDLE CreateInstance(bool first)
+        {
+            DWORD openMode = PIPE_ACCESS_DUPLEX | FILE_FLAG_OVERLAPPED | (first ? FILE_FLAG_FIRST_PIPE_INSTANCE : 0);
+            return CreateNamedPipeW(Widen(pipeName_).c_str(), openMode,
+                                    PIPE_TYPE_MESSAGE | PIPE_READMODE_MESSAGE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+                                    PIPE_UNLIMITED_INSTANCES, 4096, static_cast<DWORD>(kMaxRequest), 0, nullptr);
+        }
+
+        void AcceptLoop(HANDLE listening)
+        {
+            Profiler::SetThreadName("Index host");
+
+            OVERLAPPED overlapped = {};
+            overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+            HANDLE pipe = listening;
+            while (running_ && pipe != INVALID_HANDLE_VALUE) {
+                ResetEvent(overlapped.hEvent);
+                DWORD bytes = 0;
+                BOOL connected = ConnectNamedPipe(pipe, &overlapped);
+                if (!Finish(pipe, overlapped, connected, stop_, bytes)) {
+                    if (!running_) break;
+                    // The client gave up before it was accepted
+                    DisconnectNamedPipe(pipe);
+                    continue;
+                }
+
+                std::lock_guard<std::mutex> lock(mutex_);
+                connections_.remove_if([](const std::unique_ptr<Connection>& connection) {
+                    if (!connection->done) return false;
+                    connection->thread.join();
+                    return true;
+                });
+
+                auto connection = std::make_unique<Connection>();
+                connection->id = nextConnection_++;
+                connection->pipe = pipe;
+                Connection* raw = connection.get();
+                connection->thread = std::thread([this, raw]() { Serve(*raw); });
+                connections_.push_back(std::move(connection));
+
+                pipe = CreateInstance(false);
+                if (pipe == INVALID_HANDLE_VALUE) {
+                    Logger::Get()->error("IndexHost: cannot open another pipe instance ({}); new clients are refused",
+                                         GetLastError());
+                }
+            }
+
+            if (pipe != INVALID_HANDLE_VALUE) CloseHandle(pipe);
+            CloseHandle(overlapped.hEvent);
+        }
+
+        void Serve(Connection& connection)
+        {
+            ++clients_;
+            OVERLAPPED overlapped = {};
+            overlapped.hEvent = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+
+            std::string request;
+            std::string answer;
+            char buffer[4096];
+            while (running_) {
+                // One message, however many reads it takes
+                request.clear();
+                bool more = true;
+                bool failed = false;
+                while (more && !failed) {
+                    ResetEvent(overlapped.hEvent);
+                    DWORD bytes = 0;
+                    BOOL read = ReadFile(connection.pipe, buffer, sizeof(buffer), nullptr, &overlapped);
+                    failed = !Finish(connection.pipe, overlapped, read, stop_, bytes, &more);
+                    request.append(buffer, failed ? 0 : bytes);
+                    failed = failed || request.size() > kMaxRequest;
+                }
+                if (failed || request.size() < sizeof(RequestHeader)) break;
+
+                RequestHeader header;
+                std::memcpy(&header, request.data(), sizeof(header));
+                ReplyHeader reply;
+                reply.op = header.op;
+                reply.processId = GetCurrentProcessId();
+                reply.connectionId = connection.id;
+
+                Status status = Status::BadRequest;
+                answer.clear();
+                if (header.magic == kMagic && header.version == kProtocolVersion &&
+                    sizeof(header) + uint64_t{header.textBytes} + header.scopeBytes == request.size()) {
+                    std::string text = request.substr(sizeof(header), header.textBytes);
+                    std::string scope = request.substr(sizeof(header) + header.textBytes, header.scopeBytes);
+                    switch (static_cast<Op>(header.op)) {
+                    case Op::Hello: status = Status::Ok; break;
+                    case Op::QuickSearch:
+                        status = AnswerQuickSearch(header, text, scope, answer, reply.count, reply.flags);
+                        break;
+                    case Op::DirectorySizes: status = AnswerDirectorySizes(text, answer, reply.count); break;
+                    case Op::Status: status = AnswerStatus(answer, reply.count); break;
+                    case Op::Update: status = AnswerUpdate(); break;
+                    default: break;
+                    }
+                }
+
+                if (status == Status::Ok) {
+                    if (connection.Reserve(answer.size())) {
+                        std::memcpy(connection.view, answer.data(), answer.size());
+                        reply.bytes = answer.size();
+                    } else {
+                        status = Status::TooLarge;
+                        reply.count = 0;
+                    }
+                }
+                reply.status = static_cast<uint16_t>(status);
+                reply.sectionGeneration = connection.generation;
+                reply.sectionBytes = connection.sectionBytes;
+
+                ResetEvent(overlapped.hEvent);
+                DWORD written = 0;
+                BOOL wrote = WriteFile(connection.pipe, &reply, sizeof(reply), nullptr, &overlapped);
+                if (!Finish(connection.pipe, overlapped, wrote, stop_, written)) break;
+            }
+
+            DisconnectNamedPipe(connection.pipe);
+            CloseHandle(overlapped.hEvent);
+            --clients_;
+            connection.done = true;
+        }
+#endif
+    };
+
+    IndexHost::IndexHost(std::shared_ptr<SearchIndex> index)
+        : impl_(std::make_shared<Impl>(std::move(index)))
+    {
+    }
+
+    IndexHost::~IndexHost()
+    {
+        Stop();
+    }
+
+    bool IndexHost::Start()
+    {
+        if (impl_->running_ || !impl_->index_) return impl_->running_;
+#ifdef _WIN32
+        HANDLE listening = impl_->CreateInstance(true);
+        if (listening == INVALID_HANDLE_VALUE) {
+            Logger::Get()->info("IndexHost: {} is taken; another process is hosting the index", impl_->pipeName_);
+            return false;
+        }
+
+        impl_->stop_ = CreateEventW(nullptr, TRUE, FALSE, nullptr);
+        impl_->running_ = true;
+        impl_->acceptThread_ = std::thread([impl = impl_.get(), listening]() { impl->AcceptLoop(listening); });
+        Logger::Get()->info("IndexHost: serving the index on {}", impl_->pipeName_);
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    void IndexHost::Stop()
+    {
+        if (!impl_->running_) return;
+        impl_->running_ = false;
+#ifdef _WIN32
+        SetEvent(impl_->stop_);
+        if (impl_->acceptThread_.joinable()) {
+            impl_->acceptThread_.join();
+        }
+
+        std::list<std::unique_ptr<Impl::Connection>> connections;
+        {
+            std::lock_guard<std::mutex> lock(impl_->mutex_);
+            connections.swap(impl_->connections_);
+        }
+        for (auto& connection : connections) {
+            if (connection->thread.joinable()) connection->thread.join();
+        }
+
+        CloseHandle(impl_->stop_);
+        impl_->stop_ = nullptr;
+#endif
+    }
+
+    bool IndexHost::IsRunning() const
+    {
+        return impl_->running_;
+    }
+
+    size_t IndexHost::GetClientCount() const
+    {
+        return impl_->clients_;
+    }
+
+    // ============== IndexClient ==============
+
+    struct IndexClient::Impl
+    {
+#ifdef _WIN32
+        HANDLE pipe_ = INVALID_HANDLE_VALUE;
+        HANDLE section_ = nullptr;
+        const char* view_ = nullptr;
+#endif
+        uint32_t processId_ = 0;
+        uint32_t connectionId_ = 0;
+        uint32_t generation_ = 0;
+        uint64_t sectionBytes_ = 0;
+        std::mutex mutex_;
+
+        void Close()
+        {
+#ifdef _WIN32
+            if (view_) UnmapViewOfFile(view_);
+            if (section_) CloseHandle(section_);
+            if (pipe_ != INVALID_HANDLE_VALUE) CloseHandle(pipe_);
+            view_ = nullptr;
+            section_ = nullptr;
+            pipe_ = INVALID_HANDLE_VALUE;
+#endif
+            generation_ = 0;
+            sectionBytes_ = 0;
+        }
+
+        // Sends one request; on success the answer is at view_[0, reply.bytes)
+        bool Call(Op op, const std::string& text, const std::string& scope, const QuickSearchOptions* options,
+                  ReplyHeader& reply)
+        {
+#ifdef _WIN32
+            if (pipe_ == INVALID_HANDLE_VALUE) return false;
+
+            RequestHeader header;
+            header.op = static_cast<uint16_t>(op);
+            if (options) {
+                header.mode = static_cast<int32_t>(options->mode);
+                header.maxDistance = options->maxDistance;
+                header.maxResults = options->maxResults;
+            }
+            header.textBytes = static_cast<uint32_t>(text.size());
+            header.scopeBytes = static_cast<uint32_t>(scope.size());
+
+            std::string request(reinterpret_cast<const char*>(&header), sizeof(header));
+            request += text;
+            request += scope;
+            if (request.size() > kMaxRequest) return false;
+
+            DWORD read = 0;
+            if (!TransactNamedPipe(pipe_, request.data(), static_cast<DWORD>(request.size()), &reply,
+                                   sizeof(reply), &read, nullptr) ||
+                read != sizeof(reply) || reply.magic != kMagic) {
+                Logger::Get()->warn("IndexClient: lost the index host ({})", GetLastError());
+                Close();
+                return false;
+            }
+            processId_ = reply.processId;
+            connectionId_ = reply.connectionId;
+
+            if (reply.sectionGeneration != generation_ && reply.sectionGeneration != 0) {
+                if (view_) UnmapViewOfFile(view_);
+                if (section_) CloseHandle(section_);
+                view_ = nullptr;
+                section_ = OpenFileMappingW(FILE_MAP_READ, FALSE,
+                                            SectionName(processId_, connectionId_, reply.sectionGeneration).c_str());
+                if (section_) {
+                    view_ = static_cast<const char*>(MapViewOfFile(section_, FILE_MAP_READ, 0, 0, 0));
+                }
+                if (!view_) {
+                    Logger::Get()->warn("IndexClient: cannot map the answer section ({})", GetLastError());
+                    Close();
+                    return false;
+                }
+                generation_ = reply.sectionGeneration;
+                sectionBytes_ = reply.sectionBytes;
+            }
+
+            return reply.status == static_cast<uint16_t>(Status::Ok) &&
+                   (reply.bytes == 0 || (view_ && reply.bytes <= sectionBytes_));
+#else
+            (void)op; (void)text; (void)scope; (void)options; (void)reply;
+            return false;
+#endif
+        }
+
+        const char* View() const
+        {
+#ifdef _WIN32
+            return view_;
+#else
+            return nullptr;
+#endif
+        }
+    };
+
+    IndexClient::IndexClient()
+        : impl_(std::make_unique<Impl>())
+    {
+    }
+
+    IndexClient::~IndexClient()
+    {
+        Disconnect();
+    }
+
+    bool IndexClient::Connect(std::chrono::milliseconds timeout)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+#ifdef _WIN32
+        if (impl_->pipe_ != INVALID_HANDLE_VALUE) return true;
+
+        std::wstring name = Widen(IndexHost::PipeName());
+        auto deadline = std::chrono::steady_clock::now() + timeout;
+        while (true) {
+            impl_->pipe_ = CreateFileW(name.c_str(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                                       SECURITY_SQOS_PRESENT | SECURITY_IDENTIFICATION, nullptr);
+            if (impl_->pipe_ != INVALID_HANDLE_VALUE) break;
+
+            DWORD error = GetLastError();
+            auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+            if (left.count() <= 0 || (error != ERROR_PIPE_BUSY && error != ERROR_FILE_NOT_FOUND)) return false;
+
+            if (error == ERROR_PIPE_BUSY) {
+                WaitNamedPipeW(name.c_str(), static_cast<DWORD>(left.count()));
+            } else {
+                // Between two instances, or no host at all
+                std::this_thread::sleep_for(std::chrono::milliseconds(std::min<long long>(10, left.count())));
+            }
+        }
+
+        DWORD mode = PIPE_READMODE_MESSAGE;
+        ReplyHeader reply;
+        if (!SetNamedPipeHandleState(impl_->pipe_, &mode, nullptr, nullptr) ||
+            !impl_->Call(Op::Hello, {}, {}, nullptr, reply)) {
+            impl_->Close();
+            return false;
+        }
+        return true;
+#else
+        (void)timeout;
+        return false;
+#endif
+    }
+
+    void IndexClient::Disconnect()
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        impl_->Close();
+    }
+
+    bool IndexClient::IsConnected() const
+    {
+#ifdef _WIN32
+        return impl_->pipe_ != INVALID_HANDLE_VALUE;
+#else
+        return false;
+#endif
+    }
+
+    bool IndexClient::IsHostRunning()
+    {
+#ifdef _WIN32
+        std::wstring name = Widen(IndexHost::PipeName());
+        // Busy instances still mean a host; only a missing pipe does not
+        return WaitNamedPipeW(name.c_str(), 1) || GetLastError() != ERROR_FILE_NOT_FOUND;
+#else
+        return false;
+#endif
+    }
+
+    bool IndexClient::QuickSearch(const std::string& pattern, const QuickSearchOptions& options,
+                                  const std::filesystem::path& scope,
+                                  const std::function<bool(const HostedEntry& entry)>& visit, bool* complete)
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        ReplyHeader reply;
+        if (complete) *complete = false;
+        if (!impl_->Call(Op::QuickSearch, pattern, scope.u8string(), &options, reply)) return false;
+        if (complete) *complete = (reply.flags & kReplyComplete) != 0;
+
+        const char* base = impl_->View();
+        uint64_t pos = 0;
+        for (uint32_t i = 0; i < reply.count; ++i) {
+            EntryRecord record;
+            HostedEntry entry;
+            if (!Read(base, reply.bytes, pos, record, entry.path, &EntryRecord::pathBytes)) break;
+            entry.size = record.size;
+            entry.modifiedTime = std::chrono::system_clock::time_point(
+                std::chrono::system_clock::duration(record.modifiedTicks));
+            entry.isDirectory = record.isDirectory != 0;
+            if (!visit(entry)) break;
+        }
+        return true;
+    }
+
+    std::vector<std::filesystem::path> IndexClient::QuickSearch(const std::string& pattern,
+                                                                const QuickSearchOptions& options,
+                                                                const std::filesystem::path& scope)
+    {
+        std::vector<std::filesystem::path> paths;
+        QuickSearch(pattern, options, scope, [&paths](const HostedEntry& entry) {
+            paths.push_back(std::filesystem::u8path(entry.path.begin(), entry.path.end()));
+            return true;
+        });
+        return paths;
+    }
+
+    std::vector<DirectorySize> IndexClient::GetDirectorySizes(const std::filesystem::path& dir)
+    {
+        std::vector<DirectorySize> sizes;
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        ReplyHeader reply;
+        if (!impl_->Call(Op::DirectorySizes, dir.u8string(), {}, nullptr, reply)) return sizes;
+
+        const char* base = impl_->View();
+        uint64_t pos = 0;
+        sizes.reserve(reply.count);
+        for (uint32_t i = 0; i < reply.count; ++i) {
+            SizeRecord record;
+            std::string_view path;
+            if (!Read(base, reply.bytes, pos, record, path, &SizeRecord::pathBytes)) break;
+
+            DirectorySize size;
+            size.path = std::filesystem::u8path(path.begin(), path.end());
+            size.directBytes = record.directBytes;
+            size.directFiles = record.directFiles;
+            size.directFolders = record.directFolders;
+            size.totalBytes = record.totalBytes;
+            size.totalFiles = record.totalFiles;
+            size.totalFolders = record.totalFolders;
+            sizes.push_back(std::move(size));
+        }
+        return sizes;
+    }
+
+    std::optional<HostStatus> IndexClient::GetStatus()
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        ReplyHeader reply;
+        if (!impl_->Call(Op::Status, {}, {}, nullptr, reply) || reply.bytes < sizeof(StatusRecord)) {
+            return std::nullopt;
+        }
+
+        const char* base = impl_->View();
+        StatusRecord record;
+        std::memcpy(&record, base, sizeof(record));
+
+        HostStatus status;
+        status.processId = record.processId;
+        status.totalFiles = static_cast<size_t>(record.totalFiles);
+        status.totalDirectories = static_cast<size_t>(record.totalDirectories);
+        status.indexing = record.indexing != 0;
+        status.lastUpdate = std::chrono::system_clock::time_point(
+            std::chrono::system_clock::duration(record.lastUpdateTicks));
+
+        uint64_t pos = sizeof(record);
+        for (uint32_t i = 0; i < record.rootCount; ++i) {
+            uint32_t length = 0;
+            if (pos + sizeof(length) > reply.bytes) break;
+            std::memcpy(&length, base + pos, sizeof(length));
+            pos += sizeof(length);
+            if (pos + length > reply.bytes) break;
+            status.roots.push_back(std::filesystem::u8path(base + pos, base + pos + length));
+            pos += length;
+        }
+        return status;
+    }
+
+    bool IndexClient::RequestUpdate()
+    {
+        std::lock_guard<std::mutex> lock(impl_->mutex_);
+        ReplyHeader reply;
+        return impl_->Call(Op::Update, {}, {}, nullptr, reply);
+    }
+
+} // namespace opacity::search
@@ -0,0 +1,486 @@
+#include "opacity/search/MftReader.h"
+#include "opacity/search/UsnJournal.h"
+#include "opacity/core/Logger.h"
+
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#else
+#include <fstream>
+#endif
+
+namespace opacity::search
+{
+    using namespace opacity::core;
+
+    // ============== On-disk layout ==============
+
+    static constexpr uint32_t kAttrStandardInformation = 0x10;
+    static constexpr uint32_t kAttrFileName = 0x30;
+    static constexpr uint32_t kAttrData = 0x80;
+    static constexpr uint32_t kAttrEnd = 0xFFFFFFFF;
+
+    static constexpr uint16_t kRecordInUse = 0x0001;
+    static constexpr uint16_t kRecordDirectory = 0x0002;
+
+    static constexpr uint8_t kNamespaceDos = 2;
+    static constexpr uint64_t kReferenceMask = 0x0000FFFFFFFFFFFFull;
+
+    // 100ns ticks between 1601-01-01 and 1970-01-01, in microseconds
+    static constexpr int64_t kFileTimeEpochMicros = 11644473600000000LL;
+
+    static constexpr size_t kReadChunkSize = 1024 * 1024;
+
+    template <typename T>
+    static T ReadLE(const uint8_t* data)
+    {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        return value;
+    }
+
+    static int64_t FileTimeToMicros(uint64_t fileTime)
+    {
+        if (fileTime == 0) return 0;
+        return static_cast<int64_t>(fileTime / 10) - kFileTimeEpochMicros;
+    }
+
+    /**
+     * @brief Calls fn(type, attribute, length) for each attribute of a fixed-up record
+     */
+    template <typename Fn>
+    static void ForEachAttribute(const uint8_t* record, size_t size, Fn&& fn)
+    {
+        size_t used = std::min<size_t>(ReadLE<uint32_t>(record + 24), size);
+        size_t offset = ReadLE<uint16_t>(record + 20);
+
+        while (offset + 16 <= used) {
+            uint32_t type = ReadLE<uint32_t>(record + offset);
+            if (type == kAttrEnd) break;
+
+            uint32_t length = ReadLE<uint32_t>(record + offset + 4);
+            if (length < 16 || length > used - offset) break;
+
+            fn(type, record + offset, length);
+            offset += length;
+        }
+    }
+
+    // Resident attribute value, or empty if non-resident or out of bounds
+    static std::pair<const uint8_t*, uint32_t> ResidentValue(const uint8_t* attr, uint32_t length)
+    {
+        if (attr[8] != 0 || length < 24) return {nullptr, 0};
+        uint32_t valueLength = ReadLE<uint32_t>(attr + 16);
+        uint16_t valueOffset = ReadLE<uint16_t>(attr + 20);
+        if (valueOffset > length || valueLength > length - valueOffset) return {nullptr, 0};
+        return {attr + valueOffset, valueLength};
+    }
+
+    // ============== MftReader::Impl ==============
+
+    class MftReader::Impl
+    {
+    public:
+#ifdef _WIN32
+        HANDLE volume_ = INVALID_HANDLE_VALUE;
+#else
+        std::ifstream volume_;
+#endif
+        uint32_t clusterSize_ = 0;
+        uint32_t recordSize_ = 0;
+        uint64_t recordCount_ = 0;
+        std::vector<MftDataRun> extents_;
+
+        bool IsOpen() const
+        {
+#ifdef _WIN32
+            return volume_ != INVALID_HANDLE_VALUE;
+#else
+            return volume_.is_open();
+#endif
+        }
+
+        void Close()
+        {
+#ifdef _WIN32
+            if (volume_ != INVALID_HANDLE_VALUE) {
+                CloseHandle(volume_);
+                volume_ = INVALID_HANDLE_VALUE;
+            }
+#else
+            volume_.close();
+#endif
+            extents_.clear();
+            recordCount_ = 0;
+        }
+
+        bool OpenDevice(const std::string& device)
+        {
+#ifdef _WIN32
+            volume_ = CreateFileW(std::filesystem::path(device).wstring().c_str(), GENERIC_READ,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+#else
+            volume_.open(device, std::ios::binary);
+#endif
+            return IsOpen();
+        }
+
+        // Volume reads; offsets and sizes are cluster multiples after the boot sector
+        bool ReadAt(uint64_t offset, void* buffer, size_t size)
+        {
+#ifdef _WIN32
+            LARGE_INTEGER position;
+            position.QuadPart = static_cast<LONGLONG>(offset);
+            if (!SetFilePointerEx(volume_, position, nullptr, FILE_BEGIN)) {
+                return false;
+            }
+            auto* out = static_cast<uint8_t*>(buffer);
+            while (size > 0) {
+                DWORD request = static_cast<DWORD>(std::min<size_t>(size, 0x40000000));
+                DWORD bytes = 0;
+                if (!ReadFile(volume_, out, request, &bytes, nullptr) || bytes == 0) {
+                    return false;
+                }
+                out += bytes;
+                size -= bytes;
+            }
+            return true;
+#else
+            volume_.clear();
+            volume_.seekg(static_cast<std::streamoff>(offset));
+            volume_.read(static_cast<char*>(buffer), static_cast<std::streamsize>(size));
+            return static_cast<size_t>(volume_.gcount()) == size;
+#endif
+        }
+
+        // Reads a range of the MFT itself, following its extents
+        bool ReadMft(uint64_t offset, uint8_t* buffer, size_t size)
+        {
+            uint64_t extentStart = 0;
+            for (const auto& extent : extents_) {
+                uint64_t extentBytes = extent.clusters * clusterSize_;
+                uint64_t extentEnd = extentStart + extentBytes;
+                while (size > 0 && offset >= extentStart && offset < extentEnd) {
+                    size_t piece = static_cast<size_t>(std::min<uint64_t>(size, extentEnd - offset));
+                    if (extent.lcn < 0) {
+                        std::memset(buffer, 0, piece);
+                    } else if (!ReadAt(static_cast<uint64_t>(extent.lcn) * clusterSize_ + (offset - extentStart),
+                                       buffer, piece)) {
+                        return false;
+                    }
+                    buffer += piece;
+                    offset += piece;
+                    size -= piece;
+                }
+                if (size == 0) return true;
+                extentStart = extentEnd;
+            }
+            return size == 0;
+        }
+
+        bool ReadBootSector(uint64_t& mftOffset)
+        {
+            // Large enough for 4K-sector devices, which reject shorter reads
+            std::vector<uint8_t> boot(4096);
+            if (!ReadAt(0, boot.data(), boot.size()) || std::memcmp(boot.data() + 3, "NTFS    ", 8) != 0) {
+                return false;
+            }
+
+            uint32_t bytesPerSector = ReadLE<uint16_t>(boot.data() + 11);
+            uint32_t sectorsPerCluster = boot[13];
+            if (sectorsPerCluster > 0x80) {
+                sectorsPerCluster = 1u << (256 - sectorsPerCluster);
+            }
+            if (bytesPerSector < 512 || bytesPerSector > 4096 || (bytesPerSector & (bytesPerSector - 1)) != 0 ||
+                sectorsPerCluster == 0) {
+                return false;
+            }
+            clusterSize_ = bytesPerSector * sectorsPerCluster;
+
+            auto clustersPerRecord = static_cast<int8_t>(boot[64]);
+            recordSize_ = clustersPerRecord > 0
+                ? static_cast<uint32_t>(clustersPerRecord) * clusterSize_
+                : 1u << (-clustersPerRecord);
+            if (recordSize_ < 512 || recordSize_ > 65536) {
+                return false;
+            }
+
+            mftOffset = ReadLE<uint64_t>(boot.data() + 48) * clusterSize_;
+            return true;
+        }
+
+        // Record 0 is $MFT itself; its unnamed $DATA runs locate the whole table
+        bool LoadExtents(uint64_t mftOffset)
+        {
+            std::vector<uint8_t> record(std::max(recordSize_, clusterSize_));
+            if (!ReadAt(mftOffset, record.data(), record.size()) ||
+                !ApplyFixups(record.data(), recordSize_)) {
+                return false;
+            }
+
+            uint64_t dataSize = 0;
+            ForEachAttribute(record.data(), recordSize_, [&](uint32_t type, const uint8_t* attr, uint32_t length) {
+                if (type != kAttrData || attr[9] != 0 || attr[8] == 0 || length < 64) return;
+                if (ReadLE<uint64_t>(attr + 16) != 0 || !extents_.empty()) return;
+
+                uint16_t runsOffset = ReadLE<uint16_t>(attr + 32);
+                if (runsOffset >= length) return;
+                extents_ = ParseDataRuns(attr + runsOffset, length - runsOffset);
+                dataSize = ReadLE<uint64_t>(attr + 48);
+            });
+
+            recordCount_ = dataSize / recordSize_;
+            return !extents_.empty() && recordCount_ > 0;
+        }
+    };
+
+    // ============== MftReader ==============
+
+    MftReader::MftReader()
+        : impl_(std::make_unique<Impl>())
+    {}
+
+    MftReader::~MftReader()
+    {
+        Close();
+    }
+
+    bool MftReader::IsElevated()
+    {
+#ifdef _WIN32
+        HANDLE token = nullptr;
+        if (!OpenProcessToken(GetCurrentProcess(), TOKEN_QUERY, &token)) {
+            return false;
+        }
+        TOKEN_ELEVATION elevation{};
+        DWORD size = 0;
+        bool elevated = GetTokenInformation(token, TokenElevation, &elevation, sizeof(elevation), &size) &&
+                        elevation.TokenIsElevated != 0;
+        CloseHandle(token);
+        return elevated;
+#else
+        return false;
+#endif
+    }
+
+    bool MftReader::IsAvailable(const std::filesystem::path& root)
+    {
+        // Same volumes the change journal covers: local NTFS only
+        return IsElevated() && UsnJournal::IsSupported(root);
+    }
+
+    bool MftReader::Open(const std::string& volume)
+    {
+        Close();
+
+        // "C:\" or "C:" -> "\\.\C:"; anything else is used as given
+        std::string device = volume;
+        while (device.size() > 2 && (device.back() == '\\' || device.back() == '/')) {
+            device.pop_back();
+        }
+        if (device.size() == 2 && device[1] == ':') {
+            device = "\\\\.\\" + device;
+        }
+
+        if (!impl_->OpenDevice(device)) {
+            Logger::Get()->debug("MftReader: Cannot open {}", device);
+            return false;
+        }
+
+        uint64_t mftOffset = 0;
+        if (!impl_->ReadBootSector(mftOffset) || !impl_->LoadExtents(mftOffset)) {
+            Logger::Get()->warn("MftReader: {} is not a readable NTFS volume", volume);
+            Close();
+            return false;
+        }
+
+        Logger::Get()->info("MftReader: Opened {} ({} records)", volume, impl_->recordCount_);
+        return true;
+    }
+
+    void MftReader::Close()
+    {
+        impl_->Close();
+    }
+
+    uint64_t MftReader::RecordCount() const
+    {
+        return impl_->recordCount_;
+    }
+
+    bool MftReader::Enumerate(const std::function<void(const MftRecord&)>& fn, const std::atomic<bool>& cancel)
+    {
+        if (!impl_->IsOpen() || impl_->recordCount_ == 0) {
+            return false;
+        }
+
+        const uint32_t recordSize = impl_->recordSize_;
+        const uint64_t chunkRecords = std::max<uint64_t>(1, kReadChunkSize / recordSize);
+        std::vector<uint8_t> buffer(chunkRecords * recordSize);
+
+        for (uint64_t first = 0; first < impl_->recordCount_; first += chunkRecords) {
+            if (cancel) return false;
+
+            uint64_t count = std::min(chunkRecords, impl_->recordCount_ - first);
+            if (!impl_->ReadMft(first * recordSize, buffer.data(), count * recordSize)) {
+                Logger::Get()->error("MftReader: Read failed at record {}", first);
+                return false;
+            }
+
+            for (uint64_t i = 0; i < count; ++i) {
+                uint8_t* data = buffer.data() + i * recordSize;
+                if (!ApplyFixups(data, recordSize)) continue;
+
+                auto record = ParseRecord(data, recordSize, first + i);
+                if (record && record->inUse) {
+                    fn(*record);
+                }
+            }
+        }
+        return true;
+    }
+
+    // ============== Parsing ==============
+
+    bool MftReader::ApplyFixups(uint8_t* record, size_t size)
+    {
+        if (size < 48 || std::memcmp(record, "FILE", 4) != 0) {
+            return false;
+        }
+
+        size_t usaOffset = ReadLE<uint16_t>(record + 4);
+        size_t usaCount = ReadLE<uint16_t>(record + 6);
+        if (usaCount < 2 || usaOffset + usaCount * 2 > size) {
+            return false;
+        }
+
+        // One entry per stride (512 bytes on every NTFS version) plus the check value
+        size_t strides = usaCount - 1;
+        size_t stride = size / strides;
+        if (stride < 512 || stride * strides != size) {
+            return false;
+        }
+
+        uint16_t check = ReadLE<uint16_t>(record + usaOffset);
+        for (size_t i = 0; i < strides; ++i) {
+            uint8_t* tail = record + (i + 1) * stride - 2;
+            if (ReadLE<uint16_t>(tail) != check) {
+                return false;   // Torn write
+            }
+            std::memcpy(tail, record + usaOffset + 2 + i * 2, 2);
+        }
+        return true;
+    }
+
+    std::optional<MftRecord> MftReader::ParseRecord(const uint8_t* record, size_t size, uint64_t number)
+    {
+        if (size < 48 || std::memcmp(record, "FILE", 4) != 0) {
+            return std::nullopt;
+        }
+
+        MftRecord result;
+        result.number = number;
+        uint16_t flags = ReadLE<uint16_t>(record + 22);
+        result.inUse = (flags & kRecordInUse) != 0;
+        result.isDirectory = (flags & kRecordDirectory) != 0;
+        result.baseRecord = ReadLE<uint64_t>(record + 32) & kReferenceMask;
+        if (!result.inUse) {
+            return result;
+        }
+
+        uint8_t nameSpace = 0;
+        ForEachAttribute(record, size, [&](uint32_t type, const uint8_t* attr, uint32_t length) {
+            switch (type) {
+            case kAttrStandardInformation: {
+                auto [value, valueLength] = ResidentValue(attr, length);
+                if (value && valueLength >= 16) {
+                    result.modifiedTime = FileTimeToMicros(ReadLE<uint64_t>(value + 8));
+                }
+                break;
+            }
+            case kAttrFileName: {
+                auto [value, valueLength] = ResidentValue(attr, length);
+                if (!value || valueLength < 66) break;
+
+                uint8_t chars = value[64];
+                uint8_t ns = value[65];
+                if (66u + chars * 2u > valueLength) break;
+
+                // Prefer the long name over the 8.3 alias
+                if (result.name.empty() || (nameSpace == kNamespaceDos && ns != kNamespaceDos)) {
+                    result.parent = ReadLE<uint64_t>(value) & kReferenceMask;
+                    result.name.resize(chars);
+                    std::memcpy(result.name.data(), value + 66, chars * 2u);
+                    nameSpace = ns;
+                }
+                break;
+            }
+            case kAttrData: {
+                if (attr[9] != 0) break;    // Named stream
+                if (attr[8] == 0) {
+                    auto [value, valueLength] = ResidentValue(attr, length);
+                    (void)value;
+                    result.size = valueLength;
+                    result.hasSize = true;
+                } else if (length >= 64 && ReadLE<uint64_t>(attr + 16) == 0) {
+                    result.size = ReadLE<uint64_t>(attr + 48);
+                    result.hasSize = true;
+                }
+                break;
+            }
+            default:
+                break;
+            }
+        });
+
+        return result;
+    }
+
+    std::vector<MftDataRun> MftReader::ParseDataRuns(const uint8_t* runs, size_t size)
+    {
+        std::vector<MftDataRun> result;
+        int64_t lcn = 0;
+        size_t i = 0;
+
+        while (i < size && runs[i] != 0) {
+            uint8_t header = runs[i++];
+            size_t lengthBytes = header & 0x0F;
+            size_t offsetBytes = header >> 4;
+            if (lengthBytes == 0 || lengthBytes > 8 || offsetBytes > 8 || lengthBytes + offsetBytes > size - i) {
+                return {};
+            }
+
+            uint64_t clusters = 0;
+            for (size_t b = 0; b < lengthBytes; ++b) {
+                clusters |= static_cast<uint64_t>(runs[i + b]) << (8 * b);
+            }
+            i += lengthBytes;
+
+            MftDataRun run;
+            run.clusters = clusters;
+            if (offsetBytes == 0) {
+                run.lcn = -1;   // Sparse
+            } else {
+                uint64_t delta = 0;
+                for (size_t b = 0; b < offsetBytes; ++b) {
+                    delta |= static_cast<uint64_t>(runs[i + b]) << (8 * b);
+                }
+                // Sign-extend the relative offset
+                if (offsetBytes < 8 && (runs[i + offsetBytes - 1] & 0x80) != 0) {
+                    delta |= ~uint64_t{0} << (8 * offsetBytes);
+                }
+                lcn += static_cast<int64_t>(delta);
+                run.lcn = lcn;
+            }
+            i += offsetBytes;
+            result.push_back(run);
+        }
+        return result;
+    }
+
+} // namespace opacity::search
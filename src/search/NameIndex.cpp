@@ -0,0 +1,551 @@
+#include "opacity/search/NameIndex.h"
+#include "opacity/search/TextScanner.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+namespace opacity::search
+{
+    namespace
+    {
+        // Delta size that triggers a merge, at least this and base / kMergeRatio
+        constexpr size_t kMinMergeSize = 4096;
+        constexpr size_t kMergeRatio = 4;
+
+        // Matches remembered for the next keystroke; beyond this the next
+        // query starts from scratch
+        constexpr size_t kMaxStateTerms = 65536;
+
+        constexpr int kMaxFuzzyDistance = 2;
+
+        std::string Fold(std::string_view text)
+        {
+            std::string folded(text);
+            for (char& c : folded) {
+                if (c >= 'A' && c <= 'Z') c = static_cast<char>(c | 0x20);
+            }
+            return folded;
+        }
+
+        bool StartsWith(std::string_view text, std::string_view prefix)
+        {
+            return text.size() >= prefix.size() && text.compare(0, prefix.size(), prefix) == 0;
+        }
+
+        // Distances are capped just past the limit so rows fit in bytes
+        inline uint8_t Cap(int value, int limit)
+        {
+            return static_cast<uint8_t>(std::min(value, limit + 1));
+        }
+
+        /**
+         * @brief Next Levenshtein row for query against a name grown by one byte
+         * @return Smallest value in the new row
+         */
+        int NextRow(std::string_view query, const uint8_t* previous, uint8_t* row, int depth, char c, int limit)
+        {
+            const size_t m = query.size();
+            row[0] = Cap(depth, limit);
+            int smallest = row[0];
+            for (size_t j = 1; j <= m; ++j) {
+                int substitute = previous[j - 1] + (query[j - 1] != c ? 1 : 0);
+                int insert = previous[j] + 1;
+                int remove = row[j - 1] + 1;
+                row[j] = Cap(std::min({substitute, insert, remove}), limit);
+                smallest = std::min<int>(smallest, row[j]);
+            }
+            return smallest;
+        }
+
+        // Fuzzy input needs some length before edits are allowed at all
+        int EffectiveDistance(size_t queryLength, int maxDistance)
+        {
+            int lengthCap = queryLength <= 2 ? 0 : (queryLength <= 5 ? 1 : kMaxFuzzyDistance);
+            return std::clamp(maxDistance, 0, lengthCap);
+        }
+
+        /**
+         * @brief Rank of a name for a query, or -1 if it does not match
+         *
+         * Prefix and substring ranks are 0 for names starting with the query
+         * and 1 for other substring matches; fuzzy ranks are edit distances.
+         */
+        int RankOf(std::string_view query, std::string_view name, NameMatchMode mode, int distance)
+        {
+            switch (mode) {
+            case NameMatchMode::Prefix:
+                return StartsWith(name, query) ? 0 : -1;
+
+            case NameMatchMode::Substring:
+                if (StartsWith(name, query)) return 0;
+                return TextScanner::Find(name, query, true) != std::string_view::npos ? 1 : -1;
+
+            case NameMatchMode::Fuzzy: {
+                if (name.empty() || name[0] != query[0]) return -1;
+                int found = NameIndex::PrefixDistance(query, name, distance);
+                return found <= distance ? found : -1;
+            }
+            }
+            return -1;
+        }
+    }
+
+    // ============== Updates ==============
+
+    void NameIndex::Add(DocId doc, std::string_view name)
+    {
+        if (doc < removed_.size() && removed_[doc]) {
+            removed_[doc] = false;
+            removedCount_--;
+        }
+        delta_.emplace_back(doc, Fold(name));
+
+        if (delta_.size() >= std::max(kMinMergeSize, TermCount() / kMergeRatio)) {
+            Merge();
+        }
+    }
+
+    void NameIndex::Remove(DocId doc)
+    {
+        if (doc >= removed_.size()) {
+            removed_.resize(static_cast<size_t>(doc) + 1, false);
+        }
+        if (!removed_[doc]) {
+            removed_[doc] = true;
+            removedCount_++;
+        }
+
+        // Reclaim postings once tombstones dominate them
+        if (removedCount_ >= kMinMergeSize && removedCount_ * 2 > postings_.size()) {
+            Merge();
+        }
+    }
+
+    void NameIndex::Merge()
+    {
+        if (delta_.empty() && removedCount_ == 0) {
+            return;
+        }
+
+        std::sort(delta_.begin(), delta_.end(), [](const auto& a, const auto& b) {
+            return a.second != b.second ? a.second < b.second : a.first < b.first;
+        });
+
+        std::string terms;
+        std::vector<uint32_t> termOffsets{0};
+        std::vector<uint32_t> postingOffsets{0};
+        std::vector<DocId> postings;
+        terms.reserve(terms_.size());
+        termOffsets.reserve(TermCount() + delta_.size() + 1);
+        postingOffsets.reserve(TermCount() + delta_.size() + 1);
+        postings.reserve(postings_.size() + delta_.size());
+
+        auto finishTerm = [&](std::string_view term) {
+            if (postings.size() == postingOffsets.back()) {
+                return;     // Every document of this name is gone
+            }
+            terms.append(term);
+            termOffsets.push_back(static_cast<uint32_t>(terms.size()));
+            postingOffsets.push_back(static_cast<uint32_t>(postings.size()));
+        };
+
+        // Both sides are sorted by name, and by DocId within a name
+        const uint32_t baseCount = static_cast<uint32_t>(TermCount());
+        uint32_t term = 0;
+        size_t pending = 0;
+        std::vector<DocId> merged;
+        while (term < baseCount || pending < delta_.size()) {
+            std::string_view baseName = term < baseCount ? Term(term) : std::string_view();
+            int order = term >= baseCount ? 1
+                      : pending >= delta_.size() ? -1
+                      : baseName.compare(delta_[pending].second);
+
+            std::string_view name = order <= 0 ? baseName : std::string_view(delta_[pending].second);
+            merged.clear();
+
+            if (order <= 0) {
+                for (uint32_t p = postingOffsets_[term]; p < postingOffsets_[term + 1]; ++p) {
+                    merged.push_back(postings_[p]);
+                }
+                term++;
+            }
+            if (order >= 0) {
+                size_t firstDelta = merged.size();
+                while (pending < delta_.size() && delta_[pending].second == name) {
+                    merged.push_back(delta_[pending].first);
+                    pending++;
+                }
+                std::inplace_merge(merged.begin(), merged.begin() + firstDelta, merged.end());
+            }
+
+            DocId last = kNoDoc;
+            for (DocId doc : merged) {
+                if (doc != last && !IsRemoved(doc)) {
+                    postings.push_back(doc);
+                }
+                last = doc;
+            }
+
+            // name may point into delta_ or terms_, both still alive here
+            finishTerm(name);
+        }
+
+        terms_ = std::move(terms);
+        termOffsets_ = std::move(termOffsets);
+        postingOffsets_ = std::move(postingOffsets);
+        postings_ = std::move(postings);
+        delta_.clear();
+        delta_.shrink_to_fit();
+
+        // Removed documents have left the postings
+        removed_.clear();
+        removedCount_ = 0;
+
+        generation_++;
+    }
+
+    void NameIndex::Clear()
+    {
+        terms_.clear();
+        termOffsets_.clear();
+        postingOffsets_.clear();
+        postings_.clear();
+        delta_.clear();
+        removed_.clear();
+        removedCount_ = 0;
+        generation_++;
+    }
+
+    size_t NameIndex::MemoryUsage() const
+    {
+        size_t bytes = terms_.capacity() +
+                       termOffsets_.capacity() * sizeof(uint32_t) +
+                       postingOffsets_.capacity() * sizeof(uint32_t) +
+                       postings_.capacity() * sizeof(DocId) +
+                       removed_.capacity() / 8;
+        for (const auto& [doc, name] : delta_) {
+            bytes += sizeof(doc) + sizeof(name) + name.capacity();
+        }
+        return bytes;
+    }
+
+    // ============== Queries ==============
+
+    int NameIndex::PrefixDistance(std::string_view query, std::string_view name, int limit)
+    {
+        const size_t m = query.size();
+        std::vector<uint8_t> previous(m + 1);
+        std::vector<uint8_t> row(m + 1);
+        for (size_t j = 0; j <= m; ++j) {
+            previous[j] = Cap(static_cast<int>(j), limit);
+        }
+
+        int best = previous[m];
+        for (size_t d = 1; d <= name.size() && best > 0; ++d) {
+            int smallest = NextRow(query, previous.data(), row.data(), static_cast<int>(d), name[d - 1], limit);
+            best = std::min<int>(best, row[m]);
+            if (smallest > limit) break;     // Rows only grow from here
+            previous.swap(row);
+        }
+        return best;
+    }
+
+    uint32_t NameIndex::RangeEnd(uint32_t from, std::string_view prefix) const
+    {
+        uint32_t low = from;
+        uint32_t high = static_cast<uint32_t>(TermCount());
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (StartsWith(Term(mid), prefix)) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+        return low;
+    }
+
+    bool NameIndex::FindPrefix(std::string_view query, size_t termLimit,
+                               std::vector<std::pair<uint32_t, uint8_t>>& out) const
+    {
+        uint32_t low = 0;
+        uint32_t high = static_cast<uint32_t>(TermCount());
+        while (low < high) {
+            uint32_t mid = low + (high - low) / 2;
+            if (Term(mid) < query) {
+                low = mid + 1;
+            } else {
+                high = mid;
+            }
+        }
+
+        uint32_t end = RangeEnd(low, query);
+        for (uint32_t term = low; term < end; ++term) {
+            if (out.size() >= termLimit) return false;
+            out.emplace_back(term, 0);
+        }
+        return true;
+    }
+
+    bool NameIndex::FindSubstring(std::string_view query, size_t termLimit,
+                                  std::vector<std::pair<uint32_t, uint8_t>>& out) const
+    {
+        // Names that start with the query rank first and come from the sorted range
+        if (!FindPrefix(query, termLimit, out)) {
+            return false;
+        }
+
+        // Scan the packed names, skipping hits that straddle two of them
+        // (TextScanner is fast enough that a dictionary-wide pass stays in
+        // single milliseconds; query state spares it on later keystrokes)
+        size_t pos = 0;
+        for (;;) {
+            size_t hit = TextScanner::Find(terms_, query, true, pos);
+            if (hit == std::string_view::npos) break;
+
+            auto next = std::upper_bound(termOffsets_.begin(), termOffsets_.end(), static_cast<uint32_t>(hit));
+            uint32_t term = static_cast<uint32_t>(next - termOffsets_.begin()) - 1;
+            size_t termEnd = termOffsets_[term + 1];
+            if (hit + query.size() > termEnd) {
+                pos = hit + 1;
+                continue;
+            }
+
+            if (hit != termOffsets_[term]) {     // Prefix matches are already in
+                if (out.size() >= termLimit) return false;
+                out.emplace_back(term, 1);
+            }
+            pos = termEnd;
+        }
+        return true;
+    }
+
+    bool NameIndex::FindFuzzy(std::string_view query, int maxDistance, size_t termLimit,
+                              std::vector<std::pair<uint32_t, uint8_t>>& out) const
+    {
+        // Exact prefixes (distance 0) are a plain range
+        if (!FindPrefix(query, termLimit, out)) {
+            return false;
+        }
+        if (maxDistance == 0) {
+            return true;
+        }
+
+        // Only names sharing the first byte are considered
+        const uint32_t count = static_cast<uint32_t>(TermCount());
+        uint32_t first = 0;
+        {
+            uint32_t high = count;
+            while (first < high) {
+                uint32_t mid = first + (high - first) / 2;
+                if (Term(mid) < query.substr(0, 1)) {
+                    first = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+        }
+        const uint32_t last = RangeEnd(first, query.substr(0, 1));
+
+        // rows[d] is the Levenshtein row for the first d bytes of the current
+        // name; best[d] the smallest full-query distance seen along the way
+        const size_t width = query.size() + 1;
+        std::vector<uint8_t> rows(width);
+        std::vector<uint8_t> best(1);
+        for (size_t j = 0; j < width; ++j) {
+            rows[j] = Cap(static_cast<int>(j), maxDistance);
+        }
+        best[0] = rows[width - 1];
+
+        // Once closer matches alone fill termLimit, farther ones are dropped
+        // and the walk prunes against the tighter cutoff
+        std::array<std::vector<uint32_t>, kMaxFuzzyDistance + 1> buckets;
+        const size_t exact = out.size();
+        int cutoff = maxDistance;
+        bool complete = true;
+
+        auto emit = [&](uint32_t begin, uint32_t end, int distance) {
+            if (distance == 0 || distance > cutoff) return;     // Distance 0 came from the prefix range
+            buckets[distance].insert(buckets[distance].end(), end - begin, 0);
+            std::iota(buckets[distance].end() - (end - begin), buckets[distance].end(), begin);
+
+            size_t found = exact;
+            for (int d = 1; d <= cutoff; ++d) {
+                found += buckets[d].size();
+                if (found >= termLimit) {
+                    for (int drop = d + 1; drop <= cutoff; ++drop) {
+                        if (!buckets[drop].empty()) complete = false;
+                        buckets[drop].clear();
+                    }
+                    if (found > termLimit) complete = false;
+                    cutoff = d;
+                    break;
+                }
+            }
+        };
+
+        std::string_view previous;
+        size_t computed = 0;
+        uint32_t term = first;
+        while (term < last) {
+            std::string_view name = Term(term);
+
+            size_t shared = 0;
+            size_t limit = std::min({name.size(), previous.size(), computed});
+            while (shared < limit && name[shared] == previous[shared]) ++shared;
+
+            size_t depth = shared;
+            bool decided = false;
+            while (depth < name.size()) {
+                depth++;
+                if (rows.size() < (depth + 1) * width) {
+                    rows.resize((depth + 1) * width);
+                    best.resize(depth + 1);
+                }
+                const uint8_t* above = rows.data() + (depth - 1) * width;
+                uint8_t* row = rows.data() + depth * width;
+                int smallest = NextRow(query, above, row, static_cast<int>(depth), name[depth - 1], maxDistance);
+                best[depth] = std::min(best[depth - 1], row[width - 1]);
+
+                // Row minima never shrink with depth, so the outcome for
+                // every name under this prefix is settled
+                if (smallest > cutoff || row[width - 1] == smallest) {
+                    uint32_t end = RangeEnd(term, name.substr(0, depth));
+                    if (best[depth] <= cutoff) {
+                        emit(term, end, best[depth]);
+                    }
+                    term = end;
+                    decided = true;
+                    break;
+                }
+            }
+
+            computed = depth;
+            previous = name;
+            if (!decided) {
+                if (best[depth] <= cutoff) {
+                    emit(term, term + 1, best[depth]);
+                }
+                term++;
+            }
+        }
+
+        for (int distance = 1; distance <= cutoff; ++distance) {
+            for (uint32_t id : buckets[distance]) {
+                if (out.size() >= termLimit) return false;
+                out.emplace_back(id, static_cast<uint8_t>(distance));
+            }
+        }
+        return complete;
+    }
+
+    std::vector<DocId> NameIndex::Query(std::string_view query, NameMatchMode mode, size_t maxResults,
+                                        int maxDistance, NameQueryState* state) const
+    {
+        std::vector<DocId> results;
+        const std::string folded = Fold(query);
+        if (folded.empty() || maxResults == 0) {
+            if (state) *state = NameQueryState{};
+            return results;
+        }
+
+        const int distance = mode == NameMatchMode::Fuzzy ? EffectiveDistance(folded.size(), maxDistance) : 0;
+
+        // ---- Matching terms, best rank first ----
+        std::vector<std::pair<uint32_t, uint8_t>> matches;
+        bool complete = false;
+
+        bool reuse = state && state->complete && state->generation == generation_ &&
+                     state->mode == mode && state->maxDistance == distance &&
+                     !state->query.empty() && StartsWith(folded, state->query);
+        if (reuse) {
+            // Extending the query only removes matches, but ranks can move,
+            // so each bucket is put back in term (name) order
+            std::array<std::vector<std::pair<uint32_t, uint8_t>>, kMaxFuzzyDistance + 1> buckets;
+            for (const auto& [term, previousRank] : state->terms) {
+                (void)previousRank;
+                int rank = RankOf(folded, Term(term), mode, distance);
+                if (rank >= 0) {
+                    buckets[rank].emplace_back(term, static_cast<uint8_t>(rank));
+                }
+            }
+            for (auto& bucket : buckets) {
+                std::sort(bucket.begin(), bucket.end());
+                matches.insert(matches.end(), bucket.begin(), bucket.end());
+            }
+            complete = true;
+        } else {
+            // Without a state only enough terms for the results are needed
+            size_t termLimit = state ? kMaxStateTerms : maxResults * 2 + 16;
+            switch (mode) {
+            case NameMatchMode::Prefix:
+                complete = FindPrefix(folded, termLimit, matches);
+                break;
+            case NameMatchMode::Substring:
+                complete = FindSubstring(folded, termLimit, matches);
+                break;
+            case NameMatchMode::Fuzzy:
+                complete = FindFuzzy(folded, distance, termLimit, matches);
+                break;
+            }
+        }
+
+        if (state) {
+            state->query = folded;
+            state->mode = mode;
+            state->maxDistance = distance;
+            state->generation = generation_;
+            state->complete = complete;
+            if (complete) {
+                state->terms = matches;
+            } else {
+                state->terms.clear();
+            }
+        }
+
+        // ---- Pending names ----
+        struct PendingMatch
+        {
+            int rank;
+            std::string_view name;
+            DocId doc;
+        };
+        std::vector<PendingMatch> pending;
+        for (const auto& [doc, name] : delta_) {
+            if (IsRemoved(doc)) continue;
+            int rank = RankOf(folded, name, mode, distance);
+            if (rank >= 0) {
+                pending.push_back({rank, name, doc});
+            }
+        }
+        std::sort(pending.begin(), pending.end(), [](const PendingMatch& a, const PendingMatch& b) {
+            return a.rank != b.rank ? a.rank < b.rank : a.name < b.name;
+        });
+
+        // ---- Merge both by (rank, name) ----
+        size_t p = 0;
+        auto emitPendingBefore = [&](int rank, std::string_view name) {
+            while (p < pending.size() && results.size() < maxResults &&
+                   (pending[p].rank < rank || (pending[p].rank == rank && pending[p].name < name)))
+            {
+                results.push_back(pending[p].doc);
+                p++;
+            }
+        };
+
+        for (const auto& [term, rank] : matches) {
+            if (results.size() >= maxResults) break;
+            emitPendingBefore(rank, Term(term));
+            for (uint32_t i = postingOffsets_[term]; i < postingOffsets_[term + 1] && results.size() < maxResults; ++i) {
+                if (!IsRemoved(postings_[i])) {
+                    results.push_back(postings_[i]);
+                }
+            }
+        }
+        emitPendingBefore(kMaxFuzzyDistance + 1, std::string_view());
+
+        return results;
+    }
+
+} // namespace opacity::search
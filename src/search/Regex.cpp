@@ -0,0 +1,755 @@
+#include "opacity/search/Regex.h"
+
+#include <algorithm>
+#include <bitset>
+#include <cctype>
+#include <cstdint>
+#include <stdexcept>
+
+namespace opacity::search
+{
+    // Limits that keep compiled programs (and so match cost) bounded
+    static constexpr int kMaxRepeat = 1000;
+    static constexpr size_t kMaxInstructions = 100000;
+    static constexpr int kMaxNesting = 256;
+
+    using ByteSet = std::bitset<256>;
+
+    enum class AssertKind : uint8_t { LineBegin, LineEnd, WordBoundary, NotWordBoundary };
+
+    static bool IsWordByte(unsigned char c)
+    {
+        return std::isalnum(c) || c == '_';
+    }
+
+    // ============== Syntax tree ==============
+
+    namespace
+    {
+        struct Node
+        {
+            enum class Type { Empty, Set, Concat, Alternate, Repeat, Assert };
+
+            Type type = Type::Empty;
+            ByteSet set;
+            int literal = -1;               // Set built from a single literal byte
+            std::vector<Node> children;
+            int min = 0;
+            int max = -1;                   // -1 = unbounded
+            bool greedy = true;
+            AssertKind assertion = AssertKind::LineBegin;
+        };
+
+        class ParseError : public std::runtime_error
+        {
+        public:
+            using std::runtime_error::runtime_error;
+        };
+
+        /**
+         * @brief Recursive descent parser producing a Node tree
+         */
+        class Parser
+        {
+        public:
+            Parser(std::string_view pattern, bool caseSensitive)
+                : pattern_(pattern), caseSensitive_(caseSensitive)
+            {}
+
+            Node Parse()
+            {
+                Node node = ParseAlternate();
+                if (pos_ < pattern_.size()) {
+                    throw ParseError(pattern_[pos_] == ')' ? "unmatched )" : "unexpected character");
+                }
+                return node;
+            }
+
+        private:
+            bool AtEnd() const { return pos_ >= pattern_.size(); }
+            char Peek() const { return pattern_[pos_]; }
+
+            Node ParseAlternate()
+            {
+                if (++depth_ > kMaxNesting) throw ParseError("pattern nested too deeply");
+
+                Node first = ParseConcat();
+                if (AtEnd() || Peek() != '|') {
+                    --depth_;
+                    return first;
+                }
+
+                Node alt;
+                alt.type = Node::Type::Alternate;
+                alt.children.push_back(std::move(first));
+                while (!AtEnd() && Peek() == '|') {
+                    ++pos_;
+                    alt.children.push_back(ParseConcat());
+                }
+                --depth_;
+                return alt;
+            }
+
+            Node ParseConcat()
+            {
+                Node concat;
+                concat.type = Node::Type::Concat;
+                while (!AtEnd() && Peek() != '|' && Peek() != ')') {
+                    Node atom = ParseAtom();
+                    concat.children.push_back(ParseQuantifiers(std::move(atom)));
+                }
+                if (concat.children.size() == 1) {
+                    return std::move(concat.children.front());
+                }
+                return concat;
+            }
+
+            Node ParseQuantifiers(Node atom)
+            {
+                while (!AtEnd()) {
+                    int min = 0;
+                    int max = -1;
+                    char c = Peek();
+                    if (c == '*') {
+                        ++pos_;
+                    } else if (c == '+') {
+                        min = 1;
+                        ++pos_;
+                    } else if (c == '?') {
+                        max = 1;
+                        ++pos_;
+                    } else if (c == '{' && ParseBraces(min, max)) {
+                        // Consumed by ParseBraces
+                    } else {
+                        break;
+                    }
+
+                    if (atom.type == Node::Type::Assert || atom.type == Node::Type::Empty) {
+                        throw ParseError("nothing to repeat");
+                    }
+
+                    Node repeat;
+                    repeat.type = Node::Type::Repeat;
+                    repeat.min = min;
+                    repeat.max = max;
+                    if (!AtEnd() && Peek() == '?') {
+                        repeat.greedy = false;
+                        ++pos_;
+                    }
+                    repeat.children.push_back(std::move(atom));
+                    atom = std::move(repeat);
+                }
+                return atom;
+            }
+
+            // {n}, {n,}, {n,m}; anything else leaves '{' as a literal
+            bool ParseBraces(int& min, int& max)
+            {
+                size_t p = pos_ + 1;
+                auto number = [&](int& value) {
+                    size_t start = p;
+                    long long result = 0;
+                    while (p < pattern_.size() && std::isdigit(static_cast<unsigned char>(pattern_[p]))) {
+                        result = result * 10 + (pattern_[p] - '0');
+                        if (result > kMaxRepeat) throw ParseError("repetition count too large");
+                        ++p;
+                    }
+                    value = static_cast<int>(result);
+                    return p > start;
+                };
+
+                if (!number(min)) return false;
+                max = min;
+                if (p < pattern_.size() && pattern_[p] == ',') {
+                    ++p;
+                    if (!number(max)) max = -1;
+                }
+                if (p >= pattern_.size() || pattern_[p] != '}') return false;
+                if (max != -1 && max < min) throw ParseError("invalid repetition range");
+
+                pos_ = p + 1;
+                return true;
+            }
+
+            Node ParseAtom()
+            {
+                char c = pattern_[pos_++];
+                switch (c) {
+                case '(': {
+                    if (pattern_.substr(pos_, 2) == "?:") {
+                        pos_ += 2;
+                    } else if (!AtEnd() && Peek() == '?') {
+                        throw ParseError("lookaround and inline flags are not supported");
+                    }
+                    Node inner = ParseAlternate();
+                    if (AtEnd() || Peek() != ')') throw ParseError("missing )");
+                    ++pos_;
+                    return inner;
+                }
+                case '[':
+                    return MakeSet(ParseClass());
+                case '.': {
+                    ByteSet any;
+                    any.set();
+                    any.reset('\n');
+                    return MakeSet(any);
+                }
+                case '^':
+                    return MakeAssert(AssertKind::LineBegin);
+                case '$':
+                    return MakeAssert(AssertKind::LineEnd);
+                case '\\':
+                    return ParseEscape();
+                case '*':
+                case '+':
+                case '?':
+                    throw ParseError("nothing to repeat");
+                default:
+                    return MakeLiteral(static_cast<unsigned char>(c));
+                }
+            }
+
+            Node ParseEscape()
+            {
+                if (AtEnd()) throw ParseError("trailing backslash");
+                char c = pattern_[pos_++];
+
+                if (c == 'b') return MakeAssert(AssertKind::WordBoundary);
+                if (c == 'B') return MakeAssert(AssertKind::NotWordBoundary);
+                if (c >= '1' && c <= '9') throw ParseError("backreferences are not supported");
+
+                ByteSet set;
+                if (ClassEscape(c, set)) {
+                    return MakeSet(set);
+                }
+                return MakeLiteral(LiteralEscape(c));
+            }
+
+            // \d \w \s and their negations
+            static bool ClassEscape(char c, ByteSet& set)
+            {
+                ByteSet result;
+                char lower = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+                if (lower != 'd' && lower != 'w' && lower != 's') return false;
+
+                for (int b = 0; b < 256; ++b) {
+                    bool in = lower == 'd' ? std::isdigit(b) != 0
+                            : lower == 'w' ? IsWordByte(static_cast<unsigned char>(b))
+                            : (b == ' ' || (b >= '\t' && b <= '\r'));
+                    result[b] = in;
+                }
+                if (c != lower) result.flip();
+                set |= result;
+                return true;
+            }
+
+            unsigned char LiteralEscape(char c)
+            {
+                switch (c) {
+                case 'n': return '\n';
+                case 'r': return '\r';
+                case 't': return '\t';
+                case 'f': return '\f';
+                case 'v': return '\v';
+                case '0': return '\0';
+                case 'x': {
+                    auto hex = [this]() {
+                        if (AtEnd() || !std::isxdigit(static_cast<unsigned char>(Peek()))) {
+                            throw ParseError("invalid \\x escape");
+                        }
+                        char h = pattern_[pos_++];
+                        return std::isdigit(static_cast<unsigned char>(h)) ? h - '0' : (std::tolower(h) - 'a' + 10);
+                    };
+                    int high = hex();
+                    int low = hex();
+                    return static_cast<unsigned char>(high * 16 + low);
+                }
+                default:
+                    if (std::isalnum(static_cast<unsigned char>(c))) {
+                        throw ParseError(std::string("unknown escape \\") + c);
+                    }
+                    return static_cast<unsigned char>(c);
+                }
+            }
+
+            ByteSet ParseClass()
+            {
+                ByteSet set;
+                bool negate = !AtEnd() && Peek() == '^';
+                if (negate) ++pos_;
+
+                bool first = true;
+                while (true) {
+                    if (AtEnd()) throw ParseError("missing ]");
+                    char c = pattern_[pos_++];
+                    if (c == ']' && !first) break;
+                    first = false;
+
+                    int low;
+                    if (c == '\\') {
+                        if (AtEnd()) throw ParseError("missing ]");
+                        char e = pattern_[pos_++];
+                        if (ClassEscape(e, set)) continue;
+                        low = e == 'b' ? '\b' : LiteralEscape(e);
+                    } else {
+                        low = static_cast<unsigned char>(c);
+                    }
+
+                    int high = low;
+                    if (pos_ + 1 < pattern_.size() && Peek() == '-' && pattern_[pos_ + 1] != ']') {
+                        ++pos_;
+                        char h = pattern_[pos_++];
+                        if (h == '\\') {
+                            if (AtEnd()) throw ParseError("missing ]");
+                            high = LiteralEscape(pattern_[pos_++]);
+                        } else {
+                            high = static_cast<unsigned char>(h);
+                        }
+                        if (high < low) throw ParseError("invalid class range");
+                    }
+
+                    for (int b = low; b <= high; ++b) {
+                        AddByte(set, static_cast<unsigned char>(b));
+                    }
+                }
+
+                if (negate) set.flip();
+                return set;
+            }
+
+            void AddByte(ByteSet& set, unsigned char b) const
+            {
+                set.set(b);
+                if (!caseSensitive_) {
+                    set.set(static_cast<unsigned char>(std::tolower(b)));
+                    set.set(static_cast<unsigned char>(std::toupper(b)));
+                }
+            }
+
+            Node MakeLiteral(unsigned char b) const
+            {
+                Node node;
+                node.type = Node::Type::Set;
+                AddByte(node.set, b);
+                node.literal = b;
+                return node;
+            }
+
+            static Node MakeSet(const ByteSet& set)
+            {
+                Node node;
+                node.type = Node::Type::Set;
+                node.set = set;
+                return node;
+            }
+
+            static Node MakeAssert(AssertKind kind)
+            {
+                Node node;
+                node.type = Node::Type::Assert;
+                node.assertion = kind;
+                return node;
+            }
+
+            std::string_view pattern_;
+            bool caseSensitive_;
+            size_t pos_ = 0;
+            int depth_ = 0;
+        };
+    }
+
+    // ============== Program ==============
+
+    struct RegexProgram
+    {
+        enum class Op : uint8_t { Byte, Split, Jump, Assert, Match };
+
+        struct Inst
+        {
+            Op op;
+            AssertKind assertion;
+            uint32_t x;                     // Byte: set index; Split/Jump: target (preferred)
+            uint32_t y;                     // Split: alternative target
+        };
+
+        std::vector<Inst> insts;
+        std::vector<ByteSet> sets;
+        ByteSet firstBytes;                 // Bytes that can begin a match
+        bool anyFirst = true;               // A match can begin without consuming a byte
+        bool caseSensitive = true;
+        std::vector<std::string> literals;
+    };
+
+    namespace
+    {
+        class Compiler
+        {
+        public:
+            explicit Compiler(RegexProgram& program) : program_(program) {}
+
+            void Compile(const Node& root)
+            {
+                Emit(root);
+                Add({Op::Match, AssertKind::LineBegin, 0, 0});
+            }
+
+        private:
+            using Op = RegexProgram::Op;
+            using Inst = RegexProgram::Inst;
+
+            uint32_t Add(Inst inst)
+            {
+                if (program_.insts.size() >= kMaxInstructions) {
+                    throw ParseError("pattern too large");
+                }
+                program_.insts.push_back(inst);
+                return static_cast<uint32_t>(program_.insts.size() - 1);
+            }
+
+            uint32_t Next() const { return static_cast<uint32_t>(program_.insts.size()); }
+
+            void Emit(const Node& node)
+            {
+                switch (node.type) {
+                case Node::Type::Empty:
+                    break;
+                case Node::Type::Set: {
+                    auto index = static_cast<uint32_t>(program_.sets.size());
+                    program_.sets.push_back(node.set);
+                    Add({Op::Byte, AssertKind::LineBegin, index, 0});
+                    break;
+                }
+                case Node::Type::Assert:
+                    Add({Op::Assert, node.assertion, 0, 0});
+                    break;
+                case Node::Type::Concat:
+                    for (const auto& child : node.children) Emit(child);
+                    break;
+                case Node::Type::Alternate: {
+                    std::vector<uint32_t> exits;
+                    for (size_t i = 0; i < node.children.size(); ++i) {
+                        if (i + 1 < node.children.size()) {
+                            uint32_t split = Add({Op::Split, AssertKind::LineBegin, 0, 0});
+                            program_.insts[split].x = Next();
+                            Emit(node.children[i]);
+                            exits.push_back(Add({Op::Jump, AssertKind::LineBegin, 0, 0}));
+                            program_.insts[split].y = Next();
+                        } else {
+                            Emit(node.children[i]);
+                        }
+                    }
+                    for (uint32_t exit : exits) program_.insts[exit].x = Next();
+                    break;
+                }
+                case Node::Type::Repeat:
+                    EmitRepeat(node);
+                    break;
+                }
+            }
+
+            void EmitRepeat(const Node& node)
+            {
+                const Node& child = node.children.front();
+                for (int i = 0; i < node.min; ++i) {
+                    Emit(child);
+                }
+
+                if (node.max == -1) {
+                    // loop: split body, exit; body; jump loop
+                    uint32_t loop = Add({Op::Split, AssertKind::LineBegin, 0, 0});
+                    uint32_t body = Next();
+                    Emit(child);
+                    Add({Op::Jump, AssertKind::LineBegin, loop, 0});
+                    SetSplit(loop, body, Next(), node.greedy);
+                    return;
+                }
+
+                // Optional copies: each one can skip to the end
+                std::vector<uint32_t> splits;
+                for (int i = node.min; i < node.max; ++i) {
+                    splits.push_back(Add({Op::Split, AssertKind::LineBegin, 0, 0}));
+                    program_.insts[splits.back()].x = Next();
+                    Emit(child);
+                }
+                for (uint32_t split : splits) {
+                    SetSplit(split, split + 1, Next(), node.greedy);
+                }
+            }
+
+            void SetSplit(uint32_t split, uint32_t body, uint32_t exit, bool greedy)
+            {
+                program_.insts[split].x = greedy ? body : exit;
+                program_.insts[split].y = greedy ? exit : body;
+            }
+
+            RegexProgram& program_;
+        };
+
+        // Concatenated literal runs that any match must contain
+        void CollectLiterals(const Node& node, std::vector<std::string>& out)
+        {
+            switch (node.type) {
+            case Node::Type::Set:
+                if (node.literal >= 0) out.emplace_back(1, static_cast<char>(node.literal));
+                break;
+            case Node::Type::Concat: {
+                std::string run;
+                auto flush = [&]() {
+                    if (!run.empty()) out.push_back(std::move(run));
+                    run.clear();
+                };
+                for (const auto& child : node.children) {
+                    if (child.type == Node::Type::Set && child.literal >= 0) {
+                        run += static_cast<char>(child.literal);
+                    } else if (child.type == Node::Type::Assert) {
+                        // Zero-width: literals on both sides stay adjacent
+                    } else {
+                        flush();
+                        CollectLiterals(child, out);
+                    }
+                }
+                flush();
+                break;
+            }
+            case Node::Type::Repeat:
+                if (node.min > 0) CollectLiterals(node.children.front(), out);
+                break;
+            default:
+                // Alternation: no single branch is required
+                break;
+            }
+        }
+
+        bool ContainsLiteral(std::string_view text, const std::string& literal, bool caseSensitive)
+        {
+            if (caseSensitive) {
+                return text.find(literal) != std::string_view::npos;
+            }
+            auto equal = [](char a, char b) {
+                return std::tolower(static_cast<unsigned char>(a)) == std::tolower(static_cast<unsigned char>(b));
+            };
+            return std::search(text.begin(), text.end(), literal.begin(), literal.end(), equal) != text.end();
+        }
+
+        /**
+         * @brief Ordered set of NFA states with their match start offsets
+         */
+        class ThreadList
+        {
+        public:
+            explicit ThreadList(size_t size) : sparse_(size), dense_(size), starts_(size) {}
+
+            bool Contains(uint32_t pc) const
+            {
+                uint32_t i = sparse_[pc];
+                return i < count_ && dense_[i] == pc;
+            }
+
+            void Add(uint32_t pc, size_t start)
+            {
+                sparse_[pc] = static_cast<uint32_t>(count_);
+                dense_[count_] = pc;
+                starts_[count_] = start;
+                ++count_;
+            }
+
+            void Clear() { count_ = 0; }
+            size_t Size() const { return count_; }
+            uint32_t Pc(size_t i) const { return dense_[i]; }
+            size_t Start(size_t i) const { return starts_[i]; }
+
+        private:
+            std::vector<uint32_t> sparse_;
+            std::vector<uint32_t> dense_;
+            std::vector<size_t> starts_;
+            size_t count_ = 0;
+        };
+    }
+
+    // ============== Regex ==============
+
+    Regex::Regex(std::shared_ptr<const RegexProgram> program)
+        : program_(std::move(program))
+    {}
+
+    std::optional<Regex> Regex::Compile(std::string_view pattern, bool caseSensitive, std::string* error)
+    {
+        auto program = std::make_shared<RegexProgram>();
+        program->caseSensitive = caseSensitive;
+
+        try {
+            Node root = Parser(pattern, caseSensitive).Parse();
+            Compiler(*program).Compile(root);
+            CollectLiterals(root, program->literals);
+        }
+        catch (const ParseError& e) {
+            if (error) *error = e.what();
+            return std::nullopt;
+        }
+
+        // Longest literals first: they reject non-matching text soonest
+        auto& literals = program->literals;
+        std::sort(literals.begin(), literals.end(),
+            [](const std::string& a, const std::string& b) { return a.size() > b.size(); });
+        literals.erase(std::unique(literals.begin(), literals.end()), literals.end());
+
+        // Bytes reachable from the start without consuming input
+        std::vector<uint32_t> stack{0};
+        std::vector<bool> seen(program->insts.size(), false);
+        program->anyFirst = false;
+        while (!stack.empty()) {
+            uint32_t pc = stack.back();
+            stack.pop_back();
+            if (seen[pc]) continue;
+            seen[pc] = true;
+
+            const RegexProgram::Inst& inst = program->insts[pc];
+            switch (inst.op) {
+            case RegexProgram::Op::Byte:
+                program->firstBytes |= program->sets[inst.x];
+                break;
+            case RegexProgram::Op::Split:
+                stack.push_back(inst.y);
+                stack.push_back(inst.x);
+                break;
+            case RegexProgram::Op::Jump:
+                stack.push_back(inst.x);
+                break;
+            case RegexProgram::Op::Assert:
+                stack.push_back(pc + 1);
+                break;
+            case RegexProgram::Op::Match:
+                program->anyFirst = true;
+                break;
+            }
+        }
+
+        return Regex(std::move(program));
+    }
+
+    std::optional<Regex::Match> Regex::Find(std::string_view text, size_t from) const
+    {
+        const RegexProgram& program = *program_;
+        const size_t n = text.size();
+        if (from > n) {
+            return std::nullopt;
+        }
+
+        auto byteAt = [&](size_t pos) { return static_cast<unsigned char>(text[pos]); };
+        auto check = [&](AssertKind kind, size_t pos) {
+            switch (kind) {
+            case AssertKind::LineBegin:
+                return pos == 0 || text[pos - 1] == '\n';
+            case AssertKind::LineEnd:
+                return pos == n || text[pos] == '\n';
+            case AssertKind::WordBoundary:
+            case AssertKind::NotWordBoundary: {
+                bool before = pos > 0 && IsWordByte(byteAt(pos - 1));
+                bool after = pos < n && IsWordByte(byteAt(pos));
+                return (before != after) == (kind == AssertKind::WordBoundary);
+            }
+            }
+            return false;
+        };
+
+        ThreadList current(program.insts.size());
+        ThreadList next(program.insts.size());
+        std::vector<uint32_t> stack;
+
+        // Follow epsilon transitions in priority order
+        auto addThread = [&](ThreadList& list, uint32_t pc, size_t start, size_t pos) {
+            stack.push_back(pc);
+            while (!stack.empty()) {
+                uint32_t at = stack.back();
+                stack.pop_back();
+                if (list.Contains(at)) continue;
+                list.Add(at, start);
+
+                const RegexProgram::Inst& inst = program.insts[at];
+                switch (inst.op) {
+                case RegexProgram::Op::Split:
+                    stack.push_back(inst.y);
+                    stack.push_back(inst.x);
+                    break;
+                case RegexProgram::Op::Jump:
+                    stack.push_back(inst.x);
+                    break;
+                case RegexProgram::Op::Assert:
+                    if (check(inst.assertion, pos)) stack.push_back(at + 1);
+                    break;
+                default:
+                    break;
+                }
+            }
+        };
+
+        std::optional<Match> best;
+        for (size_t pos = from; ; ++pos) {
+            if (!best) {
+                // Nothing in flight: skip to the next byte that can start a match
+                if (current.Size() == 0 && !program.anyFirst) {
+                    while (pos < n && !program.firstBytes[byteAt(pos)]) ++pos;
+                    if (pos >= n) break;
+                }
+                addThread(current, 0, pos, pos);
+            }
+            if (current.Size() == 0) break;
+
+            for (size_t i = 0; i < current.Size(); ++i) {
+                uint32_t pc = current.Pc(i);
+                const RegexProgram::Inst& inst = program.insts[pc];
+                if (inst.op == RegexProgram::Op::Match) {
+                    best = Match{current.Start(i), pos - current.Start(i)};
+                    break;  // Lower-priority threads cannot win
+                }
+                if (inst.op == RegexProgram::Op::Byte && pos < n && program.sets[inst.x][byteAt(pos)]) {
+                    addThread(next, pc + 1, current.Start(i), pos + 1);
+                }
+            }
+
+            std::swap(current, next);
+            next.Clear();
+            if (pos >= n) break;
+        }
+
+        return best;
+    }
+
+    bool Regex::Search(std::string_view text) const
+    {
+        return MayMatch(text) && Find(text).has_value();
+    }
+
+    std::vector<Regex::Match> Regex::FindAll(std::string_view text, size_t limit) const
+    {
+        std::vector<Match> matches;
+        if (!MayMatch(text)) {
+            return matches;
+        }
+
+        size_t pos = 0;
+        while (pos <= text.size()) {
+            auto match = Find(text, pos);
+            if (!match) break;
+            matches.push_back(*match);
+            if (limit != 0 && matches.size() >= limit) break;
+            // Step past empty matches so the scan always advances
+            pos = match->first + std::max<size_t>(match->second, 1);
+        }
+        return matches;
+    }
+
+    const std::vector<std::string>& Regex::RequiredLiterals() const
+    {
+        return program_->literals;
+    }
+
+    bool Regex::MayMatch(std::string_view text) const
+    {
+        for (const auto& literal : program_->literals) {
+            if (!ContainsLiteral(text, literal, program_->caseSensitive)) return false;
+        }
+        return true;
+    }
+
+} // namespace opacity::search
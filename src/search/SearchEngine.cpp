@@ -1,15 +1,61 @@
 #include "opacity/search/SearchEngine.h"
+#include "opacity/archive/ArchiveFileSystem.h"
 #include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/search/TextScanner.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/MappedFile.h"
+#include "opacity/core/MpscQueue.h"
+#include "opacity/filesystem/CloudIntegration.h"
+#include "opacity/filesystem/StorageTopology.h"
 
 #include <algorithm>
-#include <cctype>
-#include <fstream>
-#include <regex>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <optional>
+#include <string_view>
 
 namespace opacity::search
 {
 
+namespace
+{
+    constexpr size_t kBinaryProbeBytes = 4096;
+    constexpr size_t kMaxContextChars = 200;
+    constexpr uint64_t kMaxArchiveEntryBytes = 64 * 1024 * 1024;  // Inflated to search contents
+    constexpr auto kDrainInterval = std::chrono::milliseconds(5);
+    constexpr auto kProgressInterval = std::chrono::milliseconds(100);
+}
+
+/**
+ * @brief Shared state of one search run
+ */
+struct SearchEngine::SearchState
+{
+    const std::string& query;
+    const Regex* regex;
+    const SearchOptions& options;
+
+    // Directories waiting to be enumerated; pending also counts those in flight
+    std::mutex work_mutex;
+    std::condition_variable work_cv;
+    std::deque<core::Path> directories;
+    size_t pending = 0;
+
+    core::MpscQueue<SearchResult> results;
+    std::condition_variable_any results_cv;
+
+    std::atomic<size_t> files_searched{0};
+    std::atomic<size_t> matches_found{0};
+    std::atomic<bool> limit_reached{false};
+
+    SearchState(const std::string& q, const Regex* r, const SearchOptions& o)
+        : query(q), regex(r), options(o)
+    {
+    }
+};
+
 SearchEngine::SearchEngine()
 {
     core::Logger::Get()->debug("SearchEngine initialized");
@@ -36,14 +82,15 @@ void SearchEngine::StartSearch(
     cancel_requested_ = false;
     is_searching_ = true;
 
-    search_thread_ = std::thread(
-        &SearchEngine::SearchThread,
-        this,
-        root_path,
-        query,
-        options,
-        std::move(result_callback),
-        std::move(progress_callback));
+    core::TaskOptions task_options;
+    task_options.io_device = core::TaskScheduler::IoDevice(root_path);
+    search_task_ = core::TaskScheduler::Get().Submit(
+        [this, root_path, query, options, result_callback = std::move(result_callback),
+         progress_callback = std::move(progress_callback)](const core::CancellationToken&)
+        {
+            SearchTask(root_path, query, options, result_callback, progress_callback);
+        },
+        std::move(task_options));
 }
 
 void SearchEngine::CancelSearch()
@@ -58,10 +105,7 @@ bool SearchEngine::IsSearching() const
 
 void SearchEngine::WaitForCompletion()
 {
-    if (search_thread_.joinable())
-    {
-        search_thread_.join();
-    }
+    search_task_.Wait();
 }
 
 std::vector<SearchResult> SearchEngine::SearchSync(
@@ -70,18 +114,26 @@ std::vector<SearchResult> SearchEngine::SearchSync(
     const SearchOptions& options)
 {
     std::vector<SearchResult> results;
-    std::mutex results_mutex;
 
-    auto callback = [&results, &results_mutex](const SearchResult& result) {
-        std::lock_guard<std::mutex> lock(results_mutex);
+    auto callback = [&results](const SearchResult& result) {
         results.push_back(result);
     };
 
-    size_t files_searched = 0;
-    size_t matches_found = 0;
     cancel_requested_ = false;
 
-    SearchDirectory(root_path, query, options, callback, files_searched, matches_found);
+    std::optional<Regex> regex;
+    if (options.use_regex)
+    {
+        std::string error;
+        regex = Regex::Compile(query, options.case_sensitive, &error);
+        if (!regex)
+        {
+            core::Logger::Get()->warn("Invalid search regex '{}': {}", query, error);
+            return results;
+        }
+    }
+
+    RunSearch(root_path, query, regex ? &*regex : nullptr, options, callback, nullptr);
 
     return results;
 }
@@ -94,92 +146,299 @@ bool SearchEngine::MatchPattern(
     if (pattern.empty())
         return true;
 
-    std::string fname = filename;
-    std::string pat = pattern;
+    return TextScanner::MatchWildcard(filename, pattern, case_sensitive);
+}
+
+bool SearchEngine::MatchContents(
+    const filesystem::FsItem& item,
+    const std::string& query,
+    const Regex* regex,
+    const SearchOptions& options,
+    SearchResult& result)
+{
+    if (query.empty())
+        return false;
+
+    core::MappedFile file;
+    if (!file.Open(item.full_path.Get()))
+        return false;
+
+    std::string_view content(reinterpret_cast<const char*>(file.Data()), file.Size());
+    return MatchText(content, query, regex, options, result);
+}
+
+bool SearchEngine::MatchText(
+    std::string_view content,
+    const std::string& query,
+    const Regex* regex,
+    const SearchOptions& options,
+    SearchResult& result)
+{
+    // Skip binaries the way grep does: a NUL near the start
+    std::string_view head = content.substr(0, kBinaryProbeBytes);
+    if (head.find('\0') != std::string_view::npos)
+        return false;
+
+    size_t offset = std::string_view::npos;
+    size_t length = 0;
+    if (regex)
+    {
+        if (regex->MayMatch(content))
+        {
+            if (auto match = regex->Find(content))
+            {
+                offset = match->first;
+                length = match->second;
+            }
+        }
+    }
+    else
+    {
+        offset = TextScanner::Find(content, query, options.case_sensitive);
+        length = query.size();
+    }
+
+    if (offset == std::string_view::npos)
+        return false;
 
-    if (!case_sensitive)
+    std::string_view line = ContextLine(content, offset, length);
+    result.match_line = static_cast<size_t>(
+        std::count(content.data(), content.data() + (line.data() - content.data()), '\n')) + 1;
+    result.match_offset = offset;
+    result.match_length = length;
+    if (options.capture_context)
+        result.match_context.assign(line.data(), line.size());
+
+    return true;
+}
+
+std::string_view SearchEngine::ContextLine(std::string_view content, size_t offset, size_t length)
+{
+    size_t line_start = content.rfind('\n', offset);
+    line_start = (line_start == std::string_view::npos) ? 0 : line_start + 1;
+    size_t line_end = content.find('\n', offset + length);
+    if (line_end == std::string_view::npos)
+        line_end = content.size();
+
+    std::string_view line = content.substr(line_start, line_end - line_start);
+    if (!line.empty() && line.back() == '\r')
+        line.remove_suffix(1);
+    if (line.size() > kMaxContextChars)
     {
-        std::transform(fname.begin(), fname.end(), fname.begin(),
-            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-        std::transform(pat.begin(), pat.end(), pat.begin(),
-            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        // Keep the match in view on very long lines
+        size_t in_line = offset - line_start;
+        size_t from = in_line > kMaxContextChars / 2 ? in_line - kMaxContextChars / 2 : 0;
+        line = line.substr(from, kMaxContextChars);
     }
+    return line;
+}
+
+bool SearchEngine::LoadContext(SearchResult& result)
+{
+    if (result.match_length == 0 || !result.match_context.empty())
+        return !result.match_context.empty();
+
+    core::MappedFile file;
+    if (!file.Open(result.item.full_path.Get()))
+        return false;
+
+    // Edited since the search: the offset no longer points at the match
+    if (file.Size() != result.item.size || result.match_offset + result.match_length > file.Size())
+        return false;
+
+    std::string_view content(reinterpret_cast<const char*>(file.Data()), file.Size());
+    std::string_view line = ContextLine(content, static_cast<size_t>(result.match_offset), result.match_length);
+    result.match_context.assign(line.data(), line.size());
+    return true;
+}
 
-    // Simple wildcard matching
-    size_t f = 0, p = 0;
-    size_t star_idx = std::string::npos;
-    size_t match_idx = 0;
+void SearchEngine::SearchTask(
+    const core::Path& root_path,
+    const std::string& query,
+    const SearchOptions& options,
+    const SearchResultCallback& result_callback,
+    const SearchProgressCallback& progress_callback)
+{
+    OPACITY_PROFILE_ZONE("SearchEngine::SearchTask");
+    OPACITY_LOG_DEBUG(Search, "Search started: query='{}' in '{}'", query, root_path.String());
 
-    while (f < fname.size())
+    // Compile once for the whole tree
+    std::optional<Regex> regex;
+    if (options.use_regex)
     {
-        if (p < pat.size() && (pat[p] == '?' || pat[p] == fname[f]))
+        std::string error;
+        regex = Regex::Compile(query, options.case_sensitive, &error);
+        if (!regex)
         {
-            ++f;
-            ++p;
+            core::Logger::Get()->warn("Invalid search regex '{}': {}", query, error);
+            is_searching_ = false;
+            return;
         }
-        else if (p < pat.size() && pat[p] == '*')
+    }
+
+    RunSearch(root_path, query, regex ? &*regex : nullptr, options, result_callback, progress_callback);
+
+    is_searching_ = false;
+}
+
+void SearchEngine::RunSearch(
+    const core::Path& root_path,
+    const std::string& query,
+    const Regex* regex,
+    const SearchOptions& options,
+    const SearchResultCallback& result_callback,
+    const SearchProgressCallback& progress_callback)
+{
+    SearchState state(query, regex, options);
+    state.directories.push_back(root_path);
+    placeholders_skipped_ = 0;
+    state.pending = 1;
+
+    size_t worker_count = options.worker_threads;
+    if (worker_count == 0)
+    {
+        worker_count = std::max(1u, std::thread::hardware_concurrency());
+    }
+    if (!options.recursive)
+    {
+        worker_count = 1;   // Only the root to enumerate
+    }
+
+    // Helpers share the volume's limit with the search task, which keeps
+    // working itself, so a busy pool or a spinning disk only means less help
+    filesystem::StorageTopology::GetVolumeProfile(root_path);
+    core::TaskOptions helper_options;
+    helper_options.io_device = core::TaskScheduler::IoDevice(root_path);
+    core::TaskGroup helpers;
+    helpers.Spawn(worker_count - 1, [this, &state] { SearchWorker(state); }, std::move(helper_options));
+
+    // This thread owns the callbacks: drain results between its own directories
+    auto last_progress = std::chrono::steady_clock::now();
+    std::mutex wait_mutex;
+    SearchResult result;
+    for (;;)
+    {
+        bool finished = false;
         {
-            star_idx = p;
-            match_idx = f;
-            ++p;
+            std::lock_guard<std::mutex> lock(state.work_mutex);
+            finished = state.pending == 0 || cancel_requested_ || state.limit_reached;
         }
-        else if (star_idx != std::string::npos)
+
+        while (state.results.Pop(result))
         {
-            p = star_idx + 1;
-            ++match_idx;
-            f = match_idx;
+            if (cancel_requested_)
+                continue;   // Nothing is delivered after a cancel
+            if (result_callback)
+                result_callback(result);
         }
-        else
+
+        if (finished)
+            break;
+
+        auto now = std::chrono::steady_clock::now();
+        if (progress_callback && now - last_progress >= kProgressInterval)
         {
-            return false;
+            progress_callback(state.files_searched,
+                              std::min(state.matches_found.load(), options.max_results));
+            last_progress = now;
         }
+
+        if (!SearchNext(state))
+        {
+            std::unique_lock<std::mutex> lock(wait_mutex);
+            state.results_cv.wait_for(lock, kDrainInterval);
+        }
+    }
+
+    // Wake idle helpers so cancellation and the result limit end them too
+    {
+        std::lock_guard<std::mutex> lock(state.work_mutex);
     }
+    state.work_cv.notify_all();
+    helpers.Close();
 
-    while (p < pat.size() && pat[p] == '*')
+    while (state.results.Pop(result))
     {
-        ++p;
+        if (!cancel_requested_ && result_callback)
+            result_callback(result);
+    }
+
+    size_t files_searched = state.files_searched;
+    size_t matches_found = std::min(state.matches_found.load(), options.max_results);
+    if (progress_callback)
+    {
+        progress_callback(files_searched, matches_found);
     }
 
-    return p == pat.size();
+    OPACITY_LOG_DEBUG(Search, "Search completed: {} files searched, {} matches found ({} workers)",
+                               files_searched, matches_found, worker_count);
+    if (placeholders_skipped_ > 0)
+    {
+        core::Logger::Get()->info("Search skipped {} online-only files", placeholders_skipped_.load());
+    }
 }
 
-void SearchEngine::SearchThread(
-    core::Path root_path,
-    std::string query,
-    SearchOptions options,
-    SearchResultCallback result_callback,
-    SearchProgressCallback progress_callback)
+void SearchEngine::SearchWorker(SearchState& state)
 {
-    size_t files_searched = 0;
-    size_t matches_found = 0;
+    for (;;)
+    {
+        core::Path directory;
+        {
+            std::unique_lock<std::mutex> lock(state.work_mutex);
+            state.work_cv.wait(lock, [this, &state] {
+                return !state.directories.empty() || state.pending == 0 ||
+                       cancel_requested_ || state.limit_reached;
+            });
+            if (state.directories.empty() || cancel_requested_ || state.limit_reached)
+                break;
+
+            // Newest first keeps the queue short; other workers take the rest
+            directory = std::move(state.directories.back());
+            state.directories.pop_back();
+        }
 
-    core::Logger::Get()->debug("Search started: query='{}' in '{}'", query, root_path.String());
+        ProcessDirectory(state, directory);
+    }
 
-    SearchDirectory(root_path, query, options, result_callback, files_searched, matches_found);
+    // Wake idle peers so cancellation and the result limit end every worker
+    state.work_cv.notify_all();
+}
 
-    if (progress_callback)
+bool SearchEngine::SearchNext(SearchState& state)
+{
+    core::Path directory;
     {
-        progress_callback(files_searched, matches_found);
+        std::lock_guard<std::mutex> lock(state.work_mutex);
+        if (state.directories.empty() || cancel_requested_ || state.limit_reached)
+            return false;
+
+        directory = std::move(state.directories.back());
+        state.directories.pop_back();
     }
 
-    is_searching_ = false;
-    core::Logger::Get()->debug("Search completed: {} files searched, {} matches found", 
-                               files_searched, matches_found);
+    ProcessDirectory(state, directory);
+    return true;
 }
 
-void SearchEngine::SearchDirectory(
-    const core::Path& directory,
-    const std::string& query,
-    const SearchOptions& options,
-    SearchResultCallback result_callback,
-    size_t& files_searched,
-    size_t& matches_found)
+void SearchEngine::ProcessDirectory(SearchState& state, const core::Path& directory)
 {
-    if (cancel_requested_)
-        return;
+    SearchDirectory(state, directory);
 
-    if (matches_found >= options.max_results)
-        return;
+    bool drained = false;
+    {
+        std::lock_guard<std::mutex> lock(state.work_mutex);
+        drained = --state.pending == 0;
+    }
+    if (drained)
+    {
+        state.work_cv.notify_all();
+        state.results_cv.notify_all();
+    }
+}
+
+void SearchEngine::SearchDirectory(SearchState& state, const core::Path& directory)
+{
+    const SearchOptions& options = state.options;
 
     filesystem::FileSystemManager fs_manager;
     filesystem::EnumerationOptions enum_options;
@@ -190,43 +449,138 @@ void SearchEngine::SearchDirectory(
     if (!contents.success)
         return;
 
+    std::vector<core::Path> subdirectories;
     for (const auto& item : contents.items)
     {
-        if (cancel_requested_)
-            return;
-
-        if (matches_found >= options.max_results)
+        if (cancel_requested_ || state.limit_reached)
             return;
 
         // Check if filename matches the pattern
-        bool matches = MatchPattern(item.name, query, options.case_sensitive);
+        bool matches = state.regex ? state.regex->Search(item.name)
+                                   : MatchPattern(item.name, state.query, options.case_sensitive);
 
         // Check extension filter
-        if (matches && !options.extensions.empty() && !item.is_directory)
+        bool extension_ok = item.is_directory ||
+            MatchesExtensionFilter(item.extension, options.extensions);
+        matches = matches && extension_ok;
+
+        SearchResult result;
+        if (!matches && options.search_contents && !item.is_directory && extension_ok)
         {
-            matches = MatchesExtensionFilter(item.extension, options.extensions);
+            // The enumeration already has the attributes, so this costs nothing
+            if (filesystem::CloudIntegration::ShouldSkipRead(item.attributes, options.read_placeholders))
+                ++placeholders_skipped_;
+            else
+                matches = MatchContents(item, state.query, state.regex, options, result);
         }
 
         if (matches)
         {
-            SearchResult result;
             result.item = item;
-            
-            if (result_callback)
+            if (!PublishResult(state, std::move(result)))
+                return;
+        }
+
+        ++state.files_searched;
+
+        if (options.search_archives && !item.is_directory &&
+            archive::ArchiveManager::GetFormat(item.full_path) == archive::ArchiveFormat::Zip &&
+            !filesystem::CloudIntegration::ShouldSkipRead(item.attributes, options.read_placeholders))
+        {
+            SearchArchive(state, item);
+        }
+
+        if (item.is_directory && options.recursive)
+        {
+            subdirectories.push_back(item.full_path);
+        }
+    }
+
+    if (!subdirectories.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(state.work_mutex);
+            for (auto& subdirectory : subdirectories)
             {
-                result_callback(result);
+                state.directories.push_back(std::move(subdirectory));
             }
-            ++matches_found;
+            state.pending += subdirectories.size();
         }
+        state.work_cv.notify_all();
+    }
+}
 
-        ++files_searched;
+bool SearchEngine::PublishResult(SearchState& state, SearchResult result)
+{
+    // Claim a slot so concurrent workers never exceed max_results
+    size_t slot = state.matches_found++;
+    if (slot >= state.options.max_results)
+    {
+        state.limit_reached = true;
+        state.work_cv.notify_all();
+        return false;
+    }
 
-        // Recursively search directories
-        if (item.is_directory && options.recursive)
+    state.results.Push(std::move(result));
+    if (slot + 1 == state.options.max_results)
+    {
+        state.limit_reached = true;
+        state.work_cv.notify_all();
+    }
+    return true;
+}
+
+void SearchEngine::SearchArchive(SearchState& state, const filesystem::FsItem& archive)
+{
+    const SearchOptions& options = state.options;
+
+    // Members are inflated one at a time, straight from the archive
+    for (const auto& entry : archive::ArchiveFileSystem::ListFiles(archive.full_path))
+    {
+        if (cancel_requested_ || state.limit_reached)
+            return;
+
+        filesystem::FsItem item;
+        item.name = entry.GetFilename();
+        item.path = archive::ArchiveFileSystem::JoinPath(archive.full_path, entry.full_path);
+        item.full_path = core::Path(item.path);
+        item.size = entry.uncompressed_size;
+        item.modified_time = entry.modified_time;
+        item.modified = entry.modified_time;
+        item.extension = filesystem::FsItemUtils::GetExtension(item.name);
+        item.type = filesystem::DetermineFileType(item.name);
+
+        if (!MatchesExtensionFilter(item.extension, options.extensions))
+            continue;
+
+        bool matches = state.regex ? state.regex->Search(item.name)
+                                   : MatchPattern(item.name, state.query, options.case_sensitive);
+
+        SearchResult result;
+        std::vector<char> contents;
+        if (!matches && options.search_contents && !entry.is_encrypted &&
+            archive::ArchiveFileSystem::ReadEntry(item.path, contents, kMaxArchiveEntryBytes))
         {
-            SearchDirectory(item.full_path, query, options, result_callback, 
-                           files_searched, matches_found);
+            std::string_view content(contents.data(), contents.size());
+            matches = MatchText(content, state.query, state.regex, options, result);
+
+            // The entry cannot be mapped again later, so its line is kept now
+            if (matches && result.match_context.empty())
+            {
+                std::string_view line = ContextLine(content, static_cast<size_t>(result.match_offset),
+                                                    result.match_length);
+                result.match_context.assign(line.data(), line.size());
+            }
         }
+
+        if (matches)
+        {
+            result.item = std::move(item);
+            if (!PublishResult(state, std::move(result)))
+                return;
+        }
+
+        ++state.files_searched;
     }
 }
 
@@ -237,23 +591,17 @@ bool SearchEngine::MatchesExtensionFilter(
     if (extensions.empty())
         return true;
 
-    std::string lower_ext = extension;
-    std::transform(lower_ext.begin(), lower_ext.end(), lower_ext.begin(),
-        [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
-
     for (const auto& filter_ext : extensions)
     {
-        std::string lower_filter = filter_ext;
-        std::transform(lower_filter.begin(), lower_filter.end(), lower_filter.begin(),
-            [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+        std::string_view filter = filter_ext;
 
         // Remove leading dot if present
-        if (!lower_filter.empty() && lower_filter[0] == '.')
+        if (!filter.empty() && filter[0] == '.')
         {
-            lower_filter = lower_filter.substr(1);
+            filter.remove_prefix(1);
         }
 
-        if (lower_ext == lower_filter)
+        if (TextScanner::Equals(extension, filter, false))
             return true;
     }
 
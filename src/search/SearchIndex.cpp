@@ -1,12 +1,26 @@
 #include "opacity/search/SearchIndex.h"
+#include "opacity/search/EntryStore.h"
+#include "opacity/search/IndexCrawler.h"
+#include "opacity/search/MftReader.h"
+#include "opacity/search/NameIndex.h"
+#include "opacity/search/Regex.h"
+#include "opacity/search/TextScanner.h"
+#include "opacity/search/TrigramIndex.h"
+#include "opacity/search/UsnJournal.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/MappedFile.h"
+#include "opacity/core/TaskScheduler.h"
+#include "opacity/filesystem/CloudIntegration.h"
 
 #include <algorithm>
 #include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <cwctype>
 #include <fstream>
 #include <mutex>
 #include <queue>
-#include <regex>
 #include <shared_mutex>
 #include <sstream>
 #include <thread>
@@ -29,6 +43,88 @@ namespace opacity::search
         return hash;
     }
 
+    // ============== Binary index format ==============
+    //
+    // index.bin layout (all offsets absolute, segments 8-byte aligned):
+    //   IndexFileHeader
+    //   IndexFileRecord[entryCount]     fixed-size entry records
+    //   string table                    path + filename + extension per record
+    //   content segment                 raw indexed content
+    //   name postings segment           TrigramIndex::Serialize output
+    //   content postings segment        TrigramIndex::Serialize output
+    //   journal segment (optional)      JournalSegmentEntry + volume name per cursor
+    //
+    // Records are written in DocId order so the postings can be attached
+    // directly from the mapping without rebuilding them.
+
+    static constexpr char kIndexMagic[4] = {'O', 'P', 'I', 'X'};
+    static constexpr uint32_t kIndexVersion = 1;
+    static constexpr const char* kIndexFileName = "index.bin";
+    static constexpr const char* kLegacyIndexFileName = "index.json";
+
+    struct IndexFileHeader
+    {
+        char magic[4];
+        uint32_t version;
+        uint64_t entryCount;
+        uint64_t recordsOffset;
+        uint64_t stringsOffset;
+        uint64_t stringsSize;
+        uint64_t contentOffset;
+        uint64_t contentSize;
+        uint64_t namePostingsOffset;
+        uint64_t namePostingsSize;
+        uint64_t contentPostingsOffset;
+        uint64_t contentPostingsSize;
+        uint64_t totalFiles;
+        uint64_t totalDirectories;
+        uint64_t totalSizeBytes;
+        int64_t lastUpdate;             // Microseconds since epoch
+        uint64_t journalOffset;         // 0 = no journal cursors
+    };
+
+    struct IndexFileRecord
+    {
+        uint64_t pathOffset;            // Into string table
+        uint32_t pathLength;
+        uint32_t filenameLength;        // Follows the path
+        uint32_t extensionLength;       // Follows the filename
+        uint32_t contentHash;
+        uint64_t size;
+        int64_t modifiedTime;           // Microseconds since epoch
+        int64_t indexedTime;            // Microseconds since epoch
+        uint64_t contentOffset;         // Relative to content segment
+        uint64_t contentLength;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    // Journal segment: uint32 count, then per cursor this header followed
+    // by volumeLength bytes of volume name, each padded to 8 bytes
+    struct JournalSegmentEntry
+    {
+        uint64_t journalId;
+        int64_t nextUsn;
+        uint32_t volumeLength;
+        uint32_t reserved;
+    };
+
+    static_assert(sizeof(IndexFileHeader) == 128, "IndexFileHeader layout changed");
+    static_assert(sizeof(IndexFileRecord) == 72, "IndexFileRecord layout changed");
+    static_assert(sizeof(JournalSegmentEntry) == 24, "JournalSegmentEntry layout changed");
+
+    static constexpr uint32_t kRecordDirectory = 1u << 0;
+
+    static uint64_t AlignTo8(uint64_t value)
+    {
+        return (value + 7) & ~uint64_t{7};
+    }
+
+    // Scoring: a filename match contributes up to 1.0 and content up to
+    // kMaxContentScore; a filename prefix match or better is high confidence
+    static constexpr float kMaxContentScore = 0.3f;
+    static constexpr float kHighConfidenceScore = 0.8f;
+
     // Check if file is a text file based on extension
     static bool IsTextFile(const std::filesystem::path& path)
     {
@@ -45,14 +141,63 @@ namespace opacity::search
         return std::find(textExtensions.begin(), textExtensions.end(), ext) != textExtensions.end();
     }
 
+    // One path component against another; Windows names ignore case
+    static bool SameComponent(const std::filesystem::path& a, const std::filesystem::path& b)
+    {
+#ifdef _WIN32
+        const std::wstring& x = a.native();
+        const std::wstring& y = b.native();
+        return x.size() == y.size() &&
+               std::equal(x.begin(), x.end(), y.begin(),
+                          [](wchar_t l, wchar_t r) { return std::towlower(l) == std::towlower(r); });
+#else
+        return a == b;
+#endif
+    }
+
+    // Check if path lies at or below root (component-wise), so that
+    // C:\Users\Me\Docs is within c:\users\me
+    static bool IsWithin(const std::filesystem::path& path, std::filesystem::path root)
+    {
+        if (!root.has_filename() && root.has_relative_path()) {
+            root = root.parent_path();  // Trailing separator
+        }
+        auto [rootIt, pathIt] = std::mismatch(root.begin(), root.end(), path.begin(), path.end(), SameComponent);
+        (void)pathIt;
+        return rootIt == root.end();
+    }
+
     class SearchIndex::Impl
     {
     public:
         IndexConfig config_;
         IndexStats stats_;
+
+        // Documents whose text comes through an extractor; dotted, lowercase
+        std::vector<std::string> extractorExtensions_;
+        ContentExtractor extractor_;
         
-        std::unordered_map<std::string, IndexEntry> entries_;
+        // Entries live in a compact store addressed by DocId; IndexEntry is
+        // only materialized for results. Guarded by entriesMutex_.
+        EntryStore store_;
         mutable std::shared_mutex entriesMutex_;
+
+        // Trigram postings over filenames and content, keyed by DocId.
+        // DocIds are never reused until the store is compacted.
+        TrigramIndex nameTrigrams_;
+        TrigramIndex contentTrigrams_;
+        size_t removedDocs_ = 0;
+
+        // Sorted filename dictionary behind QuickSearch, keyed by DocId
+        NameIndex nameIndex_;
+
+        // Memory-mapped index.bin; loaded entries reference their content
+        // in the mapping instead of holding a copy.
+        MappedFile indexFile_;
+
+        // Change journal position per volume, saved with the index. Cleared
+        // with the entries so a reset index always falls back to a rescan.
+        std::vector<UsnCursor> journalCursors_;
         
         std::vector<IndexUpdateCallback> updateCallbacks_;
         
@@ -62,6 +207,10 @@ namespace opacity::search
         std::atomic<bool> cancelIndexing_{false};
         std::atomic<bool> cancelSearch_{false};
         std::atomic<double> indexingProgress_{0.0};
+
+        // SearchAsync runs on the task scheduler; Shutdown waits for these
+        std::mutex searchTasksMutex_;
+        std::vector<core::TaskHandle> searchTasks_;
         
         std::thread autoUpdateThread_;
         std::atomic<bool> autoUpdateRunning_{false};
@@ -73,6 +222,616 @@ namespace opacity::search
             }
         }
 
+        // ---- Entry storage (callers hold entriesMutex_ exclusively) ----
+
+        void InsertEntryLocked(IndexEntry entry)
+        {
+            if (auto existing = store_.Find(entry.path)) {
+                EraseDocLocked(*existing);
+            }
+
+            DocId doc = store_.Insert(std::move(entry));
+            nameTrigrams_.Add(doc, store_.Filename(doc));
+            nameIndex_.Add(doc, store_.Filename(doc));
+            std::string_view content = store_.Content(doc);
+            if (!content.empty()) {
+                contentTrigrams_.Add(doc, content);
+            }
+        }
+
+        bool EraseEntryLocked(const std::filesystem::path& path)
+        {
+            auto doc = store_.Find(path);
+            if (!doc) {
+                return false;
+            }
+            EraseDocLocked(*doc);
+            return true;
+        }
+
+        void EraseDocLocked(DocId doc)
+        {
+            TombstoneDocLocked(doc);
+            MaybeCompactLocked();
+        }
+
+        // Remove a path and, if it is a directory, everything below it
+        size_t EraseTreeLocked(const std::filesystem::path& path)
+        {
+            // DocIds must stay stable until the whole subtree is gone
+            std::vector<DocId> docs = store_.FindUnder(path);
+            if (auto doc = store_.Find(path)) {
+                docs.push_back(*doc);
+            }
+            for (DocId doc : docs) {
+                TombstoneDocLocked(doc);
+            }
+            MaybeCompactLocked();
+            return docs.size();
+        }
+
+        void TombstoneDocLocked(DocId doc)
+        {
+            nameTrigrams_.Remove(doc);
+            contentTrigrams_.Remove(doc);
+            nameIndex_.Remove(doc);
+            store_.Remove(doc);
+            removedDocs_++;
+        }
+
+        void MaybeCompactLocked()
+        {
+            // Reclaim tombstones once they dominate the posting lists
+            if (removedDocs_ > 1024 && removedDocs_ > store_.Size()) {
+                CompactLocked();
+            }
+        }
+
+        void ClearEntriesLocked()
+        {
+            store_.Clear();
+            nameTrigrams_.Clear();
+            contentTrigrams_.Clear();
+            nameIndex_.Clear();
+            removedDocs_ = 0;
+            journalCursors_.clear();
+
+            // Nothing references the mapping any more
+            indexFile_.Close();
+        }
+
+        // Renumber documents densely and rebuild the postings to match
+        void CompactLocked()
+        {
+            store_.Compact();
+            RebuildTrigramsLocked();
+            RebuildNameIndexLocked();
+        }
+
+        void RebuildTrigramsLocked()
+        {
+            nameTrigrams_.Clear();
+            contentTrigrams_.Clear();
+            removedDocs_ = 0;
+
+            store_.ForEach([this](DocId doc) {
+                nameTrigrams_.Add(doc, store_.Filename(doc));
+                std::string_view content = store_.Content(doc);
+                if (!content.empty()) {
+                    contentTrigrams_.Add(doc, content);
+                }
+            });
+        }
+
+        void RebuildNameIndexLocked()
+        {
+            nameIndex_.Clear();
+            store_.ForEach([this](DocId doc) {
+                nameIndex_.Add(doc, store_.Filename(doc));
+            });
+            nameIndex_.Merge();
+        }
+
+        // Fold names left pending by a bulk load into the sorted dictionary
+        void FinishBulkInsert()
+        {
+            std::unique_lock<std::shared_mutex> lock(entriesMutex_);
+            nameIndex_.Merge();
+        }
+
+        size_t MemoryUsageLocked() const
+        {
+            return store_.MemoryUsage() + TrigramMemoryLocked() + nameIndex_.MemoryUsage();
+        }
+
+        size_t TrigramMemoryLocked() const
+        {
+            return nameTrigrams_.MemoryUsage() + contentTrigrams_.MemoryUsage();
+        }
+
+        /**
+         * @brief Documents whose trigrams can match a query
+         *
+         * Filename candidates are kept apart from content-only ones so the
+         * search can visit the higher-scoring group first.
+         */
+        struct CandidateSet
+        {
+            std::vector<DocId> names;
+            std::vector<DocId> contentOnly;
+        };
+
+        /**
+         * @brief Narrow a query to the documents whose trigrams can match it
+         *
+         * Regex queries are narrowed by the literals every match must contain.
+         * @return std::nullopt when the query cannot be filtered (< 3 chars,
+         *         or a regex without a usable literal)
+         */
+        std::optional<CandidateSet> FindCandidatesLocked(const SearchQuery& query, const Regex* regex) const
+        {
+            std::vector<std::string> literals;
+            if (regex) {
+                for (const auto& literal : regex->RequiredLiterals()) {
+                    if (literal.size() >= 3) literals.push_back(literal);
+                }
+            } else if (query.text.size() >= 3) {
+                literals.push_back(query.text);
+            }
+            if (literals.empty()) {
+                return std::nullopt;
+            }
+
+            // Documents containing every literal
+            auto lookup = [&literals](const TrigramIndex& index) -> std::optional<std::vector<DocId>> {
+                std::optional<std::vector<DocId>> result;
+                for (const auto& literal : literals) {
+                    auto docs = index.Candidates(literal);
+                    if (!docs) return std::nullopt;
+                    result = result ? TrigramIndex::Intersect(*result, *docs) : std::move(*docs);
+                }
+                return result;
+            };
+
+            CandidateSet candidates;
+            if (query.searchFilenames) {
+                auto names = lookup(nameTrigrams_);
+                if (!names) return std::nullopt;
+                candidates.names = std::move(*names);
+            }
+            if (query.searchContent) {
+                auto content = lookup(contentTrigrams_);
+                if (!content) return std::nullopt;
+                std::set_difference(content->begin(), content->end(),
+                                    candidates.names.begin(), candidates.names.end(),
+                                    std::back_inserter(candidates.contentOnly));
+            }
+            return candidates;
+        }
+
+        // ---- Persistence ----
+
+        bool WriteBinaryLocked(const std::filesystem::path& file)
+        {
+            // Records follow DocId order so postings only need renumbering
+            std::vector<DocId> remap(store_.DocCount(), kNoDoc);
+            std::vector<DocId> order;
+            order.reserve(store_.Size());
+            store_.ForEach([&](DocId doc) {
+                remap[doc] = static_cast<DocId>(order.size());
+                order.push_back(doc);
+            });
+
+            std::vector<IndexFileRecord> records;
+            records.reserve(order.size());
+            std::string strings;
+            uint64_t contentSize = 0;
+            for (DocId doc : order) {
+                const CompactEntry& entry = store_.Record(doc);
+                IndexFileRecord record{};
+                std::string path = store_.Path(doc).string();
+                std::string_view filename = store_.Filename(doc);
+                const std::string& extension = store_.Extension(doc);
+                record.pathOffset = strings.size();
+                record.pathLength = static_cast<uint32_t>(path.size());
+                record.filenameLength = static_cast<uint32_t>(filename.size());
+                record.extensionLength = static_cast<uint32_t>(extension.size());
+                strings += path;
+                strings += filename;
+                strings += extension;
+
+                record.contentHash = entry.contentHash;
+                record.size = entry.size;
+                record.modifiedTime = entry.modifiedTime;
+                record.indexedTime = entry.indexedTime;
+                record.contentOffset = contentSize;
+                record.contentLength = store_.Content(doc).size();
+                record.flags = entry.IsDirectory() ? kRecordDirectory : 0;
+                contentSize += record.contentLength;
+                records.push_back(record);
+            }
+
+            std::string namePostings;
+            std::string contentPostings;
+            nameTrigrams_.Serialize(remap, namePostings);
+            contentTrigrams_.Serialize(remap, contentPostings);
+            std::string journal = SerializeJournalLocked();
+
+            IndexFileHeader header{};
+            std::memcpy(header.magic, kIndexMagic, sizeof(kIndexMagic));
+            header.version = kIndexVersion;
+            header.entryCount = records.size();
+            header.recordsOffset = AlignTo8(sizeof(IndexFileHeader));
+            header.stringsOffset = AlignTo8(header.recordsOffset + records.size() * sizeof(IndexFileRecord));
+            header.stringsSize = strings.size();
+            header.contentOffset = AlignTo8(header.stringsOffset + header.stringsSize);
+            header.contentSize = contentSize;
+            header.namePostingsOffset = AlignTo8(header.contentOffset + header.contentSize);
+            header.namePostingsSize = namePostings.size();
+            header.contentPostingsOffset = AlignTo8(header.namePostingsOffset + header.namePostingsSize);
+            header.contentPostingsSize = contentPostings.size();
+            header.totalFiles = stats_.totalFiles;
+            header.totalDirectories = stats_.totalDirectories;
+            header.totalSizeBytes = stats_.totalSizeBytes;
+            header.lastUpdate = ToIndexTime(stats_.lastUpdate);
+            header.journalOffset = journal.empty() ? 0
+                : AlignTo8(header.contentPostingsOffset + header.contentPostingsSize);
+
+            std::ofstream out(file, std::ios::binary | std::ios::trunc);
+            if (!out) {
+                return false;
+            }
+
+            uint64_t written = 0;
+            auto writeAt = [&](uint64_t offset, const void* data, size_t size) {
+                static const char padding[8] = {};
+                if (offset > written) {
+                    out.write(padding, static_cast<std::streamsize>(offset - written));
+                }
+                out.write(static_cast<const char*>(data), static_cast<std::streamsize>(size));
+                written = offset + size;
+            };
+
+            writeAt(0, &header, sizeof(header));
+            writeAt(header.recordsOffset, records.data(), records.size() * sizeof(IndexFileRecord));
+            writeAt(header.stringsOffset, strings.data(), strings.size());
+            writeAt(header.contentOffset, nullptr, 0);
+            for (DocId doc : order) {
+                std::string_view content = store_.Content(doc);
+                out.write(content.data(), static_cast<std::streamsize>(content.size()));
+                written += content.size();
+            }
+            writeAt(header.namePostingsOffset, namePostings.data(), namePostings.size());
+            writeAt(header.contentPostingsOffset, contentPostings.data(), contentPostings.size());
+            if (header.journalOffset != 0) {
+                writeAt(header.journalOffset, journal.data(), journal.size());
+            }
+
+            out.flush();
+            return static_cast<bool>(out);
+        }
+
+        bool LoadBinaryLocked(const std::filesystem::path& file)
+        {
+            ClearEntriesLocked();
+
+            if (!indexFile_.Open(file)) {
+                Logger::Get()->error("SearchIndex: Failed to map {}", file.string());
+                return false;
+            }
+
+            IndexFileHeader header{};
+            std::string_view headerView = indexFile_.View(0, sizeof(header));
+            if (headerView.empty()) {
+                indexFile_.Close();
+                return false;
+            }
+            std::memcpy(&header, headerView.data(), sizeof(header));
+
+            std::string_view recordsView = indexFile_.View(header.recordsOffset,
+                header.entryCount * sizeof(IndexFileRecord));
+            std::string_view strings = indexFile_.View(header.stringsOffset, header.stringsSize);
+            std::string_view content = indexFile_.View(header.contentOffset, header.contentSize);
+
+            if (std::memcmp(header.magic, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+                header.version != kIndexVersion ||
+                header.entryCount > indexFile_.Size() / sizeof(IndexFileRecord) ||
+                recordsView.size() != header.entryCount * sizeof(IndexFileRecord) ||
+                strings.size() != header.stringsSize ||
+                content.size() != header.contentSize)
+            {
+                Logger::Get()->warn("SearchIndex: {} is not a valid version {} index", file.string(), kIndexVersion);
+                indexFile_.Close();
+                return false;
+            }
+
+            auto* records = reinterpret_cast<const IndexFileRecord*>(recordsView.data());
+
+            for (uint64_t i = 0; i < header.entryCount; ++i) {
+                const IndexFileRecord& record = records[i];
+                uint64_t stringsLength = uint64_t{record.pathLength} + record.filenameLength + record.extensionLength;
+                if (record.pathOffset > strings.size() || stringsLength > strings.size() - record.pathOffset ||
+                    record.contentOffset > content.size() || record.contentLength > content.size() - record.contentOffset)
+                {
+                    Logger::Get()->warn("SearchIndex: Corrupt record {} in {}", i, file.string());
+                    ClearEntriesLocked();
+                    return false;
+                }
+
+                std::string_view names = strings.substr(record.pathOffset, stringsLength);
+                IndexEntry entry;
+                entry.path = std::filesystem::path(std::string(names.substr(0, record.pathLength)));
+                entry.filename = std::string(names.substr(record.pathLength, record.filenameLength));
+                entry.extension = std::string(names.substr(record.pathLength + record.filenameLength));
+                entry.size = record.size;
+                entry.modifiedTime = FromIndexTime(record.modifiedTime);
+                entry.indexedTime = FromIndexTime(record.indexedTime);
+                entry.contentHash = record.contentHash;
+                entry.isDirectory = (record.flags & kRecordDirectory) != 0;
+
+                // DocIds must line up with the serialized postings
+                if (store_.Find(entry.path) || store_.Insert(std::move(entry)) != i) {
+                    Logger::Get()->warn("SearchIndex: Duplicate record {} in {}", i, file.string());
+                    ClearEntriesLocked();
+                    return false;
+                }
+                if (record.contentLength > 0) {
+                    store_.SetMappedContent(static_cast<DocId>(i),
+                        content.substr(record.contentOffset, record.contentLength));
+                }
+            }
+
+            // Postings are used in place; rebuild them if either segment is unusable
+            bool postingsOk =
+                nameTrigrams_.AttachSegment(indexFile_.View(header.namePostingsOffset, header.namePostingsSize)) &&
+                contentTrigrams_.AttachSegment(indexFile_.View(header.contentPostingsOffset, header.contentPostingsSize));
+            if (!postingsOk) {
+                Logger::Get()->warn("SearchIndex: Rebuilding postings for {}", file.string());
+                RebuildTrigramsLocked();
+            }
+            RebuildNameIndexLocked();
+
+            // Without cursors the next update rescans, which is always safe
+            if (header.journalOffset != 0 && header.journalOffset < indexFile_.Size()) {
+                if (!ParseJournalLocked(indexFile_.View(header.journalOffset,
+                                                        indexFile_.Size() - header.journalOffset))) {
+                    Logger::Get()->warn("SearchIndex: Ignoring corrupt journal segment in {}", file.string());
+                    journalCursors_.clear();
+                }
+            }
+
+            stats_.indexedFiles = store_.Size();
+            stats_.totalFiles = header.totalFiles;
+            stats_.totalDirectories = header.totalDirectories;
+            stats_.totalSizeBytes = header.totalSizeBytes;
+            stats_.contentIndexedFiles = store_.ContentCount();
+            stats_.lastUpdate = FromIndexTime(header.lastUpdate);
+            stats_.indexSizeBytes = indexFile_.Size() + MemoryUsageLocked();
+
+            Logger::Get()->info("SearchIndex: Mapped {} entries from {}", store_.Size(), file.string());
+            return true;
+        }
+
+        std::string SerializeJournalLocked() const
+        {
+            std::string out;
+            if (journalCursors_.empty()) {
+                return out;
+            }
+
+            auto count = static_cast<uint32_t>(journalCursors_.size());
+            out.append(reinterpret_cast<const char*>(&count), sizeof(count));
+            out.resize(AlignTo8(out.size()), '\0');
+            for (const auto& cursor : journalCursors_) {
+                JournalSegmentEntry entry{};
+                entry.journalId = cursor.journalId;
+                entry.nextUsn = cursor.nextUsn;
+                entry.volumeLength = static_cast<uint32_t>(cursor.volume.size());
+                out.append(reinterpret_cast<const char*>(&entry), sizeof(entry));
+                out += cursor.volume;
+                out.resize(AlignTo8(out.size()), '\0');
+            }
+            return out;
+        }
+
+        bool ParseJournalLocked(std::string_view segment)
+        {
+            journalCursors_.clear();
+
+            uint32_t count = 0;
+            if (segment.size() < sizeof(count)) {
+                return false;
+            }
+            std::memcpy(&count, segment.data(), sizeof(count));
+
+            size_t offset = AlignTo8(sizeof(count));
+            for (uint32_t i = 0; i < count; ++i) {
+                JournalSegmentEntry entry{};
+                if (offset > segment.size() || segment.size() - offset < sizeof(entry)) {
+                    return false;
+                }
+                std::memcpy(&entry, segment.data() + offset, sizeof(entry));
+                offset += sizeof(entry);
+                if (segment.size() - offset < entry.volumeLength) {
+                    return false;
+                }
+
+                UsnCursor cursor;
+                cursor.volume = std::string(segment.substr(offset, entry.volumeLength));
+                cursor.journalId = entry.journalId;
+                cursor.nextUsn = entry.nextUsn;
+                journalCursors_.push_back(std::move(cursor));
+                offset = AlignTo8(offset + entry.volumeLength);
+            }
+            return true;
+        }
+
+        // What ClearEntriesLocked drops, held aside while a replacement loads
+        struct LoadedState
+        {
+            EntryStore store;
+            TrigramIndex nameTrigrams;
+            TrigramIndex contentTrigrams;
+            NameIndex nameIndex;
+            size_t removedDocs = 0;
+            MappedFile indexFile;
+            std::vector<UsnCursor> journalCursors;
+            IndexStats stats;
+        };
+
+        LoadedState TakeStateLocked()
+        {
+            LoadedState state;
+            state.store = std::move(store_);
+            state.nameTrigrams = std::move(nameTrigrams_);
+            state.contentTrigrams = std::move(contentTrigrams_);
+            state.nameIndex = std::move(nameIndex_);
+            state.removedDocs = removedDocs_;
+            state.indexFile = std::move(indexFile_);
+            state.journalCursors = std::move(journalCursors_);
+            state.stats = stats_;
+
+            // Moved-from members are valid but not necessarily empty
+            ClearEntriesLocked();
+            return state;
+        }
+
+        void RestoreStateLocked(LoadedState&& state)
+        {
+            ClearEntriesLocked();
+            store_ = std::move(state.store);
+            nameTrigrams_ = std::move(state.nameTrigrams);
+            contentTrigrams_ = std::move(state.contentTrigrams);
+            nameIndex_ = std::move(state.nameIndex);
+            removedDocs_ = state.removedDocs;
+            indexFile_ = std::move(state.indexFile);
+            journalCursors_ = std::move(state.journalCursors);
+            stats_ = state.stats;
+        }
+
+        /**
+         * @brief Write index.bin and optionally switch to the new mapping
+         *
+         * The file is written next to the live one and renamed into place so
+         * a crash never leaves a truncated index. The old mapping has to be
+         * released before the rename, so when reopen is set the entries are
+         * first loaded from the new file (which moves their content out of
+         * memory) and the old ones are given up only once that worked.
+         */
+        bool SaveLocked(bool reopen)
+        {
+            std::filesystem::path indexFile = config_.indexPath / kIndexFileName;
+            std::filesystem::path tempFile = config_.indexPath / (std::string(kIndexFileName) + ".tmp");
+
+            try {
+                if (!WriteBinaryLocked(tempFile)) {
+                    Logger::Get()->error("SearchIndex: Failed to write {}", tempFile.string());
+                    return false;
+                }
+
+                if (reopen) {
+                    // A file that does not read back leaves the index as it was
+                    LoadedState previous = TakeStateLocked();
+                    if (!LoadBinaryLocked(tempFile)) {
+                        RestoreStateLocked(std::move(previous));
+                        std::error_code removeError;
+                        std::filesystem::remove(tempFile, removeError);
+                        Logger::Get()->error("SearchIndex: {} did not read back; keeping the loaded index",
+                                             tempFile.string());
+                        return false;
+                    }
+                } else {
+                    // Closing: the entries are not needed again, only their
+                    // mapping is in the way
+                    ClearEntriesLocked();
+                }
+
+                // Nothing maps index.bin any more
+                std::error_code ec;
+                std::filesystem::rename(tempFile, indexFile, ec);
+                if (ec) {
+                    // Entries stay valid, served from the mapped temp file
+                    Logger::Get()->error("SearchIndex: Failed to replace {}: {}", indexFile.string(), ec.message());
+                    return false;
+                }
+
+                Logger::Get()->info("SearchIndex: Saved index to {}", indexFile.string());
+                return true;
+            }
+            catch (const std::exception& e) {
+                Logger::Get()->error("SearchIndex: Failed to save index: {}", e.what());
+                return false;
+            }
+        }
+
+        bool WriteJsonLocked(const std::filesystem::path& file) const
+        {
+            try {
+                json j;
+                j["version"] = 1;
+                j["stats"]["totalFiles"] = stats_.totalFiles;
+                j["stats"]["indexedFiles"] = stats_.indexedFiles;
+
+                json entries = json::array();
+                store_.ForEach([&](DocId doc) {
+                    const CompactEntry& entry = store_.Record(doc);
+                    json e;
+                    e["path"] = store_.Path(doc).string();
+                    e["filename"] = std::string(store_.Filename(doc));
+                    e["extension"] = store_.Extension(doc);
+                    e["size"] = entry.size;
+                    e["isDirectory"] = entry.IsDirectory();
+                    e["contentHash"] = entry.contentHash;
+                    // Don't save content - too large
+                    entries.push_back(e);
+                });
+                j["entries"] = entries;
+
+                std::ofstream out(file);
+                out << j.dump();
+
+                Logger::Get()->info("SearchIndex: Exported index to {}", file.string());
+                return static_cast<bool>(out);
+            }
+            catch (const std::exception& e) {
+                Logger::Get()->error("SearchIndex: Failed to export index: {}", e.what());
+                return false;
+            }
+        }
+
+        bool ReadJsonLocked(const std::filesystem::path& file)
+        {
+            try {
+                std::ifstream in(file);
+                json j = json::parse(in);
+
+                ClearEntriesLocked();
+
+                for (const auto& e : j["entries"]) {
+                    IndexEntry entry;
+                    entry.path = std::filesystem::path(e["path"].get<std::string>());
+                    entry.filename = e["filename"].get<std::string>();
+                    entry.extension = e["extension"].get<std::string>();
+                    entry.size = e["size"].get<uint64_t>();
+                    entry.isDirectory = e["isDirectory"].get<bool>();
+                    entry.contentHash = e.value("contentHash", 0u);
+
+                    InsertEntryLocked(std::move(entry));
+                }
+                nameIndex_.Merge();
+
+                stats_.indexedFiles = store_.Size();
+                stats_.indexSizeBytes = MemoryUsageLocked();
+
+                Logger::Get()->info("SearchIndex: Imported {} entries from {}", store_.Size(), file.string());
+                return true;
+            }
+            catch (const std::exception& e) {
+                Logger::Get()->error("SearchIndex: Failed to import index: {}", e.what());
+                return false;
+            }
+        }
+
         bool ShouldIndex(const std::filesystem::path& path)
         {
             std::string filename = path.filename().string();
@@ -125,6 +884,21 @@ namespace opacity::search
 
         IndexEntry CreateEntry(const std::filesystem::path& path)
         {
+            std::error_code ec;
+            std::filesystem::directory_entry item(path, ec);
+            IndexEntry entry = CreateEntry(item);
+            if (WantsContent(entry)) {
+                ReadContent(entry);
+            }
+            return entry;
+        }
+
+        // Metadata only; uses the attributes the directory enumeration
+        // already cached instead of stat'ing the file again.
+        IndexEntry CreateEntry(const std::filesystem::directory_entry& item)
+        {
+            const auto& path = item.path();
+
             IndexEntry entry;
             entry.path = path;
             entry.filename = path.filename().string();
@@ -133,181 +907,758 @@ namespace opacity::search
             
             std::error_code ec;
             
-            if (std::filesystem::is_directory(path, ec)) {
+            if (item.is_directory(ec)) {
                 entry.isDirectory = true;
                 return entry;
             }
 
-            entry.size = std::filesystem::file_size(path, ec);
-            
-            auto ftime = std::filesystem::last_write_time(path, ec);
-            if (!ec) {
-                // Convert file_time_type to system_clock::time_point
-                auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
-                    ftime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now()
-                );
-                entry.modifiedTime = sctp;
+            entry.size = item.file_size(ec);
+            if (ec) entry.size = 0;
+            
+            auto ftime = item.last_write_time(ec);
+            if (!ec) {
+                // Convert file_time_type to system_clock::time_point
+                auto sctp = std::chrono::time_point_cast<std::chrono::system_clock::duration>(
+                    ftime - std::filesystem::file_time_type::clock::now() + std::chrono::system_clock::now()
+                );
+                entry.modifiedTime = sctp;
+            }
+
+            return entry;
+        }
+
+        bool IsExtractedFile(const std::filesystem::path& path) const
+        {
+            if (!extractor_) {
+                return false;
+            }
+            std::string ext = path.extension().string();
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            return std::find(extractorExtensions_.begin(), extractorExtensions_.end(), ext) != extractorExtensions_.end();
+        }
+
+        bool WantsContent(const IndexEntry& entry) const
+        {
+            if (!config_.indexContent || entry.isDirectory) {
+                return false;
+            }
+            // A document's size says little about how much text it holds
+            return (IsTextFile(entry.path) && entry.size <= config_.maxFileSize) ||
+                IsExtractedFile(entry.path);
+        }
+
+        void ReadContent(IndexEntry& entry)
+        {
+            // Reading an online-only file, text or document, would download
+            // all of it
+            if (filesystem::CloudIntegration::ShouldSkipRead(entry.path)) {
+                return;
+            }
+
+            if (IsExtractedFile(entry.path)) {
+                ReadExtractedContent(entry);
+                return;
+            }
+
+            // Index content for text files
+            try {
+                std::ifstream file(entry.path, std::ios::binary);
+                if (file) {
+                    std::stringstream ss;
+                    ss << file.rdbuf();
+                    entry.content = ss.str();
+                    entry.contentHash = HashContent(entry.content);
+                }
+            }
+            catch (...) {
+                // Ignore content indexing errors
+            }
+        }
+
+        void ReadExtractedContent(IndexEntry& entry)
+        {
+            // Chunks arrive whole characters at a time, so stopping between
+            // them never splits one
+            std::string content;
+            size_t limit = static_cast<size_t>(config_.maxFileSize);
+            try {
+                extractor_(entry.path, [&](std::string_view text) {
+                    if (content.size() + text.size() > limit) {
+                        return false;
+                    }
+                    content.append(text);
+                    return true;
+                });
+            }
+            catch (...) {
+                // Ignore content indexing errors
+            }
+
+            if (!content.empty()) {
+                entry.content = std::move(content);
+                entry.contentHash = HashContent(entry.content);
+            }
+        }
+
+        bool ShouldDescend(const std::filesystem::path& dir) const
+        {
+            // Everything below an excluded directory would be rejected anyway
+            std::string dirString = dir.string();
+            for (const auto& excluded : config_.excludedDirs) {
+                if (dirString.find(excluded) != std::string::npos) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        CrawlOptions MakeCrawlOptions() const
+        {
+            CrawlOptions options;
+            options.crawlThreads = config_.maxThreads > 0
+                ? config_.maxThreads
+                : static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+            options.contentThreads = std::max(1, config_.maxContentThreads);
+            options.followSymlinks = config_.followSymlinks;
+            options.background.low_priority = config_.backgroundPriority;
+            options.background.yield_to_foreground = config_.yieldToForeground;
+            options.background.input_grace = std::chrono::milliseconds(std::max(0, config_.foregroundIdleMs));
+            return options;
+        }
+
+        // The returned callbacks reference progress; it must outlive the crawl
+        CrawlCallbacks MakeCrawlCallbacks(const IndexProgressCallback& progress)
+        {
+            CrawlCallbacks callbacks;
+            callbacks.shouldIndex = [this](const std::filesystem::path& path) { return ShouldIndex(path); };
+            callbacks.shouldDescend = [this](const std::filesystem::path& dir) { return ShouldDescend(dir); };
+            callbacks.createEntry = [this](const std::filesystem::directory_entry& item) { return CreateEntry(item); };
+            callbacks.wantsContent = [this](const IndexEntry& entry) { return WantsContent(entry); };
+            callbacks.readContent = [this](IndexEntry& entry) { ReadContent(entry); };
+            callbacks.sink = [this](std::vector<IndexEntry>&& batch) {
+                std::unique_lock<std::shared_mutex> lock(entriesMutex_);
+                for (auto& entry : batch) {
+                    InsertEntryLocked(std::move(entry));
+                }
+            };
+            if (progress) {
+                callbacks.progress = [this, &progress](const std::filesystem::path& current,
+                                                       size_t processed, size_t discovered) {
+                    double prog = discovered > 0 ? static_cast<double>(processed) / discovered : 0.0;
+                    indexingProgress_ = prog;
+                    progress(current.string(), prog);
+                };
+            }
+            return callbacks;
+        }
+
+        /**
+         * @brief Crawl roots in parallel, merging results into the store in batches
+         */
+        void CrawlRoots(const std::vector<std::filesystem::path>& roots, IndexProgressCallback progress)
+        {
+            IndexCrawler crawler(MakeCrawlOptions(), MakeCrawlCallbacks(progress));
+            crawler.Run(roots, cancelIndexing_);
+            FinishBulkInsert();
+        }
+
+        /**
+         * @brief Index whatever roots can be read straight from the MFT
+         * @return Roots that still need a directory crawl
+         */
+        std::vector<std::filesystem::path> IndexRootsFromMft(const std::vector<std::filesystem::path>& roots,
+                                                             IndexProgressCallback progress)
+        {
+            std::vector<std::pair<std::string, std::vector<std::filesystem::path>>> volumes;
+            std::vector<std::filesystem::path> remaining;
+
+            for (const auto& root : roots) {
+                auto volume = MftReader::IsAvailable(root) ? UsnJournal::VolumeOf(root) : std::nullopt;
+                if (!volume) {
+                    remaining.push_back(root);
+                    continue;
+                }
+                auto it = std::find_if(volumes.begin(), volumes.end(),
+                    [&](const auto& group) { return group.first == *volume; });
+                if (it == volumes.end()) {
+                    volumes.push_back({*volume, {}});
+                    it = volumes.end() - 1;
+                }
+                it->second.push_back(root);
+            }
+
+            for (const auto& [volume, volumeRoots] : volumes) {
+                if (!IndexFromMft(volume, volumeRoots, progress)) {
+                    remaining.insert(remaining.end(), volumeRoots.begin(), volumeRoots.end());
+                }
+            }
+            return remaining;
+        }
+
+        /**
+         * @brief Build entries for roots on one volume from its MFT records
+         *
+         * Only paths have to be rebuilt (from parent references); text files
+         * still go through the crawler's content pool.
+         * @return false if the MFT could not be read
+         */
+        bool IndexFromMft(const std::string& volume, const std::vector<std::filesystem::path>& roots,
+                          IndexProgressCallback progress)
+        {
+            MftReader reader;
+            if (!reader.Open(volume)) {
+                return false;
+            }
+
+            struct Node
+            {
+                uint64_t parent = 0;
+                std::u16string name;
+                uint64_t size = 0;
+                int64_t modifiedTime = 0;
+                bool isDirectory = false;
+                bool inUse = false;
+            };
+
+            std::vector<Node> nodes(reader.RecordCount());
+            bool complete = reader.Enumerate([&](const MftRecord& record) {
+                // Extension records contribute attributes to their base record
+                uint64_t number = record.baseRecord != 0 ? record.baseRecord : record.number;
+                if (number >= nodes.size()) return;
+
+                Node& node = nodes[number];
+                if (record.baseRecord == 0) {
+                    node.inUse = true;
+                    node.isDirectory = record.isDirectory;
+                    node.modifiedTime = record.modifiedTime;
+                }
+                if (node.name.empty() && !record.name.empty()) {
+                    node.parent = record.parent;
+                    node.name = record.name;
+                }
+                if (record.hasSize) {
+                    node.size = record.size;
+                }
+            }, cancelIndexing_);
+            if (!complete) {
+                return false;
+            }
+
+            // Directory paths are rebuilt once and shared by their children;
+            // an empty path marks a directory that cannot be resolved
+            std::unordered_map<uint64_t, std::filesystem::path> dirPaths;
+            dirPaths[MftReader::kRootRecord] = std::filesystem::path(volume);
+
+            auto resolveDir = [&](uint64_t dir) -> const std::filesystem::path& {
+                std::vector<uint64_t> chain;
+                auto it = dirPaths.find(dir);
+                while (it == dirPaths.end()) {
+                    bool valid = dir < nodes.size() && nodes[dir].inUse && nodes[dir].isDirectory &&
+                                 dir >= MftReader::kFirstUserRecord && chain.size() < 1024;
+                    if (!valid) {
+                        it = dirPaths.emplace(dir, std::filesystem::path()).first;
+                        break;
+                    }
+                    chain.push_back(dir);
+                    dir = nodes[dir].parent;
+                    it = dirPaths.find(dir);
+                }
+
+                const std::filesystem::path* base = &it->second;
+                for (auto link = chain.rbegin(); link != chain.rend(); ++link) {
+                    std::filesystem::path path = base->empty()
+                        ? std::filesystem::path()
+                        : *base / std::filesystem::path(nodes[*link].name);
+                    base = &dirPaths.insert_or_assign(*link, std::move(path)).first->second;
+                }
+                return *base;
+            };
+
+            // MFT names carry on-disk case; compare against canonical roots
+            std::vector<std::filesystem::path> canonicalRoots;
+            for (const auto& root : roots) {
+                std::error_code ec;
+                auto canonical = std::filesystem::weakly_canonical(root, ec);
+                canonicalRoots.push_back(ec ? root : canonical);
+            }
+
+            std::vector<IndexEntry> entries;
+            auto now = std::chrono::system_clock::now();
+            for (uint64_t number = MftReader::kFirstUserRecord; number < nodes.size(); ++number) {
+                const Node& node = nodes[number];
+                if (!node.inUse || node.name.empty()) continue;
+
+                const std::filesystem::path& parent = resolveDir(node.parent);
+                if (parent.empty()) continue;
+
+                std::filesystem::path path = parent / std::filesystem::path(node.name);
+                bool inRoots = std::any_of(canonicalRoots.begin(), canonicalRoots.end(),
+                    [&](const std::filesystem::path& root) { return IsWithin(path, root) && !IsWithin(root, path); });
+                if (!inRoots || !ShouldIndex(path)) continue;
+
+                IndexEntry entry;
+                entry.path = path;
+                entry.filename = path.filename().string();
+                entry.extension = path.extension().string();
+                entry.isDirectory = node.isDirectory;
+                entry.size = node.isDirectory ? 0 : node.size;
+                entry.modifiedTime = FromIndexTime(node.modifiedTime);
+                entry.indexedTime = now;
+                entries.push_back(std::move(entry));
+            }
+            nodes.clear();
+            dirPaths.clear();
+
+            Logger::Get()->info("SearchIndex: Enumerated {} entries from the MFT of {}", entries.size(), volume);
+
+            IndexCrawler crawler(MakeCrawlOptions(), MakeCrawlCallbacks(progress));
+            crawler.Ingest(std::move(entries), cancelIndexing_);
+            FinishBulkInsert();
+            return true;
+        }
+
+        // ---- Incremental updates ----
+
+        /**
+         * @brief Current journal positions for every journaled volume under roots
+         *
+         * Taken before a crawl so changes made while it runs are replayed
+         * on the next update rather than lost.
+         */
+        std::vector<UsnCursor> QueryJournalCursors(const std::vector<std::filesystem::path>& roots) const
+        {
+            std::vector<UsnCursor> cursors;
+            for (const auto& root : roots) {
+                if (!UsnJournal::IsSupported(root)) continue;
+                auto volume = UsnJournal::VolumeOf(root);
+                if (!volume) continue;
+
+                bool known = std::any_of(cursors.begin(), cursors.end(),
+                    [&](const UsnCursor& cursor) { return cursor.volume == *volume; });
+                if (known) continue;
+
+                if (auto cursor = UsnJournal::QueryCursor(*volume)) {
+                    cursors.push_back(std::move(*cursor));
+                }
+            }
+            return cursors;
+        }
+
+        /**
+         * @brief Apply journal changes that fall under the given roots
+         * @return Number of changes applied
+         */
+        size_t ApplyJournalChanges(const std::vector<UsnChange>& changes,
+                                   const std::vector<std::filesystem::path>& roots)
+        {
+            std::vector<std::filesystem::path> newDirs;
+            size_t applied = 0;
+
+            for (const auto& change : changes) {
+                if (cancelIndexing_) break;
+
+                bool inRoots = std::any_of(roots.begin(), roots.end(),
+                    [&](const std::filesystem::path& root) { return IsWithin(change.path, root); });
+                if (!inRoots) continue;
+
+                // Records can describe files that are already gone again
+                std::error_code ec;
+                bool exists = std::filesystem::exists(change.path, ec);
+
+                if (change.kind == UsnChange::Kind::Removed || !exists) {
+                    std::unique_lock<std::shared_mutex> lock(entriesMutex_);
+                    if (EraseTreeLocked(change.path) > 0) {
+                        NotifyUpdate({IndexUpdateEvent::Type::Removed, change.path, ""});
+                        applied++;
+                    }
+                    continue;
+                }
+
+                if (!ShouldIndex(change.path)) continue;
+
+                // A directory that appeared (created or moved in) may bring a subtree
+                if (change.isDirectory && change.kind == UsnChange::Kind::Added && ShouldDescend(change.path)) {
+                    newDirs.push_back(change.path);
+                }
+
+                try {
+                    IndexEntry entry = CreateEntry(change.path);
+                    std::unique_lock<std::shared_mutex> lock(entriesMutex_);
+                    bool existed = store_.Find(change.path).has_value();
+                    InsertEntryLocked(std::move(entry));
+                    NotifyUpdate({existed ? IndexUpdateEvent::Type::Modified : IndexUpdateEvent::Type::Added,
+                                  change.path, ""});
+                    applied++;
+                }
+                catch (const std::exception& e) {
+                    Logger::Get()->warn("SearchIndex: Failed to update {}: {}", change.path.string(), e.what());
+                }
+            }
+
+            if (!newDirs.empty() && !cancelIndexing_) {
+                CrawlRoots(newDirs, nullptr);
+            }
+            return applied;
+        }
+
+        void RecomputeStatsLocked()
+        {
+            stats_.totalFiles = 0;
+            stats_.totalDirectories = 0;
+            stats_.indexedFiles = store_.Size();
+            stats_.contentIndexedFiles = store_.ContentCount();
+            stats_.totalSizeBytes = 0;
+
+            store_.ForEach([this](DocId doc) {
+                const CompactEntry& entry = store_.Record(doc);
+                if (entry.IsDirectory()) {
+                    stats_.totalDirectories++;
+                } else {
+                    stats_.totalFiles++;
+                    stats_.totalSizeBytes += entry.size;
+                }
+            });
+
+            stats_.indexSizeBytes = MemoryUsageLocked();
+        }
+
+        // ---- Searching ----
+
+        /**
+         * @brief Score matching documents into a bounded top-K heap
+         *
+         * Filename candidates are scored before content-only ones, and the
+         * scan stops early once maxResults hits of kHighConfidenceScore or
+         * better are held, once nothing left can outrank the weakest hit, or
+         * when CancelSearch fires. With emit set, every hit is reported as
+         * soon as it enters the heap, so callers see results before the scan
+         * finishes; the returned vector holds the final ranking. Reports go
+         * out from a helper task while the scan holds the index lock, so a
+         * slow callback never holds off writers, and only the hits still in
+         * the heap are kept for them.
+         */
+        std::vector<IndexSearchResult> RunSearch(const SearchQuery& query, const IndexResultCallback& emit)
+        {
+            auto startTime = std::chrono::steady_clock::now();
+            std::vector<IndexSearchResult> results;
+
+            searching_ = true;
+            cancelSearch_ = false;
+
+            const size_t limit = static_cast<size_t>(std::max(0, query.maxResults));
+            if (limit == 0) {
+                searching_ = false;
+                return results;
             }
 
-            // Index content for text files
-            if (config_.indexContent && 
-                IsTextFile(path) && 
-                entry.size <= config_.maxFileSize)
+            struct Hit
             {
-                try {
-                    std::ifstream file(path, std::ios::binary);
-                    if (file) {
-                        std::stringstream ss;
-                        ss << file.rdbuf();
-                        entry.content = ss.str();
-                        entry.contentHash = HashContent(entry.content);
-                    }
-                }
-                catch (...) {
-                    // Ignore content indexing errors
+                float score;
+                DocId doc;
+            };
+            // Min-heap on score: front() is the weakest hit kept
+            auto weaker = [](const Hit& a, const Hit& b) { return a.score > b.score; };
+            std::vector<Hit> heap;
+            heap.reserve(std::min<size_t>(limit, 4096));
+
+            // Compiled once per query; an invalid pattern is searched as plain text
+            std::optional<Regex> compiled;
+            if (query.useRegex) {
+                std::string error;
+                compiled = Regex::Compile(query.text, query.caseSensitive, &error);
+                if (!compiled) {
+                    OPACITY_LOG_DEBUG(Search, "SearchIndex: Invalid regex '{}' ({}), searching as text", query.text, error);
                 }
             }
+            const Regex* regex = compiled ? &*compiled : nullptr;
 
-            return entry;
-        }
-
-        void IndexDirectory(const std::filesystem::path& root, 
-                           std::vector<IndexEntry>& newEntries,
-                           IndexProgressCallback progress)
-        {
-            std::error_code ec;
-            
-            // Count files first for progress
-            size_t totalFiles = 0;
-            size_t processedFiles = 0;
-            
-            for (auto& entry : std::filesystem::recursive_directory_iterator(root, 
-                std::filesystem::directory_options::skip_permission_denied, ec))
+            // Hits waiting for emit, or already through it and still ranked
+            struct Outbox
             {
-                if (cancelIndexing_) return;
-                totalFiles++;
+                std::mutex mutex;
+                std::condition_variable ready;
+                std::unordered_map<DocId, IndexSearchResult> held;  // Every hit in the heap
+                std::vector<DocId> queued;                          // Not emitted yet
+                bool done = false;
+            };
+            Outbox outbox;
+
+            // Emits in batches with no lock held; waits for more unless told
+            // to take only what is there
+            auto deliver = [&](bool wait) {
+                std::unique_lock<std::mutex> lock(outbox.mutex);
+                while (true) {
+                    if (wait) {
+                        outbox.ready.wait(lock, [&] { return !outbox.queued.empty() || outbox.done; });
+                    }
+                    if (outbox.queued.empty()) return;
+
+                    // A hit outranked before its turn is not reported at all
+                    std::vector<IndexSearchResult> batch;
+                    batch.reserve(outbox.queued.size());
+                    for (DocId doc : outbox.queued) {
+                        auto it = outbox.held.find(doc);
+                        if (it != outbox.held.end()) batch.push_back(it->second);
+                    }
+                    outbox.queued.clear();
+
+                    lock.unlock();
+                    for (const IndexSearchResult& result : batch) {
+                        emit(result);
+                    }
+                    lock.lock();
+                }
+            };
+
+            // One that never starts leaves the reports to this thread once
+            // the scan is done
+            core::TaskGroup emitter;
+            if (emit) {
+                core::TaskOptions options;
+                options.priority = core::TaskPriority::Interactive;
+                emitter.Spawn(1, [&] { deliver(true); }, std::move(options));
             }
 
-            // Now index
-            for (auto& entry : std::filesystem::recursive_directory_iterator(root,
-                std::filesystem::directory_options::skip_permission_denied, ec))
             {
-                if (cancelIndexing_) return;
+                std::shared_lock<std::shared_mutex> lock(entriesMutex_);
 
-                const auto& path = entry.path();
-                
-                if (!ShouldIndex(path)) {
-                    continue;
+                const EntryStore& store = store_;
+
+                // Resolve the extension filter against the interned extensions once
+                std::vector<char> extensionAllowed;
+                if (!query.extensions.empty()) {
+                    const auto& extensions = store.Extensions();
+                    extensionAllowed.assign(extensions.size(), 0);
+                    for (size_t id = 0; id < extensions.size(); ++id) {
+                        std::string ext = extensions[id];
+                        std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+                        for (const auto& qext : query.extensions) {
+                            std::string qextLower = qext;
+                            std::transform(qextLower.begin(), qextLower.end(), qextLower.begin(), ::tolower);
+                            if (ext == qextLower || ext == "." + qextLower) {
+                                extensionAllowed[id] = 1;
+                                break;
+                            }
+                        }
+                    }
                 }
 
-                try {
-                    IndexEntry indexEntry = CreateEntry(path);
-                    newEntries.push_back(std::move(indexEntry));
+                int64_t modifiedAfter = query.modifiedAfter ? ToIndexTime(*query.modifiedAfter) : 0;
+                int64_t modifiedBefore = query.modifiedBefore ? ToIndexTime(*query.modifiedBefore) : 0;
+
+                auto makeResult = [&](DocId doc, float score) {
+                    IndexSearchResult result;
+                    result.entry = store.Materialize(doc);
+                    result.score = score;
+
+                    std::string_view content = store.Content(doc);
+                    if (query.searchContent && !content.empty()) {
+                        result.matches = FindMatches(content, query, regex);
+                        result.matchContext = GetMatchContext(content, result.matches);
+                    }
+                    return result;
+                };
+
+                // Returns false once the scan can stop; bound is the best score
+                // any document still to be visited could reach
+                auto visit = [&](DocId doc, float bound) -> bool {
+                    if (cancelSearch_) return false;
+
+                    if (heap.size() >= limit &&
+                        (heap.front().score >= kHighConfidenceScore || heap.front().score >= bound)) {
+                        return false;
+                    }
+
+                    const CompactEntry& entry = store.Record(doc);
+
+                    // Apply filters
+                    if (!extensionAllowed.empty() && !extensionAllowed[entry.extensionId]) return true;
+                    if (query.minSize && entry.size < *query.minSize) return true;
+                    if (query.maxSize && entry.size > *query.maxSize) return true;
+                    if (query.modifiedAfter && entry.modifiedTime < modifiedAfter) return true;
+                    if (query.modifiedBefore && entry.modifiedTime > modifiedBefore) return true;
+
+                    float score = CalculateScore(store.Filename(doc), store.Content(doc), query, regex);
+                    if (score <= 0.0f) return true;
+
+                    std::optional<DocId> evicted;
+                    if (heap.size() >= limit) {
+                        if (score <= heap.front().score) return true;
+                        std::pop_heap(heap.begin(), heap.end(), weaker);
+                        evicted = heap.back().doc;
+                        heap.pop_back();
+                    }
+                    heap.push_back({score, doc});
+                    std::push_heap(heap.begin(), heap.end(), weaker);
+
+                    if (emit) {
+                        IndexSearchResult result = makeResult(doc, score);
+                        std::lock_guard<std::mutex> outboxLock(outbox.mutex);
+                        if (evicted) outbox.held.erase(*evicted);
+                        outbox.held.emplace(doc, std::move(result));
+                        outbox.queued.push_back(doc);
+
+                        // Undelivered ids of outranked hits, while no one drains them
+                        if (outbox.queued.size() > 2 * limit) {
+                            outbox.queued.erase(std::remove_if(outbox.queued.begin(), outbox.queued.end(),
+                                                               [&](DocId id) { return outbox.held.count(id) == 0; }),
+                                                outbox.queued.end());
+                        }
+                        outbox.ready.notify_one();
+                    }
+                    return true;
+                };
+
+                const float nameBound = (query.searchFilenames ? 1.0f : 0.0f) + kMaxContentScore;
+                const float contentBound = query.searchContent ? kMaxContentScore : 0.0f;
+
+                // Only verify documents whose trigrams cover the query; fall back
+                // to a full scan for queries the trigram index cannot narrow.
+                if (auto candidates = FindCandidatesLocked(query, regex)) {
+                    bool running = true;
+                    for (DocId doc : candidates->names) {
+                        if (!store.IsLive(doc)) continue;
+                        if (!(running = visit(doc, nameBound))) break;
+                    }
+                    for (DocId doc : candidates->contentOnly) {
+                        if (!running) break;
+                        if (!store.IsLive(doc)) continue;
+                        if (!visit(doc, contentBound)) break;
+                    }
+                } else {
+                    for (DocId doc = 0; doc < store.DocCount(); ++doc) {
+                        if (!store.IsLive(doc)) continue;
+                        if (!visit(doc, nameBound)) break;
+                    }
+                }
+
+                // Best first (ties in index order); only the survivors are materialized
+                std::sort(heap.begin(), heap.end(), [](const Hit& a, const Hit& b) {
+                    return a.score != b.score ? a.score > b.score : a.doc < b.doc;
+                });
+                if (!emit) {
+                    results.reserve(heap.size());
+                    for (const Hit& hit : heap) {
+                        results.push_back(makeResult(hit.doc, hit.score));
+                    }
                 }
-                catch (...) {
-                    // Skip problematic files
+            }
+
+            // Past the lock: finish the reports, then rank what they kept
+            if (emit) {
+                {
+                    std::lock_guard<std::mutex> outboxLock(outbox.mutex);
+                    outbox.done = true;
                 }
+                outbox.ready.notify_all();
+                emitter.Close();
+                deliver(false);
 
-                processedFiles++;
-                if (progress && totalFiles > 0) {
-                    double prog = static_cast<double>(processedFiles) / totalFiles;
-                    indexingProgress_ = prog;
-                    progress(path.string(), prog);
+                results.reserve(heap.size());
+                for (const Hit& hit : heap) {
+                    results.push_back(std::move(outbox.held[hit.doc]));
                 }
             }
+
+            auto endTime = std::chrono::steady_clock::now();
+            stats_.lastSearchDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                endTime - startTime);
+
+            searching_ = false;
+
+            OPACITY_LOG_DEBUG(Search, "SearchIndex: Found {} results in {}ms",
+                results.size(), stats_.lastSearchDuration.count());
+
+            return results;
         }
 
-        float CalculateScore(const IndexEntry& entry, const SearchQuery& query)
+        float CalculateScore(std::string_view entryName, std::string_view entryContent,
+                             const SearchQuery& query, const Regex* regex)
         {
-            float score = 0.0f;
-            std::string searchText = query.text;
-            
-            if (!query.caseSensitive) {
-                std::transform(searchText.begin(), searchText.end(), searchText.begin(), ::tolower);
+            if (regex) {
+                return CalculateRegexScore(entryName, entryContent, query, *regex);
             }
 
+            float score = 0.0f;
+            const std::string& searchText = query.text;
+            const bool caseSensitive = query.caseSensitive;
+
             // Filename match (highest weight)
             if (query.searchFilenames) {
-                std::string filename = entry.filename;
-                if (!query.caseSensitive) {
-                    std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
-                }
-
-                if (filename == searchText) {
+                if (TextScanner::Equals(entryName, searchText, caseSensitive)) {
                     score += 1.0f;  // Exact match
-                } else if (filename.find(searchText) == 0) {
+                } else if (TextScanner::StartsWith(entryName, searchText, caseSensitive)) {
                     score += 0.8f;  // Prefix match
-                } else if (filename.find(searchText) != std::string::npos) {
+                } else if (TextScanner::Contains(entryName, searchText, caseSensitive)) {
                     score += 0.5f;  // Substring match
                 }
             }
 
             // Content match
-            if (query.searchContent && !entry.content.empty()) {
-                std::string content = entry.content;
-                if (!query.caseSensitive) {
-                    std::transform(content.begin(), content.end(), content.begin(), ::tolower);
-                }
-
-                size_t pos = 0;
-                int matchCount = 0;
-                while ((pos = content.find(searchText, pos)) != std::string::npos) {
-                    matchCount++;
-                    pos += searchText.length();
-                }
+            if (query.searchContent && !entryContent.empty()) {
+                // The score saturates at 10 matches; no need to count further
+                size_t matchCount = TextScanner::Count(entryContent, searchText, caseSensitive, 10);
 
                 if (matchCount > 0) {
                     // More matches = higher score, but with diminishing returns
-                    score += 0.3f * std::min(1.0f, static_cast<float>(matchCount) / 10.0f);
+                    score += kMaxContentScore * std::min(1.0f, static_cast<float>(matchCount) / 10.0f);
                 }
             }
 
             return score;
         }
 
-        std::vector<std::pair<size_t, size_t>> FindMatches(const std::string& text, 
-                                                           const SearchQuery& query)
+        // Same weights as the text path: full, leading or any filename match
+        float CalculateRegexScore(std::string_view entryName, std::string_view entryContent,
+                                  const SearchQuery& query, const Regex& regex)
         {
-            std::vector<std::pair<size_t, size_t>> matches;
-            
-            std::string searchText = query.text;
-            std::string content = text;
-            
-            if (!query.caseSensitive) {
-                std::transform(searchText.begin(), searchText.end(), searchText.begin(), ::tolower);
-                std::transform(content.begin(), content.end(), content.begin(), ::tolower);
-            }
+            float score = 0.0f;
 
-            if (query.useRegex) {
-                try {
-                    auto flags = std::regex::ECMAScript;
-                    if (!query.caseSensitive) flags |= std::regex::icase;
-                    
-                    std::regex re(searchText, flags);
-                    auto begin = std::sregex_iterator(content.begin(), content.end(), re);
-                    auto end = std::sregex_iterator();
-                    
-                    for (auto it = begin; it != end; ++it) {
-                        matches.emplace_back(it->position(), it->length());
+            if (query.searchFilenames) {
+                if (auto match = regex.Find(entryName)) {
+                    if (match->first == 0 && match->second == entryName.size()) {
+                        score += 1.0f;
+                    } else if (match->first == 0) {
+                        score += 0.8f;
+                    } else {
+                        score += 0.5f;
                     }
                 }
-                catch (...) {
-                    // Invalid regex, fall back to simple search
-                }
             }
 
-            if (matches.empty()) {
-                size_t pos = 0;
-                while ((pos = content.find(searchText, pos)) != std::string::npos) {
-                    matches.emplace_back(pos, searchText.length());
-                    pos += searchText.length();
+            if (query.searchContent && !entryContent.empty()) {
+                // The score saturates at 10 matches; no need to count further
+                size_t matchCount = regex.FindAll(entryContent, 10).size();
+                if (matchCount > 0) {
+                    score += kMaxContentScore * std::min(1.0f, static_cast<float>(matchCount) / 10.0f);
                 }
             }
 
+            return score;
+        }
+
+        std::vector<std::pair<size_t, size_t>> FindMatches(std::string_view text, 
+                                                           const SearchQuery& query,
+                                                           const Regex* regex)
+        {
+            if (regex) {
+                return regex->FindAll(text);
+            }
+
+            std::vector<std::pair<size_t, size_t>> matches;
+            const std::string& searchText = query.text;
+            if (searchText.empty()) return matches;
+
+            size_t pos = 0;
+            while ((pos = TextScanner::Find(text, searchText, query.caseSensitive, pos)) != std::string_view::npos) {
+                matches.emplace_back(pos, searchText.length());
+                pos += searchText.length();
+            }
+
             return matches;
         }
 
-        std::string GetMatchContext(const std::string& content, 
+        std::string GetMatchContext(std::string_view content, 
                                     const std::vector<std::pair<size_t, size_t>>& matches,
                                     int contextChars = 50)
         {
@@ -319,7 +1670,7 @@ namespace opacity::search
             size_t end = std::min(content.length(), 
                 firstMatch.first + firstMatch.second + contextChars);
 
-            std::string context = content.substr(start, end - start);
+            std::string context(content.substr(start, end - start));
             
             // Clean up whitespace
             std::replace(context.begin(), context.end(), '\n', ' ');
@@ -368,8 +1719,20 @@ namespace opacity::search
         StopAutoUpdate();
         CancelIndexing();
         CancelSearch();
+
+        std::vector<core::TaskHandle> searchTasks;
+        {
+            std::lock_guard<std::mutex> lock(impl_->searchTasksMutex_);
+            searchTasks.swap(impl_->searchTasks_);
+        }
+        for (auto& task : searchTasks) {
+            task.Wait();
+        }
         
-        SaveIndex();
+        if (!impl_->config_.indexPath.empty()) {
+            std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+            impl_->SaveLocked(false);
+        }
         
         impl_->initialized_ = false;
         Logger::Get()->info("SearchIndex: Shutdown");
@@ -396,44 +1759,22 @@ namespace opacity::search
 
         {
             std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-            impl_->entries_.clear();
+            impl_->ClearEntriesLocked();
         }
 
-        std::vector<IndexEntry> newEntries;
-        
-        for (const auto& root : impl_->config_.roots) {
-            if (impl_->cancelIndexing_) break;
-            
-            std::error_code ec;
-            if (std::filesystem::exists(root, ec)) {
-                impl_->IndexDirectory(root, newEntries, progress);
-            }
+        std::vector<UsnCursor> cursors = impl_->QueryJournalCursors(impl_->config_.roots);
+
+        std::vector<std::filesystem::path> crawlRoots = impl_->config_.roots;
+        if (impl_->config_.useMftEnumeration) {
+            crawlRoots = impl_->IndexRootsFromMft(crawlRoots, progress);
         }
+        impl_->CrawlRoots(crawlRoots, progress);
 
         if (!impl_->cancelIndexing_) {
             std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-            
-            for (auto& entry : newEntries) {
-                impl_->entries_[entry.path.string()] = std::move(entry);
-            }
-
-            impl_->stats_.totalFiles = 0;
-            impl_->stats_.totalDirectories = 0;
-            impl_->stats_.indexedFiles = impl_->entries_.size();
-            impl_->stats_.contentIndexedFiles = 0;
-            impl_->stats_.totalSizeBytes = 0;
 
-            for (const auto& [path, entry] : impl_->entries_) {
-                if (entry.isDirectory) {
-                    impl_->stats_.totalDirectories++;
-                } else {
-                    impl_->stats_.totalFiles++;
-                    impl_->stats_.totalSizeBytes += entry.size;
-                    if (!entry.content.empty()) {
-                        impl_->stats_.contentIndexedFiles++;
-                    }
-                }
-            }
+            impl_->journalCursors_ = std::move(cursors);
+            impl_->RecomputeStatsLocked();
 
             auto endTime = std::chrono::steady_clock::now();
             impl_->stats_.lastUpdate = std::chrono::system_clock::now();
@@ -445,18 +1786,120 @@ namespace opacity::search
         impl_->indexingProgress_ = 1.0;
 
         impl_->NotifyUpdate({IndexUpdateEvent::Type::Completed, {}, 
-            "Index rebuild completed: " + std::to_string(impl_->entries_.size()) + " entries"});
+            "Index rebuild completed: " + std::to_string(impl_->stats_.indexedFiles) + " entries"});
 
         Logger::Get()->info("SearchIndex: Rebuilt index with {} entries in {}ms",
-            impl_->entries_.size(), impl_->stats_.lastUpdateDuration.count());
+            impl_->stats_.indexedFiles, impl_->stats_.lastUpdateDuration.count());
 
         return !impl_->cancelIndexing_;
     }
 
     bool SearchIndex::UpdateIndex(IndexProgressCallback progress)
     {
-        // For now, just rebuild - a full implementation would do incremental updates
-        return RebuildIndex(progress);
+        OPACITY_PROFILE_ZONE("SearchIndex::UpdateIndex");
+        if (impl_->indexing_) {
+            return false;
+        }
+
+        std::vector<UsnCursor> cursors;
+        {
+            std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+            cursors = impl_->journalCursors_;
+        }
+
+        // Nothing to replay from (first run, or nothing journaled)
+        if (cursors.empty()) {
+            return RebuildIndex(progress);
+        }
+
+        impl_->indexing_ = true;
+        impl_->cancelIndexing_ = false;
+        impl_->indexingProgress_ = 0.0;
+
+        auto startTime = std::chrono::steady_clock::now();
+
+        impl_->NotifyUpdate({IndexUpdateEvent::Type::Started, {}, "Index update started"});
+
+        // Read each journaled volume once; roots whose volume cannot be
+        // replayed (non-NTFS, network, journal reset or truncated) are rescanned
+        std::vector<std::filesystem::path> journaledRoots;
+        std::vector<std::filesystem::path> rescanRoots;
+        std::vector<UsnCursor> advanced;
+        std::vector<std::string> failedVolumes;
+        std::vector<UsnChange> changes;
+
+        for (const auto& root : impl_->config_.roots) {
+            std::optional<std::string> volume;
+            if (UsnJournal::IsSupported(root)) {
+                volume = UsnJournal::VolumeOf(root);
+            }
+
+            auto sameVolume = [&](const UsnCursor& cursor) { return volume && cursor.volume == *volume; };
+            bool failed = volume && std::find(failedVolumes.begin(), failedVolumes.end(), *volume) != failedVolumes.end();
+
+            if (volume && !failed && std::none_of(advanced.begin(), advanced.end(), sameVolume)) {
+                auto cursor = std::find_if(cursors.begin(), cursors.end(), sameVolume);
+                std::optional<std::vector<UsnChange>> read;
+                if (cursor != cursors.end()) {
+                    read = UsnJournal::ReadChanges(*cursor);
+                }
+                if (read) {
+                    changes.insert(changes.end(), std::make_move_iterator(read->begin()),
+                                   std::make_move_iterator(read->end()));
+                    advanced.push_back(*cursor);
+                } else {
+                    Logger::Get()->info("SearchIndex: Journal for {} cannot be replayed, rescanning", *volume);
+                    failedVolumes.push_back(*volume);
+                    failed = true;
+                }
+            }
+
+            if (volume && !failed) {
+                journaledRoots.push_back(root);
+            } else {
+                rescanRoots.push_back(root);
+            }
+        }
+
+        size_t applied = impl_->ApplyJournalChanges(changes, journaledRoots);
+
+        if (!rescanRoots.empty() && !impl_->cancelIndexing_) {
+            // Restart journaling from here for volumes that now support it
+            std::vector<UsnCursor> fresh = impl_->QueryJournalCursors(rescanRoots);
+            advanced.insert(advanced.end(), fresh.begin(), fresh.end());
+
+            {
+                std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+                for (const auto& root : rescanRoots) {
+                    impl_->EraseTreeLocked(root);
+                }
+            }
+            impl_->CrawlRoots(rescanRoots, progress);
+        }
+
+        if (!impl_->cancelIndexing_) {
+            std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+
+            // Unread cursors stay behind so a cancelled update is replayed
+            impl_->journalCursors_ = std::move(advanced);
+            impl_->RecomputeStatsLocked();
+
+            auto endTime = std::chrono::steady_clock::now();
+            impl_->stats_.lastUpdate = std::chrono::system_clock::now();
+            impl_->stats_.lastUpdateDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
+                endTime - startTime);
+        }
+
+        impl_->indexing_ = false;
+        impl_->indexingProgress_ = 1.0;
+
+        impl_->NotifyUpdate({IndexUpdateEvent::Type::Completed, {},
+            "Index update completed: " + std::to_string(applied) + " changes"});
+
+        Logger::Get()->info("SearchIndex: Applied {} journal changes, rescanned {} roots in {}ms",
+            applied, rescanRoots.size(), impl_->stats_.lastUpdateDuration.count());
+
+        return !impl_->cancelIndexing_;
     }
 
     bool SearchIndex::AddToIndex(const std::filesystem::path& path)
@@ -469,7 +1912,7 @@ namespace opacity::search
             IndexEntry entry = impl_->CreateEntry(path);
             
             std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-            impl_->entries_[path.string()] = std::move(entry);
+            impl_->InsertEntryLocked(std::move(entry));
             
             impl_->NotifyUpdate({IndexUpdateEvent::Type::Added, path, ""});
             return true;
@@ -484,9 +1927,7 @@ namespace opacity::search
     {
         std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
         
-        auto it = impl_->entries_.find(path.string());
-        if (it != impl_->entries_.end()) {
-            impl_->entries_.erase(it);
+        if (impl_->EraseEntryLocked(path)) {
             impl_->NotifyUpdate({IndexUpdateEvent::Type::Removed, path, ""});
             return true;
         }
@@ -514,87 +1955,26 @@ namespace opacity::search
         return impl_->indexingProgress_;
     }
 
-    std::vector<SearchResult> SearchIndex::Search(const SearchQuery& query)
+    std::vector<IndexSearchResult> SearchIndex::Search(const SearchQuery& query)
     {
-        auto startTime = std::chrono::steady_clock::now();
-        std::vector<SearchResult> results;
-
-        impl_->searching_ = true;
-        impl_->cancelSearch_ = false;
-
-        {
-            std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-
-            for (const auto& [path, entry] : impl_->entries_) {
-                if (impl_->cancelSearch_) break;
-                if (results.size() >= static_cast<size_t>(query.maxResults)) break;
-
-                // Apply filters
-                if (!query.extensions.empty()) {
-                    std::string ext = entry.extension;
-                    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
-                    bool found = false;
-                    for (const auto& qext : query.extensions) {
-                        std::string qextLower = qext;
-                        std::transform(qextLower.begin(), qextLower.end(), qextLower.begin(), ::tolower);
-                        if (ext == qextLower || ext == "." + qextLower) {
-                            found = true;
-                            break;
-                        }
-                    }
-                    if (!found) continue;
-                }
-
-                if (query.minSize && entry.size < *query.minSize) continue;
-                if (query.maxSize && entry.size > *query.maxSize) continue;
-                if (query.modifiedAfter && entry.modifiedTime < *query.modifiedAfter) continue;
-                if (query.modifiedBefore && entry.modifiedTime > *query.modifiedBefore) continue;
-
-                // Calculate score
-                float score = impl_->CalculateScore(entry, query);
-                
-                if (score > 0.0f) {
-                    SearchResult result;
-                    result.entry = entry;
-                    result.score = score;
-                    
-                    if (query.searchContent && !entry.content.empty()) {
-                        result.matches = impl_->FindMatches(entry.content, query);
-                        result.matchContext = impl_->GetMatchContext(entry.content, result.matches);
-                    }
-                    
-                    results.push_back(std::move(result));
-                }
-            }
-        }
-
-        // Sort by score descending
-        std::sort(results.begin(), results.end(),
-            [](const SearchResult& a, const SearchResult& b) {
-                return a.score > b.score;
-            });
-
-        auto endTime = std::chrono::steady_clock::now();
-        impl_->stats_.lastSearchDuration = std::chrono::duration_cast<std::chrono::milliseconds>(
-            endTime - startTime);
-
-        impl_->searching_ = false;
-
-        Logger::Get()->debug("SearchIndex: Found {} results in {}ms",
-            results.size(), impl_->stats_.lastSearchDuration.count());
-
-        return results;
+        OPACITY_PROFILE_ZONE("SearchIndex::Search");
+        return impl_->RunSearch(query, nullptr);
     }
 
-    void SearchIndex::SearchAsync(const SearchQuery& query, SearchResultCallback callback)
+    void SearchIndex::SearchAsync(const SearchQuery& query, IndexResultCallback callback)
     {
-        std::thread([this, query, callback]() {
-            auto results = Search(query);
-            for (const auto& result : results) {
-                if (impl_->cancelSearch_) break;
-                callback(result);
-            }
-        }).detach();
+        Impl* impl = impl_.get();
+        core::TaskHandle task = core::TaskScheduler::Get().Submit(
+            [impl, query, callback](const core::CancellationToken&) {
+                impl->RunSearch(query, callback);
+            });
+
+        std::lock_guard<std::mutex> lock(impl->searchTasksMutex_);
+        auto& tasks = impl->searchTasks_;
+        tasks.erase(std::remove_if(tasks.begin(), tasks.end(),
+                                   [](const core::TaskHandle& t) { return t.IsDone(); }),
+                    tasks.end());
+        tasks.push_back(std::move(task));
     }
 
     void SearchIndex::CancelSearch()
@@ -604,55 +1984,98 @@ namespace opacity::search
 
     std::vector<std::filesystem::path> SearchIndex::QuickSearch(const std::string& pattern, int maxResults)
     {
-        std::vector<std::filesystem::path> results;
-        
-        std::string patternLower = pattern;
-        std::transform(patternLower.begin(), patternLower.end(), patternLower.begin(), ::tolower);
+        QuickSearchOptions options;
+        options.maxResults = maxResults;
+
+        // Wildcards need every name tested; plain text goes through the name index
+        if (pattern.find_first_of("*?") == std::string::npos) {
+            return QuickSearch(pattern, options);
+        }
 
+        std::vector<std::filesystem::path> results;
         std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
 
-        for (const auto& [path, entry] : impl_->entries_) {
+        const EntryStore& store = impl_->store_;
+        for (DocId doc = 0; doc < store.DocCount(); ++doc) {
             if (static_cast<int>(results.size()) >= maxResults) break;
+            if (!store.IsLive(doc)) continue;
 
-            std::string filename = entry.filename;
-            std::transform(filename.begin(), filename.end(), filename.begin(), ::tolower);
-
-            if (filename.find(patternLower) != std::string::npos) {
-                results.push_back(entry.path);
+            if (TextScanner::MatchWildcard(store.Filename(doc), pattern, false)) {
+                results.push_back(store.Path(doc));
             }
         }
 
         return results;
     }
 
+    std::vector<std::filesystem::path> SearchIndex::QuickSearch(const std::string& pattern,
+                                                                const QuickSearchOptions& options,
+                                                                NameQueryState* state)
+    {
+        OPACITY_PROFILE_ZONE("SearchIndex::QuickSearch");
+        std::vector<std::filesystem::path> results;
+        if (options.maxResults <= 0) {
+            return results;
+        }
+
+        std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+
+        const EntryStore& store = impl_->store_;
+        auto docs = impl_->nameIndex_.Query(pattern, options.mode, static_cast<size_t>(options.maxResults),
+                                            options.maxDistance, state);
+        results.reserve(docs.size());
+        for (DocId doc : docs) {
+            results.push_back(store.Path(doc));
+        }
+
+        return results;
+    }
+
     bool SearchIndex::IsIndexed(const std::filesystem::path& path) const
     {
         std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-        return impl_->entries_.find(path.string()) != impl_->entries_.end();
+        return impl_->store_.Find(path).has_value();
     }
 
-    std::optional<IndexEntry> SearchIndex::GetEntry(const std::filesystem::path& path) const
+    std::optional<IndexEntry> SearchIndex::GetEntry(const std::filesystem::path& path, bool withContent) const
     {
         std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
         
-        auto it = impl_->entries_.find(path.string());
-        if (it != impl_->entries_.end()) {
-            return it->second;
+        if (auto doc = impl_->store_.Find(path)) {
+            return impl_->store_.Materialize(*doc, withContent);
         }
         return std::nullopt;
     }
 
+    std::vector<DirectorySize> SearchIndex::GetDirectorySizes(const std::filesystem::path& dir) const
+    {
+        const IndexConfig& config = impl_->config_;
+        bool complete = config.includedExtensions.empty() && config.excludedExtensions.empty() &&
+                        config.excludedDirs.empty() && config.indexHiddenFiles;
+        bool covered = std::any_of(config.roots.begin(), config.roots.end(),
+            [&](const std::filesystem::path& root) { return IsWithin(dir, root); });
+        if (!complete || !covered || impl_->indexing_) {
+            return {};
+        }
+
+        std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+        return impl_->store_.DirectorySizesUnder(dir);
+    }
+
     void SearchIndex::ClearIndex()
     {
         std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-        impl_->entries_.clear();
+        impl_->ClearEntriesLocked();
         impl_->stats_ = IndexStats{};
         Logger::Get()->info("SearchIndex: Cleared index");
     }
 
     bool SearchIndex::OptimizeIndex()
     {
-        // No-op for in-memory index
+        // Renumber documents densely and drop tombstoned postings
+        std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+        impl_->CompactLocked();
+        impl_->stats_.indexSizeBytes = impl_->MemoryUsageLocked();
         return true;
     }
 
@@ -668,40 +2091,8 @@ namespace opacity::search
             return false;
         }
 
-        try {
-            std::filesystem::path indexFile = impl_->config_.indexPath / "index.json";
-            
-            json j;
-            j["version"] = 1;
-            j["stats"]["totalFiles"] = impl_->stats_.totalFiles;
-            j["stats"]["indexedFiles"] = impl_->stats_.indexedFiles;
-            
-            std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-            
-            json entries = json::array();
-            for (const auto& [path, entry] : impl_->entries_) {
-                json e;
-                e["path"] = entry.path.string();
-                e["filename"] = entry.filename;
-                e["extension"] = entry.extension;
-                e["size"] = entry.size;
-                e["isDirectory"] = entry.isDirectory;
-                e["contentHash"] = entry.contentHash;
-                // Don't save content - too large
-                entries.push_back(e);
-            }
-            j["entries"] = entries;
-
-            std::ofstream file(indexFile);
-            file << j.dump();
-
-            Logger::Get()->info("SearchIndex: Saved index to {}", indexFile.string());
-            return true;
-        }
-        catch (const std::exception& e) {
-            Logger::Get()->error("SearchIndex: Failed to save index: {}", e.what());
-            return false;
-        }
+        std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+        return impl_->SaveLocked(true);
     }
 
     bool SearchIndex::LoadIndex()
@@ -710,59 +2101,33 @@ namespace opacity::search
             return false;
         }
 
-        try {
-            std::filesystem::path indexFile = impl_->config_.indexPath / "index.json";
-            
-            std::error_code ec;
-            if (!std::filesystem::exists(indexFile, ec)) {
-                return false;
-            }
-
-            std::ifstream file(indexFile);
-            json j = json::parse(file);
-
-            std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
-            impl_->entries_.clear();
-
-            for (const auto& e : j["entries"]) {
-                IndexEntry entry;
-                entry.path = std::filesystem::path(e["path"].get<std::string>());
-                entry.filename = e["filename"].get<std::string>();
-                entry.extension = e["extension"].get<std::string>();
-                entry.size = e["size"].get<uint64_t>();
-                entry.isDirectory = e["isDirectory"].get<bool>();
-                entry.contentHash = e.value("contentHash", 0u);
-                
-                impl_->entries_[entry.path.string()] = std::move(entry);
-            }
+        std::error_code ec;
+        std::filesystem::path indexFile = impl_->config_.indexPath / kIndexFileName;
+        std::filesystem::path legacyFile = impl_->config_.indexPath / kLegacyIndexFileName;
 
-            impl_->stats_.indexedFiles = impl_->entries_.size();
+        std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
 
-            Logger::Get()->info("SearchIndex: Loaded {} entries from index", impl_->entries_.size());
-            return true;
+        if (std::filesystem::exists(indexFile, ec)) {
+            return impl_->LoadBinaryLocked(indexFile);
         }
-        catch (const std::exception& e) {
-            Logger::Get()->error("SearchIndex: Failed to load index: {}", e.what());
-            return false;
+
+        // Migrate indexes written before the binary format existed
+        if (std::filesystem::exists(legacyFile, ec)) {
+            return impl_->ReadJsonLocked(legacyFile);
         }
+        return false;
     }
 
     bool SearchIndex::ExportIndex(const std::filesystem::path& exportPath)
     {
-        auto originalPath = impl_->config_.indexPath;
-        impl_->config_.indexPath = exportPath.parent_path();
-        bool result = SaveIndex();
-        impl_->config_.indexPath = originalPath;
-        return result;
+        std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+        return impl_->WriteJsonLocked(exportPath);
     }
 
     bool SearchIndex::ImportIndex(const std::filesystem::path& importPath)
     {
-        auto originalPath = impl_->config_.indexPath;
-        impl_->config_.indexPath = importPath.parent_path();
-        bool result = LoadIndex();
-        impl_->config_.indexPath = originalPath;
-        return result;
+        std::unique_lock<std::shared_mutex> lock(impl_->entriesMutex_);
+        return impl_->ReadJsonLocked(importPath);
     }
 
     IndexStats SearchIndex::GetStatistics() const
@@ -782,12 +2147,12 @@ namespace opacity::search
         
         std::shared_lock<std::shared_mutex> lock(impl_->entriesMutex_);
         
-        for (const auto& [path, entry] : impl_->entries_) {
+        impl_->store_.ForEach([&](DocId doc) {
             std::error_code ec;
-            if (!std::filesystem::exists(entry.path, ec)) {
+            if (!std::filesystem::exists(impl_->store_.Path(doc), ec)) {
                 missingCount++;
             }
-        }
+        });
 
         Logger::Get()->info("SearchIndex: Verified index, {} missing files", missingCount);
         return missingCount == 0;
@@ -803,6 +2168,18 @@ namespace opacity::search
         impl_->config_ = config;
     }
 
+    void SearchIndex::SetContentExtractor(std::vector<std::string> extensions, ContentExtractor extractor)
+    {
+        for (auto& ext : extensions) {
+            std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+            if (!ext.empty() && ext[0] != '.') {
+                ext.insert(ext.begin(), '.');
+            }
+        }
+        impl_->extractorExtensions_ = std::move(extensions);
+        impl_->extractor_ = std::move(extractor);
+    }
+
     void SearchIndex::AddRoot(const std::filesystem::path& root)
     {
         impl_->config_.roots.push_back(root);
@@ -0,0 +1,371 @@
+#include "opacity/search/TextScanner.h"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define OPACITY_TEXTSCANNER_X86 1
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX2 code inside functions that ask for it; MSVC
+// accepts the intrinsics anywhere.
+#if defined(OPACITY_TEXTSCANNER_X86) && (defined(__GNUC__) || defined(__clang__))
+#define OPACITY_TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define OPACITY_TARGET_AVX2
+#endif
+
+namespace opacity::search
+{
+    namespace
+    {
+        constexpr std::array<uint8_t, 256> MakeFoldTable()
+        {
+            std::array<uint8_t, 256> table{};
+            for (int c = 0; c < 256; ++c) {
+                table[c] = static_cast<uint8_t>((c >= 'A' && c <= 'Z') ? c | 0x20 : c);
+            }
+            return table;
+        }
+
+        constexpr std::array<uint8_t, 256> kFold = MakeFoldTable();
+
+        inline uint8_t Fold(char c)
+        {
+            return kFold[static_cast<uint8_t>(c)];
+        }
+
+        inline bool IsAsciiLetter(char c)
+        {
+            uint8_t folded = Fold(c);
+            return folded >= 'a' && folded <= 'z';
+        }
+
+        bool EqualFolded(const char* a, const char* b, size_t length)
+        {
+            for (size_t i = 0; i < length; ++i) {
+                if (kFold[static_cast<uint8_t>(a[i])] != kFold[static_cast<uint8_t>(b[i])]) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        inline bool EqualAt(const char* text, std::string_view needle, bool caseSensitive)
+        {
+            return caseSensitive ? std::memcmp(text, needle.data(), needle.size()) == 0
+                                 : EqualFolded(text, needle.data(), needle.size());
+        }
+
+        /**
+         * @brief How a needle byte is tested against haystack bytes
+         *
+         * For a letter in a case-insensitive search, (c | 0x20) == lower
+         * holds exactly for the letter's two cases, so one OR folds the
+         * comparison. Every other byte compares as-is.
+         */
+        struct ByteProbe
+        {
+            uint8_t mask = 0;
+            uint8_t value = 0;
+
+            ByteProbe(char c, bool caseSensitive)
+            {
+                if (!caseSensitive && IsAsciiLetter(c)) {
+                    mask = 0x20;
+                    value = Fold(c);
+                } else {
+                    value = static_cast<uint8_t>(c);
+                }
+            }
+        };
+
+        inline unsigned TrailingZeros(uint32_t bits)
+        {
+#ifdef _MSC_VER
+            unsigned long index;
+            _BitScanForward(&index, bits);
+            return static_cast<unsigned>(index);
+#else
+            return static_cast<unsigned>(__builtin_ctz(bits));
+#endif
+        }
+
+        // The probes sit on the first and last needle bytes; pairs of bytes
+        // are rare enough that verification seldom runs on ordinary text.
+
+        size_t FindScalar(std::string_view text, std::string_view needle, bool caseSensitive, size_t from)
+        {
+            if (caseSensitive) {
+                return text.find(needle, from);     // memchr-driven in every standard library
+            }
+
+            const size_t last = text.size() - needle.size();
+            const uint8_t first = Fold(needle[0]);
+            for (size_t i = from; i <= last; ++i) {
+                if (Fold(text[i]) == first && EqualFolded(text.data() + i, needle.data(), needle.size())) {
+                    return i;
+                }
+            }
+            return std::string_view::npos;
+        }
+
+#ifdef OPACITY_TEXTSCANNER_X86
+        size_t FindSse2(std::string_view text, std::string_view needle, bool caseSensitive, size_t from)
+        {
+            const size_t tail = needle.size() - 1;
+            const ByteProbe head(needle[0], caseSensitive);
+            const ByteProbe end(needle[tail], caseSensitive);
+
+            const __m128i headMask = _mm_set1_epi8(static_cast<char>(head.mask));
+            const __m128i headValue = _mm_set1_epi8(static_cast<char>(head.value));
+            const __m128i endMask = _mm_set1_epi8(static_cast<char>(end.mask));
+            const __m128i endValue = _mm_set1_epi8(static_cast<char>(end.value));
+
+            const char* data = text.data();
+            size_t i = from;
+            while (i + tail + 16 <= text.size()) {
+                __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+                __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + tail));
+                __m128i hit = _mm_and_si128(
+                    _mm_cmpeq_epi8(_mm_or_si128(a, headMask), headValue),
+                    _mm_cmpeq_epi8(_mm_or_si128(b, endMask), endValue));
+
+                uint32_t bits = static_cast<uint32_t>(_mm_movemask_epi8(hit));
+                while (bits) {
+                    size_t candidate = i + TrailingZeros(bits);
+                    if (EqualAt(data + candidate, needle, caseSensitive)) {
+                        return candidate;
+                    }
+                    bits &= bits - 1;
+                }
+                i += 16;
+            }
+
+            return i + needle.size() <= text.size() ? FindScalar(text, needle, caseSensitive, i)
+                                                    : std::string_view::npos;
+        }
+
+        OPACITY_TARGET_AVX2
+        size_t FindAvx2(std::string_view text, std::string_view needle, bool caseSensitive, size_t from)
+        {
+            const size_t tail = needle.size() - 1;
+            const ByteProbe head(needle[0], caseSensitive);
+            const ByteProbe end(needle[tail], caseSensitive);
+
+            const __m256i headMask = _mm256_set1_epi8(static_cast<char>(head.mask));
+            const __m256i headValue = _mm256_set1_epi8(static_cast<char>(head.value));
+            const __m256i endMask = _mm256_set1_epi8(static_cast<char>(end.mask));
+            const __m256i endValue = _mm256_set1_epi8(static_cast<char>(end.value));
+
+            const char* data = text.data();
+            size_t i = from;
+            while (i + tail + 32 <= text.size()) {
+                __m256i a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i));
+                __m256i b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + i + tail));
+                __m256i hit = _mm256_and_si256(
+                    _mm256_cmpeq_epi8(_mm256_or_si256(a, headMask), headValue),
+                    _mm256_cmpeq_epi8(_mm256_or_si256(b, endMask), endValue));
+
+                uint32_t bits = static_cast<uint32_t>(_mm256_movemask_epi8(hit));
+                while (bits) {
+                    size_t candidate = i + TrailingZeros(bits);
+                    if (EqualAt(data + candidate, needle, caseSensitive)) {
+                        return candidate;
+                    }
+                    bits &= bits - 1;
+                }
+                i += 32;
+            }
+
+            return i + needle.size() <= text.size() ? FindSse2(text, needle, caseSensitive, i)
+                                                    : std::string_view::npos;
+        }
+
+        bool CpuHasAvx2()
+        {
+#ifdef _MSC_VER
+            int info[4];
+            __cpuid(info, 0);
+            if (info[0] < 7) return false;
+
+            // AVX2 needs both the instructions and OS support for YMM state
+            __cpuid(info, 1);
+            bool osxsave = (info[2] & (1 << 27)) != 0;
+            bool avx = (info[2] & (1 << 28)) != 0;
+            if (!osxsave || !avx) return false;
+            if ((_xgetbv(0) & 0x6) != 0x6) return false;
+
+            __cpuidex(info, 7, 0);
+            return (info[1] & (1 << 5)) != 0;
+#else
+            return __builtin_cpu_supports("avx2") != 0;
+#endif
+        }
+#endif
+
+        TextScanner::SimdLevel DetectLevel()
+        {
+#ifdef OPACITY_TEXTSCANNER_X86
+            return CpuHasAvx2() ? TextScanner::SimdLevel::Avx2 : TextScanner::SimdLevel::Sse2;
+#else
+            return TextScanner::SimdLevel::Scalar;
+#endif
+        }
+
+        // ============== Wildcards ==============
+
+        bool SegmentMatchesAt(const char* text, std::string_view segment, bool caseSensitive)
+        {
+            for (size_t i = 0; i < segment.size(); ++i) {
+                if (segment[i] == '?') continue;
+                if (caseSensitive ? text[i] != segment[i] : Fold(text[i]) != Fold(segment[i])) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        /**
+         * @brief Leftmost occurrence of a star-free segment (which may hold ?)
+         *
+         * The longest ?-free run anchors the vector search and the rest of
+         * the segment is checked around each hit.
+         */
+        size_t FindSegment(std::string_view text, std::string_view segment, bool caseSensitive, size_t from)
+        {
+            if (segment.size() > text.size() || from > text.size() - segment.size()) {
+                return std::string_view::npos;
+            }
+
+            size_t anchorStart = 0;
+            size_t anchorLength = 0;
+            for (size_t i = 0; i < segment.size();) {
+                if (segment[i] == '?') {
+                    ++i;
+                    continue;
+                }
+                size_t j = i;
+                while (j < segment.size() && segment[j] != '?') ++j;
+                if (j - i > anchorLength) {
+                    anchorStart = i;
+                    anchorLength = j - i;
+                }
+                i = j;
+            }
+
+            if (anchorLength == 0) {
+                return from;    // All ?: anything long enough matches
+            }
+            if (anchorLength == segment.size()) {
+                return TextScanner::Find(text, segment, caseSensitive, from);
+            }
+
+            std::string_view anchor = segment.substr(anchorStart, anchorLength);
+            const size_t last = text.size() - segment.size();
+            size_t pos = from + anchorStart;
+            for (;;) {
+                pos = TextScanner::Find(text, anchor, caseSensitive, pos);
+                if (pos == std::string_view::npos || pos - anchorStart > last) {
+                    return std::string_view::npos;
+                }
+                size_t start = pos - anchorStart;
+                if (SegmentMatchesAt(text.data() + start, segment, caseSensitive)) {
+                    return start;
+                }
+                ++pos;
+            }
+        }
+    }
+
+    TextScanner::SimdLevel TextScanner::ActiveLevel()
+    {
+        static const SimdLevel level = DetectLevel();
+        return level;
+    }
+
+    size_t TextScanner::Find(std::string_view text, std::string_view needle,
+                             bool caseSensitive, size_t from)
+    {
+        if (needle.empty()) {
+            return from <= text.size() ? from : std::string_view::npos;
+        }
+        if (needle.size() > text.size() || from > text.size() - needle.size()) {
+            return std::string_view::npos;
+        }
+
+        switch (ActiveLevel()) {
+#ifdef OPACITY_TEXTSCANNER_X86
+        case SimdLevel::Avx2:
+            return FindAvx2(text, needle, caseSensitive, from);
+        case SimdLevel::Sse2:
+            return FindSse2(text, needle, caseSensitive, from);
+#endif
+        default:
+            return FindScalar(text, needle, caseSensitive, from);
+        }
+    }
+
+    size_t TextScanner::Count(std::string_view text, std::string_view needle,
+                              bool caseSensitive, size_t limit)
+    {
+        if (needle.empty()) return 0;
+
+        size_t count = 0;
+        size_t pos = 0;
+        while ((pos = Find(text, needle, caseSensitive, pos)) != std::string_view::npos) {
+            ++count;
+            if (limit != 0 && count >= limit) break;
+            pos += needle.size();
+        }
+        return count;
+    }
+
+    bool TextScanner::Equals(std::string_view a, std::string_view b, bool caseSensitive)
+    {
+        if (a.size() != b.size()) return false;
+        if (caseSensitive) return a == b;
+        return EqualFolded(a.data(), b.data(), a.size());
+    }
+
+    bool TextScanner::MatchWildcard(std::string_view text, std::string_view pattern, bool caseSensitive)
+    {
+        size_t firstStar = pattern.find('*');
+        if (firstStar == std::string_view::npos) {
+            return text.size() == pattern.size() && SegmentMatchesAt(text.data(), pattern, caseSensitive);
+        }
+
+        // Anchored ends: what precedes the first star and follows the last
+        std::string_view prefix = pattern.substr(0, firstStar);
+        size_t lastStar = pattern.rfind('*');
+        std::string_view suffix = pattern.substr(lastStar + 1);
+
+        if (prefix.size() + suffix.size() > text.size()) return false;
+        if (!SegmentMatchesAt(text.data(), prefix, caseSensitive)) return false;
+        if (!SegmentMatchesAt(text.data() + text.size() - suffix.size(), suffix, caseSensitive)) return false;
+
+        // Middle segments, leftmost-first, without running into the suffix;
+        // taking the earliest match never rules out a later one
+        std::string_view middle = text.substr(prefix.size(), text.size() - prefix.size() - suffix.size());
+        size_t pos = 0;
+        size_t start = firstStar + 1;
+        while (start < lastStar) {
+            size_t next = pattern.find('*', start);
+            std::string_view segment = pattern.substr(start, next - start);
+            start = next + 1;
+            if (segment.empty()) continue;
+
+            size_t hit = FindSegment(middle, segment, caseSensitive, pos);
+            if (hit == std::string_view::npos) return false;
+            pos = hit + segment.size();
+        }
+
+        return true;
+    }
+
+} // namespace opacity::search
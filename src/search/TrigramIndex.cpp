@@ -0,0 +1,265 @@
+#include "opacity/search/TrigramIndex.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace opacity::search
+{
+    static inline uint8_t FoldByte(char c)
+    {
+        auto b = static_cast<uint8_t>(c);
+        return (b >= 'A' && b <= 'Z') ? static_cast<uint8_t>(b + ('a' - 'A')) : b;
+    }
+
+    std::vector<uint32_t> TrigramIndex::ExtractTrigrams(std::string_view text)
+    {
+        std::vector<uint32_t> trigrams;
+        if (text.size() < 3) {
+            return trigrams;
+        }
+
+        trigrams.reserve(text.size() - 2);
+        uint32_t window = (static_cast<uint32_t>(FoldByte(text[0])) << 8) | FoldByte(text[1]);
+        for (size_t i = 2; i < text.size(); ++i) {
+            window = ((window << 8) | FoldByte(text[i])) & 0xFFFFFFu;
+            trigrams.push_back(window);
+        }
+
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+        return trigrams;
+    }
+
+    void TrigramIndex::Add(DocId doc, std::string_view text)
+    {
+        for (uint32_t trigram : ExtractTrigrams(text)) {
+            auto& docs = postings_[trigram];
+            if (docs.empty() || docs.back() < doc) {
+                docs.push_back(doc);
+            } else if (!std::binary_search(docs.begin(), docs.end(), doc)) {
+                docs.insert(std::lower_bound(docs.begin(), docs.end(), doc), doc);
+            }
+        }
+
+        if (IsRemoved(doc)) {
+            removed_[doc] = false;
+            --removedCount_;
+        }
+    }
+
+    void TrigramIndex::Remove(DocId doc)
+    {
+        if (doc >= removed_.size()) {
+            removed_.resize(static_cast<size_t>(doc) + 1, false);
+        }
+        if (!removed_[doc]) {
+            removed_[doc] = true;
+            ++removedCount_;
+        }
+    }
+
+    const TrigramIndex::SegmentSlot* TrigramIndex::FindSlot(uint32_t trigram) const
+    {
+        if (!slots_) {
+            return nullptr;
+        }
+        const SegmentSlot* end = slots_ + slotCount_;
+        const SegmentSlot* it = std::lower_bound(slots_, end, trigram,
+            [](const SegmentSlot& slot, uint32_t value) { return slot.trigram < value; });
+        return (it != end && it->trigram == trigram) ? it : nullptr;
+    }
+
+    std::vector<DocId> TrigramIndex::Postings(uint32_t trigram) const
+    {
+        std::vector<DocId> docs;
+        if (const SegmentSlot* slot = FindSlot(trigram)) {
+            docs.assign(segmentDocs_ + slot->offset, segmentDocs_ + slot->offset + slot->count);
+        }
+
+        auto it = postings_.find(trigram);
+        if (it != postings_.end()) {
+            if (docs.empty() || it->second.empty() || docs.back() < it->second.front()) {
+                docs.insert(docs.end(), it->second.begin(), it->second.end());
+            } else {
+                docs = Union(docs, it->second);
+            }
+        }
+        return docs;
+    }
+
+    std::optional<std::vector<DocId>> TrigramIndex::Candidates(std::string_view query) const
+    {
+        auto trigrams = ExtractTrigrams(query);
+        if (trigrams.empty()) {
+            return std::nullopt;
+        }
+
+        // Intersect smallest posting lists first so the working set shrinks fast
+        std::vector<std::pair<size_t, uint32_t>> bySize;
+        bySize.reserve(trigrams.size());
+        for (uint32_t trigram : trigrams) {
+            size_t count = 0;
+            if (const SegmentSlot* slot = FindSlot(trigram)) {
+                count += slot->count;
+            }
+            auto it = postings_.find(trigram);
+            if (it != postings_.end()) {
+                count += it->second.size();
+            }
+            if (count == 0) {
+                return std::vector<DocId>{};
+            }
+            bySize.emplace_back(count, trigram);
+        }
+        std::sort(bySize.begin(), bySize.end());
+
+        std::vector<DocId> result = Postings(bySize.front().second);
+        for (size_t i = 1; i < bySize.size() && !result.empty(); ++i) {
+            result = Intersect(result, Postings(bySize[i].second));
+        }
+
+        if (removedCount_ > 0) {
+            result.erase(std::remove_if(result.begin(), result.end(),
+                [this](DocId doc) { return IsRemoved(doc); }), result.end());
+        }
+        return result;
+    }
+
+    void TrigramIndex::Compact()
+    {
+        if (removedCount_ == 0) {
+            return;
+        }
+
+        // The attached segment is immutable; its tombstones stay until Clear()
+        for (auto it = postings_.begin(); it != postings_.end();) {
+            auto& docs = it->second;
+            docs.erase(std::remove_if(docs.begin(), docs.end(),
+                [this](DocId doc) { return IsRemoved(doc); }), docs.end());
+            if (docs.empty()) {
+                it = postings_.erase(it);
+            } else {
+                docs.shrink_to_fit();
+                ++it;
+            }
+        }
+
+        if (!slots_) {
+            removed_.clear();
+            removedCount_ = 0;
+        }
+    }
+
+    void TrigramIndex::Serialize(const std::vector<DocId>& remap, std::string& out) const
+    {
+        std::vector<uint32_t> trigrams;
+        trigrams.reserve(slotCount_ + postings_.size());
+        for (uint32_t i = 0; i < slotCount_; ++i) {
+            trigrams.push_back(slots_[i].trigram);
+        }
+        for (const auto& [trigram, docs] : postings_) {
+            trigrams.push_back(trigram);
+        }
+        std::sort(trigrams.begin(), trigrams.end());
+        trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+        std::vector<SegmentSlot> slots;
+        std::vector<DocId> allDocs;
+        slots.reserve(trigrams.size());
+        for (uint32_t trigram : trigrams) {
+            SegmentSlot slot{trigram, 0, allDocs.size()};
+            for (DocId doc : Postings(trigram)) {
+                if (doc >= remap.size() || remap[doc] == kNoDoc || IsRemoved(doc)) continue;
+                allDocs.push_back(remap[doc]);
+                slot.count++;
+            }
+            if (slot.count > 0) {
+                slots.push_back(slot);
+            }
+        }
+
+        SegmentHeader header{{'T', 'R', 'G', 'M'}, static_cast<uint32_t>(slots.size())};
+        size_t start = out.size();
+        out.resize(start + sizeof(header) + slots.size() * sizeof(SegmentSlot) + allDocs.size() * sizeof(DocId));
+        char* dst = out.data() + start;
+        std::memcpy(dst, &header, sizeof(header));
+        dst += sizeof(header);
+        if (!slots.empty()) {
+            std::memcpy(dst, slots.data(), slots.size() * sizeof(SegmentSlot));
+            dst += slots.size() * sizeof(SegmentSlot);
+        }
+        if (!allDocs.empty()) {
+            std::memcpy(dst, allDocs.data(), allDocs.size() * sizeof(DocId));
+        }
+    }
+
+    bool TrigramIndex::AttachSegment(std::string_view segment)
+    {
+        Clear();
+
+        if (segment.size() < sizeof(SegmentHeader)) {
+            return false;
+        }
+
+        SegmentHeader header;
+        std::memcpy(&header, segment.data(), sizeof(header));
+        if (std::memcmp(header.magic, "TRGM", 4) != 0) {
+            return false;
+        }
+
+        size_t slotBytes = static_cast<size_t>(header.trigramCount) * sizeof(SegmentSlot);
+        if (segment.size() - sizeof(header) < slotBytes) {
+            return false;
+        }
+
+        auto* slots = reinterpret_cast<const SegmentSlot*>(segment.data() + sizeof(header));
+        size_t docCount = (segment.size() - sizeof(header) - slotBytes) / sizeof(DocId);
+        for (uint32_t i = 0; i < header.trigramCount; ++i) {
+            if (slots[i].offset > docCount || slots[i].count > docCount - slots[i].offset) {
+                return false;
+            }
+        }
+
+        slots_ = slots;
+        slotCount_ = header.trigramCount;
+        segmentDocs_ = reinterpret_cast<const DocId*>(segment.data() + sizeof(header) + slotBytes);
+        return true;
+    }
+
+    void TrigramIndex::Clear()
+    {
+        slots_ = nullptr;
+        segmentDocs_ = nullptr;
+        slotCount_ = 0;
+        postings_.clear();
+        removed_.clear();
+        removedCount_ = 0;
+    }
+
+    size_t TrigramIndex::MemoryUsage() const
+    {
+        size_t bytes = postings_.bucket_count() * sizeof(void*);
+        for (const auto& [trigram, docs] : postings_) {
+            bytes += sizeof(trigram) + sizeof(docs) + docs.capacity() * sizeof(DocId);
+        }
+        return bytes + removed_.size() / 8;
+    }
+
+    std::vector<DocId> TrigramIndex::Intersect(const std::vector<DocId>& a, const std::vector<DocId>& b)
+    {
+        std::vector<DocId> out;
+        out.reserve(std::min(a.size(), b.size()));
+        std::set_intersection(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+        return out;
+    }
+
+    std::vector<DocId> TrigramIndex::Union(const std::vector<DocId>& a, const std::vector<DocId>& b)
+    {
+        std::vector<DocId> out;
+        out.reserve(a.size() + b.size());
+        std::set_union(a.begin(), a.end(), b.begin(), b.end(), std::back_inserter(out));
+        return out;
+    }
+
+} // namespace opacity::search
@@ -0,0 +1,297 @@
+#include "opacity/search/UsnJournal.h"
+#include "opacity/core/Logger.h"
+
+#include <algorithm>
+#include <unordered_map>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <winioctl.h>
+#endif
+
+namespace opacity::search
+{
+    using namespace opacity::core;
+
+#ifdef _WIN32
+    namespace
+    {
+        constexpr DWORD kReasonMask =
+            USN_REASON_FILE_CREATE | USN_REASON_FILE_DELETE |
+            USN_REASON_DATA_OVERWRITE | USN_REASON_DATA_EXTEND | USN_REASON_DATA_TRUNCATION |
+            USN_REASON_RENAME_OLD_NAME | USN_REASON_RENAME_NEW_NAME |
+            USN_REASON_BASIC_INFO_CHANGE | USN_REASON_CLOSE;
+
+        constexpr DWORD kReadBufferSize = 64 * 1024;
+
+        std::wstring Widen(const std::string& text)
+        {
+            return std::filesystem::path(text).wstring();
+        }
+
+        // "C:\" -> "\\.\C:"
+        HANDLE OpenVolume(const std::string& volume)
+        {
+            std::wstring device = Widen(volume);
+            while (!device.empty() && (device.back() == L'\\' || device.back() == L'/')) {
+                device.pop_back();
+            }
+            device = L"\\\\.\\" + device;
+
+            return CreateFileW(device.c_str(), GENERIC_READ,
+                FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                nullptr, OPEN_EXISTING, 0, nullptr);
+        }
+
+        std::optional<USN_JOURNAL_DATA_V0> QueryJournal(HANDLE volume)
+        {
+            USN_JOURNAL_DATA_V0 data{};
+            DWORD bytes = 0;
+            if (!DeviceIoControl(volume, FSCTL_QUERY_USN_JOURNAL, nullptr, 0,
+                                 &data, sizeof(data), &bytes, nullptr)) {
+                return std::nullopt;
+            }
+            return data;
+        }
+
+        /**
+         * @brief Resolves directory file reference numbers to paths
+         */
+        class ParentResolver
+        {
+        public:
+            explicit ParentResolver(HANDLE volume) : volume_(volume) {}
+
+            std::optional<std::filesystem::path> Resolve(DWORDLONG frn)
+            {
+                auto it = cache_.find(frn);
+                if (it != cache_.end()) {
+                    return it->second;
+                }
+
+                FILE_ID_DESCRIPTOR id{};
+                id.dwSize = sizeof(id);
+                id.Type = FileIdType;
+                id.FileId.QuadPart = static_cast<LONGLONG>(frn);
+
+                HANDLE dir = OpenFileById(volume_, &id, 0,
+                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+                    nullptr, FILE_FLAG_BACKUP_SEMANTICS);
+                if (dir == INVALID_HANDLE_VALUE) {
+                    cache_.emplace(frn, std::nullopt);
+                    return std::nullopt;
+                }
+
+                std::wstring buffer(MAX_PATH, L'\0');
+                DWORD length = GetFinalPathNameByHandleW(dir, buffer.data(),
+                    static_cast<DWORD>(buffer.size()), FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+                if (length >= buffer.size()) {
+                    buffer.resize(length + 1);
+                    length = GetFinalPathNameByHandleW(dir, buffer.data(),
+                        static_cast<DWORD>(buffer.size()), FILE_NAME_NORMALIZED | VOLUME_NAME_DOS);
+                }
+                CloseHandle(dir);
+
+                if (length == 0 || length >= buffer.size()) {
+                    cache_.emplace(frn, std::nullopt);
+                    return std::nullopt;
+                }
+                buffer.resize(length);
+
+                // Strip the \\?\ prefix so paths match the crawler's spelling
+                if (buffer.rfind(L"\\\\?\\UNC\\", 0) == 0) {
+                    buffer = L"\\\\" + buffer.substr(8);
+                } else if (buffer.rfind(L"\\\\?\\", 0) == 0) {
+                    buffer = buffer.substr(4);
+                }
+
+                std::filesystem::path path(buffer);
+                cache_.emplace(frn, path);
+                return path;
+            }
+
+        private:
+            HANDLE volume_;
+            std::unordered_map<DWORDLONG, std::optional<std::filesystem::path>> cache_;
+        };
+    }
+#endif
+
+    std::optional<std::string> UsnJournal::VolumeOf(const std::filesystem::path& path)
+    {
+#ifdef _WIN32
+        wchar_t volume[MAX_PATH] = {};
+        if (!GetVolumePathNameW(path.wstring().c_str(), volume, MAX_PATH)) {
+            return std::nullopt;
+        }
+        return std::filesystem::path(volume).string();
+#else
+        (void)path;
+        return std::nullopt;
+#endif
+    }
+
+    bool UsnJournal::IsSupported(const std::filesystem::path& root)
+    {
+#ifdef _WIN32
+        auto volume = VolumeOf(root);
+        if (!volume) {
+            return false;
+        }
+
+        std::wstring wideVolume = Widen(*volume);
+        UINT driveType = GetDriveTypeW(wideVolume.c_str());
+        if (driveType != DRIVE_FIXED && driveType != DRIVE_REMOVABLE) {
+            return false;
+        }
+
+        wchar_t fsName[MAX_PATH] = {};
+        if (!GetVolumeInformationW(wideVolume.c_str(), nullptr, 0, nullptr, nullptr,
+                                   nullptr, fsName, MAX_PATH)) {
+            return false;
+        }
+        return std::wstring(fsName) == L"NTFS";
+#else
+        (void)root;
+        return false;
+#endif
+    }
+
+    std::optional<UsnCursor> UsnJournal::QueryCursor(const std::string& volume)
+    {
+#ifdef _WIN32
+        HANDLE handle = OpenVolume(volume);
+        if (handle == INVALID_HANDLE_VALUE) {
+            Logger::Get()->debug("UsnJournal: Cannot open volume {} (error {})", volume, GetLastError());
+            return std::nullopt;
+        }
+
+        auto data = QueryJournal(handle);
+        CloseHandle(handle);
+        if (!data) {
+            return std::nullopt;
+        }
+
+        UsnCursor cursor;
+        cursor.volume = volume;
+        cursor.journalId = data->UsnJournalID;
+        cursor.nextUsn = data->NextUsn;
+        return cursor;
+#else
+        (void)volume;
+        return std::nullopt;
+#endif
+    }
+
+    std::optional<std::vector<UsnChange>> UsnJournal::ReadChanges(UsnCursor& cursor)
+    {
+#ifdef _WIN32
+        HANDLE handle = OpenVolume(cursor.volume);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return std::nullopt;
+        }
+
+        // The journal was recreated or our position has been truncated away
+        auto data = QueryJournal(handle);
+        if (!data || data->UsnJournalID != cursor.journalId ||
+            cursor.nextUsn < data->FirstUsn || cursor.nextUsn > data->NextUsn)
+        {
+            CloseHandle(handle);
+            return std::nullopt;
+        }
+
+        READ_USN_JOURNAL_DATA_V0 read{};
+        read.StartUsn = cursor.nextUsn;
+        read.ReasonMask = kReasonMask;
+        read.ReturnOnlyOnClose = FALSE;
+        read.Timeout = 0;
+        read.BytesToWaitFor = 0;
+        read.UsnJournalID = cursor.journalId;
+
+        std::vector<UsnChange> changes;
+        std::unordered_map<std::wstring, size_t> latest;    // path -> index in changes
+        ParentResolver resolver(handle);
+        std::vector<BYTE> buffer(kReadBufferSize);
+        bool ok = true;
+
+        auto record = [&](UsnChange::Kind kind, const USN_RECORD_V2* usn) {
+            auto parent = resolver.Resolve(usn->ParentFileReferenceNumber);
+            if (!parent) return;    // Outside anything we can name; ignore
+
+            std::wstring name(reinterpret_cast<const wchar_t*>(
+                reinterpret_cast<const BYTE*>(usn) + usn->FileNameOffset),
+                usn->FileNameLength / sizeof(wchar_t));
+
+            UsnChange change;
+            change.kind = kind;
+            change.path = *parent / name;
+            change.isDirectory = (usn->FileAttributes & FILE_ATTRIBUTE_DIRECTORY) != 0;
+
+            // Keep only the last change per path, in journal order
+            std::wstring key = change.path.wstring();
+            auto it = latest.find(key);
+            if (it != latest.end()) {
+                changes[it->second].path.clear();
+            }
+            latest[key] = changes.size();
+            changes.push_back(std::move(change));
+        };
+
+        for (;;) {
+            DWORD bytes = 0;
+            if (!DeviceIoControl(handle, FSCTL_READ_USN_JOURNAL, &read, sizeof(read),
+                                 buffer.data(), static_cast<DWORD>(buffer.size()), &bytes, nullptr))
+            {
+                OPACITY_LOG_DEBUG(Search, "UsnJournal: Read failed on {} (error {})", cursor.volume, GetLastError());
+                ok = false;
+                break;
+            }
+            if (bytes <= sizeof(USN)) {
+                break;  // Caught up
+            }
+
+            USN next = *reinterpret_cast<const USN*>(buffer.data());
+            DWORD offset = sizeof(USN);
+            while (offset < bytes) {
+                auto* usn = reinterpret_cast<const USN_RECORD_V2*>(buffer.data() + offset);
+                if (usn->RecordLength == 0) break;
+
+                if (usn->MajorVersion == 2) {
+                    DWORD reason = usn->Reason;
+                    if (reason & USN_REASON_RENAME_OLD_NAME) {
+                        record(UsnChange::Kind::Removed, usn);
+                    } else if (reason & USN_REASON_CLOSE) {
+                        if (reason & USN_REASON_FILE_DELETE) {
+                            record(UsnChange::Kind::Removed, usn);
+                        } else if (reason & (USN_REASON_FILE_CREATE | USN_REASON_RENAME_NEW_NAME)) {
+                            record(UsnChange::Kind::Added, usn);
+                        } else {
+                            record(UsnChange::Kind::Modified, usn);
+                        }
+                    }
+                }
+                offset += usn->RecordLength;
+            }
+
+            read.StartUsn = next;
+        }
+
+        CloseHandle(handle);
+        if (!ok) {
+            return std::nullopt;
+        }
+
+        cursor.nextUsn = read.StartUsn;
+
+        changes.erase(std::remove_if(changes.begin(), changes.end(),
+            [](const UsnChange& change) { return change.path.empty(); }), changes.end());
+        return changes;
+#else
+        (void)cursor;
+        return std::nullopt;
+#endif
+    }
+
+} // namespace opacity::search
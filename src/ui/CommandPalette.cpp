@@ -2,20 +2,73 @@
 #include "opacity/core/Logger.h"
 
 #include <algorithm>
-#include <cctype>
+#include <atomic>
+#include <mutex>
 #include <set>
+#include <thread>
 
 #include "imgui.h"
 #include "opacity/ui/ImGuiScoped.h"
 
 namespace opacity::ui
 {
+    // Shared with its thread, which may outlive the palette
+    struct CommandPalette::MatchJob
+    {
+        std::string query;                      // Lowercased
+        std::atomic<bool> cancel{false};
+
+        std::mutex mutex;
+        bool done = false;
+        std::vector<FuzzyMatcher::Hit> hits;    // Every match; the best first
+    };
+
+    // Shared with the async providers' threads for one query
+    struct CommandPalette::StreamJob
+    {
+        std::atomic<bool> cancel{false};
+
+        std::mutex mutex;
+        size_t running = 0;                     // Providers still searching
+        std::vector<PaletteCommand> items;      // Emitted since last polled
+    };
+
+    namespace
+    {
+        // Matches among candidates, with the best count sorted to the front
+        bool RankEntries(const FuzzyMatcher& matcher, const std::string& query,
+                         const std::vector<uint32_t>& candidates, const std::unordered_map<uint32_t, int>& boosts,
+                         size_t count, std::vector<FuzzyMatcher::Hit>& hits, const std::atomic<bool>* cancel)
+        {
+            if (!matcher.Filter(query, candidates, hits, cancel))
+                return false;
+
+            if (!boosts.empty())
+            {
+                for (auto& hit : hits)
+                {
+                    auto it = boosts.find(hit.entry);
+                    if (it != boosts.end())
+                        hit.score += it->second;
+                }
+            }
+            FuzzyMatcher::SelectTop(hits, count == 0 ? hits.size() : count);
+            return true;
+        }
+    }
+
     CommandPalette::CommandPalette() = default;
-    CommandPalette::~CommandPalette() = default;
+
+    CommandPalette::~CommandPalette()
+    {
+        CancelMatch();
+        CancelStream();
+    }
 
     void CommandPalette::RegisterCommand(const PaletteCommand& command)
     {
         commands_[command.id] = command;
+        ResetMatching();
         SPDLOG_DEBUG("Registered command: {}", command.id);
     }
 
@@ -27,14 +80,39 @@ namespace opacity::ui
         }
     }
 
+    void CommandPalette::AddProvider(std::shared_ptr<PaletteProvider> provider)
+    {
+        if (!provider)
+            return;
+
+        providers_.push_back(std::move(provider));
+        if (visible_ && providers_.back()->GetTier() == PaletteProvider::Tier::Inline)
+        {
+            CollectProvided();
+            UpdateResults();
+        }
+    }
+
     void CommandPalette::UnregisterCommand(const std::string& id)
     {
+        ResetMatching();
+
+        // Results may point at it
+        inline_results_.clear();
+        ComposeResults(false);
         commands_.erase(id);
+        if (visible_)
+            UpdateResults();
     }
 
     void CommandPalette::ClearCommands()
     {
+        ResetMatching();
+        inline_results_.clear();
+        ComposeResults(false);
         commands_.clear();
+        if (visible_)
+            UpdateResults();
     }
 
     const PaletteCommand* CommandPalette::GetCommand(const std::string& id) const
@@ -129,101 +207,11 @@ namespace opacity::ui
             return results;
         }
 
-        std::string lower_query = query;
-        std::transform(lower_query.begin(), lower_query.end(), lower_query.begin(), ::tolower);
-
-        for (const auto& [id, cmd] : commands_)
-        {
-            if (!cmd.enabled) continue;
-
-            // Filter by category if set
-            if (!category_filter_.empty() && cmd.category != category_filter_)
-            {
-                continue;
-            }
-
-            PaletteMatch match;
-            match.command = &cmd;
-
-            // Calculate score from label
-            std::string lower_label = cmd.label;
-            std::transform(lower_label.begin(), lower_label.end(), lower_label.begin(), ::tolower);
-            match.score = CalculateFuzzyScore(lower_label, lower_query, match.matched_indices);
-
-            // Boost exact prefix matches
-            if (lower_label.find(lower_query) == 0)
-            {
-                match.score += 100;
-            }
-            // Boost word boundary matches
-            else if (lower_label.find(" " + lower_query) != std::string::npos)
-            {
-                match.score += 50;
-            }
-
-            // Check description and keywords for additional matches
-            if (match.score == 0 && !cmd.description.empty())
-            {
-                std::string lower_desc = cmd.description;
-                std::transform(lower_desc.begin(), lower_desc.end(), lower_desc.begin(), ::tolower);
-                std::vector<size_t> desc_indices;
-                int desc_score = CalculateFuzzyScore(lower_desc, lower_query, desc_indices);
-                if (desc_score > 0)
-                {
-                    match.score = desc_score / 2; // Lower weight for description matches
-                }
-            }
-
-            if (match.score == 0 && !cmd.keywords.empty())
-            {
-                for (const auto& keyword : cmd.keywords)
-                {
-                    std::string lower_kw = keyword;
-                    std::transform(lower_kw.begin(), lower_kw.end(), lower_kw.begin(), ::tolower);
-                    if (lower_kw.find(lower_query) != std::string::npos)
-                    {
-                        match.score = 30;
-                        break;
-                    }
-                }
-            }
-
-            // Boost by priority
-            match.score += cmd.priority;
-
-            // Boost recent commands
-            if (boost_recent_)
-            {
-                for (const auto& entry : history_)
-                {
-                    if (entry.command_id == cmd.id)
-                    {
-                        match.score += 20 + entry.use_count;
-                        break;
-                    }
-                }
-            }
-
-            if (match.score > 0)
-            {
-                results.push_back(match);
-            }
-        }
-
-        // Sort by score (descending)
-        std::sort(results.begin(), results.end(),
-            [](const PaletteMatch& a, const PaletteMatch& b)
-            {
-                return a.score > b.score;
-            });
-
-        // Limit results
-        if (max_results > 0 && results.size() > max_results)
-        {
-            results.resize(max_results);
-        }
-
-        return results;
+        EnsureIndex();
+        std::string lower_query = FuzzyMatcher::Lower(query);
+        std::vector<FuzzyMatcher::Hit> hits;
+        RankEntries(*matcher_, lower_query, EligibleEntries(), HistoryBoosts(), max_results, hits, nullptr);
+        return ToMatches(lower_query, hits, max_results == 0 ? hits.size() : max_results);
     }
 
     bool CommandPalette::Execute(const std::string& id)
@@ -242,9 +230,14 @@ namespace opacity::ui
     void CommandPalette::SetCommandEnabled(const std::string& id, bool enabled)
     {
         auto it = commands_.find(id);
-        if (it != commands_.end())
+        if (it != commands_.end() && it->second.enabled != enabled)
         {
             it->second.enabled = enabled;
+
+            // Which commands can match changed; the index itself did not
+            CancelMatch();
+            narrowed_query_.clear();
+            narrowed_hits_.clear();
         }
     }
 
@@ -277,12 +270,14 @@ namespace opacity::ui
         current_query_.clear();
         input_buffer_[0] = '\0';
         selected_index_ = 0;
+        CollectProvided();
         UpdateResults();
     }
 
     void CommandPalette::Hide()
     {
         visible_ = false;
+        CancelStream();
     }
 
     void CommandPalette::Toggle()
@@ -338,11 +333,21 @@ namespace opacity::ui
             selected_index_ >= 0 && 
             selected_index_ < static_cast<int>(current_results_.size()))
         {
-            const auto& match = current_results_[selected_index_];
-            if (match.command)
+            const PaletteCommand* cmd = current_results_[selected_index_].command;
+            if (cmd)
             {
                 Hide();
-                return Execute(match.command->id);
+                if (GetCommand(cmd->id) == cmd)
+                    return Execute(cmd->id);
+
+                // Provided items are not commands and stay out of the history;
+                // the action may reopen the palette, which replaces them
+                if (!cmd->enabled || !cmd->action)
+                    return false;
+                SPDLOG_INFO("Opening: {}", cmd->id);
+                auto action = cmd->action;
+                action();
+                return true;
             }
         }
         return false;
@@ -353,6 +358,8 @@ namespace opacity::ui
         if (category_filter_ != category)
         {
             category_filter_ = category;
+            narrowed_query_.clear();
+            narrowed_hits_.clear();
             UpdateResults();
         }
     }
@@ -364,6 +371,9 @@ namespace opacity::ui
             return false;
         }
 
+        PollMatch();
+        PollStream();
+
         // Center the palette at the top of the screen
         ImGuiIO& io = ImGui::GetIO();
         ImVec2 window_size(500, 400);
@@ -487,7 +497,7 @@ namespace opacity::ui
 
             if (current_results_.empty())
             {
-                ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "No matching commands");
+                ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), stream_job_ ? "Searching..." : "No matching commands");
             }
 
             ImGui::EndChild();
@@ -497,68 +507,6 @@ namespace opacity::ui
         return visible_;
     }
 
-    int CommandPalette::CalculateFuzzyScore(const std::string& text, const std::string& query,
-                                             std::vector<size_t>& matched_indices) const
-    {
-        if (query.empty()) return 0;
-        if (text.empty()) return 0;
-
-        matched_indices.clear();
-        int score = 0;
-        size_t query_idx = 0;
-        size_t prev_match_idx = std::string::npos;
-        bool prev_was_match = false;
-
-        for (size_t i = 0; i < text.size() && query_idx < query.size(); ++i)
-        {
-            if (std::tolower(text[i]) == std::tolower(query[query_idx]))
-            {
-                matched_indices.push_back(i);
-
-                // Base score for match
-                score += 10;
-
-                // Bonus for consecutive matches
-                if (prev_was_match && prev_match_idx + 1 == i)
-                {
-                    score += 15;
-                }
-
-                // Bonus for matching at word boundary
-                if (i == 0 || !std::isalnum(text[i - 1]))
-                {
-                    score += 20;
-                }
-
-                // Bonus for matching uppercase in camelCase
-                if (std::isupper(text[i]))
-                {
-                    score += 5;
-                }
-
-                prev_match_idx = i;
-                prev_was_match = true;
-                ++query_idx;
-            }
-            else
-            {
-                prev_was_match = false;
-            }
-        }
-
-        // Only return score if all query characters matched
-        if (query_idx < query.size())
-        {
-            matched_indices.clear();
-            return 0;
-        }
-
-        // Bonus for shorter strings (more specific matches)
-        score += std::max(0, 50 - static_cast<int>(text.size()));
-
-        return score;
-    }
-
     void CommandPalette::AddToHistory(const std::string& command_id)
     {
         // Check if already in history
@@ -597,8 +545,304 @@ namespace opacity::ui
 
     void CommandPalette::UpdateResults()
     {
-        current_results_ = Search(current_query_, 20);
+        CancelMatch();
+        CancelStream();
+        selected_index_ = 0;
+
+        // Until the inline matches are in, the last ones stay up without
+        // the previous query's streamed results
+        streamed_.clear();
+        ComposeResults(false);
+
+        if (current_query_.empty())
+        {
+            narrowed_query_.clear();
+            narrowed_hits_.clear();
+            inline_results_ = Search(current_query_, kMaxResults);
+            ComposeResults(false);
+            return;
+        }
+
+        StartStream();
+
+        EnsureIndex();
+        std::string lower_query = FuzzyMatcher::Lower(current_query_);
+
+        // Typing on only narrows what already matched
+        std::vector<uint32_t> candidates;
+        if (!narrowed_query_.empty() && lower_query.compare(0, narrowed_query_.size(), narrowed_query_) == 0)
+            candidates = narrowed_hits_;
+        else
+            candidates = EligibleEntries();
+
+        if (candidates.size() < kAsyncCandidates)
+        {
+            std::vector<FuzzyMatcher::Hit> hits;
+            RankEntries(*matcher_, lower_query, candidates, HistoryBoosts(), kMaxResults, hits, nullptr);
+            ApplyHits(lower_query, hits);
+            return;
+        }
+
+        // The thread holds its own references, so it can finish after the
+        // palette is gone or the commands change
+        auto job = std::make_shared<MatchJob>();
+        job->query = lower_query;
+        match_job_ = job;
+        std::thread([job, matcher = matcher_, candidates = std::move(candidates), boosts = HistoryBoosts()]()
+        {
+            std::vector<FuzzyMatcher::Hit> hits;
+            if (!RankEntries(*matcher, job->query, candidates, boosts, kMaxResults, hits, &job->cancel))
+                return;
+
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->hits = std::move(hits);
+            job->done = true;
+        }).detach();
+    }
+
+    void CommandPalette::PollMatch()
+    {
+        if (!match_job_)
+            return;
+
+        std::vector<FuzzyMatcher::Hit> hits;
+        {
+            std::lock_guard<std::mutex> lock(match_job_->mutex);
+            if (!match_job_->done)
+                return;
+            hits = std::move(match_job_->hits);
+        }
+
+        std::string query = std::move(match_job_->query);
+        match_job_.reset();
+        ApplyHits(query, hits);
+    }
+
+    void CommandPalette::CancelMatch()
+    {
+        if (match_job_)
+        {
+            match_job_->cancel.store(true, std::memory_order_relaxed);
+            match_job_.reset();
+        }
+    }
+
+    void CommandPalette::ResetMatching()
+    {
+        CancelMatch();
+        index_dirty_ = true;
+        narrowed_query_.clear();
+        narrowed_hits_.clear();
+    }
+
+    void CommandPalette::ApplyHits(const std::string& lower_query, std::vector<FuzzyMatcher::Hit>& hits)
+    {
+        narrowed_query_ = lower_query;
+        narrowed_hits_.clear();
+        narrowed_hits_.reserve(hits.size());
+        for (const auto& hit : hits)
+            narrowed_hits_.push_back(hit.entry);
+
+        inline_results_ = ToMatches(lower_query, hits, kMaxResults);
         selected_index_ = 0;
+        ComposeResults(false);
+    }
+
+    void CommandPalette::CollectProvided()
+    {
+        // The results and index point into the items being replaced
+        ResetMatching();
+        inline_results_.clear();
+        streamed_.clear();
+        current_results_.clear();
+        selected_index_ = 0;
+
+        provided_.clear();
+        for (const auto& provider : providers_)
+        {
+            if (provider->GetTier() == PaletteProvider::Tier::Inline)
+                provider->Collect(provided_);
+        }
+    }
+
+    void CommandPalette::StartStream()
+    {
+        std::vector<std::shared_ptr<PaletteProvider>> async;
+        for (const auto& provider : providers_)
+        {
+            if (provider->GetTier() == PaletteProvider::Tier::Async)
+                async.push_back(provider);
+        }
+        if (async.empty())
+            return;
+
+        auto job = std::make_shared<StreamJob>();
+        job->running = async.size();
+        stream_job_ = job;
+
+        // Each provider runs on its own, so a slow one holds up no other
+        for (auto& provider : async)
+        {
+            std::thread([job, provider = std::move(provider), query = current_query_]()
+            {
+                if (!job->cancel.load(std::memory_order_relaxed))
+                {
+                    provider->Query(query, kMaxStreamed, job->cancel, [&job](std::vector<PaletteCommand> items)
+                    {
+                        if (items.empty() || job->cancel.load(std::memory_order_relaxed))
+                            return;
+
+                        std::lock_guard<std::mutex> lock(job->mutex);
+                        for (auto& item : items)
+                            job->items.push_back(std::move(item));
+                    });
+                }
+
+                std::lock_guard<std::mutex> lock(job->mutex);
+                --job->running;
+            }).detach();
+        }
+    }
+
+    void CommandPalette::PollStream()
+    {
+        if (!stream_job_)
+            return;
+
+        std::vector<PaletteCommand> items;
+        bool finished;
+        {
+            std::lock_guard<std::mutex> lock(stream_job_->mutex);
+            items.swap(stream_job_->items);
+            finished = stream_job_->running == 0;
+        }
+        if (finished)
+            stream_job_.reset();
+        if (items.empty())
+            return;
+
+        // Appended in arrival order, once each
+        size_t before = streamed_.size();
+        for (auto& item : items)
+        {
+            if (streamed_.size() >= kMaxStreamed)
+                break;
+
+            if (std::none_of(streamed_.begin(), streamed_.end(),
+                             [&](const PaletteCommand& other) { return other.id == item.id; }))
+                streamed_.push_back(std::move(item));
+        }
+
+        if (streamed_.size() != before)
+            ComposeResults(true);
+    }
+
+    void CommandPalette::CancelStream()
+    {
+        if (stream_job_)
+        {
+            stream_job_->cancel.store(true, std::memory_order_relaxed);
+            stream_job_.reset();
+        }
+    }
+
+    void CommandPalette::ComposeResults(bool keep_selection)
+    {
+        const PaletteCommand* selected = nullptr;
+        if (keep_selection && selected_index_ >= 0 && selected_index_ < static_cast<int>(current_results_.size()))
+            selected = current_results_[selected_index_].command;
+
+        // A deque keeps the streamed items where they are as it grows
+        // Anything the inline matches list already is not repeated
+        current_results_ = inline_results_;
+        for (const auto& item : streamed_)
+        {
+            if (!category_filter_.empty() && item.category != category_filter_)
+                continue;
+            if (std::any_of(inline_results_.begin(), inline_results_.end(),
+                            [&](const PaletteMatch& match) { return match.command->id == item.id; }))
+                continue;
+
+            PaletteMatch match;
+            match.command = &item;
+            current_results_.push_back(std::move(match));
+        }
+
+        int index = 0;
+        if (selected)
+        {
+            auto it = std::find_if(current_results_.begin(), current_results_.end(),
+                                   [&](const PaletteMatch& match) { return match.command == selected; });
+            if (it != current_results_.end())
+                index = static_cast<int>(it - current_results_.begin());
+        }
+        selected_index_ = current_results_.empty() ? 0 : std::min(index, static_cast<int>(current_results_.size()) - 1);
+    }
+
+    void CommandPalette::EnsureIndex() const
+    {
+        if (!index_dirty_ && matcher_)
+            return;
+
+        // In the order the palette lists commands, so ties keep that order
+        auto matcher = std::make_shared<FuzzyMatcher>();
+        entries_ = GetAllCommands();
+        for (const auto& item : provided_)
+            entries_.push_back(&item);
+        entry_of_.clear();
+        for (const auto* cmd : entries_)
+        {
+            entry_of_[cmd->id] = matcher->Add(cmd->label, cmd->description, cmd->keywords, cmd->priority);
+        }
+        matcher_ = std::move(matcher);
+        index_dirty_ = false;
+    }
+
+    std::vector<uint32_t> CommandPalette::EligibleEntries() const
+    {
+        std::vector<uint32_t> candidates;
+        candidates.reserve(entries_.size());
+        for (uint32_t i = 0; i < entries_.size(); ++i)
+        {
+            const PaletteCommand* cmd = entries_[i];
+            if (cmd->enabled && (category_filter_.empty() || cmd->category == category_filter_))
+                candidates.push_back(i);
+        }
+        return candidates;
+    }
+
+    std::unordered_map<uint32_t, int> CommandPalette::HistoryBoosts() const
+    {
+        std::unordered_map<uint32_t, int> boosts;
+        if (!boost_recent_)
+            return boosts;
+
+        for (const auto& entry : history_)
+        {
+            auto it = entry_of_.find(entry.command_id);
+            if (it != entry_of_.end())
+                boosts[it->second] = 20 + entry.use_count;
+        }
+        return boosts;
+    }
+
+    std::vector<PaletteMatch> CommandPalette::ToMatches(const std::string& lower_query,
+                                                       const std::vector<FuzzyMatcher::Hit>& hits, size_t count) const
+    {
+        // Match positions are only worked out for what is shown
+        std::vector<PaletteMatch> results;
+        count = std::min(count, hits.size());
+        results.reserve(count);
+        uint64_t query_mask = FuzzyMatcher::CharMask(lower_query);
+        for (size_t i = 0; i < count; ++i)
+        {
+            PaletteMatch match;
+            match.command = entries_[hits[i].entry];
+            match.score = hits[i].score;
+            matcher_->Score(hits[i].entry, lower_query, query_mask, &match.matched_indices);
+            results.push_back(std::move(match));
+        }
+        return results;
     }
 
     void RegisterStandardCommands(CommandPalette& palette)
@@ -1,7 +1,9 @@
 #include "opacity/ui/DiffViewer.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
 
 #include <imgui.h>
+#include <algorithm>
 #include <fstream>
 #include <sstream>
 #include <iomanip>
@@ -28,6 +30,8 @@ namespace opacity::ui
         result_ = result;
         current_hunk_ = 0;
         scroll_y_ = 0.0f;
+        rows_dirty_ = true;
+        scroll_to_hunk_ = true;
         
         left_path_ = result.left_file;
         right_path_ = result.right_file;
@@ -66,6 +70,7 @@ namespace opacity::ui
         if (current_hunk_ + 1 < result_.hunks.size())
         {
             ++current_hunk_;
+            scroll_to_hunk_ = true;
         }
     }
 
@@ -74,6 +79,7 @@ namespace opacity::ui
         if (current_hunk_ > 0)
         {
             --current_hunk_;
+            scroll_to_hunk_ = true;
         }
     }
 
@@ -82,6 +88,7 @@ namespace opacity::ui
         if (index < result_.hunks.size())
         {
             current_hunk_ = index;
+            scroll_to_hunk_ = true;
         }
     }
 
@@ -92,6 +99,7 @@ namespace opacity::ui
 
     void DiffViewer::Render()
     {
+        OPACITY_PROFILE_ZONE("DiffViewer::Render");
         if (!visible_)
             return;
 
@@ -121,6 +129,12 @@ namespace opacity::ui
                 
                 ImGui::Separator();
 
+                if (rows_dirty_ || rows_mode_ != options_.mode)
+                {
+                    BuildRows();
+                    scroll_to_hunk_ = true;
+                }
+
                 // Diff content
                 switch (options_.mode)
                 {
@@ -203,6 +217,148 @@ namespace opacity::ui
         }
     }
 
+    void DiffViewer::BuildRows()
+    {
+        rows_.clear();
+        hunk_rows_.clear();
+        intra_line_cache_.clear();
+        hunk_rows_.reserve(result_.hunks.size());
+
+        for (size_t h = 0; h < result_.hunks.size(); ++h)
+        {
+            const auto& lines = result_.hunks[h].lines;
+            hunk_rows_.push_back(rows_.size());
+
+            switch (options_.mode)
+            {
+            case DiffViewMode::SideBySide:
+                for (size_t i = 0; i < lines.size();)
+                {
+                    if (lines[i].type != DiffType::Removed && lines[i].type != DiffType::Added)
+                    {
+                        rows_.push_back({ &lines[i], &lines[i], h, false });
+                        ++i;
+                        continue;
+                    }
+
+                    // Pair a block's removals with the additions that follow them
+                    size_t removed_begin = i;
+                    while (i < lines.size() && lines[i].type == DiffType::Removed)
+                        ++i;
+                    size_t added_begin = i;
+                    while (i < lines.size() && lines[i].type == DiffType::Added)
+                        ++i;
+
+                    size_t removed = added_begin - removed_begin;
+                    size_t added = i - added_begin;
+                    for (size_t k = 0; k < std::max(removed, added); ++k)
+                    {
+                        rows_.push_back({ k < removed ? &lines[removed_begin + k] : nullptr,
+                                          k < added ? &lines[added_begin + k] : nullptr, h, false });
+                    }
+                }
+                break;
+
+            case DiffViewMode::Unified:
+                rows_.push_back({ nullptr, nullptr, h, true });
+                for (const auto& line : lines)
+                    rows_.push_back({ &line, nullptr, h, false });
+                break;
+
+            case DiffViewMode::Inline:
+                for (const auto& line : lines)
+                {
+                    if (line.type == DiffType::Modified)
+                    {
+                        rows_.push_back({ &line, nullptr, h, false });
+                        rows_.push_back({ nullptr, &line, h, false });
+                    }
+                    else
+                    {
+                        rows_.push_back({ &line, nullptr, h, false });
+                    }
+                }
+                break;
+            }
+        }
+
+        rows_mode_ = options_.mode;
+        rows_dirty_ = false;
+    }
+
+    const DiffViewer::IntraLineSpan& DiffViewer::GetIntraLineSpan(size_t row)
+    {
+        auto found = intra_line_cache_.find(row);
+        if (found != intra_line_cache_.end())
+            return found->second;
+
+        // Only what has been on screen is ever cached; a long scroll
+        // through a huge diff starts over rather than growing without bound
+        if (intra_line_cache_.size() >= 4096)
+            intra_line_cache_.clear();
+
+        const DiffRow& diff_row = rows_[row];
+        const std::string& left = diff_row.left->left_text;
+        const std::string& right = diff_row.right->right_text;
+        auto continues = [](const std::string& text, size_t at)
+        {
+            return at < text.size() && (static_cast<unsigned char>(text[at]) & 0xC0) == 0x80;
+        };
+
+        // The changed run is what is left between the common prefix and
+        // suffix, widened to whole UTF-8 characters
+        size_t shorter = std::min(left.size(), right.size());
+        size_t prefix = 0;
+        while (prefix < shorter && left[prefix] == right[prefix])
+            ++prefix;
+        while (prefix > 0 && (continues(left, prefix) || continues(right, prefix)))
+            --prefix;
+
+        size_t suffix = 0;
+        while (suffix < shorter - prefix && left[left.size() - 1 - suffix] == right[right.size() - 1 - suffix])
+            ++suffix;
+        while (suffix > 0 && continues(left, left.size() - suffix))
+            --suffix;
+
+        IntraLineSpan span;
+        span.left_begin = prefix;
+        span.left_end = left.size() - suffix;
+        span.right_begin = prefix;
+        span.right_end = right.size() - suffix;
+        return intra_line_cache_.emplace(row, span).first->second;
+    }
+
+    void DiffViewer::RenderLineText(const std::string& text, const ImVec4& color,
+                                    size_t highlight_begin, size_t highlight_end)
+    {
+        const char* begin = text.data();
+        const char* end = begin + text.size();
+
+        if (highlight_end > highlight_begin)
+        {
+            ImVec2 pos = ImGui::GetCursorScreenPos();
+            float x0 = pos.x + ImGui::CalcTextSize(begin, begin + highlight_begin).x;
+            float x1 = x0 + ImGui::CalcTextSize(begin + highlight_begin, begin + highlight_end).x;
+            ImVec4 highlight(color.x, color.y, color.z, 0.3f);
+            ImGui::GetWindowDrawList()->AddRectFilled(ImVec2(x0, pos.y),
+                ImVec2(x1, pos.y + ImGui::GetTextLineHeight()), ImGui::GetColorU32(highlight));
+        }
+
+        ImGui::PushStyleColor(ImGuiCol_Text, color);
+        ImGui::TextUnformatted(begin, end);
+        ImGui::PopStyleColor();
+    }
+
+    void DiffViewer::ScrollToPendingHunk(float line_height)
+    {
+        if (!scroll_to_hunk_)
+            return;
+
+        scroll_to_hunk_ = false;
+        if (current_hunk_ < hunk_rows_.size())
+            ImGui::SetScrollY(static_cast<float>(hunk_rows_[current_hunk_]) * line_height);
+    }
+
     void DiffViewer::RenderSideBySideView()
     {
         float available_width = ImGui::GetContentRegionAvail().x;
@@ -220,75 +376,78 @@ namespace opacity::ui
         ImGui::TextUnformatted(right_path_.c_str());
         ImGui::EndChild();
 
-        // Content panels
-        ImGui::BeginChild("LeftContent", ImVec2(half_width, 0), true, 
-            ImGuiWindowFlags_HorizontalScrollbar);
+        const ImVec4 number_color(0.5f, 0.5f, 0.5f, 1.0f);
+        float line_height = ImGui::GetTextLineHeightWithSpacing();
 
-        for (const auto& hunk : result_.hunks)
+        // Both panels have one row per entry in rows_, so their heights
+        // match and syncing the scroll keeps rows side by side
+        float left_scroll = 0.0f;
+        for (int side = 0; side < 2; ++side)
         {
-            for (const auto& line : hunk.lines)
-            {
-                ImVec4 color = GetDiffTypeColor(line.type);
-                
-                if (options_.show_line_numbers && line.left_line_number > 0)
-                {
-                    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "%4zu ", line.left_line_number);
-                    ImGui::SameLine();
-                }
+            bool left_side = side == 0;
+            if (!left_side)
+                ImGui::SameLine();
 
-                if (line.type == DiffType::Added)
-                {
-                    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "    ");
-                }
-                else
-                {
-                    ImGui::TextColored(color, "%s", line.left_text.c_str());
-                }
+            ImGui::BeginChild(left_side ? "LeftContent" : "RightContent", ImVec2(half_width, 0), true,
+                ImGuiWindowFlags_HorizontalScrollbar);
+
+            if (left_side)
+            {
+                ScrollToPendingHunk(line_height);
+            }
+            else if (sync_scroll_ && ImGui::GetScrollY() != left_scroll)
+            {
+                ImGui::SetScrollY(left_scroll);
             }
-        }
 
-        float left_scroll = ImGui::GetScrollY();
-        ImGui::EndChild();
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>(rows_.size()), line_height);
+            while (clipper.Step())
+            {
+                for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; ++r)
+                {
+                    const DiffRow& row = rows_[r];
+                    const diff::DiffLine* line = left_side ? row.left : row.right;
 
-        ImGui::SameLine();
+                    if (options_.show_line_numbers)
+                    {
+                        size_t number = line ? (left_side ? line->left_line_number : line->right_line_number) : 0;
+                        if (number > 0)
+                            ImGui::TextColored(number_color, "%4zu ", number);
+                        else
+                            ImGui::TextColored(number_color, "     ");
+                        ImGui::SameLine();
+                    }
 
-        ImGui::BeginChild("RightContent", ImVec2(half_width, 0), true,
-            ImGuiWindowFlags_HorizontalScrollbar);
+                    if (!line)
+                    {
+                        ImGui::TextUnformatted("");
+                        continue;
+                    }
 
-        for (const auto& hunk : result_.hunks)
-        {
-            for (const auto& line : hunk.lines)
-            {
-                ImVec4 color = GetDiffTypeColor(line.type);
-                
-                if (options_.show_line_numbers && line.right_line_number > 0)
-                {
-                    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "%4zu ", line.right_line_number);
-                    ImGui::SameLine();
-                }
+                    const std::string& text = left_side ? line->left_text : line->right_text;
+                    ImVec4 color = GetDiffTypeColor(line->type);
 
-                if (line.type == DiffType::Removed)
-                {
-                    ImGui::TextColored(ImVec4(0.5f, 0.5f, 0.5f, 1.0f), "    ");
-                }
-                else
-                {
-                    ImGui::TextColored(color, "%s", line.right_text.c_str());
+                    // A paired change highlights just the characters that differ
+                    if (row.left && row.right && line->type != DiffType::Equal)
+                    {
+                        const IntraLineSpan& span = GetIntraLineSpan(static_cast<size_t>(r));
+                        RenderLineText(text, color,
+                            left_side ? span.left_begin : span.right_begin,
+                            left_side ? span.left_end : span.right_end);
+                    }
+                    else
+                    {
+                        RenderLineText(text, color, 0, 0);
+                    }
                 }
             }
-        }
 
-        // Sync scroll
-        if (sync_scroll_)
-        {
-            float right_scroll = ImGui::GetScrollY();
-            if (right_scroll != left_scroll)
-            {
-                ImGui::SetScrollY(left_scroll);
-            }
-        }
+            if (left_side)
+                left_scroll = ImGui::GetScrollY();
 
-        ImGui::EndChild();
+            ImGui::EndChild();
+        }
     }
 
     void DiffViewer::RenderUnifiedView()
@@ -296,16 +455,28 @@ namespace opacity::ui
         ImGui::BeginChild("UnifiedContent", ImVec2(0, 0), true, 
             ImGuiWindowFlags_HorizontalScrollbar);
 
-        for (const auto& hunk : result_.hunks)
-        {
-            // Hunk header
-            ImGui::TextColored(ImVec4(0.6f, 0.6f, 1.0f, 1.0f), 
-                "@@ -%zu,%zu +%zu,%zu @@",
-                hunk.left_start, hunk.left_count,
-                hunk.right_start, hunk.right_count);
+        float line_height = ImGui::GetTextLineHeightWithSpacing();
+        ScrollToPendingHunk(line_height);
 
-            for (const auto& line : hunk.lines)
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rows_.size()), line_height);
+        while (clipper.Step())
+        {
+            for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; ++r)
             {
+                const DiffRow& row = rows_[r];
+
+                if (row.is_header)
+                {
+                    const auto& hunk = result_.hunks[row.hunk];
+                    ImGui::TextColored(ImVec4(0.6f, 0.6f, 1.0f, 1.0f), 
+                        "@@ -%zu,%zu +%zu,%zu @@",
+                        hunk.left_start, hunk.left_count,
+                        hunk.right_start, hunk.right_count);
+                    continue;
+                }
+
+                const diff::DiffLine& line = *row.left;
                 ImVec4 color = GetDiffTypeColor(line.type);
                 char prefix = ' ';
 
@@ -344,10 +515,25 @@ namespace opacity::ui
         ImGui::BeginChild("InlineContent", ImVec2(0, 0), true,
             ImGuiWindowFlags_HorizontalScrollbar);
 
-        for (const auto& hunk : result_.hunks)
+        float line_height = ImGui::GetTextLineHeightWithSpacing();
+        ScrollToPendingHunk(line_height);
+
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(rows_.size()), line_height);
+        while (clipper.Step())
         {
-            for (const auto& line : hunk.lines)
+            for (int r = clipper.DisplayStart; r < clipper.DisplayEnd; ++r)
             {
+                const DiffRow& row = rows_[r];
+
+                // A modified line takes two rows: its left half, then its right
+                if (!row.left)
+                {
+                    ImGui::TextColored(ImVec4(0.6f, 1.0f, 0.6f, 1.0f), "+ %s", row.right->right_text.c_str());
+                    continue;
+                }
+
+                const diff::DiffLine& line = *row.left;
                 ImVec4 color = GetDiffTypeColor(line.type);
 
                 switch (line.type)
@@ -363,7 +549,6 @@ namespace opacity::ui
                     break;
                 case DiffType::Modified:
                     ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.6f, 1.0f), "- %s", line.left_text.c_str());
-                    ImGui::TextColored(ImVec4(0.6f, 1.0f, 0.6f, 1.0f), "+ %s", line.right_text.c_str());
                     break;
                 }
             }
@@ -0,0 +1,489 @@
+#include "opacity/ui/DiskUsageView.h"
+#include "opacity/filesystem/FsItem.h"
+#include "opacity/core/Path.h"
+#include "opacity/core/Profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <limits>
+#include <mutex>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        // Tiles smaller than this many square pixels are not subdivided
+        constexpr float kMinSubdivideArea = 900.0f;
+        constexpr size_t kMaxTiles = 20000;
+        constexpr size_t kTilesPerReserve = 4096;     // 8 vertices each, well under 65536
+        constexpr uint16_t kMaxDepth = 32;
+
+        // Room around a folder's children, and for its label above them
+        constexpr float kPadding = 2.0f;
+        constexpr float kMinLabelWidth = 40.0f;
+
+        // A layout is made again this soon at most while sizes keep changing
+        constexpr std::chrono::milliseconds kRelayoutInterval{1000};
+
+        struct Rect
+        {
+            float x0, y0, x1, y1;
+        };
+
+        /**
+         * @brief Squarified treemap (Bruls, Huizing, van Wijk)
+         *
+         * Rows are filled along the shorter side for as long as adding an
+         * item does not make the row's worst aspect ratio worse.
+         *
+         * @param areas Descending, summing to the rectangle's area
+         */
+        void Squarify(const std::vector<double>& areas, Rect rect, std::vector<Rect>& out)
+        {
+            out.assign(areas.size(), Rect{rect.x0, rect.y0, rect.x0, rect.y0});
+            size_t start = 0;
+            while (start < areas.size())
+            {
+                double width = rect.x1 - rect.x0;
+                double height = rect.y1 - rect.y0;
+                double side = std::min(width, height);
+                if (side <= 0.0)
+                    return;
+
+                size_t end = start;
+                double sum = 0.0;
+                double worst = std::numeric_limits<double>::infinity();
+                while (end < areas.size())
+                {
+                    double next = sum + areas[end];
+                    double side2 = side * side;
+                    double next2 = next * next;
+                    double ratio = std::max(side2 * areas[start] / next2, next2 / (side2 * areas[end]));
+                    if (end > start && ratio > worst)
+                        break;
+                    worst = ratio;
+                    sum = next;
+                    ++end;
+                }
+
+                double thickness = sum / side;
+                double offset = 0.0;
+                for (size_t i = start; i < end; ++i)
+                {
+                    double length = areas[i] / thickness;
+                    if (width >= height)
+                    {
+                        out[i] = {rect.x0, static_cast<float>(rect.y0 + offset),
+                                  static_cast<float>(rect.x0 + thickness), static_cast<float>(rect.y0 + offset + length)};
+                    }
+                    else
+                    {
+                        out[i] = {static_cast<float>(rect.x0 + offset), rect.y0,
+                                  static_cast<float>(rect.x0 + offset + length), static_cast<float>(rect.y0 + thickness)};
+                    }
+                    offset += length;
+                }
+                if (width >= height)
+                    rect.x0 = static_cast<float>(rect.x0 + thickness);
+                else
+                    rect.y0 = static_cast<float>(rect.y0 + thickness);
+                start = end;
+            }
+        }
+
+        // Neighbouring branches get far-apart hues; deeper tiles are darker
+        ImU32 TileColor(uint16_t branch, uint16_t depth, bool files)
+        {
+            float hue = std::fmod(branch * 0.618034f, 1.0f);
+            float value = std::max(0.45f, 0.92f - depth * 0.07f);
+            ImVec4 color;
+            ImGui::ColorConvertHSVtoRGB(hue, files ? 0.15f : 0.55f, value, color.x, color.y, color.z);
+            color.w = 1.0f;
+            return ImGui::ColorConvertFloat4ToU32(color);
+        }
+    }
+
+    struct DiskUsageView::LayoutJob
+    {
+        std::shared_ptr<search::FolderSizeService> folder_sizes;
+        std::filesystem::path root;
+        float width = 0.0f;
+        float height = 0.0f;
+        float label_height = 0.0f;
+
+        std::mutex mutex;
+        Layout published;
+        uint32_t version = 0;       // Bumped on every publish
+        std::atomic<bool> done{false};
+    };
+
+    DiskUsageView::DiskUsageView(std::shared_ptr<search::FolderSizeService> folder_sizes)
+        : folder_sizes_(std::move(folder_sizes))
+    {
+    }
+
+    DiskUsageView::~DiskUsageView()
+    {
+        // The job owns everything it touches; it only needs to stop early
+        job_cancel_.Cancel();
+    }
+
+    void DiskUsageView::Show(const std::string& path)
+    {
+        visible_ = true;
+        history_.clear();
+        DrillTo(core::Path(path).Get());
+        history_.clear();
+    }
+
+    void DiskUsageView::Hide()
+    {
+        visible_ = false;
+        job_cancel_.Cancel();
+        job_.reset();
+        layout_ = Layout{};
+    }
+
+    void DiskUsageView::DrillTo(std::filesystem::path path)
+    {
+        if (!root_.empty())
+            history_.push_back(root_);
+        root_ = std::move(path);
+
+        // Nothing of the old layout applies
+        job_cancel_.Cancel();
+        job_.reset();
+        layout_ = Layout{};
+        layout_width_ = 0.0f;
+        layout_height_ = 0.0f;
+    }
+
+    void DiskUsageView::DrillOut()
+    {
+        std::filesystem::path target;
+        if (!history_.empty())
+        {
+            target = std::move(history_.back());
+            history_.pop_back();
+        }
+        else if (root_.has_relative_path())
+        {
+            target = root_.parent_path();
+        }
+        else
+        {
+            return;
+        }
+
+        std::vector<std::filesystem::path> history = std::move(history_);
+        DrillTo(std::move(target));
+        history_ = std::move(history);
+    }
+
+    void DiskUsageView::StartLayout(float width, float height)
+    {
+        job_cancel_.Cancel();
+        job_cancel_ = core::CancellationSource();
+
+        auto job = std::make_shared<LayoutJob>();
+        job->folder_sizes = folder_sizes_;
+        job->root = root_;
+        job->width = width;
+        job->height = height;
+        job->label_height = ImGui::GetTextLineHeight();
+        job_ = job;
+        job_version_ = 0;
+
+        layout_width_ = width;
+        layout_height_ = height;
+        layout_generation_ = folder_sizes_->GetGeneration();
+        layout_started_ = std::chrono::steady_clock::now();
+
+        core::TaskOptions options;
+        options.priority = core::TaskPriority::Interactive;
+        options.cancel = job_cancel_.Token();
+        core::TaskScheduler::Get().Submit([job](const core::CancellationToken& cancel) {
+            RunLayout(*job, cancel);
+        }, std::move(options));
+    }
+
+    bool DiskUsageView::IsBusy() const
+    {
+        if (!visible_ || !job_)
+            return false;
+        std::lock_guard<std::mutex> lock(job_->mutex);
+        return !job_->done.load() || job_->version != job_version_;
+    }
+
+    void DiskUsageView::RunLayout(LayoutJob& job, const core::CancellationToken& cancel)
+    {
+        OPACITY_PROFILE_ZONE("DiskUsageView::RunLayout");
+        struct DoneOnExit
+        {
+            LayoutJob& job;
+            ~DoneOnExit() { job.done.store(true); }
+        } done_on_exit{job};
+
+        struct Pending
+        {
+            Rect rect;
+            std::filesystem::path path;
+            uint16_t branch;
+        };
+
+        struct Item
+        {
+            uint64_t bytes;
+            int32_t child;      // Into children, -1 for the folder's own files
+        };
+
+        Layout layout;
+        std::vector<Pending> level;
+        level.push_back({Rect{0.0f, 0.0f, job.width, job.height}, job.root, 0});
+
+        std::vector<search::FolderEntry> children;
+        search::FolderSize own_files;
+        std::vector<Item> items;
+        std::vector<double> areas;
+        std::vector<Rect> rects;
+
+        for (uint16_t depth = 0; !level.empty() && depth < kMaxDepth; ++depth)
+        {
+            std::vector<Pending> next;
+            for (const Pending& parent : level)
+            {
+                if (cancel.IsCancelled() || layout.tiles.size() >= kMaxTiles)
+                    break;
+                if (!job.folder_sizes->GetChildren(parent.path, children, own_files))
+                    continue;
+
+                items.clear();
+                uint64_t total = 0;
+                for (size_t i = 0; i < children.size(); ++i)
+                {
+                    if (children[i].size.bytes == 0)
+                        continue;
+                    items.push_back({children[i].size.bytes, static_cast<int32_t>(i)});
+                    total += children[i].size.bytes;
+                }
+                if (own_files.bytes > 0)
+                {
+                    items.push_back({own_files.bytes, -1});
+                    total += own_files.bytes;
+                }
+                if (total == 0)
+                    continue;
+                std::sort(items.begin(), items.end(),
+                          [](const Item& a, const Item& b) { return a.bytes > b.bytes; });
+
+                // Below the top level, children sit inside a frame and
+                // under the folder's label where there is room for one
+                Rect area = parent.rect;
+                if (depth > 0)
+                {
+                    area.x0 += kPadding;
+                    area.x1 -= kPadding;
+                    area.y1 -= kPadding;
+                    bool labelled = area.x1 - area.x0 >= kMinLabelWidth &&
+                                    parent.rect.y1 - parent.rect.y0 >= job.label_height * 3.0f;
+                    area.y0 += labelled ? job.label_height : kPadding;
+                }
+                double width = area.x1 - area.x0;
+                double height = area.y1 - area.y0;
+                if (width < 1.0 || height < 1.0)
+                    continue;
+
+                double scale = width * height / static_cast<double>(total);
+                areas.clear();
+                for (const Item& item : items)
+                    areas.push_back(item.bytes * scale);
+                Squarify(areas, area, rects);
+
+                for (size_t i = 0; i < items.size() && layout.tiles.size() < kMaxTiles; ++i)
+                {
+                    const Rect& rect = rects[i];
+                    Tile tile{rect.x0, rect.y0, rect.x1, rect.y1, items[i].bytes, depth,
+                              depth == 0 ? static_cast<uint16_t>(i) : parent.branch, -1};
+
+                    if (items[i].child >= 0)
+                    {
+                        const std::filesystem::path& path = children[items[i].child].path;
+                        tile.folder = static_cast<int32_t>(layout.folders.size());
+                        layout.folders.push_back(path);
+                        layout.names.push_back(path.filename().u8string());
+
+                        float tile_area = (rect.x1 - rect.x0) * (rect.y1 - rect.y0);
+                        if (tile_area >= kMinSubdivideArea)
+                            next.push_back({rect, path, tile.branch});
+                    }
+                    layout.tiles.push_back(tile);
+                }
+            }
+
+            if (cancel.IsCancelled())
+                return;
+
+            // Each level is shown as soon as it is done
+            {
+                std::lock_guard<std::mutex> lock(job.mutex);
+                job.published = layout;
+                job.version++;
+            }
+            if (layout.tiles.size() >= kMaxTiles)
+                break;
+            level = std::move(next);
+        }
+    }
+
+    void DiskUsageView::PollLayout()
+    {
+        if (!job_)
+            return;
+
+        std::lock_guard<std::mutex> lock(job_->mutex);
+        if (job_->version != job_version_)
+        {
+            layout_ = job_->published;
+            job_version_ = job_->version;
+        }
+    }
+
+    const DiskUsageView::Tile* DiskUsageView::FolderAt(const ImVec2& point) const
+    {
+        // Children follow their parents, so the last match is the deepest
+        for (auto it = layout_.tiles.rbegin(); it != layout_.tiles.rend(); ++it)
+        {
+            if (it->folder >= 0 && point.x >= it->x0 && point.x < it->x1 && point.y >= it->y0 && point.y < it->y1)
+                return &*it;
+        }
+        return nullptr;
+    }
+
+    void DiskUsageView::RenderTiles(const ImVec2& origin)
+    {
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        const auto& tiles = layout_.tiles;
+        if (tiles.empty())
+            return;
+
+        // Every tile is a dark frame with its fill inset over it, in
+        // reservations small enough for 16-bit indices: ImGui starts a new
+        // vertex offset between them, never within one
+        ImU32 frame_color = IM_COL32(20, 20, 20, 255);
+        for (size_t i = 0; i < tiles.size(); ++i)
+        {
+            if (i % kTilesPerReserve == 0)
+            {
+                int count = static_cast<int>(std::min(kTilesPerReserve, tiles.size() - i));
+                draw_list->PrimReserve(count * 12, count * 8);
+            }
+
+            const Tile& tile = tiles[i];
+            ImVec2 a(origin.x + tile.x0, origin.y + tile.y0);
+            ImVec2 b(origin.x + tile.x1, origin.y + tile.y1);
+            draw_list->PrimRect(a, b, frame_color);
+
+            ImVec2 inner_a(std::min(a.x + 1.0f, b.x), std::min(a.y + 1.0f, b.y));
+            ImVec2 inner_b(std::max(b.x - 1.0f, inner_a.x), std::max(b.y - 1.0f, inner_a.y));
+            draw_list->PrimRect(inner_a, inner_b, TileColor(tile.branch, tile.depth, tile.folder < 0));
+        }
+
+        // Labels where they fit, clipped to their tile
+        float line = ImGui::GetTextLineHeight();
+        ImFont* font = ImGui::GetFont();
+        float font_size = ImGui::GetFontSize();
+        for (const Tile& tile : tiles)
+        {
+            if (tile.x1 - tile.x0 < kMinLabelWidth || tile.y1 - tile.y0 < line + kPadding)
+                continue;
+
+            const char* name = tile.folder >= 0 ? layout_.names[tile.folder].c_str() : "(files)";
+            ImVec4 clip(origin.x + tile.x0 + kPadding, origin.y + tile.y0,
+                        origin.x + tile.x1 - kPadding, origin.y + tile.y1);
+            draw_list->AddText(font, font_size, ImVec2(clip.x, clip.y), IM_COL32(0, 0, 0, 255),
+                               name, nullptr, 0.0f, &clip);
+        }
+    }
+
+    void DiskUsageView::Render()
+    {
+        if (!visible_)
+            return;
+
+        ImGui::SetNextWindowSize(ImVec2(900, 600), ImGuiCond_FirstUseEver);
+        bool open = true;
+        if (ImGui::Begin("Disk Usage", &open))
+        {
+            bool can_go_up = !history_.empty() || root_.has_relative_path();
+            ImGui::BeginDisabled(!can_go_up);
+            if (ImGui::Button("Up"))
+                DrillOut();
+            ImGui::EndDisabled();
+            ImGui::SameLine();
+
+            // Asking every frame keeps the folder queued until it is measured
+            std::optional<search::FolderSize> size = folder_sizes_->Get(root_);
+            std::string root = root_.u8string();
+            if (size)
+            {
+                ImGui::Text("%s  %s in %llu files, %llu folders%s", root.c_str(),
+                            filesystem::FsItemUtils::FormatSize(size->bytes).c_str(),
+                            static_cast<unsigned long long>(size->files),
+                            static_cast<unsigned long long>(size->folders),
+                            size->stale ? " (updating)" : "");
+            }
+            else
+            {
+                ImGui::Text("%s  Measuring...", root.c_str());
+            }
+
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            ImVec2 avail = ImGui::GetContentRegionAvail();
+            if (size && avail.x >= 1.0f && avail.y >= 1.0f)
+            {
+                ImGui::InvisibleButton("##treemap", avail,
+                                       ImGuiButtonFlags_MouseButtonLeft | ImGuiButtonFlags_MouseButtonRight);
+
+                // Again for a new size of window, or sizes that changed,
+                // though not more often than kRelayoutInterval for those
+                bool resized = avail.x != layout_width_ || avail.y != layout_height_;
+                bool changed = folder_sizes_->GetGeneration() != layout_generation_ &&
+                               std::chrono::steady_clock::now() - layout_started_ >= kRelayoutInterval;
+                if (!job_ || resized || changed)
+                    StartLayout(avail.x, avail.y);
+                PollLayout();
+
+                RenderTiles(origin);
+
+                if (ImGui::IsItemHovered())
+                {
+                    // The first click of a double-click has drilled in
+                    // already, so the second opens where that led
+                    ImVec2 mouse = ImGui::GetIO().MousePos;
+                    const Tile* tile = FolderAt(ImVec2(mouse.x - origin.x, mouse.y - origin.y));
+                    if (ImGui::IsMouseDoubleClicked(ImGuiMouseButton_Left))
+                    {
+                        if (on_navigate_)
+                            on_navigate_(root_.u8string());
+                    }
+                    else if (tile)
+                    {
+                        std::filesystem::path path = layout_.folders[tile->folder];
+                        ImGui::SetTooltip("%s\n%s", path.u8string().c_str(),
+                                          filesystem::FsItemUtils::FormatSize(tile->bytes).c_str());
+                        if (ImGui::IsItemClicked(ImGuiMouseButton_Left))
+                            DrillTo(std::move(path));
+                    }
+                    if (ImGui::IsItemClicked(ImGuiMouseButton_Right))
+                        DrillOut();
+                }
+            }
+        }
+        ImGui::End();
+
+        if (!open)
+            Hide();
+    }
+
+} // namespace opacity::ui
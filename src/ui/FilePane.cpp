@@ -1,10 +1,26 @@
 #include "opacity/ui/FilePane.h"
+#include "opacity/ui/GlyphCache.h"
+#include "opacity/ui/PrefetchEngine.h"
+#include "opacity/ui/ShellSelection.h"
+#include "opacity/filesystem/DirectoryCache.h"
+#include "opacity/filesystem/NetworkStorage.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/ShellIntegration.h"
 
 #include <imgui.h>
 #include "opacity/ui/ImGuiScoped.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <iterator>
+#include <mutex>
+#include <numeric>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
 
 #define NOMINMAX
 #include <Windows.h>
@@ -12,8 +28,93 @@
 
 namespace opacity::ui
 {
+    namespace
+    {
+        // Batches this small are applied by binary-search insert and erase;
+        // larger ones are merged into the listing in one pass
+        constexpr size_t kPositionalEditLimit = 64;
+
+        // Names on Windows compare case-insensitively
+        void FoldName(std::string_view name, std::string& folded)
+        {
+            folded.assign(name);
+            for (char& c : folded)
+            {
+                c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+            }
+        }
+
+        std::string FoldName(std::string_view name)
+        {
+            std::string folded;
+            FoldName(name, folded);
+            return folded;
+        }
+
+        std::string DirectoryKey(const std::string& path)
+        {
+            std::string key = FoldName(path);
+            std::replace(key.begin(), key.end(), '/', '\\');
+            while (key.size() > 3 && key.back() == '\\')
+            {
+                key.pop_back();
+            }
+            return key;
+        }
+    }
+
     uint32_t FilePane::next_id_ = 1;
 
+    /**
+     * @brief A directory listing read on a background thread
+     *
+     * The thread appends batches under the mutex and the pane takes them on
+     * its next frame. Cancelling only sets the flag: the thread notices at
+     * its next batch and exits on its own, so navigating away never waits
+     * on a stalled read.
+     *
+     * A stale cached listing is handed over as the first batch, so a slow
+     * share shows its last contents at once; the fresh read then replaces
+     * it in one go when it is done.
+     */
+    struct FilePane::LoadJob
+    {
+        std::string path;
+        filesystem::EnumerationOptions options;
+        bool network = false;                       // Read ahead into subdirectories once loaded
+        filesystem::SortColumn sort_column;
+        filesystem::SortDirection sort_direction;
+        std::chrono::steady_clock::time_point started;
+        core::CancellationSource cancel;
+
+        std::mutex mutex;
+        std::vector<filesystem::FsItem> batch;      // Read, not yet taken by the pane
+        filesystem::ItemStore store;                // Whole listing, once done
+        std::vector<filesystem::ItemStore::Index> order;
+        filesystem::DirectoryContents summary;
+        bool done = false;
+
+        FilePane::RedrawCallback redraw;            // When a batch or the end is waiting; under mutex
+    };
+
+    /**
+     * @brief A changed name in the current directory, re-read on the watcher
+     * thread so the pane only has to place it
+     */
+    struct FilePane::PendingChange
+    {
+        std::string name;
+        std::optional<filesystem::FsItem> item;     // Empty when gone or filtered out
+        std::string renamed_from;                   // Selection and focus move over from it
+    };
+
+    struct FilePane::WatchQueue
+    {
+        std::mutex mutex;
+        std::vector<PendingChange> changes;
+        bool reload = false;                        // Changes were lost; read the directory again
+    };
+
     FilePane::FilePane(std::shared_ptr<filesystem::FileSystemManager> fs_manager)
         : id_{next_id_++}
         , fs_manager_(std::move(fs_manager))
@@ -23,6 +124,10 @@ namespace opacity::ui
 
     FilePane::~FilePane()
     {
+        // Reads share the window's services, which go after the panes
+        CancelLoad();
+        WaitForLoads();
+        StopWatching();
         SPDLOG_DEBUG("FilePane {} destroyed", id_.id);
     }
 
@@ -32,23 +137,44 @@ namespace opacity::ui
         , current_path_(std::move(other.current_path_))
         , history_(std::move(other.history_))
         , history_index_(other.history_index_)
-        , items_(std::move(other.items_))
+        , store_(std::move(other.store_))
+        , order_(std::move(other.order_))
         , selection_(std::move(other.selection_))
         , focused_index_(other.focused_index_)
         , file_count_(other.file_count_)
         , directory_count_(other.directory_count_)
         , total_size_(other.total_size_)
         , last_error_(std::move(other.last_error_))
+        , display_arena_(std::move(other.display_arena_))
+        , display_text_(std::move(other.display_text_))
+        , load_job_(std::move(other.load_job_))
+        , load_task_(std::move(other.load_task_))
+        , abandoned_loads_(std::move(other.abandoned_loads_))
+        , watch_queue_(std::move(other.watch_queue_))
+        , watch_handle_(other.watch_handle_)
+        , hibernating_(other.hibernating_)
+        , restore_selection_(std::move(other.restore_selection_))
+        , restore_focus_(std::move(other.restore_focus_))
+        , scroll_y_(other.scroll_y_)
+        , restore_scroll_(other.restore_scroll_)
         , sort_column_(other.sort_column_)
         , sort_direction_(other.sort_direction_)
         , show_hidden_(other.show_hidden_)
         , filter_pattern_(std::move(other.filter_pattern_))
         , view_mode_(other.view_mode_)
         , icon_size_(other.icon_size_)
+        , thumbnails_(std::move(other.thumbnails_))
+        , drawn_thumbnails_(std::move(other.drawn_thumbnails_))
+        , icons_(std::move(other.icons_))
+        , drawn_icons_(std::move(other.drawn_icons_))
+        , folder_sizes_(std::move(other.folder_sizes_))
+        , folder_size_generation_(other.folder_size_generation_)
         , custom_title_(std::move(other.custom_title_))
         , on_navigate_(std::move(other.on_navigate_))
         , on_selection_change_(std::move(other.on_selection_change_))
+        , on_redraw_(std::move(other.on_redraw_))
     {
+        other.watch_handle_ = 0;
     }
 
     FilePane& FilePane::operator=(FilePane&& other) noexcept
@@ -60,22 +186,48 @@ namespace opacity::ui
             current_path_ = std::move(other.current_path_);
             history_ = std::move(other.history_);
             history_index_ = other.history_index_;
-            items_ = std::move(other.items_);
+            store_ = std::move(other.store_);
+            order_ = std::move(other.order_);
             selection_ = std::move(other.selection_);
             focused_index_ = other.focused_index_;
             file_count_ = other.file_count_;
             directory_count_ = other.directory_count_;
             total_size_ = other.total_size_;
             last_error_ = std::move(other.last_error_);
+            display_arena_ = std::move(other.display_arena_);
+            display_text_ = std::move(other.display_text_);
+            CancelLoad();
+            load_job_ = std::move(other.load_job_);
+            load_task_ = std::move(other.load_task_);
+            abandoned_loads_.insert(abandoned_loads_.end(),
+                std::make_move_iterator(other.abandoned_loads_.begin()),
+                std::make_move_iterator(other.abandoned_loads_.end()));
+            other.abandoned_loads_.clear();
+            StopWatching();
+            watch_queue_ = std::move(other.watch_queue_);
+            watch_handle_ = other.watch_handle_;
+            other.watch_handle_ = 0;
+            hibernating_ = other.hibernating_;
+            restore_selection_ = std::move(other.restore_selection_);
+            restore_focus_ = std::move(other.restore_focus_);
+            scroll_y_ = other.scroll_y_;
+            restore_scroll_ = other.restore_scroll_;
             sort_column_ = other.sort_column_;
             sort_direction_ = other.sort_direction_;
             show_hidden_ = other.show_hidden_;
             filter_pattern_ = std::move(other.filter_pattern_);
             view_mode_ = other.view_mode_;
             icon_size_ = other.icon_size_;
+            thumbnails_ = std::move(other.thumbnails_);
+            drawn_thumbnails_ = std::move(other.drawn_thumbnails_);
+            icons_ = std::move(other.icons_);
+            drawn_icons_ = std::move(other.drawn_icons_);
+            folder_sizes_ = std::move(other.folder_sizes_);
+            folder_size_generation_ = other.folder_size_generation_;
             custom_title_ = std::move(other.custom_title_);
             on_navigate_ = std::move(other.on_navigate_);
             on_selection_change_ = std::move(other.on_selection_change_);
+            on_redraw_ = std::move(other.on_redraw_);
         }
         return *this;
     }
@@ -195,13 +347,41 @@ namespace opacity::ui
 
     void FilePane::Refresh()
     {
+        // An explicit refresh always goes back to the disk
+        fs_manager_->GetListingCache().Invalidate(core::Path(current_path_));
         LoadDirectory(current_path_);
     }
 
     void FilePane::LoadDirectory(const std::string& path)
     {
+        OPACITY_PROFILE_ZONE("FilePane::LoadDirectory");
+        CancelLoad();
+
+        // Going somewhere else while hibernating; there is nothing to put back
+        if (hibernating_)
+        {
+            hibernating_ = false;
+            restore_selection_.clear();
+            restore_focus_.clear();
+            restore_scroll_ = -1.0f;
+        }
+
+        // Every way of getting here (history and up included) teaches the
+        // read-ahead where this pane goes next; a refresh does not
+        if (path != current_path_)
+            GetPrefetchEngine().RecordNavigation(current_path_, path);
+
         current_path_ = path;
+        GetGlyphCache().Note(current_path_);
         last_error_.clear();
+        store_.Reset(path);
+        ClearDisplayText();
+        order_.clear();
+        selection_.Reset(0);
+        focused_index_ = -1;
+        file_count_ = 0;
+        directory_count_ = 0;
+        total_size_ = 0;
 
         filesystem::EnumerationOptions options;
         options.include_hidden = show_hidden_;
@@ -209,96 +389,837 @@ namespace opacity::ui
         options.sort_direction = sort_direction_;
         options.filter_pattern = filter_pattern_;
 
-        auto result = fs_manager_->EnumerateDirectory(core::Path(path), options);
+        // Watch before reading so nothing that changes meanwhile is missed;
+        // changes queued during the read are applied once it finishes
+        StopWatching();
+        StartWatching(options);
+
+        auto job = std::make_shared<LoadJob>();
+        job->path = path;
+        job->options = options;
+        job->sort_column = sort_column_;
+        job->sort_direction = sort_direction_;
+        job->started = std::chrono::steady_clock::now();
+        job->redraw = on_redraw_;
+        load_job_ = job;
+
+        // A read the pane moves on from keeps its own references and is
+        // only waited for when the pane goes
+        core::TaskOptions task_options;
+        task_options.priority = core::TaskPriority::Interactive;
+        task_options.cancel = job->cancel.Token();
+        task_options.io_device = core::TaskScheduler::IoDevice(core::Path(path));
+        load_task_ = core::TaskScheduler::Get().Submit(
+            [job, fs_manager = fs_manager_, options](const core::CancellationToken& cancel)
+        {
+            auto& cache = fs_manager->GetListingCache();
+            core::Path directory(job->path);
+
+            job->network = filesystem::NetworkStorage::IsNetworkPath(directory.Get());
+
+            // History navigation and tab switches usually land here
+            filesystem::ItemStore store;
+            filesystem::DirectoryContents summary;
+            bool stale = false;
+            auto cached = cache.FindStale(directory, options, stale);
+            if (cached && !stale)
+            {
+                store = *cached;
+                summary.success = true;
+            }
+            else
+            {
+                if (cached)
+                {
+                    // Show what was there last time while the share answers
+                    std::vector<filesystem::FsItem> preview;
+                    preview.reserve(cached->Count());
+                    for (filesystem::ItemStore::Index i = 0; i < cached->Count(); ++i)
+                        preview.push_back(cached->Materialize(i));
+
+                    std::lock_guard<std::mutex> lock(job->mutex);
+                    job->batch = std::move(preview);
+                    if (job->redraw)
+                        job->redraw();
+                }
+
+                store.Reset(job->path);
+                summary = fs_manager->EnumerateDirectoryBatched(directory, options,
+                    [&job, &store, &cancel, revalidating = cached != nullptr](std::vector<filesystem::FsItem>& batch)
+                    {
+                        if (cancel.IsCancelled())
+                            return false;
+
+                        for (const auto& item : batch)
+                            store.Add(item);
+
+                        // The stale listing stays up until the read is done
+                        if (revalidating)
+                            return true;
+
+                        // One redraw per batch the pane has not taken yet
+                        std::lock_guard<std::mutex> lock(job->mutex);
+                        bool first = job->batch.empty();
+                        job->batch.insert(job->batch.end(),
+                            std::make_move_iterator(batch.begin()), std::make_move_iterator(batch.end()));
+                        if (first && job->redraw)
+                            job->redraw();
+                        return true;
+                    });
+
+                if (summary.success)
+                {
+                    cache.Store(directory, options, store);
+                }
+                else if (cached && !cancel.IsCancelled())
+                {
+                    SPDLOG_WARN("Showing cached listing of {}: {}", job->path, summary.error_message);
+                    store = *cached;
+                    summary = filesystem::DirectoryContents{};
+                    summary.success = true;
+                }
+            }
+
+            // Sorting permutes indices; the store keeps the order it was read in
+            std::vector<filesystem::ItemStore::Index> order(store.Count());
+            std::iota(order.begin(), order.end(), 0);
+            if (summary.success && !cancel.IsCancelled())
+            {
+                filesystem::FsItemComparator comparator(options.sort_column, options.sort_direction, options.folders_first);
+                filesystem::FsItemUtils::Sort(store, order, comparator);
+            }
 
-        if (result.success)
+            std::lock_guard<std::mutex> lock(job->mutex);
+            job->store = std::move(store);
+            job->order = std::move(order);
+            job->summary = std::move(summary);
+            job->done = true;
+            if (job->redraw)
+                job->redraw();
+        }, std::move(task_options));
+    }
+
+    void FilePane::CancelLoad()
+    {
+        if (load_job_)
         {
-            items_ = std::move(result.items);
-            file_count_ = result.total_files;
-            directory_count_ = result.total_directories;
-            total_size_ = result.total_size;
+            // Redraws are made under the mutex, so none reaches the window
+            // once this returns
+            load_job_->cancel.Cancel();
+            {
+                std::lock_guard<std::mutex> lock(load_job_->mutex);
+                load_job_->redraw = nullptr;
+            }
+            load_job_.reset();
         }
-        else
+
+        if (load_task_.IsValid())
         {
-            items_.clear();
+            abandoned_loads_.erase(std::remove_if(abandoned_loads_.begin(), abandoned_loads_.end(),
+                                                  [](const core::TaskHandle& task) { return task.IsDone(); }),
+                                   abandoned_loads_.end());
+            if (!load_task_.IsDone())
+                abandoned_loads_.push_back(std::move(load_task_));
+            load_task_ = core::TaskHandle();
+        }
+    }
+
+    void FilePane::WaitForLoads()
+    {
+        // Cancelled reads stop at their next batch; one not started is skipped
+        if (load_task_.IsValid())
+            load_task_.Wait();
+        for (auto& task : abandoned_loads_)
+            task.Wait();
+        load_task_ = core::TaskHandle();
+        abandoned_loads_.clear();
+    }
+
+    void FilePane::Hibernate()
+    {
+        if (hibernating_ || load_job_)
+            return;
+
+        restore_selection_.clear();
+        selection_.ForEach([&](size_t position)
+        {
+            restore_selection_.emplace_back(store_.Name(order_[position]));
+        });
+        restore_focus_.clear();
+        if (focused_index_ >= 0 && focused_index_ < static_cast<int>(order_.size()))
+            restore_focus_ = std::string(store_.Name(order_[focused_index_]));
+        restore_scroll_ = scroll_y_;
+
+        size_t released = GetMemoryUsage();
+        StopWatching();
+
+        // Replaced rather than cleared, so the memory goes too
+        store_ = filesystem::ItemStore();
+        std::vector<filesystem::ItemStore::Index>().swap(order_);
+        selection_ = SelectionSet();
+        std::string().swap(display_arena_);
+        std::vector<DisplayText>().swap(display_text_);
+        drawn_thumbnails_.clear();
+        drawn_icons_.clear();
+        focused_index_ = -1;
+        hibernating_ = true;
+
+        SPDLOG_DEBUG("FilePane {} hibernated, released {} bytes", id_.id, released);
+    }
+
+    void FilePane::Wake()
+    {
+        if (!hibernating_)
+            return;
+
+        hibernating_ = false;
+        LoadDirectory(current_path_);
+        SPDLOG_DEBUG("FilePane {} woke at {}", id_.id, current_path_);
+    }
+
+    void FilePane::RestoreAt(const std::string& path, std::vector<std::string> selected_names,
+                             std::string focused_name, float scroll_y)
+    {
+        CancelLoad();
+        StopWatching();
+
+        std::string normalized = fs_manager_->NormalizePath(core::Path(path)).String();
+        GetPrefetchEngine().Seed(normalized, 1.0);
+        current_path_ = normalized;
+        history_.assign(1, normalized);
+        history_index_ = 0;
+
+        store_ = filesystem::ItemStore();
+        order_.clear();
+        selection_ = SelectionSet();
+        ClearDisplayText();
+        focused_index_ = -1;
+        file_count_ = 0;
+        directory_count_ = 0;
+        total_size_ = 0;
+
+        restore_selection_ = std::move(selected_names);
+        restore_focus_ = std::move(focused_name);
+        restore_scroll_ = scroll_y;
+        hibernating_ = true;
+    }
+
+    size_t FilePane::GetMemoryUsage() const
+    {
+        return store_.MemoryUsage() +
+               order_.capacity() * sizeof(filesystem::ItemStore::Index) +
+               display_arena_.capacity() +
+               display_text_.capacity() * sizeof(DisplayText);
+    }
+
+    void FilePane::PollLoad()
+    {
+        OPACITY_PROFILE_ZONE("FilePane::PollLoad");
+        if (!load_job_)
+            return;
+
+        std::vector<filesystem::FsItem> batch;
+        bool done = false;
+        {
+            std::lock_guard<std::mutex> lock(load_job_->mutex);
+            batch.swap(load_job_->batch);
+            done = load_job_->done;
+        }
+
+        if (done)
+        {
+            FinishLoad(*load_job_);
+            load_job_.reset();
+            load_task_ = core::TaskHandle();
+            return;
+        }
+
+        if (batch.empty())
+            return;
+
+        // Show partial results in the order they were read
+        for (const auto& item : batch)
+        {
+            order_.push_back(store_.Add(item));
+        }
+        selection_.Resize(order_.size());
+        file_count_ = store_.GetFileCount();
+        directory_count_ = store_.GetDirectoryCount();
+        total_size_ = store_.GetTotalSize();
+        if (focused_index_ < 0)
+            focused_index_ = 0;
+    }
+
+    void FilePane::FinishLoad(LoadJob& job)
+    {
+        auto& result = job.summary;
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(
+            std::chrono::steady_clock::now() - job.started);
+
+        if (!result.success)
+        {
+            store_.Reset(current_path_);
+            ClearDisplayText();
+            order_.clear();
+            selection_.Reset(0);
+            focused_index_ = -1;
             file_count_ = 0;
             directory_count_ = 0;
             total_size_ = 0;
             last_error_ = result.error_message;
+            StopWatching();
             SPDLOG_WARN("Failed to enumerate directory: {}", last_error_);
+            return;
+        }
+
+        // Carry over whatever was selected while the listing was coming in;
+        // the final store is a different one, so match by name
+        std::vector<std::string> selected_names;
+        selection_.ForEach([&](size_t position)
+        {
+            selected_names.emplace_back(store_.Name(order_[position]));
+        });
+
+        // Focus starts on the first item read; only keep it if the user moved it
+        std::string focused_name;
+        if (focused_index_ > 0 && focused_index_ < static_cast<int>(order_.size()))
+            focused_name = std::string(store_.Name(order_[focused_index_]));
+
+        // A pane woken from hibernation picks up where it was left
+        selected_names.insert(selected_names.end(),
+            std::make_move_iterator(restore_selection_.begin()), std::make_move_iterator(restore_selection_.end()));
+        restore_selection_.clear();
+        if (focused_name.empty())
+            focused_name = std::move(restore_focus_);
+        restore_focus_.clear();
+
+        store_ = std::move(job.store);
+        ClearDisplayText();
+        order_ = std::move(job.order);
+        file_count_ = store_.GetFileCount();
+        directory_count_ = store_.GetDirectoryCount();
+        total_size_ = store_.GetTotalSize();
+
+        // The sort may have changed while the thread was reading
+        if (job.sort_column != sort_column_ || job.sort_direction != sort_direction_)
+        {
+            filesystem::FsItemComparator comparator(sort_column_, sort_direction_, true);
+            filesystem::FsItemUtils::Sort(store_, order_, comparator);
         }
 
-        // Reset selection
-        selection_.assign(items_.size(), false);
-        focused_index_ = items_.empty() ? -1 : 0;
+        selection_.Reset(order_.size());
+        focused_index_ = order_.empty() ? -1 : 0;
+        RestoreSelection(selected_names, focused_name);
+
+        // Entering a subdirectory of a share is the likely next step; read
+        // them ahead in the order they are shown
+        if (job.network)
+        {
+            std::vector<core::Path> subdirectories;
+            for (auto index : order_)
+            {
+                if (store_.IsDirectory(index))
+                    subdirectories.emplace_back(store_.FullPath(index));
+            }
+            if (!subdirectories.empty())
+                fs_manager_->GetListingCache().Prefetch(subdirectories, job.options);
+        }
+
+        SPDLOG_DEBUG("FilePane {} loaded {} items ({} bytes) in {} ms",
+            id_.id, order_.size(), store_.MemoryUsage(), elapsed.count());
+    }
+
+    void FilePane::RestoreSelection(const std::vector<std::string>& selected_names, const std::string& focused_name)
+    {
+        std::unordered_set<std::string_view> selected(selected_names.begin(), selected_names.end());
+        for (size_t i = 0; i < order_.size(); ++i)
+        {
+            std::string_view name = store_.Name(order_[i]);
+            if (!selected.empty() && selected.count(name))
+                selection_.Set(i, true);
+            if (!focused_name.empty() && name == focused_name)
+                focused_index_ = static_cast<int>(i);
+        }
+    }
+
+    void FilePane::StartWatching(const filesystem::EnumerationOptions& options)
+    {
+        if (current_path_.empty())
+            return;
+
+        auto queue = std::make_shared<WatchQueue>();
+        filesystem::FileSystemManager* fs_manager = fs_manager_.get();
+        std::string directory = DirectoryKey(current_path_);
+
+        filesystem::WatchConfig config;
+        config.recursive = false;
+
+        // Runs on the watcher thread; it only touches the queue, which
+        // outlives the pane if a batch is in flight when it goes away
+        watch_handle_ = fs_manager_->GetFileWatch().WatchBatch(core::Path(current_path_),
+            [queue, fs_manager, options, directory, redraw = on_redraw_](const std::vector<filesystem::FileChangeEvent>& events)
+            {
+                std::vector<PendingChange> changes;
+                std::unordered_map<std::string, size_t> seen;
+
+                auto add = [&](const core::Path& path, const std::string& renamed_from)
+                {
+                    auto inserted = seen.emplace(FoldName(path.Filename()), changes.size());
+                    if (!inserted.second)
+                    {
+                        if (!renamed_from.empty())
+                            changes[inserted.first->second].renamed_from = renamed_from;
+                        return;
+                    }
+
+                    PendingChange change;
+                    change.name = path.Filename();
+                    change.item = fs_manager->GetFileInfo(path);
+                    if (change.item && !filesystem::FileSystemManager::MatchesOptions(*change.item, options))
+                        change.item.reset();
+                    change.renamed_from = renamed_from;
+                    changes.push_back(std::move(change));
+                };
+
+                for (const auto& event : events)
+                {
+                    if (event.type == filesystem::FileChangeType::Unknown || DirectoryKey(event.path.String()) == directory)
+                    {
+                        {
+                            std::lock_guard<std::mutex> lock(queue->mutex);
+                            queue->changes.clear();
+                            queue->reload = true;
+                        }
+                        if (redraw)
+                            redraw();
+                        return;
+                    }
+
+                    std::string renamed_from;
+                    if (!event.old_path.String().empty())
+                    {
+                        renamed_from = event.old_path.Filename();
+                        add(event.old_path, {});
+                    }
+                    add(event.path, renamed_from);
+                }
+
+                {
+                    std::lock_guard<std::mutex> lock(queue->mutex);
+                    if (!queue->reload)
+                    {
+                        queue->changes.insert(queue->changes.end(),
+                            std::make_move_iterator(changes.begin()), std::make_move_iterator(changes.end()));
+                    }
+                }
+                if (redraw && !changes.empty())
+                    redraw();
+            }, config);
+
+        if (watch_handle_ != 0)
+            watch_queue_ = std::move(queue);
+    }
+
+    void FilePane::StopWatching()
+    {
+        if (watch_handle_ != 0 && fs_manager_)
+            fs_manager_->GetFileWatch().Unwatch(watch_handle_);
+        watch_handle_ = 0;
+        watch_queue_.reset();
+    }
+
+    void FilePane::PollChanges()
+    {
+        // A listing still being read takes its changes when it is done
+        if (!watch_queue_ || load_job_)
+            return;
+
+        std::vector<PendingChange> changes;
+        bool reload = false;
+        {
+            std::lock_guard<std::mutex> lock(watch_queue_->mutex);
+            changes.swap(watch_queue_->changes);
+            reload = watch_queue_->reload;
+            watch_queue_->reload = false;
+        }
+
+        if (reload)
+        {
+            SPDLOG_DEBUG("FilePane {} lost changes to {}, reloading", id_.id, current_path_);
+            Refresh();
+        }
+        else if (!changes.empty())
+        {
+            ApplyChanges(changes);
+        }
+    }
+
+    void FilePane::ApplyChanges(std::vector<PendingChange>& changes)
+    {
+        // Later changes to a name supersede earlier ones
+        std::unordered_map<std::string, size_t> latest;
+        for (size_t i = 0; i < changes.size(); ++i)
+        {
+            auto inserted = latest.emplace(FoldName(changes[i].name), i);
+            if (!inserted.second)
+            {
+                if (changes[i].renamed_from.empty())
+                    changes[i].renamed_from = std::move(changes[inserted.first->second].renamed_from);
+                inserted.first->second = i;
+            }
+        }
+
+        // Find what is shown under those names now
+        struct Removed
+        {
+            bool selected;
+            bool focused;
+        };
+        std::unordered_map<std::string, Removed> removed;
+        std::vector<size_t> removed_positions;
+
+        bool has_focus = focused_index_ >= 0 && focused_index_ < static_cast<int>(order_.size());
+        filesystem::ItemStore::Index focused_item = has_focus ? order_[focused_index_] : 0;
+        bool focus_removed = false;
+        bool selection_changed = false;
+
+        // Positions shift below every edit, so the selection is carried by
+        // store index and rebuilt once the view is final
+        std::vector<bool> selected_rows = SelectedRows();
+
+        auto take = [&](size_t position, const std::string& folded_name)
+        {
+            filesystem::ItemStore::Index index = order_[position];
+            bool focused = has_focus && index == focused_item;
+            bool selected = !selected_rows.empty() && selected_rows[index];
+            removed.emplace(folded_name, Removed{selected, focused});
+            removed_positions.push_back(position);
+            focus_removed |= focused;
+            selection_changed |= selected;
+
+            if (store_.IsDirectory(index))
+            {
+                directory_count_--;
+            }
+            else
+            {
+                file_count_--;
+                total_size_ -= store_.FileSize(index);
+            }
+        };
+
+        std::string folded;
+        if (sort_column_ == filesystem::SortColumn::Name && latest.size() <= kPositionalEditLimit)
+        {
+            // Sorted by name, each name can only sit at one spot of the
+            // folder run or of the file run
+            bool ascending = sort_direction_ == filesystem::SortDirection::Ascending;
+            auto before = [&](filesystem::ItemStore::Index row, const std::string& key)
+            {
+                FoldName(store_.Name(row), folded);
+                return ascending ? folded < key : key < folded;
+            };
+            auto files = std::partition_point(order_.begin(), order_.end(),
+                [this](filesystem::ItemStore::Index index) { return store_.IsDirectory(index); });
+
+            for (const auto& entry : latest)
+            {
+                for (auto run : {std::make_pair(order_.begin(), files), std::make_pair(files, order_.end())})
+                {
+                    auto it = std::lower_bound(run.first, run.second, entry.first, before);
+                    if (it == run.second)
+                        continue;
+                    FoldName(store_.Name(*it), folded);
+                    if (folded == entry.first)
+                    {
+                        take(static_cast<size_t>(it - order_.begin()), entry.first);
+                        break;
+                    }
+                }
+            }
+            std::sort(removed_positions.begin(), removed_positions.end());
+        }
+        else
+        {
+            // One pass over the view
+            for (size_t position = 0; position < order_.size(); ++position)
+            {
+                FoldName(store_.Name(order_[position]), folded);
+                if (latest.count(folded))
+                    take(position, folded);
+            }
+        }
+
+        if (removed_positions.size() <= kPositionalEditLimit)
+        {
+            for (auto it = removed_positions.rbegin(); it != removed_positions.rend(); ++it)
+            {
+                order_.erase(order_.begin() + *it);
+            }
+        }
+        else
+        {
+            size_t next = 0;
+            size_t position = 0;
+            auto kept = std::remove_if(order_.begin(), order_.end(), [&](filesystem::ItemStore::Index)
+            {
+                bool drop = next < removed_positions.size() && removed_positions[next] == position;
+                next += drop ? 1 : 0;
+                ++position;
+                return drop;
+            });
+            order_.erase(kept, order_.end());
+        }
+
+        // The store only grows; changed items are appended as new rows
+        std::vector<filesystem::ItemStore::Index> added;
+        std::optional<filesystem::ItemStore::Index> new_focus;
+        for (const auto& entry : latest)
+        {
+            PendingChange& change = changes[entry.second];
+            if (!change.item)
+                continue;
+
+            bool selected = false;
+            bool focused = false;
+            auto carry_over = [&](const std::string& folded_name)
+            {
+                auto it = removed.find(folded_name);
+                if (it != removed.end())
+                {
+                    selected |= it->second.selected;
+                    focused |= it->second.focused;
+                }
+            };
+            carry_over(entry.first);
+            if (!change.renamed_from.empty())
+                carry_over(FoldName(change.renamed_from));
+
+            filesystem::ItemStore::Index index = store_.Add(*change.item);
+            if (selected)
+            {
+                selected_rows.resize(store_.Count(), false);
+                selected_rows[index] = true;
+            }
+            added.push_back(index);
+            if (focused)
+                new_focus = index;
+
+            if (change.item->is_directory)
+            {
+                directory_count_++;
+            }
+            else
+            {
+                file_count_++;
+                total_size_ += change.item->size;
+            }
+        }
+
+        filesystem::FsItemComparator comparator(sort_column_, sort_direction_, true);
+        auto less = [this, &comparator](filesystem::ItemStore::Index a, filesystem::ItemStore::Index b)
+        {
+            return comparator(store_, a, b);
+        };
+
+        if (added.size() <= kPositionalEditLimit)
+        {
+            for (auto index : added)
+            {
+                order_.insert(std::upper_bound(order_.begin(), order_.end(), index, less), index);
+            }
+        }
+        else
+        {
+            filesystem::FsItemUtils::Sort(store_, added, comparator);
+            size_t middle = order_.size();
+            order_.insert(order_.end(), added.begin(), added.end());
+            std::inplace_merge(order_.begin(), order_.begin() + middle, order_.end(), less);
+        }
+
+        if (selected_rows.empty())
+        {
+            selection_.Reset(order_.size());
+        }
+        else
+        {
+            selection_.Assign(order_.size(), [&](size_t position)
+            {
+                return order_[position] < selected_rows.size() && selected_rows[order_[position]];
+            });
+        }
+
+        // Focus follows its item (through a rename or update); if the item
+        // went away it stays at the same row
+        if (new_focus)
+        {
+            focused_index_ = PositionOf(*new_focus);
+        }
+        else if (focus_removed)
+        {
+            focused_index_ = std::min(focused_index_, static_cast<int>(order_.size()) - 1);
+        }
+        else if (has_focus)
+        {
+            focused_index_ = PositionOf(focused_item);
+        }
+
+        if (store_.Count() > 2 * order_.size() + 1024)
+            CompactStore();
+
+        SPDLOG_DEBUG("FilePane {} applied {} changes ({} removed, {} added)",
+            id_.id, latest.size(), removed_positions.size(), added.size());
+
+        if (selection_changed)
+            NotifySelectionChanged();
+    }
+
+    void FilePane::CompactStore()
+    {
+        // Drop rows no longer in the view; the view order becomes the store order
+        filesystem::ItemStore compacted;
+        compacted.Reset(store_.GetDirectory());
+        compacted.Reserve(order_.size(), 0);
+
+        // Positions stay where they are, and so does the selection
+        for (auto& index : order_)
+        {
+            index = compacted.AddFrom(store_, index);
+        }
+
+        store_ = std::move(compacted);
+        ClearDisplayText();
+    }
+
+    int FilePane::PositionOf(filesystem::ItemStore::Index index) const
+    {
+        // The view is sorted, so only the run comparing equal needs a scan
+        filesystem::FsItemComparator comparator(sort_column_, sort_direction_, true);
+        auto less = [this, &comparator](filesystem::ItemStore::Index a, filesystem::ItemStore::Index b)
+        {
+            return comparator(store_, a, b);
+        };
+        auto range = std::equal_range(order_.begin(), order_.end(), index, less);
+        auto it = std::find(range.first, range.second, index);
+        if (it == range.second)
+        {
+            it = std::find(order_.begin(), order_.end(), index);
+            if (it == order_.end())
+                return order_.empty() ? -1 : 0;
+        }
+        return static_cast<int>(it - order_.begin());
     }
 
     void FilePane::SelectAll()
     {
-        std::fill(selection_.begin(), selection_.end(), true);
-        if (on_selection_change_)
-            on_selection_change_(GetSelectedItems());
+        selection_.SelectAll();
+        NotifySelectionChanged();
     }
 
     void FilePane::SelectNone()
     {
-        std::fill(selection_.begin(), selection_.end(), false);
-        if (on_selection_change_)
-            on_selection_change_({});
+        selection_.Clear();
+        NotifySelectionChanged();
     }
 
     void FilePane::InvertSelection()
     {
-        for (auto& sel : selection_)
-            sel = !sel;
-        if (on_selection_change_)
-            on_selection_change_(GetSelectedItems());
+        selection_.Invert();
+        NotifySelectionChanged();
     }
 
     void FilePane::SetSelection(size_t index, bool selected)
     {
-        if (index < selection_.size())
+        if (index < order_.size())
         {
-            selection_[index] = selected;
-            if (on_selection_change_)
-                on_selection_change_(GetSelectedItems());
+            selection_.Set(index, selected);
+            NotifySelectionChanged();
         }
     }
 
     void FilePane::ToggleSelection(size_t index)
     {
-        if (index < selection_.size())
+        if (index < order_.size())
         {
-            selection_[index] = !selection_[index];
-            if (on_selection_change_)
-                on_selection_change_(GetSelectedItems());
+            selection_.Toggle(index);
+            NotifySelectionChanged();
         }
     }
 
+    void FilePane::SelectRange(size_t first, size_t last)
+    {
+        if (first > last)
+            std::swap(first, last);
+        if (last >= order_.size())
+            return;
+
+        selection_.Clear();
+        selection_.SetRange(first, last + 1, true);
+        NotifySelectionChanged();
+    }
+
     bool FilePane::IsSelected(size_t index) const
     {
-        return index < selection_.size() && selection_[index];
+        return selection_.Contains(index);
     }
 
     size_t FilePane::GetSelectionCount() const
     {
-        return std::count(selection_.begin(), selection_.end(), true);
+        return selection_.Count();
     }
 
     std::vector<filesystem::FsItem> FilePane::GetSelectedItems() const
     {
-        std::vector<filesystem::FsItem> result;
-        for (size_t i = 0; i < items_.size(); ++i)
+        return GetSelection().Materialize();
+    }
+
+    bool FilePane::CopySelectionToClipboard(bool cut) const
+    {
+        if (selection_.IsEmpty())
+            return false;
+
+        auto source = std::make_shared<SelectionFileSource>(store_, selection_, order_);
+        return core::ShellIntegration::SetClipboardFiles(std::move(source), cut ? core::ShellDropEffect::Move
+                                                                                : core::ShellDropEffect::Copy);
+    }
+
+    void FilePane::DragSelection()
+    {
+        if (selection_.IsEmpty())
+            return;
+
+        // The drag loop owns the mouse until the drop and swallows the
+        // button coming up, which ImGui would otherwise never see
+        ReleaseCapture();
+        auto source = std::make_shared<SelectionFileSource>(store_, selection_, order_);
+        core::ShellDropEffect effect = core::ShellIntegration::DragFiles(std::move(source));
+        ImGui::GetIO().MouseDown[ImGuiMouseButton_Left] = false;
+
+        // A move shows up through the directory watch
+        SPDLOG_DEBUG("FilePane {} dragged {} items out (effect {})", id_.id, selection_.Count(), static_cast<int>(effect));
+    }
+
+    std::vector<bool> FilePane::SelectedRows() const
+    {
+        // Empty when nothing is selected, which is the usual case
+        std::vector<bool> rows;
+        if (!selection_.IsEmpty())
         {
-            if (IsSelected(i))
-                result.push_back(items_[i]);
+            rows.assign(store_.Count(), false);
+            selection_.ForEach([&](size_t position) { rows[order_[position]] = true; });
         }
-        return result;
+        return rows;
+    }
+
+    void FilePane::NotifySelectionChanged()
+    {
+        if (on_selection_change_)
+            on_selection_change_(GetSelection());
     }
 
     void FilePane::SetFocusedIndex(int index)
     {
-        if (index >= -1 && index < static_cast<int>(items_.size()))
+        if (index >= -1 && index < static_cast<int>(order_.size()))
             focused_index_ = index;
     }
 
@@ -335,7 +1256,7 @@ namespace opacity::ui
         if (show_hidden_ != show)
         {
             show_hidden_ = show;
-            Refresh();
+            LoadDirectory(current_path_);
         }
     }
 
@@ -344,44 +1265,63 @@ namespace opacity::ui
         if (filter_pattern_ != pattern)
         {
             filter_pattern_ = pattern;
-            Refresh();
+            LoadDirectory(current_path_);
         }
     }
 
     void FilePane::SortItems()
     {
-        // Store selected paths to restore after sort
-        std::vector<std::string> selected_paths;
-        for (size_t i = 0; i < items_.size(); ++i)
+        // Selection and focus follow their items to where they sort to;
+        // all or nothing selected stays as it is
+        bool has_focus = focused_index_ >= 0 && focused_index_ < static_cast<int>(order_.size());
+        filesystem::ItemStore::Index focused = has_focus ? order_[focused_index_] : 0;
+        std::vector<bool> selected_rows;
+        if (selection_.Count() != order_.size())
+            selected_rows = SelectedRows();
+
+        // Items already loaded are sorted in place; a listing still being
+        // read is re-sorted when it completes
+        filesystem::FsItemComparator comparator(sort_column_, sort_direction_, true);
+        filesystem::FsItemUtils::Sort(store_, order_, comparator);
+
+        if (!selected_rows.empty())
         {
-            if (IsSelected(i))
-                selected_paths.push_back(items_[i].full_path.String());
+            selection_.Assign(order_.size(), [&](size_t position) { return selected_rows[order_[position]]; });
         }
 
-        std::string focused_path;
-        if (focused_index_ >= 0 && focused_index_ < static_cast<int>(items_.size()))
-            focused_path = items_[focused_index_].full_path.String();
-
-        // Re-enumerate with new sort
-        Refresh();
-
-        // Restore selection
-        for (size_t i = 0; i < items_.size(); ++i)
-        {
-            const auto& item_path = items_[i].full_path.String();
-            if (std::find(selected_paths.begin(), selected_paths.end(), item_path) != selected_paths.end())
-                selection_[i] = true;
-            if (item_path == focused_path)
-                focused_index_ = static_cast<int>(i);
-        }
+        if (has_focus)
+            focused_index_ = PositionOf(focused);
     }
 
     bool FilePane::Render(float width, float height)
     {
+        OPACITY_PROFILE_ZONE("FilePane::Render");
         bool was_interacted = false;
 
         opacity::ui::ImGuiScopedID pane_id(id_.id);
 
+        Wake();
+        PollLoad();
+        PollChanges();
+
+        if (load_job_)
+        {
+            // Animated dots so a stalled share still looks alive
+            static const char* const dots[] = { "", ".", "..", "..." };
+            int frame = static_cast<int>(ImGui::GetTime() * 3.0) & 3;
+            ImGui::TextDisabled("Loading %zu items%s", order_.size(), dots[frame]);
+            ImGui::SameLine();
+            if (ImGui::SmallButton("Stop"))
+            {
+                CancelLoad();
+                SortItems();
+            }
+        }
+        else if (!last_error_.empty())
+        {
+            ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "%s", last_error_.c_str());
+        }
+
         // Check for focus
         if (ImGui::IsWindowHovered(ImGuiHoveredFlags_ChildWindows) && ImGui::IsMouseClicked(0))
         {
@@ -419,6 +1359,23 @@ namespace opacity::ui
             ImGui::TableSetupColumn("Modified", ImGuiTableColumnFlags_WidthFixed, 150.0f);
             ImGui::TableSetupScrollFreeze(0, 1);
             ImGui::TableHeadersRow();
+            RestoreScroll();
+
+            // Last frame's draw list has been rendered by now
+            drawn_icons_.clear();
+            float icon_edge = ImGui::GetTextLineHeight();
+            preview::IconSize icon_size = preview::IconService::SizeFor(icon_edge);
+
+            // Sizes measured or changed since the text was made are shown anew
+            if (folder_sizes_ && folder_sizes_->GetGeneration() != folder_size_generation_)
+            {
+                folder_size_generation_ = folder_sizes_->GetGeneration();
+                for (size_t index = 0; index < display_text_.size(); ++index)
+                {
+                    if (store_.IsDirectory(static_cast<filesystem::ItemStore::Index>(index)))
+                        display_text_[index].size = DisplayText::kNone;
+                }
+            }
 
             // Handle sorting
             if (ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs())
@@ -449,29 +1406,39 @@ namespace opacity::ui
                 }
             }
 
-            // Render items
+            // Render items; opening a folder replaces the store they come from
+            int activated = -1;
+            bool drag_out = false;
             ImGuiListClipper clipper;
-            clipper.Begin(static_cast<int>(items_.size()));
+            clipper.Begin(static_cast<int>(order_.size()));
 
             while (clipper.Step())
             {
                 for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
                 {
                     size_t i = static_cast<size_t>(row);
-                    const auto& item = items_[i];
+                    filesystem::ItemStore::Index index = order_[i];
+                    bool is_directory = store_.IsDirectory(index);
+
+                    DisplayText text = GetDisplayText(index);
 
                     ImGui::TableNextRow();
+                    opacity::ui::ImGuiScopedID row_id(static_cast<int>(index));
 
-                    // Name column
+                    // Name column, after the icon
                     ImGui::TableNextColumn();
-                    const char* icon = item.is_directory ? "[DIR] " : "      ";
-
+                    if (icons_)
+                    {
+                        ImVec2 icon_min = ImGui::GetCursorScreenPos();
+                        DrawIcon(index, icon_min, icon_edge, icon_size);
+                        ImGui::SetCursorScreenPos(ImVec2(icon_min.x + icon_edge + ImGui::GetStyle().ItemInnerSpacing.x,
+                                                         icon_min.y));
+                    }
                     bool is_selected = IsSelected(i);
                     ImGuiSelectableFlags sel_flags = ImGuiSelectableFlags_SpanAllColumns |
                                                      ImGuiSelectableFlags_AllowDoubleClick;
 
-                    std::string label = std::string(icon) + item.name + "##" + std::to_string(i);
-                    if (ImGui::Selectable(label.c_str(), is_selected, sel_flags))
+                    if (ImGui::Selectable(DisplayString(text.label), is_selected, sel_flags))
                     {
                         bool ctrl = ImGui::GetIO().KeyCtrl;
                         bool shift = ImGui::GetIO().KeyShift;
@@ -482,45 +1449,170 @@ namespace opacity::ui
                         }
                         else if (shift && focused_index_ >= 0)
                         {
-                            SelectNone();
-                            size_t start = static_cast<size_t>(focused_index_);
-                            size_t end = i;
-                            if (start > end) std::swap(start, end);
-                            for (size_t j = start; j <= end; ++j)
-                                SetSelection(j, true);
+                            SelectRange(static_cast<size_t>(focused_index_), i);
                         }
                         else
                         {
-                            SelectNone();
-                            SetSelection(i, true);
+                            SelectRange(i, i);
                         }
                         focused_index_ = static_cast<int>(i);
 
-                        // Double-click to open
+                        // Double-click to open, once the rows are drawn
                         if (ImGui::IsMouseDoubleClicked(0))
                         {
-                            HandleItemActivation(i);
+                            activated = static_cast<int>(i);
                         }
                     }
 
+                    // Dragging an item takes the selection with it, or just the item
+                    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left))
+                    {
+                        if (!is_selected)
+                            SelectRange(i, i);
+                        focused_index_ = static_cast<int>(i);
+                        drag_out = true;
+                    }
+
                     // Size column
                     ImGui::TableNextColumn();
-                    if (!item.is_directory)
+                    if (!is_directory)
                     {
-                        ImGui::TextUnformatted(item.GetFormattedSize().c_str());
+                        ImGui::TextUnformatted(DisplayString(text.size));
+                    }
+                    else if (const char* folder_size = FolderSizeText(index))
+                    {
+                        ImGui::TextUnformatted(folder_size);
                     }
 
                     // Type column
                     ImGui::TableNextColumn();
-                    ImGui::TextUnformatted(item.GetTypeDescription().c_str());
+                    ImGui::TextUnformatted(store_.TypeDescription(index).c_str());
 
                     // Modified column
                     ImGui::TableNextColumn();
-                    ImGui::TextUnformatted(item.GetFormattedModifiedDate().c_str());
+                    ImGui::TextUnformatted(DisplayString(text.modified));
                 }
             }
 
+            scroll_y_ = ImGui::GetScrollY();
             ImGui::EndTable();
+
+            if (activated >= 0)
+                HandleItemActivation(static_cast<size_t>(activated));
+            else if (drag_out)
+                DragSelection();
+        }
+    }
+
+    const FilePane::DisplayText& FilePane::GetDisplayText(filesystem::ItemStore::Index index)
+    {
+        if (display_text_.size() < store_.Count())
+            display_text_.resize(store_.Count());
+
+        DisplayText& text = display_text_[index];
+        if (text.label != DisplayText::kNone)
+            return text;
+
+        // The arena may move; only offsets are kept
+        auto append = [this](std::string_view value)
+        {
+            uint32_t offset = static_cast<uint32_t>(display_arena_.size());
+            display_arena_.append(value);
+            display_arena_.push_back('\0');
+            return offset;
+        };
+
+        // Built when a row first shows, which is when its glyphs are needed
+        GetGlyphCache().Note(store_.Name(index));
+
+        bool is_directory = store_.IsDirectory(index);
+        text.label = static_cast<uint32_t>(display_arena_.size());
+        if (!icons_)
+            display_arena_.append(is_directory ? "[DIR] " : "      ");
+        display_arena_.append(store_.Name(index));
+        display_arena_.push_back('\0');
+        if (!is_directory)
+            text.size = append(filesystem::FsItemUtils::FormatSize(store_.FileSize(index)));
+        text.modified = append(filesystem::FsItemUtils::FormatDate(store_.Modified(index)));
+        return text;
+    }
+
+    void FilePane::SetIconService(std::shared_ptr<preview::IconService> icons)
+    {
+        icons_ = std::move(icons);
+        // Labels are marked with text only when there are no icons
+        ClearDisplayText();
+    }
+
+    void FilePane::DrawIcon(filesystem::ItemStore::Index index, const ImVec2& min, float edge, preview::IconSize size)
+    {
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        ImVec2 max(min.x + edge, min.y + edge);
+        bool is_directory = store_.IsDirectory(index);
+
+        preview::IconPtr icon;
+        if (ImGui::IsRectVisible(min, max))
+            icon = icons_->Get(core::Path(store_.FullPath(index)), store_.Attributes(index), store_.Modified(index), size);
+
+        if (icon && icon->texture && icon->texture->IsResident())
+        {
+            // Fit within the square, never scaled up past its edge
+            float scale = std::min(1.0f, edge / static_cast<float>(std::max(icon->width, icon->height)));
+            float width = icon->width * scale;
+            float height = icon->height * scale;
+            ImVec2 image_min(min.x + (edge - width) / 2, min.y + (edge - height) / 2);
+            const preview::TextureUv& uv = icon->texture->GetUv();
+            draw_list->AddImage(icon->texture->GetView(), image_min, ImVec2(image_min.x + width, image_min.y + height),
+                                ImVec2(uv.u0, uv.v0), ImVec2(uv.u1, uv.v1));
+            drawn_icons_.push_back(std::move(icon));
+            return;
+        }
+
+        // Placeholder until it is resolved, or for good
+        float inset = std::max(1.0f, edge * 0.15f);
+        ImU32 color = is_directory ? IM_COL32(255, 200, 100, 255) : IM_COL32(200, 200, 200, 255);
+        draw_list->AddRectFilled(ImVec2(min.x + inset, min.y + inset), ImVec2(max.x - inset, max.y - inset), color,
+                                 edge * 0.1f);
+    }
+
+    const char* FilePane::FolderSizeText(filesystem::ItemStore::Index index)
+    {
+        if (!folder_sizes_)
+            return nullptr;
+
+        // A stale size is shown but asked for every frame, which keeps it
+        // queued until it has been measured again
+        DisplayText& text = display_text_[index];
+        if (text.size != DisplayText::kNone && !text.size_stale)
+            return DisplayString(text.size);
+
+        auto size = folder_sizes_->Get(core::Path(store_.FullPath(index)).Get());
+        if (!size)
+            return nullptr;
+
+        if (text.size == DisplayText::kNone || text.size_stale != size->stale)
+        {
+            text.size = static_cast<uint32_t>(display_arena_.size());
+            display_arena_.append(filesystem::FsItemUtils::FormatSize(size->bytes));
+            display_arena_.push_back('\0');
+            text.size_stale = size->stale;
+        }
+        return DisplayString(text.size);
+    }
+
+    void FilePane::ClearDisplayText()
+    {
+        display_arena_.clear();
+        display_text_.clear();
+    }
+
+    void FilePane::RestoreScroll()
+    {
+        // Only once the rows are there to scroll over
+        if (restore_scroll_ >= 0.0f && !load_job_)
+        {
+            ImGui::SetScrollY(restore_scroll_);
+            restore_scroll_ = -1.0f;
         }
     }
 
@@ -537,97 +1629,190 @@ namespace opacity::ui
         float item_width = icon_size_px + 16.0f;
         float item_height = icon_size_px + 32.0f;
         float window_width = ImGui::GetContentRegionAvail().x;
-        int items_per_row = std::max(1, static_cast<int>(window_width / item_width));
+        size_t items_per_row = static_cast<size_t>(std::max(1, static_cast<int>(window_width / item_width)));
 
         ImGui::BeginChild("##IconView", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
-
-        for (size_t i = 0; i < items_.size(); ++i)
+        RestoreScroll();
+        bool drag_out = false;
+
+        // Last frame's draw list has been rendered by now
+        drawn_thumbnails_.clear();
+        drawn_icons_.clear();
+        preview::IconSize icon_size = preview::IconService::SizeFor(icon_size_px);
+        int thumbnail_edge = preview::ThumbnailService::EdgeFor(icon_size_px);
+
+        // Rows in view, from the scroll position; only these are submitted
+        // and the clipper spaces out the rest
+        size_t row_count = (order_.size() + items_per_row - 1) / items_per_row;
+        float row_height = item_height + ImGui::GetStyle().ItemSpacing.y;
+        size_t first_visible = static_cast<size_t>(std::max(0.0f, ImGui::GetScrollY() / row_height));
+        size_t visible_rows = static_cast<size_t>(ImGui::GetWindowHeight() / row_height) + 1;
+        size_t last_visible = std::min(first_visible + visible_rows, row_count);
+
+        // Rows away from the view; the service makes the nearest first
+        auto distance = [&](size_t row) -> int
+        {
+            if (row < first_visible)
+                return static_cast<int>(first_visible - row);
+            return row < last_visible ? 0 : static_cast<int>(row - last_visible + 1);
+        };
+        auto request = [&](size_t position, int priority) -> preview::ThumbnailPtr
         {
-            const auto& item = items_[i];
+            filesystem::ItemStore::Index index = order_[position];
+            if (!thumbnails_ || store_.IsDirectory(index))
+                return nullptr;
+            core::Path path(store_.FullPath(index));
+            if (!thumbnails_->CanThumbnail(path))
+                return nullptr;
+            return thumbnails_->Get(path, store_.Modified(index), thumbnail_edge, priority);
+        };
+
+        ImGuiListClipper clipper;
+        clipper.Begin(static_cast<int>(row_count), row_height);
+        while (clipper.Step())
+        {
+            for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
+            {
+                size_t row_start = static_cast<size_t>(row) * items_per_row;
+                size_t row_end = std::min(row_start + items_per_row, order_.size());
+                for (size_t i = row_start; i < row_end; ++i)
+                {
+                    filesystem::ItemStore::Index index = order_[i];
+                    bool is_directory = store_.IsDirectory(index);
 
-            if (i % items_per_row != 0)
-                ImGui::SameLine();
+                    if (i != row_start)
+                        ImGui::SameLine();
 
-            // Use RAII helpers to ensure PushID/PopID and BeginGroup/EndGroup pairing
-            opacity::ui::ImGuiScopedGroup scoped_group;
-            opacity::ui::ImGuiScopedID scoped_id(static_cast<int>(i));
+                    // Use RAII helpers to ensure PushID/PopID and BeginGroup/EndGroup pairing
+                    opacity::ui::ImGuiScopedGroup scoped_group;
+                    opacity::ui::ImGuiScopedID scoped_id(static_cast<int>(i));
 
-            bool is_selected = IsSelected(i);
+                    bool is_selected = IsSelected(i);
 
-            // Draw icon placeholder
-            ImVec2 pos = ImGui::GetCursorScreenPos();
-            ImDrawList* draw_list = ImGui::GetWindowDrawList();
-            
-            if (is_selected)
-            {
-                draw_list->AddRectFilled(
-                    pos,
-                    ImVec2(pos.x + item_width - 8.0f, pos.y + item_height),
-                    IM_COL32(100, 149, 237, 100)
-                );
-            }
+                    // Draw icon placeholder
+                    ImVec2 pos = ImGui::GetCursorScreenPos();
+                    ImDrawList* draw_list = ImGui::GetWindowDrawList();
 
-            // Icon area (placeholder)
-            ImU32 icon_color = item.is_directory ? IM_COL32(255, 200, 100, 255) : IM_COL32(200, 200, 200, 255);
-            draw_list->AddRectFilled(
-                ImVec2(pos.x + (item_width - icon_size_px) / 2, pos.y),
-                ImVec2(pos.x + (item_width + icon_size_px) / 2, pos.y + icon_size_px),
-                icon_color
-            );
+                    if (is_selected)
+                    {
+                        draw_list->AddRectFilled(
+                            pos,
+                            ImVec2(pos.x + item_width - 8.0f, pos.y + item_height),
+                            IM_COL32(100, 149, 237, 100)
+                        );
+                    }
 
-            // Invisible button for selection
-            if (ImGui::InvisibleButton("##item", ImVec2(item_width - 8.0f, item_height)))
-            {
-                bool ctrl = ImGui::GetIO().KeyCtrl;
-                if (ctrl)
-                {
-                    ToggleSelection(i);
-                }
-                else
-                {
-                    SelectNone();
-                    SetSelection(i, true);
-                }
-                focused_index_ = static_cast<int>(i);
-            }
+                    ImVec2 icon_min(pos.x + (item_width - icon_size_px) / 2, pos.y);
+                    ImVec2 icon_max(pos.x + (item_width + icon_size_px) / 2, pos.y + icon_size_px);
+                    preview::ThumbnailPtr thumbnail = request(i, distance(static_cast<size_t>(row)));
 
-            if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0))
-            {
-                HandleItemActivation(i);
+                    if (thumbnail && thumbnail->texture && thumbnail->texture->IsResident())
+                    {
+                        // Fit within the icon square, keeping the aspect ratio
+                        float scale = std::min(1.0f, icon_size_px / static_cast<float>(std::max(thumbnail->width, thumbnail->height)));
+                        float image_width = thumbnail->width * scale;
+                        float image_height = thumbnail->height * scale;
+                        ImVec2 image_min(icon_min.x + (icon_size_px - image_width) / 2, icon_min.y + (icon_size_px - image_height) / 2);
+                        const preview::TextureUv& uv = thumbnail->texture->GetUv();
+                        draw_list->AddImage(thumbnail->texture->GetView(), image_min,
+                                            ImVec2(image_min.x + image_width, image_min.y + image_height),
+                                            ImVec2(uv.u0, uv.v0), ImVec2(uv.u1, uv.v1));
+                        drawn_thumbnails_.push_back(std::move(thumbnail));
+                    }
+                    else if (icons_)
+                    {
+                        // The shell icon until the thumbnail is ready, or for good
+                        DrawIcon(index, icon_min, icon_size_px, icon_size);
+                    }
+                    else
+                    {
+                        ImU32 icon_color = is_directory ? IM_COL32(255, 200, 100, 255) : IM_COL32(200, 200, 200, 255);
+                        draw_list->AddRectFilled(icon_min, icon_max, icon_color);
+                    }
+
+                    // Invisible button for selection
+                    if (ImGui::InvisibleButton("##item", ImVec2(item_width - 8.0f, item_height)))
+                    {
+                        bool ctrl = ImGui::GetIO().KeyCtrl;
+                        if (ctrl)
+                        {
+                            ToggleSelection(i);
+                        }
+                        else
+                        {
+                            SelectRange(i, i);
+                        }
+                        focused_index_ = static_cast<int>(i);
+                    }
+
+                    if (ImGui::IsItemActive() && ImGui::IsMouseDragging(ImGuiMouseButton_Left))
+                    {
+                        if (!is_selected)
+                            SelectRange(i, i);
+                        focused_index_ = static_cast<int>(i);
+                        drag_out = true;
+                    }
+
+                    if (ImGui::IsItemHovered() && ImGui::IsMouseDoubleClicked(0))
+                    {
+                        HandleItemActivation(i);
+                    }
+
+                    // Render name (truncated)
+                    ImGui::SetCursorScreenPos(ImVec2(pos.x, pos.y + icon_size_px + 2.0f));
+
+                    std::string display_name(store_.Name(index));
+                    GetGlyphCache().Note(display_name);
+                    if (display_name.length() > 12)
+                    {
+                        display_name = display_name.substr(0, 9) + "...";
+                    }
+                    ImGui::TextUnformatted(display_name.c_str());
+
+                    // Let RAII destructors pop id and end group
+                }
             }
+        }
 
-            // Render name (truncated)
-            ImGui::SetCursorScreenPos(ImVec2(pos.x, pos.y + icon_size_px + 2.0f));
-            
-            std::string display_name = item.name;
-            if (display_name.length() > 12)
+        // A screen either way is queued behind what is visible, so
+        // scrolling a little finds it made; the rest has been cancelled
+        if (thumbnails_)
+        {
+            size_t prefetch_start = first_visible > visible_rows ? first_visible - visible_rows : 0;
+            size_t prefetch_end = std::min(last_visible + visible_rows, row_count);
+            for (size_t row = prefetch_start; row < prefetch_end; ++row)
             {
-                display_name = display_name.substr(0, 9) + "...";
+                if (row >= first_visible && row < last_visible)
+                    continue;
+                size_t row_start = row * items_per_row;
+                size_t row_end = std::min(row_start + items_per_row, order_.size());
+                for (size_t i = row_start; i < row_end; ++i)
+                    request(i, distance(row));
             }
-            ImGui::TextUnformatted(display_name.c_str());
-
-            // Let RAII destructors pop id and end group
         }
 
+        scroll_y_ = ImGui::GetScrollY();
         ImGui::EndChild();
+
+        if (drag_out)
+            DragSelection();
     }
 
     void FilePane::HandleItemActivation(size_t index)
     {
-        if (index >= items_.size())
+        if (index >= order_.size())
             return;
 
-        const auto& item = items_[index];
+        std::string path_str = store_.FullPath(order_[index]);
 
-        if (item.is_directory)
+        if (store_.IsDirectory(order_[index]))
         {
-            NavigateTo(item.full_path.String());
+            NavigateTo(path_str);
         }
         else
         {
             // Open with default application
             std::wstring wide_path;
-            std::string path_str = item.full_path.String();
             int size_needed = MultiByteToWideChar(CP_UTF8, 0, path_str.c_str(),
                 static_cast<int>(path_str.length()), nullptr, 0);
             wide_path.resize(size_needed);
@@ -646,33 +1831,35 @@ namespace opacity::ui
             // Arrow key navigation
             if (ImGui::IsKeyPressed(ImGuiKey_UpArrow) && focused_index_ > 0)
             {
-                if (!io.KeyShift)
-                    SelectNone();
                 --focused_index_;
-                SetSelection(static_cast<size_t>(focused_index_), true);
+                if (io.KeyShift)
+                    SetSelection(static_cast<size_t>(focused_index_), true);
+                else
+                    SelectRange(static_cast<size_t>(focused_index_), static_cast<size_t>(focused_index_));
             }
-            else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow) && focused_index_ < static_cast<int>(items_.size()) - 1)
+            else if (ImGui::IsKeyPressed(ImGuiKey_DownArrow) && focused_index_ < static_cast<int>(order_.size()) - 1)
             {
-                if (!io.KeyShift)
-                    SelectNone();
                 ++focused_index_;
-                SetSelection(static_cast<size_t>(focused_index_), true);
+                if (io.KeyShift)
+                    SetSelection(static_cast<size_t>(focused_index_), true);
+                else
+                    SelectRange(static_cast<size_t>(focused_index_), static_cast<size_t>(focused_index_));
             }
             else if (ImGui::IsKeyPressed(ImGuiKey_Home))
             {
                 if (!io.KeyShift)
                     SelectNone();
                 focused_index_ = 0;
-                if (!items_.empty())
+                if (!order_.empty())
                     SetSelection(0, true);
             }
             else if (ImGui::IsKeyPressed(ImGuiKey_End))
             {
                 if (!io.KeyShift)
                     SelectNone();
-                focused_index_ = static_cast<int>(items_.size()) - 1;
-                if (!items_.empty())
-                    SetSelection(items_.size() - 1, true);
+                focused_index_ = static_cast<int>(order_.size()) - 1;
+                if (!order_.empty())
+                    SetSelection(order_.size() - 1, true);
             }
             else if (ImGui::IsKeyPressed(ImGuiKey_Enter))
             {
@@ -689,6 +1876,14 @@ namespace opacity::ui
             {
                 SelectAll();
             }
+            else if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_C))
+            {
+                CopySelectionToClipboard(false);
+            }
+            else if (io.KeyCtrl && ImGui::IsKeyPressed(ImGuiKey_X))
+            {
+                CopySelectionToClipboard(true);
+            }
         }
     }
 
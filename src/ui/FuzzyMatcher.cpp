@@ -0,0 +1,187 @@
+#include "opacity/ui/FuzzyMatcher.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        // Checked this often while filtering, so a cancelled search stops soon
+        constexpr size_t kCancelCheckInterval = 4096;
+
+        inline bool HasAll(uint64_t mask, uint64_t required)
+        {
+            return (mask & required) == required;
+        }
+
+        inline bool Better(const FuzzyMatcher::Hit& a, const FuzzyMatcher::Hit& b)
+        {
+            return a.score != b.score ? a.score > b.score : a.entry < b.entry;
+        }
+    }
+
+    uint32_t FuzzyMatcher::Add(std::string_view label, std::string_view description,
+                               const std::vector<std::string>& keywords, int bonus)
+    {
+        Entry entry;
+        entry.label = Lower(label);
+        entry.description = Lower(description);
+        for (const auto& keyword : keywords)
+        {
+            if (!entry.keywords.empty())
+                entry.keywords += '\n';
+            entry.keywords += Lower(keyword);
+        }
+        entry.label_mask = CharMask(entry.label);
+        entry.description_mask = CharMask(entry.description);
+        entry.keyword_mask = CharMask(entry.keywords);
+        entry.bonus = bonus;
+
+        entries_.push_back(std::move(entry));
+        return static_cast<uint32_t>(entries_.size() - 1);
+    }
+
+    std::string FuzzyMatcher::Lower(std::string_view text)
+    {
+        std::string lower(text);
+        for (auto& c : lower)
+            c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        return lower;
+    }
+
+    uint64_t FuzzyMatcher::CharMask(std::string_view lower)
+    {
+        // Letters and digits get a bit each; anything else shares the rest
+        uint64_t mask = 0;
+        for (char ch : lower)
+        {
+            auto c = static_cast<unsigned char>(ch);
+            unsigned bit;
+            if (c >= 'a' && c <= 'z')
+                bit = c - 'a';
+            else if (c >= '0' && c <= '9')
+                bit = 26 + (c - '0');
+            else
+                bit = 36 + c % 28;
+            mask |= uint64_t{1} << bit;
+        }
+        return mask;
+    }
+
+    int FuzzyMatcher::Score(uint32_t index, std::string_view query, uint64_t query_mask,
+                            std::vector<size_t>* matched) const
+    {
+        const Entry& entry = entries_[index];
+        if (query.empty() || !HasAll(entry.label_mask | entry.description_mask | entry.keyword_mask, query_mask))
+            return 0;
+
+        int score = 0;
+        if (HasAll(entry.label_mask, query_mask))
+        {
+            score = SubsequenceScore(entry.label, query, matched);
+            if (score > 0)
+            {
+                // Boost exact prefix matches, then word boundary matches
+                if (std::string_view(entry.label).substr(0, query.size()) == query)
+                    score += 100;
+                else if (entry.label.find(" " + std::string(query)) != std::string::npos)
+                    score += 50;
+            }
+        }
+
+        // Lower weight for description matches
+        if (score == 0 && HasAll(entry.description_mask, query_mask))
+            score = SubsequenceScore(entry.description, query, nullptr) / 2;
+
+        if (score == 0 && HasAll(entry.keyword_mask, query_mask) &&
+            entry.keywords.find(query) != std::string::npos)
+            score = 30;
+
+        return score > 0 ? score + entry.bonus : 0;
+    }
+
+    bool FuzzyMatcher::Filter(std::string_view query, const std::vector<uint32_t>& candidates,
+                              std::vector<Hit>& hits, const std::atomic<bool>* cancel) const
+    {
+        uint64_t query_mask = CharMask(query);
+        for (size_t i = 0; i < candidates.size(); ++i)
+        {
+            if (cancel && i % kCancelCheckInterval == 0 && cancel->load(std::memory_order_relaxed))
+                return false;
+
+            int score = Score(candidates[i], query, query_mask);
+            if (score > 0)
+                hits.push_back(Hit{candidates[i], score});
+        }
+        return true;
+    }
+
+    void FuzzyMatcher::SelectTop(std::vector<Hit>& hits, size_t count)
+    {
+        // Linear to find the top, then only those are sorted
+        count = std::min(count, hits.size());
+        if (count < hits.size())
+            std::nth_element(hits.begin(), hits.begin() + count, hits.end(), Better);
+        std::sort(hits.begin(), hits.begin() + count, Better);
+    }
+
+    int FuzzyMatcher::SubsequenceScore(std::string_view text, std::string_view query, std::vector<size_t>* matched)
+    {
+        if (query.empty() || text.size() < query.size())
+            return 0;
+
+        if (matched)
+            matched->clear();
+        int score = 0;
+        size_t query_idx = 0;
+        size_t prev_match_idx = std::string::npos;
+        bool prev_was_match = false;
+
+        for (size_t i = 0; i < text.size() && query_idx < query.size(); ++i)
+        {
+            if (text[i] == query[query_idx])
+            {
+                if (matched)
+                    matched->push_back(i);
+
+                // Base score for match
+                score += 10;
+
+                // Bonus for consecutive matches
+                if (prev_was_match && prev_match_idx + 1 == i)
+                {
+                    score += 15;
+                }
+
+                // Bonus for matching at word boundary
+                if (i == 0 || !std::isalnum(static_cast<unsigned char>(text[i - 1])))
+                {
+                    score += 20;
+                }
+
+                prev_match_idx = i;
+                prev_was_match = true;
+                ++query_idx;
+            }
+            else
+            {
+                prev_was_match = false;
+            }
+        }
+
+        // Only return score if all query characters matched
+        if (query_idx < query.size())
+        {
+            if (matched)
+                matched->clear();
+            return 0;
+        }
+
+        // Bonus for shorter strings (more specific matches)
+        score += std::max(0, 50 - static_cast<int>(text.size()));
+
+        return score;
+    }
+
+} // namespace opacity::ui
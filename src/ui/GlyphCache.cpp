@@ -0,0 +1,210 @@
+#include "opacity/ui/GlyphCache.h"
+#include "opacity/core/Logger.h"
+
+#include <algorithm>
+#include <filesystem>
+#include <system_error>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        // Baked at startup: Latin-1, and the replacement character ImGui
+        // draws for anything missing
+        constexpr ImWchar kBaseRanges[] = { 0x0020, 0x00FF, 0xFFFD, 0xFFFD, 0 };
+
+        bool InBase(uint32_t codepoint)
+        {
+            return (codepoint >= 0x0020 && codepoint <= 0x00FF) || codepoint == 0xFFFD;
+        }
+
+        bool FileExists(const std::string& path)
+        {
+            std::error_code ec;
+            return !path.empty() && std::filesystem::is_regular_file(std::filesystem::u8path(path), ec);
+        }
+
+        // Next codepoint of text from i, or 0 past an invalid sequence
+        uint32_t DecodeUtf8(std::string_view text, size_t& i)
+        {
+            auto byte = [&](size_t at) { return static_cast<unsigned char>(text[at]); };
+            unsigned char lead = byte(i++);
+            size_t extra;
+            uint32_t codepoint;
+            if ((lead & 0xE0) == 0xC0) { extra = 1; codepoint = lead & 0x1F; }
+            else if ((lead & 0xF0) == 0xE0) { extra = 2; codepoint = lead & 0x0F; }
+            else if ((lead & 0xF8) == 0xF0) { extra = 3; codepoint = lead & 0x07; }
+            else return 0;
+
+            for (size_t n = 0; n < extra; ++n, ++i)
+            {
+                if (i >= text.size() || (byte(i) & 0xC0) != 0x80)
+                    return 0;
+                codepoint = (codepoint << 6) | (byte(i) & 0x3F);
+            }
+            return codepoint;
+        }
+    }
+
+    GlyphCache::GlyphCache()
+    {
+        memory_ = core::MemoryGovernor::Get().Register(
+            "Font atlas",
+            [this] { return atlas_bytes_.load(); },
+            [this](size_t target_bytes) { shrink_to_ = target_bytes; });
+    }
+
+    void GlyphCache::SetFonts(const std::string& primary, const std::vector<std::string>& fallbacks, float size)
+    {
+        primary_ = FileExists(primary) ? primary : std::string();
+        fallbacks_.clear();
+        for (const auto& path : fallbacks)
+        {
+            if (FileExists(path))
+                fallbacks_.push_back(path);
+        }
+        size_ = size;
+        fonts_dirty_ = true;
+
+        // Keep the mappings the new set still uses
+        for (auto it = font_files_.begin(); it != font_files_.end();)
+        {
+            bool used = it->first == primary_ ||
+                        std::find(fallbacks_.begin(), fallbacks_.end(), it->first) != fallbacks_.end();
+            it = used ? std::next(it) : font_files_.erase(it);
+        }
+    }
+
+    const core::MappedFile* GlyphCache::FontFile(const std::string& path)
+    {
+        auto it = font_files_.find(path);
+        if (it == font_files_.end())
+        {
+            core::MappedFile file;
+            if (!file.Open(std::filesystem::u8path(path)))
+                SPDLOG_WARN("Cannot map font {}", path);
+            it = font_files_.emplace(path, std::move(file)).first;
+        }
+        return it->second.IsOpen() ? &it->second : nullptr;
+    }
+
+    void GlyphCache::AddFont(ImFontAtlas& atlas, const core::MappedFile& file, ImFontConfig& config)
+    {
+        // The atlas only reads the data, and the mapping outlives it
+        config.FontDataOwnedByAtlas = false;
+        atlas.AddFontFromMemoryTTF(const_cast<uint8_t*>(file.Data()), static_cast<int>(file.Size()),
+                                   size_, &config, ranges_.data());
+    }
+
+    void GlyphCache::Note(std::string_view utf8)
+    {
+        for (size_t i = 0; i < utf8.size();)
+        {
+            // Most names are ASCII, which is always baked
+            if (static_cast<unsigned char>(utf8[i]) < 0x80)
+            {
+                ++i;
+                continue;
+            }
+
+            NoteCodepoint(DecodeUtf8(utf8, i));
+        }
+    }
+
+    void GlyphCache::NoteCodepoint(uint32_t codepoint)
+    {
+        if (codepoint == 0 || codepoint > IM_UNICODE_CODEPOINT_MAX || InBase(codepoint) || Known(codepoint))
+            return;
+
+        size_t word = codepoint >> 6;
+        if (word >= known_.size())
+            known_.resize(word + 1, 0);
+        known_[word] |= uint64_t{1} << (codepoint & 63);
+        codepoints_.push_back(codepoint);
+    }
+
+    void GlyphCache::Shrink(size_t target_bytes)
+    {
+        size_t bytes = atlas_bytes_.load();
+        if (bytes <= target_bytes || codepoints_.empty())
+            return;
+
+        // Keep the most recently seen share; the base ranges always stay
+        size_t keep = static_cast<size_t>(static_cast<double>(codepoints_.size()) * target_bytes / bytes);
+        codepoints_.erase(codepoints_.begin(), codepoints_.end() - static_cast<ptrdiff_t>(keep));
+        std::fill(known_.begin(), known_.end(), 0);
+        for (uint32_t codepoint : codepoints_)
+            known_[codepoint >> 6] |= uint64_t{1} << (codepoint & 63);
+
+        built_count_ = 0;
+        fonts_dirty_ = true;
+        SPDLOG_DEBUG("Font atlas shrinking to {} extra glyphs", codepoints_.size());
+    }
+
+    bool GlyphCache::Update(ImFontAtlas& atlas)
+    {
+        size_t shrink_to = shrink_to_.exchange(SIZE_MAX);
+        if (shrink_to != SIZE_MAX)
+            Shrink(shrink_to);
+
+        if (!IsPending())
+            return false;
+
+        // Font changes apply at once; new characters wait for the interval,
+        // so a folder of them costs one rebuild rather than one per frame
+        auto now = std::chrono::steady_clock::now();
+        if (!fonts_dirty_ && now - last_build_ < kRebuildInterval)
+            return false;
+
+        ImFontGlyphRangesBuilder builder;
+        builder.AddRanges(kBaseRanges);
+        for (uint32_t codepoint : codepoints_)
+            builder.AddChar(static_cast<ImWchar>(codepoint));
+        ImVector<ImWchar> ranges;
+        builder.BuildRanges(&ranges);
+        ranges_.assign(ranges.begin(), ranges.end());
+
+        atlas.Clear();
+        ImFontConfig config;
+        const core::MappedFile* primary = primary_.empty() ? nullptr : FontFile(primary_);
+        if (!primary)
+        {
+            config.GlyphRanges = ranges_.data();
+            atlas.AddFontDefault(&config);
+        }
+        else
+        {
+            AddFont(atlas, *primary, config);
+        }
+
+        config.MergeMode = true;
+        for (const auto& path : fallbacks_)
+        {
+            if (const core::MappedFile* file = FontFile(path))
+                AddFont(atlas, *file, config);
+        }
+
+        if (!atlas.Build())
+        {
+            SPDLOG_WARN("Failed to build font atlas from {}; using the default font", primary_);
+            atlas.Clear();
+            atlas.AddFontDefault();
+            atlas.Build();
+        }
+
+        built_count_ = codepoints_.size();
+        fonts_dirty_ = false;
+        atlas_bytes_ = static_cast<size_t>(atlas.TexWidth) * static_cast<size_t>(atlas.TexHeight) * 4;
+        last_build_ = now;
+        SPDLOG_DEBUG("Font atlas rebuilt with {} extra glyphs ({}x{})",
+                     built_count_, atlas.TexWidth, atlas.TexHeight);
+        return true;
+    }
+
+    GlyphCache& GetGlyphCache()
+    {
+        static GlyphCache cache;
+        return cache;
+    }
+
+} // namespace opacity::ui
@@ -1,7 +1,14 @@
 #include "opacity/ui/ImGuiBackend.h"
+#include "opacity/ui/GlyphCache.h"
+#include "opacity/core/BackgroundWork.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
 
 #include <imgui.h>
+#include <d3d10.h>
+#include <dxgi1_3.h>
+
+#include <algorithm>
 
 // ImGui Win32 + DX11 implementation (embedded since vcpkg imgui doesn't include backends)
 // Based on imgui_impl_win32.h and imgui_impl_dx11.h
@@ -266,6 +273,54 @@ static void ImGui_ImplDX11_NewFrame()
 #include <d3dcompiler.h>
 #pragma comment(lib, "d3dcompiler.lib")
 
+static void ImGui_ImplDX11_CreateFontsTexture(ID3D11Device* device)
+{
+    ImGui_ImplDX11_Data* bd = ImGui_ImplDX11_GetBackendData();
+
+    ImGuiIO& io = ImGui::GetIO();
+    unsigned char* pixels;
+    int width, height;
+    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
+
+    {
+        D3D11_TEXTURE2D_DESC desc = {};
+        desc.Width = width;
+        desc.Height = height;
+        desc.MipLevels = 1;
+        desc.ArraySize = 1;
+        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+        desc.SampleDesc.Count = 1;
+        desc.Usage = D3D11_USAGE_DEFAULT;
+        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+        desc.CPUAccessFlags = 0;
+
+        ID3D11Texture2D* pTexture = nullptr;
+        D3D11_SUBRESOURCE_DATA subResource = {};
+        subResource.pSysMem = pixels;
+        subResource.SysMemPitch = desc.Width * 4;
+        subResource.SysMemSlicePitch = 0;
+        device->CreateTexture2D(&desc, &subResource, &pTexture);
+        if (pTexture)
+        {
+            D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+            srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+            srvDesc.Texture2D.MipLevels = desc.MipLevels;
+            srvDesc.Texture2D.MostDetailedMip = 0;
+            device->CreateShaderResourceView(pTexture, &srvDesc, &bd->pFontTextureView);
+            pTexture->Release();
+        }
+    }
+
+    io.Fonts->SetTexID((ImTextureID)bd->pFontTextureView);
+}
+
+static void ImGui_ImplDX11_DestroyFontsTexture()
+{
+    ImGui_ImplDX11_Data* bd = ImGui_ImplDX11_GetBackendData();
+    if (bd->pFontTextureView) { bd->pFontTextureView->Release(); bd->pFontTextureView = nullptr; ImGui::GetIO().Fonts->SetTexID(0); }
+}
+
 static bool ImGui_ImplDX11_CreateDeviceObjects(ID3D11Device* device, ID3D11DeviceContext* ctx)
 {
     ImGui_ImplDX11_Data* bd = ImGui_ImplDX11_GetBackendData();
@@ -361,43 +416,7 @@ static bool ImGui_ImplDX11_CreateDeviceObjects(ID3D11Device* device, ID3D11Devic
         device->CreateDepthStencilState(&desc, &bd->pDepthStencilState);
     }
 
-    // Create font texture
-    ImGuiIO& io = ImGui::GetIO();
-    unsigned char* pixels;
-    int width, height;
-    io.Fonts->GetTexDataAsRGBA32(&pixels, &width, &height);
-
-    {
-        D3D11_TEXTURE2D_DESC desc = {};
-        desc.Width = width;
-        desc.Height = height;
-        desc.MipLevels = 1;
-        desc.ArraySize = 1;
-        desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-        desc.SampleDesc.Count = 1;
-        desc.Usage = D3D11_USAGE_DEFAULT;
-        desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
-        desc.CPUAccessFlags = 0;
-
-        ID3D11Texture2D* pTexture = nullptr;
-        D3D11_SUBRESOURCE_DATA subResource = {};
-        subResource.pSysMem = pixels;
-        subResource.SysMemPitch = desc.Width * 4;
-        subResource.SysMemSlicePitch = 0;
-        device->CreateTexture2D(&desc, &subResource, &pTexture);
-        if (pTexture)
-        {
-            D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
-            srvDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
-            srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
-            srvDesc.Texture2D.MipLevels = desc.MipLevels;
-            srvDesc.Texture2D.MostDetailedMip = 0;
-            device->CreateShaderResourceView(pTexture, &srvDesc, &bd->pFontTextureView);
-            pTexture->Release();
-        }
-    }
-
-    io.Fonts->SetTexID((ImTextureID)bd->pFontTextureView);
+    ImGui_ImplDX11_CreateFontsTexture(device);
 
     // Create sampler
     {
@@ -423,7 +442,7 @@ static void ImGui_ImplDX11_InvalidateDeviceObjects()
         return;
 
     if (bd->pFontSampler) { bd->pFontSampler->Release(); bd->pFontSampler = nullptr; }
-    if (bd->pFontTextureView) { bd->pFontTextureView->Release(); bd->pFontTextureView = nullptr; ImGui::GetIO().Fonts->SetTexID(0); }
+    ImGui_ImplDX11_DestroyFontsTexture();
     if (bd->pIB) { bd->pIB->Release(); bd->pIB = nullptr; }
     if (bd->pVB) { bd->pVB->Release(); bd->pVB = nullptr; }
     if (bd->pBlendState) { bd->pBlendState->Release(); bd->pBlendState = nullptr; }
@@ -696,6 +715,9 @@ bool ImGuiBackend::Initialize(const std::wstring& title, int width, int height)
         return false;
     }
 
+    // Background threads set this to have a frame drawn
+    wake_event_ = ::CreateEventW(nullptr, FALSE, FALSE, nullptr);
+
     // Show window
     ::ShowWindow(hwnd_, SW_SHOWDEFAULT);
     ::UpdateWindow(hwnd_);
@@ -737,6 +759,12 @@ void ImGuiBackend::Shutdown()
 
     CleanupDeviceD3D();
 
+    if (wake_event_)
+    {
+        ::CloseHandle(wake_event_);
+        wake_event_ = nullptr;
+    }
+
     if (hwnd_)
     {
         ::DestroyWindow(hwnd_);
@@ -752,6 +780,39 @@ bool ImGuiBackend::BeginFrame()
     if (!running_)
         return false;
 
+    // Nothing is seen, so nothing is drawn until the window comes back
+    if (::IsIconic(hwnd_) || !::IsWindowVisible(hwnd_))
+    {
+        frames_due_ = 0;
+        wait_timeout_ = INFINITE;
+        return false;
+    }
+
+    frames_due_ = std::max(frames_due_ - 1, 0);
+    wait_timeout_ = INFINITE;
+
+    // Start once the last frame is on screen, rather than queueing behind it
+    if (frame_latency_waitable_)
+    {
+        OPACITY_PROFILE_ZONE("ImGuiBackend::WaitForFrame");
+        ::WaitForSingleObjectEx(frame_latency_waitable_, 1000, TRUE);
+    }
+
+    // Characters noted last frame join the atlas before this one draws
+    ImGuiIO& io = ImGui::GetIO();
+    for (ImWchar c : io.InputQueueCharacters)
+        GetGlyphCache().NoteCodepoint(c);
+    if (GetGlyphCache().Update(*io.Fonts))
+    {
+        OPACITY_PROFILE_ZONE("ImGuiBackend::UploadFonts");
+        ImGui_ImplDX11_DestroyFontsTexture();
+        ImGui_ImplDX11_CreateFontsTexture(device_.Get());
+    }
+    else if (GetGlyphCache().IsPending())
+    {
+        RequestFrame(GlyphCache::kRebuildInterval);
+    }
+
     // Start the Dear ImGui frame
     ImGui_ImplDX11_NewFrame();
     ImGui_ImplWin32_NewFrame(hwnd_, width_, height_);
@@ -764,16 +825,44 @@ void ImGuiBackend::EndFrame()
 {
     // Rendering
     ImGui::Render();
+
+    // Held buttons repeat and drag without new messages
+    ImGuiIO& io = ImGui::GetIO();
+    if (ImGui::IsAnyMouseDown())
+        RequestFrame();
+    else if (io.WantTextInput)
+        RequestFrame(std::chrono::milliseconds(kTextInputInterval));
     
     device_context_->OMSetRenderTargets(1, main_render_target_view_.GetAddressOf(), nullptr);
     device_context_->ClearRenderTargetView(main_render_target_view_.Get(), clear_color_);
     
-    ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    {
+        OPACITY_PROFILE_ZONE("ImGuiBackend::RenderDrawData");
+        ImGui_ImplDX11_RenderDrawData(ImGui::GetDrawData());
+    }
 
+    OPACITY_PROFILE_ZONE("ImGuiBackend::Present");
     swap_chain_->Present(1, 0); // VSync
 }
 
 bool ImGuiBackend::ProcessMessages()
+{
+    if (!PumpMessages())
+        return false;
+    if (frames_due_ > 0)
+        return running_;
+
+    // Idle: sleep until input, a Wake() or the time asked for
+    ::MsgWaitForMultipleObjectsEx(wake_event_ ? 1 : 0, &wake_event_, wait_timeout_,
+                                  QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+    frames_due_ = std::max(frames_due_, 1);
+
+    if (!PumpMessages())
+        return false;
+    return running_;
+}
+
+bool ImGuiBackend::PumpMessages()
 {
     MSG msg;
     while (::PeekMessage(&msg, nullptr, 0U, 0U, PM_REMOVE))
@@ -785,12 +874,30 @@ bool ImGuiBackend::ProcessMessages()
             running_ = false;
             return false;
         }
+        frames_due_ = kFramesAfterInput;
     }
-    return running_;
+    return true;
+}
+
+void ImGuiBackend::RequestFrame(std::chrono::milliseconds within)
+{
+    if (within.count() <= 0)
+    {
+        frames_due_ = std::max(frames_due_, 1);
+        return;
+    }
+    wait_timeout_ = std::min(wait_timeout_, static_cast<DWORD>(std::min<long long>(within.count(), INFINITE - 1)));
+}
+
+void ImGuiBackend::Wake()
+{
+    if (wake_event_)
+        ::SetEvent(wake_event_);
 }
 
 bool ImGuiBackend::CreateDeviceD3D()
 {
+    // Flip model with a waitable frame latency object, Windows 10 and later
     DXGI_SWAP_CHAIN_DESC sd = {};
     sd.BufferCount = 2;
     sd.BufferDesc.Width = 0;
@@ -798,16 +905,17 @@ bool ImGuiBackend::CreateDeviceD3D()
     sd.BufferDesc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
     sd.BufferDesc.RefreshRate.Numerator = 60;
     sd.BufferDesc.RefreshRate.Denominator = 1;
-    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+    sd.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH | DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT;
     sd.BufferUsage = DXGI_USAGE_RENDER_TARGET_OUTPUT;
     sd.OutputWindow = hwnd_;
     sd.SampleDesc.Count = 1;
     sd.SampleDesc.Quality = 0;
     sd.Windowed = TRUE;
-    sd.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+    sd.SwapEffect = DXGI_SWAP_EFFECT_FLIP_DISCARD;
 
-    // Try without debug layer first (more compatible)
-    UINT createDeviceFlags = 0;
+    // Try without debug layer first (more compatible). Video support lets
+    // Media Foundation decode straight into textures on this device.
+    UINT createDeviceFlags = D3D11_CREATE_DEVICE_VIDEO_SUPPORT;
 
     D3D_FEATURE_LEVEL featureLevel;
     const D3D_FEATURE_LEVEL featureLevelArray[4] = { 
@@ -816,22 +924,46 @@ bool ImGuiBackend::CreateDeviceD3D()
         D3D_FEATURE_LEVEL_10_1, 
         D3D_FEATURE_LEVEL_10_0 
     };
-    
-    HRESULT hr = D3D11CreateDeviceAndSwapChain(
-        nullptr, D3D_DRIVER_TYPE_HARDWARE, nullptr, createDeviceFlags,
-        featureLevelArray, 4, D3D11_SDK_VERSION, &sd,
-        swap_chain_.GetAddressOf(), device_.GetAddressOf(),
-        &featureLevel, device_context_.GetAddressOf());
 
-    // If hardware failed, try WARP software renderer
-    if (FAILED(hr))
+    auto create = [&](D3D_DRIVER_TYPE driver)
     {
-        SPDLOG_WARN("Hardware D3D11 device creation failed, trying WARP driver");
-        hr = D3D11CreateDeviceAndSwapChain(
-            nullptr, D3D_DRIVER_TYPE_WARP, nullptr, createDeviceFlags,
+        HRESULT result = D3D11CreateDeviceAndSwapChain(
+            nullptr, driver, nullptr, createDeviceFlags,
             featureLevelArray, 4, D3D11_SDK_VERSION, &sd,
             swap_chain_.GetAddressOf(), device_.GetAddressOf(),
             &featureLevel, device_context_.GetAddressOf());
+        if (SUCCEEDED(result) || sd.SwapEffect != DXGI_SWAP_EFFECT_FLIP_DISCARD)
+            return result;
+
+        // Older Windows has only the blt model
+        DXGI_SWAP_CHAIN_DESC legacy = sd;
+        legacy.SwapEffect = DXGI_SWAP_EFFECT_DISCARD;
+        legacy.Flags = DXGI_SWAP_CHAIN_FLAG_ALLOW_MODE_SWITCH;
+        result = D3D11CreateDeviceAndSwapChain(
+            nullptr, driver, nullptr, createDeviceFlags,
+            featureLevelArray, 4, D3D11_SDK_VERSION, &legacy,
+            swap_chain_.GetAddressOf(), device_.GetAddressOf(),
+            &featureLevel, device_context_.GetAddressOf());
+        if (SUCCEEDED(result))
+            sd = legacy;
+        return result;
+    };
+
+    HRESULT hr = create(D3D_DRIVER_TYPE_HARDWARE);
+
+    // Not every driver offers video support
+    if (FAILED(hr))
+    {
+        SPDLOG_WARN("D3D11 device creation with video support failed, retrying without it");
+        createDeviceFlags = 0;
+        hr = create(D3D_DRIVER_TYPE_HARDWARE);
+    }
+
+    // If hardware failed, try WARP software renderer
+    if (FAILED(hr))
+    {
+        SPDLOG_WARN("Hardware D3D11 device creation failed, trying WARP driver");
+        hr = create(D3D_DRIVER_TYPE_WARP);
     }
 
     if (FAILED(hr))
@@ -840,7 +972,23 @@ bool ImGuiBackend::CreateDeviceD3D()
         return false;
     }
 
+    // Resizing has to keep the flags the chain was made with
+    swap_chain_flags_ = sd.Flags;
+    Microsoft::WRL::ComPtr<IDXGISwapChain2> swap_chain2;
+    if ((sd.Flags & DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT) && SUCCEEDED(swap_chain_.As(&swap_chain2)))
+    {
+        swap_chain2->SetMaximumFrameLatency(1);
+        frame_latency_waitable_ = swap_chain2->GetFrameLatencyWaitableObject();
+    }
+    SPDLOG_INFO("Swap chain uses the {} model", sd.SwapEffect == DXGI_SWAP_EFFECT_FLIP_DISCARD ? "flip" : "blt");
+
     SPDLOG_INFO("D3D11 device created successfully (Feature Level: 0x{:X})", (int)featureLevel);
+
+    // Video decoders share the device from their own threads
+    Microsoft::WRL::ComPtr<ID3D10Multithread> multithread;
+    if (SUCCEEDED(device_.As(&multithread)))
+        multithread->SetMultithreadProtected(TRUE);
+
     CreateRenderTarget();
     return true;
 }
@@ -848,6 +996,11 @@ bool ImGuiBackend::CreateDeviceD3D()
 void ImGuiBackend::CleanupDeviceD3D()
 {
     CleanupRenderTarget();
+    if (frame_latency_waitable_)
+    {
+        ::CloseHandle(frame_latency_waitable_);
+        frame_latency_waitable_ = nullptr;
+    }
     swap_chain_.Reset();
     device_context_.Reset();
     device_.Reset();
@@ -878,7 +1031,7 @@ void ImGuiBackend::HandleResize(int width, int height)
     height_ = height;
     
     CleanupRenderTarget();
-    swap_chain_->ResizeBuffers(0, (UINT)width, (UINT)height, DXGI_FORMAT_UNKNOWN, 0);
+    swap_chain_->ResizeBuffers(0, (UINT)width, (UINT)height, DXGI_FORMAT_UNKNOWN, swap_chain_flags_);
     CreateRenderTarget();
 }
 
@@ -897,6 +1050,14 @@ LRESULT WINAPI ImGuiBackend::WndProc(HWND hWnd, UINT msg, WPARAM wParam, LPARAM
         backend = reinterpret_cast<ImGuiBackend*>(GetWindowLongPtr(hWnd, GWLP_USERDATA));
     }
 
+    // Clicks, wheel and keys hold off background scans for a moment;
+    // the pointer merely passing over the window does not
+    if ((msg >= WM_KEYFIRST && msg <= WM_KEYLAST) ||
+        (msg > WM_MOUSEMOVE && msg <= WM_MOUSELAST))
+    {
+        core::ForegroundActivity::NoteInput();
+    }
+
     if (ImGui_ImplWin32_WndProcHandler(hWnd, msg, wParam, lParam))
         return true;
 
@@ -1,13 +1,33 @@
 #include "opacity/ui/LayoutManager.h"
+#include "opacity/core/CrashRecovery.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/SessionManager.h"
+#include "opacity/filesystem/DirectoryCache.h"
 
 #include <imgui.h>
 #include <algorithm>
+#include <cstdlib>
+#include <filesystem>
 
 namespace opacity::ui
 {
-    LayoutManager::LayoutManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager)
+    namespace
+    {
+        // Sessions may save selections as full paths; panes restore names
+        std::string ItemName(const std::string& item)
+        {
+            return std::filesystem::u8path(item).filename().u8string();
+        }
+    }
+
+    LayoutManager::LayoutManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager,
+                                 std::shared_ptr<preview::ThumbnailService> thumbnails,
+                                 std::shared_ptr<search::FolderSizeService> folder_sizes,
+                                 std::shared_ptr<preview::IconService> icons)
         : fs_manager_(std::move(fs_manager))
+        , thumbnails_(std::move(thumbnails))
+        , folder_sizes_(std::move(folder_sizes))
+        , icons_(std::move(icons))
     {
         SPDLOG_DEBUG("LayoutManager created");
     }
@@ -17,15 +37,156 @@ namespace opacity::ui
         SPDLOG_DEBUG("LayoutManager destroyed");
     }
 
+    std::unique_ptr<TabManager> LayoutManager::CreateTabManager() const
+    {
+        auto tabs = std::make_unique<TabManager>(fs_manager_, thumbnails_, folder_sizes_, icons_);
+        tabs->SetRedrawCallback(on_redraw_);
+        return tabs;
+    }
+
+    void LayoutManager::SetRedrawCallback(FilePane::RedrawCallback callback)
+    {
+        on_redraw_ = std::move(callback);
+        for (auto& pane : panes_)
+        {
+            if (pane)
+                pane->SetRedrawCallback(on_redraw_);
+        }
+    }
+
     void LayoutManager::Initialize(const std::string& initial_path)
     {
         // Create the first pane
-        panes_[0] = std::make_unique<TabManager>(fs_manager_);
+        panes_[0] = CreateTabManager();
         panes_[0]->CreateTab(initial_path);
         
         SPDLOG_INFO("LayoutManager initialized with single pane layout");
     }
 
+    void LayoutManager::RestoreSession(const core::Session& session)
+    {
+        std::vector<std::vector<TabStub>> panes;
+        std::vector<size_t> active;
+        for (const auto& pane : session.panes)
+        {
+            if (panes.size() == MAX_PANES)
+                break;
+
+            std::vector<TabStub> tabs;
+            size_t active_tab = static_cast<size_t>(std::max(0, pane.activeTabIndex));
+            for (const auto& saved : pane.tabs)
+            {
+                if (saved.isActive)
+                    active_tab = tabs.size();
+
+                TabStub stub;
+                stub.path = saved.path;
+                stub.title = saved.displayName;
+                for (const auto& item : saved.selectedItems)
+                    stub.selected_names.push_back(ItemName(item));
+                if (!saved.scrollPosition.empty())
+                    stub.scroll_y = std::strtof(saved.scrollPosition.c_str(), nullptr);
+                tabs.push_back(std::move(stub));
+            }
+            panes.push_back(std::move(tabs));
+            active.push_back(active_tab);
+        }
+        RestorePanes(panes, active);
+    }
+
+    void LayoutManager::RestoreSession(const core::SessionState& state)
+    {
+        // Crash recovery keeps the open tabs of one pane, and the other
+        // pane only by its path
+        std::vector<std::vector<TabStub>> panes(1);
+        for (const auto& path : state.openTabs)
+        {
+            TabStub stub;
+            stub.path = path.u8string();
+            panes[0].push_back(std::move(stub));
+        }
+        if (panes[0].empty() && !state.leftPanelPath.empty())
+        {
+            TabStub stub;
+            stub.path = state.leftPanelPath.u8string();
+            panes[0].push_back(std::move(stub));
+        }
+
+        size_t active_tab = static_cast<size_t>(std::max(0, state.activeTabIndex));
+        if (active_tab < panes[0].size())
+        {
+            for (const auto& item : state.selectedItems)
+                panes[0][active_tab].selected_names.push_back(item.filename().u8string());
+        }
+
+        if (!state.rightPanelPath.empty())
+        {
+            TabStub stub;
+            stub.path = state.rightPanelPath.u8string();
+            panes.push_back({std::move(stub)});
+        }
+        RestorePanes(panes, {active_tab, 0});
+    }
+
+    void LayoutManager::RestorePanes(const std::vector<std::vector<TabStub>>& panes, const std::vector<size_t>& active)
+    {
+        size_t count = std::clamp<size_t>(panes.size(), 1, MAX_PANES);
+        size_t tab_count = 0;
+        for (size_t i = 0; i < MAX_PANES; ++i)
+        {
+            if (i >= count)
+            {
+                panes_[i].reset();
+                continue;
+            }
+
+            if (!panes_[i])
+                panes_[i] = CreateTabManager();
+            panes_[i]->RestoreTabs(i < panes.size() ? panes[i] : std::vector<TabStub>(),
+                                   i < active.size() ? active[i] : 0);
+            tab_count += panes_[i]->GetTabCount();
+        }
+
+        switch (count)
+        {
+        case 1: layout_ = LayoutType::Single; break;
+        case 2: layout_ = LayoutType::DualHorizontal; break;
+        case 3: layout_ = LayoutType::TripleLeft; break;
+        default: layout_ = LayoutType::Quad; break;
+        }
+        focused_pane_ = 0;
+
+        // Background tabs next to the active ones are the likeliest to be
+        // opened; the cache takes only its prefetch limit, so order matters.
+        // Active tabs read themselves when drawn, so they are left out
+        std::vector<core::Path> directories;
+        for (size_t distance = 1; directories.size() < tab_count; ++distance)
+        {
+            bool any = false;
+            for (size_t i = 0; i < count; ++i)
+            {
+                const auto& tabs = panes_[i]->GetTabs();
+                size_t centre = std::min(panes_[i]->GetActiveTabIndex(), tabs.size() - 1);
+                if (distance < tabs.size())
+                    any = true;
+                if (centre + distance < tabs.size())
+                    directories.emplace_back(tabs[centre + distance].pane->GetCurrentPath());
+                if (distance <= centre)
+                    directories.emplace_back(tabs[centre - distance].pane->GetCurrentPath());
+            }
+            if (!any)
+                break;
+        }
+
+        if (!directories.empty())
+        {
+            filesystem::EnumerationOptions options;
+            options.include_hidden = panes_[0]->GetTabs().front().pane->GetShowHidden();
+            fs_manager_->GetListingCache().Prefetch(directories, options);
+        }
+        SPDLOG_INFO("Restored session: {} panes, {} tabs, {} read ahead", count, tab_count, directories.size());
+    }
+
     void LayoutManager::SetLayout(LayoutType layout)
     {
         if (layout_ == layout)
@@ -496,7 +657,7 @@ namespace opacity::ui
         {
             if (!panes_[i])
             {
-                panes_[i] = std::make_unique<TabManager>(fs_manager_);
+                panes_[i] = CreateTabManager();
                 
                 // Copy path from first pane if available
                 std::string path;
@@ -1,6 +1,18 @@
 #include "opacity/ui/MainWindow.h"
+#include "opacity/batch/BatchRename.h"
+#include "opacity/core/Config.h"
 #include "opacity/core/Logger.h"
+#include "opacity/core/MemoryGovernor.h"
+#include "opacity/core/Metrics.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/ShellIntegration.h"
+#include "opacity/core/StartupProfile.h"
 #include "opacity/core/Path.h"
+#include "opacity/filesystem/DirectoryCache.h"
+#include "opacity/filesystem/DriveService.h"
+#include "opacity/ui/PrefetchEngine.h"
+#include "opacity/ui/ResidentService.h"
+#include "opacity/ui/ShellSelection.h"
 
 #include <imgui.h>
 #include "opacity/ui/ImGuiScoped.h"
@@ -10,6 +22,9 @@
 #include <shellapi.h>
 
 #include <algorithm>
+#include <chrono>
+#include <climits>
+#include <numeric>
 
 namespace opacity::ui
 {
@@ -17,22 +32,92 @@ namespace opacity::ui
 // Use alias to avoid any potential naming conflicts
 using FsPath = opacity::core::Path;
 
+// Files either side of the selection whose previews are decoded ahead
+constexpr int kPreviewPrefetchDistance = 2;
+
+// Progress of long work is redrawn this often while nothing else happens
+constexpr std::chrono::milliseconds kProgressInterval(100);
+
+// Walk searches stop here (search.max_results); the resident index answers fewer
+constexpr size_t kMaxSearchResults = 500000;
+constexpr size_t kMaxResidentResults = 20000;
+
+// Theme color for a highlighted run of text (0xRRGGBBAA)
+static ImVec4 SyntaxColor(const ColorScheme& scheme, preview::TokenKind kind)
+{
+    unsigned int color = scheme.foreground;
+    switch (kind)
+    {
+    case preview::TokenKind::Keyword: color = scheme.syntax_keyword; break;
+    case preview::TokenKind::String: color = scheme.syntax_string; break;
+    case preview::TokenKind::Comment: color = scheme.syntax_comment; break;
+    case preview::TokenKind::Number: color = scheme.syntax_number; break;
+    case preview::TokenKind::Preprocessor: color = scheme.syntax_preprocessor; break;
+    default: break;
+    }
+    return ImVec4(((color >> 24) & 0xFF) / 255.0f, ((color >> 16) & 0xFF) / 255.0f,
+                  ((color >> 8) & 0xFF) / 255.0f, (color & 0xFF) / 255.0f);
+}
+
+// The main list holds FsItems; the shell gets a store of just the selected ones
+static std::shared_ptr<SelectionFileSource> SelectedFileSource(const std::vector<filesystem::FsItem>& items,
+                                                              const std::vector<bool>& selected,
+                                                              const std::string& directory)
+{
+    filesystem::ItemStore store;
+    store.Reset(directory);
+    for (size_t i = 0; i < items.size() && i < selected.size(); ++i)
+    {
+        if (selected[i])
+            store.Add(items[i]);
+    }
+    if (store.Empty())
+        return nullptr;
+
+    SelectionSet selection;
+    selection.Reset(store.Count());
+    selection.SelectAll();
+    std::vector<filesystem::ItemStore::Index> order(store.Count());
+    std::iota(order.begin(), order.end(), 0u);
+    return std::make_shared<SelectionFileSource>(std::move(store), std::move(selection), std::move(order));
+}
+
 MainWindow::MainWindow()
     : backend_(std::make_unique<ImGuiBackend>())
     , fs_manager_(std::make_unique<filesystem::FileSystemManager>())
     , preview_manager_(std::make_unique<preview::PreviewManager>())
+    , texture_manager_(std::make_unique<preview::TextureManager>())
+    , thumbnail_service_(std::make_shared<preview::ThumbnailService>())
+    , icon_service_(std::make_shared<preview::IconService>())
+    , folder_size_service_(std::make_shared<search::FolderSizeService>())
     , search_engine_(std::make_unique<search::SearchEngine>())
     , keybind_manager_(std::make_unique<KeybindManager>())
     , current_theme_(std::make_unique<Theme>())
     , advanced_search_dialog_(std::make_unique<AdvancedSearchDialog>())
     , diff_viewer_(std::make_unique<DiffViewer>())
+    , profiler_overlay_(std::make_unique<ProfilerOverlay>())
+    , disk_usage_view_(std::make_unique<DiskUsageView>(folder_size_service_))
+    , crash_recovery_(std::make_unique<core::CrashRecovery>())
+    , session_manager_(std::make_unique<core::SessionManager>())
     , operation_queue_(std::make_unique<filesystem::OperationQueue>())
     , file_watch_(std::make_unique<filesystem::FileWatch>())
 {
     // Create layout manager with shared_ptr version of fs_manager
     auto fs_shared = std::shared_ptr<filesystem::FileSystemManager>(
         fs_manager_.get(), [](filesystem::FileSystemManager*) {}); // Non-owning shared_ptr
-    layout_manager_ = std::make_unique<LayoutManager>(fs_shared);
+    layout_manager_ = std::make_unique<LayoutManager>(fs_shared, thumbnail_service_, folder_size_service_,
+                                                      icon_service_);
+
+    // Listings and watched changes arrive off the UI thread; without a wake
+    // the idle loop would not draw them until the next input
+    layout_manager_->SetRedrawCallback([this]() {
+        if (backend_)
+            backend_->Wake();
+    });
+
+    disk_usage_view_->SetNavigationCallback([this](const std::string& path) {
+        NavigateTo(path);
+    });
 }
 
 MainWindow::~MainWindow()
@@ -44,45 +129,178 @@ bool MainWindow::Initialize()
 {
     SPDLOG_INFO("Initializing MainWindow...");
 
-    if (!backend_->Initialize(L"Opacity - File Manager", 1400, 900))
     {
-        SPDLOG_ERROR("Failed to initialize ImGui backend");
-        return false;
+        OPACITY_STARTUP_PHASE("Window and device");
+        if (!backend_->Initialize(L"Opacity - File Manager", 1400, 900))
+        {
+            SPDLOG_ERROR("Failed to initialize ImGui backend");
+            return false;
+        }
     }
 
-    // Initialize preview manager with D3D11 device
-    preview_manager_->Initialize(backend_->GetDevice());
+    {
+        // Workers start here; the thumbnail cache index loads on them
+        OPACITY_STARTUP_PHASE("Thumbnail service");
+        texture_manager_->Initialize(backend_->GetDevice(), backend_->GetDeviceContext());
+        thumbnail_service_->Initialize(texture_manager_.get());
+        icon_service_->Initialize(texture_manager_.get());
+        GetPrefetchEngine().Attach(fs_manager_.get(), thumbnail_service_);
+    }
 
-    // Set initial path to user's home directory
-    current_path_ = fs_manager_->GetUserHomeDirectory();
-    if (current_path_.empty())
     {
-        current_path_ = "C:\\";
+        // Saved sizes are read by the first measurement, not here
+        OPACITY_STARTUP_PHASE("Folder sizes");
+        folder_size_service_->Initialize();
     }
-    
-    path_history_.push_back(current_path_);
-    history_index_ = 0;
 
-    // Load initial directory
-    RefreshCurrentDirectory();
+    {
+        // Colors only; fonts are built on the first frame
+        OPACITY_STARTUP_PHASE("Theme");
+        current_theme_->Initialize();
+    }
 
-    // Initialize Phase 2 components
-    current_theme_->Initialize();  // Initialize and apply default theme
-    
-    // Try to load saved keybinds
-    keybind_manager_->LoadKeybinds("keybinds.json");
-    
-    // Start file watcher
-    file_watch_->Start();
-    
-    // Set up file watch for current directory
-    auto watch_callback = [this](const filesystem::FileChangeEvent& event) {
-        // Refresh on any file change
-        SPDLOG_DEBUG("File change detected: {} ({})", 
-            event.path.String(), 
-            static_cast<int>(event.type));
-    };
-    current_watch_handle_ = file_watch_->Watch(core::Path(current_path_), watch_callback);
+    {
+        // The first listing is the only file system work before the window shows
+        OPACITY_STARTUP_PHASE("First directory");
+        current_path_ = fs_manager_->GetUserHomeDirectory();
+        if (current_path_.empty())
+        {
+            current_path_ = "C:\\";
+        }
+
+        path_history_.push_back(current_path_);
+        history_index_ = 0;
+        RefreshCurrentDirectory();
+    }
+
+    // The rest waits for the first frame, then runs one step a frame
+    deferred_init_.push_back({"Preview handlers", [this]()
+    {
+        preview_manager_->Initialize(backend_->GetDevice());
+    }});
+    deferred_init_.push_back({"Keybinds", [this]()
+    {
+        keybind_manager_->LoadKeybinds("keybinds.json");
+        keybinds_loaded_ = true;
+    }});
+    deferred_init_.push_back({"File watch", [this]()
+    {
+        file_watch_->Start();
+
+        // Set up file watch for current directory
+        auto watch_callback = [this](const filesystem::FileChangeEvent& event) {
+            // Refresh on any file change
+            OPACITY_LOG_DEBUG(Filesystem, "File change detected: {} ({})", 
+                event.path.String(), 
+                static_cast<int>(event.type));
+            backend_->Wake();
+        };
+        current_watch_handle_ = file_watch_->Watch(core::Path(current_path_), watch_callback);
+    }});
+    deferred_init_.push_back({"Resident index", [this]()
+    {
+        // Started in the background; searches use it once it answers
+        index_client_ = std::make_shared<search::IndexClient>();
+        if (ResidentService::IsEnabled())
+            ResidentService::Launch();
+    }});
+    deferred_init_.push_back({"Memory budget", []()
+    {
+        // memory.budget_mb wins; otherwise a share of installed memory
+        auto& governor = core::MemoryGovernor::Get();
+        if (auto config = core::Config::Get())
+        {
+            int budget_mb = config->Get<int>("memory.budget_mb", 0);
+            if (budget_mb > 0)
+                governor.SetBudget(static_cast<size_t>(budget_mb) * 1024 * 1024);
+            else
+                governor.SetBudgetPercent(config->Get<double>("memory.budget_percent",
+                                                              core::MemoryGovernor::kDefaultBudgetPercent));
+        }
+        governor.Start();
+    }});
+    deferred_init_.push_back({"Navigation history", [this]()
+    {
+        // Read-ahead starts from where the last session left off
+        auto& prefetch = GetPrefetchEngine();
+        prefetch.Load();
+        prefetch.RecordNavigation({}, current_path_);
+        navigation_loaded_ = true;
+    }});
+    deferred_init_.push_back({"Metrics export", []()
+    {
+        // Off unless metrics.export_path is set; the release label lets
+        // exports of different builds be told apart
+        auto config = core::Config::Get();
+        std::string path = config ? config->Get<std::string>("metrics.export_path", "") : std::string();
+        if (path.empty())
+            return;
+
+        auto& metrics = core::Metrics::Get();
+        metrics.SetConstantLabels({{"release", OPACITY_VERSION}});
+        auto interval = std::chrono::seconds(config->Get<int>(
+            "metrics.export_interval_s", static_cast<int>(core::Metrics::kDefaultExportInterval.count())));
+        auto format = config->Get<std::string>("metrics.export_format", "ndjson") == "prometheus"
+                          ? core::MetricsFormat::Prometheus
+                          : core::MetricsFormat::Ndjson;
+        metrics.StartExport(core::Path(path).Get(), interval, format);
+    }});
+    deferred_init_.push_back({"Crash recovery", [this]()
+    {
+        // Copies journal here, so one a crash or a lost share interrupted
+        // picks up where it stopped
+        auto config = core::Config::Get();
+        if (!config || config->GetConfigDir().empty())
+            return;
+
+        core::RecoveryConfig recovery;
+        recovery.recoveryPath = std::filesystem::path(config->GetConfigDir()) / "recovery";
+        if (!crash_recovery_->Initialize(recovery))
+            return;
+        crash_recovery_->StartSession();
+
+        // A rename batch cut short is put back rather than finished
+        for (const auto& pending : crash_recovery_->GetPendingOperations())
+        {
+            batch::BatchRename::RollBackJournal(pending, crash_recovery_.get());
+        }
+        batch::BatchRename::SetDefaultJournal(crash_recovery_.get());
+        crash_recovery_->StartAutoSave();
+
+        operation_queue_->SetJournal(crash_recovery_.get());
+        if (operation_queue_->ResumeJournaled() > 0)
+        {
+            operation_queue_->ProcessQueue();
+            show_operation_progress_ = true;
+        }
+    }});
+    deferred_init_.push_back({"Sessions", [this]()
+    {
+        auto config = core::Config::Get();
+        if (!config || config->GetConfigDir().empty())
+            return;
+        if (!session_manager_->initialize((std::filesystem::path(config->GetConfigDir()) / "sessions.json").string()))
+            return;
+
+        session_manager_->setStateRestorer([this](const core::Session& session) { return RestoreSession(session); });
+        session_manager_->enableAutoSave(true);
+        sessions_loaded_ = true;
+
+        // After a crash, recovery saved more recently than the auto-save
+        std::optional<core::SessionState> crashed;
+        if (crash_recovery_->IsInitialized() && crash_recovery_->DidPreviousSessionCrash())
+            crashed = crash_recovery_->LoadSessionState();
+        if (crashed)
+            RestoreSession(*crashed);
+        else if (session_manager_->getStartupBehavior() == "last")
+            session_manager_->restoreAutoSave();
+        PublishSession();
+    }});
+    deferred_init_.push_back({"Drives", [this]()
+    {
+        // Queried off this thread; a drive answering redraws the panel
+        fs_manager_->GetDriveService().SetChangeCallback([this]() { backend_->Wake(); });
+    }});
 
     running_ = true;
     SPDLOG_INFO("MainWindow initialized successfully. Starting at: {}", current_path_);
@@ -97,6 +315,12 @@ void MainWindow::Shutdown()
     running_ = false;
     
     // Cancel any ongoing search
+    if (resident_search_)
+    {
+        resident_search_->cancel.Cancel();
+        resident_search_->task.Wait();
+        resident_search_.reset();
+    }
     if (search_engine_ && search_engine_->IsSearching())
     {
         search_engine_->CancelSearch();
@@ -109,14 +333,44 @@ void MainWindow::Shutdown()
         file_watch_->Stop();
     }
     
-    // Save keybinds
-    if (keybind_manager_)
+    // Save keybinds, unless quit before they were loaded
+    if (keybind_manager_ && keybinds_loaded_)
     {
         keybind_manager_->SaveKeybinds("keybinds.json");
     }
     
+    // The last place the window was is what the next start opens
+    if (sessions_loaded_)
+    {
+        session_manager_->triggerAutoSave();
+        session_manager_->shutdown();
+    }
+
+    // Rename batches stop journaling before recovery goes with the window
+    batch::BatchRename::SetDefaultJournal(nullptr);
+
+    // Caches unregister as they go; nothing is trimmed from here on
+    core::MemoryGovernor::Get().Stop();
+
+    // A paste after exit still finds the paths
+    core::ShellIntegration::FlushClipboard();
+
+    // Writes the last export
+    core::Metrics::Get().StopExport();
+
+    // Unless quit before it was loaded
+    if (navigation_loaded_)
+        GetPrefetchEngine().Save();
+    GetPrefetchEngine().Detach();
+
     // Release preview resources
     ReleaseCurrentPreview();
+    drawn_thumbnails_.clear();
+    drawn_icons_.clear();
+    thumbnail_service_->Shutdown();
+    icon_service_->Shutdown();
+    texture_manager_->Shutdown();
+    folder_size_service_->Shutdown();
     
     backend_->Shutdown();
     SPDLOG_INFO("MainWindow shutdown complete");
@@ -125,15 +379,26 @@ void MainWindow::Shutdown()
 void MainWindow::Run()
 {
     SPDLOG_INFO("Entering main loop...");
+    core::Profiler::SetThreadName("Main");
 
     while (backend_->IsRunning() && running_)
     {
         if (!backend_->ProcessMessages())
             break;
 
+        // Time asleep waiting for input is not part of a frame
+        OPACITY_PROFILE_ZONE(ProfilerOverlay::kFrameZone);
+
         if (!backend_->BeginFrame())
             continue;
 
+        // Thumbnail uploads queued since last frame, up to the budget
+        texture_manager_->BeginFrame();
+        // Thumbnails nothing asked for last frame are no longer wanted
+        thumbnail_service_->BeginFrame();
+        icon_service_->BeginFrame();
+        folder_size_service_->BeginFrame();
+
         // Create main dockspace
         ImGuiViewport* viewport = ImGui::GetMainViewport();
         ImGui::SetNextWindowPos(viewport->Pos);
@@ -196,7 +461,15 @@ void MainWindow::Run()
         {
             diff_viewer_->Render();
         }
+        profiler_overlay_->Render();
+        disk_usage_view_->Render();
         
+        // Start queued operations as their devices free up
+        if (operation_queue_ && operation_queue_->GetOperationCount() > 0)
+        {
+            operation_queue_->ProcessQueue();
+        }
+
         // Render operation progress using OperationQueue's built-in UI
         if (show_operation_progress_ && operation_queue_)
         {
@@ -208,14 +481,62 @@ void MainWindow::Run()
             ImGui::End();
         }
 
+        // Read ahead where the user may go next, once input settles
+        GetPrefetchEngine().OnIdle(ListingOptions(),
+                                   view_mode_ == 1 ? preview::ThumbnailService::EdgeFor(IconSizePixels()) : 0);
+
+        // Keep drawing while work shown on screen is in flight; otherwise
+        // the backend sleeps until the next input
+        if ((preview_request_ && !preview_request_->IsReady()) ||
+            texture_manager_->GetPendingCount() > 0 || thumbnail_service_->GetQueuedCount() > 0 ||
+            icon_service_->GetQueuedCount() > 0 || search_results_.GetPendingCount() > 0 ||
+            search_results_.GetContextLoadCount() > 0 ||
+            folder_size_service_->GetGeneration() != folder_size_generation_ || disk_usage_view_->IsBusy())
+        {
+            folder_size_generation_ = folder_size_service_->GetGeneration();
+            backend_->RequestFrame();
+        }
+        else if (IsSearching() ||
+                 (operation_queue_ && operation_queue_->GetActiveOperationCount() > 0) ||
+                 folder_size_service_->GetQueuedCount() > 0 || GetPrefetchEngine().HasWork())
+        {
+            backend_->RequestFrame(kProgressInterval);
+        }
+
         backend_->EndFrame();
+
+        if (!interactive_)
+        {
+            interactive_ = true;
+            core::StartupProfile::MarkInteractive();
+        }
+        else if (deferred_next_ < deferred_init_.size())
+        {
+            RunDeferredInit(false);
+        }
+        if (deferred_next_ < deferred_init_.size())
+            backend_->RequestFrame();
     }
 
     SPDLOG_INFO("Exiting main loop");
 }
 
+void MainWindow::RunDeferredInit(bool all)
+{
+    do
+    {
+        const DeferredInit& step = deferred_init_[deferred_next_++];
+        OPACITY_STARTUP_PHASE(step.name, false);
+        step.run();
+    } while (all && deferred_next_ < deferred_init_.size());
+
+    if (deferred_next_ == deferred_init_.size())
+        core::StartupProfile::MarkComplete();
+}
+
 void MainWindow::RenderMenuBar()
 {
+    OPACITY_PROFILE_ZONE("MainWindow::RenderMenuBar");
     if (ImGui::BeginMenuBar())
     {
         HandleFileMenu();
@@ -388,6 +709,22 @@ void MainWindow::HandleViewMenu()
         {
             // Toggle handled by checkbox
         }
+
+        if (ImGui::MenuItem("Profiler", nullptr, profiler_overlay_->IsVisible()))
+        {
+            if (profiler_overlay_->IsVisible())
+                profiler_overlay_->Hide();
+            else
+                profiler_overlay_->Show();
+        }
+
+        if (ImGui::MenuItem("Disk Usage", nullptr, disk_usage_view_->IsVisible()))
+        {
+            if (disk_usage_view_->IsVisible())
+                disk_usage_view_->Hide();
+            else
+                disk_usage_view_->Show(current_path_);
+        }
         
         ImGui::EndMenu();
     }
@@ -437,7 +774,7 @@ void MainWindow::HandleHelpMenu()
         if (ImGui::MenuItem("About Opacity"))
         {
             // Show simple about info in a tooltip-style popup
-            SPDLOG_INFO("Opacity File Manager v1.0.0");
+            SPDLOG_INFO("Opacity File Manager v{}", OPACITY_VERSION);
         }
         
         ImGui::EndMenu();
@@ -554,6 +891,10 @@ void MainWindow::RenderAddressBar()
         }
     }
     if (ImGui::IsItemHovered()) ImGui::SetTooltip("Search files recursively (Enter)");
+
+    ImGui::SameLine();
+    ImGui::Checkbox("Contents", &search_contents_);
+    if (ImGui::IsItemHovered()) ImGui::SetTooltip("Also match files whose contents contain the text (slower)");
     
     ImGui::PopStyleVar();
     ImGui::Separator();
@@ -561,6 +902,10 @@ void MainWindow::RenderAddressBar()
 
 void MainWindow::RenderFilePanel()
 {
+    OPACITY_PROFILE_ZONE("MainWindow::RenderFilePanel");
+    // Last frame's draw list has been rendered by now
+    drawn_icons_.clear();
+
     // Column headers for details view
     if (view_mode_ == 0) // Details view
     {
@@ -602,6 +947,7 @@ void MainWindow::RenderFilePanel()
                     // Re-sort the items
                     filesystem::FsItemComparator comparator(sort_column_, sort_direction_, true);
                     filesystem::FsItemUtils::Sort(current_items_, comparator);
+                    filter_columns_dirty_ = true;
                     
                     sort_specs->SpecsDirty = false;
                 }
@@ -616,29 +962,36 @@ void MainWindow::RenderFilePanel()
             }
             else
             {
+                if (search_active_)
+                {
+                    UpdateFilter();
+                }
+
                 // Render each file item
                 for (size_t i = 0; i < current_items_.size(); ++i)
                 {
                     const auto& item = current_items_[i];
                     
                     // Apply search filter
-                    if (search_active_)
-                    {
-                        std::string lower_name = item.name;
-                        std::string lower_search = search_buffer_;
-                        std::transform(lower_name.begin(), lower_name.end(), 
-                                     lower_name.begin(), ::tolower);
-                        std::transform(lower_search.begin(), lower_search.end(), 
-                                     lower_search.begin(), ::tolower);
-                        if (lower_name.find(lower_search) == std::string::npos)
-                            continue;
-                    }
+                    if (search_active_ && !filter_selection_.Test(i))
+                        continue;
                     
                     ImGui::TableNextRow();
                     
-                    // Name column
+                    // Name column, after the icon
                     ImGui::TableNextColumn();
-                    const char* icon = item.is_directory ? "[DIR] " : "      ";
+                    float icon_edge = ImGui::GetTextLineHeight();
+                    ImVec2 icon_min = ImGui::GetCursorScreenPos();
+                    if (!DrawItemIcon(item, icon_min, icon_edge, preview::IconService::SizeFor(icon_edge)))
+                    {
+                        // Placeholder until it is resolved
+                        float inset = (std::max)(1.0f, icon_edge * 0.15f);
+                        ImU32 icon_color = item.is_directory ? IM_COL32(255, 200, 100, 255) : IM_COL32(200, 200, 200, 255);
+                        ImGui::GetWindowDrawList()->AddRectFilled(ImVec2(icon_min.x + inset, icon_min.y + inset),
+                                                                  ImVec2(icon_min.x + icon_edge - inset, icon_min.y + icon_edge - inset),
+                                                                  icon_color, icon_edge * 0.1f);
+                    }
+                    ImGui::SetCursorScreenPos(ImVec2(icon_min.x + icon_edge + ImGui::GetStyle().ItemInnerSpacing.x, icon_min.y));
                     
                     // Ensure selection vector is sized correctly
                     if (selection_.size() != current_items_.size())
@@ -650,7 +1003,7 @@ void MainWindow::RenderFilePanel()
                     ImGuiSelectableFlags sel_flags = ImGuiSelectableFlags_SpanAllColumns | 
                                                      ImGuiSelectableFlags_AllowDoubleClick;
                     
-                    std::string label = std::string(icon) + item.name + "##" + std::to_string(i);
+                    std::string label = item.name + "##" + std::to_string(i);
                     if (ImGui::Selectable(label.c_str(), selected, sel_flags))
                     {
                         // Handle selection
@@ -728,14 +1081,7 @@ void MainWindow::RenderFilePanel()
     }
     else // Icon view
     {
-        // Calculate icon size based on setting
-        float icon_size_px = 64.0f;
-        switch (icon_size_)
-        {
-        case 0: icon_size_px = 32.0f; break;  // Small
-        case 1: icon_size_px = 64.0f; break;  // Medium
-        case 2: icon_size_px = 128.0f; break; // Large
-        }
+        float icon_size_px = IconSizePixels();
 
         float item_width = icon_size_px + 16.0f;
         float item_height = icon_size_px + 32.0f;
@@ -745,6 +1091,11 @@ void MainWindow::RenderFilePanel()
         ImGui::BeginChild("##IconView", ImVec2(0, 0), false, ImGuiWindowFlags_HorizontalScrollbar);
         bool navigated = false;
 
+        // Last frame's draw list has been rendered by now
+        drawn_thumbnails_.clear();
+        int thumbnail_edge = preview::ThumbnailService::EdgeFor(icon_size_px);
+        preview::IconSize icon_size = preview::IconService::SizeFor(icon_size_px);
+
         for (size_t i = 0; i < current_items_.size(); ++i)
         {
             const auto& item = current_items_[i];
@@ -773,18 +1124,52 @@ void MainWindow::RenderFilePanel()
                 );
             }
 
-            // Draw icon placeholder (folder = yellow, file = gray)
-            ImU32 icon_color = item.is_directory ? IM_COL32(255, 200, 100, 255) : IM_COL32(200, 200, 200, 255);
+            // Only items on screen ask for a thumbnail
             float icon_left = pos.x + (item_width - icon_size_px) / 2 - 4.0f;
-            draw_list->AddRectFilled(
-                ImVec2(icon_left, pos.y),
-                ImVec2(icon_left + icon_size_px, pos.y + icon_size_px),
-                icon_color,
-                4.0f  // Rounded corners
-            );
+            ImVec2 icon_min(icon_left, pos.y);
+            ImVec2 icon_max(icon_left + icon_size_px, pos.y + icon_size_px);
+            preview::ThumbnailPtr thumbnail;
+            bool icon_drawn = false;
+            if (!item.is_directory && ImGui::IsRectVisible(icon_min, icon_max) &&
+                thumbnail_service_->CanThumbnail(item.full_path))
+            {
+                thumbnail = thumbnail_service_->Get(item.full_path, item.modified_time, thumbnail_edge);
+            }
+
+            if (thumbnail && thumbnail->texture && thumbnail->texture->IsResident())
+            {
+                // Fit within the icon square, keeping the aspect ratio
+                float scale = (std::min)(1.0f, icon_size_px / static_cast<float>((std::max)(thumbnail->width, thumbnail->height)));
+                float image_width = thumbnail->width * scale;
+                float image_height = thumbnail->height * scale;
+                ImVec2 image_min(icon_left + (icon_size_px - image_width) / 2, pos.y + (icon_size_px - image_height) / 2);
+                const preview::TextureUv& uv = thumbnail->texture->GetUv();
+                draw_list->AddImage(thumbnail->texture->GetView(), image_min,
+                                    ImVec2(image_min.x + image_width, image_min.y + image_height),
+                                    ImVec2(uv.u0, uv.v0), ImVec2(uv.u1, uv.v1));
+                drawn_thumbnails_.push_back(std::move(thumbnail));
+                icon_drawn = true;
+            }
+            else
+            {
+                // The shell icon until the thumbnail is ready, or for good
+                icon_drawn = DrawItemIcon(item, icon_min, icon_size_px, icon_size);
+            }
+
+            if (!icon_drawn)
+            {
+                // Draw icon placeholder (folder = yellow, file = gray)
+                ImU32 icon_color = item.is_directory ? IM_COL32(255, 200, 100, 255) : IM_COL32(200, 200, 200, 255);
+                draw_list->AddRectFilled(
+                    icon_min,
+                    icon_max,
+                    icon_color,
+                    4.0f  // Rounded corners
+                );
+            }
 
             // Draw folder/file symbol inside icon
-            if (item.is_directory)
+            if (item.is_directory && !icon_drawn)
             {
                 // Draw a simple folder tab
                 float tab_width = icon_size_px * 0.4f;
@@ -891,8 +1276,33 @@ void MainWindow::RenderFilePanel()
     }
 }
 
+bool MainWindow::DrawItemIcon(const filesystem::FsItem& item, const ImVec2& min, float edge, preview::IconSize size)
+{
+    ImVec2 max(min.x + edge, min.y + edge);
+    if (!ImGui::IsRectVisible(min, max))
+        return true;        // Nothing to draw, placeholder or not
+
+    uint32_t attributes = item.attributes | (item.is_directory ? filesystem::FsItem::ATTR_DIRECTORY : 0);
+    preview::IconPtr icon = icon_service_->Get(item.full_path, attributes, item.modified_time, size);
+    if (!icon || !icon->texture || !icon->texture->IsResident())
+        return false;
+
+    // Fit within the square, never scaled up past its edge
+    float scale = (std::min)(1.0f, edge / static_cast<float>((std::max)(icon->width, icon->height)));
+    float width = icon->width * scale;
+    float height = icon->height * scale;
+    ImVec2 image_min(min.x + (edge - width) / 2, min.y + (edge - height) / 2);
+    const preview::TextureUv& uv = icon->texture->GetUv();
+    ImGui::GetWindowDrawList()->AddImage(icon->texture->GetView(), image_min,
+                                         ImVec2(image_min.x + width, image_min.y + height),
+                                         ImVec2(uv.u0, uv.v0), ImVec2(uv.u1, uv.v1));
+    drawn_icons_.push_back(std::move(icon));
+    return true;
+}
+
 void MainWindow::RenderStatusBar()
 {
+    OPACITY_PROFILE_ZONE("MainWindow::RenderStatusBar");
     ImGui::Separator();
     
     // Count selected items
@@ -910,11 +1320,12 @@ void MainWindow::RenderStatusBar()
     }
     
     ImGui::SameLine(ImGui::GetWindowWidth() - 200);
-    ImGui::Text("Opacity v1.0.0");
+    ImGui::Text("Opacity v%s", OPACITY_VERSION);
 }
 
 void MainWindow::RenderPreviewPanel()
 {
+    OPACITY_PROFILE_ZONE("MainWindow::RenderPreviewPanel");
     ImGui::TextUnformatted("Preview");
     ImGui::Separator();
     
@@ -928,6 +1339,7 @@ void MainWindow::RenderPreviewPanel()
         {
             UpdatePreview();
         }
+        PollPreview();
         
         ImGui::Text("Name: %s", item.name.c_str());
         ImGui::Text("Type: %s", item.GetTypeDescription().c_str());
@@ -950,40 +1362,109 @@ void MainWindow::RenderPreviewPanel()
         ImGui::Separator();
         
         // Show actual preview content
-        if (!item.is_directory && current_preview_.type != preview::PreviewType::None)
+        if (!item.is_directory && current_preview_ && current_preview_->type != preview::PreviewType::None)
         {
-            if (!current_preview_.error_message.empty())
+            if (current_preview_->is_loading)
+            {
+                ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), "Loading preview...");
+            }
+            else if (current_preview_->online_only)
+            {
+                ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f),
+                    "Online-only file. Previewing it downloads it.");
+                if (ImGui::Button("Download and Preview"))
+                {
+                    UpdatePreview(true);
+                }
+            }
+            else if (!current_preview_->error_message.empty())
             {
                 ImGui::TextColored(ImVec4(1.0f, 0.4f, 0.4f, 1.0f), "Error: %s", 
-                    current_preview_.error_message.c_str());
+                    current_preview_->error_message.c_str());
             }
-            else if (current_preview_.type == preview::PreviewType::Text)
+            else if (current_preview_->type == preview::PreviewType::Text && current_preview_->text_preview.document)
             {
-                // Text preview
-                ImGui::TextUnformatted("Text Preview:");
+                // Text preview; only the lines on screen are read
+                const auto& document = current_preview_->text_preview.document;
+                const auto& highlighter = current_preview_->text_preview.highlighter;
+                if (text_follow_tail_ && ImGui::GetTime() - text_refresh_time_ > 0.5)
+                {
+                    document->Refresh();
+                    text_refresh_time_ = ImGui::GetTime();
+                }
+
+                size_t line_count = document->GetLineCount();
+                ImGui::Text("Text Preview: %zu lines%s", line_count,
+                    document->IsIndexing() ? " (counting...)" : "");
+                ImGui::SameLine();
+                ImGui::Checkbox("Follow", &text_follow_tail_);
+                ImGui::SameLine();
+                ImGui::SetNextItemWidth(100.0f);
+                bool jump = ImGui::InputInt("##GotoLine", &text_goto_line_, 0, 0,
+                    ImGuiInputTextFlags_EnterReturnsTrue);
+                ImGui::SameLine();
+                jump |= ImGui::Button("Go to Line");
+
                 ImGui::BeginChild("TextPreviewScroll", ImVec2(0, 0), true, 
                     ImGuiWindowFlags_HorizontalScrollbar);
-                
-                const auto& text_data = current_preview_.text_preview;
-                for (const auto& line : text_data.lines)
+
+                float line_height = ImGui::GetTextLineHeightWithSpacing();
+                if (jump)
                 {
-                    ImGui::TextUnformatted(line.c_str());
+                    text_follow_tail_ = false;
+                    text_goto_line_ = (std::max)(1, text_goto_line_);
+                    ImGui::SetScrollY(static_cast<float>(text_goto_line_ - 1) * line_height);
                 }
-                
-                if (text_data.truncated)
+
+                ImGuiListClipper clipper;
+                clipper.Begin(static_cast<int>((std::min)(line_count, static_cast<size_t>(INT_MAX))), line_height);
+                while (clipper.Step())
+                {
+                    size_t first = static_cast<size_t>(clipper.DisplayStart);
+                    size_t count = static_cast<size_t>(clipper.DisplayEnd - clipper.DisplayStart);
+                    if (!highlighter)
+                    {
+                        for (const auto& line : document->GetLines(first, count))
+                        {
+                            ImGui::TextUnformatted(line.c_str());
+                        }
+                        continue;
+                    }
+
+                    // Spans drawn side by side, each in its theme color
+                    const ColorScheme& scheme = current_theme_->GetColorScheme();
+                    for (const auto& line : highlighter->GetLines(first, count))
+                    {
+                        if (line.spans.empty())
+                        {
+                            ImGui::TextUnformatted("");
+                            continue;
+                        }
+                        for (size_t i = 0; i < line.spans.size(); ++i)
+                        {
+                            const auto& span = line.spans[i];
+                            if (i > 0)
+                            {
+                                ImGui::SameLine(0.0f, 0.0f);
+                            }
+                            ImGui::PushStyleColor(ImGuiCol_Text, SyntaxColor(scheme, span.kind));
+                            ImGui::TextUnformatted(line.text.data() + span.begin, line.text.data() + span.end);
+                            ImGui::PopStyleColor();
+                        }
+                    }
+                }
+
+                if (text_follow_tail_)
                 {
-                    ImGui::Separator();
-                    ImGui::TextColored(ImVec4(1.0f, 1.0f, 0.4f, 1.0f), 
-                        "[Truncated - showing %zu of %zu lines]", 
-                        text_data.lines.size(), text_data.total_lines);
+                    ImGui::SetScrollHereY(1.0f);
                 }
                 
                 ImGui::EndChild();
             }
-            else if (current_preview_.type == preview::PreviewType::Image)
+            else if (current_preview_->type == preview::PreviewType::Image)
             {
                 // Image preview
-                const auto& image_data = current_preview_.image_preview;
+                const auto& image_data = current_preview_->image_preview;
                 
                 ImGui::Text("Image: %dx%d, %d channels", 
                     image_data.info.width, image_data.info.height, image_data.info.channels);
@@ -994,18 +1475,18 @@ void MainWindow::RenderPreviewPanel()
                     float max_width = ImGui::GetContentRegionAvail().x;
                     float max_height = ImGui::GetContentRegionAvail().y - 20;
                     
-                    float scale_x = max_width / static_cast<float>(image_data.info.width);
-                    float scale_y = max_height / static_cast<float>(image_data.info.height);
+                    float scale_x = max_width / static_cast<float>(image_data.width);
+                    float scale_y = max_height / static_cast<float>(image_data.height);
                     float scale = (std::min)(scale_x, scale_y);
-                    scale = (std::min)(scale, 1.0f); // Don't upscale
+                    scale = (std::min)(scale, 1.0f); // Don't upscale past the decoded size
                     
-                    float display_width = image_data.info.width * scale;
-                    float display_height = image_data.info.height * scale;
+                    float display_width = image_data.width * scale;
+                    float display_height = image_data.height * scale;
                     
                     ImGui::Image(image_data.texture, ImVec2(display_width, display_height));
                 }
             }
-            else if (current_preview_.type == preview::PreviewType::Unsupported)
+            else if (current_preview_->type == preview::PreviewType::Unsupported)
             {
                 ImGui::TextColored(ImVec4(0.6f, 0.6f, 0.6f, 1.0f), 
                     "Preview not available for this file type.");
@@ -1024,7 +1505,8 @@ void MainWindow::RenderDrivesPanel()
     ImGui::TextUnformatted("Drives");
     ImGui::Separator();
     
-    auto drives = fs_manager_->GetDrives();
+    // Cached; a drive that is slow to answer shows up once it has
+    auto drives = fs_manager_->GetDriveService().GetDrives();
     for (const auto& drive : drives)
     {
         if (!drive.is_ready) continue;
@@ -1057,6 +1539,7 @@ void MainWindow::NavigateTo(const std::string& path)
         path_history_.erase(path_history_.begin() + history_index_ + 1, path_history_.end());
     }
     
+    GetPrefetchEngine().RecordNavigation(current_path_, path);
     current_path_ = path;
     path_history_.push_back(path);
     history_index_ = path_history_.size() - 1;
@@ -1066,11 +1549,63 @@ void MainWindow::NavigateTo(const std::string& path)
     selected_index_ = -1;
     
     // Refresh directory contents
-    RefreshCurrentDirectory();
+    RefreshCurrentDirectory(true);
+    PublishSession();
     
     SPDLOG_DEBUG("Navigated to: {}", path);
 }
 
+bool MainWindow::RestoreSession(const core::Session& session)
+{
+    if (session.isEmpty())
+        return false;
+
+    layout_manager_->RestoreSession(session);
+    ShowRestoredPane();
+    return true;
+}
+
+void MainWindow::RestoreSession(const core::SessionState& state)
+{
+    layout_manager_->RestoreSession(state);
+    ShowRestoredPane();
+}
+
+void MainWindow::ShowRestoredPane()
+{
+    // The list shows one directory: the active tab of the first pane
+    const TabManager* tabs = layout_manager_->GetPaneTabManager(0);
+    const FilePane* pane = tabs ? tabs->GetActivePane() : nullptr;
+    if (pane && !pane->GetCurrentPath().empty() && pane->GetCurrentPath() != current_path_)
+        NavigateTo(pane->GetCurrentPath());
+}
+
+void MainWindow::PublishSession()
+{
+    // Both only move the state in; their own threads write it
+    if (sessions_loaded_)
+    {
+        core::TabState tab;
+        tab.path = current_path_;
+        tab.isActive = true;
+        core::PaneState pane;
+        pane.type = "files";
+        pane.tabs.push_back(std::move(tab));
+        core::Session session;
+        session.layoutType = "single";
+        session.panes.push_back(std::move(pane));
+        session_manager_->publishState(std::move(session));
+    }
+
+    if (crash_recovery_->IsInitialized())
+    {
+        core::SessionState state;
+        state.openTabs.push_back(std::filesystem::u8path(current_path_));
+        state.leftPanelPath = state.openTabs.front();
+        crash_recovery_->PublishSessionState(std::move(state));
+    }
+}
+
 void MainWindow::NavigateUp()
 {
     FsPath parent = fs_manager_->GetParentDirectory(FsPath{current_path_});
@@ -1087,10 +1622,11 @@ void MainWindow::NavigateBack()
     if (history_index_ > 0)
     {
         history_index_--;
+        GetPrefetchEngine().RecordNavigation(current_path_, path_history_[history_index_]);
         current_path_ = path_history_[history_index_];
         ClearSelection();
         selected_index_ = -1;
-        RefreshCurrentDirectory();
+        RefreshCurrentDirectory(true);
         SPDLOG_DEBUG("Navigated back to: {}", current_path_);
     }
 }
@@ -1100,15 +1636,16 @@ void MainWindow::NavigateForward()
     if (history_index_ < path_history_.size() - 1)
     {
         history_index_++;
+        GetPrefetchEngine().RecordNavigation(current_path_, path_history_[history_index_]);
         current_path_ = path_history_[history_index_];
         ClearSelection();
         selected_index_ = -1;
-        RefreshCurrentDirectory();
+        RefreshCurrentDirectory(true);
         SPDLOG_DEBUG("Navigated forward to: {}", current_path_);
     }
 }
 
-void MainWindow::RefreshCurrentDirectory()
+filesystem::EnumerationOptions MainWindow::ListingOptions() const
 {
     filesystem::EnumerationOptions options;
     options.include_hidden = show_hidden_files_;
@@ -1116,6 +1653,22 @@ void MainWindow::RefreshCurrentDirectory()
     options.sort_column = sort_column_;
     options.sort_direction = sort_direction_;
     options.folders_first = true;
+    return options;
+}
+
+float MainWindow::IconSizePixels() const
+{
+    switch (icon_size_)
+    {
+    case 0: return 32.0f;   // Small
+    case 2: return 128.0f;  // Large
+    default: return 64.0f;  // Medium
+    }
+}
+
+void MainWindow::RefreshCurrentDirectory(bool use_cache)
+{
+    filesystem::EnumerationOptions options = ListingOptions();
     
     if (search_active_ && strlen(search_buffer_) > 0)
     {
@@ -1123,31 +1676,99 @@ void MainWindow::RefreshCurrentDirectory()
         options.filter_pattern = std::string("*") + search_buffer_ + "*";
     }
     
-    auto contents = fs_manager_->EnumerateDirectory(FsPath{current_path_}, options);
-    
-    if (contents.success)
+    // Filtered listings are not cached; the read-ahead warms unfiltered ones
+    auto& cache = fs_manager_->GetListingCache();
+    FsPath directory{current_path_};
+    filesystem::DirectoryCache::Snapshot cached;
+    if (use_cache && options.filter_pattern.empty())
+        cached = cache.Find(directory, options);
+
+    if (cached)
     {
-        current_items_ = std::move(contents.items);
-        total_files_ = contents.total_files;
-        total_dirs_ = contents.total_directories;
-        total_size_ = contents.total_size;
+        current_items_.clear();
+        current_items_.reserve(cached->Count());
+        for (filesystem::ItemStore::Index i = 0; i < cached->Count(); ++i)
+            current_items_.push_back(cached->Materialize(i));
+        std::sort(current_items_.begin(), current_items_.end(),
+                  filesystem::FsItemComparator(options.sort_column, options.sort_direction, options.folders_first));
+        total_files_ = cached->GetFileCount();
+        total_dirs_ = cached->GetDirectoryCount();
+        total_size_ = cached->GetTotalSize();
         last_error_.clear();
     }
     else
     {
-        current_items_.clear();
-        total_files_ = 0;
-        total_dirs_ = 0;
-        total_size_ = 0;
-        last_error_ = contents.error_message;
+        auto contents = fs_manager_->EnumerateDirectory(directory, options);
+        if (contents.success)
+        {
+            current_items_ = std::move(contents.items);
+            total_files_ = contents.total_files;
+            total_dirs_ = contents.total_directories;
+            total_size_ = contents.total_size;
+            last_error_.clear();
+
+            if (options.filter_pattern.empty())
+            {
+                filesystem::ItemStore listing;
+                listing.Reset(current_path_);
+                for (const auto& item : current_items_)
+                    listing.Add(item);
+                cache.Store(directory, options, std::move(listing));
+            }
+        }
+        else
+        {
+            current_items_.clear();
+            total_files_ = 0;
+            total_dirs_ = 0;
+            total_size_ = 0;
+            last_error_ = contents.error_message;
+        }
     }
     
     // Resize selection vector
     selection_.resize(current_items_.size(), false);
+    filter_columns_dirty_ = true;
     
     SPDLOG_DEBUG("Refreshed directory: {} ({} items)", current_path_, current_items_.size());
 }
 
+void MainWindow::UpdateFilter()
+{
+    if (filter_columns_.Size() != current_items_.size())
+        filter_columns_dirty_ = true;
+
+    bool text_changed = filter_text_ != search_buffer_;
+    if (!filter_columns_dirty_ && !text_changed)
+        return;
+
+    if (filter_columns_dirty_)
+    {
+        filter_columns_.Build(current_items_);
+        filter_columns_dirty_ = false;
+    }
+
+    if (text_changed)
+    {
+        filter_text_ = search_buffer_;
+
+        // Half-typed terms ("size:>") filter by name until they parse
+        auto program = search::FilterEngine::Compile(filter_text_);
+        if (program)
+        {
+            filter_program_ = std::move(*program);
+        }
+        else
+        {
+            search::FilterSpec spec;
+            spec.namePatterns.push_back(filter_text_);
+            filter_program_ = search::FilterEngine::Compile(spec);
+        }
+    }
+
+    filter_program_.Evaluate(filter_columns_, filter_selection_);
+}
+
 void MainWindow::OpenSelectedItems()
 {
     for (size_t i = 0; i < current_items_.size(); ++i)
@@ -1178,14 +1799,15 @@ void MainWindow::OpenSelectedItems()
 
 void MainWindow::CopySelectedItems()
 {
-    // TODO: Implement clipboard copy
-    SPDLOG_DEBUG("Copy selected items");
+    if (auto source = SelectedFileSource(current_items_, selection_, current_path_))
+        core::ShellIntegration::SetClipboardFiles(std::move(source), core::ShellDropEffect::Copy);
 }
 
 void MainWindow::CutSelectedItems()
 {
-    // TODO: Implement clipboard cut
-    SPDLOG_DEBUG("Cut selected items");
+    // The target moves the files when pasted; the watch sees them go
+    if (auto source = SelectedFileSource(current_items_, selection_, current_path_))
+        core::ShellIntegration::SetClipboardFiles(std::move(source), core::ShellDropEffect::Move);
 }
 
 void MainWindow::PasteItems()
@@ -1322,13 +1944,14 @@ void MainWindow::UpdateSort(filesystem::SortColumn column)
     // Re-sort
     filesystem::FsItemComparator comparator(sort_column_, sort_direction_, true);
     filesystem::FsItemUtils::Sort(current_items_, comparator);
+    filter_columns_dirty_ = true;
 }
 
 // ============================================================================
 // Preview methods
 // ============================================================================
 
-void MainWindow::UpdatePreview()
+void MainWindow::UpdatePreview(bool hydrate)
 {
     if (selected_index_ < 0 || static_cast<size_t>(selected_index_) >= current_items_.size())
     {
@@ -1347,24 +1970,63 @@ void MainWindow::UpdatePreview()
         return;
     }
     
+    // Selected before startup got to the preview handlers, which come first
+    if (deferred_next_ == 0 && !deferred_init_.empty())
+        RunDeferredInit(false);
+
     // Release previous preview
     ReleaseCurrentPreview();
     
-    // Load new preview
+    // Decode on the preview workers; the panel shows a placeholder until
+    // the result is polled in
     preview_file_path_ = item.full_path.String();
-    current_preview_ = preview_manager_->LoadPreview(item.full_path);
-    
-    SPDLOG_DEBUG("Loaded preview for: {} (type={})", preview_file_path_, 
-        static_cast<int>(current_preview_.type));
+    auto placeholder = std::make_shared<preview::PreviewData>();
+    placeholder->type = preview_manager_->GetPreviewType(item.full_path);
+    placeholder->file_path = preview_file_path_;
+    placeholder->file_name = item.name;
+    placeholder->is_loading = true;
+    current_preview_ = std::move(placeholder);
+    preview_request_ = preview_manager_->RequestPreview(item.full_path, hydrate);
+
+    // Warm the cache for the files either side, nearest first, in the
+    // order they are listed
+    std::vector<FsPath> neighbors;
+    for (int distance = 1; distance <= kPreviewPrefetchDistance; ++distance)
+    {
+        for (int index : {selected_index_ + distance, selected_index_ - distance})
+        {
+            if (index >= 0 && static_cast<size_t>(index) < current_items_.size() &&
+                !current_items_[index].is_directory)
+            {
+                neighbors.push_back(current_items_[index].full_path);
+            }
+        }
+    }
+    preview_manager_->PrefetchPreviews(neighbors);
+}
+
+void MainWindow::PollPreview()
+{
+    if (!preview_request_ || !preview_request_->IsReady())
+        return;
+
+    current_preview_ = preview_request_->Take();
+    preview_request_.reset();
+
+    OPACITY_LOG_DEBUG(UI, "Loaded preview for: {} (type={})", preview_file_path_, 
+        static_cast<int>(current_preview_->type));
 }
 
 void MainWindow::ReleaseCurrentPreview()
 {
-    if (current_preview_.type != preview::PreviewType::None)
+    if (preview_request_)
     {
-        preview_manager_->ReleasePreview(current_preview_);
-        current_preview_ = preview::PreviewData{};
+        preview_request_->Cancel();
+        preview_request_.reset();
     }
+
+    // The texture goes with the last reference; the cache may keep it
+    current_preview_.reset();
 }
 
 // ============================================================================
@@ -1373,7 +2035,7 @@ void MainWindow::ReleaseCurrentPreview()
 
 void MainWindow::StartSearch()
 {
-    if (search_engine_->IsSearching())
+    if (IsSearching())
     {
         SPDLOG_DEBUG("Search already in progress");
         return;
@@ -1386,50 +2048,151 @@ void MainWindow::StartSearch()
     }
     
     // Clear previous results
-    {
-        std::lock_guard<std::mutex> lock(search_results_mutex_);
-        search_results_.clear();
-        search_files_count_ = 0;
-    }
+    search_results_.Reset();
+    search_files_count_ = 0;
     
     show_search_results_ = true;
-    
+
+    // The resident index knows plain names, not contents, patterns or
+    // hidden files
+    if (index_client_ && !search_contents_ && !show_hidden_files_ &&
+        query.find_first_of("*?") == std::string::npos)
+    {
+        SearchResidentIndex(query);
+        return;
+    }
+
+    StartWalkSearch(query, current_path_);
+}
+
+void MainWindow::StartWalkSearch(const std::string& query, const std::string& directory)
+{
     search::SearchOptions options;
     options.case_sensitive = false;
     options.recursive = true;
     options.include_hidden = show_hidden_files_;
-    options.max_results = 500;
+    options.search_contents = search_contents_;
+    options.capture_context = false;     // Read for the rows on screen only
+    if (auto config = core::Config::Get())
+        options.max_results = config->Get<size_t>("search.max_results", kMaxSearchResults);
+    else
+        options.max_results = kMaxSearchResults;
     
-    SPDLOG_INFO("Starting search for '{}' in '{}'", query, current_path_);
+    SPDLOG_INFO("Starting search for '{}' in '{}'", query, directory);
     
     search_engine_->StartSearch(
-        FsPath{current_path_},
+        FsPath{directory},
         query,
         options,
         [this](const search::SearchResult& result) {
             OnSearchResult(result);
         },
         [this](size_t files_searched, size_t matches_found) {
-            std::lock_guard<std::mutex> lock(search_results_mutex_);
             search_files_count_ = files_searched;
         }
     );
 }
 
+void MainWindow::SearchResidentIndex(const std::string& query)
+{
+    auto state = std::make_shared<ResidentSearch>();
+    state->query = query;
+    state->directory = current_path_;
+
+    core::TaskOptions task_options;
+    task_options.priority = core::TaskPriority::Interactive;
+    task_options.cancel = state->cancel.Token();
+
+    std::shared_ptr<search::IndexClient> client = index_client_;
+    std::filesystem::path scope = std::filesystem::u8path(state->directory);
+    state->task = core::TaskScheduler::Get().Submit([client, state, scope](const core::CancellationToken& cancel)
+    {
+        OPACITY_PROFILE_ZONE("MainWindow::SearchResidentIndex");
+        if (!client->IsConnected() && !client->Connect(std::chrono::milliseconds(0)))
+            return;
+
+        search::QuickSearchOptions options;
+        options.maxResults = kMaxResidentResults;
+        bool complete = false;
+        bool answered = client->QuickSearch(state->query, options, scope, [&](const search::HostedEntry& entry) {
+            if (cancel.IsCancelled())
+                return false;
+
+            // The path is only lent until this returns
+            std::filesystem::path path = std::filesystem::u8path(entry.path.begin(), entry.path.end());
+
+            search::SearchResult result;
+            filesystem::FsItem& item = result.item;
+            item.name = path.filename().u8string();
+            item.path = path.u8string();
+            item.full_path = core::Path(path);
+            item.is_directory = entry.isDirectory;
+            item.size = entry.size;
+            item.modified_time = entry.modifiedTime;
+            item.modified = entry.modifiedTime;
+            item.attributes = entry.isDirectory ? filesystem::FsItem::ATTR_DIRECTORY : 0;
+            if (!entry.isDirectory)
+                item.extension = path.extension().u8string();
+            item.type = entry.isDirectory ? filesystem::FileType::Directory : filesystem::DetermineFileType(item.name);
+            state->results.push_back(std::move(result));
+            return true;
+        }, &complete);
+
+        state->complete = answered && complete && !cancel.IsCancelled();
+    }, task_options);
+
+    resident_search_ = std::move(state);
+}
+
+void MainWindow::PollResidentSearch()
+{
+    if (!resident_search_ || !resident_search_->task.IsDone())
+        return;
+
+    std::shared_ptr<ResidentSearch> state = std::move(resident_search_);
+    if (state->cancel.IsCancelled())
+        return;
+
+    // Not running, not covering this folder, or cut short: walk instead
+    if (!state->complete)
+    {
+        StartWalkSearch(state->query, state->directory);
+        return;
+    }
+
+    SPDLOG_INFO("Search for '{}' answered by the resident index: {} matches", state->query, state->results.size());
+    search_files_count_ = state->results.size();
+    search_results_.Assign(std::move(state->results));
+}
+
+bool MainWindow::IsSearching() const
+{
+    return resident_search_ || (search_engine_ && search_engine_->IsSearching());
+}
+
 void MainWindow::CancelSearch()
 {
+    if (resident_search_)
+    {
+        resident_search_->cancel.Cancel();
+        resident_search_.reset();
+    }
     search_engine_->CancelSearch();
     SPDLOG_DEBUG("Search cancelled");
 }
 
 void MainWindow::OnSearchResult(const search::SearchResult& result)
 {
-    std::lock_guard<std::mutex> lock(search_results_mutex_);
-    search_results_.push_back(result);
+    search_results_.Push(result);
 }
 
 void MainWindow::RenderSearchResults()
 {
+    OPACITY_PROFILE_ZONE("MainWindow::RenderSearchResults");
+
+    // Taken in even while hidden, so the queue never piles up
+    PollResidentSearch();
+    search_results_.Drain();
     if (!show_search_results_)
     {
         return;
@@ -1440,80 +2203,136 @@ void MainWindow::RenderSearchResults()
     if (ImGui::Begin("Search Results", &show_search_results_))
     {
         // Status bar
+        size_t matches = search_results_.GetResultCount() + search_results_.GetPendingCount();
+        if (IsSearching())
         {
-            std::lock_guard<std::mutex> lock(search_results_mutex_);
-            
-            if (search_engine_->IsSearching())
-            {
-                ImGui::Text("Searching... (%zu files, %zu matches)", 
-                    search_files_count_, search_results_.size());
-                ImGui::SameLine();
-                if (ImGui::Button("Cancel"))
-                {
-                    CancelSearch();
-                }
-            }
-            else
+            ImGui::Text("Searching... (%zu files, %zu matches)", search_files_count_.load(), matches);
+            ImGui::SameLine();
+            if (ImGui::Button("Cancel"))
             {
-                ImGui::Text("Found %zu matches", search_results_.size());
+                CancelSearch();
             }
         }
+        else
+        {
+            ImGui::Text("Found %zu matches", matches);
+        }
+        ImGui::SameLine();
+        bool grouped = search_results_.IsGrouped();
+        if (ImGui::Checkbox("Group by folder", &grouped))
+        {
+            search_results_.SetGrouped(grouped);
+        }
         
         ImGui::Separator();
         
-        // Results list
-        if (ImGui::BeginTable("SearchResultsTable", 3, 
-            ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | 
-            ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersOuter))
+        // Results list; only the rows on screen are laid out
+        if (ImGui::BeginTable("SearchResultsTable", 4, 
+            ImGuiTableFlags_Resizable | ImGuiTableFlags_RowBg | ImGuiTableFlags_Sortable |
+            ImGuiTableFlags_SortTristate | ImGuiTableFlags_ScrollY | ImGuiTableFlags_BordersOuter))
         {
             ImGui::TableSetupColumn("Name", ImGuiTableColumnFlags_WidthFixed, 200.0f);
-            ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch);
+            ImGui::TableSetupColumn("Path", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort);
+            ImGui::TableSetupColumn("Match", ImGuiTableColumnFlags_WidthStretch | ImGuiTableColumnFlags_NoSort);
             ImGui::TableSetupColumn("Size", ImGuiTableColumnFlags_WidthFixed, 80.0f);
             ImGui::TableSetupScrollFreeze(0, 1);
             ImGui::TableHeadersRow();
-            
-            std::lock_guard<std::mutex> lock(search_results_mutex_);
-            
-            for (size_t i = 0; i < search_results_.size(); ++i)
+
+            // No sort keeps the order results arrived in
+            if (ImGuiTableSortSpecs* sort_specs = ImGui::TableGetSortSpecs())
             {
-                const auto& result = search_results_[i];
-                
-                ImGui::TableNextRow();
-                
-                ImGui::TableNextColumn();
-                const char* icon = result.item.is_directory ? "[DIR] " : "";
-                std::string label = std::string(icon) + result.item.name + "##sr" + std::to_string(i);
-                
-                if (ImGui::Selectable(label.c_str(), false, 
-                    ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowDoubleClick))
+                if (sort_specs->SpecsDirty)
+                {
+                    if (sort_specs->SpecsCount == 0)
+                    {
+                        search_results_.SetSort(std::nullopt, filesystem::SortDirection::Ascending);
+                    }
+                    else
+                    {
+                        const ImGuiTableColumnSortSpecs& spec = sort_specs->Specs[0];
+                        search_results_.SetSort(spec.ColumnIndex == 3 ? filesystem::SortColumn::Size
+                                                                      : filesystem::SortColumn::Name,
+                                                spec.SortDirection == ImGuiSortDirection_Ascending
+                                                    ? filesystem::SortDirection::Ascending
+                                                    : filesystem::SortDirection::Descending);
+                    }
+                    sort_specs->SpecsDirty = false;
+                }
+            }
+
+            ImGuiListClipper clipper;
+            clipper.Begin(static_cast<int>((std::min)(search_results_.GetRowCount(), static_cast<size_t>(INT_MAX))));
+            while (clipper.Step())
+            {
+                for (int row = clipper.DisplayStart; row < clipper.DisplayEnd; ++row)
                 {
-                    if (ImGui::IsMouseDoubleClicked(0))
+                    SearchResultsModel::Row entry = search_results_.GetRow(static_cast<size_t>(row));
+                    ImGui::TableNextRow();
+                    ImGui::TableNextColumn();
+                    ImGui::PushID(row);
+
+                    if (entry.group)
                     {
-                        if (result.item.is_directory)
+                        size_t size = search_results_.GetGroupSize(entry.index);
+                        std::string label = std::string(search_results_.IsGroupExpanded(entry.index) ? "[-] " : "[+] ") +
+                                            std::to_string(size) + (size == 1 ? " match" : " matches");
+                        if (ImGui::Selectable(label.c_str(), false, ImGuiSelectableFlags_SpanAllColumns))
                         {
-                            NavigateTo(result.item.full_path.String());
-                            show_search_results_ = false;
+                            search_results_.ToggleGroup(entry.index);
                         }
-                        else
+                        ImGui::TableNextColumn();
+                        ImGui::TextUnformatted(search_results_.GetGroupDirectory(entry.index).c_str());
+                        ImGui::PopID();
+                        continue;
+                    }
+
+                    const auto& result = search_results_.GetResult(entry.index);
+                    if (search_results_.IsGrouped())
+                        ImGui::Indent();
+                    const char* icon = result.item.is_directory ? "[DIR] " : "";
+                    std::string label = std::string(icon) + result.item.name;
+                    if (ImGui::Selectable(label.c_str(), false, 
+                        ImGuiSelectableFlags_SpanAllColumns | ImGuiSelectableFlags_AllowDoubleClick))
+                    {
+                        if (ImGui::IsMouseDoubleClicked(0))
                         {
-                            // Navigate to containing folder and select the file
-                            std::string parent = fs_manager_->GetParentDirectory(result.item.full_path).String();
-                            if (!parent.empty())
+                            if (result.item.is_directory)
                             {
-                                NavigateTo(parent);
+                                NavigateTo(result.item.full_path.String());
                                 show_search_results_ = false;
                             }
+                            else
+                            {
+                                // Navigate to containing folder and select the file
+                                std::string parent = fs_manager_->GetParentDirectory(result.item.full_path).String();
+                                if (!parent.empty())
+                                {
+                                    NavigateTo(parent);
+                                    show_search_results_ = false;
+                                }
+                            }
                         }
                     }
-                }
-                
-                ImGui::TableNextColumn();
-                ImGui::TextUnformatted(result.item.full_path.String().c_str());
-                
-                ImGui::TableNextColumn();
-                if (!result.item.is_directory)
-                {
-                    ImGui::TextUnformatted(result.item.GetFormattedSize().c_str());
+                    if (search_results_.IsGrouped())
+                        ImGui::Unindent();
+                    
+                    ImGui::TableNextColumn();
+                    ImGui::TextUnformatted(result.item.path.c_str());
+
+                    ImGui::TableNextColumn();
+                    if (result.match_length > 0)
+                    {
+                        // Read on a task the first time the row is on screen
+                        const std::string& context = search_results_.Context(entry.index);
+                        ImGui::Text("%zu: %s", result.match_line, context.c_str());
+                    }
+                    
+                    ImGui::TableNextColumn();
+                    if (!result.item.is_directory)
+                    {
+                        ImGui::TextUnformatted(result.item.GetFormattedSize().c_str());
+                    }
+                    ImGui::PopID();
                 }
             }
             
@@ -1662,7 +2481,7 @@ void MainWindow::HandleKeyboardInput()
     {
         if (show_search_results_)
         {
-            if (search_engine_->IsSearching())
+            if (IsSearching())
             {
                 CancelSearch();
             }
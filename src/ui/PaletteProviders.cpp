@@ -0,0 +1,123 @@
+#include "opacity/ui/PaletteProviders.h"
+#include "opacity/core/BookmarkManager.h"
+#include "opacity/core/SessionManager.h"
+#include "opacity/core/TagManager.h"
+#include "opacity/search/SearchIndex.h"
+
+namespace opacity::ui
+{
+    namespace
+    {
+        // Below the commands their names would tie with
+        constexpr int kProvidedPriority = -5;
+    }
+
+    SessionPaletteProvider::SessionPaletteProvider(const core::SessionManager& sessions,
+                                                   std::function<void(const std::string&)> open)
+        : sessions_(sessions), open_(std::move(open))
+    {
+    }
+
+    void SessionPaletteProvider::Collect(std::vector<PaletteCommand>& items)
+    {
+        for (const core::Session* session : sessions_.getRecentSessions())
+        {
+            PaletteCommand item;
+            item.id = "session:" + session->id;
+            item.label = session->name;
+            item.description = session->description;
+            item.category = "Session";
+            item.action = [open = open_, id = session->id]() { if (open) open(id); };
+            item.priority = kProvidedPriority;
+            item.keywords = {"session", "restore"};
+            items.push_back(std::move(item));
+        }
+    }
+
+    BookmarkPaletteProvider::BookmarkPaletteProvider(const core::BookmarkManager& bookmarks,
+                                                     std::function<void(const std::string&)> open)
+        : bookmarks_(bookmarks), open_(std::move(open))
+    {
+    }
+
+    void BookmarkPaletteProvider::Collect(std::vector<PaletteCommand>& items)
+    {
+        for (const core::Bookmark* bookmark : bookmarks_.getAllBookmarks())
+        {
+            if (bookmark->isFolder || !bookmark->isValid())
+                continue;
+
+            PaletteCommand item;
+            item.id = "bookmark:" + bookmark->id;
+            item.label = bookmark->name;
+            item.description = bookmark->description.empty() ? bookmark->path : bookmark->description;
+            item.category = "Bookmark";
+            item.shortcut = bookmark->shortcut;
+            item.action = [open = open_, path = bookmark->path]() { if (open) open(path); };
+            item.priority = kProvidedPriority;
+            item.keywords = {bookmark->path};
+            if (!bookmark->category.empty())
+                item.keywords.push_back(bookmark->category);
+            items.push_back(std::move(item));
+        }
+    }
+
+    TagPaletteProvider::TagPaletteProvider(const core::TagManager& tags,
+                                           std::function<void(const std::string&)> show)
+        : tags_(tags), show_(std::move(show))
+    {
+    }
+
+    void TagPaletteProvider::Collect(std::vector<PaletteCommand>& items)
+    {
+        for (const core::Tag* tag : tags_.getAllTags())
+        {
+            PaletteCommand item;
+            item.id = "tag:" + tag->id;
+            item.label = tag->name;
+            item.description = !tag->description.empty()
+                                   ? tag->description
+                                   : std::to_string(tag->usageCount) + " tagged";
+            item.category = "Tag";
+            item.shortcut = tag->shortcut;
+            item.action = [show = show_, id = tag->id]() { if (show) show(id); };
+            item.priority = kProvidedPriority;
+            item.keywords = {"tag"};
+            items.push_back(std::move(item));
+        }
+    }
+
+    FilePaletteProvider::FilePaletteProvider(std::shared_ptr<search::SearchIndex> index,
+                                             std::function<void(const std::filesystem::path&)> open)
+        : index_(std::move(index)), open_(std::move(open))
+    {
+    }
+
+    void FilePaletteProvider::Query(const std::string& query, size_t max_results,
+                                    const std::atomic<bool>& cancel, const Emit& emit)
+    {
+        if (!index_ || query.empty())
+            return;
+
+        search::QuickSearchOptions options;
+        options.maxResults = static_cast<int>(max_results);
+        auto paths = index_->QuickSearch(query, options);
+        if (cancel.load(std::memory_order_relaxed))
+            return;
+
+        std::vector<PaletteCommand> items;
+        items.reserve(paths.size());
+        for (const auto& path : paths)
+        {
+            PaletteCommand item;
+            item.id = "file:" + path.string();
+            item.label = path.filename().string();
+            item.description = path.parent_path().string();
+            item.category = "File";
+            item.action = [open = open_, path]() { if (open) open(path); };
+            items.push_back(std::move(item));
+        }
+        emit(std::move(items));
+    }
+
+} // namespace opacity::ui
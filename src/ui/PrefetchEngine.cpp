@@ -0,0 +1,536 @@
+#include "opacity/ui/PrefetchEngine.h"
+#include "opacity/core/BackgroundWork.h"
+#include "opacity/core/BookmarkManager.h"
+#include "opacity/core/HashCache.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/Profiler.h"
+#include "opacity/core/SessionManager.h"
+#include "opacity/filesystem/DirectoryCache.h"
+#include "opacity/filesystem/NetworkStorage.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        constexpr const char* kHeader = "opacity-navigation 1";
+
+        // As BackgroundPolicy: input this recent means the user is busy
+        constexpr std::chrono::milliseconds kInputGrace(500);
+
+        // Share of a guess's score from the transitions out of the current
+        // directory; the rest comes from frecency
+        constexpr double kTransitionWeight = 0.7;
+
+        // Transition counts out of a directory are halved past this, so
+        // old habits fade
+        constexpr double kMaxTransitionTotal = 64.0;
+    }
+
+    // ============== Model ==============
+
+    std::string PrefetchEngine::Key(const std::string& path)
+    {
+        std::string key = path;
+        for (char& c : key)
+        {
+            if (c == '/')
+                c = '\\';
+            else if (c >= 'A' && c <= 'Z')
+                c = static_cast<char>(c + ('a' - 'A'));
+        }
+        // C:\ keeps its separator; C:\Users\ does not
+        while (key.size() > 3 && key.back() == '\\')
+            key.pop_back();
+        return key;
+    }
+
+    int64_t PrefetchEngine::Now()
+    {
+        using namespace std::chrono;
+        return duration_cast<seconds>(system_clock::now().time_since_epoch()).count();
+    }
+
+    double PrefetchEngine::Frecency(const Node& node, int64_t now) const
+    {
+        double age = static_cast<double>(std::max<int64_t>(0, now - node.last_visit));
+        double half_life = static_cast<double>(std::chrono::seconds(kHalfLife).count());
+        return node.score * std::exp2(-age / half_life);
+    }
+
+    PrefetchEngine::Node& PrefetchEngine::Visit(const std::string& path, double weight, int64_t now)
+    {
+        Node& node = nodes_[Key(path)];
+        if (node.path.empty())
+            node.path = path;
+        node.score = Frecency(node, now) + weight;
+        node.last_visit = now;
+        return node;
+    }
+
+    void PrefetchEngine::Prune()
+    {
+        if (nodes_.size() <= kMaxPaths)
+            return;
+
+        // Down to three quarters, so this runs once per many new paths
+        int64_t now = Now();
+        std::vector<std::pair<double, std::string>> ranked;
+        ranked.reserve(nodes_.size());
+        for (const auto& [key, node] : nodes_)
+        {
+            ranked.emplace_back(Frecency(node, now), key);
+        }
+        size_t drop = nodes_.size() - kMaxPaths * 3 / 4;
+        std::nth_element(ranked.begin(), ranked.begin() + static_cast<ptrdiff_t>(drop), ranked.end());
+        for (size_t i = 0; i < drop; ++i)
+        {
+            if (ranked[i].second != current_)
+                nodes_.erase(ranked[i].second);
+        }
+    }
+
+    void PrefetchEngine::Seed(const std::string& path, double weight)
+    {
+        if (path.empty() || weight <= 0.0)
+            return;
+
+        Visit(path, weight, Now());
+        Prune();
+    }
+
+    void PrefetchEngine::Seed(const core::BookmarkManager& bookmarks)
+    {
+        for (const auto* bookmark : bookmarks.getAllBookmarks())
+        {
+            Seed(bookmark->path, 1.0);
+        }
+        for (const auto& item : bookmarks.getQuickAccessItems())
+        {
+            Seed(item.path, std::max(1, item.frequency));
+        }
+    }
+
+    void PrefetchEngine::Seed(const core::SessionManager& sessions)
+    {
+        for (const auto* session : sessions.getRecentSessions())
+        {
+            for (const auto& pane : session->panes)
+            {
+                for (const auto& tab : pane.tabs)
+                    Seed(tab.path, 1.0);
+            }
+        }
+    }
+
+    void PrefetchEngine::RecordNavigation(const std::string& from, const std::string& to)
+    {
+        if (to.empty())
+            return;
+
+        std::string to_key = Key(to);
+        std::string from_key = from.empty() ? std::string() : Key(from);
+        if (to_key == from_key)
+            return;
+
+        // Settle the guesses made for where the user just was
+        for (const auto& [key, network] : outstanding_)
+        {
+            if (key != to_key)
+                continue;
+
+            ++stats_.used;
+            if (network)
+                ++stats_.network_used;
+        }
+        outstanding_.clear();
+
+        int64_t now = Now();
+        Visit(to, 1.0, now);
+
+        auto from_it = from_key.empty() ? nodes_.end() : nodes_.find(from_key);
+        if (from_it != nodes_.end())
+        {
+            auto& next = from_it->second.next;
+            auto it = std::find_if(next.begin(), next.end(),
+                                   [&to_key](const Successor& successor) { return successor.key == to_key; });
+            if (it == next.end())
+            {
+                // A full list gives up its rarest successor for the newcomer
+                if (next.size() >= kMaxSuccessors)
+                    next.pop_back();
+                Successor successor;
+                successor.key = to_key;
+                next.push_back(std::move(successor));
+                it = next.end() - 1;
+            }
+            it->count += 1.0;
+
+            double total = 0.0;
+            for (const auto& successor : next)
+                total += successor.count;
+            if (total > kMaxTransitionTotal)
+            {
+                for (auto& successor : next)
+                    successor.count /= 2.0;
+            }
+            std::stable_sort(next.begin(), next.end(),
+                             [](const Successor& a, const Successor& b) { return a.count > b.count; });
+        }
+
+        current_ = std::move(to_key);
+        Prune();
+    }
+
+    std::vector<std::string> PrefetchEngine::Predict(const std::string& from, size_t count) const
+    {
+        std::string from_key = Key(from);
+        int64_t now = Now();
+
+        struct Candidate
+        {
+            const Node* node = nullptr;
+            double transition = 0.0;
+            double frecency = 0.0;
+        };
+        std::unordered_map<std::string, Candidate> candidates;
+
+        auto from_it = nodes_.find(from_key);
+        if (from_it != nodes_.end())
+        {
+            double total = 0.0;
+            for (const auto& successor : from_it->second.next)
+                total += successor.count;
+            for (const auto& successor : from_it->second.next)
+            {
+                auto it = nodes_.find(successor.key);
+                if (it == nodes_.end() || total <= 0.0)
+                    continue;
+
+                Candidate& candidate = candidates[successor.key];
+                candidate.node = &it->second;
+                candidate.transition = successor.count / total;
+            }
+        }
+
+        // The most frecent directories overall, for where there is no
+        // history yet
+        std::vector<std::pair<double, const std::string*>> frecent;
+        frecent.reserve(nodes_.size());
+        for (const auto& [key, node] : nodes_)
+        {
+            if (key != from_key)
+                frecent.emplace_back(Frecency(node, now), &key);
+        }
+        size_t top = std::min(frecent.size(), count * 2);
+        std::partial_sort(frecent.begin(), frecent.begin() + static_cast<ptrdiff_t>(top), frecent.end(),
+                          [](const auto& a, const auto& b) { return a.first > b.first; });
+        for (size_t i = 0; i < top; ++i)
+        {
+            Candidate& candidate = candidates[*frecent[i].second];
+            candidate.node = &nodes_.at(*frecent[i].second);
+        }
+
+        double max_frecency = 0.0;
+        for (auto& [key, candidate] : candidates)
+        {
+            candidate.frecency = Frecency(*candidate.node, now);
+            max_frecency = std::max(max_frecency, candidate.frecency);
+        }
+
+        std::vector<std::pair<double, const Candidate*>> ranked;
+        ranked.reserve(candidates.size());
+        for (const auto& [key, candidate] : candidates)
+        {
+            double frecency = max_frecency > 0.0 ? candidate.frecency / max_frecency : 0.0;
+            ranked.emplace_back(kTransitionWeight * candidate.transition + (1.0 - kTransitionWeight) * frecency,
+                                &candidate);
+        }
+        std::sort(ranked.begin(), ranked.end(), [](const auto& a, const auto& b)
+        {
+            return a.first != b.first ? a.first > b.first : a.second->node->path < b.second->node->path;
+        });
+
+        std::vector<std::string> paths;
+        for (size_t i = 0; i < ranked.size() && paths.size() < count; ++i)
+        {
+            paths.push_back(ranked[i].second->node->path);
+        }
+        return paths;
+    }
+
+    // ============== Read-ahead ==============
+
+    void PrefetchEngine::Attach(filesystem::FileSystemManager* fs_manager,
+                                std::shared_ptr<preview::ThumbnailService> thumbnails)
+    {
+        fs_manager_ = fs_manager;
+        thumbnails_ = std::move(thumbnails);
+    }
+
+    void PrefetchEngine::Detach()
+    {
+        fs_manager_ = nullptr;
+        thumbnails_.reset();
+        unlisted_.clear();
+        warm_.clear();
+    }
+
+    bool PrefetchEngine::NetworkAllowed() const
+    {
+        if (stats_.network_predicted < kNetworkTrial)
+            return true;
+        return static_cast<double>(stats_.network_used) >=
+               kMinNetworkUseRate * static_cast<double>(stats_.network_predicted);
+    }
+
+    bool PrefetchEngine::HasWork() const
+    {
+        if (!fs_manager_ || current_.empty())
+            return false;
+        return prefetched_for_ != current_ || !unlisted_.empty() || !warm_.empty();
+    }
+
+    void PrefetchEngine::OnIdle(const filesystem::EnumerationOptions& options, int thumbnail_edge)
+    {
+        if (!HasWork() || core::ForegroundActivity::IsActive(kInputGrace))
+            return;
+
+        OPACITY_PROFILE_ZONE("PrefetchEngine::OnIdle");
+        if (prefetched_for_ != current_)
+            Start(options);
+
+        if (std::chrono::steady_clock::now() > deadline_)
+        {
+            unlisted_.clear();
+            warm_.clear();
+            return;
+        }
+
+        if (!thumbnails_ || thumbnail_edge <= 0)
+        {
+            unlisted_.clear();
+            return;
+        }
+        CollectThumbnails();
+        RenewThumbnails(thumbnail_edge);
+    }
+
+    void PrefetchEngine::Start(const filesystem::EnumerationOptions& options)
+    {
+        prefetched_for_ = current_;
+        outstanding_.clear();
+        unlisted_.clear();
+        warm_.clear();
+        options_ = options;
+        deadline_ = std::chrono::steady_clock::now() + kWarmTime;
+
+        auto it = nodes_.find(current_);
+        if (it == nodes_.end())
+            return;
+
+        bool network_allowed = NetworkAllowed();
+        std::vector<core::Path> directories;
+        for (const auto& target : Predict(it->second.path, kTargets))
+        {
+            core::Path directory(target);
+            bool network = filesystem::NetworkStorage::IsNetworkPath(directory.Get());
+            outstanding_.emplace_back(Key(target), network);
+            ++stats_.predicted;
+            if (network)
+            {
+                ++stats_.network_predicted;
+                if (!network_allowed)
+                {
+                    ++stats_.network_skipped;
+                    continue;
+                }
+            }
+            directories.push_back(std::move(directory));
+        }
+
+        SPDLOG_DEBUG("Prefetching {} directories after {}", directories.size(), it->second.path);
+        fs_manager_->GetListingCache().Prefetch(directories, options_);
+        unlisted_ = std::move(directories);
+    }
+
+    void PrefetchEngine::CollectThumbnails()
+    {
+        auto& cache = fs_manager_->GetListingCache();
+        for (auto it = unlisted_.begin(); it != unlisted_.end();)
+        {
+            // Still being read, or could not be
+            auto listing = cache.Find(*it, options_);
+            if (!listing)
+            {
+                ++it;
+                continue;
+            }
+
+            size_t taken = 0;
+            for (filesystem::ItemStore::Index i = 0; i < listing->Count() && taken < kThumbnailsPerTarget; ++i)
+            {
+                if (listing->IsDirectory(i))
+                    continue;
+
+                core::Path path(listing->FullPath(i));
+                if (!thumbnails_->CanThumbnail(path))
+                    continue;
+
+                Warm warm;
+                warm.path = std::move(path);
+                warm.modified = listing->Modified(i);
+                warm_.push_back(std::move(warm));
+                ++taken;
+            }
+            it = unlisted_.erase(it);
+        }
+    }
+
+    void PrefetchEngine::RenewThumbnails(int edge)
+    {
+        // Asked for again every frame, or BeginFrame drops them; ones held
+        // in memory are done
+        int priority = kThumbnailPriority;
+        auto done = std::remove_if(warm_.begin(), warm_.end(), [&](const Warm& warm)
+        {
+            if (!thumbnails_->Get(warm.path, warm.modified, edge, priority++))
+                return false;
+
+            ++stats_.thumbnails;
+            return true;
+        });
+        warm_.erase(done, warm_.end());
+    }
+
+    // ============== Persistence ==============
+
+    core::Path PrefetchEngine::DefaultLocation()
+    {
+        return core::Path(core::HashCache::DefaultLocation().Get().parent_path() / "navigation.dat");
+    }
+
+    bool PrefetchEngine::Load(const core::Path& file)
+    {
+        file_.SetPath(file.Get());
+
+        std::ifstream in(file.Get());
+        if (!in)
+            return false;
+
+        std::string line;
+        if (!std::getline(in, line) || line != kHeader)
+        {
+            SPDLOG_WARN("Ignoring navigation history in {}: unknown format", file.String());
+            return false;
+        }
+
+        // P <score> <last visit> <path>, then N <count> <path> for each of
+        // its successors; paths run to the end of the line
+        std::unordered_map<std::string, Node> nodes;
+        Node* node = nullptr;
+        while (std::getline(in, line))
+        {
+            std::istringstream fields(line);
+            std::string tag;
+            fields >> tag;
+            if (tag == "S")
+            {
+                fields >> stats_.predicted >> stats_.used >> stats_.network_predicted >> stats_.network_used;
+                continue;
+            }
+
+            std::string path;
+            if (tag == "P")
+            {
+                double score = 0.0;
+                int64_t last_visit = 0;
+                fields >> score >> last_visit;
+                fields.ignore(1);
+                std::getline(fields, path);
+                if (!fields.fail() && !path.empty())
+                {
+                    node = &nodes[Key(path)];
+                    node->path = path;
+                    node->score = score;
+                    node->last_visit = last_visit;
+                }
+            }
+            else if (tag == "N" && node)
+            {
+                Successor successor;
+                fields >> successor.count;
+                fields.ignore(1);
+                std::getline(fields, path);
+                if (!fields.fail() && !path.empty() && node->next.size() < kMaxSuccessors)
+                {
+                    successor.key = Key(path);
+                    node->next.push_back(std::move(successor));
+                }
+            }
+        }
+
+        nodes_ = std::move(nodes);
+        Prune();
+        SPDLOG_INFO("Loaded navigation history: {} directories", nodes_.size());
+        return true;
+    }
+
+    std::string PrefetchEngine::Serialize() const
+    {
+        // Sorted, so an unchanged model writes the same text
+        std::vector<const std::string*> keys;
+        keys.reserve(nodes_.size());
+        for (const auto& [key, node] : nodes_)
+        {
+            keys.push_back(&key);
+        }
+        std::sort(keys.begin(), keys.end(), [](const std::string* a, const std::string* b) { return *a < *b; });
+
+        std::ostringstream out;
+        out.precision(17);
+        out << kHeader << '\n';
+        out << "S " << stats_.predicted << ' ' << stats_.used << ' '
+            << stats_.network_predicted << ' ' << stats_.network_used << '\n';
+        for (const std::string* key : keys)
+        {
+            const Node& node = nodes_.at(*key);
+            out << "P " << node.score << ' ' << node.last_visit << ' ' << node.path << '\n';
+            for (const auto& successor : node.next)
+            {
+                auto it = nodes_.find(successor.key);
+                if (it != nodes_.end())
+                    out << "N " << successor.count << ' ' << it->second.path << '\n';
+            }
+        }
+        return out.str();
+    }
+
+    bool PrefetchEngine::Save()
+    {
+        if (file_.GetPath().empty())
+            file_.SetPath(DefaultLocation().Get());
+
+        std::string state = Serialize();
+        if (file_.Unchanged(state))
+            return true;
+
+        if (!file_.Write(state, state))
+        {
+            SPDLOG_WARN("Failed to save navigation history to {}", file_.GetPath().u8string());
+            return false;
+        }
+        return true;
+    }
+
+    PrefetchEngine& GetPrefetchEngine()
+    {
+        static PrefetchEngine engine;
+        return engine;
+    }
+
+} // namespace opacity::ui
@@ -0,0 +1,515 @@
+#include "opacity/ui/ProfilerOverlay.h"
+#include "opacity/ui/PrefetchEngine.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/MemoryGovernor.h"
+#include "opacity/core/Metrics.h"
+#include "opacity/core/StartupProfile.h"
+
+#include <imgui.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unordered_map>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        double Milliseconds(uint64_t nanoseconds)
+        {
+            return static_cast<double>(nanoseconds) / 1'000'000.0;
+        }
+
+        double Megabytes(size_t bytes)
+        {
+            return static_cast<double>(bytes) / (1024.0 * 1024.0);
+        }
+
+        // Stable per name, so a zone keeps its colour from frame to frame
+        ImU32 ZoneColor(const char* name)
+        {
+            size_t hash = std::hash<std::string>()(name);
+            float hue = static_cast<float>(hash % 360) / 360.0f;
+            ImVec4 color;
+            ImGui::ColorConvertHSVtoRGB(hue, 0.5f, 0.8f, color.x, color.y, color.z);
+            color.w = 1.0f;
+            return ImGui::ColorConvertFloat4ToU32(color);
+        }
+    }
+
+    ProfilerOverlay::~ProfilerOverlay()
+    {
+        if (visible_)
+            core::Profiler::SetEnabled(false);
+    }
+
+    void ProfilerOverlay::Show()
+    {
+        visible_ = true;
+        core::Profiler::SetEnabled(true);
+    }
+
+    void ProfilerOverlay::Hide()
+    {
+        visible_ = false;
+        core::Profiler::SetEnabled(false);
+        threads_.clear();
+        frames_.clear();
+        selected_frame_ = -1;
+    }
+
+    void ProfilerOverlay::Capture()
+    {
+        uint64_t now = core::Profiler::Now();
+        threads_ = core::Profiler::Collect(now > kHistory ? now - kHistory : 0);
+
+        frames_.clear();
+        for (const auto& thread : threads_)
+        {
+            for (const auto& zone : thread.zones)
+            {
+                if (zone.depth == 0 && std::strcmp(zone.name, kFrameZone) == 0)
+                    frames_.push_back(zone);
+            }
+        }
+        if (frames_.size() > kMaxFrames)
+            frames_.erase(frames_.begin(), frames_.end() - kMaxFrames);
+    }
+
+    void ProfilerOverlay::Render()
+    {
+        if (!visible_)
+            return;
+
+        ImGui::SetNextWindowSize(ImVec2(900, 600), ImGuiCond_FirstUseEver);
+        bool open = true;
+        if (ImGui::Begin("Profiler", &open))
+        {
+            if (!paused_)
+                Capture();
+
+            ImGui::Checkbox("Pause", &paused_);
+            ImGui::SameLine();
+            if (ImGui::Button("Slowest Frame") && !frames_.empty())
+            {
+                auto slowest = std::max_element(frames_.begin(), frames_.end(),
+                    [](const core::ProfileZone& a, const core::ProfileZone& b)
+                    {
+                        return a.end - a.start < b.end - b.start;
+                    });
+                selected_frame_ = static_cast<int>(slowest - frames_.begin());
+                paused_ = true;
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Export Trace"))
+            {
+                core::Profiler::ExportChromeTrace(core::Path(std::string("opacity_trace.json")));
+            }
+
+            RenderStartup();
+            RenderMemory();
+            RenderPrefetch();
+            RenderMetrics();
+
+            if (frames_.empty())
+            {
+                ImGui::TextDisabled("No frames recorded yet");
+            }
+            else
+            {
+                if (selected_frame_ >= static_cast<int>(frames_.size()))
+                    selected_frame_ = -1;
+
+                RenderFrameGraph();
+
+                const auto& frame = frames_[selected_frame_ < 0 ? frames_.size() - 1 : selected_frame_];
+                ImGui::Separator();
+                RenderTimeline(frame);
+                ImGui::Separator();
+                RenderHotZones(frame);
+            }
+        }
+        ImGui::End();
+
+        if (!open)
+            Hide();
+    }
+
+    void ProfilerOverlay::RenderFrameGraph()
+    {
+        std::vector<float> times;
+        times.reserve(frames_.size());
+        float slowest = 0.0f;
+        for (const auto& frame : frames_)
+        {
+            times.push_back(static_cast<float>(Milliseconds(frame.end - frame.start)));
+            slowest = std::max(slowest, times.back());
+        }
+
+        int shown = selected_frame_ < 0 ? static_cast<int>(frames_.size()) - 1 : selected_frame_;
+        char overlay[32];
+        std::snprintf(overlay, sizeof(overlay), "%.2f ms", times[shown]);
+        ImGui::PlotHistogram("##FrameTimes", times.data(), static_cast<int>(times.size()), 0,
+                             overlay, 0.0f, std::max(slowest, 16.7f), ImVec2(-1, 80));
+
+        // Picking a frame pauses, so it stays put while it is read
+        if (ImGui::SliderInt("Frame", &shown, 0, static_cast<int>(frames_.size()) - 1))
+        {
+            selected_frame_ = shown;
+            paused_ = true;
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Newest"))
+        {
+            selected_frame_ = -1;
+            paused_ = false;
+        }
+    }
+
+    void ProfilerOverlay::RenderTimeline(const core::ProfileZone& frame)
+    {
+        const float row_height = ImGui::GetTextLineHeight() + 2.0f;
+        const float label_width = 140.0f;
+        const double span = static_cast<double>(std::max<uint64_t>(frame.end - frame.start, 1));
+
+        ImGui::BeginChild("Timeline", ImVec2(0, ImGui::GetContentRegionAvail().y * 0.6f), true,
+                          ImGuiWindowFlags_HorizontalScrollbar);
+        ImDrawList* draw_list = ImGui::GetWindowDrawList();
+        const float width = std::max(ImGui::GetContentRegionAvail().x - label_width, 50.0f);
+
+        for (const auto& thread : threads_)
+        {
+            // Only threads that did something during the frame get a row
+            uint32_t depth = 0;
+            bool any = false;
+            for (const auto& zone : thread.zones)
+            {
+                if (zone.end >= frame.start && zone.start <= frame.end)
+                {
+                    depth = std::max(depth, zone.depth);
+                    any = true;
+                }
+            }
+            if (!any)
+                continue;
+
+            ImVec2 origin = ImGui::GetCursorScreenPos();
+            ImGui::TextUnformatted(thread.name.c_str());
+            ImGui::SetCursorScreenPos(origin);
+            ImGui::Dummy(ImVec2(label_width + width, row_height * (depth + 1)));
+
+            for (const auto& zone : thread.zones)
+            {
+                if (zone.end < frame.start || zone.start > frame.end)
+                    continue;
+
+                uint64_t start = std::max(zone.start, frame.start);
+                uint64_t end = std::min(zone.end, frame.end);
+                float x0 = origin.x + label_width + static_cast<float>((start - frame.start) / span) * width;
+                float x1 = origin.x + label_width + static_cast<float>((end - frame.start) / span) * width;
+                x1 = std::max(x1, x0 + 1.0f);
+                float y0 = origin.y + row_height * zone.depth;
+                ImVec2 min(x0, y0);
+                ImVec2 max(x1, y0 + row_height - 1.0f);
+
+                draw_list->AddRectFilled(min, max, ZoneColor(zone.name));
+                if (x1 - x0 > ImGui::CalcTextSize(zone.name).x + 4.0f)
+                    draw_list->AddText(ImVec2(x0 + 2.0f, y0), IM_COL32(0, 0, 0, 255), zone.name);
+
+                if (ImGui::IsMouseHoveringRect(min, max))
+                {
+                    ImGui::SetTooltip("%s\n%.3f ms", zone.name, Milliseconds(zone.end - zone.start));
+                }
+            }
+        }
+        ImGui::EndChild();
+    }
+
+    void ProfilerOverlay::RenderHotZones(const core::ProfileZone& frame)
+    {
+        struct Total
+        {
+            const char* name = nullptr;
+            uint64_t time = 0;
+            size_t calls = 0;
+        };
+
+        // Keyed by text: two call sites may name the same zone
+        std::unordered_map<std::string, Total> totals;
+        for (const auto& thread : threads_)
+        {
+            for (const auto& zone : thread.zones)
+            {
+                if (zone.start < frame.start || zone.end > frame.end ||
+                    (zone.depth == 0 && std::strcmp(zone.name, kFrameZone) == 0))
+                    continue;
+
+                Total& total = totals[zone.name];
+                total.name = zone.name;
+                total.time += zone.end - zone.start;
+                ++total.calls;
+            }
+        }
+
+        std::vector<Total> sorted;
+        sorted.reserve(totals.size());
+        for (const auto& [name, total] : totals)
+            sorted.push_back(total);
+        std::sort(sorted.begin(), sorted.end(),
+                  [](const Total& a, const Total& b) { return a.time > b.time; });
+
+        if (ImGui::BeginTable("HotZones", 3, ImGuiTableFlags_RowBg | ImGuiTableFlags_ScrollY | ImGuiTableFlags_Borders))
+        {
+            ImGui::TableSetupColumn("Zone");
+            ImGui::TableSetupColumn("Calls");
+            ImGui::TableSetupColumn("Total (ms)");
+            ImGui::TableHeadersRow();
+            for (const auto& total : sorted)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(total.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%zu", total.calls);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.3f", Milliseconds(total.time));
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void ProfilerOverlay::RenderStartup()
+    {
+        uint64_t begin = core::StartupProfile::GetBegin();
+        uint64_t interactive = core::StartupProfile::GetInteractive();
+        uint64_t complete = core::StartupProfile::GetComplete();
+
+        char header[96];
+        std::snprintf(header, sizeof(header), "Startup: interactive in %.1f ms###Startup",
+                      interactive ? Milliseconds(interactive - begin) : 0.0);
+        if (!ImGui::CollapsingHeader(header))
+            return;
+
+        if (interactive && interactive - begin > core::StartupProfile::kInteractiveTarget)
+        {
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "Over the %.0f ms target",
+                               Milliseconds(core::StartupProfile::kInteractiveTarget));
+        }
+        if (complete)
+            ImGui::Text("Deferred work done at %.1f ms", Milliseconds(complete - begin));
+        else
+            ImGui::TextDisabled("Deferred work still running");
+
+        auto phases = core::StartupProfile::GetPhases();
+        if (ImGui::BeginTable("StartupPhases", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+        {
+            ImGui::TableSetupColumn("Phase");
+            ImGui::TableSetupColumn("At (ms)");
+            ImGui::TableSetupColumn("Took (ms)");
+            ImGui::TableSetupColumn("Path");
+            ImGui::TableHeadersRow();
+            for (const auto& phase : phases)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(phase.name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", Milliseconds(phase.start - begin));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.2f", Milliseconds(phase.end - phase.start));
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(phase.critical ? "Critical" : "Deferred");
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void ProfilerOverlay::RenderMemory()
+    {
+        auto& governor = core::MemoryGovernor::Get();
+        core::MemoryStatus status = governor.GetStatus();
+
+        char header[96];
+        std::snprintf(header, sizeof(header), "Memory: %.0f of %.0f MB###Memory",
+                      Megabytes(status.used_bytes), Megabytes(status.budget_bytes));
+        if (!ImGui::CollapsingHeader(header))
+            return;
+
+        if (status.low_memory)
+            ImGui::TextColored(ImVec4(1.0f, 0.6f, 0.2f, 1.0f), "The system is low on memory");
+        ImGui::Text("Installed %.0f MB, %llu passes trimmed", Megabytes(status.physical_bytes),
+                    static_cast<unsigned long long>(status.enforcements));
+        ImGui::SameLine();
+        if (ImGui::SmallButton("Enforce now"))
+            governor.Enforce();
+
+        auto usage = governor.GetUsage();
+        std::sort(usage.begin(), usage.end(), [](const core::CacheUsage& a, const core::CacheUsage& b)
+        {
+            return a.bytes > b.bytes;
+        });
+        if (ImGui::BeginTable("MemoryCaches", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+        {
+            ImGui::TableSetupColumn("Cache");
+            ImGui::TableSetupColumn("MB");
+            ImGui::TableSetupColumn("Trims");
+            ImGui::TableSetupColumn("Trimmed (MB)");
+            ImGui::TableHeadersRow();
+            for (const auto& cache : usage)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(cache.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", Megabytes(cache.bytes));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(cache.trims));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f", Megabytes(cache.trimmed_bytes));
+            }
+            ImGui::EndTable();
+        }
+    }
+
+    void ProfilerOverlay::RenderPrefetch()
+    {
+        const PrefetchStats& stats = GetPrefetchEngine().GetStats();
+        auto rate = [](uint64_t used, uint64_t predicted)
+        {
+            return predicted ? 100.0 * static_cast<double>(used) / static_cast<double>(predicted) : 0.0;
+        };
+
+        char header[96];
+        std::snprintf(header, sizeof(header), "Prefetch: %.0f%% of guesses used###Prefetch",
+                      rate(stats.used, stats.predicted));
+        if (!ImGui::CollapsingHeader(header))
+            return;
+
+        if (ImGui::BeginTable("PrefetchStats", 4, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+        {
+            ImGui::TableSetupColumn("Paths");
+            ImGui::TableSetupColumn("Guessed");
+            ImGui::TableSetupColumn("Used");
+            ImGui::TableSetupColumn("Hit rate");
+            ImGui::TableHeadersRow();
+
+            auto row = [&](const char* name, uint64_t predicted, uint64_t used)
+            {
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(name);
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(predicted));
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(used));
+                ImGui::TableNextColumn();
+                ImGui::Text("%.1f%%", rate(used, predicted));
+            };
+            row("All", stats.predicted, stats.used);
+            row("Network", stats.network_predicted, stats.network_used);
+            ImGui::EndTable();
+        }
+        ImGui::Text("%llu network guesses not read ahead, %llu thumbnails made ahead",
+                    static_cast<unsigned long long>(stats.network_skipped),
+                    static_cast<unsigned long long>(stats.thumbnails));
+    }
+
+    void ProfilerOverlay::RenderMetrics()
+    {
+        // Rates are taken over a second, so they read steadily
+        constexpr auto kRateInterval = std::chrono::seconds(1);
+
+        auto samples = core::Metrics::Get().Snapshot();
+
+        char header[64];
+        std::snprintf(header, sizeof(header), "Metrics: %zu series###Metrics", samples.size());
+        if (!ImGui::CollapsingHeader(header))
+            return;
+
+        auto key_of = [](const core::MetricSample& sample)
+        {
+            std::string key = sample.name;
+            for (const auto& [name, value] : sample.labels)
+                key += ' ' + name + '=' + value;
+            return key;
+        };
+
+        auto now = std::chrono::steady_clock::now();
+        if (now - rates_sampled_ >= kRateInterval)
+        {
+            double seconds = std::chrono::duration<double>(now - rates_sampled_).count();
+            bool first = rates_sampled_ == std::chrono::steady_clock::time_point{};
+            for (const auto& sample : samples)
+            {
+                if (sample.type != core::MetricType::Counter)
+                    continue;
+
+                std::string key = key_of(sample);
+                auto previous = counter_previous_.find(key);
+                if (!first && previous != counter_previous_.end())
+                    counter_rates_[key] = static_cast<double>(sample.counter - previous->second) / seconds;
+                counter_previous_[key] = sample.counter;
+            }
+            rates_sampled_ = now;
+        }
+
+        ImGui::SetNextItemWidth(200.0f);
+        ImGui::InputTextWithHint("##MetricsFilter", "Filter", metrics_filter_, sizeof(metrics_filter_));
+
+        if (ImGui::BeginTable("MetricsSeries", 9, ImGuiTableFlags_RowBg | ImGuiTableFlags_Borders))
+        {
+            ImGui::TableSetupColumn("Metric");
+            ImGui::TableSetupColumn("Labels");
+            ImGui::TableSetupColumn("Value");
+            ImGui::TableSetupColumn("Per second");
+            ImGui::TableSetupColumn("Count");
+            ImGui::TableSetupColumn("p50");
+            ImGui::TableSetupColumn("p90");
+            ImGui::TableSetupColumn("p99");
+            ImGui::TableSetupColumn("Max");
+            ImGui::TableHeadersRow();
+            for (const auto& sample : samples)
+            {
+                std::string key = key_of(sample);
+                if (metrics_filter_[0] != '\0' && key.find(metrics_filter_) == std::string::npos)
+                    continue;
+
+                ImGui::TableNextRow();
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(sample.name.c_str());
+                ImGui::TableNextColumn();
+                ImGui::TextUnformatted(key.c_str() + std::min(key.size(), sample.name.size() + 1));
+
+                ImGui::TableNextColumn();
+                if (sample.type == core::MetricType::Counter)
+                {
+                    ImGui::Text("%llu", static_cast<unsigned long long>(sample.counter));
+                    ImGui::TableNextColumn();
+                    auto rate = counter_rates_.find(key);
+                    if (rate != counter_rates_.end())
+                        ImGui::Text("%.1f", rate->second);
+                    continue;
+                }
+                if (sample.type == core::MetricType::Gauge)
+                {
+                    ImGui::Text("%lld", static_cast<long long>(sample.gauge));
+                    continue;
+                }
+
+                const core::HistogramSummary& h = sample.histogram;
+                ImGui::TableNextColumn();
+                ImGui::TableNextColumn();
+                ImGui::Text("%llu", static_cast<unsigned long long>(h.count));
+                for (uint64_t value : {h.p50, h.p90, h.p99, h.max})
+                {
+                    ImGui::TableNextColumn();
+                    ImGui::Text("%llu", static_cast<unsigned long long>(value));
+                }
+            }
+            ImGui::EndTable();
+        }
+    }
+
+} // namespace opacity::ui
@@ -0,0 +1,245 @@
+#include "opacity/ui/ResidentService.h"
+#include "opacity/search/IndexHost.h"
+#include "opacity/core/Config.h"
+#include "opacity/core/HashCache.h"
+#include "opacity/core/Logger.h"
+#include "opacity/core/ShellIntegration.h"
+#include "opacity/preview/DocumentText.h"
+
+#include <thread>
+
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <Windows.h>
+#include <ShlObj.h>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        constexpr wchar_t kWindowClass[] = L"OpacityResidentService";
+        constexpr UINT_PTR kTooltipTimer = 1;
+        constexpr UINT kTooltipIntervalMs = 5000;
+
+        std::filesystem::path HomeFolder()
+        {
+            std::filesystem::path home;
+            PWSTR path = nullptr;
+            if (SUCCEEDED(SHGetKnownFolderPath(FOLDERID_Profile, 0, nullptr, &path)) && path)
+            {
+                home = path;
+            }
+            CoTaskMemFree(path);
+            return home;
+        }
+    }
+
+    ResidentService::ResidentService()
+        : index_(std::make_shared<search::SearchIndex>())
+    {
+    }
+
+    ResidentService::~ResidentService() = default;
+
+    bool ResidentService::IsEnabled()
+    {
+        auto config = core::Config::Get();
+        return config && config->Get<bool>("resident.enabled", false);
+    }
+
+    search::IndexConfig ResidentService::DefaultIndexConfig()
+    {
+        search::IndexConfig config;
+        if (auto settings = core::Config::Get())
+        {
+            for (const auto& root : settings->Get<std::vector<std::string>>("resident.roots", {}))
+            {
+                config.roots.push_back(std::filesystem::u8path(root));
+            }
+            config.indexContent = settings->Get<bool>("resident.index_content", false);
+        }
+        if (config.roots.empty())
+        {
+            std::filesystem::path home = HomeFolder();
+            if (!home.empty())
+                config.roots.push_back(home);
+        }
+
+        // Next to the indexes headless searches keep, under its own name
+        config.indexPath = core::HashCache::DefaultLocation().Get().parent_path() / "indexes" / "resident";
+        return config;
+    }
+
+    bool ResidentService::Launch()
+    {
+        if (search::IndexClient::IsHostRunning())
+            return true;
+
+        std::wstring executable = core::ShellIntegration::GetExecutablePath().wstring();
+        std::wstring command_line = L"\"" + executable + L"\" resident";
+
+        STARTUPINFOW startup = {};
+        startup.cb = sizeof(startup);
+        PROCESS_INFORMATION process = {};
+        if (!CreateProcessW(executable.c_str(), command_line.data(), nullptr, nullptr, FALSE,
+                            DETACHED_PROCESS | CREATE_NEW_PROCESS_GROUP, nullptr, nullptr, &startup, &process))
+        {
+            core::Logger::Get()->warn("ResidentService: cannot start the resident process ({})", GetLastError());
+            return false;
+        }
+        CloseHandle(process.hThread);
+        CloseHandle(process.hProcess);
+        return true;
+    }
+
+    void ResidentService::OpenWindow()
+    {
+        std::wstring executable = core::ShellIntegration::GetExecutablePath().wstring();
+        std::wstring command_line = L"\"" + executable + L"\"";
+
+        STARTUPINFOW startup = {};
+        startup.cb = sizeof(startup);
+        PROCESS_INFORMATION process = {};
+        if (CreateProcessW(executable.c_str(), command_line.data(), nullptr, nullptr, FALSE, 0, nullptr, nullptr,
+                           &startup, &process))
+        {
+            // Started from the tray, so it may take the foreground
+            AllowSetForegroundWindow(process.dwProcessId);
+            CloseHandle(process.hThread);
+            CloseHandle(process.hProcess);
+        }
+    }
+
+    void ResidentService::UpdateTooltip()
+    {
+        auto stats = index_->GetStatistics();
+        std::string tooltip = "Opacity: ";
+        if (index_->IsIndexing())
+            tooltip += "indexing (" + std::to_string(static_cast<int>(index_->GetIndexingProgress() * 100)) + "%)";
+        else
+            tooltip += std::to_string(stats.totalFiles) + " files indexed";
+
+        size_t clients = tray_.GetIndexClientCount();
+        if (clients > 0)
+            tooltip += ", " + std::to_string(clients) + (clients == 1 ? " window" : " windows");
+        tray_.SetTooltip(tooltip);
+    }
+
+    int ResidentService::Run()
+    {
+        if (search::IndexClient::IsHostRunning())
+        {
+            core::Logger::Get()->info("ResidentService: another process is resident already");
+            return 0;
+        }
+
+        search::IndexConfig config = DefaultIndexConfig();
+        index_->SetContentExtractor(preview::DocumentTextExtractor::GetSupportedExtensions(),
+            [](const std::filesystem::path& path, const std::function<bool(std::string_view)>& sink) {
+                return preview::DocumentTextExtractor::Extract(core::Path(path), sink);
+            });
+        if (!index_->Initialize(config))
+        {
+            core::Logger::Get()->error("ResidentService: cannot open the index at {}", config.indexPath.u8string());
+            return 1;
+        }
+
+        HINSTANCE instance = GetModuleHandleW(nullptr);
+        WNDCLASSEXW window_class = {};
+        window_class.cbSize = sizeof(window_class);
+        window_class.lpszClassName = kWindowClass;
+        window_class.hInstance = instance;
+        window_class.lpfnWndProc = [](HWND hwnd, UINT msg, WPARAM wparam, LPARAM lparam) -> LRESULT
+        {
+            auto* service = reinterpret_cast<ResidentService*>(GetWindowLongPtrW(hwnd, GWLP_USERDATA));
+            if (service && service->tray_.ProcessMessage(msg, wparam, lparam))
+                return 0;
+
+            switch (msg)
+            {
+            case WM_TIMER:
+                if (service && wparam == kTooltipTimer)
+                    service->UpdateTooltip();
+                return 0;
+            case WM_ENDSESSION:
+                // Not asked to close when the session ends, only ended
+                if (service && wparam)
+                    service->index_->SaveIndex();
+                return 0;
+            case WM_CLOSE:
+                DestroyWindow(hwnd);
+                return 0;
+            case WM_DESTROY:
+                PostQuitMessage(0);
+                return 0;
+            }
+            return DefWindowProcW(hwnd, msg, wparam, lparam);
+        };
+        RegisterClassExW(&window_class);
+
+        // Never shown; it only receives the tray icon's messages
+        HWND window = CreateWindowExW(0, kWindowClass, L"Opacity", WS_OVERLAPPED, 0, 0, 0, 0,
+                                      nullptr, nullptr, instance, nullptr);
+        if (!window)
+        {
+            core::Logger::Get()->error("ResidentService: cannot create the tray window ({})", GetLastError());
+            UnregisterClassW(kWindowClass, instance);
+            return 1;
+        }
+        SetWindowLongPtrW(window, GWLP_USERDATA, reinterpret_cast<LONG_PTR>(this));
+
+        SystemTrayConfig tray_config;
+        tray_config.tooltip = "Opacity: loading the index";
+        tray_config.showOnMinimize = true;
+        tray_.Initialize(window, tray_config);
+        TrayMenuItem update_item;
+        update_item.id = "update_index";
+        update_item.label = "&Update index";
+        tray_.SetMenuItems({update_item});
+        tray_.OnMenuItemSelected([this](const std::string& id) {
+            if (id == "update_index" && !index_->IsIndexing())
+            {
+                std::thread([index = index_]() { index->UpdateIndex(); }).detach();
+            }
+        });
+        tray_.OnShowRequested(&ResidentService::OpenWindow);
+        tray_.Show();
+
+        // Served from the start; until the load finishes answers are empty
+        if (!tray_.HostIndex(index_))
+        {
+            tray_.Shutdown();
+            DestroyWindow(window);
+            UnregisterClassW(kWindowClass, instance);
+            return 0;
+        }
+
+        std::thread loader([index = index_]() {
+            // Loaded once here rather than in every window
+            if (!index->LoadIndex() || index->GetStatistics().totalFiles == 0)
+                index->RebuildIndex();
+            else
+                index->UpdateIndex();
+            index->StartAutoUpdate();
+        });
+
+        SetTimer(window, kTooltipTimer, kTooltipIntervalMs, nullptr);
+        core::Logger::Get()->info("ResidentService: serving the index of {} root(s)", config.roots.size());
+
+        MSG msg;
+        while (GetMessageW(&msg, nullptr, 0, 0) > 0)
+        {
+            TranslateMessage(&msg);
+            DispatchMessageW(&msg);
+        }
+
+        // Windows still connected fall back to their own searches
+        index_->CancelIndexing();
+        loader.join();
+        tray_.Shutdown();
+        index_->Shutdown();
+        UnregisterClassW(kWindowClass, instance);
+        return 0;
+    }
+
+} // namespace opacity::ui
@@ -0,0 +1,243 @@
+#include "opacity/ui/SearchResultsModel.h"
+#include "opacity/core/Profiler.h"
+
+#include <algorithm>
+#include <numeric>
+#include <string_view>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        // Case-insensitive (ASCII), so C:\Foo and c:\foo sit together
+        bool FoldedLess(std::string_view a, std::string_view b)
+        {
+            auto fold = [](char c)
+            {
+                auto byte = static_cast<unsigned char>(c);
+                return (byte >= 'A' && byte <= 'Z') ? static_cast<unsigned char>(byte + ('a' - 'A')) : byte;
+            };
+            return std::lexicographical_compare(a.begin(), a.end(), b.begin(), b.end(),
+                                                [&fold](char x, char y) { return fold(x) < fold(y); });
+        }
+
+        std::string_view ParentOf(const std::string& path)
+        {
+            size_t slash = path.find_last_of("/\\");
+            return slash == std::string::npos ? std::string_view() : std::string_view(path).substr(0, slash);
+        }
+    }
+
+    SearchResultsModel::~SearchResultsModel()
+    {
+        context_cancel_.Cancel();
+    }
+
+    void SearchResultsModel::Reset()
+    {
+        search::SearchResult discarded;
+        while (pending_.Pop(discarded))
+        {
+        }
+        pushed_ = 0;
+        drained_ = 0;
+
+        results_.clear();
+        group_of_.clear();
+        context_read_.clear();
+        context_cancel_.Cancel();
+        context_cancel_ = core::CancellationSource();
+        loaded_ = std::make_shared<core::MpscQueue<LoadedContext>>();
+        context_loads_ = 0;
+        order_.clear();
+        groups_.clear();
+        group_index_.clear();
+        rows_.clear();
+    }
+
+    void SearchResultsModel::Push(search::SearchResult result)
+    {
+        // Counted first, so the pending count never runs below zero
+        pushed_.fetch_add(1, std::memory_order_relaxed);
+        pending_.Push(std::move(result));
+    }
+
+    bool SearchResultsModel::Drain()
+    {
+        OPACITY_PROFILE_ZONE("SearchResultsModel::Drain");
+        TakeLoadedContexts();
+
+        size_t first = results_.size();
+        search::SearchResult result;
+        while (results_.size() - first < kMaxDrainPerFrame && pending_.Pop(result))
+        {
+            Append(std::move(result));
+            ++drained_;
+        }
+        if (results_.size() == first)
+            return false;
+
+        SortBatch(first);
+        BuildRows();
+        return true;
+    }
+
+    void SearchResultsModel::Assign(std::vector<search::SearchResult> results)
+    {
+        Reset();
+        for (auto& result : results)
+        {
+            Append(std::move(result));
+        }
+        SortBatch(0);
+        BuildRows();
+    }
+
+    void SearchResultsModel::Append(search::SearchResult result)
+    {
+        auto index = static_cast<uint32_t>(results_.size());
+        std::string directory(ParentOf(result.item.path));
+        auto [it, added] = group_index_.try_emplace(directory, static_cast<uint32_t>(groups_.size()));
+        if (added)
+        {
+            Group group;
+            group.directory = std::move(directory);
+            groups_.push_back(std::move(group));
+        }
+        ++groups_[it->second].size;
+
+        results_.push_back(std::move(result));
+        group_of_.push_back(it->second);
+        context_read_.push_back(false);
+        order_.push_back(index);
+    }
+
+    void SearchResultsModel::SortBatch(size_t first)
+    {
+        if (!sort_column_)
+            return;
+
+        OPACITY_PROFILE_ZONE("SearchResultsModel::SortBatch");
+        filesystem::FsItemComparator comparator(*sort_column_, sort_direction_);
+        auto less = [this, &comparator](uint32_t a, uint32_t b)
+        {
+            return comparator(results_[a].item, results_[b].item);
+        };
+
+        // The batch is in arrival order, so both steps keeping ties in
+        // place keeps the whole order stable
+        auto middle = order_.begin() + static_cast<ptrdiff_t>(first);
+        std::stable_sort(middle, order_.end(), less);
+        std::inplace_merge(order_.begin(), middle, order_.end(), less);
+    }
+
+    void SearchResultsModel::BuildRows()
+    {
+        rows_.clear();
+        if (!grouped_)
+            return;
+
+        OPACITY_PROFILE_ZONE("SearchResultsModel::BuildRows");
+        std::vector<uint32_t> sorted_groups(groups_.size());
+        std::iota(sorted_groups.begin(), sorted_groups.end(), 0u);
+        std::sort(sorted_groups.begin(), sorted_groups.end(), [this](uint32_t a, uint32_t b)
+        {
+            return FoldedLess(groups_[a].directory, groups_[b].directory);
+        });
+
+        // Where each group's results start in rows_, to fill them in view order
+        std::vector<size_t> next(groups_.size());
+        size_t row_count = 0;
+        for (uint32_t group : sorted_groups)
+        {
+            ++row_count;
+            next[group] = row_count;
+            if (groups_[group].expanded)
+                row_count += groups_[group].size;
+        }
+
+        rows_.resize(row_count);
+        for (uint32_t group : sorted_groups)
+        {
+            rows_[next[group] - 1] = {group, true};
+        }
+        for (uint32_t index : order_)
+        {
+            uint32_t group = group_of_[index];
+            if (groups_[group].expanded)
+                rows_[next[group]++] = {index, false};
+        }
+    }
+
+    void SearchResultsModel::SetSort(std::optional<filesystem::SortColumn> column, filesystem::SortDirection direction)
+    {
+        if (column == sort_column_ && (!column || direction == sort_direction_))
+            return;
+
+        sort_column_ = column;
+        sort_direction_ = direction;
+
+        // From arrival order again, so equal results keep theirs
+        std::iota(order_.begin(), order_.end(), 0u);
+        SortBatch(0);
+        BuildRows();
+    }
+
+    void SearchResultsModel::SetGrouped(bool grouped)
+    {
+        if (grouped == grouped_)
+            return;
+
+        grouped_ = grouped;
+        BuildRows();
+    }
+
+    void SearchResultsModel::ToggleGroup(uint32_t group)
+    {
+        if (group >= groups_.size())
+            return;
+
+        groups_[group].expanded = !groups_[group].expanded;
+        BuildRows();
+    }
+
+    const std::string& SearchResultsModel::Context(uint32_t index)
+    {
+        TakeLoadedContexts();
+
+        // Not on this thread: the file may be large, cold, or on a share.
+        // Rows past the in-flight limit ask again on a later frame
+        search::SearchResult& result = results_[index];
+        if (!context_read_[index] && context_loads_ < kMaxContextLoads)
+        {
+            context_read_[index] = true;
+            if (result.match_length > 0 && result.match_context.empty())
+            {
+                core::TaskOptions options;
+                options.priority = core::TaskPriority::Interactive;
+                options.cancel = context_cancel_.Token();
+                options.io_device = core::TaskScheduler::IoDevice(result.item.full_path);
+                ++context_loads_;
+                core::TaskScheduler::Get().Submit(
+                    [loaded = loaded_, index, copy = result](const core::CancellationToken& cancel) mutable {
+                        if (!cancel.IsCancelled())
+                            search::SearchEngine::LoadContext(copy);
+                        loaded->Push({index, std::move(copy.match_context)});
+                    }, std::move(options));
+            }
+        }
+        return result.match_context;
+    }
+
+    void SearchResultsModel::TakeLoadedContexts()
+    {
+        LoadedContext loaded;
+        while (context_loads_ > 0 && loaded_->Pop(loaded))
+        {
+            --context_loads_;
+            if (loaded.index < results_.size())
+                results_[loaded.index].match_context = std::move(loaded.context);
+        }
+    }
+
+} // namespace opacity::ui
@@ -0,0 +1,218 @@
+#include "opacity/ui/SelectionSet.h"
+
+#include <algorithm>
+
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+
+namespace opacity::ui
+{
+    namespace
+    {
+        inline size_t PopCount(uint64_t bits)
+        {
+#ifdef _MSC_VER
+            return static_cast<size_t>(__popcnt64(bits));
+#else
+            return static_cast<size_t>(__builtin_popcountll(bits));
+#endif
+        }
+
+        // Bits [begin, end) of a word, with 0 < end - begin <= 64
+        inline uint64_t WordMask(size_t begin, size_t end)
+        {
+            uint64_t mask = ~uint64_t{0} << (begin & 63);
+            if ((end & 63) != 0 && (end >> 6) == (begin >> 6))
+                mask &= (uint64_t{1} << (end & 63)) - 1;
+            return mask;
+        }
+    }
+
+    size_t SelectionSet::CountTrailingZeros(uint64_t bits)
+    {
+#ifdef _MSC_VER
+        unsigned long index;
+        _BitScanForward64(&index, bits);
+        return static_cast<size_t>(index);
+#else
+        return static_cast<size_t>(__builtin_ctzll(bits));
+#endif
+    }
+
+    void SelectionSet::Reset(size_t size)
+    {
+        size_ = size;
+        Clear();
+    }
+
+    void SelectionSet::Resize(size_t size)
+    {
+        if (size > size_)
+        {
+            // Past the old end nothing is in a range or toggled, which an
+            // inverted set would read as selected
+            if (inverted_)
+            {
+                AddRange(size_, size);
+                raw_count_ += size - size_;
+            }
+        }
+        else if (size < size_)
+        {
+            raw_count_ -= CountRaw(size, size_);
+            RemoveRange(size, size_);
+            ClearToggles(size, size_);
+            words_.resize(std::min(words_.size(), (size + 63) >> 6));
+        }
+        size_ = size;
+    }
+
+    void SelectionSet::Set(size_t position, bool selected)
+    {
+        if (position < size_ && Contains(position) != selected)
+            Toggle(position);
+    }
+
+    void SelectionSet::Toggle(size_t position)
+    {
+        if (position >= size_)
+            return;
+
+        bool was_raw = InRanges(position) != Toggled(position);
+        size_t word = position >> 6;
+        if (word >= words_.size())
+            words_.resize(word + 1, 0);
+        words_[word] ^= uint64_t{1} << (position & 63);
+        raw_count_ = was_raw ? raw_count_ - 1 : raw_count_ + 1;
+    }
+
+    void SelectionSet::SetRange(size_t begin, size_t end, bool selected)
+    {
+        end = std::min(end, size_);
+        if (begin >= end)
+            return;
+
+        // The toggles inside are dropped and the range decides on its own
+        raw_count_ -= CountRaw(begin, end);
+        ClearToggles(begin, end);
+        if (selected != inverted_)
+        {
+            AddRange(begin, end);
+            raw_count_ += end - begin;
+        }
+        else
+        {
+            RemoveRange(begin, end);
+        }
+    }
+
+    void SelectionSet::SelectAll()
+    {
+        Clear();
+        inverted_ = true;
+    }
+
+    void SelectionSet::Clear()
+    {
+        // Both keep their storage for the next selection
+        ranges_.clear();
+        words_.clear();
+        raw_count_ = 0;
+        inverted_ = false;
+    }
+
+    bool SelectionSet::InRanges(size_t position) const
+    {
+        auto it = std::upper_bound(ranges_.begin(), ranges_.end(), position,
+            [](size_t value, const Range& range) { return value < range.begin; });
+        return it != ranges_.begin() && position < std::prev(it)->end;
+    }
+
+    size_t SelectionSet::CountRaw(size_t begin, size_t end) const
+    {
+        // Toggles outside ranges add a position, toggles inside remove one
+        size_t count = CountToggled(begin, end);
+        auto it = std::upper_bound(ranges_.begin(), ranges_.end(), begin,
+            [](size_t value, const Range& range) { return value < range.end; });
+        for (; it != ranges_.end() && it->begin < end; ++it)
+        {
+            size_t first = std::max(it->begin, begin);
+            size_t last = std::min(it->end, end);
+            count += (last - first) - 2 * CountToggled(first, last);
+        }
+        return count;
+    }
+
+    size_t SelectionSet::CountToggled(size_t begin, size_t end) const
+    {
+        end = std::min(end, words_.size() << 6);
+        size_t count = 0;
+        for (size_t position = begin; position < end;)
+        {
+            size_t word_end = std::min(((position >> 6) + 1) << 6, end);
+            count += PopCount(words_[position >> 6] & WordMask(position, word_end));
+            position = word_end;
+        }
+        return count;
+    }
+
+    void SelectionSet::ClearToggles(size_t begin, size_t end)
+    {
+        end = std::min(end, words_.size() << 6);
+        for (size_t position = begin; position < end;)
+        {
+            size_t word_end = std::min(((position >> 6) + 1) << 6, end);
+            words_[position >> 6] &= ~WordMask(position, word_end);
+            position = word_end;
+        }
+    }
+
+    void SelectionSet::AddRange(size_t begin, size_t end)
+    {
+        // Ranges that overlap or touch [begin, end) merge into it
+        auto first = std::lower_bound(ranges_.begin(), ranges_.end(), begin,
+            [](const Range& range, size_t value) { return range.end < value; });
+        auto last = first;
+        while (last != ranges_.end() && last->begin <= end)
+        {
+            begin = std::min(begin, last->begin);
+            end = std::max(end, last->end);
+            ++last;
+        }
+        first = ranges_.erase(first, last);
+        ranges_.insert(first, Range{begin, end});
+    }
+
+    void SelectionSet::RemoveRange(size_t begin, size_t end)
+    {
+        auto first = std::upper_bound(ranges_.begin(), ranges_.end(), begin,
+            [](size_t value, const Range& range) { return value < range.end; });
+        auto last = first;
+        while (last != ranges_.end() && last->begin < end)
+            ++last;
+        if (first == last)
+            return;
+
+        // What sticks out either side stays
+        Range head{first->begin, begin};
+        Range tail{end, std::prev(last)->end};
+        first = ranges_.erase(first, last);
+        if (tail.begin < tail.end)
+            first = ranges_.insert(first, tail);
+        if (head.begin < head.end)
+            ranges_.insert(first, head);
+    }
+
+    std::vector<filesystem::FsItem> SelectionView::Materialize() const
+    {
+        std::vector<filesystem::FsItem> items;
+        items.reserve(Count());
+        ForEach([&](size_t, filesystem::ItemStore::Index index)
+        {
+            items.push_back(store_.Materialize(index));
+        });
+        return items;
+    }
+
+} // namespace opacity::ui
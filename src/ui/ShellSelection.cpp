@@ -0,0 +1,183 @@
+#include "opacity/ui/ShellSelection.h"
+#include "opacity/archive/ArchiveFileSystem.h"
+#include "opacity/core/Path.h"
+#include "opacity/core/Profiler.h"
+
+#include <algorithm>
+#include <unordered_set>
+
+#define NOMINMAX
+#include <Windows.h>
+
+namespace opacity::ui
+{
+    namespace
+    {
+        // Shell names use backslashes, archive entries forward slashes
+        std::wstring ShellName(std::string_view name)
+        {
+            std::wstring wide;
+            if (name.empty())
+                return wide;
+            int length = MultiByteToWideChar(CP_UTF8, 0, name.data(), static_cast<int>(name.size()), nullptr, 0);
+            wide.resize(static_cast<size_t>(length));
+            MultiByteToWideChar(CP_UTF8, 0, name.data(), static_cast<int>(name.size()), wide.data(), length);
+            std::replace(wide.begin(), wide.end(), L'/', L'\\');
+            return wide;
+        }
+
+        std::string EntryName(std::string name)
+        {
+            std::replace(name.begin(), name.end(), '\\', '/');
+            return name;
+        }
+
+        class ArchiveReader : public core::ShellFileReader
+        {
+        public:
+            explicit ArchiveReader(std::unique_ptr<archive::ArchiveStream> stream)
+                : stream_(std::move(stream))
+            {
+            }
+
+            size_t Read(void* buffer, size_t length) override { return stream_->Read(buffer, length); }
+            bool Seek(uint64_t offset) override { return stream_->Seek(offset); }
+
+        private:
+            std::unique_ptr<archive::ArchiveStream> stream_;
+        };
+    }
+
+    SelectionFileSource::SelectionFileSource(filesystem::ItemStore store, SelectionSet selection,
+                                             std::vector<filesystem::ItemStore::Index> order)
+        : store_(std::move(store))
+        , selection_(std::move(selection))
+        , order_(std::move(order))
+    {
+        // Every item of a listing shares its directory, so one tells for all
+        archive_ = !store_.Empty() && archive::ArchiveFileSystem::IsArchivePath(store_.FullPath(0));
+    }
+
+    bool SelectionFileSource::HasPaths() const
+    {
+        return !archive_;
+    }
+
+    size_t SelectionFileSource::Count() const
+    {
+        Resolve();
+        return archive_ ? archive_files_.size() : items_.size();
+    }
+
+    std::wstring SelectionFileSource::GetPath(size_t index) const
+    {
+        Resolve();
+        if (archive_ || index >= items_.size())
+            return {};
+        return core::Path(store_.FullPath(items_[index])).WString();
+    }
+
+    core::ShellVirtualFile SelectionFileSource::Describe(size_t index) const
+    {
+        Resolve();
+        if (archive_)
+            return index < archive_files_.size() ? archive_files_[index].file : core::ShellVirtualFile{};
+
+        core::ShellVirtualFile file;
+        if (index < items_.size())
+        {
+            filesystem::ItemStore::Index item = items_[index];
+            file.name = ShellName(store_.Name(item));
+            file.size = store_.FileSize(item);
+            file.modified = store_.Modified(item);
+            file.is_directory = store_.IsDirectory(item);
+        }
+        return file;
+    }
+
+    std::unique_ptr<core::ShellFileReader> SelectionFileSource::Open(size_t index) const
+    {
+        Resolve();
+        if (!archive_ || index >= archive_files_.size() || archive_files_[index].file.is_directory)
+            return nullptr;
+
+        auto stream = archive::ArchiveFileSystem::Open(archive_files_[index].path);
+        if (!stream)
+            return nullptr;
+        return std::make_unique<ArchiveReader>(std::move(stream));
+    }
+
+    void SelectionFileSource::Resolve() const
+    {
+        std::call_once(resolved_, [this]()
+        {
+            OPACITY_PROFILE_ZONE("SelectionFileSource::Resolve");
+            items_.reserve(selection_.Count());
+            selection_.ForEach([this](size_t position) { items_.push_back(order_[position]); });
+            if (archive_)
+                ResolveArchive();
+        });
+    }
+
+    void SelectionFileSource::ResolveArchive() const
+    {
+        std::string listed;
+        std::vector<archive::ArchiveEntry> listing;
+
+        for (filesystem::ItemStore::Index index : items_)
+        {
+            std::string path = store_.FullPath(index);
+            std::string archive_path;
+            std::string entry;
+            if (!archive::ArchiveFileSystem::SplitPath(path, archive_path, entry))
+                continue;
+
+            core::ShellVirtualFile file;
+            file.name = ShellName(store_.Name(index));
+            file.modified = store_.Modified(index);
+            file.is_directory = store_.IsDirectory(index);
+            file.size = file.is_directory ? 0 : store_.FileSize(index);
+            archive_files_.push_back({path, file});
+            if (!file.is_directory)
+                continue;
+
+            // A folder is only implied by the names of what is in it
+            if (archive_path != listed)
+            {
+                listing = archive::ArchiveFileSystem::ListFiles(core::Path(archive_path));
+                listed = archive_path;
+            }
+
+            std::string prefix = EntryName(entry);
+            if (prefix.back() != '/')
+                prefix += '/';
+
+            std::unordered_set<std::string> folders;
+            for (const auto& inside : listing)
+            {
+                std::string name = EntryName(inside.name);
+                if (inside.is_directory || name.size() <= prefix.size() || name.compare(0, prefix.size(), prefix) != 0)
+                    continue;
+
+                std::string rest = name.substr(prefix.size());
+                for (size_t slash = rest.find('/'); slash != std::string::npos; slash = rest.find('/', slash + 1))
+                {
+                    if (!folders.insert(rest.substr(0, slash)).second)
+                        continue;
+                    core::ShellVirtualFile folder;
+                    folder.name = file.name + L'\\' + ShellName(rest.substr(0, slash));
+                    folder.modified = inside.modified_time;
+                    folder.is_directory = true;
+                    archive_files_.push_back({{}, folder});
+                }
+
+                core::ShellVirtualFile contained;
+                contained.name = file.name + L'\\' + ShellName(rest);
+                contained.size = inside.uncompressed_size;
+                contained.modified = inside.modified_time;
+                archive_files_.push_back({archive::ArchiveFileSystem::JoinPath(core::Path(archive_path), name), contained});
+            }
+        }
+    }
+
+} // namespace opacity::ui
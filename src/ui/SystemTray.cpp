@@ -1,4 +1,5 @@
 #include "opacity/ui/SystemTray.h"
+#include "opacity/search/IndexHost.h"
 #include "opacity/core/Logger.h"
 
 #include <atomic>
@@ -37,6 +38,9 @@ namespace opacity::ui
         TrayClickCallback clickCallback_;
         TrayMenuCallback menuCallback_;
         TrayNotificationCallback notificationCallback_;
+        std::function<void()> showCallback_;
+
+        std::unique_ptr<search::IndexHost> indexHost_;
         
         std::atomic<bool> minimizedToTray_{false};
         std::atomic<bool> notificationsEnabled_{true};
@@ -189,6 +193,7 @@ namespace opacity::ui
 
     void SystemTray::Shutdown()
     {
+        StopHostingIndex();
 #ifdef _WIN32
         if (impl_->iconAdded_) {
             Shell_NotifyIconW(NIM_DELETE, &impl_->nid_);
@@ -410,7 +415,11 @@ namespace opacity::ui
 
         // Handle standard commands
         if (cmd == 1001) {  // Show
-            RestoreFromTray();
+            if (impl_->showCallback_) {
+                impl_->showCallback_();
+            } else {
+                RestoreFromTray();
+            }
         } else if (cmd == 1002) {  // Exit
             PostMessageW(impl_->hwnd_, WM_CLOSE, 0, 0);
         } else if (cmd >= 2000 && impl_->menuCallback_) {
@@ -617,6 +626,43 @@ namespace opacity::ui
         impl_->notificationCallback_ = callback;
     }
 
+    void SystemTray::OnShowRequested(std::function<void()> callback)
+    {
+        impl_->showCallback_ = std::move(callback);
+    }
+
+    // ============== Resident Index ==============
+
+    bool SystemTray::HostIndex(std::shared_ptr<search::SearchIndex> index)
+    {
+        StopHostingIndex();
+
+        auto host = std::make_unique<search::IndexHost>(std::move(index));
+        if (!host->Start()) {
+            return false;
+        }
+        impl_->indexHost_ = std::move(host);
+        return true;
+    }
+
+    void SystemTray::StopHostingIndex()
+    {
+        if (impl_->indexHost_) {
+            impl_->indexHost_->Stop();
+            impl_->indexHost_.reset();
+        }
+    }
+
+    bool SystemTray::IsHostingIndex() const
+    {
+        return impl_->indexHost_ && impl_->indexHost_->IsRunning();
+    }
+
+    size_t SystemTray::GetIndexClientCount() const
+    {
+        return impl_->indexHost_ ? impl_->indexHost_->GetClientCount() : 0;
+    }
+
     const SystemTrayConfig& SystemTray::GetConfig() const
     {
         return impl_->config_;
@@ -640,6 +686,8 @@ namespace opacity::ui
             case WM_LBUTTONUP:
                 if (impl_->clickCallback_) {
                     impl_->clickCallback_(TrayClickType::LeftClick);
+                } else if (impl_->showCallback_) {
+                    impl_->showCallback_();
                 } else {
                     RestoreFromTray();
                 }
@@ -655,6 +703,8 @@ namespace opacity::ui
             case WM_LBUTTONDBLCLK:
                 if (impl_->clickCallback_) {
                     impl_->clickCallback_(TrayClickType::DoubleClick);
+                } else if (impl_->showCallback_) {
+                    impl_->showCallback_();
                 } else {
                     RestoreFromTray();
                 }
@@ -6,8 +6,14 @@
 
 namespace opacity::ui
 {
-    TabManager::TabManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager)
+    TabManager::TabManager(std::shared_ptr<filesystem::FileSystemManager> fs_manager,
+                           std::shared_ptr<preview::ThumbnailService> thumbnails,
+                           std::shared_ptr<search::FolderSizeService> folder_sizes,
+                           std::shared_ptr<preview::IconService> icons)
         : fs_manager_(std::move(fs_manager))
+        , thumbnails_(std::move(thumbnails))
+        , folder_sizes_(std::move(folder_sizes))
+        , icons_(std::move(icons))
     {
         SPDLOG_DEBUG("TabManager created");
     }
@@ -17,9 +23,19 @@ namespace opacity::ui
         SPDLOG_DEBUG("TabManager destroyed");
     }
 
-    TabManager::TabId TabManager::CreateTab(const std::string& path, bool make_active)
+    std::unique_ptr<FilePane> TabManager::CreatePane() const
     {
         auto pane = std::make_unique<FilePane>(fs_manager_);
+        pane->SetThumbnailService(thumbnails_);
+        pane->SetFolderSizeService(folder_sizes_);
+        pane->SetIconService(icons_);
+        pane->SetRedrawCallback(on_redraw_);
+        return pane;
+    }
+
+    TabManager::TabId TabManager::CreateTab(const std::string& path, bool make_active)
+    {
+        auto pane = CreatePane();
         
         std::string initial_path = path;
         if (initial_path.empty())
@@ -46,6 +62,42 @@ namespace opacity::ui
         return id;
     }
 
+    void TabManager::RestoreTabs(const std::vector<TabStub>& tabs, size_t active_index)
+    {
+        tabs_.clear();
+        active_tab_index_ = 0;
+        size_t active = 0;
+        for (size_t i = 0; i < tabs.size(); ++i)
+        {
+            const TabStub& stub = tabs[i];
+            if (i == active_index)
+                active = tabs_.size();
+            if (stub.path.empty())
+                continue;
+
+            auto pane = CreatePane();
+            pane->RestoreAt(stub.path, stub.selected_names, stub.focused_name, stub.scroll_y);
+            if (!stub.title.empty())
+                pane->SetTitle(stub.title);
+
+            Tab tab(std::move(pane));
+            tab.is_pinned = stub.is_pinned;
+            tab.color = stub.color;
+            tabs_.push_back(std::move(tab));
+        }
+
+        if (tabs_.empty())
+        {
+            CreateTab();
+            return;
+        }
+
+        active_tab_index_ = std::min(active, tabs_.size() - 1);
+        SPDLOG_INFO("Restored {} tabs", tabs_.size());
+        if (on_tab_changed_)
+            on_tab_changed_(GetActiveTabId());
+    }
+
     bool TabManager::CloseTab(TabId id)
     {
         size_t index = FindTabIndex(id);
@@ -314,9 +366,30 @@ namespace opacity::ui
         return nullptr;
     }
 
+    void TabManager::SetHibernation(std::chrono::seconds idle_after, size_t memory_budget)
+    {
+        hibernate_after_ = idle_after;
+        memory_budget_ = memory_budget;
+        next_hibernation_check_ = {};
+    }
+
+    void TabManager::SetRedrawCallback(FilePane::RedrawCallback callback)
+    {
+        on_redraw_ = std::move(callback);
+        for (auto& tab : tabs_)
+        {
+            if (tab.pane)
+                tab.pane->SetRedrawCallback(on_redraw_);
+        }
+    }
+
     void TabManager::Render(float width, float height)
     {
         RenderTabBar();
+
+        if (active_tab_index_ < tabs_.size())
+            tabs_[active_tab_index_].last_viewed = std::chrono::steady_clock::now();
+        UpdateHibernation();
         
         // Render active pane
         float remaining_height = height - ImGui::GetFrameHeightWithSpacing();
@@ -539,6 +612,55 @@ namespace opacity::ui
         return SIZE_MAX;
     }
 
+    void TabManager::UpdateHibernation()
+    {
+        auto now = std::chrono::steady_clock::now();
+        if (now < next_hibernation_check_)
+            return;
+        next_hibernation_check_ = now + kHibernationCheckInterval;
+
+        // The active tab counts against the budget but is never hibernated
+        std::vector<size_t> awake;
+        size_t usage = 0;
+        for (size_t i = 0; i < tabs_.size(); ++i)
+        {
+            Tab& tab = tabs_[i];
+            if (!tab.pane || tab.pane->IsHibernating())
+                continue;
+
+            if (i != active_tab_index_ && hibernate_after_.count() > 0 && now - tab.last_viewed >= hibernate_after_)
+            {
+                tab.pane->Hibernate();
+                if (tab.pane->IsHibernating())
+                    continue;
+            }
+
+            usage += tab.pane->GetMemoryUsage();
+            if (i != active_tab_index_)
+                awake.push_back(i);
+        }
+
+        if (memory_budget_ == 0 || usage <= memory_budget_)
+            return;
+
+        // Over budget: the tabs unseen for longest go first
+        std::sort(awake.begin(), awake.end(), [this](size_t a, size_t b)
+        {
+            return tabs_[a].last_viewed < tabs_[b].last_viewed;
+        });
+        for (size_t i : awake)
+        {
+            if (usage <= memory_budget_)
+                break;
+
+            size_t bytes = tabs_[i].pane->GetMemoryUsage();
+            tabs_[i].pane->Hibernate();
+            if (tabs_[i].pane->IsHibernating())
+                usage -= bytes;
+        }
+        SPDLOG_DEBUG("Tab listings hold {} bytes after hibernation (budget {})", usage, memory_budget_);
+    }
+
     void TabManager::EnsureActiveTabValid()
     {
         if (tabs_.empty())
@@ -1,10 +1,15 @@
 #include "opacity/ui/Theme.h"
+#include "opacity/ui/GlyphCache.h"
 #include "opacity/core/Logger.h"
 
 #include <imgui.h>
 #include <fstream>
 #include <algorithm>
 #include <cctype>
+#include <cstdlib>
+#include <filesystem>
+#include <utility>
+#include <vector>
 
 namespace opacity::ui
 {
@@ -16,6 +21,7 @@ namespace opacity::ui
     void Theme::Initialize()
     {
         ApplyTheme(ThemeType::Dark);
+        LoadFonts();
         SPDLOG_INFO("Theme system initialized");
     }
 
@@ -166,6 +172,13 @@ namespace opacity::ui
         scheme.document = 0x3498DBFF;
         scheme.code = 0x2ECC71FF;
         
+        // Syntax
+        scheme.syntax_keyword = 0x0000FFFF;
+        scheme.syntax_string = 0xA31515FF;
+        scheme.syntax_comment = 0x008000FF;
+        scheme.syntax_number = 0x098658FF;
+        scheme.syntax_preprocessor = 0xAF00DBFF;
+        
         return scheme;
     }
 
@@ -209,6 +222,13 @@ namespace opacity::ui
         scheme.document = 0x9CDCFEFF;
         scheme.code = 0x4EC9B0FF;
         
+        // Syntax
+        scheme.syntax_keyword = 0x569CD6FF;
+        scheme.syntax_string = 0xCE9178FF;
+        scheme.syntax_comment = 0x6A9955FF;
+        scheme.syntax_number = 0xB5CEA8FF;
+        scheme.syntax_preprocessor = 0xC586C0FF;
+        
         return scheme;
     }
 
@@ -252,6 +272,13 @@ namespace opacity::ui
         scheme.document = 0x00FFFFFF;
         scheme.code = 0x00FF80FF;
         
+        // Syntax
+        scheme.syntax_keyword = 0x00FFFFFF;
+        scheme.syntax_string = 0xFFFF00FF;
+        scheme.syntax_comment = 0x7CFC00FF;
+        scheme.syntax_number = 0xFF8000FF;
+        scheme.syntax_preprocessor = 0xFF00FFFF;
+        
         return scheme;
     }
 
@@ -358,8 +385,55 @@ namespace opacity::ui
 
     void Theme::LoadFonts()
     {
-        // Font loading would be done here
-        // For now, use default ImGui font
+        // Families map to the files Windows installs them as; a family that
+        // names a font file is used as given
+        static const std::pair<const char*, const char*> kFamilyFiles[] = {
+            {"segoe ui", "segoeui.ttf"},
+            {"arial", "arial.ttf"},
+            {"calibri", "calibri.ttf"},
+            {"consolas", "consola.ttf"},
+            {"tahoma", "tahoma.ttf"},
+            {"verdana", "verdana.ttf"},
+        };
+
+        // Merged in for scripts the main font lacks; their glyphs are only
+        // baked once a name or string on screen needs them
+        static const char* const kFallbackFiles[] = {
+            "seguisym.ttf",     // Symbols
+            "msyh.ttc",         // Chinese
+            "YuGothM.ttc",      // Japanese
+            "malgun.ttf",       // Korean
+            "Nirmala.ttf",      // Indic
+            "seguihis.ttf",     // Historic scripts
+        };
+
+        const char* windir = std::getenv("WINDIR");
+        std::filesystem::path fonts_dir = std::filesystem::path(windir ? windir : "C:\\Windows") / "Fonts";
+
+        std::string family = font_config_.family;
+        std::transform(family.begin(), family.end(), family.begin(), ::tolower);
+        std::string primary;
+        if (family.size() > 4 && (family.compare(family.size() - 4, 4, ".ttf") == 0 ||
+                                  family.compare(family.size() - 4, 4, ".ttc") == 0 ||
+                                  family.compare(family.size() - 4, 4, ".otf") == 0))
+        {
+            std::filesystem::path file = std::filesystem::u8path(font_config_.family);
+            primary = (file.is_absolute() ? file : fonts_dir / file).u8string();
+        }
+        else
+        {
+            for (const auto& [name, file] : kFamilyFiles)
+            {
+                if (family == name)
+                    primary = (fonts_dir / file).u8string();
+            }
+        }
+
+        std::vector<std::string> fallbacks;
+        for (const char* file : kFallbackFiles)
+            fallbacks.push_back((fonts_dir / file).u8string());
+
+        GetGlyphCache().SetFonts(primary, fallbacks, font_config_.size);
         SPDLOG_DEBUG("Font configuration updated: {} {}pt", font_config_.family, font_config_.size);
     }
 
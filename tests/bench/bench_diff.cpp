@@ -0,0 +1,56 @@
+// Line diffs of source-like text with a given share of lines changed
+#include "bench_support.h"
+#include "opacity/diff/DiffEngine.h"
+#include <benchmark/benchmark.h>
+
+#include <random>
+#include <sstream>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        // Every line of text, with about one in every_n replaced or dropped
+        std::string Edit(const std::string& text, int every_n)
+        {
+            std::mt19937 rng(42);
+            std::istringstream in(text);
+            std::string result;
+            std::string line;
+            while (std::getline(in, line))
+            {
+                uint32_t roll = rng() % (2 * every_n);
+                if (roll == 0)
+                    continue;
+                result += roll == 1 ? "changed " + line : line;
+                result += '\n';
+            }
+            return result;
+        }
+
+        void CompareText(benchmark::State& state, diff::DiffAlgorithm algorithm)
+        {
+            const std::string left = MakeText(static_cast<size_t>(state.range(0)));
+            const std::string right = Edit(left, static_cast<int>(state.range(1)));
+
+            diff::DiffEngine engine;
+            diff::DiffOptions options;
+            options.algorithm = algorithm;
+            for (auto _ : state)
+            {
+                auto result = engine.CompareText(left, right, options);
+                benchmark::DoNotOptimize(result.hunks.data());
+            }
+            state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(left.size() + right.size()));
+        }
+    }
+
+    // {lines, one change in every n lines}
+    BENCHMARK_CAPTURE(CompareText, Myers, diff::DiffAlgorithm::Myers)
+        ->Args({1000, 50})->Args({10000, 50})->Args({100000, 50})->Args({10000, 5})->Args({10000, 1000})
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(CompareText, Patience, diff::DiffAlgorithm::Patience)
+        ->Args({1000, 50})->Args({10000, 50})->Args({100000, 50})->Args({10000, 5})->Args({10000, 1000})
+        ->Unit(benchmark::kMillisecond);
+
+} // namespace opacity::bench
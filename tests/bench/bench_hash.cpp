@@ -0,0 +1,100 @@
+// Content hashing as duplicate finding and folder comparison use it. Files
+// are read back from the page cache after the first pass, so these measure
+// hashing and I/O overhead rather than the disk.
+#include "bench_support.h"
+#include "opacity/batch/DuplicateFinder.h"
+#include "opacity/core/FileHasher.h"
+#include <benchmark/benchmark.h>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        void HashFile(benchmark::State& state)
+        {
+            size_t bytes = static_cast<size_t>(state.range(0));
+            core::Path path = WriteScratchFile("hash/whole_" + std::to_string(bytes), bytes);
+
+            for (auto _ : state)
+            {
+                std::string hash;
+                if (!core::FileHasher::HashFile(path, hash))
+                {
+                    state.SkipWithError("HashFile failed");
+                    break;
+                }
+                benchmark::DoNotOptimize(hash.data());
+            }
+            state.SetBytesProcessed(state.iterations() * static_cast<int64_t>(bytes));
+        }
+
+        void HashPartial(benchmark::State& state)
+        {
+            core::Path path = WriteScratchFile("hash/partial", size_t{64} << 20);
+
+            for (auto _ : state)
+            {
+                std::string hash;
+                core::FileHasher::HashPartial(path, hash);
+                benchmark::DoNotOptimize(hash.data());
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        // Many small files across the worker pool; range(0) is the thread count
+        void HashFiles(benchmark::State& state)
+        {
+            constexpr size_t kFiles = 256;
+            std::vector<core::Path> paths;
+            for (size_t i = 0; i < kFiles; ++i)
+            {
+                paths.push_back(WriteScratchFile("hash/many/" + std::to_string(i), (size_t{1} << 20) + i));
+            }
+
+            for (auto _ : state)
+            {
+                std::vector<core::FileHashJob> jobs(kFiles);
+                for (size_t i = 0; i < kFiles; ++i)
+                {
+                    jobs[i].path = paths[i];
+                }
+                core::FileHasher::HashFiles(jobs, static_cast<unsigned>(state.range(0)));
+                benchmark::DoNotOptimize(jobs.data());
+            }
+            state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(kFiles));
+        }
+
+        // A folder where a third of the files have a twin of the same size
+        // and content, and the rest differ in size only by a few bytes
+        void FindDuplicates(benchmark::State& state, batch::DuplicateMatchMode mode)
+        {
+            constexpr size_t kFiles = 300;
+            for (size_t i = 0; i < kFiles; ++i)
+            {
+                size_t bytes = (size_t{256} << 10) + (i % 3 == 0 ? i / 3 : kFiles + i);
+                WriteScratchFile("dupes/" + std::to_string(i), bytes);
+                if (i % 3 == 0)
+                    WriteScratchFile("dupes/" + std::to_string(i) + "_copy", bytes);
+            }
+
+            batch::DuplicateFinder finder;
+            batch::DuplicateSearchOptions options;
+            options.mode = mode;
+            const std::vector<core::Path> roots{ScratchDirectory() / "dupes"};
+            for (auto _ : state)
+            {
+                auto result = finder.FindDuplicates(roots, options);
+                benchmark::DoNotOptimize(result.groups.data());
+            }
+        }
+    }
+
+    BENCHMARK(HashFile)->Arg(1 << 20)->Arg(64 << 20)->Arg(256 << 20)->Unit(benchmark::kMillisecond);
+    BENCHMARK(HashPartial);
+    BENCHMARK(HashFiles)->Arg(1)->Arg(4)->Arg(0)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(FindDuplicates, SizeAndPartialHash, batch::DuplicateMatchMode::SizeAndPartialHash)
+        ->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(FindDuplicates, ExactHash, batch::DuplicateMatchMode::ExactHash)
+        ->Unit(benchmark::kMillisecond);
+
+} // namespace opacity::bench
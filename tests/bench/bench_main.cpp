@@ -0,0 +1,35 @@
+// Entry point for opacity_bench; the usual Google Benchmark flags apply,
+// e.g. --benchmark_filter=Sort --benchmark_out=run.json --benchmark_out_format=json
+//
+// With OPACITY_BENCH_METRICS set to a file, the metrics the benchmarked code
+// recorded are written there after the run: Prometheus text for a .prom
+// file, NDJSON otherwise.
+#include "opacity/core/Logger.h"
+#include "opacity/core/Metrics.h"
+#include <benchmark/benchmark.h>
+
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char** argv)
+{
+    // Handlers log at info on every call, which would be measured too
+    opacity::core::Logger::Initialize("warn");
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+        return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+
+    if (const char* metrics_file = std::getenv("OPACITY_BENCH_METRICS"))
+    {
+        std::string file = metrics_file;
+        bool prometheus = file.size() >= 5 && file.compare(file.size() - 5, 5, ".prom") == 0;
+        opacity::core::Metrics::Get().Export(file, prometheus ? opacity::core::MetricsFormat::Prometheus
+                                                              : opacity::core::MetricsFormat::Ndjson);
+    }
+
+    opacity::core::Logger::Shutdown();
+    return 0;
+}
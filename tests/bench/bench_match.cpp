@@ -0,0 +1,38 @@
+// Wildcard matching of names, the inner loop of name searches and filters
+#include "bench_support.h"
+#include "opacity/search/SearchEngine.h"
+#include <benchmark/benchmark.h>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        void MatchPattern(benchmark::State& state, const char* pattern, bool case_sensitive)
+        {
+            std::vector<std::string> names;
+            for (const auto& item : MakeItems(10000))
+            {
+                names.push_back(item.name);
+            }
+
+            size_t matches = 0;
+            for (auto _ : state)
+            {
+                for (const auto& name : names)
+                {
+                    matches += search::SearchEngine::MatchPattern(name, pattern, case_sensitive);
+                }
+            }
+            benchmark::DoNotOptimize(matches);
+            state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(names.size()));
+        }
+    }
+
+    BENCHMARK_CAPTURE(MatchPattern, Literal, "README", false);
+    BENCHMARK_CAPTURE(MatchPattern, Extension, "*.jpg", false);
+    BENCHMARK_CAPTURE(MatchPattern, ExtensionCaseSensitive, "*.jpg", true);
+    BENCHMARK_CAPTURE(MatchPattern, Infix, "*port*", false);
+    BENCHMARK_CAPTURE(MatchPattern, Questions, "IMG_????.*", false);
+    BENCHMARK_CAPTURE(MatchPattern, ManyStars, "*a*e*i*.*", false);
+
+} // namespace opacity::bench
@@ -0,0 +1,64 @@
+// The cost instrumentation adds to hot paths: updates are relaxed atomics,
+// so these should stay in the nanoseconds even with every thread recording
+// into the same series.
+#include "opacity/core/Metrics.h"
+#include <benchmark/benchmark.h>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        void CounterAdd(benchmark::State& state)
+        {
+            static auto& counter = core::Metrics::Get().GetCounter("opacity_bench_counter_total");
+            for (auto _ : state)
+            {
+                counter.Add();
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        void HistogramRecord(benchmark::State& state)
+        {
+            static auto& histogram = core::Metrics::Get().GetHistogram("opacity_bench_record_us");
+            uint64_t value = 1;
+            for (auto _ : state)
+            {
+                histogram.Record(value);
+                value = value * 6364136223846793005ull + 1442695040888963407ull;
+                value >>= 40;
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        void TimerScope(benchmark::State& state)
+        {
+            static auto& histogram = core::Metrics::Get().GetHistogram("opacity_bench_timer_us");
+            for (auto _ : state)
+            {
+                core::ScopedTimer timer(histogram);
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        void Summarize(benchmark::State& state)
+        {
+            core::Histogram histogram;
+            for (uint64_t i = 1; i <= 100000; ++i)
+            {
+                histogram.Record(i);
+            }
+            for (auto _ : state)
+            {
+                auto summary = histogram.Summarize();
+                benchmark::DoNotOptimize(summary.p99);
+            }
+        }
+    }
+
+    BENCHMARK(CounterAdd)->ThreadRange(1, 8);
+    BENCHMARK(HistogramRecord)->ThreadRange(1, 8);
+    BENCHMARK(TimerScope);
+    BENCHMARK(Summarize);
+
+} // namespace opacity::bench
@@ -0,0 +1,94 @@
+// Loading the preview pane's content, per kind of file. No device is
+// given, so images are decoded and scaled but no texture is made.
+#include "bench_support.h"
+#include "opacity/preview/PreviewManager.h"
+#include <benchmark/benchmark.h>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        void Put(std::string& out, uint32_t value, int bytes)
+        {
+            for (int i = 0; i < bytes; ++i)
+            {
+                out += static_cast<char>((value >> (8 * i)) & 0xFF);
+            }
+        }
+
+        // An uncompressed 24-bit bitmap with a gradient, so the decoder has
+        // something to scale
+        std::string MakeBitmap(uint32_t width, uint32_t height)
+        {
+            uint32_t stride = (width * 3 + 3) & ~3u;
+            uint32_t pixels = stride * height;
+
+            std::string bmp = "BM";
+            Put(bmp, 54 + pixels, 4);
+            Put(bmp, 0, 4);
+            Put(bmp, 54, 4);
+            Put(bmp, 40, 4);
+            Put(bmp, width, 4);
+            Put(bmp, height, 4);
+            Put(bmp, 1, 2);
+            Put(bmp, 24, 2);
+            Put(bmp, 0, 4);
+            Put(bmp, pixels, 4);
+            Put(bmp, 2835, 4);
+            Put(bmp, 2835, 4);
+            Put(bmp, 0, 4);
+            Put(bmp, 0, 4);
+
+            for (uint32_t y = 0; y < height; ++y)
+            {
+                for (uint32_t x = 0; x < width; ++x)
+                {
+                    bmp += static_cast<char>(x * 255 / width);
+                    bmp += static_cast<char>(y * 255 / height);
+                    bmp += static_cast<char>((x ^ y) & 0xFF);
+                }
+                bmp.append(stride - width * 3, '\0');
+            }
+            return bmp;
+        }
+
+        void LoadPreview(benchmark::State& state, const core::Path& path)
+        {
+            preview::PreviewManager manager;
+            manager.Initialize(nullptr);
+
+            for (auto _ : state)
+            {
+                auto preview = manager.LoadPreview(path);
+                benchmark::DoNotOptimize(&preview);
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        void Text(benchmark::State& state)
+        {
+            LoadPreview(state, WriteScratchFile("preview/notes.txt", MakeText(20000, 3)));
+        }
+
+        void Code(benchmark::State& state)
+        {
+            LoadPreview(state, WriteScratchFile("preview/source.cpp", MakeText(20000, 4)));
+        }
+
+        void Image(benchmark::State& state)
+        {
+            LoadPreview(state, WriteScratchFile("preview/photo.bmp", MakeBitmap(3840, 2160)));
+        }
+
+        void Unsupported(benchmark::State& state)
+        {
+            LoadPreview(state, WriteScratchFile("preview/blob.bin", size_t{1} << 20));
+        }
+    }
+
+    BENCHMARK(Text)->Name("LoadPreview/Text")->Unit(benchmark::kMillisecond);
+    BENCHMARK(Code)->Name("LoadPreview/Code")->Unit(benchmark::kMillisecond);
+    BENCHMARK(Image)->Name("LoadPreview/Image")->Unit(benchmark::kMillisecond);
+    BENCHMARK(Unsupported)->Name("LoadPreview/Unsupported")->Unit(benchmark::kMicrosecond);
+
+} // namespace opacity::bench
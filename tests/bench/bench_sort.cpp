@@ -0,0 +1,56 @@
+// Sorting a folder listing on each column, as the file panes do
+#include "bench_support.h"
+#include <benchmark/benchmark.h>
+
+namespace opacity::bench
+{
+    using filesystem::FsItem;
+    using filesystem::FsItemComparator;
+    using filesystem::SortColumn;
+    using filesystem::SortDirection;
+
+    namespace
+    {
+        void SortItems(benchmark::State& state, SortColumn column)
+        {
+            const auto items = MakeItems(static_cast<size_t>(state.range(0)));
+            FsItemComparator comparator(column, SortDirection::Ascending, true);
+
+            for (auto _ : state)
+            {
+                state.PauseTiming();
+                std::vector<FsItem> copy = items;
+                state.ResumeTiming();
+
+                filesystem::FsItemUtils::Sort(copy, comparator);
+                benchmark::DoNotOptimize(copy.data());
+            }
+            state.SetItemsProcessed(state.iterations() * state.range(0));
+        }
+
+        // The comparator alone, the per-pair cost any sort pays
+        void CompareItems(benchmark::State& state, SortColumn column)
+        {
+            const auto items = MakeItems(4096);
+            FsItemComparator comparator(column, SortDirection::Ascending, true);
+
+            size_t i = 0;
+            for (auto _ : state)
+            {
+                bool less = comparator(items[i % items.size()], items[(i + 1) % items.size()]);
+                benchmark::DoNotOptimize(less);
+                ++i;
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+    }
+
+    BENCHMARK_CAPTURE(SortItems, Name, SortColumn::Name)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(SortItems, Size, SortColumn::Size)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(SortItems, Type, SortColumn::Type)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(SortItems, DateModified, SortColumn::DateModified)->RangeMultiplier(10)->Range(1000, 1000000)->Unit(benchmark::kMillisecond);
+
+    BENCHMARK_CAPTURE(CompareItems, Name, SortColumn::Name);
+    BENCHMARK_CAPTURE(CompareItems, Type, SortColumn::Type);
+
+} // namespace opacity::bench
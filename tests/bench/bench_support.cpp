@@ -0,0 +1,248 @@
+#include "bench_support.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <mutex>
+#include <random>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        namespace fs = std::filesystem;
+
+        const char* const kStems[] = {
+            "IMG_", "Report ", "invoice-", "notes_", "build", "Track ", "DSC", "backup.",
+            "Screenshot ", "data", "README", "main", "Chapter ", "log-", "export_", "Thumbs"
+        };
+
+        const char* const kExtensions[] = {
+            ".jpg", ".png", ".txt", ".cpp", ".h", ".pdf", ".docx", ".mp3",
+            ".mp4", ".zip", ".json", ".log", ".exe", ".dll", "", ".md"
+        };
+
+        const char kMarkerName[] = ".opacity_bench";
+
+        std::string MakeName(std::mt19937& rng, size_t index, std::string* extension)
+        {
+            std::string name = kStems[rng() % std::size(kStems)];
+            name += std::to_string(index % 7 == 0 ? index : rng() % 100000);
+            const char* ext = kExtensions[rng() % std::size(kExtensions)];
+            name += ext;
+            if (extension)
+                *extension = ext;
+            return name;
+        }
+
+        std::string ShapeName(TreeShape shape)
+        {
+            return shape == TreeShape::Deep ? "deep" : "wide";
+        }
+
+        // Folders of the tree below root, parents before children
+        std::vector<fs::path> TreeFolders(const fs::path& root, TreeShape shape)
+        {
+            std::vector<fs::path> folders{root};
+            if (shape == TreeShape::Wide)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    folders.push_back(root / ("folder" + std::to_string(i)));
+                }
+                return folders;
+            }
+
+            constexpr int kDepth = 12;
+            size_t level_begin = 0;
+            for (int depth = 0; depth < kDepth; ++depth)
+            {
+                size_t level_end = folders.size();
+                for (size_t i = level_begin; i < level_end; ++i)
+                {
+                    fs::path parent = folders[i];
+                    folders.push_back(parent / "left");
+                    folders.push_back(parent / "right");
+                }
+                level_begin = level_end;
+            }
+            return folders;
+        }
+
+        void WriteTree(const fs::path& root, TreeShape shape, size_t files)
+        {
+            std::error_code ec;
+            fs::remove_all(root, ec);
+
+            std::vector<fs::path> folders = TreeFolders(root, shape);
+            for (const auto& folder : folders)
+            {
+                fs::create_directories(folder, ec);
+            }
+
+            std::cerr << "opacity_bench: writing " << files << " files (" << ShapeName(shape)
+                      << ") under " << root.string() << "\n";
+
+            std::mt19937 rng(static_cast<uint32_t>(shape) + 7);
+            size_t per_folder = files / folders.size();
+            size_t remainder = files % folders.size();
+            size_t index = 0;
+            for (size_t f = 0; f < folders.size(); ++f)
+            {
+                size_t count = per_folder + (f < remainder ? 1 : 0);
+                for (size_t i = 0; i < count; ++i, ++index)
+                {
+                    // Numbered so names never collide within a folder
+                    std::string name = std::to_string(index) + "_" + MakeName(rng, index, nullptr);
+                    std::ofstream out(folders[f] / name, std::ios::binary);
+                    out << index;
+                }
+            }
+
+            std::ofstream marker(root / kMarkerName);
+            marker << ShapeName(shape) << " " << files;
+        }
+
+        bool TreeIsCurrent(const fs::path& root, TreeShape shape, size_t files)
+        {
+            std::ifstream marker(root / kMarkerName);
+            std::string name;
+            size_t count = 0;
+            return marker >> name >> count && name == ShapeName(shape) && count == files;
+        }
+    }
+
+    core::Path ScratchDirectory()
+    {
+        static const core::Path directory = [] {
+            std::error_code ec;
+            const char* configured = std::getenv("OPACITY_BENCH_DIR");
+            fs::path path = configured && *configured ? fs::path(configured)
+                                                      : fs::temp_directory_path(ec) / "opacity_bench";
+            fs::create_directories(path, ec);
+            return core::Path(path);
+        }();
+        return directory;
+    }
+
+    size_t TreeFileCount()
+    {
+        static const size_t count = [] {
+            const char* configured = std::getenv("OPACITY_BENCH_FILES");
+            if (configured && *configured)
+            {
+                size_t value = std::strtoull(configured, nullptr, 10);
+                if (value > 0)
+                    return value;
+            }
+            return size_t{1000000};
+        }();
+        return count;
+    }
+
+    const core::Path& SyntheticTree(TreeShape shape)
+    {
+        static std::mutex mutex;
+        static core::Path roots[2];
+
+        std::lock_guard<std::mutex> lock(mutex);
+        core::Path& root = roots[static_cast<int>(shape)];
+        if (root.Empty())
+        {
+            fs::path path = ScratchDirectory().Get() / ("tree_" + ShapeName(shape));
+            if (!TreeIsCurrent(path, shape, TreeFileCount()))
+                WriteTree(path, shape, TreeFileCount());
+            root = core::Path(path);
+        }
+        return root;
+    }
+
+    std::vector<filesystem::FsItem> MakeItems(size_t count, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        auto base = std::chrono::system_clock::now() - std::chrono::hours(24 * 365 * 3);
+
+        std::vector<filesystem::FsItem> items;
+        items.reserve(count);
+        for (size_t i = 0; i < count; ++i)
+        {
+            filesystem::FsItem item;
+            item.is_directory = rng() % 20 == 0;
+            item.name = MakeName(rng, i, item.is_directory ? nullptr : &item.extension);
+            item.path = "C:\\Bench\\" + item.name;
+            item.full_path = core::Path(item.path);
+            item.size = item.is_directory ? 0 : rng() % (64u << 20);
+            item.modified_time = base + std::chrono::seconds(rng() % (3600u * 24 * 365 * 3));
+            item.modified = item.modified_time;
+            item.created = item.modified_time - std::chrono::seconds(rng() % 3600u);
+            item.attributes = item.is_directory ? filesystem::FsItem::ATTR_DIRECTORY : filesystem::FsItem::ATTR_ARCHIVE;
+            item.type = item.is_directory ? filesystem::FileType::Directory : filesystem::DetermineFileType(item.name);
+            items.push_back(std::move(item));
+        }
+        return items;
+    }
+
+    std::string MakeText(size_t lines, uint32_t seed)
+    {
+        const char* const words[] = {
+            "const", "auto", "return", "items", "count", "std::string", "if", "for",
+            "path", "size_t", "nullptr", "value", "=", "+", "(", ")", "{", "}", "0", "name"
+        };
+
+        std::mt19937 rng(seed);
+        std::string text;
+        text.reserve(lines * 48);
+        for (size_t line = 0; line < lines; ++line)
+        {
+            text.append((rng() % 4) * 4, ' ');
+            size_t length = 3 + rng() % 8;
+            for (size_t w = 0; w < length; ++w)
+            {
+                if (w)
+                    text += ' ';
+                text += words[rng() % std::size(words)];
+            }
+            text += ";\n";
+        }
+        return text;
+    }
+
+    core::Path WriteScratchFile(const std::string& name, size_t bytes)
+    {
+        fs::path path = ScratchDirectory().Get() / name;
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        if (fs::exists(path, ec) && fs::file_size(path, ec) == bytes)
+            return core::Path(path);
+
+        std::mt19937_64 rng(bytes);
+        std::vector<uint64_t> block(1 << 17);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        size_t left = bytes;
+        while (left > 0)
+        {
+            for (auto& word : block)
+            {
+                word = rng();
+            }
+            size_t chunk = std::min(left, block.size() * sizeof(uint64_t));
+            out.write(reinterpret_cast<const char*>(block.data()), static_cast<std::streamsize>(chunk));
+            left -= chunk;
+        }
+        return core::Path(path);
+    }
+
+    core::Path WriteScratchFile(const std::string& name, const std::string& contents)
+    {
+        fs::path path = ScratchDirectory().Get() / name;
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(contents.data(), static_cast<std::streamsize>(contents.size()));
+        return core::Path(path);
+    }
+
+} // namespace opacity::bench
@@ -0,0 +1,68 @@
+// Shared data for the opacity_bench targets: synthetic listings held in
+// memory, and synthetic trees written to disk once and reused across runs
+#pragma once
+
+#include "opacity/core/Path.h"
+#include "opacity/filesystem/FsItem.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace opacity::bench
+{
+    enum class TreeShape
+    {
+        Deep,       // Binary fan-out twelve levels down, files spread over every folder
+        Wide        // A few folders of tens of thousands of files each
+    };
+
+    /**
+     * @brief Where benchmark files go: opacity_bench under the temp directory,
+     *        or OPACITY_BENCH_DIR when set
+     */
+    core::Path ScratchDirectory();
+
+    /**
+     * @brief Files in each generated tree: OPACITY_BENCH_FILES, or 1,000,000
+     */
+    size_t TreeFileCount();
+
+    /**
+     * @brief Root of a generated tree of this shape
+     *
+     * Written on first use, which takes minutes at the default size, and
+     * found again by a marker file on later runs as long as the size has
+     * not changed. File contents are a few bytes; the trees measure
+     * enumeration, not reads.
+     */
+    const core::Path& SyntheticTree(TreeShape shape);
+
+    /**
+     * @brief A folder listing as enumeration would return it, names shaped
+     *        like real ones (mixed case, numbered runs, common extensions)
+     */
+    std::vector<filesystem::FsItem> MakeItems(size_t count, uint32_t seed = 1);
+
+    /**
+     * @brief Lines of source-like text
+     */
+    std::string MakeText(size_t lines, uint32_t seed = 1);
+
+    /**
+     * @brief Write a file of pseudo-random bytes, or reuse it if it is
+     *        already there at that size
+     *
+     * The bytes depend on the size alone, so files written at one size are
+     * duplicates of each other. Name may include folders below the scratch
+     * directory.
+     */
+    core::Path WriteScratchFile(const std::string& name, size_t bytes);
+
+    /**
+     * @brief Write a file with exactly this content
+     */
+    core::Path WriteScratchFile(const std::string& name, const std::string& contents);
+
+} // namespace opacity::bench
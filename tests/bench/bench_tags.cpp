@@ -0,0 +1,152 @@
+// Tag lookups per row and tag filters over a large tagged collection. The
+// manager is not initialized, so nothing is written to disk.
+#include "bench_support.h"
+#include "opacity/core/TagManager.h"
+#include <benchmark/benchmark.h>
+
+#include <random>
+
+namespace opacity::bench
+{
+    namespace
+    {
+        constexpr size_t kTaggedFiles = 200000;
+        constexpr size_t kTags = 32;
+
+        struct TaggedCollection
+        {
+            core::TagManager tags;
+            std::vector<std::string> tag_ids;
+            std::vector<std::string> files;
+
+            TaggedCollection()
+            {
+                for (size_t i = 0; i < kTags; ++i)
+                {
+                    tag_ids.push_back(tags.createTag("tag" + std::to_string(i)));
+                }
+                for (size_t i = 0; i < kTaggedFiles; ++i)
+                {
+                    files.push_back("C:\\Bench\\Tagged\\" + std::to_string(i / 1000) + "\\file" + std::to_string(i) + ".jpg");
+                }
+
+                // Tag t goes to about one file in t + 2, so some tags are
+                // common and some rare
+                std::mt19937 rng(5);
+                for (size_t t = 0; t < kTags; ++t)
+                {
+                    std::vector<std::string> chosen;
+                    for (const auto& file : files)
+                    {
+                        if (rng() % (t + 2) == 0)
+                            chosen.push_back(file);
+                    }
+                    tags.assignTagToMany(chosen, tag_ids[t]);
+                }
+            }
+        };
+
+        TaggedCollection& Collection()
+        {
+            static TaggedCollection collection;
+            return collection;
+        }
+
+        void TagsForFile(benchmark::State& state)
+        {
+            auto& collection = Collection();
+            size_t i = 0;
+            for (auto _ : state)
+            {
+                auto ids = collection.tags.getTagsForFile(collection.files[i++ % collection.files.size()]);
+                benchmark::DoNotOptimize(ids.data());
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        // What a file list does per visible row: path to id once, then ids
+        void TagIdsForFileId(benchmark::State& state)
+        {
+            auto& collection = Collection();
+            std::vector<uint32_t> ids;
+            for (const auto& file : collection.files)
+            {
+                ids.push_back(collection.tags.getFileId(file));
+            }
+
+            size_t i = 0;
+            for (auto _ : state)
+            {
+                const auto& tag_ids = collection.tags.getTagIdsForFile(ids[i++ % ids.size()]);
+                benchmark::DoNotOptimize(&tag_ids);
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        void HasTag(benchmark::State& state)
+        {
+            auto& collection = Collection();
+            size_t i = 0;
+            for (auto _ : state)
+            {
+                bool has = collection.tags.hasTag(collection.files[i % collection.files.size()],
+                                                  collection.tag_ids[i % kTags]);
+                benchmark::DoNotOptimize(has);
+                ++i;
+            }
+            state.SetItemsProcessed(state.iterations());
+        }
+
+        core::TagFilter MakeFilter(int64_t kind)
+        {
+            auto& ids = Collection().tag_ids;
+            core::TagFilter filter;
+            switch (kind)
+            {
+            case 0:     // One common tag
+                filter.includeTags = {ids[0]};
+                break;
+            case 1:     // Two tags, both required
+                filter.includeTags = {ids[0], ids[1]};
+                break;
+            case 2:     // Any of several, less one
+                filter.anyOfTags = {ids[4], ids[8], ids[16]};
+                filter.excludeTags = {ids[1]};
+                break;
+            default:    // Rare and required
+                filter.includeTags = {ids[kTags - 1], ids[2]};
+                break;
+            }
+            return filter;
+        }
+
+        void FilesMatchingFilter(benchmark::State& state)
+        {
+            auto& collection = Collection();
+            const core::TagFilter filter = MakeFilter(state.range(0));
+            for (auto _ : state)
+            {
+                auto files = collection.tags.getFilesMatchingFilter(filter);
+                benchmark::DoNotOptimize(files.data());
+            }
+        }
+
+        void FileIdsMatchingFilter(benchmark::State& state)
+        {
+            auto& collection = Collection();
+            const core::TagFilter filter = MakeFilter(state.range(0));
+            for (auto _ : state)
+            {
+                auto ids = collection.tags.getFileIdsMatchingFilter(filter);
+                benchmark::DoNotOptimize(&ids);
+            }
+        }
+    }
+
+    BENCHMARK(TagsForFile);
+    BENCHMARK(TagIdsForFileId);
+    BENCHMARK(HasTag);
+    BENCHMARK(FilesMatchingFilter)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+    BENCHMARK(FileIdsMatchingFilter)->DenseRange(0, 3)->Unit(benchmark::kMicrosecond);
+
+} // namespace opacity::bench
@@ -0,0 +1,114 @@
+// Whole-tree scenarios over the generated trees (see SyntheticTree): what
+// a user waits on when opening, sorting and searching a very large folder
+// structure. Each runs a few times only; the first run of all writes the
+// trees.
+#include "bench_support.h"
+#include "opacity/filesystem/FileSystemManager.h"
+#include "opacity/search/SearchEngine.h"
+#include <benchmark/benchmark.h>
+
+#include <cstdint>
+
+namespace opacity::bench
+{
+    using filesystem::FsItem;
+
+    namespace
+    {
+        constexpr int kIterations = 3;
+
+        // Every item below root, folder by folder as the panes list them
+        std::vector<FsItem> Walk(filesystem::FileSystemManager& manager, const core::Path& root,
+                                 const filesystem::EnumerationOptions& options)
+        {
+            std::vector<FsItem> all;
+            std::vector<core::Path> pending{root};
+            while (!pending.empty())
+            {
+                core::Path folder = std::move(pending.back());
+                pending.pop_back();
+
+                auto contents = manager.EnumerateDirectory(folder, options);
+                for (auto& item : contents.items)
+                {
+                    if (item.is_directory)
+                        pending.push_back(item.full_path);
+                    all.push_back(std::move(item));
+                }
+            }
+            return all;
+        }
+
+        TreeShape ShapeOf(const benchmark::State& state)
+        {
+            return static_cast<TreeShape>(state.range(0));
+        }
+
+        void EnumerateTree(benchmark::State& state)
+        {
+            const core::Path& root = SyntheticTree(ShapeOf(state));
+            filesystem::FileSystemManager manager;
+            filesystem::EnumerationOptions options;
+
+            size_t items = 0;
+            for (auto _ : state)
+            {
+                items = Walk(manager, root, options).size();
+            }
+            state.counters["items"] = static_cast<double>(items);
+            state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(items));
+        }
+
+        // Sorting everything at once, as a flattened view of the tree would
+        void SortTree(benchmark::State& state)
+        {
+            filesystem::FileSystemManager manager;
+            const auto items = Walk(manager, SyntheticTree(ShapeOf(state)), filesystem::EnumerationOptions());
+            filesystem::FsItemComparator comparator(static_cast<filesystem::SortColumn>(state.range(1)));
+
+            for (auto _ : state)
+            {
+                state.PauseTiming();
+                std::vector<FsItem> copy = items;
+                state.ResumeTiming();
+
+                filesystem::FsItemUtils::Sort(copy, comparator);
+                benchmark::DoNotOptimize(copy.data());
+            }
+            state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(items.size()));
+        }
+
+        void SearchTree(benchmark::State& state, const char* pattern)
+        {
+            const core::Path& root = SyntheticTree(ShapeOf(state));
+            search::SearchEngine engine;
+            search::SearchOptions options;
+            options.max_results = SIZE_MAX;
+
+            size_t results = 0;
+            for (auto _ : state)
+            {
+                results = engine.SearchSync(root, pattern, options).size();
+            }
+            state.counters["results"] = static_cast<double>(results);
+        }
+    }
+
+    BENCHMARK(EnumerateTree)
+        ->ArgName("shape")->Arg(static_cast<int>(TreeShape::Deep))->Arg(static_cast<int>(TreeShape::Wide))
+        ->Iterations(kIterations)->Unit(benchmark::kMillisecond);
+
+    BENCHMARK(SortTree)
+        ->ArgNames({"shape", "column"})
+        ->ArgsProduct({{static_cast<int>(TreeShape::Deep), static_cast<int>(TreeShape::Wide)},
+                       {static_cast<int>(filesystem::SortColumn::Name), static_cast<int>(filesystem::SortColumn::Type)}})
+        ->Iterations(kIterations)->Unit(benchmark::kMillisecond);
+
+    BENCHMARK_CAPTURE(SearchTree, Extension, "*.jpg")
+        ->ArgName("shape")->Arg(static_cast<int>(TreeShape::Deep))->Arg(static_cast<int>(TreeShape::Wide))
+        ->Iterations(kIterations)->Unit(benchmark::kMillisecond);
+    BENCHMARK_CAPTURE(SearchTree, Rare, "*README12345*")
+        ->ArgName("shape")->Arg(static_cast<int>(TreeShape::Deep))->Arg(static_cast<int>(TreeShape::Wide))
+        ->Iterations(kIterations)->Unit(benchmark::kMillisecond);
+
+} // namespace opacity::bench